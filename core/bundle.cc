@@ -7,29 +7,86 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <stdexcept>
+
 #include "core/bundle.h"
 
 CORE_NAMESPACE_BEGIN
 
 bool
-Bundle::Feature3D::contains_view_id (int id) const
+Bundle::feature_contains_view_id (std::size_t feature_id, int id) const
 {
-    for (std::size_t i = 0; i < this->refs.size(); ++i)
-        if (this->refs[i].view_id == id)
+    Feature2D const* refs = this->get_feature_refs(feature_id);
+    std::size_t const num_refs = this->get_num_feature_refs(feature_id);
+    for (std::size_t i = 0; i < num_refs; ++i)
+        if (refs[i].view_id == id)
             return true;
     return false;
 }
 
 /* -------------------------------------------------------------- */
 
+void
+Bundle::reserve_features (std::size_t num_features, std::size_t num_refs)
+{
+    this->positions.reserve(num_features);
+    this->colors.reserve(num_features);
+    this->ref_offsets.reserve(num_features + 1);
+    this->refs.reserve(num_refs);
+}
+
+/* -------------------------------------------------------------- */
+
+std::size_t
+Bundle::add_feature (math::Vec3f const& pos, math::Vec3f const& color,
+    Feature2D const* refs, std::size_t num_refs)
+{
+    this->positions.push_back(pos);
+    this->colors.push_back(color);
+    this->refs.insert(this->refs.end(), refs, refs + num_refs);
+    this->ref_offsets.push_back(this->refs.size());
+    return this->positions.size() - 1;
+}
+
+/* -------------------------------------------------------------- */
+
+void
+Bundle::set_features (FeaturePositions* positions, FeatureColors* colors,
+    FeatureRefOffsets* offsets, FeatureRefs* refs)
+{
+    if (colors->size() != positions->size()
+        || offsets->size() != positions->size() + 1
+        || offsets->front() != 0 || offsets->back() != refs->size())
+        throw std::invalid_argument("Invalid feature arrays");
+
+    std::swap(this->positions, *positions);
+    std::swap(this->colors, *colors);
+    std::swap(this->ref_offsets, *offsets);
+    std::swap(this->refs, *refs);
+}
+
+/* -------------------------------------------------------------- */
+
+void
+Bundle::clear_features (void)
+{
+    FeaturePositions().swap(this->positions);
+    FeatureColors().swap(this->colors);
+    FeatureRefOffsets(1, 0).swap(this->ref_offsets);
+    FeatureRefs().swap(this->refs);
+}
+
+/* -------------------------------------------------------------- */
+
 std::size_t
 Bundle::get_byte_size (void) const
 {
     std::size_t ret = 0;
     ret += this->cameras.capacity() * sizeof(CameraInfo);
-    ret += this->features.capacity() * sizeof(Feature3D);
-    for (std::size_t i = 0; i < this->features.size(); ++i)
-        ret += this->features[i].refs.capacity() * sizeof(Feature2D);
+    ret += this->positions.capacity() * sizeof(math::Vec3f);
+    ret += this->colors.capacity() * sizeof(math::Vec3f);
+    ret += this->ref_offsets.capacity() * sizeof(std::size_t);
+    ret += this->refs.capacity() * sizeof(Feature2D);
     return ret;
 }
 
@@ -60,12 +117,10 @@ Bundle::get_features_as_mesh (void) const
     TriangleMesh::Ptr mesh = core::TriangleMesh::create();
     TriangleMesh::VertexList& verts = mesh->get_vertices();
     TriangleMesh::ColorList& colors = mesh->get_vertex_colors();
-    for (std::size_t i = 0; i < this->features.size(); ++i)
-    {
-        Bundle::Feature3D const& f = this->features[i];
-        verts.push_back(math::Vec3f(f.pos));
-        colors.push_back(math::Vec4f(f.color[0], f.color[1], f.color[2], 1.0f));
-    }
+    verts = this->positions;
+    colors.reserve(this->colors.size());
+    for (std::size_t i = 0; i < this->colors.size(); ++i)
+        colors.push_back(math::Vec4f(this->colors[i], 1.0f));
     return mesh;
 }
 
@@ -81,18 +136,18 @@ Bundle::delete_camera (std::size_t index)
     this->cameras[index].flen = 0.0f;
 
     /* Delete all SIFT features that are visible in this camera. */
-    for (std::size_t i = 0; i < this->features.size(); ++i)
+    std::size_t num_refs = 0;
+    for (std::size_t i = 0; i < this->positions.size(); ++i)
     {
-        Feature3D& feature = this->features[i];
-        typedef std::vector<Feature2D> FeatureRefs;
-        FeatureRefs& refs = feature.refs;
-
-        for (FeatureRefs::iterator iter = refs.begin(); iter != refs.end();)
-            if (iter->view_id == static_cast<int>(index))
-                iter = refs.erase(iter);
-            else
-                iter++;
+        std::size_t const begin = this->ref_offsets[i];
+        std::size_t const end = this->ref_offsets[i + 1];
+        this->ref_offsets[i] = num_refs;
+        for (std::size_t j = begin; j < end; ++j)
+            if (this->refs[j].view_id != static_cast<int>(index))
+                this->refs[num_refs++] = this->refs[j];
     }
+    this->ref_offsets.back() = num_refs;
+    this->refs.resize(num_refs);
 }
 
 CORE_NAMESPACE_END
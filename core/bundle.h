@@ -10,9 +10,11 @@
 #ifndef MVE_BUNDLE_HEADER
 #define MVE_BUNDLE_HEADER
 
+#include <cstddef>
 #include <vector>
 #include <memory>
 
+#include "math/vector.h"
 #include "core/camera.h"
 #include "core/mesh.h"
 #include "core/defines.h"
@@ -23,6 +25,11 @@ CORE_NAMESPACE_BEGIN
  * A simple data structure to represent bundle files.
  * A bundle file contains a set of cameras and a 3D feature points.
  * Every feature is associated with cameras that observe the feature.
+ *
+ * The features are stored as structure of arrays: Positions, colors and
+ * offsets into one flat array of references to the views. The references
+ * of feature i are refs[offsets[i]] to refs[offsets[i + 1]]. This avoids
+ * one allocation per feature for large bundles.
  */
 class Bundle
 {
@@ -37,29 +44,18 @@ public:
         float pos[2];
     };
 
-    /**
-     * Representation of a 3D feature with position and color. Every feature
-     * also corresponds to a set of views form which it is seen. In general,
-     * a 3D feature is seen by at least two cameras. However, if cameras are
-     * deleted from the bundle, there may only be one or zero cameras left.
-     */
-    struct Feature3D
-    {
-        /** 3D Position of the feature (track). */
-        float pos[3];
-        /** RGB color of the feature in [0,1]^3. */
-        float color[3];
-        /** References to views that see the feature. */
-        std::vector<Feature2D> refs;
-
-        bool contains_view_id (int id) const;
-    };
-
 public:
     typedef std::shared_ptr<Bundle> Ptr;
     typedef std::shared_ptr<Bundle const> ConstPtr;
     typedef std::vector<CameraInfo> Cameras;
-    typedef std::vector<Feature3D> Features;
+    /** 3D positions of the features (tracks). */
+    typedef std::vector<math::Vec3f> FeaturePositions;
+    /** RGB colors of the features in [0,1]^3. */
+    typedef std::vector<math::Vec3f> FeatureColors;
+    /** Offsets of the references of every feature, plus the end. */
+    typedef std::vector<std::size_t> FeatureRefOffsets;
+    /** References to the views that see the features. */
+    typedef std::vector<Feature2D> FeatureRefs;
 
 public:
     static Ptr create (void);
@@ -68,10 +64,45 @@ public:
     Cameras const& get_cameras (void) const;
     /** Returns all (possibly invalid) cameras (check focal length). */
     Cameras& get_cameras (void);
-    /** Returns the list of 3D features points. */
-    Features const& get_features (void) const;
-    /** Returns the list of 3D features points. */
-    Features& get_features (void);
+
+    /** Returns the number of 3D features. */
+    std::size_t get_num_features (void) const;
+    /** Returns the positions of the 3D features. */
+    FeaturePositions const& get_feature_positions (void) const;
+    /** Returns the positions of the 3D features. */
+    FeaturePositions& get_feature_positions (void);
+    /** Returns the colors of the 3D features. */
+    FeatureColors const& get_feature_colors (void) const;
+    /** Returns the colors of the 3D features. */
+    FeatureColors& get_feature_colors (void);
+    /** Returns the reference offsets of the 3D features. */
+    FeatureRefOffsets const& get_feature_ref_offsets (void) const;
+    /** Returns the flat array of references of all 3D features. */
+    FeatureRefs const& get_feature_refs (void) const;
+
+    /** Returns the number of views that see the feature. */
+    std::size_t get_num_feature_refs (std::size_t feature_id) const;
+    /** Returns the references to views that see the feature. */
+    Feature2D const* get_feature_refs (std::size_t feature_id) const;
+    /** Returns the references to views that see the feature. */
+    Feature2D* get_feature_refs (std::size_t feature_id);
+    /** Returns true if the feature is seen by the given view. */
+    bool feature_contains_view_id (std::size_t feature_id, int id) const;
+
+    /** Reserves memory for the given amount of features and references. */
+    void reserve_features (std::size_t num_features, std::size_t num_refs);
+    /** Appends a feature with the given references, returns its index. */
+    std::size_t add_feature (math::Vec3f const& pos, math::Vec3f const& color,
+        Feature2D const* refs, std::size_t num_refs);
+    /**
+     * Replaces all features. The offsets must have one more element than
+     * the positions and colors, and the last offset is the number of refs.
+     */
+    void set_features (FeaturePositions* positions, FeatureColors* colors,
+        FeatureRefOffsets* offsets, FeatureRefs* refs);
+    /** Removes all features. */
+    void clear_features (void);
+
     /** Returns the number of bytes required by this bundle. */
     std::size_t get_byte_size (void) const;
     /** Returns the number of cameras including invalid cameras. */
@@ -80,7 +111,10 @@ public:
     std::size_t get_num_valid_cameras (void) const;
     /** Returns all 3D features as colored set of points. */
     TriangleMesh::Ptr get_features_as_mesh (void) const;
-    /** Deletes a camera from the data structure fixing references. */
+    /**
+     * Deletes a camera from the data structure fixing references.
+     * The references are compacted in-place, features are kept.
+     */
     void delete_camera (std::size_t index);
 
 protected:
@@ -88,13 +122,17 @@ protected:
 
 private:
     Cameras cameras;
-    Features features;
+    FeaturePositions positions;
+    FeatureColors colors;
+    FeatureRefOffsets ref_offsets;
+    FeatureRefs refs;
 };
 
 /* -------------------------------------------------------------- */
 
 inline
 Bundle::Bundle (void)
+    : ref_offsets(1, 0)
 {
 }
 
@@ -116,16 +154,64 @@ Bundle::get_cameras (void)
     return this->cameras;
 }
 
-inline Bundle::Features const&
-Bundle::get_features (void) const
+inline std::size_t
+Bundle::get_num_features (void) const
+{
+    return this->positions.size();
+}
+
+inline Bundle::FeaturePositions const&
+Bundle::get_feature_positions (void) const
+{
+    return this->positions;
+}
+
+inline Bundle::FeaturePositions&
+Bundle::get_feature_positions (void)
+{
+    return this->positions;
+}
+
+inline Bundle::FeatureColors const&
+Bundle::get_feature_colors (void) const
+{
+    return this->colors;
+}
+
+inline Bundle::FeatureColors&
+Bundle::get_feature_colors (void)
+{
+    return this->colors;
+}
+
+inline Bundle::FeatureRefOffsets const&
+Bundle::get_feature_ref_offsets (void) const
+{
+    return this->ref_offsets;
+}
+
+inline Bundle::FeatureRefs const&
+Bundle::get_feature_refs (void) const
+{
+    return this->refs;
+}
+
+inline std::size_t
+Bundle::get_num_feature_refs (std::size_t feature_id) const
+{
+    return this->ref_offsets[feature_id + 1] - this->ref_offsets[feature_id];
+}
+
+inline Bundle::Feature2D const*
+Bundle::get_feature_refs (std::size_t feature_id) const
 {
-    return this->features;
+    return this->refs.data() + this->ref_offsets[feature_id];
 }
 
-inline Bundle::Features&
-Bundle::get_features (void)
+inline Bundle::Feature2D*
+Bundle::get_feature_refs (std::size_t feature_id)
 {
-    return this->features;
+    return this->refs.data() + this->ref_offsets[feature_id];
 }
 
 CORE_NAMESPACE_END
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "math/matrix.h"
+#include "math/octree_tools.h"
+#include "core/bundle_index.h"
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /* A halfspace n * x + d >= 0 of the viewing frustum. */
+    struct Halfspace
+    {
+        math::Vec3f n;
+        float d;
+    };
+
+    enum BoxClass
+    {
+        BOX_OUTSIDE,
+        BOX_INSIDE,
+        BOX_INTERSECTING
+    };
+
+    BoxClass
+    classify_box (Halfspace const* planes, int num_planes,
+        math::Vec3f const& aabb_min, math::Vec3f const& aabb_max)
+    {
+        math::Vec3f const center = (aabb_min + aabb_max) / 2.0f;
+        math::Vec3f const halfsize = (aabb_max - aabb_min) / 2.0f;
+        BoxClass result = BOX_INSIDE;
+        for (int i = 0; i < num_planes; ++i)
+        {
+            Halfspace const& h = planes[i];
+            float const dist = h.n.dot(center) + h.d;
+            float const radius = std::abs(h.n[0]) * halfsize[0]
+                + std::abs(h.n[1]) * halfsize[1]
+                + std::abs(h.n[2]) * halfsize[2];
+            if (dist + radius < 0.0f)
+                return BOX_OUTSIDE;
+            if (dist - radius < 0.0f)
+                result = BOX_INTERSECTING;
+        }
+        return result;
+    }
+}  /* namespace */
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::build (Bundle const& bundle)
+{
+    this->clear();
+
+    std::size_t const num_features = bundle.get_num_features();
+    std::size_t const num_cameras = bundle.get_num_cameras();
+
+    /* Inverted lists, features are visited in order and stay sorted. */
+    this->visible_features.resize(num_cameras);
+    for (std::size_t i = 0; i < num_features; ++i)
+    {
+        Bundle::Feature2D const* refs = bundle.get_feature_refs(i);
+        std::size_t const num_refs = bundle.get_num_feature_refs(i);
+        for (std::size_t j = 0; j < num_refs; ++j)
+        {
+            int const view_id = refs[j].view_id;
+            if (view_id < 0
+                || static_cast<std::size_t>(view_id) >= num_cameras)
+                throw std::invalid_argument("Invalid view ID in bundle");
+            FeatureList& list = this->visible_features[view_id];
+            if (list.empty() || list.back() != i)
+                list.push_back(i);
+        }
+    }
+
+    /* Octree over the feature positions. */
+    this->positions = bundle.get_feature_positions();
+    this->permutation.resize(num_features);
+    for (std::size_t i = 0; i < num_features; ++i)
+        this->permutation[i] = i;
+    if (num_features == 0)
+        return;
+
+    Node root;
+    root.aabb_min = math::Vec3f(std::numeric_limits<float>::max());
+    root.aabb_max = math::Vec3f(-std::numeric_limits<float>::max());
+    for (std::size_t i = 0; i < this->positions.size(); ++i)
+    {
+        math::Vec3f const& pos = this->positions[i];
+        for (int j = 0; j < 3; ++j)
+        {
+            root.aabb_min[j] = std::min(root.aabb_min[j], pos[j]);
+            root.aabb_max[j] = std::max(root.aabb_max[j], pos[j]);
+        }
+    }
+    root.first_child = -1;
+    root.begin = 0;
+    root.end = num_features;
+    this->nodes.push_back(root);
+    this->build_node(0, 0);
+}
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::build_node (std::size_t node_id, int depth)
+{
+    Node const node = this->nodes[node_id];
+    if (node.end - node.begin <= this->opts.max_leaf_features
+        || depth >= this->opts.max_depth)
+        return;
+
+    /* Partition the features by octant, ordered as the children. */
+    math::Vec3f const center = (node.aabb_min + node.aabb_max) / 2.0f;
+    std::vector<std::size_t>::iterator begin = this->permutation.begin();
+    std::vector<std::size_t>::iterator bounds[9];
+    bounds[0] = begin + node.begin;
+    bounds[8] = begin + node.end;
+    for (int axis = 0, step = 4; axis < 3; ++axis, step /= 2)
+    {
+        for (int i = 0; i < 8; i += 2 * step)
+        {
+            bounds[i + step] = std::partition(bounds[i], bounds[i + 2 * step],
+                [this, &center, axis] (std::size_t id)
+                { return this->positions[id][axis] < center[axis]; });
+        }
+    }
+
+    /* The children are referenced by index, the vector may reallocate. */
+    std::size_t const first_child = this->nodes.size();
+    this->nodes[node_id].first_child = static_cast<int>(first_child);
+    for (int i = 0; i < 8; ++i)
+    {
+        Node child;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bool const upper = (i & (4 >> axis)) != 0;
+            child.aabb_min[axis] = upper ? center[axis] : node.aabb_min[axis];
+            child.aabb_max[axis] = upper ? node.aabb_max[axis] : center[axis];
+        }
+        child.first_child = -1;
+        child.begin = std::distance(begin, bounds[i]);
+        child.end = std::distance(begin, bounds[i + 1]);
+        this->nodes.push_back(child);
+    }
+    for (int i = 0; i < 8; ++i)
+        this->build_node(first_child + i, depth + 1);
+}
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::clear (void)
+{
+    this->visible_features.clear();
+    this->positions.clear();
+    this->permutation.clear();
+    this->nodes.clear();
+}
+
+/* -------------------------------------------------------------- */
+
+BundleIndex::FeatureList const&
+BundleIndex::get_visible_features (std::size_t camera_id) const
+{
+    if (camera_id >= this->visible_features.size())
+        throw std::invalid_argument("Invalid camera ID");
+    return this->visible_features[camera_id];
+}
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::get_shared_features (std::size_t camera_1_id,
+    std::size_t camera_2_id, FeatureList* result) const
+{
+    FeatureList const& list_1 = this->get_visible_features(camera_1_id);
+    FeatureList const& list_2 = this->get_visible_features(camera_2_id);
+    result->clear();
+    std::set_intersection(list_1.begin(), list_1.end(),
+        list_2.begin(), list_2.end(), std::back_inserter(*result));
+}
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::collect_features (std::size_t node_id, FeatureList* result) const
+{
+    Node const& node = this->nodes[node_id];
+    result->insert(result->end(), this->permutation.begin() + node.begin,
+        this->permutation.begin() + node.end);
+}
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::query_box (math::Vec3f const& aabb_min,
+    math::Vec3f const& aabb_max, FeatureList* result) const
+{
+    result->clear();
+    if (this->nodes.empty())
+        return;
+
+    std::vector<std::size_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        std::size_t const node_id = stack.back();
+        Node const& node = this->nodes[node_id];
+        stack.pop_back();
+
+        if (!math::geom::box_box_overlap(node.aabb_min, node.aabb_max,
+            aabb_min, aabb_max))
+            continue;
+
+        /* Nodes inside the query box are taken without testing. */
+        if (math::geom::point_box_overlap(node.aabb_min, aabb_min, aabb_max)
+            && math::geom::point_box_overlap(node.aabb_max,
+            aabb_min, aabb_max))
+        {
+            this->collect_features(node_id, result);
+            continue;
+        }
+
+        if (node.first_child >= 0)
+        {
+            for (int i = 0; i < 8; ++i)
+                stack.push_back(node.first_child + i);
+            continue;
+        }
+
+        for (std::size_t i = node.begin; i < node.end; ++i)
+        {
+            std::size_t const id = this->permutation[i];
+            if (math::geom::point_box_overlap(this->positions[id],
+                aabb_min, aabb_max))
+                result->push_back(id);
+        }
+    }
+}
+
+/* -------------------------------------------------------------- */
+
+void
+BundleIndex::query_frustum (CameraInfo const& camera, float width,
+    float height, float znear, float zfar, FeatureList* result) const
+{
+    result->clear();
+    if (this->nodes.empty())
+        return;
+
+    /* Projection p = K (R x + t) = A x + b of a world point x. */
+    math::Matrix3f K, R;
+    camera.fill_calibration(K.begin(), width, height);
+    camera.fill_world_to_cam_rot(R.begin());
+    math::Vec3f t;
+    camera.fill_camera_translation(t.begin());
+    math::Matrix3f const A = K * R;
+    math::Vec3f const b = K * t;
+    math::Vec3f const row[3] = { A.row(0), A.row(1), A.row(2) };
+
+    /* The frustum is 0 <= p_x <= w p_z, 0 <= p_y <= h p_z, n <= p_z <= f. */
+    Halfspace planes[6];
+    planes[0].n = row[0];
+    planes[0].d = b[0];
+    planes[1].n = row[2] * width - row[0];
+    planes[1].d = b[2] * width - b[0];
+    planes[2].n = row[1];
+    planes[2].d = b[1];
+    planes[3].n = row[2] * height - row[1];
+    planes[3].d = b[2] * height - b[1];
+    planes[4].n = row[2];
+    planes[4].d = b[2] - znear;
+    planes[5].n = -row[2];
+    planes[5].d = zfar - b[2];
+
+    std::vector<std::size_t> stack(1, 0);
+    while (!stack.empty())
+    {
+        std::size_t const node_id = stack.back();
+        Node const& node = this->nodes[node_id];
+        stack.pop_back();
+
+        BoxClass const box_class = classify_box(planes, 6,
+            node.aabb_min, node.aabb_max);
+        if (box_class == BOX_OUTSIDE)
+            continue;
+        if (box_class == BOX_INSIDE)
+        {
+            this->collect_features(node_id, result);
+            continue;
+        }
+
+        if (node.first_child >= 0)
+        {
+            for (int i = 0; i < 8; ++i)
+                stack.push_back(node.first_child + i);
+            continue;
+        }
+
+        for (std::size_t i = node.begin; i < node.end; ++i)
+        {
+            std::size_t const id = this->permutation[i];
+            math::Vec3f const& pos = this->positions[id];
+            bool inside = true;
+            for (int j = 0; inside && j < 6; ++j)
+                inside = planes[j].n.dot(pos) + planes[j].d >= 0.0f;
+            if (inside)
+                result->push_back(id);
+        }
+    }
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_BUNDLE_INDEX_HEADER
+#define MVE_BUNDLE_INDEX_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "math/vector.h"
+#include "core/bundle.h"
+#include "core/camera.h"
+#include "core/defines.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * A spatial and visibility index over the 3D features of a bundle.
+ *
+ * The index keeps an inverted list per camera with the features seen by
+ * the camera, and an octree over the feature positions for box and frustum
+ * queries. Features are referred to by their index in the bundle. The index
+ * is a snapshot of the bundle and must be built again if the bundle changes.
+ * All queries are const and can run concurrently.
+ */
+class BundleIndex
+{
+public:
+    /** Options for building the octree. */
+    struct Options
+    {
+        Options (void);
+
+        /** Nodes with at most this many features are not split further. */
+        std::size_t max_leaf_features;
+        /** The maximum depth of the octree. */
+        int max_depth;
+    };
+
+    typedef std::vector<std::size_t> FeatureList;
+
+public:
+    BundleIndex (void);
+    explicit BundleIndex (Options const& options);
+
+    /** Builds the index for the given bundle. */
+    void build (Bundle const& bundle);
+    /** Releases the index. */
+    void clear (void);
+
+    /** Returns the number of indexed cameras. */
+    std::size_t get_num_cameras (void) const;
+    /** Returns the number of indexed features. */
+    std::size_t get_num_features (void) const;
+
+    /** Returns the features seen by a camera in increasing order. */
+    FeatureList const& get_visible_features (std::size_t camera_id) const;
+
+    /** Stores the features seen by both cameras in increasing order. */
+    void get_shared_features (std::size_t camera_1_id,
+        std::size_t camera_2_id, FeatureList* result) const;
+
+    /** Stores the features inside the axis-aligned box. */
+    void query_box (math::Vec3f const& aabb_min, math::Vec3f const& aabb_max,
+        FeatureList* result) const;
+
+    /**
+     * Stores the features inside the viewing frustum of the camera for an
+     * image of the given dimensions, with depths between 'znear' and 'zfar'.
+     * Occlusion is not considered, see get_visible_features() instead.
+     */
+    void query_frustum (CameraInfo const& camera, float width, float height,
+        float znear, float zfar, FeatureList* result) const;
+
+private:
+    struct Node
+    {
+        math::Vec3f aabb_min;
+        math::Vec3f aabb_max;
+        /* The first of eight children, or -1 for leaves. */
+        int first_child;
+        /* The range of features in the permutation. */
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    void build_node (std::size_t node_id, int depth);
+    void collect_features (std::size_t node_id, FeatureList* result) const;
+
+private:
+    Options opts;
+    std::vector<FeatureList> visible_features;
+    std::vector<math::Vec3f> positions;
+    /* The feature indices ordered by the leaves of the octree. */
+    std::vector<std::size_t> permutation;
+    std::vector<Node> nodes;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+BundleIndex::Options::Options (void)
+    : max_leaf_features(32)
+    , max_depth(16)
+{
+}
+
+inline
+BundleIndex::BundleIndex (void)
+{
+}
+
+inline
+BundleIndex::BundleIndex (Options const& options)
+    : opts(options)
+{
+}
+
+inline std::size_t
+BundleIndex::get_num_cameras (void) const
+{
+    return this->visible_features.size();
+}
+
+inline std::size_t
+BundleIndex::get_num_features (void) const
+{
+    return this->positions.size();
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_BUNDLE_INDEX_HEADER */
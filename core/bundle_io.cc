@@ -7,12 +7,18 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cctype>
 #include <cerrno>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <vector>
 
+#include "util/binary_io.h"
 #include "util/file_system.h"
 #include "util/strings.h"
 #include "util/exception.h"
@@ -22,11 +28,195 @@
 
 CORE_NAMESPACE_BEGIN
 
+#define BINARY_BUNDLE_SIGNATURE "\211MVE_BUNDLE\n"
+#define BINARY_BUNDLE_SIGNATURE_LEN 12
+
+/* The amount of bytes read at once by the text parsers. */
+#define BUNDLE_TEXT_CHUNK_SIZE (16 << 20)
+/* Unread bytes kept in the buffer, at least the longest token. */
+#define BUNDLE_TEXT_MIN_AVAILABLE 4096
+
+/* The amount of features used to estimate the amount of references. */
+#define BUNDLE_REFS_ESTIMATE_FEATURES 1024
+
+/* The amount of floats per camera in the binary bundle format. */
+#define BINARY_BUNDLE_CAMERA_FLOATS 18
+
+namespace
+{
+    /*
+     * Whitespace-separated tokens of a text file, read in large chunks.
+     * Like std::istream, failures are sticky and values read after a
+     * failure are zero, so the parsers check good() only where needed.
+     */
+    class BundleTextReader
+    {
+    public:
+        explicit BundleTextReader (std::string const& filename);
+
+        bool good (void) const;
+
+        int read_int (void);
+        float read_float (void);
+        double read_double (void);
+        std::string read_token (void);
+        /* Returns the rest of the current line without the newline. */
+        std::string read_line (void);
+
+    private:
+        void fill (void);
+        void skip_whitespace (void);
+        template <typename T>
+        T read_number (void);
+
+    private:
+        util::BinaryReader in;
+        std::vector<char> buffer;
+        std::size_t pos;
+        std::size_t end;
+        bool failed;
+    };
+
+    BundleTextReader::BundleTextReader (std::string const& filename)
+        : in(filename)
+        , buffer(BUNDLE_TEXT_CHUNK_SIZE + BUNDLE_TEXT_MIN_AVAILABLE)
+        , pos(0)
+        , end(0)
+        , failed(false)
+    {
+        this->fill();
+    }
+
+    inline bool
+    BundleTextReader::good (void) const
+    {
+        return !this->failed;
+    }
+
+    /* Moves unread bytes to the front and reads the next chunk. */
+    void
+    BundleTextReader::fill (void)
+    {
+        if (this->end - this->pos >= BUNDLE_TEXT_MIN_AVAILABLE
+            || this->in.eof())
+            return;
+        std::copy(this->buffer.begin() + this->pos,
+            this->buffer.begin() + this->end, this->buffer.begin());
+        this->end -= this->pos;
+        this->pos = 0;
+        this->end += this->in.read(&this->buffer[this->end],
+            BUNDLE_TEXT_CHUNK_SIZE);
+    }
+
+    void
+    BundleTextReader::skip_whitespace (void)
+    {
+        while (true)
+        {
+            this->fill();
+            while (this->pos < this->end
+                && std::isspace(static_cast<unsigned char>(
+                this->buffer[this->pos])))
+                this->pos += 1;
+            if (this->pos < this->end || this->in.eof())
+                return;
+        }
+    }
+
+    template <typename T>
+    T
+    BundleTextReader::read_number (void)
+    {
+        this->skip_whitespace();
+        T value = T();
+        char const* data = this->buffer.data();
+        char const* next = util::string::parse_number(data + this->pos,
+            data + this->end, &value);
+        if (this->failed || next == nullptr)
+        {
+            this->failed = true;
+            return T();
+        }
+        this->pos = next - data;
+        return value;
+    }
+
+    int
+    BundleTextReader::read_int (void)
+    {
+        return this->read_number<int>();
+    }
+
+    float
+    BundleTextReader::read_float (void)
+    {
+        return this->read_number<float>();
+    }
+
+    double
+    BundleTextReader::read_double (void)
+    {
+        return this->read_number<double>();
+    }
+
+    std::string
+    BundleTextReader::read_token (void)
+    {
+        this->skip_whitespace();
+        std::size_t const begin = this->pos;
+        while (this->pos < this->end
+            && !std::isspace(static_cast<unsigned char>(
+            this->buffer[this->pos])))
+            this->pos += 1;
+        if (this->failed || begin == this->pos)
+        {
+            this->failed = true;
+            return std::string();
+        }
+        return std::string(&this->buffer[begin], this->pos - begin);
+    }
+
+    std::string
+    BundleTextReader::read_line (void)
+    {
+        this->fill();
+        std::size_t const begin = this->pos;
+        while (this->pos < this->end && this->buffer[this->pos] != '\n')
+            this->pos += 1;
+        std::string line(&this->buffer[begin], this->pos - begin);
+        if (this->pos < this->end)
+            this->pos += 1;
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.resize(line.size() - 1);
+        return line;
+    }
+
+    /* ---------------------------------------------------------------- */
+
+    /*
+     * Reserves the references of all features from the average amount of
+     * references of the features read so far. This avoids growing the flat
+     * reference array repeatedly, which would temporarily need up to three
+     * times the memory of the references.
+     */
+    void
+    reserve_feature_refs (Bundle* bundle, std::size_t num_features)
+    {
+        std::size_t const num_read = bundle->get_num_features();
+        std::size_t const num_refs = bundle->get_feature_refs().size();
+        if (num_read > 0)
+            bundle->reserve_features(num_features,
+                num_refs * num_features / num_read * 21 / 20);
+    }
+}  // namespace
+
 /* ------------------- MVE native bundle format ------------------- */
 
 Bundle::Ptr
 load_mve_bundle (std::string const& filename)
 {
+    if (is_binary_bundle_file(filename))
+        return load_binary_bundle(filename);
     return load_photosynther_bundle(filename);
 }
 
@@ -36,6 +226,152 @@ save_mve_bundle (Bundle::ConstPtr bundle, std::string const& filename)
     save_photosynther_bundle(bundle, filename);
 }
 
+/* --------------------- Binary bundle format --------------------- */
+
+bool
+is_binary_bundle_file (std::string const& filename)
+{
+    util::BinaryReader in;
+    try
+    {
+        in.open(filename);
+    }
+    catch (util::FileException const&)
+    {
+        return false;
+    }
+    char signature[BINARY_BUNDLE_SIGNATURE_LEN];
+    return in.read(signature, BINARY_BUNDLE_SIGNATURE_LEN)
+        == BINARY_BUNDLE_SIGNATURE_LEN && std::equal(signature,
+        signature + BINARY_BUNDLE_SIGNATURE_LEN, BINARY_BUNDLE_SIGNATURE);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+save_binary_bundle (Bundle::ConstPtr bundle, std::string const& filename)
+{
+    Bundle::Cameras const& cameras = bundle->get_cameras();
+    Bundle::FeatureRefOffsets const& ref_offsets
+        = bundle->get_feature_ref_offsets();
+
+    util::BinaryWriter out(filename);
+
+    /* Header with the signature and the sizes. */
+    uint32_t const num_cameras = cameras.size();
+    uint64_t const num_features = bundle->get_num_features();
+    uint64_t const num_refs = bundle->get_feature_refs().size();
+    out.write(BINARY_BUNDLE_SIGNATURE, BINARY_BUNDLE_SIGNATURE_LEN);
+    out.write_value(num_cameras);
+    out.write_value(num_features);
+    out.write_value(num_refs);
+
+    /* Cameras. */
+    for (std::size_t i = 0; i < cameras.size(); ++i)
+    {
+        CameraInfo const& cam = cameras[i];
+        float values[BINARY_BUNDLE_CAMERA_FLOATS] = { cam.flen,
+            cam.ppoint[0], cam.ppoint[1], cam.paspect,
+            cam.dist[0], cam.dist[1] };
+        std::copy(cam.trans, cam.trans + 3, values + 6);
+        std::copy(cam.rot, cam.rot + 9, values + 9);
+        out.write_array(values, BINARY_BUNDLE_CAMERA_FLOATS);
+    }
+
+    /* Feature reference offsets, positions, colors and references. */
+    std::vector<uint64_t> offsets(ref_offsets.begin(), ref_offsets.end());
+    out.write_array(offsets.data(), offsets.size());
+    out.write_array(bundle->get_feature_positions().data(), num_features);
+    out.write_array(bundle->get_feature_colors().data(), num_features);
+    out.write_array(bundle->get_feature_refs().data(), num_refs);
+    out.close();
+}
+
+/* ---------------------------------------------------------------- */
+
+Bundle::Ptr
+load_binary_bundle (std::string const& filename)
+{
+    static_assert(sizeof(Bundle::Feature2D) == 16,
+        "Unexpected feature reference size");
+    static_assert(sizeof(math::Vec3f) == 3 * sizeof(float),
+        "Unexpected vector size");
+
+    util::BinaryReader in(filename);
+    uint64_t const file_size = in.size();
+
+    char signature[BINARY_BUNDLE_SIGNATURE_LEN];
+    if (in.read(signature, BINARY_BUNDLE_SIGNATURE_LEN)
+        != BINARY_BUNDLE_SIGNATURE_LEN || !std::equal(signature,
+        signature + BINARY_BUNDLE_SIGNATURE_LEN, BINARY_BUNDLE_SIGNATURE))
+        throw util::Exception(filename, ": Invalid bundle signature");
+
+    uint32_t const num_cameras = in.read_value<uint32_t>();
+    uint64_t const num_features = in.read_value<uint64_t>();
+    uint64_t const num_refs = in.read_value<uint64_t>();
+
+    /*
+     * Check that the sizes match the file size. Every feature has an
+     * offset, a position and a color, there is one more offset.
+     */
+    uint64_t const header_size = BINARY_BUNDLE_SIGNATURE_LEN + 4 + 8 + 8;
+    uint64_t const camera_size = BINARY_BUNDLE_CAMERA_FLOATS * sizeof(float);
+    uint64_t const feature_size = 8 + 6 * sizeof(float);
+    uint64_t const ref_size = sizeof(Bundle::Feature2D);
+    if (in.eof() || num_features > file_size / feature_size
+        || num_refs > file_size / ref_size
+        || header_size + num_cameras * camera_size + 8
+        + num_features * feature_size + num_refs * ref_size != file_size)
+        throw util::Exception(filename, ": Invalid bundle size");
+
+    Bundle::Ptr bundle = Bundle::create();
+
+    /* Read all cameras. */
+    Bundle::Cameras& cameras = bundle->get_cameras();
+    cameras.resize(num_cameras);
+    for (uint32_t i = 0; i < num_cameras; ++i)
+    {
+        float values[BINARY_BUNDLE_CAMERA_FLOATS];
+        in.read_array(values, BINARY_BUNDLE_CAMERA_FLOATS);
+        CameraInfo& cam = cameras[i];
+        cam.flen = values[0];
+        cam.ppoint[0] = values[1];
+        cam.ppoint[1] = values[2];
+        cam.paspect = values[3];
+        cam.dist[0] = values[4];
+        cam.dist[1] = values[5];
+        std::copy(values + 6, values + 9, cam.trans);
+        std::copy(values + 9, values + 18, cam.rot);
+    }
+
+    /* Read the feature arrays. */
+    std::vector<uint64_t> offsets(num_features + 1);
+    Bundle::FeaturePositions positions(num_features);
+    Bundle::FeatureColors colors(num_features);
+    Bundle::FeatureRefs refs(num_refs);
+    in.read_array(offsets.data(), offsets.size());
+    in.read_array(positions.data(), positions.size());
+    in.read_array(colors.data(), colors.size());
+    in.read_array(refs.data(), refs.size());
+    if (in.eof())
+        throw util::Exception(filename, ": EOF while reading bundle");
+
+    for (std::size_t i = 0; i < num_features; ++i)
+        if (offsets[i] > offsets[i + 1])
+            throw util::Exception(filename, ": Invalid reference offsets");
+    Bundle::FeatureRefOffsets ref_offsets(offsets.begin(), offsets.end());
+    try
+    {
+        bundle->set_features(&positions, &colors, &ref_offsets, &refs);
+    }
+    catch (std::invalid_argument const&)
+    {
+        throw util::Exception(filename, ": Invalid reference offsets");
+    }
+
+    return bundle;
+}
+
 /* -------------- Support for NVM files (VisualSFM) --------------- */
 
 namespace
@@ -67,28 +403,21 @@ Bundle::Ptr
 load_nvm_bundle (std::string const& filename,
     std::vector<NVMCameraInfo>* camera_info)
 {
-    std::ifstream in(filename.c_str());
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    BundleTextReader in(filename);
 
     /* Check NVM file signature. */
     std::cout << "NVM: Loading file..." << std::endl;
-    std::string signature;
-    in >> signature;
+    std::string signature = in.read_token();
     if (signature != "NVM_V3")
         throw util::Exception("Invalid NVM signature");
 
     /* Discard the rest of the line (e.g. fixed camera parameter info). */
-    {
-        std::string temp;
-        std::getline(in, temp);
-    }
+    in.read_line();
 
     // TODO: Handle multiple models.
 
     /* Read number of views. */
-    int num_views = 0;
-    in >> num_views;
+    int num_views = in.read_int();
     if (num_views < 0 || num_views > 10000)
         throw util::Exception("Invalid number of views: ",
             util::string::get(num_views));
@@ -109,23 +438,23 @@ load_nvm_bundle (std::string const& filename,
         CameraInfo bundle_cam;
 
         /* Filename and focal length. */
-        in >> nvm_cam.filename;
-        in >> bundle_cam.flen;
+        nvm_cam.filename = in.read_token();
+        bundle_cam.flen = in.read_float();
 
         /* Camera rotation and center. */
         double quat[4];
         for (int j = 0; j < 4; ++j)
-            in >> quat[j];
+            quat[j] = in.read_double();
         math::Matrix3f rot = get_rot_from_quaternion(quat);
         math::Vec3f center, trans;
         for (int j = 0; j < 3; ++j)
-            in >> center[j];
+            center[j] = in.read_float();
         trans = rot * -center;
         std::copy(rot.begin(), rot.end(), bundle_cam.rot);
         std::copy(trans.begin(), trans.end(), bundle_cam.trans);
 
         /* Radial distortion. */
-        in >> nvm_cam.radial_distortion;
+        nvm_cam.radial_distortion = in.read_float();
         bundle_cam.dist[0] = nvm_cam.radial_distortion;
         bundle_cam.dist[1] = 0.0f;
 
@@ -134,10 +463,9 @@ load_nvm_bundle (std::string const& filename,
             nvm_cam.filename = util::fs::join_path(nvm_path, nvm_cam.filename);
 
         /* Jettison trailing zero. */
-        int temp;
-        in >> temp;
+        in.read_int();
 
-        if (in.eof())
+        if (!in.good())
             throw util::Exception("Unexpected EOF in NVM file");
 
         bundle_cams.push_back(bundle_cam);
@@ -145,32 +473,32 @@ load_nvm_bundle (std::string const& filename,
     }
 
     /* Read number of features. */
-    int num_features = 0;
-    in >> num_features;
+    int num_features = in.read_int();
     if (num_features < 0 || num_features > 1000000000)
         throw util::Exception("Invalid number of features: ",
             util::string::get(num_features));
 
-    Bundle::Features& features = bundle->get_features();
-    features.reserve(num_features);
+    bundle->reserve_features(num_features, 0);
 
     /* Read points. */
     std::cout << "NVM: Number of features: " << num_features << std::endl;
     std::size_t num_strange_points = 0;
+    std::vector<Bundle::Feature2D> refs;
     for (int i = 0; i < num_features; ++i)
     {
-        Bundle::Feature3D feature;
+        if (i == BUNDLE_REFS_ESTIMATE_FEATURES)
+            reserve_feature_refs(bundle.get(), num_features);
+
+        math::Vec3f pos, color;
         for (int j = 0; j < 3; ++j)
-            in >> feature.pos[j];
+            pos[j] = in.read_float();
         for (int j = 0; j < 3; ++j)
-        {
-            in >> feature.color[j];
-            feature.color[j] /= 255.0f;
-        }
+            color[j] = in.read_float() / 255.0f;
 
         /* Read number of refs. */
-        int num_refs = 0;
-        in >> num_refs;
+        int num_refs = in.read_int();
+        if (!in.good())
+            throw util::Exception("Unexpected EOF in NVM file");
 
         /* Detect strange points not seen by cameras. Why does this happen? */
         if (num_refs == 0)
@@ -185,16 +513,20 @@ load_nvm_bundle (std::string const& filename,
                 util::string::get(num_refs));
 
         /* Read refs. */
-        feature.refs.reserve(num_refs);
+        refs.resize(num_refs);
         for (int j = 0; j < num_refs; ++j)
         {
-            Bundle::Feature2D ref;
-            in >> ref.view_id >> ref.feature_id >> ref.pos[0] >> ref.pos[1];
-            feature.refs.push_back(ref);
+            Bundle::Feature2D& ref = refs[j];
+            ref.view_id = in.read_int();
+            ref.feature_id = in.read_int();
+            ref.pos[0] = in.read_float();
+            ref.pos[1] = in.read_float();
         }
-        features.push_back(feature);
+        bundle->add_feature(pos, color, refs.data(), refs.size());
     }
-    in.close();
+
+    if (!in.good())
+        throw util::Exception("Unexpected EOF in NVM file");
 
     /* Warn about strange points. */
     if (num_strange_points > 0)
@@ -269,13 +601,10 @@ namespace
 Bundle::Ptr
 load_bundler_ps_intern (std::string const& filename, BundleFormat format)
 {
-    std::ifstream in(filename.c_str());
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    BundleTextReader in(filename);
 
     /* Read version information in the first line. */
-    std::string version_string;
-    std::getline(in, version_string);
+    std::string version_string = in.read_line();
     util::string::clip_newlines(&version_string);
     util::string::clip_whitespaces(&version_string);
 
@@ -299,11 +628,10 @@ load_bundler_ps_intern (std::string const& filename, BundleFormat format)
         throw util::Exception("Invalid file signature: ", version_string);
 
     /* Read number of cameras and number of points. */
-    int num_views = 0;
-    int num_features = 0;
-    in >> num_views >> num_features;
+    int num_views = in.read_int();
+    int num_features = in.read_int();
 
-    if (in.eof())
+    if (!in.good())
         throw util::Exception("Unexpected EOF in bundle file");
 
     if (num_views < 0 || num_views > 10000
@@ -324,45 +652,39 @@ load_bundler_ps_intern (std::string const& filename, BundleFormat format)
     {
         cameras.push_back(CameraInfo());
         CameraInfo& cam = cameras.back();
-        in >> cam.flen >> cam.dist[0] >> cam.dist[1];
+        cam.flen = in.read_float();
+        cam.dist[0] = in.read_float();
+        cam.dist[1] = in.read_float();
         for (int j = 0; j < 9; ++j)
-            in >> cam.rot[j];
+            cam.rot[j] = in.read_float();
         for (int j = 0; j < 3; ++j)
-            in >> cam.trans[j];
+            cam.trans[j] = in.read_float();
     }
 
-    if (in.eof())
-        throw util::Exception("Unexpected EOF in bundle file");
-    if (in.fail())
+    if (!in.good())
         throw util::Exception("Bundle file read error");
 
     /* Read all features. */
-    Bundle::Features& features = bundle->get_features();
-    features.reserve(num_features);
+    bundle->reserve_features(num_features, 0);
+    std::vector<Bundle::Feature2D> refs;
     for (int i = 0; i < num_features; ++i)
     {
-        /* Insert the new (uninitialized) point. */
-        features.push_back(Bundle::Feature3D());
-        Bundle::Feature3D& feature = features.back();
+        if (i == BUNDLE_REFS_ESTIMATE_FEATURES)
+            reserve_feature_refs(bundle.get(), num_features);
 
         /* Read point position and color. */
+        math::Vec3f pos, color;
         for (int j = 0; j < 3; ++j)
-            in >> feature.pos[j];
+            pos[j] = in.read_float();
         for (int j = 0; j < 3; ++j)
-        {
-            in >> feature.color[j];
-            feature.color[j] /= 255.0f;
-        }
+            color[j] = in.read_float() / 255.0f;
 
         /* Read feature references. */
-        int ref_amount = 0;
-        in >> ref_amount;
-        if (ref_amount < 0 || ref_amount > num_views)
-        {
-            in.close();
+        int ref_amount = in.read_int();
+        if (in.good() && (ref_amount < 0 || ref_amount > num_views))
             throw util::Exception("Invalid feature reference amount");
-        }
 
+        refs.resize(ref_amount);
         for (int j = 0; j < ref_amount; ++j)
         {
             /*
@@ -370,33 +692,31 @@ load_bundler_ps_intern (std::string const& filename, BundleFormat format)
              * Bundler: The third and forth parameter are the floating point
              * x- and y-coordinate in an image-centered coordinate system.
              */
-            Bundle::Feature2D ref;
-            float dummy_float;
+            Bundle::Feature2D& ref = refs[j];
+            ref.view_id = in.read_int();
+            ref.feature_id = in.read_int();
             if (format == BUNDLE_FORMAT_PHOTOSYNTHER)
             {
-                in >> ref.view_id >> ref.feature_id;
-                in >> dummy_float; // Drop reprojection quality.
+                in.read_float(); // Drop reprojection quality.
                 std::fill(ref.pos, ref.pos + 2, -1.0f);
             }
             else if (format == BUNDLE_FORMAT_NOAHBUNDLER)
             {
-                in >> ref.view_id >> ref.feature_id;
-                in >> ref.pos[0] >> ref.pos[1];
+                ref.pos[0] = in.read_float();
+                ref.pos[1] = in.read_float();
             }
-            feature.refs.push_back(ref);
         }
 
         /* Check for premature EOF. */
-        if (in.eof())
+        if (!in.good())
         {
             std::cerr << "Warning: Unexpected EOF (at feature "
                 << i << ")" << std::endl;
-            features.pop_back();
             break;
         }
+        bundle->add_feature(pos, color, refs.data(), refs.size());
     }
 
-    in.close();
     return bundle;
 }
 
@@ -419,18 +739,20 @@ load_photosynther_bundle (std::string const& filename)
 void
 save_photosynther_bundle (Bundle::ConstPtr bundle, std::string const& filename)
 {
-    Bundle::Features const& features = bundle->get_features();
+    Bundle::FeaturePositions const& positions
+        = bundle->get_feature_positions();
+    Bundle::FeatureColors const& colors = bundle->get_feature_colors();
     Bundle::Cameras const& cameras = bundle->get_cameras();
 
     std::cout << "Writing bundle (" << cameras.size() << " cameras, "
-        << features.size() << " features): " << filename << "...\n";
+        << positions.size() << " features): " << filename << "...\n";
 
     std::ofstream out(filename.c_str(), std::ios::binary);
     if (!out.good())
         throw util::FileException(filename, std::strerror(errno));
 
     out << "drews 1.0\n";
-    out << cameras.size() << " " << features.size() << "\n";
+    out << cameras.size() << " " << positions.size() << "\n";
 
     /* Write all cameras to bundle file. */
     for (std::size_t i = 0; i < cameras.size(); ++i)
@@ -461,17 +783,20 @@ save_photosynther_bundle (Bundle::ConstPtr bundle, std::string const& filename)
     }
 
     /* Write all features to bundle file. */
-    for (std::size_t i = 0; i < features.size(); ++i)
+    for (std::size_t i = 0; i < positions.size(); ++i)
     {
-        Bundle::Feature3D const& p = features[i];
-        out << p.pos[0] << " " << p.pos[1] << " " << p.pos[2] << "\n";
-        out << static_cast<int>(p.color[0] * 255.0f + 0.5f) << " "
-            << static_cast<int>(p.color[1] * 255.0f + 0.5f) << " "
-            << static_cast<int>(p.color[2] * 255.0f + 0.5f) << "\n";
-        out << p.refs.size();
-        for (std::size_t j = 0; j < p.refs.size(); ++j)
+        math::Vec3f const& pos = positions[i];
+        math::Vec3f const& color = colors[i];
+        out << pos[0] << " " << pos[1] << " " << pos[2] << "\n";
+        out << static_cast<int>(color[0] * 255.0f + 0.5f) << " "
+            << static_cast<int>(color[1] * 255.0f + 0.5f) << " "
+            << static_cast<int>(color[2] * 255.0f + 0.5f) << "\n";
+        Bundle::Feature2D const* refs = bundle->get_feature_refs(i);
+        std::size_t const num_refs = bundle->get_num_feature_refs(i);
+        out << num_refs;
+        for (std::size_t j = 0; j < num_refs; ++j)
         {
-            Bundle::Feature2D const& ref = p.refs[j];
+            Bundle::Feature2D const& ref = refs[j];
             out << " " << ref.view_id << " " << ref.feature_id << " 0";
         }
         out << "\n";
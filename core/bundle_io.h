@@ -19,7 +19,10 @@ CORE_NAMESPACE_BEGIN
 
 /* ------------------- MVE native bundle format ------------------- */
 
-/** TODO: For now refers to load_photosynther_bundle(). */
+/**
+ * Loads a binary bundle file if the file has the binary bundle signature,
+ * and a Photosynther bundle file otherwise.
+ */
 Bundle::Ptr
 load_mve_bundle (std::string const& filename);
 
@@ -27,6 +30,39 @@ load_mve_bundle (std::string const& filename);
 void
 save_mve_bundle (Bundle::ConstPtr bundle, std::string const& filename);
 
+/* --------------------- Binary bundle format --------------------- */
+
+/*
+ * The binary bundle format stores the cameras and the feature arrays of
+ * the bundle, which are read with a few large reads instead of parsing
+ * text. All arrays are aligned for their value type if the file is mapped,
+ * the references of feature i are refs[offsets[i]] to refs[offsets[i + 1]].
+ *
+ * File layout, all values in native byte order:
+ *
+ *   "\211MVE_BUNDLE\n"    The signature
+ *   uint32                The number of cameras
+ *   uint64 (2x)           The number of features and feature references
+ *   float[18] (cameras)   The focal length, principal point, pixel aspect,
+ *                         distortion, translation and rotation
+ *   uint64 (features + 1) The reference offsets
+ *   float[3] (features)   The feature positions
+ *   float[3] (features)   The feature colors in [0, 1]
+ *   Feature2D (refs)      View ID, feature ID (int32) and position (float)
+ */
+
+/** Returns true if the file exists and has the binary bundle signature. */
+bool
+is_binary_bundle_file (std::string const& filename);
+
+/** Loads a binary bundle file. Throws on error. */
+Bundle::Ptr
+load_binary_bundle (std::string const& filename);
+
+/** Writes a binary bundle file. Throws on error. */
+void
+save_binary_bundle (Bundle::ConstPtr bundle, std::string const& filename);
+
 /* -------------- Support for NVM files (VisualSFM) --------------- */
 
 /**
@@ -11,6 +11,7 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <cstdint>
 
 #include "math/matrix_tools.h"
 #include "core/camera.h"
@@ -145,6 +146,41 @@ CameraInfo::fill_calibration (float* mat, float width, float height) const
 
 /* ---------------------------------------------------------------- */
 
+void
+CameraInfo::project_points (float const* x, float const* y, float const* z,
+    std::size_t num_points, float width, float height,
+    float* u, float* v, float* depth) const
+{
+    float k[9];
+    this->fill_calibration(k, width, height);
+    float const* r = this->rot;
+    float const* t = this->trans;
+    float const k0 = this->dist[0];
+    float const k1 = this->dist[1];
+
+    /* Consecutive points are computed in SIMD lanes. */
+    std::int64_t const num = static_cast<std::int64_t>(num_points);
+#pragma omp simd
+    for (std::int64_t i = 0; i < num; ++i)
+    {
+        float const cx = r[0] * x[i] + r[1] * y[i] + r[2] * z[i] + t[0];
+        float const cy = r[3] * x[i] + r[4] * y[i] + r[5] * z[i] + t[1];
+        float const cz = r[6] * x[i] + r[7] * y[i] + r[8] * z[i] + t[2];
+        float ix = cx / cz;
+        float iy = cy / cz;
+        float const radius2 = ix * ix + iy * iy;
+        float const factor = 1.0f + radius2 * (k0 + k1 * radius2);
+        ix *= factor;
+        iy *= factor;
+        u[i] = k[0] * ix + k[2];
+        v[i] = k[4] * iy + k[5];
+        if (depth != nullptr)
+            depth[i] = cz;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 CameraInfo::fill_gl_projection (float* mat, float width, float height,
     float znear, float zfar) const
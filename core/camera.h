@@ -10,6 +10,7 @@
 #ifndef MVE_CAMERA_HEADER
 #define MVE_CAMERA_HEADER
 
+#include <cstddef>
 #include <string>
 
 #include "core/defines.h"
@@ -121,6 +122,20 @@ public:
         float src_width, float src_height, float dst_width, float dst_height,
         float* mat, float* vec) const;
 
+    /**
+     * Projects the world points with coordinates in the arrays x, y and z
+     * (structure of arrays) to the image coordinates u and v of the image
+     * with dimensions 'width' and 'height', see fill_calibration(). The
+     * radial distortion factor 1 + dist[0] r^2 + dist[1] r^4 is applied to
+     * the camera coordinates after the perspective divide. If depth is not
+     * null, the depths along the z-axis in the camera frame are stored,
+     * which are not positive for points behind the camera. All arrays have
+     * num_points elements and are preallocated by the caller.
+     */
+    void project_points (float const* x, float const* y, float const* z,
+        std::size_t num_points, float width, float height,
+        float* u, float* v, float* depth = nullptr) const;
+
     /** Retuns the rotation in string format. */
     std::string get_rotation_string (void) const;
 
@@ -8,104 +8,150 @@
  */
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
-#include <list>
-#include <set>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
 #include "math/defines.h"
+#include "math/functions.h"
 #include "math/matrix.h"
-#include "mve/mesh_info.h"
-#include "mve/depthmap.h"
-#include "mve/mesh_tools.h"
+#include "core/mesh_adjacency.h"
+#include "core/mesh_info.h"
+#include "core/depthmap.h"
+#include "core/mesh_tools.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_IMAGE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
 
-void
-depthmap_cleanup_grow (FloatImage::ConstPtr dm, FloatImage::Ptr ret,
-    std::vector<bool>& visited,
-    std::size_t x, std::size_t y, std::size_t thres)
+namespace
 {
-    typedef std::list<std::size_t> PixelQueue;
-    typedef std::set<std::size_t> PixelBag;
-
-    std::size_t w = dm->width();
-    std::size_t h = dm->height();
-    std::size_t idx = y * w + x;
-    std::size_t max_idx = w * h;
-    std::size_t const MAX_ST = (std::size_t)-1;
-
-    PixelQueue queue;
-    PixelBag collected;
+    typedef uint32_t DepthLabel;
+    DepthLabel const DM_NO_LABEL = static_cast<DepthLabel>(-1);
 
-    queue.push_front(idx);
-    collected.insert(idx);
+    /* Minimum amount of rows of the bands labeled in parallel. */
+    int const DM_CLEANUP_MIN_BAND_ROWS = 64;
 
-    /* Process queue of pixel until either thres is reached or no more
-     * pixels are available for growing. If thres is reached, mark as
-     * visited and leave pixels. If no more pixels are available, an
-     * isolated small island has been found and pixels are set to zero.
+    /*
+     * Finds the root of a pixel with path halving. Parents always have
+     * a smaller index than their children, so roots are the smallest
+     * pixel index of their component.
      */
-    while (!queue.empty())
+    inline DepthLabel
+    dm_label_find (std::vector<DepthLabel>& labels, DepthLabel i)
     {
-        /* Take queue element and process... */
-        std::size_t cur = queue.back();
-        queue.pop_back();
-
-        /* Define 4-neighborhood for region growing. Y-1, Y+1, X-1, X+1. */
-        std::size_t n[4];
-        n[0] = (cur < w ? MAX_ST : cur - w);
-        n[1] = (cur < max_idx - w ? cur + w : MAX_ST);
-        n[2] = (cur % w > 0 ? cur - 1 : MAX_ST);
-        n[3] = (cur % w < w - 1 ? cur + 1 : MAX_ST);
-
-        /* Invalidate unreconstructed neighbors. */
-        for (int i = 0; i < 4; ++i)
-            if (n[i] != MAX_ST && dm->at(n[i], 0) == 0.0f)
-                n[i] = MAX_ST;
-
-        /* Add uncollected pixels to queue. */
-        for (int i = 0; i < 4; ++i)
-            if (n[i] != MAX_ST && collected.find(n[i]) == collected.end())
-            {
-                queue.push_front(n[i]);
-                collected.insert(n[i]);
-            }
+        while (labels[i] != i)
+        {
+            labels[i] = labels[labels[i]];
+            i = labels[i];
+        }
+        return i;
     }
 
-    /* Mark collected region as visited and set depth values to zero
-     * if amount of collected pixels is less than threshold.
-     */
-    for (PixelBag::iterator i = collected.begin(); i != collected.end(); i++)
+    /* Joins the components of two pixels by linking the larger root. */
+    inline void
+    dm_label_union (std::vector<DepthLabel>& labels, DepthLabel a,
+        DepthLabel b)
     {
-        visited[*i] = true;
-        if (collected.size() < thres)
-            ret->at(*i, 0) = 0.0f;
+        a = dm_label_find(labels, a);
+        b = dm_label_find(labels, b);
+        if (a < b)
+            labels[b] = a;
+        else if (b < a)
+            labels[a] = b;
     }
-}
 
-/* ---------------------------------------------------------------- */
+    /* Labels the 4-connected valid pixels in the rows [y0, y1). */
+    void
+    dm_label_rows (FloatImage const& dm, std::vector<DepthLabel>& labels,
+        int y0, int y1)
+    {
+        int const width = dm.width();
+        for (int y = y0; y < y1; ++y)
+            for (int x = 0; x < width; ++x)
+            {
+                DepthLabel const i = y * width + x;
+                if (dm.at(i, 0) == 0.0f)
+                {
+                    labels[i] = DM_NO_LABEL;
+                    continue;
+                }
+                labels[i] = i;
+                if (x > 0 && labels[i - 1] != DM_NO_LABEL)
+                    dm_label_union(labels, i, i - 1);
+                if (y > y0 && labels[i - width] != DM_NO_LABEL)
+                    dm_label_union(labels, i, i - width);
+            }
+    }
+}  /* namespace */
 
 FloatImage::Ptr
 depthmap_cleanup (FloatImage::ConstPtr dm, std::size_t thres)
 {
-    FloatImage::Ptr ret(FloatImage::create(*dm));
+    if (dm == nullptr)
+        throw std::invalid_argument("Null depth map given");
 
-    int const width = ret->width();
-    int const height = ret->height();
-    std::vector<bool> visited;
-    visited.resize(width * height, false);
+    int const width = dm->width();
+    int const height = dm->height();
+    std::size_t const num_pixels = dm->get_pixel_amount();
+    if (num_pixels >= static_cast<std::size_t>(DM_NO_LABEL))
+        throw std::invalid_argument("Depth map too large");
+
+    /*
+     * Label the components with union-find. The image is split into row
+     * bands that are labeled in parallel, then the components are merged
+     * across the band boundaries.
+     */
+    int num_bands = 1;
+#ifdef _OPENMP
+    num_bands = omp_get_max_threads();
+#endif
+    num_bands = std::max(1, std::min(num_bands,
+        height / DM_CLEANUP_MIN_BAND_ROWS));
+
+    std::vector<DepthLabel> labels(num_pixels);
+#pragma omp parallel for schedule(static, 1)
+    for (int band = 0; band < num_bands; ++band)
+        dm_label_rows(*dm, labels, height * band / num_bands,
+            height * (band + 1) / num_bands);
+
+    for (int band = 1; band < num_bands; ++band)
+    {
+        DepthLabel const row = height * band / num_bands * width;
+        for (int x = 0; x < width; ++x)
+            if (labels[row + x] != DM_NO_LABEL
+                && labels[row + x - width] != DM_NO_LABEL)
+                dm_label_union(labels, row + x, row + x - width);
+    }
 
-    int i = 0;
-    for (int y = 0; y < height; ++y)
-        for (int x = 0; x < width; ++x, ++i)
-        {
-            if (dm->at(i, 0) == 0.0f)
-                continue;
-            if (visited[i])
-                continue;
-            depthmap_cleanup_grow(dm, ret, visited, x, y, thres);
-        }
+    /*
+     * Relabel in scanline order. Parents precede their children, so each
+     * pixel either is a root and gets a new label, or takes the new label
+     * from its already relabeled parent.
+     */
+    DepthLabel num_labels = 0;
+    for (std::size_t i = 0; i < num_pixels; ++i)
+    {
+        if (labels[i] == DM_NO_LABEL)
+            continue;
+        labels[i] = (labels[i] == i) ? num_labels++ : labels[labels[i]];
+    }
+
+    /* Count the component sizes and remove the small components. */
+    std::vector<std::size_t> sizes(num_labels, 0);
+    for (std::size_t i = 0; i < num_pixels; ++i)
+        if (labels[i] != DM_NO_LABEL)
+            sizes[labels[i]] += 1;
+
+    FloatImage::Ptr ret(FloatImage::create(*dm));
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(num_pixels); ++i)
+        if (labels[i] != DM_NO_LABEL && sizes[labels[i]] < thres)
+            ret->at(i) = 0.0f;
 
     return ret;
 }
@@ -127,13 +173,117 @@ depthmap_confidence_clean (FloatImage::Ptr dm, FloatImage::ConstPtr cm)
             dm->at(i, 0) = 0.0f;
 }
 
-MVE_IMAGE_NAMESPACE_END
-MVE_NAMESPACE_END
+/* ---------------------------------------------------------------- */
+
+namespace
+{
+    /*
+     * Approximates exp(x) for x <= 0 with a relative error of about 1e-7.
+     * The argument is split into an integer and a fractional power of two,
+     * the latter is evaluated with a polynomial. This is branch-free and
+     * vectorizes, unlike std::exp.
+     */
+    inline float
+    dm_fast_exp (float x)
+    {
+        float const t = std::max(x, -87.0f) * 1.442695041f;
+        int const n = static_cast<int>(t - 0.5f);
+        float const f = t - static_cast<float>(n);
+        float p = 1.535336188e-4f;
+        p = p * f + 1.339887440e-3f;
+        p = p * f + 9.618437357e-3f;
+        p = p * f + 5.550332471e-2f;
+        p = p * f + 2.402264791e-1f;
+        p = p * f + 6.931472028e-1f;
+        p = p * f + 1.0f;
+        int32_t const bits = (n + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(float));
+        return p * scale;
+    }
+}  /* namespace */
+
+FloatImage::Ptr
+depthmap_bilateral_filter (FloatImage::ConstPtr dm,
+    math::Matrix3f const& invproj, float gc_sigma, float pc_factor)
+{
+    if (dm == nullptr)
+        throw std::invalid_argument("Null depth map given");
+    if (gc_sigma <= 0.0f || pc_factor <= 0.0f)
+        throw std::invalid_argument("Invalid filter parameters");
+
+    int const width = dm->width();
+    int const height = dm->height();
+
+    /* Cut the kernel off at 1/64 of the maximum. */
+    int const ks = std::ceil(gc_sigma * 2.884f);
+    int const kw = 2 * ks + 1;
+
+    /* Precompute the spatial weights for the kernel. */
+    std::vector<float> spatial(kw * kw);
+    for (int ky = -ks; ky <= ks; ++ky)
+        for (int kx = -ks; kx <= ks; ++kx)
+            spatial[(ky + ks) * kw + kx + ks] = math::gaussian_xx(
+                static_cast<float>(kx * kx + ky * ky), gc_sigma);
+
+    FloatImage::Ptr ret(FloatImage::create(width, height, 1));
+    float const* data = dm->get_data_pointer();
+
+#pragma omp parallel for schedule(dynamic, 8)
+    for (int y = 0; y < height; ++y)
+    {
+        int const ky_min = std::max(-ks, -y);
+        int const ky_max = std::min(ks, height - 1 - y);
+        for (int x = 0; x < width; ++x)
+        {
+            std::size_t const i = static_cast<std::size_t>(y) * width + x;
+            float const depth = data[i];
+            if (depth == 0.0f)
+            {
+                ret->at(i) = 0.0f;
+                continue;
+            }
+
+            /* The range sigma is the scaled footprint of the pixel. */
+            float const pc_sigma = pc_factor
+                * core::geom::pixel_footprint(x, y, depth, invproj);
+            float const pc_scale = 1.0f / (2.0f * pc_sigma * pc_sigma);
+
+            int const kx_min = std::max(-ks, -x);
+            int const kx_max = std::min(ks, width - 1 - x);
+            float weight = 0.0f;
+            float depth_sum = 0.0f;
+            for (int ky = ky_min; ky <= ky_max; ++ky)
+            {
+                float const* row = data + i + ky * width;
+                float const* sw = &spatial[(ky + ks) * kw + ks];
+#pragma omp simd reduction(+:weight,depth_sum)
+                for (int kx = kx_min; kx <= kx_max; ++kx)
+                {
+                    /* Unreconstructed pixels do not contribute. */
+                    float const cd = row[kx];
+                    float const diff = depth - cd;
+                    float const w = cd == 0.0f ? 0.0f
+                        : sw[kx] * dm_fast_exp(-diff * diff * pc_scale);
+                    weight += w;
+                    depth_sum += w * cd;
+                }
+            }
+
+            ret->at(i) = depth_sum / weight;
+        }
+    }
+
+    return ret;
+}
+
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
 
 /* ---------------------------------------------------------------- */
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 float
 pixel_footprint (std::size_t x, std::size_t y, float depth,
@@ -157,34 +307,6 @@ pixel_3dpos (std::size_t x, std::size_t y, float depth,
 
 /* ---------------------------------------------------------------- */
 
-void
-dm_make_triangle (TriangleMesh* mesh, mve::Image<unsigned int>& vidx,
-    FloatImage const* dm, math::Matrix3f const& invproj,
-    std::size_t i, int* tverts)
-{
-    int const width = vidx.width();
-    //int const height = vidx.height();
-    mve::TriangleMesh::VertexList& verts(mesh->get_vertices());
-    mve::TriangleMesh::FaceList& faces(mesh->get_faces());
-
-    for (int j = 0; j < 3; ++j)
-    {
-        int iidx = i + (tverts[j] % 2) + width * (tverts[j] / 2);
-        int x = iidx % width;
-        int y = iidx / width;
-        if (vidx.at(iidx) == MATH_MAX_UINT)
-        {
-            /* Add vertex for depth pixel. */
-            vidx.at(iidx) = verts.size();
-            float depth = dm->at(iidx, 0);
-            verts.push_back(pixel_3dpos(x, y, depth, invproj));
-        }
-        faces.push_back(vidx.at(iidx));
-    }
-}
-
-/* ---------------------------------------------------------------- */
-
 bool
 dm_is_depthdisc (float* widths, float* depths, float dd_factor, int i1, int i2)
 {
@@ -207,105 +329,223 @@ dm_is_depthdisc (float* widths, float* depths, float dd_factor, int i1, int i2)
 
 /* ---------------------------------------------------------------- */
 
-TriangleMesh::Ptr
-depthmap_triangulate (FloatImage::ConstPtr dm, math::Matrix3f const& invproj,
-    float dd_factor, mve::Image<unsigned int>* vids)
+namespace
 {
-    if (dm == nullptr)
-        throw std::invalid_argument("Null depthmap given");
-
-    int const width = dm->width();
-    int const height = dm->height();
+    /* Possible triangles, vertex indices relative to 2x2 block. */
+    int dm_block_tris[4][3] = {
+        { 0, 2, 1 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 2, 3 }
+    };
+
+    /* The 2x2 block corners used by each of the possible triangles. */
+    int const dm_block_tri_corners[4] = { 0x7, 0xb, 0xd, 0xe };
+
+    /*
+     * Decides which triangles to issue for the 2x2 block with upper left
+     * pixel (x,y). The two triangles are returned as 1-based indices into
+     * 'dm_block_tris' in the lower and upper four bits, zero means none.
+     */
+    unsigned char
+    dm_block_triangles (FloatImage const& dm, math::Matrix3f const& invproj,
+        float dd_factor, int x, int y)
+    {
+        int const width = dm.width();
+        int const i = y * width + x;
+
+        /* Cache the four depth values. */
+        float depths[4] = { dm.at(i, 0), dm.at(i + 1, 0),
+            dm.at(i + width, 0), dm.at(i + width + 1, 0) };
+
+        /* Create a mask representation of the available depth values. */
+        int mask = 0;
+        int pixels = 0;
+        for (int j = 0; j < 4; ++j)
+            if (depths[j] > 0.0f)
+            {
+                mask |= 1 << j;
+                pixels += 1;
+            }
 
-    /* Prepare triangle mesh. */
-    TriangleMesh::Ptr mesh(TriangleMesh::create());
+        /* At least three valid depth values are required. */
+        if (pixels < 3)
+            return 0;
 
-    /* Generate image that maps image pixels to vertex IDs. */
-    mve::Image<unsigned int> vidx(width, height, 1);
-    vidx.fill(MATH_MAX_UINT);
+        /* Decide which triangles to issue. */
+        int tri[2] = { 0, 0 };
 
-    /* Iterate over 2x2-blocks in the depthmap and create triangles. */
-    int i = 0;
-    for (int y = 0; y < height - 1; ++y, ++i)
-    {
-        for (int x = 0; x < width - 1; ++x, ++i)
+        switch (mask)
         {
-            /* Cache the four depth values. */
-            float depths[4] = { dm->at(i, 0), dm->at(i + 1, 0),
-                dm->at(i + width, 0), dm->at(i + width + 1, 0) };
+            case 7: tri[0] = 1; break;
+            case 11: tri[0] = 2; break;
+            case 13: tri[0] = 3; break;
+            case 14: tri[0] = 4; break;
+            case 15:
+            {
+                /* Choose the triangulation with smaller diagonal. */
+                float ddiff1 = std::abs(depths[0] - depths[3]);
+                float ddiff2 = std::abs(depths[1] - depths[2]);
+                if (ddiff1 < ddiff2)
+                { tri[0] = 2; tri[1] = 3; }
+                else
+                { tri[0] = 1; tri[1] = 4; }
+                break;
+            }
+            default: return 0;
+        }
 
-            /* Create a mask representation of the available depth values. */
-            int mask = 0;
-            int pixels = 0;
+        /* Omit depth discontinuity detection if dd_factor is zero. */
+        if (dd_factor > 0.0f)
+        {
+            /* Cache pixel footprints. */
+            float widths[4];
             for (int j = 0; j < 4; ++j)
-                if (depths[j] > 0.0f)
-                {
-                    mask |= 1 << j;
-                    pixels += 1;
-                }
+            {
+                if (depths[j] == 0.0f)
+                    continue;
+                widths[j] = pixel_footprint(x + (j % 2), y + (j / 2),
+                    depths[j], invproj);
+            }
 
-            /* At least three valid depth values are required. */
-            if (pixels < 3)
-                continue;
+            /* Check for depth discontinuities. */
+            for (int j = 0; j < 2 && tri[j] != 0; ++j)
+            {
+                int* tv = dm_block_tris[tri[j] - 1];
+                #define DM_DD_ARGS widths, depths, dd_factor
+                if (dm_is_depthdisc(DM_DD_ARGS, tv[0], tv[1])) tri[j] = 0;
+                if (dm_is_depthdisc(DM_DD_ARGS, tv[1], tv[2])) tri[j] = 0;
+                if (dm_is_depthdisc(DM_DD_ARGS, tv[2], tv[0])) tri[j] = 0;
+            }
+        }
 
-            /* Possible triangles, vertex indices relative to 2x2 block. */
-            int tris[4][3] = {
-                { 0, 2, 1 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 2, 3 }
-            };
+        return static_cast<unsigned char>(tri[0] | (tri[1] << 4));
+    }
 
-            /* Decide which triangles to issue. */
-            int tri[2] = { 0, 0 };
+    /* Returns the block corners used by the triangles of a block. */
+    inline int
+    dm_block_corners (unsigned char tris)
+    {
+        int corners = 0;
+        if (tris & 0xf)
+            corners |= dm_block_tri_corners[(tris & 0xf) - 1];
+        if (tris >> 4)
+            corners |= dm_block_tri_corners[(tris >> 4) - 1];
+        return corners;
+    }
 
-            switch (mask)
-            {
-                case 7: tri[0] = 1; break;
-                case 11: tri[0] = 2; break;
-                case 13: tri[0] = 3; break;
-                case 14: tri[0] = 4; break;
-                case 15:
-                {
-                    /* Choose the triangulation with smaller diagonal. */
-                    float ddiff1 = std::abs(depths[0] - depths[3]);
-                    float ddiff2 = std::abs(depths[1] - depths[2]);
-                    if (ddiff1 < ddiff2)
-                    { tri[0] = 2; tri[1] = 3; }
-                    else
-                    { tri[0] = 1; tri[1] = 4; }
-                    break;
-                }
-                default: continue;
-            }
+    /* Returns the amount of triangles of a block. */
+    inline int
+    dm_block_num_triangles (unsigned char tris)
+    {
+        return ((tris & 0xf) != 0) + ((tris >> 4) != 0);
+    }
+}  /* namespace */
 
-            /* Omit depth discontinuity detection if dd_factor is zero. */
-            if (dd_factor > 0.0f)
-            {
-                /* Cache pixel footprints. */
-                float widths[4];
-                for (int j = 0; j < 4; ++j)
-                {
-                    if (depths[j] == 0.0f)
-                        continue;
-                    widths[j] = pixel_footprint(x + (j % 2), y + (j / 2),
-                        depths[j], invproj);// w, h, focal_len);
-                }
+/* ---------------------------------------------------------------- */
 
-                /* Check for depth discontinuities. */
-                for (int j = 0; j < 2 && tri[j] != 0; ++j)
-                {
-                    int* tv = tris[tri[j] - 1];
-                    #define DM_DD_ARGS widths, depths, dd_factor
-                    if (dm_is_depthdisc(DM_DD_ARGS, tv[0], tv[1])) tri[j] = 0;
-                    if (dm_is_depthdisc(DM_DD_ARGS, tv[1], tv[2])) tri[j] = 0;
-                    if (dm_is_depthdisc(DM_DD_ARGS, tv[2], tv[0])) tri[j] = 0;
-                }
+TriangleMesh::Ptr
+depthmap_triangulate (FloatImage::ConstPtr dm, math::Matrix3f const& invproj,
+    float dd_factor, core::Image<unsigned int>* vids)
+{
+    if (dm == nullptr)
+        throw std::invalid_argument("Null depthmap given");
+
+    std::int64_t const width = dm->width();
+    std::int64_t const height = dm->height();
+    std::int64_t const bwidth = std::max<std::int64_t>(0, width - 1);
+    std::int64_t const bheight = std::max<std::int64_t>(0, height - 1);
+
+    /*
+     * Decide the triangles of all 2x2-blocks and count the faces of each
+     * row of blocks. The rows are processed independently, and vertices
+     * and faces are written in a second pass using prefix sums.
+     */
+    std::vector<unsigned char> blocks(bwidth * bheight);
+    std::vector<std::size_t> face_offsets(bheight + 1, 0);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (std::int64_t y = 0; y < bheight; ++y)
+    {
+        std::size_t num_faces = 0;
+        for (std::int64_t x = 0; x < bwidth; ++x)
+        {
+            unsigned char const tris = dm_block_triangles(*dm, invproj,
+                dd_factor, x, y);
+            blocks[y * bwidth + x] = tris;
+            num_faces += dm_block_num_triangles(tris);
+        }
+        face_offsets[y + 1] = num_faces;
+    }
+    for (std::int64_t y = 0; y < bheight; ++y)
+        face_offsets[y + 1] += face_offsets[y];
+
+    /*
+     * Mark the pixels used by the adjacent blocks and count the vertices
+     * of each row. A pixel is corner 0, 1, 2 and 3 of the blocks below
+     * right, below left, above right and above left, respectively.
+     */
+    core::Image<unsigned int> vidx(width, height, 1);
+    std::vector<std::size_t> vertex_offsets(height + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t y = 0; y < height; ++y)
+    {
+        std::size_t num_vertices = 0;
+        for (std::int64_t x = 0; x < width; ++x)
+        {
+            int corners = 0;
+            for (int j = 0; j < 4; ++j)
+            {
+                std::int64_t const bx = x - (j % 2);
+                std::int64_t const by = y - (j / 2);
+                if (bx >= 0 && bx < bwidth && by >= 0 && by < bheight)
+                    corners |= dm_block_corners(blocks[by * bwidth + bx])
+                        & (1 << j);
             }
+            vidx.at(y * width + x) = corners ? 0 : MATH_MAX_UINT;
+            num_vertices += corners ? 1 : 0;
+        }
+        vertex_offsets[y + 1] = num_vertices;
+    }
+    for (std::int64_t y = 0; y < height; ++y)
+        vertex_offsets[y + 1] += vertex_offsets[y];
+
+    /* Prepare triangle mesh. */
+    TriangleMesh::Ptr mesh(TriangleMesh::create());
+    core::TriangleMesh::VertexList& verts(mesh->get_vertices());
+    core::TriangleMesh::FaceList& faces(mesh->get_faces());
+    verts.resize(vertex_offsets.back());
+    faces.resize(face_offsets.back() * 3);
+
+    /* Assign vertex IDs in row-major pixel order and emit the vertices. */
+#pragma omp parallel for schedule(static)
+    for (std::int64_t y = 0; y < height; ++y)
+    {
+        std::size_t vertex_id = vertex_offsets[y];
+        for (std::int64_t x = 0; x < width; ++x)
+        {
+            std::int64_t const i = y * width + x;
+            if (vidx.at(i) == MATH_MAX_UINT)
+                continue;
+            vidx.at(i) = vertex_id;
+            verts[vertex_id] = pixel_3dpos(x, y, dm->at(i, 0), invproj);
+            vertex_id += 1;
+        }
+    }
 
-            /* Build triangles. */
+    /* Emit the faces of each row of blocks. */
+#pragma omp parallel for schedule(static)
+    for (std::int64_t y = 0; y < bheight; ++y)
+    {
+        std::size_t face_pos = face_offsets[y] * 3;
+        for (std::int64_t x = 0; x < bwidth; ++x)
+        {
+            unsigned char const tris = blocks[y * bwidth + x];
+            int const tri[2] = { tris & 0xf, tris >> 4 };
             for (int j = 0; j < 2; ++j)
             {
-                if (tri[j] == 0) continue;
-                #define DM_MAKE_TRI_ARGS mesh.get(), vidx, dm.get(), invproj, i
-                dm_make_triangle(DM_MAKE_TRI_ARGS, tris[tri[j] - 1]);
+                if (tri[j] == 0)
+                    continue;
+                int const* tv = dm_block_tris[tri[j] - 1];
+                for (int k = 0; k < 3; ++k)
+                    faces[face_pos++] = vidx.at((y + tv[k] / 2) * width
+                        + x + tv[k] % 2);
             }
         }
     }
@@ -332,16 +572,16 @@ depthmap_triangulate (FloatImage::ConstPtr dm, ByteImage::ConstPtr ci,
         throw std::invalid_argument("Color image dimension mismatch");
 
     /* Triangulate depth map. */
-    mve::Image<unsigned int> vids;
-    mve::TriangleMesh::Ptr mesh;
-    mesh = mve::geom::depthmap_triangulate(dm, invproj, dd_factor, &vids);
+    core::Image<unsigned int> vids;
+    core::TriangleMesh::Ptr mesh;
+    mesh = core::geom::depthmap_triangulate(dm, invproj, dd_factor, &vids);
 
     if (ci == nullptr)
         return mesh;
 
     /* Use vertex index mapping to color the mesh. */
-    mve::TriangleMesh::ColorList& colors(mesh->get_vertex_colors());
-    mve::TriangleMesh::VertexList const& verts(mesh->get_vertices());
+    core::TriangleMesh::ColorList& colors(mesh->get_vertex_colors());
+    core::TriangleMesh::VertexList const& verts(mesh->get_vertices());
     colors.resize(verts.size());
 
     int num_pixel = vids.get_pixel_amount();
@@ -380,13 +620,13 @@ depthmap_triangulate (FloatImage::ConstPtr dm, ByteImage::ConstPtr ci,
     /* Triangulate depth map. */
     math::Matrix3f invproj;
     cam.fill_inverse_calibration(*invproj, dm->width(), dm->height());
-    mve::TriangleMesh::Ptr mesh;
-    mesh = mve::geom::depthmap_triangulate(dm, ci, invproj, dd_factor);
+    core::TriangleMesh::Ptr mesh;
+    mesh = core::geom::depthmap_triangulate(dm, ci, invproj, dd_factor);
 
     /* Transform mesh to world coordinates. */
     math::Matrix4f ctw;
     cam.fill_cam_to_world(*ctw);
-    mve::geom::mesh_transform(mesh, ctw);
+    core::geom::mesh_transform(mesh, ctw);
     mesh->recalc_normals(false, true); // Remove this?
 
     return mesh;
@@ -487,6 +727,192 @@ rangegrid_triangulate (Image<unsigned int> const& grid, TriangleMesh::Ptr mesh)
 
 /* ---------------------------------------------------------------- */
 
+namespace
+{
+    /* Appends a thread-local vertex list to the shared list. */
+    inline void
+    dm_append_vertices (std::vector<std::size_t> const& local,
+        std::vector<std::size_t>* result)
+    {
+#pragma omp critical
+        result->insert(result->end(), local.begin(), local.end());
+    }
+
+    /*
+     * Assigns confidences by expanding the region from the boundary
+     * vertices. Each iteration is a parallel sweep over the frontier,
+     * vertices are claimed atomically to add them to the next frontier.
+     */
+    void
+    dm_mesh_confidences (TriangleMesh* mesh, MeshAdjacency const& adjacency,
+        int iterations)
+    {
+        TriangleMesh::ConfidenceList& confs(mesh->get_vertex_confidences());
+        std::int64_t const num_vertices = mesh->get_vertices().size();
+        confs.clear();
+        confs.resize(num_vertices, 1.0f);
+
+        /* Find boundary vertices and remember them. */
+        std::vector<unsigned char> visited(num_vertices, 0);
+        std::vector<std::size_t> frontier;
+        for (std::int64_t i = 0; i < num_vertices; ++i)
+            if (adjacency.get_vertex_class(i)
+                == MeshInfo::VERTEX_CLASS_BORDER)
+            {
+                frontier.push_back(i);
+                visited[i] = 1;
+            }
+
+        /* Iteratively expand the current region and update confidences. */
+        for (int current = 0; current < iterations; ++current)
+        {
+            /* Assign confidence of that iteration to the frontier. */
+            float const conf = (float)current / (float)iterations;
+            std::int64_t const num_frontier = frontier.size();
+#pragma omp parallel for schedule(static)
+            for (std::int64_t i = 0; i < num_frontier; ++i)
+                confs[frontier[i]] = conf;
+
+            if (current + 1 == iterations)
+                break;
+
+            /* Replace frontier with unvisited adjacent vertices. */
+            std::vector<std::size_t> next;
+#pragma omp parallel
+            {
+                std::vector<std::size_t> local;
+#pragma omp for schedule(dynamic, 256) nowait
+                for (std::int64_t i = 0; i < num_frontier; ++i)
+                {
+                    MeshAdjacency::VertexID const* verts
+                        = adjacency.get_vertices(frontier[i]);
+                    std::size_t const num_verts
+                        = adjacency.get_num_vertices(frontier[i]);
+                    for (std::size_t j = 0; j < num_verts; ++j)
+                    {
+                        unsigned char was_visited;
+#pragma omp atomic capture
+                        { was_visited = visited[verts[j]];
+                            visited[verts[j]] = 1; }
+                        if (!was_visited)
+                            local.push_back(verts[j]);
+                    }
+                }
+                dm_append_vertices(local, &next);
+            }
+            std::swap(frontier, next);
+        }
+    }
+
+    /*
+     * Removes the faces adjacent to boundary vertices. The adjacency is
+     * not rebuilt between iterations: Only the vertices of the removed
+     * faces can become boundary vertices, so these are reclassified with
+     * their remaining faces in a parallel sweep over the frontier.
+     */
+    void
+    dm_mesh_peeling (TriangleMesh* mesh, MeshAdjacency const& adjacency,
+        int iterations)
+    {
+        TriangleMesh::FaceList& faces(mesh->get_faces());
+        std::int64_t const num_vertices = adjacency.size();
+
+        /* The iteration a face has been removed in, zero if not removed. */
+        std::vector<int> removed(faces.size() / 3, 0);
+        /* The last iteration a vertex has been reclassified in. */
+        std::vector<int> checked(num_vertices, 0);
+
+        std::vector<std::size_t> frontier;
+        for (std::int64_t i = 0; i < num_vertices; ++i)
+            if (adjacency.get_vertex_class(i)
+                == MeshInfo::VERTEX_CLASS_BORDER)
+                frontier.push_back(i);
+
+        for (int iter = 1; iter <= iterations; ++iter)
+        {
+            /* Remove all faces adjacent to the boundary vertices. */
+            std::int64_t const num_frontier = frontier.size();
+#pragma omp parallel for schedule(dynamic, 256)
+            for (std::int64_t i = 0; i < num_frontier; ++i)
+            {
+                MeshAdjacency::FaceID const* adj_faces
+                    = adjacency.get_faces(frontier[i]);
+                std::size_t const num_faces
+                    = adjacency.get_num_faces(frontier[i]);
+                for (std::size_t j = 0; j < num_faces; ++j)
+                {
+                    int face_iter;
+#pragma omp atomic read
+                    face_iter = removed[adj_faces[j]];
+                    if (face_iter == 0)
+                    {
+#pragma omp atomic write
+                        removed[adj_faces[j]] = iter;
+                    }
+                }
+            }
+
+            if (iter == iterations)
+                break;
+
+            /* Reclassify the vertices of the removed faces. */
+            std::vector<std::size_t> next;
+#pragma omp parallel
+            {
+                std::vector<std::size_t> local;
+                std::vector<MeshAdjacency::FaceID> remaining;
+#pragma omp for schedule(dynamic, 256) nowait
+                for (std::int64_t i = 0; i < num_frontier; ++i)
+                {
+                    MeshAdjacency::FaceID const* adj_faces
+                        = adjacency.get_faces(frontier[i]);
+                    std::size_t const num_faces
+                        = adjacency.get_num_faces(frontier[i]);
+                    for (std::size_t j = 0; j < num_faces; ++j)
+                    {
+                        if (removed[adj_faces[j]] != iter)
+                            continue;
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            std::size_t const vid = faces[adj_faces[j] * 3 + k];
+                            int last_checked;
+#pragma omp atomic capture
+                            { last_checked = checked[vid];
+                                checked[vid] = iter; }
+                            if (last_checked == iter)
+                                continue;
+
+                            MeshAdjacency::FaceID const* vfaces
+                                = adjacency.get_faces(vid);
+                            std::size_t const num_vfaces
+                                = adjacency.get_num_faces(vid);
+                            remaining.clear();
+                            for (std::size_t l = 0; l < num_vfaces; ++l)
+                                if (removed[vfaces[l]] == 0)
+                                    remaining.push_back(vfaces[l]);
+                            if (MeshAdjacency::classify_vertex(faces, vid,
+                                remaining) == MeshInfo::VERTEX_CLASS_BORDER)
+                                local.push_back(vid);
+                        }
+                    }
+                }
+                dm_append_vertices(local, &next);
+            }
+            std::swap(frontier, next);
+        }
+
+        /* Remove invalidated faces. */
+        std::vector<bool> delete_list(faces.size(), false);
+        for (std::size_t i = 0; i < removed.size(); ++i)
+            if (removed[i] != 0)
+                for (int j = 0; j < 3; ++j)
+                    delete_list[i * 3 + j] = true;
+        math::algo::vector_clean(delete_list, &faces);
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
 void
 depthmap_mesh_confidences (TriangleMesh::Ptr mesh, int iterations)
 {
@@ -499,43 +925,8 @@ depthmap_mesh_confidences (TriangleMesh::Ptr mesh, int iterations)
     if (iterations == 0)
         return;
 
-    TriangleMesh::ConfidenceList& confs(mesh->get_vertex_confidences());
-    TriangleMesh::VertexList const& verts(mesh->get_vertices());
-    confs.clear();
-    confs.resize(verts.size(), 1.0f);
-
-    /* Find boundary vertices and remember them. */
-    std::vector<std::size_t> vidx;
-    MeshInfo mesh_info(mesh);
-
-    for (std::size_t i = 0; i < mesh_info.size(); ++i)
-    {
-        if (mesh_info[i].vclass == MeshInfo::VERTEX_CLASS_BORDER)
-            vidx.push_back(i);
-    }
-
-    /* Iteratively expand the current region and update confidences. */
-    for (int current = 0; current < iterations; ++current)
-    {
-        /* Calculate confidence for that iteration. */
-        float conf = (float)current / (float)iterations;
-        //conf = math::algo::fastpow(conf, 3);
-
-        /* Assign current confidence to all vertices. */
-        for (std::size_t i = 0; i < vidx.size(); ++i)
-            confs[vidx[i]] = conf;
-
-        /* Replace vertex list with adjacent vertices. */
-        std::vector<std::size_t> cvidx;
-        std::swap(vidx, cvidx);
-        for (std::size_t i = 0; i < cvidx.size(); ++i)
-        {
-            MeshInfo::VertexInfo info = mesh_info[cvidx[i]];
-            for (std::size_t j = 0; j < info.verts.size(); ++j)
-                if (confs[info.verts[j]] == 1.0f)
-                    vidx.push_back(info.verts[j]);
-        }
-    }
+    MeshAdjacency adjacency(mesh);
+    dm_mesh_confidences(mesh.get(), adjacency, iterations);
 }
 
 /* ---------------------------------------------------------------- */
@@ -552,31 +943,31 @@ depthmap_mesh_peeling (TriangleMesh::Ptr mesh, int iterations)
     if (iterations == 0)
         return;
 
-    TriangleMesh::FaceList& faces(mesh->get_faces());
-    std::vector<bool> delete_list;
-    delete_list.resize(faces.size(), false);
+    MeshAdjacency adjacency(mesh);
+    dm_mesh_peeling(mesh.get(), adjacency, iterations);
+}
 
-    /* Iteratively invalidate triangles at the boundary. */
-    for (int iter = 0; iter < iterations; ++iter)
-    {
-        MeshInfo mesh_info(mesh);
-        for (std::size_t i = 0; i < mesh_info.size(); ++i)
-        {
-            MeshInfo::VertexInfo const& info(mesh_info[i]);
-            if (info.vclass == MeshInfo::VERTEX_CLASS_BORDER)
-                for (std::size_t j = 0; j < info.faces.size(); ++j)
-                    for (int k = 0; k < 3; ++k)
-                    {
-                        unsigned int fidx = info.faces[j] * 3 + k;
-                        faces[fidx] = 0;
-                        delete_list[fidx] = true;
-                    }
-        }
-    }
+/* ---------------------------------------------------------------- */
+
+void
+depthmap_mesh_confidences_and_peeling (TriangleMesh::Ptr mesh,
+    int conf_iterations, int peel_iterations)
+{
+    if (mesh == nullptr)
+        throw std::invalid_argument("Null mesh given");
+
+    if (conf_iterations < 0 || peel_iterations < 0)
+        throw std::invalid_argument("Invalid amount of iterations");
+
+    if (conf_iterations == 0 && peel_iterations == 0)
+        return;
 
-    /* Remove invalidated faces. */
-    math::algo::vector_clean(delete_list, &faces);
+    MeshAdjacency adjacency(mesh);
+    if (conf_iterations > 0)
+        dm_mesh_confidences(mesh.get(), adjacency, conf_iterations);
+    if (peel_iterations > 0)
+        dm_mesh_peeling(mesh.get(), adjacency, peel_iterations);
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
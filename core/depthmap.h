@@ -7,23 +7,24 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_DEPTHMAP_HEADER
-#define MVE_DEPTHMAP_HEADER
+#ifndef CORE_DEPTHMAP_HEADER
+#define CORE_DEPTHMAP_HEADER
 
 #include "math/vector.h"
 #include "math/matrix.h"
-#include "mve/defines.h"
-#include "mve/camera.h"
-#include "mve/image.h"
-#include "mve/mesh.h"
+#include "core/defines.h"
+#include "core/camera.h"
+#include "core/image.h"
+#include "core/mesh.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_IMAGE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
 
 /**
  * Algorithm to clean small confident islands in the depth maps.
  * Islands that are smaller than 'thres' pixels are removed.
- * Zero depth values are considered unreconstructed.
+ * Zero depth values are considered unreconstructed. Islands are
+ * 4-connected and found with union-find in row bands in parallel.
  */
 FloatImage::Ptr
 depthmap_cleanup (FloatImage::ConstPtr dm, std::size_t thres);
@@ -49,7 +50,7 @@ depthmap_confidence_clean (FloatImage::Ptr dm, FloatImage::ConstPtr cm);
  */
 FloatImage::Ptr
 depthmap_bilateral_filter (FloatImage::ConstPtr dm,
-    math::Matrix3f const& invproj, float gc_sigma, float pc_fator);
+    math::Matrix3f const& invproj, float gc_sigma, float pc_factor);
 
 /**
  * Converts between depth map conventions IN-PLACE. In one convention,
@@ -63,13 +64,13 @@ void
 depthmap_convert_conventions (typename Image<T>::Ptr dm,
     math::Matrix3f const& invproj, bool to_mve);
 
-MVE_IMAGE_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
 
 /* ---------------------------------------------------------------- */
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * Function that calculates the pixel footprint (pixel width)
@@ -99,11 +100,12 @@ pixel_3dpos (std::size_t x, std::size_t y, float depth,
  *
  * If 'vids' is not null, image content is replaced with vertex indices for
  * each pixel that generated the vertex. Index MATH_MAX_UINT corresponds to
- * a pixel that did not generate a vertex.
+ * a pixel that did not generate a vertex. Vertices are created in row-major
+ * pixel order, and the rows are triangulated in parallel.
  */
 TriangleMesh::Ptr
 depthmap_triangulate (FloatImage::ConstPtr dm, math::Matrix3f const& invproj,
-    float dd_factor = 5.0f, mve::Image<unsigned int>* vids = nullptr);
+    float dd_factor = 5.0f, core::Image<unsigned int>* vids = nullptr);
 
 /**
  * A helper function that triangulates the given depth map with optional
@@ -149,13 +151,21 @@ depthmap_mesh_confidences (TriangleMesh::Ptr mesh, int iterations = 3);
 void
 depthmap_mesh_peeling (TriangleMesh::Ptr mesh, int iterations = 1);
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+/**
+ * Computes the confidences and peels the mesh like the two functions above,
+ * in this order, but builds the mesh adjacency only once for both.
+ */
+void
+depthmap_mesh_confidences_and_peeling (TriangleMesh::Ptr mesh,
+    int conf_iterations = 3, int peel_iterations = 1);
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
 /* ------------------------- Implementation ----------------------- */
 
-MVE_NAMESPACE_BEGIN
-MVE_IMAGE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
 
 template <typename T>
 inline void
@@ -178,7 +188,7 @@ depthmap_convert_conventions (typename Image<T>::Ptr dm,
         }
 }
 
-MVE_IMAGE_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_DEPTHMAP_HEADER */
+#endif /* CORE_DEPTHMAP_HEADER */
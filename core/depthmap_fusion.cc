@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "math/matrix.h"
+#include "core/depthmap.h"
+#include "core/marching_cubes.h"
+#include "core/depthmap_fusion.h"
+
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
+
+namespace
+{
+    int const BRICK_SIZE = SparseFloatVolume::BRICK_SIZE;
+    int const WINDOW_SIZE = BRICK_SIZE + 1;
+
+    /* The transformations of a view for the integration. */
+    struct ViewProjection
+    {
+        FloatImage const* depth_map;
+        math::Matrix3f invproj;
+        math::Matrix4f cam_to_world;
+        math::Matrix3f calib;
+        math::Matrix3f rot;
+        math::Vec3f trans;
+    };
+
+    /* Sorts the keys and removes duplicates. */
+    void
+    unique_keys (std::vector<uint64_t>* keys)
+    {
+        std::sort(keys->begin(), keys->end());
+        keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+    }
+
+    /*
+     * Collects the bricks with voxels within the truncation band 'band'
+     * (in voxels) around the depth samples of the view.
+     */
+    void
+    collect_view_bricks (ViewProjection const& view,
+        SparseFloatVolume const& vol, math::Vec3f const& aabb_min, float voxel_size, float band,
+        std::vector<uint64_t>* keys)
+    {
+        FloatImage const& dm = *view.depth_map;
+        int const size[3] = { vol.width(), vol.height(), vol.depth() };
+        std::size_t compact_size = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+        keys->clear();
+        for (int y = 0; y < dm.height(); ++y)
+        {
+            for (int x = 0; x < dm.width(); ++x)
+            {
+                float const depth = dm.at(x, y, 0);
+                if (!(depth > 0.0f))
+                    continue;
+
+                math::Vec3f const pos = view.cam_to_world.mult
+                    (pixel_3dpos(x, y, depth, view.invproj), 1.0f);
+                math::Vec3f const vox = (pos - aabb_min) / voxel_size;
+
+                /* The range of bricks with voxels in the band. */
+                int lo[3], hi[3];
+                bool inside = true;
+                for (int i = 0; inside && i < 3; ++i)
+                {
+                    if (!std::isfinite(vox[i]))
+                    {
+                        inside = false;
+                        break;
+                    }
+                    float const vmin = std::max(0.0f, std::min(
+                        std::ceil(vox[i] - band), (float)size[i]));
+                    float const vmax = std::min((float)size[i] - 1.0f,
+                        std::max(std::floor(vox[i] + band), -1.0f));
+                    inside = vmin <= vmax;
+                    lo[i] = static_cast<int>(vmin) / BRICK_SIZE;
+                    hi[i] = static_cast<int>(vmax) / BRICK_SIZE;
+                }
+                if (!inside)
+                    continue;
+
+                for (int bz = lo[2]; bz <= hi[2]; ++bz)
+                    for (int by = lo[1]; by <= hi[1]; ++by)
+                        for (int bx = lo[0]; bx <= hi[0]; ++bx)
+                            keys->push_back(vol.get_brick_key(bx, by, bz));
+            }
+
+            /* Neighboring pixels share bricks, remove duplicates early. */
+            if (keys->size() > 2 * compact_size)
+            {
+                unique_keys(keys);
+                compact_size = std::max(compact_size, keys->size());
+            }
+        }
+        unique_keys(keys);
+    }
+
+    /*
+     * The voxels of a brick and the adjacent voxels in positive directions,
+     * with the interface of a volume for marching_cubes_brick().
+     */
+    class BrickWindow
+    {
+    public:
+        BrickWindow (SparseFloatVolume const& vol, int bx, int by, int bz);
+        int width (void) const;
+        int height (void) const;
+        int depth (void) const;
+        float at (int x, int y, int z) const;
+
+    private:
+        int size[3];
+        int origin[3];
+        float values[WINDOW_SIZE * WINDOW_SIZE * WINDOW_SIZE];
+    };
+
+    BrickWindow::BrickWindow (SparseFloatVolume const& vol,
+        int bx, int by, int bz)
+    {
+        this->size[0] = vol.width();
+        this->size[1] = vol.height();
+        this->size[2] = vol.depth();
+        this->origin[0] = bx * BRICK_SIZE;
+        this->origin[1] = by * BRICK_SIZE;
+        this->origin[2] = bz * BRICK_SIZE;
+
+        /* The brick and its neighbors, ordered by the offset bits. */
+        SparseFloatVolume::Brick const* neighbors[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            int const n[3] = { bx + (i & 1), by + (i >> 1 & 1),
+                bz + (i >> 2 & 1) };
+            bool const valid = n[0] * BRICK_SIZE < this->size[0]
+                && n[1] * BRICK_SIZE < this->size[1]
+                && n[2] * BRICK_SIZE < this->size[2];
+            neighbors[i] = valid ? vol.find_brick(n[0], n[1], n[2]) : nullptr;
+        }
+
+        float* value = this->values;
+        for (int z = 0; z < WINDOW_SIZE; ++z)
+            for (int y = 0; y < WINDOW_SIZE; ++y)
+                for (int x = 0; x < WINDOW_SIZE; ++x, ++value)
+                {
+                    int const nid = (x / BRICK_SIZE) | (y / BRICK_SIZE) << 1
+                        | (z / BRICK_SIZE) << 2;
+                    SparseFloatVolume::Brick const* brick = neighbors[nid];
+                    *value = brick == nullptr ? vol.get_background()
+                        : (*brick)[((z % BRICK_SIZE) * BRICK_SIZE
+                        + y % BRICK_SIZE) * BRICK_SIZE + x % BRICK_SIZE];
+                }
+    }
+
+    inline int
+    BrickWindow::width (void) const
+    {
+        return this->size[0];
+    }
+
+    inline int
+    BrickWindow::height (void) const
+    {
+        return this->size[1];
+    }
+
+    inline int
+    BrickWindow::depth (void) const
+    {
+        return this->size[2];
+    }
+
+    inline float
+    BrickWindow::at (int x, int y, int z) const
+    {
+        return this->values[((z - this->origin[2]) * WINDOW_SIZE
+            + y - this->origin[1]) * WINDOW_SIZE + x - this->origin[0]];
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+DepthMapFusion::DepthMapFusion (Options const& options)
+    : opts(options)
+{
+    if (!(this->opts.voxel_size > 0.0f))
+        throw std::invalid_argument("Invalid voxel size");
+    if (this->opts.truncation < 0.0f)
+        throw std::invalid_argument("Invalid truncation distance");
+    if (this->opts.truncation == 0.0f)
+        this->opts.truncation = 3.0f * this->opts.voxel_size;
+
+    int size[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        float const extent = (this->opts.aabb_max[i] - this->opts.aabb_min[i])
+            / this->opts.voxel_size;
+        if (!(extent > 0.0f) || extent >= std::numeric_limits<int>::max() / 2)
+            throw std::invalid_argument("Invalid volume box");
+        size[i] = static_cast<int>(std::ceil(extent)) + 1;
+    }
+    this->sdf.allocate(size[0], size[1], size[2], 1.0f);
+    this->weights.allocate(size[0], size[1], size[2], 0.0f);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+DepthMapFusion::integrate (std::vector<FusionView> const& views)
+{
+    std::int64_t const num_views = views.size();
+    std::vector<ViewProjection> projs(num_views);
+    for (std::size_t i = 0; i < views.size(); ++i)
+    {
+        FloatImage::ConstPtr dm = views[i].depth_map;
+        if (dm == nullptr)
+            throw std::invalid_argument("Null depth map given");
+        CameraInfo const& cam = views[i].camera;
+        ViewProjection& proj = projs[i];
+        proj.depth_map = dm.get();
+        cam.fill_inverse_calibration(proj.invproj.begin(),
+            dm->width(), dm->height());
+        cam.fill_cam_to_world(proj.cam_to_world.begin());
+        cam.fill_calibration(proj.calib.begin(), dm->width(), dm->height());
+        cam.fill_world_to_cam_rot(proj.rot.begin());
+        cam.fill_camera_translation(proj.trans.begin());
+    }
+
+    /* Collect the bricks in the truncation band of each view. */
+    float const band = this->opts.truncation / this->opts.voxel_size;
+    std::vector<std::vector<uint64_t> > view_bricks(num_views);
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_views; ++i)
+        collect_view_bricks(projs[i], this->sdf, this->opts.aabb_min,
+            this->opts.voxel_size, band, &view_bricks[i]);
+
+    /* Group the views by brick, the views of a brick stay in order. */
+    std::vector<std::pair<uint64_t, unsigned int> > brick_views;
+    for (std::size_t i = 0; i < view_bricks.size(); ++i)
+    {
+        for (std::size_t j = 0; j < view_bricks[i].size(); ++j)
+            brick_views.push_back(std::make_pair(view_bricks[i][j],
+                static_cast<unsigned int>(i)));
+        std::vector<uint64_t>().swap(view_bricks[i]);
+    }
+    std::sort(brick_views.begin(), brick_views.end());
+
+    std::vector<uint64_t> keys;
+    std::vector<std::size_t> offsets;
+    for (std::size_t i = 0; i < brick_views.size(); ++i)
+        if (i == 0 || brick_views[i].first != brick_views[i - 1].first)
+        {
+            keys.push_back(brick_views[i].first);
+            offsets.push_back(i);
+        }
+    offsets.push_back(brick_views.size());
+
+    /* Allocate all bricks up front, integration then needs no locking. */
+    std::int64_t const num_bricks = keys.size();
+    std::vector<float*> sdf_bricks(num_bricks);
+    std::vector<float*> weight_bricks(num_bricks);
+    for (std::int64_t i = 0; i < num_bricks; ++i)
+    {
+        int bx, by, bz;
+        this->sdf.get_brick_position(keys[i], &bx, &by, &bz);
+        sdf_bricks[i] = this->sdf.get_brick(bx, by, bz).data();
+        weight_bricks[i] = this->weights.get_brick(bx, by, bz).data();
+    }
+
+    /* Integrate the views into the voxels of each brick. */
+    int const size[3] = { this->sdf.width(), this->sdf.height(),
+        this->sdf.depth() };
+    float const trunc = this->opts.truncation;
+#pragma omp parallel for schedule(dynamic, 16)
+    for (std::int64_t i = 0; i < num_bricks; ++i)
+    {
+        int bx, by, bz;
+        this->sdf.get_brick_position(keys[i], &bx, &by, &bz);
+        float* sdf_value = sdf_bricks[i];
+        float* weight_value = weight_bricks[i];
+        for (int lz = 0; lz < BRICK_SIZE; ++lz)
+            for (int ly = 0; ly < BRICK_SIZE; ++ly)
+                for (int lx = 0; lx < BRICK_SIZE; ++lx,
+                    ++sdf_value, ++weight_value)
+                {
+                    int const x = bx * BRICK_SIZE + lx;
+                    int const y = by * BRICK_SIZE + ly;
+                    int const z = bz * BRICK_SIZE + lz;
+                    if (x >= size[0] || y >= size[1] || z >= size[2])
+                        continue;
+
+                    math::Vec3f const pos = this->get_voxel_position(x, y, z);
+                    float value = *sdf_value;
+                    float weight = *weight_value;
+                    for (std::size_t j = offsets[i]; j < offsets[i + 1]; ++j)
+                    {
+                        ViewProjection const& proj
+                            = projs[brick_views[j].second];
+                        FloatImage const& dm = *proj.depth_map;
+                        math::Vec3f const campos = proj.rot * pos + proj.trans;
+                        if (campos[2] <= 0.0f)
+                            continue;
+                        math::Vec3f const pixel = proj.calib * campos;
+                        float const px = pixel[0] / pixel[2];
+                        float const py = pixel[1] / pixel[2];
+                        if (!(px >= 0.0f && py >= 0.0f && px < dm.width()
+                            && py < dm.height()))
+                            continue;
+                        float const depth = dm.at(static_cast<int>(px),
+                            static_cast<int>(py), 0);
+                        if (!(depth > 0.0f))
+                            continue;
+
+                        float const dist = depth - campos.norm();
+                        if (dist < -trunc)
+                            continue;
+                        value = (value * weight + std::min(1.0f, dist / trunc))
+                            / (weight + 1.0f);
+                        weight += 1.0f;
+                    }
+                    *sdf_value = value;
+                    *weight_value = weight;
+                }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+TriangleMesh::Ptr
+DepthMapFusion::extract_mesh (void) const
+{
+    /* Polygonize the allocated bricks in a deterministic order. */
+    std::vector<uint64_t> keys;
+    keys.reserve(this->sdf.get_bricks().size());
+    for (SparseFloatVolume::BrickMap::const_iterator iter
+        = this->sdf.get_bricks().begin();
+        iter != this->sdf.get_bricks().end(); ++iter)
+        keys.push_back(iter->first);
+    std::sort(keys.begin(), keys.end());
+
+    /*
+     * Cubes between allocated and unallocated bricks contain unobserved
+     * voxels and are skipped, so it suffices to polygonize the bricks.
+     */
+    int const size[3] = { this->sdf.width(), this->sdf.height(),
+        this->sdf.depth() };
+    std::int64_t const num_bricks = keys.size();
+    std::vector<MCBrickMesh> results(num_bricks);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (std::int64_t i = 0; i < num_bricks; ++i)
+    {
+        int index[3];
+        this->sdf.get_brick_position(keys[i], index + 0, index + 1,
+            index + 2);
+        int min[3], max[3];
+        bool empty = false;
+        for (int j = 0; j < 3; ++j)
+        {
+            min[j] = index[j] * BRICK_SIZE;
+            max[j] = std::min(min[j] + BRICK_SIZE, size[j] - 1);
+            empty = empty || min[j] >= max[j];
+        }
+        if (empty)
+            continue;
+
+        BrickWindow const sdf_window(this->sdf, index[0], index[1], index[2]);
+        BrickWindow const weight_window(this->weights,
+            index[0], index[1], index[2]);
+        marching_cubes_brick(sdf_window, weight_window, min, max,
+            &results[i]);
+    }
+    TriangleMesh::Ptr mesh = marching_cubes_stitch(&results);
+
+    /* Marching cubes maps the volume width to [-0.5, 0.5]. */
+    TriangleMesh::VertexList& verts = mesh->get_vertices();
+    float const scale = (size[0] - 1) * this->opts.voxel_size;
+    for (std::size_t i = 0; i < verts.size(); ++i)
+        verts[i] = this->opts.aabb_min + (verts[i] + 0.5f) * scale;
+
+    return mesh;
+}
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef CORE_DEPTHMAP_FUSION_HEADER
+#define CORE_DEPTHMAP_FUSION_HEADER
+
+#include <vector>
+
+#include "math/vector.h"
+#include "core/defines.h"
+#include "core/camera.h"
+#include "core/image.h"
+#include "core/mesh.h"
+#include "core/volume.h"
+
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
+
+/** A depth map with its camera for depth map fusion. */
+struct FusionView
+{
+    /* The depth map with depths along the viewing rays, zero is invalid. */
+    FloatImage::ConstPtr depth_map;
+    CameraInfo camera;
+};
+
+/**
+ * Fusion of many depth maps into a truncated signed distance field.
+ *
+ * The SDF is stored in a sparse volume over a box in world coordinates,
+ * together with a sparse volume of weights. Every depth sample allocates
+ * the bricks within the truncation distance around it, and each voxel of
+ * these bricks averages the truncated signed distances of the views whose
+ * samples allocated the brick. Distances are positive in front of the
+ * surface and normalized to [-1, 1] by the truncation distance. Voxels
+ * further behind the surface than the truncation distance are not
+ * updated, and cubes with unobserved voxels yield no surface.
+ *
+ * The bricks touched by each view are collected in parallel over the
+ * views, allocated at once, and integrated in parallel over the bricks.
+ * Every voxel is written by one thread only, and the result does not
+ * depend on the number of threads.
+ */
+class DepthMapFusion
+{
+public:
+    struct Options
+    {
+        Options (void);
+
+        /** The box in world coordinates to reconstruct. */
+        math::Vec3f aabb_min;
+        math::Vec3f aabb_max;
+        /** The edge length of the voxels in world units. */
+        float voxel_size;
+        /** The truncation distance in world units, zero for 3 voxels. */
+        float truncation;
+    };
+
+public:
+    explicit DepthMapFusion (Options const& options);
+
+    /** Integrates the depth maps of the views into the volume. */
+    void integrate (std::vector<FusionView> const& views);
+
+    /** Extracts the surface in world coordinates with marching cubes. */
+    TriangleMesh::Ptr extract_mesh (void) const;
+
+    /** Returns the SDF volume. */
+    SparseFloatVolume const& get_sdf (void) const;
+    /** Returns the volume with the weights of the SDF values. */
+    SparseFloatVolume const& get_weights (void) const;
+    /** Returns the world position of a voxel. */
+    math::Vec3f get_voxel_position (int x, int y, int z) const;
+
+private:
+    Options opts;
+    SparseFloatVolume sdf;
+    SparseFloatVolume weights;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+DepthMapFusion::Options::Options (void)
+    : aabb_min(-1.0f)
+    , aabb_max(1.0f)
+    , voxel_size(0.01f)
+    , truncation(0.0f)
+{
+}
+
+inline SparseFloatVolume const&
+DepthMapFusion::get_sdf (void) const
+{
+    return this->sdf;
+}
+
+inline SparseFloatVolume const&
+DepthMapFusion::get_weights (void) const
+{
+    return this->weights;
+}
+
+inline math::Vec3f
+DepthMapFusion::get_voxel_position (int x, int y, int z) const
+{
+    return this->opts.aabb_min + math::Vec3f(x, y, z) * this->opts.voxel_size;
+}
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
+
+#endif /* CORE_DEPTHMAP_FUSION_HEADER */
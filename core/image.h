@@ -39,7 +39,7 @@ class Image : public TypedImageBase<T>
 public:
     typedef std::shared_ptr<Image<T> > Ptr;
     typedef std::shared_ptr<Image<T> const> ConstPtr;
-    typedef std::vector<T> ImageData;
+    typedef typename TypedImageBase<T>::ImageData ImageData;
     typedef T ValueType;
 
 public:
@@ -59,7 +59,11 @@ public:
     /** Smart pointer image copy constructor. */
     static Ptr create (Image<T> const& other);
 
-    /** Duplicates the image. */
+    /**
+     * Duplicates the image. The values are only copied on the first
+     * modification of either image, which makes duplicates of shared
+     * images cheap for read-only use.
+     */
     Ptr duplicate (void) const;
 
     /** Fills every pixel of the image with the given color. */
@@ -236,9 +240,10 @@ Image<T>::add_channels (int num_channels, T const& value)
     if (num_channels <= 0 || !this->valid())
         return;
 
-    std::vector<T> tmp(this->w * this->h * (this->c + num_channels));
-    typename std::vector<T>::iterator dest_ptr = tmp.end();
-    typename std::vector<T>::const_iterator src_ptr = this->data.end();
+    ImageData tmp;
+    tmp.resize_uninitialized(this->w * this->h * (this->c + num_channels));
+    T* dest_ptr = tmp.end();
+    T const* src_ptr = this->data.end();
     const int pixels = this->get_pixel_amount();
     for (int p = 0; p < pixels; ++p)
     {
@@ -294,8 +299,8 @@ Image<T>::delete_channel (int chan)
     if (chan < 0 || chan >= this->channels())
         return;
 
-    typename std::vector<T>::iterator src_iter = this->data.begin();
-    typename std::vector<T>::iterator dst_iter = this->data.begin();
+    T const* src_iter = this->data.begin();
+    T* dst_iter = this->data.begin();
     for (int i = 0; src_iter != this->data.end(); ++i)
     {
         if (i % this->c == chan)
@@ -12,10 +12,10 @@
 
 #include <cstdint>
 #include <memory>
-#include <vector>
 
 #include "util/strings.h"
 #include "core/defines.h"
+#include "core/image_storage.h"
 
 CORE_NAMESPACE_BEGIN
 
@@ -101,9 +101,9 @@ protected:
 
 /**
  * Base class for images of arbitrary type. Image values are stored
- * in a standard STL Vector. Type information is provided. This class
- * makes no assumptions about the image structure, i.e. it provides no
- * pixel access methods.
+ * in an ImageStorage, which is 64 byte aligned or a view of an external
+ * buffer. Type information is provided. This class makes no assumptions
+ * about the image structure, i.e. it provides no pixel access methods.
  */
 template <typename T>
 class TypedImageBase : public ImageBase
@@ -112,13 +112,16 @@ public:
     typedef T ValueType;
     typedef std::shared_ptr<TypedImageBase<T> > Ptr;
     typedef std::shared_ptr<TypedImageBase<T> const> ConstPtr;
-    typedef std::vector<T> ImageData;
+    typedef ImageStorage<T> ImageData;
 
 public:
     /** Default constructor creates an empty image. */
     TypedImageBase (void);
 
-    /** Copy constructor duplicates another image. */
+    /**
+     * Copy constructor duplicates another image. The values are shared
+     * until either image is modified, see ImageStorage.
+     */
     TypedImageBase (TypedImageBase<T> const& other);
 
     virtual ~TypedImageBase (void);
@@ -129,6 +132,21 @@ public:
     /** Allocates new image space, clearing previous content. */
     void allocate (int width, int height, int chans);
 
+    /**
+     * Allocates new image space without initializing the values. This is
+     * faster than allocate() if all values are overwritten anyway.
+     */
+    void allocate_uninitialized (int width, int height, int chans);
+
+    /**
+     * Makes the image a view of an external buffer with at least
+     * width * height * chans values, which is read and written in place.
+     * The owner, if any, is held to keep the buffer alive. Duplicates of
+     * the image own their memory.
+     */
+    void wrap (T* buffer, int width, int height, int chans,
+        std::shared_ptr<void> const& owner = nullptr);
+
     /**
      * Resizes the underlying image data vector.
      * Note: This leaves the existing/remaining image data unchanged.
@@ -419,6 +437,28 @@ TypedImageBase<T>::allocate (int width, int height, int chans)
     this->resize(width, height, chans);
 }
 
+template <typename T>
+inline void
+TypedImageBase<T>::allocate_uninitialized (int width, int height, int chans)
+{
+    this->clear();
+    this->w = width;
+    this->h = height;
+    this->c = chans;
+    this->data.resize_uninitialized(width * height * chans);
+}
+
+template <typename T>
+inline void
+TypedImageBase<T>::wrap (T* buffer, int width, int height, int chans,
+    std::shared_ptr<void> const& owner)
+{
+    this->w = width;
+    this->h = height;
+    this->c = chans;
+    this->data.wrap(buffer, width * height * chans, owner);
+}
+
 template <typename T>
 inline void
 TypedImageBase<T>::resize (int width, int height, int chans)
@@ -136,6 +136,117 @@ namespace
     {
         return 1.0f / std::pow(2.0f, apex_time);
     }
+
+    /* Parses the degrees, minutes and seconds rationals into degrees. */
+    double
+    parse_gps_coordinate (unsigned char const* buf, bool intel)
+    {
+        double degrees = 0.0;
+        double scale = 1.0;
+        for (int i = 0; i < 3; ++i, scale *= 60.0)
+        {
+            uint32_t numerator = parse_u32(buf + 8 * i, intel);
+            uint32_t denominator = parse_u32(buf + 8 * i + 4, intel);
+            if (denominator != 0)
+                degrees += static_cast<double>(numerator)
+                    / static_cast<double>(denominator) / scale;
+        }
+        return degrees;
+    }
+
+    /*
+     * Parses the GPS IFD section. The references are single characters
+     * ('N' or 'S', 'E' or 'W') and an altitude byte (1 below sea level).
+     */
+    void
+    parse_gps_ifd (unsigned char const* buf, std::size_t len,
+        std::size_t offs, std::size_t tiff_header_offset, bool intel,
+        ExifInfo* result)
+    {
+        if (offs + 2 > len)
+            throw std::invalid_argument("EXIF data corrupt (GPS entries)");
+        int num_entries = parse_u16(buf + offs, intel);
+        offs += 2;
+        if (num_entries > 10000)
+            throw std::invalid_argument("EXIF data corrupt (number of GPS)");
+        if (offs + 4 + 12 * num_entries > len)
+            throw std::invalid_argument("EXIF data corrupt (GPS table)");
+
+        char latitude_ref = 'N';
+        char longitude_ref = 'E';
+        int altitude_ref = 0;
+        bool has_latitude = false;
+        bool has_longitude = false;
+        for (int i = 0; i < num_entries; ++i, offs += 12)
+        {
+            unsigned short tag = parse_u16(buf + offs, intel);
+            unsigned short type = parse_u16(buf + offs + 2, intel);
+            unsigned int ncomp = parse_u32(buf + offs + 4, intel);
+            unsigned int coffs = parse_u32(buf + offs + 8, intel);
+
+            std::size_t buf_off = offs + 8;
+            if (ifd_is_offset(type, ncomp))
+                buf_off = tiff_header_offset + coffs;
+            std::size_t size = type == EXIF_TYPE_URATIONAL ? 8 * ncomp : ncomp;
+            if (buf_off + size > len)
+                throw std::invalid_argument("EXIF data corrupt (GPS entry)");
+
+            switch (tag)
+            {
+                case 0x1: // Latitude reference.
+                    if (type == EXIF_TYPE_ASCII && ncomp > 0)
+                        latitude_ref = static_cast<char>(buf[buf_off]);
+                    break;
+
+                case 0x2: // Latitude.
+                    if (type == EXIF_TYPE_URATIONAL && ncomp == 3)
+                    {
+                        result->gps_latitude
+                            = parse_gps_coordinate(buf + buf_off, intel);
+                        has_latitude = true;
+                    }
+                    break;
+
+                case 0x3: // Longitude reference.
+                    if (type == EXIF_TYPE_ASCII && ncomp > 0)
+                        longitude_ref = static_cast<char>(buf[buf_off]);
+                    break;
+
+                case 0x4: // Longitude.
+                    if (type == EXIF_TYPE_URATIONAL && ncomp == 3)
+                    {
+                        result->gps_longitude
+                            = parse_gps_coordinate(buf + buf_off, intel);
+                        has_longitude = true;
+                    }
+                    break;
+
+                case 0x5: // Altitude reference.
+                    if (type == EXIF_TYPE_BYTE && ncomp > 0)
+                        altitude_ref = buf[buf_off];
+                    break;
+
+                case 0x6: // Altitude.
+                    if (type == EXIF_TYPE_URATIONAL && ncomp > 0)
+                        result->gps_altitude
+                            = parse_rational_u64(buf + buf_off, intel);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if (latitude_ref == 'S')
+            result->gps_latitude = -result->gps_latitude;
+        if (longitude_ref == 'W')
+            result->gps_longitude = -result->gps_longitude;
+        if (altitude_ref == 1)
+            result->gps_altitude = -result->gps_altitude;
+        if (!std::isfinite(result->gps_altitude))
+            result->gps_altitude = 0.0;
+        result->has_gps = has_latitude && has_longitude;
+    }
 }  /* namespace */
 
 /* ---------------------------------------------------------------- */
@@ -236,7 +347,7 @@ exif_extract (char const* data, std::size_t len, bool is_jpeg)
      * While parsing the IFD entries, try to find SubIFD and GPS offsets.
      */
     std::size_t exif_sub_ifd_offset = 0;
-    //unsigned int gps_sub_ifd_offset = 0;
+    std::size_t gps_sub_ifd_offset = 0;
     for (int i = 0; i < num_entries; ++i)
     {
         unsigned short tag = parse_u16(buf + offs, align_intel);
@@ -261,9 +372,9 @@ exif_extract (char const* data, std::size_t len, bool is_jpeg)
                 exif_sub_ifd_offset = tiff_header_offset + coffs;
                 break;
 
-            //case 0x8825: // GPS IFS offset.
-            //    gps_sub_ifd_offset = tiff_header_offset + coffs;
-            //    break;
+            case 0x8825: // GPS IFD offset.
+                gps_sub_ifd_offset = tiff_header_offset + coffs;
+                break;
 
             case 0x102: // Bits per color sample.
                 if (type == EXIF_TYPE_USHORT)
@@ -316,7 +427,12 @@ exif_extract (char const* data, std::size_t len, bool is_jpeg)
         offs += 12;
     }
 
-    /* Check if a SubIFD section exists. */
+    /* Parse the GPS section if it exists. */
+    if (gps_sub_ifd_offset != 0)
+        parse_gps_ifd(buf, len, gps_sub_ifd_offset, tiff_header_offset,
+            align_intel, &result);
+
+        /* Check if a SubIFD section exists. */
     if (exif_sub_ifd_offset == 0)
         return result;
 
@@ -484,7 +600,15 @@ exif_debug_print (std::ostream& stream, ExifInfo const& exif, bool indent)
         << std::setw(width) << std::left << "Image width: "
         << debug_print(exif.image_width, " pixel") << std::endl
         << std::setw(width) << std::left << "Image height: "
-        << debug_print(exif.image_height, " pixel") << std::endl;
+        << debug_print(exif.image_height, " pixel") << std::endl
+        << std::setw(width) << std::left << "GPS position: ";
+    if (exif.has_gps)
+        stream << util::string::get_fixed(exif.gps_latitude, 6) << ", "
+            << util::string::get_fixed(exif.gps_longitude, 6) << " deg, "
+            << util::string::get_fixed(exif.gps_altitude, 1) << " m"
+            << std::endl;
+    else
+        stream << "<not set>" << std::endl;
 }
 
 CORE_IMAGE_NAMESPACE_END
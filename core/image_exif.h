@@ -85,6 +85,15 @@ struct ExifInfo
     int image_width;
     /** EXIF image height. */
     int image_height;
+
+    /** Whether the GPS latitude and longitude are set. */
+    bool has_gps;
+    /** GPS latitude in degrees, positive in the north. */
+    double gps_latitude;
+    /** GPS longitude in degrees, positive in the east. */
+    double gps_longitude;
+    /** GPS altitude in meters above sea level, 0 if not set. */
+    double gps_altitude;
 };
 
 /**
@@ -119,6 +128,10 @@ ExifInfo::ExifInfo (void)
     , flash_mode(-1)
     , image_width(-1)
     , image_height(-1)
+    , has_gps(false)
+    , gps_latitude(0.0)
+    , gps_longitude(0.0)
+    , gps_altitude(0.0)
 {
 }
 
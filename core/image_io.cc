@@ -9,11 +9,15 @@
 
 #include <algorithm>
 #include <limits>
-#include <fstream>
+#include <cctype>
 #include <cstdio>
 #include <cstdarg>
 #include <cstring>
 #include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#include <zlib.h>
 
 #ifndef MVE_NO_PNG_SUPPORT
 #   include <png.h>
@@ -33,7 +37,14 @@
 #endif
 
 #include "math/algo.h"
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "util/binary_io.h"
 #include "util/exception.h"
+#include "util/file_system.h"
+#include "util/profiler.h"
 #include "util/strings.h"
 #include "util/system.h"
 #include "core/image_io.h"
@@ -45,6 +56,8 @@
 #define MVEI_FILE_SIGNATURE "\211MVE_IMAGE\n"
 #define MVEI_FILE_SIGNATURE_LEN 11
 #define MVEI_MAX_PIXEL_AMOUNT (16384 * 16384) /* 2^28 */
+#define MVEI_COMPRESSED_SIGNATURE "\211MVE_IMAGZ\n"
+#define MVEI_COMPRESSED_BAND_ROWS 32
 
 CORE_NAMESPACE_BEGIN
 CORE_IMAGE_NAMESPACE_BEGIN
@@ -56,6 +69,7 @@ CORE_IMAGE_NAMESPACE_BEGIN
 ByteImage::Ptr
 load_file (std::string const& filename)
 {
+    UTIL_PROFILE_SCOPE("image::load_file");
     try
     {
 #ifndef MVE_NO_PNG_SUPPORT
@@ -122,6 +136,23 @@ load_file_headers (std::string const& filename)
         catch (util::Exception&) {}
 #endif
 
+#ifndef MVE_NO_TIFF_SUPPORT
+        try
+        { return load_tiff_file_headers(filename); }
+        catch (util::FileException&) { throw; }
+        catch (util::Exception&) {}
+#endif
+
+        try
+        { return load_ppm_file_headers(filename); }
+        catch (util::FileException&) { throw; }
+        catch (util::Exception&) {}
+
+        try
+        { return load_pfm_file_headers(filename); }
+        catch (util::FileException&) { throw; }
+        catch (util::Exception&) {}
+
         try
         { return load_mvei_file_headers(filename); }
         catch (util::FileException&) { throw; }
@@ -135,9 +166,66 @@ load_file_headers (std::string const& filename)
     throw util::Exception(filename, ": Cannot determine image format");
 }
 
+std::size_t
+load_file_headers (std::vector<std::string> const& filenames,
+    std::vector<ImageHeaders>* headers)
+{
+    ImageHeaders invalid;
+    invalid.width = 0;
+    invalid.height = 0;
+    invalid.channels = 0;
+    invalid.type = IMAGE_TYPE_UNKNOWN;
+    headers->clear();
+    headers->resize(filenames.size(), invalid);
+
+    std::size_t num_failed = 0;
+    std::int64_t const num_files = static_cast<std::int64_t>(filenames.size());
+#pragma omp parallel for schedule(dynamic) reduction(+:num_failed)
+    for (std::int64_t i = 0; i < num_files; ++i)
+    {
+        try
+        {
+            headers->at(i) = load_file_headers(filenames[i]);
+        }
+        catch (std::exception&)
+        {
+            num_failed += 1;
+        }
+    }
+    return num_failed;
+}
+
+std::size_t
+load_directory_headers (std::string const& path,
+    std::vector<std::string>* filenames, std::vector<ImageHeaders>* headers)
+{
+    util::fs::Directory dir(path);
+    std::sort(dir.begin(), dir.end());
+
+    std::vector<std::string> candidates;
+    for (std::size_t i = 0; i < dir.size(); ++i)
+        if (!dir[i].is_dir)
+            candidates.push_back(dir[i].get_absolute_name());
+
+    /* Keep the files that are images. */
+    std::vector<ImageHeaders> all_headers;
+    load_file_headers(candidates, &all_headers);
+    filenames->clear();
+    headers->clear();
+    for (std::size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (all_headers[i].type == IMAGE_TYPE_UNKNOWN)
+            continue;
+        filenames->push_back(candidates[i]);
+        headers->push_back(all_headers[i]);
+    }
+    return filenames->size();
+}
+
 void
 save_file (ByteImage::ConstPtr image, std::string const& filename)
 {
+    UTIL_PROFILE_SCOPE("image::save_file");
     using namespace util::string;
     std::string fext4 = lowercase(right(filename, 4));
     std::string fext5 = lowercase(right(filename, 5));
@@ -184,6 +272,7 @@ save_file (ByteImage::Ptr image, std::string const& filename)
 void
 save_file (FloatImage::ConstPtr image, std::string const& filename)
 {
+    UTIL_PROFILE_SCOPE("image::save_file");
 
     using namespace util::string;
     std::string fext4 = lowercase(right(filename, 4));
@@ -302,9 +391,10 @@ load_png_file (std::string const& filename)
     /* Update the info struct to reflect the transformations. */
     png_read_update_info(png, png_info);
 
-    /* Create image. */
+    /* Create image, all values are written by the decoder. */
     ByteImage::Ptr image = ByteImage::create();
-    image->allocate(headers.width, headers.height, headers.channels);
+    image->allocate_uninitialized(headers.width, headers.height,
+        headers.channels);
     ByteImage::ImageData& data = image->get_data();
 
     /* Setup row pointers. */
@@ -346,10 +436,355 @@ load_png_file_headers (std::string const& filename)
 void
 save_png_file (ByteImage::ConstPtr image,
     std::string const& filename, int compression_level)
+{
+    PngSaveOptions options;
+    options.compression_level = compression_level;
+    save_png_file(image, filename, options);
+}
+
+namespace
+{
+    int
+    get_png_color_type (int channels)
+    {
+        switch (channels)
+        {
+            case 1: return PNG_COLOR_TYPE_GRAY;
+            case 2: return PNG_COLOR_TYPE_GRAY_ALPHA;
+            case 3: return PNG_COLOR_TYPE_RGB;
+            case 4: return PNG_COLOR_TYPE_RGB_ALPHA;
+            default: break;
+        }
+        throw util::Exception("Cannot determine image color type");
+    }
+
+    int
+    get_png_filter_flags (PngFilters filters)
+    {
+        switch (filters)
+        {
+            case PNG_FILTERS_NONE: return PNG_FILTER_NONE;
+            case PNG_FILTERS_SUB: return PNG_FILTER_SUB;
+            case PNG_FILTERS_UP: return PNG_FILTER_UP;
+            case PNG_FILTERS_PAETH: return PNG_FILTER_PAETH;
+            default: break;
+        }
+        return PNG_ALL_FILTERS;
+    }
+
+    /* ------------------------------------------------------------ */
+
+    unsigned char
+    png_paeth_predictor (int a, int b, int c)
+    {
+        int const p = a + b - c;
+        int const pa = std::abs(p - a);
+        int const pb = std::abs(p - b);
+        int const pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return static_cast<unsigned char>(a);
+        return static_cast<unsigned char>(pb <= pc ? b : c);
+    }
+
+    /*
+     * Filters a row with the given filter value, see the PNG specification.
+     * The filter value is written first, followed by the filtered bytes.
+     * The previous row is nullptr for the first row of the image.
+     */
+    void
+    png_filter_row (unsigned char const* row, unsigned char const* prev,
+        std::size_t num_bytes, int bpp, int filter, unsigned char* out)
+    {
+        out[0] = static_cast<unsigned char>(filter);
+        out += 1;
+        switch (filter)
+        {
+            case PNG_FILTER_VALUE_NONE:
+                std::copy(row, row + num_bytes, out);
+                break;
+
+            case PNG_FILTER_VALUE_SUB:
+                for (std::size_t i = 0; i < num_bytes; ++i)
+                    out[i] = row[i] - (i >= static_cast<std::size_t>(bpp)
+                        ? row[i - bpp] : 0);
+                break;
+
+            case PNG_FILTER_VALUE_UP:
+                for (std::size_t i = 0; i < num_bytes; ++i)
+                    out[i] = row[i] - (prev != nullptr ? prev[i] : 0);
+                break;
+
+            case PNG_FILTER_VALUE_AVG:
+                for (std::size_t i = 0; i < num_bytes; ++i)
+                {
+                    int const a = i >= static_cast<std::size_t>(bpp)
+                        ? row[i - bpp] : 0;
+                    int const b = prev != nullptr ? prev[i] : 0;
+                    out[i] = row[i] - static_cast<unsigned char>((a + b) / 2);
+                }
+                break;
+
+            case PNG_FILTER_VALUE_PAETH:
+                for (std::size_t i = 0; i < num_bytes; ++i)
+                {
+                    bool const left = i >= static_cast<std::size_t>(bpp);
+                    int const a = left ? row[i - bpp] : 0;
+                    int const b = prev != nullptr ? prev[i] : 0;
+                    int const c = left && prev != nullptr ? prev[i - bpp] : 0;
+                    out[i] = row[i] - png_paeth_predictor(a, b, c);
+                }
+                break;
+
+            default:
+                throw std::invalid_argument("Invalid PNG filter");
+        }
+    }
+
+    /*
+     * Chooses the filter with the smallest sum of absolute signed bytes,
+     * the heuristic of libpng, and writes the filtered row.
+     */
+    void
+    png_filter_row_adaptive (unsigned char const* row,
+        unsigned char const* prev, std::size_t num_bytes, int bpp,
+        unsigned char* out, std::vector<unsigned char>* buffer)
+    {
+        buffer->resize(num_bytes + 1);
+        std::size_t best_sum = std::numeric_limits<std::size_t>::max();
+        for (int filter = PNG_FILTER_VALUE_NONE;
+            filter <= PNG_FILTER_VALUE_PAETH; ++filter)
+        {
+            png_filter_row(row, prev, num_bytes, bpp, filter, &buffer->at(0));
+            std::size_t sum = 0;
+            for (std::size_t i = 1; i <= num_bytes && sum < best_sum; ++i)
+            {
+                int const value = static_cast<signed char>(buffer->at(i));
+                sum += std::abs(value);
+            }
+            if (sum < best_sum)
+            {
+                best_sum = sum;
+                std::copy(buffer->begin(), buffer->end(), out);
+            }
+        }
+    }
+
+    /* ------------------------------------------------------------ */
+
+    void
+    png_append_be32 (uint32_t value, std::vector<unsigned char>* out)
+    {
+        out->push_back(static_cast<unsigned char>(value >> 24));
+        out->push_back(static_cast<unsigned char>(value >> 16));
+        out->push_back(static_cast<unsigned char>(value >> 8));
+        out->push_back(static_cast<unsigned char>(value));
+    }
+
+    /* Appends a chunk with length, type, data and CRC. */
+    void
+    png_append_chunk (char const* type, unsigned char const* data,
+        std::size_t size, std::vector<unsigned char>* out)
+    {
+        png_append_be32(static_cast<uint32_t>(size), out);
+        std::size_t const type_pos = out->size();
+        out->insert(out->end(), type, type + 4);
+        out->insert(out->end(), data, data + size);
+        uLong const crc = crc32(0L, &out->at(type_pos),
+            static_cast<uInt>(size + 4));
+        png_append_be32(static_cast<uint32_t>(crc), out);
+    }
+
+    /*
+     * Compresses the given data to a raw deflate stream. The stream ends at
+     * a flush point but is not final, unless 'last' is set, so that the
+     * streams of consecutive bands can be concatenated. The dictionary is
+     * the data preceding the band.
+     */
+    void
+    png_deflate_band (unsigned char const* data, std::size_t size,
+        unsigned char const* dict, std::size_t dict_size, bool last,
+        int level, int strategy, std::vector<unsigned char>* out)
+    {
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(z_stream));
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy)
+            != Z_OK)
+            throw util::Exception("Error initializing zlib");
+        if (dict_size > 0 && deflateSetDictionary(&stream, dict,
+            static_cast<uInt>(dict_size)) != Z_OK)
+        {
+            deflateEnd(&stream);
+            throw util::Exception("Error setting zlib dictionary");
+        }
+
+        /* The bound does not include the flush marker. */
+        out->resize(deflateBound(&stream, static_cast<uLong>(size)) + 64);
+        stream.next_in = const_cast<unsigned char*>(data);
+        stream.avail_in = static_cast<uInt>(size);
+        stream.next_out = &out->at(0);
+        stream.avail_out = static_cast<uInt>(out->size());
+        int const ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        bool const success = last ? ret == Z_STREAM_END
+            : ret == Z_OK && stream.avail_in == 0 && stream.avail_out > 0;
+        out->resize(out->size() - stream.avail_out);
+        deflateEnd(&stream);
+        if (!success)
+            throw util::Exception("Error compressing PNG data");
+    }
+
+    /*
+     * Encodes a PNG file without libpng. The rows are filtered in parallel,
+     * and bands of rows are compressed in parallel as consecutive parts of
+     * one zlib stream.
+     */
+    void
+    save_png_file_parallel (ByteImage::ConstPtr image,
+        std::string const& filename, PngSaveOptions const& options,
+        int num_threads)
+    {
+        int const color_type = get_png_color_type(image->channels());
+        int const bpp = image->channels();
+        int64_t const height = image->height();
+        std::size_t const row_bytes = static_cast<std::size_t>
+            (image->width()) * image->channels();
+        std::size_t const stride = row_bytes + 1;
+        unsigned char const* pixels = image->get_data_pointer();
+
+        /* Filter the rows. */
+        std::vector<unsigned char> filtered(stride * height);
+#pragma omp parallel num_threads(num_threads)
+        {
+            std::vector<unsigned char> buffer;
+#pragma omp for schedule(static)
+            for (int64_t y = 0; y < height; ++y)
+            {
+                unsigned char const* row = pixels + y * row_bytes;
+                unsigned char const* prev = y > 0 ? row - row_bytes : nullptr;
+                unsigned char* out = &filtered[y * stride];
+                switch (options.filters)
+                {
+                    case PNG_FILTERS_NONE:
+                        png_filter_row(row, prev, row_bytes, bpp,
+                            PNG_FILTER_VALUE_NONE, out);
+                        break;
+                    case PNG_FILTERS_SUB:
+                        png_filter_row(row, prev, row_bytes, bpp,
+                            PNG_FILTER_VALUE_SUB, out);
+                        break;
+                    case PNG_FILTERS_UP:
+                        png_filter_row(row, prev, row_bytes, bpp,
+                            PNG_FILTER_VALUE_UP, out);
+                        break;
+                    case PNG_FILTERS_PAETH:
+                        png_filter_row(row, prev, row_bytes, bpp,
+                            PNG_FILTER_VALUE_PAETH, out);
+                        break;
+                    default:
+                        png_filter_row_adaptive(row, prev, row_bytes, bpp,
+                            out, &buffer);
+                        break;
+                }
+            }
+        }
+
+        /* Bands of at least 128 KB, a few per thread for load balancing. */
+        int64_t const min_band_rows = (131072 + stride - 1) / stride;
+        int64_t const band_rows = std::max(min_band_rows,
+            (height + 4 * num_threads - 1) / (4 * num_threads));
+        int64_t const num_bands = (height + band_rows - 1) / band_rows;
+        int const strategy = options.filters == PNG_FILTERS_NONE
+            ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+
+        std::vector<std::vector<unsigned char> > bands(num_bands);
+        std::vector<uLong> band_adler(num_bands);
+        bool failed = false;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+        for (int64_t i = 0; i < num_bands; ++i)
+        {
+            std::size_t const begin = i * band_rows * stride;
+            std::size_t const end = std::min(height, (i + 1) * band_rows)
+                * stride;
+            std::size_t const dict_size = std::min<std::size_t>(begin, 32768);
+            unsigned char const* data = &filtered[0];
+            band_adler[i] = adler32(1L, data + begin,
+                static_cast<uInt>(end - begin));
+            try
+            {
+                png_deflate_band(data + begin, end - begin,
+                    data + begin - dict_size, dict_size, i + 1 == num_bands,
+                    options.compression_level, strategy, &bands[i]);
+            }
+            catch (std::exception&)
+            {
+#pragma omp critical
+                failed = true;
+            }
+        }
+        if (failed)
+            throw util::Exception("Error compressing PNG data");
+
+        /* The zlib stream with header, the bands and the checksum. */
+        std::vector<unsigned char> idat;
+        idat.push_back(0x78);
+        if (options.compression_level <= 1)
+            idat.push_back(0x01);
+        else if (options.compression_level <= 5)
+            idat.push_back(0x5e);
+        else if (options.compression_level == 6)
+            idat.push_back(0x9c);
+        else
+            idat.push_back(0xda);
+        uLong adler = 1L;
+        for (int64_t i = 0; i < num_bands; ++i)
+        {
+            idat.insert(idat.end(), bands[i].begin(), bands[i].end());
+            std::vector<unsigned char>().swap(bands[i]);
+            std::size_t const end = std::min(height, (i + 1) * band_rows);
+            adler = adler32_combine(adler, band_adler[i],
+                (end - i * band_rows) * stride);
+        }
+        png_append_be32(static_cast<uint32_t>(adler), &idat);
+
+        /* The PNG signature and chunks. */
+        std::vector<unsigned char> ihdr;
+        png_append_be32(static_cast<uint32_t>(image->width()), &ihdr);
+        png_append_be32(static_cast<uint32_t>(image->height()), &ihdr);
+        ihdr.push_back(8); /* Bit depth */
+        ihdr.push_back(static_cast<unsigned char>(color_type));
+        ihdr.push_back(PNG_COMPRESSION_TYPE_BASE);
+        ihdr.push_back(PNG_FILTER_TYPE_BASE);
+        ihdr.push_back(PNG_INTERLACE_NONE);
+
+        unsigned char const signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        std::vector<unsigned char> file(signature, signature + 8);
+        png_append_chunk("IHDR", &ihdr[0], ihdr.size(), &file);
+        png_append_chunk("IDAT", &idat[0], idat.size(), &file);
+        png_append_chunk("IEND", nullptr, 0, &file);
+
+        util::BinaryWriter out(filename);
+        out.write(&file[0], file.size());
+        out.close();
+    }
+}
+
+void
+save_png_file (ByteImage::ConstPtr image, std::string const& filename,
+    PngSaveOptions const& options)
 {
     if (image == nullptr)
         throw std::invalid_argument("Null image given");
 
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = options.num_threads > 0
+        ? options.num_threads : omp_get_max_threads();
+#endif
+    if (num_threads > 1 && image->height() > 1)
+    {
+        save_png_file_parallel(image, filename, options, num_threads);
+        return;
+    }
+
     FILE *fp = std::fopen(filename.c_str(), "wb");
     if (!fp)
         throw util::FileException(filename, std::strerror(errno));
@@ -394,8 +829,10 @@ save_png_file (ByteImage::ConstPtr image,
         }
     }
 
-    /* Set compression level (6 seems to be the default). */
-    png_set_compression_level(png_ptr, compression_level);
+    /* Set compression level (6 seems to be the default) and filters. */
+    png_set_compression_level(png_ptr, options.compression_level);
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE,
+        get_png_filter_flags(options.filters));
 
     /* Write image. */
     png_set_IHDR(png_ptr, info_ptr, image->width(), image->height(),
@@ -444,8 +881,11 @@ jpg_message_handler (j_common_ptr /*cinfo*/, int msg_level)
 }
 
 ByteImage::Ptr
-load_jpg_file (std::string const& filename, std::string* exif)
+load_jpg_file (std::string const& filename, std::string* exif, int downscale)
 {
+    if (downscale != 1 && downscale != 2 && downscale != 4 && downscale != 8)
+        throw std::invalid_argument("Invalid JPEG downscale factor");
+
     FILE* fp = std::fopen(filename.c_str(), "rb");
     if (fp == nullptr)
         throw util::FileException(filename, std::strerror(errno));
@@ -490,11 +930,17 @@ load_jpg_file (std::string const& filename, std::string* exif)
             && cinfo.out_color_space != JCS_RGB)
             throw util::Exception("Invalid JPEG color space");
 
-        /* Create image. */
-        int const width = cinfo.image_width;
-        int const height = cinfo.image_height;
+        /* Decode to the downscaled size in the DCT domain. */
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = downscale;
+        jpeg_calc_output_dimensions(&cinfo);
+
+        /* Create image, all values are written by the decoder. */
+        int const width = cinfo.output_width;
+        int const height = cinfo.output_height;
         int const channels = (cinfo.out_color_space == JCS_RGB ? 3 : 1);
-        image = ByteImage::create(width, height, channels);
+        image = ByteImage::create();
+        image->allocate_uninitialized(width, height, channels);
         ByteImage::ImageData& data = image->get_data();
 
         /* Start decompression. */
@@ -523,7 +969,7 @@ load_jpg_file (std::string const& filename, std::string* exif)
 }
 
 ImageHeaders
-load_jpg_file_headers (std::string const& filename)
+load_jpg_file_headers (std::string const& filename, std::string* exif)
 {
     FILE* fp = std::fopen(filename.c_str(), "rb");
     if (fp == nullptr)
@@ -541,11 +987,30 @@ load_jpg_file_headers (std::string const& filename)
         jpeg_create_decompress(&cinfo);
         jpeg_stdio_src(&cinfo, fp);
 
+        if (exif)
+        {
+            /* Request APP1 marker to be saved (this is the EXIF data). */
+            jpeg_save_markers(&cinfo, JPEG_APP0 + 1, 0xffff);
+        }
+
         /* Read JPEG header. */
         int ret = jpeg_read_header(&cinfo, static_cast<boolean>(false));
         if (ret != JPEG_HEADER_OK)
             throw util::Exception("JPEG header not recognized");
 
+        /* Examine JPEG markers. */
+        if (exif)
+        {
+            jpeg_saved_marker_ptr marker = cinfo.marker_list;
+            if (marker != nullptr && marker->marker == JPEG_APP0 + 1
+                && marker->data_length > 6
+                && std::equal(marker->data, marker->data + 6, "Exif\0\0"))
+            {
+                char const* data = reinterpret_cast<char const*>(marker->data);
+                exif->append(data, data + marker->data_length);
+            }
+        }
+
         if (cinfo.out_color_space != JCS_GRAYSCALE
             && cinfo.out_color_space != JCS_RGB)
             throw util::Exception("Invalid JPEG color space");
@@ -570,7 +1035,8 @@ load_jpg_file_headers (std::string const& filename)
 
 // http://download.blender.org/source/chest/blender_2.03_tree/jpeg/example.c
 void
-save_jpg_file (ByteImage::ConstPtr image, std::string const& filename, int quality)
+save_jpg_file (ByteImage::ConstPtr image, std::string const& filename,
+    int quality, bool fast)
 {
     if (image == nullptr)
         throw std::invalid_argument("Null image given");
@@ -609,6 +1075,11 @@ save_jpg_file (ByteImage::ConstPtr image, std::string const& filename, int quali
     /* Set default compression parameters. */
     jpeg_set_defaults(&cinfo);
     jpeg_set_quality(&cinfo, quality, TRUE);
+    if (fast)
+    {
+        cinfo.dct_method = JDCT_IFAST;
+        cinfo.optimize_coding = FALSE;
+    }
     jpeg_start_compress(&cinfo, TRUE);
 
     ByteImage::ImageData const& data = image->get_data();
@@ -680,6 +1151,207 @@ load_tiff_file (std::string const& filename)
     }
 }
 
+namespace
+{
+    /* Reads the headers of the current directory, which must be 8 or 16 bit. */
+    ImageHeaders
+    get_tiff_directory_headers (TIFF* tif)
+    {
+        uint32 width = 0, height = 0;
+        uint16 channels = 0, bits = 0;
+        TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+        TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &channels);
+        TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bits);
+
+        ImageHeaders headers;
+        headers.width = width;
+        headers.height = height;
+        headers.channels = channels;
+        if (bits == 8)
+            headers.type = IMAGE_TYPE_UINT8;
+        else if (bits == 16)
+            headers.type = IMAGE_TYPE_UINT16;
+        else
+            throw util::Exception("Expected 8 or 16 bit TIFF file");
+        return headers;
+    }
+
+    /* Returns the directories of the full image and the reduced levels. */
+    std::vector<tdir_t>
+    get_tiff_level_directories (TIFF* tif)
+    {
+        std::vector<tdir_t> directories;
+        tdir_t const num_directories = TIFFNumberOfDirectories(tif);
+        for (tdir_t i = 0; i < num_directories; ++i)
+        {
+            if (!TIFFSetDirectory(tif, i))
+                break;
+            uint32 subfile_type = 0;
+            TIFFGetField(tif, TIFFTAG_SUBFILETYPE, &subfile_type);
+            if (i == 0 || ((subfile_type & FILETYPE_REDUCEDIMAGE)
+                && !(subfile_type & FILETYPE_MASK)))
+                directories.push_back(i);
+        }
+        return directories;
+    }
+}  /* namespace */
+
+ImageHeaders
+load_tiff_file_headers (std::string const& filename)
+{
+    TIFFSetWarningHandler(nullptr);
+    TIFFSetErrorHandler(tiff_error_handler);
+
+    /* Opening the file reads the header and the first directory only. */
+    TIFF* tif = TIFFOpen(filename.c_str(), "r");
+    if (!tif)
+        throw util::Exception("TIFF file format not recognized");
+
+    ImageHeaders headers;
+    try
+    {
+        headers = get_tiff_directory_headers(tif);
+    }
+    catch (std::exception& e)
+    {
+        TIFFClose(tif);
+        throw;
+    }
+    TIFFClose(tif);
+    return headers;
+}
+
+std::vector<ImageHeaders>
+load_tiff_file_levels (std::string const& filename)
+{
+    TIFFSetWarningHandler(nullptr);
+    TIFFSetErrorHandler(tiff_error_handler);
+
+    TIFF* tif = TIFFOpen(filename.c_str(), "r");
+    if (!tif)
+        throw util::Exception("TIFF file format not recognized");
+
+    std::vector<ImageHeaders> levels;
+    try
+    {
+        std::vector<tdir_t> directories = get_tiff_level_directories(tif);
+        for (std::size_t i = 0; i < directories.size(); ++i)
+        {
+            if (!TIFFSetDirectory(tif, directories[i]))
+                throw util::Exception("Error reading TIFF directory");
+            levels.push_back(get_tiff_directory_headers(tif));
+        }
+    }
+    catch (std::exception& e)
+    {
+        TIFFClose(tif);
+        throw;
+    }
+    TIFFClose(tif);
+    return levels;
+}
+
+ImageBase::Ptr
+load_tiff_file_region (std::string const& filename, int level,
+    int x, int y, int width, int height)
+{
+    TIFFSetWarningHandler(nullptr);
+    TIFFSetErrorHandler(tiff_error_handler);
+
+    TIFF* tif = TIFFOpen(filename.c_str(), "r");
+    if (!tif)
+        throw util::Exception("TIFF file format not recognized");
+
+    try
+    {
+        std::vector<tdir_t> directories = get_tiff_level_directories(tif);
+        if (level < 0 || level >= static_cast<int>(directories.size()))
+            throw std::invalid_argument("Invalid TIFF pyramid level");
+        if (!TIFFSetDirectory(tif, directories[level]))
+            throw util::Exception("Error reading TIFF directory");
+
+        ImageHeaders const headers = get_tiff_directory_headers(tif);
+        if (x < 0 || y < 0 || width < 0 || height < 0
+            || x + width > headers.width || y + height > headers.height)
+            throw std::invalid_argument("Region outside of TIFF image");
+
+        uint16 planar_config = PLANARCONFIG_CONTIG;
+        TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &planar_config);
+        if (planar_config != PLANARCONFIG_CONTIG && headers.channels > 1)
+            throw util::Exception("Expected interleaved TIFF channels");
+
+        ImageBase::Ptr image = create_for_type(headers.type,
+            width, height, headers.channels);
+        std::size_t const pixel_size = headers.channels
+            * (headers.type == IMAGE_TYPE_UINT8 ? 1 : 2);
+        std::size_t const image_stride = width * pixel_size;
+        char* image_data = image->get_byte_pointer();
+
+        /* Copies the rows of a decoded block that intersect the window. */
+        std::vector<char> buffer;
+        auto copy_block = [&] (int bx, int by, int bw, int bh)
+        {
+            int const x0 = std::max(x, bx);
+            int const x1 = std::min(x + width, bx + bw);
+            int const y0 = std::max(y, by);
+            int const y1 = std::min(y + height, by + bh);
+            std::size_t const block_stride = bw * pixel_size;
+            for (int row = y0; row < y1; ++row)
+            {
+                char const* src = buffer.data() + (row - by) * block_stride
+                    + (x0 - bx) * pixel_size;
+                std::copy(src, src + (x1 - x0) * pixel_size, image_data
+                    + (row - y) * image_stride + (x0 - x) * pixel_size);
+            }
+        };
+
+        if (TIFFIsTiled(tif))
+        {
+            uint32 tile_width = 0, tile_height = 0;
+            TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width);
+            TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_height);
+            if (tile_width == 0 || tile_height == 0)
+                throw util::Exception("Invalid TIFF tile size");
+            int const tw = static_cast<int>(tile_width);
+            int const th = static_cast<int>(tile_height);
+
+            buffer.resize(TIFFTileSize(tif));
+            for (int ty = y - y % th; ty < y + height; ty += th)
+                for (int tx = x - x % tw; tx < x + width; tx += tw)
+                {
+                    if (TIFFReadTile(tif, buffer.data(), tx, ty, 0, 0) < 0)
+                        throw util::Exception("Error reading TIFF tile");
+                    copy_block(tx, ty, tw, th);
+                }
+        }
+        else
+        {
+            uint32 rows_per_strip = headers.height;
+            TIFFGetField(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+            int const sh = std::max(1, static_cast<int>(std::min
+                (rows_per_strip, static_cast<uint32>(headers.height))));
+
+            buffer.resize(TIFFStripSize(tif));
+            for (int sy = y - y % sh; sy < y + height; sy += sh)
+            {
+                tstrip_t const strip = TIFFComputeStrip(tif, sy, 0);
+                if (TIFFReadEncodedStrip(tif, strip, buffer.data(), -1) < 0)
+                    throw util::Exception("Error reading TIFF strip");
+                copy_block(0, sy, headers.width, sh);
+            }
+        }
+
+        TIFFClose(tif);
+        return image;
+    }
+    catch (std::exception& e)
+    {
+        TIFFClose(tif);
+        throw;
+    }
+}
+
 void
 save_tiff_file (ByteImage::ConstPtr image, std::string const& filename)
 {
@@ -795,68 +1467,88 @@ save_tiff_16_file (RawImage::ConstPtr image, std::string const& filename)
 /*
  * PFM file format for float images.
  * http://netpbm.sourceforge.net/doc/pfm.html
- * FIXME: Convert to C++ I/O (std::fstream)
  */
 
-FloatImage::Ptr
-load_pfm_file (std::string const& filename)
+namespace
 {
-    std::ifstream in(filename.c_str());
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
-
-    char signature[2];
-    in.read(signature, 2);
-
-    // check signature and determine channels
-    int channels = 0;
-    if (signature[0] == 'P' && signature[1] == 'f')
-        channels = 1;
-    else if (signature[0] == 'P' && signature[1] == 'F')
-        channels = 3;
-    else
+    /* Reads a whitespace delimited ASCII number of a PNM header. */
+    template <typename T>
+    bool
+    read_pnm_number (util::BinaryReader& in, T* value)
     {
-        in.close();
-        throw util::Exception("PPM signature did not match");
+        while (in.peek() != EOF && std::isspace(in.peek()))
+            in.get();
+        char token[64];
+        std::size_t len = 0;
+        while (len < sizeof(token) && in.peek() != EOF
+            && !std::isspace(in.peek()))
+            token[len++] = static_cast<char>(in.get());
+        return len > 0 && util::string::parse_number(token, token + len,
+            value) == token + len;
     }
 
-    /* Read width and height as well as max value. */
-    int width = 0;
-    int height = 0;
-    float scale = -1.0;
-    in >> width >> height >> scale;
+    /*
+     * Reads the signature, the dimensions and the max value (PPM) or the
+     * scale (PFM) of a PPM or PFM file. The signatures for 1 and 3 channel
+     * images are "P<sig_1>" and "P<sig_3>". The image data follows.
+     */
+    void
+    load_pnm_headers_intern (util::BinaryReader& in, char sig_1, char sig_3,
+        int* width, int* height, int* channels, double* value)
+    {
+        char signature[2];
+        bool const good = in.read(signature, 2) == 2;
+
+        // check signature and determine channels
+        if (good && signature[0] == 'P' && signature[1] == sig_1)
+            *channels = 1;
+        else if (good && signature[0] == 'P' && signature[1] == sig_3)
+            *channels = 3;
+        else
+            throw util::Exception("PPM signature did not match");
+
+        /* Read width and height as well as max value. */
+        *width = 0;
+        *height = 0;
+        *value = 0.0;
+        if (!read_pnm_number(in, width) || !read_pnm_number(in, height)
+            || !read_pnm_number(in, value))
+            throw util::Exception("Error reading headers");
 
-    /* Read final whitespace character. */
-    char temp;
-    in.read(&temp, 1);
+        /* Read final whitespace character. */
+        if (in.get() == EOF)
+            throw util::Exception("Error reading headers");
 
-    /* Check image width and height. Shouldn't be too large. */
-    if (width * height > PPM_MAX_PIXEL_AMOUNT)
-    {
-        in.close();
-        throw util::Exception("Image too friggin huge");
+        /* Check image width and height. Shouldn't be too large. */
+        if (*width * *height > PPM_MAX_PIXEL_AMOUNT)
+            throw util::Exception("Image too friggin huge");
     }
+}
 
-    /* Read image rows in reverse order according to PFM specification. */
-    FloatImage::Ptr image = FloatImage::create(width, height, channels);
-    std::size_t row_size = image->get_byte_size() / image->height();
-    char* ptr = reinterpret_cast<char*>(image->end()) - row_size;
-    for (int y = 0; y < height; ++y, ptr -= row_size)
-        in.read(ptr, row_size);
-    in.close();
+FloatImage::Ptr
+load_pfm_file (std::string const& filename)
+{
+    util::BinaryReader in(filename);
+
+    int width, height, channels;
+    double value;
+    load_pnm_headers_intern(in, 'f', 'F', &width, &height, &channels, &value);
+    float scale = static_cast<float>(value);
 
     /* Handle endianess. BE if scale > 0, LE if scale < 0. */
+    util::ByteOrder const order = scale < 0.0f
+        ? util::BYTE_ORDER_LITTLE_ENDIAN : util::BYTE_ORDER_BIG_ENDIAN;
     if (scale < 0.0f)
-    {
-        std::transform(image->begin(), image->end(), image->begin(),
-            (float(*)(float const&))util::system::letoh<float>);
         scale = -scale;
-    }
-    else
-    {
-        std::transform(image->begin(), image->end(), image->begin(),
-            (float(*)(float const&))util::system::betoh<float>);
-    }
+
+    /* Read image rows in reverse order according to PFM specification. */
+    FloatImage::Ptr image = FloatImage::create(width, height, channels);
+    std::size_t const row_values = static_cast<std::size_t>(width)
+        * channels;
+    for (int y = height - 1; y >= 0; --y)
+        in.read_array(image->get_data_pointer() + y * row_values,
+            row_values, order);
+    in.close();
 
     /* Handle scale. Multiply image values if scale is not 1.0. */
     if (scale != 1.0f)
@@ -868,6 +1560,19 @@ load_pfm_file (std::string const& filename)
    return image;
 }
 
+ImageHeaders
+load_pfm_file_headers (std::string const& filename)
+{
+    util::BinaryReader in(filename);
+
+    ImageHeaders headers;
+    double scale;
+    load_pnm_headers_intern(in, 'f', 'F', &headers.width, &headers.height,
+        &headers.channels, &scale);
+    headers.type = IMAGE_TYPE_FLOAT;
+    return headers;
+}
+
 void
 save_pfm_file (FloatImage::ConstPtr image, std::string const& filename)
 {
@@ -888,12 +1593,9 @@ save_pfm_file (FloatImage::ConstPtr image, std::string const& filename)
     std::string scale = "1.0"; // we currently don't support scales
 #endif
 
-    std::ofstream out(filename.c_str(), std::ios::binary);
-    if (!out.good())
-        throw util::FileException(filename, std::strerror(errno));
-
-    out << magic_number << "\n";
-    out << image->width() << " " << image->height() << " " << scale << "\n";
+    util::BinaryWriter out(filename);
+    out.write(magic_number + "\n" + util::string::get(image->width()) + " "
+        + util::string::get(image->height()) + " " + scale + "\n");
 
     /* Output rows in reverse order according to PFM specification. */
     std::size_t row_size = image->get_byte_size() / image->height();
@@ -914,41 +1616,12 @@ save_pfm_file (FloatImage::ConstPtr image, std::string const& filename)
 ImageBase::Ptr
 load_ppm_file_intern (std::string const& filename, bool bit8)
 {
-    std::ifstream in(filename.c_str());
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
-
-    char signature[2];
-    in.read(signature, 2);
-
-    // check signature and determine channels
-    int channels = 0;
-    if (signature[0] == 'P' && signature[1] == '5')
-        channels = 1;
-    else if (signature[0] == 'P' && signature[1] == '6')
-        channels = 3;
-    else
-    {
-        in.close();
-        throw util::Exception("PPM signature did not match");
-    }
-
-    /* Read width and height as well as max value. */
-    int width = 0;
-    int height = 0;
-    int maxval = 0;
-    in >> width >> height >> maxval;
+    util::BinaryReader in(filename);
 
-    /* Read final whitespace character. */
-    char temp;
-    in.read(&temp, 1);
-
-    /* Check image width and height. Shouldn't be too large. */
-    if (width * height > PPM_MAX_PIXEL_AMOUNT)
-    {
-        in.close();
-        throw util::Exception("Image too friggin huge");
-    }
+    int width, height, channels;
+    double value;
+    load_pnm_headers_intern(in, '5', '6', &width, &height, &channels, &value);
+    int const maxval = static_cast<int>(value);
 
     ImageBase::Ptr ret;
 
@@ -964,21 +1637,36 @@ load_ppm_file_intern (std::string const& filename, bool bit8)
     {
         /* Read image content, convert from big-endian to host order. */
         RawImage::Ptr image = RawImage::create(width, height, channels);
-        in.read(image->get_byte_pointer(), image->get_byte_size());
-        for (int i = 0; i < image->get_value_amount(); ++i)
-            image->at(i) = util::system::betoh(image->at(i));
+        in.read_array(image->get_data_pointer(), image->get_value_amount(),
+            util::BYTE_ORDER_BIG_ENDIAN);
         ret = image;
     }
     else
     {
-        in.close();
         throw util::Exception("PPM max value is invalid");
     }
 
-    in.close();
     return ret;
 }
 
+ImageHeaders
+load_ppm_file_headers (std::string const& filename)
+{
+    util::BinaryReader in(filename);
+
+    ImageHeaders headers;
+    double maxval;
+    load_pnm_headers_intern(in, '5', '6', &headers.width, &headers.height,
+        &headers.channels, &maxval);
+    if (maxval < 256.0)
+        headers.type = IMAGE_TYPE_UINT8;
+    else if (maxval < 65536.0)
+        headers.type = IMAGE_TYPE_UINT16;
+    else
+        throw util::Exception("PPM max value is invalid");
+    return headers;
+}
+
 RawImage::Ptr
 load_ppm_16_file (std::string const& filename)
 {
@@ -1015,12 +1703,10 @@ save_ppm_file_intern (ImageBase::ConstPtr image, std::string const& filename)
     else
         throw std::invalid_argument("Invalid image format");
 
-    std::ofstream out(filename.c_str(), std::ios::binary);
-    if (!out.good())
-        throw util::FileException(filename, std::strerror(errno));
-
-    out << magic_number << "\n";
-    out << image->width() << " " << image->height() << " " << maxval << "\n";
+    util::BinaryWriter out(filename);
+    out.write(magic_number + "\n" + util::string::get(image->width()) + " "
+        + util::string::get(image->height()) + " "
+        + util::string::get(maxval) + "\n");
 
     if (image->get_type() == IMAGE_TYPE_UINT8)
     {
@@ -1032,11 +1718,8 @@ save_ppm_file_intern (ImageBase::ConstPtr image, std::string const& filename)
         /* PPM is big-endian, so we need to convert 16 bit data. */
         RawImage::ConstPtr handle
             = std::dynamic_pointer_cast<RawImage const>(image);
-        for (int i = 0; i < handle->get_value_amount(); ++i)
-        {
-            RawImage::ValueType value = util::system::betoh(handle->at(i));
-            out.write((char const*)(&value), sizeof(RawImage::ValueType));
-        }
+        out.write_array(handle->get_data_pointer(),
+            handle->get_value_amount(), util::BYTE_ORDER_BIG_ENDIAN);
     }
     out.close();
 }
@@ -1058,60 +1741,205 @@ save_ppm_file (ByteImage::ConstPtr image, std::string const& filename)
 namespace
 {
     void
-    load_mvei_headers_intern (std::istream& in, ImageHeaders* headers)
+    load_mvei_headers_intern (util::BinaryReader& in, ImageHeaders* headers,
+        bool* compressed = nullptr)
     {
         char signature[MVEI_FILE_SIGNATURE_LEN];
-        in.read(signature, MVEI_FILE_SIGNATURE_LEN);
-        if (!std::equal(signature, signature + MVEI_FILE_SIGNATURE_LEN,
-            MVEI_FILE_SIGNATURE))
+        if (in.read(signature, MVEI_FILE_SIGNATURE_LEN)
+            != MVEI_FILE_SIGNATURE_LEN)
+            throw util::Exception("Invalid file signature");
+        bool const is_compressed = std::equal(signature,
+            signature + MVEI_FILE_SIGNATURE_LEN, MVEI_COMPRESSED_SIGNATURE);
+        if (!is_compressed && !std::equal(signature,
+            signature + MVEI_FILE_SIGNATURE_LEN, MVEI_FILE_SIGNATURE))
             throw util::Exception("Invalid file signature");
 
         /* Read image headers data, */
-        int32_t width, height, channels, raw_type;
-        in.read(reinterpret_cast<char*>(&width), sizeof(int32_t));
-        in.read(reinterpret_cast<char*>(&height), sizeof(int32_t));
-        in.read(reinterpret_cast<char*>(&channels), sizeof(int32_t));
-        in.read(reinterpret_cast<char*>(&raw_type), sizeof(int32_t));
+        int32_t const width = in.read_value<int32_t>();
+        int32_t const height = in.read_value<int32_t>();
+        int32_t const channels = in.read_value<int32_t>();
+        int32_t const raw_type = in.read_value<int32_t>();
 
-        if (!in.good())
+        if (in.eof())
             throw util::Exception("Error reading headers");
 
         headers->width = width;
         headers->height = height;
         headers->channels = channels;
         headers->type = static_cast<ImageType>(raw_type);
+        if (compressed != nullptr)
+            *compressed = is_compressed;
+    }
+
+    /*
+     * Predicts the values of the rows of a band and stores the zigzag
+     * encoded differences of the float bits as four byte planes.
+     */
+    void
+    mvei_encode_band (uint32_t const* values, int row_values,
+        int num_rows, int channels, uint8_t* planes)
+    {
+        std::size_t const num_values
+            = static_cast<std::size_t>(row_values) * num_rows;
+        for (int y = 0; y < num_rows; ++y)
+        {
+            uint32_t const* row = values + y * row_values;
+            std::size_t const offset = static_cast<std::size_t>(y)
+                * row_values;
+            for (int i = 0; i < row_values; ++i)
+            {
+                uint32_t const pred = i >= channels ? row[i - channels]
+                    : (y > 0 ? row[i - row_values] : 0);
+                uint32_t const diff = row[i] - pred;
+                uint32_t const code = (diff << 1)
+                    ^ static_cast<uint32_t>(static_cast<int32_t>(diff) >> 31);
+                planes[offset + i] = static_cast<uint8_t>(code);
+                planes[num_values + offset + i]
+                    = static_cast<uint8_t>(code >> 8);
+                planes[2 * num_values + offset + i]
+                    = static_cast<uint8_t>(code >> 16);
+                planes[3 * num_values + offset + i]
+                    = static_cast<uint8_t>(code >> 24);
+            }
+        }
+    }
+
+    /* Reconstructs the values of a band from the byte planes. */
+    void
+    mvei_decode_band (uint8_t const* planes, int row_values,
+        int num_rows, int channels, uint32_t* values)
+    {
+        std::size_t const num_values
+            = static_cast<std::size_t>(row_values) * num_rows;
+        for (int y = 0; y < num_rows; ++y)
+        {
+            uint32_t* row = values + y * row_values;
+            std::size_t const offset = static_cast<std::size_t>(y)
+                * row_values;
+            for (int i = 0; i < row_values; ++i)
+            {
+                uint32_t const code = planes[offset + i]
+                    | static_cast<uint32_t>(planes[num_values + offset + i])
+                    << 8
+                    | static_cast<uint32_t>(planes[2 * num_values
+                    + offset + i]) << 16
+                    | static_cast<uint32_t>(planes[3 * num_values
+                    + offset + i]) << 24;
+                uint32_t const diff = (code >> 1) ^ (0u - (code & 1u));
+                uint32_t const pred = i >= channels ? row[i - channels]
+                    : (y > 0 ? row[i - row_values] : 0);
+                row[i] = pred + diff;
+            }
+        }
+    }
+
+    FloatImage::Ptr
+    load_mvei_compressed_intern (util::BinaryReader& in,
+        ImageHeaders const& headers, std::string const& filename)
+    {
+        if (headers.type != IMAGE_TYPE_FLOAT || headers.width <= 0
+            || headers.height <= 0 || headers.channels <= 0)
+            throw util::Exception("Invalid compressed image headers");
+        int32_t const band_rows = in.read_value<int32_t>();
+        if (in.eof() || band_rows <= 0)
+            throw util::Exception("Invalid compressed image headers");
+
+        /* Read the table of the band sizes and the compressed bands. */
+        int const num_bands = (headers.height + band_rows - 1) / band_rows;
+        std::vector<uint64_t> offsets(num_bands + 1, 0);
+        for (int i = 0; i < num_bands; ++i)
+            offsets[i + 1] = offsets[i] + in.read_value<uint32_t>();
+        std::vector<uint8_t> data(offsets.back());
+        if (in.eof() || in.read(data.data(), data.size()) != data.size())
+            throw util::FileException(filename, "Premature end of file");
+
+        FloatImage::Ptr image = FloatImage::create(headers.width,
+            headers.height, headers.channels);
+        int const row_values = headers.width * headers.channels;
+        uint32_t* values = reinterpret_cast<uint32_t*>
+            (image->get_data_pointer());
+
+        bool failed = false;
+#pragma omp parallel
+        {
+            std::vector<uint8_t> planes;
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < num_bands; ++i)
+            {
+                int const y = i * band_rows;
+                int const num_rows = std::min(band_rows, headers.height - y);
+                uLongf size = static_cast<uLongf>(4) * row_values * num_rows;
+                planes.resize(size);
+                uLongf const expected = size;
+                int const ret = ::uncompress(planes.data(), &size,
+                    data.data() + offsets[i],
+                    static_cast<uLong>(offsets[i + 1] - offsets[i]));
+                if (ret != Z_OK || size != expected)
+                {
+#pragma omp critical
+                    failed = true;
+                    continue;
+                }
+                mvei_decode_band(planes.data(), row_values, num_rows,
+                    headers.channels, values
+                    + static_cast<std::size_t>(y) * row_values);
+            }
+        }
+        if (failed)
+            throw util::Exception(filename, ": Error decompressing image");
+
+        return image;
     }
 }
 
 ImageBase::Ptr
 load_mvei_file (std::string const& filename)
 {
-    std::ifstream in(filename.c_str(), std::ios::binary);
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryReader in(filename);
 
     /* Load image header data. */
     ImageHeaders headers;
-    load_mvei_headers_intern(in, &headers);
+    bool compressed = false;
+    load_mvei_headers_intern(in, &headers, &compressed);
     if (headers.width * headers.height > MVEI_MAX_PIXEL_AMOUNT)
         throw util::Exception("Ridiculously large image");
+    if (compressed)
+        return load_mvei_compressed_intern(in, headers, filename);
 
     /* Load image data. */
     ImageBase::Ptr image = create_for_type(headers.type,
         headers.width, headers.height, headers.channels);
-    in.read(image->get_byte_pointer(), image->get_byte_size());
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    if (in.read(image->get_byte_pointer(), image->get_byte_size())
+        != image->get_byte_size())
+        throw util::FileException(filename, "Premature end of file");
 
     return image;
 }
 
+MappedImage::Ptr
+load_mvei_file_mapped (std::string const& filename)
+{
+    util::BinaryReader in(filename);
+
+    /* Load image header data, the image data follows the headers. */
+    ImageHeaders headers;
+    bool compressed = false;
+    load_mvei_headers_intern(in, &headers, &compressed);
+    if (compressed)
+        throw util::Exception("Compressed images cannot be mapped");
+    if (headers.width * headers.height > MVEI_MAX_PIXEL_AMOUNT)
+        throw util::Exception("Ridiculously large image");
+    std::size_t const offset = in.tell();
+    in.close();
+
+    return MappedImage::create(filename, offset, headers.width,
+        headers.height, headers.channels, headers.type);
+}
+
 ImageHeaders
 load_mvei_file_headers (std::string const& filename)
 {
-    std::ifstream in(filename.c_str(), std::ios::binary);
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryReader in(filename);
 
     ImageHeaders headers;
     load_mvei_headers_intern(in, &headers);
@@ -1124,26 +1952,76 @@ save_mvei_file (ImageBase::ConstPtr image, std::string const& filename)
     if (image == nullptr)
         throw std::invalid_argument("Null image given");
 
-    int32_t width = image->width();
-    int32_t height = image->height();
-    int32_t channels = image->channels();
-    int32_t type = image->get_type();
-    char const* data = image->get_byte_pointer();
-    std::size_t size = image->get_byte_size();
-
-    std::ofstream out(filename.c_str(), std::ios::binary);
-    if (!out.good())
-        throw util::FileException(filename, std::strerror(errno));
-
+    util::BinaryWriter out(filename);
     out.write(MVEI_FILE_SIGNATURE, MVEI_FILE_SIGNATURE_LEN);
-    out.write(reinterpret_cast<char const*>(&width), sizeof(int32_t));
-    out.write(reinterpret_cast<char const*>(&height), sizeof(int32_t));
-    out.write(reinterpret_cast<char const*>(&channels), sizeof(int32_t));
-    out.write(reinterpret_cast<char const*>(&type), sizeof(int32_t));
-    out.write(data, size);
+    out.write_value<int32_t>(image->width());
+    out.write_value<int32_t>(image->height());
+    out.write_value<int32_t>(image->channels());
+    out.write_value<int32_t>(image->get_type());
+    out.write(image->get_byte_pointer(), image->get_byte_size());
+    out.close();
+}
 
-    if (!out.good())
-        throw util::FileException(filename, std::strerror(errno));
+void
+save_mvei_file_compressed (FloatImage::ConstPtr image,
+    std::string const& filename, int compression_level)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (!image->valid())
+        throw std::invalid_argument("Empty image given");
+
+    int const height = image->height();
+    int const row_values = image->width() * image->channels();
+    int const band_rows = MVEI_COMPRESSED_BAND_ROWS;
+    int const num_bands = (height + band_rows - 1) / band_rows;
+    uint32_t const* values = reinterpret_cast<uint32_t const*>
+        (image->get_data_pointer());
+
+    std::vector<std::vector<uint8_t> > bands(num_bands);
+    bool failed = false;
+#pragma omp parallel
+    {
+        std::vector<uint8_t> planes;
+#pragma omp for schedule(dynamic)
+        for (int i = 0; i < num_bands; ++i)
+        {
+            int const y = i * band_rows;
+            int const num_rows = std::min(band_rows, height - y);
+            uLong const size = static_cast<uLong>(4) * row_values * num_rows;
+            planes.resize(size);
+            mvei_encode_band(values + static_cast<std::size_t>(y)
+                * row_values, row_values, num_rows, image->channels(),
+                planes.data());
+
+            uLongf stored_size = ::compressBound(size);
+            bands[i].resize(stored_size);
+            int const ret = ::compress2(bands[i].data(), &stored_size,
+                planes.data(), size, compression_level);
+            if (ret != Z_OK)
+            {
+#pragma omp critical
+                failed = true;
+                continue;
+            }
+            bands[i].resize(stored_size);
+        }
+    }
+    if (failed)
+        throw util::Exception(filename, ": Error compressing image");
+
+    util::BinaryWriter out(filename);
+    out.write(MVEI_COMPRESSED_SIGNATURE, MVEI_FILE_SIGNATURE_LEN);
+    out.write_value<int32_t>(image->width());
+    out.write_value<int32_t>(image->height());
+    out.write_value<int32_t>(image->channels());
+    out.write_value<int32_t>(image->get_type());
+    out.write_value<int32_t>(band_rows);
+    for (int i = 0; i < num_bands; ++i)
+        out.write_value<uint32_t>(static_cast<uint32_t>(bands[i].size()));
+    for (int i = 0; i < num_bands; ++i)
+        out.write(bands[i].data(), bands[i].size());
+    out.close();
 }
 
 CORE_IMAGE_NAMESPACE_END
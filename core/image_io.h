@@ -10,10 +10,13 @@
 #ifndef MVE_IMAGE_FILE_HEADER
 #define MVE_IMAGE_FILE_HEADER
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "core/defines.h"
 #include "core/image.h"
+#include "core/image_mapped.h"
 
 CORE_NAMESPACE_BEGIN
 CORE_IMAGE_NAMESPACE_BEGIN
@@ -53,12 +56,32 @@ ByteImage::Ptr
 load_file (std::string const& filename);
 
 /**
- * Loads the image headers, detecting file type.
+ * Loads the image headers, detecting file type. Only the headers are read
+ * for all supported formats, the image data is not decoded.
  * May throw util::Exception.
  */
 ImageHeaders
 load_file_headers (std::string const& filename);
 
+/**
+ * Loads the image headers of several files in parallel, in the order of
+ * the file names. The headers of files that cannot be loaded have zero
+ * dimensions and IMAGE_TYPE_UNKNOWN. Returns the number of these files.
+ */
+std::size_t
+load_file_headers (std::vector<std::string> const& filenames,
+    std::vector<ImageHeaders>* headers);
+
+/**
+ * Loads the image headers of all images in a directory in parallel.
+ * The file names are absolute and sorted, files that are not images are
+ * skipped. Returns the number of images.
+ * May throw util::Exception if the directory cannot be read.
+ */
+std::size_t
+load_directory_headers (std::string const& path,
+    std::vector<std::string>* filenames, std::vector<ImageHeaders>* headers);
+
 /**
  * Saves a byte image to file, detecting file type.
  * May throw util::Exception.
@@ -118,6 +141,47 @@ void
 save_png_file (ByteImage::ConstPtr image,
     std::string const& filename, int compression_level = 1);
 
+/** The row filters that PNG encoding may choose from. */
+enum PngFilters
+{
+    /** Choose the best filter for every row, the libpng default. */
+    PNG_FILTERS_ADAPTIVE,
+    /** No filtering, which is fastest but compresses worst. */
+    PNG_FILTERS_NONE,
+    /** The difference to the left pixel, fast and often good enough. */
+    PNG_FILTERS_SUB,
+    /** The difference to the pixel above. */
+    PNG_FILTERS_UP,
+    /** The Paeth predictor, slow but good for photographs. */
+    PNG_FILTERS_PAETH
+};
+
+/** Encoding options for PNG files. */
+struct PngSaveOptions
+{
+    PngSaveOptions (void);
+
+    /** The zlib compression level in [0, 9], 0 is fastest. Defaults to 1. */
+    int compression_level;
+    /** The row filters. Defaults to PNG_FILTERS_ADAPTIVE. */
+    PngFilters filters;
+    /**
+     * The number of threads, 0 uses all available cores. With more than
+     * one thread, bands of rows are filtered and compressed in parallel and
+     * joined at zlib flush points, which costs little compression. Defaults
+     * to 1, which encodes with libpng.
+     */
+    int num_threads;
+};
+
+/**
+ * Saves image data to a PNG file with the given encoding options.
+ * May throw util::FileException and util::Exception.
+ */
+void
+save_png_file (ByteImage::ConstPtr image, std::string const& filename,
+    PngSaveOptions const& options);
+
 #endif /* MVE_NO_PNG_SUPPORT */
 
 /* ------------------------- JPEG support ------------------------- */
@@ -127,26 +191,37 @@ save_png_file (ByteImage::ConstPtr image,
 /**
  * Loads a JPEG file. The EXIF data blob may be loaded into 'exif'.
  * JPEGs have 1 (gray values) or 3 (RGB) channels.
+ *
+ * The image can be downscaled by a factor of 2, 4 or 8 during decoding,
+ * which is done in the DCT domain by libjpeg and is much faster than a
+ * full decode followed by rescaling. The downscaled dimensions are rounded
+ * up like rescale_half_size(), e.g. (width + 1) / 2.
  * May throw util::FileException and util::Exception.
  */
 ByteImage::Ptr
-load_jpg_file (std::string const& filename, std::string* exif = nullptr);
+load_jpg_file (std::string const& filename, std::string* exif = nullptr,
+    int downscale = 1);
 
 /**
- * Loads JPEG file headers only.
+ * Loads JPEG file headers only. The EXIF data blob may be loaded into
+ * 'exif', which is read with the headers without decoding the image.
  * May throw util::FileException and util::Exception.
  */
 ImageHeaders
-load_jpg_file_headers (std::string const& filename);
+load_jpg_file_headers (std::string const& filename,
+    std::string* exif = nullptr);
 
 /**
  * Saves image data to a JPEG file. Supports 1 and 3 channel images.
  * The quality value is in range [0, 100] from worst to best quality.
+ * The fast mode uses the fast integer DCT, which is slightly less accurate
+ * at high quality, and no Huffman table optimization. The SIMD code paths
+ * of libjpeg-turbo are used in either mode where available.
  * May throw util::FileException and util::Exception.
  */
 void
 save_jpg_file (ByteImage::ConstPtr image,
-    std::string const& filename, int quality);
+    std::string const& filename, int quality, bool fast = false);
 
 #endif /* MVE_NO_JPEG_SUPPORT */
 
@@ -161,6 +236,13 @@ save_jpg_file (ByteImage::ConstPtr image,
 ByteImage::Ptr
 load_tiff_file (std::string const& filename);
 
+/**
+ * Loads the TIFF file headers only, of 8 or 16 bit files.
+ * May throw util::Exception.
+ */
+ImageHeaders
+load_tiff_file_headers (std::string const& filename);
+
 /**
  * Writes a TIFF to file. Supports any number of channels.
  * May throw util::FileException and util::Exception.
@@ -182,6 +264,27 @@ load_tiff_16_file (std::string const& filename);
 void
 save_tiff_16_file (RawImage::ConstPtr image, std::string const& filename);
 
+/**
+ * Loads the headers of all pyramid levels of an 8 or 16 bit TIFF file.
+ * Level 0 is the full image, further levels are the directories that are
+ * marked as reduced resolution images, in the order of the file.
+ * May throw util::Exception.
+ */
+std::vector<ImageHeaders>
+load_tiff_file_levels (std::string const& filename);
+
+/**
+ * Loads a window of one pyramid level of an 8 or 16 bit TIFF file and
+ * returns a ByteImage or RawImage. Only the tiles or strips that intersect
+ * the window are decoded, so that windows and reduced levels of huge tiled
+ * images can be read with bounded memory. BigTIFF files are supported.
+ * Throws std::invalid_argument if the window is not inside the level.
+ * May throw util::Exception.
+ */
+ImageBase::Ptr
+load_tiff_file_region (std::string const& filename, int level,
+    int x, int y, int width, int height);
+
 #endif /* MVE_NO_TIFF_SUPPORT */
 
 /* -------------------------- PFM support ------------------------- */
@@ -194,6 +297,13 @@ save_tiff_16_file (RawImage::ConstPtr image, std::string const& filename);
 FloatImage::Ptr
 load_pfm_file (std::string const& filename);
 
+/**
+ * Loads the PFM file headers only.
+ * May throw util::FileException and util::Exception.
+ */
+ImageHeaders
+load_pfm_file_headers (std::string const& filename);
+
 /**
  * Saves float image data to PFM file. Supports 1 and 3 channel images.
  * May throw util::FileException and util::Exception.
@@ -226,6 +336,13 @@ save_ppm_16_file (RawImage::ConstPtr image, std::string const& filename);
 ByteImage::Ptr
 load_ppm_file (std::string const& filename);
 
+/**
+ * Loads the headers of 8 or 16 bit PPM files only.
+ * May throw util::FileException and util::Exception.
+ */
+ImageHeaders
+load_ppm_file_headers (std::string const& filename);
+
 /**
  * Writes a 8 bit PPM file. Supports 1 and 3 channel images.
  * May throw util::FileException and std::invalid_argument.
@@ -237,12 +354,23 @@ save_ppm_file (ByteImage::ConstPtr image, std::string const& filename);
 
 /**
  * Loads a native MVE image. Supports arbitrary type, size and depth,
- * with a primitive, uncompressed format.
+ * with a primitive, uncompressed format. Compressed float images (see
+ * save_mvei_file_compressed()) are detected and decoded in parallel.
  * May throw util::FileException.
  */
 ImageBase::Ptr
 load_mvei_file (std::string const& filename);
 
+/**
+ * Loads a native MVE image by memory-mapping the file instead of reading
+ * it, which is O(1) and shares the pages with other processes. The data is
+ * copy-on-write and not aligned for the value type, see MappedImage.
+ * Compressed images cannot be mapped.
+ * May throw util::FileException and util::Exception.
+ */
+MappedImage::Ptr
+load_mvei_file_mapped (std::string const& filename);
+
 /**
  * Loads the meta information for a native MVE image.
  */
@@ -257,6 +385,34 @@ load_mvei_file_headers (std::string const& filename);
 void
 save_mvei_file (ImageBase::ConstPtr image, std::string const& filename);
 
+/**
+ * Writes a float image as losslessly compressed native MVE image, which is
+ * meant for depth, normal and confidence maps. Every value is predicted by
+ * the value to its left (or above, at the start of a row), the difference
+ * of the float bits is zigzag encoded and the bytes of the differences are
+ * stored as separate planes. The planes are compressed with zlib, in bands
+ * of rows that are encoded and decoded in parallel. The compression level
+ * is a zlib level, where 1 is fastest.
+ * May throw util::FileException and util::Exception.
+ */
+void
+save_mvei_file_compressed (FloatImage::ConstPtr image,
+    std::string const& filename, int compression_level = 1);
+
+/* ------------------------ Implementation ------------------------ */
+
+#ifndef MVE_NO_PNG_SUPPORT
+
+inline
+PngSaveOptions::PngSaveOptions (void)
+    : compression_level(1)
+    , filters(PNG_FILTERS_ADAPTIVE)
+    , num_threads(1)
+{
+}
+
+#endif /* MVE_NO_PNG_SUPPORT */
+
 CORE_IMAGE_NAMESPACE_END
 CORE_NAMESPACE_END
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <memory>
+#include <utility>
+
+#include "util/thread_pool.h"
+#include "core/image_io.h"
+#include "core/image_loader.h"
+
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
+
+void
+ImageLoader::init (Options const& options)
+{
+    this->decoder = options.decoder;
+    if (!this->decoder)
+        this->decoder = [] (std::string const& filename)
+            { return load_file(filename); };
+    this->encoder = options.encoder;
+    if (!this->encoder)
+        this->encoder = [] (ByteImage::ConstPtr image,
+            std::string const& filename) { save_file(image, filename); };
+
+    this->num_threads = static_cast<std::size_t>(
+        util::ThreadPool::resolve_num_threads(options.num_threads));
+    this->max_queued = options.max_queued > 0
+        ? options.max_queued : 2 * this->num_threads;
+}
+
+/* ---------------------------------------------------------------- */
+
+ImageLoader::~ImageLoader (void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->finished.wait(lock, [this] (void)
+        { return this->num_active == 0; });
+}
+
+/* ---------------------------------------------------------------- */
+
+std::future<ByteImage::Ptr>
+ImageLoader::load (std::string const& filename)
+{
+    /* The task is shared because std::function must be copyable. */
+    Decoder const& decode = this->decoder;
+    std::shared_ptr<std::packaged_task<ByteImage::Ptr ()> > task
+        = std::make_shared<std::packaged_task<ByteImage::Ptr ()> >
+        ([decode, filename] (void) { return decode(filename); });
+    std::future<ByteImage::Ptr> result = task->get_future();
+    this->enqueue([task] (void) { (*task)(); });
+    return result;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::future<void>
+ImageLoader::save (ByteImage::ConstPtr image, std::string const& filename)
+{
+    Encoder const& encode = this->encoder;
+    std::shared_ptr<std::packaged_task<void ()> > task
+        = std::make_shared<std::packaged_task<void ()> >
+        ([encode, image, filename] (void) { encode(image, filename); });
+    std::future<void> result = task->get_future();
+    this->enqueue([task] (void) { (*task)(); });
+    return result;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ImageLoader::enqueue (std::function<void (void)> const& task)
+{
+    /* Pool workers must not block on tasks that need other workers. */
+    util::ThreadPool& pool = util::ThreadPool::get_global();
+    if (pool.is_worker_thread())
+    {
+        task();
+        return;
+    }
+
+    bool start_task = false;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->queue_not_full.wait(lock, [this] (void)
+            { return this->queue.size() < this->max_queued; });
+        this->queue.push_back(task);
+        if (this->num_active < this->num_threads)
+        {
+            this->num_active += 1;
+            start_task = true;
+        }
+    }
+    if (start_task)
+        pool.run([this] (void) { this->process_queue(); });
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ImageLoader::process_queue (void)
+{
+    while (true)
+    {
+        std::function<void (void)> task;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->queue.empty())
+            {
+                this->num_active -= 1;
+                if (this->num_active == 0)
+                    this->finished.notify_all();
+                return;
+            }
+            task = std::move(this->queue.front());
+            this->queue.pop_front();
+        }
+        this->queue_not_full.notify_one();
+
+        /* Exceptions of the codecs are stored in the futures. */
+        task();
+    }
+}
+
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
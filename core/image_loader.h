@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_IMAGE_LOADER_HEADER
+#define MVE_IMAGE_LOADER_HEADER
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+
+#include "core/defines.h"
+#include "core/image.h"
+
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
+
+/**
+ * Asynchronous image loading and saving in tasks of util::ThreadPool.
+ *
+ * Images are decoded and encoded by tasks of the global pool and the
+ * results are returned as futures, so the caller can overlap file I/O and
+ * coding with computation. The queue of requests that have not started is
+ * bounded: load() and save() block while the queue is full, which keeps
+ * the memory of the images in bounds when the caller and the pool run at
+ * different speeds. Requests from tasks of the global pool are processed
+ * immediately in the calling thread, which never waits for other workers.
+ * Exceptions of the codecs are rethrown by std::future::get(). The
+ * destructor finishes all queued requests.
+ */
+class ImageLoader
+{
+public:
+    /** Decodes one image, load_file() by default. */
+    typedef std::function<ByteImage::Ptr (std::string const&)> Decoder;
+    /** Encodes one image, save_file() by default. */
+    typedef std::function<void (ByteImage::ConstPtr, std::string const&)>
+        Encoder;
+
+    /** Options for the image loader. */
+    struct Options
+    {
+        Options (void);
+
+        /**
+         * The maximum number of concurrent codec tasks. 0 uses the
+         * process-wide thread count of util::ThreadPool, or 1 within
+         * parallel stages.
+         */
+        int num_threads;
+        /**
+         * The maximum number of queued requests before load() and save()
+         * block, 0 uses twice the number of threads.
+         */
+        std::size_t max_queued;
+        /** The image decoder, load_file() if empty. */
+        Decoder decoder;
+        /** The image encoder, save_file() if empty. */
+        Encoder encoder;
+    };
+
+public:
+    ImageLoader (void);
+    explicit ImageLoader (Options const& options);
+    ~ImageLoader (void);
+    ImageLoader (ImageLoader const& other) = delete;
+    ImageLoader& operator= (ImageLoader const& other) = delete;
+
+    /** Queues the image for loading, blocks while the queue is full. */
+    std::future<ByteImage::Ptr> load (std::string const& filename);
+
+    /**
+     * Queues the image for saving, blocks while the queue is full. The
+     * image must not be modified until the future is ready.
+     */
+    std::future<void> save (ByteImage::ConstPtr image,
+        std::string const& filename);
+
+    /** Returns the maximum number of concurrent codec tasks. */
+    std::size_t get_num_threads (void) const;
+
+private:
+    void init (Options const& options);
+    void enqueue (std::function<void (void)> const& task);
+    void process_queue (void);
+
+private:
+    Decoder decoder;
+    Encoder encoder;
+    std::size_t max_queued;
+    std::size_t num_threads;
+    /* The number of pool tasks that process the queue. */
+    std::size_t num_active;
+    std::deque<std::function<void (void)> > queue;
+    std::mutex mutex;
+    std::condition_variable queue_not_full;
+    std::condition_variable finished;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+ImageLoader::Options::Options (void)
+    : num_threads(0)
+    , max_queued(0)
+{
+}
+
+inline
+ImageLoader::ImageLoader (void)
+    : max_queued(0)
+    , num_threads(0)
+    , num_active(0)
+{
+    this->init(Options());
+}
+
+inline
+ImageLoader::ImageLoader (Options const& options)
+    : max_queued(0)
+    , num_threads(0)
+    , num_active(0)
+{
+    this->init(options);
+}
+
+inline std::size_t
+ImageLoader::get_num_threads (void) const
+{
+    return this->num_threads;
+}
+
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
+
+#endif /* MVE_IMAGE_LOADER_HEADER */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+
+#ifndef _WIN32
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "util/exception.h"
+#include "util/strings.h"
+#include "core/image.h"
+#include "core/image_mapped.h"
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    char const*
+    get_string_for_type (ImageType type)
+    {
+        switch (type)
+        {
+            case IMAGE_TYPE_UINT8: return util::string::for_type<uint8_t>();
+            case IMAGE_TYPE_UINT16: return util::string::for_type<uint16_t>();
+            case IMAGE_TYPE_UINT32: return util::string::for_type<uint32_t>();
+            case IMAGE_TYPE_UINT64: return util::string::for_type<uint64_t>();
+            case IMAGE_TYPE_SINT8: return util::string::for_type<int8_t>();
+            case IMAGE_TYPE_SINT16: return util::string::for_type<int16_t>();
+            case IMAGE_TYPE_SINT32: return util::string::for_type<int32_t>();
+            case IMAGE_TYPE_SINT64: return util::string::for_type<int64_t>();
+            case IMAGE_TYPE_FLOAT: return util::string::for_type<float>();
+            case IMAGE_TYPE_DOUBLE: return util::string::for_type<double>();
+            default: break;
+        }
+        return "unknown";
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+MappedImage::Ptr
+MappedImage::create (std::string const& filename, std::size_t offset,
+    int width, int height, int channels, ImageType type)
+{
+    int const value_size = util::string::size_for_type_string
+        (get_string_for_type(type));
+    if (width < 0 || height < 0 || channels < 0 || value_size <= 0)
+        throw util::Exception("Invalid image dimensions or type");
+
+    Ptr image(new MappedImage);
+    image->w = width;
+    image->h = height;
+    image->c = channels;
+    image->type = type;
+    image->offset = offset;
+    image->byte_size = static_cast<std::size_t>(width) * height * channels
+        * value_size;
+
+#ifdef _WIN32
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        throw util::FileException(filename, std::strerror(errno));
+    in.seekg(0, std::ios::end);
+    image->buffer.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(image->buffer.data(),
+        static_cast<std::streamsize>(image->buffer.size()));
+    if (in.fail())
+        throw util::FileException(filename, "Error reading file");
+    image->mapping = image->buffer.data();
+    image->mapping_size = image->buffer.size();
+#else
+    int const fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw util::FileException(filename, std::strerror(errno));
+    struct stat statbuf;
+    if (::fstat(fd, &statbuf) < 0)
+    {
+        int const error = errno;
+        ::close(fd);
+        throw util::FileException(filename, std::strerror(error));
+    }
+    std::size_t const file_size = static_cast<std::size_t>(statbuf.st_size);
+    if (file_size < offset + image->byte_size || file_size == 0)
+    {
+        ::close(fd);
+        throw util::FileException(filename, "File too small for image");
+    }
+
+    /* A private writable mapping of a read-only file is copy-on-write. */
+    void* mapping = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE, fd, 0);
+    int const error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw util::FileException(filename, std::strerror(error));
+    image->mapping = static_cast<char*>(mapping);
+    image->mapping_size = file_size;
+#endif
+
+    if (image->mapping_size < offset + image->byte_size)
+        throw util::FileException(filename, "File too small for image");
+
+    return image;
+}
+
+/* ---------------------------------------------------------------- */
+
+MappedImage::~MappedImage (void)
+{
+#ifndef _WIN32
+    if (this->mapping != nullptr && this->buffer.empty())
+        ::munmap(this->mapping, this->mapping_size);
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+ImageBase::Ptr
+MappedImage::duplicate_base (void) const
+{
+    ImageBase::Ptr image = image::create_for_type(this->type,
+        this->w, this->h, this->c);
+    std::copy(this->get_byte_pointer(),
+        this->get_byte_pointer() + this->byte_size,
+        image->get_byte_pointer());
+    return image;
+}
+
+/* ---------------------------------------------------------------- */
+
+char const*
+MappedImage::get_type_string (void) const
+{
+    return get_string_for_type(this->type);
+}
+
+CORE_NAMESPACE_END
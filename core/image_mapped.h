@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_IMAGE_MAPPED_HEADER
+#define MVE_IMAGE_MAPPED_HEADER
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/defines.h"
+#include "core/image_base.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * An image whose data are the pages of a memory-mapped file.
+ *
+ * Creating the image maps the file in O(1) instead of reading it, the pages
+ * are loaded on access and are shared with other processes that map the
+ * same file. The mapping is copy-on-write: the data can be modified, but
+ * modified pages are private to the image and the file is never changed.
+ *
+ * The data starts at an arbitrary offset in the file and is in general not
+ * aligned for the value type, e.g. at byte 27 for MVEI files. Values must
+ * thus be accessed with at(), which does not assume alignment, or through
+ * the byte pointer. duplicate_base() returns a regular typed image.
+ * Where files cannot be mapped, the data is read into memory instead.
+ */
+class MappedImage : public ImageBase
+{
+public:
+    typedef std::shared_ptr<MappedImage> Ptr;
+    typedef std::shared_ptr<MappedImage const> ConstPtr;
+
+public:
+    /**
+     * Maps the image data of the given dimensions and type, which starts
+     * at 'offset' in the file. Throws if the file is too small.
+     */
+    static Ptr create (std::string const& filename, std::size_t offset,
+        int width, int height, int channels, ImageType type);
+
+    virtual ~MappedImage (void);
+    MappedImage (MappedImage const& other) = delete;
+    MappedImage& operator= (MappedImage const& other) = delete;
+
+    /** Returns a regular image with a copy of the data. */
+    virtual ImageBase::Ptr duplicate_base (void) const;
+
+    /** Returns the value at the given index, T must match the type. */
+    template <typename T>
+    T at (int index) const;
+    /** Returns the value at the given pixel and channel. */
+    template <typename T>
+    T at (int x, int y, int channel) const;
+
+    virtual std::size_t get_byte_size (void) const;
+    virtual char const* get_byte_pointer (void) const;
+    virtual char* get_byte_pointer (void);
+    virtual ImageType get_type (void) const;
+    virtual char const* get_type_string (void) const;
+
+protected:
+    MappedImage (void);
+
+private:
+    ImageType type;
+    /* The mapping of the file, the data starts at the offset. */
+    char* mapping;
+    std::size_t mapping_size;
+    std::size_t offset;
+    std::size_t byte_size;
+    /* The file contents where files cannot be mapped. */
+    std::vector<char> buffer;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+MappedImage::MappedImage (void)
+    : type(IMAGE_TYPE_UNKNOWN)
+    , mapping(nullptr)
+    , mapping_size(0)
+    , offset(0)
+    , byte_size(0)
+{
+}
+
+template <typename T>
+inline T
+MappedImage::at (int index) const
+{
+    T value;
+    std::memcpy(&value, this->get_byte_pointer() + index * sizeof(T),
+        sizeof(T));
+    return value;
+}
+
+template <typename T>
+inline T
+MappedImage::at (int x, int y, int channel) const
+{
+    return this->at<T>(channel + this->c * (x + y * this->w));
+}
+
+inline std::size_t
+MappedImage::get_byte_size (void) const
+{
+    return this->byte_size;
+}
+
+inline char const*
+MappedImage::get_byte_pointer (void) const
+{
+    return this->mapping + this->offset;
+}
+
+inline char*
+MappedImage::get_byte_pointer (void)
+{
+    return this->mapping + this->offset;
+}
+
+inline ImageType
+MappedImage::get_type (void) const
+{
+    return this->type;
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_IMAGE_MAPPED_HEADER */
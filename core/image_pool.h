@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_IMAGE_POOL_HEADER
+#define MVE_IMAGE_POOL_HEADER
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "core/defines.h"
+#include "core/image.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * Pool of images that recycles image storage. The pool keeps a reference
+ * to every image it hands out. Once all other references to an image are
+ * released, the image is handed out again by the next request with the
+ * same dimensions. This avoids repeated allocations if many images with
+ * the same dimensions are processed. The content of images handed out by
+ * the pool is undefined. Requesting images is thread-safe.
+ */
+template <typename T>
+class ImagePool
+{
+public:
+    typedef typename Image<T>::Ptr ImagePtr;
+
+public:
+    ImagePool (void) = default;
+    ImagePool (ImagePool<T> const& other) = delete;
+    ImagePool<T>& operator= (ImagePool<T> const& other) = delete;
+
+    /** Returns an unused image from the pool or allocates a new one. */
+    ImagePtr acquire (int width, int height, int channels);
+
+    /** Drops all images from the pool. Images in use stay valid. */
+    void clear (void);
+
+    /** Returns the amount of images in the pool, including used ones. */
+    std::size_t size (void) const;
+
+    /** Returns the memory consumption of all images in the pool. */
+    std::size_t get_byte_size (void) const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<ImagePtr> images;
+};
+
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+typename ImagePool<T>::ImagePtr
+ImagePool<T>::acquire (int width, int height, int channels)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (std::size_t i = 0; i < this->images.size(); ++i)
+    {
+        ImagePtr const& img = this->images[i];
+        if (img.use_count() == 1 && img->width() == width
+            && img->height() == height && img->channels() == channels)
+            return img;
+    }
+
+    this->images.push_back(Image<T>::create(width, height, channels));
+    return this->images.back();
+}
+
+template <typename T>
+inline void
+ImagePool<T>::clear (void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->images.clear();
+}
+
+template <typename T>
+inline std::size_t
+ImagePool<T>::size (void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->images.size();
+}
+
+template <typename T>
+inline std::size_t
+ImagePool<T>::get_byte_size (void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::size_t ret = 0;
+    for (std::size_t i = 0; i < this->images.size(); ++i)
+        ret += this->images[i]->get_byte_size();
+    return ret;
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_IMAGE_POOL_HEADER */
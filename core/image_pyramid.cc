@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <stdexcept>
+
+#include "core/image_pyramid.h"
+#include "core/image_tools.h"
+
+CORE_NAMESPACE_BEGIN
+
+ImagePyramid::ImagePyramid (ImageBase::ConstPtr image)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (image->get_type() != IMAGE_TYPE_UINT8
+        && image->get_type() != IMAGE_TYPE_FLOAT)
+        throw std::invalid_argument("Pyramids need byte or float images");
+    if (!image->valid())
+        throw std::invalid_argument("Empty image given");
+
+    this->type = image->get_type();
+    this->width = image->width();
+    this->height = image->height();
+    this->num_levels = 1;
+    for (int w = this->width, h = this->height; w > 1 && h > 1;
+        w = (w + 1) >> 1, h = (h + 1) >> 1)
+        this->num_levels += 1;
+
+    this->levels.reserve(this->num_levels);
+    this->levels.push_back(image);
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+ImagePyramid::get_width (int level) const
+{
+    if (level < 0 || level >= this->num_levels)
+        throw std::invalid_argument("Invalid pyramid level");
+    int ret = this->width;
+    for (int i = 0; i < level; ++i)
+        ret = (ret + 1) >> 1;
+    return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+ImagePyramid::get_height (int level) const
+{
+    if (level < 0 || level >= this->num_levels)
+        throw std::invalid_argument("Invalid pyramid level");
+    int ret = this->height;
+    for (int i = 0; i < level; ++i)
+        ret = (ret + 1) >> 1;
+    return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+ImageBase::ConstPtr
+ImagePyramid::get_level (int level) const
+{
+    if (level < 0 || level >= this->num_levels)
+        throw std::invalid_argument("Invalid pyramid level");
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    while (static_cast<int>(this->levels.size()) <= level)
+    {
+        ImageBase::ConstPtr prev = this->levels.back();
+        if (this->type == IMAGE_TYPE_UINT8)
+            this->levels.push_back(image::rescale_half_size_gaussian<uint8_t>(
+                std::static_pointer_cast<ByteImage const>(prev)));
+        else
+            this->levels.push_back(image::rescale_half_size_gaussian<float>(
+                std::static_pointer_cast<FloatImage const>(prev)));
+    }
+    return this->levels[level];
+}
+
+/* ---------------------------------------------------------------- */
+
+ByteImage::ConstPtr
+ImagePyramid::get_byte_level (int level) const
+{
+    if (this->type != IMAGE_TYPE_UINT8)
+        throw std::logic_error("Pyramid is not of type UINT8");
+    return std::static_pointer_cast<ByteImage const>(this->get_level(level));
+}
+
+/* ---------------------------------------------------------------- */
+
+FloatImage::ConstPtr
+ImagePyramid::get_float_level (int level) const
+{
+    if (this->type != IMAGE_TYPE_FLOAT)
+        throw std::logic_error("Pyramid is not of type FLOAT");
+    return std::static_pointer_cast<FloatImage const>(this->get_level(level));
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+ImagePyramid::get_num_computed_levels (void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return static_cast<int>(this->levels.size());
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+ImagePyramid::get_byte_size (void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::size_t ret = 0;
+    for (std::size_t i = 1; i < this->levels.size(); ++i)
+        ret += this->levels[i]->get_byte_size();
+    return ret;
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_IMAGE_PYRAMID_HEADER
+#define MVE_IMAGE_PYRAMID_HEADER
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "core/defines.h"
+#include "core/image_base.h"
+#include "core/image.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * A pyramid of half-size levels of a byte or float image. Level 0 is the
+ * image itself, every further level is computed from the previous level
+ * with rescale_half_size_gaussian() when it is first requested. The last
+ * level has a width or height of one pixel.
+ *
+ * The pyramid references the image, which must not be modified while it
+ * is in use. Views cache one pyramid per image (see View::get_image_pyramid)
+ * so that all consumers share the levels instead of resampling the image
+ * again. Requesting levels is thread-safe.
+ */
+class ImagePyramid
+{
+public:
+    typedef std::shared_ptr<ImagePyramid> Ptr;
+    typedef std::shared_ptr<ImagePyramid const> ConstPtr;
+
+public:
+    /** Creates a pyramid of an image of type UINT8 or FLOAT. */
+    static Ptr create (ImageBase::ConstPtr image);
+
+    ImagePyramid (ImagePyramid const& other) = delete;
+    ImagePyramid& operator= (ImagePyramid const& other) = delete;
+
+    /** Returns the type of the levels. */
+    ImageType get_type (void) const;
+
+    /** Returns the number of levels including the image itself. */
+    int get_num_levels (void) const;
+    /** Returns the dimensions of a level without computing it. */
+    int get_width (int level) const;
+    int get_height (int level) const;
+
+    /** Returns a level, which is computed with all levels before it. */
+    ImageBase::ConstPtr get_level (int level) const;
+    /** Returns a level of a pyramid of type UINT8, or throws. */
+    ByteImage::ConstPtr get_byte_level (int level) const;
+    /** Returns a level of a pyramid of type FLOAT, or throws. */
+    FloatImage::ConstPtr get_float_level (int level) const;
+
+    /** Returns the number of levels that have been computed. */
+    int get_num_computed_levels (void) const;
+
+    /** Returns the memory of the computed levels except level 0. */
+    std::size_t get_byte_size (void) const;
+
+protected:
+    explicit ImagePyramid (ImageBase::ConstPtr image);
+
+private:
+    mutable std::mutex mutex;
+    mutable std::vector<ImageBase::ConstPtr> levels;
+    ImageType type;
+    int width;
+    int height;
+    int num_levels;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline ImagePyramid::Ptr
+ImagePyramid::create (ImageBase::ConstPtr image)
+{
+    return Ptr(new ImagePyramid(image));
+}
+
+inline ImageType
+ImagePyramid::get_type (void) const
+{
+    return this->type;
+}
+
+inline int
+ImagePyramid::get_num_levels (void) const
+{
+    return this->num_levels;
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_IMAGE_PYRAMID_HEADER */
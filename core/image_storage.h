@@ -0,0 +1,471 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_IMAGE_STORAGE_HEADER
+#define MVE_IMAGE_STORAGE_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#include "util/aligned_allocator.h"
+#include "util/memory.h"
+#include "core/defines.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * Storage for image values, which replaces std::vector in images.
+ *
+ * The storage either owns its memory, which is aligned to 64 bytes for
+ * SIMD code, or it is a view of an external buffer, e.g. a decoder or a
+ * staging buffer, which is kept alive by an optional owner. Views are
+ * written through to the buffer. Copies of views always own their memory,
+ * and a view is copied into owned memory if it grows.
+ *
+ * Copies of owned memory are copy-on-write: they share the values until
+ * one of the copies is accessed through a mutable accessor or resized,
+ * which then copies the values. Read-only consumers of a copy, e.g. of
+ * an image of a view, thus never copy the values if they only use the
+ * const accessors. Pointers from mutable accessors must not be kept
+ * across copies of the storage.
+ *
+ * Like std::vector, storages may be read by several threads at once,
+ * also through the mutable accessors. The copy on the first mutable
+ * access, the copies that share values and the release of shared values
+ * are serialized by a mutex, and the lock-free check of the mutable
+ * accessors synchronizes with them. A storage must not be copied while
+ * other threads access it through mutable accessors, because the copy
+ * makes the next mutable access move the values.
+ *
+ * The interface is the subset of std::vector that is used by images, with
+ * raw pointers as iterators. Like std::vector, resize() initializes new
+ * values, and resize_uninitialized() can be used if all values are going
+ * to be overwritten anyway. Only trivially copyable types are supported.
+ * Owned memory is accounted as util::MEMORY_IMAGES.
+ */
+template <typename T>
+class ImageStorage
+{
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef T const* const_iterator;
+    typedef std::size_t size_type;
+
+    /** The alignment of owned memory in bytes. */
+    static std::size_t const ALIGNMENT = 64;
+
+public:
+    ImageStorage (void);
+    explicit ImageStorage (std::size_t size, T const& value = T());
+    ImageStorage (ImageStorage<T> const& other);
+    ImageStorage (ImageStorage<T>&& other);
+    ~ImageStorage (void);
+
+    ImageStorage<T>& operator= (ImageStorage<T> const& other);
+    ImageStorage<T>& operator= (ImageStorage<T>&& other);
+
+    /**
+     * Makes the storage a view of the external buffer with 'size' values.
+     * The owner, if any, is held until the view is released.
+     */
+    void wrap (T* buffer, std::size_t size,
+        std::shared_ptr<void> const& owner = nullptr);
+    /** Returns true if the storage is a view of an external buffer. */
+    bool is_view (void) const;
+    /** Returns true if the values are shared with a copy. */
+    bool is_shared (void) const;
+
+    /** Resizes the storage, new values are set to 'value'. */
+    void resize (std::size_t size, T const& value = T());
+    /** Resizes the storage, new values are left uninitialized. */
+    void resize_uninitialized (std::size_t size);
+    /** Releases the memory or the view. */
+    void clear (void);
+    void swap (ImageStorage<T>& other);
+
+    std::size_t size (void) const;
+    std::size_t capacity (void) const;
+    bool empty (void) const;
+
+    T* data (void);
+    T const* data (void) const;
+    T* begin (void);
+    T const* begin (void) const;
+    T* end (void);
+    T const* end (void) const;
+    T& operator[] (std::size_t index);
+    T const& operator[] (std::size_t index) const;
+
+private:
+    void reserve (std::size_t size);
+    void reallocate (std::size_t size);
+    void detach (void);
+    /* Serializes the changes of values shared by copies. */
+    static std::mutex& sharing_mutex (void);
+
+private:
+    typedef util::AlignedAllocator<T, ALIGNMENT> Allocator;
+
+    T* values;
+    std::size_t num_values;
+    std::size_t num_allocated;
+    /* The owned memory, or the owner of the external buffer of a view. */
+    std::shared_ptr<void> owner;
+    bool view;
+    /*
+     * Set on both storages by copies, cleared once the values are unique.
+     * Storages with the flag set change their values and owner only with
+     * the sharing mutex locked.
+     */
+    mutable std::atomic<bool> shared;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+template <typename T>
+inline
+ImageStorage<T>::ImageStorage (void)
+    : values(nullptr)
+    , num_values(0)
+    , num_allocated(0)
+    , view(false)
+    , shared(false)
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+        "Image values must be trivially copyable");
+}
+
+template <typename T>
+inline
+ImageStorage<T>::ImageStorage (std::size_t size, T const& value)
+    : ImageStorage()
+{
+    this->resize(size, value);
+}
+
+template <typename T>
+inline
+ImageStorage<T>::ImageStorage (ImageStorage<T> const& other)
+    : ImageStorage()
+{
+    std::unique_lock<std::mutex> lock(ImageStorage<T>::sharing_mutex());
+    if (other.view || other.values == nullptr)
+    {
+        /* Views and empty storages are never shared, see detach(). */
+        lock.unlock();
+        this->resize_uninitialized(other.num_values);
+        if (other.num_values > 0)
+            std::memcpy(this->values, other.values,
+                other.num_values * sizeof(T));
+        return;
+    }
+
+    this->values = other.values;
+    this->num_values = other.num_values;
+    this->num_allocated = other.num_allocated;
+    this->owner = other.owner;
+    this->shared.store(true, std::memory_order_relaxed);
+    other.shared.store(true, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline
+ImageStorage<T>::ImageStorage (ImageStorage<T>&& other)
+    : ImageStorage()
+{
+    this->swap(other);
+}
+
+template <typename T>
+inline
+ImageStorage<T>::~ImageStorage (void)
+{
+    this->clear();
+}
+
+template <typename T>
+inline ImageStorage<T>&
+ImageStorage<T>::operator= (ImageStorage<T> const& other)
+{
+    if (this != &other)
+    {
+        ImageStorage<T> tmp(other);
+        this->swap(tmp);
+    }
+    return *this;
+}
+
+template <typename T>
+inline ImageStorage<T>&
+ImageStorage<T>::operator= (ImageStorage<T>&& other)
+{
+    this->swap(other);
+    return *this;
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::wrap (T* buffer, std::size_t size,
+    std::shared_ptr<void> const& owner)
+{
+    this->clear();
+    this->values = buffer;
+    this->num_values = size;
+    this->num_allocated = size;
+    this->owner = owner;
+    this->view = true;
+}
+
+template <typename T>
+inline bool
+ImageStorage<T>::is_view (void) const
+{
+    return this->view;
+}
+
+template <typename T>
+inline bool
+ImageStorage<T>::is_shared (void) const
+{
+    if (!this->shared.load(std::memory_order_acquire))
+        return false;
+    std::lock_guard<std::mutex> lock(ImageStorage<T>::sharing_mutex());
+    return this->shared.load(std::memory_order_relaxed)
+        && this->owner.use_count() > 1;
+}
+
+template <typename T>
+inline std::mutex&
+ImageStorage<T>::sharing_mutex (void)
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::reserve (std::size_t size)
+{
+    if (this->shared.load(std::memory_order_acquire))
+    {
+        /* Shared values are copied even if they fit, the copy may grow. */
+        std::lock_guard<std::mutex> lock(ImageStorage<T>::sharing_mutex());
+        if (this->shared.load(std::memory_order_relaxed))
+        {
+            if (size > this->num_allocated || this->owner.use_count() > 1)
+                this->reallocate(size);
+            this->shared.store(false, std::memory_order_release);
+            return;
+        }
+    }
+
+    if (size > this->num_allocated)
+        this->reallocate(size);
+}
+
+template <typename T>
+void
+ImageStorage<T>::reallocate (std::size_t size)
+{
+    /*
+     * Views and shared values are copied into owned memory. The memory is
+     * released with the last storage that references it.
+     */
+    T* new_values = Allocator().allocate(size);
+    util::MemoryAccounting::allocated(util::MEMORY_IMAGES, size * sizeof(T));
+    std::shared_ptr<void> new_owner(new_values, [size] (void* ptr)
+    {
+        Allocator().deallocate(static_cast<T*>(ptr), size);
+        util::MemoryAccounting::released(util::MEMORY_IMAGES,
+            size * sizeof(T));
+    });
+
+    std::size_t const num_values = std::min(this->num_values, size);
+    if (num_values > 0)
+        std::memcpy(new_values, this->values, num_values * sizeof(T));
+    this->values = new_values;
+    this->num_values = num_values;
+    this->num_allocated = size;
+    this->owner = new_owner;
+    this->view = false;
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::detach (void)
+{
+    /*
+     * Concurrent readers of this storage either see the cleared flag,
+     * which is released after the values moved, or wait for the lock.
+     * The count of the owner is checked with the lock, which all copies
+     * and releases of shared values hold, so other storages finished
+     * their accesses if the values are unique.
+     */
+    if (!this->shared.load(std::memory_order_acquire))
+        return;
+    std::lock_guard<std::mutex> lock(ImageStorage<T>::sharing_mutex());
+    if (!this->shared.load(std::memory_order_relaxed))
+        return;
+    if (this->owner.use_count() > 1)
+        this->reallocate(this->num_values);
+    this->shared.store(false, std::memory_order_release);
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::resize (std::size_t size, T const& value)
+{
+    std::size_t const old_size = this->num_values;
+    this->resize_uninitialized(size);
+    if (size > old_size)
+        std::fill(this->values + old_size, this->values + size, value);
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::resize_uninitialized (std::size_t size)
+{
+    this->reserve(size);
+    this->num_values = size;
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::clear (void)
+{
+    /* Shared values are released with the lock, see detach(). */
+    std::unique_lock<std::mutex> lock(ImageStorage<T>::sharing_mutex(),
+        std::defer_lock);
+    if (this->shared.load(std::memory_order_acquire))
+        lock.lock();
+    this->values = nullptr;
+    this->num_values = 0;
+    this->num_allocated = 0;
+    this->owner.reset();
+    this->view = false;
+    this->shared.store(false, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline void
+ImageStorage<T>::swap (ImageStorage<T>& other)
+{
+    std::swap(this->values, other.values);
+    std::swap(this->num_values, other.num_values);
+    std::swap(this->num_allocated, other.num_allocated);
+    std::swap(this->owner, other.owner);
+    std::swap(this->view, other.view);
+    bool const shared = this->shared.load(std::memory_order_relaxed);
+    this->shared.store(other.shared.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+    other.shared.store(shared, std::memory_order_relaxed);
+}
+
+template <typename T>
+inline std::size_t
+ImageStorage<T>::size (void) const
+{
+    return this->num_values;
+}
+
+template <typename T>
+inline std::size_t
+ImageStorage<T>::capacity (void) const
+{
+    return this->num_allocated;
+}
+
+template <typename T>
+inline bool
+ImageStorage<T>::empty (void) const
+{
+    return this->num_values == 0;
+}
+
+template <typename T>
+inline T*
+ImageStorage<T>::data (void)
+{
+    this->detach();
+    return this->values;
+}
+
+template <typename T>
+inline T const*
+ImageStorage<T>::data (void) const
+{
+    return this->values;
+}
+
+template <typename T>
+inline T*
+ImageStorage<T>::begin (void)
+{
+    this->detach();
+    return this->values;
+}
+
+template <typename T>
+inline T const*
+ImageStorage<T>::begin (void) const
+{
+    return this->values;
+}
+
+template <typename T>
+inline T*
+ImageStorage<T>::end (void)
+{
+    this->detach();
+    return this->values + this->num_values;
+}
+
+template <typename T>
+inline T const*
+ImageStorage<T>::end (void) const
+{
+    return this->values + this->num_values;
+}
+
+template <typename T>
+inline T&
+ImageStorage<T>::operator[] (std::size_t index)
+{
+    this->detach();
+    return this->values[index];
+}
+
+template <typename T>
+inline T const&
+ImageStorage<T>::operator[] (std::size_t index) const
+{
+    return this->values[index];
+}
+
+CORE_NAMESPACE_END
+
+STD_NAMESPACE_BEGIN
+
+/** Specialization of std::swap for image storage. */
+template <class T>
+inline void
+swap (core::ImageStorage<T>& a, core::ImageStorage<T>& b)
+{
+    a.swap(b);
+}
+
+STD_NAMESPACE_END
+
+#endif /* MVE_IMAGE_STORAGE_HEADER */
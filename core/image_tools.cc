@@ -8,13 +8,64 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <mutex>
+#include <vector>
 
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#   include <immintrin.h>
+#endif
+
+#include "util/thread_pool.h"
 #include "core/camera.h"
 #include "core/image_tools.h"
 
 CORE_NAMESPACE_BEGIN
 CORE_IMAGE_NAMESPACE_BEGIN
 
+/*
+ * ----------------------- Parallel execution ---------------------
+ */
+
+namespace
+{
+    std::atomic<int> parallel_num_threads(0);
+    std::atomic<int> parallel_min_pixels(65536);
+}  // namespace
+
+void
+set_num_threads (int num_threads, int min_pixels)
+{
+    parallel_num_threads = std::max(0, num_threads);
+    parallel_min_pixels = std::max(0, min_pixels);
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+get_num_threads (std::size_t num_pixels)
+{
+#ifdef _OPENMP
+    if (num_pixels < static_cast<std::size_t>(parallel_min_pixels)
+        || omp_in_parallel())
+        return 1;
+    return util::ThreadPool::resolve_num_threads(parallel_num_threads);
+#else
+    (void)num_pixels;
+    return 1;
+#endif
+}
+
 /*
  * ----------------------- Image conversion -----------------------
  */
@@ -22,17 +73,45 @@ CORE_IMAGE_NAMESPACE_BEGIN
 FloatImage::Ptr
 byte_to_float_image (ByteImage::ConstPtr image)
 {
-    if (image == nullptr)
+    FloatImage::Ptr img = FloatImage::create();
+    byte_to_float_image(image, img);
+    return img;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+byte_to_float_image (ByteImage::ConstPtr image, FloatImage::Ptr out)
+{
+    if (image == nullptr || out == nullptr)
         throw std::invalid_argument("Null image given");
 
-    FloatImage::Ptr img = FloatImage::create();
-    img->allocate(image->width(), image->height(), image->channels());
+    out->allocate_uninitialized(image->width(), image->height(),
+        image->channels());
     for (int i = 0; i < image->get_value_amount(); ++i)
     {
         float value = (float)image->at(i) / 255.0f;
-        img->at(i) = std::min(1.0f, std::max(0.0f, value));
+        out->at(i) = std::min(1.0f, std::max(0.0f, value));
     }
-    return img;
+}
+
+/* ---------------------------------------------------------------- */
+
+FloatImage::Ptr
+byte_to_float_image (ImageView<uint8_t const> image)
+{
+    FloatImage::Ptr out = FloatImage::create();
+    out->allocate_uninitialized(image.width(), image.height(),
+        image.channels());
+    int const row_values = image.width() * image.channels();
+    for (int y = 0; y < image.height(); ++y)
+    {
+        uint8_t const* row = image.row(y);
+        float* out_row = out->get_data_pointer() + y * row_values;
+        for (int i = 0; i < row_values; ++i)
+            out_row[i] = static_cast<float>(row[i]) / 255.0f;
+    }
+    return out;
 }
 
 /* ---------------------------------------------------------------- */
@@ -165,6 +244,1007 @@ float_image_normalize (FloatImage::Ptr image)
         *ptr = (*ptr - vmin) / (vmax - vmin);
 }
 
+/*
+ * ----------------------- Image undistortion ---------------------
+ */
+
+namespace
+{
+    /* Sets up the lookup like Image<T>::linear_at() samples at (x, y). */
+    void
+    set_lookup (float x, float y, int width, int height,
+        UndistortionMap::Lookup* lookup)
+    {
+        x = std::max(0.0f, std::min(static_cast<float>(width - 1), x));
+        y = std::max(0.0f, std::min(static_cast<float>(height - 1), y));
+
+        int const floor_x = static_cast<int>(x);
+        int const floor_y = static_cast<int>(y);
+        float const w1 = x - static_cast<float>(floor_x);
+        float const w0 = 1.0f - w1;
+        float const w3 = y - static_cast<float>(floor_y);
+        float const w2 = 1.0f - w3;
+
+        lookup->pixel = floor_y * width + floor_x;
+        lookup->step_x = floor_x + 1 < width;
+        lookup->step_y = floor_y + 1 < height;
+        lookup->weights[0] = w0 * w2;
+        lookup->weights[1] = w1 * w2;
+        lookup->weights[2] = w0 * w3;
+        lookup->weights[3] = w1 * w3;
+    }
+
+    void
+    set_outside (UndistortionMap::Lookup* lookup)
+    {
+        lookup->pixel = -1;
+        lookup->step_x = 0;
+        lookup->step_y = 0;
+        std::fill(lookup->weights, lookup->weights + 4, 0.0f);
+    }
+
+    /* The maps of the recently used cameras, a data set has few cameras. */
+    struct MapCacheEntry
+    {
+        int model;
+        int width;
+        int height;
+        double params[3];
+        UndistortionMap::ConstPtr map;
+    };
+
+    std::mutex map_cache_mutex;
+    std::vector<MapCacheEntry> map_cache;
+    std::size_t const map_cache_size = 8;
+
+    /*
+     * Returns the cached map of the distortion model with the given
+     * parameters, or creates and caches it with 'func'.
+     */
+    template <typename FUNC>
+    UndistortionMap::ConstPtr
+    get_cached_map (int model, int width, int height,
+        double p0, double p1, double p2, FUNC const& func)
+    {
+        if (width < 0 || height < 0)
+            throw std::invalid_argument("Invalid image dimensions");
+
+        {
+            std::lock_guard<std::mutex> lock(map_cache_mutex);
+            for (std::size_t i = 0; i < map_cache.size(); ++i)
+            {
+                MapCacheEntry const& e = map_cache[i];
+                if (e.model == model && e.width == width
+                    && e.height == height && e.params[0] == p0
+                    && e.params[1] == p1 && e.params[2] == p2)
+                    return e.map;
+            }
+        }
+
+        /* The map is created outside of the lock. */
+        std::shared_ptr<UndistortionMap> map
+            = std::make_shared<UndistortionMap>();
+        map->width = width;
+        map->height = height;
+        map->lookups.resize(static_cast<std::size_t>(width) * height);
+        int const num_threads = get_num_threads(width * height);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                func(x, y, &map->lookups[y * width + x]);
+
+        std::lock_guard<std::mutex> lock(map_cache_mutex);
+        if (map_cache.size() >= map_cache_size)
+            map_cache.erase(map_cache.begin());
+        MapCacheEntry entry = { model, width, height, { p0, p1, p2 }, map };
+        map_cache.push_back(entry);
+        return map;
+    }
+}  // namespace
+
+UndistortionMap::ConstPtr
+undistortion_map_msps (int width, int height, double k0, double k1)
+{
+    int const D = std::max(width, height);
+    double const width_half = static_cast<double>(width) / 2.0;
+    double const height_half = static_cast<double>(height) / 2.0;
+
+    return get_cached_map(0, width, height, k0, k1, 0.0,
+        [=] (int x, int y, UndistortionMap::Lookup* lookup)
+    {
+        double fx = static_cast<double>(x) - width_half;
+        double fy = static_cast<double>(y) - height_half;
+        double const s1 = D * D + k1 * (fx * fx + fy * fy);
+        double const s2 = D * D + k0 * (fx * fx + fy * fy);
+        double const factor = s1 / s2;
+        fx = fx * factor + width_half;
+        fy = fy * factor + height_half;
+
+        if (fx < -0.5 || fx > width - 0.5 || fy < -0.5 || fy > height - 0.5)
+            set_outside(lookup);
+        else
+            set_lookup(fx, fy, width, height, lookup);
+    });
+}
+
+/* ---------------------------------------------------------------- */
+
+UndistortionMap::ConstPtr
+undistortion_map_k2k4 (int width, int height,
+    double focal_length, double k2, double k4)
+{
+    double const fwidth2 = static_cast<double>(width) / 2.0;
+    double const fheight2 = static_cast<double>(height) / 2.0;
+    double const fnorm = static_cast<double>(std::max(width, height));
+
+    return get_cached_map(1, width, height, focal_length, k2, k4,
+        [=] (int x, int y, UndistortionMap::Lookup* lookup)
+    {
+        double const fx = (static_cast<double>(x) + 0.5 - fwidth2) / fnorm;
+        double const fy = (static_cast<double>(y) + 0.5 - fheight2) / fnorm;
+        double const rd = (fx * fx + fy * fy) / MATH_POW2(focal_length);
+        double const rd_factor = 1.0 + k2 * rd + k4 * rd * rd;
+        double const dist_x = fx * rd_factor;
+        double const dist_y = fy * rd_factor;
+        float const ix = dist_x * fnorm + fwidth2 - 0.5;
+        float const iy = dist_y * fnorm + fheight2 - 0.5;
+        if (ix < -0.5 || ix > width - 0.5 || iy < -0.5 || iy > height - 0.5)
+            set_outside(lookup);
+        else
+            set_lookup(ix, iy, width, height, lookup);
+    });
+}
+
+/* ---------------------------------------------------------------- */
+
+UndistortionMap::ConstPtr
+undistortion_map_vsfm (int width, int height,
+    double focal_length, double k1)
+{
+    /*
+     * The image coordinates must be normalized before the distortion
+     * model is applied. The image coordinates are first centered at
+     * the origin and then scaled w.r.t. the focal length in pixel.
+     */
+    double const norm = focal_length * std::max(width, height);
+    double const width_half = static_cast<double>(width) / 2.0;
+    double const height_half = static_cast<double>(height) / 2.0;
+
+    return get_cached_map(2, width, height, focal_length, k1, 0.0,
+        [=] (int x, int y, UndistortionMap::Lookup* lookup)
+    {
+        double fx = (static_cast<double>(x) - width_half) / norm;
+        double fy = (static_cast<double>(y) - height_half) / norm;
+        if (fy == 0.0)
+            fy = 1e-10;
+
+        double const t2 = fy * fy;
+        double const t3 = t2 * t2 * t2;
+        double const t4 = fx * fx;
+        double const t7 = k1 * (t2 + t4);
+
+        if (k1 > 0.0)
+        {
+            double const t8 = 1.0 / t7;
+            double const t10 = t3 / (t7 * t7);
+            double const t14 = std::sqrt(t10 * (0.25 + t8 / 27.0));
+            double const t15 = t2 * t8 * fy * 0.5;
+            double const t17 = std::pow(t14 + t15, 1.0/3.0);
+            double const t18 = t17 - t2 * t8 / (t17 * 3.0);
+            fx = t18 * fx / fy;
+            fy = t18;
+        }
+        else
+        {
+            double const t9 = t3 / (t7 * t7 * 4.0);
+            double const t11 = t3 / (t7 * t7 * t7 * 27.0);
+            std::complex<double> const t12 = t9 + t11;
+            std::complex<double> const t13 = std::sqrt(t12);
+            double const t14 = t2 / t7;
+            double const t15 = t14 * fy * 0.5;
+            std::complex<double> const t16 = t13 + t15;
+            std::complex<double> const t17 = std::pow(t16, 1.0/3.0);
+            std::complex<double> const t18 = (t17 + t14 / (t17 * 3.0))
+                * std::complex<double>(0.0, std::sqrt(3.0));
+            std::complex<double> const t19 = -0.5 * (t17 + t18)
+                + t14 / (t17 * 6.0);
+            fx = t19.real() * fx / fy;
+            fy = t19.real();
+        }
+
+        fx = fx * norm + width_half;
+        fy = fy * norm + height_half;
+
+        if (fx < -0.5 || fx > width - 0.5 || fy < -0.5 || fy > height - 0.5)
+            set_outside(lookup);
+        else
+            set_lookup(fx, fy, width, height, lookup);
+    });
+}
+
+/*
+ * ------------------- Image scaling and cropping -----------------
+ */
+
+namespace
+{
+    /* Half-sizes the output pixels [x0, x1) like the generic version. */
+    template <typename T>
+    void
+    half_size_pixels (T const* row1, T const* row2, int iw, int ic,
+        int x0, int x1, T* out)
+    {
+        for (int x = x0; x < x1; ++x)
+        {
+            int const p = x * 2 * ic;
+            int const q = p + ic * (x * 2 + 1 < iw);
+            for (int c = 0; c < ic; ++c)
+                out[x * ic + c] = math::interpolate<T>(
+                    row1[p + c], row1[q + c], row2[p + c], row2[q + c],
+                    0.25f, 0.25f, 0.25f, 0.25f);
+        }
+    }
+
+#if defined(__SSE2__)
+    /* Loads the three bytes of a pixel into the low 32 bit lanes. */
+    inline __m128i
+    load_pixel_epi32 (uint8_t const* ptr)
+    {
+        return _mm_setr_epi32(ptr[0], ptr[1], ptr[2], 0);
+    }
+
+    /* Stores the low three 32 bit lanes as the bytes of a pixel. */
+    inline void
+    store_pixel_epi32 (__m128i values, uint8_t* ptr)
+    {
+        values = _mm_packs_epi32(values, values);
+        int32_t const value = _mm_cvtsi128_si32(
+            _mm_packus_epi16(values, values));
+        ptr[0] = static_cast<uint8_t>(value);
+        ptr[1] = static_cast<uint8_t>(value >> 8);
+        ptr[2] = static_cast<uint8_t>(value >> 16);
+    }
+#endif
+
+    /*
+     * Half-sizes the leading output pixels of a row with SSE2 and returns
+     * the number of processed pixels. Byte values are averaged exactly in
+     * 16 bit as (a + b + c + d + 2) / 4, which the float weights with the
+     * rounding of the generic version amount to.
+     */
+    int
+    half_size_pixels_sse (uint8_t const* row1, uint8_t const* row2,
+        int iw, int ic, uint8_t* out)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        __m128i const two = _mm_set1_epi16(2);
+        if (ic == 1)
+        {
+            __m128i const mask = _mm_set1_epi16(0x00ff);
+            for (; 2 * x + 16 <= iw; x += 8)
+            {
+                __m128i const a = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(row1 + 2 * x));
+                __m128i const b = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(row2 + 2 * x));
+                __m128i sum = _mm_add_epi16(_mm_and_si128(a, mask),
+                    _mm_srli_epi16(a, 8));
+                sum = _mm_add_epi16(sum, _mm_and_si128(b, mask));
+                sum = _mm_add_epi16(sum, _mm_srli_epi16(b, 8));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x),
+                    _mm_packus_epi16(sum, sum));
+            }
+        }
+        else if (ic == 3)
+        {
+            __m128i const two32 = _mm_set1_epi32(2);
+            for (; 2 * x + 1 < iw; ++x)
+            {
+                __m128i sum = _mm_add_epi32(load_pixel_epi32(row1 + 6 * x),
+                    load_pixel_epi32(row1 + 6 * x + 3));
+                sum = _mm_add_epi32(sum, load_pixel_epi32(row2 + 6 * x));
+                sum = _mm_add_epi32(sum, load_pixel_epi32(row2 + 6 * x + 3));
+                sum = _mm_srli_epi32(_mm_add_epi32(sum, two32), 2);
+                store_pixel_epi32(sum, out + 3 * x);
+            }
+        }
+#else
+        (void)row1; (void)row2; (void)iw; (void)ic; (void)out;
+#endif
+        return x;
+    }
+
+    /*
+     * Float version of the above. The values are weighted and summed in
+     * the order of the generic version, which makes the result identical.
+     * For three channels, one pixel is processed per vector, the fourth
+     * lane is overwritten by the next pixel.
+     */
+    int
+    half_size_pixels_sse (float const* row1, float const* row2,
+        int iw, int ic, float* out)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        __m128 const quarter = _mm_set1_ps(0.25f);
+        if (ic == 1)
+        {
+            for (; 2 * x + 8 <= iw; x += 4)
+            {
+                __m128 const a0 = _mm_loadu_ps(row1 + 2 * x);
+                __m128 const a1 = _mm_loadu_ps(row1 + 2 * x + 4);
+                __m128 const b0 = _mm_loadu_ps(row2 + 2 * x);
+                __m128 const b1 = _mm_loadu_ps(row2 + 2 * x + 4);
+                __m128 sum = _mm_mul_ps(_mm_shuffle_ps(a0, a1,
+                    _MM_SHUFFLE(2, 0, 2, 0)), quarter);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(a0, a1,
+                    _MM_SHUFFLE(3, 1, 3, 1)), quarter));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(b0, b1,
+                    _MM_SHUFFLE(2, 0, 2, 0)), quarter));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(b0, b1,
+                    _MM_SHUFFLE(3, 1, 3, 1)), quarter));
+                _mm_storeu_ps(out + x, sum);
+            }
+        }
+        else if (ic == 3)
+        {
+            for (; 2 * x + 2 < iw; ++x)
+            {
+                float const* p1 = row1 + 6 * x;
+                float const* p2 = row2 + 6 * x;
+                __m128 sum = _mm_mul_ps(_mm_loadu_ps(p1), quarter);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(p1 + 3),
+                    quarter));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(p2), quarter));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(p2 + 3),
+                    quarter));
+                _mm_storeu_ps(out + 3 * x, sum);
+            }
+        }
+#else
+        (void)row1; (void)row2; (void)iw; (void)ic; (void)out;
+#endif
+        return x;
+    }
+
+    template <typename T>
+    void
+    half_size_image (typename Image<T>::ConstPtr img,
+        typename Image<T>::Ptr out)
+    {
+        if (img == nullptr || out == nullptr)
+            throw std::invalid_argument("Null image given");
+        if (img == out)
+            throw std::invalid_argument("In-place rescaling not supported");
+
+        int const iw = img->width();
+        int const ih = img->height();
+        int const ic = img->channels();
+        int const ow = (iw + 1) >> 1;
+        int const oh = (ih + 1) >> 1;
+
+        if (iw < 2 || ih < 2)
+            throw std::invalid_argument("Input image too small "
+                "for half-sizing");
+
+        out->allocate_uninitialized(ow, oh, ic);
+
+        int const rowstride = iw * ic;
+        int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < oh; ++y)
+        {
+            T const* row1 = img->get_data_pointer() + y * 2 * rowstride;
+            T const* row2 = row1 + rowstride * (y * 2 + 1 < ih);
+            T* out_row = out->get_data_pointer() + y * ow * ic;
+            int const x = half_size_pixels_sse(row1, row2, iw, ic, out_row);
+            half_size_pixels(row1, row2, iw, ic, x, ow, out_row);
+        }
+    }
+
+    /* ---------------------------------------------------------------- */
+
+    /*
+     * The 16 weights of the 4x4 gaussian kernel in the order of the generic
+     * version, and their sum, which is accumulated in the same order.
+     */
+    struct HalfSizeKernel
+    {
+        float weights[16];
+        float sum;
+    };
+
+    HalfSizeKernel
+    get_half_size_kernel (float sigma)
+    {
+        float const w1 = std::exp(-0.5f / (2.0f * MATH_POW2(sigma)));
+        float const w2 = std::exp(-2.5f / (2.0f * MATH_POW2(sigma)));
+        float const w3 = std::exp(-4.5f / (2.0f * MATH_POW2(sigma)));
+        float const weights[16] = { w3, w2, w2, w3, w2, w1, w1, w2,
+            w2, w1, w1, w2, w3, w2, w2, w3 };
+
+        HalfSizeKernel kernel;
+        kernel.sum = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            kernel.weights[i] = weights[i];
+            kernel.sum += weights[i];
+        }
+        return kernel;
+    }
+
+    /* Returns the four clamped pixel offsets for output column x. */
+    inline void
+    get_half_size_offsets (int x, int iw, int ic, int* xi)
+    {
+        int const x2 = x << 1;
+        xi[0] = std::max(0, x2 - 1) * ic;
+        xi[1] = x2 * ic;
+        xi[2] = std::min(iw - 1, x2 + 1) * ic;
+        xi[3] = std::min(iw - 1, x2 + 2) * ic;
+    }
+
+    /* Filters the output pixels [x0, x1) like the generic version. */
+    template <typename T>
+    void
+    half_size_gaussian_pixels (T const* const* row, int iw, int ic,
+        HalfSizeKernel const& kernel, int x0, int x1, T* out)
+    {
+        for (int x = x0; x < x1; ++x)
+        {
+            int xi[4];
+            get_half_size_offsets(x, iw, ic, xi);
+            for (int c = 0; c < ic; ++c)
+            {
+                math::Accum<T> accum(T(0));
+                for (int r = 0; r < 4; ++r)
+                    for (int k = 0; k < 4; ++k)
+                        accum.add(row[r][xi[k] + c], kernel.weights[r * 4 + k]);
+                out[x * ic + c] = accum.normalized();
+            }
+        }
+    }
+
+    /*
+     * Filters the output pixels [x0, x1) with SSE2 where possible and
+     * returns the first pixel that is not processed. The values are
+     * weighted and summed in the order of the generic version in float,
+     * and bytes are rounded like math::round(), which makes the result
+     * identical. For one channel, vectors of output pixels are computed
+     * from the even and odd source columns, which leaves the border pixels
+     * to the caller. For three channels, one pixel is processed per vector.
+     */
+    int
+    half_size_gaussian_pixels_sse (uint8_t const* const* row, int iw, int ic,
+        HalfSizeKernel const& kernel, int x0, uint8_t* out)
+    {
+        int x = x0;
+#if defined(__SSE2__)
+        __m128 const sum = _mm_set1_ps(kernel.sum);
+        __m128 const half = _mm_set1_ps(0.5f);
+        __m128i const zero = _mm_setzero_si128();
+        if (ic == 1)
+        {
+            __m128i const mask = _mm_set1_epi16(0x00ff);
+            for (x = std::max(x, 1); 2 * x + 17 <= iw; x += 8)
+            {
+                __m128 acc_lo = _mm_setzero_ps();
+                __m128 acc_hi = _mm_setzero_ps();
+                for (int r = 0; r < 4; ++r)
+                {
+                    uint8_t const* p = row[r] + 2 * x - 1;
+                    __m128i const a = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(p));
+                    __m128i const b = _mm_loadu_si128(
+                        reinterpret_cast<__m128i const*>(p + 2));
+                    __m128i const values[4] = { _mm_and_si128(a, mask),
+                        _mm_srli_epi16(a, 8), _mm_and_si128(b, mask),
+                        _mm_srli_epi16(b, 8) };
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        __m128 const w = _mm_set1_ps(kernel.weights[r * 4 + k]);
+                        acc_lo = _mm_add_ps(acc_lo, _mm_mul_ps(_mm_cvtepi32_ps(
+                            _mm_unpacklo_epi16(values[k], zero)), w));
+                        acc_hi = _mm_add_ps(acc_hi, _mm_mul_ps(_mm_cvtepi32_ps(
+                            _mm_unpackhi_epi16(values[k], zero)), w));
+                    }
+                }
+                __m128i const lo = _mm_cvttps_epi32(
+                    _mm_add_ps(_mm_div_ps(acc_lo, sum), half));
+                __m128i const hi = _mm_cvttps_epi32(
+                    _mm_add_ps(_mm_div_ps(acc_hi, sum), half));
+                __m128i const packed = _mm_packs_epi32(lo, hi);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x),
+                    _mm_packus_epi16(packed, packed));
+            }
+        }
+        else if (ic == 3)
+        {
+            int const x1 = (iw + 1) >> 1;
+            for (; x < x1; ++x)
+            {
+                int xi[4];
+                get_half_size_offsets(x, iw, ic, xi);
+                __m128 acc = _mm_setzero_ps();
+                for (int r = 0; r < 4; ++r)
+                    for (int k = 0; k < 4; ++k)
+                        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(
+                            load_pixel_epi32(row[r] + xi[k])),
+                            _mm_set1_ps(kernel.weights[r * 4 + k])));
+                store_pixel_epi32(_mm_cvttps_epi32(
+                    _mm_add_ps(_mm_div_ps(acc, sum), half)), out + 3 * x);
+            }
+        }
+#else
+        (void)row; (void)iw; (void)ic; (void)kernel; (void)out;
+#endif
+        return x;
+    }
+
+    int
+    half_size_gaussian_pixels_sse (float const* const* row, int iw, int ic,
+        HalfSizeKernel const& kernel, int x0, float* out)
+    {
+        int x = x0;
+#if defined(__SSE2__)
+        __m128 const sum = _mm_set1_ps(kernel.sum);
+        if (ic == 1)
+        {
+            for (x = std::max(x, 1); 2 * x + 9 <= iw; x += 4)
+            {
+                __m128 acc = _mm_setzero_ps();
+                for (int r = 0; r < 4; ++r)
+                {
+                    float const* p = row[r] + 2 * x - 1;
+                    __m128 const a0 = _mm_loadu_ps(p);
+                    __m128 const a1 = _mm_loadu_ps(p + 4);
+                    __m128 const b0 = _mm_loadu_ps(p + 2);
+                    __m128 const b1 = _mm_loadu_ps(p + 6);
+                    __m128 const values[4] = {
+                        _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)),
+                        _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)),
+                        _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)),
+                        _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)) };
+                    for (int k = 0; k < 4; ++k)
+                        acc = _mm_add_ps(acc, _mm_mul_ps(values[k],
+                            _mm_set1_ps(kernel.weights[r * 4 + k])));
+                }
+                _mm_storeu_ps(out + x, _mm_div_ps(acc, sum));
+            }
+        }
+        else if (ic == 3)
+        {
+            /* The fourth lane is overwritten by the next pixel. */
+            for (; 2 * x + 4 <= iw; ++x)
+            {
+                int xi[4];
+                get_half_size_offsets(x, iw, ic, xi);
+                __m128 acc = _mm_setzero_ps();
+                for (int r = 0; r < 4; ++r)
+                    for (int k = 0; k < 4; ++k)
+                        acc = _mm_add_ps(acc, _mm_mul_ps(
+                            _mm_loadu_ps(row[r] + xi[k]),
+                            _mm_set1_ps(kernel.weights[r * 4 + k])));
+                _mm_storeu_ps(out + 3 * x, _mm_div_ps(acc, sum));
+            }
+        }
+#else
+        (void)row; (void)iw; (void)ic; (void)kernel; (void)out;
+#endif
+        return x;
+    }
+
+    template <typename T>
+    void
+    half_size_gaussian_image (typename Image<T>::ConstPtr img, float sigma,
+        typename Image<T>::Ptr out)
+    {
+        if (img == nullptr || out == nullptr)
+            throw std::invalid_argument("Null image given");
+        if (img == out)
+            throw std::invalid_argument("In-place rescaling not supported");
+
+        int const iw = img->width();
+        int const ih = img->height();
+        int const ic = img->channels();
+        int const ow = (iw + 1) >> 1;
+        int const oh = (ih + 1) >> 1;
+
+        if (iw < 2 || ih < 2)
+            throw std::invalid_argument("Invalid input image");
+
+        out->allocate_uninitialized(ow, oh, ic);
+
+        HalfSizeKernel const kernel = get_half_size_kernel(sigma);
+        int const rowstride = iw * ic;
+        int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < oh; ++y)
+        {
+            int const y2 = y << 1;
+            T const* row[4];
+            row[0] = img->get_data_pointer() + std::max(0, y2 - 1) * rowstride;
+            row[1] = img->get_data_pointer() + y2 * rowstride;
+            row[2] = img->get_data_pointer()
+                + std::min(ih - 1, y2 + 1) * rowstride;
+            row[3] = img->get_data_pointer()
+                + std::min(ih - 1, y2 + 2) * rowstride;
+
+            /* The first pixel is on the border for one channel. */
+            T* out_row = out->get_data_pointer() + y * ow * ic;
+            int const x0 = std::min(ow, ic == 1 ? 1 : 0);
+            half_size_gaussian_pixels(row, iw, ic, kernel, 0, x0, out_row);
+            int const x1 = half_size_gaussian_pixels_sse(row, iw, ic,
+                kernel, x0, out_row);
+            half_size_gaussian_pixels(row, iw, ic, kernel, x1, ow, out_row);
+        }
+    }
+
+    /* ---------------------------------------------------------------- */
+
+    /* Subsamples the leading output pixels of a row with SSE2. */
+    int
+    subsample_pixels_sse (uint8_t const* row, int iw, int ic, uint8_t* out)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        if (ic == 1)
+        {
+            __m128i const mask = _mm_set1_epi16(0x00ff);
+            for (; 2 * x + 16 <= iw; x += 8)
+            {
+                __m128i const values = _mm_and_si128(_mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(row + 2 * x)), mask);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x),
+                    _mm_packus_epi16(values, values));
+            }
+        }
+        else if (ic == 3)
+        {
+            for (; 2 * x < iw; ++x)
+                std::memcpy(out + 3 * x, row + 6 * x, 3);
+        }
+#else
+        (void)row; (void)iw; (void)ic; (void)out;
+#endif
+        return x;
+    }
+
+    int
+    subsample_pixels_sse (float const* row, int iw, int ic, float* out)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        if (ic == 1)
+        {
+            for (; 2 * x + 8 <= iw; x += 4)
+                _mm_storeu_ps(out + x, _mm_shuffle_ps(
+                    _mm_loadu_ps(row + 2 * x), _mm_loadu_ps(row + 2 * x + 4),
+                    _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+        else if (ic == 3)
+        {
+            /* The fourth lane is overwritten by the next pixel. */
+            for (; 2 * x + 2 < iw; ++x)
+                _mm_storeu_ps(out + 3 * x, _mm_loadu_ps(row + 6 * x));
+        }
+#else
+        (void)row; (void)iw; (void)ic; (void)out;
+#endif
+        return x;
+    }
+
+    template <typename T>
+    void
+    subsample_image (typename Image<T>::ConstPtr img,
+        typename Image<T>::Ptr out)
+    {
+        if (img == nullptr || out == nullptr)
+            throw std::invalid_argument("Null image given");
+        if (img == out)
+            throw std::invalid_argument("In-place rescaling not supported");
+
+        int const iw = img->width();
+        int const ih = img->height();
+        int const ic = img->channels();
+        int const ow = (iw + 1) >> 1;
+        int const oh = (ih + 1) >> 1;
+
+        out->allocate_uninitialized(ow, oh, ic);
+
+        int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < oh; ++y)
+        {
+            T const* row = img->get_data_pointer() + y * 2 * iw * ic;
+            T* out_row = out->get_data_pointer() + y * ow * ic;
+            for (int x = subsample_pixels_sse(row, iw, ic, out_row);
+                x < ow; ++x)
+                std::copy(row + x * 2 * ic, row + x * 2 * ic + ic,
+                    out_row + x * ic);
+        }
+    }
+}  // namespace
+
+template <>
+void
+rescale_half_size<uint8_t> (ByteImage::ConstPtr image, ByteImage::Ptr out)
+{
+    half_size_image<uint8_t>(image, out);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <>
+void
+rescale_half_size<float> (FloatImage::ConstPtr image, FloatImage::Ptr out)
+{
+    half_size_image<float>(image, out);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <>
+void
+rescale_half_size_gaussian<uint8_t> (ByteImage::ConstPtr image,
+    ByteImage::Ptr out, float sigma)
+{
+    half_size_gaussian_image<uint8_t>(image, sigma, out);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <>
+void
+rescale_half_size_gaussian<float> (FloatImage::ConstPtr image,
+    FloatImage::Ptr out, float sigma)
+{
+    half_size_gaussian_image<float>(image, sigma, out);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <>
+void
+rescale_half_size_subsample<uint8_t> (ByteImage::ConstPtr image,
+    ByteImage::Ptr out)
+{
+    subsample_image<uint8_t>(image, out);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <>
+void
+rescale_half_size_subsample<float> (FloatImage::ConstPtr image,
+    FloatImage::Ptr out)
+{
+    subsample_image<float>(image, out);
+}
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * ------------------------- Image blurring --------------------------
+ */
+
+namespace
+{
+    /* Width of the column strips (in values) for the vertical pass. */
+    int const BLUR_STRIP_WIDTH = 1024;
+
+    /*
+     * Computes 'num' convolved values as dst[j] = sum_t src[t][j] * taps[t]
+     * normalized by 'weight'. Each SIMD lane computes one output value
+     * and accumulates the taps in the same order as the scalar code,
+     * which makes the result independent of the vector width.
+     */
+    void
+    convolve_values (float const* const* src, float const* taps,
+        int num_taps, float weight, float* dst, int num)
+    {
+        int j = 0;
+#if defined(__AVX__)
+        __m256 const avx_weight = _mm256_set1_ps(weight);
+        for (; j + 16 <= num; j += 16)
+        {
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            for (int t = 0; t < num_taps; ++t)
+            {
+                __m256 const tap = _mm256_set1_ps(taps[t]);
+                acc0 = _mm256_add_ps(acc0,
+                    _mm256_mul_ps(_mm256_loadu_ps(src[t] + j), tap));
+                acc1 = _mm256_add_ps(acc1,
+                    _mm256_mul_ps(_mm256_loadu_ps(src[t] + j + 8), tap));
+            }
+            _mm256_storeu_ps(dst + j, _mm256_div_ps(acc0, avx_weight));
+            _mm256_storeu_ps(dst + j + 8, _mm256_div_ps(acc1, avx_weight));
+        }
+#endif
+#if defined(__SSE2__)
+        __m128 const sse_weight = _mm_set1_ps(weight);
+        for (; j + 8 <= num; j += 8)
+        {
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            for (int t = 0; t < num_taps; ++t)
+            {
+                __m128 const tap = _mm_set1_ps(taps[t]);
+                acc0 = _mm_add_ps(acc0,
+                    _mm_mul_ps(_mm_loadu_ps(src[t] + j), tap));
+                acc1 = _mm_add_ps(acc1,
+                    _mm_mul_ps(_mm_loadu_ps(src[t] + j + 4), tap));
+            }
+            _mm_storeu_ps(dst + j, _mm_div_ps(acc0, sse_weight));
+            _mm_storeu_ps(dst + j + 4, _mm_div_ps(acc1, sse_weight));
+        }
+        for (; j + 4 <= num; j += 4)
+        {
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < num_taps; ++t)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src[t] + j),
+                    _mm_set1_ps(taps[t])));
+            _mm_storeu_ps(dst + j, _mm_div_ps(acc, sse_weight));
+        }
+#endif
+        for (; j < num; ++j)
+        {
+            float acc = 0.0f;
+            for (int t = 0; t < num_taps; ++t)
+                acc += src[t][j] * taps[t];
+            dst[j] = acc / weight;
+        }
+    }
+
+    /*
+     * Convolves the values [j0, j1) of an image row in x-direction.
+     * Values closer than 'ks' pixels to the image border are clamped
+     * and computed one by one, all other values are vectorized.
+     */
+    void
+    blur_row_values (float const* row, int width, int chans, int j0, int j1,
+        float const* taps, int ks, float weight, float* dst)
+    {
+        int const num_taps = 2 * ks + 1;
+        int const inner_begin = std::max(j0, ks * chans);
+        int const inner_end = std::min(j1, (width - ks) * chans);
+
+        for (int j = j0; j < j1; ++j)
+        {
+            if (j == inner_begin && inner_begin < inner_end)
+            {
+                std::vector<float const*> src(num_taps);
+                for (int t = 0; t < num_taps; ++t)
+                    src[t] = row + inner_begin + (t - ks) * chans;
+                convolve_values(&src[0], taps, num_taps, weight,
+                    dst + inner_begin - j0, inner_end - inner_begin);
+                j = inner_end - 1;
+                continue;
+            }
+
+            int const x = j / chans;
+            int const cc = j % chans;
+            float acc = 0.0f;
+            for (int t = 0; t < num_taps; ++t)
+            {
+                int const idx = math::clamp(x + t - ks, 0, width - 1);
+                acc += row[idx * chans + cc] * taps[t];
+            }
+            dst[j - j0] = acc / weight;
+        }
+    }
+}  // namespace
+
+template <>
+FloatImage::Ptr
+blur_gaussian<float> (FloatImage::ConstPtr in, float sigma)
+{
+    if (in == nullptr)
+        throw std::invalid_argument("Null image given");
+
+    FloatImage::Ptr out = FloatImage::create();
+    blur_gaussian(in, out, sigma);
+    return out;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+blur_gaussian (FloatImage::ConstPtr in, FloatImage::Ptr out, float sigma)
+{
+    if (in == nullptr || out == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (in == out)
+        throw std::invalid_argument("In-place blurring not supported");
+
+    int const w = in->width();
+    int const h = in->height();
+    int const c = in->channels();
+    if (out->width() != w || out->height() != h || out->channels() != c)
+        out->allocate(w, h, c);
+
+    /* Small sigmas result in literally no change. */
+    if (MATH_EPSILON_EQ(sigma, 0.0f, 0.1f))
+    {
+        std::copy(in->begin(), in->end(), out->begin());
+        return;
+    }
+
+    /*
+     * Fill kernel values. The kernel is stored with all 2 * ks + 1 taps,
+     * and the normalization weight is accumulated in the same order as
+     * the generic implementation does, to produce identical results.
+     */
+    int const ks = std::ceil(sigma * 2.884f); // Cap kernel at 1/128
+    int const num_taps = 2 * ks + 1;
+    std::vector<float> taps(num_taps);
+    float weight = 0.0f;
+    for (int i = -ks; i <= ks; ++i)
+    {
+        taps[i + ks] = math::gaussian((float)std::abs(i), sigma);
+        weight += taps[i + ks];
+    }
+
+    /*
+     * The image is processed in column strips. For each strip, the rows
+     * convolved in x-direction are kept in a ring buffer of 2 * ks + 1
+     * rows, which are then convolved in y-direction to produce the final
+     * output row. This keeps the working set small for large images.
+     */
+    int const row_values = w * c;
+    int const strip_width = std::min(row_values, BLUR_STRIP_WIDTH);
+    float const* in_ptr = in->get_data_pointer();
+    float* out_ptr = out->get_data_pointer();
+
+    /*
+     * In parallel, the strips are also split into bands of rows. Every
+     * band convolves the ks rows above it again, which makes the result
+     * independent of the number of threads.
+     */
+    int const num_strips = (row_values + strip_width - 1) / strip_width;
+    int const num_threads = get_num_threads(w * h);
+    int const band_height = std::max(1, (h + num_threads - 1) / num_threads);
+    int const num_bands = (h + band_height - 1) / band_height;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int i = 0; i < num_strips * num_bands; ++i)
+    {
+        int const j0 = (i % num_strips) * strip_width;
+        int const j1 = std::min(row_values, j0 + strip_width);
+        int const num = j1 - j0;
+        int const y0 = (i / num_strips) * band_height;
+        int const y1 = std::min(h, y0 + band_height);
+        std::vector<float> ring(num_taps * strip_width);
+        std::vector<float const*> src(num_taps);
+        int next_row = std::max(0, y0 - ks);
+        for (int y = y0; y < y1; ++y)
+        {
+            /* Convolve all rows required for this output row in x. */
+            int const last_row = std::min(h - 1, y + ks);
+            for (; next_row <= last_row; ++next_row)
+                blur_row_values(in_ptr + next_row * row_values, w, c, j0, j1,
+                    &taps[0], ks, weight,
+                    &ring[(next_row % num_taps) * strip_width]);
+
+            /* Convolve the buffered rows in y. */
+            for (int t = 0; t < num_taps; ++t)
+            {
+                int const row = math::clamp(y + t - ks, 0, h - 1);
+                src[t] = &ring[(row % num_taps) * strip_width];
+            }
+            convolve_values(&src[0], &taps[0], num_taps, weight,
+                out_ptr + y * row_values + j0, num);
+        }
+    }
+}
+
 /* ---------------------------------------------------------------- */
 
 void
@@ -181,5 +1261,1082 @@ gamma_correct (ByteImage::Ptr image, float power)
         image->at(i) = lookup[image->at(i)];
 }
 
+/* ---------------------------------------------------------------- */
+
+namespace
+{
+    /* Applies the lookup table to all values of the byte image. */
+    void
+    apply_lookup (uint8_t const* lookup, ByteImage::Ptr image)
+    {
+        if (image == nullptr)
+            throw std::invalid_argument("Null image given");
+
+        uint8_t* ptr = image->get_data_pointer();
+        int const num_values = image->get_value_amount();
+        int const num_threads = get_num_threads(image->get_pixel_amount());
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int i = 0; i < num_values; ++i)
+            ptr[i] = lookup[ptr[i]];
+    }
+
+    /* Fills the lookup table with the rounded results of the function. */
+    template <typename FUNC>
+    void
+    fill_lookup (FUNC const& func, uint8_t* lookup)
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            double const value = func(static_cast<double>(i) / 255.0);
+            lookup[i] = static_cast<uint8_t>(math::clamp
+                (value * 255.0 + 0.5, 0.0, 255.0));
+        }
+    }
+
+    struct SrgbLookups
+    {
+        SrgbLookups (void);
+        uint8_t forward[256];
+        uint8_t inverse[256];
+    };
+
+    SrgbLookups::SrgbLookups (void)
+    {
+        fill_lookup([] (double v) { return v <= 0.0031308 ? v * 12.92
+            : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055; }, this->forward);
+        fill_lookup([] (double v) { return v <= 0.04045 ? v / 12.92
+            : std::pow((v + 0.055) / 1.055, 2.4); }, this->inverse);
+    }
+
+    SrgbLookups const&
+    get_srgb_lookups (void)
+    {
+        static SrgbLookups const lookups;
+        return lookups;
+    }
+
+#if defined(__SSE2__)
+    inline __m128
+    select_ps (__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    /* Returns log2(x) for positive normal values x. */
+    inline __m128
+    log2_ps (__m128 x)
+    {
+        __m128i const bits = _mm_castps_si128(x);
+        __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23),
+            _mm_set1_epi32(127));
+        __m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits,
+            _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+        /* Center the mantissa around 1 in [sqrt(1/2), sqrt(2)). */
+        __m128 const large = _mm_cmpgt_ps(mantissa, _mm_set1_ps(1.41421356f));
+        mantissa = select_ps(large, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f)),
+            mantissa);
+        exponent = _mm_sub_epi32(exponent, _mm_castps_si128(large));
+
+        /* log2(m) = 2 / ln(2) * atanh(t) with t = (m - 1) / (m + 1). */
+        __m128 const one = _mm_set1_ps(1.0f);
+        __m128 const t = _mm_div_ps(_mm_sub_ps(mantissa, one),
+            _mm_add_ps(mantissa, one));
+        __m128 const t2 = _mm_mul_ps(t, t);
+        __m128 poly = _mm_set1_ps(0.32059889f); // 2 / (9 ln 2)
+        poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(0.41219858f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(0.57707801f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(0.96179669f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, t2), _mm_set1_ps(2.88539008f));
+        return _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(poly, t));
+    }
+
+    /* Returns 2^y for y in the range of normal values. */
+    inline __m128
+    exp2_ps (__m128 y)
+    {
+        y = _mm_min_ps(_mm_set1_ps(127.0f),
+            _mm_max_ps(_mm_set1_ps(-126.0f), y));
+        __m128i const n = _mm_cvtps_epi32(y);
+        __m128 const f = _mm_sub_ps(y, _mm_cvtepi32_ps(n));
+
+        /* Taylor series of 2^f = e^(f ln 2) for f in [-1/2, 1/2]. */
+        __m128 poly = _mm_set1_ps(1.5252734e-5f);
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(1.5403530e-4f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(1.3333558e-3f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(9.6181291e-3f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(5.5504109e-2f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(2.4022651e-1f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(6.9314718e-1f));
+        poly = _mm_add_ps(_mm_mul_ps(poly, f), _mm_set1_ps(1.0f));
+        __m128 const scale = _mm_castsi128_ps(_mm_slli_epi32(
+            _mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+        return _mm_mul_ps(poly, scale);
+    }
+
+    inline __m128
+    srgb_ps (__m128 x)
+    {
+        __m128 const linear = _mm_mul_ps(x, _mm_set1_ps(12.92f));
+        __m128 const power = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.055f),
+            exp2_ps(_mm_mul_ps(log2_ps(x), _mm_set1_ps(1.0f / 2.4f)))),
+            _mm_set1_ps(0.055f));
+        return select_ps(_mm_cmple_ps(x, _mm_set1_ps(0.0031308f)),
+            linear, power);
+    }
+
+    inline __m128
+    inv_srgb_ps (__m128 x)
+    {
+        __m128 const linear = _mm_div_ps(x, _mm_set1_ps(12.92f));
+        __m128 const base = _mm_div_ps(_mm_add_ps(x, _mm_set1_ps(0.055f)),
+            _mm_set1_ps(1.055f));
+        __m128 const power = exp2_ps(_mm_mul_ps(log2_ps(base),
+            _mm_set1_ps(2.4f)));
+        return select_ps(_mm_cmple_ps(x, _mm_set1_ps(0.04045f)),
+            linear, power);
+    }
+
+    /*
+     * Applies the function to all values, four at a time. The remaining
+     * values are padded, so that all values get the same approximation.
+     */
+    template <typename FUNC>
+    void
+    apply_ps (FUNC const& func, FloatImage::Ptr image)
+    {
+        float* ptr = image->get_data_pointer();
+        int const num_values = image->get_value_amount();
+        int const num_blocks = num_values / 4;
+        int const num_threads = get_num_threads(image->get_pixel_amount());
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int i = 0; i < num_blocks; ++i)
+            _mm_storeu_ps(ptr + i * 4, func(_mm_loadu_ps(ptr + i * 4)));
+
+        int const rest = num_values - num_blocks * 4;
+        if (rest > 0)
+        {
+            float values[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            std::copy(ptr + num_blocks * 4, ptr + num_values, values);
+            _mm_storeu_ps(values, func(_mm_loadu_ps(values)));
+            std::copy(values, values + rest, ptr + num_blocks * 4);
+        }
+    }
+#endif
+}  // namespace
+
+template <>
+void
+gamma_correct_srgb<float> (FloatImage::Ptr image)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+#if defined(__SSE2__)
+    apply_ps(srgb_ps, image);
+#else
+    std::for_each(image->begin(), image->end(), [] (float& v)
+    {
+        v = v <= 0.0031308f ? v * 12.92f
+            : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    });
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+template <>
+void
+gamma_correct_inv_srgb<float> (FloatImage::Ptr image)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+#if defined(__SSE2__)
+    apply_ps(inv_srgb_ps, image);
+#else
+    std::for_each(image->begin(), image->end(), [] (float& v)
+    {
+        v = v <= 0.04045f ? v / 12.92f
+            : std::pow((v + 0.055f) / 1.055f, 2.4f);
+    });
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+gamma_correct_srgb (ByteImage::Ptr image)
+{
+    apply_lookup(get_srgb_lookups().forward, image);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+gamma_correct_inv_srgb (ByteImage::Ptr image)
+{
+    apply_lookup(get_srgb_lookups().inverse, image);
+}
+
+
+/*
+ * ----------------------- Image desaturation ----------------------
+ */
+
+namespace
+{
+    inline float
+    byte_to_unit (uint8_t value)
+    {
+        return std::min(1.0f, std::max(0.0f, (float)value / 255.0f));
+    }
+
+#if defined(__SSE2__)
+    /* Converts four byte values in the low 32 bit lanes to [0, 1]. */
+    inline __m128
+    epi32_to_unit (__m128i values)
+    {
+        __m128 const value = _mm_div_ps(_mm_cvtepi32_ps(values),
+            _mm_set1_ps(255.0f));
+        return _mm_min_ps(_mm_set1_ps(1.0f),
+            _mm_max_ps(_mm_setzero_ps(), value));
+    }
+#endif
+
+    /*
+     * Converts the leading pixels of a row with SSE2 and returns the number
+     * of processed pixels. Only the 16 byte loads within the row are used.
+     * The operations are those of the scalar version in the same order,
+     * which makes the results identical.
+     */
+    int
+    grayscale_pixels_sse (uint8_t const* row, int width, int ic,
+        DesaturateType type, float* out)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        __m128i const zero = _mm_setzero_si128();
+        if (ic == 1)
+        {
+            for (; x + 16 <= width; x += 16)
+            {
+                __m128i const bytes = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const*>(row + x));
+                __m128i const lo = _mm_unpacklo_epi8(bytes, zero);
+                __m128i const hi = _mm_unpackhi_epi8(bytes, zero);
+                _mm_storeu_ps(out + x,
+                    epi32_to_unit(_mm_unpacklo_epi16(lo, zero)));
+                _mm_storeu_ps(out + x + 4,
+                    epi32_to_unit(_mm_unpackhi_epi16(lo, zero)));
+                _mm_storeu_ps(out + x + 8,
+                    epi32_to_unit(_mm_unpacklo_epi16(hi, zero)));
+                _mm_storeu_ps(out + x + 12,
+                    epi32_to_unit(_mm_unpackhi_epi16(hi, zero)));
+            }
+            return x;
+        }
+
+        float weights[3];
+        switch (type)
+        {
+            case DESATURATE_LUMINOSITY:
+                weights[0] = 0.21f; weights[1] = 0.72f; weights[2] = 0.07f;
+                break;
+            case DESATURATE_LUMINANCE:
+                weights[0] = 0.30f; weights[1] = 0.59f; weights[2] = 0.11f;
+                break;
+            default:
+                std::fill(weights, weights + 3, 1.0f / 3.0f);
+                break;
+        }
+        __m128 const w0 = _mm_set1_ps(weights[0]);
+        __m128 const w1 = _mm_set1_ps(weights[1]);
+        __m128 const w2 = _mm_set1_ps(weights[2]);
+        __m128 const half = _mm_set1_ps(0.5f);
+
+        /* Four RGB pixels per iteration, the last four bytes are unused. */
+        for (; 3 * x + 16 <= 3 * width; x += 4)
+        {
+            __m128i const bytes = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(row + 3 * x));
+            __m128i const lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128 const a = epi32_to_unit(_mm_unpacklo_epi16(lo, zero));
+            __m128 const b = epi32_to_unit(_mm_unpackhi_epi16(lo, zero));
+            __m128 const c = epi32_to_unit(_mm_unpacklo_epi16(
+                _mm_unpackhi_epi8(bytes, zero), zero));
+
+            /* Deinterleave RGBR GBRG BRGB into the color channels. */
+            __m128 const red = _mm_shuffle_ps(a,
+                _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+                _MM_SHUFFLE(2, 0, 3, 0));
+            __m128 const green = _mm_shuffle_ps(
+                _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 const blue = _mm_shuffle_ps(
+                _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                _MM_SHUFFLE(2, 0, 2, 0));
+
+            __m128 gray;
+            if (type == DESATURATE_MAXIMUM)
+                gray = _mm_max_ps(_mm_max_ps(red, green), blue);
+            else if (type == DESATURATE_LIGHTNESS)
+                gray = _mm_add_ps(
+                    _mm_mul_ps(_mm_max_ps(_mm_max_ps(red, green), blue),
+                    half), _mm_mul_ps(_mm_min_ps(_mm_min_ps(red, green),
+                    blue), half));
+            else
+                gray = _mm_add_ps(_mm_add_ps(_mm_mul_ps(red, w0),
+                    _mm_mul_ps(green, w1)), _mm_mul_ps(blue, w2));
+            _mm_storeu_ps(out + x, gray);
+        }
+#else
+        (void)row;
+        (void)width;
+        (void)ic;
+        (void)type;
+        (void)out;
+#endif
+        return x;
+    }
+}  // namespace
+
+FloatImage::Ptr
+byte_to_float_grayscale (ByteImage::ConstPtr image, DesaturateType type)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+    return byte_to_float_grayscale(make_view(*image), type);
+}
+
+/* ---------------------------------------------------------------- */
+
+FloatImage::Ptr
+byte_to_float_grayscale (ImageView<uint8_t const> image,
+    DesaturateType type)
+{
+    int const ic = image.channels();
+    if (ic != 1 && ic != 3)
+        throw std::invalid_argument("Gray or RGB image expected");
+
+    typedef float(*DesaturateFunc)(float const*);
+    DesaturateFunc func;
+    switch (type)
+    {
+        case DESATURATE_MAXIMUM: func = desaturate_maximum<float>; break;
+        case DESATURATE_LIGHTNESS: func = desaturate_lightness<float>; break;
+        case DESATURATE_LUMINOSITY: func = desaturate_luminosity<float>; break;
+        case DESATURATE_LUMINANCE: func = desaturate_luminance<float>; break;
+        case DESATURATE_AVERAGE: func = desaturate_average<float>; break;
+        default: throw std::invalid_argument("Invalid desaturate type");
+    }
+
+    int const w = image.width();
+    int const h = image.height();
+    FloatImage::Ptr out = FloatImage::create();
+    out->allocate_uninitialized(w, h, 1);
+
+    int const num_threads = get_num_threads(w * h);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int y = 0; y < h; ++y)
+    {
+        uint8_t const* row = image.row(y);
+        float* out_row = out->get_data_pointer() + y * w;
+        int x = grayscale_pixels_sse(row, w, ic, type, out_row);
+        if (ic == 1)
+        {
+            for (; x < w; ++x)
+                out_row[x] = byte_to_unit(row[x]);
+            continue;
+        }
+        for (; x < w; ++x)
+        {
+            float const v[3] = { byte_to_unit(row[3 * x]),
+                byte_to_unit(row[3 * x + 1]), byte_to_unit(row[3 * x + 2]) };
+            out_row[x] = func(v);
+        }
+    }
+
+    return out;
+}
+
+
+/*
+ * ------------------------- Miscellaneous ------------------------
+ */
+
+namespace
+{
+    /*
+     * Sums up a row of bytes into doubles. Gray rows are scanned with SSE2,
+     * eight values at a time with 16 bit prefix sums in a register. The
+     * sums are integers and exact, as in the generic version.
+     */
+    void
+    integral_row (uint8_t const* in, int width, int chans, double* out)
+    {
+        int const row_values = width * chans;
+        int i = 0;
+#if defined(__SSE2__)
+        if (chans == 1)
+        {
+            __m128i const zero = _mm_setzero_si128();
+            double base = 0.0;
+            for (; i + 8 <= row_values; i += 8)
+            {
+                __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(
+                    reinterpret_cast<__m128i const*>(in + i)), zero);
+                v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+                v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+                v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+                __m128i const lo = _mm_unpacklo_epi16(v, zero);
+                __m128i const hi = _mm_unpackhi_epi16(v, zero);
+                __m128d const b = _mm_set1_pd(base);
+                _mm_storeu_pd(out + i, _mm_add_pd(b, _mm_cvtepi32_pd(lo)));
+                _mm_storeu_pd(out + i + 2, _mm_add_pd(b,
+                    _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0xee))));
+                _mm_storeu_pd(out + i + 4, _mm_add_pd(b, _mm_cvtepi32_pd(hi)));
+                _mm_storeu_pd(out + i + 6, _mm_add_pd(b,
+                    _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0xee))));
+                base = out[i + 7];
+            }
+        }
+#endif
+        for (; i < std::min(chans, row_values); ++i)
+            out[i] = static_cast<double>(in[i]);
+        for (; i < row_values; ++i)
+            out[i] = static_cast<double>(in[i]) + out[i - chans];
+    }
+
+    /* Adds the previous row to the values [i0, i1) of the row. */
+    void
+    integral_add_row (double const* prev, int i0, int i1, double* row)
+    {
+        int i = i0;
+#if defined(__SSE2__)
+        for (; i + 2 <= i1; i += 2)
+            _mm_storeu_pd(row + i, _mm_add_pd(_mm_loadu_pd(row + i),
+                _mm_loadu_pd(prev + i)));
+#endif
+        for (; i < i1; ++i)
+            row[i] += prev[i];
+    }
+}  // namespace
+
+template <>
+Image<double>::Ptr
+integral_image<uint8_t, double> (ByteImage::ConstPtr image)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+
+    int const width = image->width();
+    int const height = image->height();
+    int const chans = image->channels();
+    int const row_stride = width * chans;
+
+    Image<double>::Ptr ret(Image<double>::create());
+    ret->allocate_uninitialized(width, height, chans);
+
+    int const num_threads = get_num_threads(width * height);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int y = 0; y < height; ++y)
+        integral_row(image->get_data_pointer() + y * row_stride, width,
+            chans, ret->get_data_pointer() + y * row_stride);
+
+    int const band_width = 1024;
+    int const num_bands = (row_stride + band_width - 1) / band_width;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int b = 0; b < num_bands; ++b)
+    {
+        int const i0 = b * band_width;
+        int const i1 = std::min(row_stride, i0 + band_width);
+        for (int y = 1; y < height; ++y)
+        {
+            double* row = ret->get_data_pointer() + y * row_stride;
+            integral_add_row(row - row_stride, i0, i1, row);
+        }
+    }
+
+    return ret;
+}
+
+
+/*
+ * ------------------ Normalized cross-correlation ------------------
+ */
+
+namespace
+{
+    /* The squared value ranges of the untextured window test. */
+    template <typename T>
+    float
+    ncc_squared_range (void);
+
+    template <>
+    inline float
+    ncc_squared_range<uint8_t> (void)
+    {
+        return 255.0f * 255.0f;
+    }
+
+    template <>
+    inline float
+    ncc_squared_range<float> (void)
+    {
+        return 1.0f;
+    }
+
+    inline int
+    clamp_index (int value, int size)
+    {
+        return std::max(0, std::min(size - 1, value));
+    }
+
+    template <typename T>
+    FloatImage::Ptr
+    ncc_window_statistics_intern (ImageView<T const> image, int radius,
+        int step)
+    {
+        if (image.channels() != 1)
+            throw std::invalid_argument("Gray image expected");
+        if (radius < 0 || step < 1)
+            throw std::invalid_argument("Invalid NCC window");
+
+        int const width = image.width();
+        int const height = image.height();
+        int const range = (radius / step) * step;
+        int const num_samples = MATH_POW2(2 * (radius / step) + 1);
+        float const min_variance = 1e-5f * ncc_squared_range<T>()
+            * static_cast<float>(num_samples);
+
+        /*
+         * Window sums of the values and the squares along the rows. The
+         * sums of a pixel are the sums 'step' pixels before, plus the new
+         * sample and minus the sample that left the window.
+         */
+        std::vector<double> row_sums(2 * width * height);
+        int const num_threads = get_num_threads(width * height);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < height; ++y)
+        {
+            T const* row = image.row(y);
+            double* sums = &row_sums[2 * y * width];
+            for (int x = 0; x < std::min(step, width); ++x)
+            {
+                double sum = 0.0, square_sum = 0.0;
+                for (int k = -range; k <= range; k += step)
+                {
+                    double const value = row[clamp_index(x + k, width)];
+                    sum += value;
+                    square_sum += value * value;
+                }
+                sums[2 * x + 0] = sum;
+                sums[2 * x + 1] = square_sum;
+            }
+            for (int x = step; x < width; ++x)
+            {
+                double const add = row[clamp_index(x + range, width)];
+                double const sub = row[clamp_index(x - range - step, width)];
+                sums[2 * x + 0] = sums[2 * (x - step) + 0] + add - sub;
+                sums[2 * x + 1] = sums[2 * (x - step) + 1]
+                    + add * add - sub * sub;
+            }
+        }
+
+        /*
+         * The row sums are accumulated along the columns in the same way,
+         * in bands of columns. Only the window sums of the last 'step'
+         * rows are kept.
+         */
+        FloatImage::Ptr ret = FloatImage::create();
+        ret->allocate_uninitialized(width, height, 2);
+        int const band_width = 512;
+        int const num_bands = (width + band_width - 1) / band_width;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int b = 0; b < num_bands; ++b)
+        {
+            int const x0 = b * band_width;
+            int const x1 = std::min(width, x0 + band_width);
+            int const values = 2 * (x1 - x0);
+            std::vector<double> window_sums(step * values, 0.0);
+            for (int y = 0; y < height; ++y)
+            {
+                double* sums = &window_sums[(y % step) * values];
+                if (y < step)
+                {
+                    std::fill(sums, sums + values, 0.0);
+                    for (int k = -range; k <= range; k += step)
+                    {
+                        double const* row = &row_sums[2 * (clamp_index(
+                            y + k, height) * width + x0)];
+                        for (int i = 0; i < values; ++i)
+                            sums[i] += row[i];
+                    }
+                }
+                else
+                {
+                    double const* add = &row_sums[2 * (clamp_index(
+                        y + range, height) * width + x0)];
+                    double const* sub = &row_sums[2 * (clamp_index(
+                        y - range - step, height) * width + x0)];
+                    for (int i = 0; i < values; ++i)
+                        sums[i] += add[i] - sub[i];
+                }
+
+                float* out = &ret->at(x0, y, 0);
+                for (int i = 0; i < values; i += 2)
+                {
+                    double const mean = sums[i] / num_samples;
+                    double const variance = sums[i + 1] - sums[i] * mean;
+                    out[i + 0] = static_cast<float>(mean);
+                    out[i + 1] = variance < min_variance ? 0.0f
+                        : static_cast<float>(1.0 / std::sqrt(variance));
+                }
+            }
+        }
+
+        return ret;
+    }
+
+    template <typename T>
+    bool
+    ncc_window_intern (ImageView<T const> image,
+        FloatImage const& statistics, int x, int y, int radius, int step,
+        float* values)
+    {
+        float const mean = statistics.at(x, y, 0);
+        float const inv_norm = statistics.at(x, y, 1);
+        if (inv_norm == 0.0f)
+            return false;
+
+        int const width = image.width();
+        int const height = image.height();
+        int const range = (radius / step) * step;
+        for (int dy = -range; dy <= range; dy += step)
+        {
+            T const* row = image.row(clamp_index(y + dy, height));
+            for (int dx = -range; dx <= range; dx += step, ++values)
+                *values = (static_cast<float>(row[clamp_index(x + dx,
+                    width)]) - mean) * inv_norm;
+        }
+        return true;
+    }
+
+#if defined(__AVX2__)
+    /* Gathers the four bilinear neighbors of eight pixels. */
+    inline void
+    gather_bilinear (float const* data, __m256i index, int stride,
+        __m256* v00, __m256* v01, __m256* v10, __m256* v11)
+    {
+        __m256i const below = _mm256_add_epi32(index,
+            _mm256_set1_epi32(stride));
+        *v00 = _mm256_i32gather_ps(data, index, 4);
+        *v01 = _mm256_i32gather_ps(data + 1, index, 4);
+        *v10 = _mm256_i32gather_ps(data, below, 4);
+        *v11 = _mm256_i32gather_ps(data + 1, below, 4);
+    }
+
+    /*
+     * Byte pixels are gathered as 32 bit words. The lower row is read from
+     * two bytes before the pixel, which keeps all reads inside the image
+     * for images of at least 2x2 pixels.
+     */
+    inline void
+    gather_bilinear (uint8_t const* data, __m256i index, int stride,
+        __m256* v00, __m256* v01, __m256* v10, __m256* v11)
+    {
+        int const* words = reinterpret_cast<int const*>(data);
+        __m256i const mask = _mm256_set1_epi32(0xff);
+        __m256i const upper = _mm256_i32gather_epi32(words, index, 1);
+        __m256i const lower = _mm256_i32gather_epi32(words,
+            _mm256_add_epi32(index, _mm256_set1_epi32(stride - 2)), 1);
+        *v00 = _mm256_cvtepi32_ps(_mm256_and_si256(upper, mask));
+        *v01 = _mm256_cvtepi32_ps(_mm256_and_si256(
+            _mm256_srli_epi32(upper, 8), mask));
+        *v10 = _mm256_cvtepi32_ps(_mm256_and_si256(
+            _mm256_srli_epi32(lower, 16), mask));
+        *v11 = _mm256_cvtepi32_ps(_mm256_srli_epi32(lower, 24));
+    }
+
+    inline float
+    horizontal_sum (__m256 v)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+            _mm256_extractf128_ps(v, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+        return _mm_cvtss_f32(sum);
+    }
+#endif
+
+#if defined(__SSE2__)
+    inline float
+    horizontal_sum (__m128 v)
+    {
+        __m128 sum = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+        return _mm_cvtss_f32(sum);
+    }
+#endif
+
+    /*
+     * The warped NCC of all windows. The sample positions of a window are
+     * the center mapped with the homography, plus the mapped offsets of
+     * the samples. SIMD lanes compute consecutive samples of the window,
+     * the remaining samples are computed one by one.
+     */
+    template <typename T>
+    void
+    warped_ncc_intern (ImageView<T const> image, int radius, int step,
+        float const* reference, std::size_t reference_stride,
+        float const* centers, float const* homographies,
+        std::size_t num_windows, float* result)
+    {
+        if (image.channels() != 1)
+            throw std::invalid_argument("Gray image expected");
+        if (image.width() < 2 || image.height() < 2)
+            throw std::invalid_argument("Image too small for NCC");
+        if (radius < 0 || step < 1)
+            throw std::invalid_argument("Invalid NCC window");
+
+        int const width = image.width();
+        int const height = image.height();
+        int const range = (radius / step) * step;
+        int const num_samples = MATH_POW2(2 * (radius / step) + 1);
+        float const min_variance = 1e-5f * ncc_squared_range<T>()
+            * static_cast<float>(num_samples);
+
+        std::vector<float> offset_x, offset_y;
+        offset_x.reserve(num_samples);
+        offset_y.reserve(num_samples);
+        for (int dy = -range; dy <= range; dy += step)
+            for (int dx = -range; dx <= range; dx += step)
+            {
+                offset_x.push_back(static_cast<float>(dx));
+                offset_y.push_back(static_cast<float>(dy));
+            }
+
+        T const* data = image.get_data_pointer();
+        int const stride = image.row_stride();
+        float const max_x = static_cast<float>(width - 1);
+        float const max_y = static_cast<float>(height - 1);
+        for (std::size_t i = 0; i < num_windows; ++i)
+        {
+            float const* h = homographies + 9 * i;
+            float const cx = centers[2 * i + 0];
+            float const cy = centers[2 * i + 1];
+            float const bx = h[0] * cx + h[1] * cy + h[2];
+            float const by = h[3] * cx + h[4] * cy + h[5];
+            float const bz = h[6] * cx + h[7] * cy + h[8];
+            if (!(bz > 0.0f))
+            {
+                result[i] = -1.0f;
+                continue;
+            }
+            float const center_x = bx / bz - 0.5f;
+            float const center_y = by / bz - 0.5f;
+            if (!(center_x >= 0.0f && center_y >= 0.0f
+                && center_x <= max_x && center_y <= max_y))
+            {
+                result[i] = -1.0f;
+                continue;
+            }
+
+            float const* ref = reference + i * reference_stride;
+            float dot = 0.0f, sum = 0.0f, square_sum = 0.0f;
+            int j = 0;
+#if defined(__AVX2__)
+            {
+                __m256 const h0 = _mm256_set1_ps(h[0]);
+                __m256 const h1 = _mm256_set1_ps(h[1]);
+                __m256 const h3 = _mm256_set1_ps(h[3]);
+                __m256 const h4 = _mm256_set1_ps(h[4]);
+                __m256 const h6 = _mm256_set1_ps(h[6]);
+                __m256 const h7 = _mm256_set1_ps(h[7]);
+                __m256 const zero = _mm256_setzero_ps();
+                __m256 const half = _mm256_set1_ps(0.5f);
+                __m256 const vmax_x = _mm256_set1_ps(max_x);
+                __m256 const vmax_y = _mm256_set1_ps(max_y);
+                __m256 const vlast_x = _mm256_set1_ps(max_x - 1.0f);
+                __m256 const vlast_y = _mm256_set1_ps(max_y - 1.0f);
+                __m256i const vstride = _mm256_set1_epi32(stride);
+                __m256 vdot = zero, vsum = zero, vsquare_sum = zero;
+                for (; j + 8 <= num_samples; j += 8)
+                {
+                    __m256 const ox = _mm256_loadu_ps(&offset_x[j]);
+                    __m256 const oy = _mm256_loadu_ps(&offset_y[j]);
+                    __m256 const z = _mm256_add_ps(_mm256_set1_ps(bz),
+                        _mm256_add_ps(_mm256_mul_ps(h6, ox),
+                        _mm256_mul_ps(h7, oy)));
+                    __m256 const inv_z = _mm256_div_ps(_mm256_set1_ps(1.0f), z);
+                    __m256 x = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(
+                        _mm256_set1_ps(bx), _mm256_add_ps(_mm256_mul_ps(h0, ox),
+                        _mm256_mul_ps(h1, oy))), inv_z), half);
+                    __m256 y = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(
+                        _mm256_set1_ps(by), _mm256_add_ps(_mm256_mul_ps(h3, ox),
+                        _mm256_mul_ps(h4, oy))), inv_z), half);
+                    x = _mm256_min_ps(_mm256_max_ps(x, zero), vmax_x);
+                    y = _mm256_min_ps(_mm256_max_ps(y, zero), vmax_y);
+                    __m256i const ix = _mm256_cvttps_epi32(
+                        _mm256_min_ps(x, vlast_x));
+                    __m256i const iy = _mm256_cvttps_epi32(
+                        _mm256_min_ps(y, vlast_y));
+                    __m256 const wx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(ix));
+                    __m256 const wy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(iy));
+
+                    __m256 v00, v01, v10, v11;
+                    gather_bilinear(data, _mm256_add_epi32(ix,
+                        _mm256_mullo_epi32(iy, vstride)), stride,
+                        &v00, &v01, &v10, &v11);
+                    __m256 const top = _mm256_add_ps(v00,
+                        _mm256_mul_ps(wx, _mm256_sub_ps(v01, v00)));
+                    __m256 const bottom = _mm256_add_ps(v10,
+                        _mm256_mul_ps(wx, _mm256_sub_ps(v11, v10)));
+                    __m256 const value = _mm256_add_ps(top,
+                        _mm256_mul_ps(wy, _mm256_sub_ps(bottom, top)));
+
+                    vdot = _mm256_add_ps(vdot, _mm256_mul_ps(value,
+                        _mm256_loadu_ps(ref + j)));
+                    vsum = _mm256_add_ps(vsum, value);
+                    vsquare_sum = _mm256_add_ps(vsquare_sum,
+                        _mm256_mul_ps(value, value));
+                }
+                dot += horizontal_sum(vdot);
+                sum += horizontal_sum(vsum);
+                square_sum += horizontal_sum(vsquare_sum);
+            }
+#elif defined(__SSE2__)
+            {
+                __m128 const h0 = _mm_set1_ps(h[0]);
+                __m128 const h1 = _mm_set1_ps(h[1]);
+                __m128 const h3 = _mm_set1_ps(h[3]);
+                __m128 const h4 = _mm_set1_ps(h[4]);
+                __m128 const h6 = _mm_set1_ps(h[6]);
+                __m128 const h7 = _mm_set1_ps(h[7]);
+                __m128 const zero = _mm_setzero_ps();
+                __m128 const half = _mm_set1_ps(0.5f);
+                __m128 const vmax_x = _mm_set1_ps(max_x);
+                __m128 const vmax_y = _mm_set1_ps(max_y);
+                __m128 const vlast_x = _mm_set1_ps(max_x - 1.0f);
+                __m128 const vlast_y = _mm_set1_ps(max_y - 1.0f);
+                __m128 vdot = zero, vsum = zero, vsquare_sum = zero;
+                alignas(16) int ix[4], iy[4];
+                for (; j + 4 <= num_samples; j += 4)
+                {
+                    __m128 const ox = _mm_loadu_ps(&offset_x[j]);
+                    __m128 const oy = _mm_loadu_ps(&offset_y[j]);
+                    __m128 const z = _mm_add_ps(_mm_set1_ps(bz),
+                        _mm_add_ps(_mm_mul_ps(h6, ox), _mm_mul_ps(h7, oy)));
+                    __m128 const inv_z = _mm_div_ps(_mm_set1_ps(1.0f), z);
+                    __m128 x = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(
+                        _mm_set1_ps(bx), _mm_add_ps(_mm_mul_ps(h0, ox),
+                        _mm_mul_ps(h1, oy))), inv_z), half);
+                    __m128 y = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(
+                        _mm_set1_ps(by), _mm_add_ps(_mm_mul_ps(h3, ox),
+                        _mm_mul_ps(h4, oy))), inv_z), half);
+                    x = _mm_min_ps(_mm_max_ps(x, zero), vmax_x);
+                    y = _mm_min_ps(_mm_max_ps(y, zero), vmax_y);
+                    __m128i const vix = _mm_cvttps_epi32(
+                        _mm_min_ps(x, vlast_x));
+                    __m128i const viy = _mm_cvttps_epi32(
+                        _mm_min_ps(y, vlast_y));
+                    __m128 const wx = _mm_sub_ps(x, _mm_cvtepi32_ps(vix));
+                    __m128 const wy = _mm_sub_ps(y, _mm_cvtepi32_ps(viy));
+
+                    /* SSE2 has no gathers, the pixels are loaded one by one. */
+                    _mm_store_si128(reinterpret_cast<__m128i*>(ix), vix);
+                    _mm_store_si128(reinterpret_cast<__m128i*>(iy), viy);
+                    T const* p0 = data + iy[0] * stride + ix[0];
+                    T const* p1 = data + iy[1] * stride + ix[1];
+                    T const* p2 = data + iy[2] * stride + ix[2];
+                    T const* p3 = data + iy[3] * stride + ix[3];
+                    __m128 const v00 = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+                    __m128 const v01 = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+                    __m128 const v10 = _mm_setr_ps(p0[stride], p1[stride],
+                        p2[stride], p3[stride]);
+                    __m128 const v11 = _mm_setr_ps(p0[stride + 1],
+                        p1[stride + 1], p2[stride + 1], p3[stride + 1]);
+                    __m128 const top = _mm_add_ps(v00,
+                        _mm_mul_ps(wx, _mm_sub_ps(v01, v00)));
+                    __m128 const bottom = _mm_add_ps(v10,
+                        _mm_mul_ps(wx, _mm_sub_ps(v11, v10)));
+                    __m128 const value = _mm_add_ps(top,
+                        _mm_mul_ps(wy, _mm_sub_ps(bottom, top)));
+
+                    vdot = _mm_add_ps(vdot, _mm_mul_ps(value,
+                        _mm_loadu_ps(ref + j)));
+                    vsum = _mm_add_ps(vsum, value);
+                    vsquare_sum = _mm_add_ps(vsquare_sum,
+                        _mm_mul_ps(value, value));
+                }
+                dot += horizontal_sum(vdot);
+                sum += horizontal_sum(vsum);
+                square_sum += horizontal_sum(vsquare_sum);
+            }
+#endif
+            for (; j < num_samples; ++j)
+            {
+                float const ox = offset_x[j];
+                float const oy = offset_y[j];
+                float const inv_z = 1.0f / (bz + h[6] * ox + h[7] * oy);
+                float x = (bx + h[0] * ox + h[1] * oy) * inv_z - 0.5f;
+                float y = (by + h[3] * ox + h[4] * oy) * inv_z - 0.5f;
+                x = std::min(std::max(x, 0.0f), max_x);
+                y = std::min(std::max(y, 0.0f), max_y);
+                int const ix = static_cast<int>(std::min(x, max_x - 1.0f));
+                int const iy = static_cast<int>(std::min(y, max_y - 1.0f));
+                float const wx = x - static_cast<float>(ix);
+                float const wy = y - static_cast<float>(iy);
+                T const* p = data + iy * stride + ix;
+                float const top = static_cast<float>(p[0]) + wx
+                    * (static_cast<float>(p[1]) - static_cast<float>(p[0]));
+                float const bottom = static_cast<float>(p[stride]) + wx
+                    * (static_cast<float>(p[stride + 1])
+                    - static_cast<float>(p[stride]));
+                float const value = top + wy * (bottom - top);
+                dot += value * ref[j];
+                sum += value;
+                square_sum += value * value;
+            }
+
+            float const variance = square_sum - sum * sum
+                / static_cast<float>(num_samples);
+            if (variance < min_variance)
+                result[i] = -1.0f;
+            else
+                result[i] = std::max(-1.0f,
+                    std::min(1.0f, dot / std::sqrt(variance)));
+        }
+    }
+}  // namespace
+
+FloatImage::Ptr
+ncc_window_statistics (ByteImage::ConstPtr image, int radius, int step)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+    return ncc_window_statistics_intern(make_view(*image), radius, step);
+}
+
+/* ---------------------------------------------------------------- */
+
+FloatImage::Ptr
+ncc_window_statistics (FloatImage::ConstPtr image, int radius, int step)
+{
+    if (image == nullptr)
+        throw std::invalid_argument("Null image given");
+    return ncc_window_statistics_intern(make_view(*image), radius, step);
+}
+
+/* ---------------------------------------------------------------- */
+
+FloatImage::Ptr
+ncc_window_statistics (ImageView<uint8_t const> image, int radius, int step)
+{
+    return ncc_window_statistics_intern(image, radius, step);
+}
+
+/* ---------------------------------------------------------------- */
+
+FloatImage::Ptr
+ncc_window_statistics (ImageView<float const> image, int radius, int step)
+{
+    return ncc_window_statistics_intern(image, radius, step);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ncc_window (ByteImage const& image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values)
+{
+    return ncc_window_intern(make_view(image), statistics, x, y, radius,
+        step, values);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ncc_window (FloatImage const& image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values)
+{
+    return ncc_window_intern(make_view(image), statistics, x, y, radius,
+        step, values);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ncc_window (ImageView<uint8_t const> image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values)
+{
+    return ncc_window_intern(image, statistics, x, y, radius, step, values);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ncc_window (ImageView<float const> image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values)
+{
+    return ncc_window_intern(image, statistics, x, y, radius, step, values);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+warped_ncc (ByteImage const& image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result)
+{
+    warped_ncc_intern(make_view(image), radius, step, reference,
+        reference_stride, centers, homographies, num_windows, result);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+warped_ncc (FloatImage const& image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result)
+{
+    warped_ncc_intern(make_view(image), radius, step, reference,
+        reference_stride, centers, homographies, num_windows, result);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+warped_ncc (ImageView<uint8_t const> image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result)
+{
+    warped_ncc_intern(image, radius, step, reference, reference_stride,
+        centers, homographies, num_windows, result);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+warped_ncc (ImageView<float const> image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result)
+{
+    warped_ncc_intern(image, radius, step, reference, reference_stride,
+        centers, homographies, num_windows, result);
+}
+
 CORE_IMAGE_NAMESPACE_END
 CORE_NAMESPACE_END
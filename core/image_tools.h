@@ -10,20 +10,49 @@
 #ifndef MVE_IMAGE_TOOLS_HEADER
 #define MVE_IMAGE_TOOLS_HEADER
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <limits>
-#include <complex>
+#include <memory>
 #include <type_traits>
+#include <vector>
 
 #include "util/exception.h"
 #include "math/accum.h"
 #include "math/functions.h"
 #include "core/defines.h"
 #include "core/image.h"
+#include "core/image_view.h"
 
 CORE_NAMESPACE_BEGIN
 CORE_IMAGE_NAMESPACE_BEGIN
 
+/*
+ * ----------------------- Parallel execution --------------------
+ */
+
+/**
+ * Sets the number of threads of the image operations. Operations split
+ * the output rows into bands, which are processed in parallel with OpenMP.
+ * 0 uses util::ThreadPool::get_num_threads(), or 1 within pool tasks, and
+ * 1 disables the parallelism. Images with less than 'min_pixels' pixels
+ * are processed by one thread, for these the threading overhead dominates.
+ * The results do not depend on the number of threads. The setting is
+ * global and defaults to (0, 65536).
+ */
+void
+set_num_threads (int num_threads, int min_pixels = 65536);
+
+/**
+ * Returns the number of threads for an operation on an image with the
+ * given number of pixels. This is 1 without OpenMP and when called from
+ * within a parallel region, which avoids oversubscription.
+ */
+int
+get_num_threads (std::size_t num_pixels);
+
 /*
  * ----------------------- Image conversions ---------------------
  */
@@ -35,6 +64,17 @@ CORE_IMAGE_NAMESPACE_BEGIN
 FloatImage::Ptr
 byte_to_float_image (ByteImage::ConstPtr image);
 
+/**
+ * Converts a given byte image to a float image and places the result in
+ * 'out'. The output storage is reused if it is large enough.
+ */
+void
+byte_to_float_image (ByteImage::ConstPtr image, FloatImage::Ptr out);
+
+/** Converts the pixels of a view of a byte image to a new float image. */
+FloatImage::Ptr
+byte_to_float_image (ImageView<uint8_t const> image);
+
 /** Converts a given byte image to a double image.
  * This is done by scaling from [0, 255] to [0, 1].
  */
@@ -139,6 +179,58 @@ typename Image<T>::Ptr
 image_undistort_vsfm (typename Image<T>::ConstPtr img,
     double focal_length, double k1);
 
+/**
+ * Precomputed bilinear lookups of an undistortion for one image size.
+ * For each output pixel the map stores the top-left input pixel, whether
+ * the right and lower neighbors are available, and the four bilinear
+ * weights. The map does not depend on the image type or the channels, so
+ * all images of one camera are undistorted with one model evaluation.
+ */
+struct UndistortionMap
+{
+    typedef std::shared_ptr<UndistortionMap const> ConstPtr;
+
+    struct Lookup
+    {
+        /** The top-left input pixel, or -1 if the pixel is outside. */
+        int32_t pixel;
+        /** 1 if the right and lower neighbors exist, 0 at the border. */
+        uint8_t step_x;
+        uint8_t step_y;
+        float weights[4];
+    };
+
+    int width;
+    int height;
+    std::vector<Lookup> lookups;
+};
+
+/**
+ * Returns the undistortion map of image_undistort_msps() for the image
+ * size. The maps of the recently used cameras are cached, and all
+ * image_undistort_*() functions use these maps.
+ */
+UndistortionMap::ConstPtr
+undistortion_map_msps (int width, int height, double k0, double k1);
+
+/** Returns the undistortion map of image_undistort_k2k4(), see above. */
+UndistortionMap::ConstPtr
+undistortion_map_k2k4 (int width, int height,
+    double focal_length, double k2, double k4);
+
+/** Returns the undistortion map of image_undistort_vsfm(), see above. */
+UndistortionMap::ConstPtr
+undistortion_map_vsfm (int width, int height,
+    double focal_length, double k1);
+
+/**
+ * Resamples the image with the undistortion map. Output pixels outside of
+ * the input image are set to zero. The image size must match the map.
+ */
+template <typename T>
+typename Image<T>::Ptr
+image_remap (typename Image<T>::ConstPtr img, UndistortionMap const& map);
+
 /*
  * ------------------- Image scaling and cropping -----------------
  */
@@ -201,6 +293,61 @@ template <typename T>
 typename Image<T>::Ptr
 rescale_half_size_subsample (typename Image<T>::ConstPtr image);
 
+/**
+ * Variants of the half-size rescalings that place the result in 'out'.
+ * The output storage is reused if it is large enough, which avoids the
+ * allocations in image pyramids. Input and output must not be the same.
+ */
+template <typename T>
+void
+rescale_half_size (typename Image<T>::ConstPtr image,
+    typename Image<T>::Ptr out);
+
+template <typename T>
+void
+rescale_half_size_gaussian (typename Image<T>::ConstPtr image,
+    typename Image<T>::Ptr out, float sigma = 0.866025403784439f);
+
+template <typename T>
+void
+rescale_half_size_subsample (typename Image<T>::ConstPtr image,
+    typename Image<T>::Ptr out);
+
+/**
+ * Specializations of the half-size rescaling for byte and float images.
+ * Images with 1 and 3 channels are processed with SSE2 instructions (if
+ * enabled at compile time), a block of output values of two source rows
+ * (four for the gaussian) at a time. The results are identical to the
+ * generic versions, other channel counts use the generic code path.
+ */
+template <>
+void
+rescale_half_size<uint8_t> (ByteImage::ConstPtr image, ByteImage::Ptr out);
+
+template <>
+void
+rescale_half_size<float> (FloatImage::ConstPtr image, FloatImage::Ptr out);
+
+template <>
+void
+rescale_half_size_gaussian<uint8_t> (ByteImage::ConstPtr image,
+    ByteImage::Ptr out, float sigma);
+
+template <>
+void
+rescale_half_size_gaussian<float> (FloatImage::ConstPtr image,
+    FloatImage::Ptr out, float sigma);
+
+template <>
+void
+rescale_half_size_subsample<uint8_t> (ByteImage::ConstPtr image,
+    ByteImage::Ptr out);
+
+template <>
+void
+rescale_half_size_subsample<float> (FloatImage::ConstPtr image,
+    FloatImage::Ptr out);
+
 /**
  * Returns a rescaled version of the image, upscaled with linear
  * interpolation by factor 2. In this version, only interpolated values
@@ -266,6 +413,24 @@ template <typename T>
 typename Image<T>::Ptr
 blur_gaussian (typename Image<T>::ConstPtr in, float sigma);
 
+/**
+ * Specialization of the gaussian blur for float images. The kernel is
+ * evaluated with SSE or AVX instructions (if enabled at compile time) and
+ * the vertical pass is processed in cache-sized column strips without an
+ * intermediate image. The result is identical to the generic version.
+ */
+template <>
+FloatImage::Ptr
+blur_gaussian<float> (FloatImage::ConstPtr in, float sigma);
+
+/**
+ * Blurs the float image 'in' using a gaussian convolution kernel and
+ * places the result in 'out'. The output image is reallocated only if
+ * its dimensions do not match. Input and output must not be the same.
+ */
+void
+blur_gaussian (FloatImage::ConstPtr in, FloatImage::Ptr out, float sigma);
+
 /**
  * Blurs the image using a box filter of integer size 'ks'.
  * The implementaion is separated, and much faster than Gaussian blur,
@@ -294,7 +459,8 @@ enum RotateType
  * Swapping x- and y-axis is not a real rotation but rather transposing.
  * Note: In-place not supported because CW, CCW rotation and swap changes
  * image dimensions. An in-place version of ROTATE_180 is available using
- * in-place flipping in both directions.
+ * in-place flipping in both directions. The column-wise reads of the 90
+ * degree rotations and the swap are done in cache-sized tiles.
  */
 template <typename T>
 typename Image<T>::Ptr
@@ -321,6 +487,7 @@ enum FlipType
 
 /**
  * Flips the given image either horizontally, vertically or both IN-PLACE.
+ * Rows are processed in parallel for large images.
  */
 template <typename T>
 void
@@ -356,6 +523,23 @@ template <typename T>
 typename Image<T>::Ptr
 desaturate (typename Image<T>::ConstPtr image, DesaturateType type);
 
+/**
+ * Converts a gray or RGB byte image to a gray float image in [0, 1] in a
+ * single pass. This is the input of the feature detectors and gives the
+ * same result as byte_to_float_image() followed by desaturate(), but
+ * avoids the intermediate float RGB image. Gray images are only converted.
+ */
+FloatImage::Ptr
+byte_to_float_grayscale (ByteImage::ConstPtr image, DesaturateType type);
+
+/**
+ * Converts the pixels of a view to a new float gray image. Regions of an
+ * image, for example tiles, can be converted without copying them first.
+ */
+FloatImage::Ptr
+byte_to_float_grayscale (ImageView<uint8_t const> image,
+    DesaturateType type);
+
 /**
  * Expands a gray image (one or two channels) to an RGB or RGBA image.
  */
@@ -375,6 +559,8 @@ reduce_alpha (typename core::Image<T>::Ptr img); // TODO Blend color?
  * For details, see http://en.wikipedia.org/wiki/Sobel_operator
  * For byte images, the operation can lead to clipped values.
  * Likewise for floating point images, it leads to values >1.
+ * Byte images are computed in float precision, which gives the same result
+ * as double precision, and the rows are vectorized with OpenMP SIMD.
  */
 template <typename T>
 typename core::Image<T>::Ptr
@@ -390,6 +576,16 @@ template <typename T>
 typename Image<T>::Ptr
 subtract (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2);
 
+/**
+ * Subtracts two images and places the result in 'out', which may be one
+ * of the inputs for in-place operation. The output storage is reused if
+ * it has the size of the inputs. The rows are vectorized with OpenMP SIMD.
+ */
+template <typename T>
+void
+subtract (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2,
+    typename Image<T>::Ptr out);
+
 /**
  * Creates a difference image by computing the absolute difference per value.
  * This works for unsigned image types but discards the sign.
@@ -399,6 +595,16 @@ template <typename T>
 typename Image<T>::Ptr
 difference (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2);
 
+/**
+ * Computes the absolute difference of two images and places the result in
+ * 'out', which may be one of the inputs for in-place operation.
+ * The rows are vectorized with OpenMP SIMD.
+ */
+template <typename T>
+void
+difference (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2,
+    typename Image<T>::Ptr out);
+
 /**
  * Applies gamma correction to float/double images (in-place).
  * To obtain color values from linear intensities, use 1/2.2 as exponent.
@@ -423,12 +629,25 @@ gamma_correct (ByteImage::Ptr image, float power);
  *   X' = 12.92 * X                   if X <= 0.0031308
  *   X' = 1.055 * X^(1/2.4) - 0.055   otherwise
  *
- * TODO: Implement overloading for integer image types.
+ * Float images are corrected with SSE2 instructions (if enabled at compile
+ * time) and a polynomial approximation of the power function with a
+ * relative error below 1e-6. Byte images are corrected with the overload.
  */
 template <typename T>
 void
 gamma_correct_srgb (typename Image<T>::Ptr image);
 
+template <>
+void
+gamma_correct_srgb<float> (FloatImage::Ptr image);
+
+/**
+ * Applies the sRGB gamma correction to byte images with values in
+ * [0, 255] using a lookup table of the rounded results.
+ */
+void
+gamma_correct_srgb (ByteImage::Ptr image);
+
 /**
  * Applies inverse gamma correction to float/double (in-place) images with
  * nonlinear R'G'B' values in the range [0, 1] to linear sRGB values according
@@ -437,21 +656,42 @@ gamma_correct_srgb (typename Image<T>::Ptr image);
  *   X = X' / 12.92                     if X' <= 0.04045
  *   X = ((X' + 0.055) / (1.055))^2.4   otherwise
  *
- * TODO: Implement overloading for integer image types.
+ * Float images are corrected like in gamma_correct_srgb().
  */
 template <typename T>
 void
 gamma_correct_inv_srgb (typename Image<T>::Ptr image);
 
+template <>
+void
+gamma_correct_inv_srgb<float> (FloatImage::Ptr image);
+
+/**
+ * Applies the inverse sRGB gamma correction to byte images with values
+ * in [0, 255] using a lookup table of the rounded results.
+ */
+void
+gamma_correct_inv_srgb (ByteImage::Ptr image);
+
 /**
  * Calculates the integral image (or summed area table) for the input image.
  * The integral image is computed channel-wise, i.e. the output image has
- * the same amount of channels as the input image.
+ * the same amount of channels as the input image. The rows are summed up
+ * first and the row sums are then accumulated in y, both in parallel.
  */
 template <typename T_IN, typename T_OUT>
 typename Image<T_OUT>::Ptr
 integral_image (typename Image<T_IN>::ConstPtr image);
 
+/**
+ * Specialization for the byte SATs of SURF, which accumulates the rows
+ * with SSE2 instructions (if enabled at compile time). The result is
+ * identical to the generic version.
+ */
+template <>
+Image<double>::Ptr
+integral_image<uint8_t, double> (ByteImage::ConstPtr image);
+
 /**
  * Sums over the rectangle defined by A=(x1,y1) and B=(x2,y2) on the given
  * SAT for channel cc. This is efficiently calculated as B + A - C - D
@@ -472,6 +712,87 @@ typename Image<T>::Ptr
 create_thumbnail (typename Image<T>::ConstPtr image,
     int thumb_width, int thumb_height);
 
+/*
+ * ------------------ Normalized cross-correlation ------------------
+ */
+
+/**
+ * NCC windows have samples at multiples of 'step' pixels up to 'radius'
+ * pixels from the center, in x and y. The samples are ordered row by row,
+ * with 2 * (radius / step) + 1 samples per row. Samples outside the image
+ * are clamped to the border.
+ *
+ * Computes the mean and the inverse norm of the window around every pixel
+ * of a gray image. Channel 0 is the mean, channel 1 is one over the L2 norm
+ * of the samples minus the mean, or zero for untextured windows, whose
+ * variance is below 1e-5 of the squared value range. The window sums are
+ * updated incrementally along the rows and columns, so the cost does not
+ * depend on the window size.
+ */
+FloatImage::Ptr
+ncc_window_statistics (ByteImage::ConstPtr image, int radius, int step);
+FloatImage::Ptr
+ncc_window_statistics (FloatImage::ConstPtr image, int radius, int step);
+FloatImage::Ptr
+ncc_window_statistics (ImageView<uint8_t const> image, int radius, int step);
+FloatImage::Ptr
+ncc_window_statistics (ImageView<float const> image, int radius, int step);
+
+/**
+ * Stores the window of a gray image at the pixel, normalized to zero mean
+ * and unit norm with the statistics of ncc_window_statistics(). Returns
+ * false for untextured windows.
+ */
+bool
+ncc_window (ByteImage const& image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values);
+bool
+ncc_window (FloatImage const& image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values);
+bool
+ncc_window (ImageView<uint8_t const> image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values);
+bool
+ncc_window (ImageView<float const> image, FloatImage const& statistics,
+    int x, int y, int radius, int step, float* values);
+
+/**
+ * Computes the NCC of normalized reference windows, see ncc_window(), with
+ * the windows of a gray image under homographies, for many windows at
+ * once. Window i is centered at 'centers[2 * i]' and 'centers[2 * i + 1]'
+ * in image plane coordinates, where pixel centers are at half-integer
+ * positions, and its reference samples start at 'reference + i *
+ * reference_stride'. A stride of zero shares one reference window. The
+ * sample positions are mapped with the 3x3 row-major homography starting at
+ * 'homographies[9 * i]' to the image plane of 'image', which is sampled
+ * bilinearly. The NCC is -1 if the window center maps behind the camera or
+ * outside the image, or if the warped window is untextured.
+ *
+ * The samples of a window are computed in SSE2 or AVX2 lanes if enabled at
+ * compile time. All functions also accept views of sub-regions, whose
+ * pixel coordinates are relative to the region.
+ */
+void
+warped_ncc (ByteImage const& image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result);
+void
+warped_ncc (FloatImage const& image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result);
+void
+warped_ncc (ImageView<uint8_t const> image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result);
+void
+warped_ncc (ImageView<float const> image, int radius, int step,
+    float const* reference, std::size_t reference_stride,
+    float const* centers, float const* homographies,
+    std::size_t num_windows, float* result);
+
 CORE_IMAGE_NAMESPACE_END
 CORE_NAMESPACE_END
 
@@ -573,9 +894,26 @@ rescale (typename Image<T>::ConstPtr img, RescaleInterpolation interp,
 /* ---------------------------------------------------------------- */
 
 template <typename T>
-typename Image<T>::Ptr
+inline typename Image<T>::Ptr
 rescale_half_size (typename Image<T>::ConstPtr img)
 {
+    typename Image<T>::Ptr out(Image<T>::create());
+    rescale_half_size<T>(img, out);
+    return out;
+}
+
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+void
+rescale_half_size (typename Image<T>::ConstPtr img,
+    typename Image<T>::Ptr out)
+{
+    if (img == nullptr || out == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (img == out)
+        throw std::invalid_argument("In-place rescaling not supported");
+
     int const iw = img->width();
     int const ih = img->height();
     int const ic = img->channels();
@@ -585,13 +923,15 @@ rescale_half_size (typename Image<T>::ConstPtr img)
     if (iw < 2 || ih < 2)
         throw std::invalid_argument("Input image too small for half-sizing");
 
-    typename Image<T>::Ptr out(Image<T>::create());
-    out->allocate(ow, oh, ic);
+    out->allocate_uninitialized(ow, oh, ic);
 
-    int outpos = 0;
-    int rowstride = iw * ic;
+    int const rowstride = iw * ic;
+    int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < oh; ++y)
     {
+        int outpos = y * ow * ic;
         int irow1 = y * 2 * rowstride;
         int irow2 = irow1 + rowstride * (y * 2 + 1 < ih);
 
@@ -608,16 +948,31 @@ rescale_half_size (typename Image<T>::ConstPtr img)
                     0.25f, 0.25f, 0.25f, 0.25f);
         }
     }
+}
+
+/* ---------------------------------------------------------------- */
 
+template <typename T>
+inline typename Image<T>::Ptr
+rescale_half_size_gaussian (typename Image<T>::ConstPtr img, float sigma)
+{
+    typename Image<T>::Ptr out(Image<T>::create());
+    rescale_half_size_gaussian<T>(img, out, sigma);
     return out;
 }
 
 /* ---------------------------------------------------------------- */
 
 template <typename T>
-typename Image<T>::Ptr
-rescale_half_size_gaussian (typename Image<T>::ConstPtr img, float sigma)
+void
+rescale_half_size_gaussian (typename Image<T>::ConstPtr img,
+    typename Image<T>::Ptr out, float sigma)
 {
+    if (img == nullptr || out == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (img == out)
+        throw std::invalid_argument("In-place rescaling not supported");
+
     int const iw = img->width();
     int const ih = img->height();
     int const ic = img->channels();
@@ -627,8 +982,7 @@ rescale_half_size_gaussian (typename Image<T>::ConstPtr img, float sigma)
     if (iw < 2 || ih < 2)
         throw std::invalid_argument("Invalid input image");
 
-    typename Image<T>::Ptr out(Image<T>::create());
-    out->allocate(ow, oh, ic);
+    out->allocate_uninitialized(ow, oh, ic);
 
     /*
      * Weights w1 (4 center px), w2 (8 skewed px) and w3 (4 corner px).
@@ -639,10 +993,14 @@ rescale_half_size_gaussian (typename Image<T>::ConstPtr img, float sigma)
     float const w2 = std::exp(-2.5f / (2.0f * MATH_POW2(sigma)));
     float const w3 = std::exp(-4.5f / (2.0f * MATH_POW2(sigma)));
 
-    int outpos = 0;
     int const rowstride = iw * ic;
+    int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < oh; ++y)
     {
+        int outpos = y * ow * ic;
+
         /* Init the four row pointers. */
         int y2 = (int)y << 1;
         T const* row[4];
@@ -689,16 +1047,31 @@ rescale_half_size_gaussian (typename Image<T>::ConstPtr img, float sigma)
             }
         }
     }
+}
 
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+inline typename Image<T>::Ptr
+rescale_half_size_subsample (typename Image<T>::ConstPtr img)
+{
+    typename Image<T>::Ptr out(Image<T>::create());
+    rescale_half_size_subsample<T>(img, out);
     return out;
 }
 
 /* ---------------------------------------------------------------- */
 
 template <typename T>
-typename Image<T>::Ptr
-rescale_half_size_subsample (typename Image<T>::ConstPtr img)
+void
+rescale_half_size_subsample (typename Image<T>::ConstPtr img,
+    typename Image<T>::Ptr out)
 {
+    if (img == nullptr || out == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (img == out)
+        throw std::invalid_argument("In-place rescaling not supported");
+
     int const iw = img->width();
     int const ih = img->height();
     int const ic = img->channels();
@@ -706,12 +1079,15 @@ rescale_half_size_subsample (typename Image<T>::ConstPtr img)
     int const oh = (ih + 1) >> 1;
     int const irs = iw * ic; // input image row stride
 
-    typename Image<T>::Ptr out(Image<T>::create());
-    out->allocate(ow, oh, ic);
+    out->allocate_uninitialized(ow, oh, ic);
 
-    int iter = 0; // Output image iterator
-    for (int iy = 0; iy < ih; iy += 2)
+    int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int oy = 0; oy < oh; ++oy)
     {
+        int const iy = oy * 2;
+        int iter = oy * ow * ic; // Output image iterator
         int rowoff = iy * irs;
         int pixoff = rowoff;
         for (int ix = 0; ix < iw; ix += 2)
@@ -723,8 +1099,6 @@ rescale_half_size_subsample (typename Image<T>::ConstPtr img)
             iter += ic;
         }
     }
-
-    return out;
 }
 
 /* ---------------------------------------------------------------- */
@@ -840,9 +1214,12 @@ rescale_nearest (typename Image<T>::ConstPtr img, typename Image<T>::Ptr out)
     int const ow = out->width();
     int const oh = out->height();
 
-    int outpos = 0;
+    int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < oh; ++y)
     {
+        int outpos = y * ow * ic;
         float ly = ((float)y + 0.5f) * (float)ih / (float)oh;
         int iy = static_cast<int>(ly);
         for (int x = 0; x < ow; ++x)
@@ -871,9 +1248,12 @@ rescale_linear (typename Image<T>::ConstPtr img, typename Image<T>::Ptr out)
     int const oh = out->height();
 
     T* out_ptr = out->get_data_pointer();
-    int outpos = 0;
+    int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < oh; ++y)
     {
+        int outpos = y * ow * ic;
         float fy = ((float)y + 0.5f) * (float)ih / (float)oh;
         for (int x = 0; x < ow; ++x, outpos += ic)
         {
@@ -964,8 +1344,12 @@ rescale_gaussian (typename Image<T>::ConstPtr img,
     float const sigma = sigma_factor * std::max(scale_x, scale_y) / 2.0f;
 
     /* Iterate pixels of dest image and convolute with gaussians on input. */
-    int i = 0;
+    int const num_threads = get_num_threads(ow * oh);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < oh; ++y)
+    {
+        int i = y * ow;
         for (int x = 0; x < ow; ++x, ++i)
         {
             float xf = ((float)x + 0.5f) * scale_x;
@@ -973,6 +1357,7 @@ rescale_gaussian (typename Image<T>::ConstPtr img,
             for (int c = 0; c < oc; ++c)
                 out->at(i, c) = gaussian_kernel<T>(img, xf, yf, c, sigma);
         }
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -1042,8 +1427,12 @@ blur_gaussian (typename Image<T>::ConstPtr in, float sigma)
 
     /* Convolve the image in x direction. */
     typename Image<T>::Ptr sep(Image<T>::create(w, h, c));
-    int px = 0;
+    int const num_threads = get_num_threads(w * h);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < h; ++y)
+    {
+        int px = y * w;
         for (int x = 0; x < w; ++x, ++px)
             for (int cc = 0; cc < (int)c; ++cc)
             {
@@ -1055,11 +1444,15 @@ blur_gaussian (typename Image<T>::ConstPtr in, float sigma)
                 }
                 sep->at(px, cc) = accum.normalized();
             }
+    }
 
     /* Convolve the image in y direction. */
     typename Image<T>::Ptr out(Image<T>::create(w, h, c));
-    px = 0;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < h; ++y)
+    {
+        int px = y * w;
         for (int x = 0; x < w; ++x, ++px)
             for (int cc = 0; cc < c; ++cc)
             {
@@ -1071,6 +1464,7 @@ blur_gaussian (typename Image<T>::ConstPtr in, float sigma)
                 }
                 out->at(px, cc) = accum.normalized();
             }
+    }
 
 #else // Non-separated kernel implementation
 
@@ -1116,11 +1510,14 @@ blur_boxfilter (typename Image<T>::ConstPtr in, int ks)
 #if 1
     /* Super-fast separated kernel implementation. */
     typename Image<T>::Ptr sep(Image<T>::create(w, h, c));
-    math::Accum<T>* accums = new math::Accum<T>[c];
-    T const* row = &in->at(0);
-    T* outrow = &sep->at(0);
-    for (int y = 0; y < h; ++y, row += w * c, outrow += w * c)
+    int const num_threads = get_num_threads(w * h);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int y = 0; y < h; ++y)
     {
+        std::vector<math::Accum<T> > accums(c);
+        T const* row = &in->at(y * wc);
+        T* outrow = &sep->at(y * wc);
         for (int cc = 0; cc < c; ++cc) // Reset accumulators
             accums[cc] = math::Accum<T>(T(0));
 
@@ -1141,33 +1538,41 @@ blur_boxfilter (typename Image<T>::ConstPtr in, int ks)
         }
     }
 
-    /* Second filtering pass with kernel in y-direction. */
+    /*
+     * Second filtering pass with kernel in y-direction. The running sums
+     * of a band of columns are updated row by row, which reads the image
+     * in memory order. Bands are processed in parallel.
+     */
     typename Image<T>::Ptr out(Image<T>::create(w, h, c));
-    T const* col = &sep->at(0);
-    T* outcol = &out->at(0);
-    for (int x = 0; x < w; ++x, col += c, outcol += c)
+    int const band_width = 1024;
+    int const num_bands = (wc + band_width - 1) / band_width;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int b = 0; b < num_bands; ++b)
     {
-        for (int cc = 0; cc < c; ++cc)
-            accums[cc] = math::Accum<T>(T(0));
+        int const i0 = b * band_width;
+        int const n = std::min(wc - i0, band_width);
+        std::vector<math::Accum<T> > accums(n, math::Accum<T>(T(0)));
+        T const* col = &sep->at(i0);
+        T* outcol = &out->at(i0);
 
         for (int i = 0; i < ks; ++i)
-            for (int cc = 0; cc < c; ++cc)
-                accums[cc].add(col[i * wc + cc], 1.0f);
+            for (int j = 0; j < n; ++j)
+                accums[j].add(col[i * wc + j], 1.0f);
 
         for (int y = 0; y < h; ++y)
         {
             if (y + ks < h - 1)
-                for (int cc = 0; cc < c; ++cc)
-                    accums[cc].add(col[(y + ks) * wc + cc], 1.0f);
+                for (int j = 0; j < n; ++j)
+                    accums[j].add(col[(y + ks) * wc + j], 1.0f);
             if (y > ks)
-                for (int cc = 0; cc < c; ++cc)
-                    accums[cc].sub(col[(y - ks - 1) * wc + cc], 1.0f);
-            for (int cc = 0; cc < c; ++cc)
-                outcol[y * wc + cc] = accums[cc].normalized();
+                for (int j = 0; j < n; ++j)
+                    accums[j].sub(col[(y - ks - 1) * wc + j], 1.0f);
+            for (int j = 0; j < n; ++j)
+                outcol[y * wc + j] = accums[j].normalized();
         }
     }
 
-    delete [] accums;
 #endif
 
 
@@ -1201,34 +1606,80 @@ rotate (typename Image<T>::ConstPtr image, RotateType type)
     if (image == nullptr)
         throw std::invalid_argument("Null image given");
 
-    int iw = image->width();
-    int ih = image->height();
-    int ic = image->channels();
-    int ow = type == ROTATE_180 ? iw : ih;
-    int oh = type == ROTATE_180 ? ih : iw;
+    int const iw = image->width();
+    int const ih = image->height();
+    int const ic = image->channels();
+    int const ow = type == ROTATE_180 ? iw : ih;
+    int const oh = type == ROTATE_180 ? ih : iw;
 
     typename Image<T>::Ptr ret(Image<T>::create());
-    ret->allocate(ow, oh, ic);
+    ret->allocate_uninitialized(ow, oh, ic);
+    if (iw == 0 || ih == 0)
+        return ret;
 
-    int idx = 0;
-    for (int y = 0; y < ih; ++y)
-        for (int x = 0; x < iw; ++x, idx += ic)
+    T const* src = image->get_data_pointer();
+    T* dst = ret->get_data_pointer();
+    std::ptrdiff_t const in_row = static_cast<std::ptrdiff_t>(iw) * ic;
+    std::ptrdiff_t const out_row = static_cast<std::ptrdiff_t>(ow) * ic;
+    int const num_threads = get_num_threads(iw * ih);
+
+    if (type == ROTATE_180)
+    {
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < oh; ++y)
         {
-            int dx = x;
-            int dy = y;
-            switch (type)
+            T const* in = src + (ih - y - 1) * in_row + (iw - 1) * ic;
+            T* out = dst + y * out_row;
+            for (int x = 0; x < ow; ++x, in -= ic, out += ic)
+                for (int c = 0; c < ic; ++c)
+                    out[c] = in[c];
+        }
+        return ret;
+    }
+
+    /*
+     * The other rotations read the input column-wise. The output is
+     * written in square tiles such that the input rows of a tile stay in
+     * cache. Output pixel (x, y) reads the input pixel at
+     * 'offset + x * step' of output row y.
+     */
+    int const tile = 32;
+    int const num_tile_rows = (oh + tile - 1) / tile;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int ty = 0; ty < num_tile_rows; ++ty)
+    {
+        int const y_end = std::min(oh, (ty + 1) * tile);
+        for (int x_begin = 0; x_begin < ow; x_begin += tile)
+        {
+            int const x_end = std::min(ow, x_begin + tile);
+            for (int y = ty * tile; y < y_end; ++y)
             {
-                case ROTATE_180:  dx = iw - x - 1; dy = ih - y - 1; break;
-                case ROTATE_CW:   dx = ih - y - 1; dy = x;          break;
-                case ROTATE_CCW:  dx = y;          dy = iw - x - 1; break;
-                case ROTATE_SWAP: dx = y;          dy = x;          break;
-                default: break;
-            }
+                std::ptrdiff_t offset = 0;
+                std::ptrdiff_t step = in_row;
+                switch (type)
+                {
+                    case ROTATE_CW:
+                        offset = (ih - 1) * in_row + y * ic;
+                        step = -in_row;
+                        break;
+                    case ROTATE_CCW:
+                        offset = (iw - y - 1) * ic;
+                        break;
+                    default:
+                        offset = y * ic;
+                        break;
+                }
 
-            T const* in_pixel = &image->at(idx);
-            T* out_pixel = &ret->at(dx, dy, 0);
-            std::copy(in_pixel, in_pixel + ic, out_pixel);
+                T const* in = src + offset + x_begin * step;
+                T* out = dst + y * out_row + x_begin * ic;
+                for (int x = x_begin; x < x_end; ++x, in += step, out += ic)
+                    for (int c = 0; c < ic; ++c)
+                        out[c] = in[c];
+            }
         }
+    }
 
     return ret;
 }
@@ -1251,8 +1702,12 @@ rotate (typename Image<T>::ConstPtr image, float angle, T const* fill_color)
 
     float const sin_angle = std::sin(-angle);
     float const cos_angle = std::cos(-angle);
-    T* ret_ptr = ret->begin();
+    int const num_threads = get_num_threads(w * h);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < h; ++y)
+    {
+        T* ret_ptr = ret->begin() + y * w * c;
         for (int x = 0; x < w; ++x, ret_ptr += c)
         {
             float const sample_x = cos_angle * (x - w2) - sin_angle * (y - h2) + w2;
@@ -1263,6 +1718,7 @@ rotate (typename Image<T>::ConstPtr image, float angle, T const* fill_color)
             else
                 image->linear_at(sample_x, sample_y, ret_ptr);
         }
+    }
     return ret;
 }
 
@@ -1282,18 +1738,37 @@ flip (typename Image<T>::Ptr image, FlipType type)
     int const iw = image->width();
     int const ih = image->height();
     int const ic = image->channels();
-    int const max_x = fh ? iw / 2 : iw;
-    int const max_y = fv && !fh ? ih / 2 : ih;
+    T* data = image->get_data_pointer();
+    std::ptrdiff_t const row = static_cast<std::ptrdiff_t>(iw) * ic;
+    int const num_threads = get_num_threads(iw * ih);
 
-    for (int y = 0; y < max_y; ++y)
-        for (int x = 0; x < max_x; ++x)
-        {
-            int dx = (type & FLIP_HORIZONTAL ? iw - x - 1 : x);
-            int dy = (type & FLIP_VERTICAL ? ih - y - 1 : y);
-            T* src = &image->at(x, y, 0);
-            T* dst = &image->at(dx, dy, 0);
-            std::swap_ranges(src, src + ic, dst);
-        }
+    /* Vertical flipping swaps entire rows. */
+    if (!fh)
+    {
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int y = 0; y < ih / 2; ++y)
+            std::swap_ranges(data + y * row, data + (y + 1) * row,
+                data + (ih - y - 1) * row);
+        return;
+    }
+
+    /*
+     * Otherwise row y is swapped with the reversed row y, or with the
+     * reversed row 'ih - y - 1' when flipping both directions. The middle
+     * row of the latter is reversed in itself.
+     */
+    int const num_rows = fv ? (ih + 1) / 2 : ih;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int y = 0; y < num_rows; ++y)
+    {
+        T* a = data + y * row;
+        T* b = data + (fv ? ih - y - 1 : y) * row + (iw - 1) * ic;
+        int const num_pixels = (fv && y != ih - y - 1) ? iw : iw / 2;
+        for (int x = 0; x < num_pixels; ++x, a += ic, b -= ic)
+            std::swap_ranges(a, a + ic, b);
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -1336,6 +1811,36 @@ desaturate_average (T const* v)
     return math::interpolate(v[0], v[1], v[2], third, third, third);
 }
 
+/*
+ * Desaturates all pixels with the function given as template argument,
+ * which is inlined into the loop for every desaturation type.
+ */
+template <typename T, T (*FUNC)(T const*)>
+void
+desaturate_pixels (typename Image<T>::ConstPtr img, typename Image<T>::Ptr out)
+{
+    int const pixels = img->get_pixel_amount();
+    T const* in_ptr = img->get_data_pointer();
+    T* out_ptr = out->get_data_pointer();
+    int const num_threads = get_num_threads(pixels);
+    if (img->channels() == 3)
+    {
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+        for (int i = 0; i < pixels; ++i)
+            out_ptr[i] = FUNC(in_ptr + i * 3);
+        return;
+    }
+
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int i = 0; i < pixels; ++i)
+    {
+        out_ptr[i * 2] = FUNC(in_ptr + i * 4);
+        out_ptr[i * 2 + 1] = in_ptr[i * 4 + 3];
+    }
+}
+
 /* ---------------------------------------------------------------- */
 
 template <typename T>
@@ -1352,33 +1857,27 @@ desaturate (typename Image<T>::ConstPtr img, DesaturateType type)
     bool has_alpha = (ic == 4);
 
     typename Image<T>::Ptr out(Image<T>::create());
-    out->allocate(img->width(), img->height(), 1 + has_alpha);
+    out->allocate_uninitialized(img->width(), img->height(), 1 + has_alpha);
 
-    typedef T(*DesaturateFunc)(T const*);
-    DesaturateFunc func;
     switch (type)
     {
-        case DESATURATE_MAXIMUM: func = desaturate_maximum<T>; break;
-        case DESATURATE_LIGHTNESS: func = desaturate_lightness<T>; break;
-        case DESATURATE_LUMINOSITY: func = desaturate_luminosity<T>; break;
-        case DESATURATE_LUMINANCE: func = desaturate_luminance<T>; break;
-        case DESATURATE_AVERAGE: func = desaturate_average<T>; break;
-        default: throw std::invalid_argument("Invalid desaturate type");
-    }
-
-    int outpos = 0;
-    int inpos = 0;
-    int pixels = img->get_pixel_amount();
-    for (int i = 0; i < pixels; ++i)
-    {
-        T const* v = &img->at(inpos);
-        out->at(outpos) = func(v);
-
-        if (has_alpha)
-            out->at(outpos + 1) = img->at(inpos + 3);
-
-        outpos += 1 + has_alpha;
-        inpos += 3 + has_alpha;
+        case DESATURATE_MAXIMUM:
+            desaturate_pixels<T, desaturate_maximum<T> >(img, out);
+            break;
+        case DESATURATE_LIGHTNESS:
+            desaturate_pixels<T, desaturate_lightness<T> >(img, out);
+            break;
+        case DESATURATE_LUMINOSITY:
+            desaturate_pixels<T, desaturate_luminosity<T> >(img, out);
+            break;
+        case DESATURATE_LUMINANCE:
+            desaturate_pixels<T, desaturate_luminance<T> >(img, out);
+            break;
+        case DESATURATE_AVERAGE:
+            desaturate_pixels<T, desaturate_average<T> >(img, out);
+            break;
+        default:
+            throw std::invalid_argument("Invalid desaturate type");
     }
 
     return out;
@@ -1433,45 +1932,72 @@ template <typename T>
 typename core::Image<T>::Ptr
 sobel_edge (typename core::Image<T>::ConstPtr img)
 {
+    /*
+     * Byte images are computed in float, which is exact for the 8 bit
+     * gradients and doubles the SIMD width. Other types use double.
+     */
+    typedef typename std::conditional<sizeof(T) == 1
+        && std::is_integral<T>::value, float, double>::type Real;
+
     int const width = img->width();
     int const height = img->height();
     int const chans = img->channels();
     int const row_stride = width * chans;
 
-    double const max_value = static_cast<double>(std::numeric_limits<T>::max());
+    Real const max_value = static_cast<Real>(std::numeric_limits<T>::max());
     typename core::Image<T>::Ptr out = core::Image<T>::create
         (width, height, chans);
+    T const* in_ptr = img->get_data_pointer();
     T* out_ptr = out->get_data_pointer();
 
-    int pos = 0;
-    for (int y = 0; y < height; ++y)
-        for (int x = 0; x < width; ++x, pos += chans)
+    /*
+     * The squared magnitudes of a row are computed in a vectorized pass
+     * into a buffer. The square roots are taken in a second pass, their
+     * errno handling would prevent the vectorization.
+     */
+    int const num_threads = get_num_threads(width * height);
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+    {
+        std::vector<Real> sq(row_stride);
+#pragma omp for schedule(static)
+        for (int y = 0; y < height; ++y)
         {
-            if (y == 0 || y == height - 1 || x == 0 || x == width - 1)
+            T* out_row = out_ptr + static_cast<std::ptrdiff_t>(y) * row_stride;
+            if (y == 0 || y == height - 1)
             {
-                std::fill(out_ptr + pos, out_ptr + pos + chans, T(0));
+                std::fill(out_row, out_row + row_stride, T(0));
                 continue;
             }
 
-            for (int cc = 0; cc < chans; ++cc)
+            /* The first and last pixel of the row form the border. */
+            std::fill(out_row, out_row + chans, T(0));
+            std::fill(out_row + row_stride - chans, out_row + row_stride,
+                T(0));
+
+            T const* r0 = in_ptr
+                + static_cast<std::ptrdiff_t>(y - 1) * row_stride;
+            T const* r1 = r0 + row_stride;
+            T const* r2 = r1 + row_stride;
+            Real* sq_ptr = sq.data();
+            int const end = row_stride - chans;
+#pragma omp simd
+            for (int i = chans; i < end; ++i)
+            {
+                Real const gx = (Real(r0[i + chans]) - Real(r0[i - chans]))
+                    + Real(2) * (Real(r1[i + chans]) - Real(r1[i - chans]))
+                    + (Real(r2[i + chans]) - Real(r2[i - chans]));
+                Real const gy = (Real(r2[i - chans]) - Real(r0[i - chans]))
+                    + Real(2) * (Real(r2[i]) - Real(r0[i]))
+                    + (Real(r2[i + chans]) - Real(r0[i + chans]));
+                sq_ptr[i] = gx * gx + gy * gy;
+            }
+            for (int i = chans; i < end; ++i)
             {
-                int const i = pos + cc;
-                double gx = 1.0 * (double)img->at(i + chans - row_stride)
-                    - 1.0 * (double)img->at(i - chans - row_stride)
-                    + 2.0 * (double)img->at(i + chans)
-                    - 2.0 * (double)img->at(i - chans)
-                    + 1.0 * (double)img->at(i + chans + row_stride)
-                    - 1.0 * (double)img->at(i - chans + row_stride);
-                double gy = 1.0 * (double)img->at(i + row_stride - chans)
-                    - 1.0 * (double)img->at(i - row_stride - chans)
-                    + 2.0 * (double)img->at(i + row_stride)
-                    - 2.0 * (double)img->at(i - row_stride)
-                    + 1.0 * (double)img->at(i + row_stride + chans)
-                    - 1.0 * (double)img->at(i - row_stride + chans);
-                double g = std::sqrt(gx * gx + gy * gy);
-                out_ptr[i] = static_cast<T>(std::min(max_value, g));
+                Real const g = std::sqrt(sq_ptr[i]);
+                out_row[i] = static_cast<T>(g < max_value ? g : max_value);
             }
         }
+    }
 
     return out;
 }
@@ -1479,57 +2005,94 @@ sobel_edge (typename core::Image<T>::ConstPtr img)
 /* ---------------------------------------------------------------- */
 
 template <typename T>
-typename Image<T>::Ptr
+inline typename Image<T>::Ptr
 subtract (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2)
 {
-    int const iw = i1->width();
-    int const ih = i1->height();
-    int const ic = i1->channels();
+    typename Image<T>::Ptr out(Image<T>::create());
+    subtract<T>(i1, i2, out);
+    return out;
+}
 
-    if (i1 == nullptr || i2 == nullptr)
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+void
+subtract (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2,
+    typename Image<T>::Ptr out)
+{
+    if (i1 == nullptr || i2 == nullptr || out == nullptr)
         throw std::invalid_argument("Null image given");
 
+    int const iw = i1->width();
+    int const ih = i1->height();
+    int const ic = i1->channels();
     if (iw != i2->width() || ih != i2->height() || ic != i2->channels())
         throw std::invalid_argument("Image dimensions do not match");
 
-    typename Image<T>::Ptr out(Image<T>::create());
-    out->allocate(iw, ih, ic);
+    /* Inputs aliased by the output have the size and keep their values. */
+    if (out->width() != iw || out->height() != ih || out->channels() != ic)
+        out->allocate_uninitialized(iw, ih, ic);
+    /* The output pointer is taken first, it may detach shared storage. */
+    T* out_ptr = out->get_data_pointer();
+    T const* in1 = i1->get_data_pointer();
+    T const* in2 = i2->get_data_pointer();
+    int const row_stride = iw * ic;
+    int const num_threads = get_num_threads(iw * ih);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int y = 0; y < ih; ++y)
+    {
+        std::ptrdiff_t const off = static_cast<std::ptrdiff_t>(y) * row_stride;
+#pragma omp simd
+        for (std::ptrdiff_t i = off; i < off + row_stride; ++i)
+            out_ptr[i] = in1[i] - in2[i];
+    }
+}
 
-    // FIXME: That needs speedup! STL algo with pointers.
-    for (int i = 0; i < i1->get_value_amount(); ++i)
-        out->at(i) = i1->at(i) - i2->at(i);
+/* ---------------------------------------------------------------- */
 
+template <typename T>
+inline typename Image<T>::Ptr
+difference (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2)
+{
+    typename Image<T>::Ptr out(Image<T>::create());
+    difference<T>(i1, i2, out);
     return out;
 }
 
 /* ---------------------------------------------------------------- */
 
 template <typename T>
-typename Image<T>::Ptr
-difference (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2)
+void
+difference (typename Image<T>::ConstPtr i1, typename Image<T>::ConstPtr i2,
+    typename Image<T>::Ptr out)
 {
+    if (i1 == nullptr || i2 == nullptr || out == nullptr)
+        throw std::invalid_argument("Null image given");
+
     int const iw = i1->width();
     int const ih = i1->height();
     int const ic = i1->channels();
-
-    if (i1 == nullptr || i2 == nullptr)
-        throw std::invalid_argument("Null image given");
-
     if (iw != i2->width() || ih != i2->height() || ic != i2->channels())
         throw std::invalid_argument("Image dimensions do not match");
 
-    typename Image<T>::Ptr out(Image<T>::create());
-    out->allocate(iw, ih, ic);
-
-    for (int i = 0; i < i1->get_value_amount(); ++i)
+    if (out->width() != iw || out->height() != ih || out->channels() != ic)
+        out->allocate_uninitialized(iw, ih, ic);
+    /* The output pointer is taken first, it may detach shared storage. */
+    T* out_ptr = out->get_data_pointer();
+    T const* in1 = i1->get_data_pointer();
+    T const* in2 = i2->get_data_pointer();
+    int const row_stride = iw * ic;
+    int const num_threads = get_num_threads(iw * ih);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int y = 0; y < ih; ++y)
     {
-        if (i1->at(i) < i2->at(i))
-            out->at(i) = i2->at(i) - i1->at(i);
-        else
-            out->at(i) = i1->at(i) - i2->at(i);
+        std::ptrdiff_t const off = static_cast<std::ptrdiff_t>(y) * row_stride;
+#pragma omp simd
+        for (std::ptrdiff_t i = off; i < off + row_stride; ++i)
+            out_ptr[i] = in1[i] < in2[i] ? in2[i] - in1[i] : in1[i] - in2[i];
     }
-
-    return out;
 }
 
 /* ---------------------------------------------------------------- */
@@ -1599,29 +2162,38 @@ integral_image (typename Image<T_IN>::ConstPtr image)
     int const row_stride = width * chans;
 
     typename Image<T_OUT>::Ptr ret(Image<T_OUT>::create());
-    ret->allocate(width, height, chans);
-
-    /* Input image row and destination image rows. */
-    std::vector<T_OUT> zeros(row_stride, T_OUT(0));
-    T_IN const* inrow = image->get_data_pointer();
-    T_OUT* dest = ret->get_data_pointer();
-    T_OUT* prev = &zeros[0];
+    ret->allocate_uninitialized(width, height, chans);
 
-    /*
-     * I(x,y) = i(x,y) + I(x-1,y) + I(x,y-1) - I(x-1,y-1)
-     */
+    /* Sum up the rows, I(x,y) = i(x,y) + I(x-1,y). */
+    int const num_threads = get_num_threads(width * height);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < height; ++y)
     {
-        /* Calculate first pixel in row. */
-        for (int cc = 0; cc < chans; ++cc)
-            dest[cc] = static_cast<T_OUT>(inrow[cc]) + prev[cc];
-        /* Calculate all following pixels in row. */
+        T_IN const* inrow = image->get_data_pointer() + y * row_stride;
+        T_OUT* dest = ret->get_data_pointer() + y * row_stride;
+        for (int i = 0; i < std::min(chans, row_stride); ++i)
+            dest[i] = static_cast<T_OUT>(inrow[i]);
         for (int i = chans; i < row_stride; ++i)
-            dest[i] = inrow[i] + prev[i] + dest[i - chans] - prev[i - chans];
+            dest[i] = static_cast<T_OUT>(inrow[i]) + dest[i - chans];
+    }
 
-        prev = dest;
-        dest += row_stride;
-        inrow += row_stride;
+    /* Accumulate the rows in y, I(x,y) += I(x,y-1), by bands of columns. */
+    int const band_width = 1024;
+    int const num_bands = (row_stride + band_width - 1) / band_width;
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
+    for (int b = 0; b < num_bands; ++b)
+    {
+        int const i0 = b * band_width;
+        int const i1 = std::min(row_stride, i0 + band_width);
+        for (int y = 1; y < height; ++y)
+        {
+            T_OUT* dest = ret->get_data_pointer() + y * row_stride;
+            T_OUT const* prev = dest - row_stride;
+            for (int i = i0; i < i1; ++i)
+                dest[i] += prev[i];
+        }
     }
 
     return ret;
@@ -1689,35 +2261,12 @@ template <typename T>
 typename Image<T>::Ptr
 image_undistort_msps (typename Image<T>::ConstPtr img, double k0, double k1)
 {
-    int const width = img->width();
-    int const height = img->height();
-    int const chans = img->channels();
-    int const D = std::max(width, height);
-
-    double const width_half = static_cast<double>(width) / 2.0;
-    double const height_half = static_cast<double>(height) / 2.0;
-
-    typename Image<T>::Ptr out = Image<T>::create(width, height, chans);
-    out->fill(T(0));
-    T* out_ptr = out->get_data_pointer();
-
-    for (int y = 0; y < height; y++)
-        for (int x = 0; x < width; x++, out_ptr += chans)
-        {
-            double fx = static_cast<double>(x) - width_half;
-            double fy = static_cast<double>(y) - height_half;
-            double const s1 = D * D + k1 * (fx * fx + fy * fy);
-            double const s2 = D * D + k0 * (fx * fx + fy * fy);
-            double const factor = s1 / s2;
-            fx = fx * factor + width_half;
-            fy = fy * factor + height_half;
-
-            if (fx < -0.5 || fx > width - 0.5 || fy < -0.5 || fy > height - 0.5)
-                continue;
-            img->linear_at(fx, fy, out_ptr);
-        }
+    if (img == nullptr)
+        throw std::invalid_argument("Null image given");
 
-    return out;
+    UndistortionMap::ConstPtr map = undistortion_map_msps
+        (img->width(), img->height(), k0, k1);
+    return image_remap<T>(img, *map);
 }
 
 /* ---------------------------------------------------------------- */
@@ -1733,33 +2282,9 @@ image_undistort_k2k4 (typename Image<T>::ConstPtr img,
     if (k2 == 0.0 && k4 == 0.0)
         return img->duplicate();
 
-    int const width = img->width();
-    int const height = img->height();
-    int const chans = img->channels();
-    typename Image<T>::Ptr out = Image<T>::create(width, height, chans);
-    out->fill(T(0));
-    T* out_ptr = out->get_data_pointer();
-
-    double const fwidth2 = static_cast<double>(width) / 2.0;
-    double const fheight2 = static_cast<double>(height) / 2.0;
-    double const fnorm = static_cast<double>(std::max(width, height));
-    for (int y = 0; y < height; ++y)
-        for (int x = 0; x < width; ++x, out_ptr += chans)
-        {
-            double const fx = (static_cast<double>(x) + 0.5 - fwidth2) / fnorm;
-            double const fy = (static_cast<double>(y) + 0.5 - fheight2) / fnorm;
-            double const rd = (fx * fx + fy * fy) / MATH_POW2(focal_length);
-            double const rd_factor = 1.0 + k2 * rd + k4 * rd * rd;
-            double const dist_x = fx * rd_factor;
-            double const dist_y = fy * rd_factor;
-            float const ix = dist_x * fnorm + fwidth2 - 0.5;
-            float const iy = dist_y * fnorm + fheight2 - 0.5;
-            if (ix < -0.5 || ix > width - 0.5 || iy < -0.5 || iy > height - 0.5)
-                continue;
-            img->linear_at(ix, iy, out_ptr);
-        }
-
-    return out;
+    UndistortionMap::ConstPtr map = undistortion_map_k2k4
+        (img->width(), img->height(), focal_length, k2, k4);
+    return image_remap<T>(img, *map);
 }
 
 /* ---------------------------------------------------------------- */
@@ -1775,72 +2300,49 @@ image_undistort_vsfm (typename Image<T>::ConstPtr img,
     if (k1 == 0.0)
         return img->duplicate();
 
+    UndistortionMap::ConstPtr map = undistortion_map_vsfm
+        (img->width(), img->height(), focal_length, k1);
+    return image_remap<T>(img, *map);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+typename Image<T>::Ptr
+image_remap (typename Image<T>::ConstPtr img, UndistortionMap const& map)
+{
+    if (img == nullptr)
+        throw std::invalid_argument("Null image given");
+    if (img->width() != map.width || img->height() != map.height)
+        throw std::invalid_argument("Image size does not match the map");
+
     int const width = img->width();
     int const height = img->height();
     int const chans = img->channels();
-
-    /*
-     * The image coordinates must be normalized before the distortion
-     * model is applied. The image coordinates are first centered at
-     * the origin and then scaled w.r.t. the focal length in pixel.
-     */
-    double const norm = focal_length * std::max(width, height);
-    double const width_half = static_cast<double>(width) / 2.0;
-    double const height_half = static_cast<double>(height) / 2.0;
-
     typename Image<T>::Ptr out = Image<T>::create(width, height, chans);
     out->fill(T(0));
-    T* out_ptr = out->begin();
 
+    T const* in_ptr = img->get_data_pointer();
+    int const rowstride = width * chans;
+    int const num_threads = get_num_threads(width * height);
+#pragma omp parallel for schedule(static) num_threads(num_threads) \
+    if (num_threads > 1)
     for (int y = 0; y < height; ++y)
     {
-        for (int x = 0; x < width; ++x, out_ptr += chans)
+        UndistortionMap::Lookup const* lookup = &map.lookups[y * width];
+        T* out_ptr = out->get_data_pointer() + y * rowstride;
+        for (int x = 0; x < width; ++x, ++lookup, out_ptr += chans)
         {
-            double fx = (static_cast<double>(x) - width_half) / norm;
-            double fy = (static_cast<double>(y) - height_half) / norm;
-            if (fy == 0.0)
-                fy = 1e-10;
-
-            double const t2 = fy * fy;
-            double const t3 = t2 * t2 * t2;
-            double const t4 = fx * fx;
-            double const t7 = k1 * (t2 + t4);
-
-            if (k1 > 0.0)
-            {
-                double const t8 = 1.0 / t7;
-                double const t10 = t3 / (t7 * t7);
-                double const t14 = std::sqrt(t10 * (0.25 + t8 / 27.0));
-                double const t15 = t2 * t8 * fy * 0.5;
-                double const t17 = std::pow(t14 + t15, 1.0/3.0);
-                double const t18 = t17 - t2 * t8 / (t17 * 3.0);
-                fx = t18 * fx / fy;
-                fy = t18;
-            }
-            else
-            {
-                double const t9 = t3 / (t7 * t7 * 4.0);
-                double const t11 = t3 / (t7 * t7 * t7 * 27.0);
-                std::complex<double> const t12 = t9 + t11;
-                std::complex<double> const t13 = std::sqrt(t12);
-                double const t14 = t2 / t7;
-                double const t15 = t14 * fy * 0.5;
-                std::complex<double> const t16 = t13 + t15;
-                std::complex<double> const t17 = std::pow(t16, 1.0/3.0);
-                std::complex<double> const t18 = (t17 + t14 / (t17 * 3.0))
-                    * std::complex<double>(0.0, std::sqrt(3.0));
-                std::complex<double> const t19 = -0.5 * (t17 + t18)
-                    + t14 / (t17 * 6.0);
-                fx = t19.real() * fx / fy;
-                fy = t19.real();
-            }
-
-            fx = fx * norm + width_half;
-            fy = fy * norm + height_half;
-
-            if (fx < -0.5 || fx > width - 0.5 || fy < -0.5 || fy > height - 0.5)
+            if (lookup->pixel < 0)
                 continue;
-            img->linear_at(fx, fy, out_ptr);
+            T const* p1 = in_ptr + lookup->pixel * chans;
+            T const* p2 = p1 + lookup->step_x * chans;
+            T const* p3 = p1 + lookup->step_y * rowstride;
+            T const* p4 = p3 + lookup->step_x * chans;
+            float const* w = lookup->weights;
+            for (int cc = 0; cc < chans; ++cc)
+                out_ptr[cc] = math::interpolate<T>(p1[cc], p2[cc],
+                    p3[cc], p4[cc], w[0], w[1], w[2], w[3]);
         }
     }
 
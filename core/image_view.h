@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_IMAGE_VIEW_HEADER
+#define MVE_IMAGE_VIEW_HEADER
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "core/defines.h"
+#include "core/image.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * A view of a rectangular region of an image, which references the pixels
+ * of the image instead of copying them. The rows of the region are
+ * 'row_stride' values apart, which is the number of values per row of the
+ * image. Views of const values are read-only. A view is small and passed
+ * by value. It is only valid as long as the image is neither resized nor
+ * destroyed, the view does not keep the image alive.
+ */
+template <typename T>
+class ImageView
+{
+public:
+    typedef T ValueType;
+    typedef typename std::remove_const<T>::type ImageValueType;
+
+public:
+    /** Creates an empty view. */
+    ImageView (void);
+    /** Creates a view of the given pixels. */
+    ImageView (T* data, int width, int height, int channels, int row_stride);
+    /** Creates a read-only view from a mutable view. */
+    template <typename U>
+    ImageView (ImageView<U> const& other);
+
+    int width (void) const;
+    int height (void) const;
+    int channels (void) const;
+    /** Returns the number of values between the starts of two rows. */
+    int row_stride (void) const;
+    /** Returns false if the view is empty. */
+    bool valid (void) const;
+    /** Returns true if the rows are consecutive in memory. */
+    bool is_contiguous (void) const;
+
+    /** Returns the first value of the view. */
+    T* get_data_pointer (void) const;
+    /** Returns the first value of a row. */
+    T* row (int y) const;
+    /** 2D indexing of the view data. */
+    T& at (int x, int y, int channel) const;
+
+    /** Returns the view of a region of this view. */
+    ImageView<T> sub_view (int left, int top, int width, int height) const;
+
+    /** Copies the pixels of the view into a new image. */
+    typename Image<ImageValueType>::Ptr copy (void) const;
+
+private:
+    T* data;
+    int w;
+    int h;
+    int c;
+    int stride;
+};
+
+CORE_NAMESPACE_END
+
+/* ---------------------------------------------------------------- */
+
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
+
+/** Returns a view of the whole image. */
+template <typename T>
+ImageView<T>
+make_view (Image<T>& image);
+
+/** Returns a read-only view of the whole image. */
+template <typename T>
+ImageView<T const>
+make_view (Image<T> const& image);
+
+/**
+ * Returns a view of a region of the image, the zero-copy alternative to
+ * crop(). The region must be inside the image.
+ */
+template <typename T>
+ImageView<T>
+crop_view (Image<T>& image, int left, int top, int width, int height);
+
+/** Returns a read-only view of a region of the image. */
+template <typename T>
+ImageView<T const>
+crop_view (Image<T> const& image, int left, int top, int width, int height);
+
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
+
+/* ------------------------- Implementation ----------------------- */
+
+CORE_NAMESPACE_BEGIN
+
+template <typename T>
+inline
+ImageView<T>::ImageView (void)
+    : data(nullptr), w(0), h(0), c(0), stride(0)
+{
+}
+
+template <typename T>
+inline
+ImageView<T>::ImageView (T* data, int width, int height, int channels,
+    int row_stride)
+    : data(data), w(width), h(height), c(channels), stride(row_stride)
+{
+}
+
+template <typename T>
+template <typename U>
+inline
+ImageView<T>::ImageView (ImageView<U> const& other)
+    : data(other.get_data_pointer())
+    , w(other.width())
+    , h(other.height())
+    , c(other.channels())
+    , stride(other.row_stride())
+{
+}
+
+template <typename T>
+inline int
+ImageView<T>::width (void) const
+{
+    return this->w;
+}
+
+template <typename T>
+inline int
+ImageView<T>::height (void) const
+{
+    return this->h;
+}
+
+template <typename T>
+inline int
+ImageView<T>::channels (void) const
+{
+    return this->c;
+}
+
+template <typename T>
+inline int
+ImageView<T>::row_stride (void) const
+{
+    return this->stride;
+}
+
+template <typename T>
+inline bool
+ImageView<T>::valid (void) const
+{
+    return this->data != nullptr && this->w > 0 && this->h > 0
+        && this->c > 0;
+}
+
+template <typename T>
+inline bool
+ImageView<T>::is_contiguous (void) const
+{
+    return this->stride == this->w * this->c || this->h <= 1;
+}
+
+template <typename T>
+inline T*
+ImageView<T>::get_data_pointer (void) const
+{
+    return this->data;
+}
+
+template <typename T>
+inline T*
+ImageView<T>::row (int y) const
+{
+    return this->data + static_cast<std::ptrdiff_t>(y) * this->stride;
+}
+
+template <typename T>
+inline T&
+ImageView<T>::at (int x, int y, int channel) const
+{
+    return this->row(y)[x * this->c + channel];
+}
+
+template <typename T>
+ImageView<T>
+ImageView<T>::sub_view (int left, int top, int width, int height) const
+{
+    if (left < 0 || top < 0 || width < 0 || height < 0
+        || left + width > this->w || top + height > this->h)
+        throw std::invalid_argument("Region exceeds the view");
+    return ImageView<T>(this->row(top) + left * this->c, width, height,
+        this->c, this->stride);
+}
+
+template <typename T>
+typename Image<typename ImageView<T>::ImageValueType>::Ptr
+ImageView<T>::copy (void) const
+{
+    typename Image<ImageValueType>::Ptr ret = Image<ImageValueType>::create();
+    ret->allocate_uninitialized(this->w, this->h, this->c);
+    int const row_values = this->w * this->c;
+    for (int y = 0; y < this->h; ++y)
+        std::copy(this->row(y), this->row(y) + row_values,
+            ret->get_data_pointer() + y * row_values);
+    return ret;
+}
+
+CORE_NAMESPACE_END
+
+CORE_NAMESPACE_BEGIN
+CORE_IMAGE_NAMESPACE_BEGIN
+
+template <typename T>
+inline ImageView<T>
+make_view (Image<T>& image)
+{
+    return ImageView<T>(image.get_data_pointer(), image.width(),
+        image.height(), image.channels(), image.width() * image.channels());
+}
+
+template <typename T>
+inline ImageView<T const>
+make_view (Image<T> const& image)
+{
+    return ImageView<T const>(image.get_data_pointer(), image.width(),
+        image.height(), image.channels(), image.width() * image.channels());
+}
+
+template <typename T>
+inline ImageView<T>
+crop_view (Image<T>& image, int left, int top, int width, int height)
+{
+    return make_view(image).sub_view(left, top, width, height);
+}
+
+template <typename T>
+inline ImageView<T const>
+crop_view (Image<T> const& image, int left, int top, int width, int height)
+{
+    return make_view(image).sub_view(left, top, width, height);
+}
+
+CORE_IMAGE_NAMESPACE_END
+CORE_NAMESPACE_END
+
+#endif /* MVE_IMAGE_VIEW_HEADER */
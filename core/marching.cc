@@ -23,10 +23,10 @@
  *   function is zero, and it takes negative values outside of S."
  */
 
-#include "mve/defines.h"
+#include "core/defines.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /* ----------------- Marching Cubes Lookup tables ----------------- */
 
@@ -373,5 +373,5 @@ int mt_edge_order[6][2] =
     {0, 3}, {1, 3}, {2, 3}
 };
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
@@ -7,19 +7,25 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_MARCHINGCUBES_HEADER
-#define MVE_MARCHINGCUBES_HEADER
+#ifndef CORE_MARCHINGCUBES_HEADER
+#define CORE_MARCHINGCUBES_HEADER
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 #include "math/vector.h"
 #include "math/functions.h"
-#include "mve/defines.h"
-#include "mve/mesh.h"
-#include "mve/image.h"
+#include "core/defines.h"
+#include "core/mesh.h"
+#include "core/image.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * This function polygonizes a SDF that is partitioned into cubes.
@@ -55,13 +61,28 @@ template <typename T>
 TriangleMesh::Ptr
 marching_cubes (T& accessor);
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+/**
+ * Brick-parallel marching cubes for volumes with random access, such as
+ * core::Volume. The volume must provide width(), height(), depth() and
+ * the SDF values with at(x, y, z). The cubes are partitioned into bricks
+ * of brick_size^3 cubes which are polygonized in parallel. Bricks where
+ * all SDF values have the same sign are skipped early. Each brick shares
+ * edge vertices only locally, the vertices on brick boundaries are merged
+ * when the bricks are stitched in brick order. Voxel layout and vertex
+ * positions are the same as with VolumeMCAccessor, the result
+ * differs from marching_cubes() only in the order of vertices and faces.
+ */
+template <typename V>
+TriangleMesh::Ptr
+marching_cubes_bricks (V const& volume, int brick_size = 32);
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
 /* ------------------------- Lookup tables ------------------------ */
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * Defines the 12-bit edge mask, each bit corresponding to one of 12 edges,
@@ -160,7 +181,228 @@ marching_cubes (T& accessor)
     return ret;
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+/* ---------------------------------------------------------------- */
+
+/** The polygonized part of a brick for marching_cubes_bricks(). */
+struct MCBrickMesh
+{
+    TriangleMesh::VertexList verts;
+    TriangleMesh::FaceList faces;
+    /* The edge key of boundary vertices, or the maximum for others. */
+    std::vector<uint64_t> keys;
+};
+
+/** Weights for marching_cubes_brick() that accept all cubes. */
+struct MCNoWeights
+{
+    float at (int /*x*/, int /*y*/, int /*z*/) const { return 1.0f; }
+};
+
+/**
+ * Polygonizes the cubes [min, max) of a volume for marching_cubes_bricks().
+ * Cubes with a voxel of zero weight are skipped, the weights provide
+ * at(x, y, z) like the volume. Edges are keyed by three times their first
+ * voxel index plus their axis.
+ */
+template <typename V, typename W>
+void
+marching_cubes_brick (V const& volume, W const& weights,
+    int const* min, int const* max, MCBrickMesh* result)
+{
+    int const width = volume.width();
+    int const height = volume.height();
+
+    /* Skip the brick if its voxels do not contain the surface. */
+    bool has_inside = false;
+    bool has_outside = false;
+    for (int z = min[2]; z <= max[2]; ++z)
+        for (int y = min[1]; y <= max[1]; ++y)
+            for (int x = min[0]; x <= max[0]; ++x)
+            {
+                if (volume.at(x, y, z) < 0.0f)
+                    has_inside = true;
+                else
+                    has_outside = true;
+            }
+    if (!has_inside || !has_outside)
+        return;
+
+    /* Cube voxel offsets in the order of the cube vertices. */
+    int const offsets[8][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 },
+        { 0, 0, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 0, 1, 1 } };
+    float const spacing = 1.0f / (float)(width - 1);
+
+    typedef std::unordered_map<uint64_t, unsigned int> EdgeMap;
+    EdgeMap vert_ids;
+    for (int z = min[2]; z < max[2]; ++z)
+        for (int y = min[1]; y < max[1]; ++y)
+            for (int x = min[0]; x < max[0]; ++x)
+            {
+                float sdf[8];
+                int cubeconfig = 0;
+                for (int i = 0; i < 8; ++i)
+                {
+                    sdf[i] = volume.at(x + offsets[i][0],
+                        y + offsets[i][1], z + offsets[i][2]);
+                    if (sdf[i] < 0.0f)
+                        cubeconfig |= (1 << i);
+                }
+                if (cubeconfig == 0x00 || cubeconfig == 0xff)
+                    continue;
+
+                bool observed = true;
+                for (int i = 0; observed && i < 8; ++i)
+                    observed = weights.at(x + offsets[i][0],
+                        y + offsets[i][1], z + offsets[i][2]) > 0.0f;
+                if (!observed)
+                    continue;
+
+                int const edgeconfig = mc_edge_table[cubeconfig];
+                math::Vec3f basepos(x * spacing - 0.5f,
+                    y * spacing - 0.5f, z * spacing - 0.5f);
+
+                unsigned int vid[12];
+                for (int i = 0; i < 12; ++i)
+                {
+                    if (!(edgeconfig & (1 << i)))
+                        continue;
+
+                    /* The edge key is based on the voxel with lower index. */
+                    int const* ev = mc_edge_order[i];
+                    int const* o0 = offsets[ev[0]];
+                    int const* o1 = offsets[ev[1]];
+                    int const* first = o0;
+                    int axis = 0;
+                    for (int j = 0; j < 3; ++j)
+                        if (o0[j] != o1[j])
+                        {
+                            axis = j;
+                            first = o0[j] < o1[j] ? o0 : o1;
+                        }
+                    int const fx = x + first[0];
+                    int const fy = y + first[1];
+                    int const fz = z + first[2];
+                    uint64_t const key = ((static_cast<uint64_t>(fz)
+                        * height + fy) * width + fx) * 3 + axis;
+
+                    std::pair<EdgeMap::iterator, bool> iter
+                        = vert_ids.insert(std::make_pair(key,
+                        static_cast<unsigned int>(result->verts.size())));
+                    vid[i] = iter.first->second;
+                    if (!iter.second)
+                        continue;
+
+                    /* Create new vertex on the edge. */
+                    float d[2] = { sdf[ev[0]], sdf[ev[1]] };
+                    float w[2] = { d[1] / (d[1] - d[0]),
+                        -d[0] / (d[1] - d[0]) };
+                    math::Vec3f p0 = basepos + math::Vec3f(o0[0] * spacing,
+                        o0[1] * spacing, o0[2] * spacing);
+                    math::Vec3f p1 = basepos + math::Vec3f(o1[0] * spacing,
+                        o1[1] * spacing, o1[2] * spacing);
+                    result->verts.push_back(math::interpolate
+                        (p0, p1, w[0], w[1]));
+
+                    /* Edges on the brick boundary are shared. */
+                    bool const boundary = fx == min[0] || fx == max[0]
+                        || fy == min[1] || fy == max[1]
+                        || fz == min[2] || fz == max[2];
+                    result->keys.push_back(boundary ? key
+                        : std::numeric_limits<uint64_t>::max());
+                }
+
+                for (int j = 0; mc_tri_table[cubeconfig][j] != -1; j += 3)
+                    for (int k = 0; k < 3; ++k)
+                        result->faces.push_back
+                            (vid[mc_tri_table[cubeconfig][j + k]]);
+            }
+}
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Stitches the bricks of marching_cubes_brick() in order and merges the
+ * vertices on brick boundaries. The bricks are released.
+ */
+inline TriangleMesh::Ptr
+marching_cubes_stitch (std::vector<MCBrickMesh>* bricks)
+{
+    TriangleMesh::Ptr ret(TriangleMesh::create());
+    TriangleMesh::VertexList& verts(ret->get_vertices());
+    TriangleMesh::FaceList& faces(ret->get_faces());
+    std::unordered_map<uint64_t, unsigned int> shared_ids;
+    std::vector<unsigned int> remap;
+    for (std::size_t i = 0; i < bricks->size(); ++i)
+    {
+        MCBrickMesh& brick = bricks->at(i);
+        remap.resize(brick.verts.size());
+        for (std::size_t j = 0; j < brick.verts.size(); ++j)
+        {
+            unsigned int const new_id = verts.size();
+            if (brick.keys[j] != std::numeric_limits<uint64_t>::max())
+            {
+                std::pair<std::unordered_map<uint64_t, unsigned int>
+                    ::iterator, bool> iter = shared_ids.insert
+                    (std::make_pair(brick.keys[j], new_id));
+                if (!iter.second)
+                {
+                    remap[j] = iter.first->second;
+                    continue;
+                }
+            }
+            remap[j] = new_id;
+            verts.push_back(brick.verts[j]);
+        }
+
+        for (std::size_t j = 0; j < brick.faces.size(); ++j)
+            faces.push_back(remap[brick.faces[j]]);
+        brick = MCBrickMesh();
+    }
+
+    return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+template <typename V>
+TriangleMesh::Ptr
+marching_cubes_bricks (V const& volume, int brick_size)
+{
+    if (brick_size < 1)
+        throw std::invalid_argument("Invalid brick size");
+
+    TriangleMesh::Ptr ret(TriangleMesh::create());
+    int const size[3] = { volume.width(), volume.height(), volume.depth() };
+    if (size[0] < 2 || size[1] < 2 || size[2] < 2)
+        return ret;
+
+    /* Partition the cubes into bricks. */
+    int bricks[3];
+    for (int i = 0; i < 3; ++i)
+        bricks[i] = (size[i] - 2) / brick_size + 1;
+    std::int64_t const num_bricks = static_cast<std::int64_t>(bricks[0])
+        * bricks[1] * bricks[2];
+
+    std::vector<MCBrickMesh> results(num_bricks);
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_bricks; ++i)
+    {
+        int const index[3] = { static_cast<int>(i % bricks[0]),
+            static_cast<int>(i / bricks[0] % bricks[1]),
+            static_cast<int>(i / bricks[0] / bricks[1]) };
+        int min[3], max[3];
+        for (int j = 0; j < 3; ++j)
+        {
+            min[j] = index[j] * brick_size;
+            max[j] = std::min(min[j] + brick_size, size[j] - 1);
+        }
+        marching_cubes_brick(volume, MCNoWeights(), min, max, &results[i]);
+    }
+
+    return marching_cubes_stitch(&results);
+}
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_MARCHINGCUBES_HEADER */
+#endif /* CORE_MARCHINGCUBES_HEADER */
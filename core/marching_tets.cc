@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "core/marching_tets.h"
+
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
+
+namespace
+{
+    /*
+     * Keys of the surface vertices: An edge (a, b) with a < b has the key
+     * a * 2^32 + b, a vertex snapped to the grid vertex a has a * 2^32 + a.
+     */
+    inline uint64_t
+    vertex_key (unsigned int a, unsigned int b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return static_cast<uint64_t>(a) << 32 | b;
+    }
+
+    /*
+     * Returns the configuration of a tet and stores the vertex keys of
+     * its iso edges, snapping vertices with zero SDF like the accessor
+     * version of marching_tetrahedra().
+     */
+    int
+    tet_vertex_keys (TetGrid const& grid, std::size_t tet_id, uint64_t* keys)
+    {
+        unsigned int const* vid = &grid.tets[tet_id * 4];
+        int config = 0;
+        for (int i = 0; i < 4; ++i)
+            if (grid.sdf[vid[i]] < 0.0f)
+                config |= (1 << i);
+        if (config == 0x0 || config == 0xf)
+            return config;
+
+        int const edgeconfig = mt_edge_table[config];
+        for (int i = 0; i < 6; ++i)
+        {
+            if (!(edgeconfig & (1 << i)))
+                continue;
+            unsigned int const a = vid[mt_edge_order[i][0]];
+            unsigned int const b = vid[mt_edge_order[i][1]];
+            if (grid.sdf[a] == 0.0f)
+                keys[i] = vertex_key(a, a);
+            else if (grid.sdf[b] == 0.0f)
+                keys[i] = vertex_key(b, b);
+            else
+                keys[i] = vertex_key(a, b);
+        }
+        return config;
+    }
+
+    /* Returns true if the triangle of a tet is not degenerate. */
+    inline bool
+    is_valid_triangle (uint64_t const* keys, int const* tri)
+    {
+        return keys[tri[0]] != keys[tri[1]] && keys[tri[1]] != keys[tri[2]]
+            && keys[tri[2]] != keys[tri[0]];
+    }
+
+    /*
+     * Sorts the keys in chunks in parallel, merges the chunks pairwise
+     * in parallel and removes duplicates.
+     */
+    void
+    parallel_sort_unique (std::vector<uint64_t>* keys)
+    {
+        int num_chunks = 1;
+#ifdef _OPENMP
+        num_chunks = omp_get_max_threads();
+#endif
+        std::vector<std::size_t> bounds(num_chunks + 1);
+        for (int i = 0; i <= num_chunks; ++i)
+            bounds[i] = keys->size() * i / num_chunks;
+
+        std::vector<uint64_t>::iterator begin = keys->begin();
+#pragma omp parallel for schedule(static, 1)
+        for (int i = 0; i < num_chunks; ++i)
+            std::sort(begin + bounds[i], begin + bounds[i + 1]);
+
+        for (int step = 1; step < num_chunks; step *= 2)
+        {
+#pragma omp parallel for schedule(static, 1)
+            for (int i = 0; i < num_chunks - step; i += 2 * step)
+                std::inplace_merge(begin + bounds[i], begin + bounds[i + step],
+                    begin + bounds[std::min(i + 2 * step, num_chunks)]);
+        }
+
+        keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+TriangleMesh::Ptr
+marching_tetrahedra_grid (TetGrid const& grid)
+{
+    std::size_t const num_verts = grid.positions.size();
+    bool const has_colors = !grid.colors.empty();
+    if (grid.sdf.size() != num_verts
+        || (has_colors && grid.colors.size() != num_verts))
+        throw std::invalid_argument("Invalid amount of SDF values or colors");
+    if (grid.tets.size() % 4 != 0)
+        throw std::invalid_argument("Invalid amount of tet vertex IDs");
+    for (std::size_t i = 0; i < grid.tets.size(); ++i)
+        if (grid.tets[i] >= num_verts)
+            throw std::invalid_argument("Invalid vertex ID in tets");
+
+    /* Count the edge keys and the triangles of every tet. */
+    std::int64_t const num_tets = grid.tets.size() / 4;
+    std::vector<std::size_t> key_offsets(num_tets + 1, 0);
+    std::vector<std::size_t> face_offsets(num_tets + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_tets; ++i)
+    {
+        uint64_t keys[6];
+        int const config = tet_vertex_keys(grid, i, keys);
+        if (config == 0x0 || config == 0xf)
+            continue;
+
+        int num_keys = 0;
+        for (int j = 0; j < 6; ++j)
+            if (mt_edge_table[config] & (1 << j))
+                num_keys += 1;
+        int num_faces = 0;
+        for (int j = 0; mt_tri_table[config][j] != -1; j += 3)
+            if (is_valid_triangle(keys, mt_tri_table[config] + j))
+                num_faces += 1;
+        key_offsets[i + 1] = num_keys;
+        face_offsets[i + 1] = num_faces;
+    }
+    for (std::int64_t i = 0; i < num_tets; ++i)
+    {
+        key_offsets[i + 1] += key_offsets[i];
+        face_offsets[i + 1] += face_offsets[i];
+    }
+
+    /* Collect the edge keys, the sorted unique keys are the vertices. */
+    std::vector<uint64_t> vertex_keys(key_offsets.back());
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_tets; ++i)
+    {
+        if (key_offsets[i] == key_offsets[i + 1])
+            continue;
+        uint64_t keys[6];
+        int const config = tet_vertex_keys(grid, i, keys);
+        std::size_t pos = key_offsets[i];
+        for (int j = 0; j < 6; ++j)
+            if (mt_edge_table[config] & (1 << j))
+                vertex_keys[pos++] = keys[j];
+    }
+    parallel_sort_unique(&vertex_keys);
+
+    /* Create the vertices on the edges. */
+    TriangleMesh::Ptr ret(TriangleMesh::create());
+    TriangleMesh::VertexList& verts(ret->get_vertices());
+    TriangleMesh::FaceList& faces(ret->get_faces());
+    TriangleMesh::ColorList& colors(ret->get_vertex_colors());
+    std::int64_t const num_keys = vertex_keys.size();
+    verts.resize(num_keys);
+    if (has_colors)
+        colors.resize(num_keys);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_keys; ++i)
+    {
+        unsigned int const a = static_cast<unsigned int>(vertex_keys[i] >> 32);
+        unsigned int const b = static_cast<unsigned int>(vertex_keys[i]);
+        if (a == b)
+        {
+            verts[i] = grid.positions[a];
+            if (has_colors)
+                colors[i] = math::Vec4f(grid.colors[a], 1.0f);
+            continue;
+        }
+
+        float const d[2] = { grid.sdf[a], grid.sdf[b] };
+        float const w[2] = { d[1] / (d[1] - d[0]), -d[0] / (d[1] - d[0]) };
+        verts[i] = math::interpolate(grid.positions[a], grid.positions[b],
+            w[0], w[1]);
+        if (has_colors)
+            colors[i] = math::Vec4f(math::interpolate(grid.colors[a],
+                grid.colors[b], w[0], w[1]), 1.0f);
+    }
+
+    /* Generate the triangles, looking up the vertices by key. */
+    faces.resize(face_offsets.back() * 3);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_tets; ++i)
+    {
+        if (face_offsets[i] == face_offsets[i + 1])
+            continue;
+        uint64_t keys[6];
+        int const config = tet_vertex_keys(grid, i, keys);
+        std::size_t pos = face_offsets[i] * 3;
+        for (int j = 0; mt_tri_table[config][j] != -1; j += 3)
+        {
+            int const* tri = mt_tri_table[config] + j;
+            if (!is_valid_triangle(keys, tri))
+                continue;
+            for (int k = 0; k < 3; ++k)
+                faces[pos++] = std::lower_bound(vertex_keys.begin(),
+                    vertex_keys.end(), keys[tri[k]]) - vertex_keys.begin();
+        }
+    }
+
+    return ret;
+}
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
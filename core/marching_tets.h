@@ -7,18 +7,19 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_MARCHINGTETS_HEADER
-#define MVE_MARCHINGTETS_HEADER
+#ifndef CORE_MARCHINGTETS_HEADER
+#define CORE_MARCHINGTETS_HEADER
 
 #include <map>
+#include <vector>
 
 #include "math/vector.h"
 #include "math/functions.h"
-#include "mve/defines.h"
-#include "mve/mesh.h"
+#include "core/defines.h"
+#include "core/mesh.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * This function polygonizes a SDF that is partitioned into tetrahedrons.
@@ -43,6 +44,34 @@ template <typename T>
 TriangleMesh::Ptr
 marching_tetrahedra (T& accessor);
 
+/**
+ * A tetrahedral grid with SDF values at the vertices, for example from
+ * an octree-based reconstruction.
+ */
+struct TetGrid
+{
+    /** The vertex positions. */
+    std::vector<math::Vec3f> positions;
+    /** The SDF value of every vertex. */
+    std::vector<float> sdf;
+    /** Optional vertex colors, either empty or one per vertex. */
+    std::vector<math::Vec3f> colors;
+    /** The four vertex IDs of every tetrahedron. */
+    std::vector<unsigned int> tets;
+};
+
+/**
+ * Parallel marching tetrahedra for a tetrahedral grid. The tets are
+ * polygonized in parallel, and the surface vertices are identified by the
+ * vertex IDs of their edges. All edge keys are collected and sorted in
+ * parallel, which yields one vertex per key. The result contains the same
+ * vertices and faces as marching_tetrahedra() with an accessor that
+ * iterates the tets in order. The faces are in tet order, but the vertices
+ * are ordered by key, independent of the number of threads.
+ */
+TriangleMesh::Ptr
+marching_tetrahedra_grid (TetGrid const& grid);
+
 /* ------------------------- Lookup tables ------------------------ */
 
 /**
@@ -184,7 +213,7 @@ marching_tetrahedra (T& accessor)
     return ret;
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_MARCHINGTETS_HEADER */
+#endif /* CORE_MARCHINGTETS_HEADER */
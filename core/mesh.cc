@@ -7,11 +7,19 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
 #include "math/defines.h"
 #include "math/functions.h"
-#include "mve/mesh.h"
+#include "core/mesh.h"
 
 /*
  * Whether to use AWPN (angle-weighted pseudo normals)
@@ -19,7 +27,127 @@
  */
 #define MESH_AWPN_NORMALS 1
 
-MVE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /*
+     * Computes the face normals of the faces in [begin, end) and adds the
+     * weighted face normals to the vertex normals, where vertex normal
+     * 'i' is stored at 'vertex_normals[i - offset]'. Either normals can
+     * be null. Returns the amount of zero-length face normals.
+     */
+    std::size_t
+    accumulate_normals (TriangleMesh::VertexList const& vertices,
+        TriangleMesh::FaceList const& faces, std::size_t begin,
+        std::size_t end, math::Vec3f* face_normals,
+        math::Vec3f* vertex_normals, std::size_t offset)
+    {
+        std::size_t zlfn = 0;
+        for (std::size_t i = begin; i < end; i += 3)
+        {
+            /* Face vertex indices. */
+            std::size_t ia = faces[i + 0];
+            std::size_t ib = faces[i + 1];
+            std::size_t ic = faces[i + 2];
+
+            /* Face vertices. */
+            math::Vec3f const& a = vertices[ia];
+            math::Vec3f const& b = vertices[ib];
+            math::Vec3f const& c = vertices[ic];
+
+            /* Face edges. */
+            math::Vec3f ab = b - a;
+            math::Vec3f bc = c - b;
+            math::Vec3f ca = a - c;
+
+            /* Face normal. */
+            math::Vec3f fn = ab.cross(-ca);
+            float fnl = fn.norm();
+
+            /* Count zero-length face normals. */
+            if (fnl == 0.0f)
+                zlfn += 1;
+
+#if MESH_AWPN_NORMALS
+
+            /*
+             * Calculate angle weighted pseudo normals by weighted
+             * averaging adjacent face normals.
+             */
+
+            /* Normalize face normal. */
+            if (fnl != 0.0f)
+                fn /= fnl;
+
+            /* Add (normalized) face normal. */
+            if (face_normals != nullptr)
+                face_normals[i / 3] = fn;
+
+            /* Update adjacent vertex normals. */
+            if (fnl != 0.0f && vertex_normals != nullptr)
+            {
+                float abl = ab.norm();
+                float bcl = bc.norm();
+                float cal = ca.norm();
+
+                /*
+                 * Although (a.dot(b) / (alen * blen)) is more efficient,
+                 * (a / alen).dot(b / blen) is numerically more stable.
+                 */
+                float ratio1 = (ab / abl).dot(-ca / cal);
+                float ratio2 = (-ab / abl).dot(bc / bcl);
+                float ratio3 = (ca / cal).dot(-bc / bcl);
+                float angle1 = std::acos(math::clamp(ratio1, -1.0f, 1.0f));
+                float angle2 = std::acos(math::clamp(ratio2, -1.0f, 1.0f));
+                float angle3 = std::acos(math::clamp(ratio3, -1.0f, 1.0f));
+
+                //float angle1 = std::acos(ab.dot(-ca) / (abl * cal));
+                //float angle2 = std::acos((-ab).dot(bc) / (abl * bcl));
+                //float angle3 = std::acos(ca.dot(-bc) / (cal * bcl));
+
+                vertex_normals[ia - offset] += fn * angle1;
+                vertex_normals[ib - offset] += fn * angle2;
+                vertex_normals[ic - offset] += fn * angle3;
+
+                if (MATH_ISNAN(angle1) || MATH_ISNAN(angle2)
+                    || MATH_ISNAN(angle3))
+                {
+#pragma omp critical
+                    std::cout << "NAN error in " << __FILE__ << ":" << __LINE__
+                        << ": " << angle1 << " / " << angle2 << " / " << angle3
+                        << " (" << abl << " / " << bcl << " / " << cal << ")"
+                        << " [" << ratio1 << " / " << ratio2 << " / " << ratio3
+                        << "]" << std::endl;
+                }
+            }
+
+#else /* no MESH_AWPN_NORMALS */
+
+            /*
+             * Calculate simple vertex normals by averaging
+             * area-weighted adjacent face normals.
+             */
+
+            if (face_normals != nullptr)
+            {
+                face_normals[i / 3] = fnl ? fn / fnl : fn;
+            }
+
+            if (fnl != 0.0f && vertex_normals != nullptr)
+            {
+                vertex_normals[ia - offset] += fn;
+                vertex_normals[ib - offset] += fn;
+                vertex_normals[ic - offset] += fn;
+            }
+
+#endif /* MESH_AWPN_NORMALS */
+        }
+        return zlfn;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
 
 void
 TriangleMesh::recalc_normals (bool face, bool vertex)
@@ -30,7 +158,7 @@ TriangleMesh::recalc_normals (bool face, bool vertex)
     if (face)
     {
         this->face_normals.clear();
-        this->face_normals.reserve(this->faces.size() / 3);
+        this->face_normals.resize(this->faces.size() / 3);
     }
 
     if (vertex)
@@ -42,109 +170,72 @@ TriangleMesh::recalc_normals (bool face, bool vertex)
     std::size_t zlfn = 0;
     std::size_t zlvn = 0;
 
-    for (std::size_t i = 0; i < this->faces.size(); i += 3)
+    /*
+     * Every thread handles a contiguous block of faces. The first thread
+     * adds to the vertex normals directly, the other threads add to private
+     * normals that span the vertex indices of their block. These are added
+     * to the vertex normals afterwards in thread order, which keeps the
+     * result deterministic. Faces of most meshes reference vertices with
+     * nearby indices, so the private normals are small.
+     */
+    std::size_t const num_faces = this->faces.size() / 3;
+    std::vector<std::size_t> offsets;
+    std::vector<std::vector<math::Vec3f> > partials;
+#pragma omp parallel reduction(+:zlfn)
     {
-        /* Face vertex indices. */
-        std::size_t ia = this->faces[i + 0];
-        std::size_t ib = this->faces[i + 1];
-        std::size_t ic = this->faces[i + 2];
-
-        /* Face vertices. */
-        math::Vec3f const& a = this->vertices[ia];
-        math::Vec3f const& b = this->vertices[ib];
-        math::Vec3f const& c = this->vertices[ic];
-
-        /* Face edges. */
-        math::Vec3f ab = b - a;
-        math::Vec3f bc = c - b;
-        math::Vec3f ca = a - c;
-
-        /* Face normal. */
-        math::Vec3f fn = ab.cross(-ca);
-        float fnl = fn.norm();
-
-        /* Count zero-length face normals. */
-        if (fnl == 0.0f)
-            zlfn += 1;
-
-#if MESH_AWPN_NORMALS
-
-        /*
-         * Calculate angle weighted pseudo normals by weighted
-         * averaging adjacent face normals.
-         */
-
-        /* Normalize face normal. */
-        if (fnl != 0.0f)
-            fn /= fnl;
-
-        /* Add (normalized) face normal. */
-        if (face)
-            this->face_normals.push_back(fn);
-
-        /* Update adjacent vertex normals. */
-        if (fnl != 0.0f && vertex)
+        std::size_t num_threads = 1;
+        std::size_t thread = 0;
+#ifdef _OPENMP
+        num_threads = omp_get_num_threads();
+        thread = omp_get_thread_num();
+#pragma omp single
+#endif
         {
-            float abl = ab.norm();
-            float bcl = bc.norm();
-            float cal = ca.norm();
-
-            /*
-             * Although (a.dot(b) / (alen * blen)) is more efficient,
-             * (a / alen).dot(b / blen) is numerically more stable.
-             */
-            float ratio1 = (ab / abl).dot(-ca / cal);
-            float ratio2 = (-ab / abl).dot(bc / bcl);
-            float ratio3 = (ca / cal).dot(-bc / bcl);
-            float angle1 = std::acos(math::clamp(ratio1, -1.0f, 1.0f));
-            float angle2 = std::acos(math::clamp(ratio2, -1.0f, 1.0f));
-            float angle3 = std::acos(math::clamp(ratio3, -1.0f, 1.0f));
-
-            //float angle1 = std::acos(ab.dot(-ca) / (abl * cal));
-            //float angle2 = std::acos((-ab).dot(bc) / (abl * bcl));
-            //float angle3 = std::acos(ca.dot(-bc) / (cal * bcl));
-
-            this->vertex_normals[ia] += fn * angle1;
-            this->vertex_normals[ib] += fn * angle2;
-            this->vertex_normals[ic] += fn * angle3;
-
-            if (MATH_ISNAN(angle1) || MATH_ISNAN(angle2) || MATH_ISNAN(angle3))
-            {
-                std::cout << "NAN error in " << __FILE__ << ":" << __LINE__
-                    << ": " << angle1 << " / " << angle2 << " / " << angle3
-                    << " (" << abl << " / " << bcl << " / " << cal << ")"
-                    << " [" << ratio1 << " / " << ratio2 << " / " << ratio3
-                    << "]" << std::endl;
-            }
+            offsets.resize(num_threads, 0);
+            partials.resize(num_threads);
         }
 
-#else /* no MESH_AWPN_NORMALS */
-
-        /*
-         * Calculate simple vertex normals by averaging
-         * area-weighted adjacent face normals.
-         */
-
-        if (face)
-        {
-            this->face_normals.push_back(fnl ? fn / fnl : fn);
-        }
+        std::size_t const begin = num_faces * thread / num_threads * 3;
+        std::size_t const end = num_faces * (thread + 1) / num_threads * 3;
+        math::Vec3f* face_normals = face
+            ? this->face_normals.data() : nullptr;
+        math::Vec3f* vertex_normals = vertex
+            ? this->vertex_normals.data() : nullptr;
 
-        if (fnl != 0.0f && vertex)
+        if (vertex && thread > 0 && begin < end)
         {
-            this->vertex_normals[ia] += fn;
-            this->vertex_normals[ib] += fn;
-            this->vertex_normals[ic] += fn;
+            std::size_t min_id = this->faces[begin];
+            std::size_t max_id = this->faces[begin];
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                min_id = std::min<std::size_t>(min_id, this->faces[i]);
+                max_id = std::max<std::size_t>(max_id, this->faces[i]);
+            }
+            offsets[thread] = min_id;
+            partials[thread].resize(max_id - min_id + 1, math::Vec3f(0.0f));
+            vertex_normals = partials[thread].data();
         }
 
-#endif /* MESH_AWPN_NORMALS */
-
+        zlfn += accumulate_normals(this->vertices, this->faces, begin, end,
+            face_normals, vertex_normals, offsets[thread]);
     }
 
-    /* Normalize all vertex normals. */
+    /* Add the private normals and normalize all vertex normals. */
     if (vertex)
     {
-        for (std::size_t i = 0; i < this->vertex_normals.size(); ++i)
+        for (std::size_t t = 1; t < partials.size(); ++t)
+        {
+            std::int64_t const num = partials[t].size();
+            math::Vec3f* normals = &this->vertex_normals[0] + offsets[t];
+#pragma omp parallel for schedule(static)
+            for (std::int64_t i = 0; i < num; ++i)
+                normals[i] += partials[t][i];
+            std::vector<math::Vec3f>().swap(partials[t]);
+        }
+
+        std::int64_t const num_vertices = this->vertex_normals.size();
+#pragma omp parallel for schedule(static) reduction(+:zlvn)
+        for (std::int64_t i = 0; i < num_vertices; ++i)
         {
             float vnl = this->vertex_normals[i].norm();
             if (vnl > 0.0f)
@@ -174,23 +265,53 @@ TriangleMesh::ensure_normals (bool face, bool vertex)
 
 /* ---------------------------------------------------------------- */
 
+namespace
+{
+    /*
+     * Computes the new IDs of the kept vertices as prefix sum of the kept
+     * vertices. Returns the number of kept vertices.
+     */
+    std::size_t
+    compute_new_ids (TriangleMesh::DeleteList const& dlist,
+        std::vector<TriangleMesh::VertexID>* new_ids)
+    {
+        new_ids->resize(dlist.size());
+        TriangleMesh::VertexID num_kept = 0;
+        for (std::size_t i = 0; i < dlist.size(); ++i)
+        {
+            (*new_ids)[i] = num_kept;
+            num_kept += dlist[i] ? 0 : 1;
+        }
+        return num_kept;
+    }
+
+    /* Copies the kept elements to their new positions in parallel. */
+    template <typename T>
+    void
+    compact_list (TriangleMesh::DeleteList const& dlist,
+        std::vector<TriangleMesh::VertexID> const& new_ids,
+        std::size_t num_kept, std::vector<T>* list)
+    {
+        std::vector<T> compacted(num_kept);
+        std::int64_t const num_elements = static_cast<std::int64_t>
+            (list->size());
+#pragma omp parallel for schedule(static)
+        for (std::int64_t i = 0; i < num_elements; ++i)
+            if (!dlist[i])
+                compacted[new_ids[i]] = (*list)[i];
+        std::swap(*list, compacted);
+    }
+}
+
 void
 TriangleMesh::delete_vertices (DeleteList const& delete_list)
 {
     if (delete_list.size() != this->vertices.size())
         throw std::invalid_argument("Delete list does not match vertex list");
 
-    if (this->has_vertex_normals())
-        math::algo::vector_clean(delete_list, &this->vertex_normals);
-    if (this->has_vertex_colors())
-        math::algo::vector_clean(delete_list, &this->vertex_colors);
-    if (this->has_vertex_confidences())
-        math::algo::vector_clean(delete_list, &this->vertex_confidences);
-    if (this->has_vertex_values())
-        math::algo::vector_clean(delete_list, &this->vertex_values);
-    if (this->has_vertex_texcoords())
-        math::algo::vector_clean(delete_list, &this->vertex_texcoords);
-    math::algo::vector_clean(delete_list, &this->vertices);
+    std::vector<VertexID> new_ids;
+    std::size_t const num_kept = compute_new_ids(delete_list, &new_ids);
+    this->compact_vertices(delete_list, new_ids, num_kept);
 }
 
 /* ---------------------------------------------------------------- */
@@ -201,40 +322,57 @@ TriangleMesh::delete_vertices_fix_faces (DeleteList const& dlist)
     if (dlist.size() != this->vertices.size())
         throw std::invalid_argument("Delete list does not match vertex list");
 
-    /* Each vertex is shifted to the left. This list tracks the distance. */
-    std::vector<std::size_t> idxshift(this->vertices.size(), 0);
-    std::size_t num_deleted = 0;
-    for (std::size_t i = 0; i < this->vertices.size(); ++i)
-    {
-        idxshift[i] = num_deleted;
-        if (dlist[i] == true)
-            num_deleted += 1;
-    }
+    /* The new ID of every kept vertex. */
+    std::vector<VertexID> new_ids;
+    std::size_t const num_kept = compute_new_ids(dlist, &new_ids);
 
     /* Invalidate faces referencing deleted vertices and fix vertex IDs. */
-    for (std::size_t i = 0; i < this->faces.size(); i += 3)
+    std::int64_t const num_faces = static_cast<std::int64_t>
+        (this->faces.size() / 3);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_faces; ++i)
     {
-        if (dlist[faces[i + 0]] || dlist[faces[i + 1]] || dlist[faces[i + 2]])
+        VertexID* face = &this->faces[i * 3];
+        if (dlist[face[0]] || dlist[face[1]] || dlist[face[2]])
         {
-            faces[i + 0] = 0;
-            faces[i + 1] = 0;
-            faces[i + 2] = 0;
+            face[0] = 0;
+            face[1] = 0;
+            face[2] = 0;
         }
         else
         {
-            faces[i + 0] -= idxshift[faces[i + 0]];
-            faces[i + 1] -= idxshift[faces[i + 1]];
-            faces[i + 2] -= idxshift[faces[i + 2]];
+            face[0] = new_ids[face[0]];
+            face[1] = new_ids[face[1]];
+            face[2] = new_ids[face[2]];
         }
     }
 
     /* Compact vertex and attribute vectors, remove invalid faces. */
-    this->delete_vertices(dlist);
+    this->compact_vertices(dlist, new_ids, num_kept);
     this->delete_invalid_faces();
 }
 
 /* ---------------------------------------------------------------- */
 
+void
+TriangleMesh::compact_vertices (DeleteList const& dlist,
+    std::vector<VertexID> const& new_ids, std::size_t num_kept)
+{
+    if (this->has_vertex_normals())
+        compact_list(dlist, new_ids, num_kept, &this->vertex_normals);
+    if (this->has_vertex_colors())
+        compact_list(dlist, new_ids, num_kept, &this->vertex_colors);
+    if (this->has_vertex_confidences())
+        compact_list(dlist, new_ids, num_kept, &this->vertex_confidences);
+    if (this->has_vertex_values())
+        compact_list(dlist, new_ids, num_kept, &this->vertex_values);
+    if (this->has_vertex_texcoords())
+        compact_list(dlist, new_ids, num_kept, &this->vertex_texcoords);
+    compact_list(dlist, new_ids, num_kept, &this->vertices);
+}
+
+/* ---------------------------------------------------------------- */
+
 namespace
 {
     bool
@@ -282,4 +420,4 @@ TriangleMesh::get_byte_size (void) const
     return s_verts + s_faces + s_vnorm + s_fnorm + s_color;
 }
 
-MVE_NAMESPACE_END
+CORE_NAMESPACE_END
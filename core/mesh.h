@@ -7,9 +7,10 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_TRIANGLE_MESH_HEADER
-#define MVE_TRIANGLE_MESH_HEADER
+#ifndef CORE_TRIANGLE_MESH_HEADER
+#define CORE_TRIANGLE_MESH_HEADER
 
+#include <cstdint>
 #include <vector>
 #include <memory>
 
@@ -96,7 +97,8 @@ public:
     typedef std::vector<math::Vec2f> TexCoordList;
     typedef std::vector<VertexID> FaceList;
 
-    typedef std::vector<bool> DeleteList;
+    /** Byte mask of the vertices to delete, non-zero marks deletion. */
+    typedef std::vector<uint8_t> DeleteList;
 
 public:
     virtual ~TriangleMesh (void);
@@ -151,7 +153,8 @@ public:
 
     /**
      * Deletes marked vertices and related attributes if available.
-     * Note that this does not change face data.
+     * Note that this does not change face data. The new vertex IDs are
+     * computed once, and all attribute lists are compacted in parallel.
      */
     void delete_vertices (DeleteList const& dlist);
 
@@ -181,6 +184,11 @@ protected:
 protected:
     /** Use the create() methods to instantiate a mesh. */
     TriangleMesh (void);
+
+private:
+    /* Moves the kept vertices and attributes to their new IDs. */
+    void compact_vertices (DeleteList const& dlist,
+        std::vector<VertexID> const& new_ids, std::size_t num_kept);
 };
 
 /* ---------------------------------------------------------------- */
@@ -411,4 +419,4 @@ TriangleMesh::has_face_colors (void) const
 
 CORE_NAMESPACE_END
 
-#endif /* MVE_TRIANGLE_MESH_HEADER */
+#endif /* CORE_TRIANGLE_MESH_HEADER */
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+
+#include "core/mesh_adjacency.h"
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Adjacent face representation for the ordering algorithm. */
+    struct AdjacentFace
+    {
+        std::size_t face_id;
+        std::size_t first;
+        std::size_t second;
+    };
+
+    /* Returns the position of the vertex in the face. */
+    inline int
+    corner_of_vertex (TriangleMesh::FaceList const& faces,
+        std::size_t face_id, std::size_t vertex_id)
+    {
+        for (int j = 0; j < 2; ++j)
+            if (faces[face_id * 3 + j] == vertex_id)
+                return j;
+        return 2;
+    }
+
+    /*
+     * Orders the adjacent faces of a vertex by chaining them, exactly like
+     * MeshInfo::update_vertex(), and returns the vertex class. The faces
+     * are reordered in-place unless the vertex is complex.
+     */
+    MeshInfo::VertexClass
+    order_adjacent_faces (TriangleMesh::FaceList const& faces,
+        std::size_t vertex_id, MeshAdjacency::FaceID* face_ids,
+        std::size_t num_faces, std::vector<AdjacentFace>* adj_temp,
+        std::deque<AdjacentFace>* adj_sorted)
+    {
+        /* If there are no adjacent faces, the vertex is unreferenced. */
+        if (num_faces == 0)
+            return MeshInfo::VERTEX_CLASS_UNREF;
+
+        adj_temp->clear();
+        for (std::size_t i = 0; i < num_faces; ++i)
+        {
+            int const j = corner_of_vertex(faces, face_ids[i], vertex_id);
+            AdjacentFace face;
+            face.face_id = face_ids[i];
+            face.first = faces[face_ids[i] * 3 + (j + 1) % 3];
+            face.second = faces[face_ids[i] * 3 + (j + 2) % 3];
+            adj_temp->push_back(face);
+        }
+
+        /* Sort adjacent faces by chaining them. */
+        adj_sorted->clear();
+        adj_sorted->push_back(adj_temp->front());
+        adj_temp->erase(adj_temp->begin());
+        while (!adj_temp->empty())
+        {
+            std::size_t const front_id = adj_sorted->front().first;
+            std::size_t const back_id = adj_sorted->back().second;
+
+            /* Find a faces that fits the back or front of sorted list. */
+            bool found_face = false;
+            for (std::size_t i = 0; i < adj_temp->size(); ++i)
+            {
+                AdjacentFace const face = adj_temp->at(i);
+                if (front_id == face.second)
+                    adj_sorted->push_front(face);
+                else if (back_id == face.first)
+                    adj_sorted->push_back(face);
+                else
+                    continue;
+                adj_temp->erase(adj_temp->begin() + i);
+                found_face = true;
+                break;
+            }
+
+            /* If there is no next face, the vertex is complex. */
+            if (!found_face)
+                return MeshInfo::VERTEX_CLASS_COMPLEX;
+        }
+
+        for (std::size_t i = 0; i < num_faces; ++i)
+            face_ids[i] = adj_sorted->at(i).face_id;
+
+        /* If the vertex is not on the mesh boundary, the list is circular. */
+        if (adj_sorted->front().first == adj_sorted->back().second)
+            return MeshInfo::VERTEX_CLASS_SIMPLE;
+        else
+            return MeshInfo::VERTEX_CLASS_BORDER;
+    }
+
+    /*
+     * Collects the adjacent vertices of a vertex from its ordered faces,
+     * for complex vertices as a sorted list of unique IDs.
+     */
+    void
+    collect_adjacent_vertices (TriangleMesh::FaceList const& faces,
+        std::size_t vertex_id, MeshInfo::VertexClass vclass,
+        MeshAdjacency::FaceID const* face_ids, std::size_t num_faces,
+        std::vector<MeshAdjacency::VertexID>* result)
+    {
+        result->clear();
+        for (std::size_t i = 0; i < num_faces; ++i)
+        {
+            int const j = corner_of_vertex(faces, face_ids[i], vertex_id);
+            result->push_back(faces[face_ids[i] * 3 + (j + 1) % 3]);
+            if (vclass == MeshInfo::VERTEX_CLASS_COMPLEX
+                || (vclass == MeshInfo::VERTEX_CLASS_BORDER
+                && i + 1 == num_faces))
+                result->push_back(faces[face_ids[i] * 3 + (j + 2) % 3]);
+        }
+
+        if (vclass == MeshInfo::VERTEX_CLASS_COMPLEX)
+        {
+            std::sort(result->begin(), result->end());
+            result->erase(std::unique(result->begin(), result->end()),
+                result->end());
+        }
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+MeshAdjacency::initialize (TriangleMesh::ConstPtr mesh)
+{
+    TriangleMesh::VertexList const& verts = mesh->get_vertices();
+    TriangleMesh::FaceList const& faces = mesh->get_faces();
+    std::int64_t const num_vertices = verts.size();
+    std::int64_t const num_corners = faces.size() / 3 * 3;
+
+    /* Count the adjacent faces of every vertex. */
+    this->face_offsets.clear();
+    this->face_offsets.resize(num_vertices + 1, 0);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_corners; ++i)
+    {
+#pragma omp atomic
+        this->face_offsets[faces[i] + 1] += 1;
+    }
+    for (std::int64_t i = 0; i < num_vertices; ++i)
+        this->face_offsets[i + 1] += this->face_offsets[i];
+
+    /* Add faces to their three vertices. */
+    this->face_ids.clear();
+    this->face_ids.resize(num_corners);
+    {
+        std::vector<std::size_t> fill(this->face_offsets.begin(),
+            this->face_offsets.end() - 1);
+#pragma omp parallel for schedule(static)
+        for (std::int64_t i = 0; i < num_corners; ++i)
+        {
+            std::size_t pos;
+#pragma omp atomic capture
+            pos = fill[faces[i]]++;
+            this->face_ids[pos] = i / 3;
+        }
+    }
+
+    /* Classify each vertex, order its faces and count adjacent vertices. */
+    this->vertex_classes.clear();
+    this->vertex_classes.resize(num_vertices);
+    this->vertex_offsets.clear();
+    this->vertex_offsets.resize(num_vertices + 1, 0);
+#pragma omp parallel
+    {
+        std::vector<AdjacentFace> adj_temp;
+        std::deque<AdjacentFace> adj_sorted;
+        std::vector<VertexID> adj_verts;
+
+#pragma omp for schedule(dynamic, 1024)
+        for (std::int64_t i = 0; i < num_vertices; ++i)
+        {
+            FaceID* ids = this->face_ids.data() + this->face_offsets[i];
+            std::size_t const num = this->face_offsets[i + 1]
+                - this->face_offsets[i];
+
+            /* Restore the face order of the sequential construction. */
+            std::sort(ids, ids + num);
+            VertexClass const vclass = order_adjacent_faces(faces, i,
+                ids, num, &adj_temp, &adj_sorted);
+            this->vertex_classes[i] = static_cast<unsigned char>(vclass);
+
+            if (vclass == MeshInfo::VERTEX_CLASS_COMPLEX)
+            {
+                collect_adjacent_vertices(faces, i, vclass, ids, num,
+                    &adj_verts);
+                this->vertex_offsets[i + 1] = adj_verts.size();
+            }
+            else if (vclass == MeshInfo::VERTEX_CLASS_BORDER)
+                this->vertex_offsets[i + 1] = num + 1;
+            else
+                this->vertex_offsets[i + 1] = num;
+        }
+    }
+    for (std::int64_t i = 0; i < num_vertices; ++i)
+        this->vertex_offsets[i + 1] += this->vertex_offsets[i];
+
+    /* Compute the adjacent vertices. */
+    this->vertex_ids.clear();
+    this->vertex_ids.resize(this->vertex_offsets.back());
+#pragma omp parallel
+    {
+        std::vector<VertexID> adj_verts;
+
+#pragma omp for schedule(dynamic, 1024)
+        for (std::int64_t i = 0; i < num_vertices; ++i)
+        {
+            collect_adjacent_vertices(faces, i, this->get_vertex_class(i),
+                this->get_faces(i), this->get_num_faces(i), &adj_verts);
+            std::copy(adj_verts.begin(), adj_verts.end(),
+                this->vertex_ids.begin() + this->vertex_offsets[i]);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MeshAdjacency::is_mesh_edge (std::size_t v1, std::size_t v2) const
+{
+    VertexID const* begin = this->get_vertices(v1);
+    VertexID const* end = begin + this->get_num_vertices(v1);
+    return std::find(begin, end, v2) != end;
+}
+
+/* ---------------------------------------------------------------- */
+
+MeshAdjacency::VertexClass
+MeshAdjacency::classify_vertex (TriangleMesh::FaceList const& faces,
+    std::size_t vertex_id, std::vector<FaceID> face_ids)
+{
+    std::vector<AdjacentFace> adj_temp;
+    std::deque<AdjacentFace> adj_sorted;
+    std::sort(face_ids.begin(), face_ids.end());
+    return order_adjacent_faces(faces, vertex_id, face_ids.data(),
+        face_ids.size(), &adj_temp, &adj_sorted);
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef CORE_MESH_ADJACENCY_HEADER
+#define CORE_MESH_ADJACENCY_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "core/defines.h"
+#include "core/mesh.h"
+#include "core/mesh_info.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * Compact, read-only vertex adjacency of a triangle mesh.
+ *
+ * This provides the vertex classification and the adjacent faces and
+ * vertices of MeshInfo, in the same order, but stores them in compressed
+ * sparse row form: One offset array and one flat ID array for each of the
+ * adjacent faces and vertices. This avoids the per-vertex allocations of
+ * MeshInfo, and the structure is built in parallel. Use MeshInfo if the
+ * adjacency must be updated while the mesh is modified.
+ */
+class MeshAdjacency
+{
+public:
+    typedef MeshInfo::VertexClass VertexClass;
+    typedef TriangleMesh::VertexID VertexID;
+    typedef unsigned int FaceID;
+
+public:
+    /** Constructor without initialization. */
+    MeshAdjacency (void);
+
+    /** Constructor with initialization for the given mesh. */
+    explicit MeshAdjacency (TriangleMesh::ConstPtr mesh);
+
+    /** Initializes the data structure for the given mesh. */
+    void initialize (TriangleMesh::ConstPtr mesh);
+
+    /** Returns the classification of the vertex. */
+    VertexClass get_vertex_class (std::size_t vertex_id) const;
+
+    /** Returns the amount of faces adjacent to the vertex. */
+    std::size_t get_num_faces (std::size_t vertex_id) const;
+    /** Returns the faces adjacent to the vertex. */
+    FaceID const* get_faces (std::size_t vertex_id) const;
+
+    /** Returns the amount of vertices adjacent to the vertex. */
+    std::size_t get_num_vertices (std::size_t vertex_id) const;
+    /** Returns the vertices adjacent to the vertex. */
+    VertexID const* get_vertices (std::size_t vertex_id) const;
+
+    /** Checks for the existence of an edge between the given vertices. */
+    bool is_mesh_edge (std::size_t v1, std::size_t v2) const;
+
+    /**
+     * Classifies a vertex like MeshInfo for the given adjacent faces only.
+     * This is useful to update the classification after faces have been
+     * removed from the mesh, without rebuilding the adjacency.
+     */
+    static VertexClass classify_vertex (TriangleMesh::FaceList const& faces,
+        std::size_t vertex_id, std::vector<FaceID> face_ids);
+
+    /** Returns the amount of vertices. */
+    std::size_t size (void) const;
+    /** Releases all memory. */
+    void clear (void);
+
+private:
+    std::vector<unsigned char> vertex_classes;
+    std::vector<std::size_t> face_offsets;
+    std::vector<FaceID> face_ids;
+    std::vector<std::size_t> vertex_offsets;
+    std::vector<VertexID> vertex_ids;
+};
+
+/* ------------------------- Implementation ----------------------- */
+
+inline
+MeshAdjacency::MeshAdjacency (void)
+{
+}
+
+inline
+MeshAdjacency::MeshAdjacency (TriangleMesh::ConstPtr mesh)
+{
+    this->initialize(mesh);
+}
+
+inline MeshAdjacency::VertexClass
+MeshAdjacency::get_vertex_class (std::size_t vertex_id) const
+{
+    return static_cast<VertexClass>(this->vertex_classes[vertex_id]);
+}
+
+inline std::size_t
+MeshAdjacency::get_num_faces (std::size_t vertex_id) const
+{
+    return this->face_offsets[vertex_id + 1] - this->face_offsets[vertex_id];
+}
+
+inline MeshAdjacency::FaceID const*
+MeshAdjacency::get_faces (std::size_t vertex_id) const
+{
+    return this->face_ids.data() + this->face_offsets[vertex_id];
+}
+
+inline std::size_t
+MeshAdjacency::get_num_vertices (std::size_t vertex_id) const
+{
+    return this->vertex_offsets[vertex_id + 1]
+        - this->vertex_offsets[vertex_id];
+}
+
+inline MeshAdjacency::VertexID const*
+MeshAdjacency::get_vertices (std::size_t vertex_id) const
+{
+    return this->vertex_ids.data() + this->vertex_offsets[vertex_id];
+}
+
+inline std::size_t
+MeshAdjacency::size (void) const
+{
+    return this->vertex_classes.size();
+}
+
+inline void
+MeshAdjacency::clear (void)
+{
+    std::vector<unsigned char>().swap(this->vertex_classes);
+    std::vector<std::size_t>().swap(this->face_offsets);
+    std::vector<FaceID>().swap(this->face_ids);
+    std::vector<std::size_t>().swap(this->vertex_offsets);
+    std::vector<VertexID>().swap(this->vertex_ids);
+}
+
+CORE_NAMESPACE_END
+
+#endif /* CORE_MESH_ADJACENCY_HEADER */
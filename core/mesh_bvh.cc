@@ -0,0 +1,661 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "math/octree_tools.h"
+#include "core/mesh_bvh.h"
+
+/* The tree depth is bounded by the 64 bits of the sort keys. */
+#define MESH_BVH_STACK_SIZE 128
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Spreads the lower 10 bits of the value to every third bit. */
+    inline std::uint32_t
+    expand_bits (std::uint32_t v)
+    {
+        v = (v * 0x00010001u) & 0xff0000ffu;
+        v = (v * 0x00000101u) & 0x0f00f00fu;
+        v = (v * 0x00000011u) & 0xc30c30c3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    /* Returns the 30 bit Morton code of a point in the unit cube. */
+    inline std::uint32_t
+    morton_code (math::Vec3f const& pos)
+    {
+        std::uint32_t code = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            float const v = std::min(std::max(pos[i] * 1024.0f, 0.0f),
+                1023.0f);
+            code = code * 2 + expand_bits(static_cast<std::uint32_t>(v));
+        }
+        return code;
+    }
+
+    inline int
+    count_leading_zeros (std::uint64_t v)
+    {
+#if defined(__GNUC__)
+        return __builtin_clzll(v);
+#else
+        int num = 0;
+        for (std::uint64_t bit = 1ull << 63; (v & bit) == 0; bit >>= 1)
+            num += 1;
+        return num;
+#endif
+    }
+
+    /*
+     * Returns the length of the common prefix of the sort keys 'i' and 'j',
+     * or -1 if 'j' is out of range. The keys are unique.
+     */
+    inline int
+    common_prefix (std::vector<std::uint64_t> const& keys,
+        std::int64_t i, std::int64_t j)
+    {
+        if (j < 0 || j >= static_cast<std::int64_t>(keys.size()))
+            return -1;
+        return count_leading_zeros(keys[i] ^ keys[j]);
+    }
+
+    /*
+     * Sorts the keys with the Morton code in the upper 32 bits. The lower
+     * bits are the face IDs, which are already in increasing order and
+     * kept in order by the stable radix sort.
+     */
+    void
+    sort_keys (std::vector<std::uint64_t>* keys)
+    {
+        std::vector<std::uint64_t> temp(keys->size());
+        for (int shift = 32; shift < 62; shift += 10)
+        {
+            std::vector<std::size_t> offsets(1025, 0);
+            for (std::size_t i = 0; i < keys->size(); ++i)
+                offsets[((keys->at(i) >> shift) & 1023) + 1] += 1;
+            for (std::size_t i = 1; i < offsets.size(); ++i)
+                offsets[i] += offsets[i - 1];
+            for (std::size_t i = 0; i < keys->size(); ++i)
+            {
+                std::uint64_t const key = keys->at(i);
+                temp[offsets[(key >> shift) & 1023]++] = key;
+            }
+            keys->swap(temp);
+        }
+    }
+
+    inline void
+    triangle_box (math::Vec3f const* tri, math::Vec3f* aabb_min,
+        math::Vec3f* aabb_max)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            (*aabb_min)[i] = math::min(tri[0][i], tri[1][i], tri[2][i]);
+            (*aabb_max)[i] = math::max(tri[0][i], tri[1][i], tri[2][i]);
+        }
+    }
+
+    /*
+     * Intersects the ray interval with the box and returns the entry
+     * parameter. The exit parameter is slightly enlarged to conservatively
+     * account for rounding, see Pharr et al., "Physically Based Rendering".
+     */
+    inline bool
+    ray_box_entry (math::Vec3f const& origin, math::Vec3f const& inv_dir,
+        math::Vec3f const& aabb_min, math::Vec3f const& aabb_max,
+        float tmin, float tmax, float* entry)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            float t0 = (aabb_min[i] - origin[i]) * inv_dir[i];
+            float t1 = (aabb_max[i] - origin[i]) * inv_dir[i];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            t1 *= 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
+        }
+        *entry = tmin;
+        return tmin <= tmax;
+    }
+
+    /* Returns the squared distance of the point to the box. */
+    inline float
+    point_box_square_dist (math::Vec3f const& pos,
+        math::Vec3f const& aabb_min, math::Vec3f const& aabb_max)
+    {
+        float dist = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            float const d = std::max(0.0f, std::max(aabb_min[i] - pos[i],
+                pos[i] - aabb_max[i]));
+            dist += d * d;
+        }
+        return dist;
+    }
+
+    /*
+     * Returns the closest point on the triangle by classifying the point
+     * into the Voronoi regions of the triangle, see Ericson, "Real-Time
+     * Collision Detection", Section 5.1.5.
+     */
+    math::Vec3f
+    closest_point_on_triangle (math::Vec3f const& p, math::Vec3f const& a,
+        math::Vec3f const& b, math::Vec3f const& c)
+    {
+        math::Vec3f const ab = b - a;
+        math::Vec3f const ac = c - a;
+        math::Vec3f const ap = p - a;
+        float const d1 = ab.dot(ap);
+        float const d2 = ac.dot(ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+
+        math::Vec3f const bp = p - b;
+        float const d3 = ab.dot(bp);
+        float const d4 = ac.dot(bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+
+        float const vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+
+        math::Vec3f const cp = p - c;
+        float const d5 = ab.dot(cp);
+        float const d6 = ac.dot(cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+
+        float const vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+
+        float const va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        float const denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    /* An entry of the traversal stack with the key for pruning. */
+    struct StackEntry
+    {
+        std::uint32_t node_id;
+        float key;
+    };
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+MeshBVH::build (TriangleMesh::ConstPtr mesh)
+{
+    this->clear();
+
+    TriangleMesh::VertexList const& verts = mesh->get_vertices();
+    TriangleMesh::FaceList const& faces = mesh->get_faces();
+    std::int64_t const num_faces = faces.size() / 3;
+    if (num_faces == 0)
+        return;
+    if (static_cast<std::uint64_t>(num_faces) >= LEAF_FLAG)
+        throw std::invalid_argument("Too many faces for BVH");
+    for (std::size_t i = 0; i < faces.size(); ++i)
+        if (faces[i] >= verts.size())
+            throw std::invalid_argument("Invalid vertex ID in mesh");
+
+    /* Bounding box of the face centroids. */
+    std::vector<math::Vec3f> centroids(num_faces);
+    math::Vec3f cmin(std::numeric_limits<float>::max());
+    math::Vec3f cmax(-std::numeric_limits<float>::max());
+#pragma omp parallel
+    {
+        math::Vec3f local_min(std::numeric_limits<float>::max());
+        math::Vec3f local_max(-std::numeric_limits<float>::max());
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_faces; ++i)
+        {
+            math::Vec3f const centroid = (verts[faces[i * 3 + 0]]
+                + verts[faces[i * 3 + 1]] + verts[faces[i * 3 + 2]]) / 3.0f;
+            centroids[i] = centroid;
+            for (int j = 0; j < 3; ++j)
+            {
+                local_min[j] = std::min(local_min[j], centroid[j]);
+                local_max[j] = std::max(local_max[j], centroid[j]);
+            }
+        }
+#pragma omp critical
+        for (int j = 0; j < 3; ++j)
+        {
+            cmin[j] = std::min(cmin[j], local_min[j]);
+            cmax[j] = std::max(cmax[j], local_max[j]);
+        }
+    }
+
+    /* Sort keys with the Morton code and the face ID. */
+    math::Vec3f scale;
+    for (int j = 0; j < 3; ++j)
+        scale[j] = cmax[j] > cmin[j] ? 1.0f / (cmax[j] - cmin[j]) : 0.0f;
+    std::vector<std::uint64_t> keys(num_faces);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_faces; ++i)
+    {
+        math::Vec3f const pos = (centroids[i] - cmin).cw_mult(scale);
+        keys[i] = static_cast<std::uint64_t>(morton_code(pos)) << 32
+            | static_cast<std::uint64_t>(i);
+    }
+    std::vector<math::Vec3f>().swap(centroids);
+    sort_keys(&keys);
+
+    /* Store the faces in the sorted order. */
+    this->face_ids.resize(num_faces);
+    this->triangles.resize(num_faces * 3);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_faces; ++i)
+    {
+        FaceID const face_id = static_cast<FaceID>(keys[i] & 0xffffffffu);
+        this->face_ids[i] = face_id;
+        for (int j = 0; j < 3; ++j)
+            this->triangles[i * 3 + j] = verts[faces[face_id * 3 + j]];
+    }
+    if (num_faces == 1)
+        return;
+
+    /*
+     * Build the internal nodes independently from the sorted keys, see
+     * Karras, "Maximizing Parallelism in the Construction of BVHs,
+     * Octrees, and k-d Trees", HPG 2012. The parents of the internal nodes
+     * are stored first, followed by the parents of the faces.
+     */
+    std::int64_t const num_nodes = num_faces - 1;
+    this->nodes.resize(num_nodes);
+    std::vector<std::uint32_t> parents(num_nodes + num_faces, 0);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_nodes; ++i)
+    {
+        /* Determine the direction and the other end of the range. */
+        int const dir = common_prefix(keys, i, i + 1)
+            > common_prefix(keys, i, i - 1) ? 1 : -1;
+        int const min_prefix = common_prefix(keys, i, i - dir);
+        std::int64_t max_len = 2;
+        while (common_prefix(keys, i, i + max_len * dir) > min_prefix)
+            max_len *= 2;
+        std::int64_t len = 0;
+        for (std::int64_t step = max_len / 2; step > 0; step /= 2)
+            if (common_prefix(keys, i, i + (len + step) * dir) > min_prefix)
+                len += step;
+        std::int64_t const j = i + len * dir;
+
+        /* Find the split position with a binary search. */
+        int const node_prefix = common_prefix(keys, i, j);
+        std::int64_t split = 0;
+        std::int64_t step = len;
+        do
+        {
+            step = (step + 1) / 2;
+            if (common_prefix(keys, i, i + (split + step) * dir) > node_prefix)
+                split += step;
+        }
+        while (step > 1);
+        std::int64_t const gamma = i + split * dir + std::min(dir, 0);
+
+        Node& node = this->nodes[i];
+        node.first = static_cast<std::uint32_t>(std::min(i, j));
+        node.last = static_cast<std::uint32_t>(std::max(i, j));
+        node.left = static_cast<std::uint32_t>(gamma);
+        node.right = static_cast<std::uint32_t>(gamma + 1);
+        if (node.left == node.first)
+        {
+            parents[num_nodes + node.left] = static_cast<std::uint32_t>(i);
+            node.left |= LEAF_FLAG;
+        }
+        else
+            parents[node.left] = static_cast<std::uint32_t>(i);
+        if (node.right == node.last)
+        {
+            parents[num_nodes + node.right] = static_cast<std::uint32_t>(i);
+            node.right |= LEAF_FLAG;
+        }
+        else
+            parents[node.right] = static_cast<std::uint32_t>(i);
+    }
+
+    /*
+     * Compute the boxes bottom-up: Every face walks towards the root, and
+     * the second visitor of a node computes its box from the children.
+     */
+    std::vector<int> visits(num_nodes, 0);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_faces; ++i)
+    {
+        std::uint32_t node_id = parents[num_nodes + i];
+        while (true)
+        {
+            int visited;
+#pragma omp atomic capture seq_cst
+            visited = visits[node_id]++;
+            if (visited == 0)
+                break;
+
+            Node& node = this->nodes[node_id];
+            math::Vec3f child_min[2], child_max[2];
+            std::uint32_t const children[2] = { node.left, node.right };
+            for (int j = 0; j < 2; ++j)
+            {
+                if (children[j] & LEAF_FLAG)
+                {
+                    std::size_t const face = children[j] & ~LEAF_FLAG;
+                    triangle_box(&this->triangles[face * 3],
+                        child_min + j, child_max + j);
+                }
+                else
+                {
+                    child_min[j] = this->nodes[children[j]].aabb_min;
+                    child_max[j] = this->nodes[children[j]].aabb_max;
+                }
+            }
+            for (int j = 0; j < 3; ++j)
+            {
+                node.aabb_min[j] = std::min(child_min[0][j], child_min[1][j]);
+                node.aabb_max[j] = std::max(child_max[0][j], child_max[1][j]);
+            }
+
+            if (node_id == 0)
+                break;
+            node_id = parents[node_id];
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MeshBVH::clear (void)
+{
+    std::vector<Node>().swap(this->nodes);
+    FaceList().swap(this->face_ids);
+    std::vector<math::Vec3f>().swap(this->triangles);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MeshBVH::intersect (Ray const& ray, Hit* hit) const
+{
+    return this->traverse_ray(ray, false, hit);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MeshBVH::occluded (Ray const& ray) const
+{
+    return this->traverse_ray(ray, true, nullptr);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MeshBVH::traverse_ray (Ray const& ray, bool any_hit, Hit* hit) const
+{
+    if (this->face_ids.empty())
+        return false;
+
+    /* Tests a face in the sorted order and shortens the ray on a hit. */
+    float tmax = ray.tmax;
+    bool found = false;
+    auto test_face = [this, &ray, &tmax, &found, hit] (std::size_t id)
+    {
+        math::Vec3f const* tri = &this->triangles[id * 3];
+        float bary[2];
+        float const t = math::geom::ray_triangle_intersect(ray.origin,
+            ray.dir, tri[0], tri[1], tri[2], bary);
+        if (t == 0.0f || t < ray.tmin || t > tmax)
+            return false;
+        tmax = t;
+        found = true;
+        if (hit != nullptr)
+        {
+            hit->t = t;
+            hit->face_id = this->face_ids[id];
+            hit->bcoords = math::Vec3f(1.0f - bary[0] - bary[1],
+                bary[0], bary[1]);
+        }
+        return true;
+    };
+
+    if (this->nodes.empty())
+        return test_face(0);
+
+    math::Vec3f const inv_dir(1.0f / ray.dir[0], 1.0f / ray.dir[1],
+        1.0f / ray.dir[2]);
+    float entry;
+    if (!ray_box_entry(ray.origin, inv_dir, this->nodes[0].aabb_min,
+        this->nodes[0].aabb_max, ray.tmin, tmax, &entry))
+        return false;
+
+    StackEntry stack[MESH_BVH_STACK_SIZE];
+    int stack_size = 0;
+    std::uint32_t node_id = 0;
+    while (true)
+    {
+        Node const& node = this->nodes[node_id];
+        if (node.last - node.first < this->opts.max_leaf_faces)
+        {
+            for (std::size_t i = node.first; i <= node.last; ++i)
+                if (test_face(i) && any_hit)
+                    return true;
+        }
+        else
+        {
+            std::uint32_t const children[2] = { node.left, node.right };
+            float entries[2];
+            bool visit[2] = { false, false };
+            for (int i = 0; i < 2; ++i)
+            {
+                if (children[i] & LEAF_FLAG)
+                {
+                    if (test_face(children[i] & ~LEAF_FLAG) && any_hit)
+                        return true;
+                    continue;
+                }
+                Node const& child = this->nodes[children[i]];
+                visit[i] = ray_box_entry(ray.origin, inv_dir, child.aabb_min,
+                    child.aabb_max, ray.tmin, tmax, entries + i);
+            }
+
+            /* Descend into the nearer child first. */
+            if (visit[0] && visit[1])
+            {
+                int const near = entries[1] < entries[0] ? 1 : 0;
+                stack[stack_size].node_id = children[1 - near];
+                stack[stack_size].key = entries[1 - near];
+                stack_size += 1;
+                node_id = children[near];
+                continue;
+            }
+            if (visit[0] || visit[1])
+            {
+                node_id = children[visit[0] ? 0 : 1];
+                continue;
+            }
+        }
+
+        /* Continue with the next node that is not behind the nearest hit. */
+        while (stack_size > 0 && stack[stack_size - 1].key > tmax)
+            stack_size -= 1;
+        if (stack_size == 0)
+            break;
+        stack_size -= 1;
+        node_id = stack[stack_size].node_id;
+    }
+
+    return found;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MeshBVH::closest_point (math::Vec3f const& point, Nearest* result,
+    float max_dist) const
+{
+    if (this->face_ids.empty())
+        return false;
+
+    /* Tests a face in the sorted order and updates the closest point. */
+    float best = max_dist < std::sqrt(std::numeric_limits<float>::max())
+        ? max_dist * max_dist : std::numeric_limits<float>::max();
+    bool found = false;
+    auto test_face = [this, &point, &best, &found, result] (std::size_t id)
+    {
+        math::Vec3f const* tri = &this->triangles[id * 3];
+        math::Vec3f const pos = closest_point_on_triangle(point,
+            tri[0], tri[1], tri[2]);
+        float const dist = (pos - point).square_norm();
+        if (dist > best)
+            return;
+        best = dist;
+        found = true;
+        result->point = pos;
+        result->face_id = this->face_ids[id];
+    };
+
+    if (this->nodes.empty())
+        test_face(0);
+
+    StackEntry stack[MESH_BVH_STACK_SIZE];
+    int stack_size = 0;
+    if (!this->nodes.empty())
+    {
+        stack[0].node_id = 0;
+        stack[0].key = point_box_square_dist(point,
+            this->nodes[0].aabb_min, this->nodes[0].aabb_max);
+        stack_size = 1;
+    }
+
+    while (stack_size > 0)
+    {
+        stack_size -= 1;
+        if (stack[stack_size].key > best)
+            continue;
+        Node const& node = this->nodes[stack[stack_size].node_id];
+
+        if (node.last - node.first < this->opts.max_leaf_faces)
+        {
+            for (std::size_t i = node.first; i <= node.last; ++i)
+                test_face(i);
+            continue;
+        }
+
+        std::uint32_t const children[2] = { node.left, node.right };
+        StackEntry entries[2];
+        int num_entries = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            if (children[i] & LEAF_FLAG)
+            {
+                test_face(children[i] & ~LEAF_FLAG);
+                continue;
+            }
+            Node const& child = this->nodes[children[i]];
+            entries[num_entries].node_id = children[i];
+            entries[num_entries].key = point_box_square_dist(point,
+                child.aabb_min, child.aabb_max);
+            if (entries[num_entries].key <= best)
+                num_entries += 1;
+        }
+
+        /* Push the nearer child last to visit it first. */
+        if (num_entries == 2 && entries[1].key > entries[0].key)
+            std::swap(entries[0], entries[1]);
+        for (int i = 0; i < num_entries; ++i)
+            stack[stack_size++] = entries[i];
+    }
+
+    if (found)
+        result->dist = std::sqrt(best);
+    return found;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MeshBVH::query_box (math::Vec3f const& aabb_min,
+    math::Vec3f const& aabb_max, FaceList* result) const
+{
+    result->clear();
+    if (this->face_ids.empty())
+        return;
+
+    math::Vec3f const center = (aabb_min + aabb_max) / 2.0f;
+    math::Vec3f const halfsize = (aabb_max - aabb_min) / 2.0f;
+    auto test_face = [this, &center, &halfsize, result] (std::size_t id)
+    {
+        math::Vec3f const* tri = &this->triangles[id * 3];
+        if (math::geom::triangle_box_overlap(center, halfsize,
+            tri[0], tri[1], tri[2]))
+            result->push_back(this->face_ids[id]);
+    };
+
+    if (this->nodes.empty())
+        test_face(0);
+
+    std::uint32_t stack[MESH_BVH_STACK_SIZE];
+    int stack_size = 0;
+    if (!this->nodes.empty())
+        stack[stack_size++] = 0;
+    while (stack_size > 0)
+    {
+        Node const& node = this->nodes[stack[--stack_size]];
+        if (!math::geom::box_box_overlap(node.aabb_min, node.aabb_max,
+            aabb_min, aabb_max))
+            continue;
+
+        /* Nodes inside the query box are taken without testing. */
+        if (math::geom::point_box_overlap(node.aabb_min, aabb_min, aabb_max)
+            && math::geom::point_box_overlap(node.aabb_max,
+            aabb_min, aabb_max))
+        {
+            for (std::size_t i = node.first; i <= node.last; ++i)
+                result->push_back(this->face_ids[i]);
+            continue;
+        }
+
+        if (node.last - node.first < this->opts.max_leaf_faces)
+        {
+            for (std::size_t i = node.first; i <= node.last; ++i)
+                test_face(i);
+            continue;
+        }
+
+        std::uint32_t const children[2] = { node.left, node.right };
+        for (int i = 0; i < 2; ++i)
+        {
+            if (children[i] & LEAF_FLAG)
+                test_face(children[i] & ~LEAF_FLAG);
+            else
+                stack[stack_size++] = children[i];
+        }
+    }
+
+    std::sort(result->begin(), result->end());
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef CORE_MESH_BVH_HEADER
+#define CORE_MESH_BVH_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "math/vector.h"
+#include "core/defines.h"
+#include "core/mesh.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * Bounding volume hierarchy over the faces of a triangle mesh.
+ *
+ * The hierarchy is a linear BVH: The faces are sorted along a Morton
+ * curve through their centroids, and the binary tree is derived from the
+ * common prefixes of the sorted Morton codes. Every node covers a range
+ * of consecutive faces, and nodes with at most 'max_leaf_faces' faces are
+ * used as leaves. All build stages except the sort run in parallel.
+ *
+ * The hierarchy is a snapshot of the mesh and must be built again if the
+ * mesh changes. All queries are const and can run concurrently.
+ */
+class MeshBVH
+{
+public:
+    typedef unsigned int FaceID;
+    typedef std::vector<FaceID> FaceList;
+
+    /** Options for building the hierarchy. */
+    struct Options
+    {
+        Options (void);
+
+        /** Nodes with at most this many faces are not traversed further. */
+        std::size_t max_leaf_faces;
+    };
+
+    /** A ray with origin, direction and the valid parameter interval. */
+    struct Ray
+    {
+        Ray (void);
+        Ray (math::Vec3f const& origin, math::Vec3f const& dir);
+
+        math::Vec3f origin;
+        math::Vec3f dir;
+        float tmin;
+        float tmax;
+    };
+
+    /** The nearest intersection of a ray with the mesh. */
+    struct Hit
+    {
+        /** The ray parameter of the intersection point. */
+        float t;
+        /** The ID of the intersected face. */
+        FaceID face_id;
+        /** The barycentric coordinates of the point wrt the face. */
+        math::Vec3f bcoords;
+    };
+
+    /** The closest point on the mesh to a query point. */
+    struct Nearest
+    {
+        /** The closest point on the mesh. */
+        math::Vec3f point;
+        /** The distance from the query point. */
+        float dist;
+        /** The ID of the face the point lies on. */
+        FaceID face_id;
+    };
+
+public:
+    MeshBVH (void);
+    explicit MeshBVH (Options const& options);
+    MeshBVH (TriangleMesh::ConstPtr mesh,
+        Options const& options = Options());
+
+    /** Builds the hierarchy for the given mesh. */
+    void build (TriangleMesh::ConstPtr mesh);
+    /** Releases all memory. */
+    void clear (void);
+
+    /** Returns the number of indexed faces. */
+    std::size_t get_num_faces (void) const;
+
+    /**
+     * Finds the nearest intersection of the ray with the mesh within
+     * the ray interval. Returns false if the ray does not hit the mesh.
+     */
+    bool intersect (Ray const& ray, Hit* hit) const;
+
+    /**
+     * Returns true if the ray hits any face within the ray interval.
+     * This is faster than intersect() and sufficient for visibility tests.
+     */
+    bool occluded (Ray const& ray) const;
+
+    /**
+     * Finds the closest point on the mesh to the query point with a
+     * distance of at most 'max_dist'. Returns false if there is none.
+     */
+    bool closest_point (math::Vec3f const& point, Nearest* result,
+        float max_dist = std::numeric_limits<float>::max()) const;
+
+    /** Stores the faces overlapping the box in increasing order. */
+    void query_box (math::Vec3f const& aabb_min, math::Vec3f const& aabb_max,
+        FaceList* result) const;
+
+private:
+    struct Node
+    {
+        math::Vec3f aabb_min;
+        math::Vec3f aabb_max;
+        /* The children, with LEAF_FLAG set for single faces. */
+        std::uint32_t left;
+        std::uint32_t right;
+        /* The range of faces in the sorted order. */
+        std::uint32_t first;
+        std::uint32_t last;
+    };
+
+    static std::uint32_t const LEAF_FLAG = 0x80000000u;
+
+    bool traverse_ray (Ray const& ray, bool any_hit, Hit* hit) const;
+
+private:
+    Options opts;
+    std::vector<Node> nodes;
+    /* The face IDs and the triangle corners in the sorted order. */
+    FaceList face_ids;
+    std::vector<math::Vec3f> triangles;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+MeshBVH::Options::Options (void)
+    : max_leaf_faces(4)
+{
+}
+
+inline
+MeshBVH::Ray::Ray (void)
+    : tmin(0.0f)
+    , tmax(std::numeric_limits<float>::max())
+{
+}
+
+inline
+MeshBVH::Ray::Ray (math::Vec3f const& origin, math::Vec3f const& dir)
+    : origin(origin)
+    , dir(dir)
+    , tmin(0.0f)
+    , tmax(std::numeric_limits<float>::max())
+{
+}
+
+inline
+MeshBVH::MeshBVH (void)
+{
+}
+
+inline
+MeshBVH::MeshBVH (Options const& options)
+    : opts(options)
+{
+}
+
+inline
+MeshBVH::MeshBVH (TriangleMesh::ConstPtr mesh, Options const& options)
+    : opts(options)
+{
+    this->build(mesh);
+}
+
+inline std::size_t
+MeshBVH::get_num_faces (void) const
+{
+    return this->face_ids.size();
+}
+
+CORE_NAMESPACE_END
+
+#endif /* CORE_MESH_BVH_HEADER */
@@ -11,9 +11,9 @@
 #include <list>
 #include <set>
 
-#include "mve/mesh_info.h"
+#include "core/mesh_info.h"
 
-MVE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
 
 void
 MeshInfo::initialize (TriangleMesh::ConstPtr mesh)
@@ -180,4 +180,4 @@ MeshInfo::get_faces_for_edge (std::size_t v1, std::size_t v2,
             adjacent_faces->push_back(faces1[i]);
 }
 
-MVE_NAMESPACE_END
+CORE_NAMESPACE_END
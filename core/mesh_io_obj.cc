@@ -7,23 +7,30 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <cerrno>
+#include <cstdint>
 #include <cstring>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 #include "util/strings.h"
 #include "util/tokenizer.h"
 #include "util/exception.h"
 #include "util/file_system.h"
-#include "mve/mesh_io_obj.h"
+#include "core/mesh_io_obj.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 namespace
 {
+    /* The size of the line-aligned chunks that are parsed in parallel. */
+    std::size_t const OBJ_CHUNK_SIZE = 1 << 20;
+
     struct ObjVertex
     {
         unsigned int vertex_id;
@@ -31,7 +38,7 @@ namespace
         unsigned int normal_id;
 
         ObjVertex (void);
-        bool operator< (ObjVertex const & other) const;
+        bool operator== (ObjVertex const & other) const;
     };
 
     inline
@@ -43,12 +50,379 @@ namespace
     }
 
     inline bool
-    ObjVertex::operator< (ObjVertex const & other) const
+    ObjVertex::operator== (ObjVertex const & other) const
     {
-        return std::lexicographical_compare(&vertex_id, &normal_id + 1,
-            &other.vertex_id, &other.normal_id + 1);
+        return vertex_id == other.vertex_id
+            && texcoord_id == other.texcoord_id
+            && normal_id == other.normal_id;
     }
-}
+
+    struct ObjVertexHash
+    {
+        std::size_t operator() (ObjVertex const& v) const
+        {
+            uint64_t hash = v.vertex_id;
+            hash = hash * 0x9e3779b97f4a7c15ull + v.texcoord_id;
+            hash = hash * 0x9e3779b97f4a7c15ull + v.normal_id;
+            return static_cast<std::size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    /* A line other than geometry, replayed in file order when stitching. */
+    struct ObjStatement
+    {
+        enum Type
+        {
+            OBJ_COMMENT,
+            OBJ_USEMTL,
+            OBJ_MTLLIB,
+            OBJ_UNSUPPORTED,
+            OBJ_ERROR
+        };
+
+        Type type;
+        /* The amount of face vertices of the chunk before the statement. */
+        std::size_t face_pos;
+        std::string text;
+    };
+
+    /* The parse result of a line-aligned part of the file. */
+    struct ObjChunk
+    {
+        char const* begin;
+        char const* end;
+        std::size_t first_vertex;
+        std::size_t first_texcoord;
+        std::size_t first_normal;
+        std::size_t num_vertices;
+        std::size_t num_texcoords;
+        std::size_t num_normals;
+        std::vector<ObjVertex> face_vertices;
+        std::vector<ObjStatement> statements;
+    };
+
+    inline bool
+    is_blank (char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    /* Extracts the next line with blanks and newlines clipped. */
+    inline bool
+    next_line (char const** pos, char const* end,
+        char const** line_begin, char const** line_end)
+    {
+        if (*pos >= end)
+            return false;
+        char const* eol = static_cast<char const*>
+            (std::memchr(*pos, '\n', end - *pos));
+        char const* b = *pos;
+        char const* e = eol == nullptr ? end : eol;
+        *pos = eol == nullptr ? end : eol + 1;
+        while (e > b && (is_blank(e[-1]) || e[-1] == '\r'))
+            e -= 1;
+        while (b < e && is_blank(*b))
+            b += 1;
+        *line_begin = b;
+        *line_end = e;
+        return true;
+    }
+
+    /* Returns the first blank-separated token of a line. */
+    inline std::string
+    first_token (char const* begin, char const* end)
+    {
+        char const* e = begin;
+        while (e < end && !is_blank(*e))
+            e += 1;
+        return std::string(begin, e);
+    }
+
+    /* Returns the amount of chars of the keyword or 0 if it does not match. */
+    inline std::size_t
+    match_keyword (char const* begin, char const* end, char const* keyword)
+    {
+        std::size_t const len = std::strlen(keyword);
+        if (static_cast<std::size_t>(end - begin) < len
+            || std::memcmp(begin, keyword, len) != 0)
+            return 0;
+        if (begin + len != end && !is_blank(begin[len]))
+            return 0;
+        return len;
+    }
+
+    /* Parses all blank-separated floats, returns -1 on more than 'max'. */
+    int
+    parse_floats (char const* str, char const* end, float* values, int max)
+    {
+        int num = 0;
+        while (true)
+        {
+            while (str < end && is_blank(*str))
+                str += 1;
+            if (str == end)
+                return num;
+            if (num == max)
+                return -1;
+            str = util::string::parse_float(str, values + num);
+            if (str == nullptr || str > end || (str < end && !is_blank(*str)))
+                return -1;
+            num += 1;
+        }
+    }
+
+    /* Parses an index of a face vertex, defaults to 0 if empty. */
+    inline char const*
+    parse_face_index (char const* str, char const* end, unsigned int* index)
+    {
+        *index = 0;
+        if (str == end || is_blank(*str) || *str == '/')
+            return str;
+        str = util::string::parse_uint(str, index);
+        if (str == nullptr || str > end || *index == 0)
+            return nullptr;
+        return str;
+    }
+
+    /*
+     * Parses a face vertex in the forms 'v', 'v/vt', 'v/vt/vn' or 'v//vn'
+     * and returns the position after it, or nullptr on error.
+     */
+    char const*
+    parse_face_vertex (char const* str, char const* end, ObjVertex* v)
+    {
+        if (str == end || *str == '/')
+            return nullptr;
+        str = parse_face_index(str, end, &v->vertex_id);
+        if (str != nullptr && str < end && *str == '/')
+            str = parse_face_index(str + 1, end, &v->texcoord_id);
+        if (str != nullptr && str < end && *str == '/')
+            str = parse_face_index(str + 1, end, &v->normal_id);
+        if (str != nullptr && str < end && !is_blank(*str))
+            return nullptr;
+        return str;
+    }
+
+    /* Counts the geometry lines of a chunk. */
+    void
+    count_obj_chunk (ObjChunk* chunk)
+    {
+        chunk->num_vertices = 0;
+        chunk->num_texcoords = 0;
+        chunk->num_normals = 0;
+
+        char const* pos = chunk->begin;
+        char const* begin;
+        char const* end;
+        while (next_line(&pos, chunk->end, &begin, &end))
+        {
+            if (match_keyword(begin, end, "v"))
+                chunk->num_vertices += 1;
+            else if (match_keyword(begin, end, "vt"))
+                chunk->num_texcoords += 1;
+            else if (match_keyword(begin, end, "vn"))
+                chunk->num_normals += 1;
+        }
+    }
+
+    /*
+     * Parses a chunk into the global geometry at the chunk offsets. Faces
+     * are validated against the geometry up to their line. Parsing stops
+     * at the first error, which is recorded as statement.
+     */
+    void
+    parse_obj_chunk (ObjChunk* chunk,
+        std::vector<math::Vec3f>* global_vertices,
+        std::vector<math::Vec2f>* global_texcoords,
+        std::vector<math::Vec3f>* global_normals)
+    {
+        std::size_t num_vertices = chunk->first_vertex;
+        std::size_t num_texcoords = chunk->first_texcoord;
+        std::size_t num_normals = chunk->first_normal;
+
+        char const* pos = chunk->begin;
+        char const* begin;
+        char const* end;
+        while (next_line(&pos, chunk->end, &begin, &end))
+        {
+            if (begin == end)
+                continue;
+
+            ObjStatement statement;
+            statement.face_pos = chunk->face_vertices.size();
+
+            if (*begin == '#')
+            {
+                /* Comments are printed to STDOUT. */
+                statement.type = ObjStatement::OBJ_COMMENT;
+                statement.text.assign(begin, end);
+                chunk->statements.push_back(statement);
+                continue;
+            }
+
+            std::size_t len;
+            float values[4];
+            if ((len = match_keyword(begin, end, "v")) != 0)
+            {
+                int const num = parse_floats(begin + len, end, values, 4);
+                if (num != 3 && num != 4)
+                {
+                    statement.type = ObjStatement::OBJ_ERROR;
+                    statement.text = "Invalid vertex coordinate specification";
+                    chunk->statements.push_back(statement);
+                    return;
+                }
+
+                math::Vec3f vertex(values);
+                /* Convert homogeneous coordinates. */
+                if (num == 4)
+                    vertex /= values[3];
+                global_vertices->at(num_vertices++) = vertex;
+            }
+            else if ((len = match_keyword(begin, end, "vt")) != 0)
+            {
+                int const num = parse_floats(begin + len, end, values, 3);
+                if (num != 2 && num != 3)
+                {
+                    statement.type = ObjStatement::OBJ_ERROR;
+                    statement.text = "Invalid texture coords specification";
+                    chunk->statements.push_back(statement);
+                    return;
+                }
+
+                math::Vec2f texcoord(values);
+                /* Convert homogeneous coordinates. */
+                if (num == 3)
+                    texcoord /= values[2];
+                /* Invert y coordinate */
+                texcoord[1] = 1.0f - texcoord[1];
+                global_texcoords->at(num_texcoords++) = texcoord;
+            }
+            else if ((len = match_keyword(begin, end, "vn")) != 0)
+            {
+                int const num = parse_floats(begin + len, end, values, 4);
+                if (num != 3 && num != 4)
+                {
+                    statement.type = ObjStatement::OBJ_ERROR;
+                    statement.text = "Invalid vertex normal specification";
+                    chunk->statements.push_back(statement);
+                    return;
+                }
+
+                math::Vec3f normal(values);
+                /* Convert homogeneous coordinates. */
+                if (num == 4)
+                    normal /= values[3];
+                global_normals->at(num_normals++) = normal;
+            }
+            else if ((len = match_keyword(begin, end, "f")) != 0)
+            {
+                char const* str = begin + len;
+                ObjVertex face[3];
+                int num = 0;
+                bool valid = true;
+                while (valid)
+                {
+                    while (str < end && is_blank(*str))
+                        str += 1;
+                    if (str == end)
+                        break;
+                    if (num == 3)
+                    {
+                        num += 1;
+                        break;
+                    }
+                    str = parse_face_vertex(str, end, face + num);
+                    valid = (str != nullptr);
+                    num += 1;
+                }
+
+                if (valid && num != 3)
+                {
+                    statement.type = ObjStatement::OBJ_ERROR;
+                    statement.text = "Only triangles supported";
+                    chunk->statements.push_back(statement);
+                    return;
+                }
+
+                for (int i = 0; valid && i < 3; ++i)
+                    valid = face[i].vertex_id <= num_vertices
+                        && face[i].texcoord_id <= num_texcoords
+                        && face[i].normal_id <= num_normals;
+                if (!valid)
+                {
+                    statement.type = ObjStatement::OBJ_ERROR;
+                    statement.text = "Invalid index in: "
+                        + std::string(begin, end);
+                    chunk->statements.push_back(statement);
+                    return;
+                }
+
+                chunk->face_vertices.insert(chunk->face_vertices.end(),
+                    face, face + 3);
+            }
+            else
+            {
+                bool const usemtl = match_keyword(begin, end, "usemtl") != 0;
+                bool const mtllib = match_keyword(begin, end, "mtllib") != 0;
+                util::ViewTokenizer line;
+                line.split(util::StringView(begin, end - begin));
+                if (usemtl || mtllib)
+                {
+                    statement.type = usemtl ? ObjStatement::OBJ_USEMTL
+                        : ObjStatement::OBJ_MTLLIB;
+                    if (line.size() != 2)
+                    {
+                        statement.type = ObjStatement::OBJ_ERROR;
+                        statement.text = usemtl
+                            ? "Invalid usemtl specification"
+                            : "Invalid material library specification";
+                        chunk->statements.push_back(statement);
+                        return;
+                    }
+                    statement.text = line[1].to_string();
+                }
+                else
+                {
+                    statement.type = ObjStatement::OBJ_UNSUPPORTED;
+                    statement.text = first_token(begin, end);
+                }
+                chunk->statements.push_back(statement);
+            }
+        }
+    }
+
+    /* Moves the current part into the list of parts and starts a new one. */
+    void
+    finish_obj_part (core::TriangleMesh::Ptr mesh,
+        std::string const& texture_filename,
+        std::vector<ObjModelPart>* obj_model_parts)
+    {
+        core::TriangleMesh::VertexList& vertices = mesh->get_vertices();
+        core::TriangleMesh::NormalList& normals = mesh->get_vertex_normals();
+        core::TriangleMesh::TexCoordList& texcoords
+            = mesh->get_vertex_texcoords();
+
+        if (!texcoords.empty() && texcoords.size() != vertices.size())
+            throw util::Exception("Invalid number of texture coords");
+        if (!normals.empty() && normals.size() != vertices.size())
+            throw util::Exception("Invalid number of vertex normals");
+
+        if (!vertices.empty())
+        {
+            ObjModelPart obj_model_part;
+            obj_model_part.mesh = core::TriangleMesh::create();
+            std::swap(vertices, obj_model_part.mesh->get_vertices());
+            std::swap(texcoords, obj_model_part.mesh->get_vertex_texcoords());
+            std::swap(normals, obj_model_part.mesh->get_vertex_normals());
+            std::swap(mesh->get_faces(), obj_model_part.mesh->get_faces());
+            obj_model_part.texture_filename = texture_filename;
+            obj_model_parts->push_back(obj_model_part);
+        }
+
+        mesh->clear();
+    }
+}  /* namespace */
 
 void
 load_mtl_file (std::string const& filename,
@@ -114,7 +488,7 @@ load_mtl_file (std::string const& filename,
     input.close();
 }
 
-mve::TriangleMesh::Ptr
+core::TriangleMesh::Ptr
 load_obj_mesh (std::string const& filename)
 {
     std::vector<ObjModelPart> obj_model_parts;
@@ -134,187 +508,134 @@ load_obj_mesh (std::string const& filename,
     if (filename.empty())
         throw std::invalid_argument("No filename given");
 
-    /* Open file. */
-    std::ifstream input(filename.c_str(), std::ios::binary);
-    if (!input.good())
-        throw util::FileException(filename, std::strerror(errno));
-
-    std::vector<math::Vec3f> global_vertices;
-    std::vector<math::Vec3f> global_normals;
-    std::vector<math::Vec2f> global_texcoords;
-    std::map<std::string, std::string> materials;
-
-    mve::TriangleMesh::Ptr mesh = mve::TriangleMesh::create();
-    mve::TriangleMesh::VertexList& vertices = mesh->get_vertices();
-    mve::TriangleMesh::NormalList& normals = mesh->get_vertex_normals();
-    mve::TriangleMesh::TexCoordList& texcoords = mesh->get_vertex_texcoords();
-    mve::TriangleMesh::FaceList& faces = mesh->get_faces();
+    /* Read the whole file, the string is terminated for the parser. */
+    std::string data;
+    util::fs::read_file_to_string(filename, &data);
 
-    typedef std::map<ObjVertex, unsigned int> VertexIndexMap;
-    VertexIndexMap vertex_map;
-    std::string material_name;
-    std::string new_material_name;
-    std::string buffer;
-    while (input.good())
+    /* Split the file into line-aligned chunks. */
+    std::vector<ObjChunk> chunks;
+    char const* const file_end = data.data() + data.size();
+    for (char const* pos = data.data(); pos < file_end;)
     {
-        std::getline(input, buffer);
-        util::string::clip_newlines(&buffer);
-        util::string::clip_whitespaces(&buffer);
-
-        if (input.eof() || !new_material_name.empty())
+        ObjChunk chunk;
+        chunk.begin = pos;
+        chunk.end = pos + std::min<std::size_t>(OBJ_CHUNK_SIZE,
+            file_end - pos);
+        if (chunk.end < file_end)
         {
-            if (!texcoords.empty() && texcoords.size() != vertices.size())
-                throw util::Exception("Invalid number of texture coords");
-            if (!normals.empty() && normals.size() != vertices.size())
-                throw util::Exception("Invalid number of vertex normals");
-
-            if (!vertices.empty())
-            {
-                ObjModelPart obj_model_part;
-                obj_model_part.mesh = mve::TriangleMesh::create();
-                std::swap(vertices, obj_model_part.mesh->get_vertices());
-                std::swap(texcoords, obj_model_part.mesh->get_vertex_texcoords());
-                std::swap(normals, obj_model_part.mesh->get_vertex_normals());
-                std::swap(faces, obj_model_part.mesh->get_faces());
-                obj_model_part.texture_filename = materials[material_name];
-                obj_model_parts->push_back(obj_model_part);
-            }
-
-            mesh->clear();
-            vertex_map.clear();
-
-            material_name.swap(new_material_name);
-            new_material_name.clear();
+            char const* eol = static_cast<char const*>
+                (std::memchr(chunk.end, '\n', file_end - chunk.end));
+            chunk.end = eol == nullptr ? file_end : eol + 1;
         }
+        pos = chunk.end;
+        chunks.push_back(chunk);
+    }
 
-        if (buffer.empty())
-            continue;
-        if (input.eof())
-            break;
-
-        if (buffer[0] == '#')
-        {
-            /* Print all comments to STDOUT and forget data. */
-            std::cout << "OBJ Loader: " << buffer << std::endl;
-            continue;
-        }
-
-        util::Tokenizer line;
-        line.split(buffer);
-
-        if (line[0] == "v")
-        {
-            if (line.size() != 4 && line.size() != 5)
-                throw util::Exception("Invalid vertex coordinate specification");
-
-            math::Vec3f vertex(0.0f);
-            for (int i = 0; i < 3; ++i)
-                vertex[i] = util::string::convert<float>(line[1 + i]);
-
-            /* Convert homogeneous coordinates. */
-            if (line.size() == 5)
-                vertex /= util::string::convert<float>(line[4]);
-
-            global_vertices.push_back(vertex);
-        }
-        else if (line[0] == "vt")
-        {
-            if (line.size() != 3 && line.size() != 4)
-                throw util::Exception("Invalid texture coords specification");
-
-            math::Vec2f texcoord(0.0f);
-            for (int i = 0; i < 2; ++i)
-                texcoord[i] = util::string::convert<float>(line[1 + i]);
-
-            /* Convert homogeneous coordinates. */
-            if (line.size() == 4)
-                texcoord /= util::string::convert<float>(line[3]);
-
-            /* Invert y coordinate */
-            texcoord[1] = 1.0f - texcoord[1];
+    /* Count the geometry to place all chunks in the global lists. */
+    std::int64_t const num_chunks = chunks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_chunks; ++i)
+        count_obj_chunk(&chunks[i]);
 
-            global_texcoords.push_back(texcoord);
-        }
-        else if (line[0] == "vn")
-        {
-            if (line.size() != 4 && line.size() != 5)
-                util::Exception("Invalid vertex normal specification");
+    std::size_t num_vertices = 0;
+    std::size_t num_texcoords = 0;
+    std::size_t num_normals = 0;
+    for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].first_vertex = num_vertices;
+        chunks[i].first_texcoord = num_texcoords;
+        chunks[i].first_normal = num_normals;
+        num_vertices += chunks[i].num_vertices;
+        num_texcoords += chunks[i].num_texcoords;
+        num_normals += chunks[i].num_normals;
+    }
 
-            math::Vec3f normal(0.0f);
-            for (int i = 0; i < 3; ++i)
-                normal[i] = util::string::convert<float>(line[1 + i]);
+    std::vector<math::Vec3f> global_vertices(num_vertices);
+    std::vector<math::Vec3f> global_normals(num_normals);
+    std::vector<math::Vec2f> global_texcoords(num_texcoords);
 
-            /* Convert homogeneous coordinates. */
-            if (line.size() == 5)
-                normal /= util::string::convert<float>(line[4]);
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_chunks; ++i)
+        parse_obj_chunk(&chunks[i], &global_vertices,
+            &global_texcoords, &global_normals);
 
-            global_normals.push_back(normal);
-        }
-        else if (line[0] == "f")
+    /* Stitch the faces and statements of all chunks in file order. */
+    std::map<std::string, std::string> materials;
+    core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+    core::TriangleMesh::VertexList& vertices = mesh->get_vertices();
+    core::TriangleMesh::NormalList& normals = mesh->get_vertex_normals();
+    core::TriangleMesh::TexCoordList& texcoords = mesh->get_vertex_texcoords();
+    core::TriangleMesh::FaceList& faces = mesh->get_faces();
+
+    typedef std::unordered_map<ObjVertex, unsigned int, ObjVertexHash>
+        VertexIndexMap;
+    VertexIndexMap vertex_map;
+    std::string material_name;
+    for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        ObjChunk& chunk = chunks[i];
+        std::size_t face_pos = 0;
+        for (std::size_t j = 0; j <= chunk.statements.size(); ++j)
         {
-            if (line.size() != 4)
-                throw util::Exception("Only triangles supported");
-
-            for (int i = 0; i < 3; ++i)
+            std::size_t const face_end = j < chunk.statements.size()
+                ? chunk.statements[j].face_pos : chunk.face_vertices.size();
+            for (; face_pos < face_end; ++face_pos)
             {
-                util::Tokenizer tok;
-                tok.split(line[1 + i], '/');
-
-                if (tok.size() > 3)
-                    throw util::Exception("Invalid face specification");
-
-                ObjVertex v;
-                v.vertex_id = util::string::convert<unsigned int>(tok[0]);
-                if (tok.size() > 2 && !tok[1].empty())
-                    v.texcoord_id = util::string::convert<unsigned int>(tok[1]);
-                if (tok.size() == 3 && !tok[2].empty())
-                    v.normal_id = util::string::convert<unsigned int>(tok[2]);
-
-                if (v.vertex_id > global_vertices.size()
-                    || v.texcoord_id > global_texcoords.size()
-                    || v.normal_id > global_normals.size())
-                    throw util::Exception("Invalid index in: " + buffer);
-
-                VertexIndexMap::const_iterator iter = vertex_map.find(v);
-                if (iter != vertex_map.end())
-                {
-                    faces.push_back(iter->second);
-                }
-                else
+                ObjVertex const& v = chunk.face_vertices[face_pos];
+                std::pair<VertexIndexMap::iterator, bool> iter
+                    = vertex_map.insert(std::make_pair(v, vertices.size()));
+                if (iter.second)
                 {
                     vertices.push_back(global_vertices[v.vertex_id - 1]);
                     if (v.texcoord_id != 0)
-                        texcoords.push_back(global_texcoords[v.texcoord_id - 1]);
+                        texcoords.push_back
+                            (global_texcoords[v.texcoord_id - 1]);
                     if (v.normal_id != 0)
                         normals.push_back(global_normals[v.normal_id - 1]);
-                    faces.push_back(vertices.size() - 1);
-                    vertex_map[v] = vertices.size() - 1;
                 }
+                faces.push_back(iter.first->second);
             }
-        }
-        else if (line[0] == "usemtl")
-        {
-            if (line.size() != 2)
-                throw util::Exception("Invalid usemtl specification");
-            new_material_name = line[1];
-        }
-        else if (line[0] == "mtllib")
-        {
-            if (line.size() != 2)
-                throw util::Exception("Invalid material library specification");
+            if (j == chunk.statements.size())
+                break;
 
-            std::string dir = util::fs::dirname(filename);
-            load_mtl_file(util::fs::join_path(dir, line[1]), &materials);
-        }
-        else
-        {
-            std::cout << "OBJ Loader: Skipping unsupported element: "
-                << line[0] << std::endl;
+            ObjStatement const& statement = chunk.statements[j];
+            switch (statement.type)
+            {
+                case ObjStatement::OBJ_COMMENT:
+                    std::cout << "OBJ Loader: " << statement.text << std::endl;
+                    break;
+
+                case ObjStatement::OBJ_USEMTL:
+                    finish_obj_part(mesh, materials[material_name],
+                        obj_model_parts);
+                    vertex_map.clear();
+                    material_name = statement.text;
+                    break;
+
+                case ObjStatement::OBJ_MTLLIB:
+                {
+                    std::string dir = util::fs::dirname(filename);
+                    load_mtl_file(util::fs::join_path(dir, statement.text),
+                        &materials);
+                    break;
+                }
+
+                case ObjStatement::OBJ_UNSUPPORTED:
+                    std::cout << "OBJ Loader: Skipping unsupported element: "
+                        << statement.text << std::endl;
+                    break;
+
+                case ObjStatement::OBJ_ERROR:
+                default:
+                    throw util::Exception(statement.text);
+            }
         }
+
+        /* Release the memory of stitched chunks early. */
+        std::vector<ObjVertex>().swap(chunk.face_vertices);
     }
 
-    /* Close the file stream. */
-    input.close();
+    finish_obj_part(mesh, materials[material_name], obj_model_parts);
 }
 
 void
@@ -325,8 +646,8 @@ save_obj_mesh (TriangleMesh::ConstPtr mesh, std::string const& filename)
     if (filename.empty())
         throw std::invalid_argument("No filename given");
 
-    mve::TriangleMesh::VertexList const& verts(mesh->get_vertices());
-    mve::TriangleMesh::FaceList const& faces(mesh->get_faces());
+    core::TriangleMesh::VertexList const& verts(mesh->get_vertices());
+    core::TriangleMesh::FaceList const& faces(mesh->get_faces());
 
     if (faces.size() % 3 != 0)
         throw std::invalid_argument("Triangle indices not divisible by 3");
@@ -354,5 +675,5 @@ save_obj_mesh (TriangleMesh::ConstPtr mesh, std::string const& filename)
     out.close();
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
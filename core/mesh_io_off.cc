@@ -7,19 +7,101 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
+#include <cstdint>
 #include <cstring>
 #include <cerrno>
+#include <vector>
 
 #include "math/vector.h"
 #include "util/exception.h"
-#include "mve/mesh_io_off.h"
+#include "util/file_system.h"
+#include "util/strings.h"
+#include "core/mesh_io_off.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
+
+namespace
+{
+    /* The size of the chunks that are parsed in parallel. */
+    std::size_t const OFF_CHUNK_SIZE = 1 << 20;
+
+    /* A part of the file that starts and ends at whitespace. */
+    struct OffChunk
+    {
+        char const* begin;
+        char const* end;
+        std::size_t first_token;
+        std::size_t num_tokens;
+    };
+
+    inline bool
+    is_space (char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+            || c == '\v' || c == '\f';
+    }
+
+    inline char const*
+    skip_spaces (char const* str, char const* end)
+    {
+        while (str < end && is_space(*str))
+            str += 1;
+        return str;
+    }
+
+    inline char const*
+    skip_token (char const* str, char const* end)
+    {
+        while (str < end && !is_space(*str))
+            str += 1;
+        return str;
+    }
+
+    void
+    count_off_chunk (OffChunk* chunk)
+    {
+        chunk->num_tokens = 0;
+        char const* str = skip_spaces(chunk->begin, chunk->end);
+        while (str < chunk->end)
+        {
+            chunk->num_tokens += 1;
+            str = skip_spaces(skip_token(str, chunk->end), chunk->end);
+        }
+    }
+
+    /*
+     * Parses the tokens of a chunk. The first 'num_values' tokens of the
+     * file body are vertex values, all others are face tokens. Returns
+     * false if a token is not a number.
+     */
+    bool
+    parse_off_chunk (OffChunk const& chunk, std::size_t num_values,
+        float* values, unsigned int* face_tokens)
+    {
+        std::size_t token = chunk.first_token;
+        char const* str = skip_spaces(chunk.begin, chunk.end);
+        while (str < chunk.end)
+        {
+            char const* next = token < num_values
+                ? util::string::parse_float(str, values + token)
+                : util::string::parse_uint(str,
+                face_tokens + token - num_values);
+            if (next == nullptr || (next < chunk.end && !is_space(*next)))
+                return false;
+            token += 1;
+            str = skip_spaces(next, chunk.end);
+        }
+        return true;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
 
 TriangleMesh::Ptr
 load_off_mesh (std::string const& filename)
@@ -27,130 +109,138 @@ load_off_mesh (std::string const& filename)
     if (filename.empty())
         throw std::invalid_argument("No filename given");
 
-    /* Open file. */
-    std::fstream input(filename.c_str());
-    if (input.fail())
-        throw util::FileException(filename, std::strerror(errno));
+    /* Read the whole file, the string is terminated for the parser. */
+    std::string data;
+    util::fs::read_file_to_string(filename, &data);
+    char const* str = data.data();
+    char const* const file_end = data.data() + data.size();
 
-    /* Start parsing. */
-    std::string buffer;
+    /* Read "OFF" file signature. */
     bool parse_normals = false;
+    str = skip_spaces(str, file_end);
+    char const* token_end = skip_token(str, file_end);
+    std::string const signature(str, token_end);
+    if (signature == "NOFF")
+        parse_normals = true;
+    else if (signature != "OFF")
+        throw util::Exception("File not recognized as OFF model");
 
-    /* Read "OFF" file signature. */
-    input >> buffer;
-    if (buffer == "NOFF")
+    /* Read vertex, face and edge information. */
+    unsigned int counts[3] = { 0, 0, 0 };
+    str = token_end;
+    for (int i = 0; i < 3 && str != nullptr; ++i)
+        str = util::string::parse_uint(skip_spaces(str, file_end), counts + i);
+    if (str == nullptr || (str < file_end && !is_space(*str)))
+        throw util::Exception("Invalid OFF header");
+    std::size_t const num_vertices = counts[0];
+    std::size_t const num_faces = counts[1];
+
+    /* Split the body into chunks that end at whitespace. */
+    std::vector<OffChunk> chunks;
+    while (str < file_end)
     {
-        parse_normals = true;
+        OffChunk chunk;
+        chunk.begin = str;
+        chunk.end = str + std::min<std::size_t>(OFF_CHUNK_SIZE, file_end - str);
+        while (chunk.end < file_end && !is_space(*chunk.end))
+            chunk.end += 1;
+        str = chunk.end;
+        chunks.push_back(chunk);
     }
-    else if (buffer != "OFF")
+
+    std::int64_t const num_chunks = chunks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_chunks; ++i)
+        count_off_chunk(&chunks[i]);
+
+    std::size_t num_tokens = 0;
+    for (std::size_t i = 0; i < chunks.size(); ++i)
     {
-        input.close();
-        throw util::Exception("File not recognized as OFF model");
+        chunks[i].first_token = num_tokens;
+        num_tokens += chunks[i].num_tokens;
     }
 
+    std::size_t const values_per_vertex = parse_normals ? 6 : 3;
+    std::size_t const num_values = num_vertices * values_per_vertex;
+    if (num_tokens < num_values)
+        throw util::Exception("Unexpected end of OFF file");
+
+    /* Parse vertex values and face tokens in parallel. */
+    std::vector<float> values(num_values);
+    std::vector<unsigned int> face_tokens(num_tokens - num_values);
+    bool parse_error = false;
+#pragma omp parallel for schedule(dynamic) reduction(||:parse_error)
+    for (std::int64_t i = 0; i < num_chunks; ++i)
+        if (!parse_off_chunk(chunks[i], num_values,
+            values.data(), face_tokens.data()))
+            parse_error = true;
+    if (parse_error)
+        throw util::Exception("Invalid number in OFF file");
+
     /* Create a new triangle mesh. */
     TriangleMesh::Ptr mesh = TriangleMesh::create();
     TriangleMesh::VertexList& vertices = mesh->get_vertices();
     TriangleMesh::FaceList& faces = mesh->get_faces();
     TriangleMesh::NormalList& vertex_normals = mesh->get_vertex_normals();
 
-    /* Clear the model data and init some values. */
-    std::size_t num_vertices = 0;
-    std::size_t num_faces = 0;
-    std::size_t num_edges = 0;
-
-    /* Read vertex, face and edge information. */
-    input >> num_vertices >> num_faces >> num_edges;
-
-    vertices.reserve(num_vertices);
-    faces.reserve(num_faces * 3);
-    vertex_normals.reserve(num_vertices);
-
-    /* Read vertices. */
+    vertices.resize(num_vertices);
+    if (parse_normals)
+        vertex_normals.resize(num_vertices);
     for (std::size_t i = 0; i < num_vertices; ++i)
     {
-        float x, y, z;
-        input >> x >> y >> z;
-        vertices.push_back(math::Vec3f(x, y, z));
+        float const* value = &values[i * values_per_vertex];
+        vertices[i] = math::Vec3f(value);
 
         /* Also read vertex normals if present. */
         if (parse_normals)
-        {
-            input >> x >> y >> z;
-            vertex_normals.push_back(math::Vec3f(x, y, z));
-        }
+            vertex_normals[i] = math::Vec3f(value + 3);
     }
+    std::vector<float>().swap(values);
 
     /* Read faces. */
+    faces.reserve(num_faces * 3);
+    std::size_t pos = 0;
     for (std::size_t i = 0; i < num_faces; ++i)
     {
-        std::size_t n_vertices;
-        input >> n_vertices;
-
-        if (n_vertices == 3)
-        {
-            /* Polygon is a triangle. */
-            unsigned int vidx[3];
-            bool indices_good = true;
-            for (int j = 0; j < 3; ++j)
-            {
-                input >> vidx[j];
-                if (vidx[j] >= num_vertices)
-                {
-                    std::cout << "OFF Loader: Warning: Face " << i
-                        << " has invalid vertex " << vidx[j]
-                        << ", skipping face." << std::endl;
-                    indices_good = false;
-                }
-            }
-
-            if (indices_good)
-                for (int j = 0; j < 3; ++j)
-                    faces.push_back(vidx[j]);
-        }
-        else if (n_vertices == 4)
-        {
-            /* Polygon is a quad and converted to 2 triangles. */
-            unsigned int vidx[4];
-            bool indices_good = true;
-            for (int j = 0; j < 4; ++j)
-            {
-                input >> vidx[j];
-                if (vidx[j] >= num_vertices)
-                {
-                    std::cout << "OFF Loader: Warning: Face " << i
-                        << " has invalid vertex " << vidx[j]
-                        << ", skipping face." << std::endl;
-                    indices_good = false;
-                }
-            }
+        if (pos >= face_tokens.size())
+            throw util::Exception("Unexpected end of OFF file");
+        std::size_t const n_vertices = face_tokens[pos++];
+        if (n_vertices > face_tokens.size() - pos)
+            throw util::Exception("Unexpected end of OFF file");
+        unsigned int const* vidx = &face_tokens[pos];
+        pos += n_vertices;
 
-            if (indices_good)
-            {
-                for (int j = 0; j < 3; ++j)
-                    faces.push_back(vidx[j]);
-                for (int j = 0; j < 3; ++j)
-                    faces.push_back(vidx[(j + 2) % 4]);
-            }
-        }
-        else
+        if (n_vertices != 3 && n_vertices != 4)
         {
             std::cout << "Warning: Line " << (2 + num_vertices + i)
                 << ": Polygon with " << n_vertices << "vertices, "
                 << "Skipping face!" << std::endl;
+            continue;
+        }
 
-            for (std::size_t j = 0; j < n_vertices; ++j)
+        bool indices_good = true;
+        for (std::size_t j = 0; j < n_vertices; ++j)
+        {
+            if (vidx[j] >= num_vertices)
             {
-                float tmp;
-                input >> tmp;
+                std::cout << "OFF Loader: Warning: Face " << i
+                    << " has invalid vertex " << vidx[j]
+                    << ", skipping face." << std::endl;
+                indices_good = false;
             }
         }
-    }
+        if (!indices_good)
+            continue;
 
-  /* Close file stream. */
-  input.close();
+        /* A polygon is a triangle or a quad converted to 2 triangles. */
+        for (int j = 0; j < 3; ++j)
+            faces.push_back(vidx[j]);
+        if (n_vertices == 4)
+            for (int j = 0; j < 3; ++j)
+                faces.push_back(vidx[(j + 2) % 4]);
+    }
 
-  return mesh;
+    return mesh;
 }
 
 /* ---------------------------------------------------------------- */
@@ -200,5 +290,5 @@ save_off_mesh (TriangleMesh::ConstPtr mesh, std::string const& filename)
     out.close();
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
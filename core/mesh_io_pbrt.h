@@ -7,13 +7,13 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_PBRTFILE_HEADER
-#define MVE_PBRTFILE_HEADER
+#ifndef CORE_PBRTFILE_HEADER
+#define CORE_PBRTFILE_HEADER
 
-#include "mve/mesh.h"
+#include "core/mesh.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * Saves a PBRT compatible mesh from a triangle mesh.
@@ -21,7 +21,7 @@ MVE_GEOM_NAMESPACE_BEGIN
 void
 save_pbrt_mesh (TriangleMesh::ConstPtr mesh, std::string const& filename);
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_PBRTFILE_HEADER */
+#endif /* CORE_PBRTFILE_HEADER */
@@ -10,37 +10,75 @@
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
+#include <cctype>
 #include <cstring>
 #include <cerrno>
+#include <cstdint>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
 
+#include "util/binary_io.h"
 #include "util/exception.h"
+#include "util/strings.h"
 #include "util/tokenizer.h"
+#include "util/file_system.h"
 #include "math/vector.h"
 #include "math/matrix.h"
-#include "mve/depthmap.h"
-#include "mve/mesh_io_ply.h"
+#include "core/depthmap.h"
+#include "core/mesh_io_ply.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
+
+namespace
+{
+    /*
+     * Reads a whitespace delimited ASCII number, which avoids the locale
+     * machinery of operator>>. Like operator>>, reaching the end of the
+     * file sets the end of file state, and failures return zero.
+     */
+    template <typename T>
+    T
+    ply_read_ascii (util::BinaryReader& input)
+    {
+        int chr = input.peek();
+        while (chr != EOF && std::isspace(chr))
+        {
+            input.get();
+            chr = input.peek();
+        }
+
+        char token[64];
+        std::size_t len = 0;
+        while (chr != EOF && !std::isspace(chr) && len < sizeof(token))
+        {
+            token[len++] = static_cast<char>(input.get());
+            chr = input.peek();
+        }
+
+        T value = T();
+        if (util::string::parse_number(token, token + len, &value)
+            != token + len)
+            return T();
+        return value;
+    }
+}  /* namespace */
 
 template <typename T>
 T
-ply_read_value (std::istream& input, PLYFormat format)
+ply_read_value (util::BinaryReader& input, PLYFormat format)
 {
-    T value;
     switch (format)
     {
         case PLY_ASCII:
-            input >> value;
-            return value;
+            return ply_read_ascii<T>(input);
 
         case PLY_BINARY_LE:
-            input.read(reinterpret_cast<char*>(&value), sizeof(T));
-            return util::system::letoh(value);
+            return input.read_value<T>(util::BYTE_ORDER_LITTLE_ENDIAN);
 
         case PLY_BINARY_BE:
-            input.read(reinterpret_cast<char*>(&value), sizeof(T));
-            return util::system::betoh(value);
+            return input.read_value<T>(util::BYTE_ORDER_BIG_ENDIAN);
 
         default:
             throw std::invalid_argument("Invalid data format");
@@ -53,24 +91,16 @@ ply_read_value (std::istream& input, PLYFormat format)
  */
 template <>
 unsigned char
-ply_read_value<unsigned char> (std::istream& input, PLYFormat format)
+ply_read_value<unsigned char> (util::BinaryReader& input, PLYFormat format)
 {
     switch (format)
     {
         case PLY_ASCII:
-        {
-            int temp;
-            input >> temp;
-            return static_cast<unsigned char>(temp);
-        }
+            return static_cast<unsigned char>(ply_read_ascii<int>(input));
 
         case PLY_BINARY_LE:
         case PLY_BINARY_BE:
-        {
-            unsigned char value;
-            input.read(reinterpret_cast<char*>(&value), 1);
-            return value;
-        }
+            return input.read_value<unsigned char>();
 
         default:
             throw std::invalid_argument("Invalid data format");
@@ -80,27 +110,27 @@ ply_read_value<unsigned char> (std::istream& input, PLYFormat format)
 /* Declare specialization for 'char' but leave it undefined for now. */
 template <>
 char
-ply_read_value<char> (std::istream& input, PLYFormat format);
+ply_read_value<char> (util::BinaryReader& input, PLYFormat format);
 
 /* Explicit template instantiation for 'float'. */
 template
 float
-ply_read_value<float> (std::istream& input, PLYFormat format);
+ply_read_value<float> (util::BinaryReader& input, PLYFormat format);
 
 /* Explicit template instantiation for 'double'. */
 template
 double
-ply_read_value<double> (std::istream& input, PLYFormat format);
+ply_read_value<double> (util::BinaryReader& input, PLYFormat format);
 
 /* Explicit template instantiation for 'unsigned int'. */
 template
 unsigned int
-ply_read_value<unsigned int> (std::istream& input, PLYFormat format);
+ply_read_value<unsigned int> (util::BinaryReader& input, PLYFormat format);
 
 /* Explicit template instantiation for 'int'. */
 template
 int
-ply_read_value<int> (std::istream& input, PLYFormat format);
+ply_read_value<int> (util::BinaryReader& input, PLYFormat format);
 
 /* ---------------------------------------------------------------- */
 
@@ -117,6 +147,240 @@ ply_color_convert (float const* src, unsigned char* dest, int num = 3)
     }
 }
 
+/* ---------------------------------------------------------------- */
+
+namespace
+{
+    /* Binary data is read in chunks of this many elements. */
+    std::size_t const PLY_CHUNK_SIZE = 1 << 20;
+
+    /* Decodes a binary value from memory given the PLY format. */
+    template <typename T>
+    inline T
+    ply_decode_value (char const* data, PLYFormat format)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        if (format == PLY_BINARY_LE)
+            return util::system::letoh(value);
+        return util::system::betoh(value);
+    }
+
+    /* Returns the size of a binary vertex property in bytes. */
+    std::size_t
+    ply_vertex_property_size (PLYVertexProperty prop)
+    {
+        switch (prop)
+        {
+            case PLY_V_DOUBLE_X:
+            case PLY_V_DOUBLE_Y:
+            case PLY_V_DOUBLE_Z:
+            case PLY_V_IGNORE_DOUBLE:
+                return sizeof(double);
+
+            case PLY_V_UINT8_R:
+            case PLY_V_UINT8_G:
+            case PLY_V_UINT8_B:
+            case PLY_V_IGNORE_UINT8:
+                return sizeof(unsigned char);
+
+            default:
+                return sizeof(float);
+        }
+    }
+
+    /*
+     * Reads the vertices of a binary PLY file in large chunks and decodes
+     * each chunk in parallel. The result is the same as reading the values
+     * one by one. Returns false on premature EOF.
+     */
+    bool
+    ply_bulk_read_vertices (util::BinaryReader& input, PLYFormat format,
+        std::vector<PLYVertexProperty> const& v_format,
+        std::size_t num_vertices, TriangleMesh* mesh, bool want_colors,
+        bool want_vnormals, bool want_tex_coords)
+    {
+        TriangleMesh::VertexList& vertices = mesh->get_vertices();
+        TriangleMesh::ColorList& vcolors = mesh->get_vertex_colors();
+        TriangleMesh::ConfidenceList& vconfs = mesh->get_vertex_confidences();
+        TriangleMesh::ValueList& vvalues = mesh->get_vertex_values();
+        TriangleMesh::TexCoordList& tcoords = mesh->get_vertex_texcoords();
+        TriangleMesh::NormalList& vnormals = mesh->get_vertex_normals();
+
+        /* Compute the offsets of the properties in a vertex record. */
+        std::vector<std::size_t> offsets(v_format.size());
+        std::size_t stride = 0;
+        bool want_confs = false;
+        bool want_values = false;
+        for (std::size_t n = 0; n < v_format.size(); ++n)
+        {
+            offsets[n] = stride;
+            stride += ply_vertex_property_size(v_format[n]);
+            want_confs = want_confs || v_format[n] == PLY_V_FLOAT_CONF;
+            want_values = want_values || v_format[n] == PLY_V_FLOAT_VALUE;
+        }
+
+        std::vector<char> buffer;
+        for (std::size_t first = 0; first < num_vertices;
+            first += PLY_CHUNK_SIZE)
+        {
+            std::size_t const num = std::min(PLY_CHUNK_SIZE,
+                num_vertices - first);
+            buffer.resize(num * stride);
+            std::size_t const num_read = stride == 0
+                ? num : input.read(buffer.data(), buffer.size()) / stride;
+
+            std::size_t const size = first + num_read;
+            vertices.resize(size);
+            if (want_vnormals)
+                vnormals.resize(size);
+            if (want_colors)
+                vcolors.resize(size);
+            if (want_tex_coords)
+                tcoords.resize(size);
+            if (want_confs)
+                vconfs.resize(size);
+            if (want_values)
+                vvalues.resize(size);
+
+            std::int64_t const num_records = num_read;
+#pragma omp parallel for schedule(static)
+            for (std::int64_t j = 0; j < num_records; ++j)
+            {
+                char const* record = buffer.data() + j * stride;
+                std::size_t const i = first + j;
+                math::Vec3f vertex(0.0f, 0.0f, 0.0f);
+                math::Vec3f vnormal(0.0f, 0.0f, 0.0f);
+                math::Vec4f color(1.0f, 0.5f, 0.5f, 1.0f);
+                math::Vec2f tex_coord(0.0f, 0.0f);
+
+                for (std::size_t n = 0; n < v_format.size(); ++n)
+                {
+                    PLYVertexProperty elem = v_format[n];
+                    char const* ptr = record + offsets[n];
+                    switch (elem)
+                    {
+                    case PLY_V_FLOAT_X:
+                    case PLY_V_FLOAT_Y:
+                    case PLY_V_FLOAT_Z:
+                        vertex[(int)elem - PLY_V_FLOAT_X]
+                            = ply_decode_value<float>(ptr, format);
+                        break;
+
+                    case PLY_V_DOUBLE_X:
+                    case PLY_V_DOUBLE_Y:
+                    case PLY_V_DOUBLE_Z:
+                        vertex[(int)elem - PLY_V_DOUBLE_X]
+                            = ply_decode_value<double>(ptr, format);
+                        break;
+
+                    case PLY_V_FLOAT_NX:
+                    case PLY_V_FLOAT_NY:
+                    case PLY_V_FLOAT_NZ:
+                        vnormal[(int)elem - PLY_V_FLOAT_NX]
+                            = ply_decode_value<float>(ptr, format);
+                        break;
+
+                    case PLY_V_UINT8_R:
+                    case PLY_V_UINT8_G:
+                    case PLY_V_UINT8_B:
+                        color[(int)elem - PLY_V_UINT8_R]
+                            = (float)static_cast<unsigned char>(*ptr)
+                            * (1.0f / 255.0f);
+                        break;
+
+                    case PLY_V_FLOAT_R:
+                    case PLY_V_FLOAT_G:
+                    case PLY_V_FLOAT_B:
+                        color[(int)elem - PLY_V_FLOAT_R]
+                            = ply_decode_value<float>(ptr, format);
+                        break;
+
+                    case PLY_V_FLOAT_U:
+                    case PLY_V_FLOAT_V:
+                        tex_coord[(int)elem - PLY_V_FLOAT_U]
+                            = ply_decode_value<float>(ptr, format);
+                        break;
+
+                    case PLY_V_FLOAT_CONF:
+                        vconfs[i] = ply_decode_value<float>(ptr, format);
+                        break;
+
+                    case PLY_V_FLOAT_VALUE:
+                        vvalues[i] = ply_decode_value<float>(ptr, format);
+                        break;
+
+                    default:
+                        break;
+                    }
+                }
+
+                vertices[i] = vertex;
+                if (want_vnormals)
+                    vnormals[i] = vnormal;
+                if (want_colors)
+                    vcolors[i] = color;
+                if (want_tex_coords)
+                    tcoords[i] = tex_coord;
+            }
+
+            if (num_read < num)
+                return false;
+        }
+        return true;
+    }
+
+    /*
+     * Reads the leading triangles of a binary PLY file in large chunks and
+     * decodes each chunk in parallel. A triangle is the count 3 and three
+     * indices. Stops at the first other face and positions the input at
+     * that face. Returns the number of triangles read.
+     */
+    std::size_t
+    ply_bulk_read_triangles (util::BinaryReader& input, PLYFormat format,
+        std::size_t num_faces, TriangleMesh::FaceList* faces)
+    {
+        std::size_t const stride = 1 + 3 * sizeof(unsigned int);
+        std::vector<char> buffer;
+        std::size_t num_done = 0;
+        while (num_done < num_faces)
+        {
+            std::size_t const num = std::min(PLY_CHUNK_SIZE,
+                num_faces - num_done);
+            std::size_t const chunk_start = input.tell();
+            buffer.resize(num * stride);
+            std::size_t const num_read
+                = input.read(buffer.data(), buffer.size()) / stride;
+
+            std::size_t num_tris = 0;
+            while (num_tris < num_read && buffer[num_tris * stride] == 3)
+                num_tris += 1;
+
+            std::size_t const base = faces->size();
+            faces->resize(base + 3 * num_tris);
+            unsigned int* indices = faces->data() + base;
+            std::int64_t const num_records = num_tris;
+#pragma omp parallel for schedule(static)
+            for (std::int64_t j = 0; j < num_records; ++j)
+            {
+                char const* record = buffer.data() + j * stride + 1;
+                for (int k = 0; k < 3; ++k)
+                    indices[j * 3 + k] = ply_decode_value<unsigned int>(
+                        record + k * sizeof(unsigned int), format);
+            }
+
+            num_done += num_tris;
+            if (num_tris < num)
+            {
+                /* Continue with the regular reader at the current face. */
+                input.seek(chunk_start + num_tris * stride);
+                break;
+            }
+        }
+        return num_done;
+    }
+}
+
 /* ---------------------------------------------------------------- */
 // TODO check token amount to prevent undefined access
 
@@ -128,21 +392,15 @@ load_ply_mesh (std::string const& filename)
         throw std::invalid_argument("No filename given");
 
     /* Open file. */
-    std::ifstream input(filename.c_str(), std::ios::binary);
-    if (!input.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryReader input(filename);
 
     /* Start parsing. */
     std::string buffer;
-    input >> buffer; /* Read "ply" file signature. */
+    input.read_line(&buffer); /* Read "ply" file signature. */
+    util::string::clip_newlines(&buffer);
+    util::string::clip_whitespaces(&buffer);
     if (buffer != "ply")
-    {
-        input.close();
         throw util::Exception("File format not recognized as PLY-model");
-    }
-
-    /* Discard the rest of the line. */
-    std::getline(input, buffer);
 
     PLYFormat ply_format = PLY_UNKNOWN;
     std::size_t num_faces = 0;
@@ -161,9 +419,9 @@ load_ply_mesh (std::string const& filename)
     bool reading_tristrips = false;
     std::size_t skip_bytes = 0;
 
-    while (input.good())
+    util::ViewTokenizer header;
+    while (input.read_line(&buffer))
     {
-        std::getline(input, buffer);
         util::string::clip_newlines(&buffer);
         util::string::clip_whitespaces(&buffer);
 
@@ -172,7 +430,6 @@ load_ply_mesh (std::string const& filename)
         if (buffer == "end_header")
             break;
 
-        util::Tokenizer header;
         header.split(buffer);
 
         if (header.empty())
@@ -361,10 +618,7 @@ load_ply_mesh (std::string const& filename)
     }
 
     if (critical || ply_format == PLY_UNKNOWN)
-    {
-        input.close();
         throw util::Exception("PLY file encoding not recognized by parser");
-    }
 
     /* Create a new triangle mesh. */
     TriangleMesh::Ptr mesh = TriangleMesh::create();
@@ -414,7 +668,7 @@ load_ply_mesh (std::string const& filename)
     {
         std::cout << "PLY Loader: Skipping " << skip_bytes
             << " bytes." << std::endl;
-        input.ignore(skip_bytes);
+        input.skip(skip_bytes);
     }
 
     /* Start reading the vertex data. */
@@ -426,8 +680,18 @@ load_ply_mesh (std::string const& filename)
     if (want_vnormals)
         vnormals.reserve(num_vertices);
 
+    /* Binary vertices are decoded in bulk. */
     bool eof = false;
-    for (std::size_t i = 0; !eof && i < num_vertices; ++i)
+    std::size_t first_vertex = 0;
+    if (ply_format != PLY_ASCII)
+    {
+        eof = !ply_bulk_read_vertices(input, ply_format, v_format,
+            num_vertices, mesh.get(), want_colors, want_vnormals,
+            want_tex_coords);
+        first_vertex = num_vertices;
+    }
+
+    for (std::size_t i = first_vertex; !eof && i < num_vertices; ++i)
     {
         math::Vec3f vertex(0.0f, 0.0f, 0.0f);
         math::Vec3f vnormal(0.0f, 0.0f, 0.0f);
@@ -525,7 +789,15 @@ load_ply_mesh (std::string const& filename)
     if (num_faces > 0)
         std::cout << " " << num_faces << " faces..." << std::flush;
     faces.reserve(num_faces * 3);
-    for (std::size_t i = 0; !eof && i < num_faces; ++i)
+
+    /* Binary triangles are decoded in bulk if faces only have indices. */
+    std::size_t first_face = 0;
+    if (!eof && ply_format != PLY_ASCII && f_format.size() == 1
+        && f_format[0] == PLY_F_VERTEX_INDICES)
+        first_face = ply_bulk_read_triangles(input, ply_format, num_faces,
+            &faces);
+
+    for (std::size_t i = first_face; !eof && i < num_faces; ++i)
     {
         for (std::size_t n = 0; n < f_format.size(); ++n)
         {
@@ -612,7 +884,7 @@ load_ply_mesh (std::string const& filename)
 
             eof = input.eof();
         }
-        mve::geom::rangegrid_triangulate(img, mesh);
+        core::geom::rangegrid_triangulate(img, mesh);
     }
 
     /* Start reading triangle strips data. */
@@ -647,7 +919,7 @@ load_ply_mesh (std::string const& filename)
         }
     }
 
-    /* Close the file stream. */
+    /* Close the file. */
     input.close();
     std::cout << " done." << std::endl;
     if (eof)
@@ -664,19 +936,15 @@ load_xf_file (std::string const& filename, float* ctw)
     if (filename.empty())
         throw std::invalid_argument("No filename given");
 
-    std::ifstream in(filename.c_str());
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryReader in(filename);
 
     int values_read = 0;
     while (values_read < 16 && !in.eof())
     {
-        in >> ctw[values_read];
+        ctw[values_read] = ply_read_ascii<float>(in);
         values_read += 1;
     }
 
-    in.close();
-
     if (values_read < 16)
         throw util::Exception("Unexpected EOF");
 }
@@ -880,6 +1148,257 @@ save_ply_mesh (TriangleMesh::ConstPtr mesh, std::string const& filename,
 
 /* ---------------------------------------------------------------- */
 
+namespace
+{
+    /* Writes are buffered in blocks of this size. */
+    std::size_t const PLY_WRITE_BUFFER_SIZE = 1 << 22;
+    /* Element counts are zero-padded to this width to patch them later. */
+    int const PLY_COUNT_WIDTH = 20;
+
+    void
+    ply_append (std::vector<char>* buffer, void const* data, std::size_t size)
+    {
+        char const* ptr = static_cast<char const*>(data);
+        buffer->insert(buffer->end(), ptr, ptr + size);
+    }
+
+    void
+    ply_write_count (std::ostream& out, std::size_t count)
+    {
+        out << std::setw(PLY_COUNT_WIDTH) << std::setfill('0') << count
+            << std::setfill(' ');
+    }
+}
+
+PLYStreamWriter::PLYStreamWriter (std::string const& filename,
+    SavePLYOptions const& options)
+    : filename(filename)
+    , faces_filename(filename + ".faces.tmp")
+    , options(options)
+    , num_vertices(0)
+    , num_faces(0)
+{
+    if (filename.empty())
+        throw std::invalid_argument("No filename given");
+    if (!options.format_binary)
+        throw std::invalid_argument("Only binary PLY files are streamed");
+    if (options.verts_per_simplex == 0 || options.verts_per_simplex > 255)
+        throw std::invalid_argument("Invalid vertices per simplex");
+
+    this->out.open(filename.c_str(), std::ios::binary);
+    if (!this->out.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    /* Generate PLY header with placeholders for the counts. */
+    this->out << "ply" << std::endl;
+    this->out << "format binary_little_endian 1.0" << std::endl;
+    this->out << "comment Export generated by libmve" << std::endl;
+    this->out << "element vertex ";
+    this->vertex_count_pos = this->out.tellp();
+    ply_write_count(this->out, 0);
+    this->out << std::endl;
+    this->out << "property float x" << std::endl;
+    this->out << "property float y" << std::endl;
+    this->out << "property float z" << std::endl;
+    if (options.write_vertex_normals)
+    {
+        this->out << "property float nx" << std::endl;
+        this->out << "property float ny" << std::endl;
+        this->out << "property float nz" << std::endl;
+    }
+    if (options.write_vertex_colors)
+    {
+        this->out << "property uchar red" << std::endl;
+        this->out << "property uchar green" << std::endl;
+        this->out << "property uchar blue" << std::endl;
+    }
+    if (options.write_vertex_confidences)
+        this->out << "property float confidence" << std::endl;
+    if (options.write_vertex_values)
+        this->out << "property float value" << std::endl;
+    this->out << "element face ";
+    this->face_count_pos = this->out.tellp();
+    ply_write_count(this->out, 0);
+    this->out << std::endl;
+    this->out << "property list uchar int vertex_indices" << std::endl;
+    this->out << "end_header" << std::endl;
+    if (!this->out.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    this->buffer.reserve(PLY_WRITE_BUFFER_SIZE);
+}
+
+PLYStreamWriter::~PLYStreamWriter (void)
+{
+    if (!this->out.is_open())
+        return;
+
+    try
+    {
+        this->close();
+    }
+    catch (std::exception&)
+    {
+    }
+}
+
+void
+PLYStreamWriter::add_vertices (TriangleMesh::ConstPtr mesh)
+{
+    if (mesh == nullptr)
+        throw std::invalid_argument("Null mesh given");
+    if (!this->out.is_open())
+        throw std::runtime_error("PLY stream already closed");
+
+    TriangleMesh::VertexList const& verts(mesh->get_vertices());
+    TriangleMesh::ColorList const& vcolors(mesh->get_vertex_colors());
+    TriangleMesh::NormalList const& vnormals(mesh->get_vertex_normals());
+    TriangleMesh::ConfidenceList const& conf(mesh->get_vertex_confidences());
+    TriangleMesh::ValueList const& vvalues(mesh->get_vertex_values());
+
+    bool const write_vnormals = this->options.write_vertex_normals;
+    bool const write_vcolors = this->options.write_vertex_colors;
+    bool const write_vconfidences = this->options.write_vertex_confidences;
+    bool const write_vvalues = this->options.write_vertex_values;
+    if (write_vnormals && vnormals.size() != verts.size())
+        throw std::invalid_argument("Invalid amount of vertex normals");
+    if (write_vcolors && vcolors.size() != verts.size())
+        throw std::invalid_argument("Invalid amount of vertex colors");
+    if (write_vconfidences && conf.size() != verts.size())
+        throw std::invalid_argument("Invalid amount of vertex confidences");
+    if (write_vvalues && vvalues.size() != verts.size())
+        throw std::invalid_argument("Invalid amount of vertex values");
+
+    for (std::size_t i = 0; i < verts.size(); ++i)
+    {
+        ply_append(&this->buffer, *verts[i], 3 * sizeof(float));
+        if (write_vnormals)
+            ply_append(&this->buffer, *vnormals[i], 3 * sizeof(float));
+        if (write_vcolors)
+        {
+            unsigned char color[3];
+            ply_color_convert(*vcolors[i], color);
+            ply_append(&this->buffer, color, 3);
+        }
+        if (write_vconfidences)
+            ply_append(&this->buffer, &conf[i], sizeof(float));
+        if (write_vvalues)
+            ply_append(&this->buffer, &vvalues[i], sizeof(float));
+
+        if (this->buffer.size() >= PLY_WRITE_BUFFER_SIZE)
+            this->flush(this->out, &this->buffer, this->filename);
+    }
+    this->num_vertices += verts.size();
+}
+
+void
+PLYStreamWriter::add_faces (TriangleMesh::FaceList const& faces)
+{
+    this->append_faces(faces, 0);
+}
+
+void
+PLYStreamWriter::add_mesh (TriangleMesh::ConstPtr mesh)
+{
+    if (mesh == nullptr)
+        throw std::invalid_argument("Null mesh given");
+    std::size_t const offset = this->num_vertices;
+    this->add_vertices(mesh);
+    this->append_faces(mesh->get_faces(), offset);
+}
+
+void
+PLYStreamWriter::append_faces (TriangleMesh::FaceList const& faces,
+    std::size_t offset)
+{
+    if (!this->out.is_open())
+        throw std::runtime_error("PLY stream already closed");
+    unsigned int const verts_per_simplex = this->options.verts_per_simplex;
+    if (faces.size() % verts_per_simplex != 0)
+        throw std::invalid_argument("Invalid amount of face indices");
+    if (faces.empty())
+        return;
+
+    if (!this->faces_out.is_open())
+    {
+        this->faces_out.open(this->faces_filename.c_str(), std::ios::binary);
+        if (!this->faces_out.good())
+            throw util::FileException(this->faces_filename,
+                std::strerror(errno));
+        this->faces_buffer.reserve(PLY_WRITE_BUFFER_SIZE);
+    }
+
+    unsigned char const verts_per_simplex_uchar = verts_per_simplex;
+    std::size_t const face_amount = faces.size() / verts_per_simplex;
+    for (std::size_t i = 0; i < face_amount; ++i)
+    {
+        ply_append(&this->faces_buffer, &verts_per_simplex_uchar, 1);
+        for (unsigned int j = 0; j < verts_per_simplex; ++j)
+        {
+            unsigned int const index = static_cast<unsigned int>(
+                faces[i * verts_per_simplex + j] + offset);
+            ply_append(&this->faces_buffer, &index, sizeof(unsigned int));
+        }
+
+        if (this->faces_buffer.size() >= PLY_WRITE_BUFFER_SIZE)
+            this->flush(this->faces_out, &this->faces_buffer,
+                this->faces_filename);
+    }
+    this->num_faces += face_amount;
+}
+
+void
+PLYStreamWriter::close (void)
+{
+    if (!this->out.is_open())
+        return;
+
+    this->flush(this->out, &this->buffer, this->filename);
+
+    /* Append the buffered faces and remove the temporary file. */
+    if (this->faces_out.is_open())
+    {
+        this->flush(this->faces_out, &this->faces_buffer,
+            this->faces_filename);
+        this->faces_out.close();
+
+        std::ifstream in(this->faces_filename.c_str(), std::ios::binary);
+        if (!in.good())
+            throw util::FileException(this->faces_filename,
+                std::strerror(errno));
+        this->faces_buffer.resize(PLY_WRITE_BUFFER_SIZE);
+        while (in.good())
+        {
+            in.read(this->faces_buffer.data(), this->faces_buffer.size());
+            this->out.write(this->faces_buffer.data(), in.gcount());
+        }
+        in.close();
+        this->faces_buffer.clear();
+        util::fs::unlink(this->faces_filename.c_str());
+    }
+
+    /* Patch the element counts in the header. */
+    this->out.seekp(this->vertex_count_pos);
+    ply_write_count(this->out, this->num_vertices);
+    this->out.seekp(this->face_count_pos);
+    ply_write_count(this->out, this->num_faces);
+    this->out.close();
+    if (!this->out.good())
+        throw util::FileException(this->filename, std::strerror(errno));
+}
+
+void
+PLYStreamWriter::flush (std::ofstream& out, std::vector<char>* buffer,
+    std::string const& filename)
+{
+    out.write(buffer->data(), buffer->size());
+    buffer->clear();
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 save_ply_view (std::string const& filename, CameraInfo const& camera,
     FloatImage::ConstPtr depth_map, FloatImage::ConstPtr confidence_map,
@@ -982,7 +1501,7 @@ save_ply_view (std::string const& filename, CameraInfo const& camera,
             continue;
 
         /* Build per-pixel viewing dir (in camera coords). */
-        math::Vec3f pos = mve::geom::pixel_3dpos(x, yinv, depth, invproj);
+        math::Vec3f pos = core::geom::pixel_3dpos(x, yinv, depth, invproj);
 
         /* Convert vertex to world coords and write to file. */
         out.write((char const*)pos.begin(), 3 * sizeof(float));
@@ -1087,33 +1606,26 @@ load_ply_depthmap (std::string const& filename)
         throw std::invalid_argument("No filename given");
 
     /* Open file. */
-    std::fstream input(filename.c_str());
-    if (!input.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryReader input(filename);
 
     /* Start parsing. */
     std::string buffer;
-    input >> buffer; /* Read "ply" file signature. */
+    input.read_line(&buffer); /* Read "ply" file signature. */
+    util::string::clip_newlines(&buffer);
+    util::string::clip_whitespaces(&buffer);
     if (buffer != "ply")
-    {
-        input.close();
         throw util::Exception("File format not recognized as PLY file");
-    }
-
-    /* Discard the rest of the line. */
-    std::getline(input, buffer);
 
     std::size_t n_verts = 0;
     int n_grid = 0;
     int width = 0;
     int height = 0;
-    while (input.good())
+    util::ViewTokenizer t;
+    while (input.read_line(&buffer))
     {
-        std::getline(input, buffer);
         util::string::clip_newlines(&buffer);
         util::string::clip_whitespaces(&buffer);
 
-        util::Tokenizer t;
         t.split(buffer);
 
         if (t.empty())
@@ -1132,22 +1644,20 @@ load_ply_depthmap (std::string const& filename)
     }
 
     if (!n_verts || !n_grid || !width || !height || n_grid != width * height)
-    {
-        input.close();
         throw util::Exception("File headers not recognized as depthmap");
-    }
 
     /* Read vertices. */
     TriangleMesh::VertexList verts;
     for (std::size_t i = 0; i < n_verts; ++i)
     {
-        float x, y, z;
-        input >> x >> y >> z;
+        float const x = ply_read_ascii<float>(input);
+        float const y = ply_read_ascii<float>(input);
+        float const z = ply_read_ascii<float>(input);
         verts.push_back(math::Vec3f(x, y, z));
     }
 
     /* Discard newline. */
-    std::getline(input, buffer);
+    input.read_line(&buffer);
 
     FloatImage::Ptr ret(FloatImage::create(width, height, 1));
     /* Read range grid. */
@@ -1156,17 +1666,14 @@ load_ply_depthmap (std::string const& filename)
         // Flip y-axis
         int const idx = (height - (i / width) - 1) * width + (i % width);
 
-        std::getline(input, buffer);
-        util::string::clip_newlines(&buffer);
-        util::string::clip_whitespaces(&buffer);
-        util::Tokenizer t;
-        t.split(buffer);
-
-        if (input.eof())
+        if (!input.read_line(&buffer))
         {
             std::cout << "Warning: Early EOF while parsing PLY" << std::endl;
             break;
         }
+        util::string::clip_newlines(&buffer);
+        util::string::clip_whitespaces(&buffer);
+        t.split(buffer);
 
         if (t.empty() || t[0] != "1")
         {
@@ -1187,9 +1694,8 @@ load_ply_depthmap (std::string const& filename)
         }
     }
 
-    input.close();
     return ret;
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
@@ -7,21 +7,24 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_PLY_FILE_HEADER
-#define MVE_PLY_FILE_HEADER
+#ifndef CORE_PLY_FILE_HEADER
+#define CORE_PLY_FILE_HEADER
 
-#include <istream>
+#include <cstddef>
+#include <fstream>
 #include <string>
+#include <vector>
 
+#include "util/binary_io.h"
 #include "util/system.h"
-#include "mve/defines.h"
-#include "mve/image.h"
-#include "mve/camera.h"
-#include "mve/view.h"
-#include "mve/mesh.h"
+#include "core/defines.h"
+#include "core/image.h"
+#include "core/camera.h"
+#include "core/view.h"
+#include "core/mesh.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * Loads a triangle mesh from a PLY model file.
@@ -68,6 +71,68 @@ void
 save_ply_mesh (TriangleMesh::ConstPtr mesh, std::string const& filename,
     SavePLYOptions const& options = SavePLYOptions());
 
+/**
+ * Streaming writer for binary PLY files of huge meshes. Vertices and faces
+ * are appended in chunks, so the whole mesh is never in memory. The data
+ * is written with large buffered writes. The element counts in the header
+ * are patched when the file is closed. Since PLY stores the faces after
+ * all vertices, faces are buffered in a temporary file next to the output
+ * until close(). The vertex attributes are selected by the options; face
+ * colors and normals, and ASCII output are not supported.
+ */
+class PLYStreamWriter
+{
+public:
+    PLYStreamWriter (std::string const& filename,
+        SavePLYOptions const& options = SavePLYOptions());
+    /** Closes the file if necessary, errors are ignored. */
+    ~PLYStreamWriter (void);
+    PLYStreamWriter (PLYStreamWriter const& other) = delete;
+    PLYStreamWriter& operator= (PLYStreamWriter const& other) = delete;
+
+    /**
+     * Appends the vertices of the mesh with the attributes selected by the
+     * options, which must be given for every vertex. Faces are ignored.
+     */
+    void add_vertices (TriangleMesh::ConstPtr mesh);
+
+    /** Appends faces, the indices refer to all vertices of the file. */
+    void add_faces (TriangleMesh::FaceList const& faces);
+
+    /**
+     * Appends the vertices and faces of the mesh. The face indices refer
+     * to the vertices of the mesh and are offset accordingly.
+     */
+    void add_mesh (TriangleMesh::ConstPtr mesh);
+
+    /** Writes the faces and the final header. Throws on error. */
+    void close (void);
+
+    /** Returns the number of vertices written so far. */
+    std::size_t get_num_vertices (void) const;
+    /** Returns the number of faces written so far. */
+    std::size_t get_num_faces (void) const;
+
+private:
+    void append_faces (TriangleMesh::FaceList const& faces,
+        std::size_t offset);
+    void flush (std::ofstream& out, std::vector<char>* buffer,
+        std::string const& filename);
+
+private:
+    std::string filename;
+    std::string faces_filename;
+    SavePLYOptions options;
+    std::ofstream out;
+    std::ofstream faces_out;
+    std::vector<char> buffer;
+    std::vector<char> faces_buffer;
+    std::streampos vertex_count_pos;
+    std::streampos face_count_pos;
+    std::size_t num_vertices;
+    std::size_t num_faces;
+};
+
 /**
  * Stores a scanalize-compatible PLY file from a depth map.
  * If the confidence map is given, confidence values are stored and
@@ -161,12 +226,26 @@ enum PLYFormat
     PLY_UNKNOWN
 };
 
-/** Reads a value from the input stream given the PLY format. */
+/** Reads a value from the input file given the PLY format. */
 template <typename T>
 T
-ply_read_value (std::istream& input, PLYFormat format);
+ply_read_value (util::BinaryReader& input, PLYFormat format);
+
+/* ------------------------ Implementation ------------------------ */
+
+inline std::size_t
+PLYStreamWriter::get_num_vertices (void) const
+{
+    return this->num_vertices;
+}
+
+inline std::size_t
+PLYStreamWriter::get_num_faces (void) const
+{
+    return this->num_faces;
+}
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_PLY_FILE_HEADER */
+#endif /* CORE_PLY_FILE_HEADER */
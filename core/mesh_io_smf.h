@@ -7,16 +7,16 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_MESH_IO_SMF_HEADER
-#define MVE_MESH_IO_SMF_HEADER
+#ifndef CORE_MESH_IO_SMF_HEADER
+#define CORE_MESH_IO_SMF_HEADER
 
 #include <string>
 
-#include "mve/mesh.h"
-#include "mve/defines.h"
+#include "core/mesh.h"
+#include "core/defines.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * Loads a triangle mesh from a SMF file format.
@@ -28,9 +28,9 @@ load_smf_mesh (std::string const& filename);
  * Saves a triangle mesh to a file in SMF file format.
  */
 void
-save_smf_mesh (mve::TriangleMesh::ConstPtr mesh, std::string const& filename);
+save_smf_mesh (core::TriangleMesh::ConstPtr mesh, std::string const& filename);
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_MESH_IO_SMF_HEADER */
+#endif /* CORE_MESH_IO_SMF_HEADER */
@@ -7,55 +7,68 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
-#include <list>
+#include <iterator>
 #include <limits>
 #include <fstream>
 #include <cerrno>
 #include <cstring>
+#include <cmath>
 
 #include "math/algo.h"
 #include "math/vector.h"
-#include "mve/mesh_info.h"
-#include "mve/mesh_tools.h"
+#include "core/mesh_info.h"
+#include "core/mesh_adjacency.h"
+#include "core/mesh_tools.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
-/** for-each functor: homogenous matrix-vector multiplication. */
-template <typename T, int D>
-struct foreach_hmatrix_mult
+namespace
 {
-    typedef math::Matrix<T,D,D> MatrixType;
-    typedef math::Vector<T,D-1> VectorType;
-    typedef T ValueType;
-
-    MatrixType mat;
-    ValueType val;
+    /* Multiplies the vectors with the matrix in parallel. */
+    void
+    transform_list (math::Matrix3f const& mat,
+        std::vector<math::Vec3f>* list)
+    {
+        std::int64_t const num = static_cast<std::int64_t>(list->size());
+        math::Vec3f* data = list->data();
+#pragma omp parallel for schedule(static)
+        for (std::int64_t i = 0; i < num; ++i)
+            data[i] = mat * data[i];
+    }
 
-    foreach_hmatrix_mult (MatrixType const& matrix, ValueType const& value)
-        : mat(matrix), val(value) {}
-    void operator() (VectorType& vec) { vec = mat.mult(vec, val); }
-};
+    /*
+     * Multiplies the vectors with the homogenous matrix in parallel, where
+     * 'w' is the homogenous coordinate (1 for points, 0 for directions).
+     */
+    void
+    transform_list (math::Matrix4f const& mat, float w,
+        std::vector<math::Vec3f>* list)
+    {
+        std::int64_t const num = static_cast<std::int64_t>(list->size());
+        math::Vec3f* data = list->data();
+#pragma omp parallel for schedule(static)
+        for (std::int64_t i = 0; i < num; ++i)
+            data[i] = mat.mult(data[i], w);
+    }
+}  /* namespace */
 
 /* ---------------------------------------------------------------- */
 
 void
-mesh_transform (mve::TriangleMesh::Ptr mesh, math::Matrix3f const& rot)
+mesh_transform (core::TriangleMesh::Ptr mesh, math::Matrix3f const& rot)
 {
     if (mesh == nullptr)
         throw std::invalid_argument("Null mesh given");
 
-    mve::TriangleMesh::VertexList& verts(mesh->get_vertices());
-    mve::TriangleMesh::NormalList& vnorm(mesh->get_vertex_normals());
-    mve::TriangleMesh::NormalList& fnorm(mesh->get_face_normals());
-
-    math::algo::foreach_matrix_mult<math::Matrix3f, math::Vec3f> func(rot);
-    std::for_each(verts.begin(), verts.end(), func);
-    std::for_each(fnorm.begin(), fnorm.end(), func);
-    std::for_each(vnorm.begin(), vnorm.end(), func);
+    transform_list(rot, &mesh->get_vertices());
+    transform_list(rot, &mesh->get_face_normals());
+    transform_list(rot, &mesh->get_vertex_normals());
 }
 
 /* ---------------------------------------------------------------- */
@@ -66,15 +79,9 @@ mesh_transform (TriangleMesh::Ptr mesh, math::Matrix4f const& trans)
     if (mesh == nullptr)
         throw std::invalid_argument("Null mesh given");
 
-    mve::TriangleMesh::VertexList& verts(mesh->get_vertices());
-    mve::TriangleMesh::NormalList& vnorm(mesh->get_vertex_normals());
-    mve::TriangleMesh::NormalList& fnorm(mesh->get_face_normals());
-
-    foreach_hmatrix_mult<float, 4> vfunc(trans, 1.0f);
-    foreach_hmatrix_mult<float, 4> nfunc(trans, 0.0f);
-    std::for_each(verts.begin(), verts.end(), vfunc);
-    std::for_each(fnorm.begin(), fnorm.end(), nfunc);
-    std::for_each(vnorm.begin(), vnorm.end(), nfunc);
+    transform_list(trans, 1.0f, &mesh->get_vertices());
+    transform_list(trans, 0.0f, &mesh->get_face_normals());
+    transform_list(trans, 0.0f, &mesh->get_vertex_normals());
 }
 
 /* ---------------------------------------------------------------- */
@@ -83,22 +90,24 @@ mesh_transform (TriangleMesh::Ptr mesh, math::Matrix4f const& trans)
 void
 mesh_merge (TriangleMesh::ConstPtr mesh1, TriangleMesh::Ptr mesh2)
 {
-    mve::TriangleMesh::VertexList const& verts1 = mesh1->get_vertices();
-    mve::TriangleMesh::VertexList& verts2 = mesh2->get_vertices();
-    mve::TriangleMesh::ColorList const& color1 = mesh1->get_vertex_colors();
-    mve::TriangleMesh::ColorList& color2 = mesh2->get_vertex_colors();
-    mve::TriangleMesh::ConfidenceList const& confs1 = mesh1->get_vertex_confidences();
-    mve::TriangleMesh::ConfidenceList& confs2 = mesh2->get_vertex_confidences();
-    mve::TriangleMesh::ValueList const& values1 = mesh1->get_vertex_values();
-    mve::TriangleMesh::ValueList& values2 = mesh2->get_vertex_values();
-    mve::TriangleMesh::NormalList const& vnorm1 = mesh1->get_vertex_normals();
-    mve::TriangleMesh::NormalList& vnorm2 = mesh2->get_vertex_normals();
-    mve::TriangleMesh::TexCoordList const& vtex1 = mesh1->get_vertex_texcoords();
-    mve::TriangleMesh::TexCoordList& vtex2 = mesh2->get_vertex_texcoords();
-    mve::TriangleMesh::NormalList const& fnorm1 = mesh1->get_face_normals();
-    mve::TriangleMesh::NormalList& fnorm2 = mesh2->get_face_normals();
-    mve::TriangleMesh::FaceList const& faces1 = mesh1->get_faces();
-    mve::TriangleMesh::FaceList& faces2 = mesh2->get_faces();
+    core::TriangleMesh::VertexList const& verts1 = mesh1->get_vertices();
+    core::TriangleMesh::VertexList& verts2 = mesh2->get_vertices();
+    core::TriangleMesh::ColorList const& color1 = mesh1->get_vertex_colors();
+    core::TriangleMesh::ColorList& color2 = mesh2->get_vertex_colors();
+    core::TriangleMesh::ConfidenceList const& confs1 = mesh1->get_vertex_confidences();
+    core::TriangleMesh::ConfidenceList& confs2 = mesh2->get_vertex_confidences();
+    core::TriangleMesh::ValueList const& values1 = mesh1->get_vertex_values();
+    core::TriangleMesh::ValueList& values2 = mesh2->get_vertex_values();
+    core::TriangleMesh::NormalList const& vnorm1 = mesh1->get_vertex_normals();
+    core::TriangleMesh::NormalList& vnorm2 = mesh2->get_vertex_normals();
+    core::TriangleMesh::TexCoordList const& vtex1 = mesh1->get_vertex_texcoords();
+    core::TriangleMesh::TexCoordList& vtex2 = mesh2->get_vertex_texcoords();
+    core::TriangleMesh::NormalList const& fnorm1 = mesh1->get_face_normals();
+    core::TriangleMesh::NormalList& fnorm2 = mesh2->get_face_normals();
+    core::TriangleMesh::ColorList const& fcolor1 = mesh1->get_face_colors();
+    core::TriangleMesh::ColorList& fcolor2 = mesh2->get_face_colors();
+    core::TriangleMesh::FaceList const& faces1 = mesh1->get_faces();
+    core::TriangleMesh::FaceList& faces2 = mesh2->get_faces();
 
     verts2.reserve(verts1.size() + verts2.size());
     color2.reserve(color1.size() + color2.size());
@@ -107,7 +116,7 @@ mesh_merge (TriangleMesh::ConstPtr mesh1, TriangleMesh::Ptr mesh2)
     vnorm2.reserve(vnorm1.size() + vnorm2.size());
     vtex2.reserve(vtex1.size() + vtex2.size());
     fnorm2.reserve(fnorm1.size() + fnorm2.size());
-    faces2.reserve(faces1.size() + faces2.size());
+    fcolor2.reserve(fcolor1.size() + fcolor2.size());
 
     std::size_t const offset = verts2.size();
     verts2.insert(verts2.end(), verts1.begin(), verts1.end());
@@ -117,55 +126,101 @@ mesh_merge (TriangleMesh::ConstPtr mesh1, TriangleMesh::Ptr mesh2)
     vnorm2.insert(vnorm2.end(), vnorm1.begin(), vnorm1.end());
     vtex2.insert(vtex2.end(), vtex1.begin(), vtex1.end());
     fnorm2.insert(fnorm2.end(), fnorm1.begin(), fnorm1.end());
-
-    for (std::size_t i = 0; i < faces1.size(); ++i)
-        faces2.push_back(faces1[i] + offset);
+    fcolor2.insert(fcolor2.end(), fcolor1.begin(), fcolor1.end());
+
+    /* Offset the vertex IDs of the appended faces in parallel. */
+    std::size_t const face_offset = faces2.size();
+    faces2.resize(face_offset + faces1.size());
+    std::int64_t const num_ids = static_cast<std::int64_t>(faces1.size());
+    core::TriangleMesh::VertexID const id_offset
+        = static_cast<core::TriangleMesh::VertexID>(offset);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_ids; ++i)
+        faces2[face_offset + i] = faces1[i] + id_offset;
 }
 
 /* ---------------------------------------------------------------- */
 
-void
-mesh_components (TriangleMesh::Ptr mesh, std::size_t vertex_threshold)
+namespace
 {
-    MeshInfo mesh_info(mesh);
-    std::size_t const num_vertices = mesh->get_vertices().size();
-    std::vector<int> component_per_vertex(num_vertices, -1);
-    int current_component = 0;
-    for (std::size_t i = 0; i < num_vertices; ++i)
+    typedef std::vector<std::atomic<TriangleMesh::VertexID> > UnionFind;
+
+    /* Returns the root of the vertex and halves the path on the way. */
+    TriangleMesh::VertexID
+    union_find_root (UnionFind& parents, TriangleMesh::VertexID id)
     {
-        /* Start with a vertex that has no component yet. */
-        if (component_per_vertex[i] >= 0)
-            continue;
-
-        /* Starting from this face, collect faces and assign component ID. */
-        std::list<std::size_t> queue;
-        queue.push_back(i);
-        while (!queue.empty())
+        while (true)
         {
-            std::size_t vid = queue.front();
-            queue.pop_front();
-
-            /* Skip vertices with a componenet already assigned. */
-            if (component_per_vertex[vid] >= 0)
-                continue;
-            component_per_vertex[vid] = current_component;
+            TriangleMesh::VertexID parent = parents[id].load();
+            if (parent == id)
+                return id;
+            TriangleMesh::VertexID const grandparent = parents[parent].load();
+            if (parent != grandparent)
+                parents[id].compare_exchange_weak(parent, grandparent);
+            id = grandparent;
+        }
+    }
 
-            /* Add all adjacent vertices to queue. */
-            MeshInfo::AdjacentVertices const& adj_verts = mesh_info[vid].verts;
-            queue.insert(queue.end(), adj_verts.begin(), adj_verts.end());
+    /*
+     * Joins the sets of two vertices. The root with the larger ID is
+     * linked to the other root, which keeps the trees acyclic if several
+     * threads link concurrently.
+     */
+    void
+    union_find_join (UnionFind& parents, TriangleMesh::VertexID a,
+        TriangleMesh::VertexID b)
+    {
+        while (true)
+        {
+            a = union_find_root(parents, a);
+            b = union_find_root(parents, b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            TriangleMesh::VertexID expected = a;
+            if (parents[a].compare_exchange_strong(expected, b))
+                return;
         }
-        current_component += 1;
     }
-    mesh_info.clear();
+}  /* namespace */
+
+void
+mesh_components (TriangleMesh::Ptr mesh, std::size_t vertex_threshold)
+{
+    /* Join the vertices of every face with a concurrent union-find. */
+    TriangleMesh::FaceList const& faces = mesh->get_faces();
+    std::int64_t const num_vertices = mesh->get_vertices().size();
+    std::int64_t const num_faces = faces.size() / 3;
+    UnionFind parents(num_vertices);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_vertices; ++i)
+        parents[i].store(i, std::memory_order_relaxed);
+
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_faces; ++i)
+    {
+        union_find_join(parents, faces[i * 3 + 0], faces[i * 3 + 1]);
+        union_find_join(parents, faces[i * 3 + 1], faces[i * 3 + 2]);
+    }
 
-    /* Create a list of components and count vertices per component. */
-    std::vector<std::size_t> components_size(current_component, 0);
-    for (std::size_t i = 0; i < component_per_vertex.size(); ++i)
+    /* Count vertices per component, stored at the component root. */
+    std::vector<TriangleMesh::VertexID> component_per_vertex(num_vertices);
+    std::vector<std::atomic<std::size_t> > components_size(num_vertices);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_vertices; ++i)
+        components_size[i].store(0, std::memory_order_relaxed);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_vertices; ++i)
+    {
+        component_per_vertex[i] = union_find_root(parents, i);
         components_size[component_per_vertex[i]] += 1;
+    }
+    UnionFind().swap(parents);
 
     /* Mark vertices to be deleted if part of a small component. */
     TriangleMesh::DeleteList delete_list(num_vertices, false);
-    for (std::size_t i = 0; i < component_per_vertex.size(); ++i)
+    for (std::int64_t i = 0; i < num_vertices; ++i)
         if (components_size[component_per_vertex[i]] <= vertex_threshold)
             delete_list[i] = true;
 
@@ -268,21 +323,654 @@ mesh_delete_unreferenced (TriangleMesh::Ptr mesh)
     if (mesh == nullptr)
         throw std::invalid_argument("Null mesh given");
 
-    MeshInfo mesh_info(mesh);
-    TriangleMesh::DeleteList dlist(mesh_info.size(), false);
+    /* Unreferenced vertices are those not used by any face. */
+    TriangleMesh::FaceList const& faces = mesh->get_faces();
+    std::size_t const num_vertices = mesh->get_vertices().size();
+    TriangleMesh::DeleteList dlist(num_vertices, 1);
+    for (std::size_t i = 0; i < faces.size(); ++i)
+        dlist[faces[i]] = 0;
+
     std::size_t num_deleted = 0;
-    for (std::size_t i = 0; i < mesh_info.size(); ++i)
+    for (std::size_t i = 0; i < num_vertices; ++i)
+        num_deleted += dlist[i];
+    if (num_deleted == 0)
+        return 0;
+
+    mesh->delete_vertices_fix_faces(dlist);
+    return num_deleted;
+}
+
+/* ---------------------------------------------------------------- */
+
+namespace
+{
+    /* Symmetric 4x4 error quadric, stores the upper triangle row-wise. */
+    struct Quadric
+    {
+        Quadric (void);
+        void add_plane (math::Vec3d const& n, double d, double weight);
+        Quadric& operator+= (Quadric const& rhs);
+        double error (math::Vec3d const& p) const;
+        /* Finds the position with minimal error, false if singular. */
+        bool minimize (math::Vec3d* p) const;
+
+        double q[10];
+    };
+
+    Quadric::Quadric (void)
+    {
+        std::fill(this->q, this->q + 10, 0.0);
+    }
+
+    void
+    Quadric::add_plane (math::Vec3d const& n, double d, double weight)
+    {
+        double const p[4] = { n[0], n[1], n[2], d };
+        for (int i = 0, k = 0; i < 4; ++i)
+            for (int j = i; j < 4; ++j, ++k)
+                this->q[k] += weight * p[i] * p[j];
+    }
+
+    Quadric&
+    Quadric::operator+= (Quadric const& rhs)
+    {
+        for (int i = 0; i < 10; ++i)
+            this->q[i] += rhs.q[i];
+        return *this;
+    }
+
+    double
+    Quadric::error (math::Vec3d const& p) const
+    {
+        double const* m = this->q;
+        double const x = p[0], y = p[1], z = p[2];
+        return x * (m[0] * x + 2.0 * (m[1] * y + m[2] * z + m[3]))
+            + y * (m[4] * y + 2.0 * (m[5] * z + m[6]))
+            + z * (m[7] * z + 2.0 * m[8]) + m[9];
+    }
+
+    bool
+    Quadric::minimize (math::Vec3d* p) const
+    {
+        /* Solve A p = -b with the adjugate of the symmetric 3x3 matrix. */
+        double const* m = this->q;
+        double const c00 = m[4] * m[7] - m[5] * m[5];
+        double const c01 = m[2] * m[5] - m[1] * m[7];
+        double const c02 = m[1] * m[5] - m[2] * m[4];
+        double const c11 = m[0] * m[7] - m[2] * m[2];
+        double const c12 = m[1] * m[2] - m[0] * m[5];
+        double const c22 = m[0] * m[4] - m[1] * m[1];
+        double const det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+        double const trace = m[0] + m[4] + m[7];
+        if (!(std::abs(det) > 1e-8 * trace * trace * trace))
+            return false;
+
+        double const b[3] = { -m[3], -m[6], -m[8] };
+        (*p)[0] = (c00 * b[0] + c01 * b[1] + c02 * b[2]) / det;
+        (*p)[1] = (c01 * b[0] + c11 * b[1] + c12 * b[2]) / det;
+        (*p)[2] = (c02 * b[0] + c12 * b[1] + c22 * b[2]) / det;
+        return true;
+    }
+
+    /*
+     * Edge collapse simplification with quadric error metrics. The faces
+     * adjacent to each vertex are stored in compressed rows initialized
+     * from MeshAdjacency. A collapse of (v1, v2) into v1 appends the new
+     * row of v1 to the flat array, which is compacted if it gets too big.
+     * The heap entries store the vertex stamps at the time of insertion,
+     * and entries with outdated stamps are skipped when popped.
+     */
+    class QuadricDecimator
+    {
+    public:
+        typedef TriangleMesh::VertexID VertexID;
+        typedef MeshAdjacency::FaceID FaceID;
+
+        explicit QuadricDecimator (TriangleMesh::Ptr mesh);
+        std::size_t decimate (std::size_t num_faces);
+
+    private:
+        struct Collapse
+        {
+            double cost;
+            VertexID v1;
+            VertexID v2;
+            unsigned int stamp1;
+            unsigned int stamp2;
+        };
+
+        struct CollapseGreater
+        {
+            bool operator() (Collapse const& a, Collapse const& b) const
+            { return a.cost > b.cost; }
+        };
+
+        math::Vec3d position (VertexID vid) const;
+        math::Vec3d face_normal (FaceID fid) const;
+        Collapse make_collapse (VertexID v1, VertexID v2) const;
+        double collapse_cost (VertexID v1, VertexID v2,
+            math::Vec3d* pos) const;
+        void collect_faces (VertexID vid, std::vector<FaceID>* result) const;
+        void collect_neighbors (std::vector<FaceID> const& face_ids,
+            VertexID vid, std::vector<VertexID>* result) const;
+        bool collapse (VertexID v1, VertexID v2, math::Vec3d const& pos);
+        void compact_refs (void);
+        void finalize (void);
+
+    private:
+        TriangleMesh::Ptr mesh;
+        std::vector<Quadric> quadrics;
+        std::vector<unsigned int> stamps;
+        std::vector<char> boundary;
+        std::vector<char> vertex_deleted;
+        std::vector<char> face_deleted;
+        std::size_t num_faces;
+
+        std::vector<std::size_t> ref_offsets;
+        std::vector<unsigned int> ref_sizes;
+        std::vector<FaceID> refs;
+        std::size_t max_refs;
+        std::vector<Collapse> heap;
+
+        /* Temporary storage for the collapses. */
+        std::vector<FaceID> faces1, faces2;
+        std::vector<VertexID> neighbors1, neighbors2, common;
+    };
+
+    QuadricDecimator::QuadricDecimator (TriangleMesh::Ptr mesh)
+        : mesh(mesh)
     {
-        if (mesh_info[i].vclass == MeshInfo::VERTEX_CLASS_UNREF)
+        TriangleMesh::FaceList const& faces(mesh->get_faces());
+        std::int64_t const num_verts = mesh->get_vertices().size();
+        MeshAdjacency adjacency(mesh);
+
+        this->num_faces = faces.size() / 3;
+        this->stamps.resize(num_verts, 0);
+        this->boundary.resize(num_verts, 0);
+        this->vertex_deleted.resize(num_verts, 0);
+        this->face_deleted.resize(this->num_faces, 0);
+
+        /* Copy the adjacent faces into the compressed rows. */
+        this->ref_offsets.resize(num_verts + 1, 0);
+        this->ref_sizes.resize(num_verts);
+        for (std::int64_t i = 0; i < num_verts; ++i)
+        {
+            this->ref_sizes[i] = adjacency.get_num_faces(i);
+            this->ref_offsets[i + 1] = this->ref_offsets[i]
+                + this->ref_sizes[i];
+        }
+        this->refs.resize(this->ref_offsets.back());
+        this->max_refs = 2 * this->refs.size();
+#pragma omp parallel for schedule(static)
+        for (std::int64_t i = 0; i < num_verts; ++i)
+        {
+            FaceID const* fids = adjacency.get_faces(i);
+            std::copy(fids, fids + this->ref_sizes[i],
+                this->refs.begin() + this->ref_offsets[i]);
+            this->boundary[i] = adjacency.get_vertex_class(i)
+                != MeshInfo::VERTEX_CLASS_SIMPLE;
+        }
+
+        /*
+         * The quadric of a vertex sums the area weighted planes of the
+         * adjacent faces, and planes perpendicular to the adjacent faces
+         * through the boundary edges, weighted by the squared edge length.
+         */
+        double const boundary_weight = 1000.0;
+        this->quadrics.resize(num_verts);
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (std::int64_t i = 0; i < num_verts; ++i)
+        {
+            math::Vec3d const pi = this->position(i);
+            std::size_t const nf = adjacency.get_num_faces(i);
+            FaceID const* fids = adjacency.get_faces(i);
+            for (std::size_t j = 0; j < nf; ++j)
+            {
+                math::Vec3d normal = this->face_normal(fids[j]);
+                double const area = normal.norm() / 2.0;
+                if (area <= 0.0)
+                    continue;
+                normal /= 2.0 * area;
+                this->quadrics[i].add_plane(normal, -normal.dot(pi), area);
+                if (!this->boundary[i])
+                    continue;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    VertexID const vj = faces[fids[j] * 3 + k];
+                    if (vj == static_cast<VertexID>(i))
+                        continue;
+                    int num_shared = 0;
+                    for (std::size_t l = 0; l < nf; ++l)
+                        for (int m = 0; m < 3; ++m)
+                            if (faces[fids[l] * 3 + m] == vj)
+                                num_shared += 1;
+                    if (num_shared != 1)
+                        continue;
+                    math::Vec3d const edge = this->position(vj) - pi;
+                    math::Vec3d bnormal = edge.cross(normal);
+                    double const len = bnormal.norm();
+                    if (len <= 0.0)
+                        continue;
+                    bnormal /= len;
+                    this->quadrics[i].add_plane(bnormal, -bnormal.dot(pi),
+                        boundary_weight * edge.square_norm());
+                }
+            }
+        }
+
+        /* Initialize the heap with all edges of the mesh. */
+        std::vector<std::size_t> edge_offsets(num_verts + 1, 0);
+        for (std::int64_t i = 0; i < num_verts; ++i)
+        {
+            std::size_t const nv = adjacency.get_num_vertices(i);
+            VertexID const* vids = adjacency.get_vertices(i);
+            std::size_t num_edges = 0;
+            for (std::size_t j = 0; j < nv; ++j)
+                if (vids[j] > static_cast<VertexID>(i))
+                    num_edges += 1;
+            edge_offsets[i + 1] = edge_offsets[i] + num_edges;
+        }
+        this->heap.resize(edge_offsets.back());
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (std::int64_t i = 0; i < num_verts; ++i)
         {
-            dlist[i] = true;
-            num_deleted += 1;
+            std::size_t const nv = adjacency.get_num_vertices(i);
+            VertexID const* vids = adjacency.get_vertices(i);
+            std::size_t pos = edge_offsets[i];
+            for (std::size_t j = 0; j < nv; ++j)
+                if (vids[j] > static_cast<VertexID>(i))
+                    this->heap[pos++] = this->make_collapse(i, vids[j]);
         }
+        std::make_heap(this->heap.begin(), this->heap.end(),
+            CollapseGreater());
     }
 
-    mesh->delete_vertices_fix_faces(dlist);
-    return num_deleted;
+    inline math::Vec3d
+    QuadricDecimator::position (VertexID vid) const
+    {
+        return math::Vec3d(this->mesh->get_vertices()[vid]);
+    }
+
+    inline math::Vec3d
+    QuadricDecimator::face_normal (FaceID fid) const
+    {
+        VertexID const* vid = &this->mesh->get_faces()[fid * 3];
+        math::Vec3d const a = this->position(vid[0]);
+        return (this->position(vid[1]) - a).cross(this->position(vid[2]) - a);
+    }
+
+    QuadricDecimator::Collapse
+    QuadricDecimator::make_collapse (VertexID v1, VertexID v2) const
+    {
+        Collapse collapse;
+        math::Vec3d pos;
+        collapse.cost = this->collapse_cost(v1, v2, &pos);
+        collapse.v1 = v1;
+        collapse.v2 = v2;
+        collapse.stamp1 = this->stamps[v1];
+        collapse.stamp2 = this->stamps[v2];
+        return collapse;
+    }
+
+    double
+    QuadricDecimator::collapse_cost (VertexID v1, VertexID v2,
+        math::Vec3d* pos) const
+    {
+        Quadric q = this->quadrics[v1];
+        q += this->quadrics[v2];
+
+        /* Use the optimal position unless it is far off the edge. */
+        math::Vec3d const p1 = this->position(v1);
+        math::Vec3d const p2 = this->position(v2);
+        math::Vec3d const mid = (p1 + p2) / 2.0;
+        if (q.minimize(pos)
+            && (*pos - mid).square_norm() <= (p2 - p1).square_norm())
+            return std::max(0.0, q.error(*pos));
+
+        math::Vec3d const candidates[3] = { p1, p2, mid };
+        double best_cost = std::numeric_limits<double>::max();
+        for (int i = 0; i < 3; ++i)
+        {
+            double const cost = q.error(candidates[i]);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                *pos = candidates[i];
+            }
+        }
+        return std::max(0.0, best_cost);
+    }
+
+    void
+    QuadricDecimator::collect_faces (VertexID vid,
+        std::vector<FaceID>* result) const
+    {
+        result->clear();
+        FaceID const* fids = &this->refs[this->ref_offsets[vid]];
+        for (std::size_t i = 0; i < this->ref_sizes[vid]; ++i)
+            if (!this->face_deleted[fids[i]])
+                result->push_back(fids[i]);
+    }
+
+    void
+    QuadricDecimator::collect_neighbors (std::vector<FaceID> const& face_ids,
+        VertexID vid, std::vector<VertexID>* result) const
+    {
+        TriangleMesh::FaceList const& faces(this->mesh->get_faces());
+        result->clear();
+        for (std::size_t i = 0; i < face_ids.size(); ++i)
+            for (int j = 0; j < 3; ++j)
+                if (faces[face_ids[i] * 3 + j] != vid)
+                    result->push_back(faces[face_ids[i] * 3 + j]);
+        std::sort(result->begin(), result->end());
+        result->erase(std::unique(result->begin(), result->end()),
+            result->end());
+    }
+
+    bool
+    QuadricDecimator::collapse (VertexID v1, VertexID v2,
+        math::Vec3d const& pos)
+    {
+        TriangleMesh::FaceList& faces(this->mesh->get_faces());
+        this->collect_faces(v1, &this->faces1);
+        this->collect_faces(v2, &this->faces2);
+
+        /* Count the faces adjacent to the edge. */
+        std::size_t num_shared = 0;
+        for (std::size_t i = 0; i < this->faces1.size(); ++i)
+        {
+            VertexID const* vid = &faces[this->faces1[i] * 3];
+            if (vid[0] == v2 || vid[1] == v2 || vid[2] == v2)
+                num_shared += 1;
+        }
+        if (num_shared == 0)
+            return false;
+
+        /* Do not pinch the mesh by collapsing an inner edge of a boundary. */
+        if (this->boundary[v1] && this->boundary[v2] && num_shared != 1)
+            return false;
+
+        /*
+         * Link condition: The common neighbors of the vertices must be the
+         * opposite vertices of the edge faces, otherwise the collapse
+         * creates non-manifold edges.
+         */
+        this->collect_neighbors(this->faces1, v1, &this->neighbors1);
+        this->collect_neighbors(this->faces2, v2, &this->neighbors2);
+        this->common.clear();
+        std::set_intersection(this->neighbors1.begin(), this->neighbors1.end(),
+            this->neighbors2.begin(), this->neighbors2.end(),
+            std::back_inserter(this->common));
+        if (this->common.size() != num_shared)
+            return false;
+
+        /* Reject collapses that flip or degenerate the remaining faces. */
+        for (int i = 0; i < 2; ++i)
+        {
+            std::vector<FaceID> const& fids(i == 0
+                ? this->faces1 : this->faces2);
+            VertexID const other = i == 0 ? v2 : v1;
+            for (std::size_t j = 0; j < fids.size(); ++j)
+            {
+                VertexID const* vid = &faces[fids[j] * 3];
+                if (vid[0] == other || vid[1] == other || vid[2] == other)
+                    continue;
+                math::Vec3d p[3];
+                for (int k = 0; k < 3; ++k)
+                    p[k] = (vid[k] == v1 || vid[k] == v2)
+                        ? pos : this->position(vid[k]);
+                math::Vec3d const n_old = this->face_normal(fids[j]);
+                math::Vec3d const n_new = (p[1] - p[0]).cross(p[2] - p[0]);
+                double const dot = n_old.dot(n_new);
+                if (dot <= 0.2 * n_old.norm() * n_new.norm())
+                    return false;
+            }
+        }
+
+        /* Delete the edge faces and move the faces of v2 to v1. */
+        std::size_t const new_offset = this->refs.size();
+        for (std::size_t i = 0; i < this->faces1.size(); ++i)
+        {
+            VertexID const* vid = &faces[this->faces1[i] * 3];
+            if (vid[0] == v2 || vid[1] == v2 || vid[2] == v2)
+                this->face_deleted[this->faces1[i]] = 1;
+            else
+                this->refs.push_back(this->faces1[i]);
+        }
+        for (std::size_t i = 0; i < this->faces2.size(); ++i)
+        {
+            if (this->face_deleted[this->faces2[i]])
+                continue;
+            VertexID* vid = &faces[this->faces2[i] * 3];
+            for (int j = 0; j < 3; ++j)
+                if (vid[j] == v2)
+                    vid[j] = v1;
+            this->refs.push_back(this->faces2[i]);
+        }
+        this->num_faces -= num_shared;
+        this->ref_offsets[v1] = new_offset;
+        this->ref_sizes[v1] = this->refs.size() - new_offset;
+        this->ref_sizes[v2] = 0;
+
+        this->mesh->get_vertices()[v1] = math::Vec3f(pos);
+        this->quadrics[v1] += this->quadrics[v2];
+        this->boundary[v1] = this->boundary[v1] || this->boundary[v2];
+        this->vertex_deleted[v2] = 1;
+        this->stamps[v1] += 1;
+
+        /* Insert the new edges of v1. */
+        this->neighbors1.insert(this->neighbors1.end(),
+            this->neighbors2.begin(), this->neighbors2.end());
+        std::sort(this->neighbors1.begin(), this->neighbors1.end());
+        this->neighbors1.erase(std::unique(this->neighbors1.begin(),
+            this->neighbors1.end()), this->neighbors1.end());
+        for (std::size_t i = 0; i < this->neighbors1.size(); ++i)
+        {
+            VertexID const vid = this->neighbors1[i];
+            if (vid == v1 || vid == v2)
+                continue;
+            this->heap.push_back(this->make_collapse(v1, vid));
+            std::push_heap(this->heap.begin(), this->heap.end(),
+                CollapseGreater());
+        }
+
+        if (this->refs.size() > this->max_refs)
+            this->compact_refs();
+        return true;
+    }
+
+    void
+    QuadricDecimator::compact_refs (void)
+    {
+        std::vector<FaceID> new_refs;
+        new_refs.reserve(this->max_refs / 2);
+        for (std::size_t i = 0; i < this->ref_sizes.size(); ++i)
+        {
+            std::size_t const offset = new_refs.size();
+            FaceID const* fids = &this->refs[this->ref_offsets[i]];
+            for (std::size_t j = 0; j < this->ref_sizes[i]; ++j)
+                if (!this->face_deleted[fids[j]])
+                    new_refs.push_back(fids[j]);
+            this->ref_offsets[i] = offset;
+            this->ref_sizes[i] = new_refs.size() - offset;
+        }
+        std::swap(this->refs, new_refs);
+        this->max_refs = std::max(this->max_refs, 2 * this->refs.size());
+    }
+
+    std::size_t
+    QuadricDecimator::decimate (std::size_t num_faces)
+    {
+        std::size_t num_collapsed = 0;
+        while (this->num_faces > num_faces && !this->heap.empty())
+        {
+            std::pop_heap(this->heap.begin(), this->heap.end(),
+                CollapseGreater());
+            Collapse const c = this->heap.back();
+            this->heap.pop_back();
+            if (this->vertex_deleted[c.v1] || this->vertex_deleted[c.v2]
+                || this->stamps[c.v1] != c.stamp1
+                || this->stamps[c.v2] != c.stamp2)
+                continue;
+
+            math::Vec3d pos;
+            this->collapse_cost(c.v1, c.v2, &pos);
+            if (this->collapse(c.v1, c.v2, pos))
+                num_collapsed += 1;
+        }
+        this->finalize();
+        return num_collapsed;
+    }
+
+    void
+    QuadricDecimator::finalize (void)
+    {
+        /* Compact the faces and face colors in order. */
+        TriangleMesh::FaceList& faces(this->mesh->get_faces());
+        TriangleMesh::ColorList& fcolors(this->mesh->get_face_colors());
+        bool const has_face_colors = this->mesh->has_face_colors();
+        std::size_t num_kept = 0;
+        for (std::size_t i = 0; i < this->face_deleted.size(); ++i)
+        {
+            if (this->face_deleted[i])
+                continue;
+            std::copy(faces.begin() + i * 3, faces.begin() + i * 3 + 3,
+                faces.begin() + num_kept * 3);
+            if (has_face_colors)
+                fcolors[num_kept] = fcolors[i];
+            num_kept += 1;
+        }
+        faces.resize(num_kept * 3);
+        if (has_face_colors)
+            fcolors.resize(num_kept);
+
+        /* Delete the collapsed vertices with their attributes. */
+        bool const face_normals = this->mesh->has_face_normals();
+        bool const vertex_normals = this->mesh->has_vertex_normals();
+        TriangleMesh::DeleteList dlist(this->vertex_deleted.begin(),
+            this->vertex_deleted.end());
+        this->mesh->delete_vertices_fix_faces(dlist);
+        if (face_normals || vertex_normals)
+            this->mesh->recalc_normals(face_normals, vertex_normals);
+    }
+}  /* namespace */
+
+std::size_t
+mesh_decimate (TriangleMesh::Ptr mesh, std::size_t num_faces)
+{
+    if (mesh == nullptr)
+        throw std::invalid_argument("Null mesh given");
+    if (mesh->get_faces().size() / 3 <= num_faces)
+        return 0;
+
+    QuadricDecimator decimator(mesh);
+    return decimator.decimate(num_faces);
+}
+
+/* ---------------------------------------------------------------- */
+
+namespace
+{
+    /* Spreads the lower 21 bits of the value to every third bit. */
+    uint64_t
+    morton_spread (uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x001f00000000ffffULL;
+        v = (v | v << 16) & 0x001f0000ff0000ffULL;
+        v = (v | v << 8) & 0x100f00f00f00f00fULL;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+        v = (v | v << 2) & 0x1249249249249249ULL;
+        return v;
+    }
+
+    /* Reorders the list such that 'list[i]' becomes 'old[order[i]]'. */
+    template <typename T>
+    void
+    permute_list (std::vector<std::size_t> const& order, std::vector<T>* list)
+    {
+        std::vector<T> permuted;
+        permuted.reserve(list->size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            permuted.push_back((*list)[order[i]]);
+        std::swap(*list, permuted);
+    }
+}  /* namespace */
+
+void
+mesh_reorder (TriangleMesh::Ptr mesh)
+{
+    if (mesh == nullptr)
+        throw std::invalid_argument("Null mesh given");
+
+    TriangleMesh::VertexList& verts(mesh->get_vertices());
+    TriangleMesh::FaceList& faces(mesh->get_faces());
+    if (verts.empty())
+        return;
+
+    /* Quantize the positions to 21 bits per axis within the AABB. */
+    math::Vec3f aabb_min, aabb_max;
+    mesh_find_aabb(mesh, aabb_min, aabb_max);
+    float const extent = (aabb_max - aabb_min).maximum();
+    float const scale = extent > 0.0f ? 2097151.0f / extent : 0.0f;
+    std::vector<uint64_t> codes(verts.size());
+    for (std::size_t i = 0; i < verts.size(); ++i)
+    {
+        math::Vec3f const pos = (verts[i] - aabb_min) * scale;
+        codes[i] = morton_spread(static_cast<uint64_t>(pos[0]))
+            | morton_spread(static_cast<uint64_t>(pos[1])) << 1
+            | morton_spread(static_cast<uint64_t>(pos[2])) << 2;
+    }
+
+    /* Sort the vertices by code, equal codes keep their order. */
+    std::vector<std::size_t> vorder(verts.size());
+    for (std::size_t i = 0; i < vorder.size(); ++i)
+        vorder[i] = i;
+    std::stable_sort(vorder.begin(), vorder.end(),
+        [&codes] (std::size_t a, std::size_t b)
+        { return codes[a] < codes[b]; });
+    std::vector<TriangleMesh::VertexID> new_ids(verts.size());
+    for (std::size_t i = 0; i < vorder.size(); ++i)
+        new_ids[vorder[i]] = static_cast<TriangleMesh::VertexID>(i);
+
+    if (mesh->has_vertex_normals())
+        permute_list(vorder, &mesh->get_vertex_normals());
+    if (mesh->has_vertex_colors())
+        permute_list(vorder, &mesh->get_vertex_colors());
+    if (mesh->has_vertex_confidences())
+        permute_list(vorder, &mesh->get_vertex_confidences());
+    if (mesh->has_vertex_values())
+        permute_list(vorder, &mesh->get_vertex_values());
+    if (mesh->has_vertex_texcoords())
+        permute_list(vorder, &mesh->get_vertex_texcoords());
+    permute_list(vorder, &verts);
+
+    /* Sort the faces by their smallest new vertex index. */
+    std::size_t const num_faces = faces.size() / 3;
+    std::vector<TriangleMesh::VertexID> face_keys(num_faces);
+    for (std::size_t i = 0; i < faces.size(); ++i)
+        faces[i] = new_ids[faces[i]];
+    for (std::size_t i = 0; i < num_faces; ++i)
+        face_keys[i] = std::min(faces[i * 3 + 0],
+            std::min(faces[i * 3 + 1], faces[i * 3 + 2]));
+    std::vector<std::size_t> forder(num_faces);
+    for (std::size_t i = 0; i < num_faces; ++i)
+        forder[i] = i;
+    std::stable_sort(forder.begin(), forder.end(),
+        [&face_keys] (std::size_t a, std::size_t b)
+        { return face_keys[a] < face_keys[b]; });
+
+    TriangleMesh::FaceList sorted_faces(faces.size());
+    for (std::size_t i = 0; i < num_faces; ++i)
+        for (int j = 0; j < 3; ++j)
+            sorted_faces[i * 3 + j] = faces[forder[i] * 3 + j];
+    std::swap(faces, sorted_faces);
+    if (mesh->has_face_normals())
+        permute_list(forder, &mesh->get_face_normals());
+    if (mesh->has_face_colors())
+        permute_list(forder, &mesh->get_face_colors());
 }
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
@@ -7,16 +7,16 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_MESH_TOOLS_HEADER
-#define MVE_MESH_TOOLS_HEADER
+#ifndef CORE_MESH_TOOLS_HEADER
+#define CORE_MESH_TOOLS_HEADER
 
 #include "math/vector.h"
 #include "math/matrix.h"
-#include "mve/defines.h"
-#include "mve/mesh.h"
+#include "core/defines.h"
+#include "core/mesh.h"
 
-MVE_NAMESPACE_BEGIN
-MVE_GEOM_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
+CORE_GEOM_NAMESPACE_BEGIN
 
 /**
  * Transforms the vertices and normals of the mesh using the
@@ -80,7 +80,33 @@ mesh_find_aabb (TriangleMesh::ConstPtr mesh,
 std::size_t
 mesh_delete_unreferenced (TriangleMesh::Ptr mesh);
 
-MVE_GEOM_NAMESPACE_END
-MVE_NAMESPACE_END
+/**
+ * Simplifies the mesh to at most 'num_faces' faces by edge collapses.
+ * The collapse costs are the quadric error metrics of Garland and
+ * Heckbert, with additional quadrics that keep boundaries in place. The
+ * edges are collapsed in the order of increasing cost using a binary heap
+ * with lazily invalidated entries. Collapses that change the topology or
+ * flip faces are rejected, so decimation stops early if no valid collapse
+ * remains. The collapsed vertices are deleted with their attributes, the
+ * order of the remaining vertices and faces is preserved, and normals are
+ * recomputed if present. Simplification is IN-PLACE. Returns the amount
+ * of collapsed edges.
+ */
+std::size_t
+mesh_decimate (TriangleMesh::Ptr mesh, std::size_t num_faces);
+
+/**
+ * Reorders the vertices and faces of the mesh for memory locality.
+ * The vertices are sorted along the Morton (Z-order) curve of their
+ * positions in the bounding box, so that vertices close in space are
+ * close in memory. The faces are then sorted by their smallest vertex
+ * index. All vertex and face attributes are permuted accordingly, and the
+ * faces keep their orientation. Reordering is IN-PLACE.
+ */
+void
+mesh_reorder (TriangleMesh::Ptr mesh);
+
+CORE_GEOM_NAMESPACE_END
+CORE_NAMESPACE_END
 
-#endif /* MVE_MESH_TOOLS_HEADER */
+#endif /* CORE_MESH_TOOLS_HEADER */
@@ -0,0 +1,601 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "util/profiler.h"
+#include "math/defines.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+#include "core/image_tools.h"
+#include "core/patchmatch_stereo.h"
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /* The cost of hypotheses that cannot be evaluated. */
+    float const MAX_COST = 2.0f;
+    /* Planes at grazing angles to the viewing ray are not considered. */
+    float const MIN_NORMAL_DOT = 0.1f;
+
+    /*
+     * A neighbor view. The homography of the plane n * x = c in reference
+     * camera coordinates is H = A + a * (Kr^-T n / c)^T, which maps the
+     * reference pixels to neighbor pixels.
+     */
+    struct NeighborView
+    {
+        FloatImage::ConstPtr image;
+        math::Matrix3f mat;
+        math::Vec3f vec;
+    };
+
+    /* A plane hypothesis with the depth along the viewing ray. */
+    struct Plane
+    {
+        math::Vec3f normal;
+        float depth;
+    };
+
+    /* The maximum number of planes evaluated at once. */
+    int const MAX_PLANES = 8;
+
+    /*
+     * The evaluation of plane hypotheses for one pixel of the reference
+     * view. The window of the reference is normalized once, and the
+     * windows of the neighbors are correlated for all planes at once.
+     */
+    class PixelCost
+    {
+    public:
+        PixelCost (std::vector<NeighborView> const& neighbors,
+            math::Matrix3f const& inv_calib, int radius, int step);
+
+        /* Loads the reference window, returns false if untextured. */
+        bool set_pixel (FloatImage const& reference,
+            FloatImage const& statistics, int x, int y);
+        /* Returns the viewing ray of the pixel. */
+        math::Vec3f const& get_ray (void) const;
+        /*
+         * Stores the averaged costs of the best half of the neighbors for
+         * at most MAX_PLANES planes.
+         */
+        void evaluate (Plane const* planes, int num_planes, float* costs);
+
+    private:
+        std::vector<NeighborView> const& neighbors;
+        math::Matrix3f inv_calib;
+        int radius;
+        int step;
+        float center[2 * MAX_PLANES];
+        math::Vec3f ray;
+        std::vector<float> values;
+        std::vector<float> homographies;
+        std::vector<float> nccs;
+        std::vector<float> neighbor_costs;
+    };
+
+    PixelCost::PixelCost (std::vector<NeighborView> const& neighbors,
+        math::Matrix3f const& inv_calib, int radius, int step)
+        : neighbors(neighbors)
+        , inv_calib(inv_calib)
+        , radius(radius)
+        , step(step)
+        , homographies(9 * MAX_PLANES)
+        , nccs(MAX_PLANES * neighbors.size())
+        , neighbor_costs(neighbors.size())
+    {
+        int const samples = 2 * (radius / step) + 1;
+        this->values.resize(samples * samples);
+    }
+
+    bool
+    PixelCost::set_pixel (FloatImage const& reference,
+        FloatImage const& statistics, int x, int y)
+    {
+        if (!image::ncc_window(reference, statistics, x, y, this->radius,
+            this->step, &this->values[0]))
+            return false;
+
+        /* Pixel centers are at half-integer image plane coordinates. */
+        for (int i = 0; i < MAX_PLANES; ++i)
+        {
+            this->center[2 * i + 0] = static_cast<float>(x) + 0.5f;
+            this->center[2 * i + 1] = static_cast<float>(y) + 0.5f;
+        }
+        this->ray = this->inv_calib.mult(math::Vec3f(this->center[0],
+            this->center[1], 1.0f)).normalized();
+        return true;
+    }
+
+    inline math::Vec3f const&
+    PixelCost::get_ray (void) const
+    {
+        return this->ray;
+    }
+
+    void
+    PixelCost::evaluate (Plane const* planes, int num_planes, float* costs)
+    {
+        /* The planes n * x = c through the points on the ray. */
+        int valid[MAX_PLANES];
+        math::Vec3f plane_vecs[MAX_PLANES];
+        int num_valid = 0;
+        math::Matrix3f const inv_calib_t = this->inv_calib.transposed();
+        for (int i = 0; i < num_planes; ++i)
+        {
+            costs[i] = MAX_COST;
+            float const c = planes[i].normal.dot(this->ray) * planes[i].depth;
+            if (c > -1e-8f)
+                continue;
+            plane_vecs[num_valid] = inv_calib_t.mult(planes[i].normal) / c;
+            valid[num_valid++] = i;
+        }
+        if (num_valid == 0)
+            return;
+
+        for (std::size_t n = 0; n < this->neighbors.size(); ++n)
+        {
+            NeighborView const& neighbor = this->neighbors[n];
+            for (int i = 0; i < num_valid; ++i)
+            {
+                float* h = &this->homographies[9 * i];
+                for (int r = 0; r < 3; ++r)
+                    for (int c = 0; c < 3; ++c)
+                        h[r * 3 + c] = neighbor.mat(r, c)
+                            + neighbor.vec[r] * plane_vecs[i][c];
+            }
+            image::warped_ncc(*neighbor.image, this->radius, this->step,
+                &this->values[0], 0, this->center, &this->homographies[0],
+                num_valid, &this->nccs[n * MAX_PLANES]);
+        }
+
+        int const num_best = static_cast<int>(this->neighbors.size() + 1) / 2;
+        for (int i = 0; i < num_valid; ++i)
+        {
+            for (std::size_t n = 0; n < this->neighbors.size(); ++n)
+                this->neighbor_costs[n] = 1.0f
+                    - this->nccs[n * MAX_PLANES + i];
+            std::partial_sort(this->neighbor_costs.begin(),
+                this->neighbor_costs.begin() + num_best,
+                this->neighbor_costs.end());
+            float sum = 0.0f;
+            for (int j = 0; j < num_best; ++j)
+                sum += this->neighbor_costs[j];
+            costs[valid[i]] = sum / static_cast<float>(num_best);
+        }
+    }
+
+    /* ---------------------------------------------------------------- */
+
+    /* Returns a random normal facing the camera along the ray. */
+    math::Vec3f
+    random_normal (math::Vec3f const& ray, std::mt19937* prng)
+    {
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        while (true)
+        {
+            math::Vec3f normal;
+            for (int i = 0; i < 3; ++i)
+                normal[i] = dist(*prng);
+            float const norm = normal.norm();
+            if (norm < 1e-6f)
+                continue;
+            normal /= norm;
+            float const dot = normal.dot(ray);
+            if (dot > 0.0f)
+                normal = -normal;
+            if (std::abs(dot) >= MIN_NORMAL_DOT)
+                return normal;
+        }
+    }
+
+    /* Returns the normal randomly rotated by up to about 'amount'. */
+    math::Vec3f
+    perturb_normal (math::Vec3f const& normal, math::Vec3f const& ray,
+        float amount, std::mt19937* prng)
+    {
+        std::uniform_real_distribution<float> dist(-amount, amount);
+        math::Vec3f result = normal;
+        for (int i = 0; i < 3; ++i)
+            result[i] += dist(*prng);
+        result.normalize();
+
+        /* Normals facing away are mirrored at the ray. */
+        float const dot = result.dot(ray);
+        if (dot > 0.0f)
+            result -= ray * (2.0f * dot);
+        return result;
+    }
+
+    /* Returns the depth where the ray intersects the plane of a pixel. */
+    float
+    propagate_depth (Plane const& plane, math::Vec3f const& plane_ray,
+        math::Vec3f const& ray)
+    {
+        float const dot = plane.normal.dot(ray);
+        if (dot > -MIN_NORMAL_DOT)
+            return 0.0f;
+        return plane.normal.dot(plane_ray) * plane.depth / dot;
+    }
+
+    /* Replaces the best plane by a candidate with a lower cost. */
+    void
+    select_best (Plane const* candidates, float const* costs,
+        int num_candidates, Plane* best, float* best_cost)
+    {
+        for (int i = 0; i < num_candidates; ++i)
+            if (costs[i] < *best_cost)
+            {
+                *best = candidates[i];
+                *best_cost = costs[i];
+            }
+    }
+
+    /* Returns a random seed for the pixels of one row and pass. */
+    unsigned int
+    row_seed (unsigned int seed, std::size_t view_id, int pass, int y)
+    {
+        std::seed_seq seq({ seed, static_cast<unsigned int>(view_id),
+            static_cast<unsigned int>(pass), static_cast<unsigned int>(y) });
+        unsigned int result = 0;
+        seq.generate(&result, &result + 1);
+        return result;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+PatchMatchStereo::compute (Scene::Ptr scene,
+    util::StageControl const& control)
+{
+    Bundle::ConstPtr bundle = scene->get_bundle();
+    BundleIndex index;
+    index.build(*bundle);
+
+    std::vector<std::size_t> view_ids;
+    Scene::ViewList& views = scene->get_views();
+    for (std::size_t i = 0; i < views.size(); ++i)
+        if (views[i] != nullptr && views[i]->is_camera_valid()
+            && views[i]->has_image(this->opts.image_name))
+            view_ids.push_back(i);
+
+    for (std::size_t i = 0; i < view_ids.size(); ++i)
+    {
+        control.check_cancelled("Depth map computation cancelled");
+        control.report(i, view_ids.size());
+
+        /* The images of the next view are loaded in the background. */
+        if (i + 1 < view_ids.size())
+        {
+            ViewList next = this->select_neighbors(views, *bundle, index,
+                view_ids[i + 1]);
+            std::vector<int> prefetch_ids(1, view_ids[i + 1]);
+            prefetch_ids.insert(prefetch_ids.end(), next.begin(), next.end());
+            scene->prefetch(prefetch_ids, this->opts.image_name);
+        }
+
+        if (this->opts.verbose_output)
+            std::cout << "Computing depth map for view " << view_ids[i]
+                << "..." << std::endl;
+        if (!this->compute_view(scene, index, view_ids[i])
+            && this->opts.verbose_output)
+            std::cout << "  Skipping view " << view_ids[i]
+                << " without neighbors or depth range." << std::endl;
+    }
+    control.report(view_ids.size(), view_ids.size());
+}
+
+/* ---------------------------------------------------------------- */
+
+PatchMatchStereo::ViewList
+PatchMatchStereo::select_neighbors (Scene::ViewList const& views,
+    Bundle const& bundle, BundleIndex const& index,
+    std::size_t view_id) const
+{
+    if (view_id >= index.get_num_cameras() || view_id >= views.size()
+        || views[view_id] == nullptr)
+        return ViewList();
+
+    std::vector<math::Vec3f> centers(views.size());
+    for (std::size_t i = 0; i < views.size(); ++i)
+        if (views[i] != nullptr && views[i]->is_camera_valid())
+            views[i]->get_camera().fill_camera_pos(*centers[i]);
+
+    /* Shared points are weighted down for small triangulation angles. */
+    float const min_angle = MATH_DEG2RAD(this->opts.min_triangulation_angle);
+    std::vector<float> scores(views.size(), 0.0f);
+    std::vector<int> counts(views.size(), 0);
+    BundleIndex::FeatureList const& features
+        = index.get_visible_features(view_id);
+    for (std::size_t i = 0; i < features.size(); ++i)
+    {
+        math::Vec3f const& pos = bundle.get_feature_positions()[features[i]];
+        math::Vec3f const dir = (pos - centers[view_id]).normalized();
+        Bundle::Feature2D const* refs = bundle.get_feature_refs(features[i]);
+        std::size_t const num_refs = bundle.get_num_feature_refs(features[i]);
+        for (std::size_t j = 0; j < num_refs; ++j)
+        {
+            std::size_t const other = static_cast<std::size_t>(
+                refs[j].view_id);
+            if (other == view_id || other >= views.size()
+                || views[other] == nullptr || !views[other]->is_camera_valid())
+                continue;
+            math::Vec3f const other_dir = (pos - centers[other]).normalized();
+            float const angle = std::acos(std::max(-1.0f,
+                std::min(1.0f, dir.dot(other_dir))));
+            scores[other] += MATH_POW2(std::min(1.0f, angle / min_angle));
+            counts[other] += 1;
+        }
+    }
+
+    ViewList result;
+    for (std::size_t i = 0; i < views.size(); ++i)
+        if (counts[i] >= this->opts.min_shared_points && scores[i] > 0.0f)
+            result.push_back(i);
+    std::stable_sort(result.begin(), result.end(),
+        [&scores] (std::size_t a, std::size_t b)
+        { return scores[a] > scores[b]; });
+    if (result.size() > static_cast<std::size_t>(this->opts.num_neighbors))
+        result.resize(this->opts.num_neighbors);
+    return result;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+PatchMatchStereo::compute_view (Scene::Ptr scene, BundleIndex const& index,
+    std::size_t view_id)
+{
+    UTIL_PROFILE_SCOPE("PatchMatchStereo::compute_view");
+    if (this->opts.window_radius < 1 || this->opts.window_step < 1
+        || this->opts.window_step > this->opts.window_radius)
+        throw std::invalid_argument("Invalid correlation window");
+
+    Bundle::ConstPtr bundle = scene->get_bundle();
+    Scene::ViewList& views = scene->get_views();
+    if (view_id >= views.size() || views[view_id] == nullptr
+        || !views[view_id]->is_camera_valid())
+        throw std::invalid_argument("Invalid view ID");
+
+    View::Ptr view = views[view_id];
+    ByteImage::Ptr ref_byte_image = view->get_byte_image(
+        this->opts.image_name);
+    if (ref_byte_image == nullptr)
+        throw std::invalid_argument("View without input image");
+    FloatImage::Ptr ref_image = image::byte_to_float_grayscale(
+        ref_byte_image, image::DESATURATE_AVERAGE);
+    int const width = ref_image->width();
+    int const height = ref_image->height();
+
+    CameraInfo const& ref_camera = view->get_camera();
+    math::Matrix3f ref_inv_calib, ref_rot;
+    ref_camera.fill_inverse_calibration(*ref_inv_calib, width, height);
+    ref_camera.fill_world_to_cam_rot(*ref_rot);
+    math::Vec3f ref_trans;
+    ref_camera.fill_camera_translation(*ref_trans);
+
+    /*
+     * Neighbor points are x_n = R x_r + t in reference camera coordinates
+     * x_r, with R = Rn Rr^T and t = tn - R tr.
+     */
+    ViewList neighbor_ids = this->select_neighbors(views, *bundle, index,
+        view_id);
+    std::vector<NeighborView> neighbors;
+    for (std::size_t i = 0; i < neighbor_ids.size(); ++i)
+    {
+        View::Ptr other = views[neighbor_ids[i]];
+        ByteImage::Ptr byte_image = other->get_byte_image(
+            this->opts.image_name);
+        if (byte_image == nullptr)
+            continue;
+
+        NeighborView neighbor;
+        neighbor.image = image::byte_to_float_grayscale(byte_image,
+            image::DESATURATE_AVERAGE);
+        CameraInfo const& camera = other->get_camera();
+        math::Matrix3f calib, rot;
+        camera.fill_calibration(*calib, neighbor.image->width(),
+            neighbor.image->height());
+        camera.fill_world_to_cam_rot(*rot);
+        math::Vec3f trans;
+        camera.fill_camera_translation(*trans);
+
+        math::Matrix3f const rel_rot = rot * ref_rot.transposed();
+        math::Vec3f const rel_trans = trans - rel_rot * ref_trans;
+        neighbor.mat = calib * rel_rot * ref_inv_calib;
+        neighbor.vec = calib * rel_trans;
+        neighbors.push_back(neighbor);
+    }
+    if (neighbors.empty())
+        return false;
+
+    /* The depth range of the sparse points seen by the view. */
+    float min_depth = this->opts.min_depth;
+    float max_depth = this->opts.max_depth;
+    if (min_depth <= 0.0f || max_depth <= min_depth)
+    {
+        math::Vec3f center;
+        ref_camera.fill_camera_pos(*center);
+        std::vector<float> depths;
+        BundleIndex::FeatureList const& features
+            = index.get_visible_features(view_id);
+        for (std::size_t i = 0; i < features.size(); ++i)
+        {
+            math::Vec3f const& pos
+                = bundle->get_feature_positions()[features[i]];
+            if (ref_rot.row(2).dot(pos) + ref_trans[2] > 0.0f)
+                depths.push_back((pos - center).norm());
+        }
+        if (depths.empty())
+            return false;
+
+        /* Outliers are ignored, and the range is slightly extended. */
+        std::sort(depths.begin(), depths.end());
+        std::size_t const margin = depths.size() / 50;
+        min_depth = depths[margin] * 0.8f;
+        max_depth = depths[depths.size() - 1 - margin] * 1.25f;
+    }
+
+    /* Pixels whose window leaves the image are not reconstructed. */
+    int const border = this->opts.window_radius;
+    if (width <= 2 * border || height <= 2 * border)
+        return false;
+
+    std::vector<Plane> planes(width * height);
+    std::vector<float> costs(width * height, MAX_COST);
+    std::vector<math::Vec3f> rays(width * height, math::Vec3f(0.0f));
+    std::vector<char> textured(width * height, 0);
+    FloatImage::Ptr statistics = image::ncc_window_statistics(ref_image,
+        this->opts.window_radius, this->opts.window_step);
+
+    /* Random initialization of all pixels. */
+#pragma omp parallel
+    {
+        PixelCost cost(neighbors, ref_inv_calib, this->opts.window_radius,
+            this->opts.window_step);
+#pragma omp for schedule(dynamic)
+        for (int y = border; y < height - border; ++y)
+        {
+            std::mt19937 prng(row_seed(this->opts.seed, view_id, 0, y));
+            std::uniform_real_distribution<float> depth_dist(min_depth,
+                max_depth);
+            for (int x = border; x < width - border; ++x)
+            {
+                int const i = y * width + x;
+                if (!cost.set_pixel(*ref_image, *statistics, x, y))
+                    continue;
+                textured[i] = 1;
+                rays[i] = cost.get_ray();
+                planes[i].normal = random_normal(rays[i], &prng);
+                planes[i].depth = depth_dist(prng);
+                cost.evaluate(&planes[i], 1, &costs[i]);
+            }
+        }
+    }
+
+    /*
+     * Each pass updates the pixels of one color, from the pixels of the
+     * other color at odd distances along the rows and columns.
+     */
+    int const offsets[8][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+        { -3, 0 }, { 3, 0 }, { 0, -3 }, { 0, 3 } };
+    for (int iter = 0; iter < this->opts.num_iterations; ++iter)
+    {
+        /* The refinement range decreases with every iteration. */
+        float const amount = 1.0f / static_cast<float>(1 << iter);
+        float const depth_amount = amount * (max_depth - min_depth) / 4.0f;
+        for (int color = 0; color < 2; ++color)
+        {
+            int const pass = 1 + 2 * iter + color;
+#pragma omp parallel
+            {
+                PixelCost cost(neighbors, ref_inv_calib,
+                    this->opts.window_radius, this->opts.window_step);
+#pragma omp for schedule(dynamic)
+                for (int y = border; y < height - border; ++y)
+                {
+                    std::mt19937 prng(row_seed(this->opts.seed, view_id,
+                        pass, y));
+                    std::uniform_real_distribution<float> depth_dist(
+                        min_depth, max_depth);
+                    std::uniform_real_distribution<float> delta_dist(
+                        -depth_amount, depth_amount);
+                    for (int x = border + (y + color + border) % 2;
+                        x < width - border; x += 2)
+                    {
+                        int const i = y * width + x;
+                        if (!textured[i]
+                            || !cost.set_pixel(*ref_image, *statistics, x, y))
+                            continue;
+
+                        /* Propagation of the planes of nearby pixels. */
+                        math::Vec3f const& ray = rays[i];
+                        Plane candidates[MAX_PLANES];
+                        float candidate_costs[MAX_PLANES];
+                        int num_candidates = 0;
+                        for (int j = 0; j < 8; ++j)
+                        {
+                            int const nx = x + offsets[j][0];
+                            int const ny = y + offsets[j][1];
+                            if (nx < 0 || ny < 0 || nx >= width
+                                || ny >= height)
+                                continue;
+                            int const ni = ny * width + nx;
+                            if (!textured[ni])
+                                continue;
+                            Plane& candidate = candidates[num_candidates];
+                            candidate.normal = planes[ni].normal;
+                            candidate.depth = propagate_depth(planes[ni],
+                                rays[ni], ray);
+                            if (candidate.depth >= min_depth
+                                && candidate.depth <= max_depth)
+                                num_candidates += 1;
+                        }
+                        Plane best = planes[i];
+                        float best_cost = costs[i];
+                        cost.evaluate(candidates, num_candidates,
+                            candidate_costs);
+                        select_best(candidates, candidate_costs,
+                            num_candidates, &best, &best_cost);
+
+                        /* Random refinement around the best plane. */
+                        candidates[0].normal = random_normal(ray, &prng);
+                        candidates[0].depth = depth_dist(prng);
+                        candidates[1].normal = best.normal;
+                        candidates[1].depth = best.depth + delta_dist(prng);
+                        candidates[2].normal = perturb_normal(best.normal,
+                            ray, amount, &prng);
+                        candidates[2].depth = best.depth;
+                        candidates[3].normal = perturb_normal(best.normal,
+                            ray, amount, &prng);
+                        candidates[3].depth = candidates[1].depth;
+                        for (int j = 1; j < 4; j += 2)
+                            candidates[j].depth = std::max(min_depth,
+                                std::min(max_depth, candidates[j].depth));
+                        cost.evaluate(candidates, 4, candidate_costs);
+                        select_best(candidates, candidate_costs, 4,
+                            &best, &best_cost);
+                        planes[i] = best;
+                        costs[i] = best_cost;
+                    }
+                }
+            }
+        }
+    }
+
+    /* Depth, world normal and confidence maps. */
+    math::Matrix3f const cam_to_world_rot = ref_rot.transposed();
+    FloatImage::Ptr depth_map = FloatImage::create(width, height, 1);
+    FloatImage::Ptr normal_map = FloatImage::create(width, height, 3);
+    FloatImage::Ptr confidence_map = FloatImage::create(width, height, 1);
+    for (int i = 0; i < width * height; ++i)
+    {
+        float const confidence = std::max(0.0f, 1.0f - costs[i]);
+        confidence_map->at(i) = confidence;
+        if (!textured[i] || confidence < this->opts.min_confidence)
+            continue;
+        depth_map->at(i) = planes[i].depth;
+        math::Vec3f const normal = cam_to_world_rot * planes[i].normal;
+        std::copy(*normal, *normal + 3, &normal_map->at(i, 0));
+    }
+
+    view->set_image(depth_map, this->opts.depth_name);
+    view->set_image(normal_map, this->opts.normal_name);
+    view->set_image(confidence_map, this->opts.confidence_name);
+    return true;
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_PATCHMATCH_STEREO_HEADER
+#define MVE_PATCHMATCH_STEREO_HEADER
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "util/progress.h"
+#include "core/bundle.h"
+#include "core/bundle_index.h"
+#include "core/defines.h"
+#include "core/scene.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * PatchMatch multi-view stereo for the depth and normal maps of the views.
+ *
+ * Every pixel of a reference view holds a plane hypothesis, a depth along
+ * the viewing ray and a normal. The cost of a hypothesis is one minus the
+ * normalized cross-correlation of the window around the pixel with the
+ * windows in the neighbor views, which are warped with the homography of
+ * the plane. The costs of the best half of the neighbors are averaged, so
+ * occlusions in some neighbors are tolerated. The hypotheses are
+ * initialized randomly within the depth range of the sparse points seen
+ * by the view, and improved in iterations of propagation from nearby
+ * pixels and random refinement.
+ *
+ * Propagation uses a checkerboard pattern: All pixels of one color are
+ * updated in parallel from pixels of the other color at odd distances,
+ * which are not modified at the same time. The result does not depend on
+ * the number of threads.
+ *
+ * The neighbor views of a view are chosen by the sparse points seen by
+ * both views, weighted by the triangulation angle. The images are expected
+ * to be undistorted. Resulting depths are distances along the viewing rays
+ * as for all MVE depth maps, where zero is invalid. Normals are in world
+ * coordinates, and the confidence is the averaged correlation.
+ */
+class PatchMatchStereo
+{
+public:
+    struct Options
+    {
+        Options (void);
+
+        /** The name of the undistorted input images of the views. */
+        std::string image_name;
+        /** The names of the resulting depth, normal and confidence maps. */
+        std::string depth_name;
+        std::string normal_name;
+        std::string confidence_name;
+
+        /** The maximum number of neighbor views. */
+        int num_neighbors;
+        /** Neighbors need this many shared points with the view. */
+        int min_shared_points;
+        /** Triangulation angle in degrees below which points count less. */
+        float min_triangulation_angle;
+
+        /** The radius of the correlation window in pixels. */
+        int window_radius;
+        /** The distance of the samples of the window in pixels. */
+        int window_step;
+        /** The number of iterations, each updates both colors once. */
+        int num_iterations;
+
+        /**
+         * The depth range in world units. If zero, the range is chosen
+         * from the depths of the sparse points seen by the view.
+         */
+        float min_depth;
+        float max_depth;
+        /** Depths with a lower confidence are invalidated. */
+        float min_confidence;
+        /** The seed of the random hypotheses. */
+        unsigned int seed;
+        /** Prints the processed and skipped views on the console. */
+        bool verbose_output;
+    };
+
+    typedef std::vector<std::size_t> ViewList;
+
+public:
+    explicit PatchMatchStereo (Options const& options);
+
+    /**
+     * Computes the depth, normal and confidence maps of all views with a
+     * valid camera and the input image, and stores them into the views.
+     * The views are not saved. Cancellation is checked and progress is
+     * reported before every view.
+     */
+    void compute (Scene::Ptr scene,
+        util::StageControl const& control = util::StageControl());
+
+    /**
+     * Computes the depth, normal and confidence maps of one view. Returns
+     * false if the view has no neighbor views or no depth range.
+     */
+    bool compute_view (Scene::Ptr scene, BundleIndex const& index,
+        std::size_t view_id);
+
+    /** Returns the neighbor views of a view, best neighbors first. */
+    ViewList select_neighbors (Scene::ViewList const& views,
+        Bundle const& bundle, BundleIndex const& index,
+        std::size_t view_id) const;
+
+private:
+    Options opts;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+PatchMatchStereo::Options::Options (void)
+    : image_name("undistorted")
+    , depth_name("depth-L0")
+    , normal_name("normal-L0")
+    , confidence_name("conf-L0")
+    , num_neighbors(4)
+    , min_shared_points(10)
+    , min_triangulation_angle(5.0f)
+    , window_radius(5)
+    , window_step(2)
+    , num_iterations(4)
+    , min_depth(0.0f)
+    , max_depth(0.0f)
+    , min_confidence(0.5f)
+    , seed(0)
+    , verbose_output(false)
+{
+}
+
+inline
+PatchMatchStereo::PatchMatchStereo (Options const& options)
+    : opts(options)
+{
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_PATCHMATCH_STEREO_HEADER */
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "core/point_kd_tree.h"
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Orders neighbors by distance, equal distances by ID. */
+    bool
+    neighbor_less (PointKdTree::Neighbor const& a,
+        PointKdTree::Neighbor const& b)
+    {
+        return a.dist < b.dist || (a.dist == b.dist && a.id < b.id);
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::build (PointList const& points)
+{
+    this->clear();
+    if (points.size() >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("Too many points");
+
+    std::size_t const num_points = points.size();
+    if (num_points == 0)
+        return;
+    std::size_t const max_leaf_points
+        = std::max<std::size_t>(1, this->opts.max_leaf_points);
+
+    this->ids.resize(num_points);
+    for (std::size_t i = 0; i < num_points; ++i)
+        this->ids[i] = static_cast<PointID>(i);
+
+    Node root;
+    root.split = 0.0f;
+    root.axis = LEAF_AXIS;
+    root.left = 0;
+    root.first = 0;
+    root.last = static_cast<std::uint32_t>(num_points);
+    this->nodes.push_back(root);
+
+    /* Split all nodes of a level in parallel, then append the children. */
+    std::size_t level_begin = 0;
+    while (level_begin < this->nodes.size())
+    {
+        std::size_t const level_end = this->nodes.size();
+        std::int64_t const level_size
+            = static_cast<std::int64_t>(level_end - level_begin);
+#pragma omp parallel for schedule(dynamic)
+        for (std::int64_t i = 0; i < level_size; ++i)
+        {
+            Node& node = this->nodes[level_begin + i];
+            if (node.last - node.first <= max_leaf_points)
+                continue;
+
+            /* Split along the axis of the largest extent. */
+            math::Vec3f aabb_min = points[this->ids[node.first]];
+            math::Vec3f aabb_max = aabb_min;
+            for (std::uint32_t j = node.first + 1; j < node.last; ++j)
+            {
+                math::Vec3f const& p = points[this->ids[j]];
+                for (int k = 0; k < 3; ++k)
+                {
+                    aabb_min[k] = std::min(aabb_min[k], p[k]);
+                    aabb_max[k] = std::max(aabb_max[k], p[k]);
+                }
+            }
+            math::Vec3f const extent = aabb_max - aabb_min;
+            int const axis = extent.maximum() == extent[0] ? 0
+                : (extent.maximum() == extent[1] ? 1 : 2);
+            if (extent[axis] <= 0.0f)
+                continue;
+
+            std::uint32_t const mid = node.first
+                + (node.last - node.first) / 2;
+            std::nth_element(this->ids.begin() + node.first,
+                this->ids.begin() + mid, this->ids.begin() + node.last,
+                [&points, axis] (PointID a, PointID b)
+                { return points[a][axis] < points[b][axis]; });
+            node.axis = static_cast<std::uint32_t>(axis);
+            node.split = points[this->ids[mid]][axis];
+        }
+
+        for (std::size_t i = level_begin; i < level_end; ++i)
+        {
+            if (this->nodes[i].axis == LEAF_AXIS)
+                continue;
+            Node left = this->nodes[i];
+            left.axis = LEAF_AXIS;
+            left.last = left.first + (left.last - left.first) / 2;
+            Node right = left;
+            right.first = left.last;
+            right.last = this->nodes[i].last;
+            this->nodes[i].left = static_cast<std::uint32_t>
+                (this->nodes.size());
+            this->nodes.push_back(left);
+            this->nodes.push_back(right);
+        }
+        level_begin = level_end;
+    }
+
+    /* Copy the points in the order of the leaves. */
+    this->points.resize(num_points);
+    std::int64_t const num = static_cast<std::int64_t>(num_points);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num; ++i)
+        this->points[i] = points[this->ids[i]];
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::clear (void)
+{
+    std::vector<Node>().swap(this->nodes);
+    std::vector<PointID>().swap(this->ids);
+    PointList().swap(this->points);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::search (math::Vec3f const& query, std::size_t k,
+    float max_dist2, Neighbors* result) const
+{
+    result->clear();
+    if (this->nodes.empty() || k == 0)
+        return;
+    bool const limited = k != std::numeric_limits<std::size_t>::max();
+
+    /* The nodes to visit with the squared distance to their region. */
+    struct Entry
+    {
+        std::uint32_t node;
+        float dist2;
+    };
+    Entry stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = { 0, 0.0f };
+
+    float bound = max_dist2;
+    while (stack_size > 0)
+    {
+        Entry const entry = stack[--stack_size];
+        if (entry.dist2 > bound)
+            continue;
+
+        /* Descend to the leaf on the side of the query point. */
+        Node const* node = &this->nodes[entry.node];
+        while (node->axis != LEAF_AXIS)
+        {
+            float const diff = query[node->axis] - node->split;
+            std::uint32_t const near = node->left + (diff < 0.0f ? 0 : 1);
+            std::uint32_t const far = node->left + (diff < 0.0f ? 1 : 0);
+            float const dist2 = std::max(entry.dist2, diff * diff);
+            if (dist2 <= bound)
+                stack[stack_size++] = { far, dist2 };
+            node = &this->nodes[near];
+        }
+
+        for (std::uint32_t i = node->first; i < node->last; ++i)
+        {
+            float const dist2 = (this->points[i] - query).square_norm();
+            if (dist2 > bound)
+                continue;
+            Neighbor const neighbor = { this->ids[i], dist2 };
+            if (!limited)
+            {
+                result->push_back(neighbor);
+                continue;
+            }
+
+            /* Keep the k best neighbors sorted. */
+            Neighbors::iterator pos = std::upper_bound(result->begin(),
+                result->end(), neighbor, neighbor_less);
+            if (result->size() == k && pos == result->end())
+                continue;
+            result->insert(pos, neighbor);
+            if (result->size() > k)
+                result->pop_back();
+            if (result->size() == k)
+                bound = result->back().dist;
+        }
+    }
+
+    if (!limited)
+        std::sort(result->begin(), result->end(), neighbor_less);
+    for (std::size_t i = 0; i < result->size(); ++i)
+        (*result)[i].dist = std::sqrt((*result)[i].dist);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+PointKdTree::find_nn (math::Vec3f const& query, Neighbor* result,
+    float max_dist) const
+{
+    Neighbors neighbors;
+    this->find_knn(query, 1, &neighbors, max_dist);
+    if (neighbors.empty())
+        return false;
+    *result = neighbors[0];
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::find_knn (math::Vec3f const& query, std::size_t k,
+    Neighbors* result, float max_dist) const
+{
+    float const max_dist2 = max_dist < std::sqrt(
+        std::numeric_limits<float>::max()) ? max_dist * max_dist
+        : std::numeric_limits<float>::max();
+    this->search(query, std::min(k, this->ids.size()), max_dist2, result);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::find_radius (math::Vec3f const& query, float radius,
+    Neighbors* result) const
+{
+    this->search(query, std::numeric_limits<std::size_t>::max(),
+        radius * radius, result);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::find_knn (PointList const& queries, std::size_t k,
+    std::vector<Neighbors>* results, float max_dist) const
+{
+    results->resize(queries.size());
+    std::int64_t const num_queries = static_cast<std::int64_t>
+        (queries.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (std::int64_t i = 0; i < num_queries; ++i)
+        this->find_knn(queries[i], k, &(*results)[i], max_dist);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PointKdTree::find_radius (PointList const& queries, float radius,
+    std::vector<Neighbors>* results) const
+{
+    results->resize(queries.size());
+    std::int64_t const num_queries = static_cast<std::int64_t>
+        (queries.size());
+#pragma omp parallel for schedule(dynamic, 64)
+    for (std::int64_t i = 0; i < num_queries; ++i)
+        this->find_radius(queries[i], radius, &(*results)[i]);
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_POINT_KD_TREE_HEADER
+#define MVE_POINT_KD_TREE_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "math/vector.h"
+#include "core/defines.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * KD-tree over a 3D point cloud, e.g. the vertices of a mesh, for nearest
+ * neighbor, k-nearest neighbor and radius queries.
+ *
+ * Every inner node splits its points at the median along the axis of the
+ * largest extent. Nodes with at most 'max_leaf_points' points are leaves.
+ * The nodes are stored in one array in breadth-first order, and the tree
+ * is built one level at a time with all nodes of a level in parallel. The
+ * points are copied in the order of the leaves, so the points of a leaf
+ * are consecutive in memory. The tree does not depend on the number of
+ * threads.
+ *
+ * The tree is a snapshot of the points and must be built again if they
+ * change. All queries are const and can run concurrently, the batched
+ * queries run in parallel.
+ */
+class PointKdTree
+{
+public:
+    typedef unsigned int PointID;
+    typedef std::vector<math::Vec3f> PointList;
+
+    /** Options for building the tree. */
+    struct Options
+    {
+        Options (void);
+
+        /** Nodes with at most this many points are not split further. */
+        std::size_t max_leaf_points;
+    };
+
+    /** A neighbor of a query point. */
+    struct Neighbor
+    {
+        /** The index of the point in the point list. */
+        PointID id;
+        /** The distance to the query point. */
+        float dist;
+    };
+
+    typedef std::vector<Neighbor> Neighbors;
+
+public:
+    PointKdTree (void);
+    explicit PointKdTree (Options const& options);
+    PointKdTree (PointList const& points,
+        Options const& options = Options());
+
+    /** Builds the tree for the given points. */
+    void build (PointList const& points);
+    /** Releases all memory. */
+    void clear (void);
+
+    /** Returns the number of indexed points. */
+    std::size_t get_num_points (void) const;
+
+    /**
+     * Finds the nearest point with a distance of at most 'max_dist'.
+     * Returns false if there is none.
+     */
+    bool find_nn (math::Vec3f const& query, Neighbor* result,
+        float max_dist = std::numeric_limits<float>::max()) const;
+
+    /**
+     * Finds the 'k' nearest points with a distance of at most 'max_dist',
+     * sorted by increasing distance. There are less than 'k' results if
+     * less points are within the distance.
+     */
+    void find_knn (math::Vec3f const& query, std::size_t k,
+        Neighbors* result,
+        float max_dist = std::numeric_limits<float>::max()) const;
+
+    /** Finds all points within the radius, sorted by increasing distance. */
+    void find_radius (math::Vec3f const& query, float radius,
+        Neighbors* result) const;
+
+    /** Runs find_knn() for every query point in parallel. */
+    void find_knn (PointList const& queries, std::size_t k,
+        std::vector<Neighbors>* results,
+        float max_dist = std::numeric_limits<float>::max()) const;
+
+    /** Runs find_radius() for every query point in parallel. */
+    void find_radius (PointList const& queries, float radius,
+        std::vector<Neighbors>* results) const;
+
+private:
+    struct Node
+    {
+        /* The split position for inner nodes. */
+        float split;
+        /* The split axis, or LEAF_AXIS for leaves. */
+        std::uint32_t axis;
+        /* The left child, the right child follows it. */
+        std::uint32_t left;
+        /* The range of points in the sorted order. */
+        std::uint32_t first;
+        std::uint32_t last;
+    };
+
+    static std::uint32_t const LEAF_AXIS = 3;
+
+    /* Gathers the points within the squared distance into the result. */
+    void search (math::Vec3f const& query, std::size_t k, float max_dist2,
+        Neighbors* result) const;
+
+private:
+    Options opts;
+    std::vector<Node> nodes;
+    /* The point IDs and positions in the order of the leaves. */
+    std::vector<PointID> ids;
+    PointList points;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+PointKdTree::Options::Options (void)
+    : max_leaf_points(8)
+{
+}
+
+inline
+PointKdTree::PointKdTree (void)
+{
+}
+
+inline
+PointKdTree::PointKdTree (Options const& options)
+    : opts(options)
+{
+}
+
+inline
+PointKdTree::PointKdTree (PointList const& points, Options const& options)
+    : opts(options)
+{
+    this->build(points);
+}
+
+inline std::size_t
+PointKdTree::get_num_points (void) const
+{
+    return this->ids.size();
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_POINT_KD_TREE_HEADER */
@@ -9,6 +9,12 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
 #include "util/exception.h"
 #include "util/timer.h"
@@ -18,13 +24,99 @@
 
 CORE_NAMESPACE_BEGIN
 
+namespace
+{
+    /* Returns the ID of a view directory named "view_<ID>.mve" or -1. */
+    int
+    view_id_from_name (std::string const& name)
+    {
+        if (name.size() < 10 || name.compare(0, 5, "view_") != 0)
+            return -1;
+        std::string const digits = name.substr(5, name.size() - 9);
+        if (digits.size() > 9
+            || digits.find_first_not_of("0123456789") != std::string::npos)
+            return -1;
+        return std::atoi(digits.c_str());
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
 void
-Scene::load_scene (std::string const& base_path)
+Scene::load_scene (std::string const& base_path, bool lazy,
+    util::StageControl const& control)
 {
     if (base_path.empty())
         throw util::Exception("Invalid file name given");
     this->basedir = base_path;
-    this->init_views();
+    this->init_views(lazy, control);
+}
+
+/* ---------------------------------------------------------------- */
+
+Scene::ViewList&
+Scene::get_views (void)
+{
+    if (this->num_pending_views == 0)
+        return this->views;
+
+    std::lock_guard<std::mutex> lock(this->pending_mutex);
+    std::vector<std::size_t> ids;
+    for (std::size_t i = 0; i < this->pending_views.size(); ++i)
+        if (!this->pending_views[i].empty())
+            ids.push_back(i);
+
+    std::vector<std::string> errors(ids.size());
+    std::int64_t const num_ids = static_cast<std::int64_t>(ids.size());
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_ids; ++i)
+    {
+        try
+        {
+            this->load_pending_view(ids[i]);
+        }
+        catch (std::exception& e)
+        {
+            errors[i] = e.what();
+        }
+    }
+    for (std::size_t i = 0; i < errors.size(); ++i)
+        if (!errors[i].empty())
+            throw util::Exception(errors[i]);
+
+    return this->views;
+}
+
+/* ---------------------------------------------------------------- */
+
+View::Ptr
+Scene::get_view_by_id (std::size_t id)
+{
+    if (id >= this->views.size())
+        return View::Ptr();
+    if (this->num_pending_views == 0)
+        return this->views[id];
+
+    std::lock_guard<std::mutex> lock(this->pending_mutex);
+    if (!this->pending_views[id].empty())
+        this->load_pending_view(id);
+    return this->views[id];
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Scene::prefetch (std::vector<int> const& view_ids,
+    std::string const& image_name)
+{
+    for (std::size_t i = 0; i < view_ids.size(); ++i)
+    {
+        if (view_ids[i] < 0)
+            continue;
+        View::Ptr view = this->get_view_by_id(view_ids[i]);
+        if (view != nullptr)
+            view->prefetch_image(image_name);
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -51,17 +143,83 @@ Scene::save_bundle (void)
 /* ---------------------------------------------------------------- */
 
 void
-Scene::save_views (void)
+Scene::save_views (int max_threads, bool sync)
 {
     std::cout << "Saving views to MVE files..." << std::flush;
+    std::vector<View::Ptr> dirty;
     for (std::size_t i = 0; i < this->views.size(); ++i)
         if (this->views[i] != nullptr && this->views[i]->is_dirty())
-            this->views[i]->save_view();
+            dirty.push_back(this->views[i]);
+    this->save_views_intern(dirty, false, max_threads, sync);
     std::cout << " done." << std::endl;
 }
 
 /* ---------------------------------------------------------------- */
 
+void
+Scene::rewrite_all_views (int max_threads, bool sync)
+{
+    std::cout << "Rewriting all views..." << std::flush;
+    std::vector<View::Ptr> views;
+    for (std::size_t i = 0; i < this->views.size(); ++i)
+        if (this->views[i] != nullptr)
+            views.push_back(this->views[i]);
+
+    /*
+     * Rewriting loads the images, which can release images of other views
+     * if the cache has a budget. The views are then rewritten serially.
+     */
+    if (this->cache->get_byte_budget() != 0)
+        max_threads = 1;
+    this->save_views_intern(views, true, max_threads, sync);
+    std::cout << " done." << std::endl;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Scene::save_views_intern (std::vector<View::Ptr> const& views,
+    bool rewrite, int max_threads, bool sync)
+{
+    if (views.empty())
+        return;
+
+    /* Saving is bound by I/O, the threads mainly hide the latency. */
+    std::vector<std::string> errors(views.size());
+    std::int64_t const num_views = static_cast<std::int64_t>(views.size());
+#ifdef _OPENMP
+    int const num_threads = max_threads > 0
+        ? max_threads : omp_get_max_threads();
+#else
+    (void)max_threads;
+#endif
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (std::int64_t i = 0; i < num_views; ++i)
+    {
+        try
+        {
+            if (rewrite)
+                views[i]->save_view_as(views[i]->get_directory());
+            else
+                views[i]->save_view();
+        }
+        catch (std::exception& e)
+        {
+            errors[i] = views[i]->get_directory() + ": " + e.what();
+        }
+    }
+
+    /* One sync for all files instead of syncing every file. */
+    if (sync && !util::fs::sync_filesystem(this->basedir.c_str()))
+        std::cerr << "Warning: Could not sync " << this->basedir << std::endl;
+
+    for (std::size_t i = 0; i < errors.size(); ++i)
+        if (!errors[i].empty())
+            throw util::Exception(errors[i]);
+}
+
+/* ---------------------------------------------------------------- */
+
 bool
 Scene::is_dirty (void) const
 {
@@ -138,7 +296,7 @@ Scene::get_bundle_mem_usage (void)
 /* ---------------------------------------------------------------- */
 
 void
-Scene::init_views (void)
+Scene::init_views (bool lazy, util::StageControl const& control)
 {
     util::WallTimer timer;
 
@@ -160,52 +318,113 @@ Scene::init_views (void)
     std::cout << "Initializing scene with " << views_dir.size()
         << " views..." << std::endl;
 
-    /* Load views in a temp list. */
-    ViewList temp_list;
-    int max_id = 0;
+    /* Collect the view directories, in lazy mode with the IDs. */
+    std::vector<std::string> view_dirs;
+    std::vector<int> lazy_ids;
     for (std::size_t i = 0; i < views_dir.size(); ++i)
     {
         if (views_dir[i].name.size() < 4)
             continue;
         if (util::string::right(views_dir[i].name, 4) != ".mve")
             continue;
-        View::Ptr view = View::create();
-        view->load_view(views_dir[i].get_absolute_name());
-        temp_list.push_back(view);
-        max_id = std::max(max_id, view->get_id());
+        view_dirs.push_back(views_dir[i].get_absolute_name());
+        lazy_ids.push_back(lazy ? view_id_from_name(views_dir[i].name) : -1);
     }
 
-    if (max_id > 5000 && max_id > 2 * (int)temp_list.size())
+    /* Load the remaining views in parallel in a temp list. */
+    ViewList temp_list(view_dirs.size());
+    std::vector<std::string> errors(view_dirs.size());
+    std::int64_t const num_dirs = static_cast<std::int64_t>(view_dirs.size());
+    std::size_t const num_to_load = static_cast<std::size_t>(
+        std::count(lazy_ids.begin(), lazy_ids.end(), -1));
+    std::atomic<std::size_t> num_loaded(0);
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_dirs; ++i)
+    {
+        if (lazy_ids[i] >= 0 || control.is_cancelled())
+            continue;
+        try
+        {
+            View::Ptr view = View::create();
+            view->load_view(view_dirs[i]);
+            view->set_cache(this->cache);
+            temp_list[i] = view;
+        }
+        catch (std::exception& e)
+        {
+            errors[i] = e.what();
+        }
+        control.report(++num_loaded, num_to_load);
+    }
+    control.check_cancelled("Scene loading cancelled");
+    for (std::size_t i = 0; i < errors.size(); ++i)
+        if (!errors[i].empty())
+            throw util::Exception(errors[i]);
+
+    int max_id = 0;
+    for (std::size_t i = 0; i < view_dirs.size(); ++i)
+        max_id = std::max(max_id, lazy_ids[i] >= 0
+            ? lazy_ids[i] : temp_list[i]->get_id());
+
+    if (max_id > 5000 && max_id > 2 * (int)view_dirs.size())
         throw util::Exception("Spurious view IDs");
 
     /* Transfer temp list to real list. */
     this->views.clear();
-    if (!temp_list.empty())
+    this->pending_views.clear();
+    this->num_pending_views = 0;
+    if (!view_dirs.empty())
+    {
         this->views.resize(max_id + 1);
-    for (std::size_t i = 0; i < temp_list.size(); ++i)
+        this->pending_views.resize(max_id + 1);
+    }
+    for (std::size_t i = 0; i < view_dirs.size(); ++i)
     {
-        std::size_t id = temp_list[i]->get_id();
+        std::size_t id = lazy_ids[i] >= 0
+            ? lazy_ids[i] : temp_list[i]->get_id();
 
-        if (this->views[id] != nullptr)
+        if (this->views[id] != nullptr || !this->pending_views[id].empty())
         {
             std::cout << "Warning loading MVE file "
-                << this->views[id]->get_directory() << std::endl
+                << view_dirs[i] << std::endl
                 << "  View with ID " << id << " already present"
                 << ", skipping file."
                 << std::endl;
             continue;
         }
 
-        this->views[id] = temp_list[i];
+        if (lazy_ids[i] >= 0)
+        {
+            this->pending_views[id] = view_dirs[i];
+            this->num_pending_views += 1;
+        }
+        else
+            this->views[id] = temp_list[i];
     }
 
-    std::cout << "Initialized " << temp_list.size()
+    std::cout << "Initialized " << view_dirs.size()
         << " views (max ID is " << max_id << "), took "
         << timer.get_elapsed() << "ms." << std::endl;
 }
 
 /* ---------------------------------------------------------------- */
 
+void
+Scene::load_pending_view (std::size_t id)
+{
+    std::string const& path = this->pending_views[id];
+    View::Ptr view = View::create();
+    view->load_view(path);
+    if (view->get_id() != static_cast<int>(id))
+        throw util::Exception(path, ": View ID does not match the name");
+    view->set_cache(this->cache);
+    this->views[id] = view;
+    this->pending_views[id].clear();
+    this->num_pending_views -= 1;
+}
+
+/* ---------------------------------------------------------------- */
+
 Bundle::ConstPtr
 Scene::get_bundle (void)
 {
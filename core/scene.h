@@ -10,10 +10,13 @@
 #ifndef MVE_SCENE_HEADER
 #define MVE_SCENE_HEADER
 
+#include <atomic>
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 
+#include "util/progress.h"
 #include "core/defines.h"
 #include "core/view.h"
 #include "core/bundle.h"
@@ -30,6 +33,11 @@ CORE_NAMESPACE_BEGIN
  *
  * - directory "views": contains the views in the scene.
  * - file "synth_0.out": bundle file that contains key points.
+ *
+ * The views are loaded in parallel. In lazy mode, only the view IDs are
+ * enumerated from the directory names "view_<ID>.mve" on load, and the
+ * meta data of a view is loaded on first access with get_view_by_id() or
+ * get_views(). Views with other directory names are loaded right away.
  */
 class Scene
 {
@@ -39,17 +47,28 @@ public:
 
 public:
     /** Constructs and loads a scene from the given directory. */
-    static Scene::Ptr create (std::string const& path);
+    static Scene::Ptr create (std::string const& path, bool lazy = false,
+        util::StageControl const& control = util::StageControl());
 
     Scene(const Scene&) = delete;
     Scene& operator=(const Scene&) = delete;
 
-    /** Loads the scene from the given directory. */
-    void load_scene (std::string const& base_path);
-
-    /** Returns the list of views. */
+    /**
+     * Loads the scene from the given directory. If 'lazy' is true, the
+     * views are loaded on first access. Cancellation is checked before
+     * every view, and a cancelled load throws util::CancelledException
+     * and leaves the views of the scene unchanged. Progress is reported
+     * after every loaded view.
+     */
+    void load_scene (std::string const& base_path, bool lazy = false,
+        util::StageControl const& control = util::StageControl());
+
+    /**
+     * Returns the list of views. In lazy mode, views that have not been
+     * accessed yet are null.
+     */
     ViewList const& get_views (void) const;
-    /** Returns the list of views. */
+    /** Returns the list of views, loads all pending views in lazy mode. */
     ViewList& get_views (void);
     /** Returns the bundle structure. */
     Bundle::ConstPtr get_bundle (void);
@@ -58,17 +77,36 @@ public:
     /** Resets the bundle file such that it is re-read on get_bundle. */
     void reset_bundle (void);
 
-    /** Returns a view by ID or 0 on failure. */
+    /**
+     * Returns a view by ID or 0 on failure. In lazy mode, the view is
+     * loaded on first access. This is safe to call concurrently.
+     */
     View::Ptr get_view_by_id (std::size_t id);
 
+    /**
+     * Starts loading the image of the given views in the background, see
+     * View::prefetch_image(). Invalid IDs and views without the image are
+     * skipped. In lazy mode, this loads the views.
+     */
+    void prefetch (std::vector<int> const& view_ids,
+        std::string const& image_name);
+
     /** Saves bundle file if dirty as well as dirty embeddings. */
     void save_scene (void);
-    /** Saves dirty embeddings only. */
-    void save_views (void);
+    /**
+     * Saves dirty embeddings only. The views are saved in parallel with at
+     * most 'max_threads' threads, 0 uses the OpenMP default. If 'sync' is
+     * true, the files are flushed to disk with a single sync of the file
+     * system after all views are written.
+     */
+    void save_views (int max_threads = 0, bool sync = false);
     /** Saves the bundle file if dirty. */
     void save_bundle (void);
-    /** Forces rewriting of all views. Can take a long time. */
-    void rewrite_all_views (void);
+    /**
+     * Forces rewriting of all views. Can take a long time. The views are
+     * rewritten in parallel if the cache budget is unlimited.
+     */
+    void rewrite_all_views (int max_threads = 0, bool sync = false);
 
     /** Returns true if one of the views or the bundle file is dirty. */
     bool is_dirty (void) const;
@@ -79,6 +117,16 @@ public:
     /** Forces cleanup of unused embeddings. */
     void cache_cleanup (void);
 
+    /**
+     * Sets the memory budget in bytes for the images and BLOBs of all
+     * views. If the budget is exceeded, the least recently used embeddings
+     * which are not dirty and not in use are released automatically.
+     * The default budget of 0 is unlimited.
+     */
+    void set_cache_budget (std::size_t byte_budget);
+    /** Returns the memory budget of the views in bytes. */
+    std::size_t get_cache_budget (void) const;
+
     /** Returns total scene memory usage. */
     std::size_t get_total_mem_usage (void);
     /** Returns view memory usage. */
@@ -92,26 +140,37 @@ protected:
 private:
     std::string basedir;
     ViewList views;
+    /* Directories of the views that have not been loaded yet, by ID. */
+    std::vector<std::string> pending_views;
+    std::atomic<std::size_t> num_pending_views;
+    std::mutex pending_mutex;
+    ViewCache::Ptr cache;
     Bundle::Ptr bundle;
     bool bundle_dirty;
 
 private:
-    void init_views (void);
+    void init_views (bool lazy, util::StageControl const& control);
+    void load_pending_view (std::size_t id);
+    void save_views_intern (std::vector<View::Ptr> const& views,
+        bool rewrite, int max_threads, bool sync);
 };
 
 /* ---------------------------------------------------------------- */
 
 inline
 Scene::Scene (void)
-    : bundle_dirty(false)
+    : num_pending_views(0)
+    , cache(ViewCache::create())
+    , bundle_dirty(false)
 {
 }
 
 inline Scene::Ptr
-Scene::create (std::string const& path)
+Scene::create (std::string const& path, bool lazy,
+    util::StageControl const& control)
 {
     Scene::Ptr scene(new Scene);
-    scene->load_scene(path);
+    scene->load_scene(path, lazy, control);
     return scene;
 }
 
@@ -121,22 +180,22 @@ Scene::get_views (void) const
     return this->views;
 }
 
-inline Scene::ViewList&
-Scene::get_views (void)
+inline std::string const&
+Scene::get_path (void) const
 {
-    return this->views;
+    return this->basedir;
 }
 
-inline View::Ptr
-Scene::get_view_by_id (std::size_t id)
+inline void
+Scene::set_cache_budget (std::size_t byte_budget)
 {
-    return (id < this->views.size() ? this->views[id] : View::Ptr());
+    this->cache->set_byte_budget(byte_budget);
 }
 
-inline std::string const&
-Scene::get_path (void) const
+inline std::size_t
+Scene::get_cache_budget (void) const
 {
-    return this->basedir;
+    return this->cache->get_byte_budget();
 }
 
 inline void
@@ -7,21 +7,27 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <cstring>
 #include <cerrno>
+#include <future>
+#include <sstream>
 
 #include "util/exception.h"
 #include "util/file_system.h"
 #include "util/tokenizer.h"
 #include "util/ini_parser.h"
+#include "util/thread_pool.h"
 #include "core/view.h"
 #include "core/image_io.h"
+#include "core/image_tools.h"
 
 #define VIEW_IO_META_FILE "meta.ini"
 #define VIEW_IO_BLOB_SIGNATURE "\211MVE_BLOB\n"
 #define VIEW_IO_BLOB_SIGNATURE_LEN 10
+#define VIEW_THUMBNAIL_PREFIX "thumb-"
 
 /* The signature to identify deprecated MVE files. */
 #define VIEW_MVE_FILE_SIGNATURE "\211MVE\n"
@@ -29,20 +35,33 @@
 
 CORE_NAMESPACE_BEGIN
 
+View::~View (void)
+{
+    if (this->cache != nullptr)
+        this->cache->remove_view(this);
+}
+
 void
 View::load_view (std::string const& user_path)
 {
     std::string safe_path = util::fs::sanitize_path(user_path);
     safe_path = util::fs::abspath(safe_path);
-    this->deprecated_format_check(safe_path);
+    bool const packed = is_view_pack_file(safe_path);
+    if (!packed)
+        this->deprecated_format_check(safe_path);
 
     /* Open meta.ini and populate images and blobs. */
     //std::cout << "View: Loading view: " << path << std::endl;
     this->clear();
     try
     {
-        this->load_meta_data(safe_path);
-        this->populate_images_and_blobs(safe_path);
+        if (packed)
+            this->load_pack(safe_path);
+        else
+        {
+            this->load_meta_data(safe_path);
+            this->populate_images_and_blobs(safe_path);
+        }
         this->path = safe_path;
     }
     catch (...)
@@ -213,6 +232,18 @@ View::save_view_as (std::string const& user_path)
         this->blobs[i].is_dirty = true;
     }
 
+    /* Entries of a view pack are saved as new files. */
+    if (this->is_packed())
+    {
+        for (std::size_t i = 0; i < this->images.size(); ++i)
+            if (!util::fs::is_absolute(this->images[i].filename))
+                this->images[i].filename.clear();
+        for (std::size_t i = 0; i < this->blobs.size(); ++i)
+            this->blobs[i].filename.clear();
+        this->pack_index.clear();
+        this->to_delete.clear();
+    }
+
     /* Save meta data, images and BLOBS, and free memory. */
     this->save_meta_data(safe_path);
     this->path = safe_path;
@@ -220,12 +251,128 @@ View::save_view_as (std::string const& user_path)
     this->cache_cleanup();
 }
 
+void
+View::save_view_as_pack (std::string const& filename, bool compress)
+{
+    std::string safe_path = util::fs::sanitize_path(filename);
+    safe_path = util::fs::abspath(safe_path);
+    if (util::fs::dir_exists(safe_path.c_str()))
+        throw util::FileException(safe_path, "Is a directory");
+
+    this->save_pack(safe_path, compress);
+    this->cache_cleanup();
+}
+
+void
+View::save_pack (std::string const& filename, bool compress)
+{
+    /* Load all images and BLOBs, the references keep them in memory. */
+    std::vector<ImageBase::Ptr> images(this->images.size());
+    for (std::size_t i = 0; i < this->images.size(); ++i)
+        images[i] = this->load_image(&this->images[i], false);
+    std::vector<ByteImage::Ptr> blobs(this->blobs.size());
+    for (std::size_t i = 0; i < this->blobs.size(); ++i)
+        blobs[i] = this->load_blob(&this->blobs[i], false);
+
+    std::ostringstream meta_stream;
+    util::write_ini(this->meta_data.data, meta_stream);
+    std::string const meta_text = meta_stream.str();
+
+    /* Create the index with the meta data, the images and the BLOBs. */
+    ViewPackIndex index;
+    std::vector<char const*> data;
+    ViewPackEntry meta_entry;
+    meta_entry.kind = ViewPackEntry::KIND_META;
+    meta_entry.name = VIEW_IO_META_FILE;
+    meta_entry.size = meta_text.size();
+    index.push_back(meta_entry);
+    data.push_back(meta_text.data());
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        ViewPackEntry entry;
+        entry.kind = ViewPackEntry::KIND_IMAGE;
+        entry.name = this->images[i].name;
+        entry.width = images[i]->width();
+        entry.height = images[i]->height();
+        entry.channels = images[i]->channels();
+        entry.type = images[i]->get_type();
+        entry.size = images[i]->get_byte_size();
+        index.push_back(entry);
+        data.push_back(images[i]->get_byte_pointer());
+    }
+    for (std::size_t i = 0; i < blobs.size(); ++i)
+    {
+        ViewPackEntry entry;
+        entry.kind = ViewPackEntry::KIND_BLOB;
+        entry.name = this->blobs[i].name;
+        entry.size = blobs[i]->get_byte_size();
+        index.push_back(entry);
+        data.push_back(blobs[i]->get_byte_pointer());
+    }
+
+    /* Write a new file and move it in place on success. */
+    std::string const filename_new = filename + ".new";
+    try
+    {
+        save_view_pack(filename_new, &index, data, compress);
+    }
+    catch (...)
+    {
+        util::fs::unlink(filename_new.c_str());
+        throw;
+    }
+    this->replace_file(filename, filename_new);
+
+    /* The view is now connected with the pack. */
+    this->path = filename;
+    this->pack_index = index;
+    for (std::size_t i = 0; i < this->images.size(); ++i)
+    {
+        ImageProxy& proxy = this->images[i];
+        proxy.is_dirty = false;
+        proxy.filename = proxy.name;
+        proxy.width = images[i]->width();
+        proxy.height = images[i]->height();
+        proxy.channels = images[i]->channels();
+        proxy.type = images[i]->get_type();
+        proxy.is_initialized = true;
+    }
+    for (std::size_t i = 0; i < this->blobs.size(); ++i)
+    {
+        BlobProxy& proxy = this->blobs[i];
+        proxy.is_dirty = false;
+        proxy.filename = proxy.name;
+        proxy.size = blobs[i]->get_byte_size();
+        proxy.is_initialized = true;
+    }
+    this->meta_data.is_dirty = false;
+    this->to_delete.clear();
+}
+
 int
 View::save_view (void)
 {
     if (this->path.empty())
         throw std::runtime_error("View not initialized");
 
+    /* Packed views are rewritten as a whole. */
+    if (this->is_packed())
+    {
+        int saved = this->meta_data.is_dirty ? 1 : 0;
+        for (std::size_t i = 0; i < this->images.size(); ++i)
+            saved += this->images[i].is_dirty ? 1 : 0;
+        for (std::size_t i = 0; i < this->blobs.size(); ++i)
+            saved += this->blobs[i].is_dirty ? 1 : 0;
+        if (saved == 0 && this->to_delete.empty())
+            return 0;
+
+        bool compress = false;
+        for (std::size_t i = 0; i < this->pack_index.size(); ++i)
+            compress = compress || this->pack_index[i].compressed;
+        this->save_pack(this->path, compress);
+        return saved;
+    }
+
     /* Save meta data. */
     int saved = 0;
     if (this->meta_data.is_dirty)
@@ -282,6 +429,7 @@ View::clear (void)
     this->images.clear();
     this->blobs.clear();
     this->to_delete.clear();
+    this->pack_index.clear();
 }
 
 bool
@@ -307,9 +455,9 @@ View::cache_cleanup (void)
     for (std::size_t i = 0; i < this->images.size(); ++i)
     {
         ImageProxy& proxy = this->images[i];
-        if (proxy.is_dirty || proxy.image.use_count() != 1)
+        if (!View::is_image_releasable(proxy))
             continue;
-        proxy.image.reset();
+        View::release_image_intern(&proxy);
         released += 1;
     }
     for (std::size_t i = 0; i < this->blobs.size(); ++i)
@@ -327,13 +475,29 @@ View::cache_cleanup (void)
     return released;
 }
 
+void
+View::set_cache (ViewCache::Ptr cache)
+{
+    if (this->cache == cache)
+        return;
+    if (this->cache != nullptr)
+        this->cache->remove_view(this);
+    this->cache = cache;
+    if (this->cache != nullptr)
+        this->cache->add_view(this);
+}
+
 std::size_t
 View::get_byte_size (void) const
 {
     std::size_t ret = 0;
     for (std::size_t i = 0; i < this->images.size(); ++i)
+    {
         if (this->images[i].image != nullptr)
             ret += this->images[i].image->get_byte_size();
+        if (this->images[i].pyramid != nullptr)
+            ret += this->images[i].pyramid->get_byte_size();
+    }
     for (std::size_t i = 0; i < this->blobs.size(); ++i)
         if (this->blobs[i].blob != nullptr)
             ret += this->blobs[i].blob->get_byte_size();
@@ -433,12 +597,86 @@ View::has_image (std::string const& name, ImageType type)
     return proxy->type == type;
 }
 
+namespace
+{
+    ImageBase::Ptr
+    load_image_file (std::string const& filename)
+    {
+        std::string ext4 = util::string::right(filename, 4);
+        std::string ext5 = util::string::right(filename, 5);
+        ext4 = util::string::lowercase(ext4);
+        ext5 = util::string::lowercase(ext5);
+        if (ext4 == ".png" || ext4 == ".jpg" || ext5 == ".jpeg")
+            return image::load_file(filename);
+        else if (ext5 == ".mvei")
+            return image::load_mvei_file(filename);
+        else
+            throw std::runtime_error("Unexpected image type");
+    }
+
+    ImageBase::Ptr
+    load_pack_image (std::string const& filename, ViewPackEntry const& entry)
+    {
+        ImageBase::Ptr image = image::create_for_type(entry.type,
+            entry.width, entry.height, entry.channels);
+        if (image == nullptr || image->get_byte_size() != entry.size)
+            throw std::runtime_error("Invalid image in view pack");
+        load_view_pack_entry(filename, entry, image->get_byte_pointer());
+        return image;
+    }
+}
+
+bool
+View::prefetch_image (std::string const& name)
+{
+    View::ImageProxy* proxy = this->find_image_intern(name);
+    if (proxy == nullptr || proxy->filename.empty())
+        return false;
+    if (this->path.empty() && !util::fs::is_absolute(proxy->filename))
+        return false;
+    if (proxy->image != nullptr || proxy->pending.valid())
+        return true;
+
+    /*
+     * The image is loaded by a task of the global pool. Within parallel
+     * stages, whose threads are busy already, get_image() loads it.
+     */
+    if (util::ThreadPool::resolve_num_threads(0) <= 1)
+        return true;
+    util::ThreadPool& pool = util::ThreadPool::get_global();
+
+    if (this->is_packed() && !util::fs::is_absolute(proxy->filename))
+    {
+        ViewPackEntry const* entry = this->find_pack_entry(proxy->filename,
+            ViewPackEntry::KIND_IMAGE);
+        if (entry == nullptr)
+            return false;
+        std::string const path = this->path;
+        ViewPackEntry const pack_entry = *entry;
+        proxy->pending = pool.submit([path, pack_entry] (void)
+            { return load_pack_image(path, pack_entry); }).share();
+        return true;
+    }
+
+    std::string filename;
+    if (util::fs::is_absolute(proxy->filename))
+        filename = proxy->filename;
+    else
+        filename = util::fs::join_path(this->path, proxy->filename);
+    proxy->pending = pool.submit([filename] (void)
+        { return load_image_file(filename); }).share();
+    return true;
+}
+
 void
 View::set_image (ImageBase::Ptr image, std::string const& name)
 {
     if (image == nullptr)
         throw std::invalid_argument("Null image");
 
+    /* The thumbnail of the previous image is outdated. */
+    this->remove_image(VIEW_THUMBNAIL_PREFIX + name);
+
     ImageProxy proxy;
     proxy.is_dirty = true;
     proxy.name = name;
@@ -448,6 +686,8 @@ View::set_image (ImageBase::Ptr image, std::string const& name)
     proxy.channels = image->channels();
     proxy.type = image->get_type();
     proxy.image = image;
+    if (this->cache != nullptr)
+        proxy.last_access = this->cache->next_access();
 
     for (std::size_t i = 0; i < this->images.size(); ++i)
         if (this->images[i].name == name)
@@ -464,6 +704,9 @@ View::set_image_ref (std::string const& filename, std::string name)
     if (filename.empty() || name.empty())
         throw std::invalid_argument("Empty argument");
 
+    /* The thumbnail of the previous image is outdated. */
+    this->remove_image(VIEW_THUMBNAIL_PREFIX + name);
+
     ImageProxy proxy;
     proxy.is_dirty = true;
     proxy.name = name;
@@ -495,6 +738,142 @@ View::remove_image (std::string const& name)
     return false;
 }
 
+ImagePyramid::Ptr
+View::get_image_pyramid (std::string const& name)
+{
+    View::ImageProxy* proxy = this->find_image_intern(name);
+    if (proxy == nullptr)
+        return ImagePyramid::Ptr();
+    this->initialize_image(proxy, false);
+    if (proxy->type != IMAGE_TYPE_UINT8 && proxy->type != IMAGE_TYPE_FLOAT)
+        return ImagePyramid::Ptr();
+
+    /* Loading the image updates the access time for the view cache. */
+    ImageBase::Ptr image = this->load_image(proxy, false);
+    if (proxy->pyramid == nullptr)
+        proxy->pyramid = ImagePyramid::create(image);
+    return proxy->pyramid;
+}
+
+ByteImage::Ptr
+View::get_thumbnail (std::string const& name, int max_size)
+{
+    if (max_size <= 0)
+        throw std::invalid_argument("Invalid thumbnail size");
+
+    View::ImageProxy* proxy = this->find_image_intern(name);
+    if (proxy == nullptr)
+        return ByteImage::Ptr();
+    this->initialize_image(proxy, false);
+    if (proxy->type != IMAGE_TYPE_UINT8)
+        return ByteImage::Ptr();
+
+    /* The thumbnail is never larger than the image. */
+    int width = proxy->width;
+    int height = proxy->height;
+    int const image_size = std::max(width, height);
+    if (image_size > max_size)
+    {
+        width = std::max(1, (width * max_size + image_size / 2) / image_size);
+        height = std::max(1,
+            (height * max_size + image_size / 2) / image_size);
+    }
+
+    std::string const thumb_name = VIEW_THUMBNAIL_PREFIX + name;
+    View::ImageProxy* thumb_proxy = this->find_image_intern(thumb_name);
+    if (thumb_proxy != nullptr
+        && this->is_thumbnail_valid(proxy, thumb_proxy, width, height))
+        return std::dynamic_pointer_cast<ByteImage>(
+            this->load_image(thumb_proxy, false));
+
+    /*
+     * Generate the thumbnail and save it unless the view is packed. Setting
+     * the thumbnail invalidates the proxy of the image.
+     */
+    bool const save = !this->path.empty() && !this->is_packed()
+        && !proxy->is_dirty;
+    ByteImage::Ptr thumb = this->generate_thumbnail(proxy, width, height);
+    this->set_image(thumb, thumb_name);
+    if (save)
+        this->save_image_intern(this->find_image_intern(thumb_name));
+    return thumb;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+View::is_thumbnail_valid (ImageProxy* proxy, ImageProxy* thumb_proxy,
+    int width, int height)
+{
+    this->initialize_image(thumb_proxy, false);
+    if (thumb_proxy->type != IMAGE_TYPE_UINT8
+        || thumb_proxy->width != width || thumb_proxy->height != height)
+        return false;
+
+    /*
+     * Thumbnails in memory are generated after the image was last set, and
+     * packed views are always saved as a whole. Saved thumbnails of images
+     * in files are outdated if the file of the image is newer.
+     */
+    if (thumb_proxy->is_dirty)
+        return true;
+    if (proxy->is_dirty)
+        return false;
+    if (this->is_packed() && !util::fs::is_absolute(proxy->filename))
+        return true;
+
+    std::string filename = proxy->filename;
+    if (!util::fs::is_absolute(filename))
+        filename = util::fs::join_path(this->path, filename);
+    std::string const thumb_filename = util::fs::join_path(this->path,
+        thumb_proxy->filename);
+    int64_t const image_time = util::fs::get_modification_time(
+        filename.c_str());
+    int64_t const thumb_time = util::fs::get_modification_time(
+        thumb_filename.c_str());
+    return image_time >= 0 && thumb_time >= image_time;
+}
+
+ByteImage::Ptr
+View::generate_thumbnail (ImageProxy* proxy, int width, int height)
+{
+    /*
+     * JPEG files that are not loaded are decoded with the largest DCT
+     * downscale factor that still exceeds the size of the thumbnail.
+     * Other images are halved while they are at least twice the size, and
+     * the remaining factor is rescaled linearly.
+     */
+    ByteImage::ConstPtr image = std::dynamic_pointer_cast<ByteImage>(
+        proxy->image);
+    std::string const ext = util::string::lowercase(
+        util::string::right(proxy->filename, 4));
+    bool const is_file = !proxy->is_dirty && !proxy->filename.empty()
+        && (util::fs::is_absolute(proxy->filename) || !this->is_packed());
+    if (image == nullptr && is_file && (ext == ".jpg" || ext == "jpeg"))
+    {
+        int downscale = 8;
+        while (downscale > 1 && (proxy->width / downscale < width
+            || proxy->height / downscale < height))
+            downscale /= 2;
+        std::string filename = proxy->filename;
+        if (!util::fs::is_absolute(filename))
+            filename = util::fs::join_path(this->path, filename);
+        image = image::load_jpg_file(filename, nullptr, downscale);
+    }
+    else if (image == nullptr)
+    {
+        image = std::dynamic_pointer_cast<ByteImage>(
+            this->load_image(proxy, false));
+    }
+
+    while (image->width() / 2 >= width && image->height() / 2 >= height)
+        image = image::rescale_half_size<uint8_t>(image);
+    if (image->width() == width && image->height() == height)
+        return image->duplicate();
+    return image::rescale<uint8_t>(image, image::RESCALE_LINEAR,
+        width, height);
+}
+
 /* ---------------------------------------------------------------- */
 
 ByteImage::Ptr
@@ -533,6 +912,8 @@ View::set_blob (ByteImage::Ptr blob, std::string const& name)
     proxy.is_initialized = true;
     proxy.size = blob->get_byte_size();
     proxy.blob = blob;
+    if (this->cache != nullptr)
+        proxy.last_access = this->cache->next_access();
 
     for (std::size_t i = 0; i < this->blobs.size(); ++i)
         if (this->blobs[i].name == name)
@@ -586,9 +967,15 @@ View::load_meta_data (std::string const& path)
     std::ifstream in(fname.c_str());
     if (!in.good())
         throw util::FileException(fname, "Error opening");
+    this->read_meta_data(in);
+    in.close();
+}
+
+void
+View::read_meta_data (std::istream& in)
+{
     util::parse_ini(in, &this->meta_data.data);
     this->meta_data.is_dirty = false;
-    in.close();
 
     /* Get camera data from key/value pairs. */
     std::string cam_fl = this->get_value("camera.focal_length");
@@ -700,21 +1087,81 @@ View::populate_images_and_blobs (std::string const& path)
     }
 }
 
+void
+View::load_pack (std::string const& filename)
+{
+    load_view_pack_index(filename, &this->pack_index);
+
+    bool has_meta_data = false;
+    for (std::size_t i = 0; i < this->pack_index.size(); ++i)
+    {
+        ViewPackEntry const& entry = this->pack_index[i];
+        if (entry.kind == ViewPackEntry::KIND_META)
+        {
+            std::string text(entry.size, '\0');
+            if (!text.empty())
+                load_view_pack_entry(filename, entry, &text[0]);
+            std::istringstream in(text);
+            this->read_meta_data(in);
+            has_meta_data = true;
+        }
+        else if (entry.kind == ViewPackEntry::KIND_IMAGE)
+        {
+            ImageProxy proxy;
+            proxy.is_dirty = false;
+            proxy.filename = entry.name;
+            proxy.name = entry.name;
+            proxy.width = entry.width;
+            proxy.height = entry.height;
+            proxy.channels = entry.channels;
+            proxy.type = entry.type;
+            proxy.is_initialized = true;
+            this->images.push_back(proxy);
+        }
+        else
+        {
+            BlobProxy proxy;
+            proxy.is_dirty = false;
+            proxy.filename = entry.name;
+            proxy.name = entry.name;
+            proxy.size = entry.size;
+            proxy.is_initialized = true;
+            this->blobs.push_back(proxy);
+        }
+    }
+
+    if (!has_meta_data)
+        throw util::Exception(filename, ": View pack without meta data");
+}
+
 void
 View::replace_file (std::string const& old_fn, std::string const& new_fn)
 {
-    /* Delete old file. */
+#ifdef _WIN32
+    /* Delete old file, Windows cannot rename onto an existing file. */
     if (util::fs::file_exists(old_fn.c_str()))
         if (!util::fs::unlink(old_fn.c_str()))
             throw util::FileException(old_fn, std::strerror(errno));
+#endif // _WIN32
 
-    /* Rename new file. */
+    /* Rename new file, this atomically replaces the old file on POSIX. */
     if (!util::fs::rename(new_fn.c_str(), old_fn.c_str()))
         throw util::FileException(new_fn, std::strerror(errno));
 }
 
 /* ---------------------------------------------------------------- */
 
+ViewPackEntry const*
+View::find_pack_entry (std::string const& name,
+    ViewPackEntry::Kind kind) const
+{
+    for (std::size_t i = 0; i < this->pack_index.size(); ++i)
+        if (this->pack_index[i].kind == kind
+            && this->pack_index[i].name == name)
+            return &this->pack_index[i];
+    return nullptr;
+}
+
 View::ImageProxy*
 View::find_image_intern (std::string const& name)
 {
@@ -735,10 +1182,35 @@ View::initialize_image (ImageProxy* proxy, bool update)
 ImageBase::Ptr
 View::load_image (ImageProxy* proxy, bool update)
 {
+    if (this->cache != nullptr)
+        proxy->last_access = this->cache->next_access();
     if (proxy->image != nullptr && !update)
         return proxy->image;
-    this->load_image_intern(proxy, false);
-    return proxy->image;
+
+    /* Take a prefetched image, or load it again if prefetching failed. */
+    std::shared_future<ImageBase::Ptr> pending;
+    std::swap(pending, proxy->pending);
+    ImageBase::Ptr prefetched;
+    if (pending.valid() && !update)
+    {
+        try
+        {
+            prefetched = pending.get();
+        }
+        catch (std::exception&)
+        {
+        }
+    }
+    if (prefetched != nullptr)
+        this->set_image_intern(proxy, prefetched);
+    else
+        this->load_image_intern(proxy, false);
+
+    /* The new image is referenced here and is not released by the cache. */
+    ImageBase::Ptr image = proxy->image;
+    if (this->cache != nullptr)
+        this->cache->enforce_budget();
+    return image;
 }
 
 void
@@ -751,6 +1223,27 @@ View::load_image_intern (ImageProxy* proxy, bool init_only)
     if (proxy->name.empty())
         throw std::runtime_error("Empty proxy name");
 
+    /* Relative file names of packed views are entry names. */
+    if (this->is_packed() && !util::fs::is_absolute(proxy->filename))
+    {
+        ViewPackEntry const* entry = this->find_pack_entry(proxy->filename,
+            ViewPackEntry::KIND_IMAGE);
+        if (entry == nullptr)
+            throw std::runtime_error("Image not in view pack");
+        if (!init_only)
+        {
+            this->set_image_intern(proxy, load_pack_image(this->path, *entry));
+            return;
+        }
+        proxy->is_dirty = false;
+        proxy->width = entry->width;
+        proxy->height = entry->height;
+        proxy->channels = entry->channels;
+        proxy->type = entry->type;
+        proxy->is_initialized = true;
+        return;
+    }
+
     /* If the file name is absolute, it indicates an image reference. */
     std::string filename;
     if (util::fs::is_absolute(proxy->filename))
@@ -772,17 +1265,14 @@ View::load_image_intern (ImageProxy* proxy, bool init_only)
     }
 
     //std::cout << "View: Loading image " << filename << std::endl;
-    std::string ext4 = util::string::right(proxy->filename, 4);
-    std::string ext5 = util::string::right(proxy->filename, 5);
-    ext4 = util::string::lowercase(ext4);
-    ext5 = util::string::lowercase(ext5);
-    if (ext4 == ".png" || ext4 == ".jpg" || ext5 == ".jpeg")
-        proxy->image = image::load_file(filename);
-    else if (ext5 == ".mvei")
-        proxy->image = image::load_mvei_file(filename);
-    else
-        throw std::runtime_error("Unexpected image type");
+    this->set_image_intern(proxy, load_image_file(filename));
+}
 
+void
+View::set_image_intern (ImageProxy* proxy, ImageBase::Ptr image)
+{
+    proxy->image = image;
+    proxy->pyramid.reset();
     proxy->is_dirty = false;
     proxy->width = proxy->image->width();
     proxy->height = proxy->image->height();
@@ -846,6 +1336,10 @@ View::save_image_intern (ImageProxy* proxy)
     if (use_png_format)
         image::save_png_file(
             std::dynamic_pointer_cast<ByteImage>(proxy->image), fname_new);
+    else if (this->compress_float_images
+        && proxy->image->get_type() == IMAGE_TYPE_FLOAT)
+        image::save_mvei_file_compressed(
+            std::dynamic_pointer_cast<FloatImage>(proxy->image), fname_new);
     else
         image::save_mvei_file(proxy->image, fname_new);
 
@@ -873,6 +1367,36 @@ View::save_image_intern (ImageProxy* proxy)
 
 /* ---------------------------------------------------------------- */
 
+bool
+View::is_image_releasable (ImageProxy const& proxy)
+{
+    /* The pyramid can be released even if the image is dirty. */
+    if (proxy.pyramid != nullptr)
+        return proxy.pyramid.use_count() == 1;
+    return !proxy.is_dirty && proxy.image.use_count() == 1;
+}
+
+std::size_t
+View::release_image_intern (ImageProxy* proxy)
+{
+    std::size_t released = 0;
+    if (proxy->pyramid != nullptr)
+    {
+        if (proxy->pyramid.use_count() != 1)
+            return 0;
+        released += proxy->pyramid->get_byte_size();
+        proxy->pyramid.reset();
+    }
+    if (!proxy->is_dirty && proxy->image.use_count() == 1)
+    {
+        released += proxy->image->get_byte_size();
+        proxy->image.reset();
+    }
+    return released;
+}
+
+/* ---------------------------------------------------------------- */
+
 View::BlobProxy*
 View::find_blob_intern (std::string const& name)
 {
@@ -893,10 +1417,16 @@ View::initialize_blob (BlobProxy* proxy, bool update)
 ByteImage::Ptr
 View::load_blob (BlobProxy* proxy, bool update)
 {
+    if (this->cache != nullptr)
+        proxy->last_access = this->cache->next_access();
     if (proxy->blob != nullptr && !update)
         return proxy->blob;
     this->load_blob_intern(proxy, false);
-    return proxy->blob;
+
+    ByteImage::Ptr blob = proxy->blob;
+    if (this->cache != nullptr)
+        this->cache->enforce_budget();
+    return blob;
 }
 
 void
@@ -907,6 +1437,25 @@ View::load_blob_intern (BlobProxy* proxy, bool init_only)
     if (proxy->name.empty())
         return;
 
+    if (this->is_packed())
+    {
+        ViewPackEntry const* entry = this->find_pack_entry(proxy->filename,
+            ViewPackEntry::KIND_BLOB);
+        if (entry == nullptr)
+            throw std::runtime_error("BLOB not in view pack");
+        if (!init_only)
+        {
+            // FIXME: This limits BLOBs size to 2^31 bytes.
+            ByteImage::Ptr blob = ByteImage::create(entry->size, 1, 1);
+            load_view_pack_entry(this->path, *entry,
+                blob->get_byte_pointer());
+            proxy->blob = blob;
+        }
+        proxy->size = entry->size;
+        proxy->is_initialized = true;
+        return;
+    }
+
     /* Load blob and update meta data. */
     std::string filename = util::fs::join_path(this->path, proxy->filename);
     std::ifstream in(filename.c_str(), std::ios::binary);
@@ -35,6 +35,11 @@
  * Altough JPEG files are allowed inside a view, saving a modified image will
  * always use a lossless format (PNG or MVEI), and the lossy file is deleted.
  * PNG is chosen for 1, 2, 3 and 4 channel images, MVEI for all others.
+ * Float images can be saved as compressed MVEI, see set_compression().
+ *
+ * Alternatively, a view can be stored in a single view pack file (see
+ * view_pack.h) with the meta data and the raw embeddings. Packed views are
+ * loaded lazily like directories, but saving rewrites the whole file.
  *
  * TODO: File locks?
  */
@@ -43,6 +48,8 @@
 #define MVE_VIEW_HEADER
 
 #include <cstdint>
+#include <future>
+#include <istream>
 #include <map>
 #include <memory>
 #include <string>
@@ -52,6 +59,9 @@
 #include "core/camera.h"
 #include "core/image_base.h"
 #include "core/image.h"
+#include "core/image_pyramid.h"
+#include "core/view_cache.h"
+#include "core/view_pack.h"
 
 CORE_NAMESPACE_BEGIN
 
@@ -107,6 +117,15 @@ public:
 
         /* This field is initialized on request with get_image(). */
         ImageBase::Ptr image;
+
+        /* The shared pyramid of the image, see get_image_pyramid(). */
+        ImagePyramid::Ptr pyramid;
+
+        /* The image loaded in the background, see prefetch_image(). */
+        std::shared_future<ImageBase::Ptr> pending;
+
+        /* The time of the last access, used by the view cache. */
+        uint64_t last_access = 0;
     };
 
     /** Proxy for BLOBs (Binary Large OBjects). */
@@ -130,6 +149,9 @@ public:
 
         /* This field is initialized on request with get_blob(). */
         ByteImage::Ptr blob;
+
+        /* The time of the last access, used by the view cache. */
+        uint64_t last_access = 0;
     };
 
     typedef std::vector<ImageProxy> ImageProxies;
@@ -141,10 +163,11 @@ public:
 
     View (const View&) = delete;
     View operator= (const View&) = delete;
+    ~View (void);
 
     /* --------------------- I/O interface -------------------- */
 
-    /** Initializes the view from a directory. */
+    /** Initializes the view from a directory or a view pack file. */
     void load_view (std::string const& path);
 
     /** Initializes the view from a deprecated .mve file. */
@@ -156,10 +179,20 @@ public:
     /** Writes the view to an MVE directory. */
     void save_view_as (std::string const& path);
 
+    /**
+     * Writes the view to a view pack file, optionally with compressed
+     * embeddings. The view is then connected with the file.
+     */
+    void save_view_as_pack (std::string const& filename,
+        bool compress = false);
+
+    /** Returns true if the view is connected with a view pack file. */
+    bool is_packed (void) const;
+
     /** Saves dirty meta data, images and blobs, returns the amount saved. */
     int save_view (void);
 
-    /** Returns the directory name the view is connected with. */
+    /** Returns the directory (or pack file) the view is connected with. */
     std::string const& get_directory (void) const;
 
     /** Clears everything, discards potentially unsaved data. */
@@ -174,6 +207,25 @@ public:
     /** Returns the memory consumption in bytes. */
     std::size_t get_byte_size (void) const;
 
+    /**
+     * Attaches the view to the cache, which then automatically releases
+     * the least recently used images and BLOBs of all attached views if
+     * their memory exceeds the budget. Null detaches the view.
+     */
+    void set_cache (ViewCache::Ptr cache);
+
+    /** Returns the cache the view is attached to, or null. */
+    ViewCache::Ptr get_cache (void) const;
+
+    /**
+     * Enables lossless compression of the float images that are saved to
+     * the view directory (see image::save_mvei_file_compressed()). This is
+     * meant for depth, normal and confidence maps and is disabled by
+     * default. Compressed images are loaded like other MVEI images.
+     */
+    void set_compression (bool compress_float_images);
+    bool get_compression (void) const;
+
     /* ---------------------- View Meta Data ---------------------- */
 
     /** Returns a value from the meta information. */
@@ -206,7 +258,12 @@ public:
 
     /* -------------------- Managing of images -------------------- */
 
-    /** Initializes the proxy, loads and returns the image. */
+    /**
+     * Initializes the proxy, loads and returns the image. The image is
+     * shared with the proxy, callers that modify it without setting it to
+     * the view modify a duplicate(), which only copies the values when
+     * they are first modified.
+     */
     ImageBase::Ptr get_image (std::string const& name,
         ImageType type = IMAGE_TYPE_UNKNOWN);
 
@@ -218,12 +275,46 @@ public:
     bool has_image (std::string const& name,
         ImageType type = IMAGE_TYPE_UNKNOWN);
 
+    /**
+     * Starts loading the image in the background if it is not loaded yet.
+     * The next get_image() then waits for the result instead of loading
+     * the image, which hides the disk latency behind computation. The image
+     * is loaded by a task of util::ThreadPool, and within parallel stages
+     * it is not prefetched. Returns false if there is no saved image by
+     * that name.
+     */
+    bool prefetch_image (std::string const& name);
+
     /** Returns an image of type IMAGE_TYPE_UINT8. */
     ByteImage::Ptr get_byte_image (std::string const& name);
 
     /** Returns an image of type IMAGE_TYPE_FLOAT. */
     FloatImage::Ptr get_float_image (std::string const& name);
 
+    /**
+     * Returns the pyramid of a byte or float image, which loads the image.
+     * The pyramid is created once and shared by all callers, its levels are
+     * computed on first access. The pyramid is released with the image by
+     * cache_cleanup() and the view cache if it is not referenced elsewhere,
+     * and replaced if the image is set or reloaded. Images must therefore
+     * not be modified in place while their pyramid is used. Returns null if
+     * there is no byte or float image by that name.
+     */
+    ImagePyramid::Ptr get_image_pyramid (std::string const& name);
+
+    /**
+     * Returns a thumbnail of a byte image whose larger side is at most
+     * 'max_size' pixels, with the aspect ratio of the image. The thumbnail
+     * is the image "thumb-<name>", which is generated on first access and
+     * saved right away if the view is a directory. Later calls, also in
+     * other processes, load the saved thumbnail while its file is newer
+     * than the file of the image. JPEG files are decoded downscaled in the
+     * DCT domain. Setting the image removes its thumbnail. Returns null if
+     * there is no byte image by that name.
+     */
+    ByteImage::Ptr get_thumbnail (std::string const& name,
+        int max_size = 256);
+
     /**
      * Sets an image to the view and marks it dirty.
      * If an image by that name already exists, it is overwritten.
@@ -282,8 +373,15 @@ protected:
     View (std::string const& path);
 
 private:
+    friend class ViewCache;
+
     void deprecated_format_check (std::string const& path);
     void load_meta_data (std::string const& path);
+    void read_meta_data (std::istream& in);
+    void load_pack (std::string const& filename);
+    void save_pack (std::string const& filename, bool compress);
+    ViewPackEntry const* find_pack_entry (std::string const& name,
+        ViewPackEntry::Kind kind) const;
     void save_meta_data (std::string const& path);
     void populate_images_and_blobs (std::string const& path);
     void replace_file (std::string const& old_fn, std::string const& new_fn);
@@ -292,7 +390,14 @@ private:
     void initialize_image (ImageProxy* proxy, bool update);
     ImageBase::Ptr load_image (ImageProxy* proxy, bool update);
     void load_image_intern (ImageProxy* proxy, bool init_only);
+    void set_image_intern (ImageProxy* proxy, ImageBase::Ptr image);
     void save_image_intern (ImageProxy* proxy);
+    static bool is_image_releasable (ImageProxy const& proxy);
+    bool is_thumbnail_valid (ImageProxy* proxy, ImageProxy* thumb_proxy,
+        int width, int height);
+    ByteImage::Ptr generate_thumbnail (ImageProxy* proxy,
+        int width, int height);
+    static std::size_t release_image_intern (ImageProxy* proxy);
 
     BlobProxy* find_blob_intern (std::string const& name);
     void initialize_blob (BlobProxy* proxy, bool update);
@@ -309,6 +414,9 @@ protected:
     ImageProxies images;
     BlobProxies blobs;
     FilenameList to_delete;
+    ViewPackIndex pack_index;
+    ViewCache::Ptr cache;
+    bool compress_float_images = false;
 };
 
 /* ---------------------------------------------------------------- */
@@ -342,6 +450,30 @@ View::get_directory (void) const
     return this->path;
 }
 
+inline bool
+View::is_packed (void) const
+{
+    return !this->pack_index.empty();
+}
+
+inline ViewCache::Ptr
+View::get_cache (void) const
+{
+    return this->cache;
+}
+
+inline void
+View::set_compression (bool compress_float_images)
+{
+    this->compress_float_images = compress_float_images;
+}
+
+inline bool
+View::get_compression (void) const
+{
+    return this->compress_float_images;
+}
+
 inline View::MetaData const&
 View::get_meta_data (void) const
 {
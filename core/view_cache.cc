@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+
+#include "core/view.h"
+#include "core/view_cache.h"
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    /* An image or BLOB of a view that can be released. */
+    struct CacheEntry
+    {
+        uint64_t last_access;
+        View::ImageProxy* image;
+        View::BlobProxy* blob;
+    };
+
+    bool
+    operator< (CacheEntry const& a, CacheEntry const& b)
+    {
+        return a.last_access < b.last_access;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+ViewCache::set_byte_budget (std::size_t byte_budget)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->byte_budget = byte_budget;
+    }
+    this->enforce_budget();
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+ViewCache::get_byte_size (void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->get_byte_size_intern();
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+ViewCache::get_byte_size_intern (void) const
+{
+    std::size_t ret = 0;
+    for (std::size_t i = 0; i < this->views.size(); ++i)
+        ret += this->views[i]->get_byte_size();
+    return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+ViewCache::enforce_budget (void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->byte_budget == 0)
+        return 0;
+
+    std::size_t total = this->get_byte_size_intern();
+    if (total <= this->byte_budget)
+        return 0;
+
+    /*
+     * Collect clean entries that are only referenced by their view. Image
+     * pyramids are released with their image, or alone if the image is
+     * dirty or referenced elsewhere.
+     */
+    std::vector<CacheEntry> entries;
+    for (std::size_t i = 0; i < this->views.size(); ++i)
+    {
+        View* view = this->views[i];
+        for (std::size_t j = 0; j < view->images.size(); ++j)
+        {
+            View::ImageProxy& proxy = view->images[j];
+            if (!View::is_image_releasable(proxy))
+                continue;
+            CacheEntry entry = { proxy.last_access, &proxy, nullptr };
+            entries.push_back(entry);
+        }
+        for (std::size_t j = 0; j < view->blobs.size(); ++j)
+        {
+            View::BlobProxy& proxy = view->blobs[j];
+            if (proxy.is_dirty || proxy.blob.use_count() != 1)
+                continue;
+            CacheEntry entry = { proxy.last_access, nullptr, &proxy };
+            entries.push_back(entry);
+        }
+    }
+
+    /* Release the least recently used entries first. */
+    std::sort(entries.begin(), entries.end());
+    std::size_t released = 0;
+    for (std::size_t i = 0; i < entries.size()
+        && total > this->byte_budget; ++i)
+    {
+        CacheEntry const& entry = entries[i];
+        if (entry.image != nullptr)
+            total -= View::release_image_intern(entry.image);
+        else
+        {
+            total -= entry.blob->blob->get_byte_size();
+            entry.blob->blob.reset();
+        }
+        released += 1;
+    }
+
+    return released;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ViewCache::add_view (View* view)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->views.push_back(view);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ViewCache::remove_view (View* view)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->views.erase(std::remove(this->views.begin(), this->views.end(),
+        view), this->views.end());
+}
+
+CORE_NAMESPACE_END
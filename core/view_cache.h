@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_VIEW_CACHE_HEADER
+#define MVE_VIEW_CACHE_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "core/defines.h"
+
+CORE_NAMESPACE_BEGIN
+
+class View;
+
+/**
+ * Memory budget for the cached images and BLOBs of a set of views.
+ *
+ * Views that are attached to the cache (see View::set_cache()) record the
+ * time of every access to their images and BLOBs. Whenever a view loads an
+ * image or BLOB and the memory of all attached views exceeds the budget,
+ * the least recently used entries are released until the memory is within
+ * the budget again. Only entries that are not dirty and not referenced
+ * outside of their view are released, they are reloaded on the next access.
+ * Thus the budget can be exceeded if the entries in use are larger.
+ * Image pyramids count towards the budget with their computed levels.
+ *
+ * The cache is thread-safe, but releasing entries modifies the views.
+ * Views attached to one cache must therefore not be accessed concurrently.
+ */
+class ViewCache
+{
+public:
+    typedef std::shared_ptr<ViewCache> Ptr;
+
+public:
+    /** Creates a cache with the given budget in bytes, 0 is unlimited. */
+    static Ptr create (std::size_t byte_budget = 0);
+
+    ViewCache (ViewCache const& other) = delete;
+    ViewCache& operator= (ViewCache const& other) = delete;
+
+    /** Sets the budget in bytes and releases entries if necessary. */
+    void set_byte_budget (std::size_t byte_budget);
+    /** Returns the budget in bytes, 0 is unlimited. */
+    std::size_t get_byte_budget (void) const;
+
+    /** Returns the memory of the images and BLOBs of all views. */
+    std::size_t get_byte_size (void) const;
+
+    /**
+     * Releases least recently used entries until the memory is within the
+     * budget. Returns the amount of released entries.
+     */
+    std::size_t enforce_budget (void);
+
+protected:
+    explicit ViewCache (std::size_t byte_budget);
+
+private:
+    friend class View;
+
+    /* Called by the views. */
+    void add_view (View* view);
+    void remove_view (View* view);
+    uint64_t next_access (void);
+
+    std::size_t get_byte_size_intern (void) const;
+
+private:
+    mutable std::mutex mutex;
+    std::size_t byte_budget;
+    std::atomic<uint64_t> access_counter;
+    std::vector<View*> views;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+ViewCache::ViewCache (std::size_t byte_budget)
+    : byte_budget(byte_budget)
+    , access_counter(0)
+{
+}
+
+inline ViewCache::Ptr
+ViewCache::create (std::size_t byte_budget)
+{
+    return Ptr(new ViewCache(byte_budget));
+}
+
+inline std::size_t
+ViewCache::get_byte_budget (void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->byte_budget;
+}
+
+inline uint64_t
+ViewCache::next_access (void)
+{
+    return ++this->access_counter;
+}
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_VIEW_CACHE_HEADER */
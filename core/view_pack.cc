@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include "util/exception.h"
+#include "core/view_pack.h"
+
+#define VIEW_PACK_SIGNATURE "\211MVE_PACK\n"
+#define VIEW_PACK_SIGNATURE_LEN 10
+
+/* Compression is mostly used for checkpoints, so favor speed. */
+#define VIEW_PACK_COMPRESSION_LEVEL 1
+
+CORE_NAMESPACE_BEGIN
+
+namespace
+{
+    template <typename T>
+    void
+    write_value (std::ostream& out, T const& value)
+    {
+        out.write(reinterpret_cast<char const*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    T
+    read_value (std::istream& in)
+    {
+        T value;
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    void
+    write_index (std::ostream& out, ViewPackIndex const& index)
+    {
+        out.write(VIEW_PACK_SIGNATURE, VIEW_PACK_SIGNATURE_LEN);
+        write_value<uint32_t>(out, index.size());
+        for (std::size_t i = 0; i < index.size(); ++i)
+        {
+            ViewPackEntry const& entry = index[i];
+            write_value<uint8_t>(out, entry.kind);
+            write_value<uint8_t>(out, entry.compressed ? 1 : 0);
+            write_value<uint16_t>(out, entry.name.size());
+            out.write(entry.name.data(), entry.name.size());
+            write_value<int32_t>(out, entry.width);
+            write_value<int32_t>(out, entry.height);
+            write_value<int32_t>(out, entry.channels);
+            write_value<int32_t>(out, entry.type);
+            write_value<uint64_t>(out, entry.offset);
+            write_value<uint64_t>(out, entry.stored_size);
+            write_value<uint64_t>(out, entry.size);
+        }
+    }
+
+    bool
+    fits_zlib (uint64_t size)
+    {
+        return size <= std::numeric_limits<uLong>::max();
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+bool
+is_view_pack_file (std::string const& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        return false;
+    char signature[VIEW_PACK_SIGNATURE_LEN];
+    in.read(signature, VIEW_PACK_SIGNATURE_LEN);
+    return in.good() && std::equal(signature,
+        signature + VIEW_PACK_SIGNATURE_LEN, VIEW_PACK_SIGNATURE);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+load_view_pack_index (std::string const& filename, ViewPackIndex* index)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    in.seekg(0, std::ios::end);
+    uint64_t const file_size = in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    char signature[VIEW_PACK_SIGNATURE_LEN];
+    in.read(signature, VIEW_PACK_SIGNATURE_LEN);
+    if (!std::equal(signature, signature + VIEW_PACK_SIGNATURE_LEN,
+        VIEW_PACK_SIGNATURE))
+        throw util::Exception(filename, ": Invalid view pack signature");
+
+    uint32_t const num_entries = read_value<uint32_t>(in);
+    if (!in.good() || num_entries > file_size)
+        throw util::Exception(filename, ": Invalid view pack index");
+
+    index->clear();
+    index->resize(num_entries);
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        ViewPackEntry& entry = index->at(i);
+        uint8_t const kind = read_value<uint8_t>(in);
+        entry.compressed = read_value<uint8_t>(in) != 0;
+        entry.name.resize(read_value<uint16_t>(in));
+        if (!entry.name.empty())
+            in.read(&entry.name[0], entry.name.size());
+        entry.width = read_value<int32_t>(in);
+        entry.height = read_value<int32_t>(in);
+        entry.channels = read_value<int32_t>(in);
+        int32_t const type = read_value<int32_t>(in);
+        entry.offset = read_value<uint64_t>(in);
+        entry.stored_size = read_value<uint64_t>(in);
+        entry.size = read_value<uint64_t>(in);
+        if (!in.good())
+            throw util::Exception(filename, ": EOF while reading index");
+
+        if (kind > ViewPackEntry::KIND_BLOB || entry.name.empty()
+            || type < IMAGE_TYPE_UNKNOWN || type > IMAGE_TYPE_DOUBLE
+            || entry.offset > file_size
+            || entry.stored_size > file_size - entry.offset
+            || (!entry.compressed && entry.stored_size != entry.size))
+            throw util::Exception(filename, ": Invalid entry " + entry.name);
+        entry.kind = static_cast<ViewPackEntry::Kind>(kind);
+        entry.type = static_cast<ImageType>(type);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+load_view_pack_entry (std::string const& filename,
+    ViewPackEntry const& entry, char* buffer)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        throw util::FileException(filename, std::strerror(errno));
+    in.seekg(entry.offset);
+
+    if (!entry.compressed)
+    {
+        in.read(buffer, entry.size);
+        if (!in.good())
+            throw util::Exception(filename, ": EOF while reading "
+                + entry.name);
+        return;
+    }
+
+    if (!fits_zlib(entry.stored_size) || !fits_zlib(entry.size))
+        throw util::Exception(filename, ": Entry too large " + entry.name);
+    std::vector<Bytef> stored(entry.stored_size);
+    in.read(reinterpret_cast<char*>(stored.data()), stored.size());
+    if (!in.good())
+        throw util::Exception(filename, ": EOF while reading " + entry.name);
+
+    uLongf size = entry.size;
+    int const ret = ::uncompress(reinterpret_cast<Bytef*>(buffer), &size,
+        stored.data(), stored.size());
+    if (ret != Z_OK || size != entry.size)
+        throw util::Exception(filename, ": Error decompressing "
+            + entry.name);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+save_view_pack (std::string const& filename, ViewPackIndex* index,
+    std::vector<char const*> const& data, bool compress)
+{
+    if (index->size() != data.size())
+        throw std::invalid_argument("Invalid amount of payloads");
+    for (std::size_t i = 0; i < index->size(); ++i)
+    {
+        ViewPackEntry& entry = index->at(i);
+        if (entry.name.empty()
+            || entry.name.size() > std::numeric_limits<uint16_t>::max())
+            throw std::invalid_argument("Invalid entry name");
+        entry.compressed = false;
+        entry.offset = 0;
+        entry.stored_size = entry.size;
+    }
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    /* Reserve the index, the offsets are known after the payloads. */
+    write_index(out, *index);
+
+    std::vector<Bytef> stored;
+    for (std::size_t i = 0; i < index->size(); ++i)
+    {
+        ViewPackEntry& entry = index->at(i);
+        entry.offset = out.tellp();
+
+        if (compress && entry.size > 0 && fits_zlib(entry.size))
+        {
+            uLongf stored_size = ::compressBound(entry.size);
+            stored.resize(stored_size);
+            int const ret = ::compress2(stored.data(), &stored_size,
+                reinterpret_cast<Bytef const*>(data[i]), entry.size,
+                VIEW_PACK_COMPRESSION_LEVEL);
+            if (ret == Z_OK && stored_size < entry.size)
+            {
+                out.write(reinterpret_cast<char const*>(stored.data()),
+                    stored_size);
+                entry.compressed = true;
+                entry.stored_size = stored_size;
+                continue;
+            }
+        }
+        out.write(data[i], entry.size);
+    }
+
+    out.seekp(0);
+    write_index(out, *index);
+    out.close();
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+}
+
+CORE_NAMESPACE_END
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef MVE_VIEW_PACK_HEADER
+#define MVE_VIEW_PACK_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/defines.h"
+#include "core/image_base.h"
+
+CORE_NAMESPACE_BEGIN
+
+/**
+ * Packed single-file view container.
+ *
+ * All embeddings of a view are stored in one file, which avoids the many
+ * small files of view directories on network file systems. The file
+ * starts with an index of typed entries and their offsets, followed by
+ * the payloads. The meta data is stored as an entry with the INI text.
+ * Each payload is optionally compressed with zlib. Entries are read
+ * individually, so images and BLOBs can be loaded on demand. Uncompressed
+ * image entries can also be mapped with MappedImage at their offset.
+ *
+ * File layout, all values in native byte order:
+ *
+ *   "\211MVE_PACK\n"      The signature
+ *   uint32                The number of entries
+ *   For each entry:
+ *     uint8, uint8        The kind and the compression flag
+ *     uint16, char[]      The length of the name and the name
+ *     int32 (4x)          The width, height, channels and image type
+ *     uint64 (3x)         The offset, the stored size and the size
+ *   Payloads
+ */
+struct ViewPackEntry
+{
+    enum Kind
+    {
+        KIND_META = 0,
+        KIND_IMAGE = 1,
+        KIND_BLOB = 2
+    };
+
+    Kind kind = KIND_META;
+    bool compressed = false;
+    std::string name;
+
+    /* The image specification, only used for images. */
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t channels = 0;
+    ImageType type = IMAGE_TYPE_UNKNOWN;
+
+    /* The file offset of the payload and its stored and decoded size. */
+    uint64_t offset = 0;
+    uint64_t stored_size = 0;
+    uint64_t size = 0;
+};
+
+typedef std::vector<ViewPackEntry> ViewPackIndex;
+
+/** Returns true if the file exists and has the view pack signature. */
+bool
+is_view_pack_file (std::string const& filename);
+
+/** Reads the index of a view pack file. Throws on error. */
+void
+load_view_pack_index (std::string const& filename, ViewPackIndex* index);
+
+/**
+ * Reads and decompresses the payload of an entry into the buffer, which
+ * must hold 'entry.size' bytes. Throws on error.
+ */
+void
+load_view_pack_entry (std::string const& filename,
+    ViewPackEntry const& entry, char* buffer);
+
+/**
+ * Writes a view pack file. The kind, name, image specification and size
+ * of the entries must be set, and 'data' holds the payload of every
+ * entry. The index is updated with the offsets and the compression. With
+ * 'compress', payloads are compressed if that makes them smaller.
+ */
+void
+save_view_pack (std::string const& filename, ViewPackIndex* index,
+    std::vector<char const*> const& data, bool compress);
+
+CORE_NAMESPACE_END
+
+#endif /* MVE_VIEW_PACK_HEADER */
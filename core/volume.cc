@@ -7,12 +7,14 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+
 #include "math/vector.h"
-#include "mve/marching_tets.h"
-#include "mve/marching_cubes.h"
-#include "mve/volume.h"
+#include "core/marching_tets.h"
+#include "core/marching_cubes.h"
+#include "core/volume.h"
 
-MVE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
 
 VolumeMTAccessor::VolumeMTAccessor (void)
     : iter(-1)
@@ -38,7 +40,7 @@ VolumeMTAccessor::next (void)
 
     for (int i = 0; i < 4; ++i)
     {
-        int vertexid = mve::geom::mt_freudenthal[tet_id][i];
+        int vertexid = core::geom::mt_freudenthal[tet_id][i];
         this->vid[i] = this->cube_vids[vertexid];
         this->sdf[i] = this->vol->get_data()[this->vid[i]];
         this->pos[i] = this->cube_pos[vertexid];
@@ -141,4 +143,197 @@ VolumeMCAccessor::has_colors (void) const
     return false;
 }
 
-MVE_NAMESPACE_END
+/* ---------------------------------------------------------------- */
+
+SparseVolumeCubeIterator::SparseVolumeCubeIterator (void)
+    : x(0), y(0), z(0)
+    , initialized(false)
+    , brick_index(0)
+    , background(0.0f)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+SparseVolumeCubeIterator::next (core::SparseFloatVolume const& vol)
+{
+    int const bs = core::SparseFloatVolume::BRICK_SIZE;
+    if (!this->initialized)
+    {
+        /*
+         * A cube covers the voxels of its brick and the first voxels of the
+         * neighboring bricks in positive directions. Thus the cubes next to
+         * allocated bricks in negative directions are iterated as well.
+         */
+        this->initialized = true;
+        this->background = vol.get_background();
+        core::SparseFloatVolume::BrickMap const& bricks = vol.get_bricks();
+        for (core::SparseFloatVolume::BrickMap::const_iterator iter
+            = bricks.begin(); iter != bricks.end(); ++iter)
+        {
+            int bx, by, bz;
+            vol.get_brick_position(iter->first, &bx, &by, &bz);
+            for (int i = 0; i < 8; ++i)
+            {
+                int const cx = bx - (i & 1);
+                int const cy = by - ((i >> 1) & 1);
+                int const cz = bz - ((i >> 2) & 1);
+                if (cx >= 0 && cy >= 0 && cz >= 0)
+                    this->cube_bricks.push_back(vol.get_brick_key(cx, cy, cz));
+            }
+        }
+        std::sort(this->cube_bricks.begin(), this->cube_bricks.end());
+        this->cube_bricks.erase(std::unique(this->cube_bricks.begin(),
+            this->cube_bricks.end()), this->cube_bricks.end());
+        this->brick_index = 0;
+        this->min[0] = this->max[0] = 0;
+        this->min[1] = this->max[1] = 0;
+        this->min[2] = this->max[2] = 0;
+        this->x = this->y = this->z = 0;
+    }
+    else
+    {
+        this->x += 1;
+        if (this->x == this->max[0])
+        {
+            this->x = this->min[0];
+            this->y += 1;
+        }
+        if (this->y == this->max[1])
+        {
+            this->y = this->min[1];
+            this->z += 1;
+        }
+    }
+
+    /* Move to the next brick with cubes. */
+    while (this->z >= this->max[2])
+    {
+        if (this->brick_index == this->cube_bricks.size())
+            return false;
+
+        int bx, by, bz;
+        vol.get_brick_position(this->cube_bricks[this->brick_index++],
+            &bx, &by, &bz);
+        this->min[0] = bx * bs;
+        this->min[1] = by * bs;
+        this->min[2] = bz * bs;
+        this->max[0] = std::min(this->min[0] + bs, vol.width() - 1);
+        this->max[1] = std::min(this->min[1] + bs, vol.height() - 1);
+        this->max[2] = std::min(this->min[2] + bs, vol.depth() - 1);
+        this->x = this->min[0];
+        this->y = this->min[1];
+        this->z = this->min[2];
+        if (this->x >= this->max[0] || this->y >= this->max[1])
+        {
+            this->max[2] = this->min[2];
+            continue;
+        }
+
+        for (int i = 0; i < 8; ++i)
+        {
+            int const nx = bx + (i & 1);
+            int const ny = by + ((i >> 1) & 1);
+            int const nz = bz + ((i >> 2) & 1);
+            bool const inside = nx * bs < vol.width()
+                && ny * bs < vol.height() && nz * bs < vol.depth();
+            this->neighbors[i] = inside
+                ? vol.find_brick(nx, ny, nz) : nullptr;
+        }
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+float
+SparseVolumeCubeIterator::get_value (int ox, int oy, int oz) const
+{
+    int const bs = core::SparseFloatVolume::BRICK_SIZE;
+    int const lx = this->x + ox - this->min[0];
+    int const ly = this->y + oy - this->min[1];
+    int const lz = this->z + oz - this->min[2];
+    int const neighbor = (lx == bs) + 2 * (ly == bs) + 4 * (lz == bs);
+    core::SparseFloatVolume::Brick const* brick = this->neighbors[neighbor];
+    if (brick == nullptr)
+        return this->background;
+    return (*brick)[((lz % bs) * bs + ly % bs) * bs + lx % bs];
+}
+
+/* ---------------------------------------------------------------- */
+
+namespace
+{
+    /* Cube voxel offsets in the order of the cube vertices. */
+    int const cube_offsets[8][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 },
+        { 0, 0, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 0, 1, 1 } };
+
+    /* Loads the voxels of the current cube like VolumeMCAccessor. */
+    void
+    load_sparse_cube (core::SparseFloatVolume const& vol,
+        SparseVolumeCubeIterator const& cubes, float* sdf,
+        std::size_t* vid, math::Vec3f* pos)
+    {
+        std::size_t const width = vol.width();
+        std::size_t const height = vol.height();
+        float spacing = 1.0f / (float)(width - 1);
+        math::Vec3f basepos(cubes.x * spacing - 0.5f,
+            cubes.y * spacing - 0.5f, cubes.z * spacing - 0.5f);
+        for (int i = 0; i < 8; ++i)
+        {
+            int const* o = cube_offsets[i];
+            sdf[i] = cubes.get_value(o[0], o[1], o[2]);
+            vid[i] = ((cubes.z + o[2]) * height + cubes.y + o[1]) * width
+                + cubes.x + o[0];
+            pos[i] = basepos + math::Vec3f(o[0] ? spacing : 0.0f,
+                o[1] ? spacing : 0.0f, o[2] ? spacing : 0.0f);
+        }
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+bool
+SparseVolumeMCAccessor::next (void)
+{
+    if (!this->cubes.next(*this->vol))
+        return false;
+    load_sparse_cube(*this->vol, this->cubes, this->sdf, this->vid, this->pos);
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+SparseVolumeMTAccessor::SparseVolumeMTAccessor (void)
+    : tet_id(5)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+SparseVolumeMTAccessor::next (void)
+{
+    this->tet_id = (this->tet_id + 1) % 6;
+    if (this->tet_id == 0)
+    {
+        if (!this->cubes.next(*this->vol))
+            return false;
+        load_sparse_cube(*this->vol, this->cubes, this->cube_sdf,
+            this->cube_vids, this->cube_pos);
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int vertexid = core::geom::mt_freudenthal[this->tet_id][i];
+        this->vid[i] = this->cube_vids[vertexid];
+        this->sdf[i] = this->cube_sdf[vertexid];
+        this->pos[i] = this->cube_pos[vertexid];
+    }
+
+    return true;
+}
+
+CORE_NAMESPACE_END
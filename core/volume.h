@@ -7,17 +7,19 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#ifndef MVE_VOLUME_HEADER
-#define MVE_VOLUME_HEADER
+#ifndef CORE_VOLUME_HEADER
+#define CORE_VOLUME_HEADER
 
+#include <cstdint>
 #include <vector>
 #include <limits>
 #include <memory>
+#include <unordered_map>
 
 #include "math/vector.h"
-#include "mve/defines.h"
+#include "core/defines.h"
 
-MVE_NAMESPACE_BEGIN
+CORE_NAMESPACE_BEGIN
 
 template <typename T> class Volume;
 typedef Volume<float> FloatVolume;
@@ -52,6 +54,11 @@ public:
     /** Returns depth of the image. */
     int depth (void) const;
 
+    /** Returns the voxel at the given position. */
+    T& at (int x, int y, int z);
+    /** Returns the voxel at the given position. */
+    T const& at (int x, int y, int z) const;
+
 private:
     int w;
     int h;
@@ -67,7 +74,7 @@ private:
     std::size_t iter;
 
 public:
-    mve::FloatVolume::Ptr vol;
+    core::FloatVolume::Ptr vol;
     float sdf[8];
     std::size_t vid[8];
     math::Vec3f pos[8];
@@ -90,17 +97,169 @@ private:
     std::size_t cube_vids[8];
 
 public:
-    mve::FloatVolume::Ptr vol;
+    core::FloatVolume::Ptr vol;
     float sdf[4];
     std::size_t vid[4];
     math::Vec3f pos[4];
+    math::Vec3f color[4];
 
 public:
     VolumeMTAccessor (void);
     bool next (void);
+    bool has_colors (void) const;
     void load_new_cube (void);
 };
 
+/* ---------------------------------------------------------------- */
+
+template <typename T> class SparseVolume;
+typedef SparseVolume<float> SparseFloatVolume;
+
+/**
+ * A sparse volume with regular grid layout. The voxels are stored in
+ * bricks of 8^3 voxels in a hash map, and a brick is allocated on the
+ * first write access to one of its voxels. Voxels in unallocated bricks
+ * have the background value. For SDF volumes that are only written close
+ * to the surface, memory scales with the surface area instead of the
+ * volume. Write access is not thread-safe.
+ */
+template <typename T>
+class SparseVolume
+{
+public:
+    typedef std::shared_ptr<SparseVolume<T> > Ptr;
+    typedef std::shared_ptr<SparseVolume<T> const> ConstPtr;
+    typedef std::vector<T> Brick;
+    typedef std::unordered_map<uint64_t, Brick> BrickMap;
+
+    /** The edge length of the bricks in voxels. */
+    static int const BRICK_SIZE = 8;
+
+public:
+    SparseVolume (void);
+    static Ptr create (int width, int height, int depth, T const& background);
+
+    /** Sets new volume dimensions, clearing previous contents. */
+    void allocate (int width, int height, int depth, T const& background);
+
+    /** Returns width of the volume. */
+    int width (void) const;
+    /** Returns height of the volume. */
+    int height (void) const;
+    /** Returns depth of the volume. */
+    int depth (void) const;
+    /** Returns the value of voxels in unallocated bricks. */
+    T const& get_background (void) const;
+
+    /** Returns the voxel at the given position, allocates its brick. */
+    T& at (int x, int y, int z);
+    /** Returns the voxel at the given position. */
+    T const& at (int x, int y, int z) const;
+
+    /** Returns the brick at the given brick position, allocates it. */
+    Brick& get_brick (int bx, int by, int bz);
+    /** Returns the brick at the given brick position or null. */
+    Brick const* find_brick (int bx, int by, int bz) const;
+    /** Returns all allocated bricks. */
+    BrickMap const& get_bricks (void) const;
+    /** Returns the brick position for a key in the brick map. */
+    void get_brick_position (uint64_t key, int* bx, int* by, int* bz) const;
+
+    /** Returns the key in the brick map for a brick position. */
+    uint64_t get_brick_key (int bx, int by, int bz) const;
+
+    /** Returns the memory of the allocated bricks in bytes. */
+    std::size_t get_byte_size (void) const;
+
+private:
+    int w;
+    int h;
+    int d;
+    T background;
+    BrickMap bricks;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Iterates the cubes of a sparse float volume that can contain the surface,
+ * i.e., the cubes with a voxel in an allocated brick. This is used by the
+ * sparse volume accessors.
+ */
+class SparseVolumeCubeIterator
+{
+public:
+    SparseVolumeCubeIterator (void);
+    /** Moves to the next cube, initializes on the first call. */
+    bool next (core::SparseFloatVolume const& vol);
+    /** Returns the SDF value of a cube voxel, offsets are 0 or 1. */
+    float get_value (int ox, int oy, int oz) const;
+
+public:
+    /* The voxel position of the current cube. */
+    int x;
+    int y;
+    int z;
+
+private:
+    void load_brick (core::SparseFloatVolume const& vol);
+
+private:
+    bool initialized;
+    std::vector<uint64_t> cube_bricks;
+    std::size_t brick_index;
+    int min[3];
+    int max[3];
+    /* The brick of the cube and its neighbors in positive directions. */
+    core::SparseFloatVolume::Brick const* neighbors[8];
+    float background;
+};
+
+/* ---------------------------------------------------------------- */
+
+/** Marching cubes accessor for sparse float volumes. */
+class SparseVolumeMCAccessor
+{
+private:
+    SparseVolumeCubeIterator cubes;
+
+public:
+    core::SparseFloatVolume::Ptr vol;
+    float sdf[8];
+    std::size_t vid[8];
+    math::Vec3f pos[8];
+    math::Vec3f color[8];
+
+public:
+    bool next (void);
+    bool has_colors (void) const;
+};
+
+/* ---------------------------------------------------------------- */
+
+/** Marching tetrahedra accessor for sparse float volumes. */
+class SparseVolumeMTAccessor
+{
+private:
+    SparseVolumeCubeIterator cubes;
+    int tet_id;
+    float cube_sdf[8];
+    math::Vec3f cube_pos[8];
+    std::size_t cube_vids[8];
+
+public:
+    core::SparseFloatVolume::Ptr vol;
+    float sdf[4];
+    std::size_t vid[4];
+    math::Vec3f pos[4];
+    math::Vec3f color[4];
+
+public:
+    SparseVolumeMTAccessor (void);
+    bool next (void);
+    bool has_colors (void) const;
+};
+
 /* -------------------------- Implementation ---------------------- */
 
 template <typename T>
@@ -164,6 +323,180 @@ Volume<T>::depth (void) const
     return this->d;
 }
 
-MVE_NAMESPACE_END
+template <typename T>
+inline T&
+Volume<T>::at (int x, int y, int z)
+{
+    return this->data[(static_cast<std::size_t>(z) * this->h + y)
+        * this->w + x];
+}
+
+template <typename T>
+inline T const&
+Volume<T>::at (int x, int y, int z) const
+{
+    return this->data[(static_cast<std::size_t>(z) * this->h + y)
+        * this->w + x];
+}
+
+
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+int const SparseVolume<T>::BRICK_SIZE;
+
+template <typename T>
+inline
+SparseVolume<T>::SparseVolume (void)
+    : w(0), h(0), d(0), background()
+{
+}
+
+template <typename T>
+inline typename SparseVolume<T>::Ptr
+SparseVolume<T>::create (int width, int height, int depth,
+    T const& background)
+{
+    typename SparseVolume<T>::Ptr v(new SparseVolume());
+    v->allocate(width, height, depth, background);
+    return v;
+}
+
+template <typename T>
+inline void
+SparseVolume<T>::allocate (int width, int height, int depth,
+    T const& background)
+{
+    this->w = width;
+    this->h = height;
+    this->d = depth;
+    this->background = background;
+    BrickMap().swap(this->bricks);
+}
+
+template <typename T>
+inline int
+SparseVolume<T>::width (void) const
+{
+    return this->w;
+}
+
+template <typename T>
+inline int
+SparseVolume<T>::height (void) const
+{
+    return this->h;
+}
+
+template <typename T>
+inline int
+SparseVolume<T>::depth (void) const
+{
+    return this->d;
+}
+
+template <typename T>
+inline T const&
+SparseVolume<T>::get_background (void) const
+{
+    return this->background;
+}
+
+template <typename T>
+inline uint64_t
+SparseVolume<T>::get_brick_key (int bx, int by, int bz) const
+{
+    uint64_t const bw = (this->w + BRICK_SIZE - 1) / BRICK_SIZE;
+    uint64_t const bh = (this->h + BRICK_SIZE - 1) / BRICK_SIZE;
+    return (static_cast<uint64_t>(bz) * bh + by) * bw + bx;
+}
+
+template <typename T>
+inline void
+SparseVolume<T>::get_brick_position (uint64_t key,
+    int* bx, int* by, int* bz) const
+{
+    uint64_t const bw = (this->w + BRICK_SIZE - 1) / BRICK_SIZE;
+    uint64_t const bh = (this->h + BRICK_SIZE - 1) / BRICK_SIZE;
+    *bx = static_cast<int>(key % bw);
+    *by = static_cast<int>(key / bw % bh);
+    *bz = static_cast<int>(key / bw / bh);
+}
+
+template <typename T>
+inline typename SparseVolume<T>::Brick&
+SparseVolume<T>::get_brick (int bx, int by, int bz)
+{
+    Brick& brick = this->bricks[this->get_brick_key(bx, by, bz)];
+    if (brick.empty())
+        brick.resize(BRICK_SIZE * BRICK_SIZE * BRICK_SIZE, this->background);
+    return brick;
+}
+
+template <typename T>
+inline T&
+SparseVolume<T>::at (int x, int y, int z)
+{
+    Brick& brick = this->get_brick(x / BRICK_SIZE, y / BRICK_SIZE,
+        z / BRICK_SIZE);
+    return brick[((z % BRICK_SIZE) * BRICK_SIZE + y % BRICK_SIZE)
+        * BRICK_SIZE + x % BRICK_SIZE];
+}
+
+template <typename T>
+inline T const&
+SparseVolume<T>::at (int x, int y, int z) const
+{
+    Brick const* brick = this->find_brick(x / BRICK_SIZE,
+        y / BRICK_SIZE, z / BRICK_SIZE);
+    if (brick == nullptr)
+        return this->background;
+    return (*brick)[((z % BRICK_SIZE) * BRICK_SIZE + y % BRICK_SIZE)
+        * BRICK_SIZE + x % BRICK_SIZE];
+}
+
+template <typename T>
+inline typename SparseVolume<T>::Brick const*
+SparseVolume<T>::find_brick (int bx, int by, int bz) const
+{
+    typename BrickMap::const_iterator iter
+        = this->bricks.find(this->get_brick_key(bx, by, bz));
+    return iter == this->bricks.end() ? nullptr : &iter->second;
+}
+
+template <typename T>
+inline typename SparseVolume<T>::BrickMap const&
+SparseVolume<T>::get_bricks (void) const
+{
+    return this->bricks;
+}
+
+template <typename T>
+inline std::size_t
+SparseVolume<T>::get_byte_size (void) const
+{
+    return this->bricks.size() * (sizeof(uint64_t) + sizeof(Brick)
+        + BRICK_SIZE * BRICK_SIZE * BRICK_SIZE * sizeof(T));
+}
+
+inline bool
+VolumeMTAccessor::has_colors (void) const
+{
+    return false;
+}
+
+inline bool
+SparseVolumeMCAccessor::has_colors (void) const
+{
+    return false;
+}
+
+inline bool
+SparseVolumeMTAccessor::has_colors (void) const
+{
+    return false;
+}
+
+CORE_NAMESPACE_END
 
-#endif /* MVE_VOLUME_HEADER */
+#endif /* CORE_VOLUME_HEADER */
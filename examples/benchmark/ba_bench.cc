@@ -0,0 +1,502 @@
+/*
+ * Benchmark for the bundle adjustment. Generates a synthetic scene with
+ * cameras on a circle around a cube of points, or loads a problem in the
+ * BAL format (Bundle Adjustment in the Large), and runs the bundle
+ * adjustment in every mode with the available linear solver options.
+ * Reports the time per LM iteration split into the Jacobian, the Schur
+ * complement, the linear solve and the update, and the peak memory. The
+ * results can be written to a CSV file to track regressions.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
+
+#include "util/arguments.h"
+#include "util/exception.h"
+#include "math/defines.h"
+#include "math/matrix_tools.h"
+#include "sfm/bundle_adjustment.h"
+
+typedef sfm::ba::BundleAdjustment BundleAdjustment;
+typedef sfm::ba::LinearSolver LinearSolver;
+
+/* Returns the peak resident set size of the process in kilobytes. */
+std::size_t
+get_peak_rss_kb (void)
+{
+#if defined(__linux__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#elif defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+#else
+    return 0;
+#endif
+}
+
+/* Computes the rotation matrix for the axis-angle vector r. */
+void
+rodrigues_to_matrix (double const* r, double* rot)
+{
+    double const angle = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    if (angle < 1e-12)
+    {
+        std::fill(rot, rot + 9, 0.0);
+        rot[0] = rot[4] = rot[8] = 1.0;
+        return;
+    }
+
+    double const x = r[0] / angle, y = r[1] / angle, z = r[2] / angle;
+    double const c = std::cos(angle), s = std::sin(angle), t = 1.0 - c;
+    rot[0] = t * x * x + c;
+    rot[1] = t * x * y - s * z;
+    rot[2] = t * x * z + s * y;
+    rot[3] = t * x * y + s * z;
+    rot[4] = t * y * y + c;
+    rot[5] = t * y * z - s * x;
+    rot[6] = t * x * z - s * y;
+    rot[7] = t * y * z + s * x;
+    rot[8] = t * z * z + c;
+}
+
+/* The cameras, points and observations of a bundle adjustment problem. */
+struct Problem
+{
+    std::vector<sfm::ba::Camera> cameras;
+    std::vector<sfm::ba::Point3D> points;
+    std::vector<sfm::ba::Observation> observations;
+};
+
+/* ---------------------------------------------------------------- */
+
+struct SceneSettings
+{
+    int num_cameras;
+    int num_points;
+    int observations_per_point;
+    int camera_window;
+    double noise;
+    double perturbation;
+    unsigned int seed;
+};
+
+/*
+ * Generates cameras on a circle of radius 4 looking at the origin and
+ * points in the cube [-1, 1]^3. Every point is observed by the given
+ * number of random cameras, or of random cameras within a window of
+ * consecutive cameras like in a sequence. All observations have Gaussian
+ * noise. The cameras and points are then perturbed as initialization.
+ */
+void
+generate_scene (SceneSettings const& conf, Problem* problem)
+{
+    std::mt19937 prng(conf.seed);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    problem->cameras.resize(conf.num_cameras);
+    for (int i = 0; i < conf.num_cameras; ++i)
+    {
+        /* The camera looks along its z-axis into the circle. */
+        double const angle = 2.0 * MATH_PI * i / conf.num_cameras;
+        double const axis[3] = { 0.0, MATH_PI / 2.0 + angle, 0.0 };
+        sfm::ba::Camera& cam = problem->cameras[i];
+        cam.focal_length = 1.0;
+        rodrigues_to_matrix(axis, cam.rotation);
+        double const center[3] = { 4.0 * std::cos(angle),
+            0.5 * std::sin(3.0 * angle), 4.0 * std::sin(angle) };
+        for (int r = 0; r < 3; ++r)
+            cam.translation[r] = -(cam.rotation[r * 3 + 0] * center[0]
+                + cam.rotation[r * 3 + 1] * center[1]
+                + cam.rotation[r * 3 + 2] * center[2]);
+    }
+
+    problem->points.resize(conf.num_points);
+    for (int i = 0; i < conf.num_points; ++i)
+        for (int d = 0; d < 3; ++d)
+            problem->points[i].pos[d] = uniform(prng);
+
+    int const window = conf.camera_window > 0
+        ? std::min(conf.camera_window, conf.num_cameras) : conf.num_cameras;
+    int const per_point = std::min(conf.observations_per_point, window);
+    std::uniform_int_distribution<int> pick_start(0, conf.num_cameras - 1);
+    std::vector<int> camera_ids(window);
+    problem->observations.clear();
+    problem->observations.reserve(conf.num_points * per_point);
+    for (int i = 0; i < conf.num_points; ++i)
+    {
+        int const start = window < conf.num_cameras ? pick_start(prng) : 0;
+        for (int j = 0; j < window; ++j)
+            camera_ids[j] = (start + j) % conf.num_cameras;
+        for (int j = 0; j < per_point; ++j)
+        {
+            std::uniform_int_distribution<int> pick(j, window - 1);
+            std::swap(camera_ids[j], camera_ids[pick(prng)]);
+
+            sfm::ba::Camera const& cam = problem->cameras[camera_ids[j]];
+            double const* pos = problem->points[i].pos;
+            double p[3];
+            for (int r = 0; r < 3; ++r)
+                p[r] = cam.rotation[r * 3 + 0] * pos[0]
+                    + cam.rotation[r * 3 + 1] * pos[1]
+                    + cam.rotation[r * 3 + 2] * pos[2] + cam.translation[r];
+
+            sfm::ba::Observation obs;
+            obs.camera_id = camera_ids[j];
+            obs.point_id = i;
+            obs.pos[0] = cam.focal_length * p[0] / p[2]
+                + conf.noise * noise(prng);
+            obs.pos[1] = cam.focal_length * p[1] / p[2]
+                + conf.noise * noise(prng);
+            problem->observations.push_back(obs);
+        }
+    }
+
+    /* Perturb the poses and points as initialization. */
+    for (std::size_t i = 0; i < problem->cameras.size(); ++i)
+    {
+        sfm::ba::Camera& cam = problem->cameras[i];
+        double const axis[3] = { conf.perturbation * noise(prng),
+            conf.perturbation * noise(prng), conf.perturbation * noise(prng) };
+        double delta[9], rot[9];
+        rodrigues_to_matrix(axis, delta);
+        math::matrix_multiply(delta, 3, 3, cam.rotation, 3, rot);
+        std::copy(rot, rot + 9, cam.rotation);
+        for (int d = 0; d < 3; ++d)
+            cam.translation[d] += conf.perturbation * noise(prng);
+    }
+    for (std::size_t i = 0; i < problem->points.size(); ++i)
+        for (int d = 0; d < 3; ++d)
+            problem->points[i].pos[d] += conf.perturbation * noise(prng);
+}
+
+/*
+ * Loads a problem in the BAL format. A BAL camera projects with
+ * p = -P / P.z for P = R * X + t, these cameras project with p = P / P.z,
+ * which is compensated by negating the observations. The camera model
+ * f * (1 + k1 * |p|^2 + k2 * |p|^4) * p is the same.
+ */
+void
+load_bal_problem (std::string const& filename, Problem* problem)
+{
+    std::ifstream in(filename.c_str());
+    if (!in.good())
+        throw util::FileException(filename, "Cannot open file");
+
+    int num_cameras = 0, num_points = 0, num_observations = 0;
+    in >> num_cameras >> num_points >> num_observations;
+    if (!in.good() || num_cameras <= 0 || num_points <= 0
+        || num_observations <= 0)
+        throw util::Exception("Invalid BAL header");
+
+    problem->observations.resize(num_observations);
+    for (int i = 0; i < num_observations; ++i)
+    {
+        sfm::ba::Observation& obs = problem->observations[i];
+        in >> obs.camera_id >> obs.point_id >> obs.pos[0] >> obs.pos[1];
+        obs.pos[0] = -obs.pos[0];
+        obs.pos[1] = -obs.pos[1];
+    }
+
+    problem->cameras.resize(num_cameras);
+    for (int i = 0; i < num_cameras; ++i)
+    {
+        sfm::ba::Camera& cam = problem->cameras[i];
+        double axis[3];
+        in >> axis[0] >> axis[1] >> axis[2];
+        in >> cam.translation[0] >> cam.translation[1] >> cam.translation[2];
+        in >> cam.focal_length >> cam.distortion[0] >> cam.distortion[1];
+        rodrigues_to_matrix(axis, cam.rotation);
+    }
+
+    problem->points.resize(num_points);
+    for (int i = 0; i < num_points; ++i)
+        in >> problem->points[i].pos[0] >> problem->points[i].pos[1]
+            >> problem->points[i].pos[2];
+    if (in.fail())
+        throw util::Exception("Premature EOF");
+}
+
+/* ---------------------------------------------------------------- */
+
+/* A bundle adjustment mode with linear solver options. */
+struct Variant
+{
+    std::string name;
+    BundleAdjustment::BAMode mode;
+    LinearSolver::Options linear_opts;
+    bool single_precision;
+};
+
+void
+add_variant (std::string const& name, BundleAdjustment::BAMode mode,
+    LinearSolver::Backend backend, bool implicit_schur,
+    LinearSolver::Preconditioner preconditioner, bool single_precision,
+    std::vector<Variant>* variants)
+{
+    Variant variant;
+    variant.name = name;
+    variant.mode = mode;
+    variant.linear_opts.backend = backend;
+    variant.linear_opts.implicit_schur = implicit_schur;
+    variant.linear_opts.preconditioner = preconditioner;
+    variant.single_precision = single_precision;
+    variants->push_back(variant);
+}
+
+struct AppSettings
+{
+    SceneSettings scene;
+    std::string bal_file;
+    std::string variant_filter;
+    std::string output_file;
+    int lm_iterations;
+    bool fixed_intrinsics;
+    bool shared_intrinsics;
+    double cg_forcing_max;
+};
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ] [ BAL_FILE ]");
+    args.set_description("Runs the bundle adjustment in every mode with the "
+        "linear solver options on a synthetic scene or the given BAL problem "
+        "and reports the time per LM iteration for the Jacobian, the Schur "
+        "complement, the linear solve and the update, and the peak memory. "
+        "The peak memory is the one of the process, use --variant to "
+        "measure a single variant.");
+    args.add_option('c', "cameras", true, "Cameras of the scene [100]");
+    args.add_option('p', "points", true, "Points of the scene [10000]");
+    args.add_option('k', "observations", true,
+        "Observations per point [4]");
+    args.add_option('w', "window", true,
+        "Observations from a window of consecutive cameras [0 = all]");
+    args.add_option('n', "noise", true, "Observation noise [0.001]");
+    args.add_option('e', "perturbation", true,
+        "Perturbation of the initial cameras and points [0.01]");
+    args.add_option('s', "seed", true, "Seed of the scene generator [1]");
+    args.add_option('i', "lm-iterations", true, "Maximum LM iterations [10]");
+    args.add_option('f', "fixed-intrinsics", false,
+        "Keeps focal length and distortion fixed");
+    args.add_option('\0', "shared-intrinsics", false,
+        "Optimizes one focal length and distortion for all cameras");
+    args.add_option('\0', "cg-forcing", true,
+        "Inexact CG steps with the maximum forcing term, e.g. 0.5 [0]");
+    args.add_option('v', "variant", true,
+        "Runs only variants whose name contains the string");
+    args.add_option('o', "output", true, "Writes results as CSV file");
+    args.parse(argc, argv);
+
+    AppSettings conf;
+    conf.scene.num_cameras = 100;
+    conf.scene.num_points = 10000;
+    conf.scene.observations_per_point = 4;
+    conf.scene.camera_window = 0;
+    conf.scene.noise = 0.001;
+    conf.scene.perturbation = 0.01;
+    conf.scene.seed = 1;
+    conf.lm_iterations = 10;
+    conf.fixed_intrinsics = false;
+    conf.shared_intrinsics = false;
+    conf.cg_forcing_max = 0.0;
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+        {
+            conf.bal_file = i->arg;
+            continue;
+        }
+        if (i->opt->lopt == "cameras")
+            conf.scene.num_cameras = std::max(2, i->get_arg<int>());
+        else if (i->opt->lopt == "points")
+            conf.scene.num_points = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "observations")
+            conf.scene.observations_per_point
+                = std::max(2, i->get_arg<int>());
+        else if (i->opt->lopt == "window")
+            conf.scene.camera_window = std::max(0, i->get_arg<int>());
+        else if (i->opt->lopt == "noise")
+            conf.scene.noise = i->get_arg<double>();
+        else if (i->opt->lopt == "perturbation")
+            conf.scene.perturbation = i->get_arg<double>();
+        else if (i->opt->lopt == "seed")
+            conf.scene.seed = i->get_arg<unsigned int>();
+        else if (i->opt->lopt == "lm-iterations")
+            conf.lm_iterations = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "fixed-intrinsics")
+            conf.fixed_intrinsics = true;
+        else if (i->opt->lopt == "shared-intrinsics")
+            conf.shared_intrinsics = true;
+        else if (i->opt->lopt == "cg-forcing")
+            conf.cg_forcing_max = i->get_arg<double>();
+        else if (i->opt->lopt == "variant")
+            conf.variant_filter = i->arg;
+        else if (i->opt->lopt == "output")
+            conf.output_file = i->arg;
+    }
+
+    Problem problem;
+    try
+    {
+        if (conf.bal_file.empty())
+            generate_scene(conf.scene, &problem);
+        else
+            load_bal_problem(conf.bal_file, &problem);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Problem: " << problem.cameras.size() << " cameras, "
+        << problem.points.size() << " points, "
+        << problem.observations.size() << " observations" << std::endl;
+
+    /*
+     * The dense reduced camera system is only solved for small problems,
+     * it needs the memory of the full matrix. Modes with cameras or points
+     * only have a block diagonal system without solver options. The auto
+     * variant selects the solver from the pattern of the system.
+     */
+    std::size_t const max_dense_cameras = 2000;
+    LinearSolver::Backend const automatic = LinearSolver::BACKEND_AUTO;
+    LinearSolver::Backend const cg = LinearSolver::BACKEND_CG;
+    LinearSolver::Backend const dense = LinearSolver::BACKEND_DENSE;
+    LinearSolver::Backend const sparse = LinearSolver::BACKEND_SPARSE;
+    LinearSolver::Preconditioner const b_blocks
+        = LinearSolver::PRECONDITIONER_B_BLOCKS;
+    LinearSolver::Preconditioner const s_blocks
+        = LinearSolver::PRECONDITIONER_S_BLOCKS;
+    std::vector<Variant> variants;
+    add_variant("cameras", BundleAdjustment::BA_CAMERAS, cg,
+        false, b_blocks, false, &variants);
+    add_variant("cameras-float", BundleAdjustment::BA_CAMERAS, cg,
+        false, b_blocks, true, &variants);
+    add_variant("points", BundleAdjustment::BA_POINTS, cg,
+        false, b_blocks, false, &variants);
+    add_variant("points-float", BundleAdjustment::BA_POINTS, cg,
+        false, b_blocks, true, &variants);
+    if (problem.cameras.size() <= max_dense_cameras)
+        add_variant("full-dense", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+            dense, false, b_blocks, false, &variants);
+    add_variant("full-sparse", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        sparse, false, b_blocks, false, &variants);
+    add_variant("full-sparse-float", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        sparse, false, b_blocks, true, &variants);
+    add_variant("full-auto", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        automatic, false, b_blocks, false, &variants);
+    add_variant("full-cg-b", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        cg, false, b_blocks, false, &variants);
+    add_variant("full-cg-s", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        cg, false, s_blocks, false, &variants);
+    add_variant("full-implicit-b", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        cg, true, b_blocks, false, &variants);
+    add_variant("full-implicit-s", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        cg, true, s_blocks, false, &variants);
+    add_variant("full-cg-s-float", BundleAdjustment::BA_CAMERAS_AND_POINTS,
+        cg, false, s_blocks, true, &variants);
+
+    std::ofstream csv;
+    if (!conf.output_file.empty())
+    {
+        csv.open(conf.output_file.c_str());
+        if (!csv.good())
+        {
+            std::cerr << "Error opening " << conf.output_file << std::endl;
+            return 1;
+        }
+        csv << "variant,cameras,points,observations,lm_iterations,"
+            << "cg_iterations,initial_mse,final_mse,jacobian_ms,schur_ms,"
+            << "solve_ms,update_ms,total_ms,peak_rss_kb" << std::endl;
+    }
+
+    std::cout << "Times are in ms per LM iteration." << std::endl;
+    std::cout << std::left << std::setw(17) << "Variant"
+        << std::right << std::setw(4) << "LM" << std::setw(7) << "CG"
+        << std::setw(12) << "Final MSE" << std::setw(10) << "Jacobian"
+        << std::setw(9) << "Schur" << std::setw(9) << "Solve"
+        << std::setw(9) << "Update" << std::setw(10) << "Total ms"
+        << std::setw(11) << "Peak KB" << std::endl;
+    for (std::size_t v = 0; v < variants.size(); ++v)
+    {
+        Variant const& variant = variants[v];
+        if (variant.name.find(conf.variant_filter) == std::string::npos)
+            continue;
+
+        std::vector<sfm::ba::Camera> cameras = problem.cameras;
+        std::vector<sfm::ba::Point3D> points = problem.points;
+        std::vector<sfm::ba::Observation> observations = problem.observations;
+
+        BundleAdjustment::Options ba_opts;
+        ba_opts.bundle_mode = variant.mode;
+        ba_opts.fixed_intrinsics = conf.fixed_intrinsics;
+        ba_opts.shared_intrinsics = conf.shared_intrinsics;
+        ba_opts.lm_max_iterations = conf.lm_iterations;
+        ba_opts.single_precision = variant.single_precision;
+        ba_opts.linear_opts = variant.linear_opts;
+        ba_opts.linear_opts.cg_forcing_max = conf.cg_forcing_max;
+        ba_opts.linear_opts.cg_warm_start = conf.cg_forcing_max > 0.0;
+        BundleAdjustment ba(ba_opts);
+        ba.set_cameras(&cameras);
+        ba.set_points(&points);
+        ba.set_observations(&observations);
+
+        BundleAdjustment::Status status;
+        try
+        {
+            status = ba.optimize();
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << variant.name << ": " << e.what() << std::endl;
+            continue;
+        }
+
+        double const per_iteration = 1.0
+            / std::max(1, status.num_lm_iterations);
+        std::size_t const peak_rss = get_peak_rss_kb();
+        std::cout << std::left << std::setw(17) << variant.name
+            << std::right << std::setw(4) << status.num_lm_iterations
+            << std::setw(7) << status.num_cg_iterations
+            << std::scientific << std::setprecision(3)
+            << std::setw(12) << status.final_mse
+            << std::fixed << std::setprecision(1)
+            << std::setw(10) << status.jacobian_time * per_iteration
+            << std::setw(9) << status.schur_time * per_iteration
+            << std::setw(9) << status.solve_time * per_iteration
+            << std::setw(9) << status.update_time * per_iteration
+            << std::setw(10) << status.runtime_ms
+            << std::setw(11) << peak_rss << std::endl;
+
+        if (!csv.is_open())
+            continue;
+        csv << variant.name << "," << cameras.size() << ","
+            << points.size() << "," << observations.size() << ","
+            << status.num_lm_iterations << "," << status.num_cg_iterations
+            << "," << status.initial_mse << "," << status.final_mse << ","
+            << status.jacobian_time * per_iteration << ","
+            << status.schur_time * per_iteration << ","
+            << status.solve_time * per_iteration << ","
+            << status.update_time * per_iteration << ","
+            << status.runtime_ms << "," << peak_rss << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Benchmark for the gaussian blur of float images. Compares the generic
+ * (scalar) implementation with the specialized float implementation and
+ * the variant that reuses a caller-supplied output image.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "math/accum.h"
+#include "math/functions.h"
+#include "util/timer.h"
+#include "core/image.h"
+#include "core/image_io.h"
+#include "core/image_tools.h"
+
+/* Copy of the generic scalar implementation in core/image_tools.h. */
+core::FloatImage::Ptr
+blur_gaussian_reference (core::FloatImage::ConstPtr in, float sigma)
+{
+    int const w = in->width();
+    int const h = in->height();
+    int const c = in->channels();
+    int const ks = std::ceil(sigma * 2.884f);
+    std::vector<float> kernel(ks + 1);
+    for (int i = 0; i < ks + 1; ++i)
+        kernel[i] = math::gaussian((float)i, sigma);
+
+    core::FloatImage::Ptr sep = core::FloatImage::create(w, h, c);
+    int px = 0;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x, ++px)
+            for (int cc = 0; cc < c; ++cc)
+            {
+                math::Accum<float> accum(0.0f);
+                for (int i = -ks; i <= ks; ++i)
+                {
+                    int idx = math::clamp(x + i, 0, w - 1);
+                    accum.add(in->at(y * w + idx, cc), kernel[std::abs(i)]);
+                }
+                sep->at(px, cc) = accum.normalized();
+            }
+
+    core::FloatImage::Ptr out = core::FloatImage::create(w, h, c);
+    px = 0;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x, ++px)
+            for (int cc = 0; cc < c; ++cc)
+            {
+                math::Accum<float> accum(0.0f);
+                for (int i = -ks; i <= ks; ++i)
+                {
+                    int idx = math::clamp(y + i, 0, h - 1);
+                    accum.add(sep->at(idx * w + x, cc), kernel[std::abs(i)]);
+                }
+                out->at(px, cc) = accum.normalized();
+            }
+    return out;
+}
+
+float
+max_abs_difference (core::FloatImage::ConstPtr a, core::FloatImage::ConstPtr b)
+{
+    float diff = 0.0f;
+    for (int i = 0; i < a->get_value_amount(); ++i)
+        diff = std::max(diff, std::abs(a->at(i) - b->at(i)));
+    return diff;
+}
+
+int
+main (int argc, char** argv)
+{
+    core::FloatImage::Ptr image;
+    if (argc > 1)
+    {
+        try
+        {
+            core::ByteImage::Ptr bimg = core::image::load_file(argv[1]);
+            image = core::image::byte_to_float_image(bimg);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        /* Synthetic test image with some structure. */
+        image = core::FloatImage::create(1920, 1080, 1);
+        std::srand(0);
+        for (int i = 0; i < image->get_value_amount(); ++i)
+            image->at(i) = static_cast<float>(std::rand()) / RAND_MAX;
+    }
+
+    int const repetitions = 5;
+    std::cout << "Image size: " << image->width() << "x" << image->height()
+        << "x" << image->channels() << ", " << repetitions
+        << " repetitions" << std::endl;
+    std::cout << std::setw(6) << "sigma"
+        << std::setw(14) << "generic [ms]"
+        << std::setw(14) << "float [ms]"
+        << std::setw(14) << "reuse [ms]"
+        << std::setw(10) << "speedup"
+        << std::setw(12) << "max diff" << std::endl;
+
+    float const sigmas[] = { 1.0f, 1.5f, 2.0f, 2.5f, 3.0f };
+    for (float sigma : sigmas)
+    {
+        core::FloatImage::Ptr ref, fast;
+        core::FloatImage::Ptr reuse = core::FloatImage::create();
+
+        util::WallTimer timer;
+        for (int i = 0; i < repetitions; ++i)
+            ref = blur_gaussian_reference(image, sigma);
+        float const time_ref = timer.get_elapsed() / (float)repetitions;
+
+        timer.reset();
+        for (int i = 0; i < repetitions; ++i)
+            fast = core::image::blur_gaussian<float>(image, sigma);
+        float const time_fast = timer.get_elapsed() / (float)repetitions;
+
+        timer.reset();
+        for (int i = 0; i < repetitions; ++i)
+            core::image::blur_gaussian(image, reuse, sigma);
+        float const time_reuse = timer.get_elapsed() / (float)repetitions;
+
+        float const diff = std::max(max_abs_difference(ref, fast),
+            max_abs_difference(ref, reuse));
+        std::cout << std::setw(6) << sigma
+            << std::setw(14) << time_ref
+            << std::setw(14) << time_fast
+            << std::setw(14) << time_reuse
+            << std::setw(10) << std::setprecision(3)
+            << time_ref / std::max(time_reuse, 1.0f)
+            << std::setw(12) << diff << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Benchmark for the SIFT and SURF feature detectors. Runs the detectors
+ * on all images of the given directories and reports wall times for the
+ * individual stages, the keypoint throughput and the peak memory usage.
+ * The results can be written to a CSV file to track regressions.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
+
+#include "util/arguments.h"
+#include "util/file_system.h"
+#include "util/strings.h"
+#include "util/timer.h"
+#include "core/image.h"
+#include "core/image_io.h"
+#include "features/sift.h"
+#include "features/surf.h"
+
+/* Wall times of the detector stages in milliseconds. */
+struct StageTimes
+{
+    std::vector<std::string> names;
+    std::vector<std::size_t> times;
+
+    void add (std::string const& name, util::WallTimer* timer)
+    {
+        this->names.push_back(name);
+        this->times.push_back(timer->get_elapsed());
+        timer->reset();
+    }
+};
+
+/* Exposes the individual SIFT stages. */
+class SiftBenchmark : public features::Sift
+{
+public:
+    explicit SiftBenchmark (Options const& options) : Sift(options) {}
+
+    void run (StageTimes* stages)
+    {
+        /* The DoG images are created along with the octaves. */
+        util::WallTimer timer;
+        this->create_octaves();
+        stages->add("octaves+dog", &timer);
+        this->extrema_detection();
+        stages->add("extrema", &timer);
+        this->keypoint_localization();
+        stages->add("localization", &timer);
+        /* Orientations are assigned per keypoint along with descriptors. */
+        this->descriptor_generation(nullptr);
+        stages->add("orientation+descriptors", &timer);
+    }
+};
+
+/* Exposes the individual SURF stages. */
+class SurfBenchmark : public features::Surf
+{
+public:
+    explicit SurfBenchmark (Options const& options) : Surf(options) {}
+
+    void run (core::ByteImage::ConstPtr image, StageTimes* stages)
+    {
+        util::WallTimer timer;
+        this->set_image(image);
+        stages->add("sat", &timer);
+        this->create_octaves();
+        stages->add("octaves", &timer);
+        this->extrema_detection();
+        stages->add("extrema", &timer);
+        this->keypoint_localization_and_filtering();
+        stages->add("localization", &timer);
+        this->descriptor_assignment();
+        stages->add("orientation+descriptors", &timer);
+    }
+};
+
+/* Returns the peak resident set size of the process in kilobytes. */
+std::size_t
+get_peak_rss_kb (void)
+{
+#if defined(__linux__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#elif defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+#else
+    return 0;
+#endif
+}
+
+bool
+is_image_file (std::string const& filename)
+{
+    std::string const ext = util::string::lowercase
+        (util::string::right(filename, 4));
+    return ext == ".jpg" || ext == "jpeg" || ext == ".png" || ext == ".tif";
+}
+
+struct AppSettings
+{
+    std::vector<std::string> directories;
+    std::string output_file;
+    int repetitions;
+    int num_threads;
+    bool run_sift;
+    bool run_surf;
+};
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ] [ DIRECTORY ... ]");
+    args.set_description("Runs SIFT and SURF on all images in the given "
+        "directories (defaults to examples/data/sequence) and reports "
+        "per-stage wall times, keypoint throughput and peak memory.");
+    args.add_option('r', "repetitions", true, "Repetitions per image [3]");
+    args.add_option('t', "threads", true, "Detector threads, 0 = all [1]");
+    args.add_option('o', "output", true, "Writes results as CSV file");
+    args.add_option('\0', "no-sift", false, "Skips the SIFT detector");
+    args.add_option('\0', "no-surf", false, "Skips the SURF detector");
+    args.parse(argc, argv);
+
+    AppSettings conf;
+    conf.repetitions = 3;
+    conf.num_threads = 1;
+    conf.run_sift = true;
+    conf.run_surf = true;
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+        {
+            conf.directories.push_back(i->arg);
+            continue;
+        }
+        if (i->opt->lopt == "repetitions")
+            conf.repetitions = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "threads")
+            conf.num_threads = i->get_arg<int>();
+        else if (i->opt->lopt == "output")
+            conf.output_file = i->arg;
+        else if (i->opt->lopt == "no-sift")
+            conf.run_sift = false;
+        else if (i->opt->lopt == "no-surf")
+            conf.run_surf = false;
+    }
+    if (conf.directories.empty())
+        conf.directories.push_back("examples/data/sequence");
+
+    /* Collect the image files. */
+    std::vector<std::string> filenames;
+    for (std::size_t i = 0; i < conf.directories.size(); ++i)
+    {
+        util::fs::Directory dir;
+        try
+        {
+            dir.scan(conf.directories[i]);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Error scanning " << conf.directories[i]
+                << ": " << e.what() << std::endl;
+            return 1;
+        }
+        std::sort(dir.begin(), dir.end());
+        for (std::size_t j = 0; j < dir.size(); ++j)
+            if (!dir[j].is_dir && is_image_file(dir[j].name))
+                filenames.push_back(dir[j].get_absolute_name());
+    }
+    if (filenames.empty())
+    {
+        std::cerr << "No images found." << std::endl;
+        return 1;
+    }
+
+    std::ofstream csv;
+    if (!conf.output_file.empty())
+    {
+        csv.open(conf.output_file.c_str());
+        if (!csv.good())
+        {
+            std::cerr << "Error opening " << conf.output_file << std::endl;
+            return 1;
+        }
+        csv << "detector,image,width,height,repetition,stage,time_ms,"
+            << "keypoints,descriptors,peak_rss_kb" << std::endl;
+    }
+
+    features::Sift::Options sift_options;
+    sift_options.num_threads = conf.num_threads;
+    features::Surf::Options surf_options;
+    surf_options.num_threads = conf.num_threads;
+
+    std::size_t total_keypoints[2] = { 0, 0 };
+    std::size_t total_time[2] = { 0, 0 };
+    for (std::size_t i = 0; i < filenames.size(); ++i)
+    {
+        core::ByteImage::Ptr image;
+        try
+        {
+            image = core::image::load_file(filenames[i]);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Error loading " << filenames[i]
+                << ": " << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << util::fs::basename(filenames[i]) << " ("
+            << image->width() << "x" << image->height() << ")" << std::endl;
+
+        for (int detector = 0; detector < 2; ++detector)
+        {
+            if ((detector == 0 && !conf.run_sift)
+                || (detector == 1 && !conf.run_surf))
+                continue;
+
+            for (int rep = 0; rep < conf.repetitions; ++rep)
+            {
+                StageTimes stages;
+                std::size_t num_keypoints = 0;
+                std::size_t num_descriptors = 0;
+                if (detector == 0)
+                {
+                    SiftBenchmark sift(sift_options);
+                    sift.set_image(image);
+                    sift.run(&stages);
+                    num_keypoints = sift.get_keypoints().size();
+                    num_descriptors = sift.get_descriptors().size();
+                }
+                else
+                {
+                    SurfBenchmark surf(surf_options);
+                    surf.run(image, &stages);
+                    num_keypoints = surf.get_keypoints().size();
+                    num_descriptors = surf.get_descriptors().size();
+                }
+
+                std::size_t total = 0;
+                for (std::size_t s = 0; s < stages.times.size(); ++s)
+                    total += stages.times[s];
+                total_keypoints[detector] += num_keypoints;
+                total_time[detector] += total;
+                std::size_t const peak_rss = get_peak_rss_kb();
+
+                std::string const name = detector == 0 ? "sift" : "surf";
+                std::cout << "  " << name << " #" << rep << ":";
+                for (std::size_t s = 0; s < stages.times.size(); ++s)
+                    std::cout << " " << stages.names[s] << " "
+                        << stages.times[s] << "ms";
+                std::cout << ", total " << total << "ms, "
+                    << num_keypoints << " keypoints, "
+                    << num_descriptors << " descriptors" << std::endl;
+
+                if (!csv.is_open())
+                    continue;
+                for (std::size_t s = 0; s <= stages.times.size(); ++s)
+                {
+                    bool const is_total = (s == stages.times.size());
+                    csv << name << "," << util::fs::basename(filenames[i])
+                        << "," << image->width() << "," << image->height()
+                        << "," << rep << ","
+                        << (is_total ? std::string("total") : stages.names[s])
+                        << "," << (is_total ? total : stages.times[s])
+                        << "," << num_keypoints << "," << num_descriptors
+                        << "," << peak_rss << std::endl;
+                }
+            }
+        }
+    }
+
+    /* Summary. */
+    for (int detector = 0; detector < 2; ++detector)
+    {
+        if (total_time[detector] == 0)
+            continue;
+        std::cout << (detector == 0 ? "SIFT" : "SURF") << ": "
+            << std::fixed << std::setprecision(1)
+            << (1000.0 * total_keypoints[detector] / total_time[detector])
+            << " keypoints/s" << std::endl;
+    }
+    std::cout << "Peak RSS: " << get_peak_rss_kb() << " KB" << std::endl;
+
+    return 0;
+}
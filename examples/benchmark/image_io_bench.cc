@@ -0,0 +1,453 @@
+/*
+ * Benchmark for the image I/O of the core library. Round-trips byte, raw
+ * and float images of several resolutions through every file format and
+ * reports the throughput of saving, of loading with a cold and a warm page
+ * cache, and the time of reading the headers only, as well as the file
+ * sizes. The results can be written to a CSV file to compare formats,
+ * e.g. to choose an intermediate format for caching.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#include "util/arguments.h"
+#include "util/exception.h"
+#include "util/file_system.h"
+#include "core/image.h"
+#include "core/image_io.h"
+
+/* Returns the time since the epoch of the steady clock in seconds. */
+double
+now_sec (void)
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Drops the cached pages of the file, which makes the next read a cold
+ * read from the disk. Returns false where this is not supported.
+ */
+bool
+evict_from_page_cache (std::string const& filename)
+{
+#if defined(__linux__)
+    int const fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    ::fdatasync(fd);
+    bool const success = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return success;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+/* Returns the size of the file in bytes. */
+std::size_t
+get_file_size (std::string const& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+    return in.good() ? static_cast<std::size_t>(in.tellg()) : 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* A file format with its image type and the I/O functions. */
+struct Format
+{
+    std::string name;
+    std::string extension;
+    core::ImageType type;
+    std::function<void (core::ImageBase::ConstPtr, std::string const&)> save;
+    std::function<core::ImageBase::Ptr (std::string const&)> load;
+    std::function<core::image::ImageHeaders (std::string const&)> headers;
+};
+
+template <typename T>
+std::shared_ptr<core::Image<T> const>
+cast_image (core::ImageBase::ConstPtr image)
+{
+    std::shared_ptr<core::Image<T> const> result
+        = std::dynamic_pointer_cast<core::Image<T> const>(image);
+    if (result == nullptr)
+        throw std::invalid_argument("Unexpected image type");
+    return result;
+}
+
+void
+add_format (std::string const& name, std::string const& extension,
+    core::ImageType type, Format const& functions,
+    std::vector<Format>* formats)
+{
+    Format format = functions;
+    format.name = name;
+    format.extension = extension;
+    format.type = type;
+    formats->push_back(format);
+}
+
+/* Returns all formats of the image I/O that are compiled in. */
+std::vector<Format>
+get_formats (void)
+{
+    namespace img = core::image;
+    std::vector<Format> formats;
+    Format f;
+
+#ifndef MVE_NO_PNG_SUPPORT
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_png_file(cast_image<uint8_t>(image), fn); };
+    f.load = [] (std::string const& fn) { return img::load_png_file(fn); };
+    f.headers = img::load_png_file_headers;
+    add_format("png", ".png", core::IMAGE_TYPE_UINT8, f, &formats);
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+    {
+        img::PngSaveOptions options;
+        options.num_threads = 0;
+        img::save_png_file(cast_image<uint8_t>(image), fn, options);
+    };
+    add_format("png-parallel", ".png", core::IMAGE_TYPE_UINT8, f, &formats);
+#endif
+
+#ifndef MVE_NO_JPEG_SUPPORT
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_jpg_file(cast_image<uint8_t>(image), fn, 90); };
+    f.load = [] (std::string const& fn) { return img::load_jpg_file(fn); };
+    f.headers = [] (std::string const& fn)
+        { return img::load_jpg_file_headers(fn); };
+    add_format("jpg", ".jpg", core::IMAGE_TYPE_UINT8, f, &formats);
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_jpg_file(cast_image<uint8_t>(image), fn, 90, true); };
+    add_format("jpg-fast", ".jpg", core::IMAGE_TYPE_UINT8, f, &formats);
+#endif
+
+#ifndef MVE_NO_TIFF_SUPPORT
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_tiff_file(cast_image<uint8_t>(image), fn); };
+    f.load = [] (std::string const& fn) { return img::load_tiff_file(fn); };
+    f.headers = img::load_tiff_file_headers;
+    add_format("tiff", ".tif", core::IMAGE_TYPE_UINT8, f, &formats);
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_tiff_16_file(cast_image<uint16_t>(image), fn); };
+    f.load = [] (std::string const& fn)
+        { return img::load_tiff_16_file(fn); };
+    add_format("tiff-16", ".tif", core::IMAGE_TYPE_UINT16, f, &formats);
+#endif
+
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_ppm_file(cast_image<uint8_t>(image), fn); };
+    f.load = [] (std::string const& fn) { return img::load_ppm_file(fn); };
+    f.headers = img::load_ppm_file_headers;
+    add_format("ppm", ".ppm", core::IMAGE_TYPE_UINT8, f, &formats);
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_ppm_16_file(cast_image<uint16_t>(image), fn); };
+    f.load = [] (std::string const& fn)
+        { return img::load_ppm_16_file(fn); };
+    add_format("ppm-16", ".ppm", core::IMAGE_TYPE_UINT16, f, &formats);
+
+    f.save = [] (core::ImageBase::ConstPtr image, std::string const& fn)
+        { img::save_pfm_file(cast_image<float>(image), fn); };
+    f.load = [] (std::string const& fn) { return img::load_pfm_file(fn); };
+    f.headers = img::load_pfm_file_headers;
+    add_format("pfm", ".pfm", core::IMAGE_TYPE_FLOAT, f, &formats);
+
+    f.save = img::save_mvei_file;
+    f.load = img::load_mvei_file;
+    f.headers = img::load_mvei_file_headers;
+    add_format("mvei-8", ".mvei", core::IMAGE_TYPE_UINT8, f, &formats);
+    add_format("mvei-16", ".mvei", core::IMAGE_TYPE_UINT16, f, &formats);
+    add_format("mvei-float", ".mvei", core::IMAGE_TYPE_FLOAT, f, &formats);
+    /* Mapped loads do not touch the pages, which is the point of them. */
+    f.load = [] (std::string const& fn)
+        { return img::load_mvei_file_mapped(fn); };
+    add_format("mvei-mapped", ".mvei", core::IMAGE_TYPE_FLOAT, f, &formats);
+
+    return formats;
+}
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Creates an image with smooth gradients and some noise, which compresses
+ * roughly like a photograph. Values are in the range of the type.
+ */
+core::ImageBase::Ptr
+create_test_image (core::ImageType type, int width, int height,
+    int channels)
+{
+    std::mt19937 prng(1);
+    std::normal_distribution<float> noise(0.0f, 0.02f);
+    core::ImageBase::Ptr image = core::image::create_for_type(type,
+        width, height, channels);
+    std::vector<float> values(static_cast<std::size_t>(width) * height
+        * channels);
+    for (int y = 0, i = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            for (int c = 0; c < channels; ++c, ++i)
+            {
+                float const v = 0.5f + 0.25f * std::sin(0.01f * x + c)
+                    + 0.2f * std::cos(0.013f * y - c) + noise(prng);
+                values[i] = std::min(1.0f, std::max(0.0f, v));
+            }
+
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        if (type == core::IMAGE_TYPE_UINT8)
+            std::static_pointer_cast<core::ByteImage>(image)->at(i)
+                = static_cast<uint8_t>(values[i] * 255.0f + 0.5f);
+        else if (type == core::IMAGE_TYPE_UINT16)
+            std::static_pointer_cast<core::RawImage>(image)->at(i)
+                = static_cast<uint16_t>(values[i] * 65535.0f + 0.5f);
+        else
+            std::static_pointer_cast<core::FloatImage>(image)->at(i)
+                = values[i];
+    }
+    return image;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* The measured throughputs in MB/s and the header time in microseconds. */
+struct Result
+{
+    double save_mbs;
+    double cold_load_mbs;
+    double warm_load_mbs;
+    double headers_us;
+    std::size_t file_size;
+    bool cold;
+};
+
+Result
+run_format (Format const& format, core::ImageBase::ConstPtr image,
+    std::string const& filename, int repetitions)
+{
+    double const megabytes = image->get_byte_size() / (1024.0 * 1024.0);
+    Result result;
+
+    double start = now_sec();
+    for (int i = 0; i < repetitions; ++i)
+        format.save(image, filename);
+    result.save_mbs = megabytes * repetitions / (now_sec() - start);
+    result.file_size = get_file_size(filename);
+
+    /* Cold reads evict the file before every load. */
+    double cold_time = 0.0;
+    result.cold = true;
+    for (int i = 0; i < repetitions && result.cold; ++i)
+    {
+        result.cold = evict_from_page_cache(filename);
+        start = now_sec();
+        core::ImageBase::Ptr loaded = format.load(filename);
+        cold_time += now_sec() - start;
+        if (loaded->width() != image->width()
+            || loaded->height() != image->height()
+            || loaded->channels() != image->channels())
+            throw util::Exception("Loaded image has wrong dimensions");
+    }
+    result.cold_load_mbs = result.cold
+        ? megabytes * repetitions / cold_time : 0.0;
+
+    /* Warm reads load the file once before the measurement. */
+    format.load(filename);
+    start = now_sec();
+    for (int i = 0; i < repetitions; ++i)
+        format.load(filename);
+    result.warm_load_mbs = megabytes * repetitions / (now_sec() - start);
+
+    start = now_sec();
+    for (int i = 0; i < repetitions; ++i)
+        format.headers(filename);
+    result.headers_us = 1e6 * (now_sec() - start) / repetitions;
+
+    return result;
+}
+
+/* ---------------------------------------------------------------- */
+
+struct AppSettings
+{
+    std::vector<std::pair<int, int> > sizes;
+    int channels;
+    int repetitions;
+    std::string directory;
+    std::string format_filter;
+    std::string output_file;
+};
+
+/* Parses a comma-separated list of sizes like 640x480,1920x1080. */
+std::vector<std::pair<int, int> >
+parse_sizes (std::string const& str)
+{
+    std::vector<std::pair<int, int> > sizes;
+    std::stringstream ss(str);
+    std::string token;
+    while (std::getline(ss, token, ','))
+    {
+        int width = 0, height = 0;
+        char separator = 0;
+        std::stringstream ts(token);
+        ts >> width >> separator >> height;
+        if (ts.fail() || separator != 'x' || width <= 0 || height <= 0)
+            throw std::invalid_argument("Invalid size: " + token);
+        sizes.push_back(std::make_pair(width, height));
+    }
+    return sizes;
+}
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ]");
+    args.set_description("Saves and loads synthetic images of several "
+        "resolutions with every image format and reports the throughput "
+        "in MB/s of the image data for saving and for loading with a cold "
+        "and a warm page cache, the time of reading the headers only, and "
+        "the file sizes. Cold reads drop the file from the page cache and "
+        "are only supported on Linux. JPEG is lossy and not comparable.");
+    args.add_option('s', "sizes", true,
+        "Comma-separated image sizes [640x480,1920x1080,4000x3000]");
+    args.add_option('c', "channels", true, "Image channels [3]");
+    args.add_option('r', "repetitions", true, "Repetitions per test [3]");
+    args.add_option('d', "directory", true,
+        "Directory for the temporary files [.]");
+    args.add_option('f', "format", true,
+        "Runs only formats whose name contains the string");
+    args.add_option('o', "output", true, "Writes results as CSV file");
+    args.parse(argc, argv);
+
+    AppSettings conf;
+    conf.channels = 3;
+    conf.repetitions = 3;
+    conf.directory = ".";
+    std::string sizes = "640x480,1920x1080,4000x3000";
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+            continue;
+        if (i->opt->lopt == "sizes")
+            sizes = i->arg;
+        else if (i->opt->lopt == "channels")
+            conf.channels = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "repetitions")
+            conf.repetitions = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "directory")
+            conf.directory = i->arg;
+        else if (i->opt->lopt == "format")
+            conf.format_filter = i->arg;
+        else if (i->opt->lopt == "output")
+            conf.output_file = i->arg;
+    }
+
+    try
+    {
+        conf.sizes = parse_sizes(sizes);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream csv;
+    if (!conf.output_file.empty())
+    {
+        csv.open(conf.output_file.c_str());
+        if (!csv.good())
+        {
+            std::cerr << "Error opening " << conf.output_file << std::endl;
+            return 1;
+        }
+        csv << "format,width,height,channels,image_bytes,file_bytes,"
+            << "save_mbs,cold_load_mbs,warm_load_mbs,headers_us"
+            << std::endl;
+    }
+
+    std::vector<Format> const formats = get_formats();
+    std::cout << "Throughputs are in MB/s of image data, cold loads "
+        << "are 0 where unsupported." << std::endl;
+    std::cout << std::left << std::setw(13) << "Format"
+        << std::right << std::setw(11) << "Size"
+        << std::setw(11) << "File KB" << std::setw(9) << "Save"
+        << std::setw(11) << "Cold load" << std::setw(11) << "Warm load"
+        << std::setw(12) << "Headers us" << std::endl;
+    for (std::size_t s = 0; s < conf.sizes.size(); ++s)
+    {
+        int const width = conf.sizes[s].first;
+        int const height = conf.sizes[s].second;
+        core::ImageBase::Ptr images[3];
+        core::ImageType const types[3] = { core::IMAGE_TYPE_UINT8,
+            core::IMAGE_TYPE_UINT16, core::IMAGE_TYPE_FLOAT };
+
+        for (std::size_t f = 0; f < formats.size(); ++f)
+        {
+            Format const& format = formats[f];
+            if (format.name.find(conf.format_filter) == std::string::npos)
+                continue;
+
+            int const t = std::find(types, types + 3, format.type) - types;
+            if (images[t] == nullptr)
+                images[t] = create_test_image(types[t], width, height,
+                    conf.channels);
+
+            std::string const filename = util::fs::join_path(conf.directory,
+                "image_io_bench" + format.extension);
+            Result result;
+            try
+            {
+                result = run_format(format, images[t], filename,
+                    conf.repetitions);
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << format.name << ": " << e.what() << std::endl;
+                util::fs::unlink(filename.c_str());
+                continue;
+            }
+            util::fs::unlink(filename.c_str());
+
+            std::stringstream size;
+            size << width << "x" << height;
+            std::cout << std::left << std::setw(13) << format.name
+                << std::right << std::setw(11) << size.str()
+                << std::setw(11) << result.file_size / 1024
+                << std::fixed << std::setprecision(1)
+                << std::setw(9) << result.save_mbs
+                << std::setw(11) << result.cold_load_mbs
+                << std::setw(11) << result.warm_load_mbs
+                << std::setw(12) << result.headers_us << std::endl;
+
+            if (!csv.is_open())
+                continue;
+            csv << format.name << "," << width << "," << height << ","
+                << conf.channels << "," << images[t]->get_byte_size() << ","
+                << result.file_size << "," << result.save_mbs << ","
+                << result.cold_load_mbs << "," << result.warm_load_mbs << ","
+                << result.headers_us << std::endl;
+        }
+    }
+
+    return 0;
+}
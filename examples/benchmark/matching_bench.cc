@@ -0,0 +1,527 @@
+/*
+ * Benchmark for the feature matchers. Matches the SIFT descriptors of all
+ * image pairs with the available matcher variants and reports the time,
+ * the throughput, the recall with respect to exhaustive float matching and
+ * the descriptor memory of every variant. The descriptors are computed
+ * from the images of the given directories or loaded from a dump file.
+ * The results can be written to a CSV file to track regressions.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
+
+#include "util/arguments.h"
+#include "util/exception.h"
+#include "util/file_system.h"
+#include "util/strings.h"
+#include "util/timer.h"
+#include "features/binary_descriptor.h"
+#include "features/matching.h"
+#include "features/matching_base.h"
+#include "sfm/bundler_common.h"
+#include "sfm/feature_set.h"
+
+#define DESCRIPTOR_DUMP_SIGNATURE "MVE_SIFTDUMP\n"
+#define DESCRIPTOR_DUMP_SIGNATURE_LEN 13
+
+/* Returns the peak resident set size of the process in kilobytes. */
+std::size_t
+get_peak_rss_kb (void)
+{
+#if defined(__linux__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#elif defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+#else
+    return 0;
+#endif
+}
+
+bool
+is_image_file (std::string const& filename)
+{
+    std::string const ext = util::string::lowercase
+        (util::string::right(filename, 4));
+    return ext == ".jpg" || ext == "jpeg" || ext == ".png" || ext == ".tif";
+}
+
+/* Reports the SIMD kernels the nearest neighbor search can select. */
+std::string
+get_simd_kernels (void)
+{
+    std::string kernels;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vnni"))
+        kernels += "avx512-vnni ";
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kernels += "avx2 ";
+    if (__builtin_cpu_supports("popcnt"))
+        kernels += "popcnt ";
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    kernels += "neon ";
+#elif defined(__SSE2__)
+    kernels += "sse2 ";
+#endif
+    return kernels + "scalar";
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+save_descriptors (std::string const& filename,
+    std::vector<std::string> const& names,
+    sfm::bundler::ViewportList const& viewports)
+{
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    out.write(DESCRIPTOR_DUMP_SIGNATURE, DESCRIPTOR_DUMP_SIGNATURE_LEN);
+    std::uint32_t const num_views = static_cast<std::uint32_t>(names.size());
+    out.write(reinterpret_cast<char const*>(&num_views), sizeof(num_views));
+    for (std::size_t i = 0; i < viewports.size(); ++i)
+    {
+        features::Sift::Descriptors const& descr
+            = viewports[i].features.sift_descriptors;
+        std::uint32_t const name_len = static_cast<std::uint32_t>
+            (names[i].size());
+        std::uint32_t const num_descr = static_cast<std::uint32_t>
+            (descr.size());
+        out.write(reinterpret_cast<char const*>(&name_len), sizeof(name_len));
+        out.write(names[i].c_str(), name_len);
+        out.write(reinterpret_cast<char const*>(&num_descr), sizeof(num_descr));
+        for (std::size_t j = 0; j < descr.size(); ++j)
+        {
+            float const keypoint[4] = { descr[j].x, descr[j].y,
+                descr[j].scale, descr[j].orientation };
+            out.write(reinterpret_cast<char const*>(keypoint),
+                sizeof(keypoint));
+            out.write(reinterpret_cast<char const*>(descr[j].data.begin()),
+                128 * sizeof(float));
+        }
+    }
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+}
+
+void
+load_descriptors (std::string const& filename,
+    std::vector<std::string>* names, sfm::bundler::ViewportList* viewports)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    char signature[DESCRIPTOR_DUMP_SIGNATURE_LEN + 1];
+    in.read(signature, DESCRIPTOR_DUMP_SIGNATURE_LEN);
+    signature[DESCRIPTOR_DUMP_SIGNATURE_LEN] = '\0';
+    if (std::string(DESCRIPTOR_DUMP_SIGNATURE) != signature)
+        throw util::Exception("Invalid descriptor dump signature");
+
+    std::uint32_t num_views = 0;
+    in.read(reinterpret_cast<char*>(&num_views), sizeof(num_views));
+    names->clear();
+    viewports->clear();
+    for (std::uint32_t i = 0; i < num_views && in.good(); ++i)
+    {
+        std::uint32_t name_len = 0;
+        in.read(reinterpret_cast<char*>(&name_len), sizeof(name_len));
+        std::string name(name_len, '\0');
+        in.read(&name[0], name_len);
+        names->push_back(name);
+
+        std::uint32_t num_descr = 0;
+        in.read(reinterpret_cast<char*>(&num_descr), sizeof(num_descr));
+        viewports->push_back(sfm::bundler::Viewport());
+        features::Sift::Descriptors& descr
+            = viewports->back().features.sift_descriptors;
+        descr.resize(num_descr);
+        for (std::uint32_t j = 0; j < num_descr && in.good(); ++j)
+        {
+            float keypoint[4];
+            in.read(reinterpret_cast<char*>(keypoint), sizeof(keypoint));
+            descr[j].x = keypoint[0];
+            descr[j].y = keypoint[1];
+            descr[j].scale = keypoint[2];
+            descr[j].orientation = keypoint[3];
+            in.read(reinterpret_cast<char*>(descr[j].data.begin()),
+                128 * sizeof(float));
+        }
+    }
+    if (!in.good())
+        throw util::Exception("Premature EOF");
+}
+
+/* ---------------------------------------------------------------- */
+
+/* Descriptors of a view in the representations of the variants. */
+struct ViewDescriptors
+{
+    std::vector<float> floats;
+    std::vector<unsigned short> shorts;
+    std::vector<unsigned char> bytes;
+    features::BinaryDescriptors binary;
+    int size;
+};
+
+void
+convert_descriptors (features::Sift::Descriptors const& descr,
+    features::BinaryProjection const& projection, ViewDescriptors* result)
+{
+    result->size = static_cast<int>(descr.size());
+    result->floats.resize(descr.size() * 128);
+    result->shorts.resize(descr.size() * 128);
+    result->bytes.resize(descr.size() * 128);
+    for (std::size_t i = 0; i < descr.size(); ++i)
+        for (int j = 0; j < 128; ++j)
+        {
+            float const value = descr[i].data[j];
+            float const discrete = std::floor(std::min(1.0f,
+                std::max(0.0f, value)) * 255.0f + 0.5f);
+            result->floats[i * 128 + j] = value;
+            result->shorts[i * 128 + j]
+                = static_cast<unsigned short>(discrete);
+            result->bytes[i * 128 + j] = static_cast<unsigned char>(discrete);
+        }
+    projection.compute(descr, &result->binary);
+}
+
+/* A matcher variant matching a pair of views. */
+struct Variant
+{
+    std::string name;
+    std::size_t bytes_per_descriptor;
+    std::function<void (int, int, features::Matching::Result*)> match;
+};
+
+/* Returns the number of baseline matches that are also found. */
+int
+count_recalled_matches (features::Matching::Result const& baseline,
+    features::Matching::Result const& result)
+{
+    int num_recalled = 0;
+    for (std::size_t i = 0; i < baseline.matches_1_2.size(); ++i)
+        if (baseline.matches_1_2[i] >= 0
+            && baseline.matches_1_2[i] == result.matches_1_2[i])
+            num_recalled += 1;
+    return num_recalled;
+}
+
+struct AppSettings
+{
+    std::vector<std::string> directories;
+    std::string dump_file;
+    std::string output_file;
+    int repetitions;
+    int kd_forest_checks;
+    int max_descriptors;
+};
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ] [ DIRECTORY ... ]");
+    args.set_description("Matches the SIFT descriptors of all image pairs "
+        "in the given directories (defaults to examples/data/sequence) with "
+        "the matcher variants and reports time, throughput, recall against "
+        "exhaustive float matching and descriptor memory.");
+    args.add_option('r', "repetitions", true, "Repetitions per pair [1]");
+    args.add_option('k', "kd-checks", true, "KD-forest checks [256]");
+    args.add_option('n', "max-descriptors", true,
+        "Uses the N largest scale descriptors per view, 0 = all [0]");
+    args.add_option('d', "dump", true, "Loads descriptors from file if it "
+        "exists, otherwise saves the computed descriptors to it");
+    args.add_option('o', "output", true, "Writes results as CSV file");
+    args.parse(argc, argv);
+
+    AppSettings conf;
+    conf.repetitions = 1;
+    conf.kd_forest_checks = 256;
+    conf.max_descriptors = 0;
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+        {
+            conf.directories.push_back(i->arg);
+            continue;
+        }
+        if (i->opt->lopt == "repetitions")
+            conf.repetitions = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "kd-checks")
+            conf.kd_forest_checks = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "max-descriptors")
+            conf.max_descriptors = std::max(0, i->get_arg<int>());
+        else if (i->opt->lopt == "dump")
+            conf.dump_file = i->arg;
+        else if (i->opt->lopt == "output")
+            conf.output_file = i->arg;
+    }
+    if (conf.directories.empty())
+        conf.directories.push_back("examples/data/sequence");
+
+    /* Load the descriptor dump or compute the descriptors. */
+    std::vector<std::string> names;
+    sfm::bundler::ViewportList viewports;
+    if (!conf.dump_file.empty()
+        && util::fs::file_exists(conf.dump_file.c_str()))
+    {
+        try
+        {
+            load_descriptors(conf.dump_file, &names, &viewports);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Error loading " << conf.dump_file
+                << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::vector<std::string> filenames;
+        for (std::size_t i = 0; i < conf.directories.size(); ++i)
+        {
+            util::fs::Directory dir;
+            try
+            {
+                dir.scan(conf.directories[i]);
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << "Error scanning " << conf.directories[i]
+                    << ": " << e.what() << std::endl;
+                return 1;
+            }
+            std::sort(dir.begin(), dir.end());
+            for (std::size_t j = 0; j < dir.size(); ++j)
+                if (!dir[j].is_dir && is_image_file(dir[j].name))
+                {
+                    filenames.push_back(dir[j].get_absolute_name());
+                    names.push_back(dir[j].name);
+                }
+        }
+
+        sfm::FeatureSet::Options feature_opts;
+        feature_opts.feature_types = sfm::FeatureSet::FEATURE_SIFT;
+        std::vector<sfm::FeatureSet> feature_sets;
+        if (sfm::FeatureSet::compute_features(filenames, feature_opts, 0,
+            &feature_sets) > 0)
+            return 1;
+        viewports.resize(feature_sets.size());
+        for (std::size_t i = 0; i < feature_sets.size(); ++i)
+            viewports[i].features = feature_sets[i];
+
+        if (!conf.dump_file.empty())
+        {
+            try
+            {
+                save_descriptors(conf.dump_file, names, viewports);
+            }
+            catch (std::exception& e)
+            {
+                std::cerr << "Error saving " << conf.dump_file
+                    << ": " << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (viewports.size() < 2)
+    {
+        std::cerr << "At least two views are required." << std::endl;
+        return 1;
+    }
+
+    /* Convert the descriptors for the different variants. */
+    int const num_views = static_cast<int>(viewports.size());
+    for (int i = 0; i < num_views && conf.max_descriptors > 0; ++i)
+    {
+        features::Sift::Descriptors& descr
+            = viewports[i].features.sift_descriptors;
+        if (descr.size() <= static_cast<std::size_t>(conf.max_descriptors))
+            continue;
+        std::stable_sort(descr.begin(), descr.end(),
+            [] (features::Sift::Descriptor const& a,
+            features::Sift::Descriptor const& b)
+            { return a.scale > b.scale; });
+        descr.resize(conf.max_descriptors);
+    }
+    features::Sift::Descriptors all_descriptors;
+    for (int i = 0; i < num_views; ++i)
+        all_descriptors.insert(all_descriptors.end(),
+            viewports[i].features.sift_descriptors.begin(),
+            viewports[i].features.sift_descriptors.end());
+    if (all_descriptors.empty())
+    {
+        std::cerr << "No descriptors found." << std::endl;
+        return 1;
+    }
+    features::BinaryProjection projection;
+    projection.train(all_descriptors);
+    std::vector<ViewDescriptors> views(num_views);
+    for (int i = 0; i < num_views; ++i)
+    {
+        convert_descriptors(viewports[i].features.sift_descriptors,
+            projection, &views[i]);
+        std::cout << names[i] << ": " << views[i].size
+            << " descriptors" << std::endl;
+    }
+    std::cout << "SIMD kernels: " << get_simd_kernels() << std::endl;
+
+    std::unique_ptr<features::MatchingBase> exhaustive
+        = features::MatchingBase::create
+        (features::MatchingBase::MATCHER_EXHAUSTIVE);
+    exhaustive->init(&viewports);
+    std::unique_ptr<features::MatchingBase> cascade_hashing
+        = features::MatchingBase::create
+        (features::MatchingBase::MATCHER_CASCADE_HASHING);
+    cascade_hashing->init(&viewports);
+
+    /* Distance thresholds are disabled, only the Lowe ratio is used. */
+    features::Matching::Options matching_opts
+        = exhaustive->opts.sift_matching_opts;
+    features::Matching::Options kd_forest_opts = matching_opts;
+    kd_forest_opts.kd_forest_checks = conf.kd_forest_checks;
+    features::Matching::Options binary_opts = matching_opts;
+    binary_opts.descriptor_length = 1;
+
+    std::vector<Variant> variants;
+    variants.push_back(Variant{ "float", 128 * sizeof(float),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        features::Matching::twoway_match(matching_opts,
+            views[v1].floats.data(), views[v1].size,
+            views[v2].floats.data(), views[v2].size, result); } });
+    variants.push_back(Variant{ "float-kdforest", 128 * sizeof(float),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        features::Matching::twoway_match(kd_forest_opts,
+            views[v1].floats.data(), views[v1].size,
+            views[v2].floats.data(), views[v2].size, result); } });
+    variants.push_back(Variant{ "ushort", 128 * sizeof(unsigned short),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        features::Matching::twoway_match(matching_opts,
+            views[v1].shorts.data(), views[v1].size,
+            views[v2].shorts.data(), views[v2].size, result); } });
+    variants.push_back(Variant{ "uchar", 128 * sizeof(unsigned char),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        features::Matching::twoway_match(matching_opts,
+            views[v1].bytes.data(), views[v1].size,
+            views[v2].bytes.data(), views[v2].size, result); } });
+    variants.push_back(Variant{ "binary", sizeof(features::BinaryDescriptor),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        features::Matching::twoway_match(binary_opts,
+            views[v1].binary.data(), views[v1].size,
+            views[v2].binary.data(), views[v2].size, result); } });
+    variants.push_back(Variant{ "exhaustive", 128 * sizeof(unsigned short),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        exhaustive->pairwise_match(v1, v2, result); } });
+    variants.push_back(Variant{ "cascade-hashing",
+        128 * sizeof(unsigned short),
+        [&] (int v1, int v2, features::Matching::Result* result) {
+        cascade_hashing->pairwise_match(v1, v2, result); } });
+
+    std::ofstream csv;
+    if (!conf.output_file.empty())
+    {
+        csv.open(conf.output_file.c_str());
+        if (!csv.good())
+        {
+            std::cerr << "Error opening " << conf.output_file << std::endl;
+            return 1;
+        }
+        csv << "variant,view_1,view_2,repetition,time_ms,descriptors_1,"
+            << "descriptors_2,matches,baseline_matches,recalled_matches,"
+            << "peak_rss_kb" << std::endl;
+    }
+
+    /* The first variant is the baseline for the recall. */
+    int const num_pairs = num_views * (num_views - 1) / 2;
+    std::vector<features::Matching::Result> baseline(num_pairs);
+    std::cout << std::left << std::setw(16) << "Variant"
+        << std::right << std::setw(10) << "Time ms"
+        << std::setw(10) << "Pairs/s" << std::setw(12) << "Mcmp/s"
+        << std::setw(10) << "Matches" << std::setw(9) << "Recall"
+        << std::setw(11) << "Descr KB" << std::setw(11) << "Peak KB"
+        << std::endl;
+    for (std::size_t v = 0; v < variants.size(); ++v)
+    {
+        Variant const& variant = variants[v];
+        std::size_t total_time = 0;
+        double num_comparisons = 0.0;
+        std::size_t num_matches = 0;
+        std::size_t num_baseline = 0;
+        std::size_t num_recalled = 0;
+        for (int i = 0, pair = 0; i < num_views; ++i)
+            for (int j = i + 1; j < num_views; ++j, ++pair)
+                for (int rep = 0; rep < conf.repetitions; ++rep)
+                {
+                    features::Matching::Result result;
+                    util::WallTimer timer;
+                    variant.match(i, j, &result);
+                    features::Matching::remove_inconsistent_matches(&result);
+                    std::size_t const time = timer.get_elapsed();
+                    if (v == 0)
+                        baseline[pair] = result;
+
+                    int const matches = features::Matching
+                        ::count_consistent_matches(result);
+                    int const baseline_matches = features::Matching
+                        ::count_consistent_matches(baseline[pair]);
+                    int const recalled = result.matches_1_2.empty() ? 0
+                        : count_recalled_matches(baseline[pair], result);
+                    total_time += time;
+                    num_comparisons += 2.0 * views[i].size * views[j].size;
+                    num_matches += matches;
+                    num_baseline += baseline_matches;
+                    num_recalled += recalled;
+
+                    if (!csv.is_open())
+                        continue;
+                    csv << variant.name << "," << names[i] << "," << names[j]
+                        << "," << rep << "," << time << "," << views[i].size
+                        << "," << views[j].size << "," << matches << ","
+                        << baseline_matches << "," << recalled << ","
+                        << get_peak_rss_kb() << std::endl;
+                }
+
+        std::size_t num_descriptors = 0;
+        for (int i = 0; i < num_views; ++i)
+            num_descriptors += views[i].size;
+        double const seconds = std::max(std::size_t(1), total_time) / 1000.0;
+        std::cout << std::left << std::setw(16) << variant.name
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << (total_time / double(conf.repetitions))
+            << std::setw(10) << (num_pairs * conf.repetitions / seconds)
+            << std::setw(12) << (num_comparisons / seconds / 1e6)
+            << std::setw(10) << (num_matches / conf.repetitions)
+            << std::setprecision(3) << std::setw(9)
+            << (num_baseline > 0 ? double(num_recalled) / num_baseline : 1.0)
+            << std::setw(11)
+            << (num_descriptors * variant.bytes_per_descriptor / 1024)
+            << std::setw(11) << get_peak_rss_kb() << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,324 @@
+/*
+ * Benchmark for the math kernels at the fixed sizes the pipeline uses:
+ * the SVD, QR and Cholesky decompositions of 3x3, 4x4, 8x9 and 9x9
+ * matrices (e.g. the 8-point and DLT systems), the 3x3 and 4x4 inverses
+ * and determinants, the quaternion rotations and the vector operations.
+ * Reports the time per operation, which is the baseline to compare
+ * optimizations of the generic templates against.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "util/arguments.h"
+#include "math/matrix.h"
+#include "math/matrix_qr.h"
+#include "math/matrix_svd.h"
+#include "math/matrix_tools.h"
+#include "math/quaternion.h"
+#include "math/vector.h"
+#include "sfm/ba_cholesky.h"
+
+/* Random matrices, vectors and unit quaternions. */
+template <typename T, int M, int N>
+struct Data
+{
+    std::vector<math::Matrix<T,M,N> > matrices;
+    /* Symmetric, positive definite matrices for square sizes. */
+    std::vector<math::Matrix<T,N,N> > spd_matrices;
+    std::vector<math::Vector<T,N> > vectors;
+    std::vector<math::Quaternion<T> > quaternions;
+
+    Data (std::size_t size, unsigned int seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<T> dist(T(-1), T(1));
+        this->matrices.resize(size);
+        this->spd_matrices.resize(size);
+        this->vectors.resize(size);
+        this->quaternions.resize(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            /* Diagonally dominant to be well-conditioned. */
+            math::Matrix<T,M,N>& mat = this->matrices[i];
+            for (int j = 0; j < M * N; ++j)
+                mat[j] = dist(generator);
+            for (int j = 0; j < std::min(M, N); ++j)
+                mat(j, j) += T(N);
+
+            math::Matrix<T,N,N>& spd = this->spd_matrices[i];
+            spd = mat.transposed() * mat;
+            for (int j = 0; j < N; ++j)
+                spd(j, j) += T(1);
+
+            for (int j = 0; j < N; ++j)
+                this->vectors[i][j] = dist(generator);
+
+            math::Vector<T,3> axis(dist(generator), dist(generator),
+                dist(generator));
+            this->quaternions[i].set(axis.normalized(),
+                dist(generator) * T(MATH_PI));
+        }
+    }
+
+    /* The index of the second operand of binary operations. */
+    std::size_t next (std::size_t i) const
+    {
+        return (i + 1) % this->vectors.size();
+    }
+};
+
+/* Sums the values of the results so the work is not optimized away. */
+template <typename T, int M, int N>
+double
+checksum (math::Matrix<T,M,N> const& value)
+{
+    return std::accumulate(*value, *value + M * N, 0.0);
+}
+
+template <typename T, int N>
+double
+checksum (math::Vector<T,N> const& value)
+{
+    return std::accumulate(*value, *value + N, 0.0);
+}
+
+double
+checksum (double value)
+{
+    return value;
+}
+
+/* Returns the time since the epoch of the steady clock in seconds. */
+double
+now_sec (void)
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Runs the operation on all data until the minimum time has passed, and
+ * prints the time per operation.
+ */
+template <typename D, typename OP>
+void
+run (std::string const& name, std::vector<std::string> const& filters,
+    D const& data, double min_time, OP op)
+{
+    if (!filters.empty() && std::none_of(filters.begin(), filters.end(),
+        [&name] (std::string const& f)
+        { return name.find(f) != std::string::npos; }))
+        return;
+
+    std::size_t const size = data.matrices.size();
+    double sum = 0.0;
+    std::size_t num_ops = 0;
+    double const start = now_sec();
+    double elapsed = 0.0;
+    do
+    {
+        for (std::size_t i = 0; i < size; ++i)
+            sum += checksum(op(data, i));
+        num_ops += size;
+        elapsed = now_sec() - start;
+    }
+    while (elapsed < min_time);
+    double const ns = elapsed * 1e9 / static_cast<double>(num_ops);
+
+    std::cout << std::left << std::setw(32) << name << std::right
+        << std::fixed << std::setprecision(2) << std::setw(10) << ns
+        << " ns/op  (checksum " << std::setprecision(3) << sum << ")"
+        << std::endl;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* The decompositions of all benchmarked sizes. */
+template <int M, int N>
+void
+run_decompositions (std::vector<std::string> const& filters,
+    std::size_t size, double min_time)
+{
+    typedef math::Matrix<double,M,N> Mat;
+    typedef math::Matrix<double,N,N> SquareMat;
+    typedef Data<double,M,N> D;
+    D const data(size, 1);
+    std::string const prefix = "double " + std::to_string(M) + "x"
+        + std::to_string(N) + " ";
+
+    run(prefix + "svd", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> SquareMat
+        {
+            Mat u;
+            SquareMat s, v;
+            math::matrix_svd(d.matrices[i], &u, &s, &v);
+            return v + s;
+        });
+    run(prefix + "svd jacobi", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> SquareMat
+        {
+            SquareMat v;
+            math::matrix_svd_jacobi(d.matrices[i], &v);
+            return v;
+        });
+    run(prefix + "qr", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Mat
+        {
+            math::Matrix<double,M,M> q;
+            Mat r;
+            math::matrix_qr(d.matrices[i], &q, &r);
+            return r;
+        });
+    if (M != N)
+        return;
+
+    run(prefix + "cholesky", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> SquareMat
+        {
+            SquareMat l;
+            sfm::ba::cholesky_decomposition(*d.spd_matrices[i], N, *l);
+            return l;
+        });
+    run(prefix + "cholesky solve", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> math::Vector<double,N>
+        {
+            SquareMat l;
+            math::Vector<double,N> x;
+            sfm::ba::cholesky_decomposition(*d.spd_matrices[i], N, *l);
+            sfm::ba::cholesky_solve(*l, N, *d.vectors[i], *x);
+            return x;
+        });
+}
+
+/* The inverse and determinant, specialized for 3x3 and 4x4 only. */
+template <typename T, int N>
+void
+run_inverses (std::string const& type, std::vector<std::string> const& filters,
+    std::size_t size, double min_time)
+{
+    typedef math::Matrix<T,N,N> Mat;
+    typedef Data<T,N,N> D;
+    D const data(size, 2);
+    std::string const prefix = type + std::to_string(N) + "x"
+        + std::to_string(N) + " ";
+
+    run(prefix + "inverse", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Mat
+        { return math::matrix_inverse(d.matrices[i]); });
+    run(prefix + "determinant", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> double
+        { return math::matrix_determinant(d.matrices[i]); });
+}
+
+/* The quaternion and 3-vector operations. */
+template <typename T>
+void
+run_rotations (std::string const& type, std::vector<std::string> const& filters,
+    std::size_t size, double min_time)
+{
+    typedef math::Vector<T,3> Vec;
+    typedef Data<T,3,3> D;
+    D const data(size, 3);
+
+    run(type + "quat rotate", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Vec
+        { return d.quaternions[i].rotate(d.vectors[i]); });
+    run(type + "quat mult", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> math::Vector<T,4>
+        { return d.quaternions[i] * d.quaternions[d.next(i)]; });
+    run(type + "quat to matrix", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> math::Matrix<T,3,3>
+        {
+            math::Matrix<T,3,3> rot;
+            d.quaternions[i].to_rotation_matrix(*rot);
+            return rot;
+        });
+    run(type + "vec3 cross", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Vec
+        { return d.vectors[i].cross(d.vectors[d.next(i)]); });
+    run(type + "vec3 normalized", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Vec
+        { return d.vectors[i].normalized(); });
+}
+
+/* The generic vector operations. */
+template <typename T, int N>
+void
+run_vectors (std::string const& type, std::vector<std::string> const& filters,
+    std::size_t size, double min_time)
+{
+    typedef math::Vector<T,N> Vec;
+    typedef Data<T,N,N> D;
+    D const data(size, 4);
+    std::string const prefix = type + "vec" + std::to_string(N) + " ";
+
+    run(prefix + "add", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Vec
+        { return d.vectors[i] + d.vectors[d.next(i)]; });
+    run(prefix + "dot", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> double
+        { return d.vectors[i].dot(d.vectors[d.next(i)]); });
+    run(prefix + "square norm", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> double
+        { return d.vectors[i].square_norm(); });
+    run(prefix + "mat mult", filters, data, min_time,
+        [] (D const& d, std::size_t i) -> Vec
+        { return d.matrices[i] * d.vectors[i]; });
+}
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ] [ FILTER ... ]");
+    args.set_description("Times the SVD, QR and Cholesky decompositions, "
+        "inverses, determinants, quaternion rotations and vector operations "
+        "at the fixed sizes used by the pipeline and reports the time per "
+        "operation. Only the kernels whose name contains one of the given "
+        "filters are run, e.g. \"svd\" or \"9x9\".");
+    args.add_option('n', "matrices", true, "Matrices per run [1024]");
+    args.add_option('t', "time", true, "Minimum time per kernel in ms [200]");
+    args.parse(argc, argv);
+
+    std::size_t size = 1024;
+    double min_time = 0.2;
+    std::vector<std::string> filters;
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+            filters.push_back(i->arg);
+        else if (i->opt->lopt == "matrices")
+            size = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "time")
+            min_time = i->get_arg<double>() / 1000.0;
+    }
+
+    run_decompositions<3, 3>(filters, size, min_time);
+    run_decompositions<4, 4>(filters, size, min_time);
+    run_decompositions<8, 9>(filters, size, min_time);
+    run_decompositions<9, 9>(filters, size, min_time);
+
+    run_inverses<float, 3>("float ", filters, size, min_time);
+    run_inverses<float, 4>("float ", filters, size, min_time);
+    run_inverses<double, 3>("double ", filters, size, min_time);
+    run_inverses<double, 4>("double ", filters, size, min_time);
+
+    run_rotations<float>("float ", filters, size, min_time);
+    run_rotations<double>("double ", filters, size, min_time);
+
+    run_vectors<float, 3>("float ", filters, size, min_time);
+    run_vectors<float, 4>("float ", filters, size, min_time);
+    run_vectors<double, 3>("double ", filters, size, min_time);
+    run_vectors<double, 9>("double ", filters, size, min_time);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Benchmark for the small matrix kernels. Times the 3x3 and 4x4 matrix
+ * products, matrix-vector products and inverses of float and double
+ * matrices, and compares the unrolled products of math::Matrix with the
+ * generic product, which is the one of the Matrix template for all other
+ * sizes. Reports the time per operation.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "util/arguments.h"
+#include "math/algo.h"
+#include "math/matrix.h"
+#include "math/matrix_tools.h"
+
+/* The product of the generic Matrix template. */
+template <typename T, int N, int M, int U>
+math::Matrix<T,N,U>
+generic_mult (math::Matrix<T,N,M> const& a, math::Matrix<T,M,U> const& b)
+{
+    typedef math::algo::InterleavedIter<T,U> ColIter;
+    math::Matrix<T,N,U> ret;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < U; ++j)
+            ret(i,j) = std::inner_product(*a + M * i, *a + M * i + M,
+                ColIter(*b + j), T(0));
+    return ret;
+}
+
+template <typename T, int N, int M>
+math::Vector<T,N>
+generic_mult (math::Matrix<T,N,M> const& a, math::Vector<T,M> const& b)
+{
+    math::Vector<T,N> ret;
+    for (int i = 0; i < N; ++i)
+        ret[i] = std::inner_product(*a + M * i, *a + M * i + M, *b, T(0));
+    return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* Random, well-conditioned matrices and vectors. */
+template <typename T, int N>
+struct Data
+{
+    std::vector<math::Matrix<T,N,N> > matrices;
+    std::vector<math::Vector<T,N> > vectors;
+
+    Data (std::size_t size, unsigned int seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<T> dist(T(-1), T(1));
+        this->matrices.resize(size);
+        this->vectors.resize(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            math::Matrix<T,N,N>& mat = this->matrices[i];
+            for (int j = 0; j < N * N; ++j)
+                mat[j] = dist(generator);
+            for (int j = 0; j < N; ++j)
+                mat(j, j) += T(N);
+            for (int j = 0; j < N; ++j)
+                this->vectors[i][j] = dist(generator);
+        }
+    }
+};
+
+/* Sums the values of the results so the work is not optimized away. */
+template <typename T>
+double
+checksum (T const& value)
+{
+    return std::accumulate(*value, *value + T::rows * T::cols, 0.0);
+}
+
+template <typename T, int N>
+double
+checksum (math::Vector<T,N> const& value)
+{
+    return std::accumulate(*value, *value + N, 0.0);
+}
+
+/* Runs the operation on all data and prints the time per operation. */
+template <typename T, int N, typename OP>
+void
+run (std::string const& name, Data<T,N> const& data, int repetitions, OP op)
+{
+    std::size_t const size = data.matrices.size();
+    double sum = 0.0;
+    /* The timer has nanosecond resolution, WallTimer only milliseconds. */
+    std::chrono::steady_clock::time_point const start
+        = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; ++r)
+        for (std::size_t i = 0; i < size; ++i)
+            sum += checksum(op(data, i));
+    std::chrono::nanoseconds const elapsed
+        = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    double const ns = static_cast<double>(elapsed.count())
+        / (static_cast<double>(size) * repetitions);
+
+    std::cout << std::left << std::setw(28) << name << std::right
+        << std::fixed << std::setprecision(2) << std::setw(10) << ns
+        << " ns  (checksum " << std::setprecision(3) << sum << ")"
+        << std::endl;
+}
+
+template <typename T, int N>
+void
+run_all (std::string const& type, std::size_t size, int repetitions)
+{
+    typedef math::Matrix<T,N,N> Mat;
+    typedef math::Vector<T,N> Vec;
+    typedef Data<T,N> D;
+    D const data(size, 1);
+    std::string const prefix = type + std::to_string(N) + "x"
+        + std::to_string(N) + " ";
+
+    run(prefix + "mult generic", data, repetitions,
+        [size] (D const& d, std::size_t i) -> Mat
+        { return generic_mult(d.matrices[i], d.matrices[size - 1 - i]); });
+    run(prefix + "mult unrolled", data, repetitions,
+        [size] (D const& d, std::size_t i) -> Mat
+        { return d.matrices[i] * d.matrices[size - 1 - i]; });
+    run(prefix + "mult vec generic", data, repetitions,
+        [] (D const& d, std::size_t i) -> Vec
+        { return generic_mult(d.matrices[i], d.vectors[i]); });
+    run(prefix + "mult vec unrolled", data, repetitions,
+        [] (D const& d, std::size_t i) -> Vec
+        { return d.matrices[i] * d.vectors[i]; });
+    run(prefix + "inverse", data, repetitions,
+        [] (D const& d, std::size_t i) -> Mat
+        { return math::matrix_inverse(d.matrices[i]); });
+}
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ]");
+    args.set_description("Times the 3x3 and 4x4 matrix products, "
+        "matrix-vector products and inverses of float and double matrices, "
+        "and compares the unrolled products with the generic product.");
+    args.add_option('n', "matrices", true, "Matrices per run [4096]");
+    args.add_option('r', "repetitions", true, "Repetitions of the run [500]");
+    args.parse(argc, argv);
+
+    std::size_t size = 4096;
+    int repetitions = 500;
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+            continue;
+        if (i->opt->lopt == "matrices")
+            size = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "repetitions")
+            repetitions = std::max(1, i->get_arg<int>());
+    }
+
+    run_all<float, 3>("float ", size, repetitions);
+    run_all<float, 4>("float ", size, repetitions);
+    run_all<double, 3>("double ", size, repetitions);
+    run_all<double, 4>("double ", size, repetitions);
+
+    return 0;
+}
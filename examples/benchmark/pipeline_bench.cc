@@ -0,0 +1,563 @@
+/*
+ * End-to-end benchmark for the SfM pipeline. Runs feature detection,
+ * matching, geometric verification, track computation, the initial pair
+ * search and the incremental reconstruction on all images of the given
+ * directories and reports the wall time, the throughput and the peak
+ * memory of every stage. The results can be written to a JSON file, and
+ * compared against a stored baseline to detect regressions.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
+
+#include "util/arguments.h"
+#include "util/file_system.h"
+#include "util/profiler.h"
+#include "util/strings.h"
+#include "util/timer.h"
+#include "sfm/bundler_common.h"
+#include "sfm/bundler_incremental.h"
+#include "sfm/bundler_init_pair.h"
+#include "sfm/bundler_matching.h"
+#include "sfm/bundler_tracks.h"
+#include "sfm/bundler_verification.h"
+#include "sfm/feature_set.h"
+
+/* The result of a pipeline stage. */
+struct StageResult
+{
+    std::string name;
+    double time_ms;
+    /* The number of processed items and their unit, e.g. images. */
+    std::size_t items;
+    std::string unit;
+    std::size_t peak_rss_kb;
+};
+
+typedef std::vector<StageResult> StageResults;
+
+/* Returns the peak resident set size of the process in kilobytes. */
+std::size_t
+get_peak_rss_kb (void)
+{
+#if defined(__linux__)
+    /* VmHWM is reset by reset_peak_rss(), unlike ru_maxrss. */
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line))
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::strtoul(line.c_str() + 6, nullptr, 10);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#elif defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Resets the peak resident set size to the current size, so that the
+ * peak of every stage is measured separately. Only supported on Linux,
+ * elsewhere the peak of all stages so far is reported.
+ */
+void
+reset_peak_rss (void)
+{
+#if defined(__linux__)
+    std::ofstream out("/proc/self/clear_refs");
+    out << "5" << std::endl;
+#endif
+}
+
+bool
+is_image_file (std::string const& filename)
+{
+    std::string const ext = util::string::lowercase
+        (util::string::right(filename, 4));
+    return ext == ".jpg" || ext == "jpeg" || ext == ".png" || ext == ".tif";
+}
+
+/* ---------------------------------------------------------------- */
+
+/* Measures the stages of one pipeline run. */
+class StageRecorder
+{
+public:
+    explicit StageRecorder (StageResults* results) : results(results)
+    {
+        reset_peak_rss();
+    }
+
+    /* Finishes the current stage and starts the next one. */
+    void add (std::string const& name, std::size_t items,
+        std::string const& unit)
+    {
+        StageResult result;
+        result.name = name;
+        result.time_ms = this->timer.get_elapsed();
+        result.items = items;
+        result.unit = unit;
+        result.peak_rss_kb = get_peak_rss_kb();
+        this->results->push_back(result);
+        reset_peak_rss();
+        this->timer.reset();
+    }
+
+private:
+    StageResults* results;
+    util::WallTimer timer;
+};
+
+/* Runs the pipeline once and records the stages. */
+void
+run_pipeline (std::vector<std::string> const& filenames,
+    sfm::FeatureSet::FeatureTypes feature_types, int num_threads,
+    StageResults* results)
+{
+    sfm::bundler::ViewportList viewports;
+    sfm::bundler::PairwiseMatching pairwise;
+    sfm::bundler::TrackList tracks;
+    StageRecorder stages(results);
+
+    /* Feature detection with the EXIF focal lengths. */
+    {
+        sfm::bundler::init_viewports_from_files(filenames, num_threads,
+            &viewports);
+        sfm::FeatureSet::Options feature_opts;
+        feature_opts.feature_types = feature_types;
+        feature_opts.sift_opts.num_threads = num_threads;
+        feature_opts.surf_opts.num_threads = num_threads;
+        std::vector<sfm::FeatureSet> feature_sets;
+        sfm::FeatureSet::compute_features(filenames, feature_opts, 0,
+            &feature_sets);
+        std::size_t num_features = 0;
+        for (std::size_t i = 0; i < viewports.size(); ++i)
+        {
+            sfm::bundler::Viewport& viewport = viewports[i];
+            viewport.features = std::move(feature_sets[i]);
+            if (viewport.focal_length <= 0.0f)
+                viewport.focal_length = 1.0f;
+            num_features += viewport.features.positions.size();
+        }
+        stages.add("features", filenames.size(), "images");
+        std::cout << "  " << num_features << " features" << std::endl;
+    }
+
+    /* Exhaustive matching of all pairs. */
+    {
+        sfm::bundler::Matching::Options matching_opts;
+        matching_opts.num_threads = num_threads;
+        sfm::bundler::Matching matching(matching_opts);
+        matching.init(&viewports);
+        matching.compute(&pairwise);
+        std::size_t const num_pairs
+            = viewports.size() * (viewports.size() - 1) / 2;
+        stages.add("matching", num_pairs, "pairs");
+    }
+
+    /* Geometric verification with the two-view geometry. */
+    {
+        std::size_t const num_pairs = pairwise.size();
+        sfm::bundler::Verification::Options verification_opts;
+        verification_opts.compute_geometry = true;
+        verification_opts.num_threads = num_threads;
+        sfm::bundler::Verification verification(verification_opts);
+        verification.compute(viewports, &pairwise);
+        stages.add("verification", num_pairs, "pairs");
+        std::cout << "  " << pairwise.size() << " of " << num_pairs
+            << " pairs verified" << std::endl;
+    }
+
+    /* Tracks. The reconstruction expects normalized feature positions. */
+    {
+        for (std::size_t i = 0; i < viewports.size(); ++i)
+            viewports[i].features.normalize_feature_positions();
+        std::size_t num_matches = 0;
+        for (std::size_t i = 0; i < pairwise.size(); ++i)
+            num_matches += pairwise[i].matches.size();
+        sfm::bundler::Tracks::Options tracks_opts;
+        tracks_opts.num_threads = num_threads;
+        sfm::bundler::Tracks tracks_builder(tracks_opts);
+        tracks_builder.compute(pairwise, &viewports, &tracks);
+        stages.add("tracks", num_matches, "matches");
+        std::cout << "  " << tracks.size() << " tracks" << std::endl;
+    }
+
+    /* Initial pair. */
+    sfm::bundler::InitialPair::Result init_pair;
+    {
+        sfm::bundler::InitialPair::Options init_pair_opts;
+        sfm::bundler::InitialPair init_pair_search(init_pair_opts);
+        init_pair_search.compute(viewports, pairwise, &init_pair);
+        stages.add("init_pair", pairwise.size(), "pairs");
+    }
+    if (init_pair.pair_id < 0)
+    {
+        std::cout << "  No initial pair found, skipping the "
+            << "reconstruction" << std::endl;
+        return;
+    }
+    std::cout << "  Initial pair " << init_pair.view_1_id << ", "
+        << init_pair.view_2_id << std::endl;
+
+    /* Incremental reconstruction with bundle adjustment. */
+    {
+        viewports[init_pair.view_1_id].pose = init_pair.view_1_pose;
+        viewports[init_pair.view_2_id].pose = init_pair.view_2_pose;
+        sfm::bundler::Incremental::Options incremental_opts;
+        sfm::bundler::Incremental incremental(incremental_opts);
+        incremental.initialize(&viewports, &tracks);
+        incremental.reconstruct();
+        sfm::bundler::Incremental::Statistics const& stats
+            = incremental.get_statistics();
+        stages.add("incremental", viewports.size(), "views");
+
+        /* The bundle adjustment share of the reconstruction. */
+        StageResult ba_result = results->back();
+        ba_result.name = "bundle_adjustment";
+        ba_result.time_ms = stats.ba_time;
+        ba_result.items = stats.num_full_ba + stats.num_local_ba;
+        ba_result.unit = "runs";
+        results->push_back(ba_result);
+        std::cout << "  " << stats.num_registered_views
+            << " views registered to the initial pair" << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+double
+get_items_per_second (StageResult const& result)
+{
+    if (result.time_ms <= 0.0)
+        return 0.0;
+    return 1000.0 * static_cast<double>(result.items) / result.time_ms;
+}
+
+void
+write_json (std::string const& filename, std::size_t num_images,
+    int num_threads, StageResults const& results)
+{
+    std::ofstream out(filename.c_str());
+    if (!out.good())
+        throw std::runtime_error("Error opening " + filename);
+
+    out << "{" << std::endl;
+    out << "  \"images\": " << num_images << "," << std::endl;
+    out << "  \"threads\": " << num_threads << "," << std::endl;
+    out << "  \"stages\": [" << std::endl;
+    out << std::fixed << std::setprecision(2);
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        StageResult const& result = results[i];
+        out << "    { \"name\": \"" << result.name << "\""
+            << ", \"time_ms\": " << result.time_ms
+            << ", \"items\": " << result.items
+            << ", \"unit\": \"" << result.unit << "\""
+            << ", \"items_per_second\": " << get_items_per_second(result)
+            << ", \"peak_rss_kb\": " << result.peak_rss_kb << " }"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+/* Extracts the value of a key from a line written by write_json(). */
+bool
+find_json_value (std::string const& line, std::string const& key,
+    std::string* value)
+{
+    std::string const pattern = "\"" + key + "\": ";
+    std::size_t pos = line.find(pattern);
+    if (pos == std::string::npos)
+        return false;
+    pos += pattern.size();
+    if (pos < line.size() && line[pos] == '"')
+    {
+        std::size_t const end = line.find('"', pos + 1);
+        if (end == std::string::npos)
+            return false;
+        *value = line.substr(pos + 1, end - pos - 1);
+        return true;
+    }
+    std::size_t const end = line.find_first_of(",}", pos);
+    *value = line.substr(pos, end == std::string::npos
+        ? std::string::npos : end - pos);
+    return true;
+}
+
+/* Reads the stages of a JSON file written by write_json(). */
+void
+read_json (std::string const& filename, StageResults* results)
+{
+    std::ifstream in(filename.c_str());
+    if (!in.good())
+        throw std::runtime_error("Error opening " + filename);
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        StageResult result;
+        std::string time, rss;
+        if (!find_json_value(line, "name", &result.name)
+            || !find_json_value(line, "time_ms", &time)
+            || !find_json_value(line, "peak_rss_kb", &rss))
+            continue;
+        result.time_ms = std::strtod(time.c_str(), nullptr);
+        result.items = 0;
+        result.peak_rss_kb = std::strtoul(rss.c_str(), nullptr, 10);
+        results->push_back(result);
+    }
+    if (results->empty())
+        throw std::runtime_error("No stages in " + filename);
+}
+
+/* ---------------------------------------------------------------- */
+
+struct AppSettings
+{
+    std::vector<std::string> directories;
+    std::string output_file;
+    std::string baseline_file;
+    int repetitions;
+    int num_threads;
+    std::size_t max_images;
+    sfm::FeatureSet::FeatureTypes feature_types;
+    double threshold;
+    double min_time_delta;
+    std::size_t min_memory_delta;
+    bool profile;
+};
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_usage(argv[0], "[ OPTIONS ] [ DIRECTORY ... ]");
+    args.set_description("Runs the SfM pipeline on all images in the given "
+        "directories (defaults to examples/data/sequence) and reports the "
+        "wall time, throughput and peak memory per stage. With a baseline, "
+        "the exit code is 1 if a stage is slower or uses more memory than "
+        "the baseline by more than the threshold.");
+    args.add_option('r', "repetitions", true, "Pipeline runs, the fastest "
+        "time per stage is reported [1]");
+    args.add_option('t', "threads", true, "Threads, 0 = all [0]");
+    args.add_option('n', "max-images", true, "Uses the first N images, "
+        "0 = all [3]");
+    args.add_option('f', "features", true, "Feature types: sift, surf "
+        "or all [all]");
+    args.add_option('o', "output", true, "Writes results as JSON file");
+    args.add_option('b', "baseline", true, "Compares against a JSON file");
+    args.add_option('p', "profile", false, "Prints the profiler report "
+        "with hardware counters, needs ENABLE_PROFILING");
+    args.add_option('\0', "threshold", true, "Allowed relative increase "
+        "of time and memory [0.2]");
+    args.add_option('\0', "min-time-delta", true, "Ignores time increases "
+        "below this many ms [100]");
+    args.add_option('\0', "min-memory-delta", true, "Ignores memory "
+        "increases below this many KB [16384]");
+    args.parse(argc, argv);
+
+    AppSettings conf;
+    conf.repetitions = 1;
+    conf.num_threads = 0;
+    conf.max_images = 3;
+    conf.feature_types = sfm::FeatureSet::FEATURE_ALL;
+    conf.threshold = 0.2;
+    conf.min_time_delta = 100.0;
+    conf.min_memory_delta = 16384;
+    conf.profile = false;
+    for (util::ArgResult const* i = args.next_result();
+        i != nullptr; i = args.next_result())
+    {
+        if (i->opt == nullptr)
+        {
+            conf.directories.push_back(i->arg);
+            continue;
+        }
+        if (i->opt->lopt == "repetitions")
+            conf.repetitions = std::max(1, i->get_arg<int>());
+        else if (i->opt->lopt == "threads")
+            conf.num_threads = i->get_arg<int>();
+        else if (i->opt->lopt == "max-images")
+            conf.max_images = i->get_arg<std::size_t>();
+        else if (i->opt->lopt == "features" && i->arg == "sift")
+            conf.feature_types = sfm::FeatureSet::FEATURE_SIFT;
+        else if (i->opt->lopt == "features" && i->arg == "surf")
+            conf.feature_types = sfm::FeatureSet::FEATURE_SURF;
+        else if (i->opt->lopt == "features")
+            conf.feature_types = sfm::FeatureSet::FEATURE_ALL;
+        else if (i->opt->lopt == "output")
+            conf.output_file = i->arg;
+        else if (i->opt->lopt == "baseline")
+            conf.baseline_file = i->arg;
+        else if (i->opt->lopt == "profile")
+            conf.profile = true;
+        else if (i->opt->lopt == "threshold")
+            conf.threshold = i->get_arg<double>();
+        else if (i->opt->lopt == "min-time-delta")
+            conf.min_time_delta = i->get_arg<double>();
+        else if (i->opt->lopt == "min-memory-delta")
+            conf.min_memory_delta = i->get_arg<std::size_t>();
+    }
+    if (conf.directories.empty())
+        conf.directories.push_back("examples/data/sequence");
+
+    /* Collect the image files. */
+    std::vector<std::string> filenames;
+    for (std::size_t i = 0; i < conf.directories.size(); ++i)
+    {
+        util::fs::Directory dir;
+        try
+        {
+            dir.scan(conf.directories[i]);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Error scanning " << conf.directories[i]
+                << ": " << e.what() << std::endl;
+            return 1;
+        }
+        std::sort(dir.begin(), dir.end());
+        for (std::size_t j = 0; j < dir.size(); ++j)
+            if (!dir[j].is_dir && is_image_file(dir[j].name))
+                filenames.push_back(dir[j].get_absolute_name());
+    }
+    if (conf.max_images > 0 && filenames.size() > conf.max_images)
+        filenames.resize(conf.max_images);
+    if (filenames.size() < 2)
+    {
+        std::cerr << "At least two images are required." << std::endl;
+        return 1;
+    }
+
+    StageResults baseline;
+    if (!conf.baseline_file.empty())
+    {
+        try
+        {
+            read_json(conf.baseline_file, &baseline);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    util::Profiler::set_enabled(conf.profile);
+    if (conf.profile && !util::Profiler::set_counters_enabled(true))
+        std::cerr << "Hardware counters are not available." << std::endl;
+
+    /* Run the pipeline, keeping the fastest time of every stage. */
+    StageResults results;
+    for (int rep = 0; rep < conf.repetitions; ++rep)
+    {
+        std::cout << "Run #" << rep << " on " << filenames.size()
+            << " images" << std::endl;
+        StageResults run;
+        run_pipeline(filenames, conf.feature_types, conf.num_threads, &run);
+        if (rep == 0)
+        {
+            results = run;
+            continue;
+        }
+        for (std::size_t i = 0; i < run.size() && i < results.size(); ++i)
+        {
+            results[i].time_ms = std::min(results[i].time_ms, run[i].time_ms);
+            results[i].peak_rss_kb = std::max(results[i].peak_rss_kb,
+                run[i].peak_rss_kb);
+        }
+    }
+
+    double total_ms = 0.0;
+    std::cout << std::fixed << std::setprecision(1);
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        StageResult const& result = results[i];
+        if (result.name != "bundle_adjustment")
+            total_ms += result.time_ms;
+        std::cout << std::left << std::setw(18) << result.name
+            << std::right << std::setw(10) << result.time_ms << " ms"
+            << std::setw(10) << get_items_per_second(result) << " "
+            << result.unit << "/s" << std::setw(10) << result.peak_rss_kb
+            << " KB peak" << std::endl;
+    }
+    std::cout << "Total: " << total_ms << " ms" << std::endl;
+    if (conf.profile)
+        util::Profiler::print_report(std::cout);
+
+    if (!conf.output_file.empty())
+    {
+        try
+        {
+            write_json(conf.output_file, filenames.size(), conf.num_threads,
+                results);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    /* Compare against the baseline. */
+    if (baseline.empty())
+        return 0;
+    bool regression = false;
+    for (std::size_t i = 0; i < baseline.size(); ++i)
+    {
+        StageResult const* result = nullptr;
+        for (std::size_t j = 0; j < results.size(); ++j)
+            if (results[j].name == baseline[i].name)
+                result = &results[j];
+        if (result == nullptr)
+        {
+            std::cout << "Stage " << baseline[i].name
+                << " missing in this run" << std::endl;
+            regression = true;
+            continue;
+        }
+
+        double const time_delta = result->time_ms - baseline[i].time_ms;
+        if (time_delta > conf.min_time_delta
+            && time_delta > conf.threshold * baseline[i].time_ms)
+        {
+            std::cout << "Regression in " << result->name << ": "
+                << result->time_ms << " ms vs. " << baseline[i].time_ms
+                << " ms baseline" << std::endl;
+            regression = true;
+        }
+
+        double const memory_delta = static_cast<double>(result->peak_rss_kb)
+            - static_cast<double>(baseline[i].peak_rss_kb);
+        if (memory_delta > static_cast<double>(conf.min_memory_delta)
+            && memory_delta > conf.threshold * baseline[i].peak_rss_kb)
+        {
+            std::cout << "Regression in " << result->name << ": "
+                << result->peak_rss_kb << " KB vs. "
+                << baseline[i].peak_rss_kb << " KB baseline" << std::endl;
+            regression = true;
+        }
+    }
+    std::cout << (regression ? "Regressions found." : "No regressions.")
+        << std::endl;
+
+    return regression ? 1 : 0;
+}
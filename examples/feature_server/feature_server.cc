@@ -0,0 +1,471 @@
+/*
+ * Long-running feature extraction service on a local (Unix domain) socket.
+ * Starting a process per image batch pays for the process start, the
+ * thread creation and the allocation of the scale space storage for every
+ * batch. The service keeps a thread pool running, and the SIFT and SURF
+ * detectors are kept for the jobs of the workers. They recycle their
+ * storage for images of the same size. The latency per image is thus the
+ * compute time.
+ *
+ * The protocol is line-based, the fields are separated by spaces, so the
+ * paths must not contain whitespace. Requests of a connection are queued
+ * for all workers and every request gets one reply line, which can arrive
+ * out of order and is identified by the output file name.
+ *
+ *   EXTRACT <image file> <output file>
+ *   PIXELS <width> <height> <channels> <output file>
+ *     followed by width * height * channels bytes of 8-bit pixel data
+ *   -> OK <output file> <number of features> <milliseconds>
+ *   -> ERROR <output file> <message>
+ *
+ *   PING -> PONG
+ *   SHUTDOWN -> BYE, finishes the queued requests and exits
+ *
+ * The features are written as a feature database with one view, see
+ * sfm::bundler::FeatureDatabase, through a temporary file that is renamed.
+ * Example client: printf "EXTRACT a.jpg a.features\n" | nc -U server.sock
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "util/arguments.h"
+#include "util/file_system.h"
+#include "util/strings.h"
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "util/tokenizer.h"
+#include "core/image_io.h"
+#include "sfm/feature_database.h"
+#include "sfm/feature_set.h"
+
+/* Limits the pixel data of a request to 256 megapixels with 3 channels. */
+#define MAX_PIXEL_BYTES (std::size_t(768) << 20)
+
+/* A client connection with buffered reads and serialized replies. */
+class Connection
+{
+public:
+    explicit Connection (int fd);
+    ~Connection (void);
+
+    /* Reads a line without the newline, returns false at the end. */
+    bool read_line (std::string* line);
+    /* Reads exactly the given number of bytes. */
+    bool read_bytes (std::size_t size, char* data);
+    /* Writes a line, replies of the workers are serialized. */
+    void write_line (std::string const& line);
+    /* Ends the reads, e.g. for shutdown. Replies can still be written. */
+    void shutdown_reads (void);
+
+private:
+    bool fill_buffer (void);
+
+private:
+    int fd;
+    std::string buffer;
+    std::size_t buffer_pos;
+    std::mutex write_mutex;
+};
+
+Connection::Connection (int fd)
+    : fd(fd)
+    , buffer_pos(0)
+{
+}
+
+Connection::~Connection (void)
+{
+    ::close(this->fd);
+}
+
+bool
+Connection::fill_buffer (void)
+{
+    this->buffer.erase(0, this->buffer_pos);
+    this->buffer_pos = 0;
+    char chunk[4096];
+    ssize_t const size = ::recv(this->fd, chunk, sizeof(chunk), 0);
+    if (size <= 0)
+        return false;
+    this->buffer.append(chunk, static_cast<std::size_t>(size));
+    return true;
+}
+
+bool
+Connection::read_line (std::string* line)
+{
+    while (true)
+    {
+        std::size_t const end = this->buffer.find('\n', this->buffer_pos);
+        if (end != std::string::npos)
+        {
+            line->assign(this->buffer, this->buffer_pos,
+                end - this->buffer_pos);
+            this->buffer_pos = end + 1;
+            if (!line->empty() && line->back() == '\r')
+                line->erase(line->size() - 1);
+            return true;
+        }
+        if (!this->fill_buffer())
+            return false;
+    }
+}
+
+bool
+Connection::read_bytes (std::size_t size, char* data)
+{
+    while (size > 0)
+    {
+        if (this->buffer_pos == this->buffer.size() && !this->fill_buffer())
+            return false;
+        std::size_t const num = std::min(size,
+            this->buffer.size() - this->buffer_pos);
+        std::copy(this->buffer.begin() + this->buffer_pos,
+            this->buffer.begin() + this->buffer_pos + num, data);
+        this->buffer_pos += num;
+        data += num;
+        size -= num;
+    }
+    return true;
+}
+
+void
+Connection::write_line (std::string const& line)
+{
+    std::string const data = line + "\n";
+    std::lock_guard<std::mutex> lock(this->write_mutex);
+    std::size_t pos = 0;
+    while (pos < data.size())
+    {
+        /* Clients that went away must not raise SIGPIPE. */
+        ssize_t const size = ::send(this->fd, data.data() + pos,
+            data.size() - pos, MSG_NOSIGNAL);
+        if (size <= 0)
+            return;
+        pos += static_cast<std::size_t>(size);
+    }
+}
+
+void
+Connection::shutdown_reads (void)
+{
+    ::shutdown(this->fd, SHUT_RD);
+}
+
+/* ---------------------------------------------------------------- */
+
+/* An image to process, given as file name or as pixel data. */
+struct Job
+{
+    std::shared_ptr<Connection> connection;
+    std::string image_filename;
+    core::ByteImage::Ptr image;
+    std::string output_filename;
+};
+
+/*
+ * Detectors that are kept for all jobs. A job takes idle detectors or
+ * creates new ones, at most one set per worker is thus created.
+ */
+class DetectorPool
+{
+public:
+    typedef std::unique_ptr<sfm::FeatureSet::Detectors> DetectorsPtr;
+
+public:
+    explicit DetectorPool (sfm::FeatureSet::Options const& options);
+    DetectorsPtr acquire (void);
+    void release (DetectorsPtr detectors);
+
+private:
+    sfm::FeatureSet::Options options;
+    std::vector<DetectorsPtr> idle;
+    std::mutex mutex;
+};
+
+DetectorPool::DetectorPool (sfm::FeatureSet::Options const& options)
+    : options(options)
+{
+}
+
+DetectorPool::DetectorsPtr
+DetectorPool::acquire (void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->idle.empty())
+        {
+            DetectorsPtr detectors = std::move(this->idle.back());
+            this->idle.pop_back();
+            return detectors;
+        }
+    }
+    return DetectorsPtr(new sfm::FeatureSet::Detectors(this->options));
+}
+
+void
+DetectorPool::release (DetectorsPtr detectors)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->idle.push_back(std::move(detectors));
+}
+
+/* ---------------------------------------------------------------- */
+
+/* Processes a job with detectors of the pool, the reply ends the job. */
+void
+process_job (Job const& job, DetectorPool* detector_pool,
+    sfm::FeatureSet::Options const& options)
+{
+    util::WallTimer timer;
+    try
+    {
+        sfm::bundler::ViewportList single(1);
+        sfm::FeatureSet& features = single[0].features;
+        features.set_options(options);
+
+        core::ByteImage::Ptr image = job.image != nullptr ? job.image
+            : core::image::load_file(job.image_filename);
+        DetectorPool::DetectorsPtr detectors = detector_pool->acquire();
+        features.compute_features(image, detectors.get());
+        detector_pool->release(std::move(detectors));
+
+        std::string const tmp_filename = job.output_filename + ".tmp";
+        sfm::bundler::save_feature_database(single, tmp_filename);
+        if (!util::fs::rename(tmp_filename.c_str(),
+            job.output_filename.c_str()))
+            throw std::runtime_error("Error renaming " + tmp_filename);
+
+        job.connection->write_line("OK " + job.output_filename + " "
+            + util::string::get(features.positions.size()) + " "
+            + util::string::get(timer.get_elapsed()));
+    }
+    catch (std::exception& e)
+    {
+        job.connection->write_line("ERROR " + job.output_filename
+            + " " + e.what());
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+/* The state of the server shared by the connection threads. */
+struct Server
+{
+    int listen_fd;
+    sfm::FeatureSet::Options options;
+    std::unique_ptr<DetectorPool> detectors;
+    std::unique_ptr<util::ThreadPool> workers;
+    std::atomic<bool> shutdown;
+    std::mutex mutex;
+    /* The open connections to end at shutdown. */
+    std::vector<std::weak_ptr<Connection> > connections;
+};
+
+/* Queues a job for the workers. */
+void
+queue_job (Server* server, Job const& job)
+{
+    server->workers->run([server, job] (void)
+        { process_job(job, server->detectors.get(), server->options); });
+}
+
+/* Reads the requests of a connection and queues the jobs. */
+void
+connection_main (Server* server, std::shared_ptr<Connection> connection)
+{
+    std::string line;
+    while (connection->read_line(&line))
+    {
+        util::Tokenizer tokens;
+        tokens.split(line, ' ');
+        if (tokens.empty())
+            continue;
+
+        if (tokens[0] == "EXTRACT" && tokens.size() == 3)
+        {
+            Job job;
+            job.connection = connection;
+            job.image_filename = tokens[1];
+            job.output_filename = tokens[2];
+            queue_job(server, job);
+        }
+        else if (tokens[0] == "PIXELS" && tokens.size() == 5)
+        {
+            int const width = util::string::convert<int>(tokens[1], false);
+            int const height = util::string::convert<int>(tokens[2], false);
+            int const channels = util::string::convert<int>(tokens[3], false);
+            if (width <= 0 || height <= 0
+                || (channels != 1 && channels != 3)
+                || static_cast<std::size_t>(width) * height * channels
+                > MAX_PIXEL_BYTES)
+            {
+                /* The pixel data cannot be skipped, end the connection. */
+                connection->write_line("ERROR " + tokens[4]
+                    + " Invalid image size");
+                break;
+            }
+
+            Job job;
+            job.connection = connection;
+            job.image = core::ByteImage::create(width, height, channels);
+            job.output_filename = tokens[4];
+            if (!connection->read_bytes(job.image->get_byte_size(),
+                job.image->get_byte_pointer()))
+                break;
+            queue_job(server, job);
+        }
+        else if (tokens[0] == "PING" && tokens.size() == 1)
+            connection->write_line("PONG");
+        else if (tokens[0] == "SHUTDOWN" && tokens.size() == 1)
+        {
+            connection->write_line("BYE");
+            server->shutdown = true;
+            ::shutdown(server->listen_fd, SHUT_RDWR);
+            break;
+        }
+        else
+            connection->write_line("ERROR - Invalid request: " + line);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+main (int argc, char** argv)
+{
+    util::Arguments args;
+    args.set_exit_on_error(true);
+    args.set_nonopt_minnum(1);
+    args.set_nonopt_maxnum(1);
+    args.set_usage(argv[0], "[ OPTIONS ] SOCKET");
+    args.set_description("Runs a feature extraction service on a Unix "
+        "domain socket. The workers keep their detectors warm for all "
+        "requests and write every result as a feature database file. "
+        "See the source for the protocol.");
+    args.add_option('t', "threads", true, "Worker threads, 0 = all [0]");
+    args.add_option('f', "features", true, "Feature types: sift, surf "
+        "or all [all]");
+    args.parse(argc, argv);
+
+    std::string const socket_path = args.get_nth_nonopt(0);
+    int num_threads = 0;
+    sfm::FeatureSet::Options options;
+    options.feature_types = sfm::FeatureSet::FEATURE_ALL;
+    for (util::ArgResult const* i = args.next_option();
+        i != nullptr; i = args.next_option())
+    {
+        if (i->opt->lopt == "threads")
+            num_threads = i->get_arg<int>();
+        else if (i->opt->lopt == "features")
+        {
+            if (i->arg == "sift")
+                options.feature_types = sfm::FeatureSet::FEATURE_SIFT;
+            else if (i->arg == "surf")
+                options.feature_types = sfm::FeatureSet::FEATURE_SURF;
+            else if (i->arg != "all")
+            {
+                std::cerr << "Invalid feature types: " << i->arg << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (num_threads <= 0)
+        num_threads = static_cast<int>(util::ThreadPool::get_num_threads());
+
+    /* The workers process one image each, the detectors are sequential. */
+    options.sift_opts.num_threads = 1;
+    options.surf_opts.num_threads = 1;
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    Server server;
+    server.options = options;
+    server.detectors.reset(new DetectorPool(options));
+    server.shutdown = false;
+    server.listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(socket_path.c_str());
+    if (server.listen_fd < 0 || ::bind(server.listen_fd,
+        reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::listen(server.listen_fd, 16) < 0)
+    {
+        std::cerr << "Error listening on " << socket_path << ": "
+            << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    server.workers.reset(new util::ThreadPool(num_threads));
+    std::cout << "Listening on " << socket_path << " with " << num_threads
+        << " workers." << std::endl;
+
+    /*
+     * Every connection has its own reader thread. The reads block for the
+     * lifetime of the connection, in a pool task they would occupy a worker
+     * and with more connections than workers stall the extraction.
+     */
+    std::vector<std::thread> readers;
+    while (!server.shutdown)
+    {
+        int const fd = ::accept(server.listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        std::shared_ptr<Connection> connection(new Connection(fd));
+        {
+            std::lock_guard<std::mutex> lock(server.mutex);
+            server.connections.erase(std::remove_if(
+                server.connections.begin(), server.connections.end(),
+                [] (std::weak_ptr<Connection> const& c)
+                { return c.expired(); }), server.connections.end());
+            server.connections.push_back(connection);
+        }
+        readers.push_back(std::thread(connection_main, &server, connection));
+    }
+
+    /* Stop reading requests, then finish the queued jobs. */
+    {
+        std::lock_guard<std::mutex> lock(server.mutex);
+        for (std::size_t i = 0; i < server.connections.size(); ++i)
+        {
+            std::shared_ptr<Connection> connection
+                = server.connections[i].lock();
+            if (connection != nullptr)
+                connection->shutdown_reads();
+        }
+        server.connections.clear();
+    }
+    for (std::size_t i = 0; i < readers.size(); ++i)
+        readers[i].join();
+    /* The pool finishes the queued jobs before it is destroyed. */
+    server.workers.reset();
+
+    ::close(server.listen_fd);
+    ::unlink(socket_path.c_str());
+    std::cout << "Shut down." << std::endl;
+    return 0;
+}
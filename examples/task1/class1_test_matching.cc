@@ -121,6 +121,7 @@ feature_set_matching (core::ByteImage::Ptr image1, core::ByteImage::Ptr image2)
     sift_matching_opts.lowe_ratio_threshold = 0.8f;
     sift_matching_opts.descriptor_length = 128;
     sift_matching_opts.distance_threshold = std::numeric_limits<float>::max();
+    sift_matching_opts.kd_forest_checks = 0;
 
 #if DISCRETIZE_DESCRIPTORS
     util::AlignedMemory<math::Vec128us, 16> sift_descr1, sift_descr2;
@@ -154,6 +155,7 @@ feature_set_matching (core::ByteImage::Ptr image1, core::ByteImage::Ptr image2)
     // 特征描述子的维度
     surf_matching_opts.descriptor_length = 64;
     surf_matching_opts.distance_threshold = std::numeric_limits<float>::max();
+    surf_matching_opts.kd_forest_checks = 0;
 
 #if DISCRETIZE_DESCRIPTORS
     util::AlignedMemory<math::Vec64s, 16> surf_descr1, surf_descr2;
@@ -149,6 +149,7 @@ sfm::Correspondences2D2D sift_feature_matching(sfm::FeatureSet &feat1
     matching_opts.descriptor_length = 128;
     matching_opts.distance_threshold = 1.0f;
     matching_opts.lowe_ratio_threshold = 0.8f;
+    matching_opts.kd_forest_checks = 0;
 
     // 特征匹配
     features::Matching::Result matching_result;
@@ -89,6 +89,7 @@ features::Matching::Result feature_matching(features::Sift::Descriptors const&si
     matching_opts.descriptor_length = 128;
     matching_opts.distance_threshold = 1.0f;
     matching_opts.lowe_ratio_threshold = 0.8f;
+    matching_opts.kd_forest_checks = 0;
 
     features::Matching::Result matching_result;
     features::Matching::twoway_match(matching_opts, aligned_descrs1.data()->begin(), sift_discrs1.size()
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <random>
+#include <stdexcept>
+
+#include "features/binary_descriptor.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+BinaryProjection::BinaryProjection (unsigned int seed)
+    : mean(0.0f)
+    , directions(256)
+{
+    std::mt19937 prng_mt(seed);
+    std::normal_distribution<float> dis(0.0f, 1.0f);
+    for (std::size_t i = 0; i < this->directions.size(); ++i)
+        for (int j = 0; j < 128; ++j)
+            this->directions[i][j] = dis(prng_mt);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryProjection::train (Sift::Descriptors const& descriptors)
+{
+    if (descriptors.empty())
+        throw std::invalid_argument("No training descriptors given");
+
+    math::Vector<double, 128> sum(0.0);
+    for (std::size_t i = 0; i < descriptors.size(); ++i)
+        for (int j = 0; j < 128; ++j)
+            sum[j] += descriptors[i].data[j];
+    for (int j = 0; j < 128; ++j)
+        this->mean[j] = static_cast<float>(sum[j] / descriptors.size());
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryProjection::compute (Sift::Descriptors const& descriptors,
+    BinaryDescriptors* result) const
+{
+    result->resize(descriptors.size());
+    for (std::size_t i = 0; i < descriptors.size(); ++i)
+    {
+        math::Vec128f const descr = descriptors[i].data - this->mean;
+        BinaryDescriptor& bits = result->at(i);
+        for (int j = 0; j < 4; ++j)
+        {
+            bits.bits[j] = 0;
+            for (int k = 0; k < 64; ++k)
+                if (descr.dot(this->directions[j * 64 + k]) > 0.0f)
+                    bits.bits[j] |= std::uint64_t(1) << k;
+        }
+    }
+}
+
+FEATURES_NAMESPACE_END
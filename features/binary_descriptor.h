@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef FEATURES_BINARY_DESCRIPTOR_HEADER
+#define FEATURES_BINARY_DESCRIPTOR_HEADER
+
+#include <cstdint>
+#include <vector>
+
+#include "math/functions.h"
+#include "math/vector.h"
+#include "features/defines.h"
+#include "features/sift.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+/**
+ * A 256 bit binary descriptor, compared with the Hamming distance.
+ * Binary descriptors can be matched with features::Matching like the other
+ * descriptor types, the descriptor length of the options is ignored.
+ */
+struct BinaryDescriptor
+{
+    std::uint64_t bits[4];
+};
+
+typedef std::vector<BinaryDescriptor> BinaryDescriptors;
+
+/** Returns the number of different bits. */
+int
+hamming_distance (BinaryDescriptor const& a, BinaryDescriptor const& b);
+
+/**
+ * Computes binary descriptors from SIFT descriptors by random projection.
+ * Each bit is the sign of the projection of the zero mean descriptor onto
+ * a random Gaussian direction, which approximates the angle between
+ * descriptors by the Hamming distance. The mean is estimated from a
+ * training set, and the directions only depend on the seed, so the same
+ * projection has to be used for all images.
+ *
+ * References:
+ * - "Similarity Estimation Techniques from Rounding Algorithms",
+ *   M. Charikar, STOC 2002.
+ * - "Fast and Accurate Image Matching with Cascade Hashing for 3D
+ *   Reconstruction", J. Cheng et al., CVPR 2014.
+ */
+class BinaryProjection
+{
+public:
+    explicit BinaryProjection (unsigned int seed = 0);
+
+    /** Estimates the descriptor mean from the given descriptors. */
+    void train (Sift::Descriptors const& descriptors);
+
+    /** Computes the binary descriptors of the SIFT descriptors. */
+    void compute (Sift::Descriptors const& descriptors,
+        BinaryDescriptors* result) const;
+
+private:
+    math::Vec128f mean;
+    /** 256 directions with 128 dimensions each. */
+    std::vector<math::Vec128f> directions;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline int
+hamming_distance (BinaryDescriptor const& a, BinaryDescriptor const& b)
+{
+    return static_cast<int>(math::popcount(a.bits[0] ^ b.bits[0])
+        + math::popcount(a.bits[1] ^ b.bits[1])
+        + math::popcount(a.bits[2] ^ b.bits[2])
+        + math::popcount(a.bits[3] ^ b.bits[3]));
+}
+
+FEATURES_NAMESPACE_END
+
+#endif /* FEATURES_BINARY_DESCRIPTOR_HEADER */
@@ -9,11 +9,13 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <stdexcept>
 #include <vector>
 
-#include "sfm/cascade_hashing.h"
+#include "features/cascade_hashing.h"
 
-SFM_NAMESPACE_BEGIN
+FEATURES_NAMESPACE_BEGIN
+using namespace sfm;
 
 void
 CascadeHashing::GlobalData::generate_proj_matrices (Options const& opts)
@@ -33,6 +35,8 @@ CascadeHashing::GlobalData::generate_proj_matrices (Options const& opts)
 void
 CascadeHashing::init (bundler::ViewportList* viewports)
 {
+    if (this->opts.sift_pca != nullptr)
+        throw std::invalid_argument("Cascade hashing requires full SIFT");
     ExhaustiveMatching::init(viewports);
 
     util::WallTimer timer;
@@ -68,6 +72,13 @@ CascadeHashing::init (bundler::ViewportList* viewports)
         << " ms" << std::endl;
 }
 
+void
+CascadeHashing::init_view (bundler::ViewportList const& /*viewports*/,
+    int /*view_id*/)
+{
+    throw std::logic_error("Cascade hashing needs all views at init()");
+}
+
 void
 CascadeHashing::pairwise_match (int view_1_id, int view_2_id,
     Matching::Result* result) const
@@ -151,24 +162,34 @@ CascadeHashing::compute_avg_descriptors (ProcessedFeatureSets const& pfs,
     std::size_t num_sift_descs_total = 0;
     std::size_t num_surf_descs_total = 0;
 
-    /* Compute sum of all SIFT/SURF descriptors. */
+    /*
+     * Compute sum of all SIFT/SURF descriptors. The sums per feature set
+     * are computed in parallel and accumulated in order, which keeps the
+     * result independent of the number of threads.
+     */
+    std::vector<math::Vec128f> sift_sums(pfs.size(), math::Vec128f(0.0f));
+    std::vector<math::Vec64f> surf_sums(pfs.size(), math::Vec64f(0.0f));
+#pragma omp parallel for schedule(dynamic)
     for (std::size_t i = 0; i < pfs.size(); i++)
     {
         SiftDescriptors const& sift_descr = pfs[i].sift_descr;
         SurfDescriptors const& surf_descr = pfs[i].surf_descr;
 
-        std::size_t num_sift_descriptors = sift_descr.size();
-        std::size_t num_surf_descriptors = surf_descr.size();
-        num_sift_descs_total += num_sift_descriptors;
-        num_surf_descs_total += num_surf_descriptors;
-
-        for (std::size_t j = 0; j < num_sift_descriptors; j++)
+        for (std::size_t j = 0; j < sift_descr.size(); j++)
             for (int k = 0; k < 128; k++)
-                sift_vec_sum[k] += sift_descr[j][k] / 255.0f;
+                sift_sums[i][k] += sift_descr[j][k] / 255.0f;
 
-        for (std::size_t j = 0; j < num_surf_descriptors; j++)
+        for (std::size_t j = 0; j < surf_descr.size(); j++)
             for (int k = 0; k < 64; k++)
-                surf_vec_sum[k] += surf_descr[j][k] / 127.0f;
+                surf_sums[i][k] += surf_descr[j][k] / 127.0f;
+    }
+
+    for (std::size_t i = 0; i < pfs.size(); i++)
+    {
+        sift_vec_sum += sift_sums[i];
+        surf_vec_sum += surf_sums[i];
+        num_sift_descs_total += pfs[i].sift_descr.size();
+        num_surf_descs_total += pfs[i].surf_descr.size();
     }
 
     /* Compute average vectors for SIFT/SURF. */
@@ -222,4 +243,4 @@ CascadeHashing::build_buckets(
     }
 }
 
-SFM_NAMESPACE_END
+FEATURES_NAMESPACE_END
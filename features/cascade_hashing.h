@@ -10,21 +10,23 @@
 #ifndef SFM_CASCADE_HASHING_HEADER
 #define SFM_CASCADE_HASHING_HEADER
 
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <random>
 
 #include "math/functions.h"
 #include "math/vector.h"
-#include "sfm/defines.h"
-#include "sfm/exhaustive_matching.h"
-#include "sfm/matching.h"
-#include "sfm/sift.h"
-#include "sfm/surf.h"
+#include "features/defines.h"
+#include "features/exhaustive_matching.h"
+#include "features/matching.h"
+#include "features/sift.h"
+#include "features/surf.h"
 #include "util/system.h"
 #include "util/timer.h"
 
-SFM_NAMESPACE_BEGIN
+FEATURES_NAMESPACE_BEGIN
 
 class CascadeHashing : public ExhaustiveMatching
 {
@@ -48,18 +50,31 @@ public:
      * Initialize matcher by computing cascade hashes of the SIFT/SURF
      * descriptors.
      */
-    void init (bundler::ViewportList* viewports) override;
+    void init (sfm::bundler::ViewportList* viewports) override;
 
-    /** Matches all feature types yielding a single matching result. */
+    /**
+     * Not supported, the descriptors are hashed relative to the average
+     * descriptor of all views. Throws std::logic_error.
+     */
+    void init_view (sfm::bundler::ViewportList const& viewports,
+        int view_id) override;
+
+    /**
+     * Matches all feature types yielding a single matching result.
+     * The features of the first view are matched in parallel.
+     */
     void pairwise_match (int view_1_id, int view_2_id,
         Matching::Result* result) const override;
 
+    /** Cascade hashing options, must be set before init(). */
+    Options cashash_opts;
+
 private:
     struct LocalData;
 
     /**
      * Matches all elements in set 1 to all elements in set 2 and vice versa.
-     * Works similarly to sfm::Matching::twoway_match().
+     * Works similarly to Matching::twoway_match().
      */
     template <typename D>
     void twoway_match (Matching::Options const& matching_opts,
@@ -69,7 +84,7 @@ private:
 
     /**
      * Matches all elements in set 1 to all elements in set 2.
-     * Works similarly to sfm::Matching::oneway_match().
+     * Works similarly to Matching::oneway_match().
      */
     template <typename D>
     void oneway_match (Matching::Options const& matching_opts,
@@ -217,7 +232,6 @@ private:
     GlobalData global_data;
     std::vector<LocalData> local_data_sift;
     std::vector<LocalData> local_data_surf;
-    Options cashash_opts;
 };
 
 /* ---------------------------------------------------------------- */
@@ -350,67 +364,80 @@ CascadeHashing::oneway_match (Matching::Options const& matching_opts,
     uint8_t const dim_hash_data = descriptor_length;
     uint32_t const dim_comp_hash_data = dim_hash_data / 64;
 
+    result->clear();
     result->resize(set_1_size, -1);
-    std::vector<bool> data_index_used(set_2_size);
-    std::vector<std::vector<uint32_t> > grouped_features(dim_hash_data + 1);
-    std::vector<uint32_t> top_candidates;
 
-    top_candidates.reserve(max_num_candidates);
+    /*
+     * The features of set 1 are matched in parallel. Each thread uses its
+     * own candidate buffers, and each feature writes its own result entry.
+     */
+    int const num_features = static_cast<int>(set_1_size);
+#pragma omp parallel
+    {
+        std::vector<bool> data_index_used(set_2_size);
+        std::vector<std::vector<uint32_t> > grouped_features(dim_hash_data + 1);
+        std::vector<uint32_t> top_candidates;
+
+        top_candidates.reserve(max_num_candidates);
 
-    std::unique_ptr<T> tmp(new T[max_num_candidates * descriptor_length]);
-    NearestNeighbor<T> nn;
-    nn.set_elements(tmp.get());
-    nn.set_element_dimensions(descriptor_length);
+        std::unique_ptr<T[]> tmp(new T[max_num_candidates * descriptor_length]);
+        NearestNeighbor<T> nn;
+        nn.set_elements(tmp.get());
+        nn.set_element_dimensions(descriptor_length);
 
-    for (size_t i = 0; i < set_1_size; i++)
-    {
-        std::fill(data_index_used.begin(), data_index_used.end(), false);
-
-        for (size_t j = 0; j < grouped_features.size(); j++)
-            grouped_features[j].clear();
-
-        top_candidates.clear();
-
-        /* Fetch candidate features from the buckets in each group. */
-        collect_features_from_buckets<dim_hash_data>(
-            &grouped_features,
-            i,
-            &data_index_used,
-            set_1.bucket_grps_bucket_ids,
-            set_2.bucket_grps_feature_ids,
-            &set_1.comp_hash_data[i * dim_comp_hash_data],
-            set_2.comp_hash_data);
-
-        /* Add closest candidates by Hamming distance to top_candidates vector. */
-        collect_top_ranked_candidates(
-            &top_candidates,
-            grouped_features,
-            dim_hash_data,
-            min_num_candidates,
-            max_num_candidates);
-
-        /* Copy top candidates' descriptors into a contiguous array. */
-        for (size_t j = 0; j < top_candidates.size(); j++)
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < num_features; i++)
         {
-            uint32_t candidate_id = top_candidates[j];
-            std::memcpy(tmp.get() + j * descriptor_length,
-                set_2_descs[candidate_id].begin(),
-                sizeof(V));
-        }
+            std::fill(data_index_used.begin(), data_index_used.end(), false);
+
+            for (size_t j = 0; j < grouped_features.size(); j++)
+                grouped_features[j].clear();
+
+            top_candidates.clear();
+
+            /* Fetch candidate features from the buckets in each group. */
+            collect_features_from_buckets<dim_hash_data>(
+                &grouped_features,
+                i,
+                &data_index_used,
+                set_1.bucket_grps_bucket_ids,
+                set_2.bucket_grps_feature_ids,
+                &set_1.comp_hash_data[i * dim_comp_hash_data],
+                set_2.comp_hash_data);
+
+            /* Add closest candidates by Hamming distance to top_candidates vector. */
+            collect_top_ranked_candidates(
+                &top_candidates,
+                grouped_features,
+                dim_hash_data,
+                min_num_candidates,
+                max_num_candidates);
+            if (top_candidates.empty())
+                continue;
+
+            /* Copy top candidates' descriptors into a contiguous array. */
+            for (size_t j = 0; j < top_candidates.size(); j++)
+            {
+                uint32_t candidate_id = top_candidates[j];
+                std::memcpy(tmp.get() + j * descriptor_length,
+                    set_2_descs[candidate_id].begin(),
+                    sizeof(V));
+            }
 
-        typename NearestNeighbor<T>::Result nn_result;
-        nn.set_num_elements(top_candidates.size());
-        nn.find(set_1_descs[i].begin(), &nn_result);
+            typename NearestNeighbor<T>::Result nn_result;
+            nn.set_num_elements(top_candidates.size());
+            nn.find(set_1_descs[i].begin(), &nn_result);
 
-        if (nn_result.dist_1st_best > square_dist_thres)
-            continue;
+            if (nn_result.dist_1st_best > square_dist_thres)
+                continue;
 
-        if (static_cast<float>(nn_result.dist_1st_best)
-            / static_cast<float>(nn_result.dist_2nd_best)
-            > square_lowe_thres)
-            continue;
+            if (static_cast<float>(nn_result.dist_1st_best)
+                / static_cast<float>(nn_result.dist_2nd_best)
+                > square_lowe_thres)
+                continue;
 
-        result->at(i) = top_candidates[nn_result.index_1st_best];
+            result->at(i) = top_candidates[nn_result.index_1st_best];
+        }
     }
 }
 
@@ -427,7 +454,7 @@ CascadeHashing::collect_features_from_buckets (
     size_t num_bucket_grps = bucket_grps_bucket_ids.size();
     for (size_t grp_idx = 0; grp_idx < num_bucket_grps; grp_idx++)
     {
-        uint8_t bucket_id = bucket_grps_bucket_ids[grp_idx][feature_id];
+        uint16_t bucket_id = bucket_grps_bucket_ids[grp_idx][feature_id];
         BucketFeatureIDs const& bucket_feature_ids = bucket_grps_feature_ids[grp_idx][bucket_id];
 
         for (size_t j = 0; j < bucket_feature_ids.size(); j++)
@@ -470,6 +497,6 @@ CascadeHashing::collect_top_ranked_candidates (
     }
 }
 
-SFM_NAMESPACE_END
+FEATURES_NAMESPACE_END
 
 #endif /* SFM_CASCADE_HASHING_HEADER */
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+
+#include "util/binary_io.h"
+#include "util/exception.h"
+#include "math/matrix_svd.h"
+#include "features/descriptor_pca.h"
+
+#define DESCRIPTOR_PCA_SIGNATURE "MVE_PCA\n"
+#define DESCRIPTOR_PCA_SIGNATURE_LEN 8
+
+FEATURES_NAMESPACE_BEGIN
+
+void
+DescriptorPca::compute (float const* vectors, int num_vectors, int dimensions)
+{
+    if (num_vectors < 2 || dimensions < 1)
+        throw std::invalid_argument("Too few vectors for PCA");
+
+    /* Mean and covariance matrix in double precision. */
+    int const dims = dimensions;
+    std::vector<double> mean(dims, 0.0);
+    std::vector<double> cov(dims * dims, 0.0);
+    for (int i = 0; i < num_vectors; ++i)
+    {
+        float const* vec = vectors + static_cast<std::size_t>(i) * dims;
+        for (int r = 0; r < dims; ++r)
+        {
+            mean[r] += vec[r];
+            for (int c = r; c < dims; ++c)
+                cov[r * dims + c] += static_cast<double>(vec[r]) * vec[c];
+        }
+    }
+    for (int r = 0; r < dims; ++r)
+        mean[r] /= num_vectors;
+    for (int r = 0; r < dims; ++r)
+        for (int c = r; c < dims; ++c)
+        {
+            double const value = cov[r * dims + c] / num_vectors
+                - mean[r] * mean[c];
+            cov[r * dims + c] = value;
+            cov[c * dims + r] = value;
+        }
+
+    /* For the symmetric covariance, the SVD is the eigen decomposition. */
+    std::vector<double> mat_u(dims * dims);
+    std::vector<double> vec_s(dims);
+    math::matrix_svd<double>(cov.data(), dims, dims,
+        mat_u.data(), vec_s.data(), nullptr);
+
+    std::vector<int> order(dims);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&vec_s] (int a, int b)
+        { return vec_s[a] > vec_s[b]; });
+
+    this->dimensions = dims;
+    this->axes.resize(dims * dims);
+    this->variances.resize(dims);
+    for (int i = 0; i < dims; ++i)
+    {
+        this->variances[i] = static_cast<float>(vec_s[order[i]]);
+        for (int j = 0; j < dims; ++j)
+            this->axes[i * dims + j]
+                = static_cast<float>(mat_u[j * dims + order[i]]);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+DescriptorPca::rotate (float const* vectors, int num_vectors,
+    float* result) const
+{
+    if (this->axes.empty())
+        throw std::runtime_error("PCA not computed");
+
+    int const dims = this->dimensions;
+    for (int i = 0; i < num_vectors; ++i)
+    {
+        float const* vec = vectors + static_cast<std::size_t>(i) * dims;
+        float* out = result + static_cast<std::size_t>(i) * dims;
+        for (int r = 0; r < dims; ++r)
+        {
+            float const* axis = &this->axes[r * dims];
+            float sum = 0.0f;
+            for (int c = 0; c < dims; ++c)
+                sum += axis[c] * vec[c];
+            out[r] = sum;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+DescriptorPca::project (float const* vectors, int num_vectors, int num_axes,
+    float* result) const
+{
+    if (this->axes.empty())
+        throw std::runtime_error("PCA not computed");
+    if (num_axes < 1 || num_axes > this->dimensions)
+        throw std::invalid_argument("Invalid number of axes");
+
+    int const dims = this->dimensions;
+    for (int i = 0; i < num_vectors; ++i)
+    {
+        float const* vec = vectors + static_cast<std::size_t>(i) * dims;
+        float* out = result + static_cast<std::size_t>(i) * num_axes;
+        float square_norm = 0.0f;
+        for (int r = 0; r < num_axes; ++r)
+        {
+            float const* axis = &this->axes[r * dims];
+            float sum = 0.0f;
+            for (int c = 0; c < dims; ++c)
+                sum += axis[c] * vec[c];
+            out[r] = sum;
+            square_norm += sum * sum;
+        }
+
+        if (square_norm <= 0.0f)
+            continue;
+        float const inv_norm = 1.0f / std::sqrt(square_norm);
+        for (int r = 0; r < num_axes; ++r)
+            out[r] *= inv_norm;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+DescriptorPca::save_to_file (std::string const& filename) const
+{
+    if (this->axes.empty())
+        throw std::runtime_error("PCA not computed");
+
+    util::BinaryWriter out(filename);
+    out.write(DESCRIPTOR_PCA_SIGNATURE, DESCRIPTOR_PCA_SIGNATURE_LEN);
+    out.write_value<std::int32_t>(this->dimensions);
+    out.write(this->variances.data(), this->variances.size() * sizeof(float));
+    out.write(this->axes.data(), this->axes.size() * sizeof(float));
+    out.close();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+DescriptorPca::load_from_file (std::string const& filename)
+{
+    util::BinaryReader in(filename);
+    char signature[DESCRIPTOR_PCA_SIGNATURE_LEN];
+    if (in.read(signature, DESCRIPTOR_PCA_SIGNATURE_LEN)
+        != DESCRIPTOR_PCA_SIGNATURE_LEN
+        || !std::equal(signature, signature + DESCRIPTOR_PCA_SIGNATURE_LEN,
+        DESCRIPTOR_PCA_SIGNATURE))
+        throw util::FileException(filename, "Invalid PCA file signature");
+
+    std::int32_t const dims = in.read_value<std::int32_t>();
+    if (dims < 1 || dims > 4096)
+        throw util::FileException(filename, "Invalid PCA dimensions");
+
+    std::vector<float> new_variances(dims);
+    std::vector<float> new_axes(dims * dims);
+    if (in.read_array(new_variances.data(), new_variances.size())
+        != new_variances.size()
+        || in.read_array(new_axes.data(), new_axes.size()) != new_axes.size())
+        throw util::FileException(filename, "Unexpected end of PCA file");
+
+    this->dimensions = dims;
+    this->variances.swap(new_variances);
+    this->axes.swap(new_axes);
+}
+
+FEATURES_NAMESPACE_END
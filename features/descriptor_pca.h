@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef FEATURES_DESCRIPTOR_PCA_HEADER
+#define FEATURES_DESCRIPTOR_PCA_HEADER
+
+#include <string>
+#include <vector>
+
+#include "features/defines.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+/**
+ * Principal component rotation of float descriptors.
+ *
+ * The rotation maps descriptors to the principal axes of a training set,
+ * ordered by decreasing variance. The rotation is orthogonal and the mean
+ * is not subtracted, so norms, inner products and distances are preserved
+ * and rotated descriptors can be matched like the original descriptors.
+ * Since most of the energy of the differences is in the first dimensions,
+ * searches with early termination reject candidates much earlier.
+ *
+ * Descriptors can also be projected to the first principal axes, e.g. 64
+ * or 32 of the 128 SIFT dimensions, which reduces matching cost and memory
+ * accordingly. Projected descriptors are normalized again, so they are
+ * matched with inner products and the ratio test as before. The axes are
+ * usually computed once offline from a large set of descriptors and saved.
+ */
+class DescriptorPca
+{
+public:
+    DescriptorPca (void);
+
+    /** Computes the principal axes from the given vectors. */
+    void compute (float const* vectors, int num_vectors, int dimensions);
+
+    /** Rotates the vectors, 'result' must have space for all vectors. */
+    void rotate (float const* vectors, int num_vectors, float* result) const;
+
+    /**
+     * Projects the vectors to the first 'num_axes' principal axes and
+     * normalizes them to unit length. 'result' must have space for
+     * 'num_axes' values per vector.
+     */
+    void project (float const* vectors, int num_vectors, int num_axes,
+        float* result) const;
+
+    /** Saves the principal axes, throws util::FileException on error. */
+    void save_to_file (std::string const& filename) const;
+    /** Loads the principal axes, throws util::FileException on error. */
+    void load_from_file (std::string const& filename);
+
+    /** Returns the principal axes as rows of a row-major matrix. */
+    std::vector<float> const& get_axes (void) const;
+
+    /** Returns the variances along the axes in decreasing order. */
+    std::vector<float> const& get_variances (void) const;
+
+    int get_dimensions (void) const;
+
+private:
+    int dimensions;
+    /** The principal axes as rows of a row-major matrix. */
+    std::vector<float> axes;
+    std::vector<float> variances;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+DescriptorPca::DescriptorPca (void)
+    : dimensions(0)
+{
+}
+
+inline std::vector<float> const&
+DescriptorPca::get_variances (void) const
+{
+    return this->variances;
+}
+
+inline std::vector<float> const&
+DescriptorPca::get_axes (void) const
+{
+    return this->axes;
+}
+
+inline int
+DescriptorPca::get_dimensions (void) const
+{
+    return this->dimensions;
+}
+
+FEATURES_NAMESPACE_END
+
+#endif /* FEATURES_DESCRIPTOR_PCA_HEADER */
@@ -7,6 +7,11 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "util/thread_pool.h"
 #include "features/exhaustive_matching.h"
 
 FEATURES_NAMESPACE_BEGIN
@@ -37,7 +42,25 @@ namespace
             data[i] = static_cast<signed char>(value);
         }
     }
+
+    /* Projected descriptors are unit vectors like SURF descriptors. */
+    void
+    convert_pca_values (float const* values, int num, signed short* data)
+    {
+        for (int i = 0; i < num; ++i)
+        {
+            float value = math::clamp(values[i], -1.0f, 1.0f);
+            value = math::round(value * 127.0f);
+            data[i] = static_cast<signed char>(value);
+        }
+    }
 #else // DISCRETIZE_DESCRIPTORS
+    void
+    convert_pca_values (float const* values, int num, float* data)
+    {
+        std::copy(values, values + num, data);
+    }
+
     void
     convert_descriptor (Sift::Descriptor const& descr, float* data)
     {
@@ -55,18 +78,39 @@ namespace
 void
 ExhaustiveMatching::init (bundler::ViewportList* viewports)
 {
+    DescriptorPca const* pca = this->opts.sift_pca.get();
+    if (pca != nullptr && (pca->get_dimensions() != 128
+        || this->opts.sift_pca_dimensions < 1
+        || this->opts.sift_pca_dimensions > 128))
+        throw std::invalid_argument("Invalid SIFT PCA dimensions");
+
     this->processed_feature_sets.clear();
     this->processed_feature_sets.resize(viewports->size());
 
-#pragma omp parallel for schedule(dynamic)
-    for (size_t i = 0; i < viewports->size(); i++)
+    util::parallel_for(0, viewports->size(),
+        [this, viewports] (std::size_t i)
     {
-        FeatureSet const& fs = (*viewports)[i].features;
-        ProcessedFeatureSet& pfs = this->processed_feature_sets[i];
+        /* Not virtual, subclasses may not support single views. */
+        this->ExhaustiveMatching::init_view(*viewports, static_cast<int>(i));
+    });
+}
+
+void
+ExhaustiveMatching::init_view (bundler::ViewportList const& viewports,
+    int view_id)
+{
+    if (view_id < 0 || static_cast<std::size_t>(view_id)
+        >= this->processed_feature_sets.size()
+        || this->processed_feature_sets.size() != viewports.size())
+        throw std::invalid_argument("Invalid view ID");
 
+    FeatureSet const& fs = viewports[view_id].features;
+    ProcessedFeatureSet& pfs = this->processed_feature_sets[view_id];
+    if (this->opts.sift_pca != nullptr)
+        this->init_sift_pca(&pfs.sift_pca_descr, fs.sift_descriptors);
+    else
         this->init_sift(&pfs.sift_descr, fs.sift_descriptors);
-        this->init_surf(&pfs.surf_descr, fs.surf_descriptors);
-    }
+    this->init_surf(&pfs.surf_descr, fs.surf_descriptors);
 }
 
 void
@@ -88,6 +132,30 @@ ExhaustiveMatching::init_sift (SiftDescriptors* dst,
     }
 }
 
+void
+ExhaustiveMatching::init_sift_pca (PcaDescriptors* dst,
+    Sift::Descriptors const& src)
+{
+    int const num_axes = this->opts.sift_pca_dimensions;
+    dst->resize(src.size() * num_axes);
+
+    /* Descriptors are projected in chunks to bound the temporary memory. */
+    std::size_t const chunk_size = 1024;
+    std::vector<float> values(chunk_size * 128);
+    std::vector<float> projected(chunk_size * num_axes);
+    for (std::size_t first = 0; first < src.size(); first += chunk_size)
+    {
+        std::size_t const num = std::min(chunk_size, src.size() - first);
+        for (std::size_t i = 0; i < num; ++i)
+            std::copy(src[first + i].data.begin(), src[first + i].data.end(),
+                &values[i * 128]);
+        this->opts.sift_pca->project(values.data(), static_cast<int>(num),
+            num_axes, projected.data());
+        convert_pca_values(projected.data(), static_cast<int>(num) * num_axes,
+            dst->data() + first * num_axes);
+    }
+}
+
 void
 ExhaustiveMatching::init_surf (SurfDescriptors* dst,
     Surf::Descriptors const& src)
@@ -116,12 +184,10 @@ ExhaustiveMatching::pairwise_match (int view_1_id, int view_2_id,
 
     /* SIFT matching. */
     Matching::Result sift_result;
-    if (pfs_1.sift_descr.size() > 0)
+    if (this->get_num_sift(pfs_1) > 0)
     {
-        Matching::twoway_match(this->opts.sift_matching_opts,
-            pfs_1.sift_descr.data()->begin(), pfs_1.sift_descr.size(),
-            pfs_2.sift_descr.data()->begin(), pfs_2.sift_descr.size(),
-            &sift_result);
+        this->match_sift(pfs_1, pfs_2,
+            std::numeric_limits<std::size_t>::max(), &sift_result);
         Matching::remove_inconsistent_matches(&sift_result);
     }
 
@@ -147,15 +213,10 @@ ExhaustiveMatching::pairwise_match_lowres (int view_1_id, int view_2_id,
     ProcessedFeatureSet const& pfs_2 = this->processed_feature_sets[view_2_id];
 
     /* SIFT lowres matching. */
-    if (pfs_1.sift_descr.size() > 0)
+    if (this->get_num_sift(pfs_1) > 0)
     {
         Matching::Result sift_result;
-        Matching::twoway_match(this->opts.sift_matching_opts,
-            pfs_1.sift_descr.data()->begin(),
-            std::min(num_features, pfs_1.sift_descr.size()),
-            pfs_2.sift_descr.data()->begin(),
-            std::min(num_features, pfs_2.sift_descr.size()),
-            &sift_result);
+        this->match_sift(pfs_1, pfs_2, num_features, &sift_result);
         return Matching::count_consistent_matches(sift_result);
     }
 
@@ -175,5 +236,35 @@ ExhaustiveMatching::pairwise_match_lowres (int view_1_id, int view_2_id,
     return 0;
 }
 
+void
+ExhaustiveMatching::match_sift (ProcessedFeatureSet const& pfs_1,
+    ProcessedFeatureSet const& pfs_2, std::size_t num_features,
+    Matching::Result* result) const
+{
+    std::size_t const num_1 = std::min(num_features, this->get_num_sift(pfs_1));
+    std::size_t const num_2 = std::min(num_features, this->get_num_sift(pfs_2));
+    if (this->opts.sift_pca == nullptr)
+    {
+        Matching::twoway_match(this->opts.sift_matching_opts,
+            pfs_1.sift_descr.data()->begin(), num_1,
+            pfs_2.sift_descr.data()->begin(), num_2, result);
+        return;
+    }
+
+    /* Projected descriptors use the SIFT thresholds with fewer values. */
+    Matching::Options pca_opts = this->opts.sift_matching_opts;
+    pca_opts.descriptor_length = this->opts.sift_pca_dimensions;
+    Matching::twoway_match(pca_opts, pfs_1.sift_pca_descr.data(), num_1,
+        pfs_2.sift_pca_descr.data(), num_2, result);
+}
+
+std::size_t
+ExhaustiveMatching::get_num_sift (ProcessedFeatureSet const& pfs) const
+{
+    if (this->opts.sift_pca == nullptr)
+        return pfs.sift_descr.size();
+    return pfs.sift_pca_descr.size() / this->opts.sift_pca_dimensions;
+}
+
 FEATURES_NAMESPACE_END
 
@@ -30,6 +30,10 @@ public:
     /** Initialize matcher by preprocessing given SIFT/SURF features. */
     void init (sfm::bundler::ViewportList* viewports) override;
 
+    /** Preprocesses the features of one view again. */
+    void init_view (sfm::bundler::ViewportList const& viewports,
+        int view_id) override;
+
     /** Matches all feature types yielding a single matching result. */
     void pairwise_match (int view_1_id, int view_2_id,
         Matching::Result* result) const override;
@@ -46,22 +50,38 @@ protected:
 #if DISCRETIZE_DESCRIPTORS
     typedef util::AlignedMemory<math::Vec128us, 16> SiftDescriptors;
     typedef util::AlignedMemory<math::Vec64s, 16> SurfDescriptors;
+    typedef util::AlignedMemory<int16_t, 16> PcaDescriptors;
 #else
     typedef util::AlignedMemory<math::Vec128f, 16> SiftDescriptors;
     typedef util::AlignedMemory<math::Vec64f, 16> SurfDescriptors;
+    typedef util::AlignedMemory<float, 16> PcaDescriptors;
 #endif
 
     /** Internal initialization methods for SIFT/SURF features. */
     void init_sift (SiftDescriptors* dst, Sift::Descriptors const& src);
+    void init_sift_pca (PcaDescriptors* dst, Sift::Descriptors const& src);
     void init_surf (SurfDescriptors* dst, Surf::Descriptors const& src);
 
+    /**
+     * Per-view descriptors of the matcher. With a SIFT PCA, the projected
+     * descriptors replace the SIFT descriptors, which are empty.
+     */
     struct ProcessedFeatureSet
     {
         SiftDescriptors sift_descr;
+        PcaDescriptors sift_pca_descr;
         SurfDescriptors surf_descr;
     };
 
-    // todo 每个视角对应一个ProcessedFeatureSet
+    /** Matches the SIFT descriptors, considering at most num_features. */
+    void match_sift (ProcessedFeatureSet const& pfs_1,
+        ProcessedFeatureSet const& pfs_2, std::size_t num_features,
+        Matching::Result* result) const;
+
+    /** Returns the number of SIFT descriptors of a view. */
+    std::size_t get_num_sift (ProcessedFeatureSet const& pfs) const;
+
+        // todo 每个视角对应一个ProcessedFeatureSet
     typedef std::vector<ProcessedFeatureSet> ProcessedFeatureSets;
     ProcessedFeatureSets processed_feature_sets;
 };
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "features/kd_forest.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Number of elements used to estimate the variance of a node. */
+    int const KD_VARIANCE_SAMPLES = 128;
+
+    /* Independent partial sums allow the compiler to pipeline the loop. */
+    float
+    square_distance (float const* a, float const* b, int dimensions)
+    {
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        int i = 0;
+        for (; i + 4 <= dimensions; i += 4)
+            for (int j = 0; j < 4; ++j)
+            {
+                float const diff = a[i + j] - b[i + j];
+                sum[j] += diff * diff;
+            }
+        for (; i < dimensions; ++i)
+        {
+            float const diff = a[i] - b[i];
+            sum[0] += diff * diff;
+        }
+        return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+struct KdForest::SearchState
+{
+    float const* query;
+    Result* result;
+    int num_checks;
+    /* Elements are visited once per query, even if found in many trees. */
+    std::vector<int> visited;
+    int stamp;
+    std::vector<Branch> branches;
+};
+
+/* ---------------------------------------------------------------- */
+
+KdForest::KdForest (Options const& options)
+    : opts(options)
+    , elements(nullptr)
+    , num_elements(0)
+    , dimensions(0)
+{
+    if (this->opts.num_trees < 1 || this->opts.max_leaf_size < 1
+        || this->opts.num_candidate_dimensions < 1)
+        throw std::invalid_argument("Invalid KD-forest options");
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+KdForest::build (float const* elements, int num_elements, int dimensions)
+{
+    if (elements == nullptr && num_elements > 0)
+        throw std::invalid_argument("Elements must not be null");
+    if (dimensions < 1)
+        throw std::invalid_argument("Invalid element dimensions");
+
+    this->elements = elements;
+    this->num_elements = num_elements;
+    this->dimensions = dimensions;
+    this->trees.clear();
+    this->trees.resize(this->opts.num_trees);
+    for (int i = 0; i < this->opts.num_trees; ++i)
+    {
+        Tree& tree = this->trees[i];
+        tree.indices.resize(num_elements);
+        std::iota(tree.indices.begin(), tree.indices.end(), 0);
+        std::mt19937 prng(this->opts.seed + static_cast<unsigned int>(i));
+        this->build_node(&tree, 0, num_elements, &prng);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+KdForest::build_node (Tree* tree, int begin, int end, std::mt19937* prng)
+{
+    int const node_id = static_cast<int>(tree->nodes.size());
+    tree->nodes.push_back(Node());
+    if (end - begin <= this->opts.max_leaf_size)
+    {
+        Node& node = tree->nodes[node_id];
+        node.split_dim = -1;
+        node.split_value = 0.0f;
+        node.first = begin;
+        node.second = end;
+        return node_id;
+    }
+
+    /* Estimate mean and variance from a regular subsample. */
+    int const dims = this->dimensions;
+    int const step = std::max(1, (end - begin) / KD_VARIANCE_SAMPLES);
+    std::vector<double> mean(dims, 0.0);
+    std::vector<double> variance(dims, 0.0);
+    int num_samples = 0;
+    for (int i = begin; i < end; i += step, ++num_samples)
+    {
+        float const* elem = this->elements
+            + static_cast<std::size_t>(tree->indices[i]) * dims;
+        for (int d = 0; d < dims; ++d)
+        {
+            mean[d] += elem[d];
+            variance[d] += static_cast<double>(elem[d]) * elem[d];
+        }
+    }
+    for (int d = 0; d < dims; ++d)
+    {
+        mean[d] /= num_samples;
+        variance[d] = variance[d] / num_samples - mean[d] * mean[d];
+    }
+
+    /* Randomly select one of the dimensions with the largest variance. */
+    int const num_candidates = std::min(dims,
+        this->opts.num_candidate_dimensions);
+    std::vector<int> order(dims);
+    std::iota(order.begin(), order.end(), 0);
+    std::partial_sort(order.begin(), order.begin() + num_candidates,
+        order.end(), [&variance] (int a, int b)
+        { return variance[a] > variance[b]; });
+    std::uniform_int_distribution<int> dist(0, num_candidates - 1);
+    int const split_dim = order[dist(*prng)];
+    float const split_value = static_cast<float>(mean[split_dim]);
+
+    float const* elems = this->elements;
+    int* middle = std::partition(tree->indices.data() + begin,
+        tree->indices.data() + end, [elems, dims, split_dim, split_value]
+        (int idx) { return elems[static_cast<std::size_t>(idx) * dims
+        + split_dim] < split_value; });
+    int split = static_cast<int>(middle - tree->indices.data());
+    /* Degenerate splits of identical values are split in half. */
+    if (split == begin || split == end)
+        split = begin + (end - begin) / 2;
+
+    int const first = this->build_node(tree, begin, split, prng);
+    int const second = this->build_node(tree, split, end, prng);
+    Node& node = tree->nodes[node_id];
+    node.split_dim = split_dim;
+    node.split_value = split_value;
+    node.first = first;
+    node.second = second;
+    return node_id;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+KdForest::search_tree (Tree const& tree, int tree_id, int node_id,
+    float distance, SearchState* state) const
+{
+    /* Descend to the closest leaf, remember the other branches. */
+    Result* result = state->result;
+    while (tree.nodes[node_id].split_dim >= 0)
+    {
+        Node const& node = tree.nodes[node_id];
+        float const diff = state->query[node.split_dim] - node.split_value;
+        float const branch_dist = distance + diff * diff;
+        int const near_id = diff < 0.0f ? node.first : node.second;
+        int const far_id = diff < 0.0f ? node.second : node.first;
+        if (branch_dist < result->dist_2nd_best)
+        {
+            Branch branch;
+            branch.distance = branch_dist;
+            branch.tree = tree_id;
+            branch.node = far_id;
+            state->branches.push_back(branch);
+            std::push_heap(state->branches.begin(), state->branches.end());
+        }
+        node_id = near_id;
+    }
+
+    Node const& leaf = tree.nodes[node_id];
+    for (int i = leaf.first; i < leaf.second; ++i)
+    {
+        int const index = tree.indices[i];
+        if (state->visited[index] == state->stamp)
+            continue;
+        state->visited[index] = state->stamp;
+        state->num_checks += 1;
+
+        float const dist = square_distance(state->query, this->elements
+            + static_cast<std::size_t>(index) * this->dimensions,
+            this->dimensions);
+        if (dist < result->dist_1st_best)
+        {
+            result->dist_2nd_best = result->dist_1st_best;
+            result->index_2nd_best = result->index_1st_best;
+            result->dist_1st_best = dist;
+            result->index_1st_best = index;
+        }
+        else if (dist < result->dist_2nd_best)
+        {
+            result->dist_2nd_best = dist;
+            result->index_2nd_best = index;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+KdForest::find (float const* queries, int num_queries, int num_checks,
+    Result* results) const
+{
+    SearchState state;
+    state.visited.resize(this->num_elements, -1);
+    for (int i = 0; i < num_queries; ++i)
+    {
+        Result& result = results[i];
+        result.dist_1st_best = std::numeric_limits<float>::max();
+        result.dist_2nd_best = std::numeric_limits<float>::max();
+        result.index_1st_best = -1;
+        result.index_2nd_best = -1;
+        if (this->num_elements == 0)
+            continue;
+
+        state.query = queries + static_cast<std::size_t>(i) * this->dimensions;
+        state.result = &result;
+        state.num_checks = 0;
+        state.stamp = i;
+        state.branches.clear();
+
+        /* The closest leaf of every tree is always searched. */
+        for (std::size_t t = 0; t < this->trees.size(); ++t)
+            this->search_tree(this->trees[t], static_cast<int>(t), 0,
+                0.0f, &state);
+
+        while (!state.branches.empty() && state.num_checks < num_checks)
+        {
+            std::pop_heap(state.branches.begin(), state.branches.end());
+            Branch const branch = state.branches.back();
+            state.branches.pop_back();
+            if (branch.distance >= result.dist_2nd_best)
+                break;
+            this->search_tree(this->trees[branch.tree], branch.tree,
+                branch.node, branch.distance, &state);
+        }
+    }
+}
+
+FEATURES_NAMESPACE_END
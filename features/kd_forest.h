@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef FEATURES_KD_FOREST_HEADER
+#define FEATURES_KD_FOREST_HEADER
+
+#include <random>
+#include <vector>
+
+#include "features/defines.h"
+#include "features/nearest_neighbor.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+/**
+ * Approximate nearest (and second nearest) neighbor search for float
+ * vectors with a forest of randomized KD-trees.
+ *
+ * Each tree splits at the mean of a dimension that is randomly chosen
+ * among the dimensions with the largest variance. A query descends all
+ * trees and then explores the remaining branches of all trees in order of
+ * their distance to the query using a single priority queue. The search
+ * stops after 'num_checks' elements have been compared, which trades
+ * accuracy for speed. Results are squared Euclidean distances, which
+ * equal the distances of NearestNeighbor<float> for normalized vectors.
+ *
+ * References:
+ * - "Optimised KD-trees for fast image descriptor matching",
+ *   C. Silpa-Anan and R. Hartley, CVPR 2008.
+ * - "Fast Approximate Nearest Neighbors with Automatic Algorithm
+ *   Configuration", M. Muja and D. Lowe, VISAPP 2009.
+ */
+class KdForest
+{
+public:
+    typedef NearestNeighbor<float>::Result Result;
+
+    struct Options
+    {
+        Options (void);
+
+        /** The number of randomized trees. */
+        int num_trees;
+
+        /** Maximum number of elements in a leaf node. */
+        int max_leaf_size;
+
+        /** The split dimension is chosen among this many top dimensions. */
+        int num_candidate_dimensions;
+
+        /** Seed for the random split dimensions. */
+        unsigned int seed;
+    };
+
+public:
+    explicit KdForest (Options const& options);
+
+    /**
+     * Builds the trees over the given elements. The elements are not
+     * copied and must outlive the forest.
+     */
+    void build (float const* elements, int num_elements, int dimensions);
+
+    /** Finds the approximate nearest neighbors of 'query'. */
+    void find (float const* query, int num_checks, Result* result) const;
+
+    /** Finds the approximate nearest neighbors of consecutive queries. */
+    void find (float const* queries, int num_queries, int num_checks,
+        Result* results) const;
+
+private:
+    struct Node
+    {
+        /** The split dimension, or -1 for leaf nodes. */
+        int split_dim;
+        float split_value;
+        /** Child node indices, or the element range for leafs. */
+        int first;
+        int second;
+    };
+
+    struct Tree
+    {
+        std::vector<Node> nodes;
+        std::vector<int> indices;
+    };
+
+    struct Branch
+    {
+        float distance;
+        int tree;
+        int node;
+
+        bool operator< (Branch const& rhs) const;
+    };
+
+    struct SearchState;
+
+    int build_node (Tree* tree, int begin, int end, std::mt19937* prng);
+    void search_tree (Tree const& tree, int tree_id, int node_id,
+        float distance, SearchState* state) const;
+
+private:
+    Options opts;
+    float const* elements;
+    int num_elements;
+    int dimensions;
+    std::vector<Tree> trees;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+KdForest::Options::Options (void)
+    : num_trees(4)
+    , max_leaf_size(8)
+    , num_candidate_dimensions(5)
+    , seed(0)
+{
+}
+
+/* The priority queue is a max-heap, closest branches come first. */
+inline bool
+KdForest::Branch::operator< (Branch const& rhs) const
+{
+    return this->distance > rhs.distance;
+}
+
+inline void
+KdForest::find (float const* query, int num_checks, Result* result) const
+{
+    this->find(query, 1, num_checks, result);
+}
+
+FEATURES_NAMESPACE_END
+
+#endif /* FEATURES_KD_FOREST_HEADER */
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "util/profiler.h"
+#include "math/defines.h"
+#include "core/image_tools.h"
+#include "features/klt_tracker.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+namespace
+{
+    /*
+     * Samples the square window of the given radius around (x, y) with
+     * bilinear interpolation. All samples share the interpolation weights,
+     * pixels outside the image are clamped to the border.
+     */
+    void
+    sample_window (core::FloatImage const& image, float x, float y,
+        int radius, float* values)
+    {
+        int const width = image.width();
+        int const height = image.height();
+        float const floor_x = std::floor(x);
+        float const floor_y = std::floor(y);
+        float const wx = x - floor_x;
+        float const wy = y - floor_y;
+        int const x0 = static_cast<int>(floor_x) - radius;
+        int const y0 = static_cast<int>(floor_y) - radius;
+        int const size = 2 * radius + 1;
+
+        float const* data = image.get_data_pointer();
+        for (int j = 0; j < size; ++j)
+        {
+            float const* row1 = data + width
+                * std::max(0, std::min(height - 1, y0 + j));
+            float const* row2 = data + width
+                * std::max(0, std::min(height - 1, y0 + j + 1));
+            for (int i = 0; i < size; ++i, ++values)
+            {
+                int const col1 = std::max(0, std::min(width - 1, x0 + i));
+                int const col2 = std::max(0, std::min(width - 1, x0 + i + 1));
+                *values = (1.0f - wy) * ((1.0f - wx) * row1[col1]
+                    + wx * row1[col2]) + wy * ((1.0f - wx) * row2[col1]
+                    + wx * row2[col2]);
+            }
+        }
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+KltTracker::set_image (core::ByteImage::ConstPtr img)
+{
+    if (img->channels() != 1 && img->channels() != 3)
+        throw std::invalid_argument("Gray or color image expected");
+
+    this->build_pyramid(core::image::byte_to_float_grayscale
+        (img, core::image::DESATURATE_AVERAGE));
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+KltTracker::set_float_image (core::FloatImage::ConstPtr img)
+{
+    if (img->channels() != 1 && img->channels() != 3)
+        throw std::invalid_argument("Gray or color image expected");
+
+    if (img->channels() == 3)
+        this->build_pyramid(core::image::desaturate<float>
+            (img, core::image::DESATURATE_AVERAGE));
+    else
+        this->build_pyramid(img->duplicate());
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+KltTracker::build_pyramid (core::FloatImage::Ptr image)
+{
+    UTIL_PROFILE_SCOPE("KltTracker::build_pyramid");
+
+    /* The levels of the old previous frame are reused as storage. */
+    std::swap(this->previous, this->current);
+    this->current.resize(std::max(1, this->opts.num_levels));
+    this->current[0] = image;
+
+    /* Levels smaller than the tracking window are not created. */
+    int const min_size = 2 * this->opts.window_radius + 1;
+    for (std::size_t i = 1; i < this->current.size(); ++i)
+    {
+        core::FloatImage::ConstPtr level = this->current[i - 1];
+        if (level->width() / 2 < min_size || level->height() / 2 < min_size)
+        {
+            this->current.resize(i);
+            break;
+        }
+
+        /* Levels shared with an image pyramid are not reused as storage. */
+        core::FloatImage::Ptr out;
+        if (this->current[i] != nullptr && this->current[i].use_count() == 1)
+            out = std::const_pointer_cast<core::FloatImage>(this->current[i]);
+        else
+            out = core::FloatImage::create();
+        core::image::rescale_half_size_gaussian<float>(level, out);
+        this->current[i] = out;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+KltTracker::set_pyramid (core::ImagePyramid::ConstPtr pyramid)
+{
+    if (pyramid->get_type() != core::IMAGE_TYPE_FLOAT
+        || pyramid->get_float_level(0)->channels() != 1)
+        throw std::invalid_argument("Gray float pyramid expected");
+
+    std::swap(this->previous, this->current);
+    this->current.clear();
+
+    /* The same levels as build_pyramid(), the pyramid uses the same blur. */
+    int const min_size = 2 * this->opts.window_radius + 1;
+    int const num_levels = std::min(std::max(1, this->opts.num_levels),
+        pyramid->get_num_levels());
+    this->current.push_back(pyramid->get_float_level(0));
+    for (int i = 1; i < num_levels; ++i)
+    {
+        if (pyramid->get_width(i - 1) / 2 < min_size
+            || pyramid->get_height(i - 1) / 2 < min_size)
+            break;
+        this->current.push_back(pyramid->get_float_level(i));
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+KltTracker::track (Points const& points, Points* tracked,
+    std::vector<bool>* status) const
+{
+    UTIL_PROFILE_SCOPE("KltTracker::track");
+    if (this->previous.empty() || this->current.empty())
+        throw std::runtime_error("Two frames required for tracking");
+    if (this->previous[0]->width() != this->current[0]->width()
+        || this->previous[0]->height() != this->current[0]->height())
+        throw std::invalid_argument("Frames of different size");
+
+    std::int64_t const num_points = static_cast<std::int64_t>(points.size());
+    std::vector<char> valid(points.size(), 0);
+    tracked->resize(points.size());
+#pragma omp parallel for schedule(dynamic, 16)
+    for (std::int64_t i = 0; i < num_points; ++i)
+        valid[i] = this->track_point(points[i], &tracked->at(i));
+
+    std::size_t num_tracked = 0;
+    status->resize(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        status->at(i) = valid[i] != 0;
+        num_tracked += valid[i] != 0;
+    }
+    return num_tracked;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+KltTracker::track_point (math::Vec2f const& point, math::Vec2f* result) const
+{
+    int const radius = this->opts.window_radius;
+    int const size = 2 * radius + 1;
+    int const num_pixels = size * size;
+    int const num_levels = static_cast<int>(std::min(this->previous.size(),
+        this->current.size()));
+
+    /* The previous window has a border of one pixel for the gradients. */
+    std::vector<float> border_patch((size + 2) * (size + 2));
+    std::vector<float> patch(num_pixels);
+    std::vector<float> grad_x(num_pixels);
+    std::vector<float> grad_y(num_pixels);
+    std::vector<float> window(num_pixels);
+
+    /* The guess is the flow of the coarser levels, scaled to the level. */
+    math::Vec2f guess(0.0f);
+    math::Vec2f flow(0.0f);
+    for (int level = num_levels - 1; level >= 0; --level)
+    {
+        core::FloatImage const& prev = *this->previous[level];
+        core::FloatImage const& cur = *this->current[level];
+        math::Vec2f const pos = point / static_cast<float>(1 << level);
+
+        /* Window and gradients in the previous frame, and the tensor. */
+        sample_window(prev, pos[0], pos[1], radius + 1, &border_patch[0]);
+        double gxx = 0.0, gxy = 0.0, gyy = 0.0;
+        for (int y = 0, i = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x, ++i)
+            {
+                float const* center = &border_patch[(y + 1) * (size + 2)
+                    + x + 1];
+                patch[i] = center[0];
+                grad_x[i] = 0.5f * (center[1] - center[-1]);
+                grad_y[i] = 0.5f * (center[size + 2] - center[-size - 2]);
+                gxx += grad_x[i] * grad_x[i];
+                gxy += grad_x[i] * grad_y[i];
+                gyy += grad_y[i] * grad_y[i];
+            }
+
+        /*
+         * Points without texture are rejected at the finest level. Coarse
+         * levels can be too blurred, their flow is skipped instead.
+         */
+        double const min_eigenvalue = (gxx + gyy - std::sqrt(
+            MATH_POW2(gxx - gyy) + 4.0 * MATH_POW2(gxy))) / 2.0;
+        bool const textured = min_eigenvalue
+            >= this->opts.min_eigenvalue * num_pixels;
+        if (level == 0 && !textured)
+            return false;
+        double const det = gxx * gyy - gxy * gxy;
+
+        /* Gauss-Newton iterations on the displacement at this level. */
+        flow.fill(0.0f);
+        for (int iter = 0; textured && iter < this->opts.max_iterations;
+            ++iter)
+        {
+            math::Vec2f const target = pos + guess + flow;
+            sample_window(cur, target[0], target[1], radius, &window[0]);
+            double bx = 0.0, by = 0.0;
+            for (int i = 0; i < num_pixels; ++i)
+            {
+                float const diff = patch[i] - window[i];
+                bx += diff * grad_x[i];
+                by += diff * grad_y[i];
+            }
+
+            float const dx = static_cast<float>((gyy * bx - gxy * by) / det);
+            float const dy = static_cast<float>((gxx * by - gxy * bx) / det);
+            flow[0] += dx;
+            flow[1] += dy;
+            if (MATH_POW2(dx) + MATH_POW2(dy)
+                < MATH_POW2(this->opts.min_update))
+                break;
+        }
+
+        if (level > 0)
+            guess = (guess + flow) * 2.0f;
+    }
+    *result = point + guess + flow;
+
+    /* Reject points that left the image or changed their appearance. */
+    core::FloatImage const& cur = *this->current[0];
+    if (!std::isfinite((*result)[0]) || !std::isfinite((*result)[1])
+        || (*result)[0] < 0.0f || (*result)[1] < 0.0f
+        || (*result)[0] > static_cast<float>(cur.width() - 1)
+        || (*result)[1] > static_cast<float>(cur.height() - 1))
+        return false;
+
+    sample_window(cur, (*result)[0], (*result)[1], radius, &window[0]);
+    float residual = 0.0f;
+    for (int i = 0; i < num_pixels; ++i)
+        residual += std::abs(patch[i] - window[i]);
+    return residual <= this->opts.max_residual * num_pixels;
+}
+
+FEATURES_NAMESPACE_END
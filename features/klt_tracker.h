@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef FEATURES_KLT_TRACKER_HEADER
+#define FEATURES_KLT_TRACKER_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "math/vector.h"
+#include "core/image.h"
+#include "core/image_pyramid.h"
+#include "features/defines.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+/**
+ * Pyramidal Lucas-Kanade (KLT) tracking of points between adjacent frames.
+ *
+ * For dense video, detecting SIFT features in every frame is wasteful
+ * since consecutive frames barely differ. Instead, SIFT is only run on
+ * keyframes, and the keypoints are tracked into the following frames,
+ * which is much cheaper. Every frame is set with set_image(), which keeps
+ * the pyramid of the previous frame, and track() finds the points of the
+ * previous frame in the current one. The displacement is estimated from
+ * coarse to fine over Gaussian pyramids to follow large motions. Points
+ * without texture, with a large intensity residual, or leaving the image
+ * are lost. needs_keyframe() decides when features should be re-detected.
+ */
+class KltTracker
+{
+public:
+    /** Options for KLT tracking. */
+    struct Options
+    {
+        Options (void);
+
+        /**
+         * Number of pyramid levels, each of half size. Motions up to about
+         * window_radius * 2^(num_levels - 1) pixels are tracked.
+         * Defaults to 3.
+         */
+        int num_levels;
+
+        /** Radius of the square tracking window. Defaults to 7. */
+        int window_radius;
+
+        /** Maximum number of iterations per level. Defaults to 20. */
+        int max_iterations;
+
+        /** Minimum update in pixels to continue. Defaults to 0.01. */
+        float min_update;
+
+        /**
+         * Minimum smaller eigenvalue of the structure tensor of the
+         * window, per pixel and for intensities in [0, 1]. Rejects points
+         * without texture. Defaults to 1e-4.
+         */
+        float min_eigenvalue;
+
+        /**
+         * Maximum mean absolute intensity difference of the tracked
+         * window, for intensities in [0, 1]. Defaults to 0.05.
+         */
+        float max_residual;
+
+        /** Maximum number of frames between keyframes. Defaults to 10. */
+        int max_keyframe_interval;
+
+        /**
+         * A keyframe is needed if less than this ratio of the keyframe
+         * points are tracked. Defaults to 0.5.
+         */
+        float min_track_ratio;
+    };
+
+    typedef std::vector<math::Vec2f> Points;
+
+public:
+    explicit KltTracker (Options const& options);
+
+    /** Sets the next frame, the current frame becomes the previous one. */
+    void set_image (core::ByteImage::ConstPtr img);
+    /** Sets the next frame from a float image with values in [0, 1]. */
+    void set_float_image (core::FloatImage::ConstPtr img);
+    /**
+     * Sets the next frame from the pyramid of a gray float image with
+     * values in [0, 1], e.g. of View::get_image_pyramid(). The levels are
+     * shared instead of computed.
+     */
+    void set_pyramid (core::ImagePyramid::ConstPtr pyramid);
+
+    /**
+     * Tracks the points of the previous frame into the current frame. The
+     * status of lost points is false. Returns the number of tracked points.
+     */
+    std::size_t track (Points const& points, Points* tracked,
+        std::vector<bool>* status) const;
+
+    /**
+     * Returns whether features should be re-detected in the current frame,
+     * given the number of tracked points, the number of points of the last
+     * keyframe, and the number of frames since the last keyframe.
+     */
+    bool needs_keyframe (std::size_t num_tracked,
+        std::size_t num_keyframe_points, int num_frames) const;
+
+private:
+    typedef std::vector<core::FloatImage::ConstPtr> Pyramid;
+
+    void build_pyramid (core::FloatImage::Ptr image);
+    bool track_point (math::Vec2f const& point, math::Vec2f* result) const;
+
+private:
+    Options opts;
+    Pyramid previous;
+    Pyramid current;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+KltTracker::Options::Options (void)
+    : num_levels(3)
+    , window_radius(7)
+    , max_iterations(20)
+    , min_update(0.01f)
+    , min_eigenvalue(1e-4f)
+    , max_residual(0.05f)
+    , max_keyframe_interval(10)
+    , min_track_ratio(0.5f)
+{
+}
+
+inline
+KltTracker::KltTracker (Options const& options)
+    : opts(options)
+{
+}
+
+inline bool
+KltTracker::needs_keyframe (std::size_t num_tracked,
+    std::size_t num_keyframe_points, int num_frames) const
+{
+    return num_frames >= this->opts.max_keyframe_interval
+        || static_cast<float>(num_tracked) < this->opts.min_track_ratio
+        * static_cast<float>(num_keyframe_points);
+}
+
+FEATURES_NAMESPACE_END
+
+#endif /* FEATURES_KLT_TRACKER_HEADER */
@@ -10,11 +10,51 @@
 #include <iostream>
 
 #include "math/algo.h"
+#include "features/kd_forest.h"
 #include "features/nearest_neighbor.h"
 #include "features/matching.h"
 
 FEATURES_NAMESPACE_BEGIN
 
+void
+Matching::find_nearest_neighbors (Options const& options,
+    float const* set_1, int set_1_size,
+    float const* set_2, int set_2_size,
+    NearestNeighbor<float>::Result* results)
+{
+    if (options.kd_forest_checks <= 0)
+    {
+        Matching::find_nearest_neighbors<float>(options,
+            set_1, set_1_size, set_2, set_2_size, results);
+        return;
+    }
+
+    KdForest forest((KdForest::Options()));
+    forest.build(set_2, set_2_size, options.descriptor_length);
+    forest.find(set_1, set_1_size, options.kd_forest_checks, results);
+}
+
+void
+Matching::find_nearest_neighbors_twoway (Options const& options,
+    float const* set_1, int set_1_size,
+    float const* set_2, int set_2_size,
+    NearestNeighbor<float>::Result* results_1,
+    NearestNeighbor<float>::Result* results_2)
+{
+    if (options.kd_forest_checks <= 0)
+    {
+        Matching::find_nearest_neighbors_twoway<float>(options,
+            set_1, set_1_size, set_2, set_2_size, results_1, results_2);
+        return;
+    }
+
+    /* The KD-forest is approximate, both directions are searched. */
+    Matching::find_nearest_neighbors(options, set_1, set_1_size,
+        set_2, set_2_size, results_1);
+    Matching::find_nearest_neighbors(options, set_2, set_2_size,
+        set_1, set_1_size, results_2);
+}
+
 /* 去除不一致的特征描述子 */
 void
 Matching::remove_inconsistent_matches (Matching::Result* matches)
@@ -47,6 +47,14 @@ public:
          * Set to FLOAT_MAX to disable the test.
          */
         float distance_threshold;
+
+        /**
+         * Number of descriptor comparisons for approximate matching with a
+         * randomized KD-forest. Only used for float descriptors, where a few
+         * hundred checks are typical. Set to 0 for exhaustive matching.
+         * Like the other fields, this has no default and must be set.
+         */
+        int kd_forest_checks;
     };
 
     /**
@@ -107,6 +115,49 @@ public:
     static void
     combine_results(Result const& sift_result,
         Result const& surf_result, Matching::Result* result);
+
+private:
+    /** Finds the nearest neighbors of set 1 in set 2 by exhaustive search. */
+    template <typename T>
+    static void
+    find_nearest_neighbors (Options const& options,
+        T const* set_1, int set_1_size,
+        T const* set_2, int set_2_size,
+        typename NearestNeighbor<T>::Result* results);
+
+    /** Float descriptors optionally use the KD-forest. */
+    static void
+    find_nearest_neighbors (Options const& options,
+        float const* set_1, int set_1_size,
+        float const* set_2, int set_2_size,
+        NearestNeighbor<float>::Result* results);
+
+    /**
+     * Finds the nearest neighbors of set 1 in set 2 and of set 2 in set 1
+     * with a single exhaustive search in both directions.
+     */
+    template <typename T>
+    static void
+    find_nearest_neighbors_twoway (Options const& options,
+        T const* set_1, int set_1_size,
+        T const* set_2, int set_2_size,
+        typename NearestNeighbor<T>::Result* results_1,
+        typename NearestNeighbor<T>::Result* results_2);
+
+    /** Float descriptors optionally use the KD-forest in both directions. */
+    static void
+    find_nearest_neighbors_twoway (Options const& options,
+        float const* set_1, int set_1_size,
+        float const* set_2, int set_2_size,
+        NearestNeighbor<float>::Result* results_1,
+        NearestNeighbor<float>::Result* results_2);
+
+    /** Applies the thresholds to the nearest neighbors of set 1. */
+    template <typename T>
+    static void
+    select_matches (Options const& options,
+        std::vector<typename NearestNeighbor<T>::Result> const& nn_results,
+        std::vector<int>* result);
 };
 
 /* ---------------------------------------------------------------- */
@@ -123,27 +174,29 @@ Matching::oneway_match (Options const& options,
     if (set_1_size == 0 || set_2_size == 0)
         return;
 
+    // 以描述子为特征，计算每个特征点的最近邻和次近邻
+    std::vector<typename NearestNeighbor<T>::Result> nn_results(set_1_size);
+    Matching::find_nearest_neighbors(options, set_1, set_1_size,
+        set_2, set_2_size, nn_results.data());
+
+    Matching::select_matches<T>(options, nn_results, result);
+}
+
+template <typename T>
+void
+Matching::select_matches (Options const& options,
+    std::vector<typename NearestNeighbor<T>::Result> const& nn_results,
+    std::vector<int>* result)
+{
+    int const set_1_size = static_cast<int>(nn_results.size());
+
     // 与最近邻距离的阈值
     float const square_dist_thres = MATH_POW2(options.distance_threshold);
 
-    // 以描述子为特征，计算每个特征点的最近邻和次近邻
-    NearestNeighbor<T> nn;
-    nn.set_elements(set_2);
-    // 特征点的个数
-    nn.set_num_elements(set_2_size);
-    // 设置特征描述子的维度 sift 128, surf 64
-    nn.set_element_dimensions(options.descriptor_length);
-
     for (int i = 0; i < set_1_size; ++i)
     {
         // 每个特征点最近邻搜索的结果
-        typename NearestNeighbor<T>::Result nn_result;
-
-        // feature sets 1 中第i个特征点的特征描述子
-        T const* query_pointer = set_1 + i * options.descriptor_length;
-
-        // 计算最近邻
-        nn.find(query_pointer, &nn_result);
+        typename NearestNeighbor<T>::Result const& nn_result = nn_results[i];
 
         // 标准1： 与最近邻的距离必须小于特定阈值
         if (nn_result.dist_1st_best > square_dist_thres)
@@ -179,6 +232,39 @@ Matching::oneway_match (Options const& options,
     }
 }
 
+template <typename T>
+void
+Matching::find_nearest_neighbors (Options const& options,
+    T const* set_1, int set_1_size,
+    T const* set_2, int set_2_size,
+    typename NearestNeighbor<T>::Result* results)
+{
+    NearestNeighbor<T> nn;
+    nn.set_elements(set_2);
+    // 特征点的个数
+    nn.set_num_elements(set_2_size);
+    // 设置特征描述子的维度 sift 128, surf 64
+    nn.set_element_dimensions(options.descriptor_length);
+
+    // 批量计算所有特征点的最近邻，查询和候选描述子按缓存分块处理
+    nn.find(set_1, set_1_size, results);
+}
+
+template <typename T>
+void
+Matching::find_nearest_neighbors_twoway (Options const& options,
+    T const* set_1, int set_1_size,
+    T const* set_2, int set_2_size,
+    typename NearestNeighbor<T>::Result* results_1,
+    typename NearestNeighbor<T>::Result* results_2)
+{
+    NearestNeighbor<T> nn;
+    nn.set_elements(set_2);
+    nn.set_num_elements(set_2_size);
+    nn.set_element_dimensions(options.descriptor_length);
+    nn.find_twoway(set_1, set_1_size, results_1, results_2);
+}
+
 template <typename T>
 void
 Matching::twoway_match (Options const& options,
@@ -186,13 +272,23 @@ Matching::twoway_match (Options const& options,
     T const* set_2, int set_2_size,
     Result* matches)
 {
-    // 从feature set 2 中计算feature sets 1中每个特征点的最近邻居
-    Matching::oneway_match(options, set_1, set_1_size,
-        set_2, set_2_size, &matches->matches_1_2);
+    matches->matches_1_2.clear();
+    matches->matches_1_2.resize(set_1_size, -1);
+    matches->matches_2_1.clear();
+    matches->matches_2_1.resize(set_2_size, -1);
+    if (set_1_size == 0 || set_2_size == 0)
+        return;
+
+    // 两个方向的最近邻由同一组内积计算，feature set 1 中每个特征点在
+    // feature set 2 中的最近邻，以及 feature set 2 中每个特征点在
+    // feature set 1 中的最近邻
+    std::vector<typename NearestNeighbor<T>::Result> nn_results_1(set_1_size);
+    std::vector<typename NearestNeighbor<T>::Result> nn_results_2(set_2_size);
+    Matching::find_nearest_neighbors_twoway(options, set_1, set_1_size,
+        set_2, set_2_size, nn_results_1.data(), nn_results_2.data());
 
-    // 从feature set 1 中计算feature sets 2中每个特征点的最近邻
-    Matching::oneway_match(options, set_2, set_2_size,
-        set_1, set_1_size, &matches->matches_2_1);
+    Matching::select_matches<T>(options, nn_results_1, &matches->matches_1_2);
+    Matching::select_matches<T>(options, nn_results_2, &matches->matches_2_1);
 }
 
 FEATURES_NAMESPACE_END
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <stdexcept>
+
+#include "features/cascade_hashing.h"
+#include "features/exhaustive_matching.h"
+#include "features/matching_base.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+std::unique_ptr<MatchingBase>
+MatchingBase::create (MatcherType type)
+{
+    switch (type)
+    {
+        case MATCHER_EXHAUSTIVE:
+            return std::unique_ptr<MatchingBase>(new ExhaustiveMatching());
+        case MATCHER_CASCADE_HASHING:
+            return std::unique_ptr<MatchingBase>(new CascadeHashing());
+        default:
+            throw std::invalid_argument("Invalid matcher type");
+    }
+}
+
+void
+MatchingBase::init_view (sfm::bundler::ViewportList const& /*viewports*/,
+    int /*view_id*/)
+{
+    throw std::logic_error("Matcher does not support view updates");
+}
+
+FEATURES_NAMESPACE_END
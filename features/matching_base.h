@@ -11,9 +11,11 @@
 #define SFM_MATCHING_BASE_HEADER
 
 #include <limits>
+#include <memory>
 
 #include "sfm/bundler_common.h"
 #include "features/defines.h"
+#include "features/descriptor_pca.h"
 #include "features/matching.h"
 #include "features/matching_base.h"
 
@@ -22,16 +24,34 @@ FEATURES_NAMESPACE_BEGIN
 class MatchingBase
 {
 public:
+    /** The available matcher implementations. */
+    enum MatcherType
+    {
+        MATCHER_EXHAUSTIVE,
+        MATCHER_CASCADE_HASHING
+    };
+
     struct Options
     {
         Matching::Options sift_matching_opts{ 128, 0.8f,
-            std::numeric_limits<float>::max() };
+            std::numeric_limits<float>::max(), 0 };
         Matching::Options surf_matching_opts{ 64, 0.7f,
-            std::numeric_limits<float>::max() };
+            std::numeric_limits<float>::max(), 0 };
+
+        /**
+         * Optional PCA of SIFT descriptors. If set, the exhaustive matcher
+         * projects the SIFT descriptors to the first sift_pca_dimensions
+         * principal axes and matches them with the SIFT matching options.
+         */
+        std::shared_ptr<DescriptorPca const> sift_pca;
+        int sift_pca_dimensions = 64;
     };
 
     virtual ~MatchingBase (void) = default;
 
+    /** Creates a matcher of the given type. */
+    static std::unique_ptr<MatchingBase> create (MatcherType type);
+
     /**
      * Initialize the matcher. This is used for preprocessing the features
      * of the given viewports. For example, in the exhaustive matcher the
@@ -39,6 +59,16 @@ public:
      */
     virtual void init (sfm::bundler::ViewportList* viewports) = 0;
 
+    /**
+     * Preprocesses the features of one view again after init(), e.g. when
+     * the features of the views are computed while other views are already
+     * matched. Pairs of other views can be matched concurrently. Only
+     * matchers that preprocess every view on its own support this, the
+     * others throw std::logic_error.
+     */
+    virtual void init_view (sfm::bundler::ViewportList const& viewports,
+        int view_id);
+
     /** Matches all feature types yielding a single matching result. */
     virtual void pairwise_match (int view_1_id, int view_2_id,
         Matching::Result* result) const = 0;
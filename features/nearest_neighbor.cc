@@ -39,9 +39,35 @@
 
 #include <algorithm>
 #include <iostream>
-#include <emmintrin.h> // SSE2
-#include <pmmintrin.h> // SSE3
+#include <limits>
+#if defined(__SSE2__)
+#   include <emmintrin.h> // SSE2
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#endif
+
+/*
+ * On x86 with GCC or Clang, AVX2 and AVX-512 VNNI kernels are compiled
+ * with function target attributes and selected at runtime depending on
+ * the CPU. This does not require building the library for a specific
+ * target. NEON kernels are selected at compile time.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define NN_SEARCH_X86_DISPATCH 1
+#   define NN_TARGET(x) __attribute__((target(x)))
+#endif
+#if defined(__GNUC__)
+#   define NN_INLINE inline __attribute__((always_inline))
+#else
+#   define NN_INLINE inline
+#endif
+#if ENABLE_NEON_NN_SEARCH && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#   define NN_SEARCH_NEON 1
+#endif
 
+#include "features/binary_descriptor.h"
 #include "features/nearest_neighbor.h"
 
 FEATURES_NAMESPACE_BEGIN
@@ -49,181 +75,1205 @@ FEATURES_NAMESPACE_BEGIN
 namespace
 {
     /*
-     * Signed and unsigned short inner product implementation. Stores the
-     * largest and second largest inner product of query with elements.
-     *
-     * For SSE query and result should be 16 byte aligned.
-     * Otherwise loading and storing values into/from registers is slow.
-     * The dimension size must be divisible by 8, each __m128i register
-     * can load 8 shorts = 16 bytes = 128 bit.
+     * The kernels compute the inner products of the query with a block of
+     * consecutive elements. Computing blocks instead of single inner
+     * products amortizes the cost of the indirect kernel call.
      */
-    template <typename T>
+    int const NN_BLOCK_SIZE = 64;
+
+    typedef void (*ShortKernel) (short const* query, short const* elements,
+        int num_elements, int dimensions, int* result);
+    typedef void (*ByteKernel) (unsigned char const* query,
+        unsigned char const* elements, int num_elements, int dimensions,
+        int* result);
+    typedef void (*FloatKernel) (float const* query, float const* elements,
+        int num_elements, int dimensions, float* result);
+
+    /* ----------------------- Scalar kernels ------------------------- */
+
+    template <typename T, typename V>
+    void
+    inner_prod_scalar (T const* query, T const* elements,
+        int num_elements, int dimensions, V* result)
+    {
+        for (int i = 0; i < num_elements; ++i, elements += dimensions)
+        {
+            V inner_product = V(0);
+            for (int j = 0; j < dimensions; ++j)
+                inner_product += query[j] * elements[j];
+            result[i] = inner_product;
+        }
+    }
+
+    template <int DIM>
+    void
+    short_inner_prod_scalar (short const* query, short const* elements,
+        int num_elements, int num_dimensions, int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        inner_prod_scalar<short, int>(query, elements,
+            num_elements, dimensions, result);
+    }
+
+    template <int DIM>
     void
-    short_inner_prod (T const* query,
-        typename NearestNeighbor<T>::Result* result,
-        T const* elements, int num_elements, int dimensions)
+    byte_inner_prod_scalar (unsigned char const* query,
+        unsigned char const* elements, int num_elements, int num_dimensions,
+        int* result)
     {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        inner_prod_scalar<unsigned char, int>(query, elements,
+            num_elements, dimensions, result);
+    }
+
+    template <int DIM>
+    void
+    float_inner_prod_scalar (float const* query, float const* elements,
+        int num_elements, int num_dimensions, float* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        inner_prod_scalar<float, float>(query, elements,
+            num_elements, dimensions, result);
+    }
+
+    /*
+     * The SIMD kernels process NN_KERNEL_ROWS elements at once, similar to
+     * the register blocking of a matrix product. This shares the query
+     * loads and keeps independent accumulators, which hides the latency of
+     * the multiply-add chains. The last group of a block repeats the last
+     * element instead of handling the remainder separately.
+     */
+    int const NN_KERNEL_ROWS = 4;
+
+    template <typename T>
+    NN_INLINE void
+    get_kernel_rows (T const* elements, int first, int num_elements,
+        int dimensions, T const* rows[NN_KERNEL_ROWS])
+    {
+        for (int k = 0; k < NN_KERNEL_ROWS; ++k)
+            rows[k] = elements + std::min(first + k, num_elements - 1)
+                * dimensions;
+    }
+
+    /*
+     * Stores the inner products and adds the non-SIMD dimensions. This is
+     * inlined into the kernels to avoid calling legacy SSE code in between
+     * AVX instructions, which is very slow on some CPUs.
+     */
+    template <typename T, typename V>
+    NN_INLINE void
+    store_kernel_rows (T const* query, T const* const rows[NN_KERNEL_ROWS],
+        V const sums[NN_KERNEL_ROWS], int first, int num_elements,
+        int simd_dimensions, int dimensions, V* result)
+    {
+        int const num_rows = std::min(NN_KERNEL_ROWS, num_elements - first);
+        for (int k = 0; k < num_rows; ++k)
+        {
+            V inner_product = sums[k];
+            for (int j = simd_dimensions; j < dimensions; ++j)
+                inner_product += query[j] * rows[k][j];
+            result[first + k] = inner_product;
+        }
+    }
+
+    /* ------------------------ SSE2 kernels -------------------------- */
+
 #if ENABLE_SSE2_NN_SEARCH && defined(__SSE2__)
-        /* Using a constant number reduces computation time by about 1/3. */
-        int const dim_8 = dimensions / 8;
-        __m128i const* descr_ptr = reinterpret_cast<__m128i const*>(elements);
-        for (int descr_iter = 0; descr_iter < num_elements; ++descr_iter)
-        {
-            /* Compute dot product between query and candidate. */
-            __m128i const* query_ptr = reinterpret_cast<__m128i const*>(query);
-            __m128i reg_result = _mm_set1_epi16(0);
-            for (int i = 0; i < dim_8; ++i, ++query_ptr, ++descr_ptr)
+    /*
+     * Short inner products with _mm_madd_epi16, which multiplies pairs of
+     * shorts and accumulates them in 32 bit integers. This requires values
+     * that fit into a signed short, which holds for both signed (-127 to
+     * 127) and unsigned (0 to 255) descriptors.
+     */
+    int
+    horizontal_sum_sse2 (__m128i reg)
+    {
+        reg = _mm_add_epi32(reg,
+            _mm_shuffle_epi32(reg, _MM_SHUFFLE(1, 0, 3, 2)));
+        reg = _mm_add_epi32(reg,
+            _mm_shuffle_epi32(reg, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(reg);
+    }
+
+    float
+    horizontal_sum_sse2 (__m128 reg)
+    {
+        reg = _mm_add_ps(reg, _mm_movehl_ps(reg, reg));
+        reg = _mm_add_ss(reg,
+            _mm_shuffle_ps(reg, reg, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(reg);
+    }
+
+    template <int DIM>
+    void
+    short_inner_prod_sse2 (short const* query, short const* elements,
+        int num_elements, int num_dimensions, int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_8 = dimensions / 8 * 8;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            short const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m128i sum0 = _mm_setzero_si128();
+            __m128i sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_8; j += 8)
             {
-                __m128i reg_query = _mm_load_si128(query_ptr);
-                __m128i reg_subject = _mm_load_si128(descr_ptr);
-                reg_result = _mm_add_epi16(reg_result,
-                    _mm_mullo_epi16(reg_query, reg_subject));
+                __m128i const q = _mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(query + j));
+                sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(q,
+                    _mm_loadu_si128(reinterpret_cast<__m128i const*>
+                    (rows[0] + j))));
+                sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(q,
+                    _mm_loadu_si128(reinterpret_cast<__m128i const*>
+                    (rows[1] + j))));
+                sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(q,
+                    _mm_loadu_si128(reinterpret_cast<__m128i const*>
+                    (rows[2] + j))));
+                sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(q,
+                    _mm_loadu_si128(reinterpret_cast<__m128i const*>
+                    (rows[3] + j))));
             }
-            T const* tmp = reinterpret_cast<T const*>(&reg_result);
-            int inner_product = tmp[0] + tmp[1] + tmp[2] + tmp[3]
-                + tmp[4] + tmp[5] + tmp[6] + tmp[7];
+            int const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_sse2(sum0), horizontal_sum_sse2(sum1),
+                horizontal_sum_sse2(sum2), horizontal_sum_sse2(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_8, dimensions, result);
+        }
+    }
 
-            /* Check if new largest inner product has been found. */
-            if (inner_product >= result->dist_2nd_best)
+    template <int DIM>
+    void
+    byte_inner_prod_sse2 (unsigned char const* query,
+        unsigned char const* elements, int num_elements, int num_dimensions,
+        int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        __m128i const zero = _mm_setzero_si128();
+        int const dim_16 = dimensions / 16 * 16;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            unsigned char const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m128i sum0 = _mm_setzero_si128();
+            __m128i sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_16; j += 16)
             {
-                if (inner_product >= result->dist_1st_best)
-                {
-                    result->index_2nd_best = result->index_1st_best;
-                    result->dist_2nd_best = result->dist_1st_best;
-                    result->index_1st_best = descr_iter;
-                    result->dist_1st_best = inner_product;
-                }
-                else
-                {
-                    result->index_2nd_best = descr_iter;
-                    result->dist_2nd_best = inner_product;
-                }
+                __m128i const q = _mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(query + j));
+                __m128i const q_lo = _mm_unpacklo_epi8(q, zero);
+                __m128i const q_hi = _mm_unpackhi_epi8(q, zero);
+                __m128i const e0 = _mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[0] + j));
+                sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(q_lo,
+                    _mm_unpacklo_epi8(e0, zero)));
+                sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(q_hi,
+                    _mm_unpackhi_epi8(e0, zero)));
+                __m128i const e1 = _mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[1] + j));
+                sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(q_lo,
+                    _mm_unpacklo_epi8(e1, zero)));
+                sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(q_hi,
+                    _mm_unpackhi_epi8(e1, zero)));
+                __m128i const e2 = _mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[2] + j));
+                sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(q_lo,
+                    _mm_unpacklo_epi8(e2, zero)));
+                sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(q_hi,
+                    _mm_unpackhi_epi8(e2, zero)));
+                __m128i const e3 = _mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[3] + j));
+                sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(q_lo,
+                    _mm_unpacklo_epi8(e3, zero)));
+                sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(q_hi,
+                    _mm_unpackhi_epi8(e3, zero)));
             }
+            int const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_sse2(sum0), horizontal_sum_sse2(sum1),
+                horizontal_sum_sse2(sum2), horizontal_sum_sse2(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_16, dimensions, result);
         }
-#else
-        T const* descr_ptr = elements;
-        for (int i = 0; i < num_elements; ++i)
+    }
+
+    template <int DIM>
+    void
+    float_inner_prod_sse2 (float const* query, float const* elements,
+        int num_elements, int num_dimensions, float* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_4 = dimensions / 4 * 4;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
         {
-            int inner_product = 0;
-            for (int i = 0; i < dimensions; ++i, ++descr_ptr)
-                inner_product += query[i] * *descr_ptr;
+            float const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_4; j += 4)
+            {
+                __m128 const q = _mm_loadu_ps(query + j);
+                sum0 = _mm_add_ps(sum0,
+                    _mm_mul_ps(q, _mm_loadu_ps(rows[0] + j)));
+                sum1 = _mm_add_ps(sum1,
+                    _mm_mul_ps(q, _mm_loadu_ps(rows[1] + j)));
+                sum2 = _mm_add_ps(sum2,
+                    _mm_mul_ps(q, _mm_loadu_ps(rows[2] + j)));
+                sum3 = _mm_add_ps(sum3,
+                    _mm_mul_ps(q, _mm_loadu_ps(rows[3] + j)));
+            }
+            float const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_sse2(sum0), horizontal_sum_sse2(sum1),
+                horizontal_sum_sse2(sum2), horizontal_sum_sse2(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_4, dimensions, result);
+        }
+    }
+#endif
+
+    /* ------------------------ AVX2 kernels -------------------------- */
+
+#if NN_SEARCH_X86_DISPATCH
+    NN_TARGET("avx2") int
+    horizontal_sum_avx2 (__m256i reg)
+    {
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(reg),
+            _mm256_extracti128_si256(reg, 1));
+        sum = _mm_add_epi32(sum,
+            _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum,
+            _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    NN_TARGET("avx2") float
+    horizontal_sum_avx2 (__m256 reg)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(reg),
+            _mm256_extractf128_ps(reg, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum,
+            _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(sum);
+    }
 
-            /* Check if new largest inner product has been found. */
-            if (inner_product >= result->dist_2nd_best)
+    template <int DIM>
+    NN_TARGET("avx2") void
+    short_inner_prod_avx2 (short const* query, short const* elements,
+        int num_elements, int num_dimensions, int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_16 = dimensions / 16 * 16;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            short const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m256i sum0 = _mm256_setzero_si256();
+            __m256i sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_16; j += 16)
             {
-                if (inner_product >= result->dist_1st_best)
-                {
-                    result->index_2nd_best = result->index_1st_best;
-                    result->dist_2nd_best = result->dist_1st_best;
-                    result->index_1st_best = i;
-                    result->dist_1st_best = inner_product;
-                }
-                else
-                {
-                    result->index_2nd_best = i;
-                    result->dist_2nd_best = inner_product;
-                }
+                __m256i const q = _mm256_loadu_si256
+                    (reinterpret_cast<__m256i const*>(query + j));
+                sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(q,
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>
+                    (rows[0] + j))));
+                sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(q,
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>
+                    (rows[1] + j))));
+                sum2 = _mm256_add_epi32(sum2, _mm256_madd_epi16(q,
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>
+                    (rows[2] + j))));
+                sum3 = _mm256_add_epi32(sum3, _mm256_madd_epi16(q,
+                    _mm256_loadu_si256(reinterpret_cast<__m256i const*>
+                    (rows[3] + j))));
+            }
+            int const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_avx2(sum0), horizontal_sum_avx2(sum1),
+                horizontal_sum_avx2(sum2), horizontal_sum_avx2(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_16, dimensions, result);
+        }
+    }
+
+    template <int DIM>
+    NN_TARGET("avx2") void
+    byte_inner_prod_avx2 (unsigned char const* query,
+        unsigned char const* elements, int num_elements, int num_dimensions,
+        int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_16 = dimensions / 16 * 16;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            unsigned char const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m256i sum0 = _mm256_setzero_si256();
+            __m256i sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_16; j += 16)
+            {
+                __m256i const q = _mm256_cvtepu8_epi16(_mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(query + j)));
+                sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(q,
+                    _mm256_cvtepu8_epi16(_mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[0] + j)))));
+                sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(q,
+                    _mm256_cvtepu8_epi16(_mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[1] + j)))));
+                sum2 = _mm256_add_epi32(sum2, _mm256_madd_epi16(q,
+                    _mm256_cvtepu8_epi16(_mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[2] + j)))));
+                sum3 = _mm256_add_epi32(sum3, _mm256_madd_epi16(q,
+                    _mm256_cvtepu8_epi16(_mm_loadu_si128
+                    (reinterpret_cast<__m128i const*>(rows[3] + j)))));
             }
+            int const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_avx2(sum0), horizontal_sum_avx2(sum1),
+                horizontal_sum_avx2(sum2), horizontal_sum_avx2(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_16, dimensions, result);
         }
+    }
+
+    template <int DIM>
+    NN_TARGET("avx2,fma") void
+    float_inner_prod_avx2 (float const* query, float const* elements,
+        int num_elements, int num_dimensions, float* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_8 = dimensions / 8 * 8;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            float const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m256 sum0 = _mm256_setzero_ps();
+            __m256 sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_8; j += 8)
+            {
+                __m256 const q = _mm256_loadu_ps(query + j);
+                sum0 = _mm256_fmadd_ps(q,
+                    _mm256_loadu_ps(rows[0] + j), sum0);
+                sum1 = _mm256_fmadd_ps(q,
+                    _mm256_loadu_ps(rows[1] + j), sum1);
+                sum2 = _mm256_fmadd_ps(q,
+                    _mm256_loadu_ps(rows[2] + j), sum2);
+                sum3 = _mm256_fmadd_ps(q,
+                    _mm256_loadu_ps(rows[3] + j), sum3);
+            }
+            float const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_avx2(sum0), horizontal_sum_avx2(sum1),
+                horizontal_sum_avx2(sum2), horizontal_sum_avx2(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_8, dimensions, result);
+        }
+    }
+
+    /* -------------------- AVX-512 VNNI kernels ---------------------- */
+
+    template <int DIM>
+    NN_TARGET("avx512f,avx512bw,avx512vnni") void
+    short_inner_prod_avx512 (short const* query, short const* elements,
+        int num_elements, int num_dimensions, int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_32 = dimensions / 32 * 32;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            short const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m512i sum0 = _mm512_setzero_si512();
+            __m512i sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_32; j += 32)
+            {
+                __m512i const q = _mm512_loadu_si512(query + j);
+                sum0 = _mm512_dpwssd_epi32(sum0, q,
+                    _mm512_loadu_si512(rows[0] + j));
+                sum1 = _mm512_dpwssd_epi32(sum1, q,
+                    _mm512_loadu_si512(rows[1] + j));
+                sum2 = _mm512_dpwssd_epi32(sum2, q,
+                    _mm512_loadu_si512(rows[2] + j));
+                sum3 = _mm512_dpwssd_epi32(sum3, q,
+                    _mm512_loadu_si512(rows[3] + j));
+            }
+            int const sums[NN_KERNEL_ROWS] = {
+                _mm512_reduce_add_epi32(sum0), _mm512_reduce_add_epi32(sum1),
+                _mm512_reduce_add_epi32(sum2), _mm512_reduce_add_epi32(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_32, dimensions, result);
+        }
+    }
+
+    template <int DIM>
+    NN_TARGET("avx512f,avx512bw,avx512vnni") void
+    byte_inner_prod_avx512 (unsigned char const* query,
+        unsigned char const* elements, int num_elements, int num_dimensions,
+        int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_32 = dimensions / 32 * 32;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            unsigned char const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m512i sum0 = _mm512_setzero_si512();
+            __m512i sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_32; j += 32)
+            {
+                __m512i const q = _mm512_cvtepu8_epi16(_mm256_loadu_si256
+                    (reinterpret_cast<__m256i const*>(query + j)));
+                sum0 = _mm512_dpwssd_epi32(sum0, q,
+                    _mm512_cvtepu8_epi16(_mm256_loadu_si256
+                    (reinterpret_cast<__m256i const*>(rows[0] + j))));
+                sum1 = _mm512_dpwssd_epi32(sum1, q,
+                    _mm512_cvtepu8_epi16(_mm256_loadu_si256
+                    (reinterpret_cast<__m256i const*>(rows[1] + j))));
+                sum2 = _mm512_dpwssd_epi32(sum2, q,
+                    _mm512_cvtepu8_epi16(_mm256_loadu_si256
+                    (reinterpret_cast<__m256i const*>(rows[2] + j))));
+                sum3 = _mm512_dpwssd_epi32(sum3, q,
+                    _mm512_cvtepu8_epi16(_mm256_loadu_si256
+                    (reinterpret_cast<__m256i const*>(rows[3] + j))));
+            }
+            int const sums[NN_KERNEL_ROWS] = {
+                _mm512_reduce_add_epi32(sum0), _mm512_reduce_add_epi32(sum1),
+                _mm512_reduce_add_epi32(sum2), _mm512_reduce_add_epi32(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_32, dimensions, result);
+        }
+    }
+
+    template <int DIM>
+    NN_TARGET("avx512f") void
+    float_inner_prod_avx512 (float const* query, float const* elements,
+        int num_elements, int num_dimensions, float* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_16 = dimensions / 16 * 16;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            float const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            __m512 sum0 = _mm512_setzero_ps();
+            __m512 sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_16; j += 16)
+            {
+                __m512 const q = _mm512_loadu_ps(query + j);
+                sum0 = _mm512_fmadd_ps(q,
+                    _mm512_loadu_ps(rows[0] + j), sum0);
+                sum1 = _mm512_fmadd_ps(q,
+                    _mm512_loadu_ps(rows[1] + j), sum1);
+                sum2 = _mm512_fmadd_ps(q,
+                    _mm512_loadu_ps(rows[2] + j), sum2);
+                sum3 = _mm512_fmadd_ps(q,
+                    _mm512_loadu_ps(rows[3] + j), sum3);
+            }
+            float const sums[NN_KERNEL_ROWS] = {
+                _mm512_reduce_add_ps(sum0), _mm512_reduce_add_ps(sum1),
+                _mm512_reduce_add_ps(sum2), _mm512_reduce_add_ps(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_16, dimensions, result);
+        }
+    }
 #endif
+
+    /* ------------------------ NEON kernels -------------------------- */
+
+#if NN_SEARCH_NEON
+    int
+    horizontal_sum_neon (int32x4_t reg)
+    {
+        int32x2_t sum = vadd_s32(vget_low_s32(reg), vget_high_s32(reg));
+        return vget_lane_s32(vpadd_s32(sum, sum), 0);
+    }
+
+    float
+    horizontal_sum_neon (float32x4_t reg)
+    {
+        float32x2_t sum = vadd_f32(vget_low_f32(reg), vget_high_f32(reg));
+        return vget_lane_f32(vpadd_f32(sum, sum), 0);
+    }
+
+    template <int DIM>
+    void
+    short_inner_prod_neon (short const* query, short const* elements,
+        int num_elements, int num_dimensions, int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_8 = dimensions / 8 * 8;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            short const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            int32x4_t sum0 = vdupq_n_s32(0);
+            int32x4_t sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_8; j += 8)
+            {
+                int16x8_t const q = vld1q_s16(query + j);
+                int16x8_t const e0 = vld1q_s16(rows[0] + j);
+                sum0 = vmlal_s16(sum0, vget_low_s16(q), vget_low_s16(e0));
+                sum0 = vmlal_s16(sum0, vget_high_s16(q), vget_high_s16(e0));
+                int16x8_t const e1 = vld1q_s16(rows[1] + j);
+                sum1 = vmlal_s16(sum1, vget_low_s16(q), vget_low_s16(e1));
+                sum1 = vmlal_s16(sum1, vget_high_s16(q), vget_high_s16(e1));
+                int16x8_t const e2 = vld1q_s16(rows[2] + j);
+                sum2 = vmlal_s16(sum2, vget_low_s16(q), vget_low_s16(e2));
+                sum2 = vmlal_s16(sum2, vget_high_s16(q), vget_high_s16(e2));
+                int16x8_t const e3 = vld1q_s16(rows[3] + j);
+                sum3 = vmlal_s16(sum3, vget_low_s16(q), vget_low_s16(e3));
+                sum3 = vmlal_s16(sum3, vget_high_s16(q), vget_high_s16(e3));
+            }
+            int const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_neon(sum0), horizontal_sum_neon(sum1),
+                horizontal_sum_neon(sum2), horizontal_sum_neon(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_8, dimensions, result);
+        }
+    }
+
+    template <int DIM>
+    void
+    byte_inner_prod_neon (unsigned char const* query,
+        unsigned char const* elements, int num_elements, int num_dimensions,
+        int* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_8 = dimensions / 8 * 8;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            unsigned char const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            int32x4_t sum0 = vdupq_n_s32(0);
+            int32x4_t sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_8; j += 8)
+            {
+                /* Products of 8 bit values fit into 16 bit. */
+                uint8x8_t const q = vld1_u8(query + j);
+                sum0 = vreinterpretq_s32_u32(vpadalq_u16(
+                    vreinterpretq_u32_s32(sum0),
+                    vmull_u8(q, vld1_u8(rows[0] + j))));
+                sum1 = vreinterpretq_s32_u32(vpadalq_u16(
+                    vreinterpretq_u32_s32(sum1),
+                    vmull_u8(q, vld1_u8(rows[1] + j))));
+                sum2 = vreinterpretq_s32_u32(vpadalq_u16(
+                    vreinterpretq_u32_s32(sum2),
+                    vmull_u8(q, vld1_u8(rows[2] + j))));
+                sum3 = vreinterpretq_s32_u32(vpadalq_u16(
+                    vreinterpretq_u32_s32(sum3),
+                    vmull_u8(q, vld1_u8(rows[3] + j))));
+            }
+            int const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_neon(sum0), horizontal_sum_neon(sum1),
+                horizontal_sum_neon(sum2), horizontal_sum_neon(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_8, dimensions, result);
+        }
+    }
+
+    template <int DIM>
+    void
+    float_inner_prod_neon (float const* query, float const* elements,
+        int num_elements, int num_dimensions, float* result)
+    {
+        int const dimensions = DIM > 0 ? DIM : num_dimensions;
+        int const dim_4 = dimensions / 4 * 4;
+        for (int i = 0; i < num_elements; i += NN_KERNEL_ROWS)
+        {
+            float const* rows[NN_KERNEL_ROWS];
+            get_kernel_rows(elements, i, num_elements, dimensions, rows);
+            float32x4_t sum0 = vdupq_n_f32(0.0f);
+            float32x4_t sum1 = sum0, sum2 = sum0, sum3 = sum0;
+            for (int j = 0; j < dim_4; j += 4)
+            {
+                float32x4_t const q = vld1q_f32(query + j);
+                sum0 = vmlaq_f32(sum0, q, vld1q_f32(rows[0] + j));
+                sum1 = vmlaq_f32(sum1, q, vld1q_f32(rows[1] + j));
+                sum2 = vmlaq_f32(sum2, q, vld1q_f32(rows[2] + j));
+                sum3 = vmlaq_f32(sum3, q, vld1q_f32(rows[3] + j));
+            }
+            float const sums[NN_KERNEL_ROWS] = {
+                horizontal_sum_neon(sum0), horizontal_sum_neon(sum1),
+                horizontal_sum_neon(sum2), horizontal_sum_neon(sum3) };
+            store_kernel_rows(query, rows, sums, i, num_elements,
+                dim_4, dimensions, result);
+        }
+    }
+#endif
+
+    /* ---------------------- Kernel selection ------------------------ */
+
+#if NN_SEARCH_X86_DISPATCH
+    bool
+    cpu_supports_avx2 (void)
+    {
+        __builtin_cpu_init();
+        return ENABLE_AVX2_NN_SEARCH && __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("fma");
+    }
+
+    bool
+    cpu_supports_avx512 (void)
+    {
+        __builtin_cpu_init();
+        return ENABLE_AVX512_NN_SEARCH && __builtin_cpu_supports("avx512f")
+            && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vnni");
+    }
+#endif
+
+    /*
+     * The kernels are instantiated for the SIFT and SURF dimensions, which
+     * fully unrolls their loops, and for any dimensions. The kernel of the
+     * dimensions is chosen once per search.
+     */
+    template <typename KERNEL>
+    struct KernelSet
+    {
+        KERNEL any_dims;
+        KERNEL dims_64;
+        KERNEL dims_128;
+
+        KERNEL get (int dimensions) const
+        {
+            if (dimensions == 128)
+                return this->dims_128;
+            if (dimensions == 64)
+                return this->dims_64;
+            return this->any_dims;
+        }
+    };
+
+#define NN_KERNEL_SET(KERNEL) { KERNEL<0>, KERNEL<64>, KERNEL<128> }
+
+    KernelSet<ShortKernel>
+    select_short_kernels (void)
+    {
+#if NN_SEARCH_X86_DISPATCH
+        if (cpu_supports_avx512())
+            return NN_KERNEL_SET(short_inner_prod_avx512);
+        if (cpu_supports_avx2())
+            return NN_KERNEL_SET(short_inner_prod_avx2);
+#endif
+#if NN_SEARCH_NEON
+        return NN_KERNEL_SET(short_inner_prod_neon);
+#elif ENABLE_SSE2_NN_SEARCH && defined(__SSE2__)
+        return NN_KERNEL_SET(short_inner_prod_sse2);
+#else
+        return NN_KERNEL_SET(short_inner_prod_scalar);
+#endif
+    }
+
+    KernelSet<ByteKernel>
+    select_byte_kernels (void)
+    {
+#if NN_SEARCH_X86_DISPATCH
+        if (cpu_supports_avx512())
+            return NN_KERNEL_SET(byte_inner_prod_avx512);
+        if (cpu_supports_avx2())
+            return NN_KERNEL_SET(byte_inner_prod_avx2);
+#endif
+#if NN_SEARCH_NEON
+        return NN_KERNEL_SET(byte_inner_prod_neon);
+#elif ENABLE_SSE2_NN_SEARCH && defined(__SSE2__)
+        return NN_KERNEL_SET(byte_inner_prod_sse2);
+#else
+        return NN_KERNEL_SET(byte_inner_prod_scalar);
+#endif
+    }
+
+    KernelSet<FloatKernel>
+    select_float_kernels (void)
+    {
+#if NN_SEARCH_X86_DISPATCH
+        if (cpu_supports_avx512())
+            return NN_KERNEL_SET(float_inner_prod_avx512);
+        if (cpu_supports_avx2())
+            return NN_KERNEL_SET(float_inner_prod_avx2);
+#endif
+#if NN_SEARCH_NEON
+        return NN_KERNEL_SET(float_inner_prod_neon);
+#elif ENABLE_SSE2_NN_SEARCH && defined(__SSE2__)
+        return NN_KERNEL_SET(float_inner_prod_sse2);
+#else
+        return NN_KERNEL_SET(float_inner_prod_scalar);
+#endif
+    }
+
+#undef NN_KERNEL_SET
+
+    /*
+     * Updates the largest and second largest inner product in the result
+     * with the inner product of the element with the given index.
+     */
+    template <typename V, typename RESULT>
+    NN_INLINE void
+    update_largest_inner_prods (V inner_product, int index, RESULT* result)
+    {
+        if (inner_product < result->dist_2nd_best)
+            return;
+        if (inner_product >= result->dist_1st_best)
+        {
+            result->index_2nd_best = result->index_1st_best;
+            result->dist_2nd_best = result->dist_1st_best;
+            result->index_1st_best = index;
+            result->dist_1st_best = inner_product;
+        }
+        else
+        {
+            result->index_2nd_best = index;
+            result->dist_2nd_best = inner_product;
+        }
     }
 
     /*
-     * Float inner product implementation. Stores the largest and
-     * second largest inner product of query with elements.
-     *
-     * For SSE query and result should be 16 byte aligned.
-     * Otherwise loading and storing values into/from registers is slow.
-     * The dimension size must be divisible by 4, each __m128i register
-     * can load 4 shorts = 16 bytes = 128 bit.
+     * Updates the largest and second largest inner product of query with
+     * a range of elements in the result. The index of the first element
+     * in the range is given by 'first_index'.
      */
+    template <typename T, typename V, typename KERNEL, typename RESULT>
     void
-    float_inner_prod (float const* query,
-        NearestNeighbor<float>::Result* result,
-        float const* elements, int num_elements, int dimensions)
+    find_largest_inner_prods (KERNEL kernel, T const* query, RESULT* result,
+        T const* elements, int first_index, int num_elements, int dimensions)
     {
-#if ENABLE_SSE3_NN_SEARCH && defined(__SSE3__)
+        V inner_products[NN_BLOCK_SIZE];
+        for (int i = 0; i < num_elements; i += NN_BLOCK_SIZE)
+        {
+            int const block_size = std::min(NN_BLOCK_SIZE, num_elements - i);
+            kernel(query, elements + i * dimensions, block_size,
+                dimensions, inner_products);
+            for (int j = 0; j < block_size; ++j)
+                update_largest_inner_prods(inner_products[j],
+                    first_index + i + j, result);
+        }
+    }
+
     /*
-         * SSE inner product implementation.
-         * Note that query and result should be 16 byte aligned.
-         * Otherwise loading and storing values into/from registers is slow.
-         * The dimension size must be divisible by 4, each __m128 register
-         * can load 4 floats = 16 bytes = 128 bit.
-         */
-
-        __m128 const* descr_ptr = reinterpret_cast<__m128 const*>(elements);
-        int const dim_4 = dimensions / 4;
-        for (int descr_iter = 0; descr_iter < num_elements; ++descr_iter)
-        {
-            /* Compute dot product between query and candidate. */
-            __m128 const* query_ptr = reinterpret_cast<__m128 const*>(query);
+     * Updates the results of the query and of a range of elements, as in
+     * the search in both directions, with the same inner products.
+     */
+    template <typename T, typename V, typename KERNEL, typename RESULT>
+    void
+    find_largest_inner_prods_twoway (KERNEL kernel, T const* query,
+        int query_index, RESULT* query_result, T const* elements,
+        int first_index, int num_elements, int dimensions,
+        RESULT* element_results)
+    {
+        V inner_products[NN_BLOCK_SIZE];
+        for (int i = 0; i < num_elements; i += NN_BLOCK_SIZE)
+        {
+            int const block_size = std::min(NN_BLOCK_SIZE, num_elements - i);
+            kernel(query, elements + i * dimensions, block_size,
+                dimensions, inner_products);
+            for (int j = 0; j < block_size; ++j)
+            {
+                update_largest_inner_prods(inner_products[j],
+                    first_index + i + j, query_result);
+                update_largest_inner_prods(inner_products[j], query_index,
+                    element_results + first_index + i + j);
+            }
+        }
+    }
+
+    /* Result distances are shamelessly misused to store inner products. */
+    template <typename RESULT>
+    void
+    clear_inner_prod_results (RESULT* results, int num_results)
+    {
+        for (int i = 0; i < num_results; ++i)
+        {
+            results[i].dist_1st_best = 0;
+            results[i].dist_2nd_best = 0;
+            results[i].index_1st_best = 0;
+            results[i].index_2nd_best = 0;
+        }
+    }
+
+    /*
+     * Tiles for batched search. A block of queries is matched against a
+     * tile of elements that fits into the L2 cache, which is reused for
+     * all queries of the block, like the blocking of a matrix product.
+     * This avoids streaming all elements through the cache per query.
+     */
+    int const NN_QUERY_TILE_SIZE = 32;
+    int const NN_ELEMENT_TILE_BYTES = 128 * 1024;
+
+    template <typename T>
+    int
+    get_element_tile_size (int dimensions)
+    {
+        return std::max(NN_BLOCK_SIZE, NN_ELEMENT_TILE_BYTES
+            / std::max(1, dimensions * static_cast<int>(sizeof(T)))
+            / NN_BLOCK_SIZE * NN_BLOCK_SIZE);
+    }
+
+    template <typename T, typename V, typename KERNEL, typename RESULT>
+    void
+    find_largest_inner_prods (KERNEL kernel, T const* queries,
+        int num_queries, RESULT* results, T const* elements,
+        int num_elements, int dimensions)
+    {
+        clear_inner_prod_results(results, num_queries);
+        int const element_tile_size = get_element_tile_size<T>(dimensions);
+        for (int qi = 0; qi < num_queries; qi += NN_QUERY_TILE_SIZE)
+        {
+            int const qend = std::min(num_queries, qi + NN_QUERY_TILE_SIZE);
+            for (int ei = 0; ei < num_elements; ei += element_tile_size)
+            {
+                int const tile_size = std::min(element_tile_size,
+                    num_elements - ei);
+                for (int q = qi; q < qend; ++q)
+                    find_largest_inner_prods<T, V>(kernel,
+                        queries + q * dimensions, results + q,
+                        elements + ei * dimensions, ei, tile_size, dimensions);
+            }
+        }
+    }
+
+    /*
+     * Finds the largest inner products of the queries with the elements
+     * and of the elements with the queries, with the same tiles as above.
+     * Every element visits the queries in ascending order, which gives
+     * the same results, including ties, as the search of the elements.
+     */
+    template <typename T, typename V, typename KERNEL, typename RESULT>
+    void
+    find_largest_inner_prods_twoway (KERNEL kernel, T const* queries,
+        int num_queries, RESULT* query_results, T const* elements,
+        int num_elements, RESULT* element_results, int dimensions)
+    {
+        clear_inner_prod_results(query_results, num_queries);
+        clear_inner_prod_results(element_results, num_elements);
+        int const element_tile_size = get_element_tile_size<T>(dimensions);
+        for (int qi = 0; qi < num_queries; qi += NN_QUERY_TILE_SIZE)
+        {
+            int const qend = std::min(num_queries, qi + NN_QUERY_TILE_SIZE);
+            for (int ei = 0; ei < num_elements; ei += element_tile_size)
+            {
+                int const tile_size = std::min(element_tile_size,
+                    num_elements - ei);
+                for (int q = qi; q < qend; ++q)
+                    find_largest_inner_prods_twoway<T, V>(kernel,
+                        queries + q * dimensions, q, query_results + q,
+                        elements + ei * dimensions, ei, tile_size,
+                        dimensions, element_results);
+            }
+        }
+    }
+
+    /* ------------------ Partial distance search --------------------- */
+
+    /* The number of dimensions after which the distance is checked. */
+    int const NN_PARTIAL_DIMENSIONS = 16;
+
+    NN_INLINE float
+    partial_square_distance (float const* a, float const* b, int dimensions)
+    {
+#if ENABLE_SSE2_NN_SEARCH && defined(__SSE2__)
+        if (dimensions == NN_PARTIAL_DIMENSIONS)
+        {
             __m128 sum = _mm_setzero_ps();
-            for (int i = 0; i < dim_4; ++i, ++query_ptr, ++descr_ptr)
-                sum = _mm_add_ps(sum, _mm_mul_ps(*query_ptr, *descr_ptr));
-            sum = _mm_hadd_ps(sum, sum);
-            sum = _mm_hadd_ps(sum, sum);
-
-            /* Check if new largest inner product has been found. */
-            float inner_product = _mm_cvtss_f32(sum);
-            if (inner_product >= result->dist_2nd_best)
+            for (int i = 0; i < NN_PARTIAL_DIMENSIONS; i += 4)
             {
-                if (inner_product >= result->dist_1st_best)
-                {
-                    result->index_2nd_best = result->index_1st_best;
-                    result->dist_2nd_best = result->dist_1st_best;
-                    result->index_1st_best = descr_iter;
-                    result->dist_1st_best = inner_product;
-                }
-                else
-                {
-                    result->index_2nd_best = descr_iter;
-                    result->dist_2nd_best = inner_product;
-                }
+                __m128 const diff = _mm_sub_ps(_mm_loadu_ps(a + i),
+                    _mm_loadu_ps(b + i));
+                sum = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
             }
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            return _mm_cvtss_f32(sum);
         }
-#else
-        float const* descr_ptr = elements;
-        for (int i = 0; i < num_elements; ++i)
+#endif
+        float sum = 0.0f;
+        for (int i = 0; i < dimensions; ++i)
+            sum += (a[i] - b[i]) * (a[i] - b[i]);
+        return sum;
+    }
+
+    NN_INLINE int
+    partial_square_distance (unsigned char const* a, unsigned char const* b,
+        int dimensions)
+    {
+#if ENABLE_SSE2_NN_SEARCH && defined(__SSE2__)
+        if (dimensions == NN_PARTIAL_DIMENSIONS)
         {
-            float inner_product = 0.0f;
-            for (int j = 0; j < dimensions; ++j, ++descr_ptr)
-                inner_product += query[j] * *descr_ptr;
+            __m128i const zero = _mm_setzero_si128();
+            __m128i const va = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(a));
+            __m128i const vb = _mm_loadu_si128(
+                reinterpret_cast<__m128i const*>(b));
+            __m128i const lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero),
+                _mm_unpacklo_epi8(vb, zero));
+            __m128i const hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero),
+                _mm_unpackhi_epi8(vb, zero));
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo),
+                _mm_madd_epi16(hi, hi));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+            return _mm_cvtsi128_si32(sum);
+        }
+#endif
+        int sum = 0;
+        for (int i = 0; i < dimensions; ++i)
+            sum += (int(a[i]) - int(b[i])) * (int(a[i]) - int(b[i]));
+        return sum;
+    }
 
-            /* Check if new largest inner product has been found. */
-            if (inner_product >= result->dist_2nd_best)
+    /*
+     * Finds the smallest and second smallest square distances. Each
+     * distance is accumulated in chunks and abandoned once it reaches
+     * the second smallest distance found so far. Distances are clamped
+     * to the given maximum distance.
+     */
+    template <typename T, typename V, typename RESULT>
+    void
+    find_smallest_distances (T const* queries, int num_queries,
+        RESULT* results, T const* elements, int num_elements, int dimensions,
+        V max_distance)
+    {
+        typedef typename NearestNeighbor<T>::DistanceType DistanceType;
+        for (int i = 0; i < num_queries; ++i)
+        {
+            T const* query = queries + i * dimensions;
+            V dist_1st_best = std::numeric_limits<V>::max();
+            V dist_2nd_best = std::numeric_limits<V>::max();
+            int index_1st_best = 0;
+            int index_2nd_best = 0;
+            T const* element = elements;
+            for (int j = 0; j < num_elements; ++j, element += dimensions)
             {
-                if (inner_product >= result->dist_1st_best)
+                V dist = V(0);
+                for (int k = 0; k < dimensions && dist < dist_2nd_best;
+                    k += NN_PARTIAL_DIMENSIONS)
+                    dist += partial_square_distance(query + k, element + k,
+                        std::min(NN_PARTIAL_DIMENSIONS, dimensions - k));
+                if (dist >= dist_2nd_best)
+                    continue;
+
+                if (dist < dist_1st_best)
                 {
-                    result->index_2nd_best = result->index_1st_best;
-                    result->dist_2nd_best = result->dist_1st_best;
-                    result->index_1st_best = i;
-                    result->dist_1st_best = inner_product;
+                    dist_2nd_best = dist_1st_best;
+                    index_2nd_best = index_1st_best;
+                    dist_1st_best = dist;
+                    index_1st_best = j;
                 }
                 else
                 {
-                    result->index_2nd_best = i;
-                    result->dist_2nd_best = inner_product;
+                    dist_2nd_best = dist;
+                    index_2nd_best = j;
                 }
             }
+
+            RESULT& result = results[i];
+            result.dist_1st_best = static_cast<DistanceType>
+                (std::min(dist_1st_best, max_distance));
+            result.dist_2nd_best = static_cast<DistanceType>
+                (std::min(dist_2nd_best, max_distance));
+            result.index_1st_best = index_1st_best;
+            result.index_2nd_best = index_2nd_best;
         }
+    }
+
+    /*
+     * Signed and unsigned short inner products. Both are computed with
+     * the signed short kernels, which is exact for values below 32768.
+     * With element results, the search is done in both directions.
+     */
+    template <typename T>
+    void
+    short_inner_prod (T const* queries, int num_queries,
+        typename NearestNeighbor<T>::Result* results,
+        T const* elements, int num_elements, int dimensions,
+        typename NearestNeighbor<T>::Result* element_results = nullptr)
+    {
+        static KernelSet<ShortKernel> const kernels = select_short_kernels();
+        ShortKernel const kernel = kernels.get(dimensions);
+        short const* short_queries = reinterpret_cast<short const*>(queries);
+        short const* short_elements = reinterpret_cast<short const*>(elements);
+        if (element_results != nullptr)
+            find_largest_inner_prods_twoway<short, int>(kernel,
+                short_queries, num_queries, results, short_elements,
+                num_elements, element_results, dimensions);
+        else
+            find_largest_inner_prods<short, int>(kernel, short_queries,
+                num_queries, results, short_elements, num_elements,
+                dimensions);
+    }
+
+    void
+    byte_inner_prod (unsigned char const* queries, int num_queries,
+        NearestNeighbor<unsigned char>::Result* results,
+        unsigned char const* elements, int num_elements, int dimensions,
+        NearestNeighbor<unsigned char>::Result* element_results = nullptr)
+    {
+        static KernelSet<ByteKernel> const kernels = select_byte_kernels();
+        ByteKernel const kernel = kernels.get(dimensions);
+        if (element_results != nullptr)
+            find_largest_inner_prods_twoway<unsigned char, int>(kernel,
+                queries, num_queries, results, elements, num_elements,
+                element_results, dimensions);
+        else
+            find_largest_inner_prods<unsigned char, int>(kernel, queries,
+                num_queries, results, elements, num_elements, dimensions);
+    }
+
+    void
+    float_inner_prod (float const* queries, int num_queries,
+        NearestNeighbor<float>::Result* results,
+        float const* elements, int num_elements, int dimensions,
+        NearestNeighbor<float>::Result* element_results = nullptr)
+    {
+        static KernelSet<FloatKernel> const kernels = select_float_kernels();
+        FloatKernel const kernel = kernels.get(dimensions);
+        if (element_results != nullptr)
+            find_largest_inner_prods_twoway<float, float>(kernel, queries,
+                num_queries, results, elements, num_elements,
+                element_results, dimensions);
+        else
+            find_largest_inner_prods<float, float>(kernel, queries,
+                num_queries, results, elements, num_elements, dimensions);
+    }
+
+    /* ---------------------- Binary descriptors ---------------------- */
+
+    typedef void (*BinaryKernel) (BinaryDescriptor const& query,
+        BinaryDescriptor const* elements, int num_elements, int* result);
+
+    void
+    hamming_distance_scalar (BinaryDescriptor const& query,
+        BinaryDescriptor const* elements, int num_elements, int* result)
+    {
+        for (int i = 0; i < num_elements; ++i)
+            result[i] = hamming_distance(query, elements[i]);
+    }
+
+#if NN_SEARCH_X86_DISPATCH
+    /* Without -mpopcnt, the builtin is a table lookup instead of POPCNT. */
+    NN_TARGET("popcnt") void
+    hamming_distance_popcnt (BinaryDescriptor const& query,
+        BinaryDescriptor const* elements, int num_elements, int* result)
+    {
+        for (int i = 0; i < num_elements; ++i)
+        {
+            std::uint64_t const* bits = elements[i].bits;
+            result[i] = __builtin_popcountll(query.bits[0] ^ bits[0])
+                + __builtin_popcountll(query.bits[1] ^ bits[1])
+                + __builtin_popcountll(query.bits[2] ^ bits[2])
+                + __builtin_popcountll(query.bits[3] ^ bits[3]);
+        }
+    }
 #endif
+
+    BinaryKernel
+    select_binary_kernel (void)
+    {
+#if NN_SEARCH_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("popcnt"))
+            return hamming_distance_popcnt;
+#endif
+        return hamming_distance_scalar;
     }
 
-}
+    /*
+     * Updates the smallest and second smallest Hamming distance in the
+     * result with the distance of the element with the given index.
+     */
+    NN_INLINE void
+    update_smallest_hamming_distances (int dist, int index,
+        NearestNeighbor<BinaryDescriptor>::Result* result)
+    {
+        if (dist >= result->dist_2nd_best)
+            return;
+        if (dist < result->dist_1st_best)
+        {
+            result->index_2nd_best = result->index_1st_best;
+            result->dist_2nd_best = result->dist_1st_best;
+            result->index_1st_best = index;
+            result->dist_1st_best = dist;
+        }
+        else
+        {
+            result->index_2nd_best = index;
+            result->dist_2nd_best = dist;
+        }
+    }
 
-template <>
-void
-NearestNeighbor<short>::find (short const* query,
-    NearestNeighbor<short>::Result* result) const
-{
-    /* Result distances are shamelessly misused to store inner products. */
-    result->dist_1st_best = 0;
-    result->dist_2nd_best = 0;
-    result->index_1st_best = 0;
-    result->index_2nd_best = 0;
+    /*
+     * Updates the smallest and second smallest Hamming distance of the
+     * query with a range of elements, similar to the inner products above.
+     * With element results, the elements are updated with the query, as
+     * in the search in both directions.
+     */
+    void
+    find_smallest_hamming_distances (BinaryKernel kernel,
+        BinaryDescriptor const& query, NearestNeighbor<BinaryDescriptor>
+        ::Result* result, BinaryDescriptor const* elements, int first_index,
+        int num_elements, int query_index = 0,
+        NearestNeighbor<BinaryDescriptor>::Result* element_results = nullptr)
+    {
+        int distances[NN_BLOCK_SIZE];
+        for (int i = 0; i < num_elements; i += NN_BLOCK_SIZE)
+        {
+            int const block_size = std::min(NN_BLOCK_SIZE, num_elements - i);
+            kernel(query, elements + i, block_size, distances);
+            for (int j = 0; j < block_size; ++j)
+            {
+                int const index = first_index + i + j;
+                update_smallest_hamming_distances(distances[j], index, result);
+                if (element_results != nullptr)
+                    update_smallest_hamming_distances(distances[j],
+                        query_index, element_results + index);
+            }
+        }
+    }
 
-    short_inner_prod<short>(query, result, this->elements,
-        this->num_elements, this->dimensions);
+    /* Larger than any distance, so the first elements are always taken. */
+    void
+    clear_hamming_results (NearestNeighbor<BinaryDescriptor>::Result* results,
+        int num_results)
+    {
+        for (int i = 0; i < num_results; ++i)
+        {
+            results[i].dist_1st_best = std::numeric_limits<int>::max();
+            results[i].dist_2nd_best = std::numeric_limits<int>::max();
+            results[i].index_1st_best = 0;
+            results[i].index_2nd_best = 0;
+        }
+    }
+
+    /*
+     * Finds the smallest Hamming distances of the queries in tiles of
+     * elements. With element results, the search is done in both
+     * directions, where every element visits the queries in ascending
+     * order like the search of the elements.
+     */
+    void
+    find_smallest_hamming_distances (BinaryDescriptor const* queries,
+        int num_queries, NearestNeighbor<BinaryDescriptor>::Result* results,
+        BinaryDescriptor const* elements, int num_elements,
+        NearestNeighbor<BinaryDescriptor>::Result* element_results)
+    {
+        static BinaryKernel const kernel = select_binary_kernel();
+
+        clear_hamming_results(results, num_queries);
+        if (element_results != nullptr)
+            clear_hamming_results(element_results, num_elements);
+
+        int const element_tile_size = NN_ELEMENT_TILE_BYTES
+            / static_cast<int>(sizeof(BinaryDescriptor));
+        for (int qi = 0; qi < num_queries; qi += NN_QUERY_TILE_SIZE)
+        {
+            int const qend = std::min(num_queries, qi + NN_QUERY_TILE_SIZE);
+            for (int ei = 0; ei < num_elements; ei += element_tile_size)
+            {
+                int const tile_size = std::min(element_tile_size,
+                    num_elements - ei);
+                for (int q = qi; q < qend; ++q)
+                    find_smallest_hamming_distances(kernel, queries[q],
+                        results + q, elements + ei, ei, tile_size,
+                        q, element_results);
+            }
+        }
+    }
+
+    /* ----------------------- Square distances ----------------------- */
 
     /*
      * Compute actual square distances.
@@ -231,25 +1281,21 @@ NearestNeighbor<short>::find (short const* query,
      * The maximum distance is (2*127)^2, which unfortunately does not fit
      * in a signed short. Therefore, the distance is clapmed at 127^2.
      */
-    result->dist_1st_best = std::min(16129, std::max(0, (int)result->dist_1st_best));
-    result->dist_2nd_best = std::min(16129, std::max(0, (int)result->dist_2nd_best));
-    result->dist_1st_best = 32258 - 2 * result->dist_1st_best;
-    result->dist_2nd_best = 32258 - 2 * result->dist_2nd_best;
-}
-
-template <>
-void
-NearestNeighbor<unsigned short>::find (unsigned short const* query,
-    NearestNeighbor<unsigned short>::Result* result) const
-{
-    /* Result distances are shamelessly misused to store inner products. */
-    result->dist_1st_best = 0;
-    result->dist_2nd_best = 0;
-    result->index_1st_best = 0;
-    result->index_2nd_best = 0;
-
-    short_inner_prod<unsigned short>(query, result, this->elements,
-        this->num_elements, this->dimensions);
+    void
+    signed_short_distances (NearestNeighbor<short>::Result* results,
+        int num_results)
+    {
+        for (int i = 0; i < num_results; ++i)
+        {
+            NearestNeighbor<short>::Result* result = results + i;
+            result->dist_1st_best = std::min(16129,
+                std::max(0, (int)result->dist_1st_best));
+            result->dist_2nd_best = std::min(16129,
+                std::max(0, (int)result->dist_2nd_best));
+            result->dist_1st_best = 32258 - 2 * result->dist_1st_best;
+            result->dist_2nd_best = 32258 - 2 * result->dist_2nd_best;
+        }
+    }
 
     /*
      * Compute actual square distances.
@@ -257,35 +1303,200 @@ NearestNeighbor<unsigned short>::find (unsigned short const* query,
      * The maximum distance is (2*255)^2, which unfortunately does not fit
      * in a unsigned short. Therefore, the result distance is clapmed:
      * 2 * 255^2 - 2 * <Q, Ci> = 2 * (255^2 - <Q, Ci>) and (255^2 - <Q, Ci>)
-     * is clamped to 32767 and then multiplied by 2.
+     * is clamped to 32767 and then multiplied by 2. This is used for both
+     * unsigned short and unsigned char vectors.
      */
-    result->dist_1st_best = std::min(65025, (int)result->dist_1st_best);
-    result->dist_2nd_best = std::min(65025, (int)result->dist_2nd_best);
-    result->dist_1st_best = 65025 - result->dist_1st_best;
-    result->dist_2nd_best = 65025 - result->dist_2nd_best;
-    result->dist_1st_best = std::min(32767, (int)result->dist_1st_best) * 2;
-    result->dist_2nd_best = std::min(32767, (int)result->dist_2nd_best) * 2;
+    template <typename RESULT>
+    void
+    unsigned_distances (RESULT* results, int num_results)
+    {
+        for (int i = 0; i < num_results; ++i)
+        {
+            RESULT* result = results + i;
+            result->dist_1st_best = std::min(65025, (int)result->dist_1st_best);
+            result->dist_2nd_best = std::min(65025, (int)result->dist_2nd_best);
+            result->dist_1st_best = 65025 - result->dist_1st_best;
+            result->dist_2nd_best = 65025 - result->dist_2nd_best;
+            result->dist_1st_best
+                = std::min(32767, (int)result->dist_1st_best) * 2;
+            result->dist_2nd_best
+                = std::min(32767, (int)result->dist_2nd_best) * 2;
+        }
+    }
+
+    /* Compute actual (square) distances. */
+    void
+    float_distances (NearestNeighbor<float>::Result* results,
+        int num_results)
+    {
+        for (int i = 0; i < num_results; ++i)
+        {
+            NearestNeighbor<float>::Result* result = results + i;
+            result->dist_1st_best
+                = std::max(0.0f, 2.0f - 2.0f * result->dist_1st_best);
+            result->dist_2nd_best
+                = std::max(0.0f, 2.0f - 2.0f * result->dist_2nd_best);
+        }
+    }
+
+    /* Square distances, consistent with the other vector types. */
+    void
+    hamming_square_distances (NearestNeighbor<BinaryDescriptor>::Result*
+        results, int num_results)
+    {
+        for (int i = 0; i < num_results; ++i)
+        {
+            NearestNeighbor<BinaryDescriptor>::Result* result = results + i;
+            result->dist_1st_best = std::min(256, result->dist_1st_best);
+            result->dist_2nd_best = std::min(256, result->dist_2nd_best);
+            result->dist_1st_best *= result->dist_1st_best;
+            result->dist_2nd_best *= result->dist_2nd_best;
+        }
+    }
 }
 
 template <>
 void
-NearestNeighbor<float>::find (float const* query,
-    NearestNeighbor<float>::Result* result) const
+NearestNeighbor<short>::find (short const* queries, int num_queries,
+    NearestNeighbor<short>::Result* results) const
 {
-    /* Result distances are shamelessly misused to store inner products. */
-    result->dist_1st_best = 0.0f;
-    result->dist_2nd_best = 0.0f;
-    result->index_1st_best = 0;
-    result->index_2nd_best = 0;
-
-    float_inner_prod(query, result, this->elements,
+    short_inner_prod<short>(queries, num_queries, results, this->elements,
         this->num_elements, this->dimensions);
+    signed_short_distances(results, num_queries);
+}
+
+template <>
+void
+NearestNeighbor<short>::find_twoway (short const* queries, int num_queries,
+    Result* query_results, Result* element_results) const
+{
+    short_inner_prod<short>(queries, num_queries, query_results,
+        this->elements, this->num_elements, this->dimensions,
+        element_results);
+    signed_short_distances(query_results, num_queries);
+    signed_short_distances(element_results, this->num_elements);
+}
+
+template <>
+void
+NearestNeighbor<unsigned short>::find (unsigned short const* queries,
+    int num_queries, NearestNeighbor<unsigned short>::Result* results) const
+{
+    short_inner_prod<unsigned short>(queries, num_queries, results,
+        this->elements, this->num_elements, this->dimensions);
+    unsigned_distances(results, num_queries);
+}
+
+template <>
+void
+NearestNeighbor<unsigned short>::find_twoway (unsigned short const* queries,
+    int num_queries, Result* query_results, Result* element_results) const
+{
+    short_inner_prod<unsigned short>(queries, num_queries, query_results,
+        this->elements, this->num_elements, this->dimensions,
+        element_results);
+    unsigned_distances(query_results, num_queries);
+    unsigned_distances(element_results, this->num_elements);
+}
+
+template <>
+void
+NearestNeighbor<unsigned char>::find (unsigned char const* queries,
+    int num_queries, NearestNeighbor<unsigned char>::Result* results) const
+{
+    /* Same clamping as below, which is exact for normalized vectors. */
+    if (this->early_termination)
+    {
+        find_smallest_distances<unsigned char, int>(queries, num_queries,
+            results, this->elements, this->num_elements, this->dimensions,
+            65534);
+        return;
+    }
 
     /*
-     * Compute actual (square) distances.
+     * Compute actual square distances, similar to unsigned short vectors.
+     * The distance is 2 * (255^2 - <Q, Ci>) with (255^2 - <Q, Ci>) clamped
+     * to 32767 to fit the unsigned short distance type.
      */
-    result->dist_1st_best = std::max(0.0f, 2.0f - 2.0f * result->dist_1st_best);
-    result->dist_2nd_best = std::max(0.0f, 2.0f - 2.0f * result->dist_2nd_best);
+    byte_inner_prod(queries, num_queries, results, this->elements,
+        this->num_elements, this->dimensions);
+    unsigned_distances(results, num_queries);
+}
+
+template <>
+void
+NearestNeighbor<unsigned char>::find_twoway (unsigned char const* queries,
+    int num_queries, Result* query_results, Result* element_results) const
+{
+    if (this->early_termination)
+    {
+        this->find_separately(queries, num_queries,
+            query_results, element_results);
+        return;
+    }
+
+    byte_inner_prod(queries, num_queries, query_results, this->elements,
+        this->num_elements, this->dimensions, element_results);
+    unsigned_distances(query_results, num_queries);
+    unsigned_distances(element_results, this->num_elements);
+}
+
+template <>
+void
+NearestNeighbor<float>::find (float const* queries, int num_queries,
+    NearestNeighbor<float>::Result* results) const
+{
+    if (this->early_termination)
+    {
+        find_smallest_distances<float, float>(queries, num_queries,
+            results, this->elements, this->num_elements, this->dimensions,
+            std::numeric_limits<float>::max());
+        return;
+    }
+
+    float_inner_prod(queries, num_queries, results, this->elements,
+        this->num_elements, this->dimensions);
+    float_distances(results, num_queries);
+}
+
+template <>
+void
+NearestNeighbor<float>::find_twoway (float const* queries, int num_queries,
+    Result* query_results, Result* element_results) const
+{
+    if (this->early_termination)
+    {
+        this->find_separately(queries, num_queries,
+            query_results, element_results);
+        return;
+    }
+
+    float_inner_prod(queries, num_queries, query_results, this->elements,
+        this->num_elements, this->dimensions, element_results);
+    float_distances(query_results, num_queries);
+    float_distances(element_results, this->num_elements);
+}
+
+template <>
+void
+NearestNeighbor<BinaryDescriptor>::find (BinaryDescriptor const* queries,
+    int num_queries, NearestNeighbor<BinaryDescriptor>::Result* results) const
+{
+    find_smallest_hamming_distances(queries, num_queries, results,
+        this->elements, this->num_elements, nullptr);
+    hamming_square_distances(results, num_queries);
+}
+
+template <>
+void
+NearestNeighbor<BinaryDescriptor>::find_twoway (BinaryDescriptor const*
+    queries, int num_queries, Result* query_results,
+    Result* element_results) const
+{
+    find_smallest_hamming_distances(queries, num_queries, query_results,
+        this->elements, this->num_elements, element_results);
+    hamming_square_distances(query_results, num_queries);
+    hamming_square_distances(element_results, this->num_elements);
 }
 
 FEATURES_NAMESPACE_END
@@ -13,7 +13,9 @@
 #include "features/defines.h"
 
 #define ENABLE_SSE2_NN_SEARCH 1
-#define ENABLE_SSE3_NN_SEARCH 1
+#define ENABLE_AVX2_NN_SEARCH 1
+#define ENABLE_AVX512_NN_SEARCH 1
+#define ENABLE_NEON_NN_SEARCH 1
 
 FEATURES_NAMESPACE_BEGIN
 
@@ -30,27 +32,64 @@ FEATURES_NAMESPACE_BEGIN
  * Thus, we want to quickly compute and find the largest inner product <Q, Ci>
  * corresponding to the smallest distance.
  *
- * Notes: For SSE accellerated dot products, vector dimension must be a factor
- * of 8 (i.e. 128 bit registers for SSE). Query and elements must be 16 byte
- * aligned for efficient memory access.
+ * For float and unsigned char vectors, an alternative search computes the
+ * squared distances directly and stops accumulating a distance as soon
+ * as it exceeds the second best distance, which is checked after every
+ * 16 dimensions. This is most effective if the vectors are rotated such
+ * that most energy is in the first dimensions, see DescriptorPca.
+ *
+ * Notes: On x86, the fastest of the AVX-512 VNNI, AVX2 and SSE2 kernels
+ * is selected at runtime depending on the CPU, on ARM the NEON kernels are
+ * used. Dimensions that are not a multiple of the SIMD width are supported,
+ * but a multiple of 32 (shorts, bytes) or 16 (floats) is fastest. The
+ * kernels are compiled with fixed 64 and 128 dimensions for SURF and SIFT,
+ * which are chosen once per search, other dimensions use generic kernels.
  *
  * The following types are supported:
- *   - signed short using SSE2
+ *   - signed short
  *     value range -127 to 127, normalized to 127, max distance 32258
- *   - unsigend short using SSE2
+ *   - unsigend short
+ *     value range 0 to 255, normalized to 255, max distance 65534
+ *   - unsigned char, distances are stored as unsigned short
  *     value range 0 to 255, normalized to 255, max distance 65534
- *   - float using SSE3
+ *   - float
  *     any value range, normalized to 1, any distance possible
+ *   - BinaryDescriptor, distances are stored as int
+ *     elements are whole descriptors, the element dimensions are ignored,
+ *     the distance is the squared Hamming distance, max distance 65536
  */
+template <typename T>
+struct NearestNeighborDistance
+{
+    typedef T Type;
+};
+
+/** Distances of 8 bit vectors do not fit into 8 bit. */
+template <>
+struct NearestNeighborDistance<unsigned char>
+{
+    typedef unsigned short Type;
+};
+
+struct BinaryDescriptor;
+
+template <>
+struct NearestNeighborDistance<BinaryDescriptor>
+{
+    typedef int Type;
+};
+
 template <typename T>
 class NearestNeighbor
 {
 public:
+    typedef typename NearestNeighborDistance<T>::Type DistanceType;
+
     /** Unlike the naming suggests, these are square distances. */
     struct Result
     {
-        T dist_1st_best;
-        T dist_2nd_best;
+        DistanceType dist_1st_best;
+        DistanceType dist_2nd_best;
         int index_1st_best;
         int index_2nd_best;
     };
@@ -63,15 +102,40 @@ public:
     void set_element_dimensions (int element_dimensions);
     /** For SfM, this is the number of descriptors. */
     void set_num_elements (int num_elements);
+    /**
+     * Enables the search with partial distances and early termination.
+     * Only supported for float and unsigned char vectors.
+     */
+    void set_early_termination (bool enable);
     /** Find the nearest neighbor of 'query'. */
     void find (T const* query, Result* result) const;
+    /**
+     * Find the nearest neighbors of 'num_queries' consecutive queries.
+     * Queries and elements are processed in cache tiles, which is much
+     * faster than calling find() for every query.
+     */
+    void find (T const* queries, int num_queries, Result* results) const;
+    /**
+     * Find the nearest neighbors of the queries in the elements and of the
+     * elements in the queries, with the results of two find() calls. Both
+     * directions are computed from the same inner products, which halves
+     * the work for mutual matching. 'element_results' has one result per
+     * element. With early termination, two separate searches are used.
+     */
+    void find_twoway (T const* queries, int num_queries,
+        Result* query_results, Result* element_results) const;
 
     int get_element_dimensions (void) const;
 
+private:
+    void find_separately (T const* queries, int num_queries,
+        Result* query_results, Result* element_results) const;
+
 private:
     int dimensions;
     int num_elements;
     T const* elements;
+    bool early_termination;
 };
 
 /* ---------------------------------------------------------------- */
@@ -82,6 +146,7 @@ NearestNeighbor<T>::NearestNeighbor (void)
     : dimensions(64)
     , num_elements(0)
     , elements(nullptr)
+    , early_termination(false)
 {
 }
 
@@ -106,6 +171,32 @@ NearestNeighbor<T>::set_num_elements (int num_elements)
     this->num_elements = num_elements;
 }
 
+template <typename T>
+inline void
+NearestNeighbor<T>::set_early_termination (bool enable)
+{
+    this->early_termination = enable;
+}
+
+template <typename T>
+inline void
+NearestNeighbor<T>::find (T const* query, Result* result) const
+{
+    this->find(query, 1, result);
+}
+
+template <typename T>
+inline void
+NearestNeighbor<T>::find_separately (T const* queries, int num_queries,
+    Result* query_results, Result* element_results) const
+{
+    this->find(queries, num_queries, query_results);
+    NearestNeighbor<T> reverse(*this);
+    reverse.set_elements(queries);
+    reverse.set_num_elements(num_queries);
+    reverse.find(this->elements, this->num_elements, element_results);
+}
+
 template <typename T>
 inline int
 NearestNeighbor<T>::get_element_dimensions (void) const
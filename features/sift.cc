@@ -7,10 +7,22 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
-#include <fstream>
+#include <functional>
+#include <limits>
 #include <stdexcept>
+#include <utility>
 
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+#include "util/file_system.h"
+#include "util/profiler.h"
+#include "util/strings.h"
+#include "util/thread_pool.h"
 #include "util/timer.h"
 #include "math/functions.h"
 #include "math/matrix.h"
@@ -21,8 +33,291 @@
 
 FEATURES_NAMESPACE_BEGIN
 
+namespace
+{
+    /* Number of keypoints processed as one unit in descriptor generation. */
+    int const DESCRIPTOR_CHUNK_SIZE = 256;
+
+    /*
+     * Computes the tile window [*begin, *end) along one image axis. The
+     * window contains the tile core starting at 'core' and the border.
+     * Windows at the image boundary are shifted into the image, such that
+     * most windows have the nominal size. The window start is aligned.
+     */
+    void
+    tile_window (int core, int border, int size, int extent, int align,
+        int* begin, int* end)
+    {
+        *begin = std::max(0, std::min(core - border, extent - size));
+        *begin = *begin / align * align;
+        *end = std::min(extent, *begin + size);
+        if (extent - *end < align)
+            *end = extent;
+    }
+
+    /* Marks keypoints that have been removed by the keypoint selection. */
+    std::size_t const NO_KEYPOINT = std::numeric_limits<std::size_t>::max();
+
+    /*
+     * Orders the descriptors by the new index of their keypoint, which is
+     * given by 'keypoint_order' for the keypoint index of every descriptor.
+     * Descriptors of removed keypoints (NO_KEYPOINT) are dropped. The
+     * descriptors of a keypoint keep their relative order.
+     */
+    template <typename VECTOR>
+    void
+    reorder_descriptors (std::vector<std::size_t> const& keypoint_indices,
+        std::vector<std::size_t> const& keypoint_order, VECTOR* descriptors)
+    {
+        std::vector<std::pair<std::size_t, std::size_t> > order;
+        order.reserve(descriptors->size());
+        for (std::size_t i = 0; i < descriptors->size(); ++i)
+        {
+            std::size_t const index = keypoint_order[keypoint_indices[i]];
+            if (index != NO_KEYPOINT)
+                order.push_back(std::make_pair(index, i));
+        }
+        std::sort(order.begin(), order.end());
+
+        VECTOR result;
+        result.reserve(order.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            result.push_back(descriptors->at(order[i].second));
+        std::swap(*descriptors, result);
+    }
+
+    /*
+     * Lookup table for exp(-t) with t in [0, GAUSSIAN_TABLE_RANGE] and
+     * linear interpolation between the entries. With a resolution of
+     * 1/256, the interpolation error is below (1/256)^2 / 8 < 2e-6.
+     * Beyond the range, exp(-t) < 1.2e-7 and zero is returned.
+     */
+    int const GAUSSIAN_TABLE_RANGE = 16;
+    int const GAUSSIAN_TABLE_RESOLUTION = 256;
+
+    class GaussianTable
+    {
+    public:
+        GaussianTable (void)
+        {
+            int const size = GAUSSIAN_TABLE_RANGE * GAUSSIAN_TABLE_RESOLUTION;
+            this->values.resize(size + 2);
+            for (int i = 0; i < size + 2; ++i)
+                this->values[i] = std::exp(-static_cast<float>(i)
+                    / static_cast<float>(GAUSSIAN_TABLE_RESOLUTION));
+        }
+
+        float
+        exp_neg (float t) const
+        {
+            float const pos = t * static_cast<float>(GAUSSIAN_TABLE_RESOLUTION);
+            if (!(pos < static_cast<float>(this->values.size() - 2)))
+                return 0.0f;
+            int const idx = static_cast<int>(pos);
+            float const w = pos - static_cast<float>(idx);
+            return this->values[idx] + w * (this->values[idx + 1]
+                - this->values[idx]);
+        }
+
+    private:
+        std::vector<float> values;
+    };
+
+    /* Approximation of math::gaussian_xx() using the lookup table. */
+    float
+    fast_gaussian_xx (float xx, float sigma)
+    {
+        static GaussianTable const table;
+        return table.exp_neg(xx / (2.0f * sigma * sigma));
+    }
+
+    /*
+     * Coefficients of a minimax polynomial approximation of atan(x) for
+     * x in [0, 1]. The absolute approximation error is below 1e-5.
+     */
+    float const ATAN_COEFFS[6] = { 0.99997726f, -0.33262347f, 0.19354346f,
+        -0.11643287f, 0.05265332f, -0.01172120f };
+
+    /* Approximation of atan2(y, x) mapped to [0, 2PI). */
+    float
+    fast_atan2 (float y, float x)
+    {
+        float const ax = std::abs(x);
+        float const ay = std::abs(y);
+        float const a = std::min(ax, ay)
+            / std::max(std::max(ax, ay), std::numeric_limits<float>::min());
+        float const aa = a * a;
+        float r = ATAN_COEFFS[5];
+        for (int i = 4; i >= 0; --i)
+            r = r * aa + ATAN_COEFFS[i];
+        r = r * a;
+        if (ay > ax)
+            r = MATH_PI / 2.0f - r;
+        if (x < 0.0f)
+            r = MATH_PI - r;
+        if (y < 0.0f)
+            r = 2.0f * MATH_PI - r;
+        return r >= 2.0f * MATH_PI ? 0.0f : r;
+    }
+
+    /*
+     * Computes gradient magnitude and approximate orientation for the
+     * pixels [1, width - 1) of an image row. The four values per SIMD
+     * register are computed with the same operations as fast_atan2().
+     */
+    void
+    fast_gradient_row (float const* row, int width,
+        float* grad, float* ori)
+    {
+        int x = 1;
+#if defined(__SSE2__)
+        __m128 const half = _mm_set1_ps(0.5f);
+        __m128 const sign_mask = _mm_set1_ps(-0.0f);
+        __m128 const min_value = _mm_set1_ps(std::numeric_limits<float>::min());
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const half_pi = _mm_set1_ps(MATH_PI / 2.0f);
+        __m128 const pi = _mm_set1_ps(MATH_PI);
+        __m128 const two_pi = _mm_set1_ps(2.0f * MATH_PI);
+        for (; x + 4 < width; x += 4)
+        {
+            __m128 const dx = _mm_mul_ps(half, _mm_sub_ps(
+                _mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)));
+            __m128 const dy = _mm_mul_ps(half, _mm_sub_ps(
+                _mm_loadu_ps(row + x + width), _mm_loadu_ps(row + x - width)));
+            _mm_storeu_ps(grad + x, _mm_sqrt_ps(_mm_add_ps(
+                _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+
+            __m128 const ax = _mm_andnot_ps(sign_mask, dx);
+            __m128 const ay = _mm_andnot_ps(sign_mask, dy);
+            __m128 const a = _mm_div_ps(_mm_min_ps(ax, ay),
+                _mm_max_ps(_mm_max_ps(ax, ay), min_value));
+            __m128 const aa = _mm_mul_ps(a, a);
+            __m128 r = _mm_set1_ps(ATAN_COEFFS[5]);
+            for (int i = 4; i >= 0; --i)
+                r = _mm_add_ps(_mm_mul_ps(r, aa), _mm_set1_ps(ATAN_COEFFS[i]));
+            r = _mm_mul_ps(r, a);
+
+            __m128 mask = _mm_cmpgt_ps(ay, ax);
+            r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(half_pi, r)),
+                _mm_andnot_ps(mask, r));
+            mask = _mm_cmplt_ps(dx, zero);
+            r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(pi, r)),
+                _mm_andnot_ps(mask, r));
+            mask = _mm_cmplt_ps(dy, zero);
+            r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(two_pi, r)),
+                _mm_andnot_ps(mask, r));
+            r = _mm_andnot_ps(_mm_cmpge_ps(r, two_pi), r);
+            _mm_storeu_ps(ori + x, r);
+        }
+#endif
+        for (; x < width - 1; ++x)
+        {
+            float const dx = 0.5f * (row[x + 1] - row[x - 1]);
+            float const dy = 0.5f * (row[x + width] - row[x - width]);
+            grad[x] = std::sqrt(dx * dx + dy * dy);
+            ori[x] = fast_atan2(dy, dx);
+        }
+    }
+
+    /* Sets the boundary pixels of a single-channel image to zero. */
+    void
+    clear_image_border (core::FloatImage::Ptr img)
+    {
+        int const width = img->width();
+        int const height = img->height();
+        float* ptr = img->get_data_pointer();
+        std::fill(ptr, ptr + width, 0.0f);
+        std::fill(ptr + (height - 1) * width, ptr + height * width, 0.0f);
+        for (int y = 1; y < height - 1; ++y)
+        {
+            ptr[y * width] = 0.0f;
+            ptr[y * width + width - 1] = 0.0f;
+        }
+    }
+
+    /* The size of the chunks of Lowe descriptor files parsed in parallel. */
+    std::size_t const LOWE_CHUNK_SIZE = 1 << 20;
+    /* The values of a Lowe descriptor: y, x, scale, orientation, data. */
+    std::size_t const LOWE_DESCRIPTOR_VALUES = 4 + 128;
+
+    /* A part of a Lowe descriptor file that starts and ends at whitespace. */
+    struct LoweChunk
+    {
+        char const* begin;
+        char const* end;
+        std::size_t first_token;
+        std::size_t num_tokens;
+    };
+
+    inline bool
+    is_space (char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+            || c == '\v' || c == '\f';
+    }
+
+    inline char const*
+    skip_spaces (char const* str, char const* end)
+    {
+        while (str < end && is_space(*str))
+            str += 1;
+        return str;
+    }
+
+    inline char const*
+    skip_token (char const* str, char const* end)
+    {
+        while (str < end && !is_space(*str))
+            str += 1;
+        return str;
+    }
+
+    void
+    count_lowe_chunk (LoweChunk* chunk)
+    {
+        chunk->num_tokens = 0;
+        char const* str = skip_spaces(chunk->begin, chunk->end);
+        while (str < chunk->end)
+        {
+            chunk->num_tokens += 1;
+            str = skip_spaces(skip_token(str, chunk->end), chunk->end);
+        }
+    }
+
+    /*
+     * Parses the tokens of a chunk into the descriptors. Tokens beyond
+     * the descriptors are ignored. Returns false if a token is not a number.
+     */
+    bool
+    parse_lowe_chunk (LoweChunk const& chunk, Sift::Descriptors* result)
+    {
+        std::size_t const num_values
+            = result->size() * LOWE_DESCRIPTOR_VALUES;
+        std::size_t token = chunk.first_token;
+        char const* str = skip_spaces(chunk.begin, chunk.end);
+        for (; str < chunk.end && token < num_values; ++token)
+        {
+            Sift::Descriptor& descr
+                = (*result)[token / LOWE_DESCRIPTOR_VALUES];
+            std::size_t const value = token % LOWE_DESCRIPTOR_VALUES;
+            float* target = value == 0 ? &descr.y
+                : (value == 1 ? &descr.x
+                : (value == 2 ? &descr.scale
+                : (value == 3 ? &descr.orientation
+                : &descr.data[value - 4])));
+            char const* next = util::string::parse_float(str, target);
+            if (next == nullptr || (next < chunk.end && !is_space(*next)))
+                return false;
+            str = skip_spaces(next, chunk.end);
+        }
+        return true;
+    }
+}  // namespace
+
 Sift::Sift (Options const& options)
     : options(options)
+    , pool_width(0)
+    , pool_height(0)
 {
     if (this->options.min_octave < -1
         || this->options.min_octave > this->options.max_octave)
@@ -41,6 +336,24 @@ Sift::Sift (Options const& options)
 void
 Sift::process (void)
 {
+    UTIL_PROFILE_SCOPE("Sift::process");
+    /*
+     * Large images whose pyramid exceeds the memory budget are
+     * processed in tiles.
+     */
+    int const width = this->orig->width();
+    int const height = this->orig->height();
+    if (this->options.memory_budget > 0
+        && this->orig->get_byte_size() + this->pyramid_memory(width, height,
+        this->options.min_octave, this->options.max_octave)
+        > (static_cast<std::size_t>(this->options.memory_budget) << 20))
+    {
+        this->process_tiled();
+        return;
+    }
+
+    this->prepare_image_pool(width, height);
+
     util::ClockTimer timer, total_timer;
 
     /*
@@ -56,7 +369,9 @@ Sift::process (void)
             << this->options.max_octave << ")..." << std::endl;
     }
     timer.reset();
+    this->check_cancelled();
     this->create_octaves();
+    this->options.control.report(1, 4);
     if (this->options.debug_output)
     {
         std::cout << "SIFT: Creating octaves took "
@@ -71,7 +386,9 @@ Sift::process (void)
         std::cout << "SIFT: Detecting local extrema..." << std::endl;
     }
     timer.reset();
+    this->check_cancelled();
     this->extrema_detection();
+    this->options.control.report(2, 4);
     if (this->options.debug_output)
     {
         std::cout << "SIFT: Detected " << this->keypoints.size()
@@ -87,13 +404,32 @@ Sift::process (void)
         std::cout << "SIFT: Localizing and filtering keypoints..." << std::endl;
     }
     timer.reset();
+    this->check_cancelled();
     this->keypoint_localization();
+    this->options.control.report(3, 4);
     if (this->options.debug_output)
     {
         std::cout << "SIFT: Retained " << this->keypoints.size() << " stable "
             << "keypoints, took " << timer.get_elapsed() << "ms." << std::endl;
     }
 
+    /*
+     * Limit the number of keypoints to the strongest ones.
+     */
+    if (this->options.max_features > 0 && this->keypoints.size()
+        > static_cast<std::size_t>(this->options.max_features))
+    {
+        timer.reset();
+        std::size_t const num_keypoints = this->keypoints.size();
+        this->keypoint_selection(nullptr);
+        if (this->options.debug_output)
+        {
+            std::cout << "SIFT: Selected " << this->keypoints.size()
+                << " of " << num_keypoints << " keypoints, took "
+                << timer.get_elapsed() << "ms." << std::endl;
+        }
+    }
+
     /*
      * Difference of Gaussian images are not needed anymore.
      */
@@ -111,17 +447,21 @@ Sift::process (void)
         std::cout << "SIFT: Generating keypoint descriptors..." << std::endl;
     }
     timer.reset();
-    this->descriptor_generation();
+    this->check_cancelled();
+    this->descriptor_generation(nullptr);
+    this->options.control.report(4, 4);
     if (this->options.debug_output)
     {
-        std::cout << "SIFT: Generated " << this->descriptors.size()
-            << " descriptors, took " << timer.get_elapsed() << "ms."
+        std::cout << "SIFT: Generated " << (this->descriptors.size()
+            + this->compact_descriptors.size()) << " descriptors, took "
+            << timer.get_elapsed() << "ms."
             << std::endl;
     }
     if (this->options.verbose_output)
     {
-        std::cout << "SIFT: Generated " << this->descriptors.size()
-            << " descriptors from " << this->keypoints.size() << " keypoints,"
+        std::cout << "SIFT: Generated " << (this->descriptors.size()
+            + this->compact_descriptors.size()) << " descriptors from "
+            << this->keypoints.size() << " keypoints,"
             << " took " << total_timer.get_elapsed() << "ms." << std::endl;
     }
 
@@ -131,6 +471,391 @@ Sift::process (void)
 
 /* ---------------------------------------------------------------- */
 
+void
+Sift::process_tiled (void)
+{
+    UTIL_PROFILE_SCOPE("Sift::process_tiled");
+    util::ClockTimer timer;
+    core::FloatImage::ConstPtr const image = this->orig;
+    int const width = image->width();
+    int const height = image->height();
+    int const min_octave = this->options.min_octave;
+    int const max_octave = this->options.max_octave;
+    std::size_t const budget
+        = static_cast<std::size_t>(this->options.memory_budget) << 20;
+
+    /*
+     * The octaves below 'split' are processed in tiles. The remaining
+     * octaves are processed on the full image, starting from the base
+     * image of octave 'split', which is assembled from the tiles. The
+     * tile border grows with the coarsest tiled octave, thus the smallest
+     * split is chosen whose full-image octaves fit into the budget. Tile
+     * offsets are aligned to the pixel size of octave 'split'. This way
+     * the pyramid pixels of a tile coincide with the pyramid pixels of
+     * the full image and only the tile borders differ.
+     */
+    int split = std::max(1, min_octave + 1);
+    int align = 0, border = 0, tile_size = 0;
+    int base_width = 0, base_height = 0;
+    for (; split <= max_octave + 1; ++split)
+    {
+        /* The input image and the assembled base image stay in memory. */
+        base_width = width;
+        base_height = height;
+        for (int i = 0; i < split; ++i)
+        {
+            base_width = (base_width + 1) >> 1;
+            base_height = (base_height + 1) >> 1;
+        }
+        std::size_t fixed_memory = image->get_byte_size();
+        if (split <= max_octave)
+        {
+            fixed_memory += sizeof(float) * base_width * base_height;
+            if (fixed_memory + this->pyramid_memory(width, height,
+                split, max_octave) > budget)
+                continue;
+        }
+
+        /* Find the largest tile size whose pyramid fits into the budget. */
+        align = 1 << split;
+        border = (this->tile_border(split - 1) + align - 1) / align * align;
+        tile_size = 0;
+        while (tile_size < std::max(width, height))
+        {
+            int const size = tile_size + 2 * (align + border);
+            std::size_t const crop_memory = sizeof(float) * size * size;
+            if (fixed_memory + crop_memory + this->pyramid_memory(size,
+                size, min_octave, split - 1) > budget)
+                break;
+            tile_size += align;
+        }
+        if (tile_size > 0)
+            break;
+    }
+    if (tile_size == 0)
+        throw std::invalid_argument("Memory budget too small for tiling");
+
+    /*
+     * Collect the tile cores and the tile windows including the border.
+     * The tiles are processed grouped by window size, which allows to
+     * recycle the pyramid storage between tiles.
+     */
+    struct Tile
+    {
+        int x0, y0, x1, y1;
+        int left, top, right, bottom;
+    };
+    std::vector<Tile> tiles;
+    int const window_size = tile_size + 2 * border;
+    for (int y0 = 0; y0 < height; y0 += tile_size)
+        for (int x0 = 0; x0 < width; x0 += tile_size)
+        {
+            Tile tile;
+            tile.x0 = x0;
+            tile.y0 = y0;
+            tile.x1 = std::min(width, x0 + tile_size);
+            tile.y1 = std::min(height, y0 + tile_size);
+            tile_window(x0, border, window_size, width, align,
+                &tile.left, &tile.right);
+            tile_window(y0, border, window_size, height, align,
+                &tile.top, &tile.bottom);
+            tiles.push_back(tile);
+        }
+    std::stable_sort(tiles.begin(), tiles.end(),
+        [](Tile const& a, Tile const& b)
+        {
+            if (a.right - a.left != b.right - b.left)
+                return a.right - a.left < b.right - b.left;
+            return a.bottom - a.top < b.bottom - b.top;
+        });
+
+    bool const full_octaves = split <= max_octave;
+    int const num_stages = static_cast<int>(tiles.size()) + full_octaves;
+    if (this->options.verbose_output)
+    {
+        std::cout << "SIFT: Processing octaves " << min_octave << " to "
+            << (split - 1) << " in " << tiles.size() << " tiles of size "
+            << tile_size << " with border " << border << "..." << std::endl;
+    }
+
+    /*
+     * The features of every stage are appended to these lists. For every
+     * descriptor, the index of its keypoint is recorded.
+     */
+    Keypoints keypoints;
+    Descriptors descriptors;
+    CompactDescriptors compact_descriptors;
+    std::vector<std::size_t> descriptor_keypoints;
+    std::vector<std::size_t> indices;
+    auto append_features = [&](int left, int top)
+    {
+        std::size_t const offset = keypoints.size();
+        for (std::size_t i = 0; i < this->keypoints.size(); ++i)
+        {
+            Keypoint kp(this->keypoints[i]);
+            float const scale_factor = std::pow(2.0f, kp.octave);
+            kp.x += static_cast<float>(left) / scale_factor;
+            kp.y += static_cast<float>(top) / scale_factor;
+            keypoints.push_back(kp);
+        }
+        for (std::size_t i = 0; i < this->descriptors.size(); ++i)
+        {
+            descriptors.push_back(this->descriptors[i]);
+            descriptors.back().x += left;
+            descriptors.back().y += top;
+        }
+        for (std::size_t i = 0; i < this->compact_descriptors.size(); ++i)
+        {
+            compact_descriptors.push_back(this->compact_descriptors[i]);
+            compact_descriptors.back().x += left;
+            compact_descriptors.back().y += top;
+        }
+        for (std::size_t i = 0; i < indices.size(); ++i)
+            descriptor_keypoints.push_back(offset + indices[i]);
+    };
+
+    /*
+     * The stages run on this instance with a restricted octave range,
+     * which recycles the pyramid storage of the previous stage.
+     */
+    Options const saved_options(this->options);
+    core::FloatImage::Ptr base;
+    if (full_octaves)
+        base = core::FloatImage::create(base_width, base_height, 1);
+    try
+    {
+        this->options.max_octave = split - 1;
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+        {
+            Tile const& tile = tiles[i];
+            int const tile_width = tile.right - tile.left;
+            int const tile_height = tile.bottom - tile.top;
+            this->check_cancelled();
+
+            /* Copy the tile window into recycled storage. */
+            this->orig.reset();
+            this->prepare_image_pool(tile_width, tile_height);
+            core::FloatImage::Ptr crop
+                = this->image_pool.acquire(tile_width, tile_height, 1);
+            for (int y = 0; y < tile_height; ++y)
+            {
+                float const* row = image->begin()
+                    + (tile.top + y) * width + tile.left;
+                std::copy(row, row + tile_width,
+                    crop->begin() + y * tile_width);
+            }
+            this->orig = crop;
+
+            /* Copy the tile core of the next base image. */
+            core::FloatImage::ConstPtr next_base = this->create_octaves();
+            if (full_octaves)
+            {
+                int const bx0 = tile.x0 >> split;
+                int const by0 = tile.y0 >> split;
+                int const bx1 = (tile.x1 + align - 1) >> split;
+                int const by1 = (tile.y1 + align - 1) >> split;
+                int const offset_x = tile.left >> split;
+                int const offset_y = tile.top >> split;
+                for (int y = by0; y < by1; ++y)
+                {
+                    float const* row = next_base->begin() + (y - offset_y)
+                        * next_base->width() + (bx0 - offset_x);
+                    std::copy(row, row + (bx1 - bx0),
+                        base->begin() + y * base_width + bx0);
+                }
+            }
+            next_base.reset();
+
+            this->extrema_detection();
+            this->keypoint_localization();
+
+            /*
+             * Keep the keypoints with their center in the tile core, which
+             * removes duplicates in the tile overlaps. Keypoints beyond the
+             * image boundaries are kept in the boundary tiles.
+             */
+            std::size_t num_keypoints = 0;
+            for (std::size_t j = 0; j < this->keypoints.size(); ++j)
+            {
+                Keypoint const& kp = this->keypoints[j];
+                float const scale_factor = std::pow(2.0f, kp.octave);
+                float const x = scale_factor * (kp.x + 0.5f) + tile.left;
+                float const y = scale_factor * (kp.y + 0.5f) + tile.top;
+                if ((tile.x0 > 0 && x < tile.x0)
+                    || (tile.x1 < width && x >= tile.x1)
+                    || (tile.y0 > 0 && y < tile.y0)
+                    || (tile.y1 < height && y >= tile.y1))
+                    continue;
+                this->keypoints[num_keypoints] = kp;
+                num_keypoints += 1;
+            }
+            this->keypoints.resize(num_keypoints);
+
+            for (std::size_t j = 0; j < this->octaves.size(); ++j)
+                this->octaves[j].dog.clear();
+            this->descriptor_generation(&indices);
+            append_features(tile.left, tile.top);
+            this->octaves.clear();
+            this->options.control.report(static_cast<int>(i) + 1, num_stages);
+        }
+
+        /* The remaining octaves are processed on the full image. */
+        if (full_octaves)
+        {
+            this->check_cancelled();
+            this->orig.reset();
+            this->options.min_octave = split;
+            this->options.max_octave = max_octave;
+            this->prepare_image_pool(base_width, base_height);
+            this->add_octaves(base, this->options.base_blur_sigma);
+            base.reset();
+
+            this->extrema_detection();
+            this->keypoint_localization();
+            for (std::size_t j = 0; j < this->octaves.size(); ++j)
+                this->octaves[j].dog.clear();
+            this->descriptor_generation(&indices);
+            append_features(0, 0);
+            this->octaves.clear();
+            this->options.control.report(num_stages, num_stages);
+        }
+    }
+    catch (...)
+    {
+        this->options = saved_options;
+        this->orig = image;
+        throw;
+    }
+    this->options = saved_options;
+    this->orig = image;
+
+    /* Keypoints are ordered by octave as in the full-image run. */
+    std::vector<std::size_t> order(keypoints.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&keypoints](std::size_t a, std::size_t b)
+        { return keypoints[a].octave < keypoints[b].octave; });
+    std::vector<std::size_t> keypoint_order(order.size());
+    this->keypoints.resize(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+        this->keypoints[i] = keypoints[order[i]];
+        keypoint_order[order[i]] = i;
+    }
+
+    /* The keypoint budget applies to the whole image. */
+    if (this->options.max_features > 0 && this->keypoints.size()
+        > static_cast<std::size_t>(this->options.max_features))
+    {
+        std::vector<std::size_t> selected;
+        this->keypoint_selection(&selected);
+        std::vector<std::size_t> selected_order(order.size(), NO_KEYPOINT);
+        for (std::size_t i = 0; i < selected.size(); ++i)
+            selected_order[selected[i]] = i;
+        for (std::size_t i = 0; i < keypoint_order.size(); ++i)
+            keypoint_order[i] = selected_order[keypoint_order[i]];
+    }
+
+    /* Descriptors are ordered by keypoint as in the full-image run. */
+    reorder_descriptors(descriptor_keypoints, keypoint_order, &descriptors);
+    reorder_descriptors(descriptor_keypoints, keypoint_order,
+        &compact_descriptors);
+    std::swap(this->descriptors, descriptors);
+    std::swap(this->compact_descriptors, compact_descriptors);
+
+    if (this->options.verbose_output)
+    {
+        std::cout << "SIFT: Generated " << (this->descriptors.size()
+            + this->compact_descriptors.size()) << " descriptors from "
+            << this->keypoints.size() << " keypoints, took "
+            << timer.get_elapsed() << "ms." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Sift::check_cancelled (void)
+{
+    if (!this->options.control.is_cancelled())
+        return;
+    this->octaves.clear();
+    throw util::CancelledException("SIFT cancelled");
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Sift::prepare_image_pool (int width, int height)
+{
+    /*
+     * The pyramid storage of the previous run is recycled if the input
+     * image has the same dimensions. Otherwise the storage is released.
+     */
+    if (width == this->pool_width && height == this->pool_height)
+        return;
+    this->image_pool.clear();
+    this->pool_width = width;
+    this->pool_height = height;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+Sift::pyramid_memory (int width, int height,
+    int first_octave, int last_octave) const
+{
+    /*
+     * After octave creation, all S+3 blurred and S+2 DoG images are in
+     * memory, as well as the base image for the octave after the last.
+     * During descriptor generation, the DoG images are released and at
+     * most S gradient and orientation images are generated per octave.
+     * These recycle the pooled DoG storage of the same octave, S - 2
+     * additional images per octave remain in the pool afterwards. The
+     * input image of size (width x height) is not included.
+     */
+    int const samples = this->options.num_samples_per_octave;
+    double const pixels = static_cast<double>(width) * height;
+    double octave_pixels = 0.0;
+    for (int o = first_octave; o <= last_octave; ++o)
+        octave_pixels += pixels / std::pow(4.0, o);
+
+    double const next_base = pixels / std::pow(4.0, last_octave + 1);
+    double const octave_phase = octave_pixels * (2 * samples + 5);
+    double const descriptor_phase = octave_pixels
+        * (samples + 3 + std::max(samples + 2, 2 * samples));
+    double const values = next_base + std::max(octave_phase, descriptor_phase);
+    return static_cast<std::size_t>(values * sizeof(float));
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+Sift::tile_border (int octave) const
+{
+    /*
+     * The tile border in pixels of the given octave must contain the
+     * largest descriptor window (see descriptor_assignment()) and the
+     * support of the largest blur kernel. Errors of the blur at the tile
+     * boundaries propagate to the next octave, the blur support is thus
+     * accounted twice. The border in pixels of the input image is
+     * returned, which covers the keypoints up to the given octave.
+     */
+    float const samples = this->options.num_samples_per_octave;
+    float const max_kp_sigma = this->options.base_blur_sigma
+        * std::pow(2.0f, (samples + 1.0f) / samples);
+    float const max_img_sigma = this->options.base_blur_sigma
+        * std::pow(2.0f, (samples + 2.0f) / samples);
+    float const desc_win = MATH_SQRT2 * 3.0f * max_kp_sigma * 5.0f * 0.5f;
+    float const blur_win = 2.884f * max_img_sigma;
+    int const border = static_cast<int>(std::ceil(desc_win
+        + 2.0f * blur_win)) + 2;
+    return border << std::max(0, octave);
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 Sift::set_image (core::ByteImage::ConstPtr img)
 {
@@ -138,11 +863,8 @@ Sift::set_image (core::ByteImage::ConstPtr img)
         throw std::invalid_argument("Gray or color image expected");
 
     // 将图像转化成灰度图
-    this->orig = core::image::byte_to_float_image(img);
-    if (img->channels() == 3) {
-        this->orig = core::image::desaturate<float>
-            (this->orig, core::image::DESATURATE_AVERAGE);
-    }
+    this->orig = core::image::byte_to_float_grayscale
+        (img, core::image::DESATURATE_AVERAGE);
 }
 
 /* ---------------------------------------------------------------- */
@@ -166,9 +888,10 @@ Sift::set_float_image (core::FloatImage::ConstPtr img)
 
 /* ---------------------------------------------------------------- */
 
-void
+core::FloatImage::ConstPtr
 Sift::create_octaves (void)
 {
+    UTIL_PROFILE_SCOPE("Sift::create_octaves");
     this->octaves.clear();
 
     /*
@@ -192,22 +915,47 @@ Sift::create_octaves (void)
     for (int i = 0; i < this->options.min_octave; ++i)
         img = core::image::rescale_half_size_gaussian<float>(img);
 
+    return this->add_octaves(img, this->options.inherent_blur_sigma);
+}
+
+/* ---------------------------------------------------------------- */
+
+core::FloatImage::ConstPtr
+Sift::add_octaves (core::FloatImage::ConstPtr image, float image_sigma)
+{
     /*
-     * Create new octave from 'img', then subsample octave image where
+     * Create new octave from 'image', then subsample octave image where
      * sigma is doubled to get a new base image for the next octave.
+     * The base image for the octave after the last one is returned.
      */
-    float img_sigma = this->options.inherent_blur_sigma;
     for (int i = std::max(0, this->options.min_octave);
         i <= this->options.max_octave; ++i)
     {
         //std::cout << "Creating octave " << i << "..." << std::endl;
-        this->add_octave(img, img_sigma, this->options.base_blur_sigma);
+        this->add_octave(image, image_sigma, this->options.base_blur_sigma);
 
         core::FloatImage::ConstPtr pre_base = octaves[octaves.size()-1].img[0];
-        img = core::image::rescale_half_size_gaussian<float>(pre_base);
+        core::FloatImage::Ptr half = this->image_pool.acquire
+            ((pre_base->width() + 1) >> 1, (pre_base->height() + 1) >> 1, 1);
+        core::image::rescale_half_size_gaussian<float>(pre_base, half);
+        image = half;
 
-        img_sigma = this->options.base_blur_sigma;
+        image_sigma = this->options.base_blur_sigma;
     }
+
+    /*
+     * Create the remaining samples of each octave. The samples of an
+     * octave only depend on its base image, octaves are thus independent.
+     */
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+    int const num_octaves = static_cast<int>(this->octaves.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int i = 0; i < num_octaves; ++i)
+        this->add_octave_samples(&this->octaves[i],
+            this->options.base_blur_sigma);
+
+    return image;
 }
 
 /* ---------------------------------------------------------------- */
@@ -224,18 +972,29 @@ Sift::add_octave (core::FloatImage::ConstPtr image,
     float sigma = std::sqrt(MATH_POW2(target_sigma) - MATH_POW2(has_sigma));
     //std::cout << "Pre-blurring image to sigma " << target_sigma << " (has "
     //    << has_sigma << ", blur = " << sigma << ")..." << std::endl;
-    core::FloatImage::Ptr base = (target_sigma > has_sigma
-        ? core::image::blur_gaussian<float>(image, sigma)
-        : image->duplicate());
+    core::FloatImage::Ptr base = this->image_pool.acquire
+        (image->width(), image->height(), image->channels());
+    if (target_sigma > has_sigma)
+        core::image::blur_gaussian(image, base, sigma);
+    else
+        std::copy(image->begin(), image->end(), base->begin());
 
     /* Create the new octave and add initial image. */
     this->octaves.push_back(Octave());
     Octave& oct = this->octaves.back();
     oct.img.push_back(base);
+}
+
+/* ---------------------------------------------------------------- */
 
+void
+Sift::add_octave_samples (Octave* octave, float sigma)
+{
     /* 'k' is the constant factor between the scales in scale space. */
     float const k = std::pow(2.0f, 1.0f / this->options.num_samples_per_octave);
-    sigma = target_sigma;
+    core::FloatImage::Ptr base = octave->img.back();
+    int const width = base->width();
+    int const height = base->height();
 
     /* Create other (s+2) samples of the octave to get a total of (s+3). */
     for (int i = 1; i < this->options.num_samples_per_octave + 3; ++i)
@@ -247,14 +1006,15 @@ Sift::add_octave (core::FloatImage::ConstPtr image,
         /* Blur the image to create a new scale space sample. */
         //std::cout << "Blurring image to sigma " << sigmak << " (has " << sigma
         //    << ", blur = " << blur_sigma << ")..." << std::endl;
-        core::FloatImage::Ptr img = core::image::blur_gaussian<float>
-            (base, blur_sigma);
-        oct.img.push_back(img);
+        core::FloatImage::Ptr img = this->image_pool.acquire(width, height, 1);
+        core::image::blur_gaussian(base, img, blur_sigma);
+        octave->img.push_back(img);
 
         /* Create the Difference of Gaussian image (DoG). */
         //计算差分拉普拉斯 // todo revised by sway
-        core::FloatImage::Ptr dog = core::image::subtract<float>(img, base);
-        oct.dog.push_back(dog);
+        core::FloatImage::Ptr dog = this->image_pool.acquire(width, height, 1);
+        core::image::subtract<float>(img, base, dog);
+        octave->dog.push_back(dog);
 
         /* Update previous image and sigma for next round. */
         base = img;
@@ -267,28 +1027,50 @@ Sift::add_octave (core::FloatImage::ConstPtr image,
 void
 Sift::extrema_detection (void)
 {
+    UTIL_PROFILE_SCOPE("Sift::extrema_detection");
     /* Delete previous keypoints. */
     this->keypoints.clear();
 
-    /* Detect keypoints in each octave... */
+    /*
+     * Collect the detection jobs. In each octave, three subsequent DoG
+     * images are used for detection. Every job writes its own list of
+     * keypoints. The lists are concatenated in job order afterwards,
+     * which makes the result independent of the number of threads.
+     */
+    std::vector<std::pair<int, int> > jobs;
     for (std::size_t i = 0; i < this->octaves.size(); ++i)
+        for (int s = 0; s < (int)this->octaves[i].dog.size() - 2; ++s)
+            jobs.push_back(std::make_pair(static_cast<int>(i), s));
+
+    std::vector<Keypoints> results(jobs.size());
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+    int const num_jobs = static_cast<int>(jobs.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int i = 0; i < num_jobs; ++i)
     {
-        Octave const& oct(this->octaves[i]);
-        /* In each octave, take three subsequent DoG images and detect. */
-        for (int s = 0; s < (int)oct.dog.size() - 2; ++s)
-        {
-            core::FloatImage::ConstPtr samples[3] =
-            { oct.dog[s + 0], oct.dog[s + 1], oct.dog[s + 2] };
-            this->extrema_detection(samples, static_cast<int>(i)
-                + this->options.min_octave, s);
-        }
+        Octave const& oct(this->octaves[jobs[i].first]);
+        int const s = jobs[i].second;
+        core::FloatImage::ConstPtr samples[3] =
+        { oct.dog[s + 0], oct.dog[s + 1], oct.dog[s + 2] };
+        this->extrema_detection(samples, jobs[i].first
+            + this->options.min_octave, s, &results[i]);
     }
+
+    std::size_t num_keypoints = 0;
+    for (std::size_t i = 0; i < results.size(); ++i)
+        num_keypoints += results[i].size();
+    this->keypoints.reserve(num_keypoints);
+    for (std::size_t i = 0; i < results.size(); ++i)
+        this->keypoints.insert(this->keypoints.end(),
+            results[i].begin(), results[i].end());
 }
 
 /* ---------------------------------------------------------------- */
 
 std::size_t
-Sift::extrema_detection (core::FloatImage::ConstPtr s[3], int oi, int si)
+Sift::extrema_detection (core::FloatImage::ConstPtr s[3], int oi, int si,
+    Keypoints* result)
 {
     int const w = s[1]->width();
     int const h = s[1]->height();
@@ -331,7 +1113,8 @@ Sift::extrema_detection (core::FloatImage::ConstPtr s[3], int oi, int si)
             kp.x = static_cast<float>(x);
             kp.y = static_cast<float>(y);
             kp.sample = static_cast<float>(si);
-            this->keypoints.push_back(kp);
+            kp.response = center_value;
+            result->push_back(kp);
             detected += 1;
         }
 
@@ -343,6 +1126,7 @@ Sift::extrema_detection (core::FloatImage::ConstPtr s[3], int oi, int si)
 void
 Sift::keypoint_localization (void)
 {
+    UTIL_PROFILE_SCOPE("Sift::keypoint_localization");
     /*
      * Iterate over all keypoints, accurately localize minima and maxima
      * in the DoG function by fitting a quadratic Taylor polynomial
@@ -497,6 +1281,7 @@ Sift::keypoint_localization (void)
         kp.x = (float)ix + delta_x;
         kp.y = (float)iy + delta_y;
         kp.sample = (float)is + delta_s;
+        kp.response = val;
 
         /*
          * Discard keypoints with:
@@ -537,66 +1322,219 @@ Sift::keypoint_localization (void)
 /* ---------------------------------------------------------------- */
 
 void
-Sift::descriptor_generation (void)
+Sift::keypoint_selection (std::vector<std::size_t>* selected_indices)
+{
+    /*
+     * Assign every keypoint to a grid cell, using the keypoint location
+     * relative to the input image. Without bucketing, there is one cell.
+     */
+    int const grid = std::max(1, this->options.max_features_grid);
+    float const width = static_cast<float>(this->orig->width());
+    float const height = static_cast<float>(this->orig->height());
+    std::size_t const num_keypoints = this->keypoints.size();
+
+    struct Candidate
+    {
+        std::size_t index;
+        int cell;
+        int rank;
+        float response;
+        float scale;
+    };
+    std::vector<Candidate> candidates(num_keypoints);
+    for (std::size_t i = 0; i < num_keypoints; ++i)
+    {
+        Keypoint const& kp = this->keypoints[i];
+        float const scale_factor = std::pow(2.0f, kp.octave);
+        float const x = scale_factor * (kp.x + 0.5f) / width;
+        float const y = scale_factor * (kp.y + 0.5f) / height;
+        int const cx = math::clamp(static_cast<int>(x * grid), 0, grid - 1);
+        int const cy = math::clamp(static_cast<int>(y * grid), 0, grid - 1);
+
+        Candidate& c = candidates[i];
+        c.index = i;
+        c.cell = cy * grid + cx;
+        c.rank = 0;
+        c.response = std::abs(kp.response);
+        c.scale = this->keypoint_absolute_scale(kp);
+    }
+
+    /* Strongest keypoints first, ties are broken by scale and index. */
+    auto stronger = [](Candidate const& a, Candidate const& b)
+    {
+        if (a.response != b.response)
+            return a.response > b.response;
+        if (a.scale != b.scale)
+            return a.scale > b.scale;
+        return a.index < b.index;
+    };
+
+    /* Rank the keypoints within each cell. */
+    std::sort(candidates.begin(), candidates.end(),
+        [&stronger](Candidate const& a, Candidate const& b)
+        { return a.cell != b.cell ? a.cell < b.cell : stronger(a, b); });
+    for (std::size_t i = 1; i < num_keypoints; ++i)
+        if (candidates[i].cell == candidates[i - 1].cell)
+            candidates[i].rank = candidates[i - 1].rank + 1;
+
+    /* Select keypoints by rank first, i.e. in rounds over the cells. */
+    std::size_t const num_selected = std::min(num_keypoints,
+        static_cast<std::size_t>(this->options.max_features));
+    std::nth_element(candidates.begin(), candidates.begin() + num_selected,
+        candidates.end(), [&stronger](Candidate const& a, Candidate const& b)
+        { return a.rank != b.rank ? a.rank < b.rank : stronger(a, b); });
+
+    /* Keep the original order, which is sorted by octave. */
+    std::vector<std::size_t> selected(num_selected);
+    for (std::size_t i = 0; i < num_selected; ++i)
+        selected[i] = candidates[i].index;
+    std::sort(selected.begin(), selected.end());
+    for (std::size_t i = 0; i < num_selected; ++i)
+        this->keypoints[i] = this->keypoints[selected[i]];
+    this->keypoints.resize(num_selected);
+    if (selected_indices != nullptr)
+        std::swap(*selected_indices, selected);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Sift::descriptor_generation (std::vector<std::size_t>* keypoint_indices)
 {
+    UTIL_PROFILE_SCOPE("Sift::descriptor_generation");
     if (this->octaves.empty())
         throw std::runtime_error("Octaves not available!");
+
+    /*
+     * If requested, the index of the keypoint is recorded for every
+     * descriptor, since a keypoint can produce several descriptors.
+     */
+    this->descriptors.clear();
+    this->compact_descriptors.clear();
+    if (keypoint_indices != nullptr)
+        keypoint_indices->clear();
     if (this->keypoints.empty())
         return;
 
-    this->descriptors.clear();
-    this->descriptors.reserve(this->keypoints.size() * 3 / 2);
+    if (this->options.compact_descriptors)
+        this->compact_descriptors.reserve(this->keypoints.size() * 3 / 2);
+    else
+        this->descriptors.reserve(this->keypoints.size() * 3 / 2);
 
     /*
-     * Keep a buffer of S+3 gradient and orientation images for the current
+     * Keep a buffer of gradient and orientation images for the current
      * octave. Once the octave is changed, these images are recomputed.
      * To ensure efficiency, the octave index must always increase, never
-     * decrease, which is enforced during the algorithm.
+     * decrease, which is enforced during the algorithm. Only the scale
+     * levels referenced by the keypoints of the octave are computed. With
+     * the DoG images released, these mostly recycle the DoG storage.
      */
-    int octave_index = this->keypoints[0].octave;
-    Octave* octave = &this->octaves[octave_index - this->options.min_octave];
-    this->generate_grad_ori_images(octave);
-
-    /* Walk over all keypoints and compute descriptors. */
-    for (std::size_t i = 0; i < this->keypoints.size(); ++i)
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+    std::size_t kp_begin = 0;
+    while (kp_begin < this->keypoints.size())
     {
-        Keypoint const& kp(this->keypoints[i]);
+        /* Find the range of keypoints belonging to the current octave. */
+        int const octave_index = this->keypoints[kp_begin].octave;
+        std::size_t kp_end = kp_begin + 1;
+        while (kp_end < this->keypoints.size()
+            && this->keypoints[kp_end].octave == octave_index)
+            kp_end += 1;
+        if (kp_end < this->keypoints.size()
+            && this->keypoints[kp_end].octave < octave_index)
+            throw std::runtime_error("Decreasing octave index!");
+
+        /* Setup octave gradient and orientation images. */
+        Octave* octave = &this->octaves[octave_index - this->options.min_octave];
+        std::vector<bool> levels(octave->img.size(), false);
+        for (std::size_t i = kp_begin; i < kp_end; ++i)
+        {
+            int const is = static_cast<int>(math::round(this->keypoints[i].sample));
+            levels[is + 1] = true;
+        }
+        this->generate_grad_ori_images(octave, levels);
 
-        /* Generate new gradient and orientation images if octave changed. */
-        if (kp.octave > octave_index)
+        /*
+         * Walk over the keypoints in chunks and compute descriptors. Each
+         * chunk writes its own descriptor list, the lists are concatenated
+         * in keypoint order to keep the result independent of threading.
+         */
+        int const num_chunks = static_cast<int>((kp_end - kp_begin
+            + DESCRIPTOR_CHUNK_SIZE - 1) / DESCRIPTOR_CHUNK_SIZE);
+        std::vector<Descriptors> results(num_chunks);
+        std::vector<CompactDescriptors> compact_results(num_chunks);
+        std::vector<std::vector<std::size_t> > indices(num_chunks);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+        for (int i = 0; i < num_chunks; ++i)
         {
-            /* Clear old octave gradient and orientation images. */
-            if (octave)
+            std::size_t const chunk_begin = kp_begin
+                + static_cast<std::size_t>(i) * DESCRIPTOR_CHUNK_SIZE;
+            std::size_t const chunk_end = std::min(kp_end,
+                chunk_begin + DESCRIPTOR_CHUNK_SIZE);
+            for (std::size_t j = chunk_begin; j < chunk_end; ++j)
             {
-                octave->grad.clear();
-                octave->ori.clear();
+                this->descriptor_generation(this->keypoints[j],
+                    octave, &results[i], &compact_results[i]);
+                if (keypoint_indices != nullptr)
+                    indices[i].resize(results[i].size()
+                        + compact_results[i].size(), j);
             }
-            /* Setup new octave gradient and orientation images. */
-            octave_index = kp.octave;
-            octave = &this->octaves[octave_index - this->options.min_octave];
-            this->generate_grad_ori_images(octave);
         }
-        else if (kp.octave < octave_index)
+        for (int i = 0; i < num_chunks; ++i)
         {
-            throw std::runtime_error("Decreasing octave index!");
+            this->descriptors.insert(this->descriptors.end(),
+                results[i].begin(), results[i].end());
+            this->compact_descriptors.insert(this->compact_descriptors.end(),
+                compact_results[i].begin(), compact_results[i].end());
+            if (keypoint_indices != nullptr)
+                keypoint_indices->insert(keypoint_indices->end(),
+                    indices[i].begin(), indices[i].end());
         }
 
-        /* Orientation assignment. This returns multiple orientations. */
-        std::vector<float> orientations;
-        orientations.reserve(8);
-        this->orientation_assignment(kp, octave, orientations);
+        /* Clear octave gradient and orientation images. */
+        octave->grad.clear();
+        octave->ori.clear();
 
-        /* Feature vector extraction. */
-        for (std::size_t j = 0; j < orientations.size(); ++j)
+        kp_begin = kp_end;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Sift::descriptor_generation (Keypoint const& kp, Octave const* octave,
+    Descriptors* result, CompactDescriptors* compact_result)
+{
+    /* Orientation assignment. This returns multiple orientations. */
+    std::vector<float> orientations;
+    orientations.reserve(8);
+    this->orientation_assignment(kp, octave, orientations);
+
+    /* Feature vector extraction. */
+    for (std::size_t j = 0; j < orientations.size(); ++j)
+    {
+        float const scale_factor = std::pow(2.0f, kp.octave);
+        float const x = scale_factor * (kp.x + 0.5f) - 0.5f;
+        float const y = scale_factor * (kp.y + 0.5f) - 0.5f;
+        if (this->options.compact_descriptors)
+        {
+            CompactDescriptor desc;
+            desc.x = x;
+            desc.y = y;
+            desc.scale = this->keypoint_absolute_scale(kp);
+            desc.orientation = orientations[j];
+            if (this->descriptor_assignment(kp, desc, octave))
+                compact_result->push_back(desc);
+        }
+        else
         {
             Descriptor desc;
-            float const scale_factor = std::pow(2.0f, kp.octave);
-            desc.x = scale_factor * (kp.x + 0.5f) - 0.5f;
-            desc.y = scale_factor * (kp.y + 0.5f) - 0.5f;
+            desc.x = x;
+            desc.y = y;
             desc.scale = this->keypoint_absolute_scale(kp);
             desc.orientation = orientations[j];
             if (this->descriptor_assignment(kp, desc, octave))
-                this->descriptors.push_back(desc);
+                result->push_back(desc);
         }
     }
 }
@@ -604,22 +1542,43 @@ Sift::descriptor_generation (void)
 /* ---------------------------------------------------------------- */
 
 void
-Sift::generate_grad_ori_images (Octave* octave)
+Sift::generate_grad_ori_images (Octave* octave,
+    std::vector<bool> const& levels)
 {
     octave->grad.clear();
-    octave->grad.reserve(octave->img.size());
+    octave->grad.resize(octave->img.size());
     octave->ori.clear();
-    octave->ori.reserve(octave->img.size());
+    octave->ori.resize(octave->img.size());
 
     int const width = octave->img[0]->width();
     int const height = octave->img[0]->height();
 
     //std::cout << "Generating gradient and orientation images..." << std::endl;
-    for (std::size_t i = 0; i < octave->img.size(); ++i)
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+    int const num_images = static_cast<int>(octave->img.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int i = 0; i < num_images; ++i)
     {
+        if (!levels[i])
+            continue;
+
         core::FloatImage::ConstPtr img = octave->img[i];
-        core::FloatImage::Ptr grad = core::FloatImage::create(width, height, 1);
-        core::FloatImage::Ptr ori = core::FloatImage::create(width, height, 1);
+        core::FloatImage::Ptr grad = this->image_pool.acquire(width, height, 1);
+        core::FloatImage::Ptr ori = this->image_pool.acquire(width, height, 1);
+        clear_image_border(grad);
+        clear_image_border(ori);
+
+        if (this->options.fast_math)
+        {
+            for (int y = 1; y < height - 1; ++y)
+                fast_gradient_row(img->get_data_pointer() + y * width, width,
+                    grad->get_data_pointer() + y * width,
+                    ori->get_data_pointer() + y * width);
+            octave->grad[i] = grad;
+            octave->ori[i] = ori;
+            continue;
+        }
 
         int image_iter = width + 1;
         for (int y = 1; y < height - 1; ++y, image_iter += 2)
@@ -637,8 +1596,8 @@ Sift::generate_grad_ori_images (Octave* octave)
                 ori->at(image_iter) = atan2f < 0.0f
                     ? atan2f + MATH_PI * 2.0f : atan2f;
             }
-        octave->grad.push_back(grad);
-        octave->ori.push_back(ori);
+        octave->grad[i] = grad;
+        octave->ori[i] = ori;
     }
 }
 
@@ -698,7 +1657,9 @@ Sift::orientation_assignment (Keypoint const& kp,
 
             float gm = grad->at(center + yoff + dx); // gradient magnitude
             float go = ori->at(center + yoff + dx); // gradient orientation
-            float weight = math::gaussian_xx(dist, sigma * sigma_factor);
+            float weight = this->options.fast_math
+                ? fast_gaussian_xx(dist, sigma * sigma_factor)
+                : math::gaussian_xx(dist, sigma * sigma_factor);
             int bin = static_cast<int>(nbinsf * go / (2.0f * MATH_PI));
             bin = math::clamp(bin, 0, nbins - 1);
             hist[bin] += gm * weight;
@@ -831,9 +1792,11 @@ Sift::descriptor_assignment (Keypoint const& kp, Descriptor& desc,
 
             /* Compute circular window weight for the sample. */
             float gaussian_sigma = 0.5f * (float)PXB;
-            float gaussian_weight = math::gaussian_xx
-                (MATH_POW2(binx - binoff) + MATH_POW2(biny - binoff),
-                gaussian_sigma);
+            float const gaussian_dist
+                = MATH_POW2(binx - binoff) + MATH_POW2(biny - binoff);
+            float gaussian_weight = this->options.fast_math
+                ? fast_gaussian_xx(gaussian_dist, gaussian_sigma)
+                : math::gaussian_xx(gaussian_dist, gaussian_sigma);
 
             /* Total contribution of the sample in the histogram is now: */
             float contrib = mod * gaussian_weight;
@@ -887,6 +1850,38 @@ Sift::descriptor_assignment (Keypoint const& kp, Descriptor& desc,
     /* Normalize once again. */
     desc.data.normalize();
 
+    /* RootSIFT: L1 normalization and element-wise square root. */
+    if (this->options.root_sift)
+    {
+        float const l1_norm = desc.data.abs_sum();
+        if (l1_norm > 0.0f)
+            for (int i = 0; i < PXB * PXB * OHB; ++i)
+                desc.data[i] = std::sqrt(desc.data[i] / l1_norm);
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+Sift::descriptor_assignment (Keypoint const& kp, CompactDescriptor& desc,
+    Octave const* octave)
+{
+    /* Compute the float descriptor and quantize the elements. */
+    Descriptor float_desc;
+    float_desc.x = desc.x;
+    float_desc.y = desc.y;
+    float_desc.scale = desc.scale;
+    float_desc.orientation = desc.orientation;
+    if (!this->descriptor_assignment(kp, float_desc, octave))
+        return false;
+
+    for (int i = 0; i < 128; ++i)
+    {
+        float value = math::clamp(float_desc.data[i], 0.0f, 1.0f);
+        desc.data[i] = static_cast<uint8_t>(math::round(value * 255.0f));
+    }
     return true;
 }
 
@@ -919,39 +1914,73 @@ Sift::keypoint_absolute_scale (Keypoint const& kp)
 void
 Sift::load_lowe_descriptors (std::string const& filename, Descriptors* result)
 {
-    std::ifstream in(filename.c_str());
-    if (!in.good())
+    /* Read the whole file, the string is terminated for the parser. */
+    std::string data;
+    try
+    {
+        util::fs::read_file_to_string(filename, &data);
+    }
+    catch (std::exception&)
+    {
         throw std::runtime_error("Cannot open descriptor file");
+    }
+    char const* str = data.data();
+    char const* const file_end = data.data() + data.size();
+
+    unsigned int header[2] = { 0, 0 };
+    for (int i = 0; i < 2 && str != nullptr; ++i)
+        str = util::string::parse_uint(skip_spaces(str, file_end), header + i);
+    if (str == nullptr || (str < file_end && !is_space(*str))
+        || header[0] > 100000 || header[1] != 128)
+        throw std::runtime_error("Invalid number of descriptors/dimensions");
 
-    int num_descriptors;
-    int num_dimensions;
-    in >> num_descriptors >> num_dimensions;
-    if (num_descriptors > 100000 || num_dimensions != 128)
+    /* Split the body into chunks that end at whitespace. */
+    std::vector<LoweChunk> chunks;
+    while (str < file_end)
     {
-        in.close();
-        throw std::runtime_error("Invalid number of descriptors/dimensions");
+        LoweChunk chunk;
+        chunk.begin = str;
+        chunk.end = str + std::min<std::size_t>(LOWE_CHUNK_SIZE,
+            file_end - str);
+        while (chunk.end < file_end && !is_space(*chunk.end))
+            chunk.end += 1;
+        str = chunk.end;
+        chunks.push_back(chunk);
     }
-    result->clear();
-    result->reserve(num_descriptors);
-    for (int i = 0; i < num_descriptors; ++i)
+
+    std::int64_t const num_chunks = chunks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < num_chunks; ++i)
+        count_lowe_chunk(&chunks[i]);
+
+    std::size_t num_tokens = 0;
+    for (std::size_t i = 0; i < chunks.size(); ++i)
     {
-        Sift::Descriptor descriptor;
-        in >> descriptor.y >> descriptor.x
-            >> descriptor.scale >> descriptor.orientation;
-        for (int j = 0; j < 128; ++j)
-            in >> descriptor.data[j];
-        descriptor.data.normalize();
-        result->push_back(descriptor);
+        chunks[i].first_token = num_tokens;
+        num_tokens += chunks[i].num_tokens;
     }
 
-    if (!in.good())
+    result->clear();
+    if (num_tokens < header[0] * LOWE_DESCRIPTOR_VALUES)
+        throw std::runtime_error("Error while reading descriptors");
+
+    /* Parse the descriptors in place and normalize them. */
+    result->resize(header[0]);
+    bool parse_error = false;
+#pragma omp parallel for schedule(dynamic) reduction(||:parse_error)
+    for (std::int64_t i = 0; i < num_chunks; ++i)
+        if (!parse_lowe_chunk(chunks[i], result))
+            parse_error = true;
+    if (parse_error)
     {
         result->clear();
-        in.close();
         throw std::runtime_error("Error while reading descriptors");
     }
 
-    in.close();
+    std::int64_t const num_descriptors = result->size();
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_descriptors; ++i)
+        (*result)[i].data.normalize();
 }
 
 FEATURES_NAMESPACE_END
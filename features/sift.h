@@ -14,6 +14,8 @@
  *   (x + 0.5, y + 0.5) * 2^octave - (0.5, 0.5).
  * - Memory consumption is quite high, especially with large images.
  *   TODO: Find a more efficent code path to create octaves.
+ * - The pyramid storage is kept between calls to process() and recycled
+ *   as long as the input images have the same dimensions.
  */
 #ifndef SFM_SIFT_HEADER
 #define SFM_SIFT_HEADER
@@ -21,8 +23,11 @@
 #include <string>
 #include <vector>
 
+#include "util/memory.h"
+#include "util/progress.h"
 #include "math/vector.h"
 #include "core/image.h"
+#include "core/image_pool.h"
 #include "features/defines.h"
 
 FEATURES_NAMESPACE_BEGIN
@@ -102,6 +107,76 @@ public:
          */
         float inherent_blur_sigma;
 
+        /**
+         * Sets the number of threads for the octave pipeline, i.e. the
+         * creation of the scale space samples and DoG images, the extrema
+         * detection and the descriptor generation. Defaults to 1, which
+         * processes everything serially. A value of 0 uses the process-wide
+         * thread count of util::ThreadPool, or 1 within other parallel
+         * stages. The result is identical for any number of threads.
+         * This requires OpenMP, otherwise processing is always serial.
+         */
+        int num_threads;
+
+        /**
+         * Sets the memory budget in megabytes for the input image and the
+         * image pyramid. If the budget is exceeded, the fine octaves are
+         * processed in overlapping tiles whose pyramids fit into the budget,
+         * and the coarse octaves are processed on the full image, starting
+         * from the base image assembled from the tiles. Features in the
+         * overlap are assigned to exactly one tile. The result equals a
+         * full-image run up to the order of the features. Defaults to 0,
+         * which disables tiling.
+         */
+        int memory_budget;
+
+        /**
+         * Sets the maximum number of keypoints. If more keypoints survive
+         * the localization, only the keypoints with the largest absolute
+         * DoG response are kept (ties are broken by larger scale), and
+         * descriptors are computed for these only. Note that a keypoint can
+         * produce several descriptors. Defaults to 0, which keeps all.
+         */
+        int max_features;
+
+        /**
+         * Sets the number of grid cells along each image dimension used to
+         * distribute the keypoints of 'max_features' over the image. The
+         * keypoints are then selected in rounds, where each round takes the
+         * next strongest keypoint of every cell. Defaults to 0, which
+         * disables the spatial bucketing.
+         */
+        int max_features_grid;
+
+        /**
+         * Applies the RootSIFT normalization to the descriptors, i.e. the
+         * descriptor is L1 normalized and the square root is taken of each
+         * element. Comparing such descriptors with the euclidean distance
+         * corresponds to the Hellinger kernel on the original descriptors.
+         * Defaults to false.
+         */
+        bool root_sift;
+
+        /**
+         * Produces compact descriptors with 8 bit elements instead of float
+         * descriptors, which reduces descriptor memory by a factor of four.
+         * The elements are quantized the same way the matchers discretize
+         * descriptors. The descriptors are then available through
+         * get_compact_descriptors(), and get_descriptors() returns an
+         * empty list. Defaults to false.
+         */
+        bool compact_descriptors;
+
+        /**
+         * Uses fast approximations in the descriptor generation. Gradient
+         * orientations are computed with a polynomial atan2 approximation
+         * (absolute error below 1e-5 radians) and vectorized if SSE2 is
+         * available, and Gaussian weights are taken from an interpolated
+         * lookup table (absolute error below 2e-6). The descriptors thus
+         * differ slightly from the exact computation. Defaults to false.
+         */
+        bool fast_math;
+
         /**
          * Produce status messages on the console.
          */
@@ -111,6 +186,14 @@ public:
          * Produce even more messages on the console.
          */
         bool debug_output;
+
+        /**
+         * Cancellation is checked between the stages of the pipeline and
+         * between tiles, process() then releases the pyramid and throws
+         * util::CancelledException. Progress is reported after every stage,
+         * or after every tile for tiled processing.
+         */
+        util::StageControl control;
     };
 
     /**
@@ -132,6 +215,8 @@ public:
         float x;
         /** Keypoint y-coordinate. Initially integer, later sub-pixel. */
         float y;
+        /** DoG value at the keypoint. Initially at the pixel, later interpolated. */
+        float response;
     };
 
     /**
@@ -153,9 +238,29 @@ public:
         math::Vector<float, 128> data;
     };
 
+    /**
+     * Compact representation of the SIFT descriptor. The elements of the
+     * float descriptor are quantized as round(255 * value).
+     */
+    struct CompactDescriptor
+    {
+        /** The sub-pixel x-coordinate of the image keypoint. */
+        float x;
+        /** The sub-pixel y-coordinate of the image keypoint. */
+        float y;
+        /** The scale (or sigma value) of the keypoint. */
+        float scale;
+        /** The orientation of the image keypoint in [0, 2PI]. */
+        float orientation;
+        /** The quantized descriptor data. */
+        math::Vector<uint8_t, 128> data;
+    };
+
 public:
     typedef std::vector<Keypoint> Keypoints;
-    typedef std::vector<Descriptor> Descriptors;
+    typedef util::TrackedVector<Descriptor, util::MEMORY_FEATURES>
+        Descriptors;
+    typedef std::vector<CompactDescriptor> CompactDescriptors;
 
 public:
     explicit Sift (Options const& options);
@@ -174,6 +279,9 @@ public:
     /** Returns the list of descriptors. */
     Descriptors const& get_descriptors (void) const;
 
+    /** Returns the list of compact descriptors, see compact_descriptors. */
+    CompactDescriptors const& get_compact_descriptors (void) const;
+
     /**
      * Helper function that creates SIFT descriptors from David Lowe's
      * SIFT descriptor files.
@@ -190,28 +298,44 @@ protected:
         typedef std::vector<core::FloatImage::Ptr> ImageVector;
         ImageVector img; ///< S+3 images per octave
         ImageVector dog; ///< S+2 difference of gaussian images
-        ImageVector grad; ///< S+3 gradient images
-        ImageVector ori; ///< S+3 orientation images
+        ImageVector grad; ///< S+3 gradient images, only required ones set
+        ImageVector ori; ///< S+3 orientation images, only required ones set
     };
 
 protected:
     typedef std::vector<Octave> Octaves;
 
 protected:
-    void create_octaves (void);
+    void process_tiled (void);
+    void check_cancelled (void);
+    void prepare_image_pool (int width, int height);
+    std::size_t pyramid_memory (int width, int height,
+        int first_octave, int last_octave) const;
+    int tile_border (int octave) const;
+
+    core::FloatImage::ConstPtr create_octaves (void);
+    core::FloatImage::ConstPtr add_octaves (core::FloatImage::ConstPtr image,
+        float image_sigma);
     void add_octave (core::FloatImage::ConstPtr image,
         float has_sigma, float target_sigma);
+    void add_octave_samples (Octave* octave, float sigma);
     void extrema_detection (void);
     std::size_t extrema_detection (core::FloatImage::ConstPtr s[3],
-        int oi, int si);
+        int oi, int si, Keypoints* result);
     void keypoint_localization (void);
+    void keypoint_selection (std::vector<std::size_t>* selected_indices);
 
-    void descriptor_generation (void);
-    void generate_grad_ori_images (Octave* octave);
+    void descriptor_generation (std::vector<std::size_t>* keypoint_indices);
+    void descriptor_generation (Keypoint const& kp, Octave const* octave,
+        Descriptors* result, CompactDescriptors* compact_result);
+    void generate_grad_ori_images (Octave* octave,
+        std::vector<bool> const& levels);
     void orientation_assignment (Keypoint const& kp,
         Octave const* octave, std::vector<float>& orientations);
     bool descriptor_assignment (Keypoint const& kp, Descriptor& desc,
         Octave const* octave);
+    bool descriptor_assignment (Keypoint const& kp, CompactDescriptor& desc,
+        Octave const* octave);
 
     float keypoint_relative_scale (Keypoint const& kp);
     float keypoint_absolute_scale (Keypoint const& kp);
@@ -222,6 +346,10 @@ private:
     Octaves octaves; // The image pyramid (the octaves)
     Keypoints keypoints; // Detected keypoints
     Descriptors descriptors; // Final SIFT descriptors
+    CompactDescriptors compact_descriptors; // Final compact SIFT descriptors
+    core::ImagePool<float> image_pool; // Recycled pyramid storage
+    int pool_width; // Input image width of the pooled storage
+    int pool_height; // Input image height of the pooled storage
 };
 
 /* ---------------------------------------------------------------- */
@@ -235,6 +363,13 @@ Sift::Options::Options (void)
     , edge_ratio_threshold(10.0f)
     , base_blur_sigma(1.6f)
     , inherent_blur_sigma(0.5f)
+    , num_threads(1)
+    , memory_budget(0)
+    , max_features(0)
+    , max_features_grid(0)
+    , root_sift(false)
+    , compact_descriptors(false)
+    , fast_math(false)
     , verbose_output(false)
     , debug_output(false)
 {
@@ -252,6 +387,12 @@ Sift::get_descriptors (void) const
     return this->descriptors;
 }
 
+inline Sift::CompactDescriptors const&
+Sift::get_compact_descriptors (void) const
+{
+    return this->compact_descriptors;
+}
+
 FEATURES_NAMESPACE_END
 
 #endif /* SFM_SIFT_HEADER */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "features/sift_batch.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+SiftBatch::SiftBatch (Options const& options, util::ThreadPool& pool)
+    : opts(options)
+    , pool(pool)
+    , max_in_flight(options.max_in_flight)
+    , num_in_flight(0)
+{
+    if (this->max_in_flight == 0)
+        this->max_in_flight = std::max<std::size_t>(1,
+            pool.get_num_workers());
+}
+
+SiftBatch::~SiftBatch (void)
+{
+    this->wait();
+}
+
+void
+SiftBatch::wait (void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->finished.wait(lock, [this] (void)
+        { return this->num_in_flight == 0; });
+}
+
+std::future<SiftBatch::Result>
+SiftBatch::enqueue (core::ByteImage::ConstPtr byte_image,
+    core::FloatImage::ConstPtr float_image)
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->finished.wait(lock, [this] (void)
+            { return this->num_in_flight < this->max_in_flight; });
+        this->num_in_flight += 1;
+    }
+
+    return this->pool.submit([this, byte_image, float_image] (void)
+    {
+        std::unique_ptr<Sift> sift = this->acquire();
+        Result result;
+        try
+        {
+            if (byte_image != nullptr)
+                sift->set_image(byte_image);
+            else
+                sift->set_float_image(float_image);
+            sift->process();
+            result.keypoints = sift->get_keypoints();
+            result.descriptors = sift->get_descriptors();
+        }
+        catch (...)
+        {
+            this->release(std::move(sift));
+            throw;
+        }
+        this->release(std::move(sift));
+        return result;
+    });
+}
+
+std::unique_ptr<Sift>
+SiftBatch::acquire (void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->idle.empty())
+        return std::unique_ptr<Sift>(new Sift(this->opts.sift_options));
+    std::unique_ptr<Sift> sift = std::move(this->idle.back());
+    this->idle.pop_back();
+    return sift;
+}
+
+void
+SiftBatch::release (std::unique_ptr<Sift> sift)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->idle.push_back(std::move(sift));
+        this->num_in_flight -= 1;
+    }
+    this->finished.notify_all();
+}
+
+FEATURES_NAMESPACE_END
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_SIFT_BATCH_HEADER
+#define SFM_SIFT_BATCH_HEADER
+
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "util/thread_pool.h"
+#include "core/image.h"
+#include "features/defines.h"
+#include "features/sift.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+/**
+ * Asynchronous SIFT extraction for a stream of images.
+ *
+ * Images are submitted one by one and processed concurrently on the tasks
+ * of a thread pool, and the results are returned as futures. The caller,
+ * e.g. with core::image::ImageLoader, decodes the next images and consumes
+ * the finished results while others are processed. Every concurrent image
+ * uses one of a set of recycled Sift instances, which keep their pyramid
+ * storage for images of the same size. The number of images in flight is
+ * bounded: submit() blocks while all instances are busy, which keeps the
+ * memory of the pyramids in bounds. The results are identical to the ones
+ * of Sift for every image. Exceptions of SIFT are rethrown by the futures.
+ * The destructor waits for all submitted images.
+ */
+class SiftBatch
+{
+public:
+    /** Options for the batch. */
+    struct Options
+    {
+        Options (void);
+
+        /** The SIFT options for all images. */
+        Sift::Options sift_options;
+        /**
+         * The maximum number of images in flight, 0 uses the number of
+         * workers of the pool.
+         */
+        std::size_t max_in_flight;
+    };
+
+    /** The keypoints and descriptors of an image. */
+    struct Result
+    {
+        Sift::Keypoints keypoints;
+        Sift::Descriptors descriptors;
+    };
+
+public:
+    explicit SiftBatch (Options const& options,
+        util::ThreadPool& pool = util::ThreadPool::get_global());
+    ~SiftBatch (void);
+    SiftBatch (SiftBatch const& other) = delete;
+    SiftBatch& operator= (SiftBatch const& other) = delete;
+
+    /** Queues the image, blocks while the maximum is in flight. */
+    std::future<Result> submit (core::ByteImage::ConstPtr image);
+    /** Queues the float image, blocks while the maximum is in flight. */
+    std::future<Result> submit (core::FloatImage::ConstPtr image);
+
+    /** Waits until all submitted images are processed. */
+    void wait (void);
+
+private:
+    std::future<Result> enqueue (core::ByteImage::ConstPtr byte_image,
+        core::FloatImage::ConstPtr float_image);
+    std::unique_ptr<Sift> acquire (void);
+    void release (std::unique_ptr<Sift> sift);
+
+private:
+    Options opts;
+    util::ThreadPool& pool;
+    std::size_t max_in_flight;
+    std::size_t num_in_flight;
+    std::vector<std::unique_ptr<Sift> > idle;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+SiftBatch::Options::Options (void)
+    : max_in_flight(0)
+{
+}
+
+inline std::future<SiftBatch::Result>
+SiftBatch::submit (core::ByteImage::ConstPtr image)
+{
+    return this->enqueue(image, core::FloatImage::ConstPtr());
+}
+
+inline std::future<SiftBatch::Result>
+SiftBatch::submit (core::FloatImage::ConstPtr image)
+{
+    return this->enqueue(core::ByteImage::ConstPtr(), image);
+}
+
+FEATURES_NAMESPACE_END
+
+#endif /* SFM_SIFT_BATCH_HEADER */
@@ -7,8 +7,19 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#   include <immintrin.h>
+#endif
+
+#include "util/profiler.h"
+#include "util/thread_pool.h"
 #include "util/timer.h"
 #include "math/functions.h"
 #include "math/vector.h"
@@ -32,6 +43,169 @@ namespace
         {  9, 17, 25, 33 },  // 27  51  75  99
         { 17, 33, 49, 65 }   // 51  99 147 195
     };
+
+    /* Number of response map rows processed as one unit in detection. */
+    int const DETECTION_BAND_SIZE = 64;
+
+    /* Number of keypoints processed as one unit in localization/descriptors. */
+    int const KEYPOINT_CHUNK_SIZE = 256;
+
+    /*
+     * SAT offsets of the Dxx, Dyy and Dxy box filters relative to the
+     * filter center for filter size 'fs'. See Surf::filter_dxx() and
+     * friends for the scalar implementation of the filters.
+     */
+    struct BoxFilterOffsets
+    {
+        int dxx[8];
+        int dyy[8];
+        int dxy[16];
+    };
+
+    BoxFilterOffsets
+    get_box_filter_offsets (int fs, int w)
+    {
+        BoxFilterOffsets bfo;
+        int const fs2 = fs / 2;
+
+        int const xx_row1 = -fs - fs2 - 1 - w * fs;
+        int const xx_row2 = xx_row1 + w * (fs + fs - 1);
+        for (int i = 0; i < 4; ++i)
+        {
+            bfo.dxx[i] = xx_row1 + i * fs;
+            bfo.dxx[i + 4] = xx_row2 + i * fs;
+        }
+
+        int const yy_row1 = -fs - w * (fs + fs2 + 1);
+        for (int i = 0; i < 4; ++i)
+        {
+            bfo.dyy[i] = yy_row1 + i * w * fs;
+            bfo.dyy[i + 4] = bfo.dyy[i] + fs + fs - 1;
+        }
+
+        int const xy_row1 = -fs - 1 - w * (fs + 1);
+        int const xy_row2 = xy_row1 + w * fs;
+        int const xy_row3 = xy_row2 + w;
+        int const xy_row4 = xy_row3 + w * fs;
+        int const xy_rows[4][2] = { { xy_row1, xy_row2 },
+            { xy_row1 + fs + 1, xy_row2 + fs + 1 }, { xy_row3, xy_row4 },
+            { xy_row3 + fs + 1, xy_row4 + fs + 1 } };
+        for (int i = 0; i < 4; ++i)
+        {
+            bfo.dxy[i * 4 + 0] = xy_rows[i][0];
+            bfo.dxy[i * 4 + 1] = xy_rows[i][0] + fs;
+            bfo.dxy[i * 4 + 2] = xy_rows[i][1];
+            bfo.dxy[i * 4 + 3] = xy_rows[i][1] + fs;
+        }
+        return bfo;
+    }
+
+#if defined(__SSE2__)
+    /*
+     * Computes the Hessian response for four subsequent samples with
+     * spacing 'step', centered at 'sat' in the SAT. Since the SAT values
+     * are exact integers, the box sums are exact and the result equals the
+     * scalar code, which converts the box sums to float before weighting.
+     */
+    inline __m128
+    hessian_response_4 (double const* sat, int step,
+        BoxFilterOffsets const& bfo, float inv_karea, float weight)
+    {
+        __m128 box[3];
+# if defined(__AVX__)
+#   define LOAD_SAMPLES(OFF) (step == 1 ? _mm256_loadu_pd(sat + (OFF)) \
+        : _mm256_set_pd(sat[(OFF) + 3 * step], sat[(OFF) + 2 * step], \
+        sat[(OFF) + step], sat[OFF]))
+        __m256d v[16];
+        for (int i = 0; i < 8; ++i)
+            v[i] = LOAD_SAMPLES(bfo.dxx[i]);
+        __m256d dxx = _mm256_sub_pd(_mm256_add_pd(v[5], v[0]),
+            _mm256_add_pd(v[4], v[1]));
+        __m256d tmp = _mm256_sub_pd(_mm256_add_pd(v[6], v[1]),
+            _mm256_add_pd(v[5], v[2]));
+        dxx = _mm256_sub_pd(dxx, _mm256_add_pd(tmp, tmp));
+        dxx = _mm256_add_pd(dxx, _mm256_sub_pd(_mm256_add_pd(v[7], v[2]),
+            _mm256_add_pd(v[6], v[3])));
+
+        for (int i = 0; i < 8; ++i)
+            v[i] = LOAD_SAMPLES(bfo.dyy[i]);
+        __m256d dyy = _mm256_sub_pd(_mm256_add_pd(v[5], v[0]),
+            _mm256_add_pd(v[1], v[4]));
+        tmp = _mm256_sub_pd(_mm256_add_pd(v[6], v[1]),
+            _mm256_add_pd(v[2], v[5]));
+        dyy = _mm256_sub_pd(dyy, _mm256_add_pd(tmp, tmp));
+        dyy = _mm256_add_pd(dyy, _mm256_sub_pd(_mm256_add_pd(v[7], v[2]),
+            _mm256_add_pd(v[3], v[6])));
+
+        for (int i = 0; i < 16; ++i)
+            v[i] = LOAD_SAMPLES(bfo.dxy[i]);
+        __m256d dxy[4];
+        for (int i = 0; i < 4; ++i)
+            dxy[i] = _mm256_sub_pd(_mm256_add_pd(v[i * 4 + 3], v[i * 4 + 0]),
+                _mm256_add_pd(v[i * 4 + 2], v[i * 4 + 1]));
+        __m256d dxy_sum = _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(
+            dxy[0], dxy[1]), dxy[2]), dxy[3]);
+#   undef LOAD_SAMPLES
+
+        box[0] = _mm256_cvtpd_ps(dxx);
+        box[1] = _mm256_cvtpd_ps(dyy);
+        box[2] = _mm256_cvtpd_ps(dxy_sum);
+# else
+        /* Two halves with two samples each. */
+        __m128d half[2][3];
+        for (int h = 0; h < 2; ++h)
+        {
+            double const* ptr = sat + 2 * h * step;
+#   define LOAD_SAMPLES(OFF) (step == 1 ? _mm_loadu_pd(ptr + (OFF)) \
+        : _mm_set_pd(ptr[(OFF) + step], ptr[OFF]))
+            __m128d v[16];
+            for (int i = 0; i < 8; ++i)
+                v[i] = LOAD_SAMPLES(bfo.dxx[i]);
+            __m128d dxx = _mm_sub_pd(_mm_add_pd(v[5], v[0]),
+                _mm_add_pd(v[4], v[1]));
+            __m128d tmp = _mm_sub_pd(_mm_add_pd(v[6], v[1]),
+                _mm_add_pd(v[5], v[2]));
+            dxx = _mm_sub_pd(dxx, _mm_add_pd(tmp, tmp));
+            dxx = _mm_add_pd(dxx, _mm_sub_pd(_mm_add_pd(v[7], v[2]),
+                _mm_add_pd(v[6], v[3])));
+
+            for (int i = 0; i < 8; ++i)
+                v[i] = LOAD_SAMPLES(bfo.dyy[i]);
+            __m128d dyy = _mm_sub_pd(_mm_add_pd(v[5], v[0]),
+                _mm_add_pd(v[1], v[4]));
+            tmp = _mm_sub_pd(_mm_add_pd(v[6], v[1]),
+                _mm_add_pd(v[2], v[5]));
+            dyy = _mm_sub_pd(dyy, _mm_add_pd(tmp, tmp));
+            dyy = _mm_add_pd(dyy, _mm_sub_pd(_mm_add_pd(v[7], v[2]),
+                _mm_add_pd(v[3], v[6])));
+
+            for (int i = 0; i < 16; ++i)
+                v[i] = LOAD_SAMPLES(bfo.dxy[i]);
+            __m128d dxy[4];
+            for (int i = 0; i < 4; ++i)
+                dxy[i] = _mm_sub_pd(_mm_add_pd(v[i * 4 + 3], v[i * 4 + 0]),
+                    _mm_add_pd(v[i * 4 + 2], v[i * 4 + 1]));
+#   undef LOAD_SAMPLES
+
+            half[h][0] = dxx;
+            half[h][1] = dyy;
+            half[h][2] = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(
+                dxy[0], dxy[1]), dxy[2]), dxy[3]);
+        }
+        for (int i = 0; i < 3; ++i)
+            box[i] = _mm_movelh_ps(_mm_cvtpd_ps(half[0][i]),
+                _mm_cvtpd_ps(half[1][i]));
+# endif
+
+        __m128 const karea = _mm_set1_ps(inv_karea);
+        __m128 const dxx_t = _mm_mul_ps(box[0], karea);
+        __m128 const dyy_t = _mm_mul_ps(box[1], karea);
+        __m128 const dxy_t = _mm_mul_ps(box[2], karea);
+        return _mm_sub_ps(_mm_mul_ps(dxx_t, dyy_t), _mm_mul_ps(_mm_mul_ps(
+            _mm_set1_ps(weight), dxy_t), dxy_t));
+    }
+#endif
+
 }  // namespace
 
 /* ---------------------------------------------------------------- */
@@ -48,6 +222,7 @@ Surf::Surf (Options const& options)
 void
 Surf::process (void)
 {
+    UTIL_PROFILE_SCOPE("Surf::process");
     this->keypoints.clear();
     this->descriptors.clear();
     this->octaves.clear();
@@ -130,6 +305,14 @@ Surf::set_image (core::ByteImage::ConstPtr image)
         image = core::image::desaturate<uint8_t>(image,
             core::image::DESATURATE_LIGHTNESS);
 
+    /*
+     * The response maps of the previous image are recycled only if the
+     * new image has the same dimensions.
+     */
+    if (this->sat != nullptr && (this->sat->width() != image->width()
+        || this->sat->height() != image->height()))
+        this->image_pool.clear();
+
     /* Build summed area table (SAT). */
     //util::WallTimer timer;
     this->sat = core::image::integral_image<uint8_t,SatType>(image);
@@ -142,15 +325,22 @@ Surf::set_image (core::ByteImage::ConstPtr image)
 void
 Surf::create_octaves (void)
 {
+    UTIL_PROFILE_SCOPE("Surf::create_octaves");
     /* Prepare octaves. */
     this->octaves.resize(4);
     for (int i = 0; i < 4; ++i)
         this->octaves[i].imgs.resize(4);
 
-    /* Create octaves. */
-    for (int octave = 0; octave < 4; ++octave)
-        for (int sample = 0; sample < 4; ++sample)
-            this->create_response_map(octave, sample);
+    /*
+     * Create octaves. All response maps only depend on the SAT and are
+     * computed independently. The large maps of the first octaves are
+     * scheduled first.
+     */
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int i = 0; i < 16; ++i)
+        this->create_response_map(i / 4, i % 4);
 }
 
 /* ---------------------------------------------------------------- */
@@ -190,8 +380,11 @@ Surf::create_response_map (int o, int k)
     }
 
     /* Generate the response maps. */
-    Octave::RespImage::Ptr img = Octave::RespImage::create(ow, oh, 1);
+    Octave::RespImage::Ptr img = this->image_pool.acquire(ow, oh, 1);
     int const border = fs + fs / 2 + 1;
+#if defined(__SSE2__)
+    BoxFilterOffsets const bfo = get_box_filter_offsets(fs, w);
+#endif
     for (int y = 0, i = 0; y < h; y += step)
         for (int x = 0; x < w; x += step, ++i)
         {
@@ -201,6 +394,19 @@ Surf::create_response_map (int o, int k)
                 continue;
             }
 
+#if defined(__SSE2__)
+            /* Process four samples at once if all are inside the border. */
+            if (x + 3 * step + border < w)
+            {
+                _mm_storeu_ps(&img->at(i), hessian_response_4(
+                    this->sat->get_data_pointer() + y * w + x, step, bfo,
+                    inv_karea, weight));
+                x += 3 * step;
+                i += 3;
+                continue;
+            }
+#endif
+
             SatType dxx = this->filter_dxx(fs, x, y);
             SatType dyy = this->filter_dyy(fs, x, y);
             SatType dxy = this->filter_dxy(fs, x, y);
@@ -310,31 +516,67 @@ Surf::filter_dxy (int fs, int x, int y)
 void
 Surf::extrema_detection (void)
 {
+    UTIL_PROFILE_SCOPE("Surf::extrema_detection");
     /*
      * At this stage each octave contains 4 scale space samples and local
      * maxima/minima in the approximated DoG function need to be found.
      * To this end, a simple non-maximum suppression technique is applied.
+     *
+     * The samples are split into bands of rows. Every band writes its own
+     * list of keypoints, which are concatenated in band order afterwards.
+     * This makes the result independent of the number of threads.
      */
+    struct Band
+    {
+        int octave;
+        int sample;
+        int y_begin;
+        int y_end;
+    };
+    std::vector<Band> bands;
     for (std::size_t o = 0; o < this->octaves.size(); ++o)
     {
-        int const width = this->octaves[o].imgs[0]->width();
         int const height = this->octaves[o].imgs[0]->height();
-        for (std::size_t s = 1; s < 3; ++s)
-        {
-            Octave::RespImage::ConstPtr ss = this->octaves[o].imgs[s];
-            Octave::RespType const* ptr = &ss->at(0);
-            for (int y = 0; y < height; ++y, ptr += width)
-                for (int x = 1; x + 1 < width; ++x)
-                    if (ptr[x] > ptr[x-1] && ptr[x] > ptr[x + 1])
-                        this->check_maximum(o, s, x, y);
-        }
+        for (int s = 1; s < 3; ++s)
+            for (int y = 0; y < height; y += DETECTION_BAND_SIZE)
+            {
+                Band band;
+                band.octave = static_cast<int>(o);
+                band.sample = s;
+                band.y_begin = y;
+                band.y_end = std::min(height, y + DETECTION_BAND_SIZE);
+                bands.push_back(band);
+            }
+    }
+
+    std::vector<Keypoints> results(bands.size());
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+    int const num_bands = static_cast<int>(bands.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int i = 0; i < num_bands; ++i)
+    {
+        Band const& band = bands[i];
+        Octave::RespImage::ConstPtr ss
+            = this->octaves[band.octave].imgs[band.sample];
+        int const width = ss->width();
+        Octave::RespType const* ptr = &ss->at(0) + band.y_begin * width;
+        for (int y = band.y_begin; y < band.y_end; ++y, ptr += width)
+            for (int x = 1; x + 1 < width; ++x)
+                if (ptr[x] > ptr[x-1] && ptr[x] > ptr[x + 1])
+                    this->check_maximum(band.octave, band.sample, x, y,
+                        &results[i]);
     }
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+        this->keypoints.insert(this->keypoints.end(),
+            results[i].begin(), results[i].end());
 }
 
 /* ---------------------------------------------------------------- */
 
 void
-Surf::check_maximum(int o, int s, int x, int y)
+Surf::check_maximum (int o, int s, int x, int y, Keypoints* result)
 {
     /*
      * Assumes that given coordinates are within bounds and a 1 pixel
@@ -370,7 +612,7 @@ Surf::check_maximum(int o, int s, int x, int y)
     kp.sample = static_cast<float>(s);
     kp.x = static_cast<float>(x);
     kp.y = static_cast<float>(y);
-    this->keypoints.push_back(kp);
+    result->push_back(kp);
 }
 
 /* ---------------------------------------------------------------- */
@@ -378,16 +620,35 @@ Surf::check_maximum(int o, int s, int x, int y)
 void
 Surf::keypoint_localization_and_filtering (void)
 {
-    Keypoints filtered_keypoints;
-    filtered_keypoints.reserve(this->keypoints.size());
-    for (std::size_t i = 0; i < this->keypoints.size(); ++i)
+    UTIL_PROFILE_SCOPE("Surf::keypoint_localization");
+    /* Keypoints are localized in chunks, each chunk is filtered in place. */
+    int const num_chunks = static_cast<int>((this->keypoints.size()
+        + KEYPOINT_CHUNK_SIZE - 1) / KEYPOINT_CHUNK_SIZE);
+    std::vector<Keypoints> results(num_chunks);
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int c = 0; c < num_chunks; ++c)
     {
-        Keypoint kp = this->keypoints[i];
-        bool solve_good = this->keypoint_localization(&kp);
-        if (!solve_good)
-            continue;
-        filtered_keypoints.push_back(kp);
+        std::size_t const begin = static_cast<std::size_t>(c)
+            * KEYPOINT_CHUNK_SIZE;
+        std::size_t const end = std::min(this->keypoints.size(),
+            begin + KEYPOINT_CHUNK_SIZE);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            Keypoint kp = this->keypoints[i];
+            bool solve_good = this->keypoint_localization(&kp);
+            if (!solve_good)
+                continue;
+            results[c].push_back(kp);
+        }
     }
+
+    Keypoints filtered_keypoints;
+    filtered_keypoints.reserve(this->keypoints.size());
+    for (int c = 0; c < num_chunks; ++c)
+        filtered_keypoints.insert(filtered_keypoints.end(),
+            results[c].begin(), results[c].end());
     std::swap(this->keypoints, filtered_keypoints);
 }
 
@@ -478,36 +739,63 @@ Surf::keypoint_localization (Keypoint* kp)
 void
 Surf::descriptor_assignment (void)
 {
+    UTIL_PROFILE_SCOPE("Surf::descriptor_assignment");
     this->descriptors.clear();
     this->descriptors.reserve(keypoints.size());
-    for (std::size_t i = 0; i < this->keypoints.size(); ++i)
+
+    /*
+     * Keypoints are processed in chunks. Every chunk writes its own list
+     * of descriptors, the lists are concatenated in keypoint order.
+     */
+    int const num_chunks = static_cast<int>((this->keypoints.size()
+        + KEYPOINT_CHUNK_SIZE - 1) / KEYPOINT_CHUNK_SIZE);
+    std::vector<Descriptors> results(num_chunks);
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->options.num_threads);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int c = 0; c < num_chunks; ++c)
     {
-        Keypoint const& kp = this->keypoints[i];
-
-        /* Copy over the basic information to the descriptor. */
-        Descriptor descr;
-        descr.x = kp.x;
-        descr.y = kp.y;
-
-        /*
-         * The scale is obtained from the filter size. The smallest filter in
-         * SURF has size 9 and corresponds to a scale of 1.2. Thus, the
-         * scale of a filter with size X has a scale of X * 1.2 / 9.
-         */
-        int sample = static_cast<int>(kp.sample + 0.5f);
-        descr.scale = 3 * kernel_sizes[kp.octave][sample] * 1.2f / 9.0f;
-
-        /* Find the orientation of the keypoint. */
-        if (!this->descriptor_orientation(&descr))
-            continue;
-
-        /* Compute descriptor relative to orientation. */
-        if (!this->descriptor_computation(&descr,
-            this->options.use_upright_descriptor))
-            continue;
-
-        this->descriptors.push_back(descr);
+        std::size_t const begin = static_cast<std::size_t>(c)
+            * KEYPOINT_CHUNK_SIZE;
+        std::size_t const end = std::min(this->keypoints.size(),
+            begin + KEYPOINT_CHUNK_SIZE);
+        for (std::size_t i = begin; i < end; ++i)
+            this->descriptor_assignment(this->keypoints[i], &results[c]);
     }
+
+    for (int c = 0; c < num_chunks; ++c)
+        this->descriptors.insert(this->descriptors.end(),
+            results[c].begin(), results[c].end());
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Surf::descriptor_assignment (Keypoint const& kp, Descriptors* result)
+{
+    /* Copy over the basic information to the descriptor. */
+    Descriptor descr;
+    descr.x = kp.x;
+    descr.y = kp.y;
+
+    /*
+     * The scale is obtained from the filter size. The smallest filter in
+     * SURF has size 9 and corresponds to a scale of 1.2. Thus, the
+     * scale of a filter with size X has a scale of X * 1.2 / 9.
+     */
+    int sample = static_cast<int>(kp.sample + 0.5f);
+    descr.scale = 3 * kernel_sizes[kp.octave][sample] * 1.2f / 9.0f;
+
+    /* Find the orientation of the keypoint. */
+    if (!this->descriptor_orientation(&descr))
+        return;
+
+    /* Compute descriptor relative to orientation. */
+    if (!this->descriptor_computation(&descr,
+        this->options.use_upright_descriptor))
+        return;
+
+    result->push_back(descr);
 }
 
 /* ---------------------------------------------------------------- */
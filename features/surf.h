@@ -19,8 +19,10 @@
 #include <sys/types.h>
 #include <vector>
 
+#include "util/memory.h"
 #include "math/vector.h"
 #include "core/image.h"
+#include "core/image_pool.h"
 
 #include "features/defines.h"
 
@@ -35,7 +37,9 @@ FEATURES_NAMESPACE_BEGIN
  * Since SURF relies on summed area tables (SAT), it can currently only
  * be used with integer images, in particular byte images. For floating
  * point data types, SATs may be inaccurate due to possible large values
- * in the lower-right region of the SAT.
+ * in the lower-right region of the SAT. The SAT of byte images is stored
+ * in double precision, which represents the sums exactly for images with
+ * less than 2^53 / 255 pixels and allows vectorized box filters.
  */
 class Surf
 {
@@ -53,6 +57,17 @@ public:
         /** Trade rotation invariance for speed. Defaults to false. */
         bool use_upright_descriptor;
 
+        /**
+         * Sets the number of threads for the response map construction,
+         * the extrema detection, the keypoint localization and the
+         * descriptor computation. Defaults to 1, which processes everything
+         * serially. A value of 0 uses the process-wide thread count of
+         * util::ThreadPool, or 1 within other parallel stages. The result
+         * is identical for any number of threads. This requires OpenMP,
+         * otherwise processing is always serial.
+         */
+        int num_threads;
+
         /**
          * Produce status messages on the console.
          */
@@ -96,7 +111,8 @@ public:
 
 public:
     typedef std::vector<Keypoint> Keypoints;
-    typedef std::vector<Descriptor> Descriptors;
+    typedef util::TrackedVector<Descriptor, util::MEMORY_FEATURES>
+        Descriptors;
 
 public:
     explicit Surf (Options const& options);
@@ -125,7 +141,7 @@ protected:
     };
 
 protected:
-    typedef int64_t SatType; ///< Signed type for the SAT image values
+    typedef double SatType; ///< SAT value type, exact for sums below 2^53
     typedef core::Image<SatType> SatImage; ///< SAT image type
     typedef std::vector<Octave> Octaves;
 
@@ -138,12 +154,13 @@ protected:
     SatType filter_dxy (int fs, int x, int y);
 
     void extrema_detection (void);
-    void check_maximum (int o, int s, int x, int y);
+    void check_maximum (int o, int s, int x, int y, Keypoints* result);
 
     void keypoint_localization_and_filtering (void);
     bool keypoint_localization (Surf::Keypoint* kp);
 
     void descriptor_assignment (void);
+    void descriptor_assignment (Keypoint const& kp, Descriptors* result);
     bool descriptor_orientation (Descriptor* descr);
     bool descriptor_computation (Descriptor* descr, bool upright);
     void filter_dx_dy(int x, int y, int fs, float* dx, float* dy);
@@ -154,6 +171,7 @@ private:
     Octaves octaves;
     Keypoints keypoints;
     Descriptors descriptors;
+    core::ImagePool<Octave::RespType> image_pool;
 };
 
 /* ---------------------------------------------------------------- */
@@ -162,6 +180,7 @@ inline
 Surf::Options::Options (void)
     : contrast_threshold(500.0f)
     , use_upright_descriptor(false)
+    , num_threads(1)
     , verbose_output(false)
     , debug_output(false)
 {
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include "features/vocabulary_tree.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+namespace
+{
+    float
+    square_distance (math::Vec128f const& a, math::Vec128f const& b)
+    {
+        float dist = 0.0f;
+        for (int i = 0; i < 128; ++i)
+        {
+            float const diff = a[i] - b[i];
+            dist += diff * diff;
+        }
+        return dist;
+    }
+
+    int
+    nearest_center (math::Vec128f const& descr,
+        math::Vec128f const* centers, int num_centers)
+    {
+        int best_center = 0;
+        float best_dist = std::numeric_limits<float>::max();
+        for (int i = 0; i < num_centers; ++i)
+        {
+            float const dist = square_distance(descr, centers[i]);
+            if (dist < best_dist)
+            {
+                best_dist = dist;
+                best_center = i;
+            }
+        }
+        return best_center;
+    }
+
+    /**
+     * Clusters the given members of the descriptors into k centers and
+     * assigns the index of the nearest center to each member. If there are
+     * no more members than centers, every member becomes a center.
+     */
+    void
+    kmeans (Sift::Descriptors const& descriptors,
+        std::vector<int> const& members, int k, int max_iterations,
+        unsigned int seed, math::Vec128f* centers, std::vector<int>* labels)
+    {
+        std::size_t const num_members = members.size();
+        labels->assign(num_members, 0);
+        if (num_members == 0)
+        {
+            std::fill(centers, centers + k, math::Vec128f(0.0f));
+            return;
+        }
+
+        if (num_members <= static_cast<std::size_t>(k))
+        {
+            for (int i = 0; i < k; ++i)
+                centers[i] = descriptors[members[i % num_members]].data;
+            for (std::size_t i = 0; i < num_members; ++i)
+                labels->at(i) = static_cast<int>(i);
+            return;
+        }
+
+        /* Initialize the centers with distinct random members. */
+        std::vector<int> shuffled(members);
+        std::mt19937 prng(seed);
+        for (int i = 0; i < k; ++i)
+        {
+            std::uniform_int_distribution<std::size_t> dist(i, num_members - 1);
+            std::swap(shuffled[i], shuffled[dist(prng)]);
+            centers[i] = descriptors[shuffled[i]].data;
+        }
+
+        std::vector<math::Vec128f> sums(k);
+        std::vector<int> counts(k);
+        for (int iter = 0; iter < max_iterations; ++iter)
+        {
+            /* Assign members to the nearest center. */
+            bool changed = (iter == 0);
+            for (std::size_t i = 0; i < num_members; ++i)
+            {
+                int const label = nearest_center
+                    (descriptors[members[i]].data, centers, k);
+                changed = changed || label != labels->at(i);
+                labels->at(i) = label;
+            }
+            if (!changed)
+                break;
+
+            /* Update centers, empty clusters keep their previous center. */
+            std::fill(sums.begin(), sums.end(), math::Vec128f(0.0f));
+            std::fill(counts.begin(), counts.end(), 0);
+            for (std::size_t i = 0; i < num_members; ++i)
+            {
+                sums[labels->at(i)] += descriptors[members[i]].data;
+                counts[labels->at(i)] += 1;
+            }
+            for (int i = 0; i < k; ++i)
+                if (counts[i] > 0)
+                    centers[i] = sums[i] / static_cast<float>(counts[i]);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+VocabularyTree::VocabularyTree (Options const& options)
+    : opts(options)
+    , num_words(0)
+    , num_images(0)
+{
+    if (this->opts.branching_factor < 2 || this->opts.num_levels < 1)
+        throw std::invalid_argument("Invalid vocabulary tree dimensions");
+
+    /* The level offsets index the centers of the levels 1 to L. */
+    std::size_t level_size = 1;
+    this->level_offsets.push_back(0);
+    for (int i = 0; i < this->opts.num_levels; ++i)
+    {
+        level_size *= this->opts.branching_factor;
+        if (level_size > static_cast<std::size_t>
+            (std::numeric_limits<int>::max()))
+            throw std::invalid_argument("Too many vocabulary tree words");
+        this->level_offsets.push_back(this->level_offsets.back() + level_size);
+    }
+    this->num_words = static_cast<int>(level_size);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+VocabularyTree::train (Sift::Descriptors const& descriptors)
+{
+    if (descriptors.empty())
+        throw std::invalid_argument("No training descriptors given");
+
+    int const k = this->opts.branching_factor;
+    this->centers.resize(this->level_offsets.back());
+    this->num_images = 0;
+    this->idf_weights.clear();
+    this->inverted_files.clear();
+    this->inverted_files.resize(this->num_words);
+
+    /* The node of each descriptor on the current level. */
+    std::vector<int> nodes(descriptors.size(), 0);
+    std::size_t level_size = 1;
+    for (int level = 0; level < this->opts.num_levels; ++level)
+    {
+        std::vector<std::vector<int> > members(level_size);
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+            members[nodes[i]].push_back(static_cast<int>(i));
+
+        /* The seed only depends on the node, results are thread-independent. */
+        math::Vec128f* level_centers
+            = this->centers.data() + this->level_offsets[level];
+#pragma omp parallel for schedule(dynamic)
+        for (std::size_t node = 0; node < level_size; ++node)
+        {
+            std::vector<int> labels;
+            unsigned int const seed = this->opts.seed
+                + static_cast<unsigned int>(this->level_offsets[level] + node);
+            kmeans(descriptors, members[node], k,
+                this->opts.max_kmeans_iterations, seed,
+                level_centers + node * k, &labels);
+            for (std::size_t i = 0; i < labels.size(); ++i)
+                nodes[members[node][i]] = static_cast<int>(node) * k + labels[i];
+        }
+        level_size *= k;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+VocabularyTree::quantize (math::Vec128f const& descriptor) const
+{
+    if (this->centers.empty())
+        throw std::runtime_error("Vocabulary tree not trained");
+
+    int const k = this->opts.branching_factor;
+    int node = 0;
+    for (int level = 0; level < this->opts.num_levels; ++level)
+    {
+        math::Vec128f const* children = this->centers.data()
+            + this->level_offsets[level] + static_cast<std::size_t>(node) * k;
+        node = node * k + nearest_center(descriptor, children, k);
+    }
+    return node;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+VocabularyTree::compute_histogram (Sift::Descriptors const& descriptors,
+    WordHistogram* histogram) const
+{
+    histogram->clear();
+    if (descriptors.empty())
+        return;
+
+    std::vector<int> words(descriptors.size());
+    for (std::size_t i = 0; i < descriptors.size(); ++i)
+        words[i] = this->quantize(descriptors[i].data);
+    std::sort(words.begin(), words.end());
+
+    /* Run-length encode the words to term frequencies. */
+    float const inv_num_words = 1.0f / static_cast<float>(words.size());
+    for (std::size_t i = 0; i < words.size();)
+    {
+        std::size_t j = i + 1;
+        while (j < words.size() && words[j] == words[i])
+            j += 1;
+        histogram->push_back(std::make_pair(words[i],
+            static_cast<float>(j - i) * inv_num_words));
+        i = j;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+VocabularyTree::add_image (Sift::Descriptors const& descriptors)
+{
+    WordHistogram histogram;
+    this->compute_histogram(descriptors, &histogram);
+
+    int const image_id = this->num_images;
+    for (std::size_t i = 0; i < histogram.size(); ++i)
+    {
+        Posting posting;
+        posting.image_id = image_id;
+        posting.frequency = histogram[i].second;
+        posting.weight = 0.0f;
+        this->inverted_files[histogram[i].first].push_back(posting);
+    }
+    this->num_images += 1;
+    return image_id;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+VocabularyTree::compute_weights (void)
+{
+    /* The inverse document frequency of each word. */
+    this->idf_weights.resize(this->num_words);
+    float const num_images = static_cast<float>(this->num_images);
+    for (int i = 0; i < this->num_words; ++i)
+    {
+        std::size_t const df = this->inverted_files[i].size();
+        this->idf_weights[i] = df == 0 ? 0.0f
+            : std::log(num_images / static_cast<float>(df));
+    }
+
+    /* Weight the term frequencies and normalize the image vectors. */
+    std::vector<float> square_norms(this->num_images, 0.0f);
+    for (int i = 0; i < this->num_words; ++i)
+    {
+        InvertedFile& file = this->inverted_files[i];
+        for (std::size_t j = 0; j < file.size(); ++j)
+        {
+            file[j].weight = file[j].frequency * this->idf_weights[i];
+            square_norms[file[j].image_id] += file[j].weight * file[j].weight;
+        }
+    }
+    for (int i = 0; i < this->num_words; ++i)
+    {
+        InvertedFile& file = this->inverted_files[i];
+        for (std::size_t j = 0; j < file.size(); ++j)
+        {
+            float const square_norm = square_norms[file[j].image_id];
+            if (square_norm > 0.0f)
+                file[j].weight /= std::sqrt(square_norm);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+VocabularyTree::query (Sift::Descriptors const& descriptors,
+    std::size_t num_results, QueryResults* results) const
+{
+    if (this->idf_weights.size() != static_cast<std::size_t>(this->num_words))
+        throw std::runtime_error("Vocabulary tree weights not computed");
+
+    results->clear();
+    WordHistogram histogram;
+    this->compute_histogram(descriptors, &histogram);
+
+    float square_norm = 0.0f;
+    for (std::size_t i = 0; i < histogram.size(); ++i)
+    {
+        histogram[i].second *= this->idf_weights[histogram[i].first];
+        square_norm += histogram[i].second * histogram[i].second;
+    }
+    if (square_norm == 0.0f)
+        return;
+
+    /* Accumulate the cosine similarity over the inverted files. */
+    float const inv_norm = 1.0f / std::sqrt(square_norm);
+    std::vector<float> scores(this->num_images, 0.0f);
+    for (std::size_t i = 0; i < histogram.size(); ++i)
+    {
+        float const weight = histogram[i].second * inv_norm;
+        InvertedFile const& file = this->inverted_files[histogram[i].first];
+        for (std::size_t j = 0; j < file.size(); ++j)
+            scores[file[j].image_id] += weight * file[j].weight;
+    }
+
+    for (int i = 0; i < this->num_images; ++i)
+    {
+        if (scores[i] <= 0.0f)
+            continue;
+        QueryResult result;
+        result.image_id = i;
+        result.score = scores[i];
+        results->push_back(result);
+    }
+
+    num_results = std::min(num_results, results->size());
+    std::partial_sort(results->begin(), results->begin() + num_results,
+        results->end());
+    results->resize(num_results);
+}
+
+FEATURES_NAMESPACE_END
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef FEATURES_VOCABULARY_TREE_HEADER
+#define FEATURES_VOCABULARY_TREE_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "math/vector.h"
+#include "features/defines.h"
+#include "features/sift.h"
+
+FEATURES_NAMESPACE_BEGIN
+
+/**
+ * Vocabulary tree for image retrieval with SIFT descriptors.
+ *
+ * The tree is trained with hierarchical k-means on a set of descriptors.
+ * Every image is represented as a bag of visual words (the leaves of the
+ * tree) and indexed in inverted files. Queries are scored by the cosine
+ * similarity of the tf-idf weighted word histograms.
+ *
+ * Usage: train() the tree, add_image() for all database images, then
+ * compute_weights() once before calling query().
+ *
+ * References:
+ * - "Scalable Recognition with a Vocabulary Tree", D. Nister and
+ *   H. Stewenius, CVPR 2006.
+ */
+class VocabularyTree
+{
+public:
+    struct Options
+    {
+        Options (void);
+
+        /** Number of children per node (k in k-means). */
+        int branching_factor;
+
+        /** Number of levels, the tree has branching^levels leaves. */
+        int num_levels;
+
+        /** Maximum number of Lloyd iterations per k-means clustering. */
+        int max_kmeans_iterations;
+
+        /** Seed for the initialization of the cluster centers. */
+        unsigned int seed;
+    };
+
+    /** A database image and its similarity to the query. */
+    struct QueryResult
+    {
+        int image_id;
+        float score;
+
+        /** Orders by decreasing score. */
+        bool operator< (QueryResult const& rhs) const;
+    };
+    typedef std::vector<QueryResult> QueryResults;
+
+public:
+    explicit VocabularyTree (Options const& options);
+
+    /** Builds the tree from the given training descriptors. */
+    void train (Sift::Descriptors const& descriptors);
+
+    /** Adds an image to the database and returns its ID. */
+    int add_image (Sift::Descriptors const& descriptors);
+
+    /** Computes the tf-idf weights of all images added so far. */
+    void compute_weights (void);
+
+    /**
+     * Returns the at most num_results database images with the highest
+     * scores for the given descriptors, sorted by decreasing score.
+     */
+    void query (Sift::Descriptors const& descriptors,
+        std::size_t num_results, QueryResults* results) const;
+
+    /** Returns the visual word (leaf index) of the descriptor. */
+    int quantize (math::Vec128f const& descriptor) const;
+
+    /** Returns the number of visual words. */
+    int get_num_words (void) const;
+
+    /** Returns the number of images in the database. */
+    int get_num_images (void) const;
+
+private:
+    /** A sorted list of (word, weight) pairs. */
+    typedef std::vector<std::pair<int, float> > WordHistogram;
+
+    struct Posting
+    {
+        int image_id;
+        /** The term frequency of the word in the image. */
+        float frequency;
+        /** The normalized tf-idf weight, set by compute_weights(). */
+        float weight;
+    };
+    typedef std::vector<Posting> InvertedFile;
+
+    void compute_histogram (Sift::Descriptors const& descriptors,
+        WordHistogram* histogram) const;
+
+private:
+    Options opts;
+    /** Cluster centers of all nodes in breadth-first order, without root. */
+    std::vector<math::Vec128f> centers;
+    std::vector<std::size_t> level_offsets;
+    int num_words;
+    int num_images;
+    std::vector<float> idf_weights;
+    std::vector<InvertedFile> inverted_files;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+VocabularyTree::Options::Options (void)
+    : branching_factor(10)
+    , num_levels(4)
+    , max_kmeans_iterations(10)
+    , seed(0)
+{
+}
+
+inline bool
+VocabularyTree::QueryResult::operator< (QueryResult const& rhs) const
+{
+    return this->score == rhs.score
+        ? this->image_id < rhs.image_id
+        : this->score > rhs.score;
+}
+
+inline int
+VocabularyTree::get_num_words (void) const
+{
+    return this->num_words;
+}
+
+inline int
+VocabularyTree::get_num_images (void) const
+{
+    return this->num_images;
+}
+
+FEATURES_NAMESPACE_END
+
+#endif /* FEATURES_VOCABULARY_TREE_HEADER */
@@ -220,6 +220,68 @@ MATH_NAMESPACE_END
 
 MATH_NAMESPACE_BEGIN
 
+MATH_INTERNAL_NAMESPACE_BEGIN
+
+/**
+ * The kernel of the product of the N x M matrix a and the M x U matrix b
+ * in row-major order, where a vector is an M x 1 matrix. The products with
+ * three and four columns in a, which includes all 3x3 and 4x4 matrix and
+ * matrix-vector products, are specialized and unrolled. These compute the
+ * rows of the result as sums of the scaled rows of b, which the compiler
+ * can vectorize, and sum the products in the order of the generic kernel.
+ */
+template <typename T, int N, int M, int U>
+struct MatrixMultiply
+{
+    static void mult (T* ret, T const* a, T const* b);
+};
+
+template <typename T, int N, int U>
+struct MatrixMultiply<T,N,3,U>
+{
+    static void mult (T* ret, T const* a, T const* b);
+};
+
+template <typename T, int N, int U>
+struct MatrixMultiply<T,N,4,U>
+{
+    static void mult (T* ret, T const* a, T const* b);
+};
+
+template <typename T, int N, int M, int U>
+inline void
+MatrixMultiply<T,N,M,U>::mult (T* ret, T const* a, T const* b)
+{
+    typedef algo::InterleavedIter<T,U> ColIter;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < U; ++j)
+            ret[U * i + j] = std::inner_product(a + M * i,
+                a + M * i + M, ColIter(b + j), T(0));
+}
+
+template <typename T, int N, int U>
+inline void
+MatrixMultiply<T,N,3,U>::mult (T* ret, T const* a, T const* b)
+{
+    for (int i = 0; i < N; ++i, a += 3, ret += U)
+        for (int j = 0; j < U; ++j)
+            ret[j] = a[0] * b[j] + a[1] * b[U + j] + a[2] * b[2 * U + j];
+}
+
+template <typename T, int N, int U>
+inline void
+MatrixMultiply<T,N,4,U>::mult (T* ret, T const* a, T const* b)
+{
+    for (int i = 0; i < N; ++i, a += 4, ret += U)
+        for (int j = 0; j < U; ++j)
+            ret[j] = a[0] * b[j] + a[1] * b[U + j] + a[2] * b[2 * U + j]
+                + a[3] * b[3 * U + j];
+}
+
+MATH_INTERNAL_NAMESPACE_END
+
+/* ---------------------------------------------------------------- */
+
 template <typename T, int N, int M>
 int constexpr Matrix<T,N,M>::rows;
 
@@ -461,12 +523,8 @@ template <int U>
 inline Matrix<T,N,U>
 Matrix<T,N,M>::mult (Matrix<T,M,U> const& rhs) const
 {
-    typedef algo::InterleavedIter<T,U> RowIter;
     Matrix<T,N,U> ret;
-    for (int i = 0; i < ret.rows; ++i)
-        for (int j = 0; j < ret.cols; ++j)
-            ret(i,j) = std::inner_product(m + M * i,
-                m + M * i + M, RowIter(*rhs + j), T(0));
+    internal::MatrixMultiply<T,N,M,U>::mult(*ret, m, *rhs);
     return ret;
 }
 
@@ -475,8 +533,7 @@ inline Vector<T,N>
 Matrix<T,N,M>::mult (Vector<T,M> const& rhs) const
 {
     Vector<T,N> ret;
-    for (int i = 0; i < N; ++i)
-        ret[i] = std::inner_product(m + M * i, m + M * i + M, *rhs, T(0));
+    internal::MatrixMultiply<T,N,M,1>::mult(*ret, m, *rhs);
     return ret;
 }
 
@@ -484,10 +541,9 @@ template <typename T, int N, int M>
 inline Vector<T,N-1>
 Matrix<T,N,M>::mult (Vector<T,M-1> const& rhs, T const& v) const
 {
+    Vector<T,M> const hom(rhs, v);
     Vector<T,N-1> ret;
-    for (int i = 0; i < N-1; ++i)
-        ret[i] = std::inner_product(m + M * i, m + M * i + M - 1, *rhs, T(0))
-            + v * m[M * i + M - 1];
+    internal::MatrixMultiply<T,N-1,M,1>::mult(*ret, m, *hom);
     return ret;
 }
 
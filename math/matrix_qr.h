@@ -10,9 +10,9 @@
 #ifndef MATH_MATRIX_QR_HEADER
 #define MATH_MATRIX_QR_HEADER
 
-#include <vector>
 #include <algorithm>
-#include <iostream>
+#include <cmath>
+#include <vector>
 
 #include "math/defines.h"
 #include "math/matrix.h"
@@ -21,10 +21,12 @@ MATH_NAMESPACE_BEGIN
 
 /**
  * Calculates a QR decomposition for a given matrix A. A is MxN,
- * Q is MxM and R is MxN. Uses Givens algorithm for computation.
+ * Q is MxM and R is MxN. Uses Householder reflections for computation.
+ * Q can be null, in which case Q is not formed, which saves the O(M^2 N)
+ * operations of forming Q for tall matrices.
  *
  * Reference:
- * - "Matrix Computations" by Gloub and Loan, 3rd Edition, page 227.
+ * - "Matrix Computations" by Gloub and Loan, 3rd Edition, page 224.
  */
 template <typename T>
 void
@@ -34,6 +36,7 @@ matrix_qr (T const* mat_a, int rows, int cols,
 /**
  * Matrix QR decomposition for compile-time fixed-size matrices. The
  * implementation uses the dynamic-size matrices interface in the background.
+ * Q can be null, in which case Q is not formed.
  */
 template <typename T, int M, int N>
 void
@@ -113,6 +116,118 @@ matrix_apply_givens_row (T* mat, int /*rows*/, int cols, int givens_i,
     }
 }
 
+/**
+ * Householder QR decomposition of A in-place. On return, the upper triangle
+ * of A holds R and the entries below the diagonal of column j hold the
+ * Householder vector v_j with the implicit leading entry 1, which
+ * defines the reflection H_j = I - tau_j v_j v_j^T with Q = H_0 ... H_k-1.
+ * The amount of reflections k = min(rows - 1, cols) is returned, and taus
+ * must hold min(rows, cols) values. Sub-columns with norm below epsilon
+ * are not reflected (tau = 0).
+ *
+ * The reflections are applied to the rows of the trailing submatrix, as
+ * w = v^T A and A = A - tau v w^T, which accesses row-major matrices in
+ * memory order.
+ */
+template <typename T>
+int
+matrix_householder_qr (T* mat_a, int rows, int cols, T* taus,
+    T const& epsilon)
+{
+    int const num_reflections = std::min(rows - 1, cols);
+    std::vector<T> w(cols);
+    for (int j = 0; j < num_reflections; ++j)
+    {
+        T* col = mat_a + j * cols + j;
+        T sigma(0);
+        for (int i = 1; i < rows - j; ++i)
+            sigma += MATH_POW2(col[i * cols]);
+        if (sigma <= epsilon * epsilon)
+        {
+            taus[j] = T(0);
+            continue;
+        }
+
+        /* The reflection maps the sub-column x to alpha e_1. */
+        T const x0 = col[0];
+        T const norm = std::sqrt(MATH_POW2(x0) + sigma);
+        T const alpha = x0 > T(0) ? -norm : norm;
+        T const scale = T(1) / (x0 - alpha);
+        for (int i = 1; i < rows - j; ++i)
+            col[i * cols] *= scale;
+        taus[j] = (alpha - x0) / alpha;
+        col[0] = alpha;
+
+        /* Apply the reflection to the trailing columns. */
+        int const width = cols - j - 1;
+        if (width == 0)
+            continue;
+        T* sub = col + 1;
+        std::copy(sub, sub + width, w.begin());
+        for (int i = 1; i < rows - j; ++i)
+        {
+            T const vi = col[i * cols];
+            T const* row = sub + i * cols;
+            for (int k = 0; k < width; ++k)
+                w[k] += vi * row[k];
+        }
+        for (int k = 0; k < width; ++k)
+            w[k] *= taus[j];
+        for (int k = 0; k < width; ++k)
+            sub[k] -= w[k];
+        for (int i = 1; i < rows - j; ++i)
+        {
+            T const vi = col[i * cols];
+            T* row = sub + i * cols;
+            for (int k = 0; k < width; ++k)
+                row[k] -= vi * w[k];
+        }
+    }
+    for (int j = num_reflections; j < std::min(rows, cols); ++j)
+        taus[j] = T(0);
+    return num_reflections;
+}
+
+/**
+ * Computes B = Q B in-place for the Q of matrix_householder_qr() with the
+ * factorization mat_qr of the rows x cols matrix and B of size rows x
+ * b_cols. The reflections are applied in reverse order.
+ */
+template <typename T>
+void
+matrix_householder_apply_q (T const* mat_qr, int rows, int cols,
+    T const* taus, T* mat_b, int b_cols)
+{
+    int const num_reflections = std::min(rows - 1, cols);
+    std::vector<T> w(b_cols);
+    for (int j = num_reflections - 1; j >= 0; --j)
+    {
+        if (taus[j] == T(0))
+            continue;
+        T const* v = mat_qr + j * cols + j;
+        T* sub = mat_b + j * b_cols;
+        std::copy(sub, sub + b_cols, w.begin());
+        for (int i = 1; i < rows - j; ++i)
+        {
+            T const vi = v[i * cols];
+            T const* row = sub + i * b_cols;
+            for (int k = 0; k < b_cols; ++k)
+                w[k] += vi * row[k];
+        }
+        for (int k = 0; k < b_cols; ++k)
+            w[k] *= taus[j];
+        for (int k = 0; k < b_cols; ++k)
+            sub[k] -= w[k];
+        for (int i = 1; i < rows - j; ++i)
+        {
+            T const vi = v[i * cols];
+            T* row = sub + i * b_cols;
+            for (int k = 0; k < b_cols; ++k)
+                row[k] -= vi * w[k];
+        }
+    }
+}
+
 MATH_INTERNAL_NAMESPACE_END
 MATH_NAMESPACE_END
 
@@ -125,46 +240,24 @@ void
 matrix_qr (T const* mat_a, int rows, int cols,
     T* mat_q, T* mat_r, T const& epsilon)
 {
-    /* Prepare Q and R: Copy A to R, init Q's diagonal. */
+    /* Factorize a copy of A in R, then clear the Householder vectors. */
     std::copy(mat_a, mat_a + rows * cols, mat_r);
-    std::fill(mat_q, mat_q + rows * rows, T(0));
-    for (int i = 0; i < rows; ++i)
-        mat_q[i * rows + i] = T(1);
+    std::vector<T> taus(std::max(1, std::min(rows, cols)));
+    internal::matrix_householder_qr(mat_r, rows, cols, &taus[0], epsilon);
 
-    std::vector<T> matrix_subset(2 * (cols + 1), T(0));
-    for (int j = 0; j < cols; ++j)
+    /* Form Q by applying the reflections to the identity. */
+    if (mat_q != nullptr)
     {
-        for (int i = rows - 1; i > j; --i)
-        {
-            T givens_c, givens_s;
-            internal::matrix_givens_rotation(mat_r[(i - 1) * cols + j],
-                mat_r[i * cols + j], &givens_c, &givens_s, epsilon);
-
-            int submatrix_width = cols - j;
-            for (int k = 0; k < submatrix_width; ++k)
-            {
-                matrix_subset[0 * submatrix_width + k] =
-                    mat_r[(i - 1) * cols + (j + k)];
-                matrix_subset[1 * submatrix_width + k] =
-                    mat_r[i * cols + (j + k)];
-            }
-
-            /* Only apply Givens rotation on a subblock of the matrix. */
-            for (int k = 0; k < (cols - j); ++k)
-            {
-                mat_r[(i - 1) * cols + (j + k)] =
-                    givens_c * matrix_subset[0 * submatrix_width + k] -
-                    givens_s * matrix_subset[1 * submatrix_width + k];
-                mat_r[i * cols + (j + k)] =
-                    givens_s * matrix_subset[0 * submatrix_width + k] +
-                    givens_c * matrix_subset[1 * submatrix_width + k];
-            }
-
-            /* Construct Q matrix by repeated Givens rotations. */
-            internal::matrix_apply_givens_column(mat_q, rows, rows, i - 1, i,
-                givens_c, givens_s);
-        }
+        std::fill(mat_q, mat_q + rows * rows, T(0));
+        for (int i = 0; i < rows; ++i)
+            mat_q[i * rows + i] = T(1);
+        internal::matrix_householder_apply_q(mat_r, rows, cols, &taus[0],
+            mat_q, rows);
     }
+
+    for (int i = 1; i < rows; ++i)
+        std::fill(mat_r + i * cols, mat_r + i * cols + std::min(i, cols),
+            T(0));
 }
 
 template <typename T, int M, int N>
@@ -172,7 +265,8 @@ void
 matrix_qr (Matrix<T, M, N> const& mat_a, Matrix<T, M, M>* mat_q,
     Matrix<T, M, N>* mat_r, T const& epsilon)
 {
-    matrix_qr(mat_a.begin(), M, N, mat_q->begin(), mat_r->begin(), epsilon);
+    matrix_qr(mat_a.begin(), M, N, mat_q ? mat_q->begin() : nullptr,
+        mat_r->begin(), epsilon);
 }
 
 MATH_NAMESPACE_END
@@ -20,6 +20,10 @@
 #ifndef MATH_MATRIX_SVD_HEADER
 #define MATH_MATRIX_SVD_HEADER
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
 #include <vector>
 
 #include "math/defines.h"
@@ -35,7 +39,8 @@ MATH_NAMESPACE_BEGIN
  * SVD for dynamic-size matrices A of size MxN (M rows, N columns).
  * The function decomposes input matrix A such that A = USV^T where
  * A is MxN, U is MxN, S is a N-vector and V is NxN.
- * Any of U, S or V can be null, however, this does not save operations.
+ * Any of U, S or V can be null, however, this only saves operations for
+ * the economy SVD, which does not compute U if it is null.
  *
  * Usually, M >= N, i.e. the input matrix has more rows than columns.
  * If M > 5/3 N, QR decomposition is used to do an economy SVD after Chan
@@ -63,6 +68,32 @@ matrix_svd (Matrix<T, M, N> const& mat_a, Matrix<T, M, N>* mat_u,
     Matrix<T, N, N>* mat_s, Matrix<T, N, N>* mat_v,
     T const& epsilon = T(MATH_SVD_DEFAULT_ZERO_THRESHOLD));
 
+/**
+ * SVD for 3x3 matrices, which is selected by overload resolution for
+ * fixed-size 3x3 matrices, e.g. for the rank constraints of fundamental and
+ * essential matrices. The decomposition uses Jacobi rotations of fixed
+ * size on the stack instead of the dynamic-size SVD, and the singular
+ * values are accurate to rounding, thus the epsilon is not used.
+ */
+template <typename T>
+void
+matrix_svd (Matrix<T, 3, 3> const& mat_a, Matrix<T, 3, 3>* mat_u,
+    Matrix<T, 3, 3>* mat_s, Matrix<T, 3, 3>* mat_v,
+    T const& epsilon = T(MATH_SVD_DEFAULT_ZERO_THRESHOLD));
+
+/**
+ * SVD for small compile-time fixed-size matrices using one-sided Jacobi
+ * rotations (Hestenes). Only the singular values S (in descending order) and
+ * the right singular vectors V are computed, which suffices to extract the
+ * null space of A, e.g. for the 8-point and DLT solvers. All storage is on
+ * the stack and M < N is handled without padding. This is much faster than
+ * the dynamic-size SVD for the tiny systems solved per RANSAC hypothesis.
+ */
+template <typename T, int M, int N>
+void
+matrix_svd_jacobi (Matrix<T, M, N> const& mat_a, Matrix<T, N, N>* mat_v,
+    Vector<T, N>* vec_s = nullptr, int max_sweeps = 30);
+
 /**
  * Computes the Moore–Penrose pseudoinverse of matrix A using the SVD.
  * Let the SVD of A be A = USV*, then the pseudoinverse is A' = VS'U*.
@@ -644,7 +675,7 @@ matrix_gk_svd (T const* mat_a, int rows, int cols,
 
 /**
  * Implementation of the [R-SVD] method, uses [GK-SVD] as solver
- * for the reduced problem.
+ * for the reduced problem. U can be null, which saves applying Q.
  */
 template <typename T>
 void
@@ -652,20 +683,30 @@ matrix_r_svd (T const* mat_a, int rows, int cols,
     T* mat_u, T* vec_s, T* mat_v, T const& epsilon)
 {
     /* Allocate memory for temp matrices. */
-    int const mat_q_size = rows * rows;
-    int const mat_r_size = rows * cols;
-    int const mat_u_tmp_size = rows * cols;
-    std::vector<T> buffer(mat_q_size + mat_r_size + mat_u_tmp_size);
-    T* mat_q = &buffer[0];
-    T* mat_r = mat_q + mat_q_size;
+    int const mat_qr_size = rows * cols;
+    int const mat_r_size = cols * cols;
+    int const mat_u_tmp_size = cols * cols;
+    std::vector<T> buffer(mat_qr_size + mat_r_size + mat_u_tmp_size + cols);
+    T* mat_qr = &buffer[0];
+    T* mat_r = mat_qr + mat_qr_size;
     T* mat_u_tmp = mat_r + mat_r_size;
+    T* taus = mat_u_tmp + mat_u_tmp_size;
+
+    /* Householder QR of A without forming Q, R is the upper triangle. */
+    std::copy(mat_a, mat_a + rows * cols, mat_qr);
+    matrix_householder_qr(mat_qr, rows, cols, taus, epsilon);
+    for (int i = 0; i < cols; ++i)
+        std::copy(mat_qr + i * cols + i, mat_qr + (i + 1) * cols,
+            mat_r + i * cols + i);
 
-    matrix_qr(mat_a, rows, cols, mat_q, mat_r, epsilon);
     matrix_gk_svd(mat_r, cols, cols, mat_u_tmp, vec_s, mat_v, epsilon);
-    std::fill(mat_u_tmp + cols * cols, mat_u_tmp + rows * cols, T(0));
+    if (mat_u == nullptr)
+        return;
 
-    /* Adapt U for big matrices. */
-    matrix_multiply(mat_q, rows, rows, mat_u_tmp, cols, mat_u);
+    /* Adapt U for big matrices, U = Q [U_tmp; 0]. */
+    std::copy(mat_u_tmp, mat_u_tmp + cols * cols, mat_u);
+    std::fill(mat_u + cols * cols, mat_u + rows * cols, T(0));
+    matrix_householder_apply_q(mat_qr, rows, cols, taus, mat_u, cols);
 }
 
 /**
@@ -687,6 +728,119 @@ find_largest_ev_index (T const* values, int length)
     return index;
 }
 
+/**
+ * SVD of the 3x3 matrix A with one-sided Jacobi rotations, which
+ * orthogonalize the columns of B = AV, and a QR decomposition of B with
+ * Givens rotations, which yields an orthonormal U even for rank-deficient
+ * A, after McAdams et al. (2011). The singular values are the column
+ * norms of B in descending order. Any of U, S and V can be null.
+ */
+template <typename T>
+void
+matrix_svd_3x3 (T const* mat_a, T* mat_u, T* vec_s, T* mat_v)
+{
+    T b[9], v[9] = { T(1), T(0), T(0), T(0), T(1), T(0), T(0), T(0), T(1) };
+    std::copy(mat_a, mat_a + 9, b);
+
+    /* Columns at the rounding level of A are zero and not rotated. */
+    T const epsilon = std::numeric_limits<T>::epsilon();
+    T const zero_norm = MATH_POW2(epsilon) * T(3)
+        * std::inner_product(mat_a, mat_a + 9, mat_a, T(0));
+    int const pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    for (int sweep = 0; sweep < 20; ++sweep)
+    {
+        bool converged = true;
+        for (int k = 0; k < 3; ++k)
+        {
+            int const p = pairs[k][0];
+            int const q = pairs[k][1];
+            T const alpha = b[p] * b[p] + b[3 + p] * b[3 + p]
+                + b[6 + p] * b[6 + p];
+            T const beta = b[q] * b[q] + b[3 + q] * b[3 + q]
+                + b[6 + q] * b[6 + q];
+            T const gamma = b[p] * b[q] + b[3 + p] * b[3 + q]
+                + b[6 + p] * b[6 + q];
+            if (alpha <= zero_norm || beta <= zero_norm
+                || std::abs(gamma) <= epsilon * std::sqrt(alpha * beta))
+                continue;
+
+            converged = false;
+            T const zeta = (beta - alpha) / (T(2) * gamma);
+            T const t = (zeta < T(0) ? T(-1) : T(1))
+                / (std::abs(zeta) + std::sqrt(T(1) + zeta * zeta));
+            T const c = T(1) / std::sqrt(T(1) + t * t);
+            T const s = c * t;
+            for (int i = 0; i < 9; i += 3)
+            {
+                T const bp = b[i + p];
+                b[i + p] = c * bp - s * b[i + q];
+                b[i + q] = s * bp + c * b[i + q];
+                T const vp = v[i + p];
+                v[i + p] = c * vp - s * v[i + q];
+                v[i + q] = s * vp + c * v[i + q];
+            }
+        }
+        if (converged)
+            break;
+    }
+
+    /* Sort the columns of B and V by descending norm. */
+    T s[3];
+    for (int j = 0; j < 3; ++j)
+        s[j] = std::sqrt(b[j] * b[j] + b[3 + j] * b[3 + j]
+            + b[6 + j] * b[6 + j]);
+    for (int i = 0; i < 2; ++i)
+    {
+        int const pos = static_cast<int>(std::max_element(s + i, s + 3) - s);
+        if (pos == i)
+            continue;
+        std::swap(s[i], s[pos]);
+        matrix_swap_columns(b, 3, 3, i, pos);
+        matrix_swap_columns(v, 3, 3, i, pos);
+    }
+
+    if (mat_u != nullptr)
+    {
+        /*
+         * Givens rotations G reduce B to the upper triangular R = GB,
+         * which is diagonal up to rounding, and U is the transpose of G.
+         * Columns with negative diagonal entries in R are negated in U.
+         */
+        T g[9] = { T(1), T(0), T(0), T(0), T(1), T(0), T(0), T(0), T(1) };
+        int const rotations[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+        for (int k = 0; k < 3; ++k)
+        {
+            int const p = rotations[k][0];
+            int const q = rotations[k][1];
+            T const bp = b[3 * p + p];
+            T const bq = b[3 * q + p];
+            T const r = std::sqrt(bp * bp + bq * bq);
+            if (r == T(0))
+                continue;
+            T const c = bp / r;
+            T const sn = bq / r;
+            for (int j = 0; j < 3; ++j)
+            {
+                T const rp = b[3 * p + j];
+                b[3 * p + j] = c * rp + sn * b[3 * q + j];
+                b[3 * q + j] = c * b[3 * q + j] - sn * rp;
+                T const gp = g[3 * p + j];
+                g[3 * p + j] = c * gp + sn * g[3 * q + j];
+                g[3 * q + j] = c * g[3 * q + j] - sn * gp;
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                mat_u[3 * i + j] = b[4 * j] < T(0) ? -g[3 * j + i]
+                    : g[3 * j + i];
+    }
+
+    if (vec_s != nullptr)
+        std::copy(s, s + 3, vec_s);
+    if (mat_v != nullptr)
+        std::copy(v, v + 9, mat_v);
+}
+
 MATH_INTERNAL_NAMESPACE_END
 MATH_NAMESPACE_END
 
@@ -721,14 +875,10 @@ matrix_svd (T const* mat_a, int rows, int cols,
      */
     if (rows >= cols)
     {
-        /* Allow for null result U matrix. */
-        if (mat_u == nullptr)
-        {
-            mat_u_tmp.resize(rows * cols);
-            mat_u = &mat_u_tmp[0];
-        }
-
-        /* Perform economy SVD if rows > 5/3 cols to save some operations. */
+        /*
+         * Perform economy SVD if rows > 5/3 cols to save some operations,
+         * which also skips computing U if it is not requested.
+         */
         if (rows >= 5 * cols / 3)
         {
             internal::matrix_r_svd(mat_a, rows, cols,
@@ -736,6 +886,12 @@ matrix_svd (T const* mat_a, int rows, int cols,
         }
         else
         {
+            /* Allow for null result U matrix. */
+            if (mat_u == nullptr)
+            {
+                mat_u_tmp.resize(rows * cols);
+                mat_u = &mat_u_tmp[0];
+            }
             internal::matrix_gk_svd(mat_a, rows, cols,
                 mat_u, vec_s, mat_v, epsilon);
         }
@@ -767,7 +923,8 @@ matrix_svd (T const* mat_a, int rows, int cols,
         if (pos == 0)
             continue;
         std::swap(vec_s[i], vec_s[i + pos]);
-        matrix_swap_columns(mat_u, rows, cols, i, i + pos);
+        if (mat_u != nullptr)
+            matrix_swap_columns(mat_u, rows, cols, i, i + pos);
         matrix_swap_columns(mat_v, cols, cols, i, i + pos);
     }
 }
@@ -897,6 +1054,103 @@ matrix_svd (Matrix<T, M, N> const& mat_a, Matrix<T, M, N>* mat_u,
     }
 }
 
+template <typename T>
+void
+matrix_svd (Matrix<T, 3, 3> const& mat_a, Matrix<T, 3, 3>* mat_u,
+    Matrix<T, 3, 3>* mat_s, Matrix<T, 3, 3>* mat_v, T const& /*epsilon*/)
+{
+    T vec_s[3];
+    internal::matrix_svd_3x3(mat_a.begin(), mat_u ? mat_u->begin() : nullptr,
+        vec_s, mat_v ? mat_v->begin() : nullptr);
+    if (mat_s != nullptr)
+    {
+        mat_s->fill(T(0));
+        for (int i = 0; i < 3; ++i)
+            (*mat_s)(i, i) = vec_s[i];
+    }
+}
+
+template <typename T, int M, int N>
+void
+matrix_svd_jacobi (Matrix<T, M, N> const& mat_a, Matrix<T, N, N>* mat_v,
+    Vector<T, N>* vec_s, int max_sweeps)
+{
+    /*
+     * The columns of A are orthogonalized pairwise by rotations, which are
+     * accumulated in V. After convergence, AV = US with orthogonal columns
+     * and the singular values are the column norms.
+     */
+    Matrix<T, M, N> mat_u(mat_a);
+    Matrix<T, N, N> V;
+    matrix_set_identity(&V);
+    /* Columns at the rounding level of A are zero and not rotated. */
+    T const epsilon = std::numeric_limits<T>::epsilon();
+    T const zero_norm = MATH_POW2(epsilon) * T(M)
+        * std::inner_product(mat_a.begin(), mat_a.end(), mat_a.begin(), T(0));
+    for (int sweep = 0; sweep < max_sweeps; ++sweep)
+    {
+        bool converged = true;
+        for (int p = 0; p < N - 1; ++p)
+            for (int q = p + 1; q < N; ++q)
+            {
+                T alpha(0), beta(0), gamma(0);
+                for (int i = 0; i < M; ++i)
+                {
+                    alpha += MATH_POW2(mat_u(i, p));
+                    beta += MATH_POW2(mat_u(i, q));
+                    gamma += mat_u(i, p) * mat_u(i, q);
+                }
+                if (alpha <= zero_norm || beta <= zero_norm
+                    || std::abs(gamma) <= epsilon * std::sqrt(alpha * beta))
+                    continue;
+
+                converged = false;
+                T const zeta = (beta - alpha) / (T(2) * gamma);
+                T const t = (zeta < T(0) ? T(-1) : T(1))
+                    / (std::abs(zeta) + std::sqrt(T(1) + zeta * zeta));
+                T const c = T(1) / std::sqrt(T(1) + t * t);
+                T const s = c * t;
+                for (int i = 0; i < M; ++i)
+                {
+                    T const up = mat_u(i, p);
+                    mat_u(i, p) = c * up - s * mat_u(i, q);
+                    mat_u(i, q) = s * up + c * mat_u(i, q);
+                }
+                for (int i = 0; i < N; ++i)
+                {
+                    T const vp = V(i, p);
+                    V(i, p) = c * vp - s * V(i, q);
+                    V(i, q) = s * vp + c * V(i, q);
+                }
+            }
+        if (converged)
+            break;
+    }
+
+    /* Sort the singular values and adapt the columns of V. */
+    Vector<T, N> S;
+    for (int j = 0; j < N; ++j)
+    {
+        T norm(0);
+        for (int i = 0; i < M; ++i)
+            norm += MATH_POW2(mat_u(i, j));
+        S[j] = std::sqrt(norm);
+    }
+    for (int i = 0; i < N - 1; ++i)
+    {
+        int const pos = static_cast<int>(std::max_element(S.begin() + i,
+            S.end()) - S.begin());
+        if (pos == i)
+            continue;
+        std::swap(S[i], S[pos]);
+        matrix_swap_columns(V.begin(), N, N, i, pos);
+    }
+
+    *mat_v = V;
+    if (vec_s != nullptr)
+        *vec_s = S;
+}
+
 template <typename T, int M, int N>
 void
 matrix_pseudo_inverse (Matrix<T, M, N> const& A,
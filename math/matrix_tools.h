@@ -398,24 +398,16 @@ matrix_determinant (Matrix<T,3,3> const& m)
 }
 
 template <typename T>
-T
+inline T
 matrix_determinant (Matrix<T,4,4> const& m)
 {
-    return m[0] * (m[5] * m[10] * m[15] - m[5] * m[11] * m[14]
-        - m[9] * m[6] * m[15] + m[9] * m[7] * m[14]
-        + m[13] * m[6] * m[11] - m[13] * m[7] * m[10])
-        //
-        + m[1] * (-m[4] * m[10] * m[15] + m[4] * m[11] * m[14]
-        + m[8] * m[6] * m[15] - m[8] * m[7] * m[14]
-        - m[12] * m[6] * m[11] + m[12] * m[7] * m[10])
-        //
-        + m[2] * (m[4] * m[9] * m[15] - m[4] * m[11] * m[13]
-        - m[8] * m[5] * m[15] + m[8] * m[7] * m[13]
-        + m[12] * m[5] * m[11] - m[12] * m[7] * m[9])
-        //
-        + m[3] * (-m[4] * m[9] * m[14] + m[4] * m[10] * m[13]
-        + m[8] * m[5] * m[14] - m[8] * m[6] * m[13]
-        - m[12] * m[5] * m[10] + m[12] * m[6] * m[9]);
+    /* Laplace expansion with the 2x2 minors of the upper and lower rows. */
+    return (m[0] * m[5] - m[4] * m[1]) * (m[10] * m[15] - m[14] * m[11])
+        - (m[0] * m[6] - m[4] * m[2]) * (m[9] * m[15] - m[13] * m[11])
+        + (m[0] * m[7] - m[4] * m[3]) * (m[9] * m[14] - m[13] * m[10])
+        + (m[1] * m[6] - m[5] * m[2]) * (m[8] * m[15] - m[12] * m[11])
+        - (m[1] * m[7] - m[5] * m[3]) * (m[8] * m[14] - m[12] * m[10])
+        + (m[2] * m[7] - m[6] * m[3]) * (m[8] * m[13] - m[12] * m[9]);
 }
 
 template <typename T>
@@ -478,45 +470,46 @@ template <typename T>
 Matrix<T,4,4>
 matrix_inverse (Matrix<T,4,4> const& m)
 {
-    Matrix<T,4,4> ret;
+    /*
+     * The cofactors are products of the 2x2 minors of the upper two rows
+     * (s) and of the lower two rows (c), which are shared by all cofactors
+     * and the determinant.
+     */
+    T const s0 = m[0] * m[5] - m[4] * m[1];
+    T const s1 = m[0] * m[6] - m[4] * m[2];
+    T const s2 = m[0] * m[7] - m[4] * m[3];
+    T const s3 = m[1] * m[6] - m[5] * m[2];
+    T const s4 = m[1] * m[7] - m[5] * m[3];
+    T const s5 = m[2] * m[7] - m[6] * m[3];
+    T const c5 = m[10] * m[15] - m[14] * m[11];
+    T const c4 = m[9] * m[15] - m[13] * m[11];
+    T const c3 = m[9] * m[14] - m[13] * m[10];
+    T const c2 = m[8] * m[15] - m[12] * m[11];
+    T const c1 = m[8] * m[14] - m[12] * m[10];
+    T const c0 = m[8] * m[13] - m[12] * m[9];
 
-    ret[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15]
-        + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
-    ret[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15]
-        - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
-    ret[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15]
-        + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
-    ret[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11]
-        - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
-
-    ret[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15]
-        - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
-    ret[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15]
-        + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
-    ret[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15]
-        - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
-    ret[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11]
-        + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
-
-    ret[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15]
-        + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
-    ret[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15]
-        - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
-    ret[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15]
-        + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
-    ret[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11]
-        - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
-
-    ret[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14]
-        - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
-    ret[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14]
-        + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
-    ret[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14]
-        - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
-    ret[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10]
-        + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
-
-    T det = m[0] * ret[0] + m[1] * ret[4] + m[2] * ret[8] + m[3] * ret[12];
+    Matrix<T,4,4> ret;
+    ret[0] = m[5] * c5 - m[6] * c4 + m[7] * c3;
+    ret[1] = -m[1] * c5 + m[2] * c4 - m[3] * c3;
+    ret[2] = m[13] * s5 - m[14] * s4 + m[15] * s3;
+    ret[3] = -m[9] * s5 + m[10] * s4 - m[11] * s3;
+
+    ret[4] = -m[4] * c5 + m[6] * c2 - m[7] * c1;
+    ret[5] = m[0] * c5 - m[2] * c2 + m[3] * c1;
+    ret[6] = -m[12] * s5 + m[14] * s2 - m[15] * s1;
+    ret[7] = m[8] * s5 - m[10] * s2 + m[11] * s1;
+
+    ret[8] = m[4] * c4 - m[5] * c2 + m[7] * c0;
+    ret[9] = -m[0] * c4 + m[1] * c2 - m[3] * c0;
+    ret[10] = m[12] * s4 - m[13] * s2 + m[15] * s0;
+    ret[11] = -m[8] * s4 + m[9] * s2 - m[11] * s0;
+
+    ret[12] = -m[4] * c3 + m[5] * c1 - m[6] * c0;
+    ret[13] = m[0] * c3 - m[1] * c1 + m[2] * c0;
+    ret[14] = -m[12] * s3 + m[13] * s1 - m[14] * s0;
+    ret[15] = m[8] * s3 - m[9] * s1 + m[10] * s0;
+
+    T const det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
     return ret / det;
 }
 
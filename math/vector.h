@@ -272,6 +272,117 @@ MATH_NAMESPACE_END
 #include <numeric>
 
 MATH_NAMESPACE_BEGIN
+MATH_INTERNAL_NAMESPACE_BEGIN
+
+/**
+ * The element-wise kernels of the vector operations on the value arrays.
+ * Specializations for small float and double vectors in vector_simd.h
+ * use SIMD instructions with the same results.
+ */
+template <typename T, int N>
+struct VectorOps
+{
+    static void add (T* a, T const* b);
+    static void sub (T* a, T const* b);
+    static void mult (T* a, T const* b);
+    static void div (T* a, T const* b);
+    static void add (T* a, T const& s);
+    static void sub (T* a, T const& s);
+    static void mult (T* a, T const& s);
+    static void div (T* a, T const& s);
+    static void negate (T* a);
+    static void abs (T* a);
+    static T dot (T const* a, T const* b);
+    static T square_norm (T const* a);
+};
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::add (T* a, T const* b)
+{
+    std::transform(a, a + N, b, a, std::plus<T>());
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::sub (T* a, T const* b)
+{
+    std::transform(a, a + N, b, a, std::minus<T>());
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::mult (T* a, T const* b)
+{
+    std::transform(a, a + N, b, a, std::multiplies<T>());
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::div (T* a, T const* b)
+{
+    std::transform(a, a + N, b, a, std::divides<T>());
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::add (T* a, T const& s)
+{
+    std::for_each(a, a + N, algo::foreach_addition_with_const<T>(s));
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::sub (T* a, T const& s)
+{
+    std::for_each(a, a + N, algo::foreach_substraction_with_const<T>(s));
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::mult (T* a, T const& s)
+{
+    std::for_each(a, a + N, algo::foreach_multiply_with_const<T>(s));
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::div (T* a, T const& s)
+{
+    std::for_each(a, a + N, algo::foreach_divide_by_const<T>(s));
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::negate (T* a)
+{
+    std::for_each(a, a + N, &algo::foreach_negate_value<T>);
+}
+
+template <typename T, int N>
+inline void
+VectorOps<T,N>::abs (T* a)
+{
+    std::for_each(a, a + N, &algo::foreach_absolute_value<T>);
+}
+
+template <typename T, int N>
+inline T
+VectorOps<T,N>::dot (T const* a, T const* b)
+{
+    return std::inner_product(a, a + N, b, T(0));
+}
+
+template <typename T, int N>
+inline T
+VectorOps<T,N>::square_norm (T const* a)
+{
+    return std::accumulate(a, a + N, T(0), &algo::accum_squared_sum<T>);
+}
+
+MATH_INTERNAL_NAMESPACE_END
+
+/* ------------------------- Constructors ------------------------- */
 
 template <typename T, int N>
 int constexpr Vector<T,N>::dim;
@@ -368,6 +479,12 @@ cross_product (Vector<T,3> const& v1, Vector<T,3> const& v2)
         v1[0] * v2[1] - v1[1] * v2[0]);
 }
 
+MATH_NAMESPACE_END
+
+#include "math/vector_simd.h"
+
+MATH_NAMESPACE_BEGIN
+
 /* ---------------------------- Management ------------------------ */
 
 template <typename T, int N>
@@ -434,14 +551,14 @@ template <typename T, int N>
 inline T
 Vector<T,N>::square_norm (void) const
 {
-    return std::accumulate(v, v + N, T(0), &algo::accum_squared_sum<T>);
+    return internal::VectorOps<T,N>::square_norm(v);
 }
 
 template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::normalize (void)
 {
-    std::for_each(v, v + N, algo::foreach_divide_by_const<T>(norm()));
+    internal::VectorOps<T,N>::div(v, norm());
     return *this;
 }
 
@@ -456,7 +573,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::abs_value (void)
 {
-    std::for_each(v, v + N, &algo::foreach_absolute_value<T>);
+    internal::VectorOps<T,N>::abs(v);
     return *this;
 }
 
@@ -471,7 +588,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::negate (void)
 {
-    std::for_each(v, v + N, &algo::foreach_negate_value<T>);
+    internal::VectorOps<T,N>::negate(v);
     return *this;
 }
 
@@ -535,7 +652,7 @@ template <typename T, int N>
 inline T
 Vector<T,N>::dot (Vector<T,N> const& other) const
 {
-    return std::inner_product(v, v + N, *other, T(0));
+    return internal::VectorOps<T,N>::dot(v, *other);
 }
 
 template <typename T, int N>
@@ -549,8 +666,8 @@ template <typename T, int N>
 inline Vector<T,N>
 Vector<T,N>::cw_mult (Vector<T,N> const& other) const
 {
-    Vector<T,N> ret;
-    std::transform(v, v + N, other.v, ret.v, std::multiplies<T>());
+    Vector<T,N> ret(*this);
+    internal::VectorOps<T,N>::mult(ret.v, other.v);
     return ret;
 }
 
@@ -558,8 +675,8 @@ template <typename T, int N>
 inline Vector<T,N>
 Vector<T,N>::cw_div (Vector<T,N> const& other) const
 {
-    Vector<T,N> ret;
-    std::transform(v, v + N, other.v, ret.v, std::divides<T>());
+    Vector<T,N> ret(*this);
+    internal::VectorOps<T,N>::div(ret.v, other.v);
     return ret;
 }
 
@@ -686,7 +803,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::operator-= (Vector<T,N> const& rhs)
 {
-    std::transform(v, v + N, *rhs, v, std::minus<T>());
+    internal::VectorOps<T,N>::sub(v, *rhs);
     return *this;
 }
 
@@ -701,7 +818,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::operator+= (Vector<T,N> const& rhs)
 {
-    std::transform(v, v + N, *rhs, v, std::plus<T>());
+    internal::VectorOps<T,N>::add(v, *rhs);
     return *this;
 }
 
@@ -716,7 +833,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::operator-= (T const& rhs)
 {
-    std::for_each(v, v + N, algo::foreach_substraction_with_const<T>(rhs));
+    internal::VectorOps<T,N>::sub(v, rhs);
     return *this;
 }
 
@@ -731,7 +848,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::operator+= (T const& rhs)
 {
-    std::for_each(v, v + N, algo::foreach_addition_with_const<T>(rhs));
+    internal::VectorOps<T,N>::add(v, rhs);
     return *this;
 }
 
@@ -746,7 +863,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::operator*= (T const& rhs)
 {
-    std::for_each(v, v + N, algo::foreach_multiply_with_const<T>(rhs));
+    internal::VectorOps<T,N>::mult(v, rhs);
     return *this;
 }
 
@@ -761,7 +878,7 @@ template <typename T, int N>
 inline Vector<T,N>&
 Vector<T,N>::operator/= (T const& rhs)
 {
-    std::for_each(v, v + N, algo::foreach_divide_by_const<T>(rhs));
+    internal::VectorOps<T,N>::div(v, rhs);
     return *this;
 }
 
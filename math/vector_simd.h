@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+/*
+ * SIMD kernels for Vec3f, Vec4f, Vec2d and Vec3d with SSE2 or NEON
+ * (AArch64 only). This file is included by vector.h and specializes
+ * internal::VectorOps, it is not meant to be included directly.
+ *
+ * The vectors keep their packed layout, since arrays of vectors are read
+ * and written as raw memory in many places, e.g. mesh and bundle files.
+ * The kernels thus use unaligned loads, and partial loads for three
+ * elements. Every lane computes the same IEEE operation as the scalar
+ * code, and dot products and norms sum the lane products in the order of
+ * the scalar code, so the results are identical. The unused lane of the
+ * three-element kernels may raise floating-point exception flags, e.g.
+ * for 0/0 in cw_div(). Define MATH_NO_SIMD to use the generic kernels.
+ */
+
+#ifndef MATH_VECTOR_SIMD_HEADER
+#define MATH_VECTOR_SIMD_HEADER
+
+#if !defined(MATH_NO_SIMD) && defined(__SSE2__)
+#   define MATH_VECTOR_SSE2 1
+#   include <emmintrin.h>
+#elif !defined(MATH_NO_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#   define MATH_VECTOR_NEON 1
+#   include <arm_neon.h>
+#endif
+
+#include "math/defines.h"
+
+#if defined(MATH_VECTOR_SSE2) || defined(MATH_VECTOR_NEON)
+
+MATH_NAMESPACE_BEGIN
+MATH_INTERNAL_NAMESPACE_BEGIN
+
+/*
+ * Register traits with load(), store(), set1(), add(), sub(), mult(),
+ * div(), negate() and abs() for N values of type T.
+ */
+template <typename T, int N>
+struct SimdRegister;
+
+#if defined(MATH_VECTOR_SSE2)
+
+template <>
+struct SimdRegister<float, 4>
+{
+    typedef __m128 Type;
+
+    static Type load (float const* p) { return _mm_loadu_ps(p); }
+    static void store (float* p, Type a) { _mm_storeu_ps(p, a); }
+    static Type set1 (float s) { return _mm_set1_ps(s); }
+    static Type add (Type a, Type b) { return _mm_add_ps(a, b); }
+    static Type sub (Type a, Type b) { return _mm_sub_ps(a, b); }
+    static Type mult (Type a, Type b) { return _mm_mul_ps(a, b); }
+    static Type div (Type a, Type b) { return _mm_div_ps(a, b); }
+    static Type negate (Type a)
+    { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    static Type abs (Type a)
+    { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+};
+
+/* The fourth lane is zero, or the value of set1(). */
+template <>
+struct SimdRegister<float, 3> : public SimdRegister<float, 4>
+{
+    static Type load (float const* p)
+    {
+        __m128 const xy = _mm_castsi128_ps(_mm_loadl_epi64(
+            reinterpret_cast<__m128i const*>(p)));
+        return _mm_movelh_ps(xy, _mm_load_ss(p + 2));
+    }
+
+    static void store (float* p, Type a)
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p),
+            _mm_castps_si128(a));
+        _mm_store_ss(p + 2, _mm_movehl_ps(a, a));
+    }
+};
+
+template <>
+struct SimdRegister<double, 2>
+{
+    typedef __m128d Type;
+
+    static Type load (double const* p) { return _mm_loadu_pd(p); }
+    static void store (double* p, Type a) { _mm_storeu_pd(p, a); }
+    static Type set1 (double s) { return _mm_set1_pd(s); }
+    static Type add (Type a, Type b) { return _mm_add_pd(a, b); }
+    static Type sub (Type a, Type b) { return _mm_sub_pd(a, b); }
+    static Type mult (Type a, Type b) { return _mm_mul_pd(a, b); }
+    static Type div (Type a, Type b) { return _mm_div_pd(a, b); }
+    static Type negate (Type a)
+    { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+    static Type abs (Type a)
+    { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+};
+
+#else /* MATH_VECTOR_NEON */
+
+template <>
+struct SimdRegister<float, 4>
+{
+    typedef float32x4_t Type;
+
+    static Type load (float const* p) { return vld1q_f32(p); }
+    static void store (float* p, Type a) { vst1q_f32(p, a); }
+    static Type set1 (float s) { return vdupq_n_f32(s); }
+    static Type add (Type a, Type b) { return vaddq_f32(a, b); }
+    static Type sub (Type a, Type b) { return vsubq_f32(a, b); }
+    static Type mult (Type a, Type b) { return vmulq_f32(a, b); }
+    static Type div (Type a, Type b) { return vdivq_f32(a, b); }
+    static Type negate (Type a) { return vnegq_f32(a); }
+    static Type abs (Type a) { return vabsq_f32(a); }
+};
+
+/* The fourth lane is zero, or the value of set1(). */
+template <>
+struct SimdRegister<float, 3> : public SimdRegister<float, 4>
+{
+    static Type load (float const* p)
+    {
+        return vcombine_f32(vld1_f32(p),
+            vld1_lane_f32(p + 2, vdup_n_f32(0.0f), 0));
+    }
+
+    static void store (float* p, Type a)
+    {
+        vst1_f32(p, vget_low_f32(a));
+        vst1q_lane_f32(p + 2, a, 2);
+    }
+};
+
+template <>
+struct SimdRegister<double, 2>
+{
+    typedef float64x2_t Type;
+
+    static Type load (double const* p) { return vld1q_f64(p); }
+    static void store (double* p, Type a) { vst1q_f64(p, a); }
+    static Type set1 (double s) { return vdupq_n_f64(s); }
+    static Type add (Type a, Type b) { return vaddq_f64(a, b); }
+    static Type sub (Type a, Type b) { return vsubq_f64(a, b); }
+    static Type mult (Type a, Type b) { return vmulq_f64(a, b); }
+    static Type div (Type a, Type b) { return vdivq_f64(a, b); }
+    static Type negate (Type a) { return vnegq_f64(a); }
+    static Type abs (Type a) { return vabsq_f64(a); }
+};
+
+#endif
+
+/* Two double registers, the second one holds the third value. */
+template <>
+struct SimdRegister<double, 3>
+{
+    typedef SimdRegister<double, 2> R;
+    struct Type
+    {
+        R::Type xy;
+        R::Type z;
+    };
+
+    static Type load (double const* p)
+    {
+        Type ret = { R::load(p), R::set1(p[2]) };
+        return ret;
+    }
+
+    static void store (double* p, Type a)
+    {
+        R::store(p, a.xy);
+        double z[2];
+        R::store(z, a.z);
+        p[2] = z[0];
+    }
+
+    static Type set1 (double s)
+    {
+        Type ret = { R::set1(s), R::set1(s) };
+        return ret;
+    }
+
+    static Type add (Type a, Type b)
+    {
+        Type ret = { R::add(a.xy, b.xy), R::add(a.z, b.z) };
+        return ret;
+    }
+
+    static Type sub (Type a, Type b)
+    {
+        Type ret = { R::sub(a.xy, b.xy), R::sub(a.z, b.z) };
+        return ret;
+    }
+
+    static Type mult (Type a, Type b)
+    {
+        Type ret = { R::mult(a.xy, b.xy), R::mult(a.z, b.z) };
+        return ret;
+    }
+
+    static Type div (Type a, Type b)
+    {
+        Type ret = { R::div(a.xy, b.xy), R::div(a.z, b.z) };
+        return ret;
+    }
+
+    static Type negate (Type a)
+    {
+        Type ret = { R::negate(a.xy), R::negate(a.z) };
+        return ret;
+    }
+
+    static Type abs (Type a)
+    {
+        Type ret = { R::abs(a.xy), R::abs(a.z) };
+        return ret;
+    }
+};
+
+/* ---------------------------------------------------------------- */
+
+/** The vector kernels in terms of the register traits. */
+template <typename T, int N>
+struct SimdVectorOps
+{
+    typedef SimdRegister<T, N> R;
+
+    static void add (T* a, T const* b)
+    { R::store(a, R::add(R::load(a), R::load(b))); }
+    static void sub (T* a, T const* b)
+    { R::store(a, R::sub(R::load(a), R::load(b))); }
+    static void mult (T* a, T const* b)
+    { R::store(a, R::mult(R::load(a), R::load(b))); }
+    static void div (T* a, T const* b)
+    { R::store(a, R::div(R::load(a), R::load(b))); }
+    static void add (T* a, T const& s)
+    { R::store(a, R::add(R::load(a), R::set1(s))); }
+    static void sub (T* a, T const& s)
+    { R::store(a, R::sub(R::load(a), R::set1(s))); }
+    static void mult (T* a, T const& s)
+    { R::store(a, R::mult(R::load(a), R::set1(s))); }
+    static void div (T* a, T const& s)
+    { R::store(a, R::div(R::load(a), R::set1(s))); }
+    static void negate (T* a)
+    { R::store(a, R::negate(R::load(a))); }
+    static void abs (T* a)
+    { R::store(a, R::abs(R::load(a))); }
+
+    /* The products are summed in order, like std::inner_product. */
+    static T dot (T const* a, T const* b)
+    {
+        T products[4];
+        R::store(products, R::mult(R::load(a), R::load(b)));
+        T sum = T(0);
+        for (int i = 0; i < N; ++i)
+            sum += products[i];
+        return sum;
+    }
+
+    static T square_norm (T const* a)
+    {
+        return dot(a, a);
+    }
+};
+
+template <>
+struct VectorOps<float, 3> : public SimdVectorOps<float, 3> {};
+template <>
+struct VectorOps<float, 4> : public SimdVectorOps<float, 4> {};
+template <>
+struct VectorOps<double, 2> : public SimdVectorOps<double, 2> {};
+template <>
+struct VectorOps<double, 3> : public SimdVectorOps<double, 3> {};
+
+MATH_INTERNAL_NAMESPACE_END
+
+#if defined(MATH_VECTOR_SSE2)
+
+/** Cross product of float 3-vectors with lane shuffles. */
+template <>
+inline Vector<float,3>
+cross_product (Vector<float,3> const& v1, Vector<float,3> const& v2)
+{
+    typedef internal::SimdRegister<float, 3> R;
+    __m128 const a = R::load(*v1);
+    __m128 const b = R::load(*v2);
+    __m128 const a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 const a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 const b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 const b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+    Vector<float,3> ret;
+    R::store(*ret, _mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy),
+        _mm_mul_ps(a_zxy, b_yzx)));
+    return ret;
+}
+
+#endif
+
+MATH_NAMESPACE_END
+
+#endif /* MATH_VECTOR_SSE2 || MATH_VECTOR_NEON */
+
+#endif /* MATH_VECTOR_SIMD_HEADER */
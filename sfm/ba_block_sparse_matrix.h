@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann, Fabian Langguth
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BLOCK_SPARSE_MATRIX_HEADER
+#define SFM_BLOCK_SPARSE_MATRIX_HEADER
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "sfm/ba_cholesky.h"
+#include "sfm/ba_dense_vector.h"
+#include "util/memory.h"
+#include "util/numa.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BA_NAMESPACE_BEGIN
+
+/**
+ * Sparse matrix class with dense blocks of fixed size in block-row-major
+ * format. Every block row stores the column indices of its blocks, and
+ * the values of every block are consecutive in row-major order. This
+ * avoids an index per value for the fixed-size blocks of bundle
+ * adjustment, e.g. 2x9 camera and 2x3 point blocks of the Jacobian.
+ *
+ * The values are first written by the OpenMP threads in static schedule,
+ * which places the blocks on the NUMA nodes of the threads that compute
+ * and multiply them.
+ */
+template <typename T, int BR, int BC>
+class BlockSparseMatrix
+{
+public:
+    /** The number of values of a block. */
+    static int const BLOCK_SIZE = BR * BC;
+
+public:
+    BlockSparseMatrix (void);
+    BlockSparseMatrix (std::size_t block_rows, std::size_t block_cols);
+    void allocate (std::size_t block_rows, std::size_t block_cols);
+    void set_pattern (std::vector<std::size_t> const& outer,
+        std::vector<std::size_t> const& inner);
+    void set_zero (void);
+
+    std::size_t find_block (std::size_t block_row,
+        std::size_t block_col) const;
+    void mult_diagonal (T const& factor);
+    void invert_diagonal_blocks (void);
+    DenseVector<T> diagonal (void) const;
+    void to_dense (std::vector<T>* matrix) const;
+
+    DenseVector<T> multiply (DenseVector<T> const& rhs) const;
+    DenseVector<T> transpose_multiply (DenseVector<T> const& rhs) const;
+
+    std::size_t num_block_rows (void) const;
+    std::size_t num_block_cols (void) const;
+    std::size_t num_blocks (void) const;
+    std::size_t num_rows (void) const;
+    std::size_t num_cols (void) const;
+    std::size_t row_begin (std::size_t block_row) const;
+    std::size_t row_end (std::size_t block_row) const;
+    std::size_t block_col (std::size_t block) const;
+    T* block (std::size_t block);
+    T const* block (std::size_t block) const;
+
+private:
+    std::size_t block_rows;
+    std::size_t block_cols;
+    util::FirstTouchVector<T, util::MEMORY_BA> values;
+    util::TrackedVector<std::size_t, util::MEMORY_BA> outer;
+    util::TrackedVector<std::size_t, util::MEMORY_BA> inner;
+};
+
+SFM_BA_NAMESPACE_END
+SFM_NAMESPACE_END
+
+/* ------------------------ Implementation ------------------------ */
+
+SFM_NAMESPACE_BEGIN
+SFM_BA_NAMESPACE_BEGIN
+
+template <typename T, int BR, int BC>
+BlockSparseMatrix<T, BR, BC>::BlockSparseMatrix (void)
+    : block_rows(0)
+    , block_cols(0)
+{
+}
+
+template <typename T, int BR, int BC>
+BlockSparseMatrix<T, BR, BC>::BlockSparseMatrix (std::size_t block_rows,
+    std::size_t block_cols)
+{
+    this->allocate(block_rows, block_cols);
+}
+
+template <typename T, int BR, int BC>
+void
+BlockSparseMatrix<T, BR, BC>::allocate (std::size_t block_rows,
+    std::size_t block_cols)
+{
+    this->block_rows = block_rows;
+    this->block_cols = block_cols;
+    this->values.clear();
+    this->outer.clear();
+    this->inner.clear();
+    this->outer.resize(block_rows + 1, 0);
+}
+
+/*
+ * Sets the pattern of blocks from the outer indices of the block rows and
+ * the block column indices, which must be sorted within every block row.
+ * All values are zero.
+ */
+template <typename T, int BR, int BC>
+void
+BlockSparseMatrix<T, BR, BC>::set_pattern (
+    std::vector<std::size_t> const& outer,
+    std::vector<std::size_t> const& inner)
+{
+    if (outer.size() != this->block_rows + 1 || outer.back() != inner.size())
+        throw std::invalid_argument("Invalid block sparse matrix pattern");
+
+    this->outer.assign(outer.begin(), outer.end());
+    this->inner.assign(inner.begin(), inner.end());
+    this->values.clear();
+    this->values.resize(inner.size() * BLOCK_SIZE);
+    util::first_touch_fill(this->values.data(), this->values.size(), T(0));
+}
+
+template <typename T, int BR, int BC>
+void
+BlockSparseMatrix<T, BR, BC>::set_zero (void)
+{
+    util::first_touch_fill(this->values.data(), this->values.size(), T(0));
+}
+
+/* Returns the index of the block, or num_blocks() if there is none. */
+template <typename T, int BR, int BC>
+std::size_t
+BlockSparseMatrix<T, BR, BC>::find_block (std::size_t block_row,
+    std::size_t block_col) const
+{
+    std::size_t const* begin = this->inner.data() + this->outer[block_row];
+    std::size_t const* end = this->inner.data() + this->outer[block_row + 1];
+    std::size_t const* iter = std::lower_bound(begin, end, block_col);
+    if (iter == end || *iter != block_col)
+        return this->num_blocks();
+    return iter - this->inner.data();
+}
+
+template <typename T, int BR, int BC>
+void
+BlockSparseMatrix<T, BR, BC>::mult_diagonal (T const& factor)
+{
+    static_assert(BR == BC, "Diagonal requires square blocks");
+    for (std::size_t i = 0; i < this->block_rows; ++i)
+    {
+        std::size_t const id = this->find_block(i, i);
+        if (id == this->num_blocks())
+            continue;
+        T* ptr = this->block(id);
+        for (int j = 0; j < BR; ++j)
+            ptr[j * BC + j] *= factor;
+    }
+}
+
+/*
+ * Inverts a symmetric, positive definite matrix with blocks on its diagonal
+ * using Cholesky decomposition. All other blocks must be zero. Entries of
+ * singular blocks that are not finite are set to zero.
+ */
+template <typename T, int BR, int BC>
+void
+BlockSparseMatrix<T, BR, BC>::invert_diagonal_blocks (void)
+{
+    static_assert(BR == BC, "Inversion requires square blocks");
+    if (this->block_rows != this->block_cols
+        || this->num_blocks() != this->block_rows)
+        throw std::invalid_argument("Matrix must be block diagonal");
+
+#pragma omp parallel for schedule(static) \
+    if (this->num_blocks() * BLOCK_SIZE >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(this->block_rows);
+        ++i)
+    {
+        T* ptr = this->block(i);
+        cholesky_invert_inplace(ptr, BR);
+        for (int j = 0; j < BLOCK_SIZE; ++j)
+            if (!std::isfinite(ptr[j]))
+                ptr[j] = T(0);
+    }
+}
+
+/* Returns the diagonal entries of the diagonal blocks. */
+template <typename T, int BR, int BC>
+DenseVector<T>
+BlockSparseMatrix<T, BR, BC>::diagonal (void) const
+{
+    static_assert(BR == BC, "Diagonal requires square blocks");
+    DenseVector<T> ret(this->num_rows(), T(0));
+    for (std::size_t i = 0; i < this->block_rows; ++i)
+    {
+        std::size_t const id = this->find_block(i, i);
+        if (id == this->num_blocks())
+            continue;
+        T const* ptr = this->block(id);
+        for (int j = 0; j < BR; ++j)
+            ret[i * BR + j] = ptr[j * BC + j];
+    }
+    return ret;
+}
+
+/** Returns the dense matrix in row-major order. */
+template <typename T, int BR, int BC>
+void
+BlockSparseMatrix<T, BR, BC>::to_dense (std::vector<T>* matrix) const
+{
+    std::size_t const cols = this->num_cols();
+    matrix->assign(this->num_rows() * cols, T(0));
+    for (std::size_t i = 0; i < this->block_rows; ++i)
+        for (std::size_t j = this->outer[i]; j < this->outer[i + 1]; ++j)
+        {
+            T const* ptr = this->block(j);
+            T* dense_ptr = matrix->data() + i * BR * cols + this->inner[j] * BC;
+            for (int r = 0; r < BR; ++r)
+                std::copy(ptr + r * BC, ptr + (r + 1) * BC,
+                    dense_ptr + r * cols);
+        }
+}
+
+template <typename T, int BR, int BC>
+DenseVector<T>
+BlockSparseMatrix<T, BR, BC>::multiply (DenseVector<T> const& rhs) const
+{
+    if (rhs.size() != this->num_cols())
+        throw std::invalid_argument("Incompatible dimensions");
+
+    DenseVector<T> ret(this->num_rows(), T(0));
+#pragma omp parallel for schedule(static) \
+    if (this->num_blocks() * BLOCK_SIZE >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(this->block_rows);
+        ++i)
+    {
+        T* ret_ptr = ret.data() + i * BR;
+        for (std::size_t j = this->outer[i]; j < this->outer[i + 1]; ++j)
+        {
+            T const* ptr = this->block(j);
+            T const* rhs_ptr = rhs.data() + this->inner[j] * BC;
+            for (int r = 0; r < BR; ++r)
+                for (int c = 0; c < BC; ++c)
+                    ret_ptr[r] += ptr[r * BC + c] * rhs_ptr[c];
+        }
+    }
+    return ret;
+}
+
+template <typename T, int BR, int BC>
+DenseVector<T>
+BlockSparseMatrix<T, BR, BC>::transpose_multiply (
+    DenseVector<T> const& rhs) const
+{
+    if (rhs.size() != this->num_rows())
+        throw std::invalid_argument("Incompatible dimensions");
+
+    /*
+     * Every thread scatters its block rows into its own result, and the
+     * results are summed in the order of the threads for every entry.
+     */
+    DenseVector<T> ret(this->num_cols(), T(0));
+    std::int64_t const num_block_rows = this->block_rows;
+    std::int64_t const num_cols = this->num_cols();
+    std::vector<DenseVector<T>> thread_rets;
+#pragma omp parallel \
+    if (this->num_blocks() * BLOCK_SIZE >= internal::PARALLEL_CHUNK_SIZE)
+    {
+#ifdef _OPENMP
+        std::size_t const num_threads = omp_get_num_threads();
+        std::size_t const thread_id = omp_get_thread_num();
+#else
+        std::size_t const num_threads = 1;
+        std::size_t const thread_id = 0;
+#endif
+
+#pragma omp single
+        thread_rets.resize(num_threads);
+        DenseVector<T>& thread_ret = thread_rets[thread_id];
+        thread_ret.resize(this->num_cols(), T(0));
+
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_block_rows; ++i)
+        {
+            T const* rhs_ptr = rhs.data() + i * BR;
+            for (std::size_t j = this->outer[i]; j < this->outer[i + 1]; ++j)
+            {
+                T const* ptr = this->block(j);
+                T* ret_ptr = thread_ret.data() + this->inner[j] * BC;
+                for (int r = 0; r < BR; ++r)
+                    for (int c = 0; c < BC; ++c)
+                        ret_ptr[c] += ptr[r * BC + c] * rhs_ptr[r];
+            }
+        }
+
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_cols; ++i)
+            for (std::size_t t = 0; t < num_threads; ++t)
+                ret[i] += thread_rets[t][i];
+    }
+    return ret;
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::num_block_rows (void) const
+{
+    return this->block_rows;
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::num_block_cols (void) const
+{
+    return this->block_cols;
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::num_blocks (void) const
+{
+    return this->inner.size();
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::num_rows (void) const
+{
+    return this->block_rows * BR;
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::num_cols (void) const
+{
+    return this->block_cols * BC;
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::row_begin (std::size_t block_row) const
+{
+    return this->outer[block_row];
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::row_end (std::size_t block_row) const
+{
+    return this->outer[block_row + 1];
+}
+
+template <typename T, int BR, int BC>
+inline std::size_t
+BlockSparseMatrix<T, BR, BC>::block_col (std::size_t block) const
+{
+    return this->inner[block];
+}
+
+template <typename T, int BR, int BC>
+inline T*
+BlockSparseMatrix<T, BR, BC>::block (std::size_t block)
+{
+    return this->values.data() + block * BLOCK_SIZE;
+}
+
+template <typename T, int BR, int BC>
+inline T const*
+BlockSparseMatrix<T, BR, BC>::block (std::size_t block) const
+{
+    return this->values.data() + block * BLOCK_SIZE;
+}
+
+SFM_BA_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif // SFM_BLOCK_SPARSE_MATRIX_HEADER
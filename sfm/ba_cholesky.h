@@ -1,6 +1,7 @@
 #ifndef SFM_BA_CHOLESKY_HEADER
 #define SFM_BA_CHOLESKY_HEADER
 
+#include <algorithm>
 #include <stdexcept>
 #include <cmath>
 
@@ -30,11 +31,24 @@ cholesky_invert_inplace (T* A, int const cols);
  * Cholesky decomposition of the symmetric, positive definite matrix
  * A = L * L^T. The resulting matrix L is a lower-triangular matrix.
  * If A and L are the same matrix, the decomposition is performed in-place.
+ * Large matrices are decomposed in blocks of rows, which keeps the rows of
+ * a block in cache while they are used for all later rows. Columns below a
+ * zero diagonal entry, e.g. for unconstrained parameters, are set to zero.
  */
 template <typename T>
 void
 cholesky_decomposition (T const* A, int const cols, T* L);
 
+/**
+ * Solves A * x = b with the Cholesky decomposition A = L * L^T by forward
+ * and backward substitution. Components for zero diagonal entries of L,
+ * e.g. for unconstrained parameters, are set to zero. The solution can be
+ * computed in-place, i.e., b and x can be the same vector.
+ */
+template <typename T>
+void
+cholesky_solve (T const* L, int const cols, T const* b, T* x);
+
 /**
  * Invert a lower-triangular matrix (e.g. obtained by Cholesky decomposition).
  * The inversion cannot be computed in-place.
@@ -67,36 +81,129 @@ cholesky_invert_inplace (T* A, int const cols)
     delete[] tmp;
 }
 
-template <typename T>
-void
-cholesky_decomposition (T const* A, int const cols, T* L)
+namespace internal
 {
-    T* out_ptr = L;
-    for (int r = 0; r < cols; ++r)
+    /* Rows of a block of the blocked Cholesky decomposition. */
+    int const CHOLESKY_BLOCK_SIZE = 64;
+
+    /*
+     * Computes the entries of row r of L left of column 'end' from column
+     * 'begin' on, where all columns left of 'begin' are already computed.
+     */
+    template <typename T>
+    void
+    cholesky_row (T const* A, int const cols, int r, int begin, int end,
+        T* L)
     {
-        /* Compute left-of-diagonal entries. */
-        for (int c = 0; c < r; ++c)
+        T* L_row_ptr = L + r * cols;
+        for (int c = begin; c < std::min(r, end); ++c)
         {
+            T const* L_col_ptr = L + c * cols;
             T result = T(0);
             for (int ci = 0; ci < c; ++ci)
-                result += L[r * cols + ci] * L[c * cols + ci];
+                result += L_row_ptr[ci] * L_col_ptr[ci];
             result = A[r * cols + c] - result;
-            (*out_ptr++) = result / L[c * cols + c];
+            L_row_ptr[c] = L_col_ptr[c] > T(0) ? result / L_col_ptr[c] : T(0);
         }
 
+        if (r >= end)
+            return;
+
         /* Compute diagonal entry. */
+        T result = T(0);
+        for (int c = 0; c < r; ++c)
+            result += MATH_POW2(L_row_ptr[c]);
+        result = std::max(T(0), A[r * cols + r] - result);
+        L_row_ptr[r] = std::sqrt(result);
+    }
+
+    /*
+     * Computes the entries of the four rows r, ..., r + 3 below the block
+     * in the block columns. The rows are independent, and interleaving
+     * their dot products keeps the summation order of every row.
+     */
+    template <typename T>
+    void
+    cholesky_rows_4 (T const* A, int const cols, int r, int begin, int end,
+        T* L)
+    {
+        T* L_row_ptr[4];
+        for (int i = 0; i < 4; ++i)
+            L_row_ptr[i] = L + (r + i) * cols;
+
+        for (int c = begin; c < end; ++c)
         {
-            T* L_row_ptr = L + r * cols;
-            T result = T(0);
-            for (int c = 0; c < r; ++c)
-                result += MATH_POW2(L_row_ptr[c]);
-            result = std::max(T(0), A[r * cols + r] - result);
-            (*out_ptr++) = std::sqrt(result);
+            T const* L_col_ptr = L + c * cols;
+            T result[4] = { T(0), T(0), T(0), T(0) };
+            for (int ci = 0; ci < c; ++ci)
+            {
+                T const value = L_col_ptr[ci];
+                result[0] += L_row_ptr[0][ci] * value;
+                result[1] += L_row_ptr[1][ci] * value;
+                result[2] += L_row_ptr[2][ci] * value;
+                result[3] += L_row_ptr[3][ci] * value;
+            }
+            for (int i = 0; i < 4; ++i)
+                L_row_ptr[i][c] = L_col_ptr[c] > T(0)
+                    ? (A[(r + i) * cols + c] - result[i]) / L_col_ptr[c]
+                    : T(0);
         }
+    }
+}
 
-        /* Set right-of-diagonal entries zero. */
+template <typename T>
+void
+cholesky_decomposition (T const* A, int const cols, T* L)
+{
+    int const block_size = internal::CHOLESKY_BLOCK_SIZE;
+    for (int begin = 0; begin < cols; begin += block_size)
+    {
+        int const end = std::min(cols, begin + block_size);
+
+        /* Decompose the rows of the block up to the block end. */
+        for (int r = begin; r < end; ++r)
+            internal::cholesky_row(A, cols, r, begin, end, L);
+
+        /* Compute the entries of all later rows in the block columns. */
+        int const num_groups = (cols - end + 3) / 4;
+#pragma omp parallel for schedule(dynamic, 4) if (cols - end > block_size)
+        for (int group = 0; group < num_groups; ++group)
+        {
+            int const r = end + group * 4;
+            if (r + 4 <= cols)
+                internal::cholesky_rows_4(A, cols, r, begin, end, L);
+            else
+                for (int ri = r; ri < cols; ++ri)
+                    internal::cholesky_row(A, cols, ri, begin, end, L);
+        }
+    }
+
+    /* Set right-of-diagonal entries zero. */
+    for (int r = 0; r < cols; ++r)
+        std::fill(L + r * cols + r + 1, L + (r + 1) * cols, T(0));
+}
+
+template <typename T>
+void
+cholesky_solve (T const* L, int const cols, T const* b, T* x)
+{
+    /* Forward substitution with L. */
+    for (int r = 0; r < cols; ++r)
+    {
+        T const* L_row_ptr = L + r * cols;
+        T result = b[r];
+        for (int c = 0; c < r; ++c)
+            result -= L_row_ptr[c] * x[c];
+        x[r] = L_row_ptr[r] > T(0) ? result / L_row_ptr[r] : T(0);
+    }
+
+    /* Backward substitution with L^T. */
+    for (int r = cols - 1; r >= 0; --r)
+    {
+        T result = x[r];
         for (int c = r + 1; c < cols; ++c)
-            (*out_ptr++) = T(0);
+            result -= L[c * cols + r] * x[c];
+        x[r] = L[r * cols + r] > T(0) ? result / L[r * cols + r] : T(0);
     }
 }
 
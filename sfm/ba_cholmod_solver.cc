@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann, Fabian Langguth
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifdef SFM_WITH_CHOLMOD
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <cholmod.h>
+
+#include "sfm/ba_direct_solver.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BA_NAMESPACE_BEGIN
+
+namespace
+{
+    /*
+     * Supernodal Cholesky factorization of CHOLMOD with the AMD ordering.
+     * The lower triangle of the block matrix is expanded to a scalar matrix
+     * in compressed columns once per pattern.
+     */
+    class CholmodSolver : public DirectSolver
+    {
+    public:
+        CholmodSolver (void);
+        ~CholmodSolver (void);
+
+        void analyze (std::size_t num_block_rows, int block_dim,
+            std::vector<std::size_t> const& outer,
+            std::vector<std::size_t> const& inner);
+        std::size_t get_factor_non_zero (void) const;
+        double get_factor_flops (void) const;
+        bool factorize (double const* values);
+        void solve (double const* b, double* x) const;
+
+    private:
+        void release (void);
+
+    private:
+        mutable cholmod_common common;
+        cholmod_sparse* matrix;
+        cholmod_factor* factor;
+        /* The index into the input values for every scalar entry. */
+        std::vector<std::size_t> value_index;
+        std::size_t factor_non_zero;
+        double factor_flops;
+    };
+
+    CholmodSolver::CholmodSolver (void)
+        : matrix(nullptr)
+        , factor(nullptr)
+        , factor_non_zero(0)
+        , factor_flops(0.0)
+    {
+        cholmod_start(&this->common);
+        this->common.nmethods = 1;
+        this->common.method[0].ordering = CHOLMOD_AMD;
+        this->common.supernodal = CHOLMOD_SUPERNODAL;
+        this->common.print = 0;
+    }
+
+    CholmodSolver::~CholmodSolver (void)
+    {
+        this->release();
+        cholmod_finish(&this->common);
+    }
+
+    void
+    CholmodSolver::release (void)
+    {
+        if (this->factor != nullptr)
+            cholmod_free_factor(&this->factor, &this->common);
+        if (this->matrix != nullptr)
+            cholmod_free_sparse(&this->matrix, &this->common);
+    }
+
+    void
+    CholmodSolver::analyze (std::size_t num_block_rows, int block_dim,
+        std::vector<std::size_t> const& outer,
+        std::vector<std::size_t> const& inner)
+    {
+        this->release();
+
+        /*
+         * Column c of the lower triangle is row c of the upper triangle by
+         * symmetry, so the block rows give the columns directly.
+         */
+        std::size_t const dim = block_dim;
+        std::size_t const size = num_block_rows * dim;
+        this->value_index.clear();
+        std::vector<int> col_ptr(1, 0);
+        std::vector<int> row_ind;
+        for (std::size_t r = 0; r < num_block_rows; ++r)
+            for (std::size_t a = 0; a < dim; ++a)
+            {
+                for (std::size_t k = outer[r]; k < outer[r + 1]; ++k)
+                {
+                    if (inner[k] < r)
+                        continue;
+                    for (std::size_t b = inner[k] == r ? a : 0; b < dim; ++b)
+                    {
+                        row_ind.push_back(inner[k] * dim + b);
+                        this->value_index.push_back(
+                            k * dim * dim + a * dim + b);
+                    }
+                }
+                col_ptr.push_back(row_ind.size());
+            }
+
+        this->matrix = cholmod_allocate_sparse(size, size, row_ind.size(),
+            1, 1, -1, CHOLMOD_REAL, &this->common);
+        if (this->matrix == nullptr)
+            throw std::runtime_error("Cannot allocate CHOLMOD matrix");
+        std::copy(col_ptr.begin(), col_ptr.end(),
+            static_cast<int*>(this->matrix->p));
+        std::copy(row_ind.begin(), row_ind.end(),
+            static_cast<int*>(this->matrix->i));
+
+        this->factor = cholmod_analyze(this->matrix, &this->common);
+        if (this->factor == nullptr)
+            throw std::runtime_error("CHOLMOD analysis failed");
+        this->factor_non_zero = static_cast<std::size_t>(this->common.lnz);
+        this->factor_flops = this->common.fl;
+    }
+
+    std::size_t
+    CholmodSolver::get_factor_non_zero (void) const
+    {
+        return this->factor_non_zero;
+    }
+
+    double
+    CholmodSolver::get_factor_flops (void) const
+    {
+        return this->factor_flops;
+    }
+
+    bool
+    CholmodSolver::factorize (double const* values)
+    {
+        double* x = static_cast<double*>(this->matrix->x);
+        for (std::size_t i = 0; i < this->value_index.size(); ++i)
+            x[i] = values[this->value_index[i]];
+        cholmod_factorize(this->matrix, this->factor, &this->common);
+        return this->common.status == CHOLMOD_OK;
+    }
+
+    void
+    CholmodSolver::solve (double const* b, double* x) const
+    {
+        std::size_t const size = this->matrix->nrow;
+        cholmod_dense* rhs = cholmod_allocate_dense(size, 1, size,
+            CHOLMOD_REAL, &this->common);
+        std::copy(b, b + size, static_cast<double*>(rhs->x));
+        cholmod_dense* solution = cholmod_solve(CHOLMOD_A, this->factor,
+            rhs, &this->common);
+        double const* solution_ptr = static_cast<double*>(solution->x);
+        std::copy(solution_ptr, solution_ptr + size, x);
+        cholmod_free_dense(&solution, &this->common);
+        cholmod_free_dense(&rhs, &this->common);
+    }
+}  /* namespace */
+
+DirectSolver::Ptr
+create_cholmod_solver (void)
+{
+    return DirectSolver::Ptr(new CholmodSolver());
+}
+
+SFM_BA_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_WITH_CHOLMOD */
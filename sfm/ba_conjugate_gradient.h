@@ -10,6 +10,10 @@
 #ifndef SFM_BA_CONJUGATE_GRADIENT_HEADER
 #define SFM_BA_CONJUGATE_GRADIENT_HEADER
 
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
 #include "sfm/defines.h"
 #include "sfm/ba_dense_vector.h"
 #include "sfm/ba_sparse_matrix.h"
@@ -36,6 +40,12 @@ public:
         Options (void);
         int max_iterations;
         T tolerance;
+        /**
+         * Starts from the given x instead of zero if it has the size of
+         * the system, e.g. the solution of a similar system. Defaults to
+         * false.
+         */
+        bool warm_start;
     };
 
     struct Status
@@ -62,6 +72,15 @@ public:
     Status solve (Functor const& A, Vector const& b, Vector* x,
         Functor const* P = nullptr);
 
+private:
+    /*
+     * Updates x += alpha * d and r -= alpha * Ad in a single pass and
+     * returns the new r^T r, which is summed in the chunks of
+     * DenseVector::dot() and thus independent of the number of threads.
+     */
+    static T update_solution (T const& alpha, Vector const& d,
+        Vector const& Ad, Vector* x, Vector* r);
+
 private:
     Options opts;
     Status status;
@@ -87,6 +106,7 @@ inline
 ConjugateGradient<T>::Options::Options (void)
     : max_iterations(100)
     , tolerance(1e-20)
+    , warm_start(false)
 {
 }
 
@@ -129,19 +149,21 @@ ConjugateGradient<T>::solve(Functor const& A, Vector const& b, Vector* x,
         return this->status;
     }
 
-    /* Set intial x = 0. */
+    /* Set intial x = 0, unless x is the initial guess. */
+    bool const warm_start = this->opts.warm_start
+        && x->size() == A.input_size();
     if (x->size() != A.input_size())
     {
         x->clear();
         x->resize(A.input_size(), T(0));
     }
-    else
+    else if (!warm_start)
     {
         x->fill(T(0));
     }
 
-    /* Initial residual is r = b - Ax with x = 0. */
-    Vector r = b;
+    /* Initial residual is r = b - Ax, which is b with x = 0. */
+    Vector r = warm_start ? b.subtract(A.multiply(*x)) : b;
 
     /* Regular search direction. */
     Vector d;
@@ -171,12 +193,8 @@ ConjugateGradient<T>::solve(Functor const& A, Vector const& b, Vector* x,
         Vector Ad = A.multiply(d);
         T alpha = r_dot_r / d.dot(Ad);
 
-        /* Update parameter vector. */
-        *x = (*x).add(d.multiply(alpha));
-
-        /* Compute new residual and its norm. */
-        r = r.subtract(Ad.multiply(alpha));
-        T new_r_dot_r = r.dot(r);
+        /* Update parameter vector, the new residual and its norm. */
+        T new_r_dot_r = update_solution(alpha, d, Ad, x, &r);
 
         /* Check tolerance condition. */
         if (new_r_dot_r < this->opts.tolerance)
@@ -197,10 +215,7 @@ ConjugateGradient<T>::solve(Functor const& A, Vector const& b, Vector* x,
          * The next residual will be orthogonal to new Krylov space.
          */
         T beta = new_r_dot_r / r_dot_r;
-        if (P != nullptr)
-            d = z.add(d.multiply(beta));
-        else
-            d = r.add(d.multiply(beta));
+        d.scale_add(beta, P != nullptr ? z : r);
 
         /* Update residual norm. */
         r_dot_r = new_r_dot_r;
@@ -210,6 +225,40 @@ ConjugateGradient<T>::solve(Functor const& A, Vector const& b, Vector* x,
     return this->status;
 }
 
+template <typename T>
+T
+ConjugateGradient<T>::update_solution (T const& alpha, Vector const& d,
+    Vector const& Ad, Vector* x, Vector* r)
+{
+    std::size_t const size = x->size();
+    std::size_t const chunk_size = internal::PARALLEL_CHUNK_SIZE;
+    std::int64_t const num_chunks = (size + chunk_size - 1) / chunk_size;
+    std::vector<T> chunk_sums(num_chunks, T(0));
+    T const* d_ptr = d.data();
+    T const* ad_ptr = Ad.data();
+    T* x_ptr = x->data();
+    T* r_ptr = r->data();
+#pragma omp parallel for schedule(static) if (num_chunks > 1)
+    for (std::int64_t chunk = 0; chunk < num_chunks; ++chunk)
+    {
+        std::size_t const begin = chunk * chunk_size;
+        std::size_t const end = std::min(begin + chunk_size, size);
+        T sum(0);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            x_ptr[i] += alpha * d_ptr[i];
+            r_ptr[i] -= alpha * ad_ptr[i];
+            sum += r_ptr[i] * r_ptr[i];
+        }
+        chunk_sums[chunk] = sum;
+    }
+
+    T ret(0);
+    for (std::int64_t chunk = 0; chunk < num_chunks; ++chunk)
+        ret += chunk_sums[chunk];
+    return ret;
+}
+
 /* ---------------------------------------------------------------- */
 
 template <typename T>
@@ -10,15 +10,44 @@
 #ifndef SFM_BA_DENSE_VECTOR_HEADER
 #define SFM_BA_DENSE_VECTOR_HEADER
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 
+#include "util/memory.h"
 #include "sfm/defines.h"
 
 SFM_NAMESPACE_BEGIN
 SFM_BA_NAMESPACE_BEGIN
 
+namespace internal
+{
+    /*
+     * Vectors and matrices with fewer entries are processed by a single
+     * thread, which avoids the overhead of OpenMP for small problems.
+     * This is also the chunk size of parallel sums, which makes the sums
+     * independent of the number of threads.
+     */
+    std::size_t const PARALLEL_CHUNK_SIZE = 4096;
+
+    /*
+     * Returns true if the two residuals of every observation add up to a
+     * parallel chunk. The observations of small problems are processed by
+     * a single thread, e.g. for many small problems solved concurrently.
+     */
+    inline bool
+    parallel_observations (std::size_t num_observations)
+    {
+        return 2 * num_observations >= PARALLEL_CHUNK_SIZE;
+    }
+}
+
+/**
+ * Dense vector for the bundle adjustment. Operations on large vectors are
+ * computed in parallel with OpenMP.
+ */
 template <typename T>
 class DenseVector
 {
@@ -53,8 +82,13 @@ public:
     void multiply_self (T const& factor);
     void negate_self (void);
 
+    /** Computes this += factor * rhs in-place without a temporary. */
+    void add_scaled (T const& factor, DenseVector const& rhs);
+    /** Computes this = factor * this + rhs in-place without a temporary. */
+    void scale_add (T const& factor, DenseVector const& rhs);
+
 private:
-    std::vector<T> values;
+    util::TrackedVector<T, util::MEMORY_BA> values;
 };
 
 /* ------------------------ Implementation ------------------------ */
@@ -142,8 +176,11 @@ DenseVector<T>
 DenseVector<T>::operator- (void) const
 {
     DenseVector ret(this->size());
-    for (std::size_t i = 0; i < this->size(); ++i)
-        ret[i] = -this->at(i);
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
+        ret.values[i] = -this->values[i];
     return ret;
 }
 
@@ -208,9 +245,33 @@ DenseVector<T>::dot (DenseVector<T> const& rhs) const
     if (this->size() != rhs.size())
         throw std::invalid_argument("Incompatible vector dimensions");
 
+    /* Small vectors are summed in order, large vectors in chunks. */
+    std::size_t const chunk_size = internal::PARALLEL_CHUNK_SIZE;
+    if (this->size() < chunk_size)
+    {
+        T ret(0);
+        for (std::size_t i = 0; i < this->size(); ++i)
+            ret += this->values[i] * rhs.values[i];
+        return ret;
+    }
+
+    std::int64_t const num_chunks = (this->size() + chunk_size - 1)
+        / chunk_size;
+    std::vector<T> chunk_sums(num_chunks, T(0));
+#pragma omp parallel for schedule(static)
+    for (std::int64_t chunk = 0; chunk < num_chunks; ++chunk)
+    {
+        std::size_t const begin = chunk * chunk_size;
+        std::size_t const end = std::min(begin + chunk_size, this->size());
+        T sum(0);
+        for (std::size_t i = begin; i < end; ++i)
+            sum += this->values[i] * rhs.values[i];
+        chunk_sums[chunk] = sum;
+    }
+
     T ret(0);
-    for (std::size_t i = 0; i < this->size(); ++i)
-        ret += this->values[i] * rhs.values[i];
+    for (std::int64_t chunk = 0; chunk < num_chunks; ++chunk)
+        ret += chunk_sums[chunk];
     return ret;
 }
 
@@ -222,7 +283,10 @@ DenseVector<T>::subtract (DenseVector<T> const& rhs) const
         throw std::invalid_argument("Incompatible vector dimensions");
 
     DenseVector<T> ret(this->size(), T(0));
-    for (std::size_t i = 0; i < this->size(); ++i)
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
         ret.values[i] = this->values[i] - rhs.values[i];
     return ret;
 }
@@ -235,7 +299,10 @@ DenseVector<T>::add (DenseVector<T> const& rhs) const
         throw std::invalid_argument("Incompatible vector dimensions");
 
     DenseVector<T> ret(this->size(), T(0));
-    for (std::size_t i = 0; i < this->size(); ++i)
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
         ret.values[i] = this->values[i] + rhs.values[i];
     return ret;
 }
@@ -245,8 +312,11 @@ DenseVector<T>
 DenseVector<T>::multiply (T const& factor) const
 {
     DenseVector<T> ret(this->size(), T(0));
-    for (std::size_t i = 0; i < this->size(); ++i)
-        ret[i] = this->at(i) * factor;
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
+        ret.values[i] = this->values[i] * factor;
     return ret;
 }
 
@@ -254,16 +324,50 @@ template <typename T>
 void
 DenseVector<T>::multiply_self (T const& factor)
 {
-    for (std::size_t i = 0; i < this->size(); ++i)
-        this->at(i) *= factor;
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
+        this->values[i] *= factor;
 }
 
 template <typename T>
 void
 DenseVector<T>::negate_self (void)
 {
-    for (std::size_t i = 0; i < this->size(); ++i)
-        this->at(i) = -this->at(i);
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
+        this->values[i] = -this->values[i];
+}
+
+template <typename T>
+void
+DenseVector<T>::add_scaled (T const& factor, DenseVector<T> const& rhs)
+{
+    if (this->size() != rhs.size())
+        throw std::invalid_argument("Incompatible vector dimensions");
+
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
+        this->values[i] += factor * rhs.values[i];
+}
+
+template <typename T>
+void
+DenseVector<T>::scale_add (T const& factor, DenseVector<T> const& rhs)
+{
+    if (this->size() != rhs.size())
+        throw std::invalid_argument("Incompatible vector dimensions");
+
+    std::int64_t const size = this->size();
+#pragma omp parallel for schedule(static) \
+    if (this->size() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < size; ++i)
+        this->values[i] = factor * this->values[i] + rhs.values[i];
 }
 
 SFM_BA_NAMESPACE_END
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann, Fabian Langguth
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+#include "sfm/ba_cholesky.h"
+#include "sfm/ba_direct_solver.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BA_NAMESPACE_BEGIN
+
+#ifdef SFM_WITH_CHOLMOD
+/* Defined in ba_cholmod_solver.cc. */
+DirectSolver::Ptr create_cholmod_solver (void);
+#endif
+
+namespace
+{
+    std::size_t const NO_BLOCK = std::numeric_limits<std::size_t>::max();
+
+    /*
+     * Solves L * x = b in-place for the lower-triangular block L, where
+     * components of zero diagonal entries are set to zero.
+     */
+    void
+    forward_substitute (double const* L, int dim, double* x)
+    {
+        for (int r = 0; r < dim; ++r)
+        {
+            double result = x[r];
+            for (int c = 0; c < r; ++c)
+                result -= L[r * dim + c] * x[c];
+            x[r] = L[r * dim + r] > 0.0 ? result / L[r * dim + r] : 0.0;
+        }
+    }
+
+    /* Solves L^T * x = b in-place for the lower-triangular block L. */
+    void
+    backward_substitute (double const* L, int dim, double* x)
+    {
+        for (int r = dim - 1; r >= 0; --r)
+        {
+            double result = x[r];
+            for (int c = r + 1; c < dim; ++c)
+                result -= L[c * dim + r] * x[c];
+            x[r] = L[r * dim + r] > 0.0 ? result / L[r * dim + r] : 0.0;
+        }
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+DirectSolver::Ptr
+DirectSolver::create (Backend backend)
+{
+    switch (backend)
+    {
+        case BACKEND_BLOCK_CHOLESKY:
+            return Ptr(new BlockCholesky());
+        case BACKEND_CHOLMOD:
+#ifdef SFM_WITH_CHOLMOD
+            return create_cholmod_solver();
+#else
+            throw std::invalid_argument("Compiled without CHOLMOD");
+#endif
+        default:
+            throw std::invalid_argument("Invalid direct solver backend");
+    }
+}
+
+bool
+DirectSolver::is_available (Backend backend)
+{
+#ifdef SFM_WITH_CHOLMOD
+    return backend == BACKEND_BLOCK_CHOLESKY || backend == BACKEND_CHOLMOD;
+#else
+    return backend == BACKEND_BLOCK_CHOLESKY;
+#endif
+}
+
+DirectSolver::Backend
+DirectSolver::get_default_backend (void)
+{
+    return is_available(BACKEND_CHOLMOD)
+        ? BACKEND_CHOLMOD : BACKEND_BLOCK_CHOLESKY;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BlockCholesky::analyze (std::size_t num_block_rows, int block_dim,
+    std::vector<std::size_t> const& outer,
+    std::vector<std::size_t> const& inner)
+{
+    std::size_t const num_rows = num_block_rows;
+    this->block_dim = block_dim;
+
+    /* The graph of the block rows without the diagonal. */
+    std::vector<std::set<std::size_t>> graph(num_rows);
+    for (std::size_t r = 0; r < num_rows; ++r)
+        for (std::size_t k = outer[r]; k < outer[r + 1]; ++k)
+            if (inner[k] != r)
+            {
+                graph[r].insert(inner[k]);
+                graph[inner[k]].insert(r);
+            }
+
+    /*
+     * Minimum degree ordering: the block row with the fewest neighbors is
+     * eliminated next, which connects all its neighbors. The neighbors at
+     * elimination are the rows of its column in L, including the fill.
+     */
+    std::set<std::pair<std::size_t, std::size_t>> queue;
+    for (std::size_t r = 0; r < num_rows; ++r)
+        queue.insert(std::make_pair(graph[r].size(), r));
+
+    this->permutation.clear();
+    this->permutation.reserve(num_rows);
+    std::vector<std::vector<std::size_t>> columns(num_rows);
+    while (!queue.empty())
+    {
+        std::size_t const node = queue.begin()->second;
+        queue.erase(queue.begin());
+        this->permutation.push_back(node);
+
+        std::set<std::size_t> const& neighbors = graph[node];
+        columns[node].assign(neighbors.begin(), neighbors.end());
+        for (std::size_t neighbor : neighbors)
+        {
+            std::set<std::size_t>& adjacent = graph[neighbor];
+            queue.erase(std::make_pair(adjacent.size(), neighbor));
+            adjacent.erase(node);
+            for (std::size_t other : neighbors)
+                if (other != neighbor)
+                    adjacent.insert(other);
+            queue.insert(std::make_pair(adjacent.size(), neighbor));
+        }
+        graph[node].clear();
+    }
+
+    this->inverse_permutation.resize(num_rows);
+    for (std::size_t k = 0; k < num_rows; ++k)
+        this->inverse_permutation[this->permutation[k]] = k;
+
+    /*
+     * The pattern of L in the eliminated order, the diagonal first. A
+     * column with n blocks below the diagonal takes n triangular solves
+     * and n * (n + 1) / 2 block products of 2 * dim^3 operations.
+     */
+    double const block_flops = std::pow(static_cast<double>(block_dim), 3);
+    this->factor_flops = 0.0;
+    this->factor_outer.assign(1, 0);
+    this->factor_inner.clear();
+    for (std::size_t k = 0; k < num_rows; ++k)
+    {
+        std::vector<std::size_t>& column = columns[this->permutation[k]];
+        double const n = static_cast<double>(column.size());
+        this->factor_flops += (1.0 / 3.0 + n + n * (n + 1.0)) * block_flops;
+        for (std::size_t& row : column)
+            row = this->inverse_permutation[row];
+        std::sort(column.begin(), column.end());
+        this->factor_inner.push_back(k);
+        this->factor_inner.insert(this->factor_inner.end(),
+            column.begin(), column.end());
+        this->factor_outer.push_back(this->factor_inner.size());
+    }
+
+    /* The lower blocks of the input are mapped to the blocks of L. */
+    this->factor.resize(this->get_factor_non_zero());
+    this->input_blocks.resize(inner.size());
+    for (std::size_t r = 0; r < num_rows; ++r)
+        for (std::size_t k = outer[r]; k < outer[r + 1]; ++k)
+        {
+            std::size_t const row = this->inverse_permutation[r];
+            std::size_t const col = this->inverse_permutation[inner[k]];
+            if (row < col)
+            {
+                this->input_blocks[k] = NO_BLOCK;
+                continue;
+            }
+            double const* block = this->factor_block(row, col);
+            this->input_blocks[k] = block - this->factor.data();
+        }
+}
+
+double*
+BlockCholesky::factor_block (std::size_t row, std::size_t col)
+{
+    std::vector<std::size_t>::const_iterator begin
+        = this->factor_inner.begin() + this->factor_outer[col];
+    std::vector<std::size_t>::const_iterator end
+        = this->factor_inner.begin() + this->factor_outer[col + 1];
+    std::vector<std::size_t>::const_iterator iter = row == col
+        ? begin : std::lower_bound(begin + 1, end, row);
+    if (iter == end || *iter != row)
+        throw std::runtime_error("Block not in factor pattern");
+    std::size_t const index = iter - this->factor_inner.begin();
+    return this->factor.data() + index * this->block_dim * this->block_dim;
+}
+
+bool
+BlockCholesky::factorize (double const* values)
+{
+    int const dim = this->block_dim;
+    int const block_size = dim * dim;
+    std::size_t const num_cols = this->factor_outer.size() - 1;
+
+    std::fill(this->factor.begin(), this->factor.end(), 0.0);
+    for (std::size_t k = 0; k < this->input_blocks.size(); ++k)
+        if (this->input_blocks[k] != NO_BLOCK)
+            std::copy(values + k * block_size, values + (k + 1) * block_size,
+                this->factor.begin() + this->input_blocks[k]);
+
+    /*
+     * Right-looking factorization: every column is decomposed and then
+     * subtracted from the later columns, L_ik -= L_ij * L_kj^T.
+     */
+    for (std::size_t j = 0; j < num_cols; ++j)
+    {
+        std::size_t const begin = this->factor_outer[j];
+        std::size_t const end = this->factor_outer[j + 1];
+        double* L_jj = this->factor.data() + begin * block_size;
+        cholesky_decomposition(L_jj, dim, L_jj);
+        for (int i = 0; i < dim; ++i)
+            if (!std::isfinite(L_jj[i * dim + i]))
+                return false;
+
+        /* The rows of L_ij are the solutions of L_jj * x = A_ij^T. */
+        for (std::size_t k = begin + 1; k < end; ++k)
+        {
+            double* L_ij = this->factor.data() + k * block_size;
+            for (int r = 0; r < dim; ++r)
+                forward_substitute(L_jj, dim, L_ij + r * dim);
+        }
+
+        std::ptrdiff_t const num_updates = end - begin - 1;
+#pragma omp parallel for schedule(dynamic) if (num_updates > 8)
+        for (std::ptrdiff_t ki = 0; ki < num_updates; ++ki)
+        {
+            std::size_t const k = begin + 1 + ki;
+            std::size_t const col = this->factor_inner[k];
+            double const* L_kj = this->factor.data() + k * block_size;
+            for (std::size_t i = k; i < end; ++i)
+            {
+                double const* L_ij = this->factor.data() + i * block_size;
+                double* L_ik = this->factor_block(this->factor_inner[i], col);
+                for (int r = 0; r < dim; ++r)
+                    for (int c = 0; c < dim; ++c)
+                    {
+                        double sum = 0.0;
+                        for (int d = 0; d < dim; ++d)
+                            sum += L_ij[r * dim + d] * L_kj[c * dim + d];
+                        L_ik[r * dim + c] -= sum;
+                    }
+            }
+        }
+    }
+
+    return true;
+}
+
+void
+BlockCholesky::solve (double const* b, double* x) const
+{
+    int const dim = this->block_dim;
+    int const block_size = dim * dim;
+    std::size_t const num_cols = this->factor_outer.size() - 1;
+
+    std::vector<double> y(num_cols * dim);
+    for (std::size_t k = 0; k < num_cols; ++k)
+        std::copy(b + this->permutation[k] * dim,
+            b + (this->permutation[k] + 1) * dim, y.begin() + k * dim);
+
+    /* Forward substitution with L. */
+    for (std::size_t j = 0; j < num_cols; ++j)
+    {
+        std::size_t const begin = this->factor_outer[j];
+        double* y_j = y.data() + j * dim;
+        forward_substitute(this->factor.data() + begin * block_size, dim, y_j);
+        for (std::size_t k = begin + 1; k < this->factor_outer[j + 1]; ++k)
+        {
+            double const* L_ij = this->factor.data() + k * block_size;
+            double* y_i = y.data() + this->factor_inner[k] * dim;
+            for (int r = 0; r < dim; ++r)
+                for (int c = 0; c < dim; ++c)
+                    y_i[r] -= L_ij[r * dim + c] * y_j[c];
+        }
+    }
+
+    /* Backward substitution with L^T. */
+    for (std::size_t j = num_cols; j-- > 0;)
+    {
+        std::size_t const begin = this->factor_outer[j];
+        double* y_j = y.data() + j * dim;
+        for (std::size_t k = begin + 1; k < this->factor_outer[j + 1]; ++k)
+        {
+            double const* L_ij = this->factor.data() + k * block_size;
+            double const* y_i = y.data() + this->factor_inner[k] * dim;
+            for (int r = 0; r < dim; ++r)
+                for (int c = 0; c < dim; ++c)
+                    y_j[c] -= L_ij[r * dim + c] * y_i[r];
+        }
+        backward_substitute(this->factor.data() + begin * block_size,
+            dim, y_j);
+    }
+
+    for (std::size_t k = 0; k < num_cols; ++k)
+        std::copy(y.begin() + k * dim, y.begin() + (k + 1) * dim,
+            x + this->permutation[k] * dim);
+}
+
+SFM_BA_NAMESPACE_END
+SFM_NAMESPACE_END
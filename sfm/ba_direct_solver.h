@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann, Fabian Langguth
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BA_DIRECT_SOLVER_HEADER
+#define SFM_BA_DIRECT_SOLVER_HEADER
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BA_NAMESPACE_BEGIN
+
+/**
+ * Interface of sparse direct solvers for symmetric, positive definite
+ * systems of square blocks, e.g. the reduced camera system of bundle
+ * adjustment.
+ *
+ * The pattern of the system is given in block rows, with the blocks of
+ * both triangles and all diagonal blocks, and the columns sorted within
+ * every block row. The values are the blocks in the order of the pattern,
+ * every block in row-major order. analyze() computes the fill-reducing
+ * ordering and the symbolic factorization of a pattern once, factorize()
+ * and solve() are then called for every set of values with that pattern.
+ */
+class DirectSolver
+{
+public:
+    /** The available implementations. */
+    enum Backend
+    {
+        /** In-tree block Cholesky with minimum degree ordering. */
+        BACKEND_BLOCK_CHOLESKY,
+        /** Supernodal Cholesky of CHOLMOD, only if compiled with CHOLMOD. */
+        BACKEND_CHOLMOD
+    };
+
+    typedef std::unique_ptr<DirectSolver> Ptr;
+
+public:
+    virtual ~DirectSolver (void) = default;
+
+    /** Creates a solver of the backend, throws if it is not available. */
+    static Ptr create (Backend backend);
+
+    /** Returns true if the backend is compiled in. */
+    static bool is_available (Backend backend);
+
+    /** Returns CHOLMOD if available, the block Cholesky otherwise. */
+    static Backend get_default_backend (void);
+
+    /** Computes the ordering and the symbolic factorization. */
+    virtual void analyze (std::size_t num_block_rows, int block_dim,
+        std::vector<std::size_t> const& outer,
+        std::vector<std::size_t> const& inner) = 0;
+
+    /**
+     * Returns the number of non-zero values of the lower triangle of the
+     * factor after analyze(), which estimates the cost of the solver.
+     */
+    virtual std::size_t get_factor_non_zero (void) const = 0;
+
+    /**
+     * Returns the estimated floating point operations of factorize() after
+     * analyze(), which compares the solver to iterative solvers.
+     */
+    virtual double get_factor_flops (void) const = 0;
+
+    /**
+     * Computes the numeric factorization for the values. Returns false if
+     * the factorization failed, e.g. for matrices that are not positive
+     * definite.
+     */
+    virtual bool factorize (double const* values) = 0;
+
+    /** Solves with the last factorization, b and x can be the same. */
+    virtual void solve (double const* b, double* x) const = 0;
+};
+
+/**
+ * Block Cholesky decomposition with a minimum degree ordering of the block
+ * rows. The ordering and the pattern of the factor follow from the block
+ * graph, which is much smaller than the graph of the values. The diagonal
+ * blocks are decomposed with cholesky_decomposition(), so components with
+ * zero diagonal entries, e.g. for unconstrained parameters, are zero in
+ * the solution.
+ */
+class BlockCholesky : public DirectSolver
+{
+public:
+    BlockCholesky (void);
+
+    void analyze (std::size_t num_block_rows, int block_dim,
+        std::vector<std::size_t> const& outer,
+        std::vector<std::size_t> const& inner);
+    std::size_t get_factor_non_zero (void) const;
+    double get_factor_flops (void) const;
+    bool factorize (double const* values);
+    void solve (double const* b, double* x) const;
+
+private:
+    /* Returns the block of L at block row 'row' in block column 'col'. */
+    double* factor_block (std::size_t row, std::size_t col);
+
+private:
+    int block_dim;
+    /* The eliminated block row for every position and its inverse. */
+    std::vector<std::size_t> permutation;
+    std::vector<std::size_t> inverse_permutation;
+    /* The block rows of every block column of L, the diagonal first. */
+    std::vector<std::size_t> factor_outer;
+    std::vector<std::size_t> factor_inner;
+    /* The block of L for every input block, or none for upper blocks. */
+    std::vector<std::size_t> input_blocks;
+    std::vector<double> factor;
+    double factor_flops;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+BlockCholesky::BlockCholesky (void)
+    : block_dim(0)
+    , factor_flops(0.0)
+{
+}
+
+inline std::size_t
+BlockCholesky::get_factor_non_zero (void) const
+{
+    return this->factor_inner.size() * this->block_dim * this->block_dim;
+}
+
+inline double
+BlockCholesky::get_factor_flops (void) const
+{
+    return this->factor_flops;
+}
+
+SFM_BA_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BA_DIRECT_SOLVER_HEADER */
@@ -7,8 +7,15 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <stdexcept>
 #include <iostream>
+#include <utility>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
 #include "util/timer.h"
 #include "math/matrix.h"
@@ -22,6 +29,15 @@ SFM_BA_NAMESPACE_BEGIN
 
 namespace
 {
+    /* Returns a monotonic time stamp in milliseconds for statistics. */
+    double
+    get_timestamp (void)
+    {
+        typedef std::chrono::duration<double, std::milli> Milliseconds;
+        return std::chrono::duration_cast<Milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     /*
      * Inverts a symmetric, positive definite matrix with NxN bocks on its
      * diagonal using Cholesky decomposition. All other entries must be zero.
@@ -95,9 +111,9 @@ namespace
     {
         SparseMatrix<double>::Triplets triplets;
         triplets.reserve(A.num_cols() * block_size);
+        std::vector<DenseVector<double>> columns(block_size);
         for (std::size_t block = 0; block < A.num_cols(); block += block_size)
         {
-            std::vector<DenseVector<double>> columns(block_size);
             for (std::size_t col = 0; col < block_size; ++col)
                 A.column_nonzeros(block + col, &columns[col]);
             for (std::size_t col = 0; col < block_size; ++col)
@@ -115,6 +131,663 @@ namespace
         B->allocate(A.num_cols(), A.num_cols());
         B->set_from_triplets(triplets);
     }
+
+    /*
+     * Solves the linear system with the dense Cholesky decomposition of A.
+     * Returns false if the solution is not finite.
+     */
+    template <typename T>
+    bool
+    solve_dense_cholesky (std::vector<T>* matrix, int cols,
+        DenseVector<T> const& b, DenseVector<T>* x)
+    {
+        cholesky_decomposition(matrix->data(), cols, matrix->data());
+        x->resize(b.size());
+        cholesky_solve(matrix->data(), cols, b.data(), x->data());
+        for (std::size_t i = 0; i < x->size(); ++i)
+            if (!std::isfinite(x->at(i)))
+                return false;
+        return true;
+    }
+
+    template <typename T, typename Matrix>
+    bool
+    solve_dense_cholesky (Matrix const& A,
+        DenseVector<T> const& b, DenseVector<T>* x)
+    {
+        std::vector<T> matrix;
+        A.to_dense(&matrix);
+        return solve_dense_cholesky(&matrix, static_cast<int>(A.num_cols()),
+            b, x);
+    }
+
+    /*
+     * Solves the bordered system [ A G; G^T K ] x = b like above, where G
+     * has a single block column of three columns and K is a 3x3 block.
+     */
+    template <typename T, typename Matrix, typename Border>
+    bool
+    solve_dense_cholesky (Matrix const& A, Border const& G, T const* K,
+        DenseVector<T> const& b, DenseVector<T>* x)
+    {
+        std::size_t const rows = A.num_rows();
+        std::size_t const cols = rows + 3;
+        std::vector<T> a_matrix, g_matrix;
+        A.to_dense(&a_matrix);
+        G.to_dense(&g_matrix);
+        std::vector<T> matrix(cols * cols, T(0));
+        for (std::size_t r = 0; r < rows; ++r)
+        {
+            std::copy(a_matrix.begin() + r * rows,
+                a_matrix.begin() + (r + 1) * rows, matrix.begin() + r * cols);
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                matrix[r * cols + rows + c] = g_matrix[r * 3 + c];
+                matrix[(rows + c) * cols + r] = g_matrix[r * 3 + c];
+            }
+        }
+        for (std::size_t r = 0; r < 3; ++r)
+            std::copy(K + r * 3, K + r * 3 + 3,
+                matrix.begin() + (rows + r) * cols + rows);
+        return solve_dense_cholesky(&matrix, static_cast<int>(cols), b, x);
+    }
+
+    /*
+     * Solves the linear system with the sparse direct solver, which is
+     * analyzed for the pattern of A. The bordered system with G and K is
+     * solved by eliminating A from the border with the solutions for the
+     * columns of G, i.e. (K - G^T A^-1 G) x_k = b_k - G^T A^-1 b_a. The
+     * values are converted to double. Returns false if the factorization
+     * fails or the solution is not finite.
+     */
+    template <typename T, int N>
+    bool
+    solve_sparse_cholesky (DirectSolver* solver,
+        BlockSparseMatrix<T, N, N> const& A,
+        BlockSparseMatrix<T, N, 3> const* G, T const* K,
+        DenseVector<T> const& b, DenseVector<T>* x)
+    {
+        std::size_t const rows = A.num_rows();
+        std::vector<double> values(A.block(0),
+            A.block(0) + A.num_blocks() * N * N);
+        if (!solver->factorize(values.data()))
+            return false;
+        std::vector<double> y(b.begin(), b.begin() + rows);
+        solver->solve(y.data(), y.data());
+        x->resize(b.size());
+
+        if (G != nullptr)
+        {
+            std::vector<T> g_matrix;
+            G->to_dense(&g_matrix);
+            std::vector<double> columns(3 * rows);
+            for (int c = 0; c < 3; ++c)
+            {
+                double* column = columns.data() + c * rows;
+                for (std::size_t r = 0; r < rows; ++r)
+                    column[r] = g_matrix[r * 3 + c];
+                solver->solve(column, column);
+            }
+
+            double k_matrix[9];
+            double rhs_k[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                rhs_k[i] = b[rows + i];
+                for (std::size_t r = 0; r < rows; ++r)
+                    rhs_k[i] -= g_matrix[r * 3 + i] * y[r];
+                for (int j = 0; j < 3; ++j)
+                {
+                    double const* column = columns.data() + j * rows;
+                    k_matrix[i * 3 + j] = K[i * 3 + j];
+                    for (std::size_t r = 0; r < rows; ++r)
+                        k_matrix[i * 3 + j] -= g_matrix[r * 3 + i] * column[r];
+                }
+            }
+            double delta_k[3];
+            cholesky_decomposition(k_matrix, 3, k_matrix);
+            cholesky_solve(k_matrix, 3, rhs_k, delta_k);
+            for (int c = 0; c < 3; ++c)
+            {
+                double const* column = columns.data() + c * rows;
+                for (std::size_t r = 0; r < rows; ++r)
+                    y[r] -= column[r] * delta_k[c];
+                x->at(rows + c) = static_cast<T>(delta_k[c]);
+            }
+        }
+
+        for (std::size_t r = 0; r < rows; ++r)
+            x->at(r) = static_cast<T>(y[r]);
+        for (std::size_t i = 0; i < x->size(); ++i)
+            if (!std::isfinite(x->at(i)))
+                return false;
+        return true;
+    }
+
+    /* Computes A^T, the pattern is only computed if A^T is empty. */
+    void
+    transpose_reuse (SparseMatrix<double> const& A,
+        SparseMatrix<double>* A_t)
+    {
+        if (A_t->num_rows() == 0)
+            *A_t = A.transpose();
+        else
+            A.transpose_values(A_t);
+    }
+
+    /* Computes A * B, the pattern is only computed if C is empty. */
+    void
+    multiply_reuse (SparseMatrix<double> const& A,
+        SparseMatrix<double> const& B, SparseMatrix<double>* C)
+    {
+        if (C->num_rows() == 0)
+            *C = A.multiply_pattern(B);
+        A.multiply_values(B, C);
+    }
+
+    /*
+     * Computes the pattern of S = B - E * C^-1 * E^T for C with 3x3 blocks
+     * on its diagonal, which is the union of the patterns of B and E * E^T.
+     * The values are computed with schur_complement_values().
+     */
+    void
+    schur_complement_pattern (SparseMatrix<double> const& B,
+        SparseMatrix<double> const& E, SparseMatrix<double> const& ET,
+        SparseMatrix<double>* S)
+    {
+        std::size_t const num_cols = B.num_cols();
+        std::size_t const* b_rows = B.row_indices();
+        std::size_t const* e_rows = E.row_indices();
+        std::size_t const* et_rows = ET.row_indices();
+        std::vector<std::size_t> outer(num_cols + 1, 0);
+        std::vector<std::size_t> inner;
+        inner.reserve(B.num_non_zero() + E.num_non_zero());
+
+        /* Rows are marked with the last column they were added to. */
+        std::vector<std::size_t> marker(num_cols, num_cols);
+        for (std::size_t col = 0; col < num_cols; ++col)
+        {
+            outer[col] = inner.size();
+            for (std::size_t i = B.column_begin(col);
+                i < B.column_end(col); ++i)
+                if (marker[b_rows[i]] != col)
+                {
+                    marker[b_rows[i]] = col;
+                    inner.push_back(b_rows[i]);
+                }
+            for (std::size_t i = ET.column_begin(col);
+                i < ET.column_end(col); ++i)
+                for (std::size_t j = E.column_begin(et_rows[i]);
+                    j < E.column_end(et_rows[i]); ++j)
+                    if (marker[e_rows[j]] != col)
+                    {
+                        marker[e_rows[j]] = col;
+                        inner.push_back(e_rows[j]);
+                    }
+            std::sort(inner.begin() + outer[col], inner.end());
+        }
+        outer[num_cols] = inner.size();
+
+        S->allocate(num_cols, num_cols);
+        S->set_pattern(outer, inner);
+    }
+
+    /*
+     * Computes the values of S = B - E * C^-1 * E^T into the pattern from
+     * schur_complement_pattern(), where C already is inverted. E * C^-1 is
+     * never formed: every point p of camera parameter s subtracts the
+     * columns E_p of the point, weighted with C_p^-1 * E_p(s, :)^T, from
+     * column s of S. The columns are computed in parallel.
+     */
+    void
+    schur_complement_values (SparseMatrix<double> const& B,
+        SparseMatrix<double> const& E, SparseMatrix<double> const& ET,
+        SparseMatrix<double> const& C, SparseMatrix<double>* S)
+    {
+        std::size_t const* b_rows = B.row_indices();
+        std::size_t const* e_rows = E.row_indices();
+        std::size_t const* et_rows = ET.row_indices();
+        std::size_t const* s_rows = S->row_indices();
+        double const* b_values = B.begin();
+        double const* e_values = E.begin();
+        double const* et_values = ET.begin();
+        double const* c_values = C.begin();
+        double* s_values = S->begin();
+
+#pragma omp parallel \
+    if (S->num_non_zero() >= internal::PARALLEL_CHUNK_SIZE)
+        {
+            std::vector<double> column(S->num_rows(), 0.0);
+#pragma omp for schedule(dynamic, 64)
+            for (std::int64_t c = 0; c < static_cast<std::int64_t>(
+                S->num_cols()); ++c)
+            {
+                std::size_t const col = static_cast<std::size_t>(c);
+                for (std::size_t i = S->column_begin(col);
+                    i < S->column_end(col); ++i)
+                    column[s_rows[i]] = 0.0;
+                for (std::size_t i = B.column_begin(col);
+                    i < B.column_end(col); ++i)
+                    column[b_rows[i]] = b_values[i];
+
+                /* The entries of a point are consecutive rows of E^T. */
+                std::size_t const end = ET.column_end(col);
+                for (std::size_t i = ET.column_begin(col); i < end; )
+                {
+                    std::size_t const point = et_rows[i] / 3;
+                    double e_row[3] = { 0.0, 0.0, 0.0 };
+                    for (; i < end && et_rows[i] / 3 == point; ++i)
+                        e_row[et_rows[i] % 3] = et_values[i];
+
+                    double weights[3];
+                    double const* c_block = c_values + point * 9;
+                    for (int r = 0; r < 3; ++r)
+                        weights[r] = c_block[r * 3 + 0] * e_row[0]
+                            + c_block[r * 3 + 1] * e_row[1]
+                            + c_block[r * 3 + 2] * e_row[2];
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        std::size_t const e_col = point * 3 + k;
+                        for (std::size_t j = E.column_begin(e_col);
+                            j < E.column_end(e_col); ++j)
+                            column[e_rows[j]] -= e_values[j] * weights[k];
+                    }
+                }
+
+                for (std::size_t i = S->column_begin(col);
+                    i < S->column_end(col); ++i)
+                    s_values[i] = column[s_rows[i]];
+            }
+        }
+    }
+
+    /* Converts a vector to the scalar type of the output vector. */
+    template <typename T, typename U>
+    void
+    convert_vector (DenseVector<U> const& in, DenseVector<T>* out)
+    {
+        out->resize(in.size());
+        std::copy(in.begin(), in.end(), out->begin());
+    }
+
+    /* Adds A^T * B to C for row-major blocks A (R x M) and B (R x K). */
+    template <int R, int M, int K, typename T>
+    void
+    block_transpose_multiply_add (T const* A, T const* B, T* C)
+    {
+        for (int m = 0; m < M; ++m)
+            for (int k = 0; k < K; ++k)
+            {
+                T sum(0);
+                for (int r = 0; r < R; ++r)
+                    sum += A[r * M + m] * B[r * K + k];
+                C[m * K + k] += sum;
+            }
+    }
+
+    /* Computes C = A * B for row-major blocks A (M x K) and B (K x L). */
+    template <int M, int K, int L, typename T>
+    void
+    block_multiply (T const* A, T const* B, T* C)
+    {
+        for (int m = 0; m < M; ++m)
+            for (int l = 0; l < L; ++l)
+            {
+                T sum(0);
+                for (int k = 0; k < K; ++k)
+                    sum += A[m * K + k] * B[k * L + l];
+                C[m * L + l] = sum;
+            }
+    }
+
+    /* Subtracts A * B^T from C for row-major blocks A (M x K), B (L x K). */
+    template <int M, int K, int L, typename T>
+    void
+    block_multiply_transpose_subtract (T const* A, T const* B, T* C)
+    {
+        for (int m = 0; m < M; ++m)
+            for (int l = 0; l < L; ++l)
+            {
+                T sum(0);
+                for (int k = 0; k < K; ++k)
+                    sum += A[m * K + k] * B[l * K + k];
+                C[m * L + l] -= sum;
+            }
+    }
+
+    /* Allocates a square block matrix with zero blocks on its diagonal. */
+    template <typename T, int B>
+    void
+    set_block_diagonal_pattern (std::size_t num_blocks,
+        BlockSparseMatrix<T, B, B>* A)
+    {
+        std::vector<std::size_t> outer(num_blocks + 1);
+        std::vector<std::size_t> inner(num_blocks);
+        for (std::size_t i = 0; i < num_blocks; ++i)
+        {
+            outer[i] = i;
+            inner[i] = i;
+        }
+        outer[num_blocks] = num_blocks;
+        A->allocate(num_blocks, num_blocks);
+        A->set_pattern(outer, inner);
+    }
+
+    /* Allocates a block column matrix with a zero block in every row. */
+    template <typename T, int BR, int BC>
+    void
+    set_block_column_pattern (std::size_t num_blocks,
+        BlockSparseMatrix<T, BR, BC>* A)
+    {
+        std::vector<std::size_t> outer(num_blocks + 1);
+        std::vector<std::size_t> inner(num_blocks, 0);
+        for (std::size_t i = 0; i <= num_blocks; ++i)
+            outer[i] = i;
+        A->allocate(num_blocks, 1);
+        A->set_pattern(outer, inner);
+    }
+
+    /* Inverts a symmetric, positive definite 3x3 block in-place. */
+    template <typename T>
+    void
+    invert_block_3x3 (T* block)
+    {
+        cholesky_invert_inplace(block, 3);
+        for (int i = 0; i < 9; ++i)
+            if (!std::isfinite(block[i]))
+                block[i] = T(0);
+    }
+
+    /*
+     * Computes the predicted error decrease from the unregularized diagonal,
+     * which is accumulated in double precision.
+     */
+    template <typename T>
+    double
+    predicted_error_decrease (DenseVector<T> const& delta,
+        DenseVector<T> const& diagonal, DenseVector<T> const& g,
+        double trust_region_radius)
+    {
+        double ret = 0.0;
+        for (std::size_t i = 0; i < delta.size(); ++i)
+        {
+            double const d = delta[i];
+            ret += d * (diagonal[i] * d * (1.0 / trust_region_radius) + g[i]);
+        }
+        return ret;
+    }
+
+    /*
+     * Computes A^T * (B * x) for Jacobians A and B with one block per
+     * observation, which is E * x or E^T * x without forming E. The
+     * observations are visited in order and summed per thread, which is
+     * fast for a small result such as the cameras. The results of the
+     * threads are added in order.
+     */
+    template <typename T, int AC, int BC>
+    DenseVector<T>
+    observation_product (BlockSparseMatrix<T, 2, AC> const& A,
+        BlockSparseMatrix<T, 2, BC> const& B,
+        DenseVector<T> const& x)
+    {
+        DenseVector<T> ret(A.num_cols(), T(0));
+        std::int64_t const num_observations = A.num_block_rows();
+        std::int64_t const num_cols = A.num_cols();
+        std::vector<DenseVector<T>> thread_rets;
+#pragma omp parallel \
+    if (internal::parallel_observations(num_observations))
+        {
+#ifdef _OPENMP
+            std::size_t const num_threads = omp_get_num_threads();
+            std::size_t const thread_id = omp_get_thread_num();
+#else
+            std::size_t const num_threads = 1;
+            std::size_t const thread_id = 0;
+#endif
+
+#pragma omp single
+            thread_rets.resize(num_threads);
+            DenseVector<T>& thread_ret = thread_rets[thread_id];
+            thread_ret.resize(A.num_cols(), T(0));
+
+#pragma omp for schedule(static)
+            for (std::int64_t i = 0; i < num_observations; ++i)
+            {
+                T b_x[2];
+                block_multiply<2, BC, 1>(B.block(i),
+                    x.data() + B.block_col(i) * BC, b_x);
+                block_transpose_multiply_add<2, AC, 1>(A.block(i), b_x,
+                    thread_ret.data() + A.block_col(i) * AC);
+            }
+
+#pragma omp for schedule(static)
+            for (std::int64_t i = 0; i < num_cols; ++i)
+                for (std::size_t t = 0; t < num_threads; ++t)
+                    ret[i] += thread_rets[t][i];
+        }
+        return ret;
+    }
+
+    /*
+     * Computes A^T * (B * x) like observation_product() with observations
+     * grouped by the block columns of A. Every block of the result is
+     * summed independently in parallel, which suits a large result such
+     * as the points.
+     */
+    template <typename T, int AC, int BC>
+    DenseVector<T>
+    grouped_observation_product (BlockSparseMatrix<T, 2, AC> const& A,
+        BlockSparseMatrix<T, 2, BC> const& B,
+        std::vector<std::size_t> const& outer,
+        std::vector<std::size_t> const& observations,
+        DenseVector<T> const& x)
+    {
+        DenseVector<T> ret(A.num_cols(), T(0));
+        std::int64_t const num_groups = outer.size() - 1;
+#pragma omp parallel for schedule(dynamic, 64) \
+    if (internal::parallel_observations(observations.size()))
+        for (std::int64_t g = 0; g < num_groups; ++g)
+        {
+            T* ret_ptr = ret.data() + g * AC;
+            for (std::size_t k = outer[g]; k < outer[g + 1]; ++k)
+            {
+                std::size_t const i = observations[k];
+                T b_x[2];
+                block_multiply<2, BC, 1>(B.block(i),
+                    x.data() + B.block_col(i) * BC, b_x);
+                block_transpose_multiply_add<2, AC, 1>(A.block(i),
+                    b_x, ret_ptr);
+            }
+        }
+        return ret;
+    }
+
+    /* Multiplies vectors with a block sparse matrix for CG. */
+    template <typename T, typename Matrix>
+    class CGBlockMatrixFunctor : public ConjugateGradient<T>::Functor
+    {
+    public:
+        CGBlockMatrixFunctor (Matrix const& A)
+            : A(&A)
+        {
+        }
+
+        DenseVector<T>
+        multiply (DenseVector<T> const& x) const
+        {
+            return this->A->multiply(x);
+        }
+
+        std::size_t
+        input_size (void) const
+        {
+            return this->A->num_cols();
+        }
+
+        std::size_t
+        output_size (void) const
+        {
+            return this->A->num_rows();
+        }
+
+    private:
+        Matrix const* A;
+    };
+
+    /*
+     * Multiplies vectors with the bordered matrix [ A G; G^T K ] for CG,
+     * where A is given as a functor, G has a single Nx3 block column and K
+     * is a 3x3 block. Without G, the matrix is block diagonal, e.g. for
+     * the pre-conditioner.
+     */
+    template <typename T, int N>
+    class CGBorderedFunctor : public ConjugateGradient<T>::Functor
+    {
+    public:
+        typedef typename ConjugateGradient<T>::Functor Functor;
+
+        CGBorderedFunctor (Functor const& A,
+            BlockSparseMatrix<T, N, 3> const* G, T const* K)
+            : A(&A)
+            , G(G)
+            , K(K)
+        {
+        }
+
+        DenseVector<T>
+        multiply (DenseVector<T> const& x) const
+        {
+            std::size_t const rows = this->A->output_size();
+            DenseVector<T> x_a(rows);
+            std::copy(x.begin(), x.begin() + rows, x_a.begin());
+            DenseVector<T> x_k(3);
+            std::copy(x.begin() + rows, x.end(), x_k.begin());
+
+            DenseVector<T> y_a = this->A->multiply(x_a);
+            DenseVector<T> ret(rows + 3, T(0));
+            block_multiply<3, 3, 1>(this->K, x_k.data(), ret.data() + rows);
+            if (this->G != nullptr)
+            {
+                y_a.add_scaled(T(1), this->G->multiply(x_k));
+                DenseVector<T> const g_t_x = this->G->transpose_multiply(x_a);
+                for (int i = 0; i < 3; ++i)
+                    ret[rows + i] += g_t_x[i];
+            }
+            std::copy(y_a.begin(), y_a.end(), ret.begin());
+            return ret;
+        }
+
+        std::size_t
+        input_size (void) const
+        {
+            return this->A->input_size() + 3;
+        }
+
+        std::size_t
+        output_size (void) const
+        {
+            return this->A->output_size() + 3;
+        }
+
+    private:
+        Functor const* A;
+        BlockSparseMatrix<T, N, 3> const* G;
+        T const* K;
+    };
+}
+
+/*
+ * The forcing term is choice 2 of Eisenstat and Walker, with gamma = 0.9
+ * and alpha = 2, and their safeguard against a sudden decrease. The norm
+ * of the right hand side is the one of the reduced gradient.
+ */
+template <typename T>
+typename ConjugateGradient<T>::Options
+LinearSolver::cg_options (T rhs_norm)
+{
+    typename ConjugateGradient<T>::Options cg_opts;
+    cg_opts.max_iterations = this->opts.cg_max_iterations;
+    cg_opts.tolerance = 1e-20;
+    cg_opts.warm_start = this->opts.cg_warm_start && this->rejected_step;
+    if (this->opts.cg_forcing_max <= 0.0)
+        return cg_opts;
+
+    double const forcing_max = this->opts.cg_forcing_max;
+    if (this->last_rhs_norm <= 0.0)
+    {
+        this->forcing_term = forcing_max;
+        this->last_rhs_norm = rhs_norm;
+    }
+    else if (!this->rejected_step)
+    {
+        double const ratio = rhs_norm / this->last_rhs_norm;
+        double const safeguard = 0.9 * MATH_POW2(this->forcing_term);
+        double forcing = 0.9 * MATH_POW2(ratio);
+        if (safeguard > 0.1)
+            forcing = std::max(forcing, safeguard);
+        this->forcing_term = std::min(forcing, forcing_max);
+        this->last_rhs_norm = rhs_norm;
+    }
+
+    double const tolerance = this->forcing_term * rhs_norm;
+    cg_opts.tolerance = std::max(cg_opts.tolerance,
+        static_cast<T>(MATH_POW2(tolerance)));
+    return cg_opts;
+}
+
+template <typename T>
+void
+LinearSolver::warm_start_solution (DenseVector<T>* x) const
+{
+    if (!this->opts.cg_warm_start || !this->rejected_step
+        || this->last_solution.size() != x->size())
+        return;
+    std::copy(this->last_solution.begin(), this->last_solution.end(),
+        x->begin());
+}
+
+LinearSolver::Backend
+LinearSolver::select_backend (int block_dim)
+{
+    if (this->opts.backend != BACKEND_AUTO)
+        return this->opts.backend;
+
+    SchurPattern const& pattern = this->schur_pattern;
+    std::size_t const num_cameras = pattern.schur_outer.size() - 1;
+    if (num_cameras <= this->opts.dense_max_cameras)
+        return BACKEND_DENSE;
+    if (this->opts.implicit_schur)
+        return BACKEND_CG;
+
+    /*
+     * The ordering gains nothing for mostly dense patterns of S, and its
+     * analysis takes cubic time in the number of cameras for them.
+     */
+    double const num_blocks = static_cast<double>(pattern.schur_inner.size());
+    if (num_blocks > 0.25 * MATH_POW2(static_cast<double>(num_cameras)))
+        return BACKEND_CG;
+
+    DirectSolver const* solver = this->get_direct_solver(block_dim);
+    double const product_flops = 2.0 * num_blocks * MATH_POW2(block_dim);
+    return solver->get_factor_flops()
+        <= this->opts.sparse_max_cost * product_flops
+        ? BACKEND_SPARSE : BACKEND_CG;
+}
+
+DirectSolver*
+LinearSolver::get_direct_solver (int block_dim)
+{
+    if (this->direct_solver == nullptr)
+        this->direct_solver = DirectSolver::create(this->opts.sparse_backend);
+    if (this->direct_block_dim != block_dim)
+    {
+        SchurPattern const& pattern = this->schur_pattern;
+        this->direct_solver->analyze(pattern.schur_outer.size() - 1,
+            block_dim, pattern.schur_outer, pattern.schur_inner);
+        this->direct_block_dim = block_dim;
+    }
+    return this->direct_solver.get();
 }
 
 LinearSolver::Status
@@ -126,6 +799,18 @@ LinearSolver::solve (SparseMatrixType const& jac_cams,
     bool const has_jac_cams = jac_cams.num_rows() > 0;
     bool const has_jac_points = jac_points.num_rows() > 0;
 
+    /* Discard the patterns of the products for a different problem. */
+    if (!this->products.has_pattern(jac_cams, jac_points))
+    {
+        this->products = Products();
+        this->products.num_rows = std::max(jac_cams.num_rows(),
+            jac_points.num_rows());
+        this->products.num_cam_cols = jac_cams.num_cols();
+        this->products.num_cam_non_zero = jac_cams.num_non_zero();
+        this->products.num_point_cols = jac_points.num_cols();
+        this->products.num_point_non_zero = jac_points.num_non_zero();
+    }
+
     /* Select solver based on bundle adjustment mode. */
     if (has_jac_cams && has_jac_points)
         return this->solve_schur(jac_cams, jac_points, vector_f, delta_x);
@@ -150,8 +835,10 @@ LinearSolver::solve_schur (SparseMatrixType const& jac_cams,
     DenseVectorType const& F = values;
     SparseMatrixType const& Jc = jac_cams;
     SparseMatrixType const& Jp = jac_points;
-    SparseMatrixType JcT = Jc.transpose();
-    SparseMatrixType JpT = Jp.transpose();
+    SparseMatrixType const& JcT = this->products.jac_cams_t;
+    SparseMatrixType const& JpT = this->products.jac_points_t;
+    transpose_reuse(Jc, &this->products.jac_cams_t);
+    transpose_reuse(Jp, &this->products.jac_points_t);
 
     /* Compute the blocks of the Hessian. */
     SparseMatrixType B, C;
@@ -159,7 +846,8 @@ LinearSolver::solve_schur (SparseMatrixType const& jac_cams,
     matrix_block_column_multiply(Jc, this->opts.camera_block_dim, &B);
     /* Jp^T * Jp */
     matrix_block_column_multiply(Jp, 3, &C);
-    SparseMatrixType E = JcT.multiply(Jp);
+    SparseMatrixType const& E = this->products.e;
+    multiply_reuse(JcT, Jp, &this->products.e);
 
     /* Assemble two values vectors. */
     DenseVectorType v = JcT.multiply(F);
@@ -179,42 +867,70 @@ LinearSolver::solve_schur (SparseMatrixType const& jac_cams,
     invert_block_matrix_3x3_inplace(&C);
 
     /* Compute the Schur complement matrix S. */
-    SparseMatrixType ET = E.transpose();
-    SparseMatrixType S = B.subtract(E.multiply(C).multiply(ET));
+    SparseMatrixType const& ET = this->products.e_t;
+    transpose_reuse(E, &this->products.e_t);
+    SparseMatrixType& S = this->products.schur;
+    if (S.num_rows() == 0)
+        schur_complement_pattern(B, E, ET, &S);
+    schur_complement_values(B, E, ET, C, &S);
     DenseVectorType rhs = v.subtract(E.multiply(C.multiply(w)));
 
-    /* Compute pre-conditioner for linear system. */
-    //SparseMatrixType precond = S.diagonal_matrix();
-    //precond.cwise_invert();
-    SparseMatrixType precond = B;
-    invert_block_matrix_NxN_inplace(&precond, this->opts.camera_block_dim);
-
-    /* Solve linear system. */
+    /*
+     * Small reduced camera systems are solved directly with the dense
+     * Cholesky decomposition, which is faster than many CG iterations.
+     * The sparse direct solver is only used for block Jacobians.
+     */
     DenseVectorType delta_y(Jc.num_cols());
-    typedef sfm::ba::ConjugateGradient<double> CGSolver;
-    CGSolver::Options cg_opts;
-    cg_opts.max_iterations = this->opts.cg_max_iterations;
-    cg_opts.tolerance = 1e-20;
-    CGSolver solver(cg_opts);
-    CGSolver::Status cg_status;
-    cg_status = solver.solve(S, rhs, &delta_y, &precond);
-
     Status status;
-    status.num_cg_iterations = cg_status.num_iterations;
-    switch (cg_status.info)
-    {
-        case CGSolver::CG_CONVERGENCE:
-            status.success = true;
-            break;
-        case CGSolver::CG_MAX_ITERATIONS:
-            status.success = true;
-            break;
-        case CGSolver::CG_INVALID_INPUT:
-            std::cout << "BA: CG failed (invalid input)" << std::endl;
-            status.success = false;
-            return status;
-        default:
-            break;
+    std::size_t const num_cameras = Jc.num_cols()
+        / this->opts.camera_block_dim;
+    bool const use_dense = this->opts.backend == BACKEND_DENSE
+        || (this->opts.backend != BACKEND_CG
+        && num_cameras <= this->opts.dense_max_cameras);
+    if (use_dense && solve_dense_cholesky(S, rhs, &delta_y))
+    {
+        status.success = true;
+        status.backend = BACKEND_DENSE;
+    }
+    else
+    {
+        /*
+         * Compute the block-Jacobi pre-conditioner for the linear system.
+         * The camera blocks of S also account for the points, which are
+         * ignored by the camera blocks of B.
+         */
+        SparseMatrixType precond;
+        if (this->opts.preconditioner == PRECONDITIONER_S_BLOCKS)
+            precond = S.block_diagonal_matrix(this->opts.camera_block_dim);
+        else
+            precond = B;
+        invert_block_matrix_NxN_inplace(&precond,
+            this->opts.camera_block_dim);
+
+        /* Solve linear system with pre-conditioned CG. */
+        typedef sfm::ba::ConjugateGradient<double> CGSolver;
+        CGSolver solver(this->cg_options(rhs.norm()));
+        this->warm_start_solution(&delta_y);
+        CGSolver::Status cg_status;
+        cg_status = solver.solve(S, rhs, &delta_y, &precond);
+        this->last_solution.assign(delta_y.begin(), delta_y.end());
+
+        status.num_cg_iterations = cg_status.num_iterations;
+        switch (cg_status.info)
+        {
+            case CGSolver::CG_CONVERGENCE:
+                status.success = true;
+                break;
+            case CGSolver::CG_MAX_ITERATIONS:
+                status.success = true;
+                break;
+            case CGSolver::CG_INVALID_INPUT:
+                std::cout << "BA: CG failed (invalid input)" << std::endl;
+                status.success = false;
+                return status;
+            default:
+                break;
+        }
     }
 
     /* Substitute back to obtain delta z. */
@@ -249,8 +965,11 @@ LinearSolver::solve (SparseMatrixType const& J,
     std::size_t block_size)
 {
     DenseVectorType const& F = vector_f;
-    SparseMatrixType Jt = J.transpose();
-    SparseMatrixType H = Jt.multiply(J);
+    SparseMatrixType& Jt = block_size == 0
+        ? this->products.jac_cams_t : this->products.jac_points_t;
+    transpose_reuse(J, &Jt);
+    SparseMatrixType& H = this->products.hessian;
+    multiply_reuse(Jt, J, &H);
     SparseMatrixType H_diag = H.diagonal_matrix();
 
     /* Compute RHS. */
@@ -268,12 +987,13 @@ LinearSolver::solve (SparseMatrixType const& J,
         precond.cwise_invert();
 
         typedef sfm::ba::ConjugateGradient<double> CGSolver;
-        CGSolver::Options cg_opts;
-        cg_opts.max_iterations = this->opts.cg_max_iterations;
-        cg_opts.tolerance = 1e-20;
-        CGSolver solver(cg_opts);
+        CGSolver solver(this->cg_options(g.norm()));
+        if (delta_x->size() != g.size())
+            delta_x->resize(g.size());
+        this->warm_start_solution(delta_x);
         CGSolver::Status cg_status;
         cg_status = solver.solve(H, g, delta_x, &precond);
+        this->last_solution.assign(delta_x->begin(), delta_x->end());
         status.num_cg_iterations = cg_status.num_iterations;
 
         switch (cg_status.info)
@@ -312,5 +1032,794 @@ LinearSolver::solve (SparseMatrixType const& J,
     return status;
 }
 
+/* ---------------------------------------------------------------- */
+
+/*
+ * Applies S = B - E * C^-1 * E^T with E = Jc^T * Jp as a chain of block
+ * products with the Jacobians, so neither E nor S is formed. The product
+ * for the points is grouped by the observations of the points in the
+ * Schur pattern.
+ */
+template <typename T, int N>
+class LinearSolver::ImplicitSchurFunctor
+    : public ConjugateGradient<T>::Functor
+{
+public:
+    ImplicitSchurFunctor (BlockSparseMatrix<T, N, N> const& B,
+        BlockSparseMatrix<T, 3, 3> const& C_inv,
+        BlockSparseMatrix<T, 2, N> const& jac_cams,
+        BlockSparseMatrix<T, 2, 3> const& jac_points,
+        SchurPattern const& pattern);
+
+    DenseVector<T> multiply (DenseVector<T> const& x) const;
+    std::size_t input_size (void) const;
+    std::size_t output_size (void) const;
+
+    /* Computes E * x = Jc^T * (Jp * x). */
+    DenseVector<T> multiply_e (DenseVector<T> const& x) const;
+    /* Computes E^T * x = Jp^T * (Jc * x). */
+    DenseVector<T> multiply_e_transpose (DenseVector<T> const& x) const;
+    /* Computes the diagonal block of S for the camera. */
+    void camera_block (std::size_t camera, T* block) const;
+
+private:
+    BlockSparseMatrix<T, N, N> const* B;
+    BlockSparseMatrix<T, 3, 3> const* C_inv;
+    BlockSparseMatrix<T, 2, N> const* jac_cams;
+    BlockSparseMatrix<T, 2, 3> const* jac_points;
+    SchurPattern const* pattern;
+};
+
+template <typename T, int N>
+LinearSolver::ImplicitSchurFunctor<T, N>::ImplicitSchurFunctor (
+    BlockSparseMatrix<T, N, N> const& B,
+    BlockSparseMatrix<T, 3, 3> const& C_inv,
+    BlockSparseMatrix<T, 2, N> const& jac_cams,
+    BlockSparseMatrix<T, 2, 3> const& jac_points,
+    SchurPattern const& pattern)
+    : B(&B)
+    , C_inv(&C_inv)
+    , jac_cams(&jac_cams)
+    , jac_points(&jac_points)
+    , pattern(&pattern)
+{
+}
+
+template <typename T, int N>
+DenseVector<T>
+LinearSolver::ImplicitSchurFunctor<T, N>::multiply (
+    DenseVector<T> const& x) const
+{
+    DenseVector<T> const e_t_x = this->multiply_e_transpose(x);
+    DenseVector<T> ret = this->B->multiply(x);
+    ret.add_scaled(T(-1), this->multiply_e(this->C_inv->multiply(e_t_x)));
+    return ret;
+}
+
+template <typename T, int N>
+std::size_t
+LinearSolver::ImplicitSchurFunctor<T, N>::input_size (void) const
+{
+    return this->B->num_cols();
+}
+
+template <typename T, int N>
+std::size_t
+LinearSolver::ImplicitSchurFunctor<T, N>::output_size (void) const
+{
+    return this->B->num_rows();
+}
+
+template <typename T, int N>
+DenseVector<T>
+LinearSolver::ImplicitSchurFunctor<T, N>::multiply_e (
+    DenseVector<T> const& x) const
+{
+    return observation_product(*this->jac_cams, *this->jac_points, x);
+}
+
+template <typename T, int N>
+DenseVector<T>
+LinearSolver::ImplicitSchurFunctor<T, N>::multiply_e_transpose (
+    DenseVector<T> const& x) const
+{
+    return grouped_observation_product(*this->jac_points, *this->jac_cams,
+        this->pattern->point_outer, this->pattern->point_observations, x);
+}
+
+template <typename T, int N>
+void
+LinearSolver::ImplicitSchurFunctor<T, N>::camera_block (std::size_t camera,
+    T* block) const
+{
+    T const* b_block = this->B->block(camera);
+    std::copy(b_block, b_block + N * N, block);
+    for (std::size_t k = this->pattern->camera_outer[camera];
+        k < this->pattern->camera_outer[camera + 1]; ++k)
+    {
+        std::size_t const i = this->pattern->camera_observations[k];
+        T const* jc = this->jac_cams->block(i);
+        T e_block[N * 3] = { T(0) };
+        block_transpose_multiply_add<2, N, 3>(jc,
+            this->jac_points->block(i), e_block);
+        T e_c_block[N * 3];
+        block_multiply<N, 3, 3>(e_block,
+            this->C_inv->block(this->pattern->point_ids[i]), e_c_block);
+        block_multiply_transpose_subtract<N, 3, N>(e_c_block, e_block, block);
+    }
+}
+
+template <typename T, int N>
+LinearSolver::Status
+LinearSolver::solve (BlockSparseMatrix<T, 2, N> const& jac_cams,
+    BlockSparseMatrix<T, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f,
+    DenseVectorType* delta_x)
+{
+    bool const has_jac_cams = jac_cams.num_rows() > 0;
+    bool const has_jac_points = jac_points.num_rows() > 0;
+
+    /* Select solver based on bundle adjustment mode. */
+    if (has_jac_cams && has_jac_points)
+        return this->solve_schur(jac_cams,
+            static_cast<BlockSparseMatrix<T, 2, 3> const*>(nullptr),
+            jac_points, vector_f, delta_x);
+    else if (has_jac_cams && !has_jac_points)
+        return this->solve_block_diagonal(jac_cams,
+            static_cast<BlockSparseMatrix<T, 2, 3> const*>(nullptr),
+            vector_f, delta_x);
+    else if (!has_jac_cams && has_jac_points)
+        return this->solve_block_diagonal(jac_points,
+            static_cast<BlockSparseMatrix<T, 2, 3> const*>(nullptr),
+            vector_f, delta_x);
+    else
+        throw std::invalid_argument("No Jacobian given");
+}
+
+template <typename T, int N>
+LinearSolver::Status
+LinearSolver::solve (BlockSparseMatrix<T, 2, N> const& jac_cams,
+    BlockSparseMatrix<T, 2, 3> const& jac_intrinsics,
+    BlockSparseMatrix<T, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f,
+    DenseVectorType* delta_x)
+{
+    if (jac_intrinsics.num_rows() == 0)
+        return this->solve(jac_cams, jac_points, vector_f, delta_x);
+    if (jac_cams.num_rows() == 0)
+        throw std::invalid_argument("Shared intrinsics require cameras");
+    if (jac_intrinsics.num_block_rows() != jac_cams.num_block_rows()
+        || jac_intrinsics.num_blocks() != jac_cams.num_block_rows()
+        || jac_intrinsics.num_block_cols() != 1)
+        throw std::invalid_argument("One intrinsics block per observation");
+
+    if (jac_points.num_rows() > 0)
+        return this->solve_schur(jac_cams, &jac_intrinsics, jac_points,
+            vector_f, delta_x);
+    return this->solve_block_diagonal(jac_cams, &jac_intrinsics,
+        vector_f, delta_x);
+}
+
+template <typename T, int N>
+void
+LinearSolver::update_schur_pattern (
+    BlockSparseMatrix<T, 2, N> const& jac_cams,
+    BlockSparseMatrix<T, 2, 3> const& jac_points)
+{
+    std::size_t const num_observations = jac_cams.num_block_rows();
+    if (jac_points.num_block_rows() != num_observations
+        || jac_cams.num_blocks() != num_observations
+        || jac_points.num_blocks() != num_observations)
+        throw std::invalid_argument("One block per observation required");
+    for (std::size_t i = 0; i < num_observations; ++i)
+        if (jac_cams.row_begin(i) != i || jac_points.row_begin(i) != i)
+            throw std::invalid_argument("One block per observation required");
+
+    /* Keep the pattern while cameras and points of observations are equal. */
+    std::size_t const num_cameras = jac_cams.num_block_cols();
+    std::size_t const num_points = jac_points.num_block_cols();
+    SchurPattern& pattern = this->schur_pattern;
+    bool same_pattern = pattern.camera_ids.size() == num_observations
+        && pattern.camera_outer.size() == num_cameras + 1
+        && pattern.point_outer.size() == num_points + 1;
+    for (std::size_t i = 0; same_pattern && i < num_observations; ++i)
+        same_pattern = pattern.camera_ids[i] == jac_cams.block_col(i)
+            && pattern.point_ids[i] == jac_points.block_col(i);
+    if (same_pattern)
+        return;
+
+    this->direct_block_dim = 0;
+    pattern.camera_ids.resize(num_observations);
+    pattern.point_ids.resize(num_observations);
+    for (std::size_t i = 0; i < num_observations; ++i)
+    {
+        pattern.camera_ids[i] = jac_cams.block_col(i);
+        pattern.point_ids[i] = jac_points.block_col(i);
+    }
+
+    /* Sort the observations by points and by cameras. */
+    pattern.point_outer.assign(num_points + 1, 0);
+    pattern.camera_outer.assign(num_cameras + 1, 0);
+    for (std::size_t i = 0; i < num_observations; ++i)
+    {
+        pattern.point_outer[pattern.point_ids[i] + 1] += 1;
+        pattern.camera_outer[pattern.camera_ids[i] + 1] += 1;
+    }
+    for (std::size_t i = 0; i < num_points; ++i)
+        pattern.point_outer[i + 1] += pattern.point_outer[i];
+    for (std::size_t i = 0; i < num_cameras; ++i)
+        pattern.camera_outer[i + 1] += pattern.camera_outer[i];
+
+    pattern.point_observations.resize(num_observations);
+    pattern.camera_observations.resize(num_observations);
+    {
+        std::vector<std::size_t> point_pos(pattern.point_outer.begin(),
+            pattern.point_outer.end() - 1);
+        std::vector<std::size_t> camera_pos(pattern.camera_outer.begin(),
+            pattern.camera_outer.end() - 1);
+        for (std::size_t i = 0; i < num_observations; ++i)
+        {
+            pattern.point_observations[point_pos[pattern.point_ids[i]]++] = i;
+            pattern.camera_observations[camera_pos[pattern.camera_ids[i]]++]
+                = i;
+        }
+    }
+
+    /* The blocks of E are sorted by points within every camera. */
+    std::vector<std::size_t> const& point_ids = pattern.point_ids;
+    for (std::size_t i = 0; i < num_cameras; ++i)
+        std::sort(pattern.camera_observations.begin() + pattern.camera_outer[i],
+            pattern.camera_observations.begin() + pattern.camera_outer[i + 1],
+            [&point_ids] (std::size_t a, std::size_t b)
+            {
+                return point_ids[a] < point_ids[b]
+                    || (point_ids[a] == point_ids[b] && a < b);
+            });
+    pattern.observation_blocks.resize(num_observations);
+    for (std::size_t i = 0; i < num_observations; ++i)
+        pattern.observation_blocks[pattern.camera_observations[i]] = i;
+
+    /* S has a block for every camera pair that observes a common point. */
+    pattern.schur_outer.assign(num_cameras + 1, 0);
+    pattern.schur_inner.clear();
+    std::vector<std::size_t> marker(num_cameras, num_cameras);
+    std::vector<std::size_t> row;
+    for (std::size_t a = 0; a < num_cameras; ++a)
+    {
+        row.clear();
+        row.push_back(a);
+        marker[a] = a;
+        for (std::size_t k = pattern.camera_outer[a];
+            k < pattern.camera_outer[a + 1]; ++k)
+        {
+            std::size_t const point_id
+                = pattern.point_ids[pattern.camera_observations[k]];
+            for (std::size_t j = pattern.point_outer[point_id];
+                j < pattern.point_outer[point_id + 1]; ++j)
+            {
+                std::size_t const b
+                    = pattern.camera_ids[pattern.point_observations[j]];
+                if (marker[b] == a)
+                    continue;
+                marker[b] = a;
+                row.push_back(b);
+            }
+        }
+        std::sort(row.begin(), row.end());
+        pattern.schur_inner.insert(pattern.schur_inner.end(),
+            row.begin(), row.end());
+        pattern.schur_outer[a + 1] = pattern.schur_inner.size();
+    }
+}
+
+template <typename T, int N>
+LinearSolver::Status
+LinearSolver::solve_schur (BlockSparseMatrix<T, 2, N> const& jac_cams,
+    BlockSparseMatrix<T, 2, 3> const* jac_intrinsics,
+    BlockSparseMatrix<T, 2, 3> const& jac_points,
+    DenseVectorType const& values, DenseVectorType* delta_x)
+{
+    typedef BlockSparseMatrix<T, N, N> CameraMatrix;
+    typedef BlockSparseMatrix<T, 3, 3> PointMatrix;
+    typedef BlockSparseMatrix<T, N, 3> CameraPointMatrix;
+
+    /*
+     * The blocks of the Hessian H = [ B E; E^T C ] are computed from the
+     * 2xN camera block and the 2x3 point block of every observation.
+     * B and C are block diagonal, E has a block per observation. With the
+     * implicit Schur complement, neither E nor S is formed for CG. The
+     * residuals are converted to the scalar type of the Jacobians.
+     *
+     * Shared intrinsics add the block row [ G^T K E_k ] to H, with the
+     * Nx3 block G = Jc^T * Ji of every camera, the 3x3 block K = Ji^T * Ji
+     * and the 3x3 block E_k = Ji^T * Jp of every point.
+     */
+    double const start_time = get_timestamp();
+    DenseVector<T> F;
+    convert_vector(values, &F);
+    this->update_schur_pattern(jac_cams, jac_points);
+    SchurPattern const& pattern = this->schur_pattern;
+    std::size_t const num_cameras = jac_cams.num_block_cols();
+    std::size_t const num_points = jac_points.num_block_cols();
+    Backend const backend = this->select_backend(N);
+    bool const implicit = this->opts.implicit_schur && backend == BACKEND_CG;
+    bool const shared = jac_intrinsics != nullptr;
+    bool const parallel
+        = internal::parallel_observations(pattern.camera_ids.size());
+
+    CameraMatrix B;
+    set_block_diagonal_pattern(num_cameras, &B);
+    PointMatrix C;
+    set_block_diagonal_pattern(num_points, &C);
+    CameraPointMatrix E(num_cameras, num_points);
+    if (!implicit)
+    {
+        std::vector<std::size_t> e_inner(pattern.camera_observations.size());
+        for (std::size_t i = 0; i < e_inner.size(); ++i)
+            e_inner[i] = pattern.point_ids[pattern.camera_observations[i]];
+        E.set_pattern(pattern.camera_outer, e_inner);
+    }
+    CameraPointMatrix G;
+    std::vector<T> E_k;
+    T K[9] = { T(0) };
+    if (shared)
+    {
+        set_block_column_pattern(num_cameras, &G);
+        E_k.assign(num_points * 9, T(0));
+    }
+
+#pragma omp parallel if (parallel)
+    {
+#pragma omp for schedule(dynamic, 16) nowait
+        for (std::int64_t a = 0; a < static_cast<std::int64_t>(num_cameras);
+            ++a)
+            for (std::size_t k = pattern.camera_outer[a];
+                k < pattern.camera_outer[a + 1]; ++k)
+            {
+                std::size_t const i = pattern.camera_observations[k];
+                T const* jc = jac_cams.block(i);
+                block_transpose_multiply_add<2, N, N>(jc, jc, B.block(a));
+                if (!implicit)
+                    block_transpose_multiply_add<2, N, 3>(jc,
+                        jac_points.block(i), E.block(k));
+                if (shared)
+                    block_transpose_multiply_add<2, N, 3>(jc,
+                        jac_intrinsics->block(i), G.block(a));
+            }
+
+#pragma omp for schedule(static)
+        for (std::int64_t p = 0; p < static_cast<std::int64_t>(num_points);
+            ++p)
+            for (std::size_t k = pattern.point_outer[p];
+                k < pattern.point_outer[p + 1]; ++k)
+            {
+                std::size_t const i = pattern.point_observations[k];
+                T const* jp = jac_points.block(i);
+                block_transpose_multiply_add<2, 3, 3>(jp, jp, C.block(p));
+                if (shared)
+                    block_transpose_multiply_add<2, 3, 3>(
+                        jac_intrinsics->block(i), jp, &E_k[p * 9]);
+            }
+    }
+    if (shared)
+        for (std::size_t i = 0; i < jac_intrinsics->num_blocks(); ++i)
+            block_transpose_multiply_add<2, 3, 3>(jac_intrinsics->block(i),
+                jac_intrinsics->block(i), K);
+
+    /* Assemble two values vectors, and the one of the intrinsics. */
+    DenseVector<T> v = jac_cams.transpose_multiply(F);
+    DenseVector<T> w = jac_points.transpose_multiply(F);
+    v.negate_self();
+    w.negate_self();
+    DenseVector<T> u;
+    if (shared)
+    {
+        u = jac_intrinsics->transpose_multiply(F);
+        u.negate_self();
+    }
+
+    /* Save diagonal for computing predicted error decrease */
+    DenseVector<T> const B_diag = B.diagonal();
+    DenseVector<T> const C_diag = C.diagonal();
+    DenseVector<T> K_diag(3);
+    for (int i = 0; i < 3; ++i)
+        K_diag[i] = K[i * 4];
+
+    /* Add regularization to C and B. */
+    C.mult_diagonal(1.0 + 1.0 / this->opts.trust_region_radius);
+    B.mult_diagonal(1.0 + 1.0 / this->opts.trust_region_radius);
+    for (int i = 0; i < 3; ++i)
+        K[i * 4] *= 1.0 + 1.0 / this->opts.trust_region_radius;
+
+    /* Invert C matrix. */
+    C.invert_diagonal_blocks();
+    ImplicitSchurFunctor<T, N> const implicit_S(B, C, jac_cams, jac_points,
+        pattern);
+
+    /*
+     * Compute the Schur complement S = B - E * C^-1 * E^T. Every camera
+     * block row a receives (E_ap * C_p^-1) * E_bp^T for all cameras b
+     * observing a point p of camera a.
+     */
+    CameraMatrix S(num_cameras, num_cameras);
+    if (!implicit)
+        S.set_pattern(pattern.schur_outer, pattern.schur_inner);
+    std::int64_t const num_s_rows = implicit ? 0 : num_cameras;
+#pragma omp parallel for schedule(dynamic, 16) if (parallel)
+    for (std::int64_t a = 0; a < num_s_rows; ++a)
+    {
+        T const* b_block = B.block(a);
+        std::copy(b_block, b_block + CameraMatrix::BLOCK_SIZE,
+            S.block(S.find_block(a, a)));
+
+        T e_c_block[N * 3];
+        for (std::size_t k = pattern.camera_outer[a];
+            k < pattern.camera_outer[a + 1]; ++k)
+        {
+            std::size_t const point_id
+                = pattern.point_ids[pattern.camera_observations[k]];
+            block_multiply<N, 3, 3>(E.block(k), C.block(point_id), e_c_block);
+            for (std::size_t j = pattern.point_outer[point_id];
+                j < pattern.point_outer[point_id + 1]; ++j)
+            {
+                std::size_t const observation = pattern.point_observations[j];
+                std::size_t const b = pattern.camera_ids[observation];
+                block_multiply_transpose_subtract<N, 3, N>(e_c_block,
+                    E.block(pattern.observation_blocks[observation]),
+                    S.block(S.find_block(a, b)));
+            }
+        }
+    }
+    DenseVector<T> const c_w = C.multiply(w);
+    DenseVector<T> rhs = v.subtract(implicit
+        ? implicit_S.multiply_e(c_w) : E.multiply(c_w));
+
+    /*
+     * Eliminate the points from the intrinsics blocks, which yields the
+     * border G - E * C^-1 * E_k^T of S and K - E_k * C^-1 * E_k^T. The
+     * right hand side is extended by u - E_k * C^-1 * w.
+     */
+    if (shared)
+    {
+#pragma omp parallel for schedule(dynamic, 16) if (parallel)
+        for (std::int64_t a = 0; a < static_cast<std::int64_t>(num_cameras);
+            ++a)
+            for (std::size_t k = pattern.camera_outer[a];
+                k < pattern.camera_outer[a + 1]; ++k)
+            {
+                std::size_t const i = pattern.camera_observations[k];
+                std::size_t const point_id = pattern.point_ids[i];
+                T e_block[N * 3] = { T(0) };
+                block_transpose_multiply_add<2, N, 3>(jac_cams.block(i),
+                    jac_points.block(i), e_block);
+                T e_c_block[N * 3];
+                block_multiply<N, 3, 3>(e_block, C.block(point_id),
+                    e_c_block);
+                block_multiply_transpose_subtract<N, 3, 3>(e_c_block,
+                    &E_k[point_id * 9], G.block(a));
+            }
+
+        DenseVector<T> rhs_shared(rhs.size() + 3);
+        std::copy(rhs.begin(), rhs.end(), rhs_shared.begin());
+        std::swap(rhs, rhs_shared);
+        T* rhs_k = rhs.data() + jac_cams.num_cols();
+        std::copy(u.begin(), u.end(), rhs_k);
+        for (std::size_t p = 0; p < num_points; ++p)
+        {
+            T e_c_block[9];
+            block_multiply<3, 3, 3>(&E_k[p * 9], C.block(p), e_c_block);
+            block_multiply_transpose_subtract<3, 3, 3>(e_c_block,
+                &E_k[p * 9], K);
+            T e_c_w[3];
+            block_multiply<3, 3, 1>(&E_k[p * 9], c_w.data() + p * 3, e_c_w);
+            for (int j = 0; j < 3; ++j)
+                rhs_k[j] -= e_c_w[j];
+        }
+    }
+
+    /*
+     * Small reduced camera systems are solved directly with the dense
+     * Cholesky decomposition, and sparse ones with a sparse direct solver
+     * if the fill is moderate, which is faster than many CG iterations.
+     */
+    DenseVector<T> delta_y(rhs.size());
+    Status status;
+    double const solve_start_time = get_timestamp();
+    bool solved = false;
+    if (backend == BACKEND_DENSE)
+        solved = shared
+            ? solve_dense_cholesky(S, G, K, rhs, &delta_y)
+            : solve_dense_cholesky(S, rhs, &delta_y);
+    else if (backend == BACKEND_SPARSE)
+        solved = solve_sparse_cholesky(this->get_direct_solver(N), S,
+            shared ? &G : nullptr, K, rhs, &delta_y);
+    if (solved)
+    {
+        status.success = true;
+        status.backend = backend;
+    }
+    else
+    {
+        /*
+         * Compute the block-Jacobi pre-conditioner from B or S. The block
+         * of shared intrinsics is the one of the reduced system.
+         */
+        CameraMatrix precond;
+        set_block_diagonal_pattern(num_cameras, &precond);
+        bool const s_blocks
+            = this->opts.preconditioner == PRECONDITIONER_S_BLOCKS;
+#pragma omp parallel for schedule(dynamic, 16) if (parallel)
+        for (std::int64_t a = 0; a < static_cast<std::int64_t>(num_cameras);
+            ++a)
+        {
+            if (s_blocks && implicit)
+            {
+                implicit_S.camera_block(a, precond.block(a));
+                continue;
+            }
+            T const* block = s_blocks
+                ? S.block(S.find_block(a, a)) : B.block(a);
+            std::copy(block, block + CameraMatrix::BLOCK_SIZE,
+                precond.block(a));
+        }
+        precond.invert_diagonal_blocks();
+        T K_inv[9];
+        std::copy(K, K + 9, K_inv);
+        invert_block_3x3(K_inv);
+
+        /* Solve linear system with pre-conditioned CG. */
+        typedef sfm::ba::ConjugateGradient<T> CGSolver;
+        CGSolver solver(this->cg_options(rhs.norm()));
+        this->warm_start_solution(&delta_y);
+        CGBlockMatrixFunctor<T, CameraMatrix> explicit_S(S);
+        CGBlockMatrixFunctor<T, CameraMatrix> precond_functor(precond);
+        typedef typename CGSolver::Functor CGFunctor;
+        CGFunctor const& S_functor = implicit
+            ? static_cast<CGFunctor const&>(implicit_S) : explicit_S;
+        CGBorderedFunctor<T, N> const bordered_S(S_functor, &G, K);
+        CGBorderedFunctor<T, N> const bordered_precond(precond_functor,
+            nullptr, K_inv);
+        typename CGSolver::Status cg_status;
+        cg_status = shared
+            ? solver.solve(bordered_S, rhs, &delta_y, &bordered_precond)
+            : solver.solve(S_functor, rhs, &delta_y, &precond_functor);
+        this->last_solution.assign(delta_y.begin(), delta_y.end());
+
+        status.num_cg_iterations = cg_status.num_iterations;
+        switch (cg_status.info)
+        {
+            case CGSolver::CG_CONVERGENCE:
+                status.success = true;
+                break;
+            case CGSolver::CG_MAX_ITERATIONS:
+                status.success = true;
+                break;
+            case CGSolver::CG_INVALID_INPUT:
+                std::cout << "BA: CG failed (invalid input)" << std::endl;
+                status.success = false;
+                return status;
+            default:
+                break;
+        }
+    }
+    double const solve_end_time = get_timestamp();
+
+    /* Split off the update of the shared intrinsics. */
+    std::size_t const jac_cam_cols = jac_cams.num_cols();
+    DenseVector<T> delta_k(shared ? 3 : 0);
+    if (shared)
+    {
+        DenseVector<T> delta_cams(jac_cam_cols);
+        std::copy(delta_y.begin(), delta_y.begin() + jac_cam_cols,
+            delta_cams.begin());
+        std::copy(delta_y.begin() + jac_cam_cols, delta_y.end(),
+            delta_k.begin());
+        std::swap(delta_y, delta_cams);
+    }
+
+    /* Substitute back to obtain delta z. */
+    DenseVector<T> w_y = w.subtract(implicit
+        ? implicit_S.multiply_e_transpose(delta_y)
+        : E.transpose_multiply(delta_y));
+    for (std::size_t p = 0; shared && p < num_points; ++p)
+        for (int j = 0; j < 3; ++j)
+            for (int i = 0; i < 3; ++i)
+                w_y[p * 3 + j] -= E_k[p * 9 + i * 3 + j] * delta_k[i];
+    DenseVector<T> delta_z = C.multiply(w_y);
+
+    /* Fill output vector. */
+    std::size_t const jac_point_cols = jac_points.num_cols();
+    std::size_t const jac_cols = jac_cam_cols + delta_k.size()
+        + jac_point_cols;
+
+    if (delta_x->size() != jac_cols)
+        delta_x->resize(jac_cols, 0.0);
+    for (std::size_t i = 0; i < jac_cam_cols; ++i)
+        delta_x->at(i) = delta_y[i];
+    for (std::size_t i = 0; i < delta_k.size(); ++i)
+        delta_x->at(jac_cam_cols + i) = delta_k[i];
+    for (std::size_t i = 0; i < jac_point_cols; ++i)
+        delta_x->at(jac_cam_cols + delta_k.size() + i) = delta_z[i];
+
+    /* Compute predicted error decrease */
+    status.predicted_error_decrease = 0.0;
+    status.predicted_error_decrease += predicted_error_decrease(delta_y,
+        B_diag, v, this->opts.trust_region_radius);
+    status.predicted_error_decrease += predicted_error_decrease(delta_z,
+        C_diag, w, this->opts.trust_region_radius);
+    if (shared)
+        status.predicted_error_decrease += predicted_error_decrease(delta_k,
+            K_diag, u, this->opts.trust_region_radius);
+    status.solve_time = solve_end_time - solve_start_time;
+    status.schur_time = get_timestamp() - start_time - status.solve_time;
+
+    return status;
+}
+
+template <typename T, int BC>
+LinearSolver::Status
+LinearSolver::solve_block_diagonal (
+    BlockSparseMatrix<T, 2, BC> const& jacobian,
+    BlockSparseMatrix<T, 2, 3> const* jac_intrinsics,
+    DenseVectorType const& vector_f,
+    DenseVectorType* delta_x)
+{
+    /* With one block per observation, H = J^T * J is block diagonal. */
+    double const start_time = get_timestamp();
+    std::size_t const num_observations = jacobian.num_block_rows();
+    if (jacobian.num_blocks() != num_observations)
+        throw std::invalid_argument("One block per observation required");
+
+    /*
+     * Shared intrinsics border H with the block G = J^T * Ji of every
+     * block column and the 3x3 block K = Ji^T * Ji.
+     */
+    bool const shared = jac_intrinsics != nullptr;
+    BlockSparseMatrix<T, BC, BC> H;
+    set_block_diagonal_pattern(jacobian.num_block_cols(), &H);
+    BlockSparseMatrix<T, BC, 3> G;
+    T K[9] = { T(0) };
+    if (shared)
+        set_block_column_pattern(jacobian.num_block_cols(), &G);
+    for (std::size_t i = 0; i < num_observations; ++i)
+    {
+        if (jacobian.row_begin(i) != i)
+            throw std::invalid_argument("One block per observation required");
+        T const* block = jacobian.block(i);
+        block_transpose_multiply_add<2, BC, BC>(block, block,
+            H.block(jacobian.block_col(i)));
+        if (!shared)
+            continue;
+        T const* ji = jac_intrinsics->block(i);
+        block_transpose_multiply_add<2, BC, 3>(block, ji,
+            G.block(jacobian.block_col(i)));
+        block_transpose_multiply_add<2, 3, 3>(ji, ji, K);
+    }
+    DenseVector<T> const H_diag = H.diagonal();
+    DenseVector<T> K_diag(3);
+    for (int i = 0; i < 3; ++i)
+        K_diag[i] = K[i * 4];
+
+    /* Compute RHS. */
+    DenseVector<T> F;
+    convert_vector(vector_f, &F);
+    DenseVector<T> g = jacobian.transpose_multiply(F);
+    g.negate_self();
+    DenseVector<T> u;
+    if (shared)
+    {
+        u = jac_intrinsics->transpose_multiply(F);
+        u.negate_self();
+    }
+
+    /* Add regularization to H and invert blocks of H directly. */
+    H.mult_diagonal(1.0 + 1.0 / this->opts.trust_region_radius);
+    H.invert_diagonal_blocks();
+    for (int i = 0; i < 3; ++i)
+        K[i * 4] *= 1.0 + 1.0 / this->opts.trust_region_radius;
+
+    /*
+     * Eliminate the blocks from the intrinsics, which are then solved
+     * from (K - G^T * H^-1 * G) * delta_k = u - G^T * H^-1 * g. The
+     * blocks follow from H * delta = g - G * delta_k.
+     */
+    DenseVector<T> delta_k(shared ? 3 : 0);
+    DenseVector<T> g_k = g;
+    if (shared)
+    {
+        DenseVector<T> u_k = u;
+        for (std::size_t a = 0; a < jacobian.num_block_cols(); ++a)
+        {
+            T h_g_block[BC * 3];
+            block_multiply<BC, BC, 3>(H.block(a), G.block(a), h_g_block);
+            T g_t_h_g[9] = { T(0) };
+            block_transpose_multiply_add<BC, 3, 3>(G.block(a), h_g_block,
+                g_t_h_g);
+            T g_t_h_v[3] = { T(0) };
+            block_transpose_multiply_add<BC, 3, 1>(h_g_block,
+                g.data() + a * BC, g_t_h_v);
+            for (int i = 0; i < 9; ++i)
+                K[i] -= g_t_h_g[i];
+            for (int i = 0; i < 3; ++i)
+                u_k[i] -= g_t_h_v[i];
+        }
+        invert_block_3x3(K);
+        block_multiply<3, 3, 1>(K, u_k.data(), delta_k.data());
+        g_k = g.subtract(G.multiply(delta_k));
+    }
+    DenseVector<T> delta = H.multiply(g_k);
+
+    Status status;
+    status.success = true;
+    status.num_cg_iterations = 0;
+    status.predicted_error_decrease = predicted_error_decrease(delta,
+        H_diag, g, this->opts.trust_region_radius);
+    if (shared)
+    {
+        status.predicted_error_decrease += predicted_error_decrease(delta_k,
+            K_diag, u, this->opts.trust_region_radius);
+        DenseVector<T> delta_shared(delta.size() + 3);
+        std::copy(delta.begin(), delta.end(), delta_shared.begin());
+        std::copy(delta_k.begin(), delta_k.end(), delta_shared.end() - 3);
+        std::swap(delta, delta_shared);
+    }
+    convert_vector(delta, delta_x);
+    status.schur_time = get_timestamp() - start_time;
+
+    return status;
+}
+
+template LinearSolver::Status
+LinearSolver::solve<double, 6> (
+    BlockSparseMatrix<double, 2, 6> const& jac_cams,
+    BlockSparseMatrix<double, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<double, 9> (
+    BlockSparseMatrix<double, 2, 9> const& jac_cams,
+    BlockSparseMatrix<double, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<float, 6> (
+    BlockSparseMatrix<float, 2, 6> const& jac_cams,
+    BlockSparseMatrix<float, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<float, 9> (
+    BlockSparseMatrix<float, 2, 9> const& jac_cams,
+    BlockSparseMatrix<float, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<double, 6> (
+    BlockSparseMatrix<double, 2, 6> const& jac_cams,
+    BlockSparseMatrix<double, 2, 3> const& jac_intrinsics,
+    BlockSparseMatrix<double, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<double, 9> (
+    BlockSparseMatrix<double, 2, 9> const& jac_cams,
+    BlockSparseMatrix<double, 2, 3> const& jac_intrinsics,
+    BlockSparseMatrix<double, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<float, 6> (
+    BlockSparseMatrix<float, 2, 6> const& jac_cams,
+    BlockSparseMatrix<float, 2, 3> const& jac_intrinsics,
+    BlockSparseMatrix<float, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
+template LinearSolver::Status
+LinearSolver::solve<float, 9> (
+    BlockSparseMatrix<float, 2, 9> const& jac_cams,
+    BlockSparseMatrix<float, 2, 3> const& jac_intrinsics,
+    BlockSparseMatrix<float, 2, 3> const& jac_points,
+    DenseVectorType const& vector_f, DenseVectorType* delta_x);
+
 SFM_BA_NAMESPACE_END
 SFM_NAMESPACE_END
@@ -10,11 +10,15 @@
 #ifndef SFM_BA_LINEAR_SOLVER_HEADER
 #define SFM_BA_LINEAR_SOLVER_HEADER
 
+#include <algorithm>
 #include <vector>
 
 #include "sfm/defines.h"
 #include "sfm/ba_sparse_matrix.h"
+#include "sfm/ba_block_sparse_matrix.h"
 #include "sfm/ba_dense_vector.h"
+#include "sfm/ba_conjugate_gradient.h"
+#include "sfm/ba_direct_solver.h"
 
 SFM_NAMESPACE_BEGIN
 SFM_BA_NAMESPACE_BEGIN
@@ -22,6 +26,28 @@ SFM_BA_NAMESPACE_BEGIN
 class LinearSolver
 {
 public:
+    /** Block-Jacobi pre-conditioners for the reduced camera system S. */
+    enum Preconditioner
+    {
+        /** Inverse camera blocks on the diagonal of B = Jc^T * Jc. */
+        PRECONDITIONER_B_BLOCKS,
+        /** Inverse camera blocks on the diagonal of S, including points. */
+        PRECONDITIONER_S_BLOCKS
+    };
+
+    /** Solvers for the reduced camera system S of block Jacobians. */
+    enum Backend
+    {
+        /** Selects the solver from the size and the pattern of S. */
+        BACKEND_AUTO,
+        /** Pre-conditioned CG, with the implicit S if enabled. */
+        BACKEND_CG,
+        /** Dense Cholesky decomposition. */
+        BACKEND_DENSE,
+        /** Sparse direct solver with a fill-reducing ordering. */
+        BACKEND_SPARSE
+    };
+
     struct Options
     {
         Options (void);
@@ -29,6 +55,57 @@ public:
         double trust_region_radius;
         int cg_max_iterations;
         int camera_block_dim;
+        Preconditioner preconditioner;
+        /**
+         * The solver of the reduced camera system for block Jacobians.
+         * Defaults to BACKEND_AUTO, which uses the dense Cholesky for at most
+         * dense_max_cameras cameras, and otherwise the sparse direct solver
+         * if its factorization costs at most sparse_max_cost products with
+         * S, or CG. If a direct solver fails, CG is used for the system.
+         */
+        Backend backend;
+        /**
+         * Reduced camera systems with at most this many cameras are solved
+         * with a dense Cholesky decomposition by BACKEND_AUTO. Defaults to
+         * 100, a value of 0 never selects the dense Cholesky.
+         */
+        std::size_t dense_max_cameras;
+        /**
+         * The implementation of the sparse direct solver. Defaults to
+         * CHOLMOD if compiled with it, and the block Cholesky otherwise.
+         * The ordering and the symbolic factorization are computed once
+         * while the pattern of S is the same.
+         */
+        DirectSolver::Backend sparse_backend;
+        /**
+         * The maximum cost of the sparse factorization for BACKEND_AUTO in
+         * products of S with a vector, i.e. CG iterations. Defaults to 100.
+         */
+        double sparse_max_cost;
+        /**
+         * Applies the Schur complement S = B - E * C^-1 * E^T implicitly in
+         * CG for block Jacobians, as products with Jc, Jp, the inverse
+         * blocks of C and the blocks of B. S is then never formed, which
+         * saves its memory for large problems at the cost of more work per
+         * CG iteration. The direct solvers still form S, and BACKEND_AUTO
+         * selects CG for systems above dense_max_cameras. Defaults to false.
+         */
+        bool implicit_schur;
+        /**
+         * Upper bound of the forcing term for inexact steps. CG stops once
+         * the residual norm is below the forcing term times the norm of
+         * the right hand side. The forcing term follows the decrease of
+         * the right hand side between the linearizations (Eisenstat-Walker),
+         * i.e. early LM steps are solved coarsely and the final steps
+         * accurately. Defaults to 0, which solves to the fixed tolerance.
+         */
+        double cg_forcing_max;
+        /**
+         * Starts CG from the last solution after a rejected step, which
+         * solves the same system with a smaller trust region, see
+         * set_rejected_step(). Defaults to false.
+         */
+        bool cg_warm_start;
     };
 
     struct Status
@@ -38,6 +115,15 @@ public:
         double predicted_error_decrease;
         int num_cg_iterations;
         bool success;
+        /** The solver of the reduced camera system for block Jacobians. */
+        Backend backend;
+        /**
+         * Times in milliseconds for block Jacobians. The Schur time covers
+         * the blocks of H, the Schur complement and the back-substitution,
+         * the solve time covers CG or the direct solver.
+         */
+        double schur_time;
+        double solve_time;
     };
 
     typedef SparseMatrix<double> SparseMatrixType;
@@ -46,19 +132,120 @@ public:
 public:
     LinearSolver (Options const& options);
 
+    /** Sets the trust region radius for the next solve. */
+    void set_trust_region_radius (double radius);
+
+    /**
+     * Marks the next solve as the one after a rejected step, i.e. for
+     * the linearization of the last solve. The forcing term is then kept,
+     * and CG starts from the last solution with cg_warm_start.
+     */
+    void set_rejected_step (bool rejected);
+
     /**
      * Solve the system J^T J x = -J^T f based on the bundle adjustment mode.
      * If the Jacobian for cameras is empty, only points are optimized.
      * If the Jacobian for points is empty, only cameras are optimized.
      * If both, Jacobian for cams and points is given, the Schur complement
      * trick is used to solve the linear system.
+     *
+     * The patterns of the transposes and products are computed once and
+     * reused while the Jacobians keep their dimensions and number of
+     * non-zeros, as for the iterations of one bundle adjustment problem.
+     * Only the values are computed again in later calls.
      */
     Status solve (SparseMatrixType const& jac_cams,
         SparseMatrixType const& jac_points,
         DenseVectorType const& vector_f,
         DenseVectorType* delta_x);
 
+    /**
+     * Solves the system like solve() above for block Jacobians, which have
+     * a single 2xN camera block and 2x3 point block per observation, where
+     * N is 6 or 9. The blocks of the Hessian H = J^T * J and of the Schur
+     * complement are computed directly from the observation blocks. With
+     * only cameras or only points, H is block diagonal and inverted
+     * directly. The pattern of the Schur complement is reused while the
+     * observations are the same.
+     *
+     * The scalar type T of the Jacobians is double or float. With float,
+     * the Hessian, the Schur complement and CG are computed in single
+     * precision, but the residuals and the update are double.
+     */
+    template <typename T, int N>
+    Status solve (BlockSparseMatrix<T, 2, N> const& jac_cams,
+        BlockSparseMatrix<T, 2, 3> const& jac_points,
+        DenseVectorType const& vector_f,
+        DenseVectorType* delta_x);
+
+    /**
+     * Solves the system like solve() above with intrinsics that are shared
+     * by all cameras. The intrinsics Jacobian has a 2x3 block per
+     * observation in its single block column, which couples all cameras.
+     * The reduced system of the cameras is bordered by this block, and CG
+     * is pre-conditioned with its inverse in addition to the camera
+     * blocks. The update is ordered as cameras, intrinsics and points. An
+     * empty intrinsics Jacobian solves without shared intrinsics.
+     */
+    template <typename T, int N>
+    Status solve (BlockSparseMatrix<T, 2, N> const& jac_cams,
+        BlockSparseMatrix<T, 2, 3> const& jac_intrinsics,
+        BlockSparseMatrix<T, 2, 3> const& jac_points,
+        DenseVectorType const& vector_f,
+        DenseVectorType* delta_x);
+
 private:
+    /**
+     * Schur complement for block Jacobians of cameras and points, and of
+     * the shared intrinsics if the intrinsics Jacobian is not null.
+     */
+    template <typename T, int N>
+    Status solve_schur (BlockSparseMatrix<T, 2, N> const& jac_cams,
+        BlockSparseMatrix<T, 2, 3> const* jac_intrinsics,
+        BlockSparseMatrix<T, 2, 3> const& jac_points,
+        DenseVectorType const& vector_f,
+        DenseVectorType* delta_x);
+
+    /**
+     * Solves the block diagonal system for block Jacobians. With the
+     * Jacobian of shared intrinsics, the system is bordered by the
+     * intrinsics block, which is solved first by eliminating the blocks.
+     */
+    template <typename T, int BC>
+    Status solve_block_diagonal (BlockSparseMatrix<T, 2, BC> const& jacobian,
+        BlockSparseMatrix<T, 2, 3> const* jac_intrinsics,
+        DenseVectorType const& vector_f,
+        DenseVectorType* delta_x);
+
+    /**
+     * Returns the CG options for the right hand side, and updates the
+     * forcing term for a new linearization.
+     */
+    template <typename T>
+    typename ConjugateGradient<T>::Options cg_options (T rhs_norm);
+
+    /** Sets the last solution as initial guess for a warm start. */
+    template <typename T>
+    void warm_start_solution (DenseVector<T>* x) const;
+
+    /** Applies the Schur complement S implicitly for CG. */
+    template <typename T, int N>
+    class ImplicitSchurFunctor;
+
+    /**
+     * Returns the solver for the reduced camera system with the pattern
+     * of the Schur complement and N x N blocks.
+     */
+    Backend select_backend (int block_dim);
+
+    /** Returns the sparse solver, analyzed for the pattern of S. */
+    DirectSolver* get_direct_solver (int block_dim);
+
+    /** Updates the pattern of the Schur complement for the observations. */
+    template <typename T, int N>
+    void update_schur_pattern (BlockSparseMatrix<T, 2, N> const& jac_cams,
+        BlockSparseMatrix<T, 2, 3> const& jac_points);
+
     /**
      * Conjugate Gradient on Schur-complement by exploiting the block
      * structure of H = J^T * J.
@@ -80,8 +267,63 @@ private:
         DenseVectorType* delta_x,
         std::size_t block_size = 0);
 
+private:
+    /** Transposes and products of the Jacobians with a reusable pattern. */
+    struct Products
+    {
+        Products (void);
+        bool has_pattern (SparseMatrixType const& jac_cams,
+            SparseMatrixType const& jac_points) const;
+
+        std::size_t num_rows;
+        std::size_t num_cam_cols;
+        std::size_t num_cam_non_zero;
+        std::size_t num_point_cols;
+        std::size_t num_point_non_zero;
+
+        /* Transposes of the Jacobians. */
+        SparseMatrixType jac_cams_t;
+        SparseMatrixType jac_points_t;
+        /* E = Jc^T * Jp, E^T and S = B - E * C^-1 * E^T. */
+        SparseMatrixType e;
+        SparseMatrixType e_t;
+        SparseMatrixType schur;
+        /* H = J^T * J without Schur complement. */
+        SparseMatrixType hessian;
+    };
+
+    /** Pattern of the block Schur complement for the observations. */
+    struct SchurPattern
+    {
+        /* Camera and point of every observation. */
+        std::vector<std::size_t> camera_ids;
+        std::vector<std::size_t> point_ids;
+        /* Observations of every point. */
+        std::vector<std::size_t> point_outer;
+        std::vector<std::size_t> point_observations;
+        /* Observations of every camera, which are the blocks of E. */
+        std::vector<std::size_t> camera_outer;
+        std::vector<std::size_t> camera_observations;
+        /* The block of E for every observation. */
+        std::vector<std::size_t> observation_blocks;
+        /* The pattern of the Schur complement S. */
+        std::vector<std::size_t> schur_outer;
+        std::vector<std::size_t> schur_inner;
+    };
+
 private:
     Options opts;
+    Products products;
+    SchurPattern schur_pattern;
+    /* The sparse solver and its block dimension, 0 if not analyzed. */
+    DirectSolver::Ptr direct_solver;
+    int direct_block_dim;
+
+    /* The state of inexact steps across solves. */
+    bool rejected_step;
+    double forcing_term;
+    double last_rhs_norm;
+    std::vector<double> last_solution;
 };
 
 /* ------------------------ Implementation ------------------------ */
@@ -90,6 +332,14 @@ inline
 LinearSolver::Options::Options (void)
     : trust_region_radius(1.0)
     , cg_max_iterations(1000)
+    , preconditioner(PRECONDITIONER_B_BLOCKS)
+    , backend(BACKEND_AUTO)
+    , dense_max_cameras(100)
+    , sparse_backend(DirectSolver::get_default_backend())
+    , sparse_max_cost(100.0)
+    , implicit_schur(false)
+    , cg_forcing_max(0.0)
+    , cg_warm_start(false)
 {
 }
 
@@ -98,13 +348,55 @@ LinearSolver::Status::Status (void)
     : predicted_error_decrease(0.0)
     , num_cg_iterations(0)
     , success(false)
+    , backend(BACKEND_CG)
+    , schur_time(0.0)
+    , solve_time(0.0)
 {
 }
 
+inline
+LinearSolver::Products::Products (void)
+    : num_rows(0)
+    , num_cam_cols(0)
+    , num_cam_non_zero(0)
+    , num_point_cols(0)
+    , num_point_non_zero(0)
+{
+}
+
+inline bool
+LinearSolver::Products::has_pattern (SparseMatrixType const& jac_cams,
+    SparseMatrixType const& jac_points) const
+{
+    std::size_t const rows = std::max(jac_cams.num_rows(),
+        jac_points.num_rows());
+    return this->num_rows == rows
+        && this->num_cam_cols == jac_cams.num_cols()
+        && this->num_cam_non_zero == jac_cams.num_non_zero()
+        && this->num_point_cols == jac_points.num_cols()
+        && this->num_point_non_zero == jac_points.num_non_zero();
+}
+
 inline
 LinearSolver::LinearSolver (Options const& options)
     : opts(options)
+    , direct_block_dim(0)
+    , rejected_step(false)
+    , forcing_term(0.0)
+    , last_rhs_norm(0.0)
+{
+}
+
+inline void
+LinearSolver::set_trust_region_radius (double radius)
+{
+    this->opts.trust_region_radius = radius;
+}
+
+inline void
+LinearSolver::set_rejected_step (bool rejected)
 {
+    this->rejected_step = rejected;
 }
 
 SFM_BA_NAMESPACE_END
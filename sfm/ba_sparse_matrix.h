@@ -10,11 +10,16 @@
 #ifndef SFM_SPARSE_MATRIX_HEADER
 #define SFM_SPARSE_MATRIX_HEADER
 
-#include <thread>
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
+#include "util/arena.h"
+#include "util/memory.h"
 #include "sfm/ba_dense_vector.h"
 #include "sfm/defines.h"
 
@@ -48,32 +53,50 @@ public:
     void allocate (std::size_t rows, std::size_t cols);
     void reserve (std::size_t num_elements);
     void set_from_triplets (Triplets const& triplets);
+    void set_pattern (std::vector<std::size_t> const& outer,
+        std::vector<std::size_t> const& inner);
     void mult_diagonal (T const& factor);
     void cwise_invert (void);
     void column_nonzeros (std::size_t col, DenseVector<T>* vector) const;
 
     SparseMatrix transpose (void) const;
+    void transpose_values (SparseMatrix* ret) const;
     SparseMatrix subtract (SparseMatrix const& rhs) const;
     SparseMatrix multiply (SparseMatrix const& rhs) const;
     SparseMatrix sequential_multiply (SparseMatrix const& rhs) const;
     SparseMatrix parallel_multiply (SparseMatrix const& rhs) const;
+    SparseMatrix multiply_pattern (SparseMatrix const& rhs) const;
+    void multiply_values (SparseMatrix const& rhs, SparseMatrix* ret) const;
     DenseVector<T> multiply (DenseVector<T> const& rhs) const;
     SparseMatrix diagonal_matrix (void) const;
+    SparseMatrix block_diagonal_matrix (std::size_t block_size) const;
+    void to_dense (std::vector<T>* matrix) const;
 
     std::size_t num_non_zero (void) const;
     std::size_t num_rows (void) const;
     std::size_t num_cols (void) const;
+    std::size_t column_begin (std::size_t col) const;
+    std::size_t column_end (std::size_t col) const;
+    std::size_t const* row_indices (void) const;
     T* begin (void);
     T* end (void);
+    T const* begin (void) const;
+    T const* end (void) const;
 
     void debug (void) const;
 
+private:
+    void transpose_into (SparseMatrix* ret, bool compute_pattern,
+        bool keep_positions = true) const;
+
 private:
     std::size_t rows;
     std::size_t cols;
-    std::vector<T> values;
-    std::vector<std::size_t> outer;
-    std::vector<std::size_t> inner;
+    util::TrackedVector<T, util::MEMORY_BA> values;
+    util::TrackedVector<std::size_t, util::MEMORY_BA> outer;
+    util::TrackedVector<std::size_t, util::MEMORY_BA> inner;
+    /* For a transpose, the position of every value of the source. */
+    util::TrackedVector<std::size_t, util::MEMORY_BA> transpose_positions;
 };
 
 SFM_BA_NAMESPACE_END
@@ -118,6 +141,7 @@ SparseMatrix<T>::allocate (std::size_t rows, std::size_t cols)
     this->outer.clear();
     this->inner.clear();// col id of none zero elements
     this->outer.resize(cols + 1, 0);
+    this->transpose_positions.clear();
 }
 
 template <typename T>
@@ -144,7 +168,8 @@ SparseMatrix<T>::set_from_triplets (Triplets const& triplets)
 
     /* Convert amounts to indices with prefix sum. */
     std::size_t sum = 0;
-    std::vector<std::size_t> scratch(transposed.outer.size());
+    util::ArenaScope scope;
+    util::ArenaVector<std::size_t> scratch(transposed.outer.size());
     for (std::size_t i = 0; i < transposed.outer.size(); ++i)
     {
         std::size_t const temp = transposed.outer[i];
@@ -163,7 +188,31 @@ SparseMatrix<T>::set_from_triplets (Triplets const& triplets)
     }
 
     /* Transpose matrix, implicit sorting of inner indices. */
-    *this = transposed.transpose();
+    this->outer.resize(this->cols + 1);
+    this->values.resize(triplets.size());
+    this->inner.resize(triplets.size());
+    this->transpose_positions.clear();
+    transposed.transpose_into(this, true, false);
+}
+
+/*
+ * Sets the non-zero pattern from the outer and inner indices, where the
+ * inner indices of every column must be sorted. All values are zero and
+ * can be overwritten in-place, which avoids building the matrix from
+ * triplets if the pattern is the same for many matrices.
+ */
+template <typename T>
+void
+SparseMatrix<T>::set_pattern (std::vector<std::size_t> const& outer,
+    std::vector<std::size_t> const& inner)
+{
+    if (outer.size() != this->cols + 1 || outer.back() != inner.size())
+        throw std::invalid_argument("Invalid sparse matrix pattern");
+
+    this->outer.assign(outer.begin(), outer.end());
+    this->inner.assign(inner.begin(), inner.end());
+    this->values.assign(inner.size(), T(0));
+    this->transpose_positions.clear();
 }
 
 template <typename T>
@@ -173,32 +222,107 @@ SparseMatrix<T>::transpose (void) const
     SparseMatrix ret(this->cols, this->rows);
     ret.values.resize(this->num_non_zero());
     ret.inner.resize(this->num_non_zero());
+    this->transpose_into(&ret, true);
+    return ret;
+}
 
-    /* Compute inner sizes of transposed matrix. */
-    for(std::size_t i = 0; i < this->inner.size(); ++i)
-        ret.outer[this->inner[i]] += 1;
+/*
+ * Computes the values of the transposed matrix into a matrix that has the
+ * pattern of the transpose, e.g. from a previous call to transpose(). The
+ * transpose keeps the position of every value, which is computed once for
+ * the pattern, so later calls only permute the values.
+ */
+template <typename T>
+void
+SparseMatrix<T>::transpose_values (SparseMatrix* ret) const
+{
+    if (ret->rows != this->cols || ret->cols != this->rows
+        || ret->num_non_zero() != this->num_non_zero())
+        throw std::invalid_argument("Incompatible transpose pattern");
 
-    /* Compute outer sizes of transposed matrix with prefix sum. */
-    std::size_t sum = 0;
-    std::vector<std::size_t> scratch(ret.outer.size());
-    for (std::size_t i = 0; i < ret.outer.size(); ++i)
+    if (ret->transpose_positions.size() != this->num_non_zero())
     {
-        std::size_t const temp = ret.outer[i];
-        ret.outer[i] = sum;
-        scratch[i] = sum;
-        sum += temp;
+        this->transpose_into(ret, false);
+        return;
     }
 
-    /* Write inner indices and values of transposed matrix. */
-    for (std::size_t i = 0; i < this->outer.size() - 1; ++i)
-        for (std::size_t j = this->outer[i]; j < this->outer[i + 1]; ++j)
+    std::int64_t const num_values = this->num_non_zero();
+    std::size_t const* positions = ret->transpose_positions.data();
+#pragma omp parallel for schedule(static) \
+    if (this->num_non_zero() >= internal::PARALLEL_CHUNK_SIZE)
+    for (std::int64_t i = 0; i < num_values; ++i)
+        ret->values[positions[i]] = this->values[i];
+}
+
+/*
+ * Writes the transpose into a matrix with allocated inner indices and
+ * values. Every thread counts the entries per row for its consecutive
+ * columns, which yields the positions of its entries in the transpose.
+ * The entries are thus written in parallel in the order of the columns,
+ * and the positions are kept for transpose_values().
+ */
+template <typename T>
+void
+SparseMatrix<T>::transpose_into (SparseMatrix* ret, bool compute_pattern,
+    bool keep_positions) const
+{
+    std::int64_t const num_cols = this->cols;
+    std::vector<std::size_t> offsets;
+    if (keep_positions)
+        ret->transpose_positions.resize(this->num_non_zero());
+#pragma omp parallel \
+    if (this->num_non_zero() >= internal::PARALLEL_CHUNK_SIZE)
+    {
+#ifdef _OPENMP
+        std::size_t const num_threads = omp_get_num_threads();
+        std::size_t const thread_id = omp_get_thread_num();
+#else
+        std::size_t const num_threads = 1;
+        std::size_t const thread_id = 0;
+#endif
+
+#pragma omp single
+        offsets.assign(num_threads * this->rows, 0);
+        std::size_t* thread_offsets = offsets.data() + thread_id * this->rows;
+
+        /* Count the entries of every row for the columns of the thread. */
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_cols; ++i)
+            for (std::size_t j = this->outer[i]; j < this->outer[i + 1]; ++j)
+                thread_offsets[this->inner[j]] += 1;
+
+        /* Compute the offsets with a prefix sum over rows and threads. */
+#pragma omp single
         {
-            std::size_t pos = scratch[this->inner[j]]++;
-            ret.inner[pos] = i;
-            ret.values[pos] = this->values[j];
+            std::size_t sum = 0;
+            for (std::size_t row = 0; row < this->rows; ++row)
+            {
+                if (compute_pattern)
+                    ret->outer[row] = sum;
+                for (std::size_t t = 0; t < num_threads; ++t)
+                {
+                    std::size_t const count = offsets[t * this->rows + row];
+                    offsets[t * this->rows + row] = sum;
+                    sum += count;
+                }
+            }
+            if (compute_pattern)
+                ret->outer[this->rows] = sum;
         }
 
-    return ret;
+        /* The static schedule assigns the same columns as above. */
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_cols; ++i)
+            for (std::size_t j = this->outer[i]; j < this->outer[i + 1]; ++j)
+            {
+                std::size_t const pos = thread_offsets[this->inner[j]]++;
+                if (compute_pattern)
+                    ret->inner[pos] = i;
+                ret->values[pos] = this->values[j];
+                if (keep_positions)
+                    ret->transpose_positions[j] = pos;
+            }
+    }
 }
 
 template <typename T>
@@ -261,11 +385,13 @@ template <typename T>
 SparseMatrix<T>
 SparseMatrix<T>::multiply (SparseMatrix const& rhs) const
 {
+    /* Small products and products within parallel regions are serial. */
 #ifdef _OPENMP
-    return this->parallel_multiply(rhs);
-#else
-    return this->sequential_multiply(rhs);
+    if (this->num_non_zero() + rhs.num_non_zero()
+        >= internal::PARALLEL_CHUNK_SIZE && !omp_in_parallel())
+        return this->parallel_multiply(rhs);
 #endif
+    return this->sequential_multiply(rhs);
 }
 
 template <typename T>
@@ -278,15 +404,16 @@ SparseMatrix<T>::sequential_multiply (SparseMatrix const& rhs) const
     SparseMatrix ret(this->rows, rhs.cols);
     ret.reserve(this->num_non_zero() + rhs.num_non_zero());
 
-    /* Matrix-matrix multiplication. */
-    std::vector<T> ret_col(ret.rows, T(0));
-    std::vector<bool> ret_nonzero(ret.rows, false);
+    /* Matrix-matrix multiplication with scratch memory of the thread. */
+    util::ArenaScope scope;
+    util::ArenaVector<T> ret_col(ret.rows, T(0));
+    util::ArenaVector<unsigned char> ret_nonzero(ret.rows, 0);
     for (std::size_t col = 0; col < ret.cols; ++col)
     {
         ret.outer[col] = ret.values.size();
 
         std::fill(ret_col.begin(), ret_col.end(), T(0));
-        std::fill(ret_nonzero.begin(), ret_nonzero.end(), false);
+        std::fill(ret_nonzero.begin(), ret_nonzero.end(), 0);
         std::size_t rhs_col_begin = rhs.outer[col];
         std::size_t rhs_col_end = rhs.outer[col + 1];
         for (std::size_t i = rhs_col_begin; i < rhs_col_end; ++i)
@@ -300,7 +427,7 @@ SparseMatrix<T>::sequential_multiply (SparseMatrix const& rhs) const
             {
                 std::size_t const id = this->inner[j];
                 ret_col[id] += this->values[j] * rhs_col_value;
-                ret_nonzero[id] = true;
+                ret_nonzero[id] = 1;
             }
         }
         for (std::size_t i = 0; i < ret.rows; ++i)
@@ -330,15 +457,12 @@ SparseMatrix<T>::parallel_multiply (SparseMatrix const& rhs) const
     std::size_t const chunk_size = 64;
     std::size_t const num_chunks = ret.cols / chunk_size
          + (ret.cols % chunk_size != 0);
-    std::size_t const max_threads = std::max(1u,
-        std::thread::hardware_concurrency());
-    std::size_t const num_threads = std::min(num_chunks, max_threads);
-
-#pragma omp parallel num_threads(num_threads)
+#pragma omp parallel
     {
-        /* Matrix-matrix multiplication. */
-        std::vector<T> ret_col(ret.rows, T(0));
-        std::vector<bool> ret_nonzero(ret.rows, false);
+        /* Matrix-matrix multiplication with scratch memory of the thread. */
+        util::ArenaScope scope;
+        util::ArenaVector<T> ret_col(ret.rows, T(0));
+        util::ArenaVector<unsigned char> ret_nonzero(ret.rows, 0);
         std::vector<T> thread_values;
         thread_values.reserve(nnz / num_chunks);
         std::vector<std::size_t> thread_inner;
@@ -355,7 +479,7 @@ SparseMatrix<T>::parallel_multiply (SparseMatrix const& rhs) const
             for (std::size_t col = begin; col < end; ++col)
             {
                 std::fill(ret_col.begin(), ret_col.end(), T(0));
-                std::fill(ret_nonzero.begin(), ret_nonzero.end(), false);
+                std::fill(ret_nonzero.begin(), ret_nonzero.end(), 0);
                 std::size_t const rhs_col_begin = rhs.outer[col];
                 std::size_t const rhs_col_end = rhs.outer[col + 1];
                 for (std::size_t i = rhs_col_begin; i < rhs_col_end; ++i)
@@ -369,7 +493,7 @@ SparseMatrix<T>::parallel_multiply (SparseMatrix const& rhs) const
                     {
                         std::size_t const id = this->inner[j];
                         ret_col[id] += this->values[j] * rhs_col_value;
-                        ret_nonzero[id] = true;
+                        ret_nonzero[id] = 1;
                     }
                 }
                 for (std::size_t i = 0; i < ret.rows; ++i)
@@ -397,6 +521,91 @@ SparseMatrix<T>::parallel_multiply (SparseMatrix const& rhs) const
     return ret;
 }
 
+/*
+ * Computes the pattern of the matrix-matrix product, all values are zero.
+ * The values are computed with multiply_values(), which separates the
+ * symbolic from the numeric product if the pattern is used many times.
+ */
+template <typename T>
+SparseMatrix<T>
+SparseMatrix<T>::multiply_pattern (SparseMatrix const& rhs) const
+{
+    if (this->cols != rhs.rows)
+        throw std::invalid_argument("Incompatible matrix dimensions");
+
+    SparseMatrix ret(this->rows, rhs.cols);
+    ret.inner.reserve(this->num_non_zero() + rhs.num_non_zero());
+
+    /* Rows are marked with the last column they were added to. */
+    std::vector<std::size_t> marker(ret.rows, ret.cols);
+    for (std::size_t col = 0; col < ret.cols; ++col)
+    {
+        ret.outer[col] = ret.inner.size();
+        for (std::size_t i = rhs.outer[col]; i < rhs.outer[col + 1]; ++i)
+        {
+            std::size_t const lhs_col = rhs.inner[i];
+            for (std::size_t j = this->outer[lhs_col];
+                j < this->outer[lhs_col + 1]; ++j)
+            {
+                std::size_t const id = this->inner[j];
+                if (marker[id] == col)
+                    continue;
+                marker[id] = col;
+                ret.inner.push_back(id);
+            }
+        }
+        std::sort(ret.inner.begin() + ret.outer[col], ret.inner.end());
+    }
+    ret.outer[ret.cols] = ret.inner.size();
+    ret.values.assign(ret.inner.size(), T(0));
+
+    return ret;
+}
+
+/*
+ * Computes the values of the matrix-matrix product into a matrix with the
+ * pattern from multiply_pattern(). Only the non-zeros of the pattern are
+ * visited, and the columns are computed in parallel.
+ */
+template <typename T>
+void
+SparseMatrix<T>::multiply_values (SparseMatrix const& rhs,
+    SparseMatrix* ret) const
+{
+    if (this->cols != rhs.rows || ret->rows != this->rows
+        || ret->cols != rhs.cols)
+        throw std::invalid_argument("Incompatible matrix dimensions");
+
+#pragma omp parallel \
+    if (ret->num_non_zero() >= internal::PARALLEL_CHUNK_SIZE)
+    {
+        std::vector<T> ret_col(ret->rows, T(0));
+#pragma omp for schedule(dynamic, 64)
+        for (std::int64_t c = 0; c < static_cast<std::int64_t>(ret->cols);
+            ++c)
+        {
+            std::size_t const col = static_cast<std::size_t>(c);
+            std::size_t const ret_col_begin = ret->outer[col];
+            std::size_t const ret_col_end = ret->outer[col + 1];
+            for (std::size_t i = ret_col_begin; i < ret_col_end; ++i)
+                ret_col[ret->inner[i]] = T(0);
+
+            for (std::size_t i = rhs.outer[col]; i < rhs.outer[col + 1]; ++i)
+            {
+                T const& rhs_col_value = rhs.values[i];
+                std::size_t const lhs_col = rhs.inner[i];
+                std::size_t const lhs_col_begin = this->outer[lhs_col];
+                std::size_t const lhs_col_end = this->outer[lhs_col + 1];
+                for (std::size_t j = lhs_col_begin; j < lhs_col_end; ++j)
+                    ret_col[this->inner[j]] += this->values[j] * rhs_col_value;
+            }
+
+            for (std::size_t i = ret_col_begin; i < ret_col_end; ++i)
+                ret->values[i] = ret_col[ret->inner[i]];
+        }
+    }
+}
+
 template<typename T>
 DenseVector<T>
 SparseMatrix<T>::multiply (DenseVector<T> const& rhs) const
@@ -405,9 +614,48 @@ SparseMatrix<T>::multiply (DenseVector<T> const& rhs) const
         throw std::invalid_argument("Incompatible dimensions");
 
     DenseVector<T> ret(this->rows, T(0));
-    for (std::size_t i = 0; i < this->cols; ++i)
-        for (std::size_t id = this->outer[i]; id < this->outer[i + 1]; ++id)
-            ret[this->inner[id]] += this->values[id] * rhs[i];
+    if (this->num_non_zero() < internal::PARALLEL_CHUNK_SIZE)
+    {
+        for (std::size_t i = 0; i < this->cols; ++i)
+            for (std::size_t id = this->outer[i]; id < this->outer[i + 1];
+                ++id)
+                ret[this->inner[id]] += this->values[id] * rhs[i];
+        return ret;
+    }
+
+    /*
+     * Every thread scatters its columns into its own result, and the
+     * results are summed in the order of the threads for every row.
+     */
+    std::int64_t const num_cols = this->cols;
+    std::int64_t const num_rows = this->rows;
+    std::vector<DenseVector<T>> thread_rets;
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+        std::size_t const num_threads = omp_get_num_threads();
+        std::size_t const thread_id = omp_get_thread_num();
+#else
+        std::size_t const num_threads = 1;
+        std::size_t const thread_id = 0;
+#endif
+
+#pragma omp single
+        thread_rets.resize(num_threads);
+        DenseVector<T>& thread_ret = thread_rets[thread_id];
+        thread_ret.resize(this->rows, T(0));
+
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_cols; ++i)
+            for (std::size_t id = this->outer[i]; id < this->outer[i + 1];
+                ++id)
+                thread_ret[this->inner[id]] += this->values[id] * rhs[i];
+
+#pragma omp for schedule(static)
+        for (std::int64_t i = 0; i < num_rows; ++i)
+            for (std::size_t t = 0; t < num_threads; ++t)
+                ret[i] += thread_rets[t][i];
+    }
     return ret;
 }
 
@@ -434,6 +682,52 @@ SparseMatrix<T>::diagonal_matrix (void) const
     return ret;
 }
 
+/*
+ * Returns the square blocks on the diagonal of a square matrix. All values
+ * of the blocks are stored, including zeros, such that the values of every
+ * block are consecutive.
+ */
+template<typename T>
+SparseMatrix<T>
+SparseMatrix<T>::block_diagonal_matrix (std::size_t block_size) const
+{
+    if (this->rows != this->cols)
+        throw std::invalid_argument("Block matrix must be square");
+    if (block_size == 0 || this->rows % block_size != 0)
+        throw std::invalid_argument("Invalid block size");
+
+    SparseMatrix ret(this->rows, this->cols);
+    ret.inner.resize(this->cols * block_size);
+    ret.values.resize(this->cols * block_size, T(0));
+    for (std::size_t col = 0; col < this->cols; ++col)
+    {
+        std::size_t const block_begin = col - col % block_size;
+        std::size_t const offset = col * block_size;
+        ret.outer[col] = offset;
+        for (std::size_t i = 0; i < block_size; ++i)
+            ret.inner[offset + i] = block_begin + i;
+        for (std::size_t j = this->outer[col]; j < this->outer[col + 1]; ++j)
+        {
+            std::size_t const row = this->inner[j];
+            if (row >= block_begin && row < block_begin + block_size)
+                ret.values[offset + row - block_begin] = this->values[j];
+        }
+    }
+    ret.outer[this->cols] = ret.values.size();
+    return ret;
+}
+
+/** Returns the dense matrix in row-major order. */
+template<typename T>
+void
+SparseMatrix<T>::to_dense (std::vector<T>* matrix) const
+{
+    matrix->assign(this->rows * this->cols, T(0));
+    for (std::size_t col = 0; col < this->cols; ++col)
+        for (std::size_t j = this->outer[col]; j < this->outer[col + 1]; ++j)
+            matrix->at(this->inner[j] * this->cols + col) = this->values[j];
+}
+
 template<typename T>
 void
 SparseMatrix<T>::mult_diagonal (T const& factor)
@@ -488,6 +782,30 @@ SparseMatrix<T>::num_cols (void) const
     return this->cols;
 }
 
+/** Returns the index of the first value of the column. */
+template<typename T>
+inline std::size_t
+SparseMatrix<T>::column_begin (std::size_t col) const
+{
+    return this->outer[col];
+}
+
+/** Returns the index past the last value of the column. */
+template<typename T>
+inline std::size_t
+SparseMatrix<T>::column_end (std::size_t col) const
+{
+    return this->outer[col + 1];
+}
+
+/** Returns the row of every value, sorted within every column. */
+template<typename T>
+inline std::size_t const*
+SparseMatrix<T>::row_indices (void) const
+{
+    return this->inner.data();
+}
+
 template<typename T>
 inline T*
 SparseMatrix<T>::begin (void)
@@ -502,6 +820,20 @@ SparseMatrix<T>::end (void)
     return this->values.data() + this->values.size();
 }
 
+template<typename T>
+inline T const*
+SparseMatrix<T>::begin (void) const
+{
+    return this->values.data();
+}
+
+template<typename T>
+inline T const*
+SparseMatrix<T>::end (void) const
+{
+    return this->values.data() + this->values.size();
+}
+
 template<typename T>
 void
 SparseMatrix<T>::debug (void) const
@@ -7,13 +7,22 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <thread>
 #include <iostream>
 #include <iomanip>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define BA_X86_DISPATCH 1
+#endif
 
 #include "math/matrix_tools.h"
+#include "util/profiler.h"
 #include "util/timer.h"
-#include "sfm/ba_sparse_matrix.h"
+#include "sfm/ba_block_sparse_matrix.h"
 #include "sfm/ba_dense_vector.h"
 #include "sfm/bundle_adjustment.h"
 
@@ -29,17 +38,335 @@
 SFM_NAMESPACE_BEGIN
 SFM_BA_NAMESPACE_BEGIN
 
+namespace
+{
+    /* Returns a monotonic time stamp in milliseconds for statistics. */
+    double
+    get_timestamp (void)
+    {
+        typedef std::chrono::duration<double, std::milli> Milliseconds;
+        return std::chrono::duration_cast<Milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /*
+     * Sets the pattern of the block Jacobian for cameras or points. Every
+     * observation is a block row with a single 2xBC block in the block
+     * column of its camera or point. Without an ID, all blocks are in a
+     * single block column, e.g. for shared intrinsics.
+     */
+    template <typename T, int BC>
+    void
+    set_jacobian_pattern (std::vector<Observation> const& observations,
+        int Observation::* id, std::size_t num_blocks,
+        BlockSparseMatrix<T, 2, BC>* jacobian)
+    {
+        std::vector<std::size_t> outer(observations.size() + 1);
+        std::vector<std::size_t> inner(observations.size());
+        for (std::size_t i = 0; i < observations.size(); ++i)
+        {
+            outer[i] = i;
+            inner[i] = id == nullptr ? 0 : observations[i].*id;
+        }
+        outer[observations.size()] = observations.size();
+
+        jacobian->allocate(observations.size(), num_blocks);
+        jacobian->set_pattern(outer, inner);
+    }
+
+    typedef void (*ProjectionKernel) (Camera const& cam,
+        std::vector<Point3D> const& points,
+        std::vector<Observation> const& observations,
+        std::size_t const* ids, std::size_t begin, std::size_t end,
+        double* residuals);
+
+    /*
+     * Computes the reprojection errors of the observations ids[begin, end)
+     * of a single camera with the projection and the radial distortion.
+     */
+    void
+    project_observations_scalar (Camera const& cam,
+        std::vector<Point3D> const& points,
+        std::vector<Observation> const& observations,
+        std::size_t const* ids, std::size_t begin, std::size_t end,
+        double* residuals)
+    {
+        double const* rot = cam.rotation;
+        double const* trans = cam.translation;
+        double const* dist = cam.distortion;
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            Observation const& obs = observations[ids[i]];
+            double const* point = points[obs.point_id].pos;
+            double const x = rot[0] * point[0] + rot[1] * point[1]
+                + rot[2] * point[2];
+            double const y = rot[3] * point[0] + rot[4] * point[1]
+                + rot[5] * point[2];
+            double const z = rot[6] * point[0] + rot[7] * point[1]
+                + rot[8] * point[2] + trans[2];
+            double ix = (x + trans[0]) / z;
+            double iy = (y + trans[1]) / z;
+            double const radius2 = ix * ix + iy * iy;
+            double const factor = 1.0 + radius2 * (dist[0] + dist[1] * radius2);
+            ix *= factor;
+            iy *= factor;
+            residuals[ids[i] * 2 + 0] = ix * cam.focal_length - obs.pos[0];
+            residuals[ids[i] * 2 + 1] = iy * cam.focal_length - obs.pos[1];
+        }
+    }
+
+#if BA_X86_DISPATCH
+    /*
+     * Four observations per instruction with the camera parameters in
+     * registers. Multiplications and additions are not fused, which keeps
+     * the results identical to the scalar code.
+     */
+    __attribute__((target("avx2"))) void
+    project_observations_avx2 (Camera const& cam,
+        std::vector<Point3D> const& points,
+        std::vector<Observation> const& observations,
+        std::size_t const* ids, std::size_t begin, std::size_t end,
+        double* residuals)
+    {
+        __m256d rot[9];
+        for (int i = 0; i < 9; ++i)
+            rot[i] = _mm256_set1_pd(cam.rotation[i]);
+        __m256d const t0 = _mm256_set1_pd(cam.translation[0]);
+        __m256d const t1 = _mm256_set1_pd(cam.translation[1]);
+        __m256d const t2 = _mm256_set1_pd(cam.translation[2]);
+        __m256d const k0 = _mm256_set1_pd(cam.distortion[0]);
+        __m256d const k1 = _mm256_set1_pd(cam.distortion[1]);
+        __m256d const flen = _mm256_set1_pd(cam.focal_length);
+        __m256d const one = _mm256_set1_pd(1.0);
+
+        std::size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            Observation const* obs[4];
+            double const* pos[4];
+            for (int j = 0; j < 4; ++j)
+            {
+                obs[j] = &observations[ids[i + j]];
+                pos[j] = points[obs[j]->point_id].pos;
+            }
+            __m256d const px = _mm256_set_pd(pos[3][0], pos[2][0],
+                pos[1][0], pos[0][0]);
+            __m256d const py = _mm256_set_pd(pos[3][1], pos[2][1],
+                pos[1][1], pos[0][1]);
+            __m256d const pz = _mm256_set_pd(pos[3][2], pos[2][2],
+                pos[1][2], pos[0][2]);
+
+            __m256d const x = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                rot[0], px), _mm256_mul_pd(rot[1], py)),
+                _mm256_mul_pd(rot[2], pz));
+            __m256d const y = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                rot[3], px), _mm256_mul_pd(rot[4], py)),
+                _mm256_mul_pd(rot[5], pz));
+            __m256d const z = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(rot[6], px), _mm256_mul_pd(rot[7], py)),
+                _mm256_mul_pd(rot[8], pz)), t2);
+            __m256d ix = _mm256_div_pd(_mm256_add_pd(x, t0), z);
+            __m256d iy = _mm256_div_pd(_mm256_add_pd(y, t1), z);
+            __m256d const radius2 = _mm256_add_pd(_mm256_mul_pd(ix, ix),
+                _mm256_mul_pd(iy, iy));
+            __m256d const factor = _mm256_add_pd(one, _mm256_mul_pd(radius2,
+                _mm256_add_pd(k0, _mm256_mul_pd(k1, radius2))));
+            ix = _mm256_mul_pd(ix, factor);
+            iy = _mm256_mul_pd(iy, factor);
+
+            __m256d const ox = _mm256_set_pd(obs[3]->pos[0], obs[2]->pos[0],
+                obs[1]->pos[0], obs[0]->pos[0]);
+            __m256d const oy = _mm256_set_pd(obs[3]->pos[1], obs[2]->pos[1],
+                obs[1]->pos[1], obs[0]->pos[1]);
+            double ex[4], ey[4];
+            _mm256_storeu_pd(ex, _mm256_sub_pd(_mm256_mul_pd(ix, flen), ox));
+            _mm256_storeu_pd(ey, _mm256_sub_pd(_mm256_mul_pd(iy, flen), oy));
+            for (int j = 0; j < 4; ++j)
+            {
+                residuals[ids[i + j] * 2 + 0] = ex[j];
+                residuals[ids[i + j] * 2 + 1] = ey[j];
+            }
+        }
+        project_observations_scalar(cam, points, observations, ids,
+            i, end, residuals);
+    }
+#endif
+
+    ProjectionKernel
+    select_projection_kernel (void)
+    {
+#if BA_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return project_observations_avx2;
+#endif
+        return project_observations_scalar;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
 BundleAdjustment::Status
 BundleAdjustment::optimize (void)
 {
+    UTIL_PROFILE_SCOPE("BundleAdjustment::optimize");
     util::WallTimer timer;
     this->sanity_checks();
     this->status = Status();
-    this->lm_optimize();
+    if (this->opts.local_window_size > 0
+        && this->opts.local_window_size < this->cameras->size())
+        this->local_optimize();
+    else
+        this->dispatch_optimize();
     this->status.runtime_ms = timer.get_elapsed();
+
+    /* Verbose output is asynchronous, write it before the caller's. */
+    if (this->opts.verbose_output)
+        util::AsyncLogger::get_global().flush();
     return this->status;
 }
 
+std::vector<BundleAdjustment::Status>
+BundleAdjustment::optimize_batch (Options const& options,
+    std::vector<Problem> const& problems)
+{
+    /* The problems keep the cancellation token, progress is per problem. */
+    Options problem_opts = options;
+    problem_opts.control = util::StageControl(options.control.cancel_token);
+
+    std::int64_t const num_problems = problems.size();
+    std::vector<Status> statuses(num_problems);
+    std::atomic<std::size_t> num_done(0);
+    std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (std::int64_t i = 0; i < num_problems; ++i)
+    {
+        if (options.control.is_cancelled())
+        {
+            statuses[i].cancelled = true;
+            continue;
+        }
+
+        try
+        {
+            BundleAdjustment ba(problem_opts);
+            ba.set_cameras(problems[i].cameras);
+            ba.set_points(problems[i].points);
+            ba.set_observations(problems[i].observations);
+            statuses[i] = ba.optimize();
+        }
+        catch (...)
+        {
+#pragma omp critical(ba_optimize_batch)
+            if (!error)
+                error = std::current_exception();
+        }
+        options.control.report(num_done += 1, num_problems);
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+    return statuses;
+}
+
+void
+BundleAdjustment::dispatch_optimize (void)
+{
+    if (this->opts.single_precision && this->num_cam_params == 6)
+        this->lm_optimize<float, 6>();
+    else if (this->opts.single_precision)
+        this->lm_optimize<float, 9>();
+    else if (this->num_cam_params == 6)
+        this->lm_optimize<double, 6>();
+    else
+        this->lm_optimize<double, 9>();
+}
+
+/*
+ * Optimizes the local problem of the window cameras. The problem is built
+ * from copies with new IDs, cameras outside the window are marked constant,
+ * and the optimized window cameras and points are copied back.
+ */
+void
+BundleAdjustment::local_optimize (void)
+{
+    std::vector<Camera>* all_cameras = this->cameras;
+    std::vector<Point3D>* all_points = this->points;
+    std::vector<Observation>* all_observations = this->observations;
+    std::size_t const first_camera = all_cameras->size()
+        - this->opts.local_window_size;
+
+    /* Select the points observed by the window cameras. */
+    std::vector<int> point_map(all_points->size(), -1);
+    std::vector<std::size_t> point_ids;
+    for (std::size_t i = 0; i < all_observations->size(); ++i)
+    {
+        Observation const& obs = all_observations->at(i);
+        if (static_cast<std::size_t>(obs.camera_id) < first_camera
+            || point_map[obs.point_id] >= 0)
+            continue;
+        point_map[obs.point_id] = static_cast<int>(point_ids.size());
+        point_ids.push_back(obs.point_id);
+    }
+
+    /* Select all observations and cameras of these points. */
+    std::vector<int> camera_map(all_cameras->size(), -1);
+    std::vector<std::size_t> camera_ids;
+    std::vector<Observation> local_observations;
+    for (std::size_t i = 0; i < all_observations->size(); ++i)
+    {
+        Observation obs = all_observations->at(i);
+        if (point_map[obs.point_id] < 0)
+            continue;
+        if (camera_map[obs.camera_id] < 0)
+        {
+            camera_map[obs.camera_id] = static_cast<int>(camera_ids.size());
+            camera_ids.push_back(obs.camera_id);
+        }
+        obs.camera_id = camera_map[obs.camera_id];
+        obs.point_id = point_map[obs.point_id];
+        local_observations.push_back(obs);
+    }
+
+    std::vector<Camera> local_cameras(camera_ids.size());
+    for (std::size_t i = 0; i < camera_ids.size(); ++i)
+    {
+        local_cameras[i] = all_cameras->at(camera_ids[i]);
+        if (camera_ids[i] < first_camera)
+            local_cameras[i].is_constant = true;
+    }
+    std::vector<Point3D> local_points(point_ids.size());
+    for (std::size_t i = 0; i < point_ids.size(); ++i)
+        local_points[i] = all_points->at(point_ids[i]);
+
+    LOG_V << "BA: Local problem with " << local_cameras.size()
+        << " cameras (" << (local_cameras.size()
+        - this->opts.local_window_size) << " constant), "
+        << local_points.size() << " points, "
+        << local_observations.size() << " observations." << std::endl;
+
+    this->cameras = &local_cameras;
+    this->points = &local_points;
+    this->observations = &local_observations;
+    if (!local_observations.empty())
+        this->dispatch_optimize();
+    this->cameras = all_cameras;
+    this->points = all_points;
+    this->observations = all_observations;
+
+    /* Copy back the window cameras and their points. */
+    for (std::size_t i = 0; i < camera_ids.size(); ++i)
+    {
+        if (camera_ids[i] < first_camera)
+            continue;
+        bool const is_constant = all_cameras->at(camera_ids[i]).is_constant;
+        all_cameras->at(camera_ids[i]) = local_cameras[i];
+        all_cameras->at(camera_ids[i]).is_constant = is_constant;
+    }
+    for (std::size_t i = 0; i < point_ids.size(); ++i)
+        all_points->at(point_ids[i]) = local_points[i];
+}
+
 void
 BundleAdjustment::sanity_checks (void)
 {
@@ -69,6 +396,7 @@ BundleAdjustment::sanity_checks (void)
     }
 }
 
+template <typename T, int N>
 void
 BundleAdjustment::lm_optimize (void)
 {
@@ -77,46 +405,64 @@ BundleAdjustment::lm_optimize (void)
     pcg_opts = this->opts.linear_opts;
     pcg_opts.trust_region_radius = TRUST_REGION_RADIUS_INIT;
 
-    /* Compute reprojection error for the first time. */
-    DenseVectorType F, F_new;
+    /*
+     * Compute reprojection error for the first time. The residuals and the
+     * update are allocated once and reused in all iterations.
+     */
+    this->group_observations();
+    DenseVectorType F, F_new, delta_x;
     this->compute_reprojection_errors(&F);// todo F 是误差向量
     double current_mse = this->compute_mse(F);
     this->status.initial_mse = current_mse;
     this->status.final_mse = current_mse;
 
+    /* The sparsity pattern of the Jacobian is the same for all iterations. */
+    BlockSparseMatrix<T, 2, N> Jc;
+    BlockSparseMatrix<T, 2, 3> Ji;
+    BlockSparseMatrix<T, 2, 3> Jp;
+    BlockSparseMatrix<T, 2, N>* jac_cam
+        = (this->opts.bundle_mode & BA_CAMERAS) ? &Jc : nullptr;
+    BlockSparseMatrix<T, 2, 3>* jac_intrinsics
+        = (this->opts.bundle_mode & BA_CAMERAS)
+        && this->opts.shared_intrinsics ? &Ji : nullptr;
+    BlockSparseMatrix<T, 2, 3>* jac_points
+        = (this->opts.bundle_mode & BA_POINTS) ? &Jp : nullptr;
+    this->setup_jacobian(jac_cam, jac_intrinsics, jac_points);
+
+    /* The solver keeps the patterns of its products across iterations. */
+    LinearSolver pcg(pcg_opts);
+
     /* Levenberg-Marquard main loop. */
     for (int lm_iter = 0; ; ++lm_iter)
     {
+        UTIL_PROFILE_SCOPE("BundleAdjustment::lm_iteration");
         if (lm_iter + 1 > this->opts.lm_min_iterations
             && (current_mse < this->opts.lm_mse_threshold))
         {
             LOG_V << "BA: Satisfied MSE threshold." << std::endl;
             break;
         }
-
-        /* Compute Jacobian. */ // todo 计算雅各比矩阵
-        SparseMatrixType Jc, Jp;
-        switch (this->opts.bundle_mode)
+        if (this->opts.control.is_cancelled())
         {
-            case BA_CAMERAS_AND_POINTS:
-                this->analytic_jacobian(&Jc, &Jp);
-                break;
-            case BA_CAMERAS:
-                this->analytic_jacobian(&Jc, nullptr);
-                break;
-            case BA_POINTS:
-                this->analytic_jacobian(nullptr, &Jp);
-                break;
-            default:
-                throw std::runtime_error("Invalid bundle mode");
+            LOG_V << "BA: Cancelled after " << lm_iter << " iterations."
+                << std::endl;
+            this->status.cancelled = true;
+            break;
         }
 
+        /* Compute Jacobian. */ // todo 计算雅各比矩阵
+        double const jacobian_start_time = get_timestamp();
+        this->analytic_jacobian(jac_cam, jac_intrinsics, jac_points);
+        this->status.jacobian_time += get_timestamp() - jacobian_start_time;
+
         /* Perform linear step. */ // todo 计算更新量
-        DenseVectorType delta_x;
-        LinearSolver pcg(pcg_opts);
-        LinearSolver::Status cg_status = pcg.solve(Jc, Jp, F, &delta_x);
+        pcg.set_trust_region_radius(pcg_opts.trust_region_radius);
+        LinearSolver::Status cg_status = pcg.solve(Jc, Ji, Jp, F, &delta_x);
+        this->status.schur_time += cg_status.schur_time;
+        this->status.solve_time += cg_status.solve_time;
 
         /* Update reprojection errors and MSE after linear step. */
+        double const update_start_time = get_timestamp();
         double new_mse, delta_mse, delta_mse_ratio = 1.0;
         if (cg_status.success)
         {
@@ -150,7 +496,8 @@ BundleAdjustment::lm_optimize (void)
             this->status.num_lm_iterations += 1;
             this->status.num_lm_successful_iterations += 1;
 
-            this->update_parameters(delta_x);//todo 更新参数
+            this->update_parameters();//todo 更新参数
+            pcg.set_rejected_step(false);
 
             std::swap(F, F_new);
             current_mse = new_mse;
@@ -176,7 +523,10 @@ BundleAdjustment::lm_optimize (void)
             this->status.num_lm_iterations += 1;
             this->status.num_lm_unsuccessful_iterations += 1;
             pcg_opts.trust_region_radius *= TRUST_REGION_RADIUS_DECREMENT;
+            pcg.set_rejected_step(true);
         }
+        this->status.update_time += get_timestamp() - update_start_time;
+        this->opts.control.report(lm_iter + 1, this->opts.lm_max_iterations);
 
         /* Check termination due to LM iterations. */
         if (lm_iter + 1 < this->opts.lm_min_iterations)
@@ -203,6 +553,29 @@ BundleAdjustment::lm_optimize (void)
     this->status.final_mse = current_mse;
 }
 
+/*
+ * Groups the observations by camera. The reprojection errors are computed
+ * per camera, which keeps the camera parameters in registers.
+ */
+void
+BundleAdjustment::group_observations (void)
+{
+    std::size_t const num_cameras = this->cameras->size();
+    std::size_t const num_observations = this->observations->size();
+    this->camera_outer.assign(num_cameras + 1, 0);
+    for (std::size_t i = 0; i < num_observations; ++i)
+        this->camera_outer[this->observations->at(i).camera_id + 1] += 1;
+    for (std::size_t i = 0; i < num_cameras; ++i)
+        this->camera_outer[i + 1] += this->camera_outer[i];
+
+    std::vector<std::size_t> camera_pos(this->camera_outer.begin(),
+        this->camera_outer.end() - 1);
+    this->camera_observations.resize(num_observations);
+    for (std::size_t i = 0; i < num_observations; ++i)
+        this->camera_observations
+            [camera_pos[this->observations->at(i).camera_id]++] = i;
+}
+
 void
 BundleAdjustment::compute_reprojection_errors (DenseVectorType* vector_f,
     DenseVectorType const* delta_x)
@@ -210,62 +583,62 @@ BundleAdjustment::compute_reprojection_errors (DenseVectorType* vector_f,
     if (vector_f->size() != this->observations->size() * 2)
         vector_f->resize(this->observations->size() * 2);
 
-#pragma omp parallel for
-    for (std::size_t i = 0; i < this->observations->size(); ++i)
+    /*
+     * The updated cameras and points are computed once for the trial step
+     * instead of once per observation, which saves the rotation update and
+     * the rotation product for every observation. They are kept in the
+     * trial buffers, which are reused across iterations and applied by
+     * update_parameters() if the step is accepted.
+     */
+    std::vector<Camera> const* cameras = this->cameras;
+    std::vector<Point3D> const* points = this->points;
+    std::vector<Camera>& new_cameras = this->trial_cameras;
+    std::vector<Point3D>& new_points = this->trial_points;
+    std::size_t points_offset = 0;
+    bool const parallel
+        = internal::parallel_observations(this->observations->size());
+    if (delta_x != nullptr && (this->opts.bundle_mode & BA_CAMERAS))
     {
-        Observation const& obs = this->observations->at(i);
-        Point3D const& p3d = this->points->at(obs.point_id);
-        Camera const& cam = this->cameras->at(obs.camera_id);
-
-        double const* flen = &cam.focal_length;
-        double const* dist = cam.distortion;
-        double const* rot = cam.rotation;
-        double const* trans = cam.translation;
-        double const* point = p3d.pos;
-
-        Point3D new_point;
-        Camera new_camera;
-        if (delta_x != nullptr)
-        {
-            std::size_t cam_id = obs.camera_id * this->num_cam_params;
-            std::size_t pt_id = obs.point_id * 3;
-
-            if (this->opts.bundle_mode & BA_CAMERAS)
-            {
-                this->update_camera(cam, delta_x->data() + cam_id, &new_camera);
-                flen = &new_camera.focal_length;
-                dist = new_camera.distortion;
-                rot = new_camera.rotation;
-                trans = new_camera.translation;
-                pt_id += this->cameras->size() * this->num_cam_params;
-            }
-
-            if (this->opts.bundle_mode & BA_POINTS)
-            {
-                this->update_point(p3d, delta_x->data() + pt_id, &new_point);
-                point = new_point.pos;
-            }
-        }
-
-        /* Project point onto image plane. */
-        double rp[] = { 0.0, 0.0, 0.0 };
-        for (int d = 0; d < 3; ++d)
+        /* Shared intrinsics follow the cameras, i.e. precede the points. */
+        new_cameras.resize(this->cameras->size());
+        points_offset = new_cameras.size() * this->num_cam_params;
+        double const* shared_update = delta_x->data() + points_offset;
+        if (this->opts.shared_intrinsics)
+            points_offset += 3;
+#pragma omp parallel for if (parallel)
+        for (std::int64_t i = 0;
+            i < static_cast<std::int64_t>(new_cameras.size()); ++i)
         {
-            rp[0] += rot[0 + d] * point[d];
-            rp[1] += rot[3 + d] * point[d];
-            rp[2] += rot[6 + d] * point[d];
+            Camera const& cam = this->cameras->at(i);
+            double const* update = delta_x->data() + i * this->num_cam_params;
+            double const* intrinsics_update = update;
+            if (this->opts.fixed_intrinsics)
+                intrinsics_update = nullptr;
+            else if (this->opts.shared_intrinsics)
+                intrinsics_update = cam.is_constant ? nullptr : shared_update;
+            this->update_camera(cam, update, intrinsics_update,
+                &new_cameras[i]);
         }
-        rp[2] = (rp[2] + trans[2]);
-        rp[0] = (rp[0] + trans[0]) / rp[2];
-        rp[1] = (rp[1] + trans[1]) / rp[2];
-
-        /* Distort reprojections. */
-        this->radial_distort(rp + 0, rp + 1, dist);
-
-        /* Compute reprojection error. */
-        vector_f->at(i * 2 + 0) = rp[0] * (*flen) - obs.pos[0];
-        vector_f->at(i * 2 + 1) = rp[1] * (*flen) - obs.pos[1];
+        cameras = &new_cameras;
     }
+    if (delta_x != nullptr && (this->opts.bundle_mode & BA_POINTS))
+    {
+        new_points.resize(this->points->size());
+#pragma omp parallel for if (parallel)
+        for (std::int64_t i = 0;
+            i < static_cast<std::int64_t>(new_points.size()); ++i)
+            this->update_point(this->points->at(i),
+                delta_x->data() + points_offset + i * 3, &new_points[i]);
+        points = &new_points;
+    }
+
+    static ProjectionKernel const kernel = select_projection_kernel();
+    std::int64_t const num_cameras = cameras->size();
+#pragma omp parallel for schedule(dynamic, 16) if (parallel)
+    for (std::int64_t i = 0; i < num_cameras; ++i)
+        kernel(cameras->at(i), *points, *this->observations,
+            this->camera_observations.data(), this->camera_outer[i],
+            this->camera_outer[i + 1], vector_f->data());
 }
 
 double
@@ -306,22 +679,49 @@ BundleAdjustment::rodrigues_to_matrix (double const* r, double* m)
     m[8] = 1.0 - (r[0] * r[0] + r[1] * r[1]) * ct;
 }
 
+template <typename T, int N>
 void
-BundleAdjustment::analytic_jacobian (SparseMatrixType* jac_cam,
-    SparseMatrixType* jac_points)
+BundleAdjustment::setup_jacobian (BlockSparseMatrix<T, 2, N>* jac_cam,
+    BlockSparseMatrix<T, 2, 3>* jac_intrinsics,
+    BlockSparseMatrix<T, 2, 3>* jac_points)
 {
-    std::size_t const camera_cols = this->cameras->size() * this->num_cam_params;
-    std::size_t const point_cols = this->points->size() * 3;
-    std::size_t const jacobi_rows = this->observations->size() * 2;
+    switch (this->opts.bundle_mode)
+    {
+        case BA_CAMERAS_AND_POINTS:
+        case BA_CAMERAS:
+        case BA_POINTS:
+            break;
+        default:
+            throw std::runtime_error("Invalid bundle mode");
+    }
 
-    SparseMatrixType::Triplets cam_triplets, point_triplets;
     if (jac_cam != nullptr)
-        cam_triplets.resize(this->observations->size() * 2
-            * this->num_cam_params);
+        set_jacobian_pattern(*this->observations, &Observation::camera_id,
+            this->cameras->size(), jac_cam);
+    if (jac_intrinsics != nullptr)
+        set_jacobian_pattern(*this->observations,
+            static_cast<int Observation::*>(nullptr), 1, jac_intrinsics);
     if (jac_points != nullptr)
-        point_triplets.resize(this->observations->size() * 3 * 2);
+        set_jacobian_pattern(*this->observations, &Observation::point_id,
+            this->points->size(), jac_points);
+}
 
-#pragma omp parallel
+/*
+ * Computes the Jacobian values in-place, the Jacobians must have the
+ * pattern from setup_jacobian(). Every observation writes its own blocks,
+ * which are computed in parallel. With shared intrinsics, the camera
+ * blocks are the extrinsics and the intrinsics have their own blocks.
+ */
+template <typename T, int N>
+void
+BundleAdjustment::analytic_jacobian (BlockSparseMatrix<T, 2, N>* jac_cam,
+    BlockSparseMatrix<T, 2, 3>* jac_intrinsics,
+    BlockSparseMatrix<T, 2, 3>* jac_points)
+{
+    int const cam_offset = this->opts.shared_intrinsics ? 3 : 0;
+    UTIL_PROFILE_SCOPE("BundleAdjustment::analytic_jacobian");
+#pragma omp parallel \
+    if (internal::parallel_observations(this->observations->size()))
     {
         double cam_x_ptr[9], cam_y_ptr[9], point_x_ptr[3], point_y_ptr[3];
 #pragma omp for
@@ -338,42 +738,31 @@ BundleAdjustment::analytic_jacobian (SparseMatrixType* jac_cam,
                 std::fill(point_x_ptr, point_x_ptr + 3, 0.0);
                 std::fill(point_y_ptr, point_y_ptr + 3, 0.0);
             }
-
-            std::size_t row_x = i * 2, row_y = row_x + 1;
-            std::size_t cam_col = obs.camera_id * this->num_cam_params;
-            std::size_t point_col = obs.point_id * 3;
-            std::size_t cam_offset = i * this->num_cam_params * 2;
-            for (int j = 0; jac_cam != nullptr && j < this->num_cam_params; ++j)
+            if (cam.is_constant)
             {
-                cam_triplets[cam_offset + j * 2 + 0] =
-                    SparseMatrixType::Triplet(row_x, cam_col + j, cam_x_ptr[j]);
-                cam_triplets[cam_offset + j * 2 + 1] =
-                    SparseMatrixType::Triplet(row_y, cam_col + j, cam_y_ptr[j]);
+                std::fill(cam_x_ptr, cam_x_ptr + 9, 0.0);
+                std::fill(cam_y_ptr, cam_y_ptr + 9, 0.0);
             }
-            std::size_t point_offset = i * 3 * 2;
-            for (int j = 0; jac_points != nullptr && j < 3; ++j)
-            {
-                point_triplets[point_offset + j * 2 + 0] =
-                    SparseMatrixType::Triplet(row_x, point_col + j, point_x_ptr[j]);
-                point_triplets[point_offset + j * 2 + 1] =
-                    SparseMatrixType::Triplet(row_y, point_col + j, point_y_ptr[j]);
-            }
-        }
 
-#pragma omp sections
-        {
-#pragma omp section
             if (jac_cam != nullptr)
             {
-                jac_cam->allocate(jacobi_rows, camera_cols);
-                jac_cam->set_from_triplets(cam_triplets);
+                T* block = jac_cam->block(i);
+                std::copy(cam_x_ptr + cam_offset,
+                    cam_x_ptr + cam_offset + N, block);
+                std::copy(cam_y_ptr + cam_offset,
+                    cam_y_ptr + cam_offset + N, block + N);
+            }
+            if (jac_intrinsics != nullptr)
+            {
+                T* block = jac_intrinsics->block(i);
+                std::copy(cam_x_ptr, cam_x_ptr + 3, block);
+                std::copy(cam_y_ptr, cam_y_ptr + 3, block + 3);
             }
-
-#pragma omp section
             if (jac_points != nullptr)
             {
-                jac_points->allocate(jacobi_rows, point_cols);
-                jac_points->set_from_triplets(point_triplets);
+                T* block = jac_points->block(i);
+                std::copy(point_x_ptr, point_x_ptr + 3, block);
+                std::copy(point_y_ptr, point_y_ptr + 3, block + 3);
             }
         }
     }
@@ -636,35 +1025,32 @@ BundleAdjustment::analytic_jacobian_entries (Camera const& cam,
 #endif
 }
 
+/*
+ * Applies the trial step of the last call to compute_reprojection_errors()
+ * with an update. The trial cameras and points already hold the updated
+ * parameters, which are copied instead of computed again.
+ */
 void
-BundleAdjustment::update_parameters (DenseVectorType const& delta_x)
+BundleAdjustment::update_parameters (void)
 {
-    /* Update cameras. */
-    std::size_t total_camera_params = 0;
     if (this->opts.bundle_mode & BA_CAMERAS)
-    {
-        for (std::size_t i = 0; i < this->cameras->size(); ++i)
-            this->update_camera(this->cameras->at(i),
-                delta_x.data() + this->num_cam_params * i,
-                &this->cameras->at(i));
-        total_camera_params = this->cameras->size() * this->num_cam_params;
-    }
-
-    /* Update points. */
+        std::copy(this->trial_cameras.begin(), this->trial_cameras.end(),
+            this->cameras->begin());
     if (this->opts.bundle_mode & BA_POINTS)
-    {
-        for (std::size_t i = 0; i < this->points->size(); ++i)
-            this->update_point(this->points->at(i),
-                delta_x.data() + total_camera_params + i * 3,
-                &this->points->at(i));
-    }
+        std::copy(this->trial_points.begin(), this->trial_points.end(),
+            this->points->begin());
 }
 
+/*
+ * Updates the camera with the extrinsics of the camera update. The
+ * intrinsics update is part of the camera update, shared by all cameras,
+ * or null to keep the intrinsics.
+ */
 void
-BundleAdjustment::update_camera (Camera const& cam,
-    double const* update, Camera* out)
+BundleAdjustment::update_camera (Camera const& cam, double const* update,
+    double const* intrinsics_update, Camera* out)
 {
-    if (opts.fixed_intrinsics)
+    if (intrinsics_update == nullptr)
     {
         out->focal_length = cam.focal_length;
         out->distortion[0] = cam.distortion[0];
@@ -672,12 +1058,12 @@ BundleAdjustment::update_camera (Camera const& cam,
     }
     else
     {
-        out->focal_length = cam.focal_length + update[0];
-        out->distortion[0] = cam.distortion[0] + update[1];
-        out->distortion[1] = cam.distortion[1] + update[2];
+        out->focal_length = cam.focal_length + intrinsics_update[0];
+        out->distortion[0] = cam.distortion[0] + intrinsics_update[1];
+        out->distortion[1] = cam.distortion[1] + intrinsics_update[2];
     }
 
-    int const offset = this->opts.fixed_intrinsics ? 0 : 3;
+    int const offset = this->num_cam_params == 9 ? 3 : 0;
     out->translation[0] = cam.translation[0] + update[0 + offset];
     out->translation[1] = cam.translation[1] + update[1 + offset];
     out->translation[2] = cam.translation[2] + update[2 + offset];
@@ -687,6 +1073,7 @@ BundleAdjustment::update_camera (Camera const& cam,
     double rot_update[9];
     this->rodrigues_to_matrix(update + 3 + offset, rot_update);
     math::matrix_multiply(rot_update, 3, 3, rot_orig, 3, out->rotation);
+    out->is_constant = cam.is_constant;
 }
 
 void
@@ -696,6 +1083,7 @@ BundleAdjustment::update_point (Point3D const& pt,
     out->pos[0] = pt.pos[0] + update[0];
     out->pos[1] = pt.pos[1] + update[1];
     out->pos[2] = pt.pos[2] + update[2];
+    out->is_constant = pt.is_constant;
 }
 
 void
@@ -12,9 +12,11 @@
 
 #include <vector>
 
+#include "util/async_logger.h"
 #include "util/logging.h"
+#include "util/progress.h"
 #include "sfm/defines.h"
-#include "sfm/ba_sparse_matrix.h"
+#include "sfm/ba_block_sparse_matrix.h"
 #include "sfm/ba_dense_vector.h"
 #include "sfm/ba_linear_solver.h"
 #include "sfm/ba_types.h"
@@ -25,16 +27,13 @@
  * - PBA normalizes focal length and depth values before LM optimization,
  *   and denormalizes afterwards. Is this necessary with double?
  * - PBA exits the LM main loop if norm of -JF is small. Useful?
- * - The slowest part is computing the Schur complement because of matrix
- *   multiplications. How can this be improved?
+ * - The Jacobians and the Schur complement are block sparse matrices with
+ *   blocks per observation and camera pair, which avoids sparse products.
  *
  * Actual TODOs.
  *
- * - Better preconditioner for conjugate gradient, i.e., use the 9x9 diagonal
- *   blocks of S instead of B. Requires method in matrix.
  * - Properly implement and test BA_POINTS mode.
  * - More accurate implementations for the Jacobian (currently approximated).
- * - Implement block_size = 9 in linear solver, no need for CG
  */
 
 SFM_NAMESPACE_BEGIN
@@ -62,16 +61,51 @@ public:
     {
         Options (void);
 
+        /** Prints progress, asynchronously through util::AsyncLogger. */
         bool verbose_output;
         BAMode bundle_mode;
         bool fixed_intrinsics; // 固定内参数，不进行优化
-        //bool shared_intrinsics;
+        /**
+         * Optimizes one set of intrinsics for all cameras, e.g. if all
+         * images are taken with the same camera. The focal length and the
+         * distortion of every camera receive the same update, and constant
+         * cameras keep their intrinsics. The camera blocks are reduced to
+         * the extrinsics, and a single intrinsics block couples all
+         * cameras in the linear system. Ignored with fixed_intrinsics.
+         * Defaults to false.
+         */
+        bool shared_intrinsics;
         int lm_max_iterations;
         int lm_min_iterations;
 
         double lm_delta_threshold;
         double lm_mse_threshold;
+        /**
+         * Stores the Jacobians and solves the linear systems in single
+         * precision, which halves the memory and bandwidth of the solver.
+         * Residuals, parameter updates and the LM acceptance test remain in
+         * double precision. Defaults to false.
+         */
+        bool single_precision;
+        /**
+         * Local bundle adjustment for incremental reconstruction. Only the
+         * last local_window_size cameras, i.e. the most recently added ones,
+         * and the points observed by them are optimized. Other cameras
+         * observing these points are held constant, and all remaining
+         * cameras, points and observations are left out of the problem.
+         * The MSE in the status is the one of the local problem. Defaults
+         * to 0, which optimizes all cameras and points.
+         */
+        std::size_t local_window_size;
         LinearSolver::Options linear_opts;
+        /**
+         * Cancellation is checked before every LM iteration. A cancelled
+         * optimization returns with the parameters of the last successful
+         * iteration, and optimize() can be called again to resume. Progress
+         * is reported after every iteration with the maximum iterations as
+         * total.
+         */
+        util::StageControl control;
     };
 
     struct Status
@@ -85,6 +119,25 @@ public:
         int num_lm_unsuccessful_iterations;
         int num_cg_iterations;
         std::size_t runtime_ms;
+        /**
+         * Times in milliseconds summed over all LM iterations for the
+         * Jacobians, the Schur complement, the linear solve (CG or dense
+         * Cholesky), and the evaluation and update of the parameters.
+         */
+        double jacobian_time;
+        double schur_time;
+        double solve_time;
+        double update_time;
+        /** True if the optimization stopped due to cancellation. */
+        bool cancelled;
+    };
+
+    /** The cameras, points and observations of a problem in a batch. */
+    struct Problem
+    {
+        std::vector<Camera>* cameras;
+        std::vector<Point3D>* points;
+        std::vector<Observation>* observations;
     };
 
 public:
@@ -95,17 +148,33 @@ public:
     void set_observations (std::vector<Observation>* observations);
 
     Status optimize (void);
+
+    /**
+     * Optimizes many small, independent problems with the options, e.g.
+     * for local or two-view refinement. The problems are optimized
+     * concurrently with one problem per thread, and every problem is
+     * computed by its thread only. Small reduced camera systems are solved
+     * densely, see LinearSolver::Options::dense_max_cameras. Cancellation
+     * is checked before every problem, and progress is reported once per
+     * problem. Returns the status of every problem, and rethrows the first
+     * exception after all problems are finished.
+     */
+    static std::vector<Status> optimize_batch (Options const& options,
+        std::vector<Problem> const& problems);
     void print_status (bool detailed = false) const;
 
 private:
-    typedef SparseMatrix<double> SparseMatrixType;
     typedef DenseVector<double> DenseVectorType;
 
 private:
     void sanity_checks (void);
+    void local_optimize (void);
+    void dispatch_optimize (void);
+    template <typename T, int N>
     void lm_optimize (void);
 
     /* Helper functions. */
+    void group_observations (void);
     void compute_reprojection_errors (DenseVectorType* vector_f,
         DenseVectorType const* delta_x = nullptr);
     double compute_mse (DenseVectorType const& vector_f);
@@ -113,15 +182,22 @@ private:
     void rodrigues_to_matrix (double const* r, double* rot);
 
     /* Analytic Jacobian. */
-    void analytic_jacobian (SparseMatrixType* jac_cam,
-        SparseMatrixType* jac_points);
+    template <typename T, int N>
+    void setup_jacobian (BlockSparseMatrix<T, 2, N>* jac_cam,
+        BlockSparseMatrix<T, 2, 3>* jac_intrinsics,
+        BlockSparseMatrix<T, 2, 3>* jac_points);
+    template <typename T, int N>
+    void analytic_jacobian (BlockSparseMatrix<T, 2, N>* jac_cam,
+        BlockSparseMatrix<T, 2, 3>* jac_intrinsics,
+        BlockSparseMatrix<T, 2, 3>* jac_points);
     void analytic_jacobian_entries (Camera const& cam, Point3D const& point,
         double* cam_x_ptr, double* cam_y_ptr,
         double* point_x_ptr, double* point_y_ptr);
 
     /* Update of camera/point parameters. */
-    void update_parameters (DenseVectorType const& delta_x);
-    void update_camera (Camera const& cam, double const* update, Camera* out);
+    void update_parameters (void);
+    void update_camera (Camera const& cam, double const* update,
+        double const* intrinsics_update, Camera* out);
     void update_point (Point3D const& pt, double const* update, Point3D* out);
 
 private:
@@ -132,6 +208,12 @@ private:
     std::vector<Point3D>* points;
     std::vector<Observation>* observations;
     int const num_cam_params;
+    /* Observations grouped by camera for the reprojection errors. */
+    std::vector<std::size_t> camera_outer;
+    std::vector<std::size_t> camera_observations;
+    /* Cameras and points of the trial step, reused across iterations. */
+    std::vector<Camera> trial_cameras;
+    std::vector<Point3D> trial_points;
 };
 
 /* ------------------------ Implementation ------------------------ */
@@ -140,10 +222,14 @@ inline
 BundleAdjustment::Options::Options (void)
     : verbose_output(false)
     , bundle_mode(BA_CAMERAS_AND_POINTS)
+    , fixed_intrinsics(false)
+    , shared_intrinsics(false)
     , lm_max_iterations(50)
     , lm_min_iterations(0)
     , lm_delta_threshold(1e-4)
     , lm_mse_threshold(1e-8)
+    , single_precision(false)
+    , local_window_size(0)
 {
 }
 
@@ -155,6 +241,12 @@ BundleAdjustment::Status::Status (void)
     , num_lm_successful_iterations(0)
     , num_lm_unsuccessful_iterations(0)
     , num_cg_iterations(0)
+    , runtime_ms(0)
+    , jacobian_time(0.0)
+    , schur_time(0.0)
+    , solve_time(0.0)
+    , update_time(0.0)
+    , cancelled(false)
 {
 }
 
@@ -167,9 +259,14 @@ BundleAdjustment::BundleAdjustment (Options const& options)
     , cameras(nullptr)
     , points(nullptr)
     , observations(nullptr)
-    , num_cam_params(options.fixed_intrinsics ? 6 : 9)
+    , num_cam_params(options.fixed_intrinsics
+        || options.shared_intrinsics ? 6 : 9)
 {
+    if (this->opts.fixed_intrinsics)
+        this->opts.shared_intrinsics = false;
     this->opts.linear_opts.camera_block_dim = this->num_cam_params;
+    if (options.verbose_output)
+        this->log.set_async(&util::AsyncLogger::get_global());
 }
 
 inline void
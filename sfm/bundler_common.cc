@@ -13,15 +13,30 @@
 #include <limits>
 #include <sstream>
 #include <vector>
+#include <cstdint>
 #include <cstring>
 #include <cerrno>
+#include <stdexcept>
 
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "util/binary_io.h"
 #include "util/exception.h"
+#include "core/image_exif.h"
+#include "core/image_io.h"
+#include "sfm/extract_focal_length.h"
 #include "sfm/bundler_common.h"
 
 #define PREBUNDLE_SIGNATURE "MVE_PREBUNDLE\n"
 #define PREBUNDLE_SIGNATURE_LEN 14
 
+#define PREBUNDLE_BINARY_SIGNATURE "MVE_PREBUNDLE_B\n"
+#define PREBUNDLE_BINARY_SIGNATURE_LEN 16
+#define PREBUNDLE_BINARY_VERSION 1
+#define PREBUNDLE_BINARY_ALIGNMENT 64
+
 #define SURVEY_SIGNATURE "MVE_SURVEY\n"
 #define SURVEY_SIGNATURE_LEN 11
 
@@ -53,124 +68,197 @@ Track::remove_view (int view_id)
 
 /* ------------------ Input/Output for Prebundle ------------------ */
 
-void
-save_prebundle_data (ViewportList const& viewports,
-    PairwiseMatching const& matching, std::ostream& out)
+namespace
 {
-    /* Write signature. */
-    out.write(PREBUNDLE_SIGNATURE, PREBUNDLE_SIGNATURE_LEN);
+    /* Header of the binary format, followed by the offset tables. */
+    struct PrebundleHeader
+    {
+        char signature[PREBUNDLE_BINARY_SIGNATURE_LEN];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t num_views;
+        std::uint64_t num_pairs;
+        std::uint64_t views_offset;
+        std::uint64_t pairs_offset;
+        std::uint64_t file_size;
+    };
+
+    /* Entry of the view table with the offsets of the feature arrays. */
+    struct PrebundleView
+    {
+        std::uint64_t positions_offset;
+        std::uint64_t colors_offset;
+        std::uint32_t num_positions;
+        std::uint32_t num_colors;
+    };
+
+    /* Entry of the pair table with the offset of the match array. */
+    struct PrebundlePair
+    {
+        std::int32_t view_1_id;
+        std::int32_t view_2_id;
+        std::uint64_t matches_offset;
+        std::uint64_t num_matches;
+    };
+
+    static_assert(sizeof(PrebundleHeader) == 64, "Invalid header size");
+    static_assert(sizeof(PrebundleView) == 24, "Invalid view entry size");
+    static_assert(sizeof(PrebundlePair) == 24, "Invalid pair entry size");
+    static_assert(sizeof(math::Vec2f) == 2 * sizeof(float),
+        "Positions are not packed");
+    static_assert(sizeof(math::Vec3uc) == 3, "Colors are not packed");
+
+    std::uint64_t
+    align_offset (std::uint64_t offset)
+    {
+        return (offset + PREBUNDLE_BINARY_ALIGNMENT - 1)
+            / PREBUNDLE_BINARY_ALIGNMENT * PREBUNDLE_BINARY_ALIGNMENT;
+    }
 
-    /* Write number of viewports. */
-    int32_t num_viewports = static_cast<int32_t>(viewports.size());
-    out.write(reinterpret_cast<char const*>(&num_viewports), sizeof(int32_t));
+    /* Writes the data at the given offset, padding the gap with zeros. */
+    void
+    write_at_offset (util::BinaryWriter& out, std::uint64_t offset,
+        void const* data, std::size_t size)
+    {
+        char const padding[PREBUNDLE_BINARY_ALIGNMENT] = { 0 };
+        out.write(padding, offset - out.tell());
+        out.write(data, size);
+    }
+}  /* namespace */
 
-    /* Write per-viewport data. */
+void
+save_prebundle_data (ViewportList const& viewports,
+    PairwiseMatching const& matching, util::BinaryWriter& out)
+{
+    /* Compute the layout of the file. */
+    PrebundleHeader header;
+    std::memset(&header, 0, sizeof(PrebundleHeader));
+    std::copy(PREBUNDLE_BINARY_SIGNATURE, PREBUNDLE_BINARY_SIGNATURE
+        + PREBUNDLE_BINARY_SIGNATURE_LEN, header.signature);
+    header.version = PREBUNDLE_BINARY_VERSION;
+    header.num_views = viewports.size();
+    header.num_pairs = matching.size();
+    header.views_offset = align_offset(sizeof(PrebundleHeader));
+    header.pairs_offset = align_offset(header.views_offset
+        + header.num_views * sizeof(PrebundleView));
+    std::uint64_t offset = header.pairs_offset
+        + header.num_pairs * sizeof(PrebundlePair);
+
+    std::vector<PrebundleView> views(viewports.size());
     for (std::size_t i = 0; i < viewports.size(); ++i)
     {
         FeatureSet const& vpf = viewports[i].features;
-
-        /* Write positions. */
-        int32_t num_positions = static_cast<int32_t>(vpf.positions.size());
-        out.write(reinterpret_cast<char const*>(&num_positions), sizeof(int32_t));
-        for (std::size_t j = 0; j < vpf.positions.size(); ++j)
-            out.write(reinterpret_cast<char const*>(&vpf.positions[j]), sizeof(math::Vec2f));
-
-        /* Write colors. */
-        int32_t num_colors = static_cast<int32_t>(vpf.colors.size());
-        out.write(reinterpret_cast<char const*>(&num_colors), sizeof(int32_t));
-        for (std::size_t j = 0; j < vpf.colors.size(); ++j)
-            out.write(reinterpret_cast<char const*>(&vpf.colors[j]), sizeof(math::Vec3uc));
+        if (vpf.positions.size() > std::numeric_limits<std::uint32_t>::max()
+            || vpf.colors.size() > std::numeric_limits<std::uint32_t>::max())
+            throw std::invalid_argument("Too many features in view");
+        PrebundleView& view = views[i];
+        view.num_positions = static_cast<std::uint32_t>(vpf.positions.size());
+        view.num_colors = static_cast<std::uint32_t>(vpf.colors.size());
+        view.positions_offset = align_offset(offset);
+        offset = view.positions_offset
+            + view.num_positions * sizeof(math::Vec2f);
+        view.colors_offset = align_offset(offset);
+        offset = view.colors_offset + view.num_colors * sizeof(math::Vec3uc);
     }
 
-    /* Write number of matching pairs. */
-    int32_t num_pairs = static_cast<int32_t>(matching.size());
-    out.write(reinterpret_cast<char const*>(&num_pairs), sizeof(int32_t));
+    std::vector<PrebundlePair> pairs(matching.size());
+    for (std::size_t i = 0; i < matching.size(); ++i)
+    {
+        PrebundlePair& pair = pairs[i];
+        pair.view_1_id = static_cast<std::int32_t>(matching[i].view_1_id);
+        pair.view_2_id = static_cast<std::int32_t>(matching[i].view_2_id);
+        pair.num_matches = matching[i].matches.size();
+        pair.matches_offset = align_offset(offset);
+        offset = pair.matches_offset
+            + pair.num_matches * 2 * sizeof(std::int32_t);
+    }
+    header.file_size = offset;
+
+    /* Write the header, the tables and the arrays in the order of offsets. */
+    write_at_offset(out, 0, &header, sizeof(PrebundleHeader));
+    write_at_offset(out, header.views_offset, views.data(),
+        views.size() * sizeof(PrebundleView));
+    write_at_offset(out, header.pairs_offset, pairs.data(),
+        pairs.size() * sizeof(PrebundlePair));
+    for (std::size_t i = 0; i < viewports.size(); ++i)
+    {
+        FeatureSet const& vpf = viewports[i].features;
+        write_at_offset(out, views[i].positions_offset,
+            vpf.positions.data(), vpf.positions.size() * sizeof(math::Vec2f));
+        write_at_offset(out, views[i].colors_offset,
+            vpf.colors.data(), vpf.colors.size() * sizeof(math::Vec3uc));
+    }
 
-    /* Write per-matching pair data. */
+    std::vector<std::int32_t> matches;
     for (std::size_t i = 0; i < matching.size(); ++i)
     {
-        TwoViewMatching const& tvr = matching[i];
-        int32_t id1 = static_cast<int32_t>(tvr.view_1_id);
-        int32_t id2 = static_cast<int32_t>(tvr.view_2_id);
-        int32_t num_matches = static_cast<int32_t>(tvr.matches.size());
-        out.write(reinterpret_cast<char const*>(&id1), sizeof(int32_t));
-        out.write(reinterpret_cast<char const*>(&id2), sizeof(int32_t));
-        out.write(reinterpret_cast<char const*>(&num_matches), sizeof(int32_t));
-        for (std::size_t j = 0; j < tvr.matches.size(); ++j)
+        CorrespondenceIndices const& tvm = matching[i].matches;
+        matches.resize(2 * tvm.size());
+        for (std::size_t j = 0; j < tvm.size(); ++j)
         {
-            CorrespondenceIndex const& c = tvr.matches[j];
-            int32_t i1 = static_cast<int32_t>(c.first);
-            int32_t i2 = static_cast<int32_t>(c.second);
-            out.write(reinterpret_cast<char const*>(&i1), sizeof(int32_t));
-            out.write(reinterpret_cast<char const*>(&i2), sizeof(int32_t));
+            matches[2 * j + 0] = static_cast<std::int32_t>(tvm[j].first);
+            matches[2 * j + 1] = static_cast<std::int32_t>(tvm[j].second);
         }
+        write_at_offset(out, pairs[i].matches_offset, matches.data(),
+            matches.size() * sizeof(std::int32_t));
     }
 }
 
 void
-load_prebundle_data (std::istream& in, ViewportList* viewports,
+load_prebundle_data (util::BinaryReader& in, ViewportList* viewports,
     PairwiseMatching* matching)
 {
     /* Read and check file signature. */
-    char signature[PREBUNDLE_SIGNATURE_LEN + 1];
-    in.read(signature, PREBUNDLE_SIGNATURE_LEN);
-    signature[PREBUNDLE_SIGNATURE_LEN] = '\0';
-    if (std::string(PREBUNDLE_SIGNATURE) != signature)
+    char signature[PREBUNDLE_SIGNATURE_LEN];
+    if (in.read(signature, PREBUNDLE_SIGNATURE_LEN) != PREBUNDLE_SIGNATURE_LEN
+        || !std::equal(signature, signature + PREBUNDLE_SIGNATURE_LEN,
+        PREBUNDLE_SIGNATURE))
         throw std::invalid_argument("Invalid prebundle file signature");
 
     viewports->clear();
     matching->clear();
 
     /* Read number of viewports. */
-    int32_t num_viewports;
-    in.read(reinterpret_cast<char*>(&num_viewports), sizeof(int32_t));
+    int32_t const num_viewports = in.read_value<int32_t>();
     viewports->resize(num_viewports);
 
     /* Read per-viewport data. */
-    for (int i = 0; i < num_viewports; ++i)
+    for (int i = 0; i < num_viewports && !in.eof(); ++i)
     {
         FeatureSet& vpf = viewports->at(i).features;
 
         /* Read positions. */
-        int32_t num_positions;
-        in.read(reinterpret_cast<char*>(&num_positions), sizeof(int32_t));
+        int32_t const num_positions = in.read_value<int32_t>();
         vpf.positions.resize(num_positions);
-        for (int j = 0; j < num_positions; ++j)
-            in.read(reinterpret_cast<char*>(&vpf.positions[j]), sizeof(math::Vec2f));
+        in.read_array(vpf.positions.data(), vpf.positions.size());
 
         /* Read colors. */
-        int32_t num_colors;
-        in.read(reinterpret_cast<char*>(&num_colors), sizeof(int32_t));
+        int32_t const num_colors = in.read_value<int32_t>();
         vpf.colors.resize(num_colors);
-        for (int j = 0; j < num_colors; ++j)
-            in.read(reinterpret_cast<char*>(&vpf.colors[j]), sizeof(math::Vec3uc));
+        in.read_array(vpf.colors.data(), vpf.colors.size());
     }
 
     /* Read number of matching pairs. */
-    int32_t num_pairs;
-    in.read(reinterpret_cast<char*>(&num_pairs), sizeof(int32_t));
+    int32_t const num_pairs = in.read_value<int32_t>();
 
     /* Read per-matching pair data. */
-    for (int32_t i = 0; i < num_pairs; ++i)
+    std::vector<int32_t> indices;
+    for (int32_t i = 0; i < num_pairs && !in.eof(); ++i)
     {
-        int32_t id1, id2, num_matches;
-        in.read(reinterpret_cast<char*>(&id1), sizeof(int32_t));
-        in.read(reinterpret_cast<char*>(&id2), sizeof(int32_t));
-        in.read(reinterpret_cast<char*>(&num_matches), sizeof(int32_t));
+        int32_t const id1 = in.read_value<int32_t>();
+        int32_t const id2 = in.read_value<int32_t>();
+        int32_t const num_matches = in.read_value<int32_t>();
+        indices.resize(2 * std::max(num_matches, 0));
+        in.read_array(indices.data(), indices.size());
 
         TwoViewMatching tvr;
         tvr.view_1_id = static_cast<int>(id1);
         tvr.view_2_id = static_cast<int>(id2);
-        tvr.matches.reserve(num_matches);
-        for (int32_t j = 0; j < num_matches; ++j)
+        tvr.matches.resize(indices.size() / 2);
+        for (std::size_t j = 0; j < tvr.matches.size(); ++j)
         {
-            int32_t i1, i2;
-            in.read(reinterpret_cast<char*>(&i1), sizeof(int32_t));
-            in.read(reinterpret_cast<char*>(&i2), sizeof(int32_t));
-            CorrespondenceIndex c;
-            c.first = static_cast<int>(i1);
-            c.second = static_cast<int>(i2);
-            tvr.matches.push_back(c);
+            tvr.matches[j].first = static_cast<int>(indices[2 * j + 0]);
+            tvr.matches[j].second = static_cast<int>(indices[2 * j + 1]);
         }
         matching->push_back(tvr);
     }
@@ -180,9 +268,7 @@ void
 save_prebundle_to_file (ViewportList const& viewports,
     PairwiseMatching const& matching, std::string const& filename)
 {
-    std::ofstream out(filename.c_str(), std::ios::binary);
-    if (!out.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryWriter out(filename);
     save_prebundle_data(viewports, matching, out);
     out.close();
 }
@@ -191,28 +277,315 @@ void
 load_prebundle_from_file (std::string const& filename,
     ViewportList* viewports, PairwiseMatching* matching)
 {
-    std::ifstream in(filename.c_str(), std::ios::binary);
-    if (!in.good())
-        throw util::FileException(filename, std::strerror(errno));
+    util::BinaryReader in(filename);
+
+    /* Files in the binary format are mapped instead of parsed. */
+    char signature[PREBUNDLE_BINARY_SIGNATURE_LEN];
+    if (in.read(signature, PREBUNDLE_BINARY_SIGNATURE_LEN)
+        == PREBUNDLE_BINARY_SIGNATURE_LEN
+        && std::equal(signature, signature + PREBUNDLE_BINARY_SIGNATURE_LEN,
+        PREBUNDLE_BINARY_SIGNATURE))
+    {
+        in.close();
+        PrebundleFile file;
+        file.open(filename);
+        std::int64_t const num_views
+            = static_cast<std::int64_t>(file.get_num_views());
+        std::int64_t const num_pairs
+            = static_cast<std::int64_t>(file.get_num_pairs());
+        viewports->clear();
+        viewports->resize(num_views);
+        matching->clear();
+        matching->resize(num_pairs);
+#pragma omp parallel
+        {
+#pragma omp for schedule(dynamic, 16) nowait
+            for (std::int64_t i = 0; i < num_views; ++i)
+                file.get_viewport(i, &viewports->at(i));
+#pragma omp for schedule(dynamic, 64)
+            for (std::int64_t i = 0; i < num_pairs; ++i)
+                file.get_matching(i, &matching->at(i));
+        }
+        return;
+    }
+    in.seek(0);
+
+    load_prebundle_data(in, viewports, matching);
+    if (in.eof())
+        throw util::Exception("Premature EOF");
+}
 
-    try
+void
+PrebundleFile::open (std::string const& filename)
+{
+    this->close();
+
+    this->mapping.open(filename);
+    this->data = reinterpret_cast<unsigned char const*>(this->mapping.data());
+    this->size = this->mapping.size();
+    if (this->size < sizeof(PrebundleHeader))
     {
-        load_prebundle_data(in, viewports, matching);
+        this->close();
+        throw util::FileException(filename, "Invalid prebundle file");
     }
-    catch (...)
+
+    /* Validate the header and the offset tables, but not the arrays. */
+    bool valid = this->size >= sizeof(PrebundleHeader);
+    PrebundleHeader const* header
+        = reinterpret_cast<PrebundleHeader const*>(this->data);
+    valid = valid && std::equal(header->signature, header->signature
+        + PREBUNDLE_BINARY_SIGNATURE_LEN, PREBUNDLE_BINARY_SIGNATURE);
+    if (valid && header->version != PREBUNDLE_BINARY_VERSION)
     {
-        in.close();
-        throw;
+        this->close();
+        throw util::FileException(filename, "Unsupported prebundle version");
+    }
+    valid = valid && header->file_size == this->size
+        && header->views_offset % PREBUNDLE_BINARY_ALIGNMENT == 0
+        && header->pairs_offset % PREBUNDLE_BINARY_ALIGNMENT == 0
+        && header->num_views <= this->size / sizeof(PrebundleView)
+        && header->num_pairs <= this->size / sizeof(PrebundlePair)
+        && header->views_offset + header->num_views * sizeof(PrebundleView)
+            <= this->size
+        && header->pairs_offset + header->num_pairs * sizeof(PrebundlePair)
+            <= this->size;
+
+    for (std::size_t i = 0; valid && i < header->num_views; ++i)
+    {
+        PrebundleView const& view = reinterpret_cast<PrebundleView const*>
+            (this->data + header->views_offset)[i];
+        valid = view.positions_offset % alignof(math::Vec2f) == 0
+            && view.positions_offset <= this->size
+            && view.num_positions <= (this->size - view.positions_offset)
+                / sizeof(math::Vec2f)
+            && view.colors_offset <= this->size
+            && view.num_colors <= (this->size - view.colors_offset)
+                / sizeof(math::Vec3uc);
+    }
+    for (std::size_t i = 0; valid && i < header->num_pairs; ++i)
+    {
+        PrebundlePair const& pair = reinterpret_cast<PrebundlePair const*>
+            (this->data + header->pairs_offset)[i];
+        valid = pair.matches_offset % alignof(std::int32_t) == 0
+            && pair.matches_offset <= this->size
+            && pair.num_matches <= (this->size - pair.matches_offset)
+                / (2 * sizeof(std::int32_t));
     }
 
-    if (in.eof())
+    if (!valid)
     {
-        in.close();
-        throw util::Exception("Premature EOF");
+        this->close();
+        throw util::FileException(filename, "Invalid prebundle file");
     }
-    in.close();
 }
 
+void
+PrebundleFile::close (void)
+{
+    this->mapping.close();
+    this->data = nullptr;
+    this->size = 0;
+}
+
+namespace
+{
+    PrebundleHeader const&
+    get_header (unsigned char const* data)
+    {
+        if (data == nullptr)
+            throw std::runtime_error("Prebundle file not open");
+        return *reinterpret_cast<PrebundleHeader const*>(data);
+    }
+
+    PrebundleView const&
+    get_view (unsigned char const* data, std::size_t view_id)
+    {
+        PrebundleHeader const& header = get_header(data);
+        if (view_id >= header.num_views)
+            throw std::out_of_range("Invalid view ID");
+        return reinterpret_cast<PrebundleView const*>
+            (data + header.views_offset)[view_id];
+    }
+
+    PrebundlePair const&
+    get_pair (unsigned char const* data, std::size_t pair_id)
+    {
+        PrebundleHeader const& header = get_header(data);
+        if (pair_id >= header.num_pairs)
+            throw std::out_of_range("Invalid pair ID");
+        return reinterpret_cast<PrebundlePair const*>
+            (data + header.pairs_offset)[pair_id];
+    }
+}  /* namespace */
+
+std::size_t
+PrebundleFile::get_num_views (void) const
+{
+    return get_header(this->data).num_views;
+}
+
+std::size_t
+PrebundleFile::get_num_pairs (void) const
+{
+    return get_header(this->data).num_pairs;
+}
+
+std::size_t
+PrebundleFile::get_num_positions (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).num_positions;
+}
+
+math::Vec2f const*
+PrebundleFile::get_positions (std::size_t view_id) const
+{
+    return reinterpret_cast<math::Vec2f const*>(this->data
+        + get_view(this->data, view_id).positions_offset);
+}
+
+std::size_t
+PrebundleFile::get_num_colors (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).num_colors;
+}
+
+math::Vec3uc const*
+PrebundleFile::get_colors (std::size_t view_id) const
+{
+    return reinterpret_cast<math::Vec3uc const*>(this->data
+        + get_view(this->data, view_id).colors_offset);
+}
+
+int
+PrebundleFile::get_view_1_id (std::size_t pair_id) const
+{
+    return get_pair(this->data, pair_id).view_1_id;
+}
+
+int
+PrebundleFile::get_view_2_id (std::size_t pair_id) const
+{
+    return get_pair(this->data, pair_id).view_2_id;
+}
+
+std::size_t
+PrebundleFile::get_num_matches (std::size_t pair_id) const
+{
+    return get_pair(this->data, pair_id).num_matches;
+}
+
+std::int32_t const*
+PrebundleFile::get_matches (std::size_t pair_id) const
+{
+    return reinterpret_cast<std::int32_t const*>(this->data
+        + get_pair(this->data, pair_id).matches_offset);
+}
+
+void
+PrebundleFile::get_viewport (std::size_t view_id, Viewport* viewport) const
+{
+    math::Vec2f const* positions = this->get_positions(view_id);
+    math::Vec3uc const* colors = this->get_colors(view_id);
+    viewport->features.positions.assign(positions,
+        positions + this->get_num_positions(view_id));
+    viewport->features.colors.assign(colors,
+        colors + this->get_num_colors(view_id));
+}
+
+void
+PrebundleFile::get_matching (std::size_t pair_id,
+    TwoViewMatching* matching) const
+{
+    PrebundlePair const& pair = get_pair(this->data, pair_id);
+    std::int32_t const* matches = this->get_matches(pair_id);
+    matching->view_1_id = pair.view_1_id;
+    matching->view_2_id = pair.view_2_id;
+    matching->matches.resize(pair.num_matches);
+    for (std::size_t i = 0; i < pair.num_matches; ++i)
+    {
+        matching->matches[i].first = matches[2 * i + 0];
+        matching->matches[i].second = matches[2 * i + 1];
+    }
+}
+
+/* -------------------- Viewport Initialization ------------------- */
+
+std::size_t
+init_viewports_from_files (std::vector<std::string> const& filenames,
+    int num_threads, ViewportList* viewports)
+{
+    viewports->clear();
+    viewports->resize(filenames.size());
+
+    int num_workers = std::max(1, num_threads);
+#ifdef _OPENMP
+    if (num_threads <= 0)
+        num_workers = omp_get_max_threads();
+#endif
+
+    std::size_t num_failed = 0;
+    std::int64_t const num_images = static_cast<std::int64_t>(filenames.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_workers)
+    for (std::int64_t i = 0; i < num_images; ++i)
+    {
+        std::string const& filename = filenames[i];
+        Viewport& viewport = viewports->at(i);
+        try
+        {
+            /* JPEG headers come with EXIF, other formats have none. */
+            std::string exif;
+            core::image::ImageHeaders headers;
+#ifndef MVE_NO_JPEG_SUPPORT
+            try
+            { headers = core::image::load_jpg_file_headers(filename, &exif); }
+            catch (util::FileException&) { throw; }
+            catch (util::Exception&)
+            {
+                exif.clear();
+                headers = core::image::load_file_headers(filename);
+            }
+#else
+            headers = core::image::load_file_headers(filename);
+#endif
+
+            core::image::ExifInfo exif_info;
+            if (!exif.empty())
+            {
+                try
+                {
+                    exif_info = core::image::exif_extract(exif.c_str(),
+                        exif.size(), false);
+                }
+                catch (std::exception&)
+                {
+                    exif_info = core::image::ExifInfo();
+                }
+            }
+
+            viewport.focal_length = extract_focal_length(exif_info).first;
+            viewport.has_gps = exif_info.has_gps;
+            viewport.gps_position = math::Vec3d(exif_info.gps_latitude,
+                exif_info.gps_longitude, exif_info.gps_altitude);
+            viewport.features.width = headers.width;
+            viewport.features.height = headers.height;
+        }
+        catch (std::exception& e)
+        {
+#pragma omp critical
+            {
+                std::cerr << "Error processing " << filename << ": "
+                    << e.what() << std::endl;
+                num_failed += 1;
+            }
+            viewport = Viewport();
+        }
+    }
+
+    return num_failed;
+}
+
+/* ------------------------ Survey Points ------------------------- */
+
 void
 load_survey_from_file (std::string const& filename,
     SurveyPointList* survey_points)
@@ -10,11 +10,14 @@
 #ifndef SFM_BUNDLER_COMMON_HEADER
 #define SFM_BUNDLER_COMMON_HEADER
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "math/vector.h"
 #include "util/aligned_memory.h"
+#include "util/binary_io.h"
 #include "core/image.h"
 #include "sfm/camera_pose.h"
 #include "sfm/correspondence.h"
@@ -43,6 +46,13 @@ struct Viewport
     /** Radial distortion parameter. */
     float radial_distortion[2];
 
+    /**
+     * GPS position from EXIF as latitude and longitude in degrees and
+     * altitude in meters. Only valid if has_gps is set.
+     */
+    math::Vec3d gps_position;
+    bool has_gps;
+
     /** Camera pose for the viewport. */
     CameraPose pose;
 
@@ -112,6 +122,32 @@ typedef std::vector<SurveyPoint> SurveyPointList;
 
 /* ------------- Data Structures for Feature Matching ------------- */
 
+/**
+ * The two-view geometry of a verified pair, which is computed once during
+ * verification and reused by the initial pair search.
+ */
+struct TwoViewGeometry
+{
+    TwoViewGeometry (void);
+
+    /** Whether the relative pose has been computed. */
+    bool has_pose (void) const;
+
+    /** The number of fundamental matrix inliers, -1 if not computed. */
+    int num_fundamental_inliers;
+    /** The number of homography inliers, -1 if not computed. */
+    int num_homography_inliers;
+    /** The number of inliers triangulated in front of both cameras. */
+    int num_triangulated;
+    /** The median triangulation angle of these inliers in radians. */
+    double triangulation_angle;
+    /**
+     * The pose of view 2 with the focal length of view 2, where view 1 is
+     * in canonical form. The pose is invalid if it has not been computed.
+     */
+    CameraPose pose;
+};
+
 /** The matching result between two views. */
 struct TwoViewMatching
 {
@@ -120,6 +156,7 @@ struct TwoViewMatching
     int view_1_id;
     int view_2_id;
     CorrespondenceIndices matches; // std::vector<pair<int, int> >
+    TwoViewGeometry geometry;
 };
 
 /** The matching result between several pairs of views. */
@@ -130,6 +167,11 @@ typedef std::vector<TwoViewMatching> PairwiseMatching;
 /**
  * Saves the pre-bundle data to file, which records all viewport and
  * matching data necessary for incremental structure-from-motion.
+ *
+ * The file is in the versioned binary format of PrebundleFile: a header,
+ * offset tables for the views and pairs, and the flat arrays of positions,
+ * colors and matches, each aligned to 64 bytes. The data is stored in the
+ * byte order of the machine.
  */
 void
 save_prebundle_to_file (ViewportList const& viewports,
@@ -137,11 +179,81 @@ save_prebundle_to_file (ViewportList const& viewports,
 
 /**
  * Loads the pre-bundle data from file, initializing viewports and matching.
+ * Both the binary format and the older stream format are supported.
  */
 void
 load_prebundle_from_file (std::string const& filename,
     ViewportList* viewports, PairwiseMatching* matching);
 
+/**
+ * Read-only access to a pre-bundle file in the binary format, which is
+ * memory-mapped instead of parsed. Opening the file only validates the
+ * header and the offset tables, the features of a view and the matches of
+ * a pair are read from the mapping on access. The pointers are valid until
+ * the file is closed, and concurrent reads are safe.
+ */
+class PrebundleFile
+{
+public:
+    PrebundleFile (void);
+    ~PrebundleFile (void);
+    PrebundleFile (PrebundleFile const& other) = delete;
+    PrebundleFile& operator= (PrebundleFile const& other) = delete;
+
+    /** Maps the file, throws if it is not a valid binary pre-bundle. */
+    void open (std::string const& filename);
+    /** Unmaps the file, which invalidates all pointers. */
+    void close (void);
+    bool is_open (void) const;
+
+    std::size_t get_num_views (void) const;
+    std::size_t get_num_pairs (void) const;
+
+    /** Returns the feature positions and colors of a view. */
+    std::size_t get_num_positions (std::size_t view_id) const;
+    math::Vec2f const* get_positions (std::size_t view_id) const;
+    std::size_t get_num_colors (std::size_t view_id) const;
+    math::Vec3uc const* get_colors (std::size_t view_id) const;
+
+    /**
+     * Returns the views and matches of a pair. The matches are pairs of
+     * feature IDs of view 1 and view 2, two integers per match.
+     */
+    int get_view_1_id (std::size_t pair_id) const;
+    int get_view_2_id (std::size_t pair_id) const;
+    std::size_t get_num_matches (std::size_t pair_id) const;
+    std::int32_t const* get_matches (std::size_t pair_id) const;
+
+    /** Copies the features of a view into the viewport. */
+    void get_viewport (std::size_t view_id, Viewport* viewport) const;
+    /** Copies a pair into the two-view matching. */
+    void get_matching (std::size_t pair_id, TwoViewMatching* matching) const;
+
+private:
+    util::MappedFile mapping;
+    unsigned char const* data;
+    std::size_t size;
+};
+
+/* -------------------- Viewport Initialization ------------------- */
+
+/**
+ * Initializes the viewports for a list of image files, one viewport per
+ * image in the same order. Only the image headers are read, and for JPEG
+ * images the EXIF data with them, the images are not decoded. The images
+ * are processed in parallel with the given number of threads, 0 uses all
+ * available cores. The focal lengths are extracted with
+ * extract_focal_length(), the EXIF GPS positions are copied, and the
+ * image dimensions are set in the feature sets. Images that fail to load
+ * are reported on the console and get a focal length of zero. Returns the
+ * number of failed images.
+ */
+std::size_t
+init_viewports_from_files (std::vector<std::string> const& filenames,
+    int num_threads, ViewportList* viewports);
+
+/* ------------------------ Survey Points ------------------------- */
+
 /**
  * Loads survey points and their observations from file.
  *
@@ -182,6 +294,21 @@ SurveyObservation::SurveyObservation (int view_id, float x, float y)
 {
 }
 
+inline
+TwoViewGeometry::TwoViewGeometry (void)
+    : num_fundamental_inliers(-1)
+    , num_homography_inliers(-1)
+    , num_triangulated(0)
+    , triangulation_angle(0.0)
+{
+}
+
+inline bool
+TwoViewGeometry::has_pose (void) const
+{
+    return this->pose.is_valid();
+}
+
 inline bool
 TwoViewMatching::operator< (TwoViewMatching const& rhs) const
 {
@@ -193,6 +320,8 @@ TwoViewMatching::operator< (TwoViewMatching const& rhs) const
 inline
 Viewport::Viewport (void)
     : focal_length(0.0f)
+    , gps_position(0.0)
+    , has_gps(false)
 {
     std::fill(this->radial_distortion, this->radial_distortion + 2, 0.0f);
 }
@@ -203,6 +332,25 @@ Track::is_valid (void) const
     return !std::isnan(this->pos[0]);
 }
 
+inline
+PrebundleFile::PrebundleFile (void)
+    : data(nullptr)
+    , size(0)
+{
+}
+
+inline
+PrebundleFile::~PrebundleFile (void)
+{
+    this->close();
+}
+
+inline bool
+PrebundleFile::is_open (void) const
+{
+    return this->data != nullptr;
+}
+
 SFM_BUNDLER_NAMESPACE_END
 SFM_NAMESPACE_END
 
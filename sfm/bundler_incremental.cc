@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "sfm/bundler_incremental.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Returns a timestamp in milliseconds for the phase times. */
+    double
+    get_timestamp (void)
+    {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Removes the feature of a view from a track and its track ID. */
+    void
+    remove_track_view (ViewportList* viewports, Track* track, int track_id,
+        int view_id)
+    {
+        std::vector<int>& track_ids = viewports->at(view_id).track_ids;
+        for (std::size_t i = 0; i < track->features.size(); ++i)
+        {
+            FeatureReference const& ref = track->features[i];
+            if (ref.view_id == view_id && track_ids[ref.feature_id] == track_id)
+                track_ids[ref.feature_id] = -1;
+        }
+        track->remove_view(view_id);
+    }
+
+    /* Counts the triangulated tracks visible in a view. */
+    int
+    count_visible_tracks (Viewport const& viewport, TrackList const& tracks)
+    {
+        int num_visible = 0;
+        for (std::size_t i = 0; i < viewport.track_ids.size(); ++i)
+        {
+            int const track_id = viewport.track_ids[i];
+            if (track_id >= 0 && tracks[track_id].is_valid())
+                num_visible += 1;
+        }
+        return num_visible;
+    }
+}  /* namespace */
+
+void
+Incremental::initialize (ViewportList* viewports, TrackList* tracks)
+{
+    if (viewports == nullptr || tracks == nullptr)
+        throw std::invalid_argument("Viewports and tracks must not be null");
+
+    this->viewports = viewports;
+    this->tracks = tracks;
+    this->stats = Statistics();
+    this->registered.clear();
+    for (std::size_t i = 0; i < viewports->size(); ++i)
+        if (viewports->at(i).pose.is_valid())
+            this->registered.push_back(static_cast<int>(i));
+    if (this->registered.size() < 2)
+        throw std::invalid_argument("At least two views require a pose");
+    this->failed_visible.assign(viewports->size(), -1);
+
+    /* The given tracks positions are not used for initialization. */
+    for (std::size_t i = 0; i < tracks->size(); ++i)
+        tracks->at(i).invalidate();
+
+    this->triangulate_new_tracks();
+    this->bundle_adjustment(0);
+    this->invalidate_large_error_tracks();
+    this->full_ba_cameras = this->registered.size();
+    this->new_cameras = 0;
+    this->stats.num_full_ba += 1;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Incremental::reconstruct (void)
+{
+    if (this->viewports == nullptr)
+        throw std::runtime_error("Reconstruction not initialized");
+
+    std::vector<int> next_views;
+    while (true)
+    {
+        double const selection_start = get_timestamp();
+        this->find_next_views(&next_views);
+        this->stats.selection_time += get_timestamp() - selection_start;
+        if (next_views.empty())
+            break;
+
+        this->stats.num_rounds += 1;
+        std::size_t const num_registered = this->register_views(next_views);
+        if (this->opts.verbose_output)
+        {
+            std::cout << "Round " << this->stats.num_rounds << ": Registered "
+                << num_registered << " of " << next_views.size()
+                << " views, " << this->registered.size() << " cameras."
+                << std::endl;
+        }
+        if (num_registered == 0)
+            continue;
+
+        this->triangulate_new_tracks();
+        this->new_cameras += num_registered;
+        if (this->new_cameras < static_cast<std::size_t>
+            (std::max(1, this->opts.ba_min_new_cameras)))
+            continue;
+
+        /* Local BA of the latest cameras, unless the cameras have grown. */
+        bool const full_ba = this->opts.ba_local_window_size == 0
+            || static_cast<double>(this->registered.size())
+            >= this->opts.ba_full_growth
+            * static_cast<double>(this->full_ba_cameras);
+        this->bundle_adjustment(full_ba ? 0 : this->opts.ba_local_window_size);
+        this->invalidate_large_error_tracks();
+        this->new_cameras = 0;
+        if (full_ba)
+        {
+            this->full_ba_cameras = this->registered.size();
+            this->stats.num_full_ba += 1;
+        }
+        else
+            this->stats.num_local_ba += 1;
+    }
+
+    if (this->new_cameras > 0
+        || this->full_ba_cameras != this->registered.size())
+    {
+        this->bundle_adjustment(0);
+        this->invalidate_large_error_tracks();
+        this->full_ba_cameras = this->registered.size();
+        this->new_cameras = 0;
+        this->stats.num_full_ba += 1;
+    }
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Reconstructed " << this->registered.size()
+            << " cameras in " << this->stats.num_rounds << " rounds, "
+            << this->stats.num_failed_views << " failed registrations, "
+            << this->stats.num_full_ba << " full and "
+            << this->stats.num_local_ba << " local BA." << std::endl;
+        std::cout << "Time for selection " << this->stats.selection_time
+            << "ms, registration " << this->stats.registration_time
+            << "ms, triangulation " << this->stats.triangulation_time
+            << "ms, BA " << this->stats.ba_time << "ms, filtering "
+            << this->stats.filter_time << "ms." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Incremental::find_next_views (std::vector<int>* next_views) const
+{
+    if (this->viewports == nullptr)
+        throw std::runtime_error("Reconstruction not initialized");
+
+    ViewportList const& viewports = *this->viewports;
+    std::int64_t const num_views = static_cast<std::int64_t>(viewports.size());
+    std::vector<int> num_visible(viewports.size(), -1);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (std::int64_t i = 0; i < num_views; ++i)
+        if (!viewports[i].pose.is_valid())
+            num_visible[i] = count_visible_tracks(viewports[i], *this->tracks);
+
+    /* Candidates are ordered by decreasing visible tracks, then view ID. */
+    std::vector<std::pair<int, int> > candidates;
+    for (std::int64_t i = 0; i < num_views; ++i)
+    {
+        if (num_visible[i] < this->opts.min_visible_tracks
+            || num_visible[i] <= this->failed_visible[i])
+            continue;
+        candidates.push_back(std::make_pair(-num_visible[i],
+            static_cast<int>(i)));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    next_views->clear();
+    std::size_t const max_views = static_cast<std::size_t>
+        (std::max(1, this->opts.max_views_per_round));
+    for (std::size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (next_views->size() >= max_views
+            || -candidates[i].first < this->opts.next_view_ratio
+            * -candidates[0].first)
+            break;
+        next_views->push_back(candidates[i].second);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+Incremental::register_views (std::vector<int> const& views)
+{
+    double const start_time = get_timestamp();
+    std::size_t const num_views = views.size();
+    std::vector<RansacPoseP3P::Result> results(num_views);
+    std::vector<std::vector<int> > feature_ids(num_views);
+    std::vector<char> success(num_views, 0);
+
+    /* The poses are estimated in parallel, every view on its own. */
+    RansacPoseP3P ransac(this->opts.pose_p3p_opts);
+    std::size_t const min_inliers = static_cast<std::size_t>
+        (std::max(3, this->opts.min_registration_inliers));
+#pragma omp parallel for schedule(dynamic)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(num_views); ++i)
+    {
+        Viewport const& viewport = this->viewports->at(views[i]);
+        if (viewport.focal_length <= 0.0f)
+            continue;
+
+        Correspondences2D3D corresp;
+        for (std::size_t j = 0; j < viewport.track_ids.size(); ++j)
+        {
+            int const track_id = viewport.track_ids[j];
+            if (track_id < 0 || !this->tracks->at(track_id).is_valid())
+                continue;
+            Track const& track = this->tracks->at(track_id);
+            math::Vec2f const& pos = viewport.features.positions[j];
+            Correspondence2D3D c;
+            std::copy(track.pos.begin(), track.pos.end(), c.p3d);
+            std::copy(pos.begin(), pos.end(), c.p2d);
+            corresp.push_back(c);
+            feature_ids[i].push_back(static_cast<int>(j));
+        }
+        if (corresp.size() < min_inliers)
+            continue;
+
+        CameraPose k_pose;
+        k_pose.set_k_matrix(viewport.focal_length, 0.0, 0.0);
+        ransac.estimate(corresp, k_pose.K, &results[i]);
+        success[i] = results[i].inliers.size() >= min_inliers;
+    }
+
+    /* The poses and outliers are applied in the order of the views. */
+    std::size_t num_registered = 0;
+    std::vector<char> is_inlier;
+    for (std::size_t i = 0; i < num_views; ++i)
+    {
+        int const view_id = views[i];
+        Viewport& viewport = this->viewports->at(view_id);
+        if (!success[i])
+        {
+            this->failed_visible[view_id]
+                = static_cast<int>(feature_ids[i].size());
+            this->stats.num_failed_views += 1;
+            continue;
+        }
+
+        math::Matrix<double, 3, 4> const& pose = results[i].pose;
+        viewport.pose.set_k_matrix(viewport.focal_length, 0.0, 0.0);
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+                viewport.pose.R(r, c) = pose(r, c);
+            viewport.pose.t[r] = pose(r, 3);
+        }
+
+        /* Outliers are removed from their tracks. */
+        is_inlier.assign(feature_ids[i].size(), 0);
+        for (std::size_t j = 0; j < results[i].inliers.size(); ++j)
+            is_inlier[results[i].inliers[j]] = 1;
+        for (std::size_t j = 0; j < feature_ids[i].size(); ++j)
+        {
+            if (is_inlier[j])
+                continue;
+            int const track_id = viewport.track_ids[feature_ids[i][j]];
+            remove_track_view(this->viewports, &this->tracks->at(track_id),
+                track_id, view_id);
+        }
+
+        this->registered.push_back(view_id);
+        num_registered += 1;
+    }
+
+    this->stats.num_registered_views += num_registered;
+    this->stats.registration_time += get_timestamp() - start_time;
+    return num_registered;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Incremental::triangulate_new_tracks (void)
+{
+    double const start_time = get_timestamp();
+
+    /* The pose table is indexed by view ID. */
+    std::vector<CameraPose> poses(this->viewports->size());
+    for (std::size_t i = 0; i < poses.size(); ++i)
+        poses[i] = this->viewports->at(i).pose;
+
+    /* Collect the invalid tracks with at least two registered views. */
+    std::vector<Triangulate::TrackObservations> observations;
+    std::vector<int> track_ids;
+    Triangulate::TrackObservations track_obs;
+    for (std::size_t i = 0; i < this->tracks->size(); ++i)
+    {
+        Track const& track = this->tracks->at(i);
+        if (track.is_valid())
+            continue;
+
+        track_obs.pose_ids.clear();
+        track_obs.positions.clear();
+        for (std::size_t j = 0; j < track.features.size(); ++j)
+        {
+            FeatureReference const& ref = track.features[j];
+            if (!poses[ref.view_id].is_valid())
+                continue;
+            track_obs.pose_ids.push_back(ref.view_id);
+            track_obs.positions.push_back(this->viewports->at(ref.view_id)
+                .features.positions[ref.feature_id]);
+        }
+        if (track_obs.pose_ids.size() < 2)
+            continue;
+        observations.push_back(track_obs);
+        track_ids.push_back(static_cast<int>(i));
+    }
+
+    Triangulate triangulate(this->opts.triangulate_opts);
+    std::vector<Triangulate::TrackResult> results;
+    triangulate.triangulate_tracks(poses, observations, &results);
+
+    /* Set the new positions and remove the outliers from the tracks. */
+    std::size_t num_new_tracks = 0;
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        if (!results[i].success)
+            continue;
+        Track& track = this->tracks->at(track_ids[i]);
+        for (int j = 0; j < 3; ++j)
+            track.pos[j] = static_cast<float>(results[i].pos[j]);
+        for (std::size_t j = 0; j < results[i].outliers.size(); ++j)
+            remove_track_view(this->viewports, &track, track_ids[i],
+                observations[i].pose_ids[results[i].outliers[j]]);
+        num_new_tracks += 1;
+    }
+
+    this->stats.num_new_tracks += num_new_tracks;
+    this->stats.triangulation_time += get_timestamp() - start_time;
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Triangulated " << num_new_tracks << " of "
+            << observations.size() << " new tracks." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Incremental::bundle_adjustment (std::size_t window_size)
+{
+    double const start_time = get_timestamp();
+
+    /* The cameras are in the order of registration for the local window. */
+    std::vector<int> camera_ids(this->viewports->size(), -1);
+    std::vector<ba::Camera> ba_cameras(this->registered.size());
+    for (std::size_t i = 0; i < this->registered.size(); ++i)
+    {
+        Viewport const& viewport = this->viewports->at(this->registered[i]);
+        CameraPose const& pose = viewport.pose;
+        ba::Camera& cam = ba_cameras[i];
+        cam.focal_length = pose.get_focal_length();
+        std::copy(viewport.radial_distortion,
+            viewport.radial_distortion + 2, cam.distortion);
+        std::copy(pose.t.begin(), pose.t.end(), cam.translation);
+        std::copy(pose.R.begin(), pose.R.end(), cam.rotation);
+        camera_ids[this->registered[i]] = static_cast<int>(i);
+    }
+
+    /* Points are the valid tracks with at least two registered views. */
+    std::vector<int> track_ids;
+    std::vector<ba::Point3D> ba_points;
+    std::vector<ba::Observation> ba_observations;
+    for (std::size_t i = 0; i < this->tracks->size(); ++i)
+    {
+        Track const& track = this->tracks->at(i);
+        if (!track.is_valid())
+            continue;
+
+        std::size_t const num_obs = ba_observations.size();
+        for (std::size_t j = 0; j < track.features.size(); ++j)
+        {
+            FeatureReference const& ref = track.features[j];
+            if (camera_ids[ref.view_id] < 0)
+                continue;
+            math::Vec2f const& pos = this->viewports->at(ref.view_id)
+                .features.positions[ref.feature_id];
+            ba::Observation obs;
+            std::copy(pos.begin(), pos.end(), obs.pos);
+            obs.camera_id = camera_ids[ref.view_id];
+            obs.point_id = static_cast<int>(ba_points.size());
+            ba_observations.push_back(obs);
+        }
+        if (ba_observations.size() - num_obs < 2)
+        {
+            ba_observations.resize(num_obs);
+            continue;
+        }
+
+        ba::Point3D point;
+        std::copy(track.pos.begin(), track.pos.end(), point.pos);
+        ba_points.push_back(point);
+        track_ids.push_back(static_cast<int>(i));
+    }
+
+    if (!ba_observations.empty())
+    {
+        ba::BundleAdjustment::Options ba_opts = this->opts.ba_opts;
+        ba_opts.bundle_mode = ba::BundleAdjustment::BA_CAMERAS_AND_POINTS;
+        ba_opts.local_window_size = window_size;
+        ba::BundleAdjustment ba(ba_opts);
+        ba.set_cameras(&ba_cameras);
+        ba.set_points(&ba_points);
+        ba.set_observations(&ba_observations);
+        ba.optimize();
+        if (this->opts.verbose_output)
+            ba.print_status();
+    }
+
+    /* Apply the optimized cameras and points. */
+    for (std::size_t i = 0; i < this->registered.size(); ++i)
+    {
+        Viewport& viewport = this->viewports->at(this->registered[i]);
+        ba::Camera const& cam = ba_cameras[i];
+        viewport.focal_length = static_cast<float>(cam.focal_length);
+        std::copy(cam.distortion, cam.distortion + 2,
+            viewport.radial_distortion);
+        viewport.pose.set_k_matrix(cam.focal_length, 0.0, 0.0);
+        std::copy(cam.translation, cam.translation + 3,
+            viewport.pose.t.begin());
+        std::copy(cam.rotation, cam.rotation + 9, viewport.pose.R.begin());
+    }
+    for (std::size_t i = 0; i < ba_points.size(); ++i)
+    {
+        Track& track = this->tracks->at(track_ids[i]);
+        for (int j = 0; j < 3; ++j)
+            track.pos[j] = static_cast<float>(ba_points[i].pos[j]);
+    }
+
+    this->stats.ba_time += get_timestamp() - start_time;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Incremental::invalidate_large_error_tracks (void)
+{
+    double const start_time = get_timestamp();
+
+    /* Mean reprojection error of every track, infinite behind a camera. */
+    TrackList& tracks = *this->tracks;
+    std::int64_t const num_tracks = static_cast<std::int64_t>(tracks.size());
+    std::vector<double> errors(tracks.size(), -1.0);
+#pragma omp parallel for schedule(dynamic, 256)
+    for (std::int64_t i = 0; i < num_tracks; ++i)
+    {
+        Track const& track = tracks[i];
+        if (!track.is_valid())
+            continue;
+
+        math::Vec3d const pos(track.pos[0], track.pos[1], track.pos[2]);
+        double error = 0.0;
+        int num_obs = 0;
+        for (std::size_t j = 0; j < track.features.size(); ++j)
+        {
+            FeatureReference const& ref = track.features[j];
+            Viewport const& viewport = this->viewports->at(ref.view_id);
+            CameraPose const& pose = viewport.pose;
+            if (!pose.is_valid())
+                continue;
+
+            math::Vec3d const x = pose.R * pos + pose.t;
+            if (x[2] <= 0.0)
+            {
+                error = std::numeric_limits<double>::infinity();
+                num_obs = 1;
+                break;
+            }
+            double ix = x[0] / x[2];
+            double iy = x[1] / x[2];
+            float const* dist = viewport.radial_distortion;
+            double const radius2 = ix * ix + iy * iy;
+            double const factor = 1.0 + radius2 * (dist[0] + dist[1] * radius2);
+            double const flen = pose.get_focal_length();
+            math::Vec2f const& p2d
+                = viewport.features.positions[ref.feature_id];
+            double const dx = ix * factor * flen - p2d[0];
+            double const dy = iy * factor * flen - p2d[1];
+            error += std::sqrt(dx * dx + dy * dy);
+            num_obs += 1;
+        }
+        if (num_obs > 0)
+            errors[i] = error / static_cast<double>(num_obs);
+    }
+
+    std::vector<double> valid_errors;
+    for (std::size_t i = 0; i < errors.size(); ++i)
+        if (errors[i] >= 0.0)
+            valid_errors.push_back(errors[i]);
+    if (valid_errors.empty())
+        return;
+    std::size_t const median_id = valid_errors.size() / 2;
+    std::nth_element(valid_errors.begin(),
+        valid_errors.begin() + median_id, valid_errors.end());
+    double const threshold = this->opts.track_error_threshold_factor
+        * valid_errors[median_id];
+
+    std::size_t num_invalidated = 0;
+    for (std::size_t i = 0; i < errors.size(); ++i)
+    {
+        if (errors[i] <= threshold)
+            continue;
+        tracks[i].invalidate();
+        num_invalidated += 1;
+    }
+
+    this->stats.num_invalidated_tracks += num_invalidated;
+    this->stats.filter_time += get_timestamp() - start_time;
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Invalidated " << num_invalidated << " tracks with an "
+            << "error above " << threshold << "." << std::endl;
+    }
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_INCREMENTAL_HEADER
+#define SFM_BUNDLER_INCREMENTAL_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "sfm/bundler_common.h"
+#include "sfm/bundle_adjustment.h"
+#include "sfm/ransac_pose_p3p.h"
+#include "sfm/triangulate.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Incremental structure-from-motion.
+ *
+ * The reconstruction starts from the views with a pose, usually an initial
+ * pair, and extends it in rounds. Every round selects the views that see
+ * the most triangulated tracks, registers them in parallel with P3P RANSAC,
+ * triangulates the new tracks and runs bundle adjustment. Several views
+ * are registered per round, and bundle adjustment only runs once enough
+ * cameras have been added since the last one. It is a local bundle
+ * adjustment of the latest cameras, unless the reconstruction has grown
+ * enough since the last full bundle adjustment.
+ *
+ * The feature positions must be normalized, and the focal lengths of the
+ * viewports must be initialized. The poses use the principal point 0.
+ */
+class Incremental
+{
+public:
+    /** Options for incremental reconstruction. */
+    struct Options
+    {
+        Options (void);
+
+        /** Options for the registration of new views. */
+        RansacPoseP3P::Options pose_p3p_opts;
+
+        /** Options for the triangulation of new tracks. */
+        Triangulate::Options triangulate_opts;
+
+        /** Options for bundle adjustment, the window is set per run. */
+        ba::BundleAdjustment::Options ba_opts;
+
+        /** Minimum number of visible tracks to register a view. */
+        int min_visible_tracks;
+
+        /** Minimum number of P3P inliers to register a view. */
+        int min_registration_inliers;
+
+        /** Maximum number of views registered per round. */
+        int max_views_per_round;
+
+        /**
+         * Views of a round must see at least this fraction of the visible
+         * tracks of the best view. Defaults to 0.75.
+         */
+        double next_view_ratio;
+
+        /**
+         * Bundle adjustment runs once this many cameras have been added
+         * since the last bundle adjustment. Defaults to 1.
+         */
+        int ba_min_new_cameras;
+
+        /**
+         * A full bundle adjustment runs once the number of cameras has grown
+         * by this factor since the last full bundle adjustment, otherwise a
+         * local bundle adjustment runs. Defaults to 1.2.
+         */
+        double ba_full_growth;
+
+        /**
+         * The number of latest cameras of the local bundle adjustment.
+         * Defaults to 0, which always runs the full bundle adjustment.
+         */
+        std::size_t ba_local_window_size;
+
+        /**
+         * Tracks with a mean reprojection error above this factor times the
+         * median of all tracks are invalidated after bundle adjustment, and
+         * triangulated again with outlier removal. Defaults to 10.
+         */
+        double track_error_threshold_factor;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+    };
+
+    /** Statistics and per-phase times in milliseconds. */
+    struct Statistics
+    {
+        Statistics (void);
+
+        std::size_t num_rounds;
+        std::size_t num_registered_views;
+        std::size_t num_failed_views;
+        std::size_t num_new_tracks;
+        std::size_t num_invalidated_tracks;
+        std::size_t num_full_ba;
+        std::size_t num_local_ba;
+
+        double selection_time;
+        double registration_time;
+        double triangulation_time;
+        double ba_time;
+        double filter_time;
+    };
+
+public:
+    explicit Incremental (Options const& options);
+
+    /**
+     * Initializes the reconstruction with the viewports and tracks. The
+     * views with a valid pose are the initial reconstruction, at least two
+     * are required. Their tracks are triangulated and bundle adjusted.
+     */
+    void initialize (ViewportList* viewports, TrackList* tracks);
+
+    /**
+     * Registers all views that can be registered, and runs a final full
+     * bundle adjustment if the cameras changed since the last one.
+     */
+    void reconstruct (void);
+
+    /**
+     * Returns the views for the next round, ordered by decreasing number of
+     * visible tracks. Views that failed to register are skipped until they
+     * see more tracks than at the failure.
+     */
+    void find_next_views (std::vector<int>* next_views) const;
+
+    /** Returns the statistics of the reconstruction. */
+    Statistics const& get_statistics (void) const;
+
+private:
+    std::size_t register_views (std::vector<int> const& views);
+    void triangulate_new_tracks (void);
+    void bundle_adjustment (std::size_t window_size);
+    void invalidate_large_error_tracks (void);
+
+private:
+    Options opts;
+    Statistics stats;
+    ViewportList* viewports;
+    TrackList* tracks;
+    /* The registered views in the order of registration. */
+    std::vector<int> registered;
+    /* The number of visible tracks of a view at the last failure. */
+    std::vector<int> failed_visible;
+    /* The cameras at the last full BA and added since the last BA. */
+    std::size_t full_ba_cameras;
+    std::size_t new_cameras;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Incremental::Options::Options (void)
+    : min_visible_tracks(20)
+    , min_registration_inliers(12)
+    , max_views_per_round(4)
+    , next_view_ratio(0.75)
+    , ba_min_new_cameras(1)
+    , ba_full_growth(1.2)
+    , ba_local_window_size(0)
+    , track_error_threshold_factor(10.0)
+    , verbose_output(false)
+{
+}
+
+inline
+Incremental::Statistics::Statistics (void)
+    : num_rounds(0)
+    , num_registered_views(0)
+    , num_failed_views(0)
+    , num_new_tracks(0)
+    , num_invalidated_tracks(0)
+    , num_full_ba(0)
+    , num_local_ba(0)
+    , selection_time(0.0)
+    , registration_time(0.0)
+    , triangulation_time(0.0)
+    , ba_time(0.0)
+    , filter_time(0.0)
+{
+}
+
+inline
+Incremental::Incremental (Options const& options)
+    : opts(options)
+    , viewports(nullptr)
+    , tracks(nullptr)
+    , full_ba_cameras(0)
+    , new_cameras(0)
+{
+}
+
+inline Incremental::Statistics const&
+Incremental::get_statistics (void) const
+{
+    return this->stats;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_INCREMENTAL_HEADER */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "math/defines.h"
+#include "sfm/bundler_init_pair.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+void
+InitialPair::rank_pairs (PairwiseMatching const& matching,
+    std::vector<std::size_t>* ranking) const
+{
+    /* Candidates are ordered by decreasing triangulated inliers, then ID. */
+    std::vector<std::pair<int, std::size_t> > candidates;
+    for (std::size_t i = 0; i < matching.size(); ++i)
+    {
+        TwoViewGeometry const& geometry = matching[i].geometry;
+        if (!geometry.has_pose() || geometry.num_fundamental_inliers <= 0)
+            continue;
+
+        float const homography_ratio = static_cast<float>
+            (geometry.num_homography_inliers)
+            / static_cast<float>(geometry.num_fundamental_inliers);
+        if (homography_ratio > this->opts.max_homography_inliers
+            || geometry.num_triangulated < this->opts.min_num_triangulated
+            || geometry.triangulation_angle
+            < this->opts.min_triangulation_angle)
+            continue;
+        candidates.push_back(std::make_pair(-geometry.num_triangulated, i));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    ranking->resize(candidates.size());
+    for (std::size_t i = 0; i < candidates.size(); ++i)
+        ranking->at(i) = candidates[i].second;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+InitialPair::compute (ViewportList const& viewports,
+    PairwiseMatching const& matching, Result* result) const
+{
+    *result = Result();
+    std::vector<std::size_t> ranking;
+    this->rank_pairs(matching, &ranking);
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Initial pair: " << ranking.size() << " of "
+            << matching.size() << " pairs qualify." << std::endl;
+    }
+    if (ranking.empty())
+        return;
+
+    TwoViewMatching const& tvm = matching[ranking.front()];
+    result->pair_id = static_cast<int>(ranking.front());
+    result->view_1_id = tvm.view_1_id;
+    result->view_2_id = tvm.view_2_id;
+    result->view_1_pose.init_canonical_form();
+    result->view_1_pose.set_k_matrix(
+        viewports.at(tvm.view_1_id).focal_length, 0.0, 0.0);
+    result->view_2_pose = tvm.geometry.pose;
+    result->view_2_pose.set_k_matrix(
+        viewports.at(tvm.view_2_id).focal_length, 0.0, 0.0);
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Initial pair: Views " << tvm.view_1_id << " and "
+            << tvm.view_2_id << " with " << tvm.geometry.num_triangulated
+            << " triangulated inliers, " << tvm.geometry.num_homography_inliers
+            << " homography inliers, angle "
+            << MATH_RAD2DEG(tvm.geometry.triangulation_angle) << " degrees."
+            << std::endl;
+    }
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_INIT_PAIR_HEADER
+#define SFM_BUNDLER_INIT_PAIR_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "math/defines.h"
+#include "sfm/bundler_common.h"
+#include "sfm/camera_pose.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Selects the initial pair for incremental SfM.
+ *
+ * The pairs are ranked by the two-view geometry that verification computes
+ * once per pair (see Verification::Options::compute_geometry), so nothing
+ * is estimated again here. A pair qualifies if few of its inliers fit a
+ * homography, i.e. the scene is not planar and the baseline is not a pure
+ * rotation, and its inliers triangulate with a large enough angle. The
+ * qualified pairs are ranked by decreasing number of triangulated inliers.
+ */
+class InitialPair
+{
+public:
+    /** Options for the initial pair search. */
+    struct Options
+    {
+        Options (void);
+
+        /**
+         * Maximum ratio of homography inliers to fundamental matrix
+         * inliers. Defaults to 0.8.
+         */
+        float max_homography_inliers;
+
+        /** Minimum number of triangulated inliers. Defaults to 50. */
+        int min_num_triangulated;
+
+        /**
+         * Minimum median triangulation angle in radians. Defaults to
+         * 5 degrees.
+         */
+        double min_triangulation_angle;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+    };
+
+    /** The initial pair with the poses of both views. */
+    struct Result
+    {
+        Result (void);
+
+        /** The index of the pair in the matching, -1 if none was found. */
+        int pair_id;
+        int view_1_id;
+        int view_2_id;
+        CameraPose view_1_pose;
+        CameraPose view_2_pose;
+    };
+
+public:
+    explicit InitialPair (Options const& options);
+
+    /**
+     * Returns the indices of the qualified pairs in the order of their
+     * rank. Pairs without two-view geometry do not qualify.
+     */
+    void rank_pairs (PairwiseMatching const& matching,
+        std::vector<std::size_t>* ranking) const;
+
+    /**
+     * Finds the best initial pair. The pose of view 1 is in canonical form
+     * and both poses have the focal lengths of the viewports.
+     */
+    void compute (ViewportList const& viewports,
+        PairwiseMatching const& matching, Result* result) const;
+
+private:
+    Options opts;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+InitialPair::Options::Options (void)
+    : max_homography_inliers(0.8f)
+    , min_num_triangulated(50)
+    , min_triangulation_angle(MATH_DEG2RAD(5.0))
+    , verbose_output(false)
+{
+}
+
+inline
+InitialPair::Result::Result (void)
+    : pair_id(-1)
+    , view_1_id(-1)
+    , view_2_id(-1)
+{
+}
+
+inline
+InitialPair::InitialPair (Options const& options)
+    : opts(options)
+{
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_INIT_PAIR_HEADER */
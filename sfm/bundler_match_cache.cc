@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include "util/exception.h"
+#include "sfm/bundler_match_cache.h"
+
+#define MATCH_CACHE_SIGNATURE "MVE_MATCHCACHE\n"
+#define MATCH_CACHE_SIGNATURE_LEN 15
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    void
+    swap_correspondences (CorrespondenceIndices* matches)
+    {
+        for (std::size_t i = 0; i < matches->size(); ++i)
+            std::swap(matches->at(i).first, matches->at(i).second);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+MatchCache::MatchCache (Key options_hash)
+    : options_hash(options_hash)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+MatchCache::Key
+MatchCache::hash_data (void const* data, std::size_t size, Key hash)
+{
+    unsigned char const* bytes = static_cast<unsigned char const*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<Key>(bytes[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* ---------------------------------------------------------------- */
+
+MatchCache::Key
+MatchCache::hash_features (FeatureSet const& features)
+{
+    Key hash = hash_data(nullptr, 0);
+    std::uint64_t const sizes[3] = { features.positions.size(),
+        features.sift_descriptors.size(), features.surf_descriptors.size() };
+    hash = hash_data(sizes, sizeof(sizes), hash);
+    if (!features.positions.empty())
+        hash = hash_data(features.positions.data(),
+            features.positions.size() * sizeof(math::Vec2f), hash);
+    for (std::size_t i = 0; i < features.sift_descriptors.size(); ++i)
+        hash = hash_data(features.sift_descriptors[i].data.begin(),
+            128 * sizeof(float), hash);
+    for (std::size_t i = 0; i < features.surf_descriptors.size(); ++i)
+        hash = hash_data(features.surf_descriptors[i].data.begin(),
+            64 * sizeof(float), hash);
+    return hash;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MatchCache::load_from_file (std::string const& filename)
+{
+    this->entries.clear();
+
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    char signature[MATCH_CACHE_SIGNATURE_LEN + 1];
+    in.read(signature, MATCH_CACHE_SIGNATURE_LEN);
+    signature[MATCH_CACHE_SIGNATURE_LEN] = '\0';
+    if (std::string(MATCH_CACHE_SIGNATURE) != signature)
+        throw util::Exception("Invalid match cache signature");
+
+    Key options_hash = 0;
+    in.read(reinterpret_cast<char*>(&options_hash), sizeof(Key));
+    if (options_hash != this->options_hash)
+        return false;
+
+    std::uint64_t num_entries = 0;
+    in.read(reinterpret_cast<char*>(&num_entries), sizeof(std::uint64_t));
+    for (std::uint64_t i = 0; i < num_entries && in.good(); ++i)
+    {
+        Key keys[2];
+        int32_t num_matches;
+        in.read(reinterpret_cast<char*>(keys), sizeof(keys));
+        in.read(reinterpret_cast<char*>(&num_matches), sizeof(int32_t));
+        if (num_matches < 0)
+            break;
+
+        std::vector<int32_t> data(2 * num_matches);
+        in.read(reinterpret_cast<char*>(data.data()),
+            data.size() * sizeof(int32_t));
+        CorrespondenceIndices& matches
+            = this->entries[std::make_pair(keys[0], keys[1])];
+        matches.resize(num_matches);
+        for (int32_t j = 0; j < num_matches; ++j)
+            matches[j] = CorrespondenceIndex(data[2 * j], data[2 * j + 1]);
+    }
+
+    if (!in.good())
+    {
+        this->entries.clear();
+        throw util::Exception("Premature EOF");
+    }
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MatchCache::save_to_file (std::string const& filename) const
+{
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+
+    out.write(MATCH_CACHE_SIGNATURE, MATCH_CACHE_SIGNATURE_LEN);
+    out.write(reinterpret_cast<char const*>(&this->options_hash), sizeof(Key));
+    std::uint64_t const num_entries = this->entries.size();
+    out.write(reinterpret_cast<char const*>(&num_entries),
+        sizeof(std::uint64_t));
+
+    std::vector<int32_t> data;
+    for (Entries::const_iterator iter = this->entries.begin();
+        iter != this->entries.end(); ++iter)
+    {
+        Key const keys[2] = { iter->first.first, iter->first.second };
+        CorrespondenceIndices const& matches = iter->second;
+        int32_t const num_matches = static_cast<int32_t>(matches.size());
+        data.resize(2 * matches.size());
+        for (std::size_t j = 0; j < matches.size(); ++j)
+        {
+            data[2 * j] = static_cast<int32_t>(matches[j].first);
+            data[2 * j + 1] = static_cast<int32_t>(matches[j].second);
+        }
+        out.write(reinterpret_cast<char const*>(keys), sizeof(keys));
+        out.write(reinterpret_cast<char const*>(&num_matches), sizeof(int32_t));
+        out.write(reinterpret_cast<char const*>(data.data()),
+            data.size() * sizeof(int32_t));
+    }
+
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+    out.close();
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+MatchCache::lookup (Key view_1_key, Key view_2_key,
+    CorrespondenceIndices* matches) const
+{
+    /* Pairs are stored with ordered keys. */
+    bool const swapped = view_2_key < view_1_key;
+    Entries::const_iterator iter = this->entries.find(swapped
+        ? std::make_pair(view_2_key, view_1_key)
+        : std::make_pair(view_1_key, view_2_key));
+    if (iter == this->entries.end())
+        return false;
+
+    *matches = iter->second;
+    if (swapped)
+        swap_correspondences(matches);
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MatchCache::insert (Key view_1_key, Key view_2_key,
+    CorrespondenceIndices const& matches)
+{
+    if (view_2_key < view_1_key)
+    {
+        CorrespondenceIndices& entry
+            = this->entries[std::make_pair(view_2_key, view_1_key)];
+        entry = matches;
+        swap_correspondences(&entry);
+    }
+    else
+        this->entries[std::make_pair(view_1_key, view_2_key)] = matches;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_MATCH_CACHE_HEADER
+#define SFM_BUNDLER_MATCH_CACHE_HEADER
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "sfm/bundler_common.h"
+#include "sfm/correspondence.h"
+#include "sfm/feature_set.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Persistent cache of pairwise matching results.
+ *
+ * Views are identified by a content hash of their features, and the cache
+ * is only valid for the matching options it was created with (given as
+ * options hash). Thus, the cache remains valid if views are reordered or
+ * added, and only pairs with changed features need to be matched again.
+ * The cache also records pairs without matches, which are most pairs.
+ */
+class MatchCache
+{
+public:
+    typedef std::uint64_t Key;
+
+    explicit MatchCache (Key options_hash);
+
+    /** Returns the FNV-1a hash of the data, continuing the given hash. */
+    static Key hash_data (void const* data, std::size_t size,
+        Key hash = 14695981039346656037ull);
+
+    /** Returns the content hash of the features of a view. */
+    static Key hash_features (FeatureSet const& features);
+
+    /**
+     * Loads the cache from file. If the file was written with different
+     * options, the cache is left empty and false is returned.
+     */
+    bool load_from_file (std::string const& filename);
+
+    /** Saves the cache to file. */
+    void save_to_file (std::string const& filename) const;
+
+    /**
+     * Looks up the matches for the given pair of views. The matches index
+     * the features of view 1 (first) and view 2 (second). This is safe to
+     * call from multiple threads if the cache is not modified.
+     */
+    bool lookup (Key view_1_key, Key view_2_key,
+        CorrespondenceIndices* matches) const;
+
+    /** Inserts or replaces the matches for the given pair of views. */
+    void insert (Key view_1_key, Key view_2_key,
+        CorrespondenceIndices const& matches);
+
+    /** Returns the number of cached pairs. */
+    std::size_t size (void) const;
+
+private:
+    typedef std::map<std::pair<Key, Key>, CorrespondenceIndices> Entries;
+
+    Key options_hash;
+    Entries entries;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline std::size_t
+MatchCache::size (void) const
+{
+    return this->entries.size();
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_MATCH_CACHE_HEADER */
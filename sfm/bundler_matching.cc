@@ -0,0 +1,736 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "util/file_system.h"
+#include "util/profiler.h"
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "math/defines.h"
+#include "sfm/bundler_matching.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    /* A range of consecutive view IDs. */
+    struct ViewBlock
+    {
+        int begin;
+        int end;
+
+        bool contains (int view_id) const
+        {
+            return view_id >= this->begin && view_id < this->end;
+        }
+    };
+
+    /*
+     * Returns the two blocks of views of a shard. Shard IDs enumerate the
+     * block pairs (a, b), a <= b, as a + b * (b + 1) / 2.
+     */
+    void
+    get_shard_blocks (std::size_t num_views, int num_blocks, int shard_id,
+        ViewBlock* block_a, ViewBlock* block_b)
+    {
+        if (shard_id < 0 || shard_id >= Matching::get_num_shards(num_blocks))
+            throw std::invalid_argument("Invalid shard ID");
+
+        int const b = static_cast<int>((std::sqrt(8.0 * shard_id + 1.0)
+            - 1.0) / 2.0);
+        int const a = shard_id - b * (b + 1) / 2;
+        std::int64_t const views = static_cast<std::int64_t>(num_views);
+        block_a->begin = static_cast<int>(views * a / num_blocks);
+        block_a->end = static_cast<int>(views * (a + 1) / num_blocks);
+        block_b->begin = static_cast<int>(views * b / num_blocks);
+        block_b->end = static_cast<int>(views * (b + 1) / num_blocks);
+    }
+
+    /* Converts latitude, longitude and altitude to WGS84 earth-centered. */
+    math::Vec3d
+    gps_to_ecef (math::Vec3d const& gps)
+    {
+        double const a = 6378137.0;
+        double const e2 = 6.69437999014e-3;
+        double const lat = MATH_DEG2RAD(gps[0]);
+        double const lon = MATH_DEG2RAD(gps[1]);
+        double const n = a / std::sqrt(1.0 - e2 * MATH_POW2(std::sin(lat)));
+        return math::Vec3d(
+            (n + gps[2]) * std::cos(lat) * std::cos(lon),
+            (n + gps[2]) * std::cos(lat) * std::sin(lon),
+            (n * (1.0 - e2) + gps[2]) * std::sin(lat));
+    }
+
+    /*
+     * Exact nearest neighbor search over 3D points with an implicit kd-tree,
+     * which splits the sorted point IDs at the median and cycles the axes.
+     */
+    class SpatialIndex
+    {
+    public:
+        /* Pairs of squared distance and point ID, ascending by distance. */
+        typedef std::vector<std::pair<double, int> > Results;
+
+    public:
+        explicit SpatialIndex (std::vector<math::Vec3d> const& points);
+
+        /*
+         * Finds the k nearest points with a distance of at most max_dist,
+         * excluding the query point. k = 0 finds all points in the radius.
+         */
+        void find (int query_id, std::size_t k, double max_dist,
+            Results* results) const;
+
+    private:
+        void build (int begin, int end, int axis);
+        void search (int begin, int end, int axis, int query_id,
+            std::size_t k, double max_dist2, Results* heap) const;
+
+    private:
+        std::vector<math::Vec3d> const& points;
+        std::vector<int> ids;
+    };
+
+    SpatialIndex::SpatialIndex (std::vector<math::Vec3d> const& points)
+        : points(points)
+        , ids(points.size())
+    {
+        for (std::size_t i = 0; i < this->ids.size(); ++i)
+            this->ids[i] = static_cast<int>(i);
+        this->build(0, static_cast<int>(this->ids.size()), 0);
+    }
+
+    void
+    SpatialIndex::build (int begin, int end, int axis)
+    {
+        if (end - begin < 2)
+            return;
+        int const mid = (begin + end) / 2;
+        std::vector<math::Vec3d> const& pts = this->points;
+        std::nth_element(this->ids.begin() + begin, this->ids.begin() + mid,
+            this->ids.begin() + end, [&pts, axis] (int a, int b)
+            { return pts[a][axis] < pts[b][axis]; });
+        this->build(begin, mid, (axis + 1) % 3);
+        this->build(mid + 1, end, (axis + 1) % 3);
+    }
+
+    void
+    SpatialIndex::find (int query_id, std::size_t k, double max_dist,
+        Results* results) const
+    {
+        double const max_dist2 = max_dist > 0.0 ? MATH_POW2(max_dist)
+            : std::numeric_limits<double>::infinity();
+        results->clear();
+        this->search(0, static_cast<int>(this->ids.size()), 0, query_id,
+            k, max_dist2, results);
+        std::sort_heap(results->begin(), results->end());
+    }
+
+    void
+    SpatialIndex::search (int begin, int end, int axis, int query_id,
+        std::size_t k, double max_dist2, Results* heap) const
+    {
+        if (begin >= end)
+            return;
+
+        /* The heap holds the farthest result on top. */
+        int const mid = (begin + end) / 2;
+        int const id = this->ids[mid];
+        math::Vec3d const& query = this->points[query_id];
+        double const dist2 = (this->points[id] - query).square_norm();
+        bool const full = k > 0 && heap->size() == k;
+        if (id != query_id && dist2 <= max_dist2
+            && (!full || dist2 < heap->front().first))
+        {
+            if (full)
+            {
+                std::pop_heap(heap->begin(), heap->end());
+                heap->pop_back();
+            }
+            heap->push_back(std::make_pair(dist2, id));
+            std::push_heap(heap->begin(), heap->end());
+        }
+
+        /* The far side is searched if the split is within the bound. */
+        double const diff = query[axis] - this->points[id][axis];
+        int const next = (axis + 1) % 3;
+        if (diff < 0.0)
+            this->search(begin, mid, next, query_id, k, max_dist2, heap);
+        else
+            this->search(mid + 1, end, next, query_id, k, max_dist2, heap);
+
+        double bound2 = max_dist2;
+        if (k > 0 && heap->size() == k)
+            bound2 = std::min(bound2, heap->front().first);
+        if (MATH_POW2(diff) > bound2)
+            return;
+        if (diff < 0.0)
+            this->search(mid + 1, end, next, query_id, k, max_dist2, heap);
+        else
+            this->search(begin, mid, next, query_id, k, max_dist2, heap);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+Matching::Matching (Options const& options, Progress* progress)
+    : opts(options)
+    , progress(progress)
+    , viewports(nullptr)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::init (ViewportList* viewports)
+{
+    if (viewports == nullptr)
+        throw std::invalid_argument("Viewports must not be null");
+
+    this->viewports = viewports;
+    this->matcher = features::MatchingBase::create(this->opts.matcher_type);
+    this->matcher->opts.sift_pca = this->opts.sift_pca;
+    this->matcher->opts.sift_pca_dimensions = this->opts.sift_pca_dimensions;
+    this->matcher->init(viewports);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::compute (PairwiseMatching* pairwise_matching)
+{
+    UTIL_PROFILE_SCOPE("Matching::compute");
+    if (this->viewports == nullptr || this->matcher == nullptr)
+        throw std::runtime_error("Matching not initialized");
+
+    pairwise_matching->clear();
+
+    /* Without pair selection and shards, all pairs are enumerated. */
+    ViewPairs pairs;
+    std::int64_t num_pairs = 0;
+    bool const use_retrieval = this->opts.num_retrieval_candidates > 0;
+    bool const use_sequential = this->opts.sequential_window > 0;
+    bool const use_gps = this->opts.gps_num_neighbors > 0
+        || this->opts.gps_max_distance > 0.0;
+    bool const use_shards = this->opts.num_shard_blocks > 1;
+    bool const use_selection = use_retrieval || use_sequential || use_gps;
+    bool const use_pairs = use_selection || use_shards;
+    if (use_retrieval)
+        this->retrieve_pairs(use_sequential ? static_cast<std::size_t>
+            (std::max(1, this->opts.loop_closure_interval)) : 1, &pairs);
+    if (use_sequential)
+        this->add_sequential_pairs(&pairs);
+    if (use_gps)
+        this->add_gps_pairs(&pairs);
+    if (use_shards)
+        this->select_shard_pairs(use_selection, &pairs);
+    if (use_pairs)
+        num_pairs = static_cast<std::int64_t>(pairs.size());
+    else
+    {
+        std::int64_t const num_viewports
+            = static_cast<std::int64_t>(this->viewports->size());
+        num_pairs = num_viewports * (num_viewports - 1) / 2;
+    }
+
+    std::size_t num_done = 0;
+    std::size_t num_matched = 0;
+    std::size_t num_pruned = 0;
+    std::size_t num_cached = 0;
+
+    /* Pairs are identified in the cache by the content of their views. */
+    bool const use_cache = !this->opts.match_cache_file.empty();
+    MatchCache cache(this->get_options_hash());
+    std::vector<MatchCache::Key> view_keys;
+    PairwiseMatching new_entries;
+    if (use_cache)
+    {
+        view_keys.resize(this->viewports->size());
+#pragma omp parallel for schedule(dynamic)
+        for (std::size_t i = 0; i < view_keys.size(); ++i)
+            view_keys[i] = MatchCache::hash_features(
+                this->viewports->at(i).features);
+
+        std::string const& filename = this->opts.match_cache_file;
+        if (util::fs::file_exists(filename.c_str())
+            && !cache.load_from_file(filename) && this->opts.verbose_output)
+            std::cout << "Match cache " << filename << " was created with "
+                << "different options, ignoring." << std::endl;
+    }
+
+    if (this->progress != nullptr)
+    {
+        this->progress->num_total = static_cast<std::size_t>(num_pairs);
+        this->progress->num_done = 0;
+        this->progress->num_matched = 0;
+        this->progress->num_pruned = 0;
+        this->progress->num_cached = 0;
+        this->progress->pairs_per_second = 0.0f;
+    }
+
+    util::WallTimer timer;
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (std::int64_t i = 0; i < num_pairs; ++i)
+    {
+        if (this->opts.control.is_cancelled())
+            continue;
+
+        int view_1_id, view_2_id;
+        if (use_pairs)
+        {
+            view_1_id = pairs[i].first;
+            view_2_id = pairs[i].second;
+        }
+        else
+        {
+            /* Inverts the pair index i = v2 * (v2 - 1) / 2 + v1, v1 < v2. */
+            view_2_id = static_cast<int>
+                (0.5 + std::sqrt(0.25 + 2.0 * static_cast<double>(i)));
+            view_1_id = static_cast<int>(i
+                - static_cast<std::int64_t>(view_2_id) * (view_2_id - 1) / 2);
+        }
+
+        CorrespondenceIndices matches;
+        bool const cached = use_cache && cache.lookup(view_keys[view_1_id],
+            view_keys[view_2_id], &matches);
+
+        /* Most pairs share nothing and are rejected with few features. */
+        bool const pruned = !cached && this->opts.preemptive_num_features > 0
+            && this->matcher->pairwise_match_lowres(view_1_id, view_2_id,
+            static_cast<std::size_t>(this->opts.preemptive_num_features))
+            < this->opts.preemptive_threshold;
+
+        if (!cached && !pruned)
+            this->two_view_matching(view_1_id, view_2_id, &matches);
+        bool const keep = static_cast<int>(matches.size())
+            >= this->opts.min_feature_matches;
+
+#pragma omp critical
+        {
+            num_done += 1;
+            num_pruned += pruned ? 1 : 0;
+            num_cached += cached ? 1 : 0;
+
+            /* The cache is only updated after all lookups are done. */
+            if (use_cache && !cached)
+            {
+                new_entries.push_back(TwoViewMatching());
+                new_entries.back().view_1_id = view_1_id;
+                new_entries.back().view_2_id = view_2_id;
+                new_entries.back().matches = matches;
+            }
+            if (keep)
+            {
+                num_matched += 1;
+                pairwise_matching->push_back(TwoViewMatching());
+                TwoViewMatching& tvm = pairwise_matching->back();
+                tvm.view_1_id = view_1_id;
+                tvm.view_2_id = view_2_id;
+                std::swap(tvm.matches, matches);
+            }
+
+            if (this->progress != nullptr)
+            {
+                this->progress->num_done = num_done;
+                this->progress->num_matched = num_matched;
+                this->progress->num_pruned = num_pruned;
+                this->progress->num_cached = num_cached;
+                this->progress->pairs_per_second = static_cast<float>
+                    (num_done) / std::max(0.001f, timer.get_elapsed_sec());
+            }
+            this->opts.control.report(num_done,
+                static_cast<std::size_t>(num_pairs));
+        }
+    }
+
+    /* Pairs finish in arbitrary order, sort for a deterministic result. */
+    std::sort(pairwise_matching->begin(), pairwise_matching->end());
+
+    if (use_cache && !new_entries.empty())
+    {
+        for (std::size_t i = 0; i < new_entries.size(); ++i)
+            cache.insert(view_keys[new_entries[i].view_1_id],
+                view_keys[new_entries[i].view_2_id], new_entries[i].matches);
+        cache.save_to_file(this->opts.match_cache_file);
+    }
+    this->opts.control.check_cancelled("Matching cancelled");
+
+    float const pairs_per_second = static_cast<float>(num_pairs)
+        / std::max(0.001f, timer.get_elapsed_sec());
+    if (this->progress != nullptr)
+        this->progress->pairs_per_second = pairs_per_second;
+
+    if (this->opts.verbose_output)
+    {
+        if (use_shards)
+            std::cout << "Shard " << this->opts.shard_id << " of "
+                << get_num_shards(this->opts.num_shard_blocks) << ": ";
+        std::cout << "Matched " << num_pairs << " view pairs in "
+            << timer.get_elapsed() << "ms (" << pairs_per_second
+            << " pairs/s), " << num_matched << " pairs with at least "
+            << this->opts.min_feature_matches << " matches." << std::endl;
+        if (this->opts.preemptive_num_features > 0)
+            std::cout << "Preemptive matching pruned " << num_pruned
+                << " of " << num_pairs << " view pairs." << std::endl;
+        if (use_cache)
+            std::cout << "Loaded " << num_cached << " of " << num_pairs
+                << " view pairs from the match cache." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+MatchCache::Key
+Matching::get_options_hash (void) const
+{
+    /* The version changes whenever matching results change. */
+    int32_t const values[4] = { 1,
+        static_cast<int32_t>(this->opts.matcher_type),
+        this->opts.preemptive_num_features, this->opts.preemptive_threshold };
+    MatchCache::Key hash = MatchCache::hash_data(values, sizeof(values));
+
+    features::Matching::Options const* matching_opts[2] = {
+        &this->matcher->opts.sift_matching_opts,
+        &this->matcher->opts.surf_matching_opts };
+    for (int i = 0; i < 2; ++i)
+    {
+        features::Matching::Options const& mo = *matching_opts[i];
+        hash = MatchCache::hash_data(&mo.descriptor_length,
+            sizeof(int), hash);
+        hash = MatchCache::hash_data(&mo.lowe_ratio_threshold,
+            sizeof(float), hash);
+        hash = MatchCache::hash_data(&mo.distance_threshold,
+            sizeof(float), hash);
+        hash = MatchCache::hash_data(&mo.kd_forest_checks,
+            sizeof(int), hash);
+    }
+
+    /* The PCA only changes the hash if it is used. */
+    if (this->opts.sift_pca != nullptr)
+    {
+        std::vector<float> const& axes = this->opts.sift_pca->get_axes();
+        hash = MatchCache::hash_data(&this->opts.sift_pca_dimensions,
+            sizeof(int), hash);
+        hash = MatchCache::hash_data(axes.data(),
+            axes.size() * sizeof(float), hash);
+    }
+    return hash;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::retrieve_pairs (std::size_t query_step, ViewPairs* pairs)
+{
+    util::WallTimer timer;
+    ViewportList const& views = *this->viewports;
+
+    /* Train with a regular subsample of all SIFT descriptors. */
+    std::size_t num_descriptors = 0;
+    for (std::size_t i = 0; i < views.size(); ++i)
+        num_descriptors += views[i].features.sift_descriptors.size();
+    std::size_t const max_descriptors
+        = std::max<std::size_t>(1, this->opts.max_training_descriptors);
+    std::size_t const step = (num_descriptors + max_descriptors - 1)
+        / max_descriptors;
+
+    features::Sift::Descriptors training;
+    training.reserve(std::min(num_descriptors, max_descriptors));
+    std::size_t counter = 0;
+    for (std::size_t i = 0; i < views.size(); ++i)
+    {
+        features::Sift::Descriptors const& descr
+            = views[i].features.sift_descriptors;
+        for (std::size_t j = 0; j < descr.size(); ++j, ++counter)
+            if (counter % step == 0)
+                training.push_back(descr[j]);
+    }
+    if (training.empty())
+        throw std::runtime_error("No SIFT descriptors for retrieval");
+
+    features::VocabularyTree tree(this->opts.vocabulary_tree_opts);
+    tree.train(training);
+    training.clear();
+    training.shrink_to_fit();
+    for (std::size_t i = 0; i < views.size(); ++i)
+        tree.add_image(views[i].features.sift_descriptors);
+    tree.compute_weights();
+
+    /* Query the views, the view itself is usually the best result. */
+    std::size_t const num_candidates
+        = static_cast<std::size_t>(this->opts.num_retrieval_candidates);
+    std::vector<ViewPairs> view_pairs(views.size());
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (std::size_t i = 0; i < views.size(); ++i)
+    {
+        if (i % query_step != 0)
+            continue;
+        features::VocabularyTree::QueryResults results;
+        tree.query(views[i].features.sift_descriptors,
+            num_candidates + 1, &results);
+        int const view_id = static_cast<int>(i);
+        for (std::size_t j = 0, num = 0; j < results.size()
+            && num < num_candidates; ++j)
+        {
+            int const other_id = results[j].image_id;
+            if (other_id == view_id)
+                continue;
+            view_pairs[i].push_back(std::make_pair(
+                std::min(view_id, other_id), std::max(view_id, other_id)));
+            num += 1;
+        }
+    }
+
+    /* Pairs retrieved from both views are matched only once. */
+    pairs->clear();
+    for (std::size_t i = 0; i < view_pairs.size(); ++i)
+        pairs->insert(pairs->end(), view_pairs[i].begin(), view_pairs[i].end());
+    std::sort(pairs->begin(), pairs->end());
+    pairs->erase(std::unique(pairs->begin(), pairs->end()), pairs->end());
+
+    if (this->opts.verbose_output)
+    {
+        std::size_t const num_all_pairs = views.size() * (views.size() - 1) / 2;
+        std::cout << "Retrieval selected " << pairs->size() << " of "
+            << num_all_pairs << " view pairs (" << tree.get_num_words()
+            << " words) in " << timer.get_elapsed() << "ms." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::add_sequential_pairs (ViewPairs* pairs)
+{
+    std::size_t const num_retrieved = pairs->size();
+    int const num_views = static_cast<int>(this->viewports->size());
+    int const window = this->opts.sequential_window;
+    for (int i = 0; i < num_views; ++i)
+        for (int j = i + 1; j < num_views && j <= i + window; ++j)
+            pairs->push_back(std::make_pair(i, j));
+    std::sort(pairs->begin(), pairs->end());
+    pairs->erase(std::unique(pairs->begin(), pairs->end()), pairs->end());
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Sequential matching with a window of " << window
+            << " views selected " << pairs->size() << " view pairs, "
+            << num_retrieved << " retrieved." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::add_gps_pairs (ViewPairs* pairs)
+{
+    util::WallTimer timer;
+    ViewportList const& views = *this->viewports;
+    int const num_views = static_cast<int>(views.size());
+    std::size_t const num_selected = pairs->size();
+
+    /* Views without GPS are paired with all other views. */
+    std::vector<int> gps_view_ids;
+    std::vector<math::Vec3d> positions;
+    for (int i = 0; i < num_views; ++i)
+    {
+        if (views[i].has_gps)
+        {
+            gps_view_ids.push_back(i);
+            positions.push_back(gps_to_ecef(views[i].gps_position));
+            continue;
+        }
+        for (int j = 0; j < num_views; ++j)
+            if (j != i && (j > i || views[j].has_gps))
+                pairs->push_back(std::make_pair(std::min(i, j),
+                    std::max(i, j)));
+    }
+
+    SpatialIndex index(positions);
+    std::size_t const k = static_cast<std::size_t>
+        (std::max(0, this->opts.gps_num_neighbors));
+    std::int64_t const num_gps_views
+        = static_cast<std::int64_t>(gps_view_ids.size());
+    std::vector<ViewPairs> view_pairs(gps_view_ids.size());
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (std::int64_t i = 0; i < num_gps_views; ++i)
+    {
+        SpatialIndex::Results results;
+        index.find(static_cast<int>(i), k, this->opts.gps_max_distance,
+            &results);
+        int const view_id = gps_view_ids[i];
+        for (std::size_t j = 0; j < results.size(); ++j)
+        {
+            int const other_id = gps_view_ids[results[j].second];
+            view_pairs[i].push_back(std::make_pair(
+                std::min(view_id, other_id), std::max(view_id, other_id)));
+        }
+    }
+
+    for (std::size_t i = 0; i < view_pairs.size(); ++i)
+        pairs->insert(pairs->end(), view_pairs[i].begin(), view_pairs[i].end());
+    std::sort(pairs->begin(), pairs->end());
+    pairs->erase(std::unique(pairs->begin(), pairs->end()), pairs->end());
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "GPS positions of " << gps_view_ids.size() << " of "
+            << num_views << " views selected " << pairs->size()
+            << " view pairs, " << num_selected << " selected before, in "
+            << timer.get_elapsed() << "ms." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::select_shard_pairs (bool filter, ViewPairs* pairs)
+{
+    ViewBlock block_a, block_b;
+    get_shard_blocks(this->viewports->size(), this->opts.num_shard_blocks,
+        this->opts.shard_id, &block_a, &block_b);
+
+    /* Retrieved pairs are ordered, block a is never after block b. */
+    if (filter)
+    {
+        pairs->erase(std::remove_if(pairs->begin(), pairs->end(),
+            [&block_a, &block_b] (std::pair<int, int> const& pair)
+            {
+                return !block_a.contains(pair.first)
+                    || !block_b.contains(pair.second);
+            }), pairs->end());
+        return;
+    }
+
+    pairs->clear();
+    for (int view_2_id = block_b.begin; view_2_id < block_b.end; ++view_2_id)
+        for (int view_1_id = block_a.begin; view_1_id < block_a.end
+            && view_1_id < view_2_id; ++view_1_id)
+            pairs->push_back(std::make_pair(view_1_id, view_2_id));
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::get_shard_views (std::size_t num_views, int num_shard_blocks,
+    int shard_id, std::vector<int>* view_ids)
+{
+    view_ids->clear();
+    if (num_shard_blocks < 2)
+    {
+        for (std::size_t i = 0; i < num_views; ++i)
+            view_ids->push_back(static_cast<int>(i));
+        return;
+    }
+
+    ViewBlock block_a, block_b;
+    get_shard_blocks(num_views, num_shard_blocks, shard_id,
+        &block_a, &block_b);
+    for (int i = block_a.begin; i < block_a.end; ++i)
+        view_ids->push_back(i);
+    for (int i = std::max(block_a.end, block_b.begin); i < block_b.end; ++i)
+        view_ids->push_back(i);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::merge_shards (std::vector<std::string> const& filenames,
+    ViewportList* viewports, PairwiseMatching* pairwise_matching)
+{
+    viewports->clear();
+    pairwise_matching->clear();
+    for (std::size_t i = 0; i < filenames.size(); ++i)
+    {
+        PrebundleFile file;
+        file.open(filenames[i]);
+        if (i == 0)
+            viewports->resize(file.get_num_views());
+        else if (file.get_num_views() != viewports->size())
+            throw std::invalid_argument("Shards with different views");
+
+        for (std::size_t j = 0; j < file.get_num_views(); ++j)
+            if (viewports->at(j).features.positions.empty())
+                file.get_viewport(j, &viewports->at(j));
+
+        std::size_t const offset = pairwise_matching->size();
+        pairwise_matching->resize(offset + file.get_num_pairs());
+        for (std::size_t j = 0; j < file.get_num_pairs(); ++j)
+            file.get_matching(j, &pairwise_matching->at(offset + j));
+    }
+
+    std::sort(pairwise_matching->begin(), pairwise_matching->end());
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::init_view (int view_id)
+{
+    if (this->viewports == nullptr || this->matcher == nullptr)
+        throw std::runtime_error("Matching not initialized");
+    this->matcher->init_view(*this->viewports, view_id);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::match_pair (int view_1_id, int view_2_id,
+    CorrespondenceIndices* matches)
+{
+    if (this->viewports == nullptr || this->matcher == nullptr)
+        throw std::runtime_error("Matching not initialized");
+
+    matches->clear();
+    if (this->opts.preemptive_num_features > 0
+        && this->matcher->pairwise_match_lowres(view_1_id, view_2_id,
+        static_cast<std::size_t>(this->opts.preemptive_num_features))
+        < this->opts.preemptive_threshold)
+        return;
+
+    this->two_view_matching(view_1_id, view_2_id, matches);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Matching::two_view_matching (int view_1_id, int view_2_id,
+    CorrespondenceIndices* matches)
+{
+    UTIL_PROFILE_SCOPE("Matching::two_view_matching");
+    features::Matching::Result result;
+    this->matcher->pairwise_match(view_1_id, view_2_id, &result);
+
+    /* Keep the matches that are consistent in both directions. */
+    matches->clear();
+    for (std::size_t i = 0; i < result.matches_1_2.size(); ++i)
+    {
+        int const j = result.matches_1_2[i];
+        if (j < 0 || result.matches_2_1[j] != static_cast<int>(i))
+            continue;
+        matches->push_back(CorrespondenceIndex(static_cast<int>(i), j));
+    }
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_MATCHING_HEADER
+#define SFM_BUNDLER_MATCHING_HEADER
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util/progress.h"
+#include "features/descriptor_pca.h"
+#include "features/matching.h"
+#include "features/matching_base.h"
+#include "features/vocabulary_tree.h"
+#include "sfm/bundler_common.h"
+#include "sfm/bundler_match_cache.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Matching between all pairs of views.
+ *
+ * The features of all views are preprocessed once by the matcher, then all
+ * pairs of views are matched in parallel. Pairs are dynamically scheduled
+ * over the threads since matching times differ a lot between pairs. The
+ * matching results are reduced to the consistent correspondences and
+ * added to the pairwise matching immediately, so that only the results of
+ * the pairs in progress are held in memory.
+ *
+ * Optionally, a vocabulary tree over the SIFT descriptors selects the
+ * most similar views for every view and only these pairs are matched.
+ * For ordered images, e.g. video frames, sequential matching matches
+ * every view with a window of the following views, and the vocabulary
+ * tree adds loop closure pairs for a regular subset of the views. This
+ * reduces the number of pairs from O(n^2) to O(n K) for a window of K.
+ * With GPS positions, every view is matched with its nearest views only.
+ * Pairs can further be rejected early by preemptive matching of the
+ * features with the largest scale. With a match cache file, the results
+ * of pairs with unchanged features are reused from previous runs.
+ *
+ * For large datasets, matching can be split into independent shards, which
+ * run on different nodes. The views are split into blocks of consecutive
+ * view IDs, and every shard matches the pairs of one pair of blocks. A
+ * shard only requires the features of the views in its two blocks, the
+ * features of the other views can be empty. Every shard saves its
+ * pairwise matching as pre-bundle, and merge_shards() combines them.
+ */
+class Matching
+{
+public:
+    /** Options for pairwise matching. */
+    struct Options
+    {
+        Options (void);
+
+        /** The matcher implementation. */
+        features::MatchingBase::MatcherType matcher_type;
+
+        /** Minimum number of feature matches to keep a pair of views. */
+        int min_feature_matches;
+
+        /**
+         * Number of most similar views retrieved for every view with a
+         * vocabulary tree. Only these pairs are matched, 0 matches all pairs.
+         */
+        int num_retrieval_candidates;
+
+        /**
+         * Number of following views every view is matched with for ordered
+         * images. With retrieval, the retrieved pairs of every
+         * loop_closure_interval-th view are matched as well. 0 disables
+         * sequential matching.
+         */
+        int sequential_window;
+
+        /** Views between the loop closure queries. Defaults to 10. */
+        int loop_closure_interval;
+
+        /**
+         * Number of nearest views by EXIF GPS position every view is
+         * matched with, e.g. for aerial images. Views without GPS are
+         * matched with all views. 0 matches all views within the distance.
+         */
+        int gps_num_neighbors;
+
+        /**
+         * Maximum distance in meters of the views matched by GPS position.
+         * 0 does not limit the distance. If both this and gps_num_neighbors
+         * are 0, GPS positions are not used.
+         */
+        double gps_max_distance;
+
+        /** Maximum number of SIFT descriptors to train the tree with. */
+        std::size_t max_training_descriptors;
+
+        /** Options for the vocabulary tree. */
+        features::VocabularyTree::Options vocabulary_tree_opts;
+
+        /**
+         * Number of features with the largest scale used for preemptive
+         * matching. Pairs with less than preemptive_threshold matches among
+         * these features are not fully matched. 0 disables the stage.
+         */
+        int preemptive_num_features;
+
+        /** Minimum number of preemptive matches for full matching. */
+        int preemptive_threshold;
+
+        /**
+         * Optional PCA of SIFT descriptors, e.g. computed offline and loaded
+         * with DescriptorPca::load_from_file(). The exhaustive matcher then
+         * matches the descriptors projected to sift_pca_dimensions axes,
+         * which reduces matching time and memory. Defaults to none.
+         */
+        std::shared_ptr<features::DescriptorPca const> sift_pca;
+
+        /** Number of principal axes of the SIFT PCA. Defaults to 64. */
+        int sift_pca_dimensions;
+
+        /**
+         * File name of the persistent match cache, which is loaded if it
+         * exists and updated with the new pairs. Empty disables the cache.
+         */
+        std::string match_cache_file;
+
+        /**
+         * Number of blocks of views for sharded matching, which gives
+         * B * (B + 1) / 2 shards for B blocks. Only the pairs of the shard
+         * with ID shard_id are matched. With retrieval, the retrieved pairs
+         * are restricted to the shard, which requires all SIFT features.
+         * Every shard should use its own match cache file. Values below 2
+         * disable sharding.
+         */
+        int num_shard_blocks;
+
+        /** The shard to match, in [0, get_num_shards(num_shard_blocks)). */
+        int shard_id;
+
+        /** Number of threads, 0 uses util::ThreadPool::get_num_threads(). */
+        int num_threads;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+
+        /**
+         * Cancellation is checked before every pair. Pairs in progress are
+         * finished, the finished pairs are added to the match cache, and
+         * compute() throws util::CancelledException. A new run with the
+         * same cache file thus resumes with the remaining pairs. Progress
+         * is reported after every pair.
+         */
+        util::StageControl control;
+    };
+
+    /**
+     * The state of the matching, which can be read while matching is in
+     * progress, e.g. from another thread.
+     */
+    struct Progress
+    {
+        /** The number of pairs to be matched. */
+        std::size_t num_total;
+        /** The number of matched pairs. */
+        std::size_t num_done;
+        /** The number of pairs with enough matches. */
+        std::size_t num_matched;
+        /** The number of pairs rejected by preemptive matching. */
+        std::size_t num_pruned;
+        /** The number of pairs loaded from the match cache. */
+        std::size_t num_cached;
+        /** The matching throughput in pairs per second. */
+        float pairs_per_second;
+    };
+
+public:
+    explicit Matching (Options const& options, Progress* progress = nullptr);
+
+    /** Initializes the matcher with the features of the given views. */
+    void init (ViewportList* viewports);
+
+    /**
+     * Matches all pairs of views and stores the pairs with enough matches
+     * in the pairwise matching, which is sorted by view IDs.
+     */
+    void compute (PairwiseMatching* pairwise_matching);
+
+    /**
+     * Prepares the features of a view that have been computed after
+     * init(), for streaming where pairs are matched while the features of
+     * other views are computed. Only the exhaustive matcher supports this.
+     */
+    void init_view (int view_id);
+
+    /**
+     * Matches a single pair of views with preemptive matching, without
+     * pair selection and the match cache. The matches are empty for pairs
+     * rejected by preemptive matching, and are kept for pairs with less
+     * than min_feature_matches like the entries of the match cache. Pairs
+     * can be matched concurrently.
+     */
+    void match_pair (int view_1_id, int view_2_id,
+        CorrespondenceIndices* matches);
+
+    /**
+     * Returns the hash of all options that affect matching results, which
+     * identifies match cache files. Requires init().
+     */
+    MatchCache::Key get_options_hash (void) const;
+
+    /** Returns the number of shards for the number of blocks. */
+    static int get_num_shards (int num_shard_blocks);
+
+    /**
+     * Returns the sorted IDs of the views whose features are required to
+     * match the given shard. Without sharding, these are all views.
+     */
+    static void get_shard_views (std::size_t num_views, int num_shard_blocks,
+        int shard_id, std::vector<int>* view_ids);
+
+    /**
+     * Loads the pre-bundle files of all shards and merges them. The file
+     * of every view with features provides its features, and the pairs of
+     * all files are combined and sorted by view IDs.
+     */
+    static void merge_shards (std::vector<std::string> const& filenames,
+        ViewportList* viewports, PairwiseMatching* pairwise_matching);
+
+private:
+    typedef std::vector<std::pair<int, int> > ViewPairs;
+
+    /**
+     * Selects the view pairs to match with the vocabulary tree. Only every
+     * query_step-th view is queried, all views can be retrieved.
+     */
+    void retrieve_pairs (std::size_t query_step, ViewPairs* pairs);
+
+    /** Adds the pairs of the sequential window to the sorted pairs. */
+    void add_sequential_pairs (ViewPairs* pairs);
+
+    /** Adds the pairs of neighboring GPS positions to the sorted pairs. */
+    void add_gps_pairs (ViewPairs* pairs);
+
+    /**
+     * Restricts the pairs to the shard. Without filtering, all pairs of
+     * the shard are enumerated instead.
+     */
+    void select_shard_pairs (bool filter, ViewPairs* pairs);
+
+    /** Matches a pair of views and keeps consistent correspondences. */
+    void two_view_matching (int view_1_id, int view_2_id,
+        CorrespondenceIndices* matches);
+
+private:
+    Options opts;
+    Progress* progress;
+    ViewportList* viewports;
+    std::unique_ptr<features::MatchingBase> matcher;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Matching::Options::Options (void)
+    : matcher_type(features::MatchingBase::MATCHER_EXHAUSTIVE)
+    , min_feature_matches(24)
+    , num_retrieval_candidates(0)
+    , sequential_window(0)
+    , loop_closure_interval(10)
+    , gps_num_neighbors(0)
+    , gps_max_distance(0.0)
+    , max_training_descriptors(200000)
+    , preemptive_num_features(0)
+    , preemptive_threshold(2)
+    , sift_pca_dimensions(64)
+    , num_shard_blocks(0)
+    , shard_id(0)
+    , num_threads(0)
+    , verbose_output(false)
+{
+}
+
+inline int
+Matching::get_num_shards (int num_shard_blocks)
+{
+    return num_shard_blocks < 2 ? 1
+        : num_shard_blocks * (num_shard_blocks + 1) / 2;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_MATCHING_HEADER */
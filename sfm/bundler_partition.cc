@@ -0,0 +1,605 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "math/transform.h"
+#include "sfm/bundler_partition.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    /* The weighted view graph, the weights are the numbers of matches. */
+    typedef std::vector<std::vector<std::pair<int, double> > > ViewGraph;
+
+    void
+    build_view_graph (std::size_t num_views, PairwiseMatching const& matching,
+        ViewGraph* graph)
+    {
+        graph->clear();
+        graph->resize(num_views);
+        for (std::size_t i = 0; i < matching.size(); ++i)
+        {
+            TwoViewMatching const& tvm = matching[i];
+            double const weight = static_cast<double>(tvm.matches.size());
+            if (weight <= 0.0)
+                continue;
+            graph->at(tvm.view_1_id).push_back(
+                std::make_pair(tvm.view_2_id, weight));
+            graph->at(tvm.view_2_id).push_back(
+                std::make_pair(tvm.view_1_id, weight));
+        }
+    }
+
+    /*
+     * Splits the cluster with the normalized cut of the view graph. The
+     * relaxed solution is the eigenvector of the second largest eigenvalue
+     * of D^-1/2 W D^-1/2, computed by power iteration orthogonal to the
+     * largest eigenvector D^1/2 1. The views are ordered by the solution,
+     * and the split with the smallest normalized cut is selected, where
+     * each part has at least a quarter of the views.
+     */
+    void
+    bisect_cluster (ViewGraph const& graph, std::vector<int> const& cluster,
+        int num_iterations, std::vector<int>* part_1, std::vector<int>* part_2)
+    {
+        std::size_t const size = cluster.size();
+        std::vector<int> local_ids(graph.size(), -1);
+        for (std::size_t i = 0; i < size; ++i)
+            local_ids[cluster[i]] = static_cast<int>(i);
+
+        /* The cluster graph, isolated views get a unit degree. */
+        ViewGraph local(size);
+        std::vector<double> degree(size, 0.0);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            std::vector<std::pair<int, double> > const& edges
+                = graph[cluster[i]];
+            for (std::size_t j = 0; j < edges.size(); ++j)
+            {
+                int const other = local_ids[edges[j].first];
+                if (other < 0)
+                    continue;
+                local[i].push_back(std::make_pair(other, edges[j].second));
+                degree[i] += edges[j].second;
+            }
+            degree[i] = std::max(1.0, degree[i]);
+        }
+
+        std::vector<double> top(size);
+        double top_norm = 0.0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            top[i] = std::sqrt(degree[i]);
+            top_norm += degree[i];
+        }
+        top_norm = std::sqrt(top_norm);
+        for (std::size_t i = 0; i < size; ++i)
+            top[i] /= top_norm;
+
+        /* Power iteration with (I + D^-1/2 W D^-1/2) / 2, which is PSD. */
+        std::vector<double> vec(size), next(size);
+        for (std::size_t i = 0; i < size; ++i)
+            vec[i] = static_cast<double>((i * 7919) % size) - 0.5 * size;
+        for (int iter = 0; iter < num_iterations; ++iter)
+        {
+            double dot = 0.0;
+            for (std::size_t i = 0; i < size; ++i)
+                dot += vec[i] * top[i];
+            for (std::size_t i = 0; i < size; ++i)
+                vec[i] -= dot * top[i];
+
+            double norm = 0.0;
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                double sum = 0.0;
+                for (std::size_t j = 0; j < local[i].size(); ++j)
+                    sum += local[i][j].second * vec[local[i][j].first]
+                        / std::sqrt(degree[local[i][j].first]);
+                next[i] = 0.5 * (vec[i] + sum / std::sqrt(degree[i]));
+                norm += next[i] * next[i];
+            }
+            norm = std::sqrt(norm);
+            if (norm <= 0.0)
+                break;
+            for (std::size_t i = 0; i < size; ++i)
+                vec[i] = next[i] / norm;
+        }
+
+        /* Sweep the views ordered by the relaxed indicator D^-1/2 v. */
+        std::vector<std::pair<double, int> > order(size);
+        double volume = 0.0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            order[i] = std::make_pair(vec[i] / std::sqrt(degree[i]),
+                static_cast<int>(i));
+            volume += degree[i];
+        }
+        std::sort(order.begin(), order.end());
+
+        std::size_t const min_size = std::max<std::size_t>(1, size / 4);
+        std::vector<char> in_part_1(size, 0);
+        double cut = 0.0;
+        double volume_1 = 0.0;
+        double best_ncut = 0.0;
+        std::size_t best_split = size / 2;
+        for (std::size_t k = 0; k + min_size < size; ++k)
+        {
+            int const view = order[k].second;
+            double weight_1 = 0.0;
+            for (std::size_t j = 0; j < local[view].size(); ++j)
+                if (in_part_1[local[view][j].first])
+                    weight_1 += local[view][j].second;
+            cut += degree[view] - 2.0 * weight_1;
+            volume_1 += degree[view];
+            in_part_1[view] = 1;
+            if (k + 1 < min_size)
+                continue;
+
+            double const ncut = cut / volume_1 + cut / (volume - volume_1);
+            if (k + 1 == min_size || ncut < best_ncut)
+            {
+                best_ncut = ncut;
+                best_split = k + 1;
+            }
+        }
+
+        part_1->clear();
+        part_2->clear();
+        for (std::size_t k = 0; k < size; ++k)
+            (k < best_split ? part_1 : part_2)->push_back(
+                cluster[order[k].second]);
+        std::sort(part_1->begin(), part_1->end());
+        std::sort(part_2->begin(), part_2->end());
+    }
+
+    /* The 3D points of the merged sub-models, indexed by view features. */
+    struct MergedPoints
+    {
+        std::vector<std::vector<int> > feature_points;
+        std::vector<math::Vec3d> points;
+    };
+
+    /* Finds the points of a sub-model that already have a merged point. */
+    void
+    find_shared_points (Partition::SubModel const& sub_model,
+        MergedPoints const& merged, std::vector<math::Vec3d>* sub_points,
+        std::vector<math::Vec3d>* merged_points)
+    {
+        sub_points->clear();
+        merged_points->clear();
+        for (std::size_t i = 0; i < sub_model.tracks.size(); ++i)
+        {
+            Track const& track = sub_model.tracks[i];
+            if (!track.is_valid())
+                continue;
+            for (std::size_t j = 0; j < track.features.size(); ++j)
+            {
+                FeatureReference const& ref = track.features[j];
+                std::vector<int> const& points = merged.feature_points
+                    [sub_model.view_ids[ref.view_id]];
+                if (points.empty() || points[ref.feature_id] < 0)
+                    continue;
+                sub_points->push_back(math::Vec3d(track.pos));
+                merged_points->push_back(
+                    merged.points[points[ref.feature_id]]);
+                break;
+            }
+        }
+    }
+
+    /*
+     * Estimates the similarity transform from the sub-model to the merged
+     * points. Correspondences with more than three times the median error
+     * are rejected and the transform is estimated again.
+     */
+    bool
+    estimate_similarity (std::vector<math::Vec3d> const& sub_points,
+        std::vector<math::Vec3d> const& merged_points, std::size_t min_points,
+        math::Matrix3d* rot, double* scale, math::Vec3d* trans)
+    {
+        std::vector<math::Vec3d> p0 = sub_points;
+        std::vector<math::Vec3d> p1 = merged_points;
+        for (int round = 0; round < 3; ++round)
+        {
+            if (p0.size() < std::max<std::size_t>(3, min_points))
+                return false;
+            if (!math::determine_transform(p0, p1, rot, scale, trans))
+                return false;
+
+            std::vector<double> errors(sub_points.size());
+            for (std::size_t i = 0; i < sub_points.size(); ++i)
+                errors[i] = (*rot * sub_points[i] * *scale + *trans
+                    - merged_points[i]).norm();
+            std::vector<double> sorted = errors;
+            std::nth_element(sorted.begin(),
+                sorted.begin() + sorted.size() / 2, sorted.end());
+            double const threshold = 3.0 * sorted[sorted.size() / 2];
+
+            p0.clear();
+            p1.clear();
+            for (std::size_t i = 0; i < sub_points.size(); ++i)
+                if (errors[i] <= threshold)
+                {
+                    p0.push_back(sub_points[i]);
+                    p1.push_back(merged_points[i]);
+                }
+        }
+        return true;
+    }
+
+    /* Adds the points of a transformed sub-model to the merged points. */
+    void
+    add_merged_points (Partition::SubModel const& sub_model,
+        math::Matrix3d const& rot, double scale, math::Vec3d const& trans,
+        MergedPoints* merged)
+    {
+        for (std::size_t i = 0; i < sub_model.view_ids.size(); ++i)
+        {
+            std::vector<int>& points
+                = merged->feature_points[sub_model.view_ids[i]];
+            if (points.empty())
+                points.resize(sub_model.viewports[i].features.positions.size(),
+                    -1);
+        }
+
+        for (std::size_t i = 0; i < sub_model.tracks.size(); ++i)
+        {
+            Track const& track = sub_model.tracks[i];
+            if (!track.is_valid())
+                continue;
+
+            /* Tracks with a merged point extend it, others are added. */
+            int point_id = -1;
+            for (std::size_t j = 0; j < track.features.size()
+                && point_id < 0; ++j)
+            {
+                FeatureReference const& ref = track.features[j];
+                point_id = merged->feature_points
+                    [sub_model.view_ids[ref.view_id]][ref.feature_id];
+            }
+            if (point_id < 0)
+            {
+                point_id = static_cast<int>(merged->points.size());
+                merged->points.push_back(rot * math::Vec3d(track.pos)
+                    * scale + trans);
+            }
+            for (std::size_t j = 0; j < track.features.size(); ++j)
+            {
+                FeatureReference const& ref = track.features[j];
+                int& feature_point = merged->feature_points
+                    [sub_model.view_ids[ref.view_id]][ref.feature_id];
+                if (feature_point < 0)
+                    feature_point = point_id;
+            }
+        }
+    }
+
+    std::size_t
+    count_registered_views (Partition::SubModel const& sub_model)
+    {
+        std::size_t num_registered = 0;
+        for (std::size_t i = 0; i < sub_model.viewports.size(); ++i)
+            if (sub_model.viewports[i].pose.is_valid())
+                num_registered += 1;
+        return num_registered;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+Partition::reconstruct (PairwiseMatching const& matching,
+    ViewportList* viewports, TrackList* tracks) const
+{
+    if (viewports == nullptr || tracks == nullptr)
+        throw std::invalid_argument("Viewports and tracks must not be null");
+
+    std::vector<std::vector<int> > clusters;
+    this->compute_clusters(viewports->size(), matching, &clusters);
+
+    /* Clusters are independent, failed clusters are not merged. */
+    std::vector<SubModel> sub_models(clusters.size());
+    std::int64_t const num_clusters = static_cast<std::int64_t>
+        (clusters.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (std::int64_t i = 0; i < num_clusters; ++i)
+    {
+        SubModel& sub_model = sub_models[i];
+        extract_sub_model(*viewports, matching, clusters[i], &sub_model);
+        try
+        {
+            if (!this->reconstruct_sub_model(&sub_model))
+                sub_model.tracks.clear();
+        }
+        catch (std::exception const& e)
+        {
+            if (this->opts.verbose_output)
+            {
+#pragma omp critical(partition_output)
+                std::cout << "Sub-model " << i << " failed: " << e.what()
+                    << std::endl;
+            }
+            for (std::size_t j = 0; j < sub_model.viewports.size(); ++j)
+                sub_model.viewports[j].pose = CameraPose();
+            sub_model.tracks.clear();
+        }
+    }
+
+    this->merge_sub_models(sub_models, viewports);
+    sub_models.clear();
+
+    /* The final reconstruction triangulates all tracks and runs full BA. */
+    Tracks(this->opts.tracks_opts).compute(matching, viewports, tracks);
+    Incremental incremental(this->opts.incremental_opts);
+    incremental.initialize(viewports, tracks);
+    incremental.reconstruct();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Partition::compute_clusters (std::size_t num_views,
+    PairwiseMatching const& matching,
+    std::vector<std::vector<int> >* clusters) const
+{
+    ViewGraph graph;
+    build_view_graph(num_views, matching, &graph);
+
+    /* Recursive bisection until the clusters are small enough. */
+    std::size_t const max_size = std::max<std::size_t>(2,
+        this->opts.max_cluster_size);
+    std::vector<std::vector<int> > stack(1);
+    for (std::size_t i = 0; i < num_views; ++i)
+        stack.back().push_back(static_cast<int>(i));
+    std::vector<std::vector<int> > cores;
+    while (!stack.empty())
+    {
+        std::vector<int> cluster;
+        std::swap(cluster, stack.back());
+        stack.pop_back();
+        if (cluster.empty())
+            continue;
+        if (cluster.size() <= max_size)
+        {
+            cores.push_back(cluster);
+            continue;
+        }
+
+        std::vector<int> part_1, part_2;
+        bisect_cluster(graph, cluster, this->opts.num_cut_iterations,
+            &part_1, &part_2);
+        stack.push_back(part_2);
+        stack.push_back(part_1);
+    }
+
+    /* Overlap with the views with most matches to the cluster. */
+    clusters->clear();
+    clusters->resize(cores.size());
+    std::vector<double> weights(num_views, 0.0);
+    std::vector<char> in_cluster(num_views, 0);
+    for (std::size_t i = 0; i < cores.size(); ++i)
+    {
+        std::vector<int> const& core = cores[i];
+        for (std::size_t j = 0; j < core.size(); ++j)
+            in_cluster[core[j]] = 1;
+
+        std::vector<int> candidates;
+        for (std::size_t j = 0; j < core.size(); ++j)
+            for (std::size_t k = 0; k < graph[core[j]].size(); ++k)
+            {
+                int const other = graph[core[j]][k].first;
+                if (in_cluster[other])
+                    continue;
+                if (weights[other] == 0.0)
+                    candidates.push_back(other);
+                weights[other] += graph[core[j]][k].second;
+            }
+
+        std::vector<std::pair<double, int> > ranking;
+        for (std::size_t j = 0; j < candidates.size(); ++j)
+        {
+            ranking.push_back(std::make_pair(-weights[candidates[j]],
+                candidates[j]));
+            weights[candidates[j]] = 0.0;
+        }
+        std::sort(ranking.begin(), ranking.end());
+        if (ranking.size() > this->opts.num_overlap_views)
+            ranking.resize(this->opts.num_overlap_views);
+
+        std::vector<int>& cluster = clusters->at(i);
+        cluster = core;
+        for (std::size_t j = 0; j < ranking.size(); ++j)
+            cluster.push_back(ranking[j].second);
+        std::sort(cluster.begin(), cluster.end());
+        for (std::size_t j = 0; j < core.size(); ++j)
+            in_cluster[core[j]] = 0;
+    }
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Partitioned " << num_views << " views into "
+            << clusters->size() << " clusters of at most " << max_size
+            << " views and " << this->opts.num_overlap_views
+            << " overlapping views." << std::endl;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Partition::extract_sub_model (ViewportList const& viewports,
+    PairwiseMatching const& matching, std::vector<int> const& cluster,
+    SubModel* sub_model)
+{
+    std::vector<int> local_ids(viewports.size(), -1);
+    sub_model->view_ids = cluster;
+    sub_model->viewports.clear();
+    sub_model->viewports.resize(cluster.size());
+    for (std::size_t i = 0; i < cluster.size(); ++i)
+    {
+        local_ids[cluster[i]] = static_cast<int>(i);
+        Viewport& viewport = sub_model->viewports[i];
+        viewport = viewports[cluster[i]];
+        viewport.pose = CameraPose();
+        viewport.track_ids.clear();
+    }
+
+    sub_model->matching.clear();
+    for (std::size_t i = 0; i < matching.size(); ++i)
+    {
+        TwoViewMatching const& tvm = matching[i];
+        int const view_1_id = local_ids[tvm.view_1_id];
+        int const view_2_id = local_ids[tvm.view_2_id];
+        if (view_1_id < 0 || view_2_id < 0)
+            continue;
+        sub_model->matching.push_back(tvm);
+        sub_model->matching.back().view_1_id = view_1_id;
+        sub_model->matching.back().view_2_id = view_2_id;
+    }
+    sub_model->tracks.clear();
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+Partition::reconstruct_sub_model (SubModel* sub_model) const
+{
+    Tracks(this->opts.tracks_opts).compute(sub_model->matching,
+        &sub_model->viewports, &sub_model->tracks);
+
+    InitialPair::Result init_pair;
+    InitialPair(this->opts.init_pair_opts).compute(sub_model->viewports,
+        sub_model->matching, &init_pair);
+    if (init_pair.pair_id < 0)
+        return false;
+    sub_model->viewports[init_pair.view_1_id].pose = init_pair.view_1_pose;
+    sub_model->viewports[init_pair.view_2_id].pose = init_pair.view_2_pose;
+
+    Incremental incremental(this->opts.incremental_opts);
+    incremental.initialize(&sub_model->viewports, &sub_model->tracks);
+    incremental.reconstruct();
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+Partition::merge_sub_models (std::vector<SubModel> const& sub_models,
+    ViewportList* viewports) const
+{
+    for (std::size_t i = 0; i < viewports->size(); ++i)
+        viewports->at(i).pose = CameraPose();
+
+    /* The largest sub-model is the reference frame. */
+    std::vector<std::size_t> remaining;
+    std::size_t reference = sub_models.size();
+    std::size_t reference_views = 0;
+    for (std::size_t i = 0; i < sub_models.size(); ++i)
+    {
+        std::size_t const num_registered
+            = count_registered_views(sub_models[i]);
+        if (num_registered == 0)
+            continue;
+        remaining.push_back(i);
+        if (num_registered > reference_views)
+        {
+            reference = i;
+            reference_views = num_registered;
+        }
+    }
+    if (remaining.empty())
+        return 0;
+
+    MergedPoints merged;
+    merged.feature_points.resize(viewports->size());
+    std::size_t num_merged = 0;
+    std::size_t next = reference;
+    math::Matrix3d rot;
+    math::matrix_set_identity(&rot);
+    double scale = 1.0;
+    math::Vec3d trans(0.0);
+    std::vector<math::Vec3d> sub_points, merged_points;
+    while (true)
+    {
+        /* Transforms the poses of the views without pose, see below. */
+        SubModel const& sub_model = sub_models[next];
+        remaining.erase(std::find(remaining.begin(), remaining.end(), next));
+        for (std::size_t i = 0; i < sub_model.view_ids.size(); ++i)
+        {
+            Viewport const& sub_view = sub_model.viewports[i];
+            Viewport& view = viewports->at(sub_model.view_ids[i]);
+            if (!sub_view.pose.is_valid() || view.pose.is_valid())
+                continue;
+
+            /*
+             * With X' = s R X + t, the pose [Ri | ti] becomes
+             * [Ri R^T | s ti - Ri R^T t], which is scaled by s.
+             */
+            CameraPose& pose = view.pose;
+            pose.K = sub_view.pose.K;
+            pose.R = sub_view.pose.R * rot.transposed();
+            pose.t = sub_view.pose.t * scale - pose.R * trans;
+            view.focal_length = sub_view.focal_length;
+            std::copy(sub_view.radial_distortion,
+                sub_view.radial_distortion + 2, view.radial_distortion);
+        }
+        add_merged_points(sub_model, rot, scale, trans, &merged);
+        num_merged += 1;
+
+        /* The next sub-model shares the most points with the merged ones. */
+        bool found = false;
+        while (!remaining.empty() && !found)
+        {
+            std::size_t best_shared = 0;
+            for (std::size_t i = 0; i < remaining.size(); ++i)
+            {
+                find_shared_points(sub_models[remaining[i]], merged,
+                    &sub_points, &merged_points);
+                if (sub_points.size() > best_shared)
+                {
+                    best_shared = sub_points.size();
+                    next = remaining[i];
+                }
+            }
+            if (best_shared < std::max<std::size_t>(3,
+                this->opts.min_merge_points))
+                break;
+
+            find_shared_points(sub_models[next], merged,
+                &sub_points, &merged_points);
+            found = estimate_similarity(sub_points, merged_points,
+                this->opts.min_merge_points, &rot, &scale, &trans);
+            if (!found)
+                remaining.erase(std::find(remaining.begin(),
+                    remaining.end(), next));
+        }
+        if (!found)
+            break;
+    }
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Merged " << num_merged << " of " << sub_models.size()
+            << " sub-models." << std::endl;
+    }
+    return num_merged;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_PARTITION_HEADER
+#define SFM_BUNDLER_PARTITION_HEADER
+
+#include <cstddef>
+#include <vector>
+
+#include "sfm/bundler_common.h"
+#include "sfm/bundler_incremental.h"
+#include "sfm/bundler_init_pair.h"
+#include "sfm/bundler_tracks.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Partitioned reconstruction with sub-model merging.
+ *
+ * Incremental reconstruction of all views gets slow as bundle adjustment
+ * grows. This component clusters the view graph, whose edge weights are
+ * the numbers of matches, by recursive bisection with normalized cuts
+ * until the clusters are small enough. Every cluster is extended by the
+ * views with most matches to the cluster, so that neighboring clusters
+ * overlap. The clusters are reconstructed independently, in parallel or
+ * on separate nodes, with the tracks, initial pair and incremental
+ * components. The sub-models are then registered with similarity
+ * transforms, estimated from the 3D points of shared features, and merged
+ * into one set of poses. A final incremental reconstruction of the tracks
+ * of all views triangulates them with the merged poses, runs the final
+ * full bundle adjustment and registers the remaining views.
+ *
+ * The matching must include the two-view geometry for the initial pairs,
+ * see Verification::Options::compute_geometry.
+ */
+class Partition
+{
+public:
+    /** Options for partitioned reconstruction. */
+    struct Options
+    {
+        Options (void);
+
+        /** Maximum number of views of a cluster. Defaults to 100. */
+        std::size_t max_cluster_size;
+
+        /**
+         * Number of views of the neighboring clusters added to every
+         * cluster. Defaults to 10.
+         */
+        std::size_t num_overlap_views;
+
+        /**
+         * Number of power iterations for the normalized cut of a cluster.
+         * Defaults to 100.
+         */
+        int num_cut_iterations;
+
+        /**
+         * Minimum number of shared 3D points to merge a sub-model.
+         * Defaults to 20.
+         */
+        std::size_t min_merge_points;
+
+        /** Options for the tracks of the sub-models and all views. */
+        Tracks::Options tracks_opts;
+
+        /** Options for the initial pairs of the sub-models. */
+        InitialPair::Options init_pair_opts;
+
+        /** Options for the sub-models and the final reconstruction. */
+        Incremental::Options incremental_opts;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+    };
+
+    /** The reconstruction of one cluster with local view IDs. */
+    struct SubModel
+    {
+        /** The global IDs of the views, ascending by view ID. */
+        std::vector<int> view_ids;
+        /** The viewports of the views, in the order of the view IDs. */
+        ViewportList viewports;
+        /** The pairs of the cluster with local view IDs. */
+        PairwiseMatching matching;
+        /** The tracks of the sub-model with local view IDs. */
+        TrackList tracks;
+    };
+
+public:
+    explicit Partition (Options const& options);
+
+    /**
+     * Runs the partitioned reconstruction: clusters the views, extracts
+     * and reconstructs the sub-models in parallel, merges them into the
+     * poses of the viewports and reconstructs the tracks of all views.
+     */
+    void reconstruct (PairwiseMatching const& matching,
+        ViewportList* viewports, TrackList* tracks) const;
+
+    /**
+     * Clusters the views by recursive normalized cuts and extends the
+     * clusters with overlapping views. The views of every cluster are
+     * ascending.
+     */
+    void compute_clusters (std::size_t num_views,
+        PairwiseMatching const& matching,
+        std::vector<std::vector<int> >* clusters) const;
+
+    /** Copies the viewports and pairs of a cluster into the sub-model. */
+    static void extract_sub_model (ViewportList const& viewports,
+        PairwiseMatching const& matching, std::vector<int> const& cluster,
+        SubModel* sub_model);
+
+    /**
+     * Reconstructs a sub-model from its initial pair. Returns false if the
+     * sub-model has no initial pair.
+     */
+    bool reconstruct_sub_model (SubModel* sub_model) const;
+
+    /**
+     * Registers the sub-models into the frame of the largest sub-model
+     * and sets the poses of the viewports. Sub-models are merged in the
+     * order of most shared points. Views of several sub-models keep the
+     * pose of the first merged one, views of no merged sub-model get an
+     * invalid pose. Returns the number of merged sub-models.
+     */
+    std::size_t merge_sub_models (std::vector<SubModel> const& sub_models,
+        ViewportList* viewports) const;
+
+private:
+    Options opts;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Partition::Options::Options (void)
+    : max_cluster_size(100)
+    , num_overlap_views(10)
+    , num_cut_iterations(100)
+    , min_merge_points(20)
+    , verbose_output(false)
+{
+}
+
+inline
+Partition::Partition (Options const& options)
+    : opts(options)
+{
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_PARTITION_HEADER */
@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#include "util/file_system.h"
+#include "util/strings.h"
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "core/image_io.h"
+#include "sfm/bundler_match_cache.h"
+#include "sfm/bundler_pipeline.h"
+#include "sfm/feature_database.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Returns the name of the feature file of a view in the work dir. */
+    std::string
+    get_feature_filename (std::string const& work_dir, int view_id,
+        std::string const& image_filename)
+    {
+        std::string const name = util::string::get_filled(view_id, 4) + "_"
+            + util::fs::basename(image_filename) + ".features";
+        return util::fs::join_path(util::fs::join_path(work_dir, "features"),
+            name);
+    }
+
+    /* Saves the file through a temporary file, which is then renamed. */
+    template <typename SAVE>
+    void
+    save_atomic (std::string const& filename, SAVE save)
+    {
+        std::string const tmp_filename = filename + ".tmp";
+        save(tmp_filename);
+        if (!util::fs::rename(tmp_filename.c_str(), filename.c_str()))
+            throw std::runtime_error("Error renaming " + tmp_filename);
+    }
+
+    /* Saves the features of a viewport as a database with one view. */
+    void
+    save_view_features (Viewport* viewport, std::string const& filename)
+    {
+        ViewportList single(1);
+        std::swap(single[0].features, viewport->features);
+        try
+        {
+            save_atomic(filename, [&single] (std::string const& fn)
+                { save_feature_database(single, fn); });
+        }
+        catch (...)
+        {
+            std::swap(single[0].features, viewport->features);
+            throw;
+        }
+        std::swap(single[0].features, viewport->features);
+    }
+
+    void
+    make_directory (std::string const& path)
+    {
+        if (!util::fs::dir_exists(path.c_str())
+            && !util::fs::mkdir(path.c_str()))
+            throw std::runtime_error("Error creating directory " + path);
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+Pipeline::compute (std::vector<std::string> const& filenames,
+    ViewportList* viewports, TrackList* tracks)
+{
+    if (viewports == nullptr || tracks == nullptr)
+        throw std::invalid_argument("Viewports and tracks must not be null");
+    if (filenames.size() < 2)
+        throw std::invalid_argument("At least two images are required");
+
+    this->stats = Statistics();
+    bool const use_work_dir = !this->opts.work_dir.empty();
+    std::string prebundle_filename;
+    if (use_work_dir)
+    {
+        make_directory(this->opts.work_dir);
+        make_directory(util::fs::join_path(this->opts.work_dir, "features"));
+        prebundle_filename = util::fs::join_path(this->opts.work_dir,
+            "prebundle.sfm");
+    }
+
+    /* The focal lengths and image sizes are not part of the pre-bundle. */
+    util::WallTimer timer;
+    init_viewports_from_files(filenames, this->opts.num_threads, viewports);
+
+    PairwiseMatching pairwise_matching;
+    if (use_work_dir && util::fs::file_exists(prebundle_filename.c_str()))
+    {
+        ViewportList loaded;
+        load_prebundle_from_file(prebundle_filename, &loaded,
+            &pairwise_matching);
+        if (loaded.size() != viewports->size())
+            throw std::runtime_error("Pre-bundle does not match the images");
+        for (std::size_t i = 0; i < loaded.size(); ++i)
+        {
+            FeatureSet& features = viewports->at(i).features;
+            std::swap(features.positions, loaded[i].features.positions);
+            std::swap(features.colors, loaded[i].features.colors);
+        }
+        if (this->opts.verbose_output)
+            std::cout << "Loaded pre-bundle with " << pairwise_matching.size()
+                << " pairs from " << prebundle_filename << std::endl;
+
+        /* The pre-bundle does not store the two-view geometry. */
+        Verification::Options verification_opts
+            = this->opts.verification_opts;
+        verification_opts.num_threads = this->opts.num_threads;
+        Verification verification(verification_opts);
+        verification.compute(*viewports, &pairwise_matching);
+        this->stats.prebundle_loaded = true;
+        this->stats.num_pairs_verified = pairwise_matching.size();
+    }
+    else
+    {
+        this->compute_prebundle(filenames, viewports, &pairwise_matching);
+        if (use_work_dir)
+            save_atomic(prebundle_filename, [&] (std::string const& fn)
+                { save_prebundle_to_file(*viewports, pairwise_matching, fn); });
+    }
+    this->stats.prebundle_time = timer.get_elapsed();
+
+    this->reconstruct(pairwise_matching, viewports, tracks);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Pipeline::compute_prebundle (std::vector<std::string> const& filenames,
+    ViewportList* viewports, PairwiseMatching* pairwise_matching)
+{
+    Matching::Options const& mopts = this->opts.matching_opts;
+    if (mopts.matcher_type != features::MatchingBase::MATCHER_EXHAUSTIVE
+        || mopts.num_retrieval_candidates > 0 || mopts.gps_num_neighbors > 0
+        || mopts.gps_max_distance > 0.0 || mopts.num_shard_blocks > 1)
+        throw std::invalid_argument("Pipeline requires exhaustive matching "
+            "without retrieval, GPS or shards");
+
+    /* The viewports only get their features while the graph runs. */
+    Matching::Options matching_opts = mopts;
+    matching_opts.match_cache_file.clear();
+    Matching matching(matching_opts);
+    matching.init(viewports);
+
+    Verification::Options verification_opts = this->opts.verification_opts;
+    verification_opts.num_threads = 1;
+    verification_opts.verbose_output = false;
+
+    bool const use_work_dir = !this->opts.work_dir.empty();
+    std::string cache_filename;
+    MatchCache cache(matching.get_options_hash());
+    if (use_work_dir)
+    {
+        cache_filename = util::fs::join_path(this->opts.work_dir,
+            "matches.cache");
+        if (util::fs::file_exists(cache_filename.c_str())
+            && !cache.load_from_file(cache_filename)
+            && this->opts.verbose_output)
+            std::cout << "Match cache " << cache_filename << " was created "
+                << "with different options, ignoring." << std::endl;
+    }
+
+    int const num_views = static_cast<int>(viewports->size());
+    int const window = mopts.sequential_window;
+    std::size_t num_pairs = static_cast<std::size_t>(num_views)
+        * (num_views - 1) / 2;
+    if (window > 0)
+    {
+        num_pairs = 0;
+        for (int i = 0; i < num_views; ++i)
+            num_pairs += std::min(window, num_views - 1 - i);
+    }
+
+    /* The state shared by the items, guarded by the mutex. */
+    std::mutex mutex;
+    std::vector<char> view_done(num_views, 0);
+    std::vector<MatchCache::Key> view_keys(num_views, 0);
+    std::size_t num_done = 0;
+    std::size_t num_total = num_views + num_pairs;
+    std::size_t pairs_since_save = 0;
+    std::atomic<bool> failed(false);
+    std::atomic<int> next_view(0);
+    util::StageControl const& control = this->opts.control;
+
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+    util::ThreadPool pool(static_cast<std::size_t>(num_threads));
+    util::TaskGroup group(pool);
+
+    /* Reports one finished item, requires the lock. */
+    auto report_item = [&] (void)
+    {
+        num_done += 1;
+        control.report(num_done, num_total);
+    };
+
+    auto save_cache = [&] (void)
+    {
+        save_atomic(cache_filename, [&cache] (std::string const& fn)
+            { cache.save_to_file(fn); });
+        pairs_since_save = 0;
+    };
+
+    /* Matches and verifies a pair of views with features. */
+    auto match_and_verify = [&] (int view_1_id, int view_2_id)
+    {
+        CorrespondenceIndices matches;
+        bool cached = false;
+        if (use_work_dir)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cached = cache.lookup(view_keys[view_1_id], view_keys[view_2_id],
+                &matches);
+        }
+        if (!cached)
+            matching.match_pair(view_1_id, view_2_id, &matches);
+
+        bool verified = false;
+        PairwiseMatching pair(1);
+        if (static_cast<int>(matches.size()) >= mopts.min_feature_matches)
+        {
+            pair[0].view_1_id = view_1_id;
+            pair[0].view_2_id = view_2_id;
+            pair[0].matches = matches;
+            Verification verification(verification_opts);
+            verification.compute(*viewports, &pair);
+            verified = !pair.empty();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cached)
+            this->stats.num_pairs_cached += 1;
+        else
+        {
+            this->stats.num_pairs_matched += 1;
+            if (use_work_dir)
+            {
+                cache.insert(view_keys[view_1_id], view_keys[view_2_id],
+                    matches);
+                pairs_since_save += 1;
+                if (static_cast<int>(pairs_since_save)
+                    >= std::max(1, this->opts.checkpoint_interval))
+                    save_cache();
+            }
+        }
+        if (verified)
+        {
+            pairwise_matching->push_back(TwoViewMatching());
+            std::swap(pairwise_matching->back(), pair[0]);
+        }
+        report_item();
+    };
+
+    auto pair_item = [&] (int view_1_id, int view_2_id)
+    {
+        if (failed || control.is_cancelled())
+            return;
+
+        try
+        {
+            match_and_verify(view_1_id, view_2_id);
+        }
+        catch (...)
+        {
+            failed = true;
+            throw;
+        }
+    };
+
+    /*
+     * Computes or loads the features of a view, then queues the pairs with
+     * all finished views and the next view. Every view item thus keeps one
+     * image in flight.
+     */
+    std::function<void (int)> view_item = [&] (int view_id)
+    {
+        if (failed || control.is_cancelled())
+            return;
+
+        try
+        {
+            Viewport& viewport = viewports->at(view_id);
+            std::string const& image_filename = filenames[view_id];
+            std::string feature_filename;
+            if (use_work_dir)
+                feature_filename = get_feature_filename(this->opts.work_dir,
+                    view_id, image_filename);
+
+            bool loaded = false;
+            if (use_work_dir
+                && util::fs::file_exists(feature_filename.c_str()))
+            {
+                FeatureDatabase database;
+                database.open(feature_filename);
+                database.get_features(0, &viewport.features);
+                loaded = true;
+            }
+            else
+            {
+                FeatureSet features(this->opts.feature_opts);
+                bool valid = true;
+                try
+                {
+                    features.compute_features(
+                        core::image::load_file(image_filename));
+                }
+                catch (std::exception& e)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::cerr << "Error processing " << image_filename
+                        << ": " << e.what() << std::endl;
+                    this->stats.num_views_failed += 1;
+                    features = FeatureSet(this->opts.feature_opts);
+                    valid = false;
+                }
+                std::swap(viewport.features, features);
+                if (use_work_dir && valid)
+                    save_view_features(&viewport, feature_filename);
+            }
+            matching.init_view(view_id);
+            MatchCache::Key const key
+                = MatchCache::hash_features(viewport.features);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (loaded)
+                this->stats.num_views_loaded += 1;
+            else
+                this->stats.num_views_computed += 1;
+            view_keys[view_id] = key;
+            view_done[view_id] = 1;
+            for (int i = 0; i < num_views; ++i)
+            {
+                if (i == view_id || !view_done[i]
+                    || (window > 0 && std::abs(i - view_id) > window))
+                    continue;
+                int const view_1_id = std::min(i, view_id);
+                int const view_2_id = std::max(i, view_id);
+                group.run([&pair_item, view_1_id, view_2_id] (void)
+                    { pair_item(view_1_id, view_2_id); });
+            }
+            report_item();
+        }
+        catch (...)
+        {
+            failed = true;
+            throw;
+        }
+
+        int const next_view_id = next_view++;
+        if (next_view_id < num_views)
+            group.run([&view_item, next_view_id] (void)
+                { view_item(next_view_id); });
+    };
+
+    int const max_in_flight = this->opts.max_images_in_flight > 0
+        ? this->opts.max_images_in_flight : num_threads;
+    for (int i = 0; i < std::min(max_in_flight, num_views); ++i)
+    {
+        int const view_id = next_view++;
+        group.run([&view_item, view_id] (void) { view_item(view_id); });
+    }
+
+    /* The matches of the finished pairs are saved even after errors. */
+    std::exception_ptr error;
+    try
+    {
+        group.wait();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    if (use_work_dir && pairs_since_save > 0)
+        save_cache();
+    if (error)
+        std::rethrow_exception(error);
+    control.check_cancelled("Pipeline cancelled");
+
+    /* Pairs finish in arbitrary order, sort for a deterministic result. */
+    std::sort(pairwise_matching->begin(), pairwise_matching->end());
+    this->stats.num_pairs_verified = pairwise_matching->size();
+
+    for (std::size_t i = 0; i < viewports->size(); ++i)
+        viewports->at(i).features.clear_descriptors();
+
+    if (this->opts.verbose_output)
+        std::cout << "Computed " << this->stats.num_views_computed
+            << " and loaded " << this->stats.num_views_loaded << " views, "
+            << "matched " << this->stats.num_pairs_matched << " and loaded "
+            << this->stats.num_pairs_cached << " pairs, "
+            << pairwise_matching->size() << " pairs verified." << std::endl;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Pipeline::reconstruct (PairwiseMatching const& pairwise_matching,
+    ViewportList* viewports, TrackList* tracks)
+{
+    /* The reconstruction expects normalized feature positions. */
+    for (std::size_t i = 0; i < viewports->size(); ++i)
+        viewports->at(i).features.normalize_feature_positions();
+
+    util::WallTimer timer;
+    Tracks tracks_builder(this->opts.tracks_opts);
+    tracks_builder.compute(pairwise_matching, viewports, tracks);
+    this->stats.tracks_time = timer.get_elapsed();
+
+    timer.reset();
+    InitialPair::Result init_pair;
+    InitialPair init_pair_search(this->opts.init_pair_opts);
+    init_pair_search.compute(*viewports, pairwise_matching, &init_pair);
+    if (init_pair.pair_id < 0)
+        throw std::runtime_error("No initial pair found");
+    viewports->at(init_pair.view_1_id).pose = init_pair.view_1_pose;
+    viewports->at(init_pair.view_2_id).pose = init_pair.view_2_pose;
+
+    Incremental incremental(this->opts.incremental_opts);
+    incremental.initialize(viewports, tracks);
+    incremental.reconstruct();
+    this->stats.reconstruction_time = timer.get_elapsed();
+
+    for (std::size_t i = 0; i < viewports->size(); ++i)
+        if (viewports->at(i).pose.is_valid())
+            this->stats.num_reconstructed_views += 1;
+
+    if (this->opts.verbose_output)
+        std::cout << "Reconstructed " << this->stats.num_reconstructed_views
+            << " of " << viewports->size() << " views." << std::endl;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_PIPELINE_HEADER
+#define SFM_BUNDLER_PIPELINE_HEADER
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "util/progress.h"
+#include "sfm/bundler_common.h"
+#include "sfm/bundler_incremental.h"
+#include "sfm/bundler_init_pair.h"
+#include "sfm/bundler_matching.h"
+#include "sfm/bundler_tracks.h"
+#include "sfm/bundler_verification.h"
+#include "sfm/feature_set.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Runs all stages from the images to the incremental
+ * reconstruction with overlapping stages and checkpoints.
+ *
+ * The work is a graph over views and pairs: the features of every view,
+ * then the matching and verification of every pair, which depend on the
+ * features of both views, and finally the tracks, the initial pair and
+ * the reconstruction, which depend on all pairs. The items of the graph
+ * run on a thread pool as soon as their inputs are complete, so pairs are
+ * matched and verified while the features of other views are computed.
+ * At most max_images_in_flight images are processed at the same time.
+ *
+ * With a work directory, completed work is saved, and a new run with the
+ * same images resumes where the last run stopped:
+ * - features/<view ID>_<image>.features: the features of a view as a
+ *   feature database with one view, saved when the view is complete.
+ * - matches.cache: the match cache with the matched pairs, saved every
+ *   checkpoint_interval pairs and when the run stops.
+ * - prebundle.sfm: the viewports and the verified pairs, saved when all
+ *   pairs are verified. Features and matching are skipped if it exists,
+ *   only the two-view geometry of the pairs is verified again.
+ * Files are written to a temporary file which is renamed, so interrupted
+ * runs leave no partial files. Matches are only reused for features with
+ * the same content, but the feature files must be removed if the feature
+ * options change.
+ *
+ * All pairs are matched, or the pairs of the sequential window of the
+ * matching options. Retrieval, GPS and shard pair selection and cascade
+ * hashing need the features of all views and are not supported.
+ */
+class Pipeline
+{
+public:
+    /** Options for the pipeline and its stages. */
+    struct Options
+    {
+        Options (void);
+
+        /** Directory of the checkpoints, empty disables checkpoints. */
+        std::string work_dir;
+
+        FeatureSet::Options feature_opts;
+        Matching::Options matching_opts;
+        Verification::Options verification_opts;
+        Tracks::Options tracks_opts;
+        InitialPair::Options init_pair_opts;
+        Incremental::Options incremental_opts;
+
+        /**
+         * Maximum number of images processed at the same time, 0 allows
+         * one image per thread.
+         */
+        int max_images_in_flight;
+
+        /** Matched pairs between saves of the match cache. Defaults to 64. */
+        int checkpoint_interval;
+
+        /** Number of threads, 0 uses util::ThreadPool::get_num_threads(). */
+        int num_threads;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+
+        /**
+         * Cancellation is checked before every view and pair. Items in
+         * progress are finished and saved, and compute() throws
+         * util::CancelledException. Progress is reported after every view
+         * and pair.
+         */
+        util::StageControl control;
+    };
+
+    /** Statistics of the last run. */
+    struct Statistics
+    {
+        Statistics (void);
+
+        /** The views with features computed, loaded or failed to load. */
+        std::size_t num_views_computed;
+        std::size_t num_views_loaded;
+        std::size_t num_views_failed;
+        /** The pairs matched and loaded from the match cache. */
+        std::size_t num_pairs_matched;
+        std::size_t num_pairs_cached;
+        /** The verified pairs. */
+        std::size_t num_pairs_verified;
+        /** Whether the pre-bundle has been loaded from the work directory. */
+        bool prebundle_loaded;
+        /** The reconstructed views, including the initial pair. */
+        std::size_t num_reconstructed_views;
+
+        /** The wall time in ms of the overlapped features and matching. */
+        double prebundle_time;
+        /** The wall times in ms of the tracks and the reconstruction. */
+        double tracks_time;
+        double reconstruction_time;
+    };
+
+public:
+    explicit Pipeline (Options const& options);
+
+    /**
+     * Runs the pipeline for the images, one viewport per image. The
+     * viewports get the features with normalized positions and the poses
+     * of the reconstructed views, the tracks are the reconstructed tracks.
+     * Throws if no initial pair is found.
+     */
+    void compute (std::vector<std::string> const& filenames,
+        ViewportList* viewports, TrackList* tracks);
+
+    /** Returns the statistics of the last call to compute(). */
+    Statistics const& get_statistics (void) const;
+
+private:
+    /* Computes the features, matching and verification as one graph. */
+    void compute_prebundle (std::vector<std::string> const& filenames,
+        ViewportList* viewports, PairwiseMatching* pairwise_matching);
+    void reconstruct (PairwiseMatching const& pairwise_matching,
+        ViewportList* viewports, TrackList* tracks);
+
+private:
+    Options opts;
+    Statistics stats;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Pipeline::Options::Options (void)
+    : max_images_in_flight(0)
+    , checkpoint_interval(64)
+    , num_threads(0)
+    , verbose_output(false)
+{
+    /* The initial pair is selected by the two-view geometry. */
+    this->verification_opts.compute_geometry = true;
+}
+
+inline
+Pipeline::Statistics::Statistics (void)
+    : num_views_computed(0)
+    , num_views_loaded(0)
+    , num_views_failed(0)
+    , num_pairs_matched(0)
+    , num_pairs_cached(0)
+    , num_pairs_verified(0)
+    , prebundle_loaded(false)
+    , num_reconstructed_views(0)
+    , prebundle_time(0.0)
+    , tracks_time(0.0)
+    , reconstruction_time(0.0)
+{
+}
+
+inline
+Pipeline::Pipeline (Options const& options)
+    : opts(options)
+{
+}
+
+inline Pipeline::Statistics const&
+Pipeline::get_statistics (void) const
+{
+    return this->stats;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_PIPELINE_HEADER */
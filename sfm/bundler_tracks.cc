@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "sfm/bundler_tracks.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    typedef std::vector<std::atomic<std::uint32_t> > ParentList;
+
+    /*
+     * Finds the root of a set with path halving. The parents are always
+     * smaller than their children, and a parent is only replaced by its own
+     * parent, which is safe with concurrent finds and unions.
+     */
+    std::uint32_t
+    find_root (ParentList& parents, std::uint32_t x)
+    {
+        while (true)
+        {
+            std::uint32_t parent = parents[x].load(std::memory_order_relaxed);
+            if (parent == x)
+                return x;
+            std::uint32_t const grandparent
+                = parents[parent].load(std::memory_order_relaxed);
+            if (grandparent != parent)
+                parents[x].compare_exchange_weak(parent, grandparent,
+                    std::memory_order_relaxed);
+            x = grandparent;
+        }
+    }
+
+    /*
+     * Joins the sets of two features. The root with the larger index is
+     * linked under the other root, which fails and is repeated if that root
+     * has been linked concurrently.
+     */
+    void
+    unite_sets (ParentList& parents, std::uint32_t a, std::uint32_t b)
+    {
+        while (true)
+        {
+            a = find_root(parents, a);
+            b = find_root(parents, b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            std::uint32_t expected = a;
+            if (parents[a].compare_exchange_strong(expected, b))
+                return;
+        }
+    }
+}  /* namespace */
+
+Tracks::Tracks (Options const& options)
+    : opts(options)
+{
+    this->stats.num_features = 0;
+    this->stats.num_matches = 0;
+    this->stats.num_total = 0;
+    this->stats.num_inconsistent = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Tracks::compute (PairwiseMatching const& matching,
+    ViewportList* viewports, TrackList* tracks)
+{
+    if (viewports == nullptr || tracks == nullptr)
+        throw std::invalid_argument("Viewports and tracks must not be null");
+
+    util::WallTimer timer;
+    std::size_t const num_views = viewports->size();
+    std::size_t const num_pairs = matching.size();
+
+    /* The flat feature index of the first feature of every view. */
+    std::vector<std::size_t> offsets(num_views + 1, 0);
+    for (std::size_t i = 0; i < num_views; ++i)
+        offsets[i + 1] = offsets[i]
+            + viewports->at(i).features.positions.size();
+    std::size_t const num_features = offsets.back();
+    if (num_features >= std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("Too many features for tracks");
+
+    std::size_t num_matches = 0;
+    for (std::size_t i = 0; i < num_pairs; ++i)
+    {
+        TwoViewMatching const& tvm = matching[i];
+        if (tvm.view_1_id < 0 || tvm.view_2_id < 0
+            || static_cast<std::size_t>(tvm.view_1_id) >= num_views
+            || static_cast<std::size_t>(tvm.view_2_id) >= num_views)
+            throw std::invalid_argument("Invalid view ID in matching");
+        num_matches += tvm.matches.size();
+    }
+
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+    std::int64_t const num_features_int
+        = static_cast<std::int64_t>(num_features);
+    ParentList parents(num_features);
+#pragma omp parallel for num_threads(num_threads)
+    for (std::int64_t i = 0; i < num_features_int; ++i)
+        parents[i].store(static_cast<std::uint32_t>(i),
+            std::memory_order_relaxed);
+
+    /* Join the sets of all matches concurrently. */
+    std::size_t num_invalid = 0;
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic) \
+    reduction(+:num_invalid)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(num_pairs); ++i)
+    {
+        TwoViewMatching const& tvm = matching[i];
+        std::size_t const offset_1 = offsets[tvm.view_1_id];
+        std::size_t const offset_2 = offsets[tvm.view_2_id];
+        std::size_t const size_1 = offsets[tvm.view_1_id + 1] - offset_1;
+        std::size_t const size_2 = offsets[tvm.view_2_id + 1] - offset_2;
+        for (std::size_t j = 0; j < tvm.matches.size(); ++j)
+        {
+            std::size_t const f1 = tvm.matches[j].first;
+            std::size_t const f2 = tvm.matches[j].second;
+            if (f1 >= size_1 || f2 >= size_2)
+            {
+                num_invalid += 1;
+                continue;
+            }
+            unite_sets(parents, static_cast<std::uint32_t>(offset_1 + f1),
+                static_cast<std::uint32_t>(offset_2 + f2));
+        }
+    }
+    if (num_invalid > 0)
+        throw std::invalid_argument("Invalid feature ID in matching");
+
+    /* Link every feature directly to the root of its set. */
+#pragma omp parallel for num_threads(num_threads)
+    for (std::int64_t i = 0; i < num_features_int; ++i)
+        parents[i].store(find_root(parents, static_cast<std::uint32_t>(i)),
+            std::memory_order_relaxed);
+
+    /*
+     * Create the tracks in a single pass in feature order. The root of a set
+     * is its smallest feature, and the track is created with the next
+     * feature of the set, where the root has been visited before. Until the
+     * cleanup below, the track IDs of the roots map sets to tracks.
+     */
+    tracks->clear();
+    for (std::size_t i = 0; i < num_views; ++i)
+    {
+        Viewport& viewport = viewports->at(i);
+        viewport.track_ids.assign(viewport.features.positions.size(), -1);
+    }
+    for (std::size_t i = 0; i < num_views; ++i)
+    {
+        std::vector<int>& track_ids = viewports->at(i).track_ids;
+        for (std::size_t j = 0; j < track_ids.size(); ++j)
+        {
+            std::uint32_t const flat_id = static_cast<std::uint32_t>
+                (offsets[i] + j);
+            std::uint32_t const root = parents[flat_id].load
+                (std::memory_order_relaxed);
+            if (root == flat_id)
+                continue;
+
+            std::size_t const root_view = std::upper_bound(offsets.begin(),
+                offsets.end(), static_cast<std::size_t>(root))
+                - offsets.begin() - 1;
+            int const root_feature = static_cast<int>
+                (root - offsets[root_view]);
+            int& root_track_id = viewports->at(root_view)
+                .track_ids[root_feature];
+            if (root_track_id < 0)
+            {
+                root_track_id = static_cast<int>(tracks->size());
+                tracks->push_back(Track());
+                tracks->back().features.push_back(FeatureReference
+                    (static_cast<int>(root_view), root_feature));
+            }
+            tracks->at(root_track_id).features.push_back
+                (FeatureReference(static_cast<int>(i), static_cast<int>(j)));
+            track_ids[j] = root_track_id;
+        }
+    }
+    ParentList().swap(parents);
+
+    /*
+     * Remove the inconsistent tracks. The features of a track are ascending
+     * by view ID, and a view with several features is a repeated view ID.
+     */
+    std::size_t const num_total = tracks->size();
+    std::vector<char> keep(num_total, 1);
+    std::size_t num_inconsistent = 0;
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 256) \
+    reduction(+:num_inconsistent)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(num_total); ++i)
+    {
+        FeatureReferenceList& features = tracks->at(i).features;
+        for (std::size_t j = 1; j < features.size() && keep[i]; ++j)
+            if (features[j - 1].view_id == features[j].view_id)
+                keep[i] = 0;
+        if (keep[i])
+            continue;
+
+        num_inconsistent += 1;
+        for (std::size_t j = 0; j < features.size(); ++j)
+            viewports->at(features[j].view_id)
+                .track_ids[features[j].feature_id] = -1;
+        FeatureReferenceList().swap(features);
+    }
+
+    std::size_t num_kept = 0;
+    for (std::size_t i = 0; i < num_total; ++i)
+    {
+        if (!keep[i])
+            continue;
+        if (num_kept != i)
+            std::swap(tracks->at(num_kept), tracks->at(i));
+        num_kept += 1;
+    }
+    tracks->resize(num_kept);
+
+    /* Set the final track IDs and the track colors. */
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 256)
+    for (std::int64_t i = 0; i < static_cast<std::int64_t>(num_kept); ++i)
+    {
+        Track& track = tracks->at(i);
+        track.invalidate();
+
+        math::Vec3f color(0.0f, 0.0f, 0.0f);
+        int num_colors = 0;
+        for (std::size_t j = 0; j < track.features.size(); ++j)
+        {
+            FeatureReference const& ref = track.features[j];
+            Viewport& viewport = viewports->at(ref.view_id);
+            viewport.track_ids[ref.feature_id] = static_cast<int>(i);
+            if (viewport.features.colors.size()
+                != viewport.features.positions.size())
+                continue;
+            math::Vec3uc const& c = viewport.features.colors[ref.feature_id];
+            color += math::Vec3f(c[0], c[1], c[2]);
+            num_colors += 1;
+        }
+        if (num_colors > 0)
+            color /= static_cast<float>(num_colors);
+        for (int j = 0; j < 3; ++j)
+            track.color[j] = static_cast<unsigned char>(color[j] + 0.5f);
+    }
+
+    this->stats.num_features = num_features;
+    this->stats.num_matches = num_matches;
+    this->stats.num_total = num_total;
+    this->stats.num_inconsistent = num_inconsistent;
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "Computed " << num_kept << " tracks from " << num_matches
+            << " matches in " << timer.get_elapsed() << "ms, "
+            << num_inconsistent << " inconsistent tracks removed."
+            << std::endl;
+    }
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
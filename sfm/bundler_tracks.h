@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_TRACKS_HEADER
+#define SFM_BUNDLER_TRACKS_HEADER
+
+#include <cstddef>
+
+#include "sfm/bundler_common.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Computes feature tracks from the pairwise matching.
+ *
+ * Every feature of every view has a flat index, and the matches are the
+ * edges of a graph on these indices. The tracks are the connected
+ * components of the graph, which are computed with a disjoint-set forest.
+ * The pairs are processed in parallel with concurrent, lock-free unions.
+ * Sets are always linked under the root with the smaller index, so the
+ * root of every set is its smallest feature and the result does not depend
+ * on the order of the unions.
+ *
+ * The order of the tracks is deterministic, and the features of a track are
+ * ascending by view ID. Tracks with more than one feature in the same
+ * view are inconsistent and removed, and their features get no track ID.
+ * The track positions are not triangulated and invalid, the track colors
+ * are the mean colors of the features if the views have colors.
+ */
+class Tracks
+{
+public:
+    /** Options for track computation. */
+    struct Options
+    {
+        Options (void);
+
+        /** Number of threads, 0 uses util::ThreadPool::get_num_threads(). */
+        int num_threads;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+    };
+
+    /** Statistics of the last track computation. */
+    struct Statistics
+    {
+        /** The number of features of all views. */
+        std::size_t num_features;
+        /** The number of matches of all pairs. */
+        std::size_t num_matches;
+        /** The number of tracks, including the inconsistent tracks. */
+        std::size_t num_total;
+        /** The number of inconsistent tracks that were removed. */
+        std::size_t num_inconsistent;
+    };
+
+public:
+    explicit Tracks (Options const& options);
+
+    /**
+     * Computes the tracks of the pairwise matching. The track IDs of the
+     * viewports are set for all features, -1 for features without track.
+     * The view IDs and feature IDs of the matches must be valid.
+     */
+    void compute (PairwiseMatching const& matching,
+        ViewportList* viewports, TrackList* tracks);
+
+    /** Returns the statistics of the last call to compute(). */
+    Statistics const& get_statistics (void) const;
+
+private:
+    Options opts;
+    Statistics stats;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Tracks::Options::Options (void)
+    : num_threads(0)
+    , verbose_output(false)
+{
+}
+
+inline Tracks::Statistics const&
+Tracks::get_statistics (void) const
+{
+    return this->stats;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_TRACKS_HEADER */
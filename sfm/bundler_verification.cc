@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+#include "util/async_logger.h"
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "sfm/fundamental.h"
+#include "sfm/triangulate.h"
+#include "sfm/bundler_verification.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Normalizes a feature position like FeatureSet does. */
+    math::Vec2d
+    normalize_position (FeatureSet const& features, math::Vec2f const& pos)
+    {
+        if (features.width <= 0 || features.height <= 0)
+            return math::Vec2d(pos[0], pos[1]);
+
+        double const width = static_cast<double>(features.width);
+        double const height = static_cast<double>(features.height);
+        double const norm = std::max(width, height);
+        return math::Vec2d((pos[0] + 0.5 - width / 2.0) / norm,
+            (pos[1] + 0.5 - height / 2.0) / norm);
+    }
+
+    /*
+     * Computes the two-view geometry from the inlier correspondences of a
+     * pair. The relative pose is the solution from the essential matrix
+     * with the most inliers in front of both cameras.
+     */
+    void
+    compute_geometry (Viewport const& view_1, Viewport const& view_2,
+        FundamentalMatrix const& fundamental,
+        Correspondences2D2D const& inliers, RansacHomography* ransac,
+        RansacHomography::Result* result, TwoViewGeometry* geometry)
+    {
+        *geometry = TwoViewGeometry();
+        geometry->num_fundamental_inliers = static_cast<int>(inliers.size());
+        if (inliers.size() >= 4)
+        {
+            ransac->estimate(inliers, result);
+            geometry->num_homography_inliers
+                = static_cast<int>(result->inliers.size());
+        }
+        if (view_1.focal_length <= 0.0f || view_2.focal_length <= 0.0f)
+            return;
+
+        /* Test the four poses with the inliers, E = K2^T * F * K1. */
+        CameraPose pose_1;
+        pose_1.init_canonical_form();
+        pose_1.set_k_matrix(view_1.focal_length, 0.0, 0.0);
+        CameraPose pose_2;
+        pose_2.set_k_matrix(view_2.focal_length, 0.0, 0.0);
+        EssentialMatrix const essential = pose_2.K.transposed()
+            * fundamental * pose_1.K;
+        std::vector<CameraPose> poses;
+        pose_from_essential(essential, &poses);
+
+        std::size_t best_num_consistent = 0;
+        for (std::size_t i = 0; i < poses.size(); ++i)
+        {
+            poses[i].K = pose_2.K;
+            std::size_t num_consistent = 0;
+            for (std::size_t j = 0; j < inliers.size(); ++j)
+                if (is_consistent_pose(inliers[j], pose_1, poses[i]))
+                    num_consistent += 1;
+            if (num_consistent <= best_num_consistent)
+                continue;
+            best_num_consistent = num_consistent;
+            geometry->pose = poses[i];
+        }
+        if (best_num_consistent == 0)
+            return;
+
+        /* Median angle between the rays of the consistent inliers. */
+        math::Vec3d center_2;
+        geometry->pose.fill_camera_pos(&center_2);
+        std::vector<double> angles;
+        angles.reserve(best_num_consistent);
+        for (std::size_t i = 0; i < inliers.size(); ++i)
+        {
+            if (!is_consistent_pose(inliers[i], pose_1, geometry->pose))
+                continue;
+            math::Vec3d const x = triangulate_match(inliers[i],
+                pose_1, geometry->pose);
+            math::Vec3d const ray_1 = x.normalized();
+            math::Vec3d const ray_2 = (x - center_2).normalized();
+            double const cos_angle = std::max(-1.0,
+                std::min(1.0, ray_1.dot(ray_2)));
+            angles.push_back(std::acos(cos_angle));
+        }
+        std::nth_element(angles.begin(), angles.begin() + angles.size() / 2,
+            angles.end());
+        geometry->num_triangulated = static_cast<int>(angles.size());
+        geometry->triangulation_angle = angles[angles.size() / 2];
+    }
+}  /* namespace */
+
+Verification::Verification (Options const& options)
+    : opts(options)
+{
+    this->opts.ransac_opts.num_threads = 1;
+    this->opts.homography_opts.num_threads = 1;
+    this->stats.num_total = 0;
+    this->stats.num_skipped = 0;
+    this->stats.num_verified = 0;
+    this->stats.ransac_statistics = RansacStatistics();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Verification::compute (ViewportList const& viewports,
+    PairwiseMatching* pairwise_matching)
+{
+    if (pairwise_matching == nullptr)
+        throw std::invalid_argument("Pairwise matching must not be null");
+
+    util::WallTimer timer;
+    std::size_t const num_pairs = pairwise_matching->size();
+
+    /* RANSAC requires at least a sample of matches. */
+    int const sample_size = this->opts.ransac_opts.solver
+        == RansacFundamental::SOLVER_7_POINT ? 7 : 8;
+    std::size_t const min_feature_matches = static_cast<std::size_t>
+        (std::max(sample_size, this->opts.min_feature_matches));
+    std::size_t const min_inliers = static_cast<std::size_t>
+        (std::max(0, this->opts.min_matching_inliers));
+    std::vector<char> keep(num_pairs, 0);
+    std::size_t num_skipped = 0;
+    RansacStatistics ransac_statistics;
+
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+#pragma omp parallel num_threads(num_threads) reduction(+:num_skipped)
+    {
+        /* The scratch buffers of a thread are reused for all its pairs. */
+        RansacFundamental ransac(this->opts.ransac_opts);
+        RansacFundamental::Workspace workspace;
+        RansacFundamental::Result result;
+        Correspondences2D2D correspondences;
+        RansacHomography homography_ransac(this->opts.homography_opts);
+        RansacHomography::Result homography_result;
+        RansacStatistics thread_statistics;
+
+#pragma omp for schedule(dynamic)
+        for (std::int64_t i = 0; i < static_cast<std::int64_t>(num_pairs);
+            ++i)
+        {
+            TwoViewMatching& tvm = pairwise_matching->at(i);
+            if (tvm.matches.size() < min_feature_matches)
+            {
+                num_skipped += 1;
+                continue;
+            }
+
+            FeatureSet const& view_1 = viewports.at(tvm.view_1_id).features;
+            FeatureSet const& view_2 = viewports.at(tvm.view_2_id).features;
+            correspondences.resize(tvm.matches.size());
+            for (std::size_t j = 0; j < tvm.matches.size(); ++j)
+            {
+                math::Vec2d const p1 = normalize_position(view_1,
+                    view_1.positions[tvm.matches[j].first]);
+                math::Vec2d const p2 = normalize_position(view_2,
+                    view_2.positions[tvm.matches[j].second]);
+                std::copy(p1.begin(), p1.end(), correspondences[j].p1);
+                std::copy(p2.begin(), p2.end(), correspondences[j].p2);
+            }
+
+            ransac.estimate(correspondences, &result, &workspace);
+            thread_statistics += result.statistics;
+            if (result.inliers.size() < min_inliers)
+                continue;
+
+            /* The inliers are ascending, which allows filtering in-place. */
+            for (std::size_t j = 0; j < result.inliers.size(); ++j)
+            {
+                tvm.matches[j] = tvm.matches[result.inliers[j]];
+                correspondences[j] = correspondences[result.inliers[j]];
+            }
+            tvm.matches.resize(result.inliers.size());
+            correspondences.resize(result.inliers.size());
+            keep[i] = 1;
+
+            if (this->opts.compute_geometry)
+                compute_geometry(viewports.at(tvm.view_1_id),
+                    viewports.at(tvm.view_2_id), result.fundamental,
+                    correspondences, &homography_ransac, &homography_result,
+                    &tvm.geometry);
+        }
+
+#pragma omp critical
+        ransac_statistics += thread_statistics;
+    }
+
+    /* Compact the verified pairs, which keeps their order. */
+    std::size_t num_kept = 0;
+    for (std::size_t i = 0; i < num_pairs; ++i)
+    {
+        if (!keep[i])
+            continue;
+        if (num_kept != i)
+            std::swap(pairwise_matching->at(num_kept),
+                pairwise_matching->at(i));
+        num_kept += 1;
+    }
+    pairwise_matching->resize(num_kept);
+
+    this->stats.num_total = num_pairs;
+    this->stats.num_skipped = num_skipped;
+    this->stats.num_verified = num_kept;
+    this->stats.ransac_statistics = ransac_statistics;
+
+    if (this->opts.verbose_output)
+    {
+        /* Write the messages of the pairs before the summary. */
+        util::AsyncLogger::get_global().flush();
+        std::cout << "Verified " << num_pairs << " view pairs in "
+            << timer.get_elapsed() << "ms, " << num_kept << " pairs with at "
+            << "least " << min_inliers << " inliers, " << num_skipped
+            << " pairs skipped." << std::endl;
+        std::cout << "RANSAC iterations: " << ransac_statistics.num_iterations
+            << ", time for sampling " << ransac_statistics.sampling_time
+            << "ms, solving " << ransac_statistics.solving_time
+            << "ms, scoring " << ransac_statistics.scoring_time
+            << "ms." << std::endl;
+    }
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
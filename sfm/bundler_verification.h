@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_BUNDLER_VERIFICATION_HEADER
+#define SFM_BUNDLER_VERIFICATION_HEADER
+
+#include <cstddef>
+
+#include "sfm/bundler_common.h"
+#include "sfm/ransac_fundamental.h"
+#include "sfm/ransac_homography.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Bundler Component: Geometric verification of the pairwise matching.
+ *
+ * Every candidate pair from matching is verified by estimating the
+ * fundamental matrix with RANSAC, and only the inlier matches are kept.
+ * The pairs are processed in parallel, where every thread reuses its
+ * buffers for all its pairs. Pairs with too few matches are removed before
+ * any work is done, which are most pairs in practice.
+ *
+ * The feature positions are normalized with the image dimensions of the
+ * feature sets for the RANSAC threshold. Positions of feature sets without
+ * image dimensions are assumed to be normalized already. The focal lengths
+ * of the viewports for the two-view geometry are relative to these
+ * normalized positions.
+ */
+class Verification
+{
+public:
+    /** Options for geometric verification. */
+    struct Options
+    {
+        Options (void);
+
+        /** Options for RANSAC, which runs single-threaded per pair. */
+        RansacFundamental::Options ransac_opts;
+
+        /** Options for the homography RANSAC of the two-view geometry. */
+        RansacHomography::Options homography_opts;
+
+        /** Minimum number of matches of a pair to be verified. */
+        int min_feature_matches;
+
+        /** Minimum number of RANSAC inliers to keep a pair of views. */
+        int min_matching_inliers;
+
+        /**
+         * Computes the two-view geometry of the verified pairs for the
+         * initial pair search: the homography inliers and, for views with a
+         * focal length, the relative pose from the essential matrix and the
+         * triangulated inliers. Defaults to false.
+         */
+        bool compute_geometry;
+
+        /** Number of threads, 0 uses util::ThreadPool::get_num_threads(). */
+        int num_threads;
+
+        /** Produce status messages on the console. */
+        bool verbose_output;
+    };
+
+    /** Statistics of the last verification. */
+    struct Statistics
+    {
+        /** The number of candidate pairs. */
+        std::size_t num_total;
+        /** The number of pairs skipped because of too few matches. */
+        std::size_t num_skipped;
+        /** The number of verified pairs with enough inliers. */
+        std::size_t num_verified;
+        /** The RANSAC statistics summed up over all pairs not skipped. */
+        RansacStatistics ransac_statistics;
+    };
+
+public:
+    explicit Verification (Options const& options);
+
+    /**
+     * Verifies all pairs of the pairwise matching in-place. Pairs that fail
+     * the verification are removed, the order of the pairs is kept.
+     */
+    void compute (ViewportList const& viewports,
+        PairwiseMatching* pairwise_matching);
+
+    /** Returns the statistics of the last call to compute(). */
+    Statistics const& get_statistics (void) const;
+
+private:
+    Options opts;
+    Statistics stats;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Verification::Options::Options (void)
+    : min_feature_matches(24)
+    , min_matching_inliers(12)
+    , compute_geometry(false)
+    , num_threads(0)
+    , verbose_output(false)
+{
+}
+
+inline Verification::Statistics const&
+Verification::get_statistics (void) const
+{
+    return this->stats;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_BUNDLER_VERIFICATION_HEADER */
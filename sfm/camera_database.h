@@ -10,7 +10,6 @@
 #ifndef SFM_CAMERA_DATABASE_HEADER
 #define SFM_CAMERA_DATABASE_HEADER
 
-#include <vector>
 #include <string>
 
 #include "sfm/defines.h"
@@ -22,10 +21,10 @@ SFM_NAMESPACE_BEGIN
  */
 struct CameraModel
 {
-    /** The manufacturer for the camera. */
-    std::string maker;
-    /** The model of the camera. */
-    std::string model;
+    /** The manufacturer for the camera, simplified for the lookup. */
+    char const* maker;
+    /** The model of the camera, simplified for the lookup. */
+    char const* model;
     /** The width of the sensor in milli meters. */
     float sensor_width_mm;
     /** The height of the sensor in milli meters. */
@@ -42,6 +41,10 @@ struct CameraModel
  * Camera database which, given a maker and model string, will look for
  * a camera model in the database and return the model on successful lookup.
  * If the lookup fails, a null pointer is returned.
+ *
+ * The models are a constant table sorted by the simplified maker and model
+ * strings, which requires no initialization, and the lookup is a binary
+ * search. Lookups are safe from multiple threads.
  */
 class CameraDatabase
 {
@@ -55,23 +58,20 @@ public:
 
 private:
     CameraDatabase (void);
-    void add (std::string const& maker, std::string const& model,
-        float sensor_width_mm, float sensor_height_mm,
-        int sensor_width_px, int sensor_height_px);
-
-private:
-    static CameraDatabase* instance;
-    std::vector<CameraModel> data;
 };
 
 /* ------------------------ Implementation ------------------------ */
 
+inline
+CameraDatabase::CameraDatabase (void)
+{
+}
+
 inline CameraDatabase*
 CameraDatabase::get (void)
 {
-    if (CameraDatabase::instance == nullptr)
-        CameraDatabase::instance = new CameraDatabase();
-    return CameraDatabase::instance;
+    static CameraDatabase instance;
+    return &instance;
 }
 
 SFM_NAMESPACE_END
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <cstdint>
+
+#include "sfm/camera_pose.h"
+
+SFM_NAMESPACE_BEGIN
+
+/*
+ * The loops have no dependencies between points and read and write the
+ * arrays in order, the projections and divisions of consecutive points are
+ * computed in SIMD lanes.
+ */
+
+void
+CameraPose::project_points (double const* x, double const* y,
+    double const* z, std::size_t num_points, double* u, double* v,
+    double* depth) const
+{
+    math::Matrix<double, 3, 4> P;
+    this->fill_p_matrix(&P);
+    sfm::project_points(P, x, y, z, num_points, u, v, depth);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+CameraPose::project_points_distorted (double const* x, double const* y,
+    double const* z, std::size_t num_points, double const* dist,
+    double* u, double* v, double* depth) const
+{
+    double const* r = this->R.begin();
+    double const* t = this->t.begin();
+    double const* k = this->K.begin();
+    std::int64_t const num = static_cast<std::int64_t>(num_points);
+#pragma omp simd
+    for (std::int64_t i = 0; i < num; ++i)
+    {
+        double const cx = r[0] * x[i] + r[1] * y[i] + r[2] * z[i] + t[0];
+        double const cy = r[3] * x[i] + r[4] * y[i] + r[5] * z[i] + t[1];
+        double const cz = r[6] * x[i] + r[7] * y[i] + r[8] * z[i] + t[2];
+        double ix = cx / cz;
+        double iy = cy / cz;
+        double const radius2 = ix * ix + iy * iy;
+        double const factor = 1.0 + radius2 * (dist[0] + dist[1] * radius2);
+        ix *= factor;
+        iy *= factor;
+        u[i] = k[0] * ix + k[1] * iy + k[2];
+        v[i] = k[4] * iy + k[5];
+        if (depth != nullptr)
+            depth[i] = cz;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+project_points (math::Matrix<double, 3, 4> const& P,
+    double const* x, double const* y, double const* z,
+    std::size_t num_points, double* u, double* v, double* depth)
+{
+    double const* p = P.begin();
+    std::int64_t const num = static_cast<std::int64_t>(num_points);
+#pragma omp simd
+    for (std::int64_t i = 0; i < num; ++i)
+    {
+        double const px = p[0] * x[i] + p[1] * y[i] + p[2] * z[i] + p[3];
+        double const py = p[4] * x[i] + p[5] * y[i] + p[6] * z[i] + p[7];
+        double const pw = p[8] * x[i] + p[9] * y[i] + p[10] * z[i] + p[11];
+        u[i] = px / pw;
+        v[i] = py / pw;
+        if (depth != nullptr)
+            depth[i] = pw;
+    }
+}
+
+SFM_NAMESPACE_END
@@ -10,6 +10,7 @@
 #ifndef SFM_POSE_HEADER
 #define SFM_POSE_HEADER
 
+#include <cstddef>
 #include <vector>
 
 #include "math/vector.h"
@@ -51,12 +52,44 @@ public:
     /** Returns true if K matrix is valid (non-zero focal length). */
     bool is_valid (void) const;
 
+    /**
+     * Projects the points with coordinates x, y and z to the image
+     * coordinates u and v with the P matrix, see project_points().
+     */
+    void project_points (double const* x, double const* y, double const* z,
+        std::size_t num_points, double* u, double* v,
+        double* depth = nullptr) const;
+
+    /**
+     * Like project_points(), but applies the radial distortion factor
+     * 1 + k0 r^2 + k1 r^4 with the coefficients dist = { k0, k1 } to the
+     * camera coordinates after the perspective divide and before K, which
+     * is the camera model of the bundle adjustment.
+     */
+    void project_points_distorted (double const* x, double const* y,
+        double const* z, std::size_t num_points, double const* dist,
+        double* u, double* v, double* depth = nullptr) const;
+
 public:
     math::Matrix<double, 3, 3> K;
     math::Matrix<double, 3, 3> R;
     math::Vector<double, 3> t;
 };
 
+/**
+ * Projects the points with coordinates in the arrays x, y and z, i.e. in
+ * structure-of-arrays layout, with the 3x4 projection matrix P to the image
+ * coordinates u and v. If depth is not null, the third coordinate before
+ * the perspective divide is stored, which is the depth in the camera for
+ * P = K [R | t]. Points with non-positive depth are projected as well and
+ * must be rejected with the depth if required. All arrays have num_points
+ * elements and are preallocated by the caller.
+ */
+void
+project_points (math::Matrix<double, 3, 4> const& P,
+    double const* x, double const* y, double const* z,
+    std::size_t num_points, double* u, double* v, double* depth = nullptr);
+
 /* ------------------------ Implementation ------------------------ */
 
 inline
@@ -12,6 +12,7 @@
 
 #include <vector>
 
+#include "util/memory.h"
 #include "math/matrix.h"
 #include "sfm/defines.h"
 
@@ -26,7 +27,8 @@ typedef std::vector<Correspondence2D3D> Correspondences2D3D;
 /** The IDs of a matching feature pair in two images. */
 typedef std::pair<int, int> CorrespondenceIndex;
 /** A list of all matching feature pairs in two images. */
-typedef std::vector<CorrespondenceIndex> CorrespondenceIndices;
+typedef util::TrackedVector<CorrespondenceIndex, util::MEMORY_MATCHES>
+    CorrespondenceIndices;
 
 /**
  * Two image coordinates which correspond to each other in terms of observing
@@ -49,6 +51,57 @@ struct Correspondence2D3D
     double p2d[2];
 };
 
+/**
+ * Image correspondences in structure of arrays layout. Consecutive
+ * coordinates allow evaluating several correspondences per SIMD
+ * instruction, e.g. with sampson_distances().
+ */
+struct PackedCorrespondences2D2D
+{
+    PackedCorrespondences2D2D (void) = default;
+    explicit PackedCorrespondences2D2D (Correspondences2D2D const& matches);
+
+    /** Packs the given matches, reusing the allocated memory. */
+    void assign (Correspondences2D2D const& matches);
+    std::size_t size (void) const;
+
+    std::vector<double> x1;
+    std::vector<double> y1;
+    std::vector<double> x2;
+    std::vector<double> y2;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+PackedCorrespondences2D2D::PackedCorrespondences2D2D
+    (Correspondences2D2D const& matches)
+{
+    this->assign(matches);
+}
+
+inline void
+PackedCorrespondences2D2D::assign (Correspondences2D2D const& matches)
+{
+    this->x1.resize(matches.size());
+    this->y1.resize(matches.size());
+    this->x2.resize(matches.size());
+    this->y2.resize(matches.size());
+    for (std::size_t i = 0; i < matches.size(); ++i)
+    {
+        this->x1[i] = matches[i].p1[0];
+        this->y1[i] = matches[i].p1[1];
+        this->x2[i] = matches[i].p2[0];
+        this->y2[i] = matches[i].p2[1];
+    }
+}
+
+inline std::size_t
+PackedCorrespondences2D2D::size (void) const
+{
+    return this->x1.size();
+}
+
 SFM_NAMESPACE_END
 
 #endif  // SFM_CORRESPONDENCE_HEADER
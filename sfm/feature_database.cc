@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "util/exception.h"
+#include "sfm/feature_database.h"
+
+#define FEATURE_DATABASE_SIGNATURE "MVE_FEATURES_B\n"
+#define FEATURE_DATABASE_SIGNATURE_LEN 15
+#define FEATURE_DATABASE_VERSION 2
+#define FEATURE_DATABASE_ALIGNMENT 64
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+namespace
+{
+    int const SIFT_DIMENSIONS = 128;
+    int const SURF_DIMENSIONS = 64;
+    int const KEYPOINT_VALUES = 4;
+
+    /* Header of the file, followed by the view table. */
+    struct FeatureDatabaseHeader
+    {
+        char signature[16];
+        std::uint32_t version;
+        std::uint32_t sift_pca_dimensions;
+        std::uint64_t num_views;
+        std::uint64_t views_offset;
+        std::uint64_t file_size;
+        std::uint64_t padding[2];
+    };
+
+    /* Entry of the view table with the offsets of the feature arrays. */
+    struct FeatureDatabaseView
+    {
+        std::int32_t width;
+        std::int32_t height;
+        std::uint32_t num_positions;
+        std::uint32_t num_colors;
+        std::uint32_t num_sift;
+        std::uint32_t num_surf;
+        std::uint64_t positions_offset;
+        std::uint64_t colors_offset;
+        std::uint64_t sift_keypoints_offset;
+        std::uint64_t sift_descriptors_offset;
+        std::uint64_t surf_keypoints_offset;
+        std::uint64_t surf_descriptors_offset;
+        std::uint64_t sift_pca_offset;
+    };
+
+    static_assert(sizeof(FeatureDatabaseHeader) == 64, "Invalid header size");
+    static_assert(sizeof(FeatureDatabaseView) == 80,
+        "Invalid view entry size");
+    static_assert(sizeof(math::Vector<float, 128>) == 128 * sizeof(float),
+        "SIFT descriptors are not packed");
+    static_assert(sizeof(math::Vector<float, 64>) == 64 * sizeof(float),
+        "SURF descriptors are not packed");
+
+    std::uint64_t
+    align_offset (std::uint64_t offset)
+    {
+        return (offset + FEATURE_DATABASE_ALIGNMENT - 1)
+            / FEATURE_DATABASE_ALIGNMENT * FEATURE_DATABASE_ALIGNMENT;
+    }
+
+    /* Writes the data at the given offset, padding the gap with zeros. */
+    void
+    write_at_offset (util::BinaryWriter& out, std::uint64_t offset,
+        void const* data, std::size_t size)
+    {
+        char const padding[FEATURE_DATABASE_ALIGNMENT] = { 0 };
+        out.write(padding, offset - out.tell());
+        out.write(data, size);
+    }
+
+    /* Reserves an aligned array and returns its offset. */
+    std::uint64_t
+    reserve_array (std::uint64_t* offset, std::uint64_t size)
+    {
+        std::uint64_t const array_offset = align_offset(*offset);
+        *offset = array_offset + size;
+        return array_offset;
+    }
+
+    /* Writes the keypoints and descriptor values as separate arrays. */
+    template <typename DESCRIPTORS, int DIM>
+    void
+    write_descriptors (util::BinaryWriter& out,
+        DESCRIPTORS const& descriptors,
+        std::uint64_t keypoints_offset, std::uint64_t descriptors_offset)
+    {
+        std::vector<float> keypoints(KEYPOINT_VALUES * descriptors.size());
+        for (std::size_t i = 0; i < descriptors.size(); ++i)
+        {
+            keypoints[KEYPOINT_VALUES * i + 0] = descriptors[i].x;
+            keypoints[KEYPOINT_VALUES * i + 1] = descriptors[i].y;
+            keypoints[KEYPOINT_VALUES * i + 2] = descriptors[i].scale;
+            keypoints[KEYPOINT_VALUES * i + 3] = descriptors[i].orientation;
+        }
+        write_at_offset(out, keypoints_offset, keypoints.data(),
+            keypoints.size() * sizeof(float));
+
+        write_at_offset(out, descriptors_offset, nullptr, 0);
+        for (std::size_t i = 0; i < descriptors.size(); ++i)
+            out.write(descriptors[i].data.begin(), DIM * sizeof(float));
+    }
+
+    template <typename DESCRIPTORS, int DIM>
+    void
+    read_descriptors (float const* keypoints, float const* values,
+        std::size_t num_descriptors, DESCRIPTORS* descriptors)
+    {
+        descriptors->resize(num_descriptors);
+        for (std::size_t i = 0; i < num_descriptors; ++i)
+        {
+            typename DESCRIPTORS::value_type& descr = descriptors->at(i);
+            descr.x = keypoints[KEYPOINT_VALUES * i + 0];
+            descr.y = keypoints[KEYPOINT_VALUES * i + 1];
+            descr.scale = keypoints[KEYPOINT_VALUES * i + 2];
+            descr.orientation = keypoints[KEYPOINT_VALUES * i + 3];
+            std::copy(values + DIM * i, values + DIM * (i + 1),
+                descr.data.begin());
+        }
+    }
+
+    /* Writes the SIFT descriptors projected with the PCA. */
+    void
+    write_pca_descriptors (util::BinaryWriter& out,
+        Sift::Descriptors const& descriptors,
+        features::DescriptorPca const& pca, int num_axes,
+        std::uint64_t offset)
+    {
+        write_at_offset(out, offset, nullptr, 0);
+        std::vector<float> projected(num_axes);
+        for (std::size_t i = 0; i < descriptors.size(); ++i)
+        {
+            pca.project(descriptors[i].data.begin(), 1, num_axes,
+                projected.data());
+            out.write(projected.data(), num_axes * sizeof(float));
+        }
+    }
+
+    /* Checks that an array with the given element size is in the file. */
+    bool
+    is_valid_array (std::uint64_t offset, std::uint64_t num,
+        std::uint64_t element_size, std::uint64_t alignment,
+        std::uint64_t file_size)
+    {
+        return offset % alignment == 0 && offset <= file_size
+            && num <= (file_size - offset) / element_size;
+    }
+
+    FeatureDatabaseHeader const&
+    get_header (unsigned char const* data)
+    {
+        if (data == nullptr)
+            throw std::runtime_error("Feature database not open");
+        return *reinterpret_cast<FeatureDatabaseHeader const*>(data);
+    }
+
+    FeatureDatabaseView const&
+    get_view (unsigned char const* data, std::size_t view_id)
+    {
+        FeatureDatabaseHeader const& header = get_header(data);
+        if (view_id >= header.num_views)
+            throw std::out_of_range("Invalid view ID");
+        return reinterpret_cast<FeatureDatabaseView const*>
+            (data + header.views_offset)[view_id];
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+save_feature_database (ViewportList const& viewports,
+    std::string const& filename, features::DescriptorPca const* sift_pca,
+    int sift_pca_dimensions)
+{
+    if (sift_pca != nullptr && (sift_pca->get_dimensions() != SIFT_DIMENSIONS
+        || sift_pca_dimensions < 1 || sift_pca_dimensions > SIFT_DIMENSIONS))
+        throw std::invalid_argument("Invalid SIFT PCA dimensions");
+    std::uint32_t const pca_dims = sift_pca == nullptr ? 0
+        : static_cast<std::uint32_t>(sift_pca_dimensions);
+
+    /* Compute the layout of the file. */
+    FeatureDatabaseHeader header;
+    std::memset(&header, 0, sizeof(FeatureDatabaseHeader));
+    std::copy(FEATURE_DATABASE_SIGNATURE, FEATURE_DATABASE_SIGNATURE
+        + FEATURE_DATABASE_SIGNATURE_LEN, header.signature);
+    header.version = FEATURE_DATABASE_VERSION;
+    header.sift_pca_dimensions = pca_dims;
+    header.num_views = viewports.size();
+    header.views_offset = sizeof(FeatureDatabaseHeader);
+
+    std::uint64_t offset = header.views_offset
+        + viewports.size() * sizeof(FeatureDatabaseView);
+    std::vector<FeatureDatabaseView> views(viewports.size());
+    for (std::size_t i = 0; i < viewports.size(); ++i)
+    {
+        FeatureSet const& vpf = viewports[i].features;
+        std::size_t const max_size = std::max(std::max(vpf.positions.size(),
+            vpf.colors.size()), std::max(vpf.sift_descriptors.size(),
+            vpf.surf_descriptors.size()));
+        if (max_size > std::numeric_limits<std::uint32_t>::max())
+            throw std::invalid_argument("Too many features in view");
+
+        FeatureDatabaseView& view = views[i];
+        std::memset(&view, 0, sizeof(FeatureDatabaseView));
+        view.width = vpf.width;
+        view.height = vpf.height;
+        view.num_positions = static_cast<std::uint32_t>(vpf.positions.size());
+        view.num_colors = static_cast<std::uint32_t>(vpf.colors.size());
+        view.num_sift = static_cast<std::uint32_t>
+            (vpf.sift_descriptors.size());
+        view.num_surf = static_cast<std::uint32_t>
+            (vpf.surf_descriptors.size());
+        view.positions_offset = reserve_array(&offset,
+            view.num_positions * sizeof(math::Vec2f));
+        view.colors_offset = reserve_array(&offset,
+            view.num_colors * sizeof(math::Vec3uc));
+        view.sift_keypoints_offset = reserve_array(&offset,
+            view.num_sift * KEYPOINT_VALUES * sizeof(float));
+        view.sift_descriptors_offset = reserve_array(&offset,
+            view.num_sift * SIFT_DIMENSIONS * sizeof(float));
+        view.surf_keypoints_offset = reserve_array(&offset,
+            view.num_surf * KEYPOINT_VALUES * sizeof(float));
+        view.surf_descriptors_offset = reserve_array(&offset,
+            view.num_surf * SURF_DIMENSIONS * sizeof(float));
+        view.sift_pca_offset = reserve_array(&offset,
+            view.num_sift * pca_dims * sizeof(float));
+    }
+    header.file_size = offset;
+
+    /* Write the header, the table and the arrays in the order of offsets. */
+    util::BinaryWriter out(filename);
+    write_at_offset(out, 0, &header, sizeof(FeatureDatabaseHeader));
+    write_at_offset(out, header.views_offset, views.data(),
+        views.size() * sizeof(FeatureDatabaseView));
+    for (std::size_t i = 0; i < viewports.size(); ++i)
+    {
+        FeatureSet const& vpf = viewports[i].features;
+        write_at_offset(out, views[i].positions_offset,
+            vpf.positions.data(), vpf.positions.size() * sizeof(math::Vec2f));
+        write_at_offset(out, views[i].colors_offset,
+            vpf.colors.data(), vpf.colors.size() * sizeof(math::Vec3uc));
+        write_descriptors<Sift::Descriptors, SIFT_DIMENSIONS>(out,
+            vpf.sift_descriptors, views[i].sift_keypoints_offset,
+            views[i].sift_descriptors_offset);
+        write_descriptors<Surf::Descriptors, SURF_DIMENSIONS>(out,
+            vpf.surf_descriptors, views[i].surf_keypoints_offset,
+            views[i].surf_descriptors_offset);
+        if (sift_pca != nullptr)
+            write_pca_descriptors(out, vpf.sift_descriptors, *sift_pca,
+                sift_pca_dimensions, views[i].sift_pca_offset);
+    }
+    write_at_offset(out, header.file_size, nullptr, 0);
+    out.close();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+FeatureDatabase::open (std::string const& filename)
+{
+    this->close();
+
+    this->mapping.open(filename);
+    this->data = reinterpret_cast<unsigned char const*>(this->mapping.data());
+    this->size = this->mapping.size();
+    if (this->size < sizeof(FeatureDatabaseHeader))
+    {
+        this->close();
+        throw util::FileException(filename, "Invalid feature database");
+    }
+
+    /* Validate the header and the view table, but not the arrays. */
+    FeatureDatabaseHeader const* header
+        = reinterpret_cast<FeatureDatabaseHeader const*>(this->data);
+    bool valid = std::equal(header->signature, header->signature
+        + FEATURE_DATABASE_SIGNATURE_LEN, FEATURE_DATABASE_SIGNATURE);
+    if (valid && header->version != FEATURE_DATABASE_VERSION)
+    {
+        this->close();
+        throw util::FileException(filename,
+            "Unsupported feature database version");
+    }
+    valid = valid && header->file_size == this->size
+        && header->sift_pca_dimensions <= SIFT_DIMENSIONS
+        && is_valid_array(header->views_offset, header->num_views,
+        sizeof(FeatureDatabaseView), FEATURE_DATABASE_ALIGNMENT, this->size);
+
+    for (std::size_t i = 0; valid && i < header->num_views; ++i)
+    {
+        FeatureDatabaseView const& view
+            = reinterpret_cast<FeatureDatabaseView const*>
+            (this->data + header->views_offset)[i];
+        std::uint64_t const size = this->size;
+        valid = is_valid_array(view.positions_offset, view.num_positions,
+                sizeof(math::Vec2f), alignof(math::Vec2f), size)
+            && is_valid_array(view.colors_offset, view.num_colors,
+                sizeof(math::Vec3uc), 1, size)
+            && is_valid_array(view.sift_keypoints_offset, view.num_sift,
+                KEYPOINT_VALUES * sizeof(float), alignof(float), size)
+            && is_valid_array(view.sift_descriptors_offset, view.num_sift,
+                SIFT_DIMENSIONS * sizeof(float), alignof(float), size)
+            && is_valid_array(view.surf_keypoints_offset, view.num_surf,
+                KEYPOINT_VALUES * sizeof(float), alignof(float), size)
+            && is_valid_array(view.surf_descriptors_offset, view.num_surf,
+                SURF_DIMENSIONS * sizeof(float), alignof(float), size)
+            && (header->sift_pca_dimensions == 0 || is_valid_array(
+                view.sift_pca_offset, view.num_sift, header->sift_pca_dimensions
+                * sizeof(float), alignof(float), size));
+    }
+
+    if (!valid)
+    {
+        this->close();
+        throw util::FileException(filename, "Invalid feature database");
+    }
+}
+
+void
+FeatureDatabase::close (void)
+{
+    this->mapping.close();
+    this->data = nullptr;
+    this->size = 0;
+}
+
+std::size_t
+FeatureDatabase::get_num_views (void) const
+{
+    return get_header(this->data).num_views;
+}
+
+int
+FeatureDatabase::get_width (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).width;
+}
+
+int
+FeatureDatabase::get_height (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).height;
+}
+
+std::size_t
+FeatureDatabase::get_num_positions (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).num_positions;
+}
+
+math::Vec2f const*
+FeatureDatabase::get_positions (std::size_t view_id) const
+{
+    return reinterpret_cast<math::Vec2f const*>(this->data
+        + get_view(this->data, view_id).positions_offset);
+}
+
+std::size_t
+FeatureDatabase::get_num_colors (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).num_colors;
+}
+
+math::Vec3uc const*
+FeatureDatabase::get_colors (std::size_t view_id) const
+{
+    return reinterpret_cast<math::Vec3uc const*>(this->data
+        + get_view(this->data, view_id).colors_offset);
+}
+
+std::size_t
+FeatureDatabase::get_num_sift_descriptors (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).num_sift;
+}
+
+float const*
+FeatureDatabase::get_sift_keypoints (std::size_t view_id) const
+{
+    return reinterpret_cast<float const*>(this->data
+        + get_view(this->data, view_id).sift_keypoints_offset);
+}
+
+float const*
+FeatureDatabase::get_sift_descriptors (std::size_t view_id) const
+{
+    return reinterpret_cast<float const*>(this->data
+        + get_view(this->data, view_id).sift_descriptors_offset);
+}
+
+int
+FeatureDatabase::get_sift_pca_dimensions (void) const
+{
+    return static_cast<int>(get_header(this->data).sift_pca_dimensions);
+}
+
+float const*
+FeatureDatabase::get_sift_pca_descriptors (std::size_t view_id) const
+{
+    if (this->get_sift_pca_dimensions() == 0)
+        throw std::runtime_error("No PCA descriptors in feature database");
+    return reinterpret_cast<float const*>(this->data
+        + get_view(this->data, view_id).sift_pca_offset);
+}
+
+std::size_t
+FeatureDatabase::get_num_surf_descriptors (std::size_t view_id) const
+{
+    return get_view(this->data, view_id).num_surf;
+}
+
+float const*
+FeatureDatabase::get_surf_keypoints (std::size_t view_id) const
+{
+    return reinterpret_cast<float const*>(this->data
+        + get_view(this->data, view_id).surf_keypoints_offset);
+}
+
+float const*
+FeatureDatabase::get_surf_descriptors (std::size_t view_id) const
+{
+    return reinterpret_cast<float const*>(this->data
+        + get_view(this->data, view_id).surf_descriptors_offset);
+}
+
+void
+FeatureDatabase::get_features (std::size_t view_id,
+    FeatureSet* features) const
+{
+    FeatureDatabaseView const& view = get_view(this->data, view_id);
+    features->width = view.width;
+    features->height = view.height;
+    math::Vec2f const* positions = this->get_positions(view_id);
+    features->positions.assign(positions, positions + view.num_positions);
+    math::Vec3uc const* colors = this->get_colors(view_id);
+    features->colors.assign(colors, colors + view.num_colors);
+    read_descriptors<Sift::Descriptors, SIFT_DIMENSIONS>(
+        this->get_sift_keypoints(view_id), this->get_sift_descriptors(view_id),
+        view.num_sift, &features->sift_descriptors);
+    read_descriptors<Surf::Descriptors, SURF_DIMENSIONS>(
+        this->get_surf_keypoints(view_id), this->get_surf_descriptors(view_id),
+        view.num_surf, &features->surf_descriptors);
+}
+
+void
+FeatureDatabase::get_viewports (ViewportList* viewports) const
+{
+    std::int64_t const num_views
+        = static_cast<std::int64_t>(this->get_num_views());
+    viewports->clear();
+    viewports->resize(num_views);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (std::int64_t i = 0; i < num_views; ++i)
+        this->get_features(i, &viewports->at(i).features);
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
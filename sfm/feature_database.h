@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_FEATURE_DATABASE_HEADER
+#define SFM_FEATURE_DATABASE_HEADER
+
+#include <cstddef>
+#include <string>
+
+#include "util/binary_io.h"
+#include "math/vector.h"
+#include "features/descriptor_pca.h"
+#include "sfm/bundler_common.h"
+#include "sfm/feature_set.h"
+#include "sfm/defines.h"
+
+SFM_NAMESPACE_BEGIN
+SFM_BUNDLER_NAMESPACE_BEGIN
+
+/**
+ * Saves the features of all viewports to a feature database file.
+ *
+ * The file is in a versioned binary format similar to PrebundleFile: a
+ * header, an offset table with one entry per view, and the flat arrays of
+ * positions, colors, keypoints and descriptors of every view, each aligned
+ * to 64 bytes. The keypoints (x, y, scale, orientation) and the descriptor
+ * values are stored in separate arrays, so the descriptors of a view are
+ * one consecutive block of 128 (SIFT) or 64 (SURF) floats per descriptor.
+ * With a SIFT PCA, the SIFT descriptors projected to the first
+ * 'sift_pca_dimensions' principal axes are stored as an additional array,
+ * which can be matched directly with features::Matching.
+ * The data is stored in the byte order of the machine.
+ */
+void
+save_feature_database (ViewportList const& viewports,
+    std::string const& filename,
+    features::DescriptorPca const* sift_pca = nullptr,
+    int sift_pca_dimensions = 64);
+
+/**
+ * Read-only access to a feature database, which is memory-mapped instead
+ * of parsed. Opening the file only validates the header and the offset
+ * table, the features are read from the mapping on access. Matching can
+ * use the descriptor arrays directly, and only the pages of the accessed
+ * views are loaded into memory. The pointers are valid until the file is
+ * closed, and concurrent reads are safe.
+ */
+class FeatureDatabase
+{
+public:
+    FeatureDatabase (void);
+    ~FeatureDatabase (void);
+    FeatureDatabase (FeatureDatabase const& other) = delete;
+    FeatureDatabase& operator= (FeatureDatabase const& other) = delete;
+
+    /** Maps the file, throws if it is not a valid feature database. */
+    void open (std::string const& filename);
+    /** Unmaps the file, which invalidates all pointers. */
+    void close (void);
+    bool is_open (void) const;
+
+    std::size_t get_num_views (void) const;
+
+    /** Returns the image dimensions of the feature computation. */
+    int get_width (std::size_t view_id) const;
+    int get_height (std::size_t view_id) const;
+
+    /** Returns the feature positions and colors of a view. */
+    std::size_t get_num_positions (std::size_t view_id) const;
+    math::Vec2f const* get_positions (std::size_t view_id) const;
+    std::size_t get_num_colors (std::size_t view_id) const;
+    math::Vec3uc const* get_colors (std::size_t view_id) const;
+
+    /**
+     * Returns the SIFT keypoints, four floats (x, y, scale, orientation)
+     * per descriptor, and the descriptors, 128 floats per descriptor.
+     */
+    std::size_t get_num_sift_descriptors (std::size_t view_id) const;
+    float const* get_sift_keypoints (std::size_t view_id) const;
+    float const* get_sift_descriptors (std::size_t view_id) const;
+
+    /**
+     * Returns the number of values of the projected SIFT descriptors, or
+     * 0 if the database has none.
+     */
+    int get_sift_pca_dimensions (void) const;
+    /** Returns the projected SIFT descriptors, in the order of SIFT. */
+    float const* get_sift_pca_descriptors (std::size_t view_id) const;
+
+    /** Returns the SURF keypoints and descriptors, 64 floats each. */
+    std::size_t get_num_surf_descriptors (std::size_t view_id) const;
+    float const* get_surf_keypoints (std::size_t view_id) const;
+    float const* get_surf_descriptors (std::size_t view_id) const;
+
+    /** Copies the features of a view into the feature set. */
+    void get_features (std::size_t view_id, FeatureSet* features) const;
+
+    /** Copies the features of all views into the viewports. */
+    void get_viewports (ViewportList* viewports) const;
+
+private:
+    util::MappedFile mapping;
+    unsigned char const* data;
+    std::size_t size;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+FeatureDatabase::FeatureDatabase (void)
+    : data(nullptr)
+    , size(0)
+{
+}
+
+inline
+FeatureDatabase::~FeatureDatabase (void)
+{
+    this->close();
+}
+
+inline bool
+FeatureDatabase::is_open (void) const
+{
+    return this->data != nullptr;
+}
+
+SFM_BUNDLER_NAMESPACE_END
+SFM_NAMESPACE_END
+
+#endif /* SFM_FEATURE_DATABASE_HEADER */
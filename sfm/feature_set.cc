@@ -10,7 +10,14 @@
 #include <iostream>
 #include <algorithm>
 
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "core/image_io.h"
 #include "sfm/feature_set.h"
+#include "util/numa.h"
+#include "util/thread_pool.h"
 
 SFM_NAMESPACE_BEGIN
 
@@ -26,17 +33,108 @@ namespace
 
 void
 FeatureSet::compute_features (core::ByteImage::Ptr image)
+{
+    Detectors detectors(this->opts);
+    this->compute_features(image, &detectors);
+}
+
+void
+FeatureSet::compute_features (core::ByteImage::Ptr image,
+    Detectors* detectors)
 {
     this->colors.clear();
     this->positions.clear();
     this->width = image->width();
     this->height = image->height();
 
+    /*
+     * With both feature types and free threads, SURF is detected in a
+     * task of the global pool while this thread detects SIFT. Both read
+     * the same input image and convert it themselves. Within parallel
+     * stages, e.g. batch processing, the detectors run one after another.
+     */
+    bool const use_sift = this->opts.feature_types & FEATURE_SIFT;
+    bool const use_surf = this->opts.feature_types & FEATURE_SURF;
+    Sift::Descriptors sift_descr;
+    Surf::Descriptors surf_descr;
+    if (use_sift && use_surf && util::ThreadPool::resolve_num_threads(0) > 1)
+    {
+        util::TaskGroup group;
+        group.run([&] (void)
+        {
+            compute_surf(image, &detectors->surf, &surf_descr);
+        });
+        compute_sift(image, &detectors->sift, &sift_descr);
+        group.wait();
+    }
+    else
+    {
+        if (use_sift)
+            compute_sift(image, &detectors->sift, &sift_descr);
+        if (use_surf)
+            compute_surf(image, &detectors->surf, &surf_descr);
+    }
+
     /* Make sure these are in the right order. Matching relies on it. */
-    if (this->opts.feature_types & FEATURE_SIFT)
-        this->compute_sift(image);
-    if (this->opts.feature_types & FEATURE_SURF)
-        this->compute_surf(image);
+    if (use_sift)
+    {
+        this->add_features(image, sift_descr);
+        std::swap(sift_descr, this->sift_descriptors);
+    }
+    if (use_surf)
+    {
+        this->add_features(image, surf_descr);
+        std::swap(surf_descr, this->surf_descriptors);
+    }
+}
+
+std::size_t
+FeatureSet::compute_features (std::vector<std::string> const& filenames,
+    Options const& options, int max_images_in_flight,
+    std::vector<FeatureSet>* result)
+{
+    result->clear();
+    result->resize(filenames.size(), FeatureSet(options));
+
+    /*
+     * Every worker loads, converts and processes one image at a time,
+     * the number of workers thus bounds the number of images in memory.
+     * Images are dynamically scheduled since processing times differ.
+     */
+    int num_workers = std::max(1, max_images_in_flight);
+#ifdef _OPENMP
+    if (max_images_in_flight <= 0)
+        num_workers = omp_get_max_threads();
+#endif
+
+    std::size_t num_failed = 0;
+    int const num_images = static_cast<int>(filenames.size());
+#pragma omp parallel num_threads(num_workers)
+    {
+        Detectors detectors(options);
+#pragma omp for schedule(dynamic)
+        for (int i = 0; i < num_images; ++i)
+        {
+            try
+            {
+                core::ByteImage::Ptr image
+                    = core::image::load_file(filenames[i]);
+                result->at(i).compute_features(image, &detectors);
+            }
+            catch (std::exception& e)
+            {
+#pragma omp critical
+                {
+                    std::cerr << "Error processing " << filenames[i]
+                        << ": " << e.what() << std::endl;
+                    num_failed += 1;
+                }
+                result->at(i) = FeatureSet(options);
+            }
+        }
+    }
+
+    return num_failed;
 }
 
 void
@@ -55,51 +153,37 @@ FeatureSet::normalize_feature_positions (void)
 }
 
 void
-FeatureSet::compute_sift (core::ByteImage::ConstPtr image)
+FeatureSet::compute_sift (core::ByteImage::ConstPtr image, Sift* sift,
+    Sift::Descriptors* result)
 {
     /* Compute features. */
-    Sift::Descriptors descr;
-    {
-        Sift sift(this->opts.sift_opts);
-        sift.set_image(image);
-        sift.process();
-        descr = sift.get_descriptors();
-    }
+    sift->set_image(image);
+    sift->process();
+    *result = sift->get_descriptors();
 
     /* Sort features by scale for low-res matching. */
-    std::sort(descr.begin(), descr.end(), compare_scale<sfm::Sift::Descriptor>);
-
-    /* Prepare and copy to data structures. */
-    std::size_t offset = this->positions.size();
-    this->positions.resize(offset + descr.size());
-    this->colors.resize(offset + descr.size());
-
-    for (std::size_t i = 0; i < descr.size(); ++i)
-    {
-        Sift::Descriptor const& d = descr[i];
-        this->positions[offset + i] = math::Vec2f(d.x, d.y);
-        image->linear_at(d.x, d.y, this->colors[offset + i].begin());
-    }
-
-    /* Keep SIFT descriptors. */
-    std::swap(descr, this->sift_descriptors);
+    std::sort(result->begin(), result->end(),
+        compare_scale<sfm::Sift::Descriptor>);
 }
 
 void
-FeatureSet::compute_surf (core::ByteImage::ConstPtr image)
+FeatureSet::compute_surf (core::ByteImage::ConstPtr image, Surf* surf,
+    Surf::Descriptors* result)
 {
     /* Compute features. */
-    Surf::Descriptors descr;
-    {
-        Surf surf(this->opts.surf_opts);
-        surf.set_image(image);
-        surf.process();
-        descr = surf.get_descriptors();
-    }
+    surf->set_image(image);
+    surf->process();
+    *result = surf->get_descriptors();
 
     /* Sort features by scale for low-res matching. */
-    std::sort(descr.begin(), descr.end(), compare_scale<sfm::Surf::Descriptor>);
+    std::sort(result->begin(), result->end(),
+        compare_scale<sfm::Surf::Descriptor>);
+}
 
+template <typename T>
+void
+FeatureSet::add_features (core::ByteImage::ConstPtr image, T const& descr)
+{
     /* Prepare and copy to data structures. */
     std::size_t offset = this->positions.size();
     this->positions.resize(offset + descr.size());
@@ -107,13 +191,10 @@ FeatureSet::compute_surf (core::ByteImage::ConstPtr image)
 
     for (std::size_t i = 0; i < descr.size(); ++i)
     {
-        Surf::Descriptor const& d = descr[i];
-        this->positions[offset + i] = math::Vec2f(d.x, d.y);
-        image->linear_at(d.x, d.y, this->colors[offset + i].begin());
+        this->positions[offset + i] = math::Vec2f(descr[i].x, descr[i].y);
+        image->linear_at(descr[i].x, descr[i].y,
+            this->colors[offset + i].begin());
     }
-
-    /* Keep SURF descriptors. */
-    std::swap(descr, this->surf_descriptors);
 }
 
 void
@@ -125,4 +206,17 @@ FeatureSet::clear_descriptors (void)
     this->surf_descriptors.shrink_to_fit();
 }
 
+bool
+FeatureSet::move_descriptors_to_node (int node)
+{
+    bool moved = true;
+    if (!this->sift_descriptors.empty())
+        moved &= util::move_to_numa_node(this->sift_descriptors.data(),
+            this->sift_descriptors.size() * sizeof(Sift::Descriptor), node);
+    if (!this->surf_descriptors.empty())
+        moved &= util::move_to_numa_node(this->surf_descriptors.data(),
+            this->surf_descriptors.size() * sizeof(Surf::Descriptor), node);
+    return moved;
+}
+
 SFM_NAMESPACE_END
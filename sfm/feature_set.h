@@ -10,6 +10,7 @@
 #ifndef SFM_FEATURE_SET_HEADER
 #define SFM_FEATURE_SET_HEADER
 
+#include <string>
 #include <vector>
 
 #include "math/vector.h"
@@ -47,15 +48,51 @@ public:
         Surf::Options surf_opts;
     };
 
+    /**
+     * The SIFT and SURF detectors for a sequence of images. The detectors
+     * recycle their scale space storage for images of the same size, so a
+     * thread that processes many images keeps one instance.
+     */
+    struct Detectors
+    {
+        explicit Detectors (Options const& options);
+
+        Sift sift;
+        Surf surf;
+    };
+
 public:
     FeatureSet (void);
     explicit FeatureSet (Options const& options);
     void set_options (Options const& options);
 
     // todo compute features
-    /**  Computes the features specified in the options. */
+    /**
+     * Computes the features specified in the options. SIFT and SURF are
+     * detected concurrently if both are requested, except within parallel
+     * stages. The features are stored in the same order either way.
+     */
     void compute_features (core::ByteImage::Ptr image);
 
+    /**
+     * Computes the features specified in the options with the given
+     * detectors, which must be created with the same options.
+     */
+    void compute_features (core::ByteImage::Ptr image, Detectors* detectors);
+
+    /**
+     * Computes the features for a list of image files, one feature set per
+     * image in the same order. Images are loaded, converted and processed
+     * in parallel, and at most 'max_images_in_flight' images are in memory
+     * at the same time. A value of 0 uses one image per available core.
+     * Every worker reuses its detectors for all of its images.
+     * Images that fail to load are reported on the console and yield an
+     * empty feature set. Returns the number of failed images.
+     */
+    static std::size_t compute_features (
+        std::vector<std::string> const& filenames, Options const& options,
+        int max_images_in_flight, std::vector<FeatureSet>* result);
+
     // todo normalizes the features positions
     /** Normalizes the features positions w.r.t. the image dimensions. */
     void normalize_feature_positions (void);
@@ -63,6 +100,12 @@ public:
     /** Clear descriptor data. */
     void clear_descriptors (void);
 
+    /**
+     * Moves the descriptors to the NUMA node of the threads that match
+     * them. Returns false if the memory could not be moved.
+     */
+    bool move_descriptors_to_node (int node);
+
 public:
     /** Image dimension used for feature computation. */
     int width, height;
@@ -76,8 +119,12 @@ public:
     Surf::Descriptors surf_descriptors;
 
 private:
-    void compute_sift (core::ByteImage::ConstPtr image);
-    void compute_surf (core::ByteImage::ConstPtr image);
+    static void compute_sift (core::ByteImage::ConstPtr image, Sift* sift,
+        Sift::Descriptors* result);
+    static void compute_surf (core::ByteImage::ConstPtr image, Surf* surf,
+        Surf::Descriptors* result);
+    template <typename T>
+    void add_features (core::ByteImage::ConstPtr image, T const& descr);
 
 private:
     Options opts;
@@ -91,14 +138,25 @@ FeatureSet::Options::Options (void)
 {
 }
 
+inline
+FeatureSet::Detectors::Detectors (Options const& options)
+    : sift(options.sift_opts)
+    , surf(options.surf_opts)
+{
+}
+
 inline
 FeatureSet::FeatureSet (void)
+    : width(0)
+    , height(0)
 {
 }
 
 inline
 FeatureSet::FeatureSet (Options const& options)
-    : opts(options)
+    : width(0)
+    , height(0)
+    , opts(options)
 {
 }
 
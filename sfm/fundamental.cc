@@ -7,8 +7,14 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <stdexcept>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define SAMPSON_X86_DISPATCH 1
+#endif
 
 #include "math/matrix_tools.h"
 #include "math/matrix_svd.h"
@@ -19,6 +25,13 @@ SFM_NAMESPACE_BEGIN
 
 namespace
 {
+    /*
+     * Minimum number of rows of an over-determined system to solve it with
+     * the 9x9 normal matrix A^T A instead of A. Both have the same right
+     * singular vectors, but the SVD of A is expensive for many rows.
+     */
+    int const NORMAL_MATRIX_MIN_ROWS = 64;
+
     /**
      * Creates the cross product matrix [x] for x. With this matrix,
      * the cross product cross(x, y) can be expressed using matrix
@@ -38,6 +51,67 @@ namespace
         (*result)(2, 1) = v[0];
     }
 
+    /**
+     * Computes the real roots of c[3] x^3 + c[2] x^2 + c[1] x + c[0] and
+     * returns the number of roots. Uses the trigonometric solution for
+     * three real roots and Cardano's formula otherwise.
+     */
+    int
+    solve_cubic_roots (double const* c, double* roots)
+    {
+        double scale = 0.0;
+        for (int i = 0; i < 4; ++i)
+            scale = std::max(scale, std::abs(c[i]));
+        double const epsilon = 1e-12 * scale;
+        if (scale == 0.0)
+            return 0;
+
+        /* Degenerate cases of lower degree. */
+        if (std::abs(c[3]) < epsilon)
+        {
+            if (std::abs(c[2]) < epsilon)
+            {
+                if (std::abs(c[1]) < epsilon)
+                    return 0;
+                roots[0] = -c[0] / c[1];
+                return 1;
+            }
+            double const disc = c[1] * c[1] - 4.0 * c[2] * c[0];
+            if (disc < 0.0)
+                return 0;
+            double const q = -0.5 * (c[1] + std::copysign(std::sqrt(disc),
+                c[1]));
+            roots[0] = q / c[2];
+            if (q == 0.0)
+                return 1;
+            roots[1] = c[0] / q;
+            return 2;
+        }
+
+        double const a = c[2] / c[3];
+        double const b = c[1] / c[3];
+        double const d = c[0] / c[3];
+        double const q = (a * a - 3.0 * b) / 9.0;
+        double const r = (2.0 * a * a * a - 9.0 * a * b + 27.0 * d) / 54.0;
+        double const q3 = q * q * q;
+        if (r * r < q3)
+        {
+            double const theta = std::acos(r / std::sqrt(q3));
+            double const factor = -2.0 * std::sqrt(q);
+            roots[0] = factor * std::cos(theta / 3.0) - a / 3.0;
+            roots[1] = factor * std::cos((theta + 2.0 * MATH_PI) / 3.0)
+                - a / 3.0;
+            roots[2] = factor * std::cos((theta - 2.0 * MATH_PI) / 3.0)
+                - a / 3.0;
+            return 3;
+        }
+
+        double const e = -std::copysign(std::cbrt(std::abs(r)
+            + std::sqrt(r * r - q3)), r);
+        double const f = (e == 0.0) ? 0.0 : q / e;
+        roots[0] = e + f - a / 3.0;
+        return 1;
+    }
 }  // namespace
 
 bool
@@ -65,7 +139,16 @@ fundamental_least_squares (Correspondences2D2D const& points,
 
     /* Compute fundamental matrix using SVD. */
     std::vector<double> V(9 * 9);
-    math::matrix_svd<double>(&A[0], points.size(), 9, nullptr, nullptr, &V[0]);
+    int const rows = static_cast<int>(points.size());
+    if (rows >= NORMAL_MATRIX_MIN_ROWS)
+    {
+        math::Matrix<double, 9, 9> AtA, AtA_V;
+        math::matrix_transpose_multiply(&A[0], rows, 9, AtA.begin());
+        math::matrix_svd_jacobi(AtA, &AtA_V);
+        std::copy(AtA_V.begin(), AtA_V.end(), V.begin());
+    }
+    else
+        math::matrix_svd<double>(&A[0], rows, 9, nullptr, nullptr, &V[0]);
 
     /* Use last column of V as solution. */
     for (int i = 0; i < 9; ++i)
@@ -102,13 +185,71 @@ fundamental_8_point (Eight2DPoints const& points_view_1,
      * vector corresponding to the smallest eigenvalue of A.
      */
     math::Matrix<double, 9, 9> V;
-    math::matrix_svd<double, 8, 9>(A, nullptr, nullptr, &V);
+    math::matrix_svd_jacobi(A, &V);
     math::Vector<double, 9> f = V.col(8);
     std::copy(*f, *f + 9, **result);
 
     return true;
 }
 
+bool
+fundamental_7_point (Seven2DPoints const& points_view_1,
+    Seven2DPoints const& points_view_2,
+    std::vector<FundamentalMatrix>* result)
+{
+    result->clear();
+
+    /* Create 7x9 matrix A, similar to the 8-point algorithm. */
+    math::Matrix<double, 7, 9> A;
+    for (int i = 0; i < 7; ++i)
+    {
+        math::Vector<double, 3> p1 = points_view_1.col(i);
+        math::Vector<double, 3> p2 = points_view_2.col(i);
+        A(i, 0) = p2[0] * p1[0];
+        A(i, 1) = p2[0] * p1[1];
+        A(i, 2) = p2[0] * 1.0;
+        A(i, 3) = p2[1] * p1[0];
+        A(i, 4) = p2[1] * p1[1];
+        A(i, 5) = p2[1] * 1.0;
+        A(i, 6) = 1.0   * p1[0];
+        A(i, 7) = 1.0   * p1[1];
+        A(i, 8) = 1.0   * 1.0;
+    }
+
+    /* The two singular vectors of the null space of A span the solutions. */
+    math::Matrix<double, 9, 9> V;
+    math::matrix_svd_jacobi(A, &V);
+    FundamentalMatrix F1, F2;
+    for (int i = 0; i < 9; ++i)
+    {
+        F1[i] = V(i, 7);
+        F2[i] = V(i, 8);
+    }
+
+    /*
+     * The determinant of F(x) = x F1 + (1 - x) F2 is a cubic polynomial
+     * p(x) = c0 + c1 x + c2 x^2 + c3 x^3. The coefficients are recovered
+     * from p(0), p(1), p(-1) and p(2).
+     */
+    double const p0 = math::matrix_determinant(F2);
+    double const p1 = math::matrix_determinant(F1);
+    double const pm1 = math::matrix_determinant(F2 * 2.0 - F1);
+    double const p2 = math::matrix_determinant(F1 * 2.0 - F2);
+    double coeffs[4];
+    coeffs[0] = p0;
+    coeffs[2] = (p1 + pm1) / 2.0 - p0;
+    double const c1_plus_c3 = (p1 - pm1) / 2.0;
+    coeffs[3] = (p2 - p0 - 4.0 * coeffs[2] - 2.0 * c1_plus_c3) / 6.0;
+    coeffs[1] = c1_plus_c3 - coeffs[3];
+
+    double roots[3];
+    int const num_roots = solve_cubic_roots(coeffs, roots);
+    for (int i = 0; i < num_roots; ++i)
+        result->push_back(F1 * roots[i] + F2 * (1.0 - roots[i]));
+
+    return !result->empty();
+}
+
 void
 enforce_fundamental_constraints (FundamentalMatrix* matrix)
 {
@@ -117,12 +258,17 @@ enforce_fundamental_constraints (FundamentalMatrix* matrix)
      * degrees of freedom. However, F' computed from point correspondences may
      * not have rank 2 and it needs to be enforced. To this end, the SVD is
      * used: F' = USV*, F = UDV* where D = diag(s1, s2, 0) and s1 and s2
-     * are the largest and second largest eigenvalues of F.
+     * are the largest and second largest eigenvalues of F. With the last
+     * right singular vector v3, this is equivalent to F = F' - (F' v3) v3*,
+     * which only requires V.
      */
-    math::Matrix<double, 3, 3> U, S, V;
-    math::matrix_svd(*matrix, &U, &S, &V);
-    S(2, 2) = 0.0;
-    *matrix = U * S * V.transposed();
+    math::Matrix<double, 3, 3> V;
+    math::matrix_svd_jacobi(*matrix, &V);
+    math::Vec3d const v3 = V.col(2);
+    math::Vec3d const u3 = matrix->mult(v3);
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            (*matrix)(i, j) -= u3[i] * v3[j];
 }
 
 void
@@ -246,4 +392,106 @@ sampson_distance (FundamentalMatrix const& F, Correspondence2D2D const& m)
     return p2_F_p1 / sum;
 }
 
+namespace
+{
+    typedef void (*SampsonKernel) (FundamentalMatrix const& F,
+        PackedCorrespondences2D2D const& m, std::size_t begin,
+        std::size_t end, double* result);
+
+    /* Same operations in the same order as sampson_distance(). */
+    void
+    sampson_distances_scalar (FundamentalMatrix const& F,
+        PackedCorrespondences2D2D const& m, std::size_t begin,
+        std::size_t end, double* result)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            double const fx1_0 = m.x1[i] * F[0] + m.y1[i] * F[1] + F[2];
+            double const fx1_1 = m.x1[i] * F[3] + m.y1[i] * F[4] + F[5];
+            double const fx1_2 = m.x1[i] * F[6] + m.y1[i] * F[7] + F[8];
+            double const ftx2_0 = m.x2[i] * F[0] + m.y2[i] * F[3] + F[6];
+            double const ftx2_1 = m.x2[i] * F[1] + m.y2[i] * F[4] + F[7];
+
+            double p2_F_p1 = 0.0;
+            p2_F_p1 += m.x2[i] * fx1_0;
+            p2_F_p1 += m.y2[i] * fx1_1;
+            p2_F_p1 += 1.0 * fx1_2;
+            p2_F_p1 *= p2_F_p1;
+
+            double sum = 0.0;
+            sum += fx1_0 * fx1_0;
+            sum += fx1_1 * fx1_1;
+            sum += ftx2_0 * ftx2_0;
+            sum += ftx2_1 * ftx2_1;
+            result[i] = p2_F_p1 / sum;
+        }
+    }
+
+#if SAMPSON_X86_DISPATCH
+    /*
+     * Four correspondences per instruction. Multiplications and additions
+     * are not fused, which keeps the results identical to the scalar code.
+     */
+    __attribute__((target("avx2"))) void
+    sampson_distances_avx2 (FundamentalMatrix const& F,
+        PackedCorrespondences2D2D const& m, std::size_t begin,
+        std::size_t end, double* result)
+    {
+        __m256d f[9];
+        for (int i = 0; i < 9; ++i)
+            f[i] = _mm256_set1_pd(F[i]);
+
+        std::size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m256d const x1 = _mm256_loadu_pd(m.x1.data() + i);
+            __m256d const y1 = _mm256_loadu_pd(m.y1.data() + i);
+            __m256d const x2 = _mm256_loadu_pd(m.x2.data() + i);
+            __m256d const y2 = _mm256_loadu_pd(m.y2.data() + i);
+
+            __m256d const fx1_0 = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(x1, f[0]), _mm256_mul_pd(y1, f[1])), f[2]);
+            __m256d const fx1_1 = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(x1, f[3]), _mm256_mul_pd(y1, f[4])), f[5]);
+            __m256d const fx1_2 = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(x1, f[6]), _mm256_mul_pd(y1, f[7])), f[8]);
+            __m256d const ftx2_0 = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(x2, f[0]), _mm256_mul_pd(y2, f[3])), f[6]);
+            __m256d const ftx2_1 = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(x2, f[1]), _mm256_mul_pd(y2, f[4])), f[7]);
+
+            __m256d p2_F_p1 = _mm256_add_pd(_mm256_add_pd(
+                _mm256_mul_pd(x2, fx1_0), _mm256_mul_pd(y2, fx1_1)), fx1_2);
+            p2_F_p1 = _mm256_mul_pd(p2_F_p1, p2_F_p1);
+
+            __m256d sum = _mm256_mul_pd(fx1_0, fx1_0);
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(fx1_1, fx1_1));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(ftx2_0, ftx2_0));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(ftx2_1, ftx2_1));
+            _mm256_storeu_pd(result + i, _mm256_div_pd(p2_F_p1, sum));
+        }
+        sampson_distances_scalar(F, m, i, end, result);
+    }
+#endif
+
+    SampsonKernel
+    select_sampson_kernel (void)
+    {
+#if SAMPSON_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return sampson_distances_avx2;
+#endif
+        return sampson_distances_scalar;
+    }
+}
+
+void
+sampson_distances (FundamentalMatrix const& fundamental,
+    PackedCorrespondences2D2D const& matches, double* result)
+{
+    static SampsonKernel const kernel = select_sampson_kernel();
+    kernel(fundamental, matches, 0, matches.size(), result);
+}
+
 SFM_NAMESPACE_END
@@ -56,6 +56,7 @@
 
 SFM_NAMESPACE_BEGIN
 
+typedef math::Matrix<double, 3, 7> Seven2DPoints;
 typedef math::Matrix<double, 3, 8> Eight2DPoints;
 typedef math::Matrix<double, 3, 3> FundamentalMatrix;
 typedef math::Matrix<double, 3, 3> EssentialMatrix;
@@ -89,6 +90,21 @@ bool
 fundamental_8_point (Eight2DPoints const& points_view_1,
     Eight2DPoints const& points_view_2, FundamentalMatrix* result);
 
+/**
+ * Algorithm to compute the fundamental matrix from 7 point correspondences.
+ * The null space of the 7x9 system is two-dimensional, and the rank
+ * constraint det(F) = 0 on F = a F1 + (1 - a) F2 yields a cubic in a with
+ * one or three real roots. It follows [Sect. 11.1.2, Hartley, Zisserman,
+ * 2004]. Returns false if no solution exists.
+ *
+ * This does not normalize the image coordinates for stability. The
+ * resulting matrices have rank 2 and do not need constraint enforcement.
+ */
+bool
+fundamental_7_point (Seven2DPoints const& points_view_1,
+    Seven2DPoints const& points_view_2,
+    std::vector<FundamentalMatrix>* result);
+
 /**
  * Constraints the given matrix to have TWO NON-ZERO eigenvalues.
  * This is done using SVD: F' = USV*, F = UDV* with D = diag(a, b, 0).
@@ -137,6 +153,15 @@ double
 sampson_distance (FundamentalMatrix const& fundamental,
     Correspondence2D2D const& match);
 
+/**
+ * Computes the Sampson distances for all packed image correspondences.
+ * On x86, an AVX2 kernel evaluates four correspondences per instruction if
+ * supported by the CPU. The results equal sampson_distance().
+ */
+void
+sampson_distances (FundamentalMatrix const& fundamental,
+    PackedCorrespondences2D2D const& matches, double* result);
+
 /**
  * Computes a transformation for 2D points in homogeneous coordinates
  * such that the mean of the points is zero and the points fit in the unit
@@ -151,19 +176,8 @@ compute_normalization(math::Matrix<T, 3, DIM> const& points,
 /* ---------------------------------------------------------------- */
 
 #if 0  // This is not yet implemented!
-typedef math::Matrix<double, 3, 7> Seven2DPoints;
 typedef math::Matrix<double, 3, 5> Five2DPoints;
 
-/**
- * Algorithm to compute the fundamental matrix from 7 point correspondences.
- * The algorithm returns one or three possible solutions.
- * The implementation follows [Sect. 11.2, 11.1.2, Hartley, Zisserman, 2004].
- */
-bool
-pose_7_point (Seven2DPoints const& points_view_1,
-    Seven2DPoints const& points_view_2,
-    std::vector<FundamentalMatrix>* result);
-
 /**
  * Algorithm to compute the essential matrix from 5 point correspondences.
  * The algorithm returns up to ten possible solutions.
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <stdexcept>
+
+#include "sfm/guided_matching.h"
+
+SFM_NAMESPACE_BEGIN
+
+GuidedMatching::GuidedMatching (Options const& options)
+    : opts(options)
+{
+    if (this->opts.grid_size < 1)
+        throw std::invalid_argument("Invalid grid size");
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GuidedMatching::build_grid (std::vector<math::Vec2f> const& positions,
+    Grid* grid) const
+{
+    math::Vec2f max_pos = positions[0];
+    grid->min = positions[0];
+    for (std::size_t i = 1; i < positions.size(); ++i)
+        for (int j = 0; j < 2; ++j)
+        {
+            grid->min[j] = std::min(grid->min[j], positions[i][j]);
+            max_pos[j] = std::max(max_pos[j], positions[i][j]);
+        }
+
+    /* Square cells, the grid covers all positions. */
+    float const extent = std::max(max_pos[0] - grid->min[0],
+        max_pos[1] - grid->min[1]);
+    grid->cell_size = std::max(extent, 1e-6f) / this->opts.grid_size;
+    grid->width = std::max(1, static_cast<int>(std::ceil(
+        (max_pos[0] - grid->min[0]) / grid->cell_size)));
+    grid->height = std::max(1, static_cast<int>(std::ceil(
+        (max_pos[1] - grid->min[1]) / grid->cell_size)));
+
+    /* Counting sort of the positions into the cells. */
+    std::vector<int> cells(positions.size());
+    grid->cell_start.assign(grid->width * grid->height + 1, 0);
+    for (std::size_t i = 0; i < positions.size(); ++i)
+    {
+        int const x = std::min(grid->width - 1, static_cast<int>(
+            (positions[i][0] - grid->min[0]) / grid->cell_size));
+        int const y = std::min(grid->height - 1, static_cast<int>(
+            (positions[i][1] - grid->min[1]) / grid->cell_size));
+        cells[i] = y * grid->width + x;
+        grid->cell_start[cells[i] + 1] += 1;
+    }
+    for (std::size_t i = 1; i < grid->cell_start.size(); ++i)
+        grid->cell_start[i] += grid->cell_start[i - 1];
+
+    std::vector<int> offsets(grid->cell_start.begin(),
+        grid->cell_start.end() - 1);
+    grid->indices.resize(positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        grid->indices[offsets[cells[i]]++] = static_cast<int>(i);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GuidedMatching::collect_candidates (Grid const& grid, double const* line,
+    double half_width, std::vector<int>* candidates) const
+{
+    candidates->clear();
+
+    /*
+     * The line is traversed along its major direction. For every column
+     * (or row) of cells, the band covers an interval in the minor direction
+     * which extends the line by half_width * |l| / |l_minor| on each side.
+     */
+    bool const horizontal = std::abs(line[1]) >= std::abs(line[0]);
+    int const major = horizontal ? 0 : 1;
+    int const minor = 1 - major;
+    int const major_cells = horizontal ? grid.width : grid.height;
+    int const minor_cells = horizontal ? grid.height : grid.width;
+    double const norm = std::sqrt(MATH_POW2(line[0]) + MATH_POW2(line[1]));
+    double const slope = -line[major] / line[minor];
+    double const offset = -line[2] / line[minor];
+    double const band = half_width * norm / std::abs(line[minor]);
+
+    for (int i = 0; i < major_cells; ++i)
+    {
+        double const major_1 = grid.min[major] + i * grid.cell_size;
+        double const major_2 = major_1 + grid.cell_size;
+        double const minor_1 = slope * major_1 + offset;
+        double const minor_2 = slope * major_2 + offset;
+        double const lower = std::min(minor_1, minor_2) - band;
+        double const upper = std::max(minor_1, minor_2) + band;
+
+        double const cell_lower = (lower - grid.min[minor]) / grid.cell_size;
+        double const cell_upper = (upper - grid.min[minor]) / grid.cell_size;
+        if (cell_upper < 0.0 || cell_lower >= minor_cells)
+            continue;
+        int const first = static_cast<int>(std::max(0.0, cell_lower));
+        int const last = static_cast<int>(std::min
+            (static_cast<double>(minor_cells - 1), cell_upper));
+
+        for (int j = first; j <= last; ++j)
+        {
+            int const cell = horizontal
+                ? j * grid.width + i : i * grid.width + j;
+            candidates->insert(candidates->end(),
+                grid.indices.begin() + grid.cell_start[cell],
+                grid.indices.begin() + grid.cell_start[cell + 1]);
+        }
+    }
+}
+
+SFM_NAMESPACE_END
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef SFM_GUIDED_MATCHING_HEADER
+#define SFM_GUIDED_MATCHING_HEADER
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "math/defines.h"
+#include "math/vector.h"
+#include "features/matching.h"
+#include "sfm/correspondence.h"
+#include "sfm/defines.h"
+#include "sfm/fundamental.h"
+
+SFM_NAMESPACE_BEGIN
+
+/**
+ * Guided matching of features between two views with a known fundamental
+ * matrix, e.g. from RansacFundamental. For every feature in one view, only
+ * the features in the other view with a Sampson distance below the
+ * threshold are candidates. The positions of the other view are bucketed
+ * into a regular grid, and only grid cells that intersect the band around
+ * the epipolar line are visited. Candidates are then matched with the
+ * usual nearest neighbor criteria, i.e. the distance threshold and the
+ * Lowe ratio test of the matching options.
+ */
+class GuidedMatching
+{
+public:
+    struct Options
+    {
+        Options (void);
+
+        /**
+         * Threshold on the Sampson distance of candidates. Defaults to
+         * 0.0015, which assumes that the positions are normalized.
+         */
+        double threshold;
+
+        /** The number of grid cells along the larger extent of a view. */
+        int grid_size;
+
+        /** The descriptor matching options. */
+        features::Matching::Options matching_opts;
+    };
+
+public:
+    explicit GuidedMatching (Options const& options);
+
+    /**
+     * Matches the features of view 1 to the features of view 2 and vice
+     * versa, given the fundamental matrix F with x2^T F x1 = 0. The
+     * descriptors are consecutive with matching_opts.descriptor_length
+     * elements each. Unsuccessful matches are indicated by negative indices.
+     */
+    template <typename T>
+    void twoway_match (FundamentalMatrix const& fundamental,
+        std::vector<math::Vec2f> const& positions_1, T const* descr_1,
+        std::vector<math::Vec2f> const& positions_2, T const* descr_2,
+        features::Matching::Result* result) const;
+
+private:
+    /** Regular grid of positions in compressed row storage. */
+    struct Grid
+    {
+        math::Vec2f min;
+        float cell_size;
+        int width;
+        int height;
+        std::vector<int> cell_start;
+        std::vector<int> indices;
+    };
+
+    void build_grid (std::vector<math::Vec2f> const& positions,
+        Grid* grid) const;
+
+    /**
+     * Collects the candidates in the grid cells intersecting the band of
+     * the given half width around the line l[0] x + l[1] y + l[2] = 0.
+     */
+    void collect_candidates (Grid const& grid, double const* line,
+        double half_width, std::vector<int>* candidates) const;
+
+    template <typename T>
+    void oneway_match (FundamentalMatrix const& fundamental,
+        std::vector<math::Vec2f> const& positions_1, T const* descr_1,
+        std::vector<math::Vec2f> const& positions_2, T const* descr_2,
+        std::vector<int>* result) const;
+
+private:
+    Options opts;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+GuidedMatching::Options::Options (void)
+    : threshold(0.0015)
+    , grid_size(32)
+{
+    this->matching_opts.descriptor_length = 128;
+    this->matching_opts.lowe_ratio_threshold = 0.8f;
+    this->matching_opts.distance_threshold = std::numeric_limits<float>::max();
+    this->matching_opts.kd_forest_checks = 0;
+}
+
+template <typename T>
+void
+GuidedMatching::twoway_match (FundamentalMatrix const& fundamental,
+    std::vector<math::Vec2f> const& positions_1, T const* descr_1,
+    std::vector<math::Vec2f> const& positions_2, T const* descr_2,
+    features::Matching::Result* result) const
+{
+    this->oneway_match(fundamental, positions_1, descr_1,
+        positions_2, descr_2, &result->matches_1_2);
+    this->oneway_match(fundamental.transposed(), positions_2, descr_2,
+        positions_1, descr_1, &result->matches_2_1);
+}
+
+template <typename T>
+void
+GuidedMatching::oneway_match (FundamentalMatrix const& fundamental,
+    std::vector<math::Vec2f> const& positions_1, T const* descr_1,
+    std::vector<math::Vec2f> const& positions_2, T const* descr_2,
+    std::vector<int>* result) const
+{
+    result->clear();
+    result->resize(positions_1.size(), -1);
+    if (positions_1.empty() || positions_2.empty())
+        return;
+
+    Grid grid;
+    this->build_grid(positions_2, &grid);
+
+    /*
+     * With the epipolar line l = F x1 in view 2 and l' = F^T x2 in view 1,
+     * the Sampson distance is SD = (x2^T F x1)^2 / (|l|^2 + |l'|^2), where
+     * only the first two coefficients of the lines are used. SD < t^2
+     * implies for the distance d of x2 to l that d^2 < t^2 (1 + |l'|^2 /
+     * |l|^2). |l'|^2 is convex in x2 and bounded by its maximum over the
+     * corners of the grid, which bounds the width of the band.
+     */
+    FundamentalMatrix const& F = fundamental;
+    double max_norm_2 = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        double const x = grid.min[0]
+            + (i & 1 ? grid.width : 0) * grid.cell_size;
+        double const y = grid.min[1]
+            + (i & 2 ? grid.height : 0) * grid.cell_size;
+        double const norm_2 = MATH_POW2(F[0] * x + F[3] * y + F[6])
+            + MATH_POW2(F[1] * x + F[4] * y + F[7]);
+        max_norm_2 = std::max(max_norm_2, norm_2);
+    }
+
+    int const dim = this->opts.matching_opts.descriptor_length;
+    double const square_thres = MATH_POW2(this->opts.threshold);
+    float const square_dist_thres
+        = MATH_POW2(this->opts.matching_opts.distance_threshold);
+    float const square_lowe_thres
+        = MATH_POW2(this->opts.matching_opts.lowe_ratio_threshold);
+    std::vector<int> candidates;
+    for (std::size_t i = 0; i < positions_1.size(); ++i)
+    {
+        math::Vec2f const& p1 = positions_1[i];
+        double const line[3] = {
+            F[0] * p1[0] + F[1] * p1[1] + F[2],
+            F[3] * p1[0] + F[4] * p1[1] + F[5],
+            F[6] * p1[0] + F[7] * p1[1] + F[8] };
+        double const norm_1 = MATH_POW2(line[0]) + MATH_POW2(line[1]);
+        if (norm_1 == 0.0)
+            continue;
+
+        double const half_width = this->opts.threshold
+            * std::sqrt(1.0 + max_norm_2 / norm_1);
+        this->collect_candidates(grid, line, half_width, &candidates);
+
+        Correspondence2D2D match;
+        match.p1[0] = p1[0];
+        match.p1[1] = p1[1];
+        T const* query = descr_1 + i * dim;
+        float dist_1st_best = std::numeric_limits<float>::max();
+        float dist_2nd_best = std::numeric_limits<float>::max();
+        int index_1st_best = -1;
+        for (std::size_t j = 0; j < candidates.size(); ++j)
+        {
+            int const index = candidates[j];
+            match.p2[0] = positions_2[index][0];
+            match.p2[1] = positions_2[index][1];
+            if (sampson_distance(F, match) >= square_thres)
+                continue;
+
+            T const* candidate = descr_2
+                + static_cast<std::size_t>(index) * dim;
+            float dist = 0.0f;
+            for (int k = 0; k < dim; ++k)
+            {
+                float const diff = static_cast<float>(query[k])
+                    - static_cast<float>(candidate[k]);
+                dist += diff * diff;
+            }
+
+            if (dist < dist_1st_best)
+            {
+                dist_2nd_best = dist_1st_best;
+                dist_1st_best = dist;
+                index_1st_best = index;
+            }
+            else if (dist < dist_2nd_best)
+                dist_2nd_best = dist;
+        }
+
+        if (index_1st_best < 0 || dist_1st_best > square_dist_thres)
+            continue;
+        if (dist_2nd_best < std::numeric_limits<float>::max()
+            && dist_1st_best / dist_2nd_best > square_lowe_thres)
+            continue;
+        result->at(i) = index_1st_best;
+    }
+}
+
+SFM_NAMESPACE_END
+
+#endif /* SFM_GUIDED_MATCHING_HEADER */
@@ -7,9 +7,15 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <set>
 #include <stdexcept>
 #include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   include <immintrin.h>
+#   define HOMOGRAPHY_X86_DISPATCH 1
+#endif
 
 #include "math/matrix_tools.h"
 #include "math/matrix_svd.h"
@@ -17,43 +23,80 @@
 
 SFM_NAMESPACE_BEGIN
 
+namespace
+{
+    /*
+     * Minimum number of rows of an over-determined system to solve it with
+     * the 9x9 normal matrix A^T A instead of A. Both have the same right
+     * singular vectors, but the SVD of A is expensive for many rows.
+     */
+    int const NORMAL_MATRIX_MIN_ROWS = 64;
+
+    /* Creates the two rows of the DLT system for a correspondence. */
+    void
+    fill_dlt_rows (Correspondence2D2D const& match, double* row1, double* row2)
+    {
+        row1[0] =  0.0;
+        row1[1] =  0.0;
+        row1[2] =  0.0;
+        row1[3] =  match.p1[0];
+        row1[4] =  match.p1[1];
+        row1[5] =  1.0;
+        row1[6] = -match.p1[0] * match.p2[1];
+        row1[7] = -match.p1[1] * match.p2[1];
+        row1[8] = -match.p2[1];
+        row2[0] = -match.p1[0];
+        row2[1] = -match.p1[1];
+        row2[2] = -1.0;
+        row2[3] =  0.0;
+        row2[4] =  0.0;
+        row2[5] =  0.0;
+        row2[6] =  match.p1[0] * match.p2[0];
+        row2[7] =  match.p1[1] * match.p2[0];
+        row2[8] =  match.p2[0];
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
 bool
 homography_dlt (Correspondences2D2D const& points, HomographyMatrix* result)
 {
     if (points.size() < 4)
         throw std::invalid_argument("At least 4 matches required");
 
-    /* Create 2Nx9 matrix A. Each correspondence creates two rows in A. */
-    std::vector<double> A(2 * points.size() * 9);
-    for (std::size_t i = 0; i < points.size(); ++i)
+    /*
+     * Create 2Nx9 matrix A. Each correspondence creates two rows in A.
+     * The minimal case uses the fixed-size SVD without allocation.
+     */
+    math::Matrix<double, 9, 9> V;
+    if (points.size() == 4)
     {
-        std::size_t const row1 = 9 * i;
-        std::size_t const row2 = 9 * (i + points.size());
-        Correspondence2D2D const& match = points[i];
-        A[row1 + 0] =  0.0;
-        A[row1 + 1] =  0.0;
-        A[row1 + 2] =  0.0;
-        A[row1 + 3] =  match.p1[0];
-        A[row1 + 4] =  match.p1[1];
-        A[row1 + 5] =  1.0;
-        A[row1 + 6] = -match.p1[0] * match.p2[1];
-        A[row1 + 7] = -match.p1[1] * match.p2[1];
-        A[row1 + 8] = -match.p2[1];
-        A[row2 + 0] = -match.p1[0];
-        A[row2 + 1] = -match.p1[1];
-        A[row2 + 2] = -1.0;
-        A[row2 + 3] =  0.0;
-        A[row2 + 4] =  0.0;
-        A[row2 + 5] =  0.0;
-        A[row2 + 6] =  match.p1[0] * match.p2[0];
-        A[row2 + 7] =  match.p1[1] * match.p2[0];
-        A[row2 + 8] =  match.p2[0];
+        math::Matrix<double, 8, 9> A;
+        for (int i = 0; i < 4; ++i)
+            fill_dlt_rows(points[i], A.begin() + 9 * i,
+                A.begin() + 9 * (i + 4));
+        math::matrix_svd_jacobi(A, &V);
     }
+    else
+    {
+        std::vector<double> A(2 * points.size() * 9);
+        for (std::size_t i = 0; i < points.size(); ++i)
+            fill_dlt_rows(points[i], &A[9 * i],
+                &A[9 * (i + points.size())]);
 
-    /* Compute homography matrix using SVD. */
-    math::Matrix<double, 9, 9> V;
-    math::matrix_svd<double>(&A[0], 2 * points.size(),
-        9, nullptr, nullptr, V.begin());
+        /* Compute homography matrix using SVD. */
+        int const rows = static_cast<int>(2 * points.size());
+        if (rows >= NORMAL_MATRIX_MIN_ROWS)
+        {
+            math::Matrix<double, 9, 9> AtA;
+            math::matrix_transpose_multiply(&A[0], rows, 9, AtA.begin());
+            math::matrix_svd_jacobi(AtA, &V);
+        }
+        else
+            math::matrix_svd<double>(&A[0], rows, 9,
+                nullptr, nullptr, V.begin());
+    }
 
     /* Only consider the last column of V as the solution. */
     for (int i = 0; i < 9; ++i)
@@ -62,6 +105,125 @@ homography_dlt (Correspondences2D2D const& points, HomographyMatrix* result)
     return true;
 }
 
+namespace
+{
+    /*
+     * Computes the similarity transform that moves the centroid of the
+     * points to the origin and scales their mean distance to sqrt(2), as
+     * scale and offset of x' = scale * x + offset. Returns false if the
+     * points coincide.
+     */
+    bool
+    compute_normalization (double const (*points)[2], int num_points,
+        double* scale, double* offset)
+    {
+        double cx = 0.0, cy = 0.0;
+        for (int i = 0; i < num_points; ++i)
+        {
+            cx += points[i][0];
+            cy += points[i][1];
+        }
+        cx /= static_cast<double>(num_points);
+        cy /= static_cast<double>(num_points);
+
+        double mean_dist = 0.0;
+        for (int i = 0; i < num_points; ++i)
+            mean_dist += std::sqrt(MATH_POW2(points[i][0] - cx)
+                + MATH_POW2(points[i][1] - cy));
+        mean_dist /= static_cast<double>(num_points);
+        if (mean_dist <= 0.0)
+            return false;
+
+        *scale = MATH_SQRT2 / mean_dist;
+        offset[0] = -*scale * cx;
+        offset[1] = -*scale * cy;
+        return true;
+    }
+}
+
+bool
+homography_4point (Correspondence2D2D const* matches,
+    HomographyMatrix* result)
+{
+    double p1[4][2], p2[4][2];
+    for (int i = 0; i < 4; ++i)
+    {
+        std::copy(matches[i].p1, matches[i].p1 + 2, p1[i]);
+        std::copy(matches[i].p2, matches[i].p2 + 2, p2[i]);
+    }
+
+    double s1, s2, o1[2], o2[2];
+    if (!compute_normalization(p1, 4, &s1, o1)
+        || !compute_normalization(p2, 4, &s2, o2))
+        return false;
+
+    /*
+     * Two rows of the system A h = b for every normalized correspondence
+     * (x, y) -> (u, v) with h = (H00, H01, ..., H21) and H22 = 1:
+     *
+     *   H00 x + H01 y + H02 - H20 x u - H21 y u = u
+     *   H10 x + H11 y + H12 - H20 x v - H21 y v = v
+     */
+    double a[8][9];
+    for (int i = 0; i < 4; ++i)
+    {
+        double const x = s1 * p1[i][0] + o1[0];
+        double const y = s1 * p1[i][1] + o1[1];
+        double const u = s2 * p2[i][0] + o2[0];
+        double const v = s2 * p2[i][1] + o2[1];
+        double* r1 = a[2 * i + 0];
+        double* r2 = a[2 * i + 1];
+        r1[0] = x;   r1[1] = y;   r1[2] = 1.0;
+        r1[3] = 0.0; r1[4] = 0.0; r1[5] = 0.0;
+        r1[6] = -x * u; r1[7] = -y * u; r1[8] = u;
+        r2[0] = 0.0; r2[1] = 0.0; r2[2] = 0.0;
+        r2[3] = x;   r2[4] = y;   r2[5] = 1.0;
+        r2[6] = -x * v; r2[7] = -y * v; r2[8] = v;
+    }
+
+    /* Gaussian elimination with partial pivoting and back substitution. */
+    double const pivot_threshold = 1e-10;
+    for (int j = 0; j < 8; ++j)
+    {
+        int pivot = j;
+        for (int i = j + 1; i < 8; ++i)
+            if (std::abs(a[i][j]) > std::abs(a[pivot][j]))
+                pivot = i;
+        if (std::abs(a[pivot][j]) < pivot_threshold)
+            return false;
+        if (pivot != j)
+            std::swap_ranges(a[j] + j, a[j] + 9, a[pivot] + j);
+        for (int i = j + 1; i < 8; ++i)
+        {
+            double const factor = a[i][j] / a[j][j];
+            for (int k = j + 1; k < 9; ++k)
+                a[i][k] -= factor * a[j][k];
+        }
+    }
+    double h[9];
+    h[8] = 1.0;
+    for (int j = 7; j >= 0; --j)
+    {
+        double sum = a[j][8];
+        for (int k = j + 1; k < 8; ++k)
+            sum -= a[j][k] * h[k];
+        h[j] = sum / a[j][j];
+    }
+
+    /* Denormalize with H = T2^-1 H' T1. */
+    HomographyMatrix T1, T2_inv;
+    T1.fill(0.0);
+    T1[0] = s1; T1[2] = o1[0];
+    T1[4] = s1; T1[5] = o1[1];
+    T1[8] = 1.0;
+    T2_inv.fill(0.0);
+    T2_inv[0] = 1.0 / s2; T2_inv[2] = -o2[0] / s2;
+    T2_inv[4] = 1.0 / s2; T2_inv[5] = -o2[1] / s2;
+    T2_inv[8] = 1.0;
+    *result = T2_inv * HomographyMatrix(h) * T1;
+    return true;
+}
+
 double
 symmetric_transfer_error(HomographyMatrix const& homography,
     Correspondence2D2D const& match)
@@ -87,4 +249,112 @@ symmetric_transfer_error(HomographyMatrix const& homography,
     return 0.5 * error;
 }
 
+namespace
+{
+    typedef void (*TransferErrorKernel) (HomographyMatrix const& H,
+        HomographyMatrix const& H_inv, PackedCorrespondences2D2D const& m,
+        std::size_t begin, std::size_t end, double* result);
+
+    /* Same operations in the same order as symmetric_transfer_error(). */
+    void
+    transfer_errors_scalar (HomographyMatrix const& H,
+        HomographyMatrix const& H_inv, PackedCorrespondences2D2D const& m,
+        std::size_t begin, std::size_t end, double* result)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            double const x1 = m.x1[i], y1 = m.y1[i];
+            double const x2 = m.x2[i], y2 = m.y2[i];
+            double const bx = H_inv[0] * x2 + H_inv[1] * y2 + H_inv[2];
+            double const by = H_inv[3] * x2 + H_inv[4] * y2 + H_inv[5];
+            double const bz = H_inv[6] * x2 + H_inv[7] * y2 + H_inv[8];
+            double const fx = H[0] * x1 + H[1] * y1 + H[2];
+            double const fy = H[3] * x1 + H[4] * y1 + H[5];
+            double const fz = H[6] * x1 + H[7] * y1 + H[8];
+
+            double const dx1 = x1 - bx / bz;
+            double const dy1 = y1 - by / bz;
+            double const dx2 = fx / fz - x2;
+            double const dy2 = fy / fz - y2;
+            double const error = (dx1 * dx1 + dy1 * dy1)
+                + (dx2 * dx2 + dy2 * dy2);
+            result[i] = 0.5 * error;
+        }
+    }
+
+#if HOMOGRAPHY_X86_DISPATCH
+    /*
+     * Four correspondences per instruction. Multiplications and additions
+     * are not fused, which keeps the results identical to the scalar code.
+     */
+    __attribute__((target("avx2"))) void
+    transfer_errors_avx2 (HomographyMatrix const& H,
+        HomographyMatrix const& H_inv, PackedCorrespondences2D2D const& m,
+        std::size_t begin, std::size_t end, double* result)
+    {
+        __m256d h[9], h_inv[9];
+        for (int i = 0; i < 9; ++i)
+        {
+            h[i] = _mm256_set1_pd(H[i]);
+            h_inv[i] = _mm256_set1_pd(H_inv[i]);
+        }
+        __m256d const half = _mm256_set1_pd(0.5);
+
+        std::size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m256d const x1 = _mm256_loadu_pd(m.x1.data() + i);
+            __m256d const y1 = _mm256_loadu_pd(m.y1.data() + i);
+            __m256d const x2 = _mm256_loadu_pd(m.x2.data() + i);
+            __m256d const y2 = _mm256_loadu_pd(m.y2.data() + i);
+
+            __m256d const bx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                h_inv[0], x2), _mm256_mul_pd(h_inv[1], y2)), h_inv[2]);
+            __m256d const by = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                h_inv[3], x2), _mm256_mul_pd(h_inv[4], y2)), h_inv[5]);
+            __m256d const bz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                h_inv[6], x2), _mm256_mul_pd(h_inv[7], y2)), h_inv[8]);
+            __m256d const fx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                h[0], x1), _mm256_mul_pd(h[1], y1)), h[2]);
+            __m256d const fy = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                h[3], x1), _mm256_mul_pd(h[4], y1)), h[5]);
+            __m256d const fz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(
+                h[6], x1), _mm256_mul_pd(h[7], y1)), h[8]);
+
+            __m256d const dx1 = _mm256_sub_pd(x1, _mm256_div_pd(bx, bz));
+            __m256d const dy1 = _mm256_sub_pd(y1, _mm256_div_pd(by, bz));
+            __m256d const dx2 = _mm256_sub_pd(_mm256_div_pd(fx, fz), x2);
+            __m256d const dy2 = _mm256_sub_pd(_mm256_div_pd(fy, fz), y2);
+            __m256d const error1 = _mm256_add_pd(
+                _mm256_mul_pd(dx1, dx1), _mm256_mul_pd(dy1, dy1));
+            __m256d const error2 = _mm256_add_pd(
+                _mm256_mul_pd(dx2, dx2), _mm256_mul_pd(dy2, dy2));
+            __m256d const error = _mm256_add_pd(error1, error2);
+            _mm256_storeu_pd(result + i, _mm256_mul_pd(half, error));
+        }
+        transfer_errors_scalar(H, H_inv, m, i, end, result);
+    }
+#endif
+
+    TransferErrorKernel
+    select_transfer_error_kernel (void)
+    {
+#if HOMOGRAPHY_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return transfer_errors_avx2;
+#endif
+        return transfer_errors_scalar;
+    }
+}
+
+void
+symmetric_transfer_errors (HomographyMatrix const& homography,
+    PackedCorrespondences2D2D const& matches, double* result)
+{
+    static TransferErrorKernel const kernel = select_transfer_error_kernel();
+    HomographyMatrix const homography_inv = math::matrix_inverse(homography);
+    kernel(homography, homography_inv, matches, 0, matches.size(), result);
+}
+
 SFM_NAMESPACE_END
@@ -26,6 +26,19 @@ typedef math::Matrix3d HomographyMatrix;
 bool
 homography_dlt (Correspondences2D2D const& matches, HomographyMatrix* result);
 
+/**
+ * Minimal solver for the homography matrix from exactly four image
+ * correspondences. The points are normalized to zero mean and an average
+ * distance of sqrt(2) from the origin, and the 8x8 linear system with the
+ * homography entry H(2,2) of the normalized points set to one is solved by
+ * Gaussian elimination with partial pivoting. This is much faster than the
+ * DLT with SVD and meant for the hypotheses of RANSAC. Returns false for
+ * degenerate configurations, e.g. three collinear points.
+ */
+bool
+homography_4point (Correspondence2D2D const* matches,
+    HomographyMatrix* result);
+
 /**
  * Computes the symmetric transfer error for an image correspondence given the
  * homography matrix between two views.
@@ -34,6 +47,16 @@ double
 symmetric_transfer_error(HomographyMatrix const& homography,
     Correspondence2D2D const& match);
 
+/**
+ * Computes the symmetric transfer errors for all packed image
+ * correspondences. The inverse homography is computed once, and on x86, an
+ * AVX2 kernel evaluates four correspondences per instruction if supported
+ * by the CPU. The results equal symmetric_transfer_error().
+ */
+void
+symmetric_transfer_errors (HomographyMatrix const& homography,
+    PackedCorrespondences2D2D const& matches, double* result);
+
 SFM_NAMESPACE_END
 
 #endif // SFM_HOMOGRAPHY_HEADER
@@ -7,8 +7,9 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#include <complex>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 #include "math/matrix.h"
 #include "math/vector.h"
@@ -18,7 +19,16 @@ SFM_NAMESPACE_BEGIN
 
 namespace
 {
-    void
+    /*
+     * Real parts of the four complex roots of the quartic with the given
+     * factors, highest degree first. The quartic is reduced to the
+     * depressed quartic y^4 + alpha y^2 + beta y + gamma, which is split
+     * into two quadratics with the largest real root m of the resolvent
+     * cubic 8m^3 + 8 alpha m^2 + (2 alpha^2 - 8 gamma) m - beta^2. This
+     * root is non-negative, and all values are real, so no complex
+     * arithmetic is needed.
+     */
+    inline void
     solve_quartic_roots (math::Vec5d const& factors, math::Vec4d* real_roots)
     {
         double const A = factors[0];
@@ -38,51 +48,106 @@ namespace
         double const beta = B3 / (8.0 * A3)- B * C / (2.0 * A2) + D / A;
         double const gamma = -3.0 * B4 / (256.0 * A4) + B2 * C / (16.0 * A3)
             - B * D / (4.0 * A2) + E / A;
-
-        double const alpha2 = alpha * alpha;
-        double const alpha3 = alpha2 * alpha;
-        double const beta2 = beta * beta;
-
-        std::complex<double> P(-alpha2 / 12.0 - gamma, 0.0);
-        std::complex<double> Q(-alpha3 / 108.0
-            + alpha * gamma / 3.0 - beta2 / 8.0, 0.0);
-        std::complex<double> R = -Q / 2.0
-            + std::sqrt(Q * Q / 4.0 + P * P * P / 27.0);
-
-        std::complex<double> U = std::pow(R, 1.0 / 3.0);
-        std::complex<double> y = (U.real() == 0.0)
-            ? -5.0 * alpha / 6.0 - std::pow(Q, 1.0 / 3.0)
-            : -5.0 * alpha / 6.0 - P / (3.0 * U) + U;
-
-        std::complex<double> w = std::sqrt(alpha + 2.0 * y);
-        std::complex<double> part1 = -B / (4.0 * A);
-        std::complex<double> part2 = 3.0 * alpha + 2.0 * y;
-        std::complex<double> part3 = 2.0 * beta / w;
-
-        std::complex<double> complex_roots[4];
-        complex_roots[0] = part1 + 0.5 * (w + std::sqrt(-(part2 + part3)));
-        complex_roots[1] = part1 + 0.5 * (w - std::sqrt(-(part2 + part3)));
-        complex_roots[2] = part1 + 0.5 * (-w + std::sqrt(-(part2 - part3)));
-        complex_roots[3] = part1 + 0.5 * (-w - std::sqrt(-(part2 - part3)));
-
-        for (int i = 0; i < 4; ++i)
-            (*real_roots)[i] = complex_roots[i].real();
+        double const shift = -B / (4.0 * A);
+
+        /* Resolvent cubic m^3 + c2 m^2 + c1 m + c0 in depressed form. */
+        double const c2 = alpha;
+        double const c1 = alpha * alpha / 4.0 - gamma;
+        double const c0 = -beta * beta / 8.0;
+        double const p = c1 - c2 * c2 / 3.0;
+        double const q = 2.0 * c2 * c2 * c2 / 27.0 - c2 * c1 / 3.0 + c0;
+        double const disc = q * q / 4.0 + p * p * p / 27.0;
+        double m;
+        if (disc > 0.0)
+        {
+            double const sqrt_disc = std::sqrt(disc);
+            m = std::cbrt(-q / 2.0 + sqrt_disc)
+                + std::cbrt(-q / 2.0 - sqrt_disc);
+        }
+        else if (p < 0.0)
+        {
+            double const r = std::sqrt(-p / 3.0);
+            double const cos_phi = std::max(-1.0,
+                std::min(1.0, -q / (2.0 * r * r * r)));
+            m = 2.0 * r * std::cos(std::acos(cos_phi) / 3.0);
+        }
+        else
+            m = 0.0;
+        m -= c2 / 3.0;
+
+        /* Polish the root, the closed form loses precision. */
+        for (int i = 0; i < 2; ++i)
+        {
+            double const f = ((m + c2) * m + c1) * m + c0;
+            double const df = (3.0 * m + 2.0 * c2) * m + c1;
+            if (df == 0.0)
+                break;
+            m -= f / df;
+        }
+
+        if (m <= 0.0)
+        {
+            /* Bi-quadratic y^4 + alpha y^2 + gamma for beta = 0. */
+            double const d = alpha * alpha - 4.0 * gamma;
+            double y1, y2;
+            if (d >= 0.0)
+            {
+                /* Real y^2, the real part is zero for negative y^2. */
+                double const z1 = (-alpha + std::sqrt(d)) / 2.0;
+                double const z2 = (-alpha - std::sqrt(d)) / 2.0;
+                y1 = std::sqrt(std::max(0.0, z1));
+                y2 = std::sqrt(std::max(0.0, z2));
+            }
+            else
+            {
+                /* Complex y^2 = a + bi, Re(sqrt(a + bi)) for both. */
+                double const a = -alpha / 2.0;
+                double const abs_z = std::sqrt(a * a - d / 4.0);
+                y1 = std::sqrt(std::max(0.0, (abs_z + a) / 2.0));
+                y2 = y1;
+            }
+            (*real_roots)[0] = shift + y1;
+            (*real_roots)[1] = shift - y1;
+            (*real_roots)[2] = shift + y2;
+            (*real_roots)[3] = shift - y2;
+            return;
+        }
+
+        /* Quadratics y^2 -+ s y + (alpha / 2 + m +- beta / (2 s)). */
+        double const s = std::sqrt(2.0 * m);
+        double const t = beta / (2.0 * s);
+        double const d1 = s * s - 4.0 * (alpha / 2.0 + m + t);
+        double const d2 = s * s - 4.0 * (alpha / 2.0 + m - t);
+        double const e1 = d1 > 0.0 ? std::sqrt(d1) / 2.0 : 0.0;
+        double const e2 = d2 > 0.0 ? std::sqrt(d2) / 2.0 : 0.0;
+        (*real_roots)[0] = shift + s / 2.0 + e1;
+        (*real_roots)[1] = shift + s / 2.0 - e1;
+        (*real_roots)[2] = shift - s / 2.0 + e2;
+        (*real_roots)[3] = shift - s / 2.0 - e2;
     }
-}
+}  /* namespace */
 
 void
 pose_p3p_kneip (
     math::Vec3d p1, math::Vec3d p2, math::Vec3d p3,
     math::Vec3d f1, math::Vec3d f2, math::Vec3d f3,
     std::vector<math::Matrix<double, 3, 4> >* solutions)
+{
+    math::Matrix<double, 3, 4> poses[4];
+    int const num_solutions = pose_p3p_kneip(p1, p2, p3, f1, f2, f3, poses);
+    solutions->assign(poses, poses + num_solutions);
+}
+
+int
+pose_p3p_kneip (
+    math::Vec3d p1, math::Vec3d p2, math::Vec3d p3,
+    math::Vec3d f1, math::Vec3d f2, math::Vec3d f3,
+    math::Matrix<double, 3, 4>* solutions)
 {
     /* Check if points are co-linear. In this case return no solution. */
     double const colinear_threshold = 1e-10;
     if ((p2 - p1).cross(p3 - p1).square_norm() < colinear_threshold)
-    {
-        solutions->clear();
-        return;
-    }
+        return 0;
 
     /* Normalize directions if necessary. */
     double const normalize_epsilon = 1e-10;
@@ -199,8 +264,6 @@ pose_p3p_kneip (
     solve_quartic_roots(factors, &real_roots);
 
     /* Back-substitution of each solution. */
-    solutions->clear();
-    solutions->resize(4);
     for (int i = 0; i < 4; ++i)
     {
         double cot_alpha = (-f_1 * p_1 / f_2 - real_roots[i] * p_2 + d_12 * b)
@@ -232,7 +295,25 @@ pose_p3p_kneip (
         R = R.transposed();
         C = -R * C;
 
-        solutions->at(i) = R.hstack(C);
+        solutions[i] = R.hstack(C);
+    }
+
+    return 4;
+}
+
+void
+pose_p3p_kneip_batch (math::Vec3d const* points,
+    math::Vec3d const* directions, std::size_t num_samples,
+    math::Matrix<double, 3, 4>* solutions, int* num_solutions)
+{
+    std::int64_t const num = static_cast<std::int64_t>(num_samples);
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num; ++i)
+    {
+        math::Vec3d const* p = points + 3 * i;
+        math::Vec3d const* f = directions + 3 * i;
+        num_solutions[i] = pose_p3p_kneip(p[0], p[1], p[2],
+            f[0], f[1], f[2], solutions + 4 * i);
     }
 }
 
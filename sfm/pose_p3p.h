@@ -13,6 +13,7 @@
 #ifndef SFM_POSE_P3P_HEADER
 #define SFM_POSE_P3P_HEADER
 
+#include <cstddef>
 #include <vector>
 
 #include "math/matrix.h"
@@ -44,6 +45,29 @@ pose_p3p_kneip (
     math::Vec3d f1, math::Vec3d f2, math::Vec3d f3,
     std::vector<math::Matrix<double, 3, 4> >* solutions);
 
+/**
+ * Variant of the P3P algorithm that writes the solutions to an array of
+ * four poses without allocation, e.g. for RANSAC. Returns the number of
+ * solutions, which is either four or zero for co-linear points.
+ */
+int
+pose_p3p_kneip (
+    math::Vec3d p1, math::Vec3d p2, math::Vec3d p3,
+    math::Vec3d f1, math::Vec3d f2, math::Vec3d f3,
+    math::Matrix<double, 3, 4>* solutions);
+
+/**
+ * Solves many P3P problems in one call, e.g. all samples of preemptive
+ * RANSAC. Sample i consists of the points points[3i..3i+2] and the
+ * directions directions[3i..3i+2]. Its solutions are written to
+ * solutions[4i..4i+3] and their number to num_solutions[i]. The samples
+ * are solved in parallel and without allocation.
+ */
+void
+pose_p3p_kneip_batch (math::Vec3d const* points,
+    math::Vec3d const* directions, std::size_t num_samples,
+    math::Matrix<double, 3, 4>* solutions, int* num_solutions);
+
 SFM_NAMESPACE_END
 
 #endif /* SFM_POSE_P3P_HEADER */
@@ -7,22 +7,155 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
+#include <stdexcept>
 
 #include "math/functions.h"
 #include "sfm/ransac.h"
 
 SFM_NAMESPACE_BEGIN
 
+RansacStatistics::RansacStatistics (void)
+    : num_estimations(0)
+    , num_iterations(0)
+    , num_hypotheses(0)
+    , sampling_time(0.0)
+    , solving_time(0.0)
+    , scoring_time(0.0)
+    , total_time(0.0)
+    , termination(TERMINATION_MAX_ITERATIONS)
+{
+    std::fill(this->num_terminations,
+        this->num_terminations + TERMINATION_NUM_REASONS, 0);
+}
+
+RansacStatistics&
+RansacStatistics::operator+= (RansacStatistics const& other)
+{
+    this->num_estimations += other.num_estimations;
+    this->num_iterations += other.num_iterations;
+    this->num_hypotheses += other.num_hypotheses;
+    this->sampling_time += other.sampling_time;
+    this->solving_time += other.solving_time;
+    this->scoring_time += other.scoring_time;
+    this->total_time += other.total_time;
+    this->termination = other.termination;
+    for (int i = 0; i < TERMINATION_NUM_REASONS; ++i)
+        this->num_terminations[i] += other.num_terminations[i];
+    return *this;
+}
+
+double
+get_ransac_timestamp (void)
+{
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    return std::chrono::duration_cast<Milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* ---------------------------------------------------------------- */
+
 int
 compute_ransac_iterations (double inlier_ratio,
     int num_samples,
     double desired_success_rate)
 {
     double prob_all_good = math::fastpow(inlier_ratio, num_samples);
+    if (prob_all_good >= 1.0)
+        return 1;
+    if (prob_all_good <= 0.0 || desired_success_rate >= 1.0)
+        return std::numeric_limits<int>::max();
     double num_iterations = std::log(1.0 - desired_success_rate)
         / std::log(1.0 - prob_all_good);
-    return static_cast<int>(math::round(num_iterations));
+    if (num_iterations >= std::numeric_limits<int>::max())
+        return std::numeric_limits<int>::max();
+    return std::max(1, static_cast<int>(math::round(num_iterations)));
+}
+
+void
+compute_prosac_subset_sizes (int num_matches, int num_samples,
+    int growth_iterations, std::vector<int>* subset_sizes)
+{
+    subset_sizes->clear();
+    if (num_matches < num_samples)
+        return;
+
+    /*
+     * T_n is the expected number of samples from the n best matches among
+     * 'growth_iterations' uniform samples from all matches. The subset is
+     * grown at iteration T'_n, where T'_(n+1) = T'_n + ceil(T_(n+1) - T_n).
+     */
+    subset_sizes->resize(std::max(0, growth_iterations), num_matches);
+    int n = num_samples;
+    double t_n = growth_iterations;
+    for (int i = 0; i < num_samples; ++i)
+        t_n *= static_cast<double>(n - i) / (num_matches - i);
+    double t_n_prime = 1.0;
+    for (int t = 1; t <= growth_iterations && n < num_matches; ++t)
+    {
+        if (t > t_n_prime)
+        {
+            double const t_n_next = t_n * (n + 1) / (n + 1 - num_samples);
+            t_n_prime += std::ceil(t_n_next - t_n);
+            t_n = t_n_next;
+            n += 1;
+        }
+        subset_sizes->at(t - 1) = n;
+    }
+}
+
+void
+draw_ransac_sample (int num_matches, int subset_size, int num_samples,
+    std::mt19937* prng, std::vector<int>* sample)
+{
+    if (num_matches < num_samples || num_samples < 1)
+        throw std::invalid_argument("Not enough matches for sample");
+
+    sample->clear();
+    int range = num_matches;
+    if (subset_size >= num_samples && subset_size < num_matches)
+    {
+        sample->push_back(subset_size - 1);
+        range = subset_size - 1;
+    }
+
+    /* Rejection of duplicates, samples are small compared to the range. */
+    std::uniform_int_distribution<int> dist(0, range - 1);
+    while (static_cast<int>(sample->size()) < num_samples)
+    {
+        int const index = dist(*prng);
+        if (std::find(sample->begin(), sample->end(), index) == sample->end())
+            sample->push_back(index);
+    }
+}
+
+int
+compute_required_iterations (std::vector<int> const& inliers,
+    int num_matches, int num_samples, double desired_success_rate,
+    int iteration, std::vector<int> const* subset_sizes)
+{
+    if (subset_sizes == nullptr || subset_sizes->empty())
+        return compute_ransac_iterations(static_cast<double>(inliers.size())
+            / num_matches, num_samples, desired_success_rate);
+
+    int const subset_size = subset_sizes->at(iteration);
+    int const subset_inliers = static_cast<int>(std::lower_bound
+        (inliers.begin(), inliers.end(), subset_size) - inliers.begin());
+    int const num_iterations = compute_ransac_iterations(static_cast<double>
+        (subset_inliers) / subset_size, num_samples, desired_success_rate);
+    if (num_iterations > std::numeric_limits<int>::max() - iteration - 1)
+        return std::numeric_limits<int>::max();
+    return iteration + 1 + num_iterations;
+}
+
+std::mt19937
+get_ransac_generator (unsigned int seed, int iteration)
+{
+    return std::mt19937(seed
+        + 2654435761u * static_cast<unsigned int>(iteration));
 }
 
 SFM_NAMESPACE_END
@@ -10,10 +10,77 @@
 #ifndef SFM_RANSAC_HEADER
 #define SFM_RANSAC_HEADER
 
+#include <random>
+#include <vector>
+
 #include "sfm/defines.h"
 
 SFM_NAMESPACE_BEGIN
 
+/**
+ * Statistics of a RANSAC estimation, e.g. to tune thresholds or to find
+ * pathological problems that take a lot of time. The statistics of many
+ * estimations can be summed up in default constructed statistics, which
+ * does not merge the improvements.
+ */
+struct RansacStatistics
+{
+    /** The reasons for terminating RANSAC. */
+    enum Termination
+    {
+        /** All iterations were run. */
+        TERMINATION_MAX_ITERATIONS,
+        /** Adaptive termination reached the success probability. */
+        TERMINATION_SUCCESS_PROBABILITY,
+        /** Preemptive scoring reduced the hypotheses to a single one. */
+        TERMINATION_PREEMPTIVE,
+        TERMINATION_NUM_REASONS
+    };
+
+    /** The inlier ratio of the best model after it improved. */
+    struct Improvement
+    {
+        int iteration;
+        double inlier_ratio;
+    };
+
+    RansacStatistics (void);
+
+    /** Sums up the statistics of another estimation. */
+    RansacStatistics& operator+= (RansacStatistics const& other);
+
+    /** The number of estimations, which is 1 for a single estimation. */
+    int num_estimations;
+    /** The number of iterations, i.e. samples, that were run. */
+    int num_iterations;
+    /** The number of hypotheses, solvers may yield several per sample. */
+    int num_hypotheses;
+
+    /**
+     * Times in milliseconds for drawing samples, solving for hypotheses and
+     * scoring hypotheses. The times are summed up over all threads.
+     */
+    double sampling_time;
+    double solving_time;
+    double scoring_time;
+    /** Wall time of the estimation in milliseconds. */
+    double total_time;
+
+    /** The termination reason of the last estimation. */
+    Termination termination;
+    /** The number of estimations for every termination reason. */
+    int num_terminations[TERMINATION_NUM_REASONS];
+
+    /** The improvements of the best model in the last estimation. */
+    std::vector<Improvement> improvements;
+};
+
+/** Returns a monotonic time stamp in milliseconds for statistics. */
+double
+get_ransac_timestamp (void);
+
+/* ---------------------------------------------------------------- */
+
 /**
  * The function returns the required number of iterations for a desired
  * RANSAC success rate. If w is the probability of choosing one good sample
@@ -33,6 +100,49 @@ compute_ransac_iterations (double inlier_ratio,
     int num_samples,
     double desired_success_rate = 0.99);
 
+/**
+ * Computes the PROSAC sampling schedule for matches sorted by decreasing
+ * quality. For every iteration, the size n of the subset of the best
+ * matches is returned, which grows from the sample size to all matches
+ * within 'growth_iterations' iterations. A PROSAC sample contains match
+ * n - 1 and further matches from the better ones.
+ *
+ * Reference: "Matching with PROSAC - Progressive Sample Consensus",
+ * O. Chum and J. Matas, CVPR 2005.
+ */
+void
+compute_prosac_subset_sizes (int num_matches, int num_samples,
+    int growth_iterations, std::vector<int>* subset_sizes);
+
+/**
+ * Draws 'num_samples' distinct indices of matches. If 'subset_size' is
+ * smaller than the number of matches, the sample is a PROSAC sample of
+ * match subset_size - 1 and num_samples - 1 matches from the better ones.
+ * Otherwise, the indices are drawn uniformly from all matches.
+ */
+void
+draw_ransac_sample (int num_matches, int subset_size, int num_samples,
+    std::mt19937* prng, std::vector<int>* sample);
+
+/**
+ * Returns the number of iterations required for the success rate after
+ * a model with the given sorted inliers was found in the given iteration.
+ * If PROSAC subset sizes are given, the inlier ratio of the subset sampled
+ * in that iteration is used, and the iterations are counted from there.
+ */
+int
+compute_required_iterations (std::vector<int> const& inliers,
+    int num_matches, int num_samples, double desired_success_rate,
+    int iteration = 0, std::vector<int> const* subset_sizes = nullptr);
+
+/**
+ * Returns the generator for the samples of a RANSAC iteration. The
+ * generator only depends on the seed and the iteration, which makes
+ * samples independent of the evaluation order of the iterations.
+ */
+std::mt19937
+get_ransac_generator (unsigned int seed, int iteration);
+
 SFM_NAMESPACE_END
 
 #endif /* SFM_RANSAC_HEADER */
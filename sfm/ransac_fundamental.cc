@@ -8,75 +8,241 @@
  */
 
 #include <algorithm>
-#include <iostream>
-#include <set>
 #include <stdexcept>
 
-#include "util/system.h"
+#include "util/async_logger.h"
+#include "util/profiler.h"
+#include "util/thread_pool.h"
 #include "math/algo.h"
+#include "sfm/ransac.h"
 #include "sfm/ransac_fundamental.h"
 
 SFM_NAMESPACE_BEGIN
 
+namespace
+{
+    /* Iterations between updates of the required number of iterations. */
+    int const RANSAC_BATCH_SIZE = 32;
+
+    /* Maximum number of refits of the local optimization. */
+    int const RANSAC_LO_ROUNDS = 10;
+
+    /* Verbose messages per second, RANSAC runs for every image pair. */
+    util::LogRateLimit verbose_rate_limit(30);
+
+}
+
+/* ---------------------------------------------------------------- */
+
 RansacFundamental::RansacFundamental (Options const& options)
     : opts(options)
 {
 }
 
 void
-RansacFundamental::estimate (Correspondences2D2D const& matches, Result* result)
+RansacFundamental::estimate (Correspondences2D2D const& matches,
+    Result* result, Workspace* workspace)
 {
+    UTIL_PROFILE_SCOPE("RansacFundamental::estimate");
+    int const sample_size
+        = this->opts.solver == SOLVER_7_POINT ? 7 : 8;
+    if (static_cast<int>(matches.size()) < sample_size)
+        throw std::invalid_argument("Not enough matches for solver");
+
     if (this->opts.verbose_output)
     {
-        std::cout << "RANSAC-F: Running for " << this->opts.max_iterations
-            << " iterations, threshold " << this->opts.threshold
-            << "..." << std::endl;
+        util::AsyncLogger::get_global().log_limited(verbose_rate_limit,
+            util::Logging::LOG_INFO, "RANSAC-F: Running for ",
+            this->opts.max_iterations, " iterations, threshold ",
+            this->opts.threshold, "...");
     }
 
-    std::vector<int> inliers;
-    inliers.reserve(matches.size());
-    for (int iteration = 0; iteration < this->opts.max_iterations; ++iteration)
+    double const start_time = get_ransac_timestamp();
+    Workspace local_workspace;
+    Workspace& ws = workspace != nullptr ? *workspace : local_workspace;
+    result->inliers.clear();
+    RansacStatistics& stats = result->statistics;
+    stats = RansacStatistics();
+    stats.num_estimations = 1;
+
+    int const num_matches = static_cast<int>(matches.size());
+    ws.packed.assign(matches);
+    PackedCorrespondences2D2D const& packed = ws.packed;
+    std::vector<int>& subset_sizes = ws.subset_sizes;
+    subset_sizes.clear();
+    if (this->opts.prosac_sampling)
+        compute_prosac_subset_sizes(num_matches, sample_size,
+            this->opts.max_iterations, &subset_sizes);
+
+    /*
+     * The hypotheses are independent, each iteration seeds its own
+     * generator. Every thread keeps its best hypothesis, and the reduction
+     * prefers the earliest iteration among equal inlier counts. This yields
+     * the result of the serial loop for any number of threads. With
+     * adaptive termination or local optimization, iterations are evaluated
+     * in batches. The best model of a batch is optimized and the required
+     * number of iterations is updated after each batch.
+     */
+    bool const use_batches = this->opts.adaptive_termination
+        || this->opts.local_optimization;
+    int const batch_size = use_batches
+        ? RANSAC_BATCH_SIZE : std::max(1, this->opts.max_iterations);
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+    int required_iterations = this->opts.max_iterations;
+    int best_iteration = -1;
+    int num_iterations = 0;
+    while (num_iterations < required_iterations)
     {
-        FundamentalMatrix fundamental;
-        this->estimate_8_point(matches, &fundamental);
-        this->find_inliers(matches, fundamental, &inliers);
-        if (inliers.size() > result->inliers.size())
+        int const batch_end = std::min(required_iterations,
+            num_iterations + batch_size);
+        std::size_t const num_inliers = result->inliers.size();
+
+#pragma omp parallel num_threads(num_threads)
         {
-            if (this->opts.verbose_output)
+            /* Only a single thread can use the buffers of the workspace. */
+            Workspace thread_workspace;
+            Workspace& tws = num_threads == 1 ? ws : thread_workspace;
+            std::vector<int>& best_inliers = tws.best_inliers;
+            std::vector<int>& inliers = tws.inliers;
+            std::vector<int>& sample = tws.sample;
+            std::vector<double>& distances = tws.distances;
+            std::vector<FundamentalMatrix>& hypotheses = tws.hypotheses;
+            FundamentalMatrix best_fundamental;
+            int best_local_iteration = -1;
+            inliers.reserve(matches.size());
+            RansacStatistics thread_stats;
+
+#pragma omp for schedule(static)
+            for (int iteration = num_iterations; iteration < batch_end;
+                ++iteration)
+            {
+                double const sample_time = get_ransac_timestamp();
+                std::mt19937 prng = get_ransac_generator(this->opts.seed,
+                    iteration);
+                draw_ransac_sample(num_matches, subset_sizes.empty()
+                    ? num_matches : subset_sizes[iteration], sample_size,
+                    &prng, &sample);
+                double const solve_time = get_ransac_timestamp();
+                this->compute_hypotheses(matches, sample, &hypotheses);
+                double const score_time = get_ransac_timestamp();
+
+                /* All solutions of a sample belong to the same iteration. */
+                for (std::size_t i = 0; i < hypotheses.size(); ++i)
+                {
+                    this->find_inliers(packed, hypotheses[i], &distances,
+                        &inliers);
+                    if (best_local_iteration < 0
+                        || inliers.size() > best_inliers.size())
+                    {
+                        best_fundamental = hypotheses[i];
+                        std::swap(best_inliers, inliers);
+                        best_local_iteration = iteration;
+                        inliers.reserve(matches.size());
+                    }
+                }
+
+                double const end_time = get_ransac_timestamp();
+                thread_stats.sampling_time += solve_time - sample_time;
+                thread_stats.solving_time += score_time - solve_time;
+                thread_stats.scoring_time += end_time - score_time;
+                thread_stats.num_hypotheses += hypotheses.size();
+            }
+
+#pragma omp critical
             {
-                std::cout << "RANSAC-F: Iteration " << iteration
-                    << ", inliers " << inliers.size() << " ("
-                    << (100.0 * inliers.size() / matches.size())
-                    << "%)" << std::endl;
+                stats.sampling_time += thread_stats.sampling_time;
+                stats.solving_time += thread_stats.solving_time;
+                stats.scoring_time += thread_stats.scoring_time;
+                stats.num_hypotheses += thread_stats.num_hypotheses;
+                if (best_local_iteration >= 0
+                    && (best_inliers.size() > result->inliers.size()
+                    || (best_inliers.size() == result->inliers.size()
+                    && best_iteration >= num_iterations
+                    && best_local_iteration < best_iteration)))
+                {
+                    result->fundamental = best_fundamental;
+                    std::swap(result->inliers, best_inliers);
+                    best_iteration = best_local_iteration;
+                }
             }
+        }
 
-            result->fundamental = fundamental;
-            std::swap(result->inliers, inliers);
-            inliers.reserve(matches.size());
+        num_iterations = batch_end;
+        if (result->inliers.size() > num_inliers)
+            stats.improvements.push_back(RansacStatistics::Improvement
+                {best_iteration, static_cast<double>(result->inliers.size())
+                / num_matches});
+        if (this->opts.local_optimization
+            && result->inliers.size() > num_inliers)
+        {
+            std::size_t const num_sampled = result->inliers.size();
+            this->optimize_locally(matches, &ws, result);
+            if (result->inliers.size() > num_sampled)
+                stats.improvements.push_back(RansacStatistics::Improvement
+                    {best_iteration, static_cast<double>(
+                    result->inliers.size()) / num_matches});
         }
+        if (this->opts.adaptive_termination
+            && result->inliers.size() > num_inliers)
+            required_iterations = std::min(this->opts.max_iterations,
+                compute_required_iterations(result->inliers, num_matches,
+                sample_size, this->opts.success_probability, best_iteration,
+                &subset_sizes));
+    }
+
+    stats.num_iterations = num_iterations;
+    stats.termination = num_iterations < this->opts.max_iterations
+        ? RansacStatistics::TERMINATION_SUCCESS_PROBABILITY
+        : RansacStatistics::TERMINATION_MAX_ITERATIONS;
+    stats.num_terminations[stats.termination] = 1;
+    stats.total_time = get_ransac_timestamp() - start_time;
+
+    if (this->opts.verbose_output && best_iteration >= 0)
+    {
+        util::AsyncLogger::get_global().log_limited(verbose_rate_limit,
+            util::Logging::LOG_INFO, "RANSAC-F: Iteration ", best_iteration,
+            ", inliers ", result->inliers.size(), " (",
+            100.0 * result->inliers.size() / matches.size(), "%), ",
+            num_iterations, " iterations");
     }
 }
 
 void
-RansacFundamental::estimate_8_point (Correspondences2D2D const& matches,
-    FundamentalMatrix* fundamental)
+RansacFundamental::compute_hypotheses (Correspondences2D2D const& matches,
+    std::vector<int> const& sample,
+    std::vector<FundamentalMatrix>* hypotheses) const
 {
-    if (matches.size() < 8)
-        throw std::invalid_argument("At least 8 matches required");
+    hypotheses->clear();
+    if (this->opts.solver == SOLVER_7_POINT)
+    {
+        if (sample.size() != 7)
+            throw std::invalid_argument("Sample of 7 matches required");
 
-    /*
-     * Draw 8 random numbers in the interval [0, matches.size() - 1]
-     * without duplicates. This is done by keeping a set with drawn numbers.
-     */
-    std::set<int> result;
-    while (result.size() < 8)
-        result.insert(util::system::rand_int() % matches.size());
+        math::Matrix<double, 3, 7> pset1, pset2;
+        for (int i = 0; i < 7; ++i)
+        {
+            Correspondence2D2D const& match = matches[sample[i]];
+            pset1(0, i) = match.p1[0];
+            pset1(1, i) = match.p1[1];
+            pset1(2, i) = 1.0;
+            pset2(0, i) = match.p2[0];
+            pset2(1, i) = match.p2[1];
+            pset2(2, i) = 1.0;
+        }
+
+        /* Up to three solutions with rank 2. */
+        sfm::fundamental_7_point(pset1, pset2, hypotheses);
+        return;
+    }
+
+    if (sample.size() != 8)
+        throw std::invalid_argument("Sample of 8 matches required");
 
     math::Matrix<double, 3, 8> pset1, pset2;
-    std::set<int>::const_iterator iter = result.begin();
-    for (int i = 0; i < 8; ++i, ++iter)
+    for (int i = 0; i < 8; ++i)
     {
-        Correspondence2D2D const& match = matches[*iter];
+        Correspondence2D2D const& match = matches[sample[i]];
         pset1(0, i) = match.p1[0];
         pset1(1, i) = match.p1[1];
         pset1(2, i) = 1.0;
@@ -86,21 +252,57 @@ RansacFundamental::estimate_8_point (Correspondences2D2D const& matches,
     }
 
     /* Compute fundamental matrix using normalized 8-point. */
-    sfm::fundamental_8_point(pset1, pset2, fundamental);
-    sfm::enforce_fundamental_constraints(fundamental);
+    hypotheses->resize(1);
+    sfm::fundamental_8_point(pset1, pset2, &hypotheses->front());
+    sfm::enforce_fundamental_constraints(&hypotheses->front());
 }
 
 void
-RansacFundamental::find_inliers (Correspondences2D2D const& matches,
-    FundamentalMatrix const& fundamental, std::vector<int>* result)
+RansacFundamental::find_inliers (PackedCorrespondences2D2D const& matches,
+    FundamentalMatrix const& fundamental, std::vector<double>* distances,
+    std::vector<int>* result) const
 {
     result->resize(0);
+    distances->resize(matches.size());
+    sampson_distances(fundamental, matches, distances->data());
     double const squared_thres = this->opts.threshold * this->opts.threshold;
     for (std::size_t i = 0; i < matches.size(); ++i)
-    {
-        double error = sampson_distance(fundamental, matches[i]);
-        if (error < squared_thres)
+        if (distances->at(i) < squared_thres)
             result->push_back(i);
+}
+
+void
+RansacFundamental::optimize_locally (Correspondences2D2D const& matches,
+    Workspace* workspace, Result* result) const
+{
+    Correspondences2D2D& inlier_matches = workspace->inlier_matches;
+    std::vector<double>& distances = workspace->distances;
+    std::vector<int>& inliers = workspace->inliers;
+    inliers.reserve(matches.size());
+    for (int round = 0; round < RANSAC_LO_ROUNDS
+        && result->inliers.size() >= 8; ++round)
+    {
+        inlier_matches.resize(result->inliers.size());
+        for (std::size_t i = 0; i < result->inliers.size(); ++i)
+            inlier_matches[i] = matches[result->inliers[i]];
+
+        FundamentalMatrix fundamental;
+        sfm::fundamental_least_squares(inlier_matches, &fundamental);
+        sfm::enforce_fundamental_constraints(&fundamental);
+        this->find_inliers(workspace->packed, fundamental,
+            &distances, &inliers);
+        if (inliers.size() <= result->inliers.size())
+            break;
+
+        if (this->opts.verbose_output)
+        {
+            util::AsyncLogger::get_global().log_limited(verbose_rate_limit,
+                util::Logging::LOG_INFO, "RANSAC-F: Local optimization, ",
+                "inliers ", result->inliers.size(), " -> ", inliers.size());
+        }
+
+        result->fundamental = fundamental;
+        std::swap(result->inliers, inliers);
     }
 }
 
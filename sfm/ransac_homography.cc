@@ -8,17 +8,33 @@
  */
 
 #include <algorithm>
-#include <iostream>
-#include <set>
 #include <stdexcept>
 
-#include "util/system.h"
+#include "util/async_logger.h"
+#include "util/profiler.h"
+#include "util/thread_pool.h"
 #include "math/algo.h"
 #include "math/matrix_tools.h"
+#include "sfm/ransac.h"
 #include "sfm/ransac_homography.h"
 
 SFM_NAMESPACE_BEGIN
 
+namespace
+{
+    /* Iterations between updates of the required number of iterations. */
+    int const RANSAC_BATCH_SIZE = 32;
+
+    /* Maximum number of refits of the local optimization. */
+    int const RANSAC_LO_ROUNDS = 10;
+
+    /* Verbose messages per second, RANSAC runs for every image pair. */
+    util::LogRateLimit verbose_rate_limit(30);
+
+}
+
+/* ---------------------------------------------------------------- */
+
 RansacHomography::RansacHomography (Options const& options)
     : opts(options)
 {
@@ -27,73 +43,214 @@ RansacHomography::RansacHomography (Options const& options)
 void
 RansacHomography::estimate (Correspondences2D2D const& matches, Result* result)
 {
+    UTIL_PROFILE_SCOPE("RansacHomography::estimate");
     if (this->opts.verbose_output)
     {
-        std::cout << "RANSAC-H: Running for " << this->opts.max_iterations
-            << " iterations, threshold " << this->opts.threshold
-            << "..." << std::endl;
+        util::AsyncLogger::get_global().log_limited(verbose_rate_limit,
+            util::Logging::LOG_INFO, "RANSAC-H: Running for ",
+            this->opts.max_iterations, " iterations, threshold ",
+            this->opts.threshold, "...");
     }
 
-    std::vector<int> inliers;
-    inliers.reserve(matches.size());
-    for (int iteration = 0; iteration < this->opts.max_iterations; ++iteration)
+    if (matches.size() < 4)
+        throw std::invalid_argument("At least 4 matches required");
+
+    double const start_time = get_ransac_timestamp();
+    result->inliers.clear();
+    RansacStatistics& stats = result->statistics;
+    stats = RansacStatistics();
+    stats.num_estimations = 1;
+    int const num_matches = static_cast<int>(matches.size());
+    PackedCorrespondences2D2D const packed(matches);
+    std::vector<int> subset_sizes;
+    if (this->opts.prosac_sampling)
+        compute_prosac_subset_sizes(num_matches, 4,
+            this->opts.max_iterations, &subset_sizes);
+
+    /*
+     * The hypotheses are evaluated in parallel like in RANSAC-F. Every
+     * iteration seeds its own generator and the reduction prefers the
+     * earliest iteration among equal inlier counts, which yields the same
+     * result for any number of threads.
+     */
+    bool const use_batches = this->opts.adaptive_termination
+        || this->opts.local_optimization;
+    int const batch_size = use_batches
+        ? RANSAC_BATCH_SIZE : std::max(1, this->opts.max_iterations);
+    int const num_threads
+        = util::ThreadPool::resolve_num_threads(this->opts.num_threads);
+    int required_iterations = this->opts.max_iterations;
+    int best_iteration = -1;
+    int num_iterations = 0;
+    while (num_iterations < required_iterations)
     {
-        HomographyMatrix homography;
-        this->compute_homography(matches, &homography);
-        this->evaluate_homography(matches, homography, &inliers);
-        if (inliers.size() > result->inliers.size())
+        int const batch_end = std::min(required_iterations,
+            num_iterations + batch_size);
+        std::size_t const num_inliers = result->inliers.size();
+
+#pragma omp parallel num_threads(num_threads)
         {
-            if (this->opts.verbose_output)
+            HomographyMatrix best_homography;
+            std::vector<int> best_inliers;
+            int best_local_iteration = -1;
+            std::vector<int> inliers;
+            inliers.reserve(matches.size());
+            std::vector<int> sample;
+            std::vector<double> distances;
+            RansacStatistics thread_stats;
+
+#pragma omp for schedule(static)
+            for (int iteration = num_iterations; iteration < batch_end;
+                ++iteration)
             {
-                std::cout << "RANSAC-H: Iteration " << iteration
-                    << ", inliers " << inliers.size() << " ("
-                    << (100.0 * inliers.size() / matches.size())
-                    << "%)" << std::endl;
+                double const sample_time = get_ransac_timestamp();
+                std::mt19937 prng = get_ransac_generator(this->opts.seed,
+                    iteration);
+                draw_ransac_sample(num_matches, subset_sizes.empty()
+                    ? num_matches : subset_sizes[iteration], 4,
+                    &prng, &sample);
+                double const solve_time = get_ransac_timestamp();
+                HomographyMatrix homography;
+                this->compute_homography(matches, sample, &homography);
+                double const score_time = get_ransac_timestamp();
+                this->find_inliers(packed, homography, &distances, &inliers);
+                double const end_time = get_ransac_timestamp();
+                thread_stats.sampling_time += solve_time - sample_time;
+                thread_stats.solving_time += score_time - solve_time;
+                thread_stats.scoring_time += end_time - score_time;
+                thread_stats.num_hypotheses += 1;
+                if (best_local_iteration < 0
+                    || inliers.size() > best_inliers.size())
+                {
+                    best_homography = homography;
+                    std::swap(best_inliers, inliers);
+                    best_local_iteration = iteration;
+                    inliers.reserve(matches.size());
+                }
             }
 
-            result->homography = homography;
-            std::swap(result->inliers, inliers);
-            inliers.reserve(matches.size());
+#pragma omp critical
+            {
+                stats.sampling_time += thread_stats.sampling_time;
+                stats.solving_time += thread_stats.solving_time;
+                stats.scoring_time += thread_stats.scoring_time;
+                stats.num_hypotheses += thread_stats.num_hypotheses;
+                if (best_local_iteration >= 0
+                    && (best_inliers.size() > result->inliers.size()
+                    || (best_inliers.size() == result->inliers.size()
+                    && best_iteration >= num_iterations
+                    && best_local_iteration < best_iteration)))
+                {
+                    result->homography = best_homography;
+                    std::swap(result->inliers, best_inliers);
+                    best_iteration = best_local_iteration;
+                }
+            }
+        }
+
+        num_iterations = batch_end;
+        if (result->inliers.size() > num_inliers)
+            stats.improvements.push_back(RansacStatistics::Improvement
+                {best_iteration, static_cast<double>(result->inliers.size())
+                / num_matches});
+        if (this->opts.local_optimization
+            && result->inliers.size() > num_inliers)
+        {
+            std::size_t const num_sampled = result->inliers.size();
+            this->optimize_locally(matches, packed, result);
+            if (result->inliers.size() > num_sampled)
+                stats.improvements.push_back(RansacStatistics::Improvement
+                    {best_iteration, static_cast<double>(
+                    result->inliers.size()) / num_matches});
         }
+        if (this->opts.adaptive_termination
+            && result->inliers.size() > num_inliers)
+            required_iterations = std::min(this->opts.max_iterations,
+                compute_required_iterations(result->inliers, num_matches,
+                4, this->opts.success_probability, best_iteration,
+                &subset_sizes));
+    }
+
+    stats.num_iterations = num_iterations;
+    stats.termination = num_iterations < this->opts.max_iterations
+        ? RansacStatistics::TERMINATION_SUCCESS_PROBABILITY
+        : RansacStatistics::TERMINATION_MAX_ITERATIONS;
+    stats.num_terminations[stats.termination] = 1;
+    stats.total_time = get_ransac_timestamp() - start_time;
+
+    if (this->opts.verbose_output && best_iteration >= 0)
+    {
+        util::AsyncLogger::get_global().log_limited(verbose_rate_limit,
+            util::Logging::LOG_INFO, "RANSAC-H: Iteration ", best_iteration,
+            ", inliers ", result->inliers.size(), " (",
+            100.0 * result->inliers.size() / matches.size(), "%), ",
+            num_iterations, " iterations");
     }
 }
 
 void
 RansacHomography::compute_homography (Correspondences2D2D const& matches,
-    HomographyMatrix* homography)
+    std::vector<int> const& sample, HomographyMatrix* homography) const
 {
-    if (matches.size() < 4)
-        throw std::invalid_argument("At least 4 matches required");
-
-    /*
-     * Draw 4 random numbers in the interval [0, matches.size() - 1]
-     * without duplicates. This is done by keeping a set with drawn numbers.
-     */
-    std::set<int> result;
-    while (result.size() < 4)
-        result.insert(util::system::rand_int() % matches.size());
+    if (sample.size() != 4)
+        throw std::invalid_argument("Sample of 4 matches required");
 
-    Correspondences2D2D four_correspondeces(4);
-    std::set<int>::const_iterator iter = result.begin();
-    for (std::size_t i = 0; i < 4; ++i, ++iter)
-        four_correspondeces[i] = matches[*iter];
+    Correspondence2D2D four_correspondences[4];
+    for (std::size_t i = 0; i < 4; ++i)
+        four_correspondences[i] = matches[sample[i]];
 
-    sfm::homography_dlt(four_correspondeces, homography);
+    /* The DLT only handles samples the minimal solver rejects. */
+    if (!sfm::homography_4point(four_correspondences, homography))
+        sfm::homography_dlt(Correspondences2D2D(four_correspondences,
+            four_correspondences + 4), homography);
     *homography /= (*homography)[8];
 }
 
 void
-RansacHomography::evaluate_homography (Correspondences2D2D const& matches,
-    HomographyMatrix const& homography, std::vector<int>* inliers)
+RansacHomography::find_inliers (PackedCorrespondences2D2D const& matches,
+    HomographyMatrix const& homography, std::vector<double>* distances,
+    std::vector<int>* result) const
 {
+    result->resize(0);
+    distances->resize(matches.size());
+    symmetric_transfer_errors(homography, matches, distances->data());
     double const square_threshold = MATH_POW2(this->opts.threshold);
-    inliers->resize(0);
     for (std::size_t i = 0; i < matches.size(); ++i)
+        if (distances->at(i) < square_threshold)
+            result->push_back(i);
+}
+
+void
+RansacHomography::optimize_locally (Correspondences2D2D const& matches,
+    PackedCorrespondences2D2D const& packed, Result* result) const
+{
+    Correspondences2D2D inlier_matches;
+    std::vector<double> distances;
+    std::vector<int> inliers;
+    inliers.reserve(matches.size());
+    for (int round = 0; round < RANSAC_LO_ROUNDS
+        && result->inliers.size() >= 4; ++round)
     {
-        Correspondence2D2D const& match = matches[i];
-        double error = sfm::symmetric_transfer_error(homography, match);
-        if (error < square_threshold)
-            inliers->push_back(i);
+        inlier_matches.resize(result->inliers.size());
+        for (std::size_t i = 0; i < result->inliers.size(); ++i)
+            inlier_matches[i] = matches[result->inliers[i]];
+
+        HomographyMatrix homography;
+        sfm::homography_dlt(inlier_matches, &homography);
+        homography /= homography[8];
+        this->find_inliers(packed, homography, &distances, &inliers);
+        if (inliers.size() <= result->inliers.size())
+            break;
+
+        if (this->opts.verbose_output)
+        {
+            util::AsyncLogger::get_global().log_limited(verbose_rate_limit,
+                util::Logging::LOG_INFO, "RANSAC-H: Local optimization, ",
+                "inliers ", result->inliers.size(), " -> ", inliers.size());
+        }
+
+        result->homography = homography;
+        std::swap(result->inliers, inliers);
     }
 }
 
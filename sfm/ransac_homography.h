@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "sfm/homography.h"
+#include "sfm/ransac.h"
 
 SFM_NAMESPACE_BEGIN
 
@@ -44,6 +45,51 @@ public:
          */
         double threshold;
 
+        /**
+         * Sets the number of threads for evaluating hypotheses. Defaults
+         * to 1, a value of 0 uses the process-wide thread count of
+         * util::ThreadPool, or 1 within other parallel stages. The result
+         * is identical for any number of threads. This requires OpenMP.
+         */
+        int num_threads;
+
+        /**
+         * Seed of the random samples. Every iteration draws its sample from
+         * a generator seeded by this value and the iteration, which makes
+         * the result deterministic for a fixed seed. Defaults to 0.
+         */
+        unsigned int seed;
+
+        /**
+         * Stops early once the number of iterations required for the
+         * success probability is reached. The required number is computed
+         * with compute_ransac_iterations() from the inlier ratio of the best
+         * model and updated whenever a better model is found. Defaults to
+         * false, which always runs max_iterations.
+         */
+        bool adaptive_termination;
+
+        /** Success probability for adaptive termination. Defaults to 0.99. */
+        double success_probability;
+
+        /**
+         * Draws samples with PROSAC, which samples from the best matches
+         * first and progressively includes worse matches until samples are
+         * drawn from all matches after max_iterations. This requires that
+         * the matches are sorted by decreasing quality, e.g. by increasing
+         * Lowe ratio. Defaults to false.
+         */
+        bool prosac_sampling;
+
+        /**
+         * Enables LO-RANSAC. Whenever a better model is found, it is
+         * refitted to all its inliers with least squares and re-scored,
+         * which is repeated while the number of inliers increases. This
+         * reaches the final inlier set in fewer iterations. Defaults to
+         * false.
+         */
+        bool local_optimization;
+
         /**
          * Produce status messages on the console.
          */
@@ -54,7 +100,8 @@ public:
     {
         /**
          * The resulting homography matrix which led to the inliers.
-         * This is NOT the re-computed matrix from the inliers.
+         * This is NOT the re-computed matrix from the inliers, unless
+         * local optimization is enabled.
          */
         HomographyMatrix homography;
 
@@ -63,6 +110,9 @@ public:
          * homography matrix.
          */
         std::vector<int> inliers;
+
+        /** Statistics of the estimation. */
+        RansacStatistics statistics;
     };
 
 public:
@@ -71,9 +121,12 @@ public:
 
 private:
     void compute_homography (Correspondences2D2D const& matches,
-        HomographyMatrix* homography);
-    void evaluate_homography (Correspondences2D2D const& matches,
-        HomographyMatrix const& homography, std::vector<int>* inliers);
+        std::vector<int> const& sample, HomographyMatrix* homography) const;
+    void find_inliers (PackedCorrespondences2D2D const& matches,
+        HomographyMatrix const& homography, std::vector<double>* distances,
+        std::vector<int>* result) const;
+    void optimize_locally (Correspondences2D2D const& matches,
+        PackedCorrespondences2D2D const& packed, Result* result) const;
 
 private:
     Options opts;
@@ -85,6 +138,12 @@ inline
 RansacHomography::Options::Options (void)
     : max_iterations(1000)
     , threshold(0.005)
+    , num_threads(1)
+    , seed(0)
+    , adaptive_termination(false)
+    , success_probability(0.99)
+    , prosac_sampling(false)
+    , local_optimization(false)
     , verbose_output(false)
 {
 }
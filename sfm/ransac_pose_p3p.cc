@@ -7,17 +7,42 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
-#include <set>
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <numeric>
+#include <stdexcept>
 
-#include "util/system.h"
 #include "math/matrix_tools.h"
+#include "sfm/camera_pose.h"
+#include "sfm/ransac.h"
 #include "sfm/ransac_pose_p3p.h"
 #include "sfm/pose_p3p.h"
 
 SFM_NAMESPACE_BEGIN
 
+namespace
+{
+    /* A hypothesis of preemptive RANSAC with its projection matrix K[R|t]. */
+    struct PreemptiveHypothesis
+    {
+        math::Matrix<double, 3, 4> projection;
+        int pose_id;
+        int score;
+    };
+
+    /* Orders by decreasing score, ties are broken by the sample order. */
+    bool
+    compare_hypotheses (PreemptiveHypothesis const& a,
+        PreemptiveHypothesis const& b)
+    {
+        return a.score != b.score ? a.score > b.score : a.pose_id < b.pose_id;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
 RansacPoseP3P::RansacPoseP3P (Options const& options)
     : opts(options)
 {
@@ -34,35 +59,91 @@ RansacPoseP3P::estimate (Correspondences2D3D const& corresp,
             << "..." << std::endl;
     }
 
+    if (corresp.size() < 3)
+        throw std::invalid_argument("At least 3 correspondences required");
+
+    double const start_time = get_ransac_timestamp();
+    RansacStatistics& stats = result->statistics;
+    stats = RansacStatistics();
+    stats.num_estimations = 1;
+
+    int const num_corresp = static_cast<int>(corresp.size());
+    std::vector<int> subset_sizes;
+    if (this->opts.prosac_sampling)
+        compute_prosac_subset_sizes(num_corresp, 3,
+            this->opts.max_iterations, &subset_sizes);
+
+    PointArrays points;
+    points.x.resize(corresp.size());
+    points.y.resize(corresp.size());
+    points.z.resize(corresp.size());
+    for (std::size_t i = 0; i < corresp.size(); ++i)
+    {
+        points.x[i] = corresp[i].p3d[0];
+        points.y[i] = corresp[i].p3d[1];
+        points.z[i] = corresp[i].p3d[2];
+    }
+
+    if (this->opts.preemptive_scoring)
+    {
+        this->estimate_preemptive(corresp, k_matrix, points, subset_sizes,
+            result);
+        stats.total_time = get_ransac_timestamp() - start_time;
+        return;
+    }
+
     /* Pre-compute inverse K matrix to compute directions from corresp. */
     math::Matrix<double, 3, 3> inv_k_matrix = math::matrix_inverse(k_matrix);
-    std::atomic<int> num_iterations;
+    std::atomic<int> num_iterations(0);
+    /* Iterations beyond the required number are skipped. */
+    std::atomic<int> required_iterations(this->opts.max_iterations);
 
 #pragma omp parallel
     {
         std::vector<int> inliers;
         inliers.reserve(corresp.size());
+        std::vector<double> buffer;
+        std::vector<int> sample;
+        RansacStatistics thread_stats;
 #pragma omp for
         for (int i = 0; i < this->opts.max_iterations; ++i)
         {
-            int iteration = i;
-            if (this->opts.verbose_output)
-                iteration = num_iterations++;
+            if (i >= required_iterations)
+                continue;
+
+            int const iteration = num_iterations++;
 
             /* Compute up to four poses [R|t] using P3P algorithm. */
-            PutativePoses poses;
-            this->compute_p3p(corresp, inv_k_matrix, &poses);
+            double const sample_time = get_ransac_timestamp();
+            std::mt19937 prng = get_ransac_generator(this->opts.seed, i);
+            draw_ransac_sample(num_corresp, subset_sizes.empty()
+                ? num_corresp : subset_sizes[i], 3, &prng, &sample);
+            double const solve_time = get_ransac_timestamp();
+            Pose poses[4];
+            int const num_poses = this->compute_p3p(corresp, sample,
+                inv_k_matrix, poses);
+            double const score_time = get_ransac_timestamp();
+            thread_stats.sampling_time += solve_time - sample_time;
+            thread_stats.solving_time += score_time - solve_time;
+            thread_stats.num_hypotheses += num_poses;
 
             /* Check all putative solutions and count inliers. */
-            for (std::size_t j = 0; j < poses.size(); ++j)
+            for (int j = 0; j < num_poses; ++j)
             {
-                this->find_inliers(corresp, k_matrix, poses[j], &inliers);
+                double const find_time = get_ransac_timestamp();
+                this->find_inliers(corresp, points, k_matrix * poses[j],
+                    &buffer, &inliers);
+                thread_stats.scoring_time += get_ransac_timestamp()
+                    - find_time;
 #pragma omp critical
                 if (inliers.size() > result->inliers.size())
                 {
                     result->pose = poses[j];
                     std::swap(result->inliers, inliers);
                     inliers.reserve(corresp.size());
+                    stats.improvements.push_back(RansacStatistics::Improvement
+                        {i, static_cast<double>(result->inliers.size())
+                        / num_corresp});
 
                     if (this->opts.verbose_output)
                     {
@@ -71,30 +152,184 @@ RansacPoseP3P::estimate (Correspondences2D3D const& corresp,
                             << (100.0 * result->inliers.size() / corresp.size())
                             << "%)" << std::endl;
                     }
+
+                    if (this->opts.adaptive_termination)
+                        required_iterations = std::min(
+                            this->opts.max_iterations,
+                            compute_required_iterations(result->inliers,
+                            num_corresp, 3, this->opts.success_probability,
+                            i, &subset_sizes));
                 }
             }
         }
+
+#pragma omp critical
+        {
+            stats.sampling_time += thread_stats.sampling_time;
+            stats.solving_time += thread_stats.solving_time;
+            stats.scoring_time += thread_stats.scoring_time;
+            stats.num_hypotheses += thread_stats.num_hypotheses;
+        }
     }
+
+    stats.num_iterations = num_iterations;
+    stats.termination = num_iterations < this->opts.max_iterations
+        ? RansacStatistics::TERMINATION_SUCCESS_PROBABILITY
+        : RansacStatistics::TERMINATION_MAX_ITERATIONS;
+    stats.num_terminations[stats.termination] = 1;
+    stats.total_time = get_ransac_timestamp() - start_time;
 }
 
 void
+RansacPoseP3P::estimate_preemptive (Correspondences2D3D const& corresp,
+    math::Matrix<double, 3, 3> const& k_matrix, PointArrays const& points,
+    std::vector<int> const& subset_sizes, Result* result) const
+{
+    int const num_corresp = static_cast<int>(corresp.size());
+    int const num_samples = std::max(1, this->opts.max_iterations);
+    math::Matrix<double, 3, 3> inv_k_matrix = math::matrix_inverse(k_matrix);
+
+    /* Draw all samples and convert them to 3D points and directions. */
+    std::vector<math::Vec3d> sample_points(3 * num_samples);
+    std::vector<math::Vec3d> sample_directions(3 * num_samples);
+    RansacStatistics& stats = result->statistics;
+    double const sample_time = get_ransac_timestamp();
+#pragma omp parallel
+    {
+        std::vector<int> sample;
+#pragma omp for
+        for (int i = 0; i < num_samples; ++i)
+        {
+            std::mt19937 prng = get_ransac_generator(this->opts.seed, i);
+            draw_ransac_sample(num_corresp, subset_sizes.empty()
+                ? num_corresp : subset_sizes[i], 3, &prng, &sample);
+            for (int j = 0; j < 3; ++j)
+            {
+                Correspondence2D3D const& c = corresp[sample[j]];
+                sample_points[3 * i + j] = math::Vec3d(c.p3d);
+                sample_directions[3 * i + j] = inv_k_matrix.mult(
+                    math::Vec3d(c.p2d[0], c.p2d[1], 1.0));
+            }
+        }
+    }
+
+    /* Generate all hypotheses, every sample yields up to four poses. */
+    double const solve_time = get_ransac_timestamp();
+    std::vector<Pose> poses(4 * num_samples);
+    std::vector<int> num_poses(num_samples, 0);
+    pose_p3p_kneip_batch(&sample_points[0], &sample_directions[0],
+        num_samples, &poses[0], &num_poses[0]);
+    stats.sampling_time += solve_time - sample_time;
+    stats.solving_time += get_ransac_timestamp() - solve_time;
+
+    std::vector<PreemptiveHypothesis> hypotheses;
+    hypotheses.reserve(poses.size());
+    for (int i = 0; i < num_samples; ++i)
+        for (int j = 0; j < num_poses[i]; ++j)
+        {
+            hypotheses.push_back(PreemptiveHypothesis());
+            hypotheses.back().projection = k_matrix * poses[4 * i + j];
+            hypotheses.back().pose_id = 4 * i + j;
+            hypotheses.back().score = 0;
+        }
+    stats.num_iterations = num_samples;
+    stats.num_hypotheses = static_cast<int>(hypotheses.size());
+    stats.termination = RansacStatistics::TERMINATION_PREEMPTIVE;
+    stats.num_terminations[stats.termination] = 1;
+    if (hypotheses.empty())
+        return;
+
+    double const score_time = get_ransac_timestamp();
+
+    /* The blocks are drawn from a random order of the correspondences. */
+    std::vector<int> order(num_corresp);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 prng = get_ransac_generator(this->opts.seed, num_samples);
+    std::shuffle(order.begin(), order.end(), prng);
+    PointArrays shuffled;
+    shuffled.x.resize(num_corresp);
+    shuffled.y.resize(num_corresp);
+    shuffled.z.resize(num_corresp);
+    for (int i = 0; i < num_corresp; ++i)
+    {
+        shuffled.x[i] = points.x[order[i]];
+        shuffled.y[i] = points.y[order[i]];
+        shuffled.z[i] = points.z[order[i]];
+    }
+
+    double const square_threshold = MATH_POW2(this->opts.threshold);
+    int const block_size = std::max(1, this->opts.preemptive_block_size);
+    std::size_t num_active = hypotheses.size();
+    int num_scored = 0;
+    for (; num_scored < num_corresp && num_active > 1;
+        num_scored += block_size)
+    {
+        int const block_end = std::min(num_corresp, num_scored + block_size);
+        int const block_length = block_end - num_scored;
+#pragma omp parallel
+        {
+            std::vector<double> u(block_length), v(block_length);
+#pragma omp for schedule(static)
+            for (std::int64_t i = 0; i < static_cast<std::int64_t>(
+                num_active); ++i)
+            {
+                PreemptiveHypothesis& hypothesis = hypotheses[i];
+                project_points(hypothesis.projection,
+                    &shuffled.x[num_scored], &shuffled.y[num_scored],
+                    &shuffled.z[num_scored], block_length, &u[0], &v[0]);
+                for (int j = 0; j < block_length; ++j)
+                {
+                    double const* p2d = corresp[order[num_scored + j]].p2d;
+                    double const square_error = MATH_POW2(u[j] - p2d[0])
+                        + MATH_POW2(v[j] - p2d[1]);
+                    if (square_error < square_threshold)
+                        hypothesis.score += 1;
+                }
+            }
+        }
+
+        /* Keep the better half of the hypotheses. */
+        std::size_t const num_kept = std::max<std::size_t>(1, num_active / 2);
+        std::partial_sort(hypotheses.begin(), hypotheses.begin() + num_kept,
+            hypotheses.begin() + num_active, compare_hypotheses);
+        num_active = num_kept;
+    }
+
+    /* With all correspondences scored, the best hypothesis is first. */
+    std::partial_sort(hypotheses.begin(), hypotheses.begin() + 1,
+        hypotheses.begin() + num_active, compare_hypotheses);
+    result->pose = poses[hypotheses.front().pose_id];
+    std::vector<double> buffer;
+    this->find_inliers(corresp, points, k_matrix * result->pose, &buffer,
+        &result->inliers);
+    stats.scoring_time = get_ransac_timestamp() - score_time;
+    stats.improvements.push_back(RansacStatistics::Improvement
+        {hypotheses.front().pose_id / 4, static_cast<double>(
+        result->inliers.size()) / num_corresp});
+
+    if (this->opts.verbose_output)
+    {
+        std::cout << "RANSAC-3: Preemptive scoring of " << hypotheses.size()
+            << " hypotheses on " << std::min(num_scored, num_corresp)
+            << " correspondences, inliers " << result->inliers.size() << " ("
+            << (100.0 * result->inliers.size() / corresp.size())
+            << "%)" << std::endl;
+    }
+}
+
+int
 RansacPoseP3P::compute_p3p (Correspondences2D3D const& corresp,
+    std::vector<int> const& sample,
     math::Matrix<double, 3, 3> const& inv_k_matrix,
-    PutativePoses* poses) const
+    Pose* poses) const
 {
-    if (corresp.size() < 3)
-        throw std::invalid_argument("At least 3 correspondences required");
-
-    /* Draw 3 unique random numbers. */
-    std::set<int> result;
-    while (result.size() < 3)
-        result.insert(util::system::rand_int() % corresp.size());
+    if (sample.size() != 3)
+        throw std::invalid_argument("Sample of 3 correspondences required");
 
-    std::set<int>::const_iterator iter = result.begin();
-    Correspondence2D3D const& c1(corresp[*iter++]);
-    Correspondence2D3D const& c2(corresp[*iter++]);
-    Correspondence2D3D const& c3(corresp[*iter]);
-    pose_p3p_kneip(
+    Correspondence2D3D const& c1(corresp[sample[0]]);
+    Correspondence2D3D const& c2(corresp[sample[1]]);
+    Correspondence2D3D const& c3(corresp[sample[2]]);
+    return pose_p3p_kneip(
         math::Vec3d(c1.p3d), math::Vec3d(c2.p3d), math::Vec3d(c3.p3d),
         inv_k_matrix.mult(math::Vec3d(c1.p2d[0], c1.p2d[1], 1.0)),
         inv_k_matrix.mult(math::Vec3d(c2.p2d[0], c2.p2d[1], 1.0)),
@@ -104,18 +339,23 @@ RansacPoseP3P::compute_p3p (Correspondences2D3D const& corresp,
 
 void
 RansacPoseP3P::find_inliers (Correspondences2D3D const& corresp,
-    math::Matrix<double, 3, 3> const& k_matrix,
-    Pose const& pose, std::vector<int>* inliers) const
+    PointArrays const& points, math::Matrix<double, 3, 4> const& p_matrix,
+    std::vector<double>* buffer, std::vector<int>* inliers) const
 {
+    std::size_t const num_points = corresp.size();
+    buffer->resize(2 * num_points);
+    double* u = &buffer->at(0);
+    double* v = u + num_points;
+    project_points(p_matrix, &points.x[0], &points.y[0], &points.z[0],
+        num_points, u, v);
+
     inliers->resize(0);
     double const square_threshold = MATH_POW2(this->opts.threshold);
-    for (std::size_t i = 0; i < corresp.size(); ++i)
+    for (std::size_t i = 0; i < num_points; ++i)
     {
         Correspondence2D3D const& c = corresp[i];
-        math::Vec4d p3d(c.p3d[0], c.p3d[1], c.p3d[2], 1.0);
-        math::Vec3d p2d = k_matrix * (pose * p3d);
-        double square_error = MATH_POW2(p2d[0] / p2d[2] - c.p2d[0])
-            + MATH_POW2(p2d[1] / p2d[2] - c.p2d[1]);
+        double square_error = MATH_POW2(u[i] - c.p2d[0])
+            + MATH_POW2(v[i] - c.p2d[1]);
         if (square_error < square_threshold)
             inliers->push_back(i);
     }
@@ -16,6 +16,7 @@
 #include "math/vector.h"
 #include "sfm/correspondence.h"
 #include "sfm/defines.h"
+#include "sfm/ransac.h"
 
 SFM_NAMESPACE_BEGIN
 
@@ -54,6 +55,51 @@ public:
          */
         double threshold;
 
+        /**
+         * Seed of the random samples. Every iteration draws its sample from
+         * a generator seeded by this value and the iteration, which makes
+         * the samples deterministic for a fixed seed. Defaults to 0.
+         */
+        unsigned int seed;
+
+        /**
+         * Stops early once the number of iterations required for the
+         * success probability is reached. The required number is computed
+         * with compute_ransac_iterations() from the inlier ratio of the best
+         * model and updated whenever a better model is found. Defaults to
+         * false, which always runs max_iterations.
+         */
+        bool adaptive_termination;
+
+        /** Success probability for adaptive termination. Defaults to 0.99. */
+        double success_probability;
+
+        /**
+         * Draws samples with PROSAC, which samples from the best matches
+         * first and progressively includes worse matches until samples are
+         * drawn from all matches after max_iterations. This requires that
+         * the matches are sorted by decreasing quality, e.g. by increasing
+         * Lowe ratio. Defaults to false.
+         */
+        bool prosac_sampling;
+
+        /**
+         * Enables preemptive RANSAC. All hypotheses of max_iterations samples
+         * are generated first and scored on consecutive blocks of randomly
+         * ordered correspondences. After every block, only the better half
+         * of the hypotheses is kept until a single hypothesis remains. This
+         * scores a small fraction of the correspondences of regular RANSAC,
+         * which pays off for thousands of correspondences. Adaptive
+         * termination does not apply. Defaults to false.
+         */
+        bool preemptive_scoring;
+
+        /**
+         * Number of correspondences per block of preemptive scoring.
+         * Defaults to 100.
+         */
+        int preemptive_block_size;
+
         /**
          * Produce status messages on the console.
          */
@@ -67,6 +113,9 @@ public:
 
         /** The correspondence indices which led to the result. */
         std::vector<int> inliers;
+
+        /** Statistics of the estimation. */
+        RansacStatistics statistics;
     };
 
 public:
@@ -78,16 +127,31 @@ public:
 
 private:
     typedef math::Matrix<double, 3, 4> Pose;
-    typedef std::vector<Pose> PutativePoses;
+
+    /* The 3D points of the correspondences for batched projection. */
+    struct PointArrays
+    {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+    };
 
 private:
-    void compute_p3p (Correspondences2D3D const& corresp,
+    void estimate_preemptive (Correspondences2D3D const& corresp,
+        math::Matrix<double, 3, 3> const& k_matrix,
+        PointArrays const& points, std::vector<int> const& subset_sizes,
+        Result* result) const;
+
+    /** Computes up to four poses and returns the number of poses. */
+    int compute_p3p (Correspondences2D3D const& corresp,
+        std::vector<int> const& sample,
         math::Matrix<double, 3, 3> const& inv_k_matrix,
-        PutativePoses* poses) const;
+        Pose* poses) const;
 
+    /** Counts inliers, buffer holds the projections of all points. */
     void find_inliers (Correspondences2D3D const& corresp,
-        math::Matrix<double, 3, 3> const& k_matrix,
-        Pose const& pose, std::vector<int>* inliers) const;
+        PointArrays const& points, math::Matrix<double, 3, 4> const& p_matrix,
+        std::vector<double>* buffer, std::vector<int>* inliers) const;
 
 private:
     Options opts;
@@ -99,6 +163,12 @@ inline
 RansacPoseP3P::Options::Options (void)
     : max_iterations(1000)
     , threshold(0.005)
+    , seed(0)
+    , adaptive_termination(false)
+    , success_probability(0.99)
+    , prosac_sampling(false)
+    , preemptive_scoring(false)
+    , preemptive_block_size(100)
     , verbose_output(false)
 {
 }
@@ -7,6 +7,7 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <cstdint>
 #include <stdexcept>
 
 #include "math/matrix_svd.h"
@@ -72,6 +73,38 @@ triangulate_track (std::vector<math::Vec2f> const& pos,
     return math::Vector<double, 3>(x[0] / x[3], x[1] / x[3], x[2] / x[3]);
 }
 
+template <int N>
+math::Vector<double, 3>
+triangulate_track (math::Vec2f const* pos, CameraPose const* const* poses)
+{
+    math::Matrix<double, 2 * N, 4> A;
+    for (int i = 0; i < N; ++i)
+    {
+        math::Vec2d p = pos[i];
+        math::Matrix<double, 3, 4> p_mat;
+        poses[i]->fill_p_matrix(&p_mat);
+
+        for (int j = 0; j < 4; ++j)
+        {
+            A(2 * i + 0, j) = p[0] * p_mat(2, j) - p_mat(0, j);
+            A(2 * i + 1, j) = p[1] * p_mat(2, j) - p_mat(1, j);
+        }
+    }
+
+    /* Consider the last column of V and extract 3D point. */
+    math::Matrix<double, 4, 4> mat_v;
+    math::matrix_svd_jacobi(A, &mat_v);
+    math::Vector<double, 4> x = mat_v.col(3);
+    return math::Vector<double, 3>(x[0] / x[3], x[1] / x[3], x[2] / x[3]);
+}
+
+template math::Vector<double, 3>
+triangulate_track<2> (math::Vec2f const* pos, CameraPose const* const* poses);
+template math::Vector<double, 3>
+triangulate_track<3> (math::Vec2f const* pos, CameraPose const* const* poses);
+template math::Vector<double, 3>
+triangulate_track<4> (math::Vec2f const* pos, CameraPose const* const* poses);
+
 bool
 is_consistent_pose (Correspondence2D2D const& match,
     CameraPose const& pose1, CameraPose const& pose2)
@@ -95,20 +128,87 @@ Triangulate::triangulate (std::vector<CameraPose const*> const& poses,
     if (poses.size() != positions.size())
         throw std::invalid_argument("Poses and positions size mismatch");
 
-    /* Check all possible pose pairs for successful triangulation */
-    std::vector<std::size_t> best_outliers(positions.size());
+    return this->triangulate(poses.data(), positions.data(), poses.size(),
+        track_pos, stats, outliers);
+}
+
+void
+Triangulate::triangulate_tracks (std::vector<CameraPose> const& poses,
+    std::vector<TrackObservations> const& tracks,
+    std::vector<TrackResult>* results, Statistics* stats) const
+{
+    /* Check the input first, no exception may leave the parallel loop. */
+    for (std::size_t i = 0; i < tracks.size(); ++i)
+    {
+        TrackObservations const& track = tracks[i];
+        if (track.pose_ids.size() < 2)
+            throw std::invalid_argument("At least two poses required");
+        if (track.pose_ids.size() != track.positions.size())
+            throw std::invalid_argument("Poses and positions size mismatch");
+        for (std::size_t j = 0; j < track.pose_ids.size(); ++j)
+            if (track.pose_ids[j] < 0
+                || track.pose_ids[j] >= static_cast<int>(poses.size()))
+                throw std::invalid_argument("Invalid pose ID");
+    }
+
+    results->clear();
+    results->resize(tracks.size());
+#pragma omp parallel
+    {
+        Statistics thread_stats;
+        std::vector<CameraPose const*> track_poses;
+#pragma omp for schedule(dynamic, 64)
+        for (std::int64_t i = 0; i < static_cast<std::int64_t>(tracks.size());
+            ++i)
+        {
+            TrackObservations const& track = tracks[i];
+            track_poses.resize(track.pose_ids.size());
+            for (std::size_t j = 0; j < track.pose_ids.size(); ++j)
+                track_poses[j] = &poses[track.pose_ids[j]];
+
+            TrackResult& result = results->at(i);
+            result.success = this->triangulate(track_poses.data(),
+                track.positions.data(), track_poses.size(), &result.pos,
+                &thread_stats, &result.outliers);
+        }
+
+        if (stats != nullptr)
+        {
+#pragma omp critical
+            {
+                stats->num_new_tracks += thread_stats.num_new_tracks;
+                stats->num_large_error += thread_stats.num_large_error;
+                stats->num_behind_camera += thread_stats.num_behind_camera;
+                stats->num_too_small_angle
+                    += thread_stats.num_too_small_angle;
+            }
+        }
+    }
+}
+
+bool
+Triangulate::triangulate (CameraPose const* const* poses,
+    math::Vec2f const* positions, std::size_t num_views,
+    math::Vec3d* track_pos, Statistics* stats,
+    std::vector<std::size_t>* outliers) const
+{
+    /*
+     * Check all possible pose pairs for successful triangulation. Only the
+     * outliers of every pair are counted, they are collected for the best
+     * pair at the end, which avoids allocations per pair.
+     */
+    std::size_t best_num_outliers = num_views;
+    math::Vec3d best_tmp_pos(0.0);
     math::Vec3f best_pos(0.0f);
-    for (std::size_t p1 = 0; p1 < poses.size(); ++p1)
-        for (std::size_t p2 = p1 + 1; p2 < poses.size(); ++p2)
+    for (std::size_t p1 = 0; p1 < num_views; ++p1)
+        for (std::size_t p2 = p1 + 1; p2 < num_views; ++p2)
         {
             /* Triangulate position from current pair */
-            std::vector<CameraPose const*> pose_pair;
-            std::vector<math::Vec2f> position_pair;
-            pose_pair.push_back(poses[p1]);
-            pose_pair.push_back(poses[p2]);
-            position_pair.push_back(positions[p1]);
-            position_pair.push_back(positions[p2]);
-            math::Vec3d tmp_pos = triangulate_track(position_pair, pose_pair);
+            CameraPose const* pose_pair[2] = { poses[p1], poses[p2] };
+            math::Vec2f const position_pair[2]
+                = { positions[p1], positions[p2] };
+            math::Vec3d tmp_pos = triangulate_track<2>(position_pair,
+                pose_pair);
             if (MATH_ISNAN(tmp_pos[0]) || MATH_ISINF(tmp_pos[0]) ||
                 MATH_ISNAN(tmp_pos[1]) || MATH_ISINF(tmp_pos[1]) ||
                 MATH_ISNAN(tmp_pos[2]) || MATH_ISINF(tmp_pos[2]))
@@ -127,33 +227,15 @@ Triangulate::triangulate (std::vector<CameraPose const*> const& poses,
                     continue;
             }
 
-            /* Chek error in all input poses and find outliers. */
-            std::vector<std::size_t> tmp_outliers;
-            for (std::size_t i = 0; i < poses.size(); ++i)
-            {
-                math::Vec3d x = poses[i]->R * tmp_pos + poses[i]->t;
-
-                /* Reject track if it appears behind the camera. */
-                if (x[2] <= 0.0)
-                {
-                    tmp_outliers.push_back(i);
-                    continue;
-                }
-
-                x = poses[i]->K * x;
-                math::Vec2d x2d(x[0] / x[2], x[1] / x[2]);
-                double error = (positions[i] - x2d).norm();
-                if (error > this->opts.error_threshold)
-                    tmp_outliers.push_back(i);
-            }
-
             /* Select triangulation with lowest amount of outliers. */
-            if (tmp_outliers.size() < best_outliers.size())
+            std::size_t const num_outliers = this->count_outliers(poses,
+                positions, num_views, tmp_pos, nullptr);
+            if (num_outliers < best_num_outliers)
             {
+                best_tmp_pos = tmp_pos;
                 best_pos = tmp_pos;
-                std::swap(best_outliers, tmp_outliers);
+                best_num_outliers = num_outliers;
             }
-
         }
 
     /* If all pairs have small angles pos will be 0 here. */
@@ -165,7 +247,7 @@ Triangulate::triangulate (std::vector<CameraPose const*> const& poses,
     }
 
     /* Check if required number of inliers is found. */
-    if (poses.size() < best_outliers.size() + this->opts.min_num_views)
+    if (num_views < best_num_outliers + this->opts.min_num_views)
     {
         if (stats != nullptr)
             stats->num_large_error += 1;
@@ -177,11 +259,51 @@ Triangulate::triangulate (std::vector<CameraPose const*> const& poses,
     if (stats != nullptr)
         stats->num_new_tracks += 1;
     if (outliers != nullptr)
-        std::swap(*outliers, best_outliers);
+    {
+        outliers->clear();
+        this->count_outliers(poses, positions, num_views, best_tmp_pos,
+            outliers);
+    }
 
     return true;
 }
 
+/*
+ * Counts the views in which the position appears behind the camera or has
+ * a large reprojection error, and appends them to the outliers if given.
+ */
+std::size_t
+Triangulate::count_outliers (CameraPose const* const* poses,
+    math::Vec2f const* positions, std::size_t num_views,
+    math::Vec3d const& pos, std::vector<std::size_t>* outliers) const
+{
+    std::size_t num_outliers = 0;
+    for (std::size_t i = 0; i < num_views; ++i)
+    {
+        math::Vec3d x = poses[i]->R * pos + poses[i]->t;
+
+        /* Reject track if it appears behind the camera. */
+        if (x[2] <= 0.0)
+        {
+            num_outliers += 1;
+            if (outliers != nullptr)
+                outliers->push_back(i);
+            continue;
+        }
+
+        x = poses[i]->K * x;
+        math::Vec2d x2d(x[0] / x[2], x[1] / x[2]);
+        double error = (positions[i] - x2d).norm();
+        if (error > this->opts.error_threshold)
+        {
+            num_outliers += 1;
+            if (outliers != nullptr)
+                outliers->push_back(i);
+        }
+    }
+    return num_outliers;
+}
+
 void
 Triangulate::print_statistics (Statistics const& stats, std::ostream& out) const
 {
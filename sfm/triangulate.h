@@ -38,6 +38,16 @@ math::Vector<double, 3>
 triangulate_track (std::vector<math::Vec2f> const& pos,
     std::vector<CameraPose const*> const& poses);
 
+/**
+ * Triangulates the 3D point coordinate from N views like the function above,
+ * but with fixed-size matrices on the stack and without heap allocations.
+ * The null space of the DLT system is computed with the Jacobi SVD. This
+ * is instantiated for N = 2, 3 and 4.
+ */
+template <int N>
+math::Vector<double, 3>
+triangulate_track (math::Vec2f const* pos, CameraPose const* const* poses);
+
 /**
  * Given a two-view pose configuration and a correspondence, this function
  * returns true if the triangulated point is in front of both cameras.
@@ -84,14 +94,53 @@ public:
         int num_too_small_angle;
     };
 
+    /** Observations of a track as indices into a pose table. */
+    struct TrackObservations
+    {
+        std::vector<int> pose_ids;
+        std::vector<math::Vec2f> positions;
+    };
+
+    /** Result of a track of the batch triangulation. */
+    struct TrackResult
+    {
+        TrackResult (void);
+
+        math::Vec3d pos;
+        bool success;
+        /** Indices of the outlier observations of the track. */
+        std::vector<std::size_t> outliers;
+    };
+
 public:
     explicit Triangulate (Options const& options);
     bool triangulate (std::vector<CameraPose const*> const& poses,
         std::vector<math::Vec2f> const& positions,
         math::Vec3d* track_pos, Statistics* stats = nullptr,
         std::vector<std::size_t>* outliers = nullptr) const;
+
+    /**
+     * Triangulates all tracks like triangulate() in parallel. The pose IDs
+     * of the tracks index the pose table, and the results are in the order
+     * of the tracks. The statistics are collected per thread and added to
+     * the given statistics at the end.
+     */
+    void triangulate_tracks (std::vector<CameraPose> const& poses,
+        std::vector<TrackObservations> const& tracks,
+        std::vector<TrackResult>* results,
+        Statistics* stats = nullptr) const;
+
     void print_statistics (Statistics const& stats, std::ostream& out) const;
 
+private:
+    bool triangulate (CameraPose const* const* poses,
+        math::Vec2f const* positions, std::size_t num_views,
+        math::Vec3d* track_pos, Statistics* stats,
+        std::vector<std::size_t>* outliers) const;
+    std::size_t count_outliers (CameraPose const* const* poses,
+        math::Vec2f const* positions, std::size_t num_views,
+        math::Vec3d const& pos, std::vector<std::size_t>* outliers) const;
+
 private:
     Options const opts;
     double const cos_angle_thres;
@@ -116,6 +165,13 @@ Triangulate::Statistics::Statistics (void)
 {
 }
 
+inline
+Triangulate::TrackResult::TrackResult (void)
+    : pos(0.0)
+    , success(false)
+{
+}
+
 inline
 Triangulate::Triangulate (Options const& options)
     : opts(options)
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "util/binary_io.h"
+#include "util/exception.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    char const* const FILENAME = "test_binary_io.bin";
+
+    /* Larger than the buffers, so that direct reads and writes are used. */
+    std::size_t const BLOCK_SIZE = 3 * 1024 * 1024 + 17;
+
+    std::vector<char>
+    create_block (void)
+    {
+        std::vector<char> block(BLOCK_SIZE);
+        for (std::size_t i = 0; i < block.size(); ++i)
+            block[i] = static_cast<char>(i * 7 + i / 251);
+        return block;
+    }
+
+    std::vector<float>
+    create_floats (void)
+    {
+        std::vector<float> values;
+        for (int i = 0; i < 1000; ++i)
+            values.push_back(i * 0.25f - 100.0f);
+        return values;
+    }
+
+    /* The layout of the test file, with its size. */
+    std::size_t
+    write_file (void)
+    {
+        std::vector<char> const block = create_block();
+        std::vector<float> const floats = create_floats();
+
+        util::BinaryWriter writer(FILENAME);
+        writer.write("header\r\nline 2\n");
+        writer.write_value<uint32_t>(0x01020304u, util::BYTE_ORDER_BIG_ENDIAN);
+        writer.write_value<uint32_t>(0x01020304u,
+            util::BYTE_ORDER_LITTLE_ENDIAN);
+        writer.write_value<double>(-2.5);
+        writer.write_array(floats.data(), floats.size(),
+            util::BYTE_ORDER_BIG_ENDIAN);
+        writer.write(block.data(), block.size());
+        for (int i = 0; i < 100000; ++i)
+            writer.write_value<int16_t>(static_cast<int16_t>(i),
+                util::BYTE_ORDER_LITTLE_ENDIAN);
+        writer.write("last line");
+        std::size_t const size = writer.tell();
+        writer.close();
+        return size;
+    }
+
+    std::vector<char>
+    read_raw (void)
+    {
+        std::ifstream in(FILENAME, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>());
+    }
+
+    void
+    test_writer (std::size_t size)
+    {
+        std::vector<char> const raw = read_raw();
+        TEST_CHECK(raw.size() == size);
+        if (raw.size() != size)
+            return;
+
+        /* Both byte orders are written explicitly. */
+        char const expected[8] = { 1, 2, 3, 4, 4, 3, 2, 1 };
+        TEST_CHECK(std::equal(expected, expected + 8, raw.begin() + 15));
+
+        std::vector<char> const block = create_block();
+        std::size_t const block_start = 15 + 8 + 8 + 4000;
+        TEST_CHECK(std::equal(block.begin(), block.end(),
+            raw.begin() + block_start));
+    }
+
+    void
+    test_reader (util::BinaryReader::Backend backend, std::size_t size)
+    {
+        std::vector<char> const block = create_block();
+        std::vector<float> const floats = create_floats();
+
+        util::BinaryReader reader(FILENAME, backend);
+        TEST_CHECK(reader.size() == size);
+
+        /* Lines keep a CR before the line break. */
+        std::string line;
+        TEST_CHECK(reader.read_line(&line) && line == "header\r");
+        TEST_CHECK(reader.read_line(&line) && line == "line 2");
+        TEST_CHECK(reader.peek() == 1);
+        TEST_CHECK(reader.tell() == 15);
+
+        TEST_CHECK(reader.read_value<uint32_t>(util::BYTE_ORDER_BIG_ENDIAN)
+            == 0x01020304u);
+        TEST_CHECK(reader.read_value<uint32_t>(
+            util::BYTE_ORDER_LITTLE_ENDIAN) == 0x01020304u);
+        TEST_CHECK(reader.read_value<double>() == -2.5);
+        std::vector<float> read_floats(floats.size());
+        TEST_CHECK(reader.read_array(read_floats.data(), read_floats.size(),
+            util::BYTE_ORDER_BIG_ENDIAN) == floats.size());
+        TEST_CHECK(read_floats == floats);
+
+        std::vector<char> read_block(block.size());
+        TEST_CHECK(reader.read(read_block.data(), read_block.size())
+            == block.size());
+        TEST_CHECK(read_block == block);
+
+        bool values_match = true;
+        for (int i = 0; i < 100000; ++i)
+            values_match = values_match && reader.read_value<int16_t>(
+                util::BYTE_ORDER_LITTLE_ENDIAN) == static_cast<int16_t>(i);
+        TEST_CHECK(values_match);
+        TEST_CHECK(!reader.eof());
+
+        /* The last line has no line break, then the file ends. */
+        TEST_CHECK(reader.read_line(&line) && line == "last line");
+        TEST_CHECK(reader.tell() == size);
+        TEST_CHECK(!reader.read_line(&line));
+        TEST_CHECK(reader.eof());
+
+        /* Seeking back clears the end of file state. */
+        std::size_t const block_start = 15 + 8 + 8 + 4000;
+        reader.seek(block_start + 1000);
+        TEST_CHECK(!reader.eof());
+        TEST_CHECK(reader.get() == static_cast<unsigned char>(block[1000]));
+        TEST_CHECK(reader.skip(block.size() - 1001) == block.size() - 1001);
+        TEST_CHECK(reader.read_value<int16_t>(util::BYTE_ORDER_LITTLE_ENDIAN)
+            == 0);
+        reader.seek(15);
+        TEST_CHECK(reader.read_value<uint32_t>(util::BYTE_ORDER_BIG_ENDIAN)
+            == 0x01020304u);
+
+        /* Reads beyond the end are partial, later values are zero. */
+        reader.seek(size - 4);
+        char tail[16];
+        TEST_CHECK(reader.read(tail, sizeof(tail)) == 4);
+        TEST_CHECK(std::string(tail, 4) == "line");
+        TEST_CHECK(reader.eof());
+        TEST_CHECK(reader.read_value<uint32_t>() == 0);
+        TEST_CHECK(reader.get() == EOF);
+        reader.seek(size - 2);
+        TEST_CHECK(reader.skip(10) == 2);
+        TEST_CHECK(reader.eof());
+    }
+
+    void
+    test_mapped_file (std::size_t size)
+    {
+        std::vector<char> const raw = read_raw();
+        util::MappedFile mapping(FILENAME);
+        TEST_CHECK(mapping.is_open());
+        TEST_CHECK(mapping.size() == size);
+        TEST_CHECK(mapping.data() != nullptr
+            && std::equal(raw.begin(), raw.end(), mapping.data()));
+        mapping.close();
+        TEST_CHECK(!mapping.is_open());
+
+        /* Empty files have no data. */
+        util::BinaryWriter(FILENAME).close();
+        mapping.open(FILENAME);
+        TEST_CHECK(mapping.size() == 0);
+        TEST_CHECK(mapping.data() == nullptr);
+        util::BinaryReader reader(FILENAME, util::BinaryReader::BACKEND_MAPPED);
+        TEST_CHECK(reader.get() == EOF);
+        TEST_CHECK(reader.eof());
+    }
+
+    void
+    test_missing_file (void)
+    {
+        bool buffered_throws = false;
+        bool mapped_throws = false;
+        try
+        {
+            util::BinaryReader reader("test_binary_io_missing.bin");
+        }
+        catch (util::FileException const&)
+        {
+            buffered_throws = true;
+        }
+        try
+        {
+            util::BinaryReader reader("test_binary_io_missing.bin",
+                util::BinaryReader::BACKEND_MAPPED);
+        }
+        catch (util::FileException const&)
+        {
+            mapped_throws = true;
+        }
+        TEST_CHECK(buffered_throws);
+        TEST_CHECK(mapped_throws);
+    }
+}  // namespace
+
+int
+main (void)
+{
+    std::size_t const size = write_file();
+    test_writer(size);
+    test_reader(util::BinaryReader::BACKEND_BUFFERED, size);
+    test_reader(util::BinaryReader::BACKEND_MAPPED, size);
+    test_mapped_file(size);
+    test_missing_file();
+    std::remove(FILENAME);
+    return TEST_RESULT;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef TESTS_TEST_CHECK_HEADER
+#define TESTS_TEST_CHECK_HEADER
+
+#include <iostream>
+
+/*
+ * Minimal checks for the test executables. A failed check prints the
+ * location and the condition and counts the failure, main() returns the
+ * number of failures through TEST_RESULT.
+ */
+namespace test
+{
+    inline int&
+    num_failures (void)
+    {
+        static int failures = 0;
+        return failures;
+    }
+}  // namespace test
+
+#define TEST_CHECK(cond) \
+    do { if (!(cond)) { test::num_failures() += 1; \
+        std::cerr << __FILE__ << ":" << __LINE__ << ": Check failed: " \
+        << #cond << std::endl; } } while (false)
+
+#define TEST_RESULT (test::num_failures() > 0 ? 1 : 0)
+
+#endif /* TESTS_TEST_CHECK_HEADER */
@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "math/defines.h"
+#include "math/matrix.h"
+#include "core/depthmap.h"
+#include "core/image.h"
+#include "core/mesh.h"
+#include "core/mesh_info.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    void
+    set_num_threads (int num_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(num_threads);
+#else
+        (void)num_threads;
+#endif
+    }
+
+    /* Inverse calibration with focal length 'flen' in pixels. */
+    math::Matrix3f
+    create_invproj (int width, int height, float flen)
+    {
+        math::Matrix3f invproj(0.0f);
+        invproj[0] = 1.0f / flen;
+        invproj[2] = -0.5f * width / flen;
+        invproj[4] = 1.0f / flen;
+        invproj[5] = -0.5f * height / flen;
+        invproj[8] = 1.0f;
+        return invproj;
+    }
+
+    /*
+     * Creates a slanted depth map with a depth step in the right half and
+     * random holes with the given probability.
+     */
+    core::FloatImage::Ptr
+    create_depthmap (int width, int height, float holes, unsigned int seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        core::FloatImage::Ptr dm = core::FloatImage::create(width, height, 1);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+            {
+                float depth = 5.0f + 0.01f * x + 0.02f * y;
+                if (x > width / 2 && y > height / 3)
+                    depth += 3.0f;
+                dm->at(x, y, 0) = uniform(rng) < holes ? 0.0f : depth;
+            }
+        return dm;
+    }
+
+    void
+    test_triangulate_full (void)
+    {
+        int const width = 9;
+        int const height = 6;
+        core::FloatImage::Ptr dm = create_depthmap(width, height, 0.0f, 1);
+        math::Matrix3f const invproj = create_invproj(width, height, 10.0f);
+
+        /* Without discontinuity detection all blocks are triangulated. */
+        core::Image<unsigned int> vids;
+        core::TriangleMesh::Ptr mesh
+            = core::geom::depthmap_triangulate(dm, invproj, 0.0f, &vids);
+        TEST_CHECK(mesh->get_vertices().size() == width * height);
+        TEST_CHECK(mesh->get_faces().size() == 6 * (width - 1) * (height - 1));
+
+        /* Vertices are in row-major pixel order. */
+        bool vertices_match = vids.width() == width && vids.height() == height;
+        for (int i = 0; vertices_match && i < width * height; ++i)
+            vertices_match = vids.at(i) == static_cast<unsigned int>(i)
+                && mesh->get_vertices()[i] == core::geom::pixel_3dpos(
+                i % width, i / width, dm->at(i), invproj);
+        TEST_CHECK(vertices_match);
+
+        /* The depth step is not triangulated with discontinuity detection. */
+        mesh = core::geom::depthmap_triangulate(dm, invproj, 5.0f, &vids);
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        TEST_CHECK(!faces.empty());
+        TEST_CHECK(faces.size() < 6 * (width - 1) * (height - 1));
+        bool crosses_step = false;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            bool near = false;
+            bool far = false;
+            for (int j = 0; j < 3; ++j)
+            {
+                float const depth = mesh->get_vertices()[faces[i + j]].norm();
+                (depth > 7.5f ? far : near) = true;
+            }
+            crosses_step = crosses_step || (near && far);
+        }
+        TEST_CHECK(!crosses_step);
+    }
+
+    /* Pixels used by no triangle do not create vertices. */
+    void
+    test_triangulate_holes (void)
+    {
+        core::FloatImage::Ptr dm = core::FloatImage::create(3, 3, 1);
+        dm->fill(1.0f);
+        dm->at(1, 1, 0) = 0.0f;
+        dm->at(2, 1, 0) = 0.0f;
+        math::Matrix3f const invproj = create_invproj(3, 3, 10.0f);
+        core::Image<unsigned int> vids;
+        core::TriangleMesh::Ptr mesh
+            = core::geom::depthmap_triangulate(dm, invproj, 0.0f, &vids);
+        TEST_CHECK(mesh->get_faces().size() == 6);
+        TEST_CHECK(mesh->get_vertices().size() == 5);
+        TEST_CHECK(vids.at(0, 0, 0) == 0);
+        TEST_CHECK(vids.at(1, 0, 0) == 1);
+        TEST_CHECK(vids.at(0, 1, 0) == 2);
+        TEST_CHECK(vids.at(1, 1, 0) == MATH_MAX_UINT);
+        TEST_CHECK(vids.at(1, 2, 0) == 4);
+        TEST_CHECK(vids.at(2, 2, 0) == MATH_MAX_UINT);
+    }
+
+    /* The result must not depend on the amount of threads. */
+    void
+    test_triangulate_threads (void)
+    {
+        core::FloatImage::Ptr dm = create_depthmap(173, 131, 0.1f, 2);
+        math::Matrix3f const invproj = create_invproj(173, 131, 150.0f);
+        core::Image<unsigned int> vids_serial, vids_parallel;
+
+        set_num_threads(1);
+        core::TriangleMesh::Ptr serial = core::geom::depthmap_triangulate(
+            dm, invproj, 5.0f, &vids_serial);
+        set_num_threads(7);
+        core::TriangleMesh::Ptr parallel = core::geom::depthmap_triangulate(
+            dm, invproj, 5.0f, &vids_parallel);
+
+        TEST_CHECK(!serial->get_faces().empty());
+        TEST_CHECK(serial->get_vertices() == parallel->get_vertices());
+        TEST_CHECK(serial->get_faces() == parallel->get_faces());
+        TEST_CHECK(std::equal(vids_serial.begin(), vids_serial.end(),
+            vids_parallel.begin()));
+    }
+    /* Bilateral filter with std::exp in double precision. */
+    core::FloatImage::Ptr
+    reference_bilateral_filter (core::FloatImage::ConstPtr dm,
+        math::Matrix3f const& invproj, float gc_sigma, float pc_factor)
+    {
+        int const width = dm->width();
+        int const height = dm->height();
+        int const ks = std::ceil(gc_sigma * 2.884f);
+        core::FloatImage::Ptr ret = core::FloatImage::create(width, height, 1);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+            {
+                double const depth = dm->at(x, y, 0);
+                if (depth == 0.0)
+                    continue;
+                double const pc_sigma = pc_factor
+                    * core::geom::pixel_footprint(x, y, depth, invproj);
+                double weight = 0.0;
+                double depth_sum = 0.0;
+                for (int ky = std::max(0, y - ks);
+                    ky <= std::min(height - 1, y + ks); ++ky)
+                    for (int kx = std::max(0, x - ks);
+                        kx <= std::min(width - 1, x + ks); ++kx)
+                    {
+                        double const cd = dm->at(kx, ky, 0);
+                        if (cd == 0.0)
+                            continue;
+                        double const dist2 = (kx - x) * (kx - x)
+                            + (ky - y) * (ky - y);
+                        double const w = std::exp(-dist2
+                            / (2.0 * gc_sigma * gc_sigma))
+                            * std::exp(-(depth - cd) * (depth - cd)
+                            / (2.0 * pc_sigma * pc_sigma));
+                        weight += w;
+                        depth_sum += w * cd;
+                    }
+                ret->at(x, y, 0) = depth_sum / weight;
+            }
+        return ret;
+    }
+
+    void
+    test_bilateral_filter (void)
+    {
+        core::FloatImage::Ptr dm = create_depthmap(67, 45, 0.15f, 3);
+        std::mt19937 rng(4);
+        std::normal_distribution<float> noise(0.0f, 0.01f);
+        for (int i = 0; i < dm->get_pixel_amount(); ++i)
+            if (dm->at(i) != 0.0f)
+                dm->at(i) += noise(rng);
+        math::Matrix3f const invproj = create_invproj(67, 45, 60.0f);
+
+        float const sigmas[] = { 0.7f, 2.0f, 4.5f };
+        for (int i = 0; i < 3; ++i)
+        {
+            core::FloatImage::Ptr filtered = core::image::
+                depthmap_bilateral_filter(dm, invproj, sigmas[i], 5.0f);
+            core::FloatImage::Ptr expected = reference_bilateral_filter(
+                dm, invproj, sigmas[i], 5.0f);
+            float max_error = 0.0f;
+            for (int j = 0; j < dm->get_pixel_amount(); ++j)
+                max_error = std::max(max_error,
+                    std::abs(filtered->at(j) - expected->at(j)));
+            TEST_CHECK(max_error < 1e-4f);
+        }
+
+        /* Holes stay holes and the depth step is preserved. */
+        core::FloatImage::Ptr filtered = core::image::
+            depthmap_bilateral_filter(dm, invproj, 3.0f, 5.0f);
+        bool holes_kept = true;
+        bool step_kept = true;
+        for (int j = 0; j < dm->get_pixel_amount(); ++j)
+        {
+            holes_kept = holes_kept
+                && ((dm->at(j) == 0.0f) == (filtered->at(j) == 0.0f));
+            if (dm->at(j) != 0.0f)
+                step_kept = step_kept
+                    && std::abs(filtered->at(j) - dm->at(j)) < 0.5f;
+        }
+        TEST_CHECK(holes_kept);
+        TEST_CHECK(step_kept);
+    }
+    /* Removes 4-connected islands below the threshold by flood fill. */
+    core::FloatImage::Ptr
+    reference_cleanup (core::FloatImage::ConstPtr dm, std::size_t thres)
+    {
+        int const width = dm->width();
+        int const height = dm->height();
+        core::FloatImage::Ptr ret = core::FloatImage::create(*dm);
+        std::vector<bool> visited(dm->get_pixel_amount(), false);
+        for (int start = 0; start < dm->get_pixel_amount(); ++start)
+        {
+            if (visited[start] || dm->at(start) == 0.0f)
+                continue;
+            std::vector<int> island(1, start);
+            visited[start] = true;
+            for (std::size_t i = 0; i < island.size(); ++i)
+            {
+                int const x = island[i] % width;
+                int const y = island[i] / width;
+                int const neighbors[4][2] = { { x - 1, y }, { x + 1, y },
+                    { x, y - 1 }, { x, y + 1 } };
+                for (int j = 0; j < 4; ++j)
+                {
+                    int const nx = neighbors[j][0];
+                    int const ny = neighbors[j][1];
+                    if (nx < 0 || nx >= width || ny < 0 || ny >= height)
+                        continue;
+                    int const n = ny * width + nx;
+                    if (visited[n] || dm->at(n) == 0.0f)
+                        continue;
+                    visited[n] = true;
+                    island.push_back(n);
+                }
+            }
+            if (island.size() < thres)
+                for (std::size_t i = 0; i < island.size(); ++i)
+                    ret->at(island[i]) = 0.0f;
+        }
+        return ret;
+    }
+
+    /* Random masks over several row bands, with one and seven threads. */
+    void
+    test_cleanup (void)
+    {
+        float const holes[] = { 0.3f, 0.45f, 0.6f };
+        for (int i = 0; i < 3; ++i)
+        {
+            core::FloatImage::Ptr dm
+                = create_depthmap(97, 301, holes[i], 10 + i);
+            std::size_t const thresholds[] = { 0, 1, 2, 5, 20, 200 };
+            for (int j = 0; j < 6; ++j)
+            {
+                core::FloatImage::Ptr expected
+                    = reference_cleanup(dm, thresholds[j]);
+                set_num_threads(1);
+                core::FloatImage::Ptr serial
+                    = core::image::depthmap_cleanup(dm, thresholds[j]);
+                set_num_threads(7);
+                core::FloatImage::Ptr parallel
+                    = core::image::depthmap_cleanup(dm, thresholds[j]);
+                TEST_CHECK(std::equal(serial->begin(), serial->end(),
+                    expected->begin()));
+                TEST_CHECK(std::equal(parallel->begin(), parallel->end(),
+                    expected->begin()));
+            }
+        }
+    }
+
+    /* Confidences of the MeshInfo based implementation. */
+    core::TriangleMesh::ConfidenceList
+    reference_confidences (core::TriangleMesh::ConstPtr mesh, int iterations)
+    {
+        core::TriangleMesh::ConfidenceList confs(
+            mesh->get_vertices().size(), 1.0f);
+        core::MeshInfo mesh_info(mesh);
+        std::vector<std::size_t> vidx;
+        for (std::size_t i = 0; i < mesh_info.size(); ++i)
+            if (mesh_info[i].vclass == core::MeshInfo::VERTEX_CLASS_BORDER)
+                vidx.push_back(i);
+
+        for (int current = 0; current < iterations; ++current)
+        {
+            float const conf = (float)current / (float)iterations;
+            for (std::size_t i = 0; i < vidx.size(); ++i)
+                confs[vidx[i]] = conf;
+            std::vector<std::size_t> cvidx;
+            std::swap(vidx, cvidx);
+            for (std::size_t i = 0; i < cvidx.size(); ++i)
+            {
+                core::MeshInfo::VertexInfo const& info = mesh_info[cvidx[i]];
+                for (std::size_t j = 0; j < info.verts.size(); ++j)
+                    if (confs[info.verts[j]] == 1.0f)
+                        vidx.push_back(info.verts[j]);
+            }
+        }
+        return confs;
+    }
+
+    /*
+     * Peeling with a MeshInfo of the remaining faces in every iteration.
+     * Returns the remaining faces in their original order.
+     */
+    core::TriangleMesh::FaceList
+    reference_peeling (core::TriangleMesh::ConstPtr mesh, int iterations)
+    {
+        core::TriangleMesh::FaceList faces = mesh->get_faces();
+        for (int iter = 0; iter < iterations; ++iter)
+        {
+            core::TriangleMesh::Ptr current = core::TriangleMesh::create();
+            current->get_vertices() = mesh->get_vertices();
+            current->get_faces() = faces;
+            core::MeshInfo mesh_info(current);
+            std::vector<bool> removed(faces.size() / 3, false);
+            for (std::size_t i = 0; i < mesh_info.size(); ++i)
+                if (mesh_info[i].vclass == core::MeshInfo::VERTEX_CLASS_BORDER)
+                    for (std::size_t j = 0; j < mesh_info[i].faces.size(); ++j)
+                        removed[mesh_info[i].faces[j]] = true;
+            core::TriangleMesh::FaceList remaining;
+            for (std::size_t i = 0; i < removed.size(); ++i)
+                if (!removed[i])
+                    remaining.insert(remaining.end(), faces.begin() + i * 3,
+                        faces.begin() + i * 3 + 3);
+            faces.swap(remaining);
+        }
+        return faces;
+    }
+
+    core::TriangleMesh::Ptr
+    copy_mesh (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::TriangleMesh::Ptr copy = core::TriangleMesh::create();
+        copy->get_vertices() = mesh->get_vertices();
+        copy->get_faces() = mesh->get_faces();
+        return copy;
+    }
+
+    /* A triangulated depth map with holes and a depth step. */
+    void
+    test_confidences_and_peeling (void)
+    {
+        core::FloatImage::Ptr dm = create_depthmap(83, 61, 0.04f, 20);
+        math::Matrix3f const invproj = create_invproj(83, 61, 70.0f);
+        core::TriangleMesh::Ptr mesh
+            = core::geom::depthmap_triangulate(dm, invproj, 5.0f);
+        TEST_CHECK(!mesh->get_faces().empty());
+
+        int const num_threads[] = { 1, 7 };
+        for (int t = 0; t < 2; ++t)
+        {
+            set_num_threads(num_threads[t]);
+            for (int iterations = 1; iterations <= 4; ++iterations)
+            {
+                core::TriangleMesh::ConfidenceList const expected_confs
+                    = reference_confidences(mesh, iterations);
+                core::TriangleMesh::FaceList const expected_faces
+                    = reference_peeling(mesh, iterations);
+                TEST_CHECK(expected_faces.size() < mesh->get_faces().size());
+
+                core::TriangleMesh::Ptr result = copy_mesh(mesh);
+                core::geom::depthmap_mesh_confidences(result, iterations);
+                TEST_CHECK(result->get_vertex_confidences() == expected_confs);
+                TEST_CHECK(result->get_faces() == mesh->get_faces());
+
+                result = copy_mesh(mesh);
+                core::geom::depthmap_mesh_peeling(result, iterations);
+                TEST_CHECK(result->get_faces() == expected_faces);
+
+                result = copy_mesh(mesh);
+                core::geom::depthmap_mesh_confidences_and_peeling(result,
+                    iterations, iterations);
+                TEST_CHECK(result->get_vertex_confidences() == expected_confs);
+                TEST_CHECK(result->get_faces() == expected_faces);
+            }
+        }
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_triangulate_full();
+    test_triangulate_holes();
+    test_triangulate_threads();
+    test_bilateral_filter();
+    test_cleanup();
+    test_confidences_and_peeling();
+    return TEST_RESULT;
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "math/matrix.h"
+#include "math/vector.h"
+#include "core/depthmap.h"
+#include "core/depthmap_fusion.h"
+#include "core/mesh.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    float const RADIUS = 0.5f;
+
+    void
+    set_num_threads (int num_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(num_threads);
+#else
+        (void)num_threads;
+#endif
+    }
+
+    /* A camera at 'pos' looking at the origin. */
+    core::CameraInfo
+    create_camera (math::Vec3f const& pos)
+    {
+        math::Vec3f const zaxis = -pos.normalized();
+        math::Vec3f const up = std::abs(zaxis[1]) < 0.9f
+            ? math::Vec3f(0.0f, 1.0f, 0.0f) : math::Vec3f(1.0f, 0.0f, 0.0f);
+        math::Vec3f const xaxis = up.cross(zaxis).normalized();
+        math::Vec3f const yaxis = zaxis.cross(xaxis);
+
+        core::CameraInfo cam;
+        cam.flen = 1.5f;
+        for (int i = 0; i < 3; ++i)
+        {
+            cam.rot[0 + i] = xaxis[i];
+            cam.rot[3 + i] = yaxis[i];
+            cam.rot[6 + i] = zaxis[i];
+        }
+        for (int i = 0; i < 3; ++i)
+            cam.trans[i] = -math::Vec3f(cam.rot + i * 3).dot(pos);
+        return cam;
+    }
+
+    /* Ray traces the depth map of the sphere around the origin. */
+    core::FloatImage::Ptr
+    render_sphere (core::CameraInfo const& cam, int width, int height)
+    {
+        math::Matrix3f invproj;
+        cam.fill_inverse_calibration(invproj.begin(), width, height);
+        math::Matrix3f rot;
+        cam.fill_cam_to_world_rot(rot.begin());
+        math::Vec3f pos;
+        cam.fill_camera_pos(pos.begin());
+
+        core::FloatImage::Ptr dm = core::FloatImage::create(width, height, 1);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+            {
+                math::Vec3f const dir = rot
+                    * core::geom::pixel_3dpos(x, y, 1.0f, invproj);
+                float const b = pos.dot(dir);
+                float const c = pos.square_norm() - RADIUS * RADIUS;
+                float const disc = b * b - c;
+                dm->at(x, y, 0) = disc < 0.0f ? 0.0f : -b - std::sqrt(disc);
+            }
+        return dm;
+    }
+
+    std::vector<core::geom::FusionView>
+    create_views (void)
+    {
+        /* Views along the axes and the diagonals of the cube. */
+        std::vector<core::geom::FusionView> views;
+        for (int i = 0; i < 27; ++i)
+        {
+            math::Vec3f const dir(i % 3 - 1, i / 3 % 3 - 1, i / 9 - 1);
+            int const num_nonzero = (dir[0] != 0.0f) + (dir[1] != 0.0f)
+                + (dir[2] != 0.0f);
+            if (num_nonzero != 1 && num_nonzero != 3)
+                continue;
+            core::geom::FusionView view;
+            view.camera = create_camera(dir.normalized() * 2.5f);
+            view.depth_map = render_sphere(view.camera, 160, 120);
+            views.push_back(view);
+        }
+        return views;
+    }
+
+    double
+    mesh_area (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        double area = 0.0;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+            area += 0.5 * (verts[faces[i + 1]] - verts[faces[i]])
+                .cross(verts[faces[i + 2]] - verts[faces[i]]).norm();
+        return area;
+    }
+
+    /* The fused sphere must be closed and close to the true surface. */
+    void
+    test_sphere (void)
+    {
+        std::vector<core::geom::FusionView> const views = create_views();
+        core::geom::DepthMapFusion::Options options;
+        options.voxel_size = 0.025f;
+        core::geom::DepthMapFusion fusion(options);
+        set_num_threads(7);
+        fusion.integrate(views);
+        core::TriangleMesh::Ptr mesh = fusion.extract_mesh();
+
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        TEST_CHECK(!mesh->get_faces().empty());
+        float max_error = 0.0f;
+        for (std::size_t i = 0; i < verts.size(); ++i)
+            max_error = std::max(max_error,
+                std::abs(verts[i].norm() - RADIUS));
+        TEST_CHECK(max_error < 0.5f * options.voxel_size);
+        double const area = 4.0 * MATH_PI * RADIUS * RADIUS;
+        TEST_CHECK(std::abs(mesh_area(mesh) - area) < 0.03 * area);
+
+        /* Every edge of a closed mesh is used twice. */
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        std::vector<std::pair<unsigned int, unsigned int> > edges;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+            for (int j = 0; j < 3; ++j)
+                edges.push_back(std::make_pair(
+                    std::min(faces[i + j], faces[i + (j + 1) % 3]),
+                    std::max(faces[i + j], faces[i + (j + 1) % 3])));
+        std::sort(edges.begin(), edges.end());
+        bool closed = edges.size() % 2 == 0;
+        for (std::size_t i = 0; closed && i < edges.size(); i += 2)
+            closed = edges[i] == edges[i + 1]
+                && (i + 2 == edges.size() || edges[i] != edges[i + 2]);
+        TEST_CHECK(closed);
+
+        /*
+         * Voxels next to the surface are observed with the sign of the
+         * distance, voxels deep inside the sphere are not observed.
+         */
+        core::SparseFloatVolume const& sdf = fusion.get_sdf();
+        core::SparseFloatVolume const& weights = fusion.get_weights();
+        bool values_match = true;
+        for (int i = 0; i < sdf.width(); ++i)
+        {
+            math::Vec3f const pos = fusion.get_voxel_position(i, 40, 40);
+            float const dist = pos.norm() - RADIUS;
+            float const value = sdf.at(i, 40, 40);
+            float const weight = weights.at(i, 40, 40);
+            if (std::abs(dist) > 0.5f * options.voxel_size
+                && std::abs(dist) < 1.5f * options.voxel_size)
+                values_match = values_match && weight > 0.0f
+                    && (value > 0.0f) == (dist > 0.0f);
+            if (dist < -4.0f * options.voxel_size)
+                values_match = values_match && weight == 0.0f
+                    && value == 1.0f;
+        }
+        TEST_CHECK(values_match);
+    }
+
+    /* The result must not depend on the number of threads. */
+    void
+    test_threads (void)
+    {
+        std::vector<core::geom::FusionView> const views = create_views();
+        core::geom::DepthMapFusion::Options options;
+        options.voxel_size = 0.04f;
+        options.truncation = 0.1f;
+
+        set_num_threads(1);
+        core::geom::DepthMapFusion serial(options);
+        serial.integrate(views);
+        core::TriangleMesh::Ptr serial_mesh = serial.extract_mesh();
+        set_num_threads(7);
+        core::geom::DepthMapFusion parallel(options);
+        parallel.integrate(views);
+        core::TriangleMesh::Ptr parallel_mesh = parallel.extract_mesh();
+
+        TEST_CHECK(!serial_mesh->get_faces().empty());
+        TEST_CHECK(serial_mesh->get_vertices()
+            == parallel_mesh->get_vertices());
+        TEST_CHECK(serial_mesh->get_faces() == parallel_mesh->get_faces());
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_sphere();
+    test_threads();
+    return TEST_RESULT;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "core/image.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    core::ByteImage::Ptr
+    create_ramp (int width, int height)
+    {
+        core::ByteImage::Ptr image = core::ByteImage::create(width, height, 3);
+        for (int i = 0; i < image->get_value_amount(); ++i)
+            image->at(i) = static_cast<uint8_t>(i * 7);
+        return image;
+    }
+
+    uint8_t const*
+    const_values (core::ByteImage::ConstPtr image)
+    {
+        return image->get_data_pointer();
+    }
+
+    /* Sums the values through the mutable accessors. */
+    uint64_t
+    mutable_sum (core::ByteImage::Ptr image)
+    {
+        uint64_t sum = 0;
+        for (int i = 0; i < image->get_value_amount(); ++i)
+            sum += image->at(i);
+        return sum;
+    }
+
+    void
+    test_copy_semantics (void)
+    {
+        core::ByteImage::Ptr orig = create_ramp(16, 8);
+        core::ByteImage::Ptr copy = orig->duplicate();
+        TEST_CHECK(const_values(copy) == const_values(orig));
+
+        copy->at(0) = 99;
+        TEST_CHECK(orig->at(0) == 0);
+        TEST_CHECK(copy->at(0) == 99);
+
+        core::ByteImage::Ptr copy2 = orig->duplicate();
+        orig->at(1) = 42;
+        TEST_CHECK(copy2->at(1) == 7);
+        TEST_CHECK(orig->at(1) == 42);
+
+        /* The last holder of the values writes them in place. */
+        core::ByteImage::Ptr copy3 = orig->duplicate();
+        uint8_t const* values = const_values(orig);
+        orig.reset();
+        copy3->at(2) = 1;
+        TEST_CHECK(const_values(copy3) == values);
+    }
+
+    /*
+     * Threads read the same duplicated images through the mutable
+     * accessors, which copies the values of every image once. Other
+     * threads modify further duplicates at the same time.
+     */
+    void
+    test_concurrent_reads (void)
+    {
+        int const num_threads = 8;
+        for (int round = 0; round < 20; ++round)
+        {
+            core::ByteImage::Ptr orig = create_ramp(64, 32);
+            uint64_t const expected = mutable_sum(orig);
+            core::ByteImage::Ptr copy = orig->duplicate();
+            std::vector<core::ByteImage::Ptr> own(num_threads);
+            for (int t = 0; t < num_threads; ++t)
+                own[t] = (t % 2 ? orig : copy)->duplicate();
+
+            std::atomic<int> failures(0);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < num_threads; ++t)
+                threads.emplace_back([&, t] (void)
+                {
+                    if (t % 4 == 3)
+                    {
+                        own[t]->fill(0);
+                        if (mutable_sum(own[t]) != 0)
+                            failures += 1;
+                        return;
+                    }
+                    core::ByteImage::Ptr image = (t % 2) ? orig : copy;
+                    for (int i = 0; i < 10; ++i)
+                        if (mutable_sum(image) != expected)
+                            failures += 1;
+                });
+            for (std::size_t t = 0; t < threads.size(); ++t)
+                threads[t].join();
+            TEST_CHECK(failures == 0);
+            TEST_CHECK(mutable_sum(orig) == expected);
+            TEST_CHECK(mutable_sum(copy) == expected);
+        }
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_copy_semantics();
+    test_concurrent_reads();
+    return TEST_RESULT;
+}
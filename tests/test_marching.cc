@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "core/marching_cubes.h"
+#include "core/marching_tets.h"
+#include "core/mesh.h"
+#include "core/volume.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    void
+    set_num_threads (int num_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(num_threads);
+#else
+        (void)num_threads;
+#endif
+    }
+
+    /* Grid edge of a surface vertex: first voxel and axis. */
+    typedef std::array<int, 4> EdgeKey;
+    typedef std::array<EdgeKey, 3> Triangle;
+
+    /* The SDF of two spheres, which is never exactly zero at voxels. */
+    float
+    sdf_value (int x, int y, int z, int width)
+    {
+        float const s = 1.0f / (width - 1);
+        math::Vec3f const p(x * s - 0.5f, y * s - 0.5f, z * s - 0.5f);
+        float const d1 = (p - math::Vec3f(-0.1f, 0.02f, 0.0f)).norm() - 0.2317f;
+        float const d2 = (p - math::Vec3f(0.17f, -0.05f, 0.11f)).norm() - 0.1713f;
+        return std::min(d1, d2);
+    }
+
+    core::FloatVolume::Ptr
+    create_volume (int w, int h, int d)
+    {
+        core::FloatVolume::Ptr volume = core::FloatVolume::create(w, h, d);
+        for (int z = 0; z < d; ++z)
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                    volume->at(x, y, z) = sdf_value(x, y, z, w);
+        return volume;
+    }
+
+    /*
+     * Returns the grid edge of a vertex. Two coordinates of a surface
+     * vertex are on voxels, the third one is between two voxels.
+     */
+    EdgeKey
+    get_edge_key (math::Vec3f const& pos, int width)
+    {
+        EdgeKey key = {{ 0, 0, 0, -1 }};
+        for (int i = 0; i < 3; ++i)
+        {
+            float const g = (pos[i] + 0.5f) * (width - 1);
+            float const r = std::round(g);
+            if (std::abs(g - r) < 1e-3f)
+                key[i] = static_cast<int>(r);
+            else
+            {
+                key[i] = static_cast<int>(std::floor(g));
+                key[3] = i;
+            }
+        }
+        return key;
+    }
+
+    /*
+     * Returns the triangles of the mesh as sorted grid edge triples, each
+     * rotated to start with its smallest edge. This is independent of the
+     * order of vertices and faces but keeps the orientation.
+     */
+    std::vector<Triangle>
+    get_triangles (core::TriangleMesh::ConstPtr mesh, int width)
+    {
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        std::vector<Triangle> triangles;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            Triangle tri;
+            for (int j = 0; j < 3; ++j)
+                tri[j] = get_edge_key(verts[faces[i + j]], width);
+            std::rotate(tri.begin(), std::min_element(tri.begin(),
+                tri.end()), tri.end());
+            triangles.push_back(tri);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    /* Checks that vertices on the same grid edge have the same position. */
+    bool
+    same_positions (core::TriangleMesh::ConstPtr a,
+        core::TriangleMesh::ConstPtr b, int width)
+    {
+        typedef std::pair<EdgeKey, math::Vec3f> KeyedVertex;
+        std::vector<KeyedVertex> va, vb;
+        for (std::size_t i = 0; i < a->get_vertices().size(); ++i)
+            va.push_back(KeyedVertex(get_edge_key(a->get_vertices()[i],
+                width), a->get_vertices()[i]));
+        for (std::size_t i = 0; i < b->get_vertices().size(); ++i)
+            vb.push_back(KeyedVertex(get_edge_key(b->get_vertices()[i],
+                width), b->get_vertices()[i]));
+        auto const by_key = [] (KeyedVertex const& x, KeyedVertex const& y)
+            { return x.first < y.first; };
+        std::sort(va.begin(), va.end(), by_key);
+        std::sort(vb.begin(), vb.end(), by_key);
+        if (va.size() != vb.size())
+            return false;
+        for (std::size_t i = 0; i < va.size(); ++i)
+            if (va[i].first != vb[i].first
+                || !va[i].second.is_similar(vb[i].second, 1e-6f))
+                return false;
+        return true;
+    }
+
+    /*
+     * Checks that both meshes have the same oriented triangles, up to the
+     * order of vertices and faces. Vertices are matched by position.
+     */
+    bool
+    same_surface (core::TriangleMesh::ConstPtr a,
+        core::TriangleMesh::ConstPtr b, float eps)
+    {
+        core::TriangleMesh::VertexList const& va = a->get_vertices();
+        core::TriangleMesh::VertexList const& vb = b->get_vertices();
+        if (va.size() != vb.size()
+            || a->get_faces().size() != b->get_faces().size())
+            return false;
+
+        /* Match the vertices of 'a' with the vertices of 'b' sorted by x. */
+        std::vector<unsigned int> order(vb.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&] (unsigned int i,
+            unsigned int j) { return vb[i][0] < vb[j][0]; });
+        std::vector<unsigned int> mapping(va.size());
+        std::vector<bool> used(vb.size(), false);
+        for (std::size_t i = 0; i < va.size(); ++i)
+        {
+            std::vector<unsigned int>::const_iterator iter = std::lower_bound(
+                order.begin(), order.end(), va[i][0] - eps, [&] (unsigned int j,
+                float x) { return vb[j][0] < x; });
+            bool found = false;
+            for (; !found && iter != order.end()
+                && vb[*iter][0] <= va[i][0] + eps; ++iter)
+                if (!used[*iter] && va[i].is_similar(vb[*iter], eps))
+                {
+                    mapping[i] = *iter;
+                    used[*iter] = true;
+                    found = true;
+                }
+            if (!found)
+                return false;
+        }
+
+        typedef std::array<unsigned int, 3> Face;
+        std::vector<Face> fa, fb;
+        for (std::size_t i = 0; i < a->get_faces().size(); i += 3)
+        {
+            Face f = {{ mapping[a->get_faces()[i]],
+                mapping[a->get_faces()[i + 1]],
+                mapping[a->get_faces()[i + 2]] }};
+            std::rotate(f.begin(), std::min_element(f.begin(), f.end()),
+                f.end());
+            fa.push_back(f);
+            Face g = {{ b->get_faces()[i], b->get_faces()[i + 1],
+                b->get_faces()[i + 2] }};
+            std::rotate(g.begin(), std::min_element(g.begin(), g.end()),
+                g.end());
+            fb.push_back(g);
+        }
+        std::sort(fa.begin(), fa.end());
+        std::sort(fb.begin(), fb.end());
+        return fa == fb;
+    }
+
+    core::TriangleMesh::Ptr
+    reference_marching_cubes (core::FloatVolume::Ptr volume)
+    {
+        core::VolumeMCAccessor accessor;
+        accessor.vol = volume;
+        return core::geom::marching_cubes(accessor);
+    }
+
+    /* Bricks of any size must give the mesh of the serial accessor. */
+    void
+    test_marching_cubes_bricks (void)
+    {
+        core::FloatVolume::Ptr volume = create_volume(41, 37, 45);
+        core::TriangleMesh::Ptr reference = reference_marching_cubes(volume);
+        std::vector<Triangle> const expected = get_triangles(reference, 41);
+        TEST_CHECK(!expected.empty());
+
+        int const brick_sizes[] = { 1, 3, 8, 13, 32, 64 };
+        for (int i = 0; i < 6; ++i)
+        {
+            core::TriangleMesh::Ptr mesh = core::geom::marching_cubes_bricks(
+                *volume, brick_sizes[i]);
+            TEST_CHECK(mesh->get_vertices().size()
+                == reference->get_vertices().size());
+            TEST_CHECK(get_triangles(mesh, 41) == expected);
+            TEST_CHECK(same_positions(mesh, reference, 41));
+        }
+    }
+    /*
+     * Creates a sparse volume that only stores the voxels close to the
+     * surface, and the equivalent dense volume with the background value
+     * in the other voxels.
+     */
+    core::SparseFloatVolume::Ptr
+    create_sparse_volume (int w, int h, int d,
+        core::FloatVolume::Ptr* dense)
+    {
+        float const background = 1.0f;
+        float const band = 2.5f / (w - 1);
+        core::SparseFloatVolume::Ptr volume
+            = core::SparseFloatVolume::create(w, h, d, background);
+        *dense = core::FloatVolume::create(w, h, d);
+        for (int z = 0; z < d; ++z)
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                {
+                    float const value = sdf_value(x, y, z, w);
+                    bool const near = std::abs(value) < band;
+                    (*dense)->at(x, y, z) = near ? value : background;
+                    if (near)
+                        volume->at(x, y, z) = value;
+                }
+        return volume;
+    }
+
+    /* The sparse accessors must give the meshes of the dense accessors. */
+    void
+    test_sparse_volume (void)
+    {
+        core::FloatVolume::Ptr dense;
+        core::SparseFloatVolume::Ptr sparse
+            = create_sparse_volume(43, 38, 35, &dense);
+        TEST_CHECK(sparse->get_bricks().size() < 6 * 5 * 5);
+        TEST_CHECK(sparse->at(0, 0, 0) == 1.0f);
+
+        core::SparseVolumeMCAccessor sparse_mc;
+        sparse_mc.vol = sparse;
+        core::TriangleMesh::Ptr mc_mesh = core::geom::marching_cubes(sparse_mc);
+        core::TriangleMesh::Ptr mc_reference = reference_marching_cubes(dense);
+        TEST_CHECK(!mc_mesh->get_faces().empty());
+        TEST_CHECK(get_triangles(mc_mesh, 43) == get_triangles(mc_reference, 43));
+        TEST_CHECK(same_positions(mc_mesh, mc_reference, 43));
+
+        core::SparseVolumeMTAccessor sparse_mt;
+        sparse_mt.vol = sparse;
+        core::TriangleMesh::Ptr mt_mesh
+            = core::geom::marching_tetrahedra(sparse_mt);
+        core::VolumeMTAccessor dense_mt;
+        dense_mt.vol = dense;
+        core::TriangleMesh::Ptr mt_reference
+            = core::geom::marching_tetrahedra(dense_mt);
+        TEST_CHECK(!mt_mesh->get_faces().empty());
+        TEST_CHECK(same_surface(mt_mesh, mt_reference, 1e-6f));
+    }
+
+    /* Iterates the tets of a grid in order. */
+    struct TetGridAccessor
+    {
+        TetGridAccessor (core::geom::TetGrid const& grid);
+        bool next (void);
+        bool has_colors (void) const;
+
+        core::geom::TetGrid const& grid;
+        std::size_t iter;
+        float sdf[4];
+        unsigned int vid[4];
+        math::Vec3f pos[4];
+        math::Vec3f color[4];
+    };
+
+    TetGridAccessor::TetGridAccessor (core::geom::TetGrid const& grid)
+        : grid(grid)
+        , iter(0)
+    {
+    }
+
+    bool
+    TetGridAccessor::next (void)
+    {
+        if (this->iter == this->grid.tets.size())
+            return false;
+        for (int i = 0; i < 4; ++i)
+        {
+            this->vid[i] = this->grid.tets[this->iter + i];
+            this->sdf[i] = this->grid.sdf[this->vid[i]];
+            this->pos[i] = this->grid.positions[this->vid[i]];
+            if (this->has_colors())
+                this->color[i] = this->grid.colors[this->vid[i]];
+        }
+        this->iter += 4;
+        return true;
+    }
+
+    bool
+    TetGridAccessor::has_colors (void) const
+    {
+        return !this->grid.colors.empty();
+    }
+
+    /*
+     * Creates the Freudenthal tets of a volume. Values close to zero are
+     * set to zero to exercise vertex snapping.
+     */
+    core::geom::TetGrid
+    create_tet_grid (int w, int h, int d, bool colors)
+    {
+        core::FloatVolume::Ptr volume = create_volume(w, h, d);
+        std::vector<float>& values = volume->get_data();
+        for (std::size_t i = 0; i < values.size(); ++i)
+            if (std::abs(values[i]) < 0.1f / w)
+                values[i] = 0.0f;
+
+        core::geom::TetGrid grid;
+        grid.positions.resize(w * h * d);
+        grid.sdf = values;
+        core::VolumeMTAccessor accessor;
+        accessor.vol = volume;
+        while (accessor.next())
+            for (int i = 0; i < 4; ++i)
+            {
+                grid.tets.push_back(accessor.vid[i]);
+                grid.positions[accessor.vid[i]] = accessor.pos[i];
+            }
+        if (colors)
+            for (std::size_t i = 0; i < grid.positions.size(); ++i)
+                grid.colors.push_back(grid.positions[i] + 0.5f);
+        return grid;
+    }
+
+    /*
+     * The grid version must give the faces of the serial version in the
+     * same order, with the same corner positions and colors.
+     */
+    bool
+    same_faces (core::TriangleMesh::ConstPtr a, core::TriangleMesh::ConstPtr b)
+    {
+        core::TriangleMesh::FaceList const& fa = a->get_faces();
+        core::TriangleMesh::FaceList const& fb = b->get_faces();
+        bool const colors = a->has_vertex_colors();
+        if (fa.size() != fb.size() || colors != b->has_vertex_colors()
+            || a->get_vertices().size() != b->get_vertices().size())
+            return false;
+        for (std::size_t i = 0; i < fa.size(); ++i)
+        {
+            if (!a->get_vertices()[fa[i]].is_similar(
+                b->get_vertices()[fb[i]], 1e-6f))
+                return false;
+            if (colors && !a->get_vertex_colors()[fa[i]].is_similar(
+                b->get_vertex_colors()[fb[i]], 1e-6f))
+                return false;
+        }
+        return true;
+    }
+
+    void
+    test_marching_tetrahedra_grid (bool colors)
+    {
+        core::geom::TetGrid const grid = create_tet_grid(31, 27, 29, colors);
+        TEST_CHECK(std::count(grid.sdf.begin(), grid.sdf.end(), 0.0f) > 0);
+
+        TetGridAccessor accessor(grid);
+        core::TriangleMesh::Ptr reference
+            = core::geom::marching_tetrahedra(accessor);
+        TEST_CHECK(!reference->get_faces().empty());
+
+        set_num_threads(1);
+        core::TriangleMesh::Ptr serial
+            = core::geom::marching_tetrahedra_grid(grid);
+        set_num_threads(7);
+        core::TriangleMesh::Ptr parallel
+            = core::geom::marching_tetrahedra_grid(grid);
+        TEST_CHECK(same_faces(serial, reference));
+        TEST_CHECK(serial->get_vertices() == parallel->get_vertices());
+        TEST_CHECK(serial->get_faces() == parallel->get_faces());
+        TEST_CHECK(serial->get_vertex_colors()
+            == parallel->get_vertex_colors());
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_marching_cubes_bricks();
+    test_sparse_volume();
+    test_marching_tetrahedra_grid(false);
+    test_marching_tetrahedra_grid(true);
+    return TEST_RESULT;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "core/mesh.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    /*
+     * Creates a bumpy grid of (w x h) vertices. With 'shuffle' the vertex
+     * IDs are permuted, so faces refer to vertices all over the list.
+     */
+    core::TriangleMesh::Ptr
+    create_grid (int w, int h, bool shuffle)
+    {
+        std::vector<unsigned int> ids(w * h);
+        for (std::size_t i = 0; i < ids.size(); ++i)
+            ids[i] = i;
+        if (shuffle)
+            std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        core::TriangleMesh::VertexList& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList& faces = mesh->get_faces();
+        verts.resize(w * h);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                verts[ids[y * w + x]] = math::Vec3f(x, y,
+                    std::sin(x * 0.3f) * std::cos(y * 0.2f) * 2.0f);
+        for (int y = 0; y + 1 < h; ++y)
+            for (int x = 0; x + 1 < w; ++x)
+            {
+                unsigned int const i = y * w + x;
+                faces.push_back(ids[i]);
+                faces.push_back(ids[i + 1]);
+                faces.push_back(ids[i + w]);
+                faces.push_back(ids[i + 1]);
+                faces.push_back(ids[i + w + 1]);
+                faces.push_back(ids[i + w]);
+            }
+        return mesh;
+    }
+
+    void
+    set_num_threads (int num_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(num_threads);
+#else
+        (void)num_threads;
+#endif
+    }
+
+    /* Angle weighted vertex normals, computed in double precision. */
+    std::vector<math::Vec3d>
+    reference_normals (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        std::vector<math::Vec3d> normals(verts.size(), math::Vec3d(0.0));
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            math::Vec3d const v[3] = { math::Vec3d(verts[faces[i]]),
+                math::Vec3d(verts[faces[i + 1]]),
+                math::Vec3d(verts[faces[i + 2]]) };
+            math::Vec3d const fn = (v[1] - v[0]).cross(v[2] - v[0]).normalized();
+            for (int j = 0; j < 3; ++j)
+            {
+                math::Vec3d const e1 = (v[(j + 1) % 3] - v[j]).normalized();
+                math::Vec3d const e2 = (v[(j + 2) % 3] - v[j]).normalized();
+                normals[faces[i + j]] += fn * std::acos(e1.dot(e2));
+            }
+        }
+        for (std::size_t i = 0; i < normals.size(); ++i)
+            normals[i].normalize();
+        return normals;
+    }
+
+    bool
+    similar_normals (core::TriangleMesh::NormalList const& a,
+        core::TriangleMesh::NormalList const& b, float eps)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (std::size_t i = 0; i < a.size(); ++i)
+            if (!a[i].is_similar(b[i], eps))
+                return false;
+        return true;
+    }
+
+    void
+    test_normals (bool shuffle)
+    {
+        core::TriangleMesh::Ptr mesh = create_grid(150, 90, shuffle);
+        std::vector<math::Vec3d> const expected = reference_normals(mesh);
+
+        set_num_threads(1);
+        mesh->recalc_normals();
+        core::TriangleMesh::NormalList const serial_vnormals
+            = mesh->get_vertex_normals();
+        core::TriangleMesh::NormalList const serial_fnormals
+            = mesh->get_face_normals();
+
+        set_num_threads(7);
+        mesh->recalc_normals();
+        TEST_CHECK(similar_normals(serial_vnormals,
+            mesh->get_vertex_normals(), 1e-5f));
+        TEST_CHECK(serial_fnormals == mesh->get_face_normals());
+        TEST_CHECK(mesh->get_face_normals().size()
+            == mesh->get_faces().size() / 3);
+
+        bool matches_reference = true;
+        for (std::size_t i = 0; i < expected.size(); ++i)
+            matches_reference = matches_reference && math::Vec3f(expected[i])
+                .is_similar(mesh->get_vertex_normals()[i], 1e-4f);
+        TEST_CHECK(matches_reference);
+
+        /* Only vertex normals. */
+        mesh->clear_normals();
+        mesh->recalc_normals(false, true);
+        TEST_CHECK(mesh->get_face_normals().empty());
+        TEST_CHECK(similar_normals(serial_vnormals,
+            mesh->get_vertex_normals(), 1e-5f));
+    }
+
+    /*
+     * Returns the sorted corner positions of the faces, each rotated to
+     * start with its smallest position to keep the orientation.
+     */
+    std::vector<std::vector<float> >
+    face_positions (core::TriangleMesh::VertexList const& verts,
+        core::TriangleMesh::FaceList const& faces)
+    {
+        std::vector<std::vector<float> > result;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            std::vector<float> tri;
+            for (int j = 0; j < 3; ++j)
+                tri.insert(tri.end(), verts[faces[i + j]].begin(),
+                    verts[faces[i + j]].end());
+            std::size_t first = 0;
+            for (std::size_t j = 3; j < 9; j += 3)
+                if (std::lexicographical_compare(tri.begin() + j,
+                    tri.begin() + j + 3, tri.begin() + first,
+                    tri.begin() + first + 3))
+                    first = j;
+            std::rotate(tri.begin(), tri.begin() + first, tri.end());
+            result.push_back(tri);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    /* Kept vertices and attributes stay in order, one and seven threads. */
+    void
+    test_delete_vertices (bool fix_faces)
+    {
+        core::TriangleMesh::Ptr original = create_grid(150, 90, true);
+        core::TriangleMesh::VertexList const& verts = original->get_vertices();
+        for (std::size_t i = 0; i < verts.size(); ++i)
+        {
+            original->get_vertex_colors().push_back(
+                math::Vec4f(verts[i], 1.0f));
+            original->get_vertex_confidences().push_back(verts[i][0]);
+            original->get_vertex_values().push_back(verts[i][1]);
+            original->get_vertex_texcoords().push_back(
+                math::Vec2f(verts[i][0], verts[i][1]));
+        }
+        original->recalc_normals(false, true);
+
+        std::mt19937 rng(3);
+        core::TriangleMesh::DeleteList dlist(verts.size());
+        for (std::size_t i = 0; i < dlist.size(); ++i)
+            dlist[i] = rng() % 10 < 3;
+
+        /* The kept vertices and the faces with only kept vertices. */
+        core::TriangleMesh::VertexList expected_verts;
+        for (std::size_t i = 0; i < verts.size(); ++i)
+            if (!dlist[i])
+                expected_verts.push_back(verts[i]);
+        core::TriangleMesh::FaceList const& faces = original->get_faces();
+        core::TriangleMesh::FaceList kept_faces;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+            if (!dlist[faces[i]] && !dlist[faces[i + 1]]
+                && !dlist[faces[i + 2]])
+                kept_faces.insert(kept_faces.end(),
+                    faces.begin() + i, faces.begin() + i + 3);
+        std::vector<std::vector<float> > const expected_faces
+            = face_positions(verts, kept_faces);
+
+        int const num_threads[] = { 1, 7 };
+        for (int t = 0; t < 2; ++t)
+        {
+            set_num_threads(num_threads[t]);
+            core::TriangleMesh::Ptr mesh = original->duplicate();
+            if (fix_faces)
+                mesh->delete_vertices_fix_faces(dlist);
+            else
+                mesh->delete_vertices(dlist);
+
+            core::TriangleMesh::VertexList const& kept = mesh->get_vertices();
+            TEST_CHECK(kept == expected_verts);
+            bool attributes_match
+                = mesh->get_vertex_colors().size() == kept.size()
+                && mesh->get_vertex_confidences().size() == kept.size()
+                && mesh->get_vertex_values().size() == kept.size()
+                && mesh->get_vertex_texcoords().size() == kept.size()
+                && mesh->get_vertex_normals().size() == kept.size();
+            for (std::size_t i = 0; attributes_match && i < kept.size(); ++i)
+                attributes_match = math::Vec3f(
+                    mesh->get_vertex_colors()[i].begin()) == kept[i]
+                    && mesh->get_vertex_confidences()[i] == kept[i][0]
+                    && mesh->get_vertex_values()[i] == kept[i][1]
+                    && mesh->get_vertex_texcoords()[i]
+                    == math::Vec2f(kept[i][0], kept[i][1]);
+            TEST_CHECK(attributes_match);
+
+            if (fix_faces)
+                TEST_CHECK(face_positions(kept, mesh->get_faces())
+                    == expected_faces);
+            else
+                TEST_CHECK(mesh->get_faces() == original->get_faces());
+        }
+
+        bool size_mismatch_throws = false;
+        try
+        {
+            dlist.pop_back();
+            original->delete_vertices(dlist);
+        }
+        catch (std::invalid_argument const&)
+        {
+            size_mismatch_throws = true;
+        }
+        TEST_CHECK(size_mismatch_throws);
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_normals(false);
+    test_normals(true);
+    test_delete_vertices(false);
+    test_delete_vertices(true);
+    return TEST_RESULT;
+}
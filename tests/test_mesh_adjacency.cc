@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <vector>
+
+#include "core/mesh.h"
+#include "core/mesh_adjacency.h"
+#include "core/mesh_info.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    core::TriangleMesh::Ptr
+    create_mesh (int num_vertices, unsigned int const* faces, int num_faces)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        for (int i = 0; i < num_vertices; ++i)
+            mesh->get_vertices().push_back(math::Vec3f(i, i % 3, i % 5));
+        mesh->get_faces().assign(faces, faces + 3 * num_faces);
+        return mesh;
+    }
+
+    core::TriangleMesh::Ptr
+    create_grid (int w, int h)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                mesh->get_vertices().push_back(math::Vec3f(x, y, 0.0f));
+        core::TriangleMesh::FaceList& faces = mesh->get_faces();
+        for (int y = 0; y + 1 < h; ++y)
+            for (int x = 0; x + 1 < w; ++x)
+            {
+                unsigned int const i = y * w + x;
+                unsigned int const quad[6]
+                    = { i, i + 1, i + w, i + 1, i + w + 1, i + w };
+                faces.insert(faces.end(), quad, quad + 6);
+            }
+        return mesh;
+    }
+
+    /* The adjacency must match MeshInfo, including the order. */
+    void
+    check_against_mesh_info (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::MeshInfo info(mesh);
+        core::MeshAdjacency adjacency(mesh);
+        TEST_CHECK(adjacency.size() == info.size());
+        if (adjacency.size() != info.size())
+            return;
+
+        bool classes_match = true;
+        bool faces_match = true;
+        bool vertices_match = true;
+        for (std::size_t i = 0; i < info.size(); ++i)
+        {
+            classes_match = classes_match
+                && adjacency.get_vertex_class(i) == info[i].vclass;
+            faces_match = faces_match && std::vector<std::size_t>(
+                adjacency.get_faces(i), adjacency.get_faces(i)
+                + adjacency.get_num_faces(i)) == info[i].faces;
+            vertices_match = vertices_match && std::vector<std::size_t>(
+                adjacency.get_vertices(i), adjacency.get_vertices(i)
+                + adjacency.get_num_vertices(i)) == info[i].verts;
+        }
+        TEST_CHECK(classes_match);
+        TEST_CHECK(faces_match);
+        TEST_CHECK(vertices_match);
+
+        bool edges_match = true;
+        for (std::size_t i = 0; i < info.size(); ++i)
+            for (std::size_t j = 0; j < info.size() && j < 40; ++j)
+                edges_match = edges_match
+                    && adjacency.is_mesh_edge(i, j) == info.is_mesh_edge(i, j);
+        TEST_CHECK(edges_match);
+    }
+
+    void
+    test_grid (void)
+    {
+        core::TriangleMesh::Ptr mesh = create_grid(31, 17);
+        check_against_mesh_info(mesh);
+
+        /* An inner vertex becomes a border vertex without one face. */
+        core::MeshAdjacency adjacency(mesh);
+        std::size_t const vertex_id = 5 * 31 + 7;
+        TEST_CHECK(adjacency.get_vertex_class(vertex_id)
+            == core::MeshInfo::VERTEX_CLASS_SIMPLE);
+        std::vector<core::MeshAdjacency::FaceID> face_ids(
+            adjacency.get_faces(vertex_id), adjacency.get_faces(vertex_id)
+            + adjacency.get_num_faces(vertex_id));
+        TEST_CHECK(core::MeshAdjacency::classify_vertex(mesh->get_faces(),
+            vertex_id, face_ids) == core::MeshInfo::VERTEX_CLASS_SIMPLE);
+        face_ids.erase(face_ids.begin() + 2);
+        TEST_CHECK(core::MeshAdjacency::classify_vertex(mesh->get_faces(),
+            vertex_id, face_ids) == core::MeshInfo::VERTEX_CLASS_BORDER);
+        face_ids.erase(face_ids.begin() + 3);
+        TEST_CHECK(core::MeshAdjacency::classify_vertex(mesh->get_faces(),
+            vertex_id, face_ids) == core::MeshInfo::VERTEX_CLASS_COMPLEX);
+    }
+
+    void
+    test_closed_mesh (void)
+    {
+        /* Octahedron. */
+        unsigned int const faces[] = { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 1,
+            5, 2, 1, 5, 3, 2, 5, 4, 3, 5, 1, 4 };
+        core::TriangleMesh::Ptr mesh = create_mesh(6, faces, 8);
+        check_against_mesh_info(mesh);
+        core::MeshAdjacency adjacency(mesh);
+        for (std::size_t i = 0; i < adjacency.size(); ++i)
+        {
+            TEST_CHECK(adjacency.get_vertex_class(i)
+                == core::MeshInfo::VERTEX_CLASS_SIMPLE);
+            TEST_CHECK(adjacency.get_num_faces(i) == 4);
+        }
+    }
+
+    void
+    test_special_vertices (void)
+    {
+        /*
+         * Two fans touching at vertex 0, an unreferenced vertex 7 and
+         * the edge (4, 5) shared by three faces.
+         */
+        unsigned int const faces[] = { 0, 1, 2, 0, 3, 4,
+            4, 5, 6, 5, 4, 8, 4, 5, 9 };
+        core::TriangleMesh::Ptr mesh = create_mesh(10, faces, 5);
+        check_against_mesh_info(mesh);
+        core::MeshAdjacency adjacency(mesh);
+        TEST_CHECK(adjacency.get_vertex_class(0)
+            == core::MeshInfo::VERTEX_CLASS_COMPLEX);
+        TEST_CHECK(adjacency.get_vertex_class(7)
+            == core::MeshInfo::VERTEX_CLASS_UNREF);
+        TEST_CHECK(adjacency.get_num_faces(7) == 0);
+        TEST_CHECK(adjacency.get_num_vertices(7) == 0);
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_grid();
+    test_closed_mesh();
+    test_special_vertices();
+    return TEST_RESULT;
+}
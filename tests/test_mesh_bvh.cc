@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "math/octree_tools.h"
+#include "core/mesh.h"
+#include "core/mesh_bvh.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    math::Vec3f
+    random_point (std::mt19937* rng, float lo, float hi)
+    {
+        std::uniform_real_distribution<float> uniform(lo, hi);
+        float const x = uniform(*rng);
+        float const y = uniform(*rng);
+        float const z = uniform(*rng);
+        return math::Vec3f(x, y, z);
+    }
+
+    /* Random triangles of about 'size' in the unit cube. */
+    core::TriangleMesh::Ptr
+    create_soup (std::size_t num_faces, float size, unsigned int seed)
+    {
+        std::mt19937 rng(seed);
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        for (std::size_t i = 0; i < num_faces; ++i)
+        {
+            math::Vec3f const center = random_point(&rng, 0.0f, 1.0f);
+            for (int j = 0; j < 3; ++j)
+            {
+                mesh->get_faces().push_back(mesh->get_vertices().size());
+                mesh->get_vertices().push_back(center
+                    + random_point(&rng, -size, size));
+            }
+        }
+        return mesh;
+    }
+
+    math::Vec3f const&
+    corner (core::TriangleMesh::ConstPtr mesh, std::size_t face_id, int j)
+    {
+        return mesh->get_vertices()[mesh->get_faces()[face_id * 3 + j]];
+    }
+
+    /* Nearest hit with the same acceptance rules over all faces. */
+    bool
+    brute_force_intersect (core::TriangleMesh::ConstPtr mesh,
+        core::MeshBVH::Ray const& ray, float* t_hit)
+    {
+        bool found = false;
+        *t_hit = ray.tmax;
+        for (std::size_t i = 0; i < mesh->get_faces().size() / 3; ++i)
+        {
+            float const t = math::geom::ray_triangle_intersect(ray.origin,
+                ray.dir, corner(mesh, i, 0), corner(mesh, i, 1),
+                corner(mesh, i, 2));
+            if (t == 0.0f || t < ray.tmin || t > *t_hit)
+                continue;
+            *t_hit = t;
+            found = true;
+        }
+        return found;
+    }
+
+    /* Distance of the point to the segment in double precision. */
+    double
+    segment_dist (math::Vec3d const& p, math::Vec3d const& a,
+        math::Vec3d const& b)
+    {
+        math::Vec3d const ab = b - a;
+        double const s = std::min(1.0, std::max(0.0,
+            (p - a).dot(ab) / ab.square_norm()));
+        return (a + ab * s - p).norm();
+    }
+
+    /* Distance of the point to the triangle in double precision. */
+    double
+    triangle_dist (math::Vec3d const& p, math::Vec3d const& a,
+        math::Vec3d const& b, math::Vec3d const& c)
+    {
+        /* Inside the prism over the triangle the plane distance is used. */
+        math::Vec3d const n = (b - a).cross(c - a).normalized();
+        double const plane_dist = (p - a).dot(n);
+        math::Vec3d const q = p - n * plane_dist;
+        bool const inside = (b - a).cross(q - a).dot(n) >= 0.0
+            && (c - b).cross(q - b).dot(n) >= 0.0
+            && (a - c).cross(q - c).dot(n) >= 0.0;
+        if (inside)
+            return std::abs(plane_dist);
+        return std::min(segment_dist(p, a, b),
+            std::min(segment_dist(p, b, c), segment_dist(p, c, a)));
+    }
+
+    void
+    test_rays (std::size_t num_faces, std::size_t max_leaf_faces)
+    {
+        core::TriangleMesh::Ptr mesh = create_soup(num_faces, 0.05f,
+            num_faces);
+        core::MeshBVH::Options options;
+        options.max_leaf_faces = max_leaf_faces;
+        core::MeshBVH bvh(mesh, options);
+        TEST_CHECK(bvh.get_num_faces() == num_faces);
+
+        std::mt19937 rng(7);
+        std::size_t num_hits = 0;
+        bool hits_match = true;
+        bool occlusion_matches = true;
+        bool faces_match = true;
+        for (int i = 0; i < 500; ++i)
+        {
+            /* Rays from outside towards random points, some limited. */
+            math::Vec3f const origin = random_point(&rng, -0.5f, 1.5f);
+            math::Vec3f const target = random_point(&rng, 0.0f, 1.0f);
+            core::MeshBVH::Ray ray(origin, (target - origin).normalized());
+            if (i % 3 == 1)
+                ray.tmax = (target - origin).norm();
+            if (i % 5 == 2)
+                ray.tmin = 0.5f * (target - origin).norm();
+
+            float expected_t;
+            bool const expected = brute_force_intersect(mesh, ray,
+                &expected_t);
+            core::MeshBVH::Hit hit;
+            bool const result = bvh.intersect(ray, &hit);
+            occlusion_matches = occlusion_matches
+                && bvh.occluded(ray) == expected;
+            hits_match = hits_match && result == expected;
+            if (!result || !expected)
+                continue;
+
+            num_hits += 1;
+            hits_match = hits_match && hit.t == expected_t;
+            float bary[2];
+            float const face_t = math::geom::ray_triangle_intersect(
+                ray.origin, ray.dir, corner(mesh, hit.face_id, 0),
+                corner(mesh, hit.face_id, 1), corner(mesh, hit.face_id, 2),
+                bary);
+            faces_match = faces_match && face_t == hit.t
+                && hit.bcoords[1] == bary[0] && hit.bcoords[2] == bary[1];
+        }
+        TEST_CHECK(hits_match);
+        TEST_CHECK(occlusion_matches);
+        TEST_CHECK(faces_match);
+        TEST_CHECK(num_faces < 1000 || num_hits > 100);
+    }
+
+    void
+    test_closest_point (std::size_t num_faces)
+    {
+        core::TriangleMesh::Ptr mesh = create_soup(num_faces, 0.08f,
+            num_faces + 1);
+        core::MeshBVH bvh(mesh);
+
+        std::mt19937 rng(8);
+        bool dists_match = true;
+        bool points_match = true;
+        bool limits_match = true;
+        for (int i = 0; i < 300; ++i)
+        {
+            math::Vec3f const point = random_point(&rng, -0.2f, 1.2f);
+            double expected = std::numeric_limits<double>::max();
+            for (std::size_t j = 0; j < num_faces; ++j)
+                expected = std::min(expected, triangle_dist(
+                    math::Vec3d(point), math::Vec3d(corner(mesh, j, 0)),
+                    math::Vec3d(corner(mesh, j, 1)),
+                    math::Vec3d(corner(mesh, j, 2))));
+
+            core::MeshBVH::Nearest nearest;
+            TEST_CHECK(bvh.closest_point(point, &nearest));
+            dists_match = dists_match
+                && std::abs(nearest.dist - expected) < 1e-5;
+            points_match = points_match && std::abs(triangle_dist(
+                math::Vec3d(nearest.point),
+                math::Vec3d(corner(mesh, nearest.face_id, 0)),
+                math::Vec3d(corner(mesh, nearest.face_id, 1)),
+                math::Vec3d(corner(mesh, nearest.face_id, 2)))) < 1e-5
+                && std::abs((nearest.point - point).norm()
+                - nearest.dist) < 1e-5f;
+
+            /* A limit below the distance finds nothing. */
+            limits_match = limits_match && (expected < 1e-4
+                || !bvh.closest_point(point, &nearest, expected * 0.99f));
+        }
+        TEST_CHECK(dists_match);
+        TEST_CHECK(points_match);
+        TEST_CHECK(limits_match);
+    }
+
+    void
+    test_query_box (std::size_t num_faces)
+    {
+        core::TriangleMesh::Ptr mesh = create_soup(num_faces, 0.05f,
+            num_faces + 2);
+        core::MeshBVH bvh(mesh);
+
+        std::mt19937 rng(9);
+        bool boxes_match = true;
+        for (int i = 0; i < 200; ++i)
+        {
+            math::Vec3f const a = random_point(&rng, -0.1f, 1.1f);
+            math::Vec3f const b = random_point(&rng, -0.1f, 1.1f);
+            math::Vec3f aabb_min, aabb_max;
+            for (int j = 0; j < 3; ++j)
+            {
+                aabb_min[j] = std::min(a[j], b[j]);
+                aabb_max[j] = std::max(a[j], b[j]);
+            }
+            if (i % 2 == 0)
+                aabb_max = aabb_min + (aabb_max - aabb_min) * 0.2f;
+
+            core::MeshBVH::FaceList expected;
+            math::Vec3f const center = (aabb_min + aabb_max) / 2.0f;
+            math::Vec3f const halfsize = (aabb_max - aabb_min) / 2.0f;
+            for (std::size_t j = 0; j < num_faces; ++j)
+                if (math::geom::triangle_box_overlap(center, halfsize,
+                    corner(mesh, j, 0), corner(mesh, j, 1),
+                    corner(mesh, j, 2)))
+                    expected.push_back(j);
+
+            core::MeshBVH::FaceList result;
+            bvh.query_box(aabb_min, aabb_max, &result);
+            boxes_match = boxes_match && result == expected;
+        }
+        TEST_CHECK(boxes_match);
+    }
+
+    void
+    test_empty (void)
+    {
+        core::MeshBVH bvh(core::TriangleMesh::create());
+        core::MeshBVH::Hit hit;
+        core::MeshBVH::Ray const ray(math::Vec3f(0.0f),
+            math::Vec3f(1.0f, 0.0f, 0.0f));
+        TEST_CHECK(bvh.get_num_faces() == 0);
+        TEST_CHECK(!bvh.intersect(ray, &hit));
+        TEST_CHECK(!bvh.occluded(ray));
+        core::MeshBVH::Nearest nearest;
+        TEST_CHECK(!bvh.closest_point(math::Vec3f(0.0f), &nearest));
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_empty();
+    std::size_t const sizes[] = { 1, 2, 5, 100, 3000 };
+    for (int i = 0; i < 5; ++i)
+    {
+        test_rays(sizes[i], 1);
+        test_rays(sizes[i], 4);
+        test_closest_point(sizes[i]);
+        test_query_box(sizes[i]);
+    }
+    return TEST_RESULT;
+}
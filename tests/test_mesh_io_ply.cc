@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "core/mesh.h"
+#include "core/mesh_io_ply.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    /* Creates a grid of (w x h) vertices with all vertex attributes. */
+    core::TriangleMesh::Ptr
+    create_grid (int w, int h)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        core::TriangleMesh::VertexList& verts = mesh->get_vertices();
+        core::TriangleMesh::ColorList& colors = mesh->get_vertex_colors();
+        core::TriangleMesh::ConfidenceList& confs
+            = mesh->get_vertex_confidences();
+        core::TriangleMesh::ValueList& values = mesh->get_vertex_values();
+        core::TriangleMesh::FaceList& faces = mesh->get_faces();
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                int const i = y * w + x;
+                verts.push_back(math::Vec3f(x * 0.5f, y * 0.25f, i * 0.125f));
+                colors.push_back(math::Vec4f((i % 256) / 255.0f,
+                    ((i * 3) % 256) / 255.0f, ((i * 7) % 256) / 255.0f, 1.0f));
+                confs.push_back(i * 0.5f);
+                values.push_back(-i * 0.25f);
+            }
+        for (int y = 0; y + 1 < h; ++y)
+            for (int x = 0; x + 1 < w; ++x)
+            {
+                unsigned int const i = y * w + x;
+                faces.push_back(i);
+                faces.push_back(i + 1);
+                faces.push_back(i + w);
+                faces.push_back(i + 1);
+                faces.push_back(i + w + 1);
+                faces.push_back(i + w);
+            }
+        return mesh;
+    }
+
+    bool
+    equal_meshes (core::TriangleMesh::ConstPtr a,
+        core::TriangleMesh::ConstPtr b)
+    {
+        if (a->get_vertices() != b->get_vertices()
+            || a->get_faces() != b->get_faces()
+            || a->get_vertex_confidences() != b->get_vertex_confidences()
+            || a->get_vertex_values() != b->get_vertex_values()
+            || a->get_vertex_colors().size() != b->get_vertex_colors().size())
+            return false;
+        for (std::size_t i = 0; i < a->get_vertex_colors().size(); ++i)
+            if (!a->get_vertex_colors()[i].is_similar(
+                b->get_vertex_colors()[i], 0.5f / 255.0f))
+                return false;
+        return true;
+    }
+
+    void
+    test_round_trip (bool binary)
+    {
+        std::string const filename = binary
+            ? "test_mesh_io_ply_binary.ply" : "test_mesh_io_ply_ascii.ply";
+        core::TriangleMesh::Ptr mesh = create_grid(37, 23);
+        core::geom::SavePLYOptions options;
+        options.format_binary = binary;
+        options.write_face_colors = false;
+        core::geom::save_ply_mesh(mesh, filename, options);
+        core::TriangleMesh::Ptr loaded = core::geom::load_ply_mesh(filename);
+        std::remove(filename.c_str());
+        TEST_CHECK(equal_meshes(mesh, loaded));
+    }
+
+    /* A truncated binary file keeps the faces that were read completely. */
+    void
+    test_truncated_binary (void)
+    {
+        std::string const filename = "test_mesh_io_ply_truncated.ply";
+        core::TriangleMesh::Ptr mesh = create_grid(8, 8);
+        core::geom::SavePLYOptions options;
+        options.write_face_colors = false;
+        core::geom::save_ply_mesh(mesh, filename, options);
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        std::string data;
+        char buffer[4096];
+        std::size_t num_read;
+        while ((num_read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.append(buffer, num_read);
+        std::fclose(file);
+        file = std::fopen(filename.c_str(), "wb");
+        std::fwrite(data.data(), 1, data.size() - 20, file);
+        std::fclose(file);
+
+        core::TriangleMesh::Ptr loaded = core::geom::load_ply_mesh(filename);
+        std::remove(filename.c_str());
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        core::TriangleMesh::FaceList const& loaded_faces
+            = loaded->get_faces();
+        std::size_t const num_complete = faces.size() - 6;
+        TEST_CHECK(loaded->get_vertices() == mesh->get_vertices());
+        TEST_CHECK(loaded_faces.size() >= num_complete);
+        TEST_CHECK(loaded_faces.size() < faces.size());
+        TEST_CHECK(std::equal(faces.begin(), faces.begin() + num_complete,
+            loaded_faces.begin()));
+    }
+
+    /* Meshes streamed in parts load as the merged mesh. */
+    void
+    test_stream_writer (void)
+    {
+        std::string const filename = "test_mesh_io_ply_stream.ply";
+        core::TriangleMesh::Ptr part1 = create_grid(20, 10);
+        core::TriangleMesh::Ptr part2 = create_grid(7, 30);
+        {
+            core::geom::PLYStreamWriter writer(filename);
+            writer.add_mesh(part1);
+            writer.add_mesh(part2);
+            TEST_CHECK(writer.get_num_vertices() == 200 + 210);
+            TEST_CHECK(writer.get_num_faces() == 342 + 348);
+            writer.close();
+        }
+        core::TriangleMesh::Ptr loaded = core::geom::load_ply_mesh(filename);
+        std::remove(filename.c_str());
+
+        core::TriangleMesh::Ptr merged = core::TriangleMesh::create(part1);
+        std::size_t const offset = merged->get_vertices().size();
+        merged->get_vertices().insert(merged->get_vertices().end(),
+            part2->get_vertices().begin(), part2->get_vertices().end());
+        merged->get_vertex_colors().insert(merged->get_vertex_colors().end(),
+            part2->get_vertex_colors().begin(),
+            part2->get_vertex_colors().end());
+        merged->get_vertex_confidences().insert(
+            merged->get_vertex_confidences().end(),
+            part2->get_vertex_confidences().begin(),
+            part2->get_vertex_confidences().end());
+        merged->get_vertex_values().insert(merged->get_vertex_values().end(),
+            part2->get_vertex_values().begin(),
+            part2->get_vertex_values().end());
+        for (std::size_t i = 0; i < part2->get_faces().size(); ++i)
+            merged->get_faces().push_back(part2->get_faces()[i] + offset);
+        TEST_CHECK(equal_meshes(merged, loaded));
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_round_trip(true);
+    test_round_trip(false);
+    test_truncated_binary();
+    test_stream_writer();
+    return TEST_RESULT;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "core/mesh.h"
+#include "core/mesh_io_obj.h"
+#include "core/mesh_io_off.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    /*
+     * Creates a grid of (w x h) vertices. The coordinates are exact in
+     * the text formats. Grids over 300 x 300 span several parse chunks.
+     */
+    core::TriangleMesh::Ptr
+    create_grid (int w, int h)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        core::TriangleMesh::VertexList& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList& faces = mesh->get_faces();
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                verts.push_back(math::Vec3f(x * 0.5f, y * 0.25f,
+                    ((x * 7 + y * 3) % 64) * 0.125f));
+        for (int y = 0; y + 1 < h; ++y)
+            for (int x = 0; x + 1 < w; ++x)
+            {
+                unsigned int const i = y * w + x;
+                faces.push_back(i);
+                faces.push_back(i + 1);
+                faces.push_back(i + w);
+                faces.push_back(i + 1);
+                faces.push_back(i + w + 1);
+                faces.push_back(i + w);
+            }
+        return mesh;
+    }
+
+    /* Compares the corner positions of all faces, which OBJ keeps. */
+    bool
+    equal_triangles (core::TriangleMesh::ConstPtr a,
+        core::TriangleMesh::ConstPtr b)
+    {
+        core::TriangleMesh::FaceList const& fa = a->get_faces();
+        core::TriangleMesh::FaceList const& fb = b->get_faces();
+        if (fa.size() != fb.size())
+            return false;
+        for (std::size_t i = 0; i < fa.size(); ++i)
+            if (a->get_vertices()[fa[i]] != b->get_vertices()[fb[i]])
+                return false;
+        return true;
+    }
+
+    void
+    write_file (std::string const& filename, std::string const& data)
+    {
+        std::ofstream out(filename.c_str(), std::ios::binary);
+        out << data;
+    }
+
+    void
+    test_obj_round_trip (void)
+    {
+        std::string const filename = "test_mesh_io_text.obj";
+        core::TriangleMesh::Ptr mesh = create_grid(320, 320);
+        core::geom::save_obj_mesh(mesh, filename);
+        core::TriangleMesh::Ptr loaded = core::geom::load_obj_mesh(filename);
+        std::remove(filename.c_str());
+        TEST_CHECK(loaded->get_vertices().size() == mesh->get_vertices().size());
+        TEST_CHECK(equal_triangles(mesh, loaded));
+    }
+
+    /* Face vertices with the same indices share one mesh vertex. */
+    void
+    test_obj_attributes (void)
+    {
+        std::string const filename = "test_mesh_io_text_attribs.obj";
+        write_file(filename,
+            "# comment\r\n"
+            "v 0 0 0\r\n"
+            "v  1 0 0 \r\n"
+            "\tv 0 2 0 2\r\n"
+            "vt 0 0\n"
+            "vt 1 0.25\n"
+            "vn 0 0 1\n"
+            "s off\n"
+            "f 1/1/1 2/2/1 3/1/1\n"
+            "f 3/1/1 2/2/1 1/1/1\n");
+        core::TriangleMesh::Ptr mesh = core::geom::load_obj_mesh(filename);
+        std::remove(filename.c_str());
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        TEST_CHECK(verts.size() == 3);
+        TEST_CHECK(faces.size() == 6);
+        TEST_CHECK(mesh->get_vertex_texcoords().size() == 3);
+        TEST_CHECK(mesh->get_vertex_normals().size() == 3);
+        if (verts.size() != 3 || faces.size() != 6
+            || mesh->get_vertex_texcoords().size() != 3)
+            return;
+        TEST_CHECK(verts[1] == math::Vec3f(1.0f, 0.0f, 0.0f));
+        TEST_CHECK(verts[2] == math::Vec3f(0.0f, 1.0f, 0.0f));
+        TEST_CHECK(faces[3] == 2 && faces[4] == 1 && faces[5] == 0);
+        TEST_CHECK(mesh->get_vertex_texcoords()[1]
+            == math::Vec2f(1.0f, 0.75f));
+    }
+
+    /* Faces may only refer to the geometry before them. */
+    void
+    test_obj_invalid_index (void)
+    {
+        std::string const filename = "test_mesh_io_text_invalid.obj";
+        write_file(filename, "v 0 0 0\nv 1 0 0\nf 1 2 3\nv 0 1 0\n");
+        bool thrown = false;
+        try
+        {
+            core::geom::load_obj_mesh(filename);
+        }
+        catch (std::exception&)
+        {
+            thrown = true;
+        }
+        std::remove(filename.c_str());
+        TEST_CHECK(thrown);
+    }
+
+    void
+    test_off_round_trip (void)
+    {
+        std::string const filename = "test_mesh_io_text.off";
+        core::TriangleMesh::Ptr mesh = create_grid(320, 320);
+        core::geom::save_off_mesh(mesh, filename);
+        core::TriangleMesh::Ptr loaded = core::geom::load_off_mesh(filename);
+        std::remove(filename.c_str());
+        TEST_CHECK(loaded->get_vertices() == mesh->get_vertices());
+        TEST_CHECK(loaded->get_faces() == mesh->get_faces());
+    }
+
+    /* Quads are split, other polygons and invalid faces are skipped. */
+    void
+    test_off_polygons (void)
+    {
+        std::string const filename = "test_mesh_io_text_polygons.off";
+        write_file(filename,
+            "NOFF\n5 4 0\n"
+            "0 0 0  0 0 1\n1 0 0  0 0 1\n1 1 0  0 0 1\n"
+            "0 1 0  0 0 1\n2 2 0  0 0 1\n"
+            "4 0 1 2 3\n5 0 1 2 3 4\n3 0 1 5\n3 1 4 2\n");
+        core::TriangleMesh::Ptr mesh = core::geom::load_off_mesh(filename);
+        std::remove(filename.c_str());
+        unsigned int const expected[] = { 0, 1, 2, 2, 3, 0, 1, 4, 2 };
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        TEST_CHECK(mesh->get_vertex_normals().size() == 5);
+        TEST_CHECK(faces == core::TriangleMesh::FaceList(expected,
+            expected + 9));
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_obj_round_trip();
+    test_obj_attributes();
+    test_obj_invalid_index();
+    test_off_round_trip();
+    test_off_polygons();
+    return TEST_RESULT;
+}
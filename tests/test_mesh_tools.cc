@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "math/matrix.h"
+#include "core/mesh.h"
+#include "core/mesh_tools.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    /* Appends a grid of (w x h) vertices at the given z. */
+    void
+    append_grid (core::TriangleMesh::Ptr mesh, int w, int h, float z)
+    {
+        core::TriangleMesh::VertexList& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList& faces = mesh->get_faces();
+        unsigned int const base = verts.size();
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                verts.push_back(math::Vec3f(x, y, z));
+        for (int y = 0; y + 1 < h; ++y)
+            for (int x = 0; x + 1 < w; ++x)
+            {
+                unsigned int const i = base + y * w + x;
+                unsigned int const quad[6]
+                    = { i, i + 1, i + w, i + 1, i + w + 1, i + w };
+                faces.insert(faces.end(), quad, quad + 6);
+            }
+    }
+
+    /* Permutes the vertex IDs and the face order. */
+    void
+    shuffle_mesh (core::TriangleMesh::Ptr mesh, unsigned int seed)
+    {
+        std::mt19937 rng(seed);
+        core::TriangleMesh::VertexList& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList& faces = mesh->get_faces();
+        std::vector<unsigned int> ids(verts.size());
+        for (std::size_t i = 0; i < ids.size(); ++i)
+            ids[i] = i;
+        std::shuffle(ids.begin(), ids.end(), rng);
+        core::TriangleMesh::VertexList new_verts(verts.size());
+        for (std::size_t i = 0; i < verts.size(); ++i)
+            new_verts[ids[i]] = verts[i];
+        verts.swap(new_verts);
+
+        std::vector<std::size_t> order(faces.size() / 3);
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+        core::TriangleMesh::FaceList new_faces;
+        for (std::size_t i = 0; i < order.size(); ++i)
+            for (int j = 0; j < 3; ++j)
+                new_faces.push_back(ids[faces[order[i] * 3 + j]]);
+        faces.swap(new_faces);
+    }
+
+    /* Returns the sorted corner positions of all faces. */
+    std::vector<math::Vec3f>
+    face_corners (core::TriangleMesh::ConstPtr mesh)
+    {
+        std::vector<math::Vec3f> corners;
+        for (std::size_t i = 0; i < mesh->get_faces().size(); ++i)
+            corners.push_back(mesh->get_vertices()[mesh->get_faces()[i]]);
+        std::sort(corners.begin(), corners.end(),
+            [] (math::Vec3f const& a, math::Vec3f const& b)
+            { return std::lexicographical_compare(a.begin(), a.end(),
+            b.begin(), b.end()); });
+        return corners;
+    }
+
+    /* Appends a single triangle at the given z. */
+    void
+    append_triangle (core::TriangleMesh::Ptr mesh, float z)
+    {
+        unsigned int const base = mesh->get_vertices().size();
+        for (int i = 0; i < 3; ++i)
+        {
+            mesh->get_vertices().push_back(math::Vec3f(i, i % 2, z));
+            mesh->get_faces().push_back(base + i);
+        }
+    }
+
+    /*
+     * Components with 1, 3, 4, 12, 100 and 1 vertices, each at its own z.
+     * Thresholds at or above the size of a component delete it.
+     */
+    void
+    test_components (void)
+    {
+        int const sizes[][2] = { { 1, 1 }, { 3, 1 }, { 2, 2 }, { 4, 3 },
+            { 10, 10 }, { 1, 1 } };
+        for (int threshold = 0; threshold <= 101; ++threshold)
+        {
+            core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+            core::TriangleMesh::Ptr expected = core::TriangleMesh::create();
+            for (int i = 0; i < 6; ++i)
+            {
+                int const w = sizes[i][0];
+                int const h = sizes[i][1];
+                bool const keep = w * h > threshold;
+                if (w == 3 && h == 1)
+                {
+                    append_triangle(mesh, i);
+                    if (keep)
+                        append_triangle(expected, i);
+                    continue;
+                }
+                append_grid(mesh, w, h, i);
+                if (keep)
+                    append_grid(expected, w, h, i);
+            }
+            shuffle_mesh(mesh, threshold);
+
+            core::geom::mesh_components(mesh, threshold);
+            TEST_CHECK(mesh->get_vertices().size()
+                == expected->get_vertices().size());
+            TEST_CHECK(face_corners(mesh) == face_corners(expected));
+        }
+    }
+
+    /* Checks indices, degenerate faces and edges with more than two faces. */
+    bool
+    is_valid_manifold (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        std::vector<std::pair<unsigned int, unsigned int> > edges;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+            for (int j = 0; j < 3; ++j)
+            {
+                unsigned int const v1 = faces[i + j];
+                unsigned int const v2 = faces[i + (j + 1) % 3];
+                if (v1 >= mesh->get_vertices().size() || v1 == v2)
+                    return false;
+                edges.push_back(std::make_pair(v1, v2));
+            }
+        /* Consistently oriented faces use each directed edge once. */
+        std::sort(edges.begin(), edges.end());
+        return std::adjacent_find(edges.begin(), edges.end()) == edges.end();
+    }
+
+    /* Decimation of a flat and a bumpy height field. */
+    void
+    test_decimate (bool flat)
+    {
+        int const w = 60;
+        int const h = 40;
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        append_grid(mesh, w, h, 0.0f);
+        core::TriangleMesh::VertexList& verts = mesh->get_vertices();
+        for (std::size_t i = 0; i < verts.size(); ++i)
+        {
+            if (!flat)
+                verts[i][2] = std::sin(verts[i][0] * 0.2f)
+                    * std::cos(verts[i][1] * 0.3f);
+            mesh->get_vertex_colors().push_back(math::Vec4f(i, 0, 0, 1));
+        }
+        std::size_t const num_vertices = verts.size();
+        std::size_t const target = flat ? 200 : 1500;
+
+        std::size_t const collapses = core::geom::mesh_decimate(mesh, target);
+        TEST_CHECK(mesh->get_faces().size() / 3 <= target);
+        TEST_CHECK(mesh->get_vertices().size() + collapses == num_vertices);
+        TEST_CHECK(mesh->get_vertex_colors().size()
+            == mesh->get_vertices().size());
+        TEST_CHECK(is_valid_manifold(mesh));
+
+        /* No face is flipped, and the boundary stays in place. */
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        bool flipped = false;
+        double area = 0.0;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            math::Vec3f const n = (verts[faces[i + 1]] - verts[faces[i]])
+                .cross(verts[faces[i + 2]] - verts[faces[i]]);
+            flipped = flipped || !(n[2] > 0.0f);
+            area += 0.5 * n[2];
+        }
+        TEST_CHECK(!flipped);
+        TEST_CHECK(std::abs(area - (w - 1) * (h - 1)) < 1e-2);
+
+        /*
+         * Remaining vertices keep their colors and stay within the grid,
+         * vertices of the flat grid stay on the plane. The boundary
+         * quadrics allow small deviations on curved boundaries.
+         */
+        float const eps = flat ? 1e-4f : 1e-2f;
+        std::vector<std::size_t> ids;
+        bool attributes_kept = true;
+        for (std::size_t i = 0; i < verts.size(); ++i)
+        {
+            ids.push_back(mesh->get_vertex_colors()[i][0]);
+            attributes_kept = attributes_kept && ids.back() < num_vertices
+                && verts[i][0] >= -eps && verts[i][0] <= w - 1 + eps
+                && verts[i][1] >= -eps && verts[i][1] <= h - 1 + eps
+                && (!flat || std::abs(verts[i][2]) < 1e-4f);
+        }
+        std::sort(ids.begin(), ids.end());
+        attributes_kept = attributes_kept
+            && std::adjacent_find(ids.begin(), ids.end()) == ids.end();
+        TEST_CHECK(attributes_kept);
+    }
+
+    /* Returns the oriented triangles as rotated corner position triples. */
+    std::vector<std::vector<float> >
+    oriented_triangles (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        std::vector<std::vector<float> > triangles;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            unsigned int f[3] = { faces[i], faces[i + 1], faces[i + 2] };
+            std::vector<float> tri;
+            std::rotate(f, std::min_element(f, f + 3, [&mesh]
+                (unsigned int a, unsigned int b)
+                { math::Vec3f const& pa = mesh->get_vertices()[a];
+                math::Vec3f const& pb = mesh->get_vertices()[b];
+                return std::lexicographical_compare(pa.begin(), pa.end(),
+                pb.begin(), pb.end()); }), f + 3);
+            for (int j = 0; j < 3; ++j)
+                tri.insert(tri.end(), mesh->get_vertices()[f[j]].begin(),
+                    mesh->get_vertices()[f[j]].end());
+            triangles.push_back(tri);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    /* Returns the mean index distance of the vertices of the faces. */
+    double
+    mean_index_distance (core::TriangleMesh::ConstPtr mesh)
+    {
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        double sum = 0.0;
+        for (std::size_t i = 0; i < faces.size(); ++i)
+        {
+            unsigned int const next = faces[i % 3 == 2 ? i - 2 : i + 1];
+            sum += std::abs(static_cast<double>(faces[i]) - next);
+        }
+        return sum / faces.size();
+    }
+
+    /* Attributes derived from the positions must follow the vertices. */
+    void
+    test_reorder (void)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        append_grid(mesh, 70, 50, 0.0f);
+        append_grid(mesh, 20, 30, 3.0f);
+        shuffle_mesh(mesh, 5);
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        core::TriangleMesh::FaceList const& faces = mesh->get_faces();
+        for (std::size_t i = 0; i < verts.size(); ++i)
+        {
+            mesh->get_vertex_colors().push_back(math::Vec4f(verts[i], 1.0f));
+            mesh->get_vertex_confidences().push_back(verts[i][0]);
+            mesh->get_vertex_values().push_back(verts[i][1]);
+            mesh->get_vertex_texcoords().push_back(
+                math::Vec2f(verts[i][0], verts[i][2]));
+        }
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+            mesh->get_face_colors().push_back(math::Vec4f(verts[faces[i]]
+                + verts[faces[i + 1]] + verts[faces[i + 2]], 1.0f));
+        mesh->recalc_normals();
+        std::vector<std::vector<float> > const expected
+            = oriented_triangles(mesh);
+        double const shuffled_distance = mean_index_distance(mesh);
+
+        core::geom::mesh_reorder(mesh);
+        TEST_CHECK(oriented_triangles(mesh) == expected);
+        TEST_CHECK(mean_index_distance(mesh) < 0.1 * shuffled_distance);
+
+        bool vertex_attributes_match = true;
+        for (std::size_t i = 0; i < verts.size(); ++i)
+            vertex_attributes_match = vertex_attributes_match
+                && math::Vec3f(mesh->get_vertex_colors()[i].begin())
+                == verts[i]
+                && mesh->get_vertex_confidences()[i] == verts[i][0]
+                && mesh->get_vertex_values()[i] == verts[i][1]
+                && mesh->get_vertex_texcoords()[i]
+                == math::Vec2f(verts[i][0], verts[i][2]);
+        TEST_CHECK(vertex_attributes_match);
+
+        /* Faces are sorted by the smallest vertex and keep attributes. */
+        core::TriangleMesh::NormalList const vnormals
+            = mesh->get_vertex_normals();
+        core::TriangleMesh::NormalList const fnormals
+            = mesh->get_face_normals();
+        bool faces_sorted = true;
+        bool face_attributes_match = true;
+        unsigned int last_key = 0;
+        for (std::size_t i = 0; i < faces.size(); i += 3)
+        {
+            unsigned int const key = std::min(faces[i],
+                std::min(faces[i + 1], faces[i + 2]));
+            faces_sorted = faces_sorted && key >= last_key;
+            last_key = key;
+            face_attributes_match = face_attributes_match
+                && math::Vec3f(mesh->get_face_colors()[i / 3].begin())
+                == verts[faces[i]] + verts[faces[i + 1]] + verts[faces[i + 2]];
+        }
+        TEST_CHECK(faces_sorted);
+        TEST_CHECK(face_attributes_match);
+        mesh->recalc_normals();
+        TEST_CHECK(fnormals == mesh->get_face_normals());
+        bool normals_match = true;
+        for (std::size_t i = 0; i < vnormals.size(); ++i)
+            normals_match = normals_match
+                && vnormals[i].is_similar(mesh->get_vertex_normals()[i], 1e-6f);
+        TEST_CHECK(normals_match);
+    }
+
+    /* A grid with all vertex attributes and face colors. */
+    core::TriangleMesh::Ptr
+    create_attributed_grid (int w, int h, float z)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        append_grid(mesh, w, h, z);
+        core::TriangleMesh::VertexList const& verts = mesh->get_vertices();
+        for (std::size_t i = 0; i < verts.size(); ++i)
+        {
+            mesh->get_vertex_colors().push_back(math::Vec4f(verts[i], 1.0f));
+            mesh->get_vertex_confidences().push_back(verts[i][0]);
+            mesh->get_vertex_values().push_back(verts[i][1]);
+            mesh->get_vertex_texcoords().push_back(
+                math::Vec2f(verts[i][0], verts[i][1]));
+        }
+        for (std::size_t i = 0; i < mesh->get_faces().size(); i += 3)
+            mesh->get_face_colors().push_back(math::Vec4f(i, z, 0.0f, 1.0f));
+        mesh->recalc_normals();
+        return mesh;
+    }
+
+    void
+    test_transform (void)
+    {
+        core::TriangleMesh::Ptr mesh = create_attributed_grid(130, 70, 0.5f);
+        core::TriangleMesh::ConstPtr original = mesh->duplicate();
+        math::Matrix4f trans(0.0f);
+        trans(0, 1) = -1.0f;
+        trans(1, 0) = 1.0f;
+        trans(2, 2) = 2.0f;
+        trans(0, 3) = 3.0f;
+        trans(1, 3) = -4.0f;
+        trans(3, 3) = 1.0f;
+        core::geom::mesh_transform(mesh, trans);
+
+        bool points_match = true;
+        for (std::size_t i = 0; i < mesh->get_vertices().size(); ++i)
+            points_match = points_match && mesh->get_vertices()[i]
+                == trans.mult(original->get_vertices()[i], 1.0f)
+                && mesh->get_vertex_normals()[i]
+                == trans.mult(original->get_vertex_normals()[i], 0.0f);
+        for (std::size_t i = 0; i < mesh->get_face_normals().size(); ++i)
+            points_match = points_match && mesh->get_face_normals()[i]
+                == trans.mult(original->get_face_normals()[i], 0.0f);
+        TEST_CHECK(points_match);
+        TEST_CHECK(mesh->get_faces() == original->get_faces());
+
+        /* The rotation version rotates points and normals alike. */
+        math::Matrix3f rot(0.0f);
+        rot(0, 2) = 1.0f;
+        rot(1, 1) = 1.0f;
+        rot(2, 0) = -1.0f;
+        mesh = original->duplicate();
+        core::geom::mesh_transform(mesh, rot);
+        bool rotations_match = true;
+        for (std::size_t i = 0; i < mesh->get_vertices().size(); ++i)
+            rotations_match = rotations_match && mesh->get_vertices()[i]
+                == rot * original->get_vertices()[i]
+                && mesh->get_vertex_normals()[i]
+                == rot * original->get_vertex_normals()[i];
+        for (std::size_t i = 0; i < mesh->get_face_normals().size(); ++i)
+            rotations_match = rotations_match && mesh->get_face_normals()[i]
+                == rot * original->get_face_normals()[i];
+        TEST_CHECK(rotations_match);
+    }
+
+    /* Returns the list 'b' followed by the list 'a'. */
+    template <typename T>
+    std::vector<T>
+    concat (std::vector<T> const& a, std::vector<T> const& b)
+    {
+        std::vector<T> ret(b);
+        ret.insert(ret.end(), a.begin(), a.end());
+        return ret;
+    }
+
+    /* All attributes of the first mesh are appended to the second. */
+    void
+    test_merge (void)
+    {
+        core::TriangleMesh::ConstPtr mesh1
+            = create_attributed_grid(40, 30, 1.0f);
+        core::TriangleMesh::ConstPtr mesh2
+            = create_attributed_grid(25, 50, 2.0f);
+        core::TriangleMesh::Ptr merged = mesh2->duplicate();
+        core::geom::mesh_merge(mesh1, merged);
+
+        std::size_t const num_verts2 = mesh2->get_vertices().size();
+        std::size_t const num_faces2 = mesh2->get_faces().size();
+        TEST_CHECK(merged->get_vertices().size()
+            == num_verts2 + mesh1->get_vertices().size());
+        TEST_CHECK(merged->get_faces().size()
+            == num_faces2 + mesh1->get_faces().size());
+
+        TEST_CHECK(merged->get_vertices()
+            == concat(mesh1->get_vertices(), mesh2->get_vertices()));
+        TEST_CHECK(merged->get_vertex_colors() == concat(
+            mesh1->get_vertex_colors(), mesh2->get_vertex_colors()));
+        TEST_CHECK(merged->get_vertex_confidences()
+            == concat(mesh1->get_vertex_confidences(),
+            mesh2->get_vertex_confidences()));
+        TEST_CHECK(merged->get_vertex_values() == concat(
+            mesh1->get_vertex_values(), mesh2->get_vertex_values()));
+        TEST_CHECK(merged->get_vertex_texcoords() == concat(
+            mesh1->get_vertex_texcoords(), mesh2->get_vertex_texcoords()));
+        TEST_CHECK(merged->get_vertex_normals() == concat(
+            mesh1->get_vertex_normals(), mesh2->get_vertex_normals()));
+        TEST_CHECK(merged->get_face_normals() == concat(
+            mesh1->get_face_normals(), mesh2->get_face_normals()));
+        TEST_CHECK(merged->get_face_colors() == concat(
+            mesh1->get_face_colors(), mesh2->get_face_colors()));
+
+        bool faces_match = std::equal(mesh2->get_faces().begin(),
+            mesh2->get_faces().end(), merged->get_faces().begin());
+        for (std::size_t i = 0; i < mesh1->get_faces().size(); ++i)
+            faces_match = faces_match && merged->get_faces()[num_faces2 + i]
+                == mesh1->get_faces()[i] + num_verts2;
+        TEST_CHECK(faces_match);
+    }
+
+    void
+    test_delete_unreferenced (void)
+    {
+        core::TriangleMesh::Ptr mesh = core::TriangleMesh::create();
+        mesh->get_vertices().push_back(math::Vec3f(-1.0f));
+        append_grid(mesh, 20, 10, 0.0f);
+        mesh->get_vertices().push_back(math::Vec3f(-2.0f));
+        append_triangle(mesh, 1.0f);
+        mesh->get_vertices().push_back(math::Vec3f(-3.0f));
+        shuffle_mesh(mesh, 4);
+        std::vector<math::Vec3f> const corners = face_corners(mesh);
+
+        TEST_CHECK(core::geom::mesh_delete_unreferenced(mesh) == 3);
+        TEST_CHECK(mesh->get_vertices().size() == 20 * 10 + 3);
+        TEST_CHECK(face_corners(mesh) == corners);
+        TEST_CHECK(core::geom::mesh_delete_unreferenced(mesh) == 0);
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_components();
+    test_decimate(true);
+    test_decimate(false);
+    test_reorder();
+    test_transform();
+    test_merge();
+    test_delete_unreferenced();
+    return TEST_RESULT;
+}
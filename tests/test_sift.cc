@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "core/image.h"
+#include "features/sift.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    /* Random blobs of varying size and contrast on a smooth gradient. */
+    core::FloatImage::Ptr
+    create_image (int width, int height)
+    {
+        core::FloatImage::Ptr image = core::FloatImage::create(width, height, 1);
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                image->at(x, y, 0) = 0.3f + 0.2f * x / width;
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        int const num_blobs = width * height / 400;
+        for (int i = 0; i < num_blobs; ++i)
+        {
+            float const cx = unit(rng) * width;
+            float const cy = unit(rng) * height;
+            float const sigma = 1.0f + 12.0f * unit(rng) * unit(rng);
+            float const value = unit(rng) - 0.5f;
+            int const radius = static_cast<int>(3.0f * sigma) + 1;
+            for (int y = std::max(0, static_cast<int>(cy) - radius);
+                y < std::min(height, static_cast<int>(cy) + radius); ++y)
+                for (int x = std::max(0, static_cast<int>(cx) - radius);
+                    x < std::min(width, static_cast<int>(cx) + radius); ++x)
+                {
+                    float const dd = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                    image->at(x, y, 0) += value
+                        * std::exp(-dd / (2.0f * sigma * sigma));
+                }
+        }
+        return image;
+    }
+
+    template <typename DESCRIPTOR>
+    bool
+    descriptor_less (DESCRIPTOR const& a, DESCRIPTOR const& b)
+    {
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.y != b.y)
+            return a.y < b.y;
+        if (a.scale != b.scale)
+            return a.scale < b.scale;
+        return a.orientation < b.orientation;
+    }
+
+    /*
+     * Descriptors must match up to the order. The tiles are blurred in
+     * a different memory layout, the results thus differ slightly.
+     */
+    template <typename VECTOR>
+    bool
+    same_descriptors (VECTOR a, VECTOR b, float data_eps)
+    {
+        float const eps = 1e-3f;
+        if (a.size() != b.size())
+            return false;
+        std::sort(a.begin(), a.end(),
+            descriptor_less<typename VECTOR::value_type>);
+        std::sort(b.begin(), b.end(),
+            descriptor_less<typename VECTOR::value_type>);
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (std::abs(a[i].x - b[i].x) > eps
+                || std::abs(a[i].y - b[i].y) > eps
+                || std::abs(a[i].scale - b[i].scale) > eps
+                || std::abs(a[i].orientation - b[i].orientation) > eps)
+                return false;
+            for (int j = 0; j < 128; ++j)
+                if (std::abs(static_cast<float>(a[i].data[j])
+                    - static_cast<float>(b[i].data[j])) > data_eps)
+                    return false;
+        }
+        return true;
+    }
+
+    /* Descriptors must follow the keypoints, which are sorted by octave. */
+    template <typename VECTOR>
+    bool
+    ordered_by_keypoints (features::Sift::Keypoints const& keypoints,
+        VECTOR const& descriptors)
+    {
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < descriptors.size(); ++i)
+        {
+            while (k < keypoints.size())
+            {
+                features::Sift::Keypoint const& kp = keypoints[k];
+                float const scale_factor = std::pow(2.0f, kp.octave);
+                if (std::abs(scale_factor * (kp.x + 0.5f) - 0.5f
+                    - descriptors[i].x) < 1e-3f
+                    && std::abs(scale_factor * (kp.y + 0.5f) - 0.5f
+                    - descriptors[i].y) < 1e-3f)
+                    break;
+                k += 1;
+            }
+            if (k == keypoints.size())
+                return false;
+        }
+        for (std::size_t i = 1; i < keypoints.size(); ++i)
+            if (keypoints[i].octave < keypoints[i - 1].octave)
+                return false;
+        return true;
+    }
+
+    void
+    test_tiled (features::Sift::Options options, int budget)
+    {
+        core::FloatImage::Ptr image = create_image(400, 300);
+        features::Sift full(options);
+        full.set_float_image(image);
+        full.process();
+
+        options.memory_budget = budget;
+        features::Sift tiled(options);
+        tiled.set_float_image(image);
+        tiled.process();
+
+        TEST_CHECK(tiled.get_keypoints().size()
+            == full.get_keypoints().size());
+        if (options.max_features > 0 && !full.get_keypoints().empty())
+            TEST_CHECK(tiled.get_keypoints().size()
+                == static_cast<std::size_t>(options.max_features));
+        TEST_CHECK(same_descriptors(full.get_descriptors(),
+            tiled.get_descriptors(), 1e-3f));
+        TEST_CHECK(same_descriptors(full.get_compact_descriptors(),
+            tiled.get_compact_descriptors(), 1.0f));
+        TEST_CHECK(ordered_by_keypoints(tiled.get_keypoints(),
+            tiled.get_descriptors()));
+        TEST_CHECK(ordered_by_keypoints(tiled.get_keypoints(),
+            tiled.get_compact_descriptors()));
+
+        /* Processing again recycles the pyramid storage. */
+        tiled.process();
+        TEST_CHECK(same_descriptors(full.get_descriptors(),
+            tiled.get_descriptors(), 1e-3f));
+    }
+
+    /*
+     * The keypoint localization is an exercise of the course. Until it is
+     * implemented, no keypoints are retained and only the tiled pyramid
+     * processing is run.
+     */
+    bool
+    has_keypoints (void)
+    {
+        features::Sift sift((features::Sift::Options()));
+        sift.set_float_image(create_image(400, 300));
+        sift.process();
+        return sift.get_keypoints().size() > 50;
+    }
+
+    void
+    test_budget_too_small (void)
+    {
+        features::Sift::Options options;
+        options.memory_budget = 1;
+        features::Sift sift(options);
+        sift.set_float_image(create_image(400, 300));
+        bool throws = false;
+        try
+        {
+            sift.process();
+        }
+        catch (std::invalid_argument const&)
+        {
+            throws = true;
+        }
+        TEST_CHECK(throws);
+    }
+}  // namespace
+
+int
+main (void)
+{
+    if (!has_keypoints())
+        std::cout << "No keypoints retained, the features of the tiled "
+            << "processing are compared trivially." << std::endl;
+
+    features::Sift::Options options;
+    test_tiled(options, 5);
+
+    /* The keypoint budget is applied to the whole image. */
+    options.max_features = 100;
+    test_tiled(options, 5);
+    options.max_features_grid = 3;
+    test_tiled(options, 5);
+
+    options.compact_descriptors = true;
+    test_tiled(options, 4);
+
+    /* The upsampled octave in tiles. */
+    features::Sift::Options upsampled;
+    upsampled.min_octave = -1;
+    test_tiled(upsampled, 16);
+
+    /* All octaves in tiles. */
+    features::Sift::Options single_octave;
+    single_octave.max_octave = 0;
+    test_tiled(single_octave, 3);
+
+    test_budget_too_small();
+    return TEST_RESULT;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "util/strings.h"
+#include "tests/test_check.h"
+
+namespace
+{
+    /* Numbers for the fast and the slow path, and overflow and underflow. */
+    std::vector<std::string>
+    create_numbers (void)
+    {
+        char const* special[] = { "0", "-0.0", "1.5", "0.1", "-17.25e3",
+            "1.2345678901234567", "3.14159265358979323846", "16777217",
+            "123456789012345678901234", "7.0e-10", "0.000000000001234",
+            "3.4028235e38", "1.17549435e-38", "2.2250738585072014e-308",
+            "4.9e-324", "1e-400", "1e400", "-1e400", "1e39", "-1e-50" };
+        std::vector<std::string> numbers(special, special
+            + sizeof(special) / sizeof(special[0]));
+
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<double> mantissa(-10.0, 10.0);
+        std::uniform_int_distribution<int> exponent(-40, 40);
+        for (int i = 0; i < 2000; ++i)
+        {
+            char buffer[64];
+            double const value = mantissa(rng)
+                * std::pow(10.0, exponent(rng));
+            std::snprintf(buffer, sizeof(buffer),
+                i % 2 ? "%.17g" : "%.9g", value);
+            numbers.push_back(buffer);
+        }
+        return numbers;
+    }
+
+    bool
+    same_value (double a, double b)
+    {
+        return a == b && std::signbit(a) == std::signbit(b);
+    }
+
+    /*
+     * Checks the parsers against the C library in the classic locale.
+     * The expected values must be computed in the classic locale.
+     */
+    void
+    check_numbers (std::vector<std::string> const& numbers,
+        std::vector<double> const& doubles, std::vector<float> const& floats)
+    {
+        bool doubles_match = true;
+        bool floats_match = true;
+        bool converts_match = true;
+        for (std::size_t i = 0; i < numbers.size(); ++i)
+        {
+            char const* begin = numbers[i].c_str();
+            char const* end = begin + numbers[i].size();
+            double d = 0.0;
+            float f = 0.0f;
+            float pf = 0.0f;
+            doubles_match = doubles_match
+                && util::string::parse_number(begin, end, &d) == end
+                && same_value(d, doubles[i]);
+            floats_match = floats_match
+                && util::string::parse_number(begin, end, &f) == end
+                && util::string::parse_float(begin, &pf) == end
+                && same_value(f, floats[i]) && same_value(pf, floats[i]);
+            converts_match = converts_match && same_value(
+                util::string::convert<double>(numbers[i]), doubles[i]);
+        }
+        TEST_CHECK(doubles_match);
+        TEST_CHECK(floats_match);
+        TEST_CHECK(converts_match);
+    }
+
+    /* Selects a locale with a comma as decimal point, if installed. */
+    bool
+    set_comma_locale (void)
+    {
+        char const* names[] = { "de_DE.UTF-8", "de_DE.utf8", "de_DE",
+            "fr_FR.UTF-8", "fr_FR.utf8", "fr_FR" };
+        for (std::size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+            if (std::setlocale(LC_NUMERIC, names[i]) != nullptr
+                && std::strcmp(std::localeconv()->decimal_point, ",") == 0)
+                return true;
+        std::setlocale(LC_NUMERIC, "C");
+        return false;
+    }
+
+    void
+    test_parse_numbers (void)
+    {
+        std::vector<std::string> const numbers = create_numbers();
+        std::vector<double> doubles;
+        std::vector<float> floats;
+        for (std::size_t i = 0; i < numbers.size(); ++i)
+        {
+            doubles.push_back(std::strtod(numbers[i].c_str(), nullptr));
+            floats.push_back(std::strtof(numbers[i].c_str(), nullptr));
+        }
+        check_numbers(numbers, doubles, floats);
+
+        /* The slow path must not depend on the global locale. */
+        if (!set_comma_locale())
+        {
+            std::printf("No comma decimal locale, skipping locale test.\n");
+            return;
+        }
+        TEST_CHECK(std::strtod("1.5", nullptr) != 1.5);
+        check_numbers(numbers, doubles, floats);
+        std::setlocale(LC_NUMERIC, "C");
+    }
+
+    void
+    test_invalid_numbers (void)
+    {
+        char const* invalid[] = { "", "-", ".", "e5", "+.e1", "abc" };
+        bool all_rejected = true;
+        for (std::size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        {
+            char const* end = invalid[i] + std::strlen(invalid[i]);
+            double d;
+            float f;
+            all_rejected = all_rejected
+                && util::string::parse_number(invalid[i], end, &d) == nullptr
+                && util::string::parse_float(invalid[i], &f) == nullptr;
+        }
+        TEST_CHECK(all_rejected);
+
+        /* A dangling exponent is not part of the number. */
+        char const* str = "2.5e+";
+        double d = 0.0;
+        TEST_CHECK(util::string::parse_number(str, str + 5, &d) == str + 3);
+        TEST_CHECK(d == 2.5);
+    }
+}  // namespace
+
+int
+main (void)
+{
+    test_parse_numbers();
+    test_invalid_numbers();
+    return TEST_RESULT;
+}
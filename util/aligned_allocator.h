@@ -63,6 +63,10 @@ public:
     bool operator!= (AlignedAllocator<T_other, alignment_other> const&);
 };
 
+/** A vector with aligned memory, e.g. for SIMD loads. */
+template <typename T, size_t alignment = 16>
+using AlignedVector = std::vector<T, AlignedAllocator<T, alignment> >;
+
 /* ------------------------ Implementation ------------------------ */
 
 template <typename T, size_t alignment>
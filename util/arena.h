@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_ARENA_HEADER
+#define UTIL_ARENA_HEADER
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+
+#include "util/aligned_allocator.h"
+#include "util/defines.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/**
+ * Monotonic arena for short-lived scratch memory.
+ *
+ * Allocations bump a pointer in the current block and are never freed
+ * individually. The memory is recycled with reset(), which coalesces all
+ * blocks into one, or by rewinding to a marker, see ArenaScope. After a
+ * warm-up, a loop that resets the arena in every iteration runs without
+ * heap allocation. The blocks are allocated with AlignedAllocator on cache
+ * line boundaries. An arena must only be used by one thread at a time,
+ * get_thread_arena() returns an arena for each thread.
+ */
+class Arena
+{
+public:
+    /** A position in the arena to rewind to. */
+    struct Marker
+    {
+        std::size_t block_id;
+        std::size_t offset;
+    };
+
+public:
+    explicit Arena (std::size_t block_size = 64 * 1024);
+    ~Arena (void);
+    Arena (Arena const& other) = delete;
+    Arena& operator= (Arena const& other) = delete;
+
+    /** Returns the arena of the calling thread. */
+    static Arena& get_thread_arena (void);
+
+    /** Returns uninitialized memory with the given alignment. */
+    void* allocate (std::size_t size,
+        std::size_t alignment = alignof(std::max_align_t));
+
+    /** Returns the current position for rewind(). */
+    Marker get_marker (void) const;
+    /** Discards all allocations after the marker, keeping the memory. */
+    void rewind (Marker const& marker);
+
+    /** Discards all allocations and coalesces the memory into one block. */
+    void reset (void);
+    /** Discards all allocations and frees the memory. */
+    void release (void);
+
+    /** Returns the bytes allocated from the arena since the last reset. */
+    std::size_t get_used (void) const;
+    /** Returns the bytes of all blocks. */
+    std::size_t get_capacity (void) const;
+
+private:
+    struct Block
+    {
+        char* data;
+        std::size_t size;
+    };
+
+    typedef AlignedAllocator<char, 64> BlockAllocator;
+
+    void add_block (std::size_t size);
+
+private:
+    std::size_t block_size;
+    std::vector<Block> blocks;
+    std::size_t block_id;
+    std::size_t offset;
+};
+
+/* ---------------------------------------------------------------- */
+
+/** Rewinds the arena to the position at construction on destruction. */
+class ArenaScope
+{
+public:
+    explicit ArenaScope (Arena& arena = Arena::get_thread_arena());
+    ~ArenaScope (void);
+    ArenaScope (ArenaScope const& other) = delete;
+    ArenaScope& operator= (ArenaScope const& other) = delete;
+
+private:
+    Arena& arena;
+    Arena::Marker marker;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Implements the STL allocator interface with memory of an arena. The
+ * memory is only returned with the arena, so containers should be
+ * reserved to their final size, and they must be destroyed before the
+ * arena is reset or rewound to before their allocation.
+ */
+template <typename T>
+struct ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef T const* const_pointer;
+    typedef T& reference;
+    typedef T const& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+public:
+    /** Allocates from the given arena, the thread arena by default. */
+    ArenaAllocator (void);
+    explicit ArenaAllocator (Arena& arena);
+
+    template <class U>
+    ArenaAllocator (ArenaAllocator<U> const& other);
+
+    pointer allocate (size_type n);
+    void deallocate (pointer p, size_type n);
+    size_type max_size (void) const;
+
+    template <class U>
+    bool operator== (ArenaAllocator<U> const& other) const;
+    template <class U>
+    bool operator!= (ArenaAllocator<U> const& other) const;
+
+    Arena* arena;
+};
+
+/** A vector with the memory of an arena. */
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+Arena::Arena (std::size_t block_size)
+    : block_size(std::max<std::size_t>(block_size, 64))
+    , block_id(0)
+    , offset(0)
+{
+}
+
+inline
+Arena::~Arena (void)
+{
+    this->release();
+}
+
+inline Arena&
+Arena::get_thread_arena (void)
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+inline void*
+Arena::allocate (std::size_t size, std::size_t alignment)
+{
+    /* Use the next block with enough space, or add a new one. */
+    while (this->block_id < this->blocks.size())
+    {
+        Block const& block = this->blocks[this->block_id];
+        std::uintptr_t const base
+            = reinterpret_cast<std::uintptr_t>(block.data);
+        std::size_t const start = ((base + this->offset + alignment - 1)
+            / alignment) * alignment - base;
+        if (start + size <= block.size)
+        {
+            this->offset = start + size;
+            return block.data + start;
+        }
+        this->block_id += 1;
+        this->offset = 0;
+    }
+
+    this->add_block(size + alignment);
+    return this->allocate(size, alignment);
+}
+
+inline Arena::Marker
+Arena::get_marker (void) const
+{
+    Marker marker;
+    marker.block_id = this->block_id;
+    marker.offset = this->offset;
+    return marker;
+}
+
+inline void
+Arena::rewind (Marker const& marker)
+{
+    this->block_id = marker.block_id;
+    this->offset = marker.offset;
+}
+
+inline void
+Arena::reset (void)
+{
+    if (this->blocks.size() > 1)
+    {
+        std::size_t const capacity = this->get_capacity();
+        this->release();
+        this->add_block(capacity);
+    }
+    this->block_id = 0;
+    this->offset = 0;
+}
+
+inline void
+Arena::release (void)
+{
+    BlockAllocator allocator;
+    for (std::size_t i = 0; i < this->blocks.size(); ++i)
+        allocator.deallocate(this->blocks[i].data, this->blocks[i].size);
+    this->blocks.clear();
+    this->block_id = 0;
+    this->offset = 0;
+}
+
+inline std::size_t
+Arena::get_used (void) const
+{
+    std::size_t used = this->offset;
+    for (std::size_t i = 0; i < this->block_id; ++i)
+        used += this->blocks[i].size;
+    return used;
+}
+
+inline std::size_t
+Arena::get_capacity (void) const
+{
+    std::size_t capacity = 0;
+    for (std::size_t i = 0; i < this->blocks.size(); ++i)
+        capacity += this->blocks[i].size;
+    return capacity;
+}
+
+inline void
+Arena::add_block (std::size_t size)
+{
+    /* Blocks grow geometrically, which bounds the amount of blocks. */
+    Block block;
+    block.size = std::max(size, std::max(this->block_size,
+        this->get_capacity()));
+    block.data = BlockAllocator().allocate(block.size);
+    this->blocks.push_back(block);
+}
+
+/* ---------------------------------------------------------------- */
+
+inline
+ArenaScope::ArenaScope (Arena& arena)
+    : arena(arena)
+    , marker(arena.get_marker())
+{
+}
+
+inline
+ArenaScope::~ArenaScope (void)
+{
+    this->arena.rewind(this->marker);
+}
+
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+inline
+ArenaAllocator<T>::ArenaAllocator (void)
+    : arena(&Arena::get_thread_arena())
+{
+}
+
+template <typename T>
+inline
+ArenaAllocator<T>::ArenaAllocator (Arena& arena)
+    : arena(&arena)
+{
+}
+
+template <typename T>
+template <class U>
+inline
+ArenaAllocator<T>::ArenaAllocator (ArenaAllocator<U> const& other)
+    : arena(other.arena)
+{
+}
+
+template <typename T>
+inline typename ArenaAllocator<T>::pointer
+ArenaAllocator<T>::allocate (size_type n)
+{
+    if (n > this->max_size())
+        throw std::bad_alloc();
+    return static_cast<pointer>(this->arena->allocate(n * sizeof(T),
+        alignof(T)));
+}
+
+template <typename T>
+inline void
+ArenaAllocator<T>::deallocate (pointer /*p*/, size_type /*n*/)
+{
+}
+
+template <typename T>
+inline typename ArenaAllocator<T>::size_type
+ArenaAllocator<T>::max_size (void) const
+{
+    return std::numeric_limits<std::size_t>::max() / sizeof(T);
+}
+
+template <typename T>
+template <class U>
+inline bool
+ArenaAllocator<T>::operator== (ArenaAllocator<U> const& other) const
+{
+    return this->arena == other.arena;
+}
+
+template <typename T>
+template <class U>
+inline bool
+ArenaAllocator<T>::operator!= (ArenaAllocator<U> const& other) const
+{
+    return this->arena != other.arena;
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_ARENA_HEADER */
@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include "util/async_logger.h"
+
+UTIL_NAMESPACE_BEGIN
+
+namespace
+{
+    std::int64_t
+    get_timestamp_ns (void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>
+            (std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Collects the output of a util::Logging stream until it is synced. */
+    class LineBuffer : public std::stringbuf
+    {
+    public:
+        LineBuffer (void)
+            : logger(nullptr)
+            , level(Logging::LOG_INFO)
+        {
+        }
+
+        int sync (void)
+        {
+            if (this->logger != nullptr && this->pptr() != this->pbase())
+                this->logger->write(this->level, this->str());
+            this->str(std::string());
+            return 0;
+        }
+
+        AsyncLogger* logger;
+        Logging::LogLevel level;
+    };
+
+    struct LineStream
+    {
+        LineStream (void) : stream(&buffer) {}
+
+        LineBuffer buffer;
+        std::ostream stream;
+    };
+
+    LineStream&
+    get_line_stream (void)
+    {
+        static thread_local LineStream line_stream;
+        return line_stream;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+std::ostream&
+Logging::async_stream (LogLevel log_level) const
+{
+    /* Pending output without line break goes to the previous target. */
+    LineStream& line_stream = get_line_stream();
+    if (line_stream.buffer.logger != this->async
+        || line_stream.buffer.level != log_level)
+    {
+        line_stream.stream.flush();
+        line_stream.buffer.logger = this->async;
+        line_stream.buffer.level = log_level;
+    }
+    return line_stream.stream;
+}
+
+/* ---------------------------------------------------------------- */
+
+LogRateLimit::LogRateLimit (std::size_t max_messages,
+    std::chrono::milliseconds interval)
+    : max_messages(max_messages)
+    , interval_ns(std::chrono::duration_cast<std::chrono::nanoseconds>
+        (interval).count())
+    , window_start(get_timestamp_ns())
+    , num_messages(0)
+    , num_suppressed(0)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+LogRateLimit::allow (std::size_t* num_suppressed)
+{
+    /* The thread that starts a new window resets the message counter. */
+    std::int64_t const now = get_timestamp_ns();
+    std::int64_t start = this->window_start.load(std::memory_order_relaxed);
+    if (now - start >= this->interval_ns
+        && this->window_start.compare_exchange_strong(start, now))
+        this->num_messages = 0;
+
+    if (this->num_messages.fetch_add(1) < this->max_messages)
+    {
+        *num_suppressed = this->num_suppressed.exchange(0);
+        return true;
+    }
+    this->num_suppressed += 1;
+    return false;
+}
+
+/* ---------------------------------------------------------------- */
+
+struct AsyncLogger::TextMessage : public AsyncLogger::Message
+{
+    void format (std::ostream& out) const
+    {
+        out << this->text;
+    }
+
+    std::string text;
+};
+
+/* ---------------------------------------------------------------- */
+
+AsyncLogger::AsyncLogger (std::chrono::milliseconds flush_interval)
+    : stub(new TextMessage())
+    , max_level(Logging::LOG_DEBUG)
+    , out(&std::cout)
+    , err(&std::cerr)
+    , flush_interval(flush_interval)
+    , num_pushed(0)
+    , num_written(0)
+    , flush_requested(false)
+    , stop(false)
+{
+    this->stub->next = nullptr;
+    this->head = this->stub.get();
+    this->tail = this->stub.get();
+    this->thread = std::thread(&AsyncLogger::thread_main, this);
+}
+
+/* ---------------------------------------------------------------- */
+
+AsyncLogger::~AsyncLogger (void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop = true;
+    }
+    this->wakeup.notify_one();
+    this->thread.join();
+    this->write_pending();
+}
+
+/* ---------------------------------------------------------------- */
+
+AsyncLogger&
+AsyncLogger::get_global (void)
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::set_max_level (Logging::LogLevel max_level)
+{
+    this->max_level = static_cast<int>(max_level);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::set_output (std::ostream* out, std::ostream* err)
+{
+    this->flush();
+    this->out = out;
+    this->err = err;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::write (Logging::LogLevel level, std::string const& text)
+{
+    if (!this->is_enabled(level))
+        return;
+    TextMessage* message = new TextMessage();
+    message->level = level;
+    message->text = text;
+    this->push(message);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::flush (void)
+{
+    std::size_t const target = this->num_pushed;
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (this->num_written < target)
+    {
+        /* Messages may be hidden by pushes in progress, retry until done. */
+        this->flush_requested = true;
+        this->wakeup.notify_one();
+        this->flushed.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::push (Message* message)
+{
+    /* A producer links its message after swapping the head. */
+    bool const is_error = message->level == Logging::LOG_ERROR;
+    message->next.store(nullptr, std::memory_order_relaxed);
+    Message* prev = this->head.exchange(message, std::memory_order_acq_rel);
+    prev->next.store(message, std::memory_order_release);
+    this->num_pushed += 1;
+
+    /* The message may be written and freed already. */
+    if (is_error)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->flush_requested = true;
+        this->wakeup.notify_one();
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+AsyncLogger::Message*
+AsyncLogger::pop (void)
+{
+    /*
+     * Single consumer. The stub is re-queued when the tail reaches the
+     * head, so the last message can be popped while producers push.
+     * Returns null for an empty queue or a push in progress.
+     */
+    Message* tail = this->tail;
+    Message* next = tail->next.load(std::memory_order_acquire);
+    if (tail == this->stub.get())
+    {
+        if (next == nullptr)
+            return nullptr;
+        this->tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr)
+    {
+        this->tail = next;
+        return tail;
+    }
+
+    if (tail != this->head.load(std::memory_order_acquire))
+        return nullptr;
+
+    this->push_stub();
+    next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+        return nullptr;
+    this->tail = next;
+    return tail;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::push_stub (void)
+{
+    Message* stub = this->stub.get();
+    stub->next.store(nullptr, std::memory_order_relaxed);
+    Message* prev = this->head.exchange(stub, std::memory_order_acq_rel);
+    prev->next.store(stub, std::memory_order_release);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::write_pending (void)
+{
+    bool written = false;
+    while (Message* message = this->pop())
+    {
+        std::unique_ptr<Message> owned(message);
+        message->format(message->level == Logging::LOG_ERROR
+            ? *this->err : *this->out);
+        this->num_written += 1;
+        written = true;
+    }
+
+    if (written)
+    {
+        this->out->flush();
+        this->err->flush();
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncLogger::thread_main (void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->wakeup.wait_for(lock, this->flush_interval, [this] (void)
+            { return this->stop || this->flush_requested; });
+        bool const stopping = this->stop;
+        this->flush_requested = false;
+
+        lock.unlock();
+        this->write_pending();
+        lock.lock();
+        this->flushed.notify_all();
+
+        /* Messages are complete after join, except for pushes in flight. */
+        if (stopping && this->num_written >= this->num_pushed)
+            return;
+    }
+}
+
+UTIL_NAMESPACE_END
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_ASYNC_LOGGER_HEADER
+#define UTIL_ASYNC_LOGGER_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "util/defines.h"
+#include "util/logging.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/**
+ * Limits the amount of messages per time interval, e.g. for messages that
+ * are logged for every image pair. The limit is shared by all threads and
+ * counts the suppressed messages for a note with the next logged message.
+ */
+class LogRateLimit
+{
+public:
+    explicit LogRateLimit (std::size_t max_messages,
+        std::chrono::milliseconds interval = std::chrono::seconds(1));
+
+    /**
+     * Returns true if a message may be logged now. In this case, the
+     * amount of messages suppressed since the last logged message is
+     * stored in 'num_suppressed'.
+     */
+    bool allow (std::size_t* num_suppressed);
+
+private:
+    std::size_t max_messages;
+    std::int64_t interval_ns;
+    std::atomic<std::int64_t> window_start;
+    std::atomic<std::size_t> num_messages;
+    std::atomic<std::size_t> num_suppressed;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Logger that writes messages from a background thread.
+ *
+ * Messages are pushed to a lock-free multi-producer queue, so logging
+ * threads neither wait for the stream nor for each other. The arguments of
+ * log() are copied and only formatted by the background thread, which
+ * writes all pending messages every flush interval, and immediately for
+ * errors. Messages of every thread appear in the order of logging. Like
+ * util::Logging, errors are written to std::cerr and all other levels to
+ * std::cout.
+ *
+ * A util::Logging instance forwards its stream output to the logger with
+ * Logging::set_async(), where every line must be terminated by std::endl
+ * or a flush. Code that mixes asynchronous messages with direct console
+ * output should call flush() before the direct output.
+ */
+class AsyncLogger
+{
+public:
+    explicit AsyncLogger (std::chrono::milliseconds flush_interval
+        = std::chrono::milliseconds(20));
+    ~AsyncLogger (void);
+    AsyncLogger (AsyncLogger const& other) = delete;
+    AsyncLogger& operator= (AsyncLogger const& other) = delete;
+
+    /** Returns the process-wide logger, which is drained at exit. */
+    static AsyncLogger& get_global (void);
+
+    /** Sets the maximum level of logged messages, LOG_DEBUG by default. */
+    void set_max_level (Logging::LogLevel max_level);
+    /** Returns true if messages with the given level are logged. */
+    bool is_enabled (Logging::LogLevel level) const;
+
+    /**
+     * Sets the output streams for subsequent messages. This must not be
+     * called concurrently with logging.
+     */
+    void set_output (std::ostream* out, std::ostream* err);
+
+    /** Logs the arguments with operator<< as one line. */
+    template <typename... ARGS>
+    void log (Logging::LogLevel level, ARGS const&... args);
+
+    /** Logs the arguments if the rate limit allows it. */
+    template <typename... ARGS>
+    void log_limited (LogRateLimit& limit, Logging::LogLevel level,
+        ARGS const&... args);
+
+    /** Logs preformatted text, which includes the line break. */
+    void write (Logging::LogLevel level, std::string const& text);
+
+    /** Blocks until all messages logged before the call are written. */
+    void flush (void);
+
+private:
+    struct Message
+    {
+        virtual ~Message (void) = default;
+        virtual void format (std::ostream& out) const = 0;
+
+        std::atomic<Message*> next;
+        Logging::LogLevel level;
+    };
+
+    struct TextMessage;
+    template <typename... ARGS>
+    struct ArgsMessage;
+
+    /* String literals and C strings are copied as strings. */
+    template <typename T>
+    struct Argument
+    {
+        typedef T Type;
+    };
+
+    void push (Message* message);
+    void push_stub (void);
+    Message* pop (void);
+    void write_pending (void);
+    void thread_main (void);
+
+private:
+    /* The queue with a stub node, pushed at the head, popped at the tail. */
+    std::atomic<Message*> head;
+    Message* tail;
+    std::unique_ptr<Message> stub;
+
+    std::atomic<int> max_level;
+    std::ostream* out;
+    std::ostream* err;
+    std::chrono::milliseconds flush_interval;
+    std::atomic<std::size_t> num_pushed;
+    std::atomic<std::size_t> num_written;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable flushed;
+    bool flush_requested;
+    bool stop;
+    std::thread thread;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+template <typename... ARGS>
+struct AsyncLogger::ArgsMessage : public AsyncLogger::Message
+{
+    explicit ArgsMessage (ARGS const&... args)
+        : args(args...)
+    {
+    }
+
+    void format (std::ostream& out) const
+    {
+        this->format_args<0>(out);
+        out << '\n';
+    }
+
+    template <std::size_t I>
+    typename std::enable_if<(I < sizeof...(ARGS))>::type
+    format_args (std::ostream& out) const
+    {
+        out << std::get<I>(this->args);
+        this->format_args<I + 1>(out);
+    }
+
+    template <std::size_t I>
+    typename std::enable_if<(I >= sizeof...(ARGS))>::type
+    format_args (std::ostream& /*out*/) const
+    {
+    }
+
+    std::tuple<ARGS...> args;
+};
+
+template <>
+struct AsyncLogger::Argument<char const*>
+{
+    typedef std::string Type;
+};
+
+template <>
+struct AsyncLogger::Argument<char*>
+{
+    typedef std::string Type;
+};
+
+template <std::size_t N>
+struct AsyncLogger::Argument<char[N]>
+{
+    typedef std::string Type;
+};
+
+inline bool
+AsyncLogger::is_enabled (Logging::LogLevel level) const
+{
+    return static_cast<int>(level)
+        <= this->max_level.load(std::memory_order_relaxed);
+}
+
+template <typename... ARGS>
+void
+AsyncLogger::log (Logging::LogLevel level, ARGS const&... args)
+{
+    if (!this->is_enabled(level))
+        return;
+    Message* message
+        = new ArgsMessage<typename Argument<ARGS>::Type...>(args...);
+    message->level = level;
+    this->push(message);
+}
+
+template <typename... ARGS>
+void
+AsyncLogger::log_limited (LogRateLimit& limit, Logging::LogLevel level,
+    ARGS const&... args)
+{
+    if (!this->is_enabled(level))
+        return;
+    std::size_t num_suppressed = 0;
+    if (!limit.allow(&num_suppressed))
+        return;
+    if (num_suppressed > 0)
+        this->log(level, "(", num_suppressed, " similar messages suppressed)");
+    this->log(level, args...);
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_ASYNC_LOGGER_HEADER */
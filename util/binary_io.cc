@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#   include <fcntl.h>
+#   include <io.h>
+#   include <sys/stat.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "util/exception.h"
+#include "util/binary_io.h"
+
+/* The size of the read and write buffers. */
+#define BINARY_IO_BUFFER_SIZE (1 << 20)
+
+UTIL_NAMESPACE_BEGIN
+
+namespace
+{
+    int
+    open_file (std::string const& filename, bool write)
+    {
+#ifdef _WIN32
+        return write
+            ? ::_open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC
+                | _O_BINARY, _S_IREAD | _S_IWRITE)
+            : ::_open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        return write
+            ? ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)
+            : ::open(filename.c_str(), O_RDONLY);
+#endif
+    }
+
+    void
+    close_file (int fd)
+    {
+#ifdef _WIN32
+        ::_close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+
+    std::size_t
+    get_file_size (int fd, std::string const& filename)
+    {
+#ifdef _WIN32
+        struct _stat64 statbuf;
+        if (::_fstat64(fd, &statbuf) < 0)
+#else
+        struct stat statbuf;
+        if (::fstat(fd, &statbuf) < 0)
+#endif
+            throw util::FileException(filename, std::strerror(errno));
+        return static_cast<std::size_t>(statbuf.st_size);
+    }
+
+    /* Reads until 'size' bytes are read or the end of the file. */
+    std::size_t
+    read_file (int fd, char* data, std::size_t size,
+        std::string const& filename)
+    {
+        std::size_t done = 0;
+        while (done < size)
+        {
+            std::size_t const chunk = std::min<std::size_t>(size - done,
+                1 << 30);
+#ifdef _WIN32
+            int const ret = ::_read(fd, data + done,
+                static_cast<unsigned int>(chunk));
+#else
+            ssize_t const ret = ::read(fd, data + done, chunk);
+#endif
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret < 0)
+                throw util::FileException(filename, std::strerror(errno));
+            if (ret == 0)
+                break;
+            done += static_cast<std::size_t>(ret);
+        }
+        return done;
+    }
+
+    void
+    write_file (int fd, char const* data, std::size_t size,
+        std::string const& filename)
+    {
+        std::size_t done = 0;
+        while (done < size)
+        {
+            std::size_t const chunk = std::min<std::size_t>(size - done,
+                1 << 30);
+#ifdef _WIN32
+            int const ret = ::_write(fd, data + done,
+                static_cast<unsigned int>(chunk));
+#else
+            ssize_t const ret = ::write(fd, data + done, chunk);
+#endif
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                throw util::FileException(filename, std::strerror(errno));
+            done += static_cast<std::size_t>(ret);
+        }
+    }
+
+    void
+    seek_file (int fd, std::size_t offset, std::string const& filename)
+    {
+#ifdef _WIN32
+        bool const failed = ::_lseeki64(fd,
+            static_cast<__int64>(offset), SEEK_SET) < 0;
+#else
+        bool const failed = ::lseek(fd,
+            static_cast<off_t>(offset), SEEK_SET) < 0;
+#endif
+        if (failed)
+            throw util::FileException(filename, std::strerror(errno));
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+MappedFile::open (std::string const& filename)
+{
+    this->close();
+
+#ifdef _WIN32
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.good())
+        throw util::FileException(filename, std::strerror(errno));
+    in.seekg(0, std::ios::end);
+    this->buffer.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(this->buffer.data(),
+        static_cast<std::streamsize>(this->buffer.size()));
+    if (in.fail())
+        throw util::FileException(filename, "Error reading file");
+    this->mapping = this->buffer.empty() ? nullptr : this->buffer.data();
+    this->mapping_size = this->buffer.size();
+#else
+    int const fd = open_file(filename, false);
+    if (fd < 0)
+        throw util::FileException(filename, std::strerror(errno));
+    std::size_t file_size = 0;
+    try
+    {
+        file_size = get_file_size(fd, filename);
+    }
+    catch (...)
+    {
+        close_file(fd);
+        throw;
+    }
+
+    /* Empty files cannot be mapped. */
+    if (file_size > 0)
+    {
+        void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED,
+            fd, 0);
+        int const error = errno;
+        close_file(fd);
+        if (mapping == MAP_FAILED)
+            throw util::FileException(filename, std::strerror(error));
+        this->mapping = static_cast<char const*>(mapping);
+    }
+    else
+        close_file(fd);
+    this->mapping_size = file_size;
+#endif
+    this->opened = true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MappedFile::close (void)
+{
+#ifndef _WIN32
+    if (this->mapping != nullptr)
+        ::munmap(const_cast<char*>(this->mapping), this->mapping_size);
+#endif
+    std::vector<char>().swap(this->buffer);
+    this->mapping = nullptr;
+    this->mapping_size = 0;
+    this->opened = false;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MappedFile::advise (AccessHint hint)
+{
+#if defined(MADV_SEQUENTIAL) && !defined(_WIN32)
+    if (this->mapping == nullptr)
+        return;
+    int advice = MADV_NORMAL;
+    switch (hint)
+    {
+        case ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+        case ACCESS_RANDOM: advice = MADV_RANDOM; break;
+        case ACCESS_WILLNEED: advice = MADV_WILLNEED; break;
+        default: break;
+    }
+    /* The advice is only a hint, failures are ignored. */
+    ::madvise(const_cast<char*>(this->mapping), this->mapping_size, advice);
+#else
+    (void)hint;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryReader::open (std::string const& filename, Backend backend,
+    AccessHint hint)
+{
+    this->close();
+    this->filename = filename;
+    this->backend = backend;
+
+    if (backend == BACKEND_MAPPED)
+    {
+        this->mapping.open(filename);
+        this->data = this->mapping.data();
+        this->file_size = this->mapping.size();
+        this->end = this->file_size;
+    }
+    else
+    {
+        this->fd = open_file(filename, false);
+        if (this->fd < 0)
+            throw util::FileException(filename, std::strerror(errno));
+        try
+        {
+            this->file_size = get_file_size(this->fd, filename);
+        }
+        catch (...)
+        {
+            this->close();
+            throw;
+        }
+        this->buffer.resize(BINARY_IO_BUFFER_SIZE);
+        this->data = this->buffer.data();
+    }
+    this->advise(hint);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryReader::close (void)
+{
+    if (this->fd >= 0)
+        close_file(this->fd);
+    this->mapping.close();
+    std::vector<char>().swap(this->buffer);
+    this->fd = -1;
+    this->data = nullptr;
+    this->pos = 0;
+    this->end = 0;
+    this->offset = 0;
+    this->file_size = 0;
+    this->at_eof = false;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryReader::advise (AccessHint hint)
+{
+    if (this->backend == BACKEND_MAPPED)
+    {
+        this->mapping.advise(hint);
+        return;
+    }
+
+#if defined(POSIX_FADV_SEQUENTIAL) && !defined(_WIN32)
+    if (this->fd < 0)
+        return;
+    int advice = POSIX_FADV_NORMAL;
+    switch (hint)
+    {
+        case ACCESS_SEQUENTIAL: advice = POSIX_FADV_SEQUENTIAL; break;
+        case ACCESS_RANDOM: advice = POSIX_FADV_RANDOM; break;
+        case ACCESS_WILLNEED: advice = POSIX_FADV_WILLNEED; break;
+        default: break;
+    }
+    /* The advice is only a hint, failures are ignored. */
+    ::posix_fadvise(this->fd, 0, 0, advice);
+#else
+    (void)hint;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+BinaryReader::read_buffered (char* data, std::size_t size)
+{
+    std::size_t done = 0;
+    while (done < size)
+    {
+        std::size_t const available = this->end - this->pos;
+        if (available > 0)
+        {
+            std::size_t const num = std::min(available, size - done);
+            std::memcpy(data + done, this->data + this->pos, num);
+            this->pos += num;
+            done += num;
+            continue;
+        }
+
+        /* Large reads bypass the buffer. */
+        if (this->fd >= 0 && size - done >= this->buffer.size())
+        {
+            std::size_t const num = read_file(this->fd, data + done,
+                size - done, this->filename);
+            this->offset += this->end + num;
+            this->pos = 0;
+            this->end = 0;
+            done += num;
+            if (done < size)
+                this->at_eof = true;
+            break;
+        }
+
+        if (!this->fill())
+        {
+            this->at_eof = true;
+            break;
+        }
+    }
+    return done;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+BinaryReader::fill (void)
+{
+    if (this->fd < 0)
+        return false;
+    this->offset += this->end;
+    this->pos = 0;
+    this->end = read_file(this->fd, this->buffer.data(),
+        this->buffer.size(), this->filename);
+    return this->end > 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+BinaryReader::read_line (std::string* line)
+{
+    line->clear();
+    bool found_any = false;
+    while (true)
+    {
+        if (this->pos == this->end && !this->fill())
+        {
+            this->at_eof = true;
+            return found_any;
+        }
+        found_any = true;
+
+        char const* begin = this->data + this->pos;
+        char const* newline = static_cast<char const*>(std::memchr(begin,
+            '\n', this->end - this->pos));
+        if (newline == nullptr)
+        {
+            line->append(begin, this->end - this->pos);
+            this->pos = this->end;
+            continue;
+        }
+        line->append(begin, newline - begin);
+        this->pos += newline - begin + 1;
+        return true;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+BinaryReader::skip (std::size_t size)
+{
+    std::size_t const start = this->tell();
+    std::size_t const target = std::min(this->file_size
+        - std::min(this->file_size, start), size) + start;
+    this->seek(target);
+    if (target - start < size)
+        this->at_eof = true;
+    return target - start;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryReader::seek (std::size_t offset)
+{
+    this->at_eof = false;
+
+    /* Positions in the buffer or the mapping need no system call. */
+    if (offset >= this->offset && offset - this->offset <= this->end)
+    {
+        this->pos = offset - this->offset;
+        return;
+    }
+    if (this->fd < 0)
+    {
+        this->pos = this->end;
+        return;
+    }
+
+    seek_file(this->fd, offset, this->filename);
+    this->offset = offset;
+    this->pos = 0;
+    this->end = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+BinaryWriter::~BinaryWriter (void)
+{
+    try
+    {
+        this->close();
+    }
+    catch (...)
+    {
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryWriter::open (std::string const& filename)
+{
+    this->close();
+    this->fd = open_file(filename, true);
+    if (this->fd < 0)
+        throw util::FileException(filename, std::strerror(errno));
+    this->filename = filename;
+    this->buffer.resize(BINARY_IO_BUFFER_SIZE);
+    this->used = 0;
+    this->written = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryWriter::close (void)
+{
+    if (this->fd < 0)
+        return;
+
+    /* The file is closed even if writing the buffer fails. */
+    int const fd = this->fd;
+    try
+    {
+        this->flush();
+    }
+    catch (...)
+    {
+        close_file(fd);
+        this->fd = -1;
+        throw;
+    }
+    this->fd = -1;
+    std::vector<char>().swap(this->buffer);
+#ifdef _WIN32
+    if (::_close(fd) < 0)
+#else
+    if (::close(fd) < 0)
+#endif
+        throw util::FileException(this->filename, std::strerror(errno));
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryWriter::flush (void)
+{
+    if (this->used == 0)
+        return;
+    std::size_t const num = this->used;
+    this->used = 0;
+    this->write_direct(this->buffer.data(), num);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+BinaryWriter::write_direct (char const* data, std::size_t size)
+{
+    if (this->fd < 0)
+        throw std::runtime_error("File not open for writing");
+    write_file(this->fd, data, size, this->filename);
+    this->written += size;
+}
+
+UTIL_NAMESPACE_END
@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_BINARY_IO_HEADER
+#define UTIL_BINARY_IO_HEADER
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "util/defines.h"
+#include "util/system.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/** The byte order of binary values in a file. */
+enum ByteOrder
+{
+    BYTE_ORDER_HOST,
+    BYTE_ORDER_LITTLE_ENDIAN,
+    BYTE_ORDER_BIG_ENDIAN
+};
+
+/** Hints about the access pattern of a file for the operating system. */
+enum AccessHint
+{
+    ACCESS_NORMAL,
+    /* Enables aggressive readahead. */
+    ACCESS_SEQUENTIAL,
+    /* Disables readahead. */
+    ACCESS_RANDOM,
+    /* Starts reading the file in the background. */
+    ACCESS_WILLNEED
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Read-only memory mapping of a whole file. The pages are loaded on access
+ * and are shared with other processes that map the same file. Where files
+ * cannot be mapped, the file is read into memory instead. The data are
+ * aligned to at least 16 bytes and valid until the file is closed.
+ */
+class MappedFile
+{
+public:
+    MappedFile (void);
+    explicit MappedFile (std::string const& filename);
+    ~MappedFile (void);
+    MappedFile (MappedFile const& other) = delete;
+    MappedFile& operator= (MappedFile const& other) = delete;
+
+    /** Maps the file, throws util::FileException on error. */
+    void open (std::string const& filename);
+    /** Unmaps the file, which invalidates the data. */
+    void close (void);
+    bool is_open (void) const;
+
+    /** Passes the access pattern hint for the mapping to the system. */
+    void advise (AccessHint hint);
+
+    /** Returns the contents of the file, null for empty files. */
+    char const* data (void) const;
+    std::size_t size (void) const;
+
+private:
+    char const* mapping;
+    std::size_t mapping_size;
+    bool opened;
+    /* The file contents where files cannot be mapped. */
+    std::vector<char> buffer;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Sequential reader for binary files.
+ *
+ * The buffered backend reads the file in large blocks, and reads larger
+ * than the buffer go directly to the destination. The mapped backend reads
+ * from a MappedFile without system calls, which is best for files that are
+ * accessed repeatedly or out of order. Both backends pass the readahead
+ * hint to the system.
+ *
+ * Like std::istream, reading beyond the end of the file is not an error:
+ * reads return the amount of data read and set the end of file state,
+ * which is sticky until seek(). Values that could not be read are zero.
+ * Failures to open or read the file throw util::FileException.
+ */
+class BinaryReader
+{
+public:
+    enum Backend
+    {
+        BACKEND_BUFFERED,
+        BACKEND_MAPPED
+    };
+
+public:
+    BinaryReader (void);
+    explicit BinaryReader (std::string const& filename,
+        Backend backend = BACKEND_BUFFERED,
+        AccessHint hint = ACCESS_SEQUENTIAL);
+    ~BinaryReader (void);
+    BinaryReader (BinaryReader const& other) = delete;
+    BinaryReader& operator= (BinaryReader const& other) = delete;
+
+    /** Opens the file, throws util::FileException on error. */
+    void open (std::string const& filename,
+        Backend backend = BACKEND_BUFFERED,
+        AccessHint hint = ACCESS_SEQUENTIAL);
+    void close (void);
+    bool is_open (void) const;
+
+    /** Passes the access pattern hint for the file to the system. */
+    void advise (AccessHint hint);
+
+    /** Reads up to 'size' bytes and returns the amount of bytes read. */
+    std::size_t read (void* data, std::size_t size);
+    /** Reads a value in the given byte order. */
+    template <typename T>
+    T read_value (ByteOrder order = BYTE_ORDER_HOST);
+    /**
+     * Reads 'num' values in the given byte order and returns the amount of
+     * values read. Byte order conversion requires arithmetic types, other
+     * types such as vectors can only be read in host order.
+     */
+    template <typename T>
+    std::size_t read_array (T* values, std::size_t num,
+        ByteOrder order = BYTE_ORDER_HOST);
+
+    /** Returns the next byte without consuming it, or EOF. */
+    int peek (void);
+    /** Returns and consumes the next byte, or EOF. */
+    int get (void);
+    /**
+     * Reads the rest of the line without the line break, including a CR
+     * before it. Returns false if the end of the file has been reached.
+     */
+    bool read_line (std::string* line);
+
+    /** Skips up to 'size' bytes and returns the amount of bytes skipped. */
+    std::size_t skip (std::size_t size);
+    /** Moves to the absolute offset and clears the end of file state. */
+    void seek (std::size_t offset);
+    /** Returns the current offset in the file. */
+    std::size_t tell (void) const;
+    /** Returns the size of the file. */
+    std::size_t size (void) const;
+
+    /** Returns true if a read reached the end of the file. */
+    bool eof (void) const;
+    std::string const& get_filename (void) const;
+
+private:
+    std::size_t read_buffered (char* data, std::size_t size);
+    bool fill (void);
+
+private:
+    std::string filename;
+    Backend backend;
+    int fd;
+    MappedFile mapping;
+    std::vector<char> buffer;
+    /* The buffer or the mapping, which starts at file position 'offset'. */
+    char const* data;
+    std::size_t pos;
+    std::size_t end;
+    std::size_t offset;
+    std::size_t file_size;
+    bool at_eof;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Sequential writer for binary files, which collects small writes in a
+ * large buffer. Writes larger than the buffer go directly to the file.
+ * Failures throw util::FileException. The destructor closes the file but
+ * ignores errors, so close() should be called to detect them.
+ */
+class BinaryWriter
+{
+public:
+    BinaryWriter (void);
+    explicit BinaryWriter (std::string const& filename);
+    ~BinaryWriter (void);
+    BinaryWriter (BinaryWriter const& other) = delete;
+    BinaryWriter& operator= (BinaryWriter const& other) = delete;
+
+    /** Creates or truncates the file, throws util::FileException. */
+    void open (std::string const& filename);
+    /** Writes the buffer and closes the file. */
+    void close (void);
+    bool is_open (void) const;
+
+    void write (void const* data, std::size_t size);
+    void write (std::string const& str);
+    /** Writes a value in the given byte order. */
+    template <typename T>
+    void write_value (T const& value, ByteOrder order = BYTE_ORDER_HOST);
+    /** Writes 'num' values in the given byte order, see read_array(). */
+    template <typename T>
+    void write_array (T const* values, std::size_t num,
+        ByteOrder order = BYTE_ORDER_HOST);
+
+    /** Writes the buffer to the file. */
+    void flush (void);
+    /** Returns the amount of bytes written so far. */
+    std::size_t tell (void) const;
+    std::string const& get_filename (void) const;
+
+private:
+    void write_direct (char const* data, std::size_t size);
+
+private:
+    std::string filename;
+    int fd;
+    std::vector<char> buffer;
+    std::size_t used;
+    std::size_t written;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+namespace internal
+{
+    inline bool
+    needs_byte_swap (ByteOrder order)
+    {
+#ifdef HOST_BYTEORDER_LE
+        return order == BYTE_ORDER_BIG_ENDIAN;
+#else
+        return order == BYTE_ORDER_LITTLE_ENDIAN;
+#endif
+    }
+
+    template <typename T>
+    inline typename std::enable_if<std::is_arithmetic<T>::value>::type
+    byte_swap_values (T* values, std::size_t num)
+    {
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            char* bytes = reinterpret_cast<char*>(values + i);
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+    }
+
+    template <typename T>
+    inline typename std::enable_if<!std::is_arithmetic<T>::value>::type
+    byte_swap_values (T* /*values*/, std::size_t /*num*/)
+    {
+        throw std::invalid_argument("Byte order conversion needs "
+            "arithmetic types");
+    }
+}
+
+inline
+MappedFile::MappedFile (void)
+    : mapping(nullptr)
+    , mapping_size(0)
+    , opened(false)
+{
+}
+
+inline
+MappedFile::MappedFile (std::string const& filename)
+    : MappedFile()
+{
+    this->open(filename);
+}
+
+inline
+MappedFile::~MappedFile (void)
+{
+    this->close();
+}
+
+inline bool
+MappedFile::is_open (void) const
+{
+    return this->opened;
+}
+
+inline char const*
+MappedFile::data (void) const
+{
+    return this->mapping;
+}
+
+inline std::size_t
+MappedFile::size (void) const
+{
+    return this->mapping_size;
+}
+
+/* ---------------------------------------------------------------- */
+
+inline
+BinaryReader::BinaryReader (void)
+    : backend(BACKEND_BUFFERED)
+    , fd(-1)
+    , data(nullptr)
+    , pos(0)
+    , end(0)
+    , offset(0)
+    , file_size(0)
+    , at_eof(false)
+{
+}
+
+inline
+BinaryReader::BinaryReader (std::string const& filename, Backend backend,
+    AccessHint hint)
+    : BinaryReader()
+{
+    this->open(filename, backend, hint);
+}
+
+inline
+BinaryReader::~BinaryReader (void)
+{
+    this->close();
+}
+
+inline bool
+BinaryReader::is_open (void) const
+{
+    return this->fd >= 0 || this->mapping.is_open();
+}
+
+inline std::size_t
+BinaryReader::read (void* data, std::size_t size)
+{
+    /* Small reads are served from the buffer without a call. */
+    if (size <= this->end - this->pos)
+    {
+        std::memcpy(data, this->data + this->pos, size);
+        this->pos += size;
+        return size;
+    }
+    return this->read_buffered(static_cast<char*>(data), size);
+}
+
+template <typename T>
+inline T
+BinaryReader::read_value (ByteOrder order)
+{
+    T value = T();
+    if (this->read(&value, sizeof(T)) != sizeof(T))
+        return T();
+    if (internal::needs_byte_swap(order))
+        internal::byte_swap_values(&value, 1);
+    return value;
+}
+
+template <typename T>
+inline std::size_t
+BinaryReader::read_array (T* values, std::size_t num, ByteOrder order)
+{
+    std::size_t const num_read = this->read(values, num * sizeof(T))
+        / sizeof(T);
+    if (internal::needs_byte_swap(order))
+        internal::byte_swap_values(values, num_read);
+    return num_read;
+}
+
+inline int
+BinaryReader::peek (void)
+{
+    if (this->pos == this->end && !this->fill())
+    {
+        this->at_eof = true;
+        return EOF;
+    }
+    return static_cast<unsigned char>(this->data[this->pos]);
+}
+
+inline int
+BinaryReader::get (void)
+{
+    int const chr = this->peek();
+    if (chr != EOF)
+        this->pos += 1;
+    return chr;
+}
+
+inline std::size_t
+BinaryReader::tell (void) const
+{
+    return this->offset + this->pos;
+}
+
+inline std::size_t
+BinaryReader::size (void) const
+{
+    return this->file_size;
+}
+
+inline bool
+BinaryReader::eof (void) const
+{
+    return this->at_eof;
+}
+
+inline std::string const&
+BinaryReader::get_filename (void) const
+{
+    return this->filename;
+}
+
+/* ---------------------------------------------------------------- */
+
+inline
+BinaryWriter::BinaryWriter (void)
+    : fd(-1)
+    , used(0)
+    , written(0)
+{
+}
+
+inline
+BinaryWriter::BinaryWriter (std::string const& filename)
+    : BinaryWriter()
+{
+    this->open(filename);
+}
+
+inline bool
+BinaryWriter::is_open (void) const
+{
+    return this->fd >= 0;
+}
+
+inline void
+BinaryWriter::write (void const* data, std::size_t size)
+{
+    if (size <= this->buffer.size() - this->used)
+    {
+        std::memcpy(this->buffer.data() + this->used, data, size);
+        this->used += size;
+        return;
+    }
+    this->flush();
+    if (size >= this->buffer.size())
+        this->write_direct(static_cast<char const*>(data), size);
+    else
+    {
+        std::memcpy(this->buffer.data(), data, size);
+        this->used = size;
+    }
+}
+
+inline void
+BinaryWriter::write (std::string const& str)
+{
+    this->write(str.data(), str.size());
+}
+
+template <typename T>
+inline void
+BinaryWriter::write_value (T const& value, ByteOrder order)
+{
+    T copy(value);
+    if (internal::needs_byte_swap(order))
+        internal::byte_swap_values(&copy, 1);
+    this->write(&copy, sizeof(T));
+}
+
+template <typename T>
+inline void
+BinaryWriter::write_array (T const* values, std::size_t num,
+    ByteOrder order)
+{
+    if (!internal::needs_byte_swap(order))
+    {
+        this->write(values, num * sizeof(T));
+        return;
+    }
+    for (std::size_t i = 0; i < num; ++i)
+        this->write_value(values[i], order);
+}
+
+inline std::size_t
+BinaryWriter::tell (void) const
+{
+    return this->written + this->used;
+}
+
+inline std::string const&
+BinaryWriter::get_filename (void) const
+{
+    return this->filename;
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_BINARY_IO_HEADER */
@@ -15,6 +15,8 @@
 #include <cstring> // std::strerror
 #include <cstdio> // std::rename
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 
 #if defined(_WIN32)
 #   include <direct.h>
@@ -24,12 +26,17 @@
 #   include <sys/types.h>
 #else // Linux, OSX, ...
 #   include <dirent.h>
+#   include <fcntl.h>
 #   include <unistd.h>
 #   include <sys/stat.h>
 #   include <sys/types.h>
 #   include <pwd.h>
 #endif
 
+#if defined(__linux__)
+#   include <sys/syscall.h> // SYS_getdents64
+#endif
+
 #if defined(__APPLE__)
 #   include <mach-o/dyld.h> // for _NSGetExecutablePath
 #endif
@@ -40,6 +47,7 @@
 
 #include "util/exception.h"
 #include "util/system.h"
+#include "util/thread_pool.h"
 #include "util/file_system.h"
 
 UTIL_NAMESPACE_BEGIN
@@ -115,6 +123,31 @@ file_exists (char const* pathname)
 
 /* ---------------------------------------------------------------- */
 
+int64_t
+get_modification_time (char const* pathname)
+{
+#ifdef _WIN32
+    struct _stat statbuf;
+    if (::_stat(pathname, &statbuf) < 0)
+        return -1;
+    return static_cast<int64_t>(statbuf.st_mtime) * 1000000000;
+#elif defined(__APPLE__)
+    struct stat statbuf;
+    if (::stat(pathname, &statbuf) < 0)
+        return -1;
+    return static_cast<int64_t>(statbuf.st_mtimespec.tv_sec) * 1000000000
+        + statbuf.st_mtimespec.tv_nsec;
+#else // _WIN32
+    struct stat statbuf;
+    if (::stat(pathname, &statbuf) < 0)
+        return -1;
+    return static_cast<int64_t>(statbuf.st_mtim.tv_sec) * 1000000000
+        + statbuf.st_mtim.tv_nsec;
+#endif // _WIN32
+}
+
+/* ---------------------------------------------------------------- */
+
 char*
 get_cwd (char* buf, size_t size)
 {
@@ -274,6 +307,28 @@ copy_file (char const* src, char const* dst)
 
 /* ---------------------------------------------------------------- */
 
+bool
+sync_filesystem (char const* pathname)
+{
+#if defined(_WIN32)
+    (void)pathname;
+    return false;
+#elif defined(__linux__)
+    int fd = ::open(pathname, O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool const success = ::syncfs(fd) == 0;
+    ::close(fd);
+    return success;
+#else // _WIN32
+    (void)pathname;
+    ::sync();
+    return true;
+#endif // _WIN32
+}
+
+/* ---------------------------------------------------------------- */
+
 std::string
 get_cwd_string (void)
 {
@@ -547,12 +602,65 @@ File::operator< (File const& rhs) const
 
 /* ---------------------------------------------------------------- */
 
+#ifndef _WIN32
+namespace
+{
+    /* The records of getdents64, which has no declaration in older libcs. */
+    struct LinuxDirent64
+    {
+        std::uint64_t d_ino;
+        std::int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+
+    /*
+     * Adds the entry with the type from the listing. Entries of unknown
+     * type and symbolic links, which may point to directories, are
+     * recorded for stat.
+     */
+    void
+    add_directory_entry (std::string const& path, char const* name,
+        unsigned char type, Directory* directory,
+        std::vector<std::size_t>* unresolved)
+    {
+        if (!std::strcmp(name, ".") || !std::strcmp(name, ".."))
+            return;
+        if (type == DT_UNKNOWN || type == DT_LNK)
+            unresolved->push_back(directory->size());
+        directory->push_back(File(path, name, type == DT_DIR));
+    }
+
+    /* Determines the unresolved types with stat relative to the dir. */
+    void
+    resolve_directory_entries (int dir_fd,
+        std::vector<std::size_t> const& unresolved, bool parallel_stat,
+        Directory* directory)
+    {
+        auto resolve = [&] (std::size_t i)
+        {
+            File& file = directory->at(unresolved[i]);
+            struct stat info;
+            if (::fstatat(dir_fd, file.name.c_str(), &info, 0) == 0)
+                file.is_dir = S_ISDIR(info.st_mode);
+        };
+        if (parallel_stat)
+            util::parallel_for(0, unresolved.size(), resolve, 16);
+        else
+            for (std::size_t i = 0; i < unresolved.size(); ++i)
+                resolve(i);
+    }
+}  /* namespace */
+#endif
+
 void
-Directory::scan (std::string const& path)
+Directory::scan (std::string const& path, bool parallel_stat)
 {
     this->clear();
 
 #ifdef _WIN32
+    (void)parallel_stat;
     WIN32_FIND_DATA data;
     HANDLE hf = FindFirstFile((path + "/*").c_str(), &data);
 
@@ -572,23 +680,51 @@ Directory::scan (std::string const& path)
     while (FindNextFile(hf, &data) != 0);
 
     FindClose(hf);
+#elif defined(__linux__)
+    /*
+     * Reads the entries with large getdents64 calls, which saves round
+     * trips on network file systems compared to readdir.
+     */
+    int const fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw Exception("Cannot open directory: ", std::strerror(errno));
+
+    std::vector<char> buffer(256 * 1024);
+    std::vector<std::size_t> unresolved;
+    while (true)
+    {
+        long const num_bytes = ::syscall(SYS_getdents64, fd,
+            buffer.data(), buffer.size());
+        if (num_bytes < 0)
+        {
+            int const error = errno;
+            ::close(fd);
+            throw Exception("Cannot read directory: ", std::strerror(error));
+        }
+        if (num_bytes == 0)
+            break;
+
+        for (long pos = 0; pos < num_bytes;)
+        {
+            LinuxDirent64 const* entry = reinterpret_cast<LinuxDirent64 const*>
+                (buffer.data() + pos);
+            add_directory_entry(path, entry->d_name, entry->d_type,
+                this, &unresolved);
+            pos += entry->d_reclen;
+        }
+    }
+    resolve_directory_entries(fd, unresolved, parallel_stat, this);
+    ::close(fd);
 #else
     DIR *dp = ::opendir(path.c_str());
     if (dp == nullptr)
         throw Exception("Cannot open directory: ", std::strerror(errno));
 
+    std::vector<std::size_t> unresolved;
     struct dirent *ep;
     while ((ep = ::readdir(dp)))
-    {
-        if (!std::strcmp(ep->d_name, "."))
-            continue;
-        if (!std::strcmp(ep->d_name, ".."))
-            continue;
-        this->push_back(File());
-        this->back().path = path;
-        this->back().name = ep->d_name;
-        this->back().is_dir = (ep->d_type == DT_DIR);
-    }
+        add_directory_entry(path, ep->d_name, ep->d_type, this, &unresolved);
+    resolve_directory_entries(::dirfd(dp), unresolved, parallel_stat, this);
     ::closedir(dp);
 #endif
 }
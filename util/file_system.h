@@ -10,6 +10,7 @@
 #ifndef UTIL_FS_HEADER
 #define UTIL_FS_HEADER
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -31,6 +32,13 @@ bool dir_exists (char const* pathname);
 /** Determines if the given path is a file. */
 bool file_exists (char const* pathname);
 
+/**
+ * Returns the modification time of the file in nanoseconds since the
+ * epoch, or -1 if the file does not exist. The resolution depends on the
+ * file system, e.g. seconds on Windows.
+ */
+int64_t get_modification_time (char const* pathname);
+
 /** Determines the current user's path for application data. */
 char const* get_app_data_dir (void);
 
@@ -67,6 +75,13 @@ bool rename (char const* from, char const* to);
 /** Copies a file from 'src' to 'dst', throws FileException on error. */
 void copy_file (char const* src, char const* dst);
 
+/**
+ * Flushes all cached writes of the file system that contains the given
+ * path to disk. One call after writing many files is much cheaper than
+ * syncing every file. Returns false on error or if not supported.
+ */
+bool sync_filesystem (char const* pathname);
+
 /*
  * ----------------------------- File IO  ----------------------------
  */
@@ -146,8 +161,17 @@ class Directory : public std::vector<File>
 {
 public:
     Directory (void);
-    Directory (std::string const& path);
-    void scan (std::string const& path);
+    Directory (std::string const& path, bool parallel_stat = false);
+
+    /**
+     * Scans the directory entries, except "." and "..", in the order of
+     * the listing. The entry types are taken from the listing, only
+     * entries of unknown type and symbolic links are resolved with stat,
+     * which follows links to directories. With 'parallel_stat', these
+     * calls run on the global thread pool, which hides the latency of
+     * network file systems.
+     */
+    void scan (std::string const& path, bool parallel_stat = false);
 };
 
 /*
@@ -254,9 +278,9 @@ Directory::Directory (void)
 }
 
 inline
-Directory::Directory (std::string const& path)
+Directory::Directory (std::string const& path, bool parallel_stat)
 {
-    this->scan(path);
+    this->scan(path, parallel_stat);
 }
 
 inline
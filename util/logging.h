@@ -17,6 +17,14 @@
 
 UTIL_NAMESPACE_BEGIN
 
+class AsyncLogger;
+
+/**
+ * Level-filtered logging to the console. By default, messages are written
+ * synchronously to std::cout, and errors to std::cerr. With set_async(),
+ * the lines are handed to an AsyncLogger, which writes them from a
+ * background thread. Lines must then be terminated with std::endl.
+ */
 class Logging
 {
 public:
@@ -41,6 +49,8 @@ public:
     Logging (void);
     Logging (LogLevel max_level);
     void set_max_level (LogLevel max_level);
+    /** Forwards the output to the logger, or writes directly for null. */
+    void set_async (AsyncLogger* logger);
 
     std::ostream& log (LogLevel log_level) const;
     std::ostream& error (void) const;
@@ -49,9 +59,14 @@ public:
     std::ostream& verbose (void) const;
     std::ostream& debug (void) const;
 
+private:
+    /* Defined with the AsyncLogger. */
+    std::ostream& async_stream (LogLevel log_level) const;
+
 private:
     LogLevel max_level;
     NullStream nullstream;
+    AsyncLogger* async;
 };
 
 /* ------------------------ Implementation ------------------------ */
@@ -66,12 +81,14 @@ Logging::NullStream::operator<< (T const& /*arg*/)
 inline
 Logging::Logging (void)
     : max_level(LOG_INFO)
+    , async(nullptr)
 {
 }
 
 inline
 Logging::Logging (LogLevel max_level)
     : max_level(max_level)
+    , async(nullptr)
 {
 }
 
@@ -81,11 +98,19 @@ Logging::set_max_level (LogLevel max_level)
     this->max_level = max_level;
 }
 
+inline void
+Logging::set_async (AsyncLogger* logger)
+{
+    this->async = logger;
+}
+
 inline std::ostream&
 Logging::log (LogLevel log_level) const
 {
     if (log_level > this->max_level)
         return const_cast<NullStream&>(this->nullstream);
+    if (this->async != nullptr)
+        return this->async_stream(log_level);
     return (log_level == LOG_ERROR) ? std::cerr : std::cout;
 }
 
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__APPLE__)
+#   include <mach/mach.h>
+#   include <sys/resource.h>
+#elif defined(__linux__)
+#   include <sys/resource.h>
+#   include <unistd.h>
+#endif
+
+#include "util/memory.h"
+#include "util/strings.h"
+
+UTIL_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Every tag on its own cache line, tags are updated by many threads. */
+    struct alignas(64) TagCounter
+    {
+        std::atomic<std::size_t> current;
+        std::atomic<std::size_t> peak;
+        std::atomic<std::size_t> num_allocations;
+    };
+
+    /* Zero-initialized before any dynamic initialization. */
+    TagCounter counters[MEMORY_NUM_TAGS];
+
+    char const* tag_names[MEMORY_NUM_TAGS] =
+    {
+        "images", "features", "matches", "BA", "other"
+    };
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+MemoryAccounting::allocated (MemoryTag tag, std::size_t bytes)
+{
+    TagCounter& counter = counters[tag];
+    counter.num_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t const current = bytes
+        + counter.current.fetch_add(bytes, std::memory_order_relaxed);
+    std::size_t peak = counter.peak.load(std::memory_order_relaxed);
+    while (current > peak && !counter.peak.compare_exchange_weak(peak,
+        current, std::memory_order_relaxed))
+        continue;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MemoryAccounting::released (MemoryTag tag, std::size_t bytes)
+{
+    counters[tag].current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+MemoryAccounting::get_current (MemoryTag tag)
+{
+    return counters[tag].current.load(std::memory_order_relaxed);
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+MemoryAccounting::get_peak (MemoryTag tag)
+{
+    return counters[tag].peak.load(std::memory_order_relaxed);
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+MemoryAccounting::get_num_allocations (MemoryTag tag)
+{
+    return counters[tag].num_allocations.load(std::memory_order_relaxed);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MemoryAccounting::reset_peaks (void)
+{
+    for (int i = 0; i < MEMORY_NUM_TAGS; ++i)
+        counters[i].peak = counters[i].current.load();
+}
+
+/* ---------------------------------------------------------------- */
+
+char const*
+MemoryAccounting::get_tag_name (MemoryTag tag)
+{
+    if (tag < 0 || tag >= MEMORY_NUM_TAGS)
+        return "unknown";
+    return tag_names[tag];
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+MemoryAccounting::get_current_rss (void)
+{
+#if defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+        reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return static_cast<std::size_t>(info.resident_size);
+#elif defined(__linux__)
+    /* The second field of statm is the resident set size in pages. */
+    std::FILE* file = std::fopen("/proc/self/statm", "r");
+    if (file == nullptr)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int const num_read = std::fscanf(file, "%lu %lu", &size, &resident);
+    std::fclose(file);
+    if (num_read != 2)
+        return 0;
+    return static_cast<std::size_t>(resident)
+        * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+MemoryAccounting::get_peak_rss (void)
+{
+#if defined(__APPLE__) || defined(__linux__)
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#   if defined(__APPLE__)
+    /* The maximum resident set size is in bytes on macOS... */
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#   else
+    /* ...and in kilo bytes on Linux. */
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#   endif
+#else
+    return 0;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+MemoryAccounting::get_summary (void)
+{
+    std::stringstream ss;
+    ss << "Memory: RSS " << string::get_size_string(get_current_rss())
+        << " (peak " << string::get_size_string(get_peak_rss()) << ")";
+    for (int i = 0; i < MEMORY_NUM_TAGS; ++i)
+    {
+        MemoryTag const tag = static_cast<MemoryTag>(i);
+        ss << ", " << get_tag_name(tag) << " "
+            << string::get_size_string(get_current(tag))
+            << " (peak " << string::get_size_string(get_peak(tag)) << ")";
+    }
+    return ss.str();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MemoryAccounting::print_report (std::ostream& out)
+{
+    out << std::left << std::setw(12) << "Subsystem" << std::right
+        << std::setw(12) << "Current" << std::setw(12) << "Peak"
+        << std::setw(14) << "Allocations" << std::endl;
+    for (int i = 0; i < MEMORY_NUM_TAGS; ++i)
+    {
+        MemoryTag const tag = static_cast<MemoryTag>(i);
+        out << std::left << std::setw(12) << get_tag_name(tag) << std::right
+            << std::setw(12) << string::get_size_string(get_current(tag))
+            << std::setw(12) << string::get_size_string(get_peak(tag))
+            << std::setw(14) << get_num_allocations(tag) << std::endl;
+    }
+    out << std::left << std::setw(12) << "RSS" << std::right
+        << std::setw(12) << string::get_size_string(get_current_rss())
+        << std::setw(12) << string::get_size_string(get_peak_rss())
+        << std::endl;
+}
+
+/* ---------------------------------------------------------------- */
+
+MemoryReporter::MemoryReporter (Logging const& logging,
+    std::chrono::milliseconds interval, Logging::LogLevel level)
+    : logging(logging)
+    , interval(interval)
+    , level(level)
+    , stop(false)
+{
+    this->thread = std::thread(&MemoryReporter::thread_main, this);
+}
+
+/* ---------------------------------------------------------------- */
+
+MemoryReporter::~MemoryReporter (void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop = true;
+    }
+    this->stop_requested.notify_all();
+    this->thread.join();
+    this->report();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MemoryReporter::report (void) const
+{
+    /* Formatted up front to write the line at once. */
+    std::string const line = MemoryAccounting::get_summary() + "\n";
+    this->logging.log(this->level) << line << std::flush;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+MemoryReporter::thread_main (void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stop_requested.wait_for(lock, this->interval,
+        [this] (void) { return this->stop; }))
+    {
+        lock.unlock();
+        this->report();
+        lock.lock();
+    }
+}
+
+UTIL_NAMESPACE_END
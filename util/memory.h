@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_MEMORY_HEADER
+#define UTIL_MEMORY_HEADER
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/defines.h"
+#include "util/logging.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/** The subsystems for memory accounting. */
+enum MemoryTag
+{
+    MEMORY_IMAGES,
+    MEMORY_FEATURES,
+    MEMORY_MATCHES,
+    MEMORY_BA,
+    MEMORY_OTHER,
+    MEMORY_NUM_TAGS
+};
+
+/**
+ * Process-wide memory accounting.
+ *
+ * Allocations are reported per subsystem with allocated() and released(),
+ * usually through TrackedAllocator or the image storage, and the current
+ * and peak amount of bytes is kept for every tag. The counters are updated
+ * atomically and can be used from all threads. In addition, the resident
+ * set size of the process is queried from the operating system, which also
+ * covers untracked allocations and memory-mapped files.
+ */
+class MemoryAccounting
+{
+public:
+    /** Records an allocation of the given amount of bytes. */
+    static void allocated (MemoryTag tag, std::size_t bytes);
+    /** Records the release of the given amount of bytes. */
+    static void released (MemoryTag tag, std::size_t bytes);
+
+    /** Returns the currently allocated bytes for the tag. */
+    static std::size_t get_current (MemoryTag tag);
+    /** Returns the peak of allocated bytes for the tag. */
+    static std::size_t get_peak (MemoryTag tag);
+    /** Returns the amount of allocations for the tag. */
+    static std::size_t get_num_allocations (MemoryTag tag);
+    /** Resets the peaks of all tags to the current values. */
+    static void reset_peaks (void);
+
+    /** Returns a short name for the tag, e.g. "images". */
+    static char const* get_tag_name (MemoryTag tag);
+
+    /** Returns the resident set size of the process in bytes, or 0. */
+    static std::size_t get_current_rss (void);
+    /** Returns the peak resident set size of the process in bytes, or 0. */
+    static std::size_t get_peak_rss (void);
+
+    /** Returns a one line summary of the RSS and all tags. */
+    static std::string get_summary (void);
+    /** Prints a table of the RSS and all tags. */
+    static void print_report (std::ostream& out);
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Implements the STL allocator interface with std::allocator and records
+ * the allocations for the tag.
+ */
+template <typename T, MemoryTag TAG>
+struct TrackedAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef T const* const_pointer;
+    typedef T& reference;
+    typedef T const& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef TrackedAllocator<U, TAG> other;
+    };
+
+public:
+    TrackedAllocator (void) = default;
+
+    template <class U>
+    TrackedAllocator (TrackedAllocator<U, TAG> const& other);
+
+    pointer allocate (size_type n);
+    void deallocate (pointer p, size_type n);
+    size_type max_size (void) const;
+
+    template <class U>
+    bool operator== (TrackedAllocator<U, TAG> const& other) const;
+    template <class U>
+    bool operator!= (TrackedAllocator<U, TAG> const& other) const;
+};
+
+/** A vector whose memory is accounted for the tag. */
+template <typename T, MemoryTag TAG>
+using TrackedVector = std::vector<T, TrackedAllocator<T, TAG> >;
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Periodically logs the memory summary in a background thread.
+ * The reporter logs once more when it is destroyed, which records the
+ * peak values at the end of a run.
+ */
+class MemoryReporter
+{
+public:
+    explicit MemoryReporter (Logging const& logging,
+        std::chrono::milliseconds interval = std::chrono::seconds(10),
+        Logging::LogLevel level = Logging::LOG_INFO);
+    ~MemoryReporter (void);
+    MemoryReporter (MemoryReporter const& other) = delete;
+    MemoryReporter& operator= (MemoryReporter const& other) = delete;
+
+    /** Logs the summary now. */
+    void report (void) const;
+
+private:
+    void thread_main (void);
+
+private:
+    Logging const& logging;
+    std::chrono::milliseconds interval;
+    Logging::LogLevel level;
+    std::mutex mutex;
+    std::condition_variable stop_requested;
+    bool stop;
+    std::thread thread;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline
+TrackedAllocator<T, TAG>::TrackedAllocator
+    (TrackedAllocator<U, TAG> const& /*other*/)
+{
+}
+
+template <typename T, MemoryTag TAG>
+inline typename TrackedAllocator<T, TAG>::pointer
+TrackedAllocator<T, TAG>::allocate (size_type n)
+{
+    pointer p = std::allocator<T>().allocate(n);
+    MemoryAccounting::allocated(TAG, n * sizeof(T));
+    return p;
+}
+
+template <typename T, MemoryTag TAG>
+inline void
+TrackedAllocator<T, TAG>::deallocate (pointer p, size_type n)
+{
+    MemoryAccounting::released(TAG, n * sizeof(T));
+    std::allocator<T>().deallocate(p, n);
+}
+
+template <typename T, MemoryTag TAG>
+inline typename TrackedAllocator<T, TAG>::size_type
+TrackedAllocator<T, TAG>::max_size (void) const
+{
+    return std::numeric_limits<std::size_t>::max() / sizeof(T);
+}
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline bool
+TrackedAllocator<T, TAG>::operator==
+    (TrackedAllocator<U, TAG> const& /*other*/) const
+{
+    return true;
+}
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline bool
+TrackedAllocator<T, TAG>::operator!=
+    (TrackedAllocator<U, TAG> const& /*other*/) const
+{
+    return false;
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_MEMORY_HEADER */
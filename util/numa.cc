@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#   include <pthread.h>
+#   include <sched.h>
+#   include <sys/syscall.h> // SYS_mbind
+#   include <unistd.h>
+#endif
+
+#include "util/numa.h"
+
+UTIL_NAMESPACE_BEGIN
+
+namespace
+{
+    /* Parses a sysfs list like "0-3,8-11", returns false on errors. */
+    bool
+    parse_id_list (std::string const& str, std::vector<int>* ids)
+    {
+        ids->clear();
+        char const* ptr = str.c_str();
+        while (*ptr != '\0' && *ptr != '\n')
+        {
+            char* end = nullptr;
+            long const first = std::strtol(ptr, &end, 10);
+            if (end == ptr || first < 0)
+                return false;
+            long last = first;
+            ptr = end;
+            if (*ptr == '-')
+            {
+                last = std::strtol(ptr + 1, &end, 10);
+                if (end == ptr + 1 || last < first)
+                    return false;
+                ptr = end;
+            }
+            for (long i = first; i <= last; ++i)
+                ids->push_back(static_cast<int>(i));
+            if (*ptr == ',')
+                ptr += 1;
+        }
+        return true;
+    }
+
+    bool
+    read_id_list (std::string const& filename, std::vector<int>* ids)
+    {
+        std::ifstream in(filename.c_str());
+        std::string line;
+        if (!in.good() || !std::getline(in, line))
+            return false;
+        return parse_id_list(line, ids);
+    }
+
+    /* Returns the CPUs the process may run on, all CPUs if unknown. */
+    std::vector<int>
+    get_usable_cpus (void)
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (::sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        {
+            for (int i = 0; i < CPU_SETSIZE; ++i)
+                if (CPU_ISSET(i, &mask))
+                    cpus.push_back(i);
+            return cpus;
+        }
+#endif
+        unsigned int const num_cpus
+            = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < num_cpus; ++i)
+            cpus.push_back(static_cast<int>(i));
+        return cpus;
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+NumaTopology::NumaTopology (void)
+{
+    std::vector<int> const usable = get_usable_cpus();
+    int const max_cpu = usable.empty() ? 0 : usable.back();
+    this->cpu_nodes.resize(max_cpu + 1, -1);
+
+    std::vector<int> nodes;
+#if defined(__linux__)
+    std::string const sysfs_path = "/sys/devices/system/node/";
+    if (read_id_list(sysfs_path + "online", &nodes) && !nodes.empty())
+    {
+        this->node_cpus.resize(nodes.back() + 1);
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+        {
+            std::vector<int> cpus;
+            if (!read_id_list(sysfs_path + "node" + std::to_string(nodes[i])
+                + "/cpulist", &cpus))
+                continue;
+            for (std::size_t j = 0; j < cpus.size(); ++j)
+            {
+                if (!std::binary_search(usable.begin(), usable.end(),
+                    cpus[j]))
+                    continue;
+                this->node_cpus[nodes[i]].push_back(cpus[j]);
+                this->cpu_nodes[cpus[j]] = nodes[i];
+            }
+        }
+    }
+#endif
+
+    /* Without NUMA information, all CPUs are on node 0. */
+    if (std::count(this->cpu_nodes.begin(), this->cpu_nodes.end(), -1)
+        == static_cast<std::ptrdiff_t>(this->cpu_nodes.size()))
+    {
+        this->node_cpus.assign(1, usable);
+        for (std::size_t i = 0; i < usable.size(); ++i)
+            this->cpu_nodes[usable[i]] = 0;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+NumaTopology const&
+NumaTopology::get (void)
+{
+    static NumaTopology const topology;
+    return topology;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+NumaTopology::get_num_cpus (void) const
+{
+    std::size_t num_cpus = 0;
+    for (std::size_t i = 0; i < this->node_cpus.size(); ++i)
+        num_cpus += this->node_cpus[i].size();
+    return num_cpus;
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+NumaTopology::get_node_of_cpu (int cpu) const
+{
+    if (cpu < 0 || cpu >= static_cast<int>(this->cpu_nodes.size()))
+        return -1;
+    return this->cpu_nodes[cpu];
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+get_current_cpu (void)
+{
+#if defined(__linux__)
+    return ::sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+get_current_numa_node (void)
+{
+    return NumaTopology::get().get_node_of_cpu(get_current_cpu());
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+set_thread_affinity (std::vector<int> const& cpus)
+{
+#if defined(__linux__)
+    if (cpus.empty())
+        return false;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (std::size_t i = 0; i < cpus.size(); ++i)
+    {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE)
+            return false;
+        CPU_SET(cpus[i], &mask);
+    }
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(mask),
+        &mask) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+move_to_numa_node (void const* data, std::size_t bytes, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    /* The constants of <linux/mempolicy.h>, which is not always present. */
+    int const mpol_preferred = 1;
+    unsigned int const mpol_mf_move = 1 << 1;
+    std::size_t const bits = 8 * sizeof(unsigned long);
+
+    if (node < 0 || node >= static_cast<int>(
+        NumaTopology::get().get_num_nodes()))
+        return false;
+
+    std::uintptr_t const page_size = ::sysconf(_SC_PAGESIZE);
+    std::uintptr_t const begin = (reinterpret_cast<std::uintptr_t>(data)
+        + page_size - 1) / page_size * page_size;
+    std::uintptr_t const end = (reinterpret_cast<std::uintptr_t>(data)
+        + bytes) / page_size * page_size;
+    if (begin >= end)
+        return true;
+
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1ul << (node % bits);
+    return ::syscall(SYS_mbind, begin, end - begin, mpol_preferred,
+        mask.data(), mask.size() * bits + 1, mpol_mf_move) == 0;
+#else
+    (void)data;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+UTIL_NAMESPACE_END
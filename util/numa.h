@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_NUMA_HEADER
+#define UTIL_NUMA_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "util/defines.h"
+#include "util/memory.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/**
+ * The NUMA nodes of the system and their CPUs.
+ *
+ * On Linux, the topology is read from sysfs and restricted to the CPUs the
+ * process may run on. Systems without NUMA information are described as a
+ * single node with all CPUs. Node IDs are the IDs of the operating system,
+ * nodes without usable CPUs have an empty CPU list.
+ */
+class NumaTopology
+{
+public:
+    /** Returns the topology of the system, which is read on first use. */
+    static NumaTopology const& get (void);
+
+    /** Returns the amount of nodes, i.e. the largest node ID plus one. */
+    std::size_t get_num_nodes (void) const;
+    /** Returns the amount of usable CPUs of all nodes. */
+    std::size_t get_num_cpus (void) const;
+    /** Returns the usable CPUs of the node in ascending order. */
+    std::vector<int> const& get_node_cpus (std::size_t node) const;
+    /** Returns the node of the CPU, or -1 if the CPU is unknown. */
+    int get_node_of_cpu (int cpu) const;
+
+private:
+    NumaTopology (void);
+
+private:
+    std::vector<std::vector<int> > node_cpus;
+    std::vector<int> cpu_nodes;
+};
+
+/* ---------------------------------------------------------------- */
+
+/** Returns the CPU of the calling thread, or -1 if unknown. */
+int get_current_cpu (void);
+
+/** Returns the NUMA node of the calling thread, or -1 if unknown. */
+int get_current_numa_node (void);
+
+/**
+ * Restricts the calling thread to the given CPUs. Returns false if thread
+ * affinity is not supported or the CPUs are not available.
+ */
+bool set_thread_affinity (std::vector<int> const& cpus);
+
+/**
+ * Moves the pages of the memory range to the NUMA node, and makes the node
+ * the preferred node for pages that are not allocated yet. Only the pages
+ * entirely within the range are moved. Returns false if this is not
+ * supported, e.g. without NUMA or on systems other than Linux.
+ */
+bool move_to_numa_node (void const* data, std::size_t bytes, int node);
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Tracked allocator that leaves new elements uninitialized for
+ * value-initialization, e.g. with resize(). The operating system places
+ * the pages of a buffer on the NUMA node of the thread that first writes
+ * them, and the elements can be initialized by the threads that later
+ * process them, e.g. with first_touch_fill(). Only use this for trivial
+ * types and initialize all elements before reading them.
+ */
+template <typename T, MemoryTag TAG>
+struct FirstTouchAllocator : public TrackedAllocator<T, TAG>
+{
+public:
+    template <class U>
+    struct rebind
+    {
+        typedef FirstTouchAllocator<U, TAG> other;
+    };
+
+public:
+    FirstTouchAllocator (void) = default;
+
+    template <class U>
+    FirstTouchAllocator (FirstTouchAllocator<U, TAG> const& other);
+
+    template <class U>
+    void construct (U* p);
+    template <class U, typename... ARGS>
+    void construct (U* p, ARGS&&... args);
+
+    template <class U>
+    bool operator== (FirstTouchAllocator<U, TAG> const& other) const;
+    template <class U>
+    bool operator!= (FirstTouchAllocator<U, TAG> const& other) const;
+};
+
+/** A tracked vector with elements placed by first touch. */
+template <typename T, MemoryTag TAG>
+using FirstTouchVector = std::vector<T, FirstTouchAllocator<T, TAG> >;
+
+/**
+ * Fills the range with the OpenMP threads in static schedule, which places
+ * the pages on the nodes of the threads that process the range with the
+ * same schedule. The OpenMP threads should be bound to cores for this,
+ * e.g. with OMP_PROC_BIND=close or spread.
+ */
+template <typename T>
+void
+first_touch_fill (T* data, std::size_t size, T const& value);
+
+/* ------------------------ Implementation ------------------------ */
+
+inline std::size_t
+NumaTopology::get_num_nodes (void) const
+{
+    return this->node_cpus.size();
+}
+
+inline std::vector<int> const&
+NumaTopology::get_node_cpus (std::size_t node) const
+{
+    return this->node_cpus[node];
+}
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline
+FirstTouchAllocator<T, TAG>::FirstTouchAllocator
+    (FirstTouchAllocator<U, TAG> const& /*other*/)
+{
+}
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline void
+FirstTouchAllocator<T, TAG>::construct (U* p)
+{
+    ::new(static_cast<void*>(p)) U;
+}
+
+template <typename T, MemoryTag TAG>
+template <class U, typename... ARGS>
+inline void
+FirstTouchAllocator<T, TAG>::construct (U* p, ARGS&&... args)
+{
+    ::new(static_cast<void*>(p)) U(std::forward<ARGS>(args)...);
+}
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline bool
+FirstTouchAllocator<T, TAG>::operator==
+    (FirstTouchAllocator<U, TAG> const& /*other*/) const
+{
+    return true;
+}
+
+template <typename T, MemoryTag TAG>
+template <class U>
+inline bool
+FirstTouchAllocator<T, TAG>::operator!=
+    (FirstTouchAllocator<U, TAG> const& /*other*/) const
+{
+    return false;
+}
+
+template <typename T>
+void
+first_touch_fill (T* data, std::size_t size, T const& value)
+{
+    std::int64_t const num = static_cast<std::int64_t>(size);
+#pragma omp parallel for schedule(static) if (size >= (1 << 16))
+    for (std::int64_t i = 0; i < num; ++i)
+        data[i] = value;
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_NUMA_HEADER */
@@ -0,0 +1,580 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#if defined(__linux__)
+#   include <linux/perf_event.h>
+#   include <sys/syscall.h> // SYS_perf_event_open
+#   include <unistd.h>
+#endif
+
+#include "util/exception.h"
+#include "util/profiler.h"
+
+UTIL_NAMESPACE_BEGIN
+
+namespace
+{
+    struct Event
+    {
+        char const* name;
+        std::int64_t start;
+        std::int64_t end;
+        int depth;
+        bool has_counters;
+        std::uint64_t counters[Profiler::NUM_COUNTERS];
+    };
+
+    struct ThreadBuffer
+    {
+        std::vector<Event> events;
+        /* The amount of recorded events, the ring position modulo size. */
+        std::atomic<std::size_t> num_recorded;
+        std::size_t thread_id;
+    };
+
+    typedef std::vector<std::shared_ptr<ThreadBuffer> > BufferList;
+
+    std::atomic<bool> profiling_enabled(true);
+    std::atomic<std::size_t> events_per_buffer(1 << 16);
+
+    /* The buffers outlive their threads for the export. */
+    std::mutex buffers_mutex;
+    BufferList&
+    get_buffers (void)
+    {
+        static BufferList buffers;
+        return buffers;
+    }
+
+    thread_local ThreadBuffer* thread_buffer = nullptr;
+    thread_local int scope_depth = 0;
+
+    /* ------------------------------------------------------------ */
+
+    std::atomic<bool> counters_enabled(false);
+
+    /* The counters of a thread, opened as one group on first use. */
+    struct CounterGroup
+    {
+        CounterGroup (void);
+        ~CounterGroup (void);
+        bool open (void);
+        void close (void);
+
+        int fds[Profiler::NUM_COUNTERS];
+        bool opened;
+    };
+
+    thread_local CounterGroup counter_group;
+
+    CounterGroup::CounterGroup (void)
+        : opened(false)
+    {
+        std::fill(this->fds, this->fds + Profiler::NUM_COUNTERS, -1);
+    }
+
+    CounterGroup::~CounterGroup (void)
+    {
+        this->close();
+    }
+
+    /* Returns false if any of the counters is not available. */
+    bool
+    CounterGroup::open (void)
+    {
+        if (this->opened)
+            return this->fds[0] >= 0;
+        this->opened = true;
+#if defined(__linux__)
+        std::uint64_t const configs[Profiler::NUM_COUNTERS] =
+        {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int i = 0; i < Profiler::NUM_COUNTERS; ++i)
+        {
+            /* The cycles counter leads the group, which is read at once. */
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP
+                | PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            this->fds[i] = static_cast<int>(::syscall(SYS_perf_event_open,
+                &attr, 0, -1, i == 0 ? -1 : this->fds[0], 0));
+            if (this->fds[i] < 0)
+            {
+                this->close();
+                return false;
+            }
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void
+    CounterGroup::close (void)
+    {
+#if defined(__linux__)
+        for (int i = Profiler::NUM_COUNTERS - 1; i >= 0; --i)
+            if (this->fds[i] >= 0)
+                ::close(this->fds[i]);
+#endif
+        std::fill(this->fds, this->fds + Profiler::NUM_COUNTERS, -1);
+    }
+
+    ThreadBuffer*
+    get_thread_buffer (void)
+    {
+        if (thread_buffer != nullptr)
+            return thread_buffer;
+
+        std::shared_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->events.resize(std::max<std::size_t>(1, events_per_buffer));
+        buffer->num_recorded = 0;
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffer->thread_id = get_buffers().size();
+        get_buffers().push_back(buffer);
+        thread_buffer = buffer.get();
+        return thread_buffer;
+    }
+
+    /* Copies the events of a buffer in the order of recording. */
+    void
+    collect_events (ThreadBuffer const& buffer, std::vector<Event>* events)
+    {
+        std::size_t const size = buffer.events.size();
+        std::size_t const num = buffer.num_recorded;
+        events->clear();
+        if (num <= size)
+        {
+            events->assign(buffer.events.begin(), buffer.events.begin() + num);
+            return;
+        }
+        std::size_t const first = num % size;
+        events->assign(buffer.events.begin() + first, buffer.events.end());
+        events->insert(events->end(), buffer.events.begin(),
+            buffer.events.begin() + first);
+    }
+
+    /* Copies the list of buffers, which may grow during the export. */
+    BufferList
+    copy_buffers (void)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        return get_buffers();
+    }
+
+    struct ReportNode
+    {
+        ReportNode (void);
+
+        std::string name;
+        std::size_t count;
+        std::int64_t total_ns;
+        std::int64_t children_ns;
+        std::size_t counter_count;
+        std::uint64_t counters[Profiler::NUM_COUNTERS];
+        std::vector<std::size_t> children;
+    };
+
+    ReportNode::ReportNode (void)
+        : count(0)
+        , total_ns(0)
+        , children_ns(0)
+        , counter_count(0)
+    {
+        std::fill(this->counters, this->counters + Profiler::NUM_COUNTERS, 0);
+    }
+
+    void
+    append_report (std::vector<ReportNode> const& nodes, std::size_t node_id,
+        int depth, Profiler::Report* report)
+    {
+        std::vector<std::size_t> children = nodes[node_id].children;
+        std::sort(children.begin(), children.end(),
+            [&nodes] (std::size_t a, std::size_t b)
+            { return nodes[a].total_ns > nodes[b].total_ns; });
+        for (std::size_t i = 0; i < children.size(); ++i)
+        {
+            ReportNode const& node = nodes[children[i]];
+            Profiler::ReportEntry entry;
+            entry.name = node.name;
+            entry.depth = depth;
+            entry.count = node.count;
+            entry.total_ms = static_cast<double>(node.total_ns) / 1e6;
+            entry.self_ms = static_cast<double>(node.total_ns
+                - node.children_ns) / 1e6;
+            entry.counter_count = node.counter_count;
+            std::copy(node.counters, node.counters + Profiler::NUM_COUNTERS,
+                entry.counters);
+            report->push_back(entry);
+            append_report(nodes, children[i], depth + 1, report);
+        }
+    }
+
+    void
+    write_json_string (std::ostream& out, char const* str)
+    {
+        out << '"';
+        for (; *str != '\0'; ++str)
+        {
+            if (*str == '"' || *str == '\\')
+                out << '\\';
+            out << *str;
+        }
+        out << '"';
+    }
+
+    /* Returns the ratio of two counters, or zero for an empty divisor. */
+    double
+    counter_ratio (std::uint64_t value, std::uint64_t divisor)
+    {
+        return divisor == 0 ? 0.0 : static_cast<double>(value)
+            / static_cast<double>(divisor);
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+void
+Profiler::set_enabled (bool enabled)
+{
+    profiling_enabled = enabled;
+}
+
+bool
+Profiler::is_enabled (void)
+{
+    return profiling_enabled.load(std::memory_order_relaxed);
+}
+
+void
+Profiler::set_buffer_size (std::size_t num_events)
+{
+    events_per_buffer = num_events;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Profiler::clear (void)
+{
+    BufferList buffers = copy_buffers();
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+        buffers[i]->num_recorded = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+Profiler::get_num_dropped (void)
+{
+    BufferList buffers = copy_buffers();
+    std::size_t num_dropped = 0;
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+    {
+        std::size_t const num = buffers[i]->num_recorded;
+        std::size_t const size = buffers[i]->events.size();
+        num_dropped += num > size ? num - size : 0;
+    }
+    return num_dropped;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+Profiler::set_counters_enabled (bool enabled)
+{
+    if (!enabled)
+    {
+        counters_enabled = false;
+        return true;
+    }
+    if (!counter_group.open())
+        return false;
+    counters_enabled = true;
+    return true;
+}
+
+bool
+Profiler::is_counters_enabled (void)
+{
+    return counters_enabled.load(std::memory_order_relaxed);
+}
+
+char const*
+Profiler::get_counter_name (Counter counter)
+{
+    switch (counter)
+    {
+        case COUNTER_CYCLES: return "cycles";
+        case COUNTER_INSTRUCTIONS: return "instructions";
+        case COUNTER_LLC_MISSES: return "llc_misses";
+        case COUNTER_BRANCH_MISSES: return "branch_misses";
+        default: return "unknown";
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+Profiler::read_counters (std::uint64_t* values)
+{
+#if defined(__linux__)
+    if (!counter_group.open())
+        return false;
+
+    /* The group format: count, time enabled, time running, values. */
+    std::uint64_t data[3 + NUM_COUNTERS];
+    ssize_t const size = ::read(counter_group.fds[0], data, sizeof(data));
+    if (size != static_cast<ssize_t>(sizeof(data)) || data[0] != NUM_COUNTERS)
+        return false;
+
+    /* Scale for multiplexing with other users of the counters. */
+    double const scale = data[2] > 0 && data[2] < data[1]
+        ? static_cast<double>(data[1]) / static_cast<double>(data[2]) : 1.0;
+    for (int i = 0; i < NUM_COUNTERS; ++i)
+        values[i] = static_cast<std::uint64_t>(
+            static_cast<double>(data[3 + i]) * scale);
+    return true;
+#else
+    (void)values;
+    return false;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Profiler::record (char const* name, std::int64_t start_ns,
+    std::int64_t end_ns, int depth, std::uint64_t const* counters)
+{
+    ThreadBuffer* buffer = get_thread_buffer();
+    std::size_t const index
+        = buffer->num_recorded.load(std::memory_order_relaxed);
+    Event& event = buffer->events[index % buffer->events.size()];
+    event.name = name;
+    event.start = start_ns;
+    event.end = end_ns;
+    event.depth = depth;
+    event.has_counters = counters != nullptr;
+    if (counters != nullptr)
+        std::copy(counters, counters + NUM_COUNTERS, event.counters);
+    buffer->num_recorded.store(index + 1, std::memory_order_release);
+}
+
+/* ---------------------------------------------------------------- */
+
+std::int64_t
+Profiler::now (void)
+{
+    typedef std::chrono::steady_clock Clock;
+    static Clock::time_point const epoch = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (Clock::now() - epoch).count();
+}
+
+/* ---------------------------------------------------------------- */
+
+int&
+Profiler::thread_depth (void)
+{
+    return scope_depth;
+}
+
+/* ---------------------------------------------------------------- */
+
+Profiler::Report
+Profiler::get_report (void)
+{
+    /* Node 0 is the root, nodes are identified by parent and name. */
+    std::vector<ReportNode> nodes(1);
+    std::map<std::pair<std::size_t, std::string>, std::size_t> node_ids;
+
+    BufferList buffers = copy_buffers();
+    std::vector<Event> events;
+    std::vector<std::size_t> open_nodes;
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+    {
+        /*
+         * Events are recorded when the scopes end. Ordered by start time,
+         * the enclosing scope of an event is the last one before it with
+         * a smaller depth. Scopes whose parents have been overwritten in
+         * the ring buffer are attached to the deepest known scope.
+         */
+        collect_events(*buffers[i], &events);
+        std::sort(events.begin(), events.end(),
+            [] (Event const& a, Event const& b)
+            { return a.start < b.start
+                || (a.start == b.start && a.depth < b.depth); });
+
+        open_nodes.clear();
+        for (std::size_t j = 0; j < events.size(); ++j)
+        {
+            Event const& event = events[j];
+            std::size_t const depth = std::min(open_nodes.size(),
+                static_cast<std::size_t>(std::max(0, event.depth)));
+            open_nodes.resize(depth);
+            std::size_t const parent = depth == 0 ? 0 : open_nodes.back();
+
+            std::pair<std::size_t, std::string> key(parent, event.name);
+            std::map<std::pair<std::size_t, std::string>,
+                std::size_t>::iterator iter = node_ids.find(key);
+            std::size_t node_id;
+            if (iter == node_ids.end())
+            {
+                node_id = nodes.size();
+                node_ids.insert(std::make_pair(key, node_id));
+                ReportNode node;
+                node.name = event.name;
+                nodes.push_back(node);
+                nodes[parent].children.push_back(node_id);
+            }
+            else
+                node_id = iter->second;
+
+            std::int64_t const duration = event.end - event.start;
+            nodes[node_id].count += 1;
+            nodes[node_id].total_ns += duration;
+            nodes[parent].children_ns += duration;
+            if (event.has_counters)
+            {
+                nodes[node_id].counter_count += 1;
+                for (int k = 0; k < NUM_COUNTERS; ++k)
+                    nodes[node_id].counters[k] += event.counters[k];
+            }
+            open_nodes.push_back(node_id);
+        }
+    }
+
+    Report report;
+    append_report(nodes, 0, 0, &report);
+    return report;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Profiler::print_report (std::ostream& out)
+{
+    Report report = Profiler::get_report();
+    bool has_counters = false;
+    for (std::size_t i = 0; i < report.size(); ++i)
+        has_counters = has_counters || report[i].counter_count > 0;
+
+    /* The miss rates are given per thousand instructions (MPKI). */
+    std::ios_base::fmtflags const flags = out.flags();
+    out << std::setw(12) << "Total ms" << std::setw(12) << "Self ms"
+        << std::setw(10) << "Calls";
+    if (has_counters)
+        out << std::setw(8) << "IPC" << std::setw(10) << "LLC MPKI"
+            << std::setw(10) << "Br MPKI";
+    out << "  Scope" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (std::size_t i = 0; i < report.size(); ++i)
+    {
+        ReportEntry const& entry = report[i];
+        out << std::setw(12) << entry.total_ms
+            << std::setw(12) << entry.self_ms
+            << std::setw(10) << entry.count;
+        if (has_counters && entry.counter_count == 0)
+            out << std::setw(28) << "";
+        else if (has_counters)
+        {
+            std::uint64_t const kilo_instructions
+                = entry.counters[COUNTER_INSTRUCTIONS] / 1000;
+            out << std::setprecision(2)
+                << std::setw(8) << counter_ratio(
+                entry.counters[COUNTER_INSTRUCTIONS],
+                entry.counters[COUNTER_CYCLES])
+                << std::setw(10) << counter_ratio(
+                entry.counters[COUNTER_LLC_MISSES], kilo_instructions)
+                << std::setw(10) << counter_ratio(
+                entry.counters[COUNTER_BRANCH_MISSES], kilo_instructions)
+                << std::setprecision(3);
+        }
+        out << "  " << std::string(2 * entry.depth, ' ') << entry.name
+            << std::endl;
+    }
+    out.flags(flags);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Profiler::write_chrome_trace (std::ostream& out)
+{
+    /* Complete events with times in micro seconds. */
+    BufferList buffers = copy_buffers();
+    std::vector<Event> events;
+    std::ios_base::fmtflags const flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+    {
+        collect_events(*buffers[i], &events);
+        for (std::size_t j = 0; j < events.size(); ++j)
+        {
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\":";
+            write_json_string(out, events[j].name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffers[i]->thread_id
+                << ",\"ts\":" << static_cast<double>(events[j].start) / 1e3
+                << ",\"dur\":" << static_cast<double>(events[j].end
+                - events[j].start) / 1e3;
+            if (events[j].has_counters)
+            {
+                out << ",\"args\":{";
+                for (int k = 0; k < NUM_COUNTERS; ++k)
+                    out << (k > 0 ? "," : "") << "\""
+                        << get_counter_name(static_cast<Counter>(k))
+                        << "\":" << events[j].counters[k];
+                out << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    out.flags(flags);
+}
+
+void
+Profiler::write_chrome_trace (std::string const& filename)
+{
+    std::ofstream out(filename.c_str());
+    if (!out.good())
+        throw util::FileException(filename, std::strerror(errno));
+    Profiler::write_chrome_trace(out);
+    out.close();
+}
+
+UTIL_NAMESPACE_END
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ *
+ * Scoped profiling with per-thread event buffers. Instrument code with
+ *
+ *     UTIL_PROFILE_SCOPE("Sift::extrema_detection");
+ *
+ * which records the time until the end of the enclosing scope. The macros
+ * compile to nothing unless UTIL_ENABLE_PROFILING is defined, e.g. with
+ * the ENABLE_PROFILING option of CMake. Recording is further switched at
+ * runtime with Profiler::set_enabled().
+ *
+ * On Linux, the scopes can additionally sample the hardware performance
+ * counters of the thread with Profiler::set_counters_enabled(), which
+ * shows the instructions per cycle and the cache and branch miss rates of
+ * every scope.
+ */
+#ifndef UTIL_PROFILER_HEADER
+#define UTIL_PROFILER_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "util/defines.h"
+
+#define UTIL_PROFILE_CONCAT_IMPL(a, b) a##b
+#define UTIL_PROFILE_CONCAT(a, b) UTIL_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef UTIL_ENABLE_PROFILING
+#   define UTIL_PROFILE_SCOPE(name) ::util::ProfileScope \
+        UTIL_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#   define UTIL_PROFILE_FUNCTION() UTIL_PROFILE_SCOPE(__func__)
+#else
+#   define UTIL_PROFILE_SCOPE(name) do {} while (false)
+#   define UTIL_PROFILE_FUNCTION() do {} while (false)
+#endif
+
+UTIL_NAMESPACE_BEGIN
+
+/**
+ * Collects the scopes timed by ProfileScope.
+ *
+ * Every thread records finished scopes into its own ring buffer without
+ * locking. A full buffer overwrites the oldest events, so long runs keep
+ * the most recent events. The events are combined into a hierarchical
+ * report, where scopes with the same name and the same enclosing scopes
+ * are aggregated over all calls and threads, and exported as Chrome trace
+ * JSON for chrome://tracing and Perfetto. The export and clear() must not
+ * run concurrently with instrumented code.
+ */
+class Profiler
+{
+public:
+    /** The hardware counters sampled per scope. */
+    enum Counter
+    {
+        COUNTER_CYCLES,
+        COUNTER_INSTRUCTIONS,
+        /** Misses of the last level cache. */
+        COUNTER_LLC_MISSES,
+        COUNTER_BRANCH_MISSES,
+        NUM_COUNTERS
+    };
+
+    /** A node of the hierarchical report. */
+    struct ReportEntry
+    {
+        /** The scope name. */
+        std::string name;
+        /** The nesting depth, 0 for top level scopes. */
+        int depth;
+        /** The number of calls. */
+        std::size_t count;
+        /** The total time in the scope in milli seconds. */
+        double total_ms;
+        /** The total time excluding child scopes in milli seconds. */
+        double self_ms;
+        /** The number of calls with hardware counters. */
+        std::size_t counter_count;
+        /** The hardware counters summed up over these calls. */
+        std::uint64_t counters[NUM_COUNTERS];
+    };
+
+    typedef std::vector<ReportEntry> Report;
+
+public:
+    /** Switches recording at runtime, enabled by default. */
+    static void set_enabled (bool enabled);
+    static bool is_enabled (void);
+
+    /** Sets the events per thread buffer, applies to new threads only. */
+    static void set_buffer_size (std::size_t num_events);
+
+    /** Discards all recorded events. */
+    static void clear (void);
+
+    /** Returns the report in depth-first order, children by total time. */
+    static Report get_report (void);
+    /** Prints the report as an indented table. */
+    static void print_report (std::ostream& out);
+
+    /** Writes all events in the Chrome trace event format. */
+    static void write_chrome_trace (std::ostream& out);
+    static void write_chrome_trace (std::string const& filename);
+
+    /** Returns the amount of events lost to full buffers. */
+    static std::size_t get_num_dropped (void);
+
+    /**
+     * Switches sampling of the hardware counters with perf_event_open(),
+     * disabled by default. Every thread opens its counters on first use,
+     * which only counts user space. Reading the counters is a system call
+     * at the start and end of every scope, so sampling is meant for scopes
+     * that run for micro seconds or longer. Returns false if the counters
+     * are not available to the calling thread, e.g. on other systems than
+     * Linux or if perf_event_paranoid forbids them.
+     */
+    static bool set_counters_enabled (bool enabled);
+    static bool is_counters_enabled (void);
+
+    /** Returns a short name of a counter, e.g. "instructions". */
+    static char const* get_counter_name (Counter counter);
+
+    /**
+     * Reads the counters of the calling thread, scaled for the time the
+     * counters were not scheduled. Returns false if they are unavailable.
+     */
+    static bool read_counters (std::uint64_t* values);
+
+    /**
+     * Records a finished scope. Names must be string literals. The counter
+     * deltas of the scope are optional.
+     */
+    static void record (char const* name, std::int64_t start_ns,
+        std::int64_t end_ns, int depth,
+        std::uint64_t const* counters = nullptr);
+
+    /** Returns the nanoseconds since the start of the process. */
+    static std::int64_t now (void);
+
+    /** Returns the nesting depth of the calling thread, see ProfileScope. */
+    static int& thread_depth (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+/** Times the lifetime of the object, see UTIL_PROFILE_SCOPE. */
+class ProfileScope
+{
+public:
+    explicit ProfileScope (char const* name);
+    ~ProfileScope (void);
+    ProfileScope (ProfileScope const& other) = delete;
+    ProfileScope& operator= (ProfileScope const& other) = delete;
+
+private:
+    char const* name;
+    std::int64_t start;
+    bool has_counters;
+    std::uint64_t start_counters[Profiler::NUM_COUNTERS];
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+ProfileScope::ProfileScope (char const* name)
+    : name(Profiler::is_enabled() ? name : nullptr)
+    , start(0)
+    , has_counters(false)
+{
+    if (this->name == nullptr)
+        return;
+    Profiler::thread_depth() += 1;
+    this->start = Profiler::now();
+    /* The counters are read last to exclude the profiler. */
+    if (Profiler::is_counters_enabled())
+        this->has_counters = Profiler::read_counters(this->start_counters);
+}
+
+inline
+ProfileScope::~ProfileScope (void)
+{
+    if (this->name == nullptr)
+        return;
+    std::uint64_t counters[Profiler::NUM_COUNTERS];
+    bool const has_counters = this->has_counters
+        && Profiler::read_counters(counters);
+    std::int64_t const end = Profiler::now();
+    int const depth = --Profiler::thread_depth();
+    if (!has_counters)
+    {
+        Profiler::record(this->name, this->start, end, depth);
+        return;
+    }
+    for (int i = 0; i < Profiler::NUM_COUNTERS; ++i)
+        counters[i] -= this->start_counters[i];
+    Profiler::record(this->name, this->start, end, depth, counters);
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_PROFILER_HEADER */
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_PROGRESS_HEADER
+#define UTIL_PROGRESS_HEADER
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "util/defines.h"
+#include "util/exception.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/** Thrown by stages that stop because cancellation was requested. */
+class CancelledException : public Exception
+{
+public:
+    CancelledException (std::string const& msg) throw()
+        : Exception(msg)
+    { }
+
+    virtual ~CancelledException (void) throw()
+    { }
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Flag for cooperative cancellation. Any thread, e.g. the one of a job
+ * scheduler, requests cancellation with cancel(), and the stages that use
+ * the token poll it at iteration and chunk boundaries.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken (void);
+    CancellationToken (CancellationToken const& other) = delete;
+    CancellationToken& operator= (CancellationToken const& other) = delete;
+
+    /** Requests cancellation of all stages that use the token. */
+    void cancel (void);
+    /** Clears the request, e.g. before resuming a job. */
+    void reset (void);
+    /** Returns true if cancellation was requested. */
+    bool is_cancelled (void) const;
+
+private:
+    std::atomic<bool> cancelled;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Callback for the progress of a stage with the amount of finished and of
+ * total work units, e.g. iterations, image pairs or views.
+ */
+typedef std::function<void (std::size_t num_done, std::size_t num_total)>
+    ProgressCallback;
+
+/**
+ * The optional cancellation token and progress callback of a long-running
+ * stage, which is usually part of the stage options.
+ *
+ * A stage checks for cancellation at its iteration or chunk boundaries and
+ * stops with a consistent state, as documented by the stage. Stages that
+ * cannot return partial results throw CancelledException. Reports of
+ * parallel stages are serialized, but may come from any thread, so the
+ * callback must not block for long.
+ */
+class StageControl
+{
+public:
+    StageControl (void);
+    StageControl (CancellationToken const* token,
+        ProgressCallback const& callback = ProgressCallback());
+
+    /** Returns true if cancellation was requested for the stage. */
+    bool is_cancelled (void) const;
+    /** Throws CancelledException with the message if cancelled. */
+    void check_cancelled (char const* message) const;
+    /** Reports the progress to the callback, if any. */
+    void report (std::size_t num_done, std::size_t num_total) const;
+
+public:
+    /** The cancellation token, or null to never cancel. */
+    CancellationToken const* cancel_token;
+    /** The progress callback, or empty for no reports. */
+    ProgressCallback progress_callback;
+
+private:
+    /* Shared by copies of the options within a stage. */
+    std::shared_ptr<std::mutex> mutex;
+};
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+CancellationToken::CancellationToken (void)
+    : cancelled(false)
+{
+}
+
+inline void
+CancellationToken::cancel (void)
+{
+    this->cancelled.store(true, std::memory_order_release);
+}
+
+inline void
+CancellationToken::reset (void)
+{
+    this->cancelled.store(false, std::memory_order_release);
+}
+
+inline bool
+CancellationToken::is_cancelled (void) const
+{
+    return this->cancelled.load(std::memory_order_acquire);
+}
+
+inline
+StageControl::StageControl (void)
+    : cancel_token(nullptr)
+    , mutex(std::make_shared<std::mutex>())
+{
+}
+
+inline
+StageControl::StageControl (CancellationToken const* token,
+    ProgressCallback const& callback)
+    : cancel_token(token)
+    , progress_callback(callback)
+    , mutex(std::make_shared<std::mutex>())
+{
+}
+
+inline bool
+StageControl::is_cancelled (void) const
+{
+    return this->cancel_token != nullptr && this->cancel_token->is_cancelled();
+}
+
+inline void
+StageControl::check_cancelled (char const* message) const
+{
+    if (this->is_cancelled())
+        throw CancelledException(message);
+}
+
+inline void
+StageControl::report (std::size_t num_done, std::size_t num_total) const
+{
+    if (!this->progress_callback)
+        return;
+    std::lock_guard<std::mutex> lock(*this->mutex);
+    this->progress_callback(num_done, num_total);
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_PROGRESS_HEADER */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_STRING_VIEW_HEADER
+#define UTIL_STRING_VIEW_HEADER
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#include "util/defines.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/**
+ * Non-owning reference to a range of characters, the subset of
+ * std::string_view that is needed for parsing. The referenced string must
+ * outlive the view, and the range is not null-terminated in general.
+ */
+class StringView
+{
+public:
+    typedef char const* iterator;
+    typedef char const* const_iterator;
+
+    static std::size_t const npos = static_cast<std::size_t>(-1);
+
+public:
+    StringView (void);
+    StringView (char const* str);
+    StringView (char const* str, std::size_t size);
+    StringView (std::string const& str);
+
+    char const* data (void) const;
+    std::size_t size (void) const;
+    bool empty (void) const;
+    char const* begin (void) const;
+    char const* end (void) const;
+    char const& operator[] (std::size_t index) const;
+
+    /** Returns the view of at most 'len' characters starting at 'pos'. */
+    StringView substr (std::size_t pos, std::size_t len = npos) const;
+    /** Returns the position of the character at or after 'pos', or npos. */
+    std::size_t find (char chr, std::size_t pos = 0) const;
+
+    /** Returns a copy of the characters. */
+    std::string to_string (void) const;
+
+private:
+    char const* str;
+    std::size_t len;
+};
+
+bool operator== (StringView const& lhs, StringView const& rhs);
+bool operator!= (StringView const& lhs, StringView const& rhs);
+std::ostream& operator<< (std::ostream& out, StringView const& view);
+
+/* ------------------------ Implementation ------------------------ */
+
+inline
+StringView::StringView (void)
+    : str(""), len(0)
+{
+}
+
+inline
+StringView::StringView (char const* str)
+    : str(str), len(std::strlen(str))
+{
+}
+
+inline
+StringView::StringView (char const* str, std::size_t size)
+    : str(str), len(size)
+{
+}
+
+inline
+StringView::StringView (std::string const& str)
+    : str(str.data()), len(str.size())
+{
+}
+
+inline char const*
+StringView::data (void) const
+{
+    return this->str;
+}
+
+inline std::size_t
+StringView::size (void) const
+{
+    return this->len;
+}
+
+inline bool
+StringView::empty (void) const
+{
+    return this->len == 0;
+}
+
+inline char const*
+StringView::begin (void) const
+{
+    return this->str;
+}
+
+inline char const*
+StringView::end (void) const
+{
+    return this->str + this->len;
+}
+
+inline char const&
+StringView::operator[] (std::size_t index) const
+{
+    return this->str[index];
+}
+
+inline StringView
+StringView::substr (std::size_t pos, std::size_t len) const
+{
+    pos = std::min(pos, this->len);
+    return StringView(this->str + pos, std::min(len, this->len - pos));
+}
+
+inline std::size_t
+StringView::find (char chr, std::size_t pos) const
+{
+    for (; pos < this->len; ++pos)
+        if (this->str[pos] == chr)
+            return pos;
+    return npos;
+}
+
+inline std::string
+StringView::to_string (void) const
+{
+    return std::string(this->str, this->len);
+}
+
+inline bool
+operator== (StringView const& lhs, StringView const& rhs)
+{
+    return lhs.size() == rhs.size()
+        && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+inline bool
+operator!= (StringView const& lhs, StringView const& rhs)
+{
+    return !(lhs == rhs);
+}
+
+inline std::ostream&
+operator<< (std::ostream& out, StringView const& view)
+{
+    return out.write(view.data(), view.size());
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_STRING_VIEW_HEADER */
@@ -15,9 +15,16 @@
 #include <iomanip>
 #include <stdexcept>
 #include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <locale>
+#include <type_traits>
 
 #include "util/defines.h"
+#include "util/string_view.h"
 
 UTIL_NAMESPACE_BEGIN
 UTIL_STRING_NAMESPACE_BEGIN
@@ -38,9 +45,36 @@ std::string get_digits (T const& value, int digits);
 template <typename T>
 std::string get_filled (T const& value, int width, char fill = '0');
 
-/** From string to other types conversions. */
+/**
+ * From string to other types conversions. Leading whitespace is skipped,
+ * with strict conversion the remaining string must be a valid value.
+ * Numbers are converted with parse_number(), other types with streams.
+ */
+template <typename T>
+T convert (StringView str, bool strict_conversion = true);
+
+/**
+ * Parses a decimal number in [begin, end) like std::from_chars() and
+ * returns the position after the number, or nullptr if there is no valid
+ * number or it overflows. Integers are checked for the range of T. The
+ * conversion is independent of the locale and does not allocate, except
+ * for floating point numbers that are not exactly representable with a
+ * single operation, which are converted by a stream in the classic locale.
+ */
 template <typename T>
-T convert (std::string const& str, bool strict_conversion = true);
+char const* parse_number (char const* begin, char const* end, T* value);
+
+/**
+ * Parses a decimal floating point number at the beginning of 'str' after
+ * skipping blanks and returns the position after the number, or nullptr
+ * if there is no number. In contrast to convert(), no temporary strings
+ * are created which makes it suitable for parsing large text files.
+ * Short numbers are converted directly, all others like parse_number().
+ */
+char const* parse_float (char const* str, float* value);
+
+/** Like parse_float() for unsigned decimal integers, fails on overflow. */
+char const* parse_uint (char const* str, unsigned int* value);
 
 /** String representation for types. */
 template <typename T>
@@ -146,16 +180,308 @@ get_filled (T const& value, int width, char fill)
     return ss.str();
 }
 
+namespace internal
+{
+    /* Characters are converted as characters, not as numbers. */
+    template <typename T>
+    struct IsParsableNumber
+    {
+        static bool const value = std::is_floating_point<T>::value
+            || (std::is_integral<T>::value && sizeof(T) > 1);
+    };
+
+    template <typename T, bool NUMBER = IsParsableNumber<T>::value>
+    struct Converter
+    {
+        static T
+        convert (StringView str, bool strict_conversion)
+        {
+            std::stringstream ss(str.to_string());
+            T ret = T();
+            ss >> ret;
+            if (strict_conversion && (!ss.eof() || ss.fail()))
+                throw std::invalid_argument("Invalid string conversion: "
+                    + str.to_string());
+            return ret;
+        }
+    };
+
+    template <typename T>
+    struct Converter<T, true>
+    {
+        static T
+        convert (StringView str, bool strict_conversion)
+        {
+            char const* begin = str.begin();
+            while (begin < str.end() && std::isspace(
+                static_cast<unsigned char>(*begin)))
+                begin += 1;
+            T ret = T();
+            char const* next = parse_number(begin, str.end(), &ret);
+            if (strict_conversion && next != str.end())
+                throw std::invalid_argument("Invalid string conversion: "
+                    + str.to_string());
+            return next == nullptr ? T() : ret;
+        }
+    };
+
+    template <typename T>
+    inline char const*
+    parse_integer (char const* begin, char const* end, T* value)
+    {
+        typedef typename std::make_unsigned<T>::type Unsigned;
+        bool const negative = begin < end && *begin == '-';
+        if (negative && !std::is_signed<T>::value)
+            return nullptr;
+        char const* str = begin;
+        if (str < end && (*str == '-' || *str == '+'))
+            str += 1;
+
+        /* The magnitude of the minimum is one larger than the maximum. */
+        Unsigned const limit = static_cast<Unsigned>(
+            std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+        char const* digits = str;
+        Unsigned ret = 0;
+        for (; str < end && *str >= '0' && *str <= '9'; ++str)
+        {
+            Unsigned const digit = static_cast<Unsigned>(*str - '0');
+            if (ret > (limit - digit) / 10)
+                return nullptr;
+            ret = ret * 10 + digit;
+        }
+        if (str == digits)
+            return nullptr;
+        *value = static_cast<T>(negative ? Unsigned(0) - ret : ret);
+        return str;
+    }
+
+    /*
+     * Converts a validated decimal number in [begin, end) with the classic
+     * locale, which the C library functions do not allow to select in
+     * portable code. The stream conversion is correctly rounded like
+     * std::strtod(), but yields the largest value with a failure on
+     * overflow, which is mapped to infinity as by std::strtod().
+     */
+    template <typename T>
+    inline T
+    parse_real_classic (char const* begin, char const* end)
+    {
+        std::istringstream in(std::string(begin, end));
+        in.imbue(std::locale::classic());
+        T value = T(0);
+        in >> value;
+        if (in.fail())
+            value = std::copysign(std::numeric_limits<T>::infinity(),
+                value);
+        return value;
+    }
+
+    template <typename T>
+    inline char const*
+    parse_real (char const* begin, char const* end, T* value)
+    {
+        char const* str = begin;
+        bool const negative = str < end && *str == '-';
+        if (str < end && (*str == '-' || *str == '+'))
+            str += 1;
+
+        /* Collect up to 19 significant digits of the mantissa. */
+        uint64_t mantissa = 0;
+        int num_digits = 0;
+        int exponent = 0;
+        bool has_digits = false;
+        for (; str < end && *str >= '0' && *str <= '9'; ++str)
+        {
+            has_digits = true;
+            if (num_digits < 19)
+                mantissa = mantissa * 10 + (*str - '0');
+            else
+                exponent += 1;
+            num_digits += (mantissa != 0);
+        }
+        if (str < end && *str == '.')
+        {
+            str += 1;
+            for (; str < end && *str >= '0' && *str <= '9'; ++str)
+            {
+                has_digits = true;
+                if (num_digits >= 19)
+                    continue;
+                mantissa = mantissa * 10 + (*str - '0');
+                num_digits += (mantissa != 0);
+                exponent -= 1;
+            }
+        }
+        if (!has_digits)
+            return nullptr;
+
+        if (str < end && (*str == 'e' || *str == 'E'))
+        {
+            char const* exp_str = str + 1;
+            bool const exp_negative = exp_str < end && *exp_str == '-';
+            if (exp_str < end && (*exp_str == '-' || *exp_str == '+'))
+                exp_str += 1;
+            if (exp_str < end && *exp_str >= '0' && *exp_str <= '9')
+            {
+                int exp_value = 0;
+                for (; exp_str < end && *exp_str >= '0' && *exp_str <= '9';
+                    ++exp_str)
+                    if (exp_value < 100000)
+                        exp_value = exp_value * 10 + (*exp_str - '0');
+                exponent += exp_negative ? -exp_value : exp_value;
+                str = exp_str;
+            }
+        }
+
+        /* Exact mantissa and power of ten, see parse_float(). */
+        static double const powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5,
+            1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+            1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        int const max_exponent = sizeof(T) == sizeof(float) ? 10 : 22;
+        uint64_t const max_mantissa = uint64_t(1)
+            << std::numeric_limits<T>::digits;
+        if (num_digits < 19 && mantissa <= max_mantissa
+            && exponent >= -max_exponent && exponent <= max_exponent)
+        {
+            T ret = static_cast<T>(mantissa);
+            T const power = static_cast<T>(powers[std::abs(exponent)]);
+            ret = exponent < 0 ? ret / power : ret * power;
+            *value = negative ? -ret : ret;
+            return str;
+        }
+
+        /* The rare remaining numbers need a terminated copy. */
+        *value = parse_real_classic<T>(begin, str);
+        return str;
+    }
+
+    template <typename T>
+    inline char const*
+    parse_number_impl (char const* begin, char const* end, T* value,
+        std::true_type /*is_integral*/)
+    {
+        return parse_integer(begin, end, value);
+    }
+
+    template <typename T>
+    inline char const*
+    parse_number_impl (char const* begin, char const* end, T* value,
+        std::false_type /*is_integral*/)
+    {
+        return parse_real(begin, end, value);
+    }
+}  /* namespace internal */
+
 template <typename T>
 inline T
-convert (std::string const& str, bool strict_conversion)
+convert (StringView str, bool strict_conversion)
 {
-    std::stringstream ss(str);
-    T ret = T();
-    ss >> ret;
-    if (strict_conversion && (!ss.eof() || ss.fail()))
-        throw std::invalid_argument("Invalid string conversion: " + str);
-    return ret;
+    return internal::Converter<T>::convert(str, strict_conversion);
+}
+
+template <typename T>
+inline char const*
+parse_number (char const* begin, char const* end, T* value)
+{
+    static_assert(std::is_arithmetic<T>::value
+        && !std::is_same<T, bool>::value,
+        "parse_number() requires a number type");
+    return internal::parse_number_impl(begin, end, value,
+        std::integral_constant<bool, std::is_integral<T>::value>());
+}
+
+inline char const*
+parse_float (char const* str, float* value)
+{
+    while (*str == ' ' || *str == '\t')
+        str += 1;
+
+    char const* begin = str;
+    bool const negative = (*str == '-');
+    if (*str == '-' || *str == '+')
+        str += 1;
+
+    /* Collect up to 19 significant digits of the mantissa. */
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    for (; *str >= '0' && *str <= '9'; ++str, has_digits = true)
+    {
+        if (num_digits < 19)
+            mantissa = mantissa * 10 + (*str - '0');
+        else
+            exponent += 1;
+        num_digits += (mantissa != 0);
+    }
+    if (*str == '.')
+    {
+        str += 1;
+        for (; *str >= '0' && *str <= '9'; ++str, has_digits = true)
+        {
+            if (num_digits >= 19)
+                continue;
+            mantissa = mantissa * 10 + (*str - '0');
+            num_digits += (mantissa != 0);
+            exponent -= 1;
+        }
+    }
+    if (!has_digits)
+        return nullptr;
+
+    if (*str == 'e' || *str == 'E')
+    {
+        char const* exp_str = str + 1;
+        bool const exp_negative = (*exp_str == '-');
+        if (*exp_str == '-' || *exp_str == '+')
+            exp_str += 1;
+        if (*exp_str >= '0' && *exp_str <= '9')
+        {
+            int exp_value = 0;
+            for (; *exp_str >= '0' && *exp_str <= '9'; ++exp_str)
+                if (exp_value < 100000)
+                    exp_value = exp_value * 10 + (*exp_str - '0');
+            exponent += exp_negative ? -exp_value : exp_value;
+            str = exp_str;
+        }
+    }
+
+    /*
+     * Mantissa and power of ten are exact floats, a single multiplication
+     * or division is then correctly rounded. This is the common case.
+     */
+    static float const powers[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+        1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    if (num_digits < 19 && mantissa <= (1u << 24)
+        && exponent >= -10 && exponent <= 10)
+    {
+        float ret = static_cast<float>(mantissa);
+        ret = exponent < 0 ? ret / powers[-exponent] : ret * powers[exponent];
+        *value = negative ? -ret : ret;
+        return str;
+    }
+
+    *value = internal::parse_real_classic<float>(begin, str);
+    return str;
+}
+
+inline char const*
+parse_uint (char const* str, unsigned int* value)
+{
+    while (*str == ' ' || *str == '\t')
+        str += 1;
+    if (*str < '0' || *str > '9')
+        return nullptr;
+
+    uint64_t ret = 0;
+    for (; *str >= '0' && *str <= '9'; ++str)
+    {
+        ret = ret * 10 + (*str - '0');
+        if (ret > 0xffffffffu)
+            return nullptr;
+    }
+    *value = static_cast<unsigned int>(ret);
+    return str;
 }
 
 template <typename T>
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "util/numa.h"
+#include "util/thread_pool.h"
+
+UTIL_NAMESPACE_BEGIN
+
+namespace
+{
+    /* The pool and the worker ID of the calling thread if it is a worker. */
+    thread_local ThreadPool const* current_pool = nullptr;
+    thread_local std::size_t current_worker = 0;
+
+    std::atomic<std::size_t> global_num_threads(0);
+    std::atomic<int> global_affinity(AFFINITY_NONE);
+    std::atomic<bool> global_created(false);
+
+    std::size_t
+    get_default_num_threads (void)
+    {
+#ifdef _OPENMP
+        return std::max(1, omp_get_max_threads());
+#else
+        return std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+}  /* namespace */
+
+/* ---------------------------------------------------------------- */
+
+ThreadPool::ThreadPool (std::size_t num_workers, ThreadAffinity affinity)
+    : next_node_worker(0)
+    , num_queued(0)
+    , shutdown(false)
+{
+    if (num_workers == 0)
+        num_workers = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i < num_workers; ++i)
+        this->workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    this->assign_cpus(affinity);
+    for (std::size_t i = 0; i < num_workers; ++i)
+        this->threads.push_back(std::thread(&ThreadPool::worker_main,
+            this, i));
+}
+
+/* ---------------------------------------------------------------- */
+
+ThreadPool::~ThreadPool (void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->shutdown = true;
+    }
+    this->task_queued.notify_all();
+    for (std::size_t i = 0; i < this->threads.size(); ++i)
+        this->threads[i].join();
+}
+
+/* ---------------------------------------------------------------- */
+
+ThreadPool&
+ThreadPool::get_global (void)
+{
+    static ThreadPool pool((global_created = true, get_num_threads()),
+        static_cast<ThreadAffinity>(global_affinity.load()));
+    return pool;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::set_num_threads (std::size_t num_threads)
+{
+    if (global_created)
+        throw std::runtime_error("Global thread pool already in use");
+    global_num_threads = num_threads;
+#ifdef _OPENMP
+    if (num_threads > 0)
+        omp_set_num_threads(static_cast<int>(num_threads));
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::set_affinity (ThreadAffinity affinity)
+{
+    if (global_created)
+        throw std::runtime_error("Global thread pool already in use");
+    global_affinity = affinity;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::size_t
+ThreadPool::get_num_threads (void)
+{
+    /* The default is determined once, workers run OpenMP with 1 thread. */
+    static std::size_t const default_num_threads = get_default_num_threads();
+    std::size_t const num_threads = global_num_threads;
+    return num_threads > 0 ? num_threads : default_num_threads;
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+ThreadPool::resolve_num_threads (int requested)
+{
+    if (requested > 0)
+        return requested;
+    if (current_pool != nullptr || in_openmp_region())
+        return 1;
+    return static_cast<int>(get_num_threads());
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ThreadPool::in_openmp_region (void)
+{
+#ifdef _OPENMP
+    return omp_in_parallel();
+#else
+    return false;
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ThreadPool::is_worker_thread (void) const
+{
+    return current_pool == this;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::run (Task const& task)
+{
+    this->push_task(this->is_worker_thread()
+        ? *this->workers[current_worker] : this->shared, task);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::run_on_node (int node, Task const& task)
+{
+    if (node < 0 || node >= static_cast<int>(this->node_workers.size())
+        || this->node_workers[node].empty())
+    {
+        this->run(task);
+        return;
+    }
+
+    /* Prefer the calling worker, its deque is local and hot. */
+    std::vector<std::size_t> const& candidates = this->node_workers[node];
+    if (this->is_worker_thread()
+        && this->workers[current_worker]->node == node)
+    {
+        this->push_task(*this->workers[current_worker], task);
+        return;
+    }
+    std::size_t const index = this->next_node_worker.fetch_add(1);
+    this->push_task(*this->workers[candidates[index % candidates.size()]],
+        task);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::push_task (Worker& target, Task const& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->num_queued += 1;
+    }
+    this->task_queued.notify_one();
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ThreadPool::run_pending_task (void)
+{
+    Task task;
+    if (!this->pop_task(&task))
+        return false;
+    task();
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ThreadPool::pop_task (Task* task)
+{
+    if (this->num_queued <= 0)
+        return false;
+
+    /* Take the newest own task, which is most likely in the cache. */
+    bool const is_worker = this->is_worker_thread();
+    if (is_worker)
+    {
+        Worker& own = *this->workers[current_worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            *task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            this->num_queued -= 1;
+            return true;
+        }
+    }
+
+    /* Take the oldest shared task, or steal the oldest task of a worker. */
+    std::vector<std::size_t> const& victims = is_worker
+        ? this->workers[current_worker]->victims : this->shared.victims;
+    for (std::size_t i = 0; i <= victims.size(); ++i)
+    {
+        Worker& victim = i == 0 ? this->shared
+            : *this->workers[victims[i - 1]];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty())
+            continue;
+        *task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        this->num_queued -= 1;
+        return true;
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::assign_cpus (ThreadAffinity affinity)
+{
+    /* The CPUs in the order of assignment to the workers. */
+    NumaTopology const& topology = NumaTopology::get();
+    std::size_t const num_nodes = topology.get_num_nodes();
+    std::vector<int> cpus;
+    if (affinity == AFFINITY_COMPACT)
+    {
+        for (std::size_t i = 0; i < num_nodes; ++i)
+            cpus.insert(cpus.end(), topology.get_node_cpus(i).begin(),
+                topology.get_node_cpus(i).end());
+    }
+    else if (affinity == AFFINITY_SCATTER)
+    {
+        for (std::size_t j = 0; cpus.size() < topology.get_num_cpus(); ++j)
+            for (std::size_t i = 0; i < num_nodes; ++i)
+                if (j < topology.get_node_cpus(i).size())
+                    cpus.push_back(topology.get_node_cpus(i)[j]);
+    }
+
+    std::size_t const num_workers = this->workers.size();
+    if (!cpus.empty())
+    {
+        this->node_workers.resize(num_nodes);
+        for (std::size_t i = 0; i < num_workers; ++i)
+        {
+            Worker& worker = *this->workers[i];
+            worker.cpu = cpus[i % cpus.size()];
+            worker.node = topology.get_node_of_cpu(worker.cpu);
+            this->node_workers[worker.node].push_back(i);
+        }
+    }
+
+    /* Workers steal from the next workers, those of their node first. */
+    for (std::size_t i = 0; i < num_workers; ++i)
+    {
+        Worker& worker = *this->workers[i];
+        for (int same_node = 1; same_node >= 0; --same_node)
+            for (std::size_t j = 1; j < num_workers; ++j)
+            {
+                std::size_t const victim = (i + j) % num_workers;
+                if ((this->workers[victim]->node == worker.node)
+                    == (same_node == 1))
+                    worker.victims.push_back(victim);
+            }
+        this->shared.victims.push_back(i);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::worker_main (std::size_t worker_id)
+{
+    current_pool = this;
+    current_worker = worker_id;
+    if (this->workers[worker_id]->cpu >= 0)
+        set_thread_affinity(std::vector<int>(1,
+            this->workers[worker_id]->cpu));
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+
+    while (true)
+    {
+        if (this->run_pending_task())
+            continue;
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->task_queued.wait(lock, [this] (void)
+            { return this->shutdown || this->num_queued > 0; });
+        if (this->shutdown && this->num_queued <= 0)
+            return;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TaskGroup::wait (void)
+{
+    this->wait_all();
+    std::exception_ptr error;
+    std::swap(error, this->error);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TaskGroup::finish (std::exception_ptr error)
+{
+    /* Notify under the lock, the group may be destroyed right after. */
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (error && !this->error)
+        this->error = error;
+    this->num_running -= 1;
+    if (this->num_running == 0)
+        this->finished.notify_all();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TaskGroup::wait_all (void)
+{
+    while (true)
+    {
+        if (this->num_running == 0)
+        {
+            /* Wait until the last task has released the lock. */
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return;
+        }
+
+        /* Help with pending tasks, or wait for a while for new ones. */
+        if (this->pool.run_pending_task())
+            continue;
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->finished.wait_for(lock, std::chrono::milliseconds(1),
+            [this] (void) { return this->num_running == 0; });
+    }
+}
+
+UTIL_NAMESPACE_END
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2015, Simon Fuhrmann
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#ifndef UTIL_THREAD_POOL_HEADER
+#define UTIL_THREAD_POOL_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "util/defines.h"
+
+UTIL_NAMESPACE_BEGIN
+
+/** The placement of the worker threads of a pool on the CPUs. */
+enum ThreadAffinity
+{
+    /** Workers are not pinned and are scheduled by the system. */
+    AFFINITY_NONE,
+    /** Workers are pinned to the CPUs of the first nodes first. */
+    AFFINITY_COMPACT,
+    /** Workers are pinned to the CPUs of all nodes in turn. */
+    AFFINITY_SCATTER
+};
+
+/**
+ * Work-stealing task scheduler with a fixed set of worker threads.
+ *
+ * Every worker owns a deque of tasks. Tasks created by a worker are pushed
+ * to the back of its own deque and popped from there, idle workers steal
+ * from the front of the other deques. Tasks from other threads are queued
+ * in a shared deque. Threads waiting for tasks in TaskGroup::wait() and
+ * parallel_for() execute pending tasks instead of blocking, so nested
+ * parallel stages share the workers instead of spawning more threads.
+ * OpenMP regions within tasks run with a single thread for the same
+ * reason.
+ *
+ * With an affinity other than AFFINITY_NONE, every worker is pinned to one
+ * CPU and thus to a NUMA node. Idle workers steal from workers of their own
+ * node first, and run_on_node() queues tasks for the workers of a node, so
+ * data that a task allocates or first writes stays on the node of the task.
+ *
+ * The process-wide pool is created on first use with get_num_threads()
+ * workers. Tasks must not throw, use TaskGroup or submit() to propagate
+ * exceptions. The destructor finishes all queued tasks.
+ */
+class ThreadPool
+{
+public:
+    typedef std::function<void (void)> Task;
+
+public:
+    /** Creates the pool with the given amount of workers, 0 for all. */
+    explicit ThreadPool (std::size_t num_workers = 0,
+        ThreadAffinity affinity = AFFINITY_NONE);
+    ~ThreadPool (void);
+    ThreadPool (ThreadPool const& other) = delete;
+    ThreadPool& operator= (ThreadPool const& other) = delete;
+
+    /** Returns the process-wide pool with get_num_threads() workers. */
+    static ThreadPool& get_global (void);
+
+    /**
+     * Sets the process-wide amount of threads, 0 restores the default.
+     * This is the size of the global pool and the amount of OpenMP threads
+     * of the calling thread. It must be set before the global pool is used.
+     */
+    static void set_num_threads (std::size_t num_threads);
+
+    /**
+     * Sets the worker affinity of the process-wide pool, AFFINITY_NONE by
+     * default. It must be set before the global pool is used.
+     */
+    static void set_affinity (ThreadAffinity affinity);
+
+    /**
+     * Returns the process-wide amount of threads. This defaults to the
+     * OpenMP default, which respects OMP_NUM_THREADS, or the amount of
+     * cores without OpenMP.
+     */
+    static std::size_t get_num_threads (void);
+
+    /**
+     * Returns the amount of threads for a parallel stage that requests the
+     * given amount, where 0 or less requests the process-wide default.
+     * This is 1 for defaults within pool tasks and OpenMP regions, which
+     * avoids the oversubscription of nested parallel stages.
+     */
+    static int resolve_num_threads (int requested);
+
+    /** Returns true if the calling thread is within an OpenMP region. */
+    static bool in_openmp_region (void);
+
+    /** Returns the amount of worker threads. */
+    std::size_t get_num_workers (void) const;
+
+    /** Returns true if the calling thread is a worker of this pool. */
+    bool is_worker_thread (void) const;
+
+    /**
+     * Returns the NUMA node of the worker, or -1 if the worker is not
+     * pinned to a CPU.
+     */
+    int get_worker_node (std::size_t worker_id) const;
+
+    /** Queues the task for execution. */
+    void run (Task const& task);
+
+    /**
+     * Queues the task for the workers of the NUMA node. Workers of other
+     * nodes only take the task if they are idle, and the task is queued
+     * like run() if no worker is pinned to the node.
+     */
+    void run_on_node (int node, Task const& task);
+
+    /** Queues the function and returns a future for its result. */
+    template <typename FUNC>
+    std::future<typename std::result_of<FUNC ()>::type>
+    submit (FUNC func);
+
+    /**
+     * Executes one pending task in the calling thread. Returns false if
+     * there was no pending task.
+     */
+    bool run_pending_task (void);
+
+private:
+    struct Worker
+    {
+        Worker (void) : cpu(-1), node(-1) {}
+
+        std::deque<Task> tasks;
+        std::mutex mutex;
+        /* The CPU and node of a pinned worker, or -1. */
+        int cpu;
+        int node;
+        /* The other workers, those of the same node first. */
+        std::vector<std::size_t> victims;
+    };
+
+    void assign_cpus (ThreadAffinity affinity);
+    void push_task (Worker& target, Task const& task);
+    bool pop_task (Task* task);
+    void worker_main (std::size_t worker_id);
+
+private:
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> threads;
+    Worker shared;
+    /* The workers of every node, and the next worker for run_on_node(). */
+    std::vector<std::vector<std::size_t> > node_workers;
+    std::atomic<std::size_t> next_node_worker;
+    /* The amount of queued tasks, may be off while tasks are queued. */
+    std::atomic<long> num_queued;
+    std::mutex mutex;
+    std::condition_variable task_queued;
+    bool shutdown;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * A group of tasks that are waited for together.
+ *
+ * The waiting thread executes pending tasks of the pool until all tasks of
+ * the group are finished. The first exception thrown by a task is rethrown
+ * by wait(). The destructor waits for the tasks but discards exceptions.
+ */
+class TaskGroup
+{
+public:
+    explicit TaskGroup (ThreadPool& pool = ThreadPool::get_global());
+    ~TaskGroup (void);
+    TaskGroup (TaskGroup const& other) = delete;
+    TaskGroup& operator= (TaskGroup const& other) = delete;
+
+    /** Queues the function as a task of the group. */
+    template <typename FUNC>
+    void run (FUNC func);
+
+    /** Waits for all tasks and rethrows the first exception. */
+    void wait (void);
+
+private:
+    void finish (std::exception_ptr error);
+    void wait_all (void);
+
+private:
+    ThreadPool& pool;
+    std::atomic<std::size_t> num_running;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+/* ---------------------------------------------------------------- */
+
+/**
+ * Calls func(i) for all i in [begin, end) with the tasks of the pool.
+ * The range is split into chunks for about four times the amount of
+ * workers, but no smaller than 'min_chunk' indices. Nested loops within
+ * pool tasks share the workers. The loop runs in the calling thread if it
+ * is too small or called within an OpenMP region. The first exception is
+ * rethrown.
+ */
+template <typename FUNC>
+void
+parallel_for (std::size_t begin, std::size_t end, FUNC const& func,
+    std::size_t min_chunk = 1, ThreadPool& pool = ThreadPool::get_global());
+
+/* ------------------------ Implementation ------------------------ */
+
+template <typename FUNC>
+std::future<typename std::result_of<FUNC ()>::type>
+ThreadPool::submit (FUNC func)
+{
+    /* The task is shared because std::function must be copyable. */
+    typedef typename std::result_of<FUNC ()>::type ResultType;
+    std::shared_ptr<std::packaged_task<ResultType ()> > task
+        = std::make_shared<std::packaged_task<ResultType ()> >(func);
+    std::future<ResultType> result = task->get_future();
+    this->run([task] (void) { (*task)(); });
+    return result;
+}
+
+inline std::size_t
+ThreadPool::get_num_workers (void) const
+{
+    return this->threads.size();
+}
+
+inline int
+ThreadPool::get_worker_node (std::size_t worker_id) const
+{
+    return this->workers[worker_id]->node;
+}
+
+inline
+TaskGroup::TaskGroup (ThreadPool& pool)
+    : pool(pool)
+    , num_running(0)
+{
+}
+
+inline
+TaskGroup::~TaskGroup (void)
+{
+    this->wait_all();
+}
+
+template <typename FUNC>
+void
+TaskGroup::run (FUNC func)
+{
+    this->num_running += 1;
+    this->pool.run([this, func] (void)
+    {
+        std::exception_ptr error;
+        try
+        {
+            func();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        this->finish(error);
+    });
+}
+
+template <typename FUNC>
+void
+parallel_for (std::size_t begin, std::size_t end, FUNC const& func,
+    std::size_t min_chunk, ThreadPool& pool)
+{
+    if (begin >= end)
+        return;
+
+    std::size_t const num_chunks = 4 * pool.get_num_workers();
+    std::size_t const size = end - begin;
+    std::size_t const chunk = num_chunks == 0 ? size
+        : std::max(std::max<std::size_t>(min_chunk, 1),
+        (size + num_chunks - 1) / num_chunks);
+    if (chunk >= size || ThreadPool::in_openmp_region())
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            func(i);
+        return;
+    }
+
+    TaskGroup group(pool);
+    for (std::size_t first = begin; first < end; first += chunk)
+    {
+        std::size_t const last = std::min(end, first + chunk);
+        group.run([&func, first, last] (void)
+        {
+            for (std::size_t i = first; i < last; ++i)
+                func(i);
+        });
+    }
+    group.wait();
+}
+
+UTIL_NAMESPACE_END
+
+#endif /* UTIL_THREAD_POOL_HEADER */
@@ -16,6 +16,7 @@
 #include <algorithm>
 
 #include "util/strings.h"
+#include "util/string_view.h"
 #include "util/defines.h"
 
 UTIL_NAMESPACE_BEGIN
@@ -58,6 +59,25 @@ public:
 
 /* ---------------------------------------------------------------- */
 
+/**
+ * Tokenizer that references the tokens in the input string instead of
+ * copying them, for parsing large text files. The input string must
+ * outlive the tokens. Reusing the tokenizer for many lines avoids
+ * allocations altogether.
+ */
+class ViewTokenizer : public std::vector<StringView>
+{
+public:
+    /** Tokenization at a delimiter character, see Tokenizer::split(). */
+    void split (StringView str, char delim = ' ', bool keep_empty = false);
+
+    /** Returns the requested token as the specified type. */
+    template <typename T>
+    T get_as (std::size_t pos) const;
+};
+
+/* ---------------------------------------------------------------- */
+
 inline void
 Tokenizer::split (std::string const& str, char delim, bool keep_empty)
 {
@@ -130,6 +150,34 @@ Tokenizer::get_as (std::size_t pos) const
     return string::convert<T>(this->at(pos));
 }
 
+/* ---------------------------------------------------------------- */
+
+inline void
+ViewTokenizer::split (StringView str, char delim, bool keep_empty)
+{
+    this->clear();
+    std::size_t new_tok = 0;
+    for (std::size_t cur_pos = 0; cur_pos < str.size(); ++cur_pos)
+        if (str[cur_pos] == delim)
+        {
+            if (keep_empty || cur_pos > new_tok)
+                this->push_back(str.substr(new_tok, cur_pos - new_tok));
+            new_tok = cur_pos + 1;
+        }
+
+    if (keep_empty || new_tok < str.size())
+        this->push_back(str.substr(new_tok));
+}
+
+/* ---------------------------------------------------------------- */
+
+template <typename T>
+inline T
+ViewTokenizer::get_as (std::size_t pos) const
+{
+    return string::convert<T>(this->at(pos));
+}
+
 UTIL_NAMESPACE_END
 
 #endif /* UTIL_TOKENIZE_HEADER */